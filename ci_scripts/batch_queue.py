@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+
+# Hands books out to "Sigil --worker" processes so that one list of
+# books can be processed over several machines.
+#
+#   batch_queue.py [options] SOCKET JOBS_FILE
+#
+# SOCKET is the path of the unix socket to listen on, given to each
+# worker as queue=SOCKET, and JOBS_FILE has one job per line, either
+# json as -
+#
+#   {"id": "ID", "epub": "PATH", "args": ["search=Group", "clean=mend"]}
+#
+# or just the path of a book, which then gets the --args given here
+# and an id made from its file name.  See src/Misc/BatchWorker.h for
+# what is sent both ways.
+#
+# A request is only answered with "none" once every job has a result,
+# until then a request with nothing to hand out waits, since a job can
+# still come back.  A job comes back when the worker running it goes
+# away or says it failed, and is handed out again up to --retries more
+# times.  The workers keep the result of a job that saved, so handing
+# one out twice does not process the book twice.
+#
+# Every result is written as a line of json to --results as it comes
+# in.  Exits with 1 if any job did not save.
+
+import argparse
+import asyncio
+import json
+import os
+import sys
+
+
+class Queue:
+
+    def __init__(self, jobs, retries, results):
+        self.jobs = {job['id']: job for job in jobs}
+        self.pending = [job['id'] for job in jobs]
+        self.attempts = {job_id: 0 for job_id in self.jobs}
+        self.running = {}
+        self.results = {}
+        self.retries = retries
+        self.results_file = results
+        self.waiting = []
+        self.finished = asyncio.Event()
+        if not self.jobs:
+            self.finished.set()
+
+    def request(self, writer):
+        self.waiting.append(writer)
+        self.hand_out()
+
+    def hand_out(self):
+        while self.waiting and self.pending:
+            writer = self.waiting.pop(0)
+            if writer.is_closing():
+                continue
+            job_id = self.pending.pop(0)
+            self.attempts[job_id] += 1
+            self.running[job_id] = writer
+            send(writer, dict(self.jobs[job_id], type='job'))
+        if len(self.results) == len(self.jobs):
+            for writer in self.waiting:
+                if not writer.is_closing():
+                    send(writer, {'type': 'none'})
+            self.waiting = []
+            self.finished.set()
+
+    def result(self, message):
+        job_id = message.get('id')
+        if job_id not in self.running:
+            return
+        del self.running[job_id]
+        if not message.get('saved') and (self.attempts[job_id] <= self.retries):
+            self.pending.append(job_id)
+        else:
+            self.finish(job_id, message)
+        self.hand_out()
+
+    def lost(self, writer):
+        self.waiting = [w for w in self.waiting if w is not writer]
+        for job_id in [j for j, w in self.running.items() if w is writer]:
+            del self.running[job_id]
+            if self.attempts[job_id] <= self.retries:
+                self.pending.append(job_id)
+            else:
+                self.finish(job_id, {'type': 'result', 'id': job_id, 'saved': False,
+                                     'line': '%s: failed: its worker went away' % self.jobs[job_id]['epub']})
+        self.hand_out()
+
+    def finish(self, job_id, message):
+        self.results[job_id] = message
+        self.results_file.write(json.dumps(message) + '\n')
+        self.results_file.flush()
+        print(message.get('line', job_id), flush=True)
+
+
+def send(writer, message):
+    writer.write((json.dumps(message) + '\n').encode('utf-8'))
+
+
+def read_jobs(path, args):
+    jobs = []
+    with open(path, encoding='utf-8') as jobs_file:
+        for line in jobs_file:
+            line = line.strip()
+            if not line:
+                continue
+            if line.startswith('{'):
+                job = json.loads(line)
+            else:
+                name = os.path.splitext(os.path.basename(line))[0]
+                job = {'id': ''.join(c if c.isalnum() or c in '._-' else '_' for c in name),
+                       'epub': os.path.abspath(line), 'args': list(args)}
+            if job['id'] in [j['id'] for j in jobs]:
+                sys.exit('the job id %s is used twice' % job['id'])
+            jobs.append(job)
+    return jobs
+
+
+async def serve(socket_path, queue):
+    async def worker(reader, writer):
+        try:
+            while True:
+                line = await reader.readline()
+                if not line:
+                    break
+                message = json.loads(line)
+                if message.get('type') == 'request':
+                    queue.request(writer)
+                elif message.get('type') == 'result':
+                    queue.result(message)
+        finally:
+            queue.lost(writer)
+            writer.close()
+
+    if os.path.exists(socket_path):
+        os.remove(socket_path)
+    server = await asyncio.start_unix_server(worker, path=socket_path)
+    async with server:
+        await queue.finished.wait()
+    os.remove(socket_path)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Hand out books to Sigil --worker processes.')
+    parser.add_argument('socket')
+    parser.add_argument('jobs')
+    parser.add_argument('--args', nargs='*', default=[],
+                        help='the batch keys for books listed only by path')
+    parser.add_argument('--retries', type=int, default=2,
+                        help='how many more times a job is handed out after it fails')
+    parser.add_argument('--results', default='results.jsonl')
+    options = parser.parse_args()
+
+    jobs = read_jobs(options.jobs, options.args)
+    with open(options.results, 'w', encoding='utf-8') as results:
+        queue = Queue(jobs, options.retries, results)
+        asyncio.run(serve(options.socket, queue))
+    failed = [r for r in queue.results.values() if not r.get('saved')]
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
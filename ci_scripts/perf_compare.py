@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+
+# Compares how long two Sigil builds take to run the same workload
+# over the same books, to catch slowdowns before a release.
+#
+#   perf_compare.py [options] BASELINE_SIGIL CANDIDATE_SIGIL book.epub ...
+#
+# Each run copies the books to a temporary folder and processes them
+# one at a time with "Sigil --batch": open, universal rename, a book
+# wide replace, Mend all, reports and save.  The builds take turns run
+# by run so that a machine getting busier or cooler part way through
+# hurts both the same.  The first run of each build is thrown away to
+# warm the disk cache.
+#
+# For every step the median of each build is printed along with how
+# much slower or faster the candidate is.  A step is only called a
+# regression or an improvement when the change is bigger than the
+# threshold AND a Mann-Whitney U test over the runs says it is not
+# noise, so one slow run never fails a comparison on its own.
+#
+# With --generate N a corpus of N books of growing size is first made
+# with the baseline build's --generate-book instead of using books
+# given on the command line.
+#
+# Exits with 1 if any step regressed.
+
+import argparse
+import csv
+import math
+import os
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+
+STEPS = ['open', 'rename', 'replace', 'clean', 'reports', 'save', 'total']
+
+WORKLOAD = ['jobs=1',
+            'rename=Section0001.xhtml',
+            'find=(?i)\\bthe\\b',
+            'replace=the',
+            'find=\\s+</p>',
+            'replace=</p>',
+            'clean=mend']
+
+
+def run_workload(sigil, books, workdir):
+    # work on copies so every run starts from the same books
+    if os.path.exists(workdir):
+        shutil.rmtree(workdir)
+    os.makedirs(workdir)
+    copies = []
+    for book in books:
+        copy = os.path.join(workdir, os.path.basename(book))
+        shutil.copy2(book, copy)
+        copies.append(copy)
+    timings = os.path.join(workdir, 'timings.csv')
+    command = [sigil, '--batch'] + WORKLOAD + ['reports=' + os.path.join(workdir, 'reports'),
+                                               'output=' + os.path.join(workdir, 'output'),
+                                               'timings=' + timings] + copies
+    result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    if result.returncode != 0:
+        print(result.stdout)
+        sys.exit('%s failed the workload' % sigil)
+
+    # summed over the books, per step
+    totals = {}
+    with open(timings, encoding='utf-8') as f:
+        for row in csv.DictReader(f):
+            totals[row['Step']] = totals.get(row['Step'], 0.0) + float(row['Milliseconds'])
+    return totals
+
+
+def mann_whitney_p(a, b):
+    # two sided, with the normal approximation and the tie correction
+    n1 = len(a)
+    n2 = len(b)
+    ranked = sorted([(v, 0) for v in a] + [(v, 1) for v in b])
+    ranks = [0.0] * len(ranked)
+    ties = 0.0
+    i = 0
+    while i < len(ranked):
+        j = i
+        while j + 1 < len(ranked) and ranked[j + 1][0] == ranked[i][0]:
+            j += 1
+        for k in range(i, j + 1):
+            ranks[k] = (i + j) / 2.0 + 1
+        t = j - i + 1
+        ties += t ** 3 - t
+        i = j + 1
+    r1 = sum(r for r, (v, g) in zip(ranks, ranked) if g == 0)
+    u = r1 - n1 * (n1 + 1) / 2.0
+    n = n1 + n2
+    sigma = math.sqrt(n1 * n2 / 12.0 * ((n + 1) - ties / (n * (n - 1))))
+    if sigma == 0:
+        return 1.0
+    z = (abs(u - n1 * n2 / 2.0) - 0.5) / sigma
+    return math.erfc(max(z, 0.0) / math.sqrt(2))
+
+
+def generate_corpus(sigil, count, folder):
+    books = []
+    for i in range(count):
+        book = os.path.join(folder, 'corpus%02d.epub' % (i + 1))
+        command = [sigil, '--generate-book', book,
+                   'chapters=%d' % (50 * (i + 1)), 'seed=%d' % (i + 1)]
+        if subprocess.run(command).returncode != 0:
+            sys.exit('could not generate ' + book)
+        books.append(book)
+    return books
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare two Sigil builds on a fixed workload.')
+    parser.add_argument('baseline')
+    parser.add_argument('candidate')
+    parser.add_argument('books', nargs='*')
+    parser.add_argument('--runs', type=int, default=7, help='timed runs of each build (default 7)')
+    parser.add_argument('--threshold', type=float, default=5.0,
+                        help='smallest change in percent that counts (default 5)')
+    parser.add_argument('--alpha', type=float, default=0.05,
+                        help='largest p value that is not noise (default 0.05)')
+    parser.add_argument('--generate', type=int, default=0, metavar='N',
+                        help='make a corpus of N books instead of using books given')
+    args = parser.parse_args()
+
+    tempdir = tempfile.mkdtemp(prefix='sigil_perf_')
+    try:
+        books = args.books
+        if args.generate > 0:
+            books = generate_corpus(args.baseline, args.generate, tempdir)
+        if not books:
+            parser.error('no books given')
+
+        builds = [args.baseline, args.candidate]
+        runs = {0: [], 1: []}
+        for run in range(args.runs + 1):
+            for which in (run % 2, 1 - run % 2):
+                totals = run_workload(builds[which], books, os.path.join(tempdir, 'work'))
+                if run > 0:
+                    runs[which].append(totals)
+            print('run %d of %d done' % (run, args.runs), file=sys.stderr)
+
+        regressed = False
+        print('%-10s %12s %12s %9s %8s  %s' % ('step', 'baseline ms', 'candidate ms', 'change', 'p', 'verdict'))
+        for step in STEPS:
+            a = [totals[step] for totals in runs[0] if step in totals]
+            b = [totals[step] for totals in runs[1] if step in totals]
+            if not a or not b:
+                continue
+            median_a = statistics.median(a)
+            median_b = statistics.median(b)
+            change = (median_b - median_a) / median_a * 100.0 if median_a > 0 else 0.0
+            p = mann_whitney_p(a, b)
+            verdict = 'same'
+            if p <= args.alpha and abs(change) >= args.threshold:
+                verdict = 'SLOWER' if change > 0 else 'faster'
+                if change > 0:
+                    regressed = True
+            print('%-10s %12.1f %12.1f %+8.1f%% %8.3f  %s' % (step, median_a, median_b, change, p, verdict))
+        return 1 if regressed else 0
+    finally:
+        shutil.rmtree(tempdir, ignore_errors=True)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -707,6 +707,33 @@ void gumbo_memory_set_allocator(void *(*allocator_p)(void *, size_t));
  */
 void gumbo_memory_set_free(void (*free_p)(void *));
 
+/**
+ * An arena that gumbo allocations can be carved out of instead of the
+ * allocator above.  Blocks are never individually returned to the system,
+ * the whole arena is released at once by gumbo_arena_destroy.
+ */
+typedef struct GumboArena GumboArena;
+
+/**
+ * Create an empty arena.  chunk_size is the size of the first region it
+ * grabs from the allocator, later regions double in size.  Pass 0 for
+ * a default.
+ */
+GumboArena* gumbo_arena_create(size_t chunk_size);
+
+/**
+ * Make arena the one used by every gumbo allocation made on the calling
+ * thread, or pass NULL to go back to the allocator.  Returns the arena
+ * that was current before so that callers can restore it.
+ */
+GumboArena* gumbo_arena_set_current(GumboArena* arena);
+
+/**
+ * Release everything allocated from arena.  Any output parsed into it
+ * must have been destroyed (or simply no longer be used) first.
+ */
+void gumbo_arena_destroy(GumboArena* arena);
+
 /** Convert a `GumboOutputStatus` code into a readable description. */
 const char* gumbo_status_to_string(GumboOutputStatus status);
 
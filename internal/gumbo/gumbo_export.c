@@ -0,0 +1,171 @@
+// Copyright 2024 Kevin B. Hendricks, Stratford Ontario  All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gumbo.h"
+#include "gumbo_export.h"
+
+typedef struct {
+  char* data;
+  size_t length;
+  size_t capacity;
+  int failed;
+} ExportBuffer;
+
+static void reserve(ExportBuffer* buffer, size_t extra) {
+  if (buffer->failed || buffer->length + extra <= buffer->capacity) {
+    return;
+  }
+  size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+  while (capacity < buffer->length + extra) {
+    capacity *= 2;
+  }
+  char* data = realloc(buffer->data, capacity);
+  if (!data) {
+    buffer->failed = 1;
+    return;
+  }
+  buffer->data = data;
+  buffer->capacity = capacity;
+}
+
+static void put_uint(ExportBuffer* buffer, unsigned int value) {
+  uint32_t v = (uint32_t) value;
+  reserve(buffer, sizeof(v));
+  if (buffer->failed) {
+    return;
+  }
+  memcpy(buffer->data + buffer->length, &v, sizeof(v));
+  buffer->length += sizeof(v);
+}
+
+static void put_bytes(ExportBuffer* buffer, const char* data, size_t length) {
+  if (!data) {
+    length = 0;
+  }
+  put_uint(buffer, (unsigned int) length);
+  reserve(buffer, length);
+  if (buffer->failed || length == 0) {
+    return;
+  }
+  memcpy(buffer->data + buffer->length, data, length);
+  buffer->length += length;
+}
+
+static void put_string(ExportBuffer* buffer, const char* text) {
+  put_bytes(buffer, text, text ? strlen(text) : 0);
+}
+
+static void put_position(ExportBuffer* buffer, const GumboSourcePosition* pos) {
+  put_uint(buffer, pos->line);
+  put_uint(buffer, pos->column);
+  put_uint(buffer, pos->offset);
+}
+
+// The same name the tag_name of the python bindings gives
+static void put_tag_name(ExportBuffer* buffer, const GumboElement* element, unsigned int* flags) {
+  GumboStringPiece original = element->original_tag;
+  gumbo_tag_from_original_text(&original);
+  if (element->tag_namespace == GUMBO_NAMESPACE_SVG) {
+    const char* svg_tagname = gumbo_normalize_svg_tagname(&original);
+    if (svg_tagname) {
+      put_string(buffer, svg_tagname);
+      return;
+    }
+  }
+  if (element->tag == GUMBO_TAG_UNKNOWN) {
+    *flags |= GUMBO_EXPORT_UNKNOWN_TAG;
+    put_bytes(buffer, original.data, original.length);
+    return;
+  }
+  put_string(buffer, gumbo_normalized_tagname(element->tag));
+}
+
+static void export_node(ExportBuffer* buffer, const GumboNode* node) {
+  unsigned int i;
+  if (buffer->failed) {
+    return;
+  }
+  put_uint(buffer, node->type);
+  switch (node->type) {
+    case GUMBO_NODE_DOCUMENT: {
+      const GumboDocument* document = &node->v.document;
+      put_uint(buffer, document->has_doctype);
+      put_uint(buffer, document->children.length);
+      put_string(buffer, document->name);
+      put_string(buffer, document->public_identifier);
+      put_string(buffer, document->system_identifier);
+      for (i = 0; i < document->children.length; ++i) {
+        export_node(buffer, document->children.data[i]);
+      }
+      break;
+    }
+    case GUMBO_NODE_ELEMENT:
+    case GUMBO_NODE_TEMPLATE: {
+      const GumboElement* element = &node->v.element;
+      // the flags are only known once the tag name is written
+      size_t flags_at = buffer->length + sizeof(uint32_t);
+      unsigned int flags = 0;
+      put_uint(buffer, element->tag_namespace);
+      put_uint(buffer, 0);
+      put_uint(buffer, element->children.length);
+      put_uint(buffer, element->attributes.length);
+      put_position(buffer, &element->start_pos);
+      put_position(buffer, &element->end_pos);
+      put_tag_name(buffer, element, &flags);
+      if (!buffer->failed) {
+        uint32_t v = (uint32_t) flags;
+        memcpy(buffer->data + flags_at, &v, sizeof(v));
+      }
+      put_bytes(buffer, element->original_tag.data, element->original_tag.length);
+      put_bytes(buffer, element->original_end_tag.data, element->original_end_tag.length);
+      for (i = 0; i < element->attributes.length; ++i) {
+        const GumboAttribute* attr = element->attributes.data[i];
+        put_uint(buffer, attr->attr_namespace);
+        put_string(buffer, attr->name);
+        put_string(buffer, attr->value);
+      }
+      for (i = 0; i < element->children.length; ++i) {
+        export_node(buffer, element->children.data[i]);
+      }
+      break;
+    }
+    default: {
+      const GumboText* text = &node->v.text;
+      put_position(buffer, &text->start_pos);
+      put_string(buffer, text->text);
+      put_bytes(buffer, text->original_text.data, text->original_text.length);
+      break;
+    }
+  }
+}
+
+char* gumbo_export_tree(const GumboNode* node, size_t* length) {
+  ExportBuffer buffer = {NULL, 0, 0, 0};
+  export_node(&buffer, node);
+  if (buffer.failed) {
+    free(buffer.data);
+    return NULL;
+  }
+  *length = buffer.length;
+  return buffer.data;
+}
+
+void gumbo_free_export(char* table) {
+  free(table);
+}
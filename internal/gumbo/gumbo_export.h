@@ -0,0 +1,60 @@
+// Copyright 2024 Kevin B. Hendricks, Stratford Ontario  All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef GUMBO_EXPORT_H_
+#define GUMBO_EXPORT_H_
+
+#include <stddef.h>
+
+#include "gumbo.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  // Writes the tree below node into one flat table so that bindings such
+  // as the ctypes ones of the plugin launcher can build their own tree
+  // without a call into the library for every node and field.
+  //
+  // Nodes are written in document order, each one followed by its
+  // children.  All numbers are native unsigned 32 bit ints and every
+  // string is its length in bytes followed by its utf-8 bytes.
+  //
+  //   document:   type, has_doctype, child count,
+  //               name, public identifier, system identifier
+  //   element:    type, namespace, flags, child count, attribute count,
+  //   template    start line, column, offset, end line, column, offset,
+  //               tag name, original tag, original end tag,
+  //               then for each attribute: namespace, name, value
+  //   text, cdata type, start line, column, offset,
+  //   comment,    text, original text
+  //   whitespace
+  //
+  // Flags has GUMBO_EXPORT_UNKNOWN_TAG set when the tag name is the
+  // name as written in the original tag, which is not lowercased.
+  //
+  // Returns NULL if memory runs out, otherwise the table which must be
+  // released with gumbo_free_export, and sets length to its size.
+  char* gumbo_export_tree(const GumboNode* node, size_t* length);
+
+  void gumbo_free_export(char* table);
+
+#define GUMBO_EXPORT_UNKNOWN_TAG 1
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // GUMBO_EXPORT_H_
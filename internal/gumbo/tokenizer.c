@@ -659,6 +659,25 @@ static void append_char_to_tag_buffer(GumboParser* parser, int codepoint,
   gumbo_string_buffer_append_codepoint(codepoint, buffer);
 }
 
+// Appends the printable ASCII that follows the current character of a quoted
+// attribute value straight to the tag buffer, up to the closing quote or the
+// next character reference, leaving the input on the last character appended.
+// Values are mostly plain text so this saves going through the state machine
+// one character at a time.
+static void append_plain_run_to_tag_buffer(GumboParser* parser, char quote) {
+  Utf8Iterator* input = &parser->_tokenizer_state->_input;
+  int c = utf8iterator_current(input);
+  if (c < 0x20 || c >= 0x7F) {
+    return;
+  }
+  GumboStringPiece run;
+  run.data = utf8iterator_get_char_pointer(input) + 1;
+  run.length = utf8iterator_skip_plain_ascii(input, quote, '&');
+  if (run.length > 0) {
+    gumbo_string_buffer_append_string(&run, &parser->_tokenizer_state->_tag_state._buffer);
+  }
+}
+
 // (Re-)initialize the tag buffer.  This also resets the original_text pointer
 // and _start_pos field to point to the current position.
 static void initialize_tag_buffer(GumboParser* parser) {
@@ -1824,6 +1843,7 @@ static StateResult handle_attr_value_double_quoted_state(
       return NEXT_CHAR;
     default:
       append_char_to_tag_buffer(parser, c, false);
+      append_plain_run_to_tag_buffer(parser, '"');
       return NEXT_CHAR;
   }
 }
@@ -1853,6 +1873,7 @@ static StateResult handle_attr_value_single_quoted_state(
       return NEXT_CHAR;
     default:
       append_char_to_tag_buffer(parser, c, false);
+      append_plain_run_to_tag_buffer(parser, '\'');
       return NEXT_CHAR;
   }
 }
@@ -21,6 +21,11 @@
 #include <string.h>
 #include <strings.h>    // For strncasecmp.
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GUMBO_HAVE_SSE2 1
+#endif
+
 #include "error.h"
 #include "gumbo.h"
 #include "parser.h"
@@ -127,6 +132,20 @@ static void read_char(Utf8Iterator* iter) {
     return;
   }
 
+  // 7-bit characters other than the carriage return need none of the
+  // decoding below.
+  unsigned char first = (unsigned char) *iter->_start;
+  if (first < 0x80 && first != '\r') {
+    iter->_width = 1;
+    if (utf8_is_invalid_code_point(first)) {
+      add_error(iter, GUMBO_ERR_UTF8_INVALID);
+      iter->_current = kUtf8ReplacementChar;
+    } else {
+      iter->_current = first;
+    }
+    return;
+  }
+
   uint32_t code_point = 0;
   uint32_t state = UTF8_ACCEPT;
   for (const char* c = iter->_start; c < iter->_end; ++c) {
@@ -216,6 +235,50 @@ void utf8iterator_next(Utf8Iterator* iter) {
   read_char(iter);
 }
 
+// True for printable 7-bit characters other than the two stop characters.
+static inline bool is_plain_ascii(char c, char stop1, char stop2) {
+  return c >= 0x20 && c < 0x7F && c != stop1 && c != stop2;
+}
+
+size_t utf8iterator_skip_plain_ascii(Utf8Iterator* iter, char stop1, char stop2) {
+  assert(iter->_width == 1 && iter->_current >= 0x20 && iter->_current < 0x7F);
+  const char* run = iter->_start + 1;
+  const char* c = run;
+  const char* end = iter->_end;
+#ifdef GUMBO_HAVE_SSE2
+  // Sixteen bytes at a time for as long as they are all plain; the
+  // scalar loop below finds where in the last block the run ends.
+  const __m128i below = _mm_set1_epi8(0x20 - 1);
+  const __m128i above = _mm_set1_epi8(0x7F);
+  const __m128i s1 = _mm_set1_epi8(stop1);
+  const __m128i s2 = _mm_set1_epi8(stop2);
+  while (end - c >= 16) {
+    __m128i bytes = _mm_loadu_si128((const __m128i*) c);
+    // Bytes of 0x80 and up are negative as signed chars so fail both tests.
+    __m128i plain = _mm_and_si128(_mm_cmpgt_epi8(bytes, below), _mm_cmplt_epi8(bytes, above));
+    __m128i stops = _mm_or_si128(_mm_cmpeq_epi8(bytes, s1), _mm_cmpeq_epi8(bytes, s2));
+    if (_mm_movemask_epi8(_mm_andnot_si128(stops, plain)) != 0xFFFF) {
+      break;
+    }
+    c += 16;
+  }
+#endif
+  while (c < end && is_plain_ascii(*c, stop1, stop2)) {
+    ++c;
+  }
+  size_t count = (size_t) (c - run);
+  if (count == 0) {
+    return 0;
+  }
+  // None of the skipped characters is a newline or a tab so each one
+  // is a single column.
+  iter->_start += count;
+  iter->_pos.offset += count;
+  iter->_pos.column += (unsigned int) count;
+  iter->_current = (unsigned char) *iter->_start;
+  return count;
+}
+
 int utf8iterator_current(const Utf8Iterator* iter) {
   return iter->_current;
 }
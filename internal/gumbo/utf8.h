@@ -88,6 +88,14 @@ void utf8iterator_init(
 // Advances the current position by one code point.
 void utf8iterator_next(Utf8Iterator* iter);
 
+// Skips the run of printable 7-bit characters that follows the current one,
+// stopping before any control or non-ASCII character and before the two stop
+// characters.  The iterator is left on the last character skipped, with its
+// position updated, so that the caller's own utf8iterator_next moves past the
+// run.  The current character must itself be printable 7-bit.  Returns the
+// number of characters skipped.
+size_t utf8iterator_skip_plain_ascii(Utf8Iterator* iter, char stop1, char stop2);
+
 // Returns the current code point as an integer.
 int utf8iterator_current(const Utf8Iterator* iter);
 
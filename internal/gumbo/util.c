@@ -48,6 +48,182 @@ void gumbo_memory_set_free(void (*free_p)(void *))
   gumbo_user_free = free_p ? free_p : free;
 }
 
+/*
+ * Arena allocation.
+ *
+ * Every block handed out by gumbo_malloc starts with a small header giving
+ * its size and, for arena blocks, the chunk it was carved from.  That lets
+ * gumbo_free and gumbo_realloc tell the two kinds apart no matter which
+ * arena (if any) is current when they are called.  Freeing an arena block
+ * only gives the space back when it is the most recent block of its chunk,
+ * which covers the grow/shrink pattern of the string buffers and vectors.
+ * Everything else is released at once by gumbo_arena_destroy.
+ */
+
+#if defined(_MSC_VER)
+#define GUMBO_THREAD_LOCAL __declspec(thread)
+#else
+#define GUMBO_THREAD_LOCAL __thread
+#endif
+
+#define GUMBO_ARENA_ALIGN (2 * sizeof(void*))
+#define GUMBO_ALIGN_UP(n) (((n) + GUMBO_ARENA_ALIGN - 1) & ~(GUMBO_ARENA_ALIGN - 1))
+
+static const size_t kGumboArenaDefaultChunkSize = 64 * 1024;
+static const size_t kGumboArenaMaxChunkSize = 16 * 1024 * 1024;
+
+typedef struct GumboArenaChunk {
+  struct GumboArenaChunk* next;
+  size_t capacity;
+  size_t used;
+} GumboArenaChunk;
+
+struct GumboArena {
+  GumboArenaChunk* chunks;
+  size_t next_chunk_size;
+};
+
+typedef struct {
+  size_t size;
+  // NULL for blocks from gumbo_user_allocator
+  GumboArenaChunk* chunk;
+} GumboBlockHeader;
+
+#define GUMBO_HEADER_SIZE GUMBO_ALIGN_UP(sizeof(GumboBlockHeader))
+#define GUMBO_CHUNK_HEADER_SIZE GUMBO_ALIGN_UP(sizeof(GumboArenaChunk))
+
+static GUMBO_THREAD_LOCAL GumboArena* gumbo_current_arena = NULL;
+
+static inline GumboBlockHeader* block_header(void* ptr)
+{
+  return (GumboBlockHeader*)((char*)ptr - GUMBO_HEADER_SIZE);
+}
+
+static inline char* chunk_data(GumboArenaChunk* chunk)
+{
+  return (char*)chunk + GUMBO_CHUNK_HEADER_SIZE;
+}
+
+static inline size_t block_span(size_t size)
+{
+  return GUMBO_ALIGN_UP(GUMBO_HEADER_SIZE + size);
+}
+
+// True if the block is the last one carved out of its chunk
+static inline bool is_last_in_chunk(GumboBlockHeader* header)
+{
+  GumboArenaChunk* chunk = header->chunk;
+  return (char*)header + block_span(header->size) == chunk_data(chunk) + chunk->used;
+}
+
+static void* arena_alloc(GumboArena* arena, size_t size)
+{
+  size_t span = block_span(size);
+  GumboArenaChunk* chunk = arena->chunks;
+  if (!chunk || chunk->capacity - chunk->used < span) {
+    size_t capacity = arena->next_chunk_size;
+    if (capacity < span) capacity = span;
+    chunk = gumbo_user_allocator(NULL, GUMBO_CHUNK_HEADER_SIZE + capacity);
+    if (!chunk) return NULL;
+    chunk->capacity = capacity;
+    chunk->used = 0;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    if (arena->next_chunk_size < kGumboArenaMaxChunkSize) {
+      arena->next_chunk_size *= 2;
+    }
+  }
+  GumboBlockHeader* header = (GumboBlockHeader*)(chunk_data(chunk) + chunk->used);
+  chunk->used += span;
+  header->size = size;
+  header->chunk = chunk;
+  return (char*)header + GUMBO_HEADER_SIZE;
+}
+
+void* gumbo_malloc(size_t size)
+{
+  if (gumbo_current_arena) {
+    return arena_alloc(gumbo_current_arena, size);
+  }
+  GumboBlockHeader* header = gumbo_user_allocator(NULL, GUMBO_HEADER_SIZE + size);
+  if (!header) return NULL;
+  header->size = size;
+  header->chunk = NULL;
+  return (char*)header + GUMBO_HEADER_SIZE;
+}
+
+void* gumbo_realloc(void* ptr, size_t size)
+{
+  if (!ptr) return gumbo_malloc(size);
+  GumboBlockHeader* header = block_header(ptr);
+
+  if (!header->chunk) {
+    header = gumbo_user_allocator(header, GUMBO_HEADER_SIZE + size);
+    if (!header) return NULL;
+    header->size = size;
+    return (char*)header + GUMBO_HEADER_SIZE;
+  }
+
+  // Grow or shrink the newest block of a chunk in place
+  GumboArenaChunk* chunk = header->chunk;
+  if (is_last_in_chunk(header)) {
+    size_t start = chunk->used - block_span(header->size);
+    if (chunk->capacity - start >= block_span(size)) {
+      chunk->used = start + block_span(size);
+      header->size = size;
+      return ptr;
+    }
+  }
+
+  void* new_ptr = gumbo_malloc(size);
+  if (!new_ptr) return NULL;
+  memcpy(new_ptr, ptr, header->size < size ? header->size : size);
+  gumbo_free(ptr);
+  return new_ptr;
+}
+
+void gumbo_free(void* ptr)
+{
+  if (!ptr) return;
+  GumboBlockHeader* header = block_header(ptr);
+  if (!header->chunk) {
+    gumbo_user_free(header);
+    return;
+  }
+  if (is_last_in_chunk(header)) {
+    header->chunk->used -= block_span(header->size);
+  }
+}
+
+GumboArena* gumbo_arena_create(size_t chunk_size)
+{
+  GumboArena* arena = gumbo_user_allocator(NULL, sizeof(GumboArena));
+  if (!arena) return NULL;
+  arena->chunks = NULL;
+  arena->next_chunk_size = chunk_size ? chunk_size : kGumboArenaDefaultChunkSize;
+  return arena;
+}
+
+GumboArena* gumbo_arena_set_current(GumboArena* arena)
+{
+  GumboArena* previous = gumbo_current_arena;
+  gumbo_current_arena = arena;
+  return previous;
+}
+
+void gumbo_arena_destroy(GumboArena* arena)
+{
+  if (!arena) return;
+  if (gumbo_current_arena == arena) gumbo_current_arena = NULL;
+  GumboArenaChunk* chunk = arena->chunks;
+  while (chunk) {
+    GumboArenaChunk* next = chunk->next;
+    gumbo_user_free(chunk);
+    chunk = next;
+  }
+  gumbo_user_free(arena);
+}
+
 bool gumbo_isspace(unsigned char ch) 
 {
   switch(ch) {
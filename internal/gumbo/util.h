@@ -34,15 +34,15 @@ extern "C" {
 extern void *(* gumbo_user_allocator)(void *, size_t);
 extern void (* gumbo_user_free)(void *);
 
-static inline void *gumbo_malloc(size_t size)
-{
-  return gumbo_user_allocator(NULL, size);
-}
+// All gumbo memory goes through these.  When an arena has been made current
+// on the calling thread (see gumbo_arena_set_current) blocks are carved out
+// of the arena, otherwise they come from gumbo_user_allocator.  Either kind
+// of block may be passed to gumbo_realloc and gumbo_free at any time.
+void *gumbo_malloc(size_t size);
 
-static inline void *gumbo_realloc(void *ptr, size_t size)
-{
-  return gumbo_user_allocator(ptr, size);
-}
+void *gumbo_realloc(void *ptr, size_t size);
+
+void gumbo_free(void *ptr);
 
 static inline char *gumbo_strdup(const char *str)
 {
@@ -52,11 +52,6 @@ static inline char *gumbo_strdup(const char *str)
   return copy;
 }
 
-static inline void gumbo_free(void *ptr)
-{
-  gumbo_user_free(ptr);
-}
-
 static inline int gumbo_tolower(int c)
 {
   return c | ((c >= 'A' && c <= 'Z') << 5);
@@ -0,0 +1,350 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QtConcurrent/QtConcurrent>
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QLockFile>
+#include <QtCore/QReadLocker>
+#include <QtCore/QSaveFile>
+#include <QtCore/QUuid>
+#include <QDebug>
+
+#include "BookManipulation/AutosaveJournal.h"
+#include "BookManipulation/Book.h"
+#include "BookManipulation/FolderKeeper.h"
+#include "Misc/TaskScheduler.h"
+#include "Misc/Utility.h"
+#include "ResourceObjects/OPFResource.h"
+#include "ResourceObjects/TextResource.h"
+
+#if 0
+#define DBG if(1)
+#else
+#define DBG if(0)
+#endif
+
+static const QString JOURNAL_FOLDER = "autosave";
+static const QString JOURNAL_SUFFIX = ".journal";
+static const QString LOCK_SUFFIX = ".lock";
+
+// "SGJ1"
+static const quint32 JOURNAL_MAGIC = 0x53474a31;
+static const quint32 JOURNAL_VERSION = 1;
+
+static const quint8 RECORD_EPUB_PATH = 1;
+static const quint8 RECORD_TEXT = 2;
+
+// How often the changed files are journaled
+static const int WRITE_INTERVAL_MS = 60 * 1000;
+
+// How many writes are appended before the journal is rewritten
+static const int WRITES_PER_CHECKPOINT = 10;
+
+AutosaveJournal::AutosaveJournal(QObject *parent)
+    :
+    QObject(parent),
+    m_Lock(NULL),
+    m_WritesSinceCheckpoint(0),
+    m_Watcher(new QFutureWatcher<void>(this))
+{
+    QString base = JournalFolder() + "/" + QUuid::createUuid().toString(QUuid::WithoutBraces);
+    QDir().mkpath(JournalFolder());
+    m_JournalPath = base + JOURNAL_SUFFIX;
+    m_Lock = new QLockFile(base + LOCK_SUFFIX);
+    // the lock is only taken by another session if this one dies
+    m_Lock->setStaleLockTime(0);
+    if (!m_Lock->tryLock(0)) {
+        qDebug() << "AutosaveJournal could not lock" << m_JournalPath;
+    }
+
+    m_Timer.setInterval(WRITE_INTERVAL_MS);
+    connect(&m_Timer, SIGNAL(timeout()), this, SLOT(WriteChanges()));
+}
+
+
+AutosaveJournal::~AutosaveJournal()
+{
+    m_Timer.stop();
+    WaitForWrite();
+    delete m_Lock;
+}
+
+
+void AutosaveJournal::SetBook(QSharedPointer<Book> book)
+{
+    WaitForWrite();
+    QFile::remove(m_JournalPath);
+    m_Book = book;
+    m_WritesSinceCheckpoint = 0;
+    TakeRevisions();
+    m_Timer.start();
+}
+
+
+void AutosaveJournal::SetEpubPath(const QString &epub_path)
+{
+    m_EpubPath = epub_path;
+}
+
+
+void AutosaveJournal::BookSaved()
+{
+    WaitForWrite();
+    QFile::remove(m_JournalPath);
+    m_WritesSinceCheckpoint = 0;
+    TakeRevisions();
+}
+
+
+void AutosaveJournal::Discard()
+{
+    m_Timer.stop();
+    WaitForWrite();
+    QFile::remove(m_JournalPath);
+    m_Book.clear();
+    m_Revisions.clear();
+}
+
+
+void AutosaveJournal::WriteChanges()
+{
+    // a slow disk should not have writes queue up behind each other
+    if (!m_Book || m_Watcher->isRunning()) {
+        return;
+    }
+
+    QList<Record> records;
+    bool has_opf = false;
+    OPFResource *opf = m_Book->GetOPF();
+    QList<TextResource *> text_resources = m_Book->GetFolderKeeper()->GetResourceTypeList<TextResource>();
+    foreach(TextResource *text_resource, text_resources) {
+        QString bookpath = text_resource->GetRelativePath();
+        quint64 revision = text_resource->GetRevision();
+        if (m_Revisions.contains(bookpath) && (m_Revisions.value(bookpath) == revision)) {
+            continue;
+        }
+        records << MakeRecord(text_resource);
+        m_Revisions.insert(bookpath, revision);
+        has_opf = has_opf || (text_resource == opf);
+    }
+
+    if (records.isEmpty()) {
+        return;
+    }
+
+    // Checkpoints always carry the OPF so the journal has the manifest
+    // that goes with the files in it
+    bool checkpoint = m_WritesSinceCheckpoint + 1 >= WRITES_PER_CHECKPOINT;
+    if (checkpoint && opf && !has_opf) {
+        records << MakeRecord(opf);
+    }
+
+    m_WritesSinceCheckpoint = checkpoint ? 0 : m_WritesSinceCheckpoint + 1;
+    DBG qDebug() << "AutosaveJournal writing" << records.count() << "files" << (checkpoint ? "checkpoint" : "");
+    m_Watcher->setFuture(TaskScheduler::Run(TaskScheduler::BackgroundLane, WriteRecords, m_JournalPath, m_EpubPath, records, checkpoint));
+}
+
+
+AutosaveJournal::Record AutosaveJournal::MakeRecord(TextResource *text_resource)
+{
+    Record record;
+    record.bookpath = text_resource->GetRelativePath();
+    record.revision = text_resource->GetRevision();
+    QReadLocker locker(&text_resource->GetLock());
+    record.text = text_resource->GetText();
+    return record;
+}
+
+
+void AutosaveJournal::TakeRevisions()
+{
+    m_Revisions.clear();
+    if (!m_Book) {
+        return;
+    }
+    QList<TextResource *> text_resources = m_Book->GetFolderKeeper()->GetResourceTypeList<TextResource>();
+    foreach(TextResource *text_resource, text_resources) {
+        m_Revisions.insert(text_resource->GetRelativePath(), text_resource->GetRevision());
+    }
+}
+
+
+void AutosaveJournal::WaitForWrite()
+{
+    m_Watcher->waitForFinished();
+}
+
+
+// Runs in a worker thread.
+void AutosaveJournal::WriteRecords(const QString &journal_path, const QString &epub_path,
+                                   const QList<Record> &records, bool checkpoint)
+{
+    Contents contents;
+    if (checkpoint) {
+        Read(journal_path, contents);
+    }
+    foreach(const Record &record, records) {
+        Entry entry;
+        entry.revision = record.revision;
+        entry.text = record.text;
+        contents.entries.insert(record.bookpath, entry);
+    }
+
+    // A checkpoint replaces the journal, otherwise the records are
+    // appended to it
+    QSaveFile save_file(journal_path);
+    QFile append_file(journal_path);
+    QIODevice *device = NULL;
+    if (checkpoint) {
+        if (save_file.open(QIODevice::WriteOnly)) {
+            device = &save_file;
+        }
+    } else if (append_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        device = &append_file;
+    }
+    if (!device) {
+        qDebug() << "AutosaveJournal could not write" << journal_path;
+        return;
+    }
+
+    QDataStream out(device);
+    out.setVersion(QDataStream::Qt_6_0);
+    if (device->pos() == 0) {
+        out << JOURNAL_MAGIC << JOURNAL_VERSION;
+    }
+    out << RECORD_EPUB_PATH << epub_path;
+    QHashIterator<QString, Entry> it(contents.entries);
+    while (it.hasNext()) {
+        it.next();
+        out << RECORD_TEXT << it.key() << it.value().revision << qCompress(it.value().text.toUtf8());
+    }
+
+    if (checkpoint) {
+        save_file.commit();
+    } else {
+        append_file.flush();
+    }
+}
+
+
+QStringList AutosaveJournal::OrphanedJournals()
+{
+    QStringList journals;
+    QDir folder(JournalFolder());
+    foreach(const QString &name, folder.entryList(QStringList() << "*" + JOURNAL_SUFFIX, QDir::Files, QDir::Time)) {
+        QString path = folder.absoluteFilePath(name);
+        QString base = path.left(path.length() - JOURNAL_SUFFIX.length());
+        QLockFile lock(base + LOCK_SUFFIX);
+        lock.setStaleLockTime(0);
+        // a lock held by a process that is no longer running is taken over
+        if (lock.tryLock(0)) {
+            journals << path;
+            lock.unlock();
+        }
+    }
+    return journals;
+}
+
+
+bool AutosaveJournal::Read(const QString &journal_path, Contents &contents)
+{
+    QFile file(journal_path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if ((magic != JOURNAL_MAGIC) || (version != JOURNAL_VERSION)) {
+        return false;
+    }
+
+    // Later records replace earlier ones for the same file.  A crash
+    // part way through a write leaves a last record that is cut short.
+    while (!in.atEnd()) {
+        in.startTransaction();
+        quint8 kind = 0;
+        in >> kind;
+        if (kind == RECORD_EPUB_PATH) {
+            QString epub_path;
+            in >> epub_path;
+            if (!in.commitTransaction()) {
+                break;
+            }
+            contents.epub_path = epub_path;
+        } else if (kind == RECORD_TEXT) {
+            QString bookpath;
+            Entry entry;
+            QByteArray data;
+            in >> bookpath >> entry.revision >> data;
+            if (!in.commitTransaction()) {
+                break;
+            }
+            entry.text = QString::fromUtf8(qUncompress(data));
+            contents.entries.insert(bookpath, entry);
+        } else {
+            break;
+        }
+    }
+    return true;
+}
+
+
+int AutosaveJournal::Replay(QSharedPointer<Book> book, const Contents &contents)
+{
+    int count = 0;
+    FolderKeeper *folder_keeper = book->GetFolderKeeper();
+    QHashIterator<QString, Entry> it(contents.entries);
+    while (it.hasNext()) {
+        it.next();
+        // files added since the book was last saved are not in it
+        TextResource *text_resource = qobject_cast<TextResource *>(folder_keeper->GetResourceByBookPathNoThrow(it.key()));
+        if (!text_resource) {
+            DBG qDebug() << "AutosaveJournal has no file for" << it.key();
+            continue;
+        }
+        text_resource->SetText(it.value().text);
+        text_resource->SaveToDisk(true);
+        count++;
+    }
+    if (count > 0) {
+        book->SetModified(true);
+    }
+    return count;
+}
+
+
+void AutosaveJournal::Remove(const QString &journal_path)
+{
+    QFile::remove(journal_path);
+    QString base = journal_path.left(journal_path.length() - JOURNAL_SUFFIX.length());
+    QFile::remove(base + LOCK_SUFFIX);
+}
+
+
+QString AutosaveJournal::JournalFolder()
+{
+    return Utility::DefinePrefsDir() + "/" + JOURNAL_FOLDER;
+}
@@ -0,0 +1,178 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+
+#pragma once
+#ifndef AUTOSAVEJOURNAL_H
+#define AUTOSAVEJOURNAL_H
+
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QTimer>
+
+class Book;
+class QLockFile;
+class TextResource;
+
+/**
+ * Keeps a journal of the text files edited since the book was last
+ * saved so that the edits can be recovered if Sigil does not close
+ * normally.
+ *
+ * Every so often the text of each file whose revision has changed since
+ * it was last journaled is appended to the journal, compressed, by a
+ * worker thread.  Every few writes the journal is rewritten with only
+ * the latest text of each file, along with the OPF.  The journal is
+ * emptied when the book is saved and removed when the window closes.
+ *
+ * Each running journal holds a lock file, so any journal whose lock is
+ * free at start up was left behind by a session that did not end.
+ */
+class AutosaveJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    struct Entry {
+        quint64 revision = 0;
+        QString text;
+    };
+
+    /**
+     * What a journal holds, the latest text of each file by book path.
+     */
+    struct Contents {
+        QString epub_path;
+        QHash<QString, Entry> entries;
+    };
+
+    AutosaveJournal(QObject *parent = NULL);
+    ~AutosaveJournal();
+
+    /**
+     * Starts journaling the edits made to a book from now on.
+     */
+    void SetBook(QSharedPointer<Book> book);
+
+    /**
+     * The file the book is saved to, empty for a new book.
+     */
+    void SetEpubPath(const QString &epub_path);
+
+    /**
+     * Everything journaled so far has been saved to the epub.
+     */
+    void BookSaved();
+
+    /**
+     * Removes the journal, the book is closing normally.
+     */
+    void Discard();
+
+    /**
+     * Journals left behind by sessions that did not end normally.
+     */
+    static QStringList OrphanedJournals();
+
+    /**
+     * Reads a journal, stopping at the first record that was not
+     * completely written.
+     *
+     * @return False if the file is not a journal.
+     */
+    static bool Read(const QString &journal_path, Contents &contents);
+
+    /**
+     * Sets the text of each file in the book that the journal has.
+     *
+     * @return The number of files recovered.
+     */
+    static int Replay(QSharedPointer<Book> book, const Contents &contents);
+
+    static void Remove(const QString &journal_path);
+
+private slots:
+
+    /**
+     * Hands the text of the files changed since the last write to a
+     * worker thread to append to the journal.
+     */
+    void WriteChanges();
+
+private:
+
+    struct Record {
+        QString bookpath;
+        quint64 revision;
+        QString text;
+    };
+
+    static Record MakeRecord(TextResource *text_resource);
+
+    /**
+     * Remembers the current revision of every text file as journaled.
+     */
+    void TakeRevisions();
+
+    void WaitForWrite();
+
+    // Runs in a worker thread.
+    static void WriteRecords(const QString &journal_path, const QString &epub_path,
+                             const QList<Record> &records, bool checkpoint);
+
+    static QString JournalFolder();
+
+
+    ///////////////////////////////
+    // PRIVATE MEMBER VARIABLES
+    ///////////////////////////////
+
+    QSharedPointer<Book> m_Book;
+
+    QString m_EpubPath;
+
+    QString m_JournalPath;
+
+    QLockFile *m_Lock;
+
+    /**
+     * The revision of each text file when it was last journaled, or
+     * when the book was last loaded or saved.
+     */
+    QHash<QString, quint64> m_Revisions;
+
+    /**
+     * Writes since the journal was last rewritten.
+     */
+    int m_WritesSinceCheckpoint;
+
+    QFutureWatcher<void> *m_Watcher;
+
+    QTimer m_Timer;
+};
+
+#endif // AUTOSAVEJOURNAL_H
@@ -21,6 +21,7 @@
 *************************************************************************/
 
 #include <QtCore>
+#include <QCryptographicHash>
 #include <QFileInfo>
 #include <QFutureSynchronizer>
 #include <QtConcurrent/QtConcurrent>
@@ -30,6 +31,9 @@
 #include "BookManipulation/Book.h"
 #include "BookManipulation/CleanSource.h"
 #include "BookManipulation/FolderKeeper.h"
+#include "BookManipulation/FragmentIndex.h"
+#include "BookManipulation/ReferenceIndex.h"
+#include "BookManipulation/ReportCache.h"
 #include "Parsers/GumboInterface.h"
 #include "Parsers/CSSToolbox.h"
 #include "Misc/TempFolder.h"
@@ -37,7 +41,9 @@
 #include "Misc/HTMLSpellCheck.h"
 #include "Misc/HTMLSpellCheckML.h"
 #include "Misc/Landmarks.h"
+#include "Misc/SpellCheck.h"
 #include "ResourceObjects/HTMLResource.h"
+#include "ResourceObjects/ImageResource.h"
 #include "ResourceObjects/NCXResource.h"
 #include "ResourceObjects/OPFResource.h"
 #include "ResourceObjects/MiscTextResource.h"
@@ -45,12 +51,17 @@
 #include "SourceUpdates/AnchorUpdates.h"
 #include "SourceUpdates/PerformHTMLUpdates.h"
 #include "SourceUpdates/UniversalUpdates.h"
+#include "Misc/SettingsSnapshot.h"
 #include "Misc/SettingsStore.h"
+#include "Misc/Trace.h"
 
 static const QString FIRST_CSS_NAME   = "Style0001.css";
 static const QString FIRST_JS_NAME    = "Script0001.js";
 static const QString FIRST_SVG_NAME   = "Image0001.svg";
 static const QString PLACEHOLDER_TEXT = "PLACEHOLDER";
+
+// How much html a merge has its workers extract bodies from at once
+static const qint64 MERGE_BATCH_SIZE = 16 * 1024 * 1024;
 static const QString EMPTY_HTML_FILE  = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
                                         "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.1//EN\"\n"
                                         "  \"http://www.w3.org/TR/xhtml11/DTD/xhtml11.dtd\">\n\n"
@@ -602,6 +613,15 @@ HTMLResource *Book::CreateSectionBreakOriginalResource(const QString &content, H
 
 void Book::CreateNewSections(const QStringList &new_sections, HTMLResource *original_resource)
 {
+    CreateNewSections(new_sections, original_resource, QList<QStringList>());
+}
+
+
+void Book::CreateNewSections(const QStringList &new_sections, HTMLResource *original_resource,
+                             const QList<QStringList> &section_ids)
+{
+    TRACE_OPERATION(operation, "Book::CreateNewSections", tr("Split"));
+    operation.AddArg("sections", new_sections.count());
     const QString originating_bookpath = original_resource->GetRelativePath();
     int original_position = GetOPF()->GetReadingOrder(original_resource);
     Q_ASSERT(original_position >= 0);
@@ -675,16 +695,31 @@ void Book::CreateNewSections(const QStringList &new_sections, HTMLResource *orig
         }
     }
 
+    // The ids found while splitting save parsing every new file again to find out where they went
+    QHash<QString, QString> ID_locations;
+    if (section_ids.count() == new_files.count()) {
+        for (int i = 0; i < new_files.count(); ++i) {
+            const QString bookpath = new_files.at(i)->GetRelativePath();
+            foreach(const QString &id, section_ids.at(i)) {
+                ID_locations[id] = bookpath;
+            }
+        }
+    } else {
+        ID_locations = AnchorUpdates::GetIDLocations(new_files);
+    }
     // Update anchor references between fragment ids in the new files. Since these all came from one single
     // file it's safe to assume that the fragment ids are all unique (since otherwise the references would be broken).
-    AnchorUpdates::UpdateAllAnchorsWithIDs(new_files);
+    AnchorUpdates::UpdateAllAnchorsWithIDs(new_files, ID_locations);
     // Now, update references to the original file that are made in other files.
     // We can't assume that ids are unique in this case, and so need to use a different mechanism.
-    AnchorUpdates::UpdateExternalAnchors(other_files, original_resource->GetRelativePath(), new_files);
+    // Only the files that link to the original file can have anything to update.
+    other_files = m_Mainfolder->GetReferenceIndex()->GetFilesAffectedBy(other_files, QStringList() << originating_bookpath);
+    operation.AddArg("referring_files", other_files.count());
+    AnchorUpdates::UpdateExternalAnchors(other_files, originating_bookpath, ID_locations);
     // Update TOC entries as well if an NCX exists, they are optional on epub3
     NCXResource * ncx_resource = GetNCX();
     if (ncx_resource) {
-        AnchorUpdates::UpdateTOCEntries(ncx_resource, originating_bookpath, new_files);
+        AnchorUpdates::UpdateTOCEntries(ncx_resource, originating_bookpath, ID_locations);
     }
     GetOPF()->UpdateSpineOrder(html_resources);
     SetModified(true);
@@ -693,9 +728,7 @@ void Book::CreateNewSections(const QStringList &new_sections, HTMLResource *orig
 
 bool Book::IsDataWellFormed(HTMLResource *html_resource)
 {
-    XhtmlDoc::WellFormedError error = XhtmlDoc::WellFormedErrorForSource(html_resource->GetText(), 
-                                                                         html_resource->GetEpubVersion());
-    return error.line == -1;
+    return html_resource->FileIsWellFormed();
 }
 
 
@@ -710,12 +743,30 @@ bool Book::IsDataOnDiskWellFormed(HTMLResource *html_resource)
 bool Book::RenameClassInHTML(const QString css_bookpath, const QString oldname, const QString newname)
 {
     const QList<HTMLResource *> html_resources = m_Mainfolder->GetResourceTypeList<HTMLResource>(false);
-    QFuture< bool > rfuture;
-    rfuture = QtConcurrent::mapped(html_resources, std::bind(Book::RenameClassInHTMLFileMapped,
+
+    // The classes and stylesheet links of each file are cached until its
+    // text changes so finding the few files that use the class is cheap.
+    // Only those are parsed and rewritten.
+    QFuture< bool > ufuture;
+    ufuture = QtConcurrent::mapped(html_resources, std::bind(Book::ClassUsedInHTMLFileMapped,
                                                              std::placeholders::_1,
                                                              css_bookpath,
-                                                             oldname,
-                                                             newname));
+                                                             oldname));
+    QList<HTMLResource *> using_resources;
+    for (int i = 0; i < ufuture.results().count(); i++) {
+        if (ufuture.resultAt(i)) {
+            using_resources.append(html_resources.at(i));
+        }
+    }
+    if (using_resources.isEmpty()) {
+        return true;
+    }
+
+    QFuture< bool > rfuture;
+    rfuture = QtConcurrent::mapped(using_resources, std::bind(Book::RenameClassInHTMLFileMapped,
+                                                              std::placeholders::_1,
+                                                              oldname,
+                                                              newname));
     bool result = true;
     for (int i = 0; i < rfuture.results().count(); i++) {
         result = result && rfuture.resultAt(i);
@@ -724,20 +775,34 @@ bool Book::RenameClassInHTML(const QString css_bookpath, const QString oldname,
 }
 
 
+bool Book::ClassUsedInHTMLFileMapped(HTMLResource* html_resource,
+                                     const QString css_bookpath,
+                                     const QString classname)
+{
+    if (!html_resource->GetLinkedStylesheets().contains(css_bookpath)) {
+        return false;
+    }
+    // list of element_name.class_name
+    const QStringList classes_in_file = html_resource->GetParsedFact(HTMLResource::Fact_Classes);
+    foreach(const QString &element_class, classes_in_file) {
+        if (element_class.mid(element_class.indexOf('.') + 1) == classname) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
 bool Book::RenameClassInHTMLFileMapped(HTMLResource* html_resource,
-                                       const QString css_bookpath,
                                        const QString oldname,
                                        const QString newname)
 {
-    QStringList linked_stylesheets = html_resource->GetLinkedStylesheets();
+    QWriteLocker locker(&html_resource->GetLock());
     QString xhtmltext = html_resource->GetText();
-    if (linked_stylesheets.contains(css_bookpath)) {
-        QWriteLocker locker(&html_resource->GetLock());
-        CSSToolbox tb;
-        QString newtext = tb.rename_class_in_text(oldname, newname, xhtmltext);
-        if (xhtmltext != newtext) {
-            html_resource->SetText(newtext);
-        }
+    CSSToolbox tb;
+    QString newtext = tb.rename_class_in_text(oldname, newname, xhtmltext);
+    if (xhtmltext != newtext) {
+        html_resource->SetText(newtext);
     }
     return true;
 }
@@ -757,11 +822,79 @@ void Book::ReformatAllHTML(bool to_valid)
 }
 
 
+QStringList Book::ReformatAllStylesheets(CSSInfo::CSSFormat format, bool include_style_blocks)
+{
+    QList<Resource *> resources = m_Mainfolder->GetResourceTypeAsGenericList<CSSResource>(true);
+    if (include_style_blocks) {
+        resources.append(m_Mainfolder->GetResourceTypeAsGenericList<HTMLResource>(true));
+    }
+
+    QFuture<std::tuple<QString, bool>> future = QtConcurrent::mapped(resources,
+                                                                     std::bind(ReformatCSSInResourceMapped,
+                                                                               std::placeholders::_1,
+                                                                               format));
+    future.waitForFinished();
+
+    // Every text is set on the GUI thread once all of them are done
+    QStringList parse_errors;
+    bool book_modified = false;
+    for (int i = 0; i < resources.count(); i++) {
+        QString new_text;
+        bool has_errors;
+        std::tie(new_text, has_errors) = future.resultAt(i);
+        if (has_errors) {
+            parse_errors << resources.at(i)->GetRelativePath();
+        }
+        if (!new_text.isNull()) {
+            TextResource *text_resource = qobject_cast<TextResource *>(resources.at(i));
+            text_resource->SetText(new_text);
+            book_modified = true;
+        }
+    }
+    if (book_modified) {
+        SetModified();
+    }
+    return parse_errors;
+}
+
+
+// Returns a null string when the text is unchanged
+std::tuple<QString, bool> Book::ReformatCSSInResourceMapped(Resource *resource, CSSInfo::CSSFormat format)
+{
+    QString text;
+    QString new_text;
+    CSSResource *css_resource = qobject_cast<CSSResource *>(resource);
+    if (css_resource) {
+        QSharedPointer<const CSSInfo> cp = css_resource->GetCSSInfo();
+        if (cp->hasParseErrors()) {
+            return std::make_tuple(QString(), true);
+        }
+        text = css_resource->GetText();
+        new_text = cp->getSerializedCSSText(format);
+    }
+    HTMLResource *html_resource = qobject_cast<HTMLResource *>(resource);
+    if (html_resource) {
+        QSharedPointer<const HTMLStyleInfo> hp = html_resource->GetStyleInfo();
+        if (!hp->hasStyles()) {
+            return std::make_tuple(QString(), false);
+        }
+        if (hp->hasParseErrors()) {
+            return std::make_tuple(QString(), true);
+        }
+        text = html_resource->GetText();
+        new_text = hp->getSerializedCSSText(format);
+    }
+    if (new_text == text) {
+        return std::make_tuple(QString(), false);
+    }
+    return std::make_tuple(new_text, false);
+}
+
+
 Resource *Book::PreviousResource(Resource *resource)
 {
     QList<HTMLResource *> html_resources = m_Mainfolder->GetResourceTypeList<HTMLResource>(true);
-    HTMLResource *html_resource = qobject_cast<HTMLResource *>(resource);
-    int previous_file_reading_order = html_resources.indexOf(html_resource) - 1;
+    int previous_file_reading_order = m_Mainfolder->GetSortedHTMLPosition(resource) - 1;
 
     if (previous_file_reading_order < 0) {
         previous_file_reading_order = 0;
@@ -775,12 +908,15 @@ QHash <QString, QList<XhtmlDoc::XMLElement>> Book::GetLinkElements()
 {
     QHash<QString, QList<XhtmlDoc::XMLElement>> links_in_html;
     const QList<HTMLResource *> html_resources = m_Mainfolder->GetResourceTypeList<HTMLResource>(false);
-    QFuture<std::tuple<QString, QList<XhtmlDoc::XMLElement>>> future = QtConcurrent::mapped(html_resources, GetLinkElementsInHTMLFileMapped);
+    const QList<std::tuple<QString, QList<XhtmlDoc::XMLElement>>> results =
+        m_Mainfolder->GetReportCache()->Map<std::tuple<QString, QList<XhtmlDoc::XMLElement>>>(ReportCache::Report_LinkElements,
+                                                                                         html_resources, 0,
+                                                                                         GetLinkElementsInHTMLFileMapped);
 
-    for (int i = 0; i < future.results().count(); i++) {
+    for (int i = 0; i < results.count(); i++) {
         QString bookpath;
         QList<XhtmlDoc::XMLElement> links;
-        std::tie(bookpath, links) = future.resultAt(i);
+        std::tie(bookpath, links) = results.at(i);
         // Each target entry has a list of filenames that contain it
         links_in_html[bookpath] = links;
     }
@@ -815,7 +951,7 @@ std::tuple<QString, QStringList> Book::GetStyleUrlsInHTMLFileMapped(HTMLResource
     QString html_bookpath = html_resource->GetRelativePath();
     QString startdir = html_resource->GetFolder();
     // we need to convert this hreflist to bookpaths if possible
-    QStringList urllist = XhtmlDoc::GetAllDescendantStyleUrls(html_resource->GetText());
+    QStringList urllist = html_resource->GetParsedFact(HTMLResource::Fact_StyleUrls);
     QStringList bookpaths;
     QRegularExpression url_file_search("url\\s*\\(\\s*['\"]?([^\\(\\)'\"]*)[\"']?\\)");
     foreach (QString url, urllist) {
@@ -832,30 +968,14 @@ std::tuple<QString, QStringList> Book::GetStyleUrlsInHTMLFileMapped(HTMLResource
 
 QHash<QString, QStringList> Book::GetIdsInHTMLFiles()
 {
-    QHash<QString, QStringList> ids_in_html;
+    // The fragment index only reads again the files edited since it was last asked
     const QList<HTMLResource *> html_resources = m_Mainfolder->GetResourceTypeList<HTMLResource>(false);
-    QFuture<std::tuple<QString, QStringList>> future = QtConcurrent::mapped(html_resources, GetIdsInHTMLFileMapped);
-
-    for (int i = 0; i < future.results().count(); i++) {
-        QString bookpath;
-        QStringList ids;
-        std::tie(bookpath, ids) = future.resultAt(i);
-        // Each target entry has a list of filenames that contain it
-        ids_in_html[bookpath] = ids;
-    }
-
-    return ids_in_html;
-}
-
-std::tuple<QString, QStringList> Book::GetIdsInHTMLFileMapped(HTMLResource *html_resource)
-{
-    return std::make_tuple(html_resource->GetRelativePath(),
-                           XhtmlDoc::GetAllDescendantIDs(html_resource->GetText()));
+    return m_Mainfolder->GetFragmentIndex()->GetIdLists(html_resources);
 }
 
 QStringList Book::GetIdsInHTMLFile(HTMLResource *html_resource)
 {
-    return XhtmlDoc::GetAllDescendantIDs(html_resource->GetText());
+    return html_resource->GetParsedFact(HTMLResource::Fact_Ids);
 }
 
 
@@ -903,12 +1023,12 @@ QHash<QString, QStringList> Book::GetHrefsInHTMLFiles()
 std::tuple<QString, QStringList> Book::GetHrefsInHTMLFileMapped(HTMLResource *html_resource)
 {
     return std::make_tuple(html_resource->GetRelativePath(),
-                           XhtmlDoc::GetAllDescendantHrefs(html_resource->GetText()));
+                           html_resource->GetParsedFact(HTMLResource::Fact_Hrefs));
 }
 
 QStringList Book::GetClassesInHTMLFile(HTMLResource *html_resource)
 {
-    return XhtmlDoc::GetAllDescendantClasses(html_resource->GetText());
+    return html_resource->GetParsedFact(HTMLResource::Fact_Classes);
 }
 
 QHash<QString, QStringList> Book::GetImagesInHTMLFiles()
@@ -930,11 +1050,18 @@ QHash< QString, std::pair<int,int> > Book::GetSpellWordCountsInHTMLFiles()
 {
     QHash< QString, std::pair<int,int> > words_in_html;
     const QList<HTMLResource *> html_resources = m_Mainfolder->GetResourceTypeList<HTMLResource>(false);
-    QFuture<std::tuple<QString, std::pair<int,int> > > future = QtConcurrent::mapped(html_resources, GetWordCountsInHTMLFileMapped);
-    for (int i = 0; i < future.results().count(); i++) {
+    // The misspelled word counts also depend on the dictionaries and
+    // on whether numbers are checked
+    quint64 context = (SpellCheck::instance()->generation() << 1) |
+                      (SettingsSnapshot::instance()->Current()->spellcheck_numbers ? 1 : 0);
+    const QList<std::tuple<QString, std::pair<int,int> > > results =
+        m_Mainfolder->GetReportCache()->Map<std::tuple<QString, std::pair<int,int> > >(ReportCache::Report_WordCounts,
+                                                                                      html_resources, context,
+                                                                                      GetWordCountsInHTMLFileMapped);
+    for (int i = 0; i < results.count(); i++) {
         QString bookpath;
         std::pair<int, int> word_counts;
-        std::tie(bookpath, word_counts) = future.resultAt(i);
+        std::tie(bookpath, word_counts) = results.at(i);
         words_in_html[bookpath] = word_counts;
     }
     return words_in_html;
@@ -951,6 +1078,154 @@ std::tuple<QString, std::pair<int,int> > Book::GetWordCountsInHTMLFileMapped(HTM
 }
 
 
+// The distinct code points seen in some text.  There is a bit for every
+// BMP code point, so adding one is a single or, and the rest are rare
+// enough to keep in a set.
+class CharacterBits
+{
+public:
+    void add(uint c)
+    {
+        if (c < 0x10000) {
+            m_Bmp[c >> 6] |= Q_UINT64_C(1) << (c & 63);
+        } else {
+            m_Astral.insert(c);
+        }
+    }
+
+    // Gumbo text is always well formed utf-8, anything else becomes U+FFFD
+    // as QString::fromUtf8 would make it
+    void addUtf8(const char *text)
+    {
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(text);
+        const size_t len = strlen(text);
+        size_t i = 0;
+        while (i < len) {
+            // most text is plain ascii, so check eight bytes at a time
+            if (i + 8 <= len) {
+                quint64 word;
+                memcpy(&word, p + i, 8);
+                if ((word & Q_UINT64_C(0x8080808080808080)) == 0) {
+                    for (int k = 0; k < 8; k++) {
+                        m_Bmp[p[i + k] >> 6] |= Q_UINT64_C(1) << (p[i + k] & 63);
+                    }
+                    i += 8;
+                    continue;
+                }
+            }
+            unsigned char c = p[i];
+            if (c < 0x80) {
+                m_Bmp[c >> 6] |= Q_UINT64_C(1) << (c & 63);
+                i++;
+                continue;
+            }
+            uint cp;
+            size_t extra;
+            if (c >= 0xF0 && c <= 0xF4) {
+                cp = c & 0x07;
+                extra = 3;
+            } else if (c >= 0xE0 && c < 0xF0) {
+                cp = c & 0x0F;
+                extra = 2;
+            } else if (c >= 0xC2 && c < 0xE0) {
+                cp = c & 0x1F;
+                extra = 1;
+            } else {
+                add(0xFFFD);
+                i++;
+                continue;
+            }
+            size_t k = 1;
+            for (; k <= extra && i + k < len && (p[i + k] & 0xC0) == 0x80; k++) {
+                cp = (cp << 6) | (p[i + k] & 0x3F);
+            }
+            if (k <= extra) {
+                add(0xFFFD);
+                i++;
+                continue;
+            }
+            add(cp);
+            i += extra + 1;
+        }
+    }
+
+    // in code point order
+    QList<uint> values() const
+    {
+        QList<uint> characters;
+        for (uint w = 0; w < BMP_WORDS; w++) {
+            quint64 bits = m_Bmp[w];
+            while (bits) {
+                int bit = qCountTrailingZeroBits(bits);
+                characters.append((w << 6) + bit);
+                bits &= bits - 1;
+            }
+        }
+        QList<uint> astral = m_Astral.values();
+        std::sort(astral.begin(), astral.end());
+        characters.append(astral);
+        return characters;
+    }
+
+private:
+    static const uint BMP_WORDS = 0x10000 / 64;
+    quint64 m_Bmp[BMP_WORDS] = {};
+    QSet<uint> m_Astral;
+};
+
+
+QList<uint> Book::GetCharactersInHTMLFiles()
+{
+    const QList<HTMLResource *> html_resources = m_Mainfolder->GetResourceTypeList<HTMLResource>(false);
+    const QList<QList<uint>> results =
+        m_Mainfolder->GetReportCache()->Map<QList<uint>>(ReportCache::Report_Characters,
+                                                         html_resources, 0,
+                                                         GetCharactersInHTMLFileMapped);
+    CharacterBits character_bits;
+    foreach(const QList<uint> &characters, results) {
+        foreach(uint c, characters) {
+            character_bits.add(c);
+        }
+    }
+    return character_bits.values();
+}
+
+
+QList<uint> Book::GetCharactersInHTMLFileMapped(HTMLResource *html_resource)
+{
+    QString replaced_html = html_resource->GetText();
+    replaced_html = replaced_html.replace("<html>", "<html xmlns=\"http://www.w3.org/1999/xhtml\">");
+    QString version = "any_version";
+    GumboInterface gi = GumboInterface(replaced_html, version);
+    QList<GumboNode*> nodes = gi.get_all_nodes_with_tag(GUMBO_TAG_BODY);
+    if (nodes.count() != 1) {
+        return QList<uint>();
+    }
+    // Look at the text nodes in place rather than joining
+    // all of the body text into one string first
+    CharacterBits character_bits;
+    QList<GumboNode*> stack;
+    stack << nodes.at(0);
+    while (!stack.isEmpty()) {
+        GumboNode* node = stack.takeLast();
+        GumboVector* children = &node->v.element.children;
+        for (unsigned int i = 0; i < children->length; ++i) {
+            GumboNode* child = static_cast<GumboNode*>(children->data[i]);
+            if (child->type == GUMBO_NODE_TEXT || child->type == GUMBO_NODE_WHITESPACE ||
+                child->type == GUMBO_NODE_CDATA) {
+                character_bits.addUtf8(child->v.text.text);
+            } else if (child->type == GUMBO_NODE_ELEMENT && child->v.element.tag != GUMBO_TAG_BR) {
+                stack << child;
+            }
+        }
+    }
+    QList<uint> characters = character_bits.values();
+    // line breaks are not reported
+    characters.removeOne('\n');
+    return characters;
+}
+
+
 QHash<QString, QStringList> Book::GetVideoInHTMLFiles()
 {
     QHash<QString, QStringList> video_in_html;
@@ -1000,6 +1275,97 @@ QHash<QString, QStringList> Book::GetHTMLFilesUsingMedia()
     return html_files;
 }
 
+QList<QList<Resource *>> Book::GetDuplicateResources()
+{
+    // Only files of the same size can have the same contents
+    QHash<qint64, QList<Resource *>> same_sizes;
+    foreach(Resource *resource, m_Mainfolder->GetResourceList()) {
+        if (!qobject_cast<TextResource *>(resource)) {
+            same_sizes[QFileInfo(resource->GetFullPath()).size()].append(resource);
+        }
+    }
+    QList<Resource *> candidates;
+    foreach(const QList<Resource *> &resources, same_sizes) {
+        if (resources.count() > 1) {
+            candidates.append(resources);
+        }
+    }
+
+    QFuture<std::tuple<Resource *, QByteArray>> future = QtConcurrent::mapped(candidates, HashResourceMapped);
+    QHash<QByteArray, QList<Resource *>> same_contents;
+    for (int i = 0; i < future.results().count(); i++) {
+        Resource *resource;
+        QByteArray hash;
+        std::tie(resource, hash) = future.resultAt(i);
+        if (!hash.isEmpty()) {
+            same_contents[hash].append(resource);
+        }
+    }
+
+    QList<QList<Resource *>> groups;
+    foreach(QList<Resource *> resources, same_contents) {
+        if (resources.count() > 1) {
+            std::sort(resources.begin(), resources.end(), [](Resource *a, Resource *b) {
+                return a->GetRelativePath() < b->GetRelativePath();
+            });
+            groups.append(resources);
+        }
+    }
+    std::sort(groups.begin(), groups.end(), [](const QList<Resource *> &a, const QList<Resource *> &b) {
+        return a.first()->GetRelativePath() < b.first()->GetRelativePath();
+    });
+    return groups;
+}
+
+
+std::tuple<Resource *, QByteArray> Book::HashResourceMapped(Resource *resource)
+{
+    QByteArray hash;
+    QFile file(resource->GetFullPath());
+    if (file.open(QIODevice::ReadOnly)) {
+        QCryptographicHash hasher(QCryptographicHash::Sha1);
+        if (hasher.addData(&file)) {
+            hash = hasher.result();
+        }
+    }
+    return std::make_tuple(resource, hash);
+}
+
+
+QList<Resource *> Book::MergeDuplicateResources(const QList<QList<Resource *>> &groups)
+{
+    QHash<QString, QString> updates;
+    QList<Resource *> duplicates;
+    foreach(const QList<Resource *> &group, groups) {
+        Resource *kept = group.first();
+        foreach(Resource *resource, group) {
+            ImageResource *image_resource = qobject_cast<ImageResource *>(resource);
+            if (image_resource && GetOPF()->IsCoverImage(image_resource)) {
+                kept = resource;
+                break;
+            }
+        }
+        foreach(Resource *resource, group) {
+            if (resource != kept) {
+                updates[resource->GetRelativePath()] = kept->GetRelativePath();
+                duplicates.append(resource);
+            }
+        }
+    }
+    if (updates.isEmpty()) {
+        return duplicates;
+    }
+
+    // The manifest entries of the duplicates go when they are deleted,
+    // so the OPF is left alone rather than pointing two entries at one file
+    QList<Resource *> resources = m_Mainfolder->GetResourceList();
+    resources.removeOne(GetOPF());
+    UniversalUpdates::PerformUniversalUpdates(true, resources, updates, QList<XMLResource *>(), m_Mainfolder->GetReferenceIndex());
+    SetModified();
+    return duplicates;
+}
+
+
 QHash<QString, QStringList> Book::GetHTMLFilesUsingImages()
 {
     QHash<QString, QStringList> html_files;
@@ -1024,8 +1390,7 @@ std::tuple<QString, QStringList> Book::GetMediaInHTMLFileMapped(HTMLResource *ht
 {
     QString html_bookpath = html_resource->GetRelativePath();
     QString startdir = html_resource->GetFolder();
-    QStringList media_hrefs = XhtmlDoc::GetAllMediaPathsFromMediaChildren(html_resource->GetText(), 
-                                                                       GIMAGE_TAGS + GVIDEO_TAGS + GAUDIO_TAGS);
+    QStringList media_hrefs = html_resource->GetParsedFact(HTMLResource::Fact_MediaPaths);
     QStringList media_bookpaths;
     foreach(QString ahref, media_hrefs) {
         if (ahref.indexOf(":") == -1) {
@@ -1039,7 +1404,7 @@ std::tuple<QString, QStringList> Book::GetImagesInHTMLFileMapped(HTMLResource *h
 {
     QString html_bookpath = html_resource->GetRelativePath();
     QString startdir = html_resource->GetFolder();
-    QStringList image_hrefs = XhtmlDoc::GetAllMediaPathsFromMediaChildren(html_resource->GetText(), GIMAGE_TAGS);
+    QStringList image_hrefs = html_resource->GetParsedFact(HTMLResource::Fact_ImagePaths);
     QStringList image_bookpaths;
     foreach(QString ahref, image_hrefs) {
         if (ahref.indexOf(":") == -1) {
@@ -1053,7 +1418,7 @@ std::tuple<QString, QStringList> Book::GetVideoInHTMLFileMapped(HTMLResource *ht
 {
     QString html_bookpath = html_resource->GetRelativePath();
     QString startdir = html_resource->GetFolder();
-    QStringList video_hrefs = XhtmlDoc::GetAllMediaPathsFromMediaChildren(html_resource->GetText(), GVIDEO_TAGS);
+    QStringList video_hrefs = html_resource->GetParsedFact(HTMLResource::Fact_VideoPaths);
     QStringList video_bookpaths;
     foreach(QString ahref, video_hrefs) {
         if (ahref.indexOf(":") == -1) {
@@ -1067,7 +1432,7 @@ std::tuple<QString, QStringList> Book::GetAudioInHTMLFileMapped(HTMLResource *ht
 {
     QString html_bookpath = html_resource->GetRelativePath();
     QString startdir = html_resource->GetFolder();
-    QStringList audio_hrefs = XhtmlDoc::GetAllMediaPathsFromMediaChildren(html_resource->GetText(), GAUDIO_TAGS);
+    QStringList audio_hrefs = html_resource->GetParsedFact(HTMLResource::Fact_AudioPaths);
     QStringList audio_bookpaths;
     foreach(QString ahref, audio_hrefs) {
         if (ahref.indexOf(":") == -1) {
@@ -1102,12 +1467,11 @@ QList<HTMLResource *> Book::GetNonWellFormedHTMLFiles()
     return malformed_resources;
 }
 
+// The verdict is kept by the resource so unchanged files are not checked again
 std::pair<HTMLResource*, bool> Book::ResourceWellFormedMap(HTMLResource * html_resource) {
     std::pair<HTMLResource*, bool> res;
     res.first = html_resource;
-    XhtmlDoc::WellFormedError error = XhtmlDoc::WellFormedErrorForSource(html_resource->GetText(),
-                                                                         html_resource->GetEpubVersion());
-    res.second = (error.line == -1);
+    res.second = html_resource->FileIsWellFormed();
     return res;
 }
 
@@ -1142,24 +1506,55 @@ QHash<QString, int> Book::GetUniqueWordsInHTMLFiles()
     QString default_lang = GetConstOPF()->GetPrimaryBookLanguage();
     default_lang.replace('_','-');
 
-    QHash<QString, int> all_words;
+    // every file gets its own table of word counts
     const QList<HTMLResource *> html_resources = m_Mainfolder->GetResourceTypeList<HTMLResource>(false);
-    QFuture<QStringList> future = QtConcurrent::mapped(html_resources, std::bind(GetWordsInHTMLFileMapped,
-                                                                                 std::placeholders::_1,
-                                                                                 default_lang));
-
-    for (int i = 0; i < future.results().count(); i++) {
-        QStringList result = future.resultAt(i);
-        foreach (QString word, result) {
-            if (all_words.contains(word)) {
-                all_words[word]++;
-            } else {
-                all_words[word] = 1;
-            }
+    QList<QHash<QString, int>> tables =
+        QtConcurrent::blockingMapped<QList<QHash<QString, int>>>(html_resources, std::bind(CountWordsInHTMLFileMapped,
+                                                                                          std::placeholders::_1,
+                                                                                          default_lang));
+
+    // then the tables are merged two at a time, in parallel, until one is left
+    while (tables.count() > 1) {
+        QList<std::pair<QHash<QString, int>, QHash<QString, int>>> pairs;
+        for (int i = 0; i + 1 < tables.count(); i += 2) {
+            pairs << std::make_pair(std::move(tables[i]), std::move(tables[i + 1]));
+        }
+        QHash<QString, int> odd_one;
+        if (tables.count() % 2) {
+            odd_one = std::move(tables.last());
+        }
+        tables.clear();
+        QtConcurrent::blockingMap(pairs, MergeWordCountsMapped);
+        for (int i = 0; i < pairs.count(); i++) {
+            tables << std::move(pairs[i].first);
+        }
+        if (!odd_one.isEmpty()) {
+            tables << std::move(odd_one);
         }
     }
 
-    return all_words;
+    if (tables.isEmpty()) {
+        return QHash<QString, int>();
+    }
+    return tables.first();
+}
+
+QHash<QString, int> Book::CountWordsInHTMLFileMapped(HTMLResource *html_resource, const QString &default_lang)
+{
+    return HTMLSpellCheckML::CountWords(html_resource->GetText(), default_lang);
+}
+
+// merges the second table into the first, adding the smaller to the larger
+void Book::MergeWordCountsMapped(std::pair<QHash<QString, int>, QHash<QString, int>> &counts)
+{
+    if (counts.first.count() < counts.second.count()) {
+        counts.first.swap(counts.second);
+    }
+    QHash<QString, int>::const_iterator it = counts.second.constBegin();
+    for (; it != counts.second.constEnd(); ++it) {
+        counts.first[it.key()] += it.value();
+    }
+    counts.second.clear();
 }
 
 QHash<QString, QStringList> Book::GetStylesheetsInHTMLFiles()
@@ -1181,7 +1576,7 @@ std::tuple<QString, QStringList> Book::GetStylesheetsInHTMLFileMapped(HTMLResour
 {
     QString html_bookpath = html_resource->GetRelativePath();
     QString startdir = html_resource->GetFolder();
-    QStringList link_hrefs = XhtmlDoc::GetLinkedStylesheets(html_resource->GetText());
+    QStringList link_hrefs = html_resource->GetParsedFact(HTMLResource::Fact_LinkedStylesheets);
     QStringList link_bookpaths;
     foreach(QString ahref, link_hrefs) {
         if (ahref.indexOf(":") == -1) {
@@ -1195,7 +1590,7 @@ std::tuple<QString, QStringList> Book::GetStylesheetsInHTMLFileMapped(HTMLResour
 QStringList Book::GetStylesheetsInHTMLFile(HTMLResource *html_resource)
 {
     // convert encoded links relative to a html resource to their book paths
-    QStringList stylelinks = XhtmlDoc::GetLinkedStylesheets(html_resource->GetText());
+    QStringList stylelinks = html_resource->GetParsedFact(HTMLResource::Fact_LinkedStylesheets);
     QStringList results;
     QString html_folder = html_resource->GetFolder();
     foreach(QString stylelink, stylelinks) {
@@ -1208,7 +1603,7 @@ QStringList Book::GetStylesheetsInHTMLFile(HTMLResource *html_resource)
 }
 
 // employed to perform update of local merged links and to extract the updated body
-QPair<QString, QString> Book::UpdateAndExtractBodyInOneFile(Resource * resource, const QStringList & merged_bookpaths)
+QPair<QString, QString> Book::UpdateAndExtractBodyInOneFile(Resource * resource, const QSet<QString> & merged_bookpaths)
 {
     QPair<QString, QString> res;
     HTMLResource *htmlresource = qobject_cast<HTMLResource *>(resource);
@@ -1253,6 +1648,8 @@ QPair<QString, QString> Book::UpdateAndExtractBodyInOneFile(Resource * resource,
 // Reconcile all references to the files that were merged.
 Resource *Book::MergeResources(QList<Resource *> resources)
 {
+    TRACE_OPERATION(operation, "Book::MergeResources", tr("Merge"));
+    operation.AddArg("files", resources.count());
 
     // Make sure that the nav resource is not part of a merge
     Resource* nav_resource = GetConstOPF()->GetNavResource();
@@ -1263,14 +1660,18 @@ Resource *Book::MergeResources(QList<Resource *> resources)
     // nothing to merge
     if (resources.size() < 2) return NULL;
 
-    // First Create a set of Ids used in the files to be merged
-    QHash<QString,QStringList> BookPathIds = GetIdsInHTMLFiles();
+    // First Create a set of Ids used in the files to be merged, only
+    // they can clash with the section ids added to the merged file
     QSet<QString> UsedIds;
+    qint64 total_length = 0;
     foreach(Resource * resource, resources) {
-        QString bookpath = resource->GetRelativePath();
-        QStringList ids=BookPathIds.value(bookpath, QStringList());
-        foreach(QString id, ids) {
-            UsedIds.insert(id);
+        HTMLResource *html_resource = qobject_cast<HTMLResource *>(resource);
+        if (html_resource) {
+            foreach(QString id, GetIdsInHTMLFile(html_resource)) {
+                UsedIds.insert(id);
+            }
+            QReadLocker locker(&html_resource->GetLock());
+            total_length += html_resource->GetText().length();
         }
     }
 
@@ -1279,52 +1680,72 @@ Resource *Book::MergeResources(QList<Resource *> resources)
     foreach(Resource * resource, resources) {
         merged_bookpaths << resource->GetRelativePath();
     }
+    const QSet<QString> merged_bookpath_set(merged_bookpaths.begin(), merged_bookpaths.end());
 
     Resource *sink_resource = resources.at(0);
     QString version = sink_resource->GetEpubVersion(); 
     HTMLResource *sink_html_resource = qobject_cast<HTMLResource *>(sink_resource);
-    
-    const QList<QPair<QString, QString>> &bodies = QtConcurrent::blockingMapped(resources, 
-                                                       std::bind(UpdateAndExtractBodyInOneFile, std::placeholders::_1,
-                                                       merged_bookpaths));
-    // collect the outputs from the many threads
-    QHash<QString, QString> updated_bodies;
-    for (int i = 0; i < bodies.count(); ++i) {
-        QPair<QString, QString> body = bodies.at(i);
-        updated_bodies.insert(body.first, body.second);
-    }
 
-    QStringList new_bodies;
     QHash<QString,QString> section_id_map;
 
+    // The merged file can be no longer than all of the files together
+    // so one buffer sized for them never has to grow
+    QString new_source;
+    new_source.reserve(total_length + merged_bookpaths.count() * 64);
+
     // remove everything after the body tag in the sink resource
-    QString text = sink_html_resource->GetText();
-    QRegularExpression body_search(BODY_START, QRegularExpression::CaseInsensitiveOption);
-    QRegularExpressionMatch body_search_mo = body_search.match(text);
-    int body_tag_end   = body_search_mo.capturedStart() + body_search_mo.capturedLength();
-    new_bodies << Utility::Substring(0, body_tag_end, text);
-
-    // build up the new merged file and set it into the sink resource
-    int i = 0;
-    foreach(QString bookpath, merged_bookpaths) {
-        // inject anchor tag to start each merged section and record it after the sink resource
-        if (i == 0) {
-            new_bodies.append(updated_bodies[bookpath]);
-        } else {
-            QString section_id = Utility::GenerateUniqueId("section", UsedIds);
-            UsedIds.insert(section_id);
-            if (version.startsWith("3")) {
-                new_bodies.append("  <a id=\"" + section_id + "\"></a>\n" + updated_bodies[bookpath]);
-            } else {
-                new_bodies.append("  <p id=\"" + section_id + "\" style=\"display:none\"></p>\n" + updated_bodies[bookpath]);
+    {
+        QReadLocker locker(&sink_html_resource->GetLock());
+        QString text = sink_html_resource->GetText();
+        QRegularExpression body_search(BODY_START, QRegularExpression::CaseInsensitiveOption);
+        QRegularExpressionMatch body_search_mo = body_search.match(text);
+        int body_tag_end   = body_search_mo.capturedStart() + body_search_mo.capturedLength();
+        new_source.append(QStringView(text).left(body_tag_end));
+    }
+
+    // Workers extract the bodies of a batch of files, with their links
+    // into the merged set made local, while this thread appends each one
+    // in order as soon as it and those before it are done.  The bodies
+    // go with their batch's future, so only one batch of them is ever
+    // held besides the output.
+    int next = 0;
+    while (next < resources.count()) {
+        QList<Resource *> batch;
+        qint64 batch_size = 0;
+        while ((next < resources.count()) && (batch.isEmpty() || (batch_size < MERGE_BATCH_SIZE))) {
+            HTMLResource *html_resource = qobject_cast<HTMLResource *>(resources.at(next));
+            if (html_resource) {
+                QReadLocker locker(&html_resource->GetLock());
+                batch_size += html_resource->GetText().length() * sizeof(QChar);
+            }
+            batch << resources.at(next++);
+        }
+        QFuture<QPair<QString, QString>> bodies = QtConcurrent::mapped(batch,
+                                                      std::bind(UpdateAndExtractBodyInOneFile, std::placeholders::_1,
+                                                      merged_bookpath_set));
+        int first = next - batch.count();
+        for (int i = 0; i < batch.count(); ++i) {
+            QString bookpath = merged_bookpaths.at(first + i);
+            // inject anchor tag to start each merged section and record it after the sink resource
+            if (first + i > 0) {
+                QString section_id = Utility::GenerateUniqueId("section", UsedIds);
+                UsedIds.insert(section_id);
+                if (version.startsWith("3")) {
+                    new_source.append("  <a id=\"" + section_id + "\"></a>\n");
+                } else {
+                    new_source.append("  <p id=\"" + section_id + "\" style=\"display:none\"></p>\n");
+                }
+                section_id_map[bookpath] = section_id;
             }
-            section_id_map[bookpath] = section_id;
+            new_source.append(bodies.resultAt(i).second);
         }
-        i++;
     }
-    new_bodies.append("</body>\n</html>");
-    QString new_source = new_bodies.join("");
-    sink_html_resource->SetText(new_source);
+    new_source.append("</body>\n</html>");
+
+    {
+        QWriteLocker locker(&sink_html_resource->GetLock());
+        sink_html_resource->SetText(new_source);
+    }
 
     // Anchor Updates should handle updating all links in the nav properly
     // But if this is an epub2, then we must update the guide entries as well
@@ -1366,6 +1787,8 @@ QList <Resource *> Book::GetAllResources()
 void Book::SaveAllResourcesToDisk()
 {
     QList<Resource *> resources = m_Mainfolder->GetResourceList();
+    // everything that reads the whole book folder comes through here
+    m_Mainfolder->WaitForDeferredFiles();
     m_Mainfolder->SuspendWatchingResources();
     QtConcurrent::blockingMap(resources, SaveOneResourceToDisk);
     m_Mainfolder->ResumeWatchingResources();
@@ -1378,6 +1801,18 @@ bool Book::IsModified() const
 }
 
 
+QString Book::GetSaveCompression() const
+{
+    return m_SaveCompression;
+}
+
+
+void Book::SetSaveCompression(const QString &profile)
+{
+    m_SaveCompression = profile;
+}
+
+
 bool Book::HasObfuscatedFonts() const
 {
     QList<FontResource *> font_resources = m_Mainfolder->GetResourceTypeList<FontResource>();
@@ -1412,68 +1847,7 @@ void Book::SetModified(bool modified)
 
 std::tuple<bool, QString, QString> Book::HasUndefinedURLFragments()
 {
-    QList<HTMLResource *> html_resources = GetHTMLResources();
-    bool hasUndefinedUrlFrags = false;
-    Q_UNUSED(hasUndefinedUrlFrags);
-    
-    QStringList html_bookpaths;
-    foreach(HTMLResource *html_resource, html_resources) {
-        html_bookpaths.append(html_resource->GetRelativePath());
-    }
-
-    // The key to both here is now a bookpath
-    QHash<QString, QStringList> links = GetRelLinksInAllFiles(html_resources);
-    QHash<QString, QStringList> all_ids = GetIDsInAllFiles(html_resources);
-
-    foreach(HTMLResource *html_resource, html_resources) {
-        QString bookpath = html_resource->GetRelativePath();
-        QString htmldir = html_resource->GetFolder();
-        foreach(QString ahref, links[bookpath]) {
-            // each links is relative to the bookpath resource and raw
-            // convert this href to a bookpath href
-            std::pair<QString,QString> hrefparts = Utility::parseRelativeHREF(ahref);
-            QString attpath = hrefparts.first;
-            QString dest_bookpath;
-            if (attpath.isEmpty()) {
-                dest_bookpath = bookpath;
-            } else {
-                dest_bookpath = Utility::buildBookPath(attpath, htmldir);
-            }
-            QString dest_id = hrefparts.second;
-            if (dest_id.startsWith("#")) dest_id = dest_id.mid(1,-1);
-
-            if (!dest_id.isEmpty()) {
-                if (html_bookpaths.contains(dest_bookpath) && !all_ids[dest_bookpath].contains(dest_id)) {
-                    return std::make_tuple(true, ahref, bookpath);
-                }
-            }
-        }
-    }
-    return std::make_tuple(false, QString(), QString());
-}
-
-QHash<QString, QStringList> Book::GetRelLinksInAllFiles(const QList<HTMLResource *> &html_resources)
-{
-    const QList<QPair<QString, QStringList>> &links_in_files = QtConcurrent::blockingMapped(html_resources, GetRelLinksInOneFile);
-    QHash<QString, QStringList> links_in_files_map;
-    for (int i = 0; i < links_in_files.count(); ++i) {
-        QPair<QString, QStringList> entry = links_in_files.at(i);
-        links_in_files_map.insert(entry.first, entry.second);
-    }
-    return links_in_files_map;
-}
-
-
-QHash<QString, QStringList> Book::GetIDsInAllFiles(const QList<HTMLResource *> &html_resources)
-{
-    const QList<QPair<QString, QStringList>> &IDs_in_files = QtConcurrent::blockingMapped(html_resources, GetOneFileIDs);
-    QHash<QString, QStringList> ID_map;
-
-    for (int i = 0; i < IDs_in_files.count(); ++i) {
-        QPair<QString, QStringList> entry = IDs_in_files.at(i);
-        ID_map.insert(entry.first, entry.second);
-    }
-    return ID_map;
+    return m_Mainfolder->GetFragmentIndex()->FindUndefinedFragment(GetHTMLResources());
 }
 
 void Book::SaveOneResourceToDisk(Resource *resource)
@@ -1520,43 +1894,3 @@ Book::NewSectionResult Book::CreateOneNewSection(NewSection section_info,
     section.reading_order = section_info.reading_order;
     return section;
 }
-
-// Links hrefs are raw (untouched) 
-QPair<QString, QStringList> Book::GetRelLinksInOneFile(HTMLResource *html_resource)
-{
-    Q_ASSERT(html_resource);
-    QReadLocker locker(&html_resource->GetLock());
-    QString htmldir = html_resource->GetFolder();
-    GumboInterface gi = GumboInterface(html_resource->GetText(), html_resource->GetEpubVersion());
-    gi.parse();
-    QPair<QString, QStringList> link_pair;
-    QStringList hreflist;
-    const QList<GumboNode*> anchor_nodes = gi.get_all_nodes_with_tag(GUMBO_TAG_A);
-    for (int i = 0; i < anchor_nodes.length(); ++i) {
-        GumboNode* node = anchor_nodes.at(i);
-        GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, "href");
-        // We find the hrefs that are relative and contain an href.
-        if (attr && QUrl(QString::fromUtf8(attr->value)).isRelative()) {
-            hreflist.append(QString::fromStdString(attr->value));
-        }
-    }
-    link_pair.first = html_resource->GetRelativePath();
-    link_pair.second = hreflist;
-    return link_pair;
-}
-
-
-QPair<QString, QStringList> Book::GetOneFileIDs(HTMLResource *html_resource)
-{
-    Q_ASSERT(html_resource);
-    QReadLocker locker(&html_resource->GetLock());
-    QString newsource = html_resource->GetText();
-    QString version = html_resource->GetEpubVersion();
-    GumboInterface gi = GumboInterface(newsource, version);
-    gi.parse();
-    QPair<QString, QStringList> id_pair;
-    QStringList ids = gi.get_all_values_for_attribute(QString("id"));
-    id_pair.first = html_resource->GetRelativePath();
-    id_pair.second = ids;
-    return id_pair;
-}
@@ -28,9 +28,11 @@
 #include <QObject>
 #include <QUrl>
 #include <QPair>
+#include <QSet>
 #include <QFuture>
 #include "Parsers/OPFParser.h" // for MetaEntry
 #include "BookManipulation/XhtmlDoc.h"
+#include "Parsers/CSSInfo.h"
 #include "ResourceObjects/Resource.h"
 
 class CSSResource;
@@ -199,6 +201,17 @@ public:
     void CreateNewSections(const QStringList &new_sections,
                            HTMLResource *originalResource);
 
+    /**
+     * As above, with the ids each section holds as found when the
+     * file was split, the original resource's section first.  Anchors
+     * are then updated without parsing the new files again.
+     *
+     * @param section_ids The ids of each section.
+     */
+    void CreateNewSections(const QStringList &new_sections,
+                           HTMLResource *originalResource,
+                           const QList<QStringList> &section_ids);
+
     /**
      * Returns the previous resource, or the same resource if at top of folder
      *
@@ -210,16 +223,21 @@ public:
     static std::tuple<QString, QList<XhtmlDoc::XMLElement>> GetLinkElementsInHTMLFileMapped(HTMLResource *html_resource);
 
 
+    /**
+     * Renames a class in the html files that link to the stylesheet.
+     * Only the files whose cached classes include oldname are rewritten.
+     */
     bool RenameClassInHTML(const QString css_bookpath, const QString oldname, const QString newname);
+    static bool ClassUsedInHTMLFileMapped(HTMLResource* html_resource,
+                                          const QString css_bookpath,
+                                          const QString classname);
     static bool RenameClassInHTMLFileMapped(HTMLResource* html_resource,
-                                            const QString css_bookpath,
                                             const QString oldname,
                                             const QString newname);
 
     QStringList GetStyleUrlsInHTMLFiles();
     static std::tuple<QString, QStringList> GetStyleUrlsInHTMLFileMapped(HTMLResource *html_resource);
     QHash<QString, QStringList> GetIdsInHTMLFiles();
-    static std::tuple<QString, QStringList> GetIdsInHTMLFileMapped(HTMLResource *html_resource);
     QStringList GetIdsInHTMLFile(HTMLResource *html_resource);
 
     QStringList GetIdsInHrefs();
@@ -232,6 +250,8 @@ public:
     static QStringList GetWordsInHTMLFileMapped(HTMLResource *html_resource, const QString &default_lang);
 
     QHash<QString, int> GetUniqueWordsInHTMLFiles();
+    static QHash<QString, int> CountWordsInHTMLFileMapped(HTMLResource *html_resource, const QString &default_lang);
+    static void MergeWordCountsMapped(std::pair<QHash<QString, int>, QHash<QString, int>> &counts);
 
     QHash<QString, QStringList> GetStylesheetsInHTMLFiles();
     static std::tuple<QString, QStringList> GetStylesheetsInHTMLFileMapped(HTMLResource *html_resource);
@@ -241,14 +261,33 @@ public:
     QHash<QString, QStringList> GetVideoInHTMLFiles();
     QHash<QString, QStringList> GetAudioInHTMLFiles();
     QHash< QString, std::pair<int,int> > GetSpellWordCountsInHTMLFiles();
+    QList<uint> GetCharactersInHTMLFiles();
     QHash<QString, QStringList> GetHTMLFilesUsingMedia();
     QHash<QString, QStringList> GetHTMLFilesUsingImages();
 
+    /**
+     * Groups the binary files (images, fonts, audio, video and so on)
+     * that have exactly the same contents.  Only files of the same size
+     * are read, in parallel.  Each group holds two or more files and is
+     * sorted by book path.
+     */
+    QList<QList<Resource *>> GetDuplicateResources();
+    static std::tuple<Resource *, QByteArray> HashResourceMapped(Resource *resource);
+
+    /**
+     * Points every reference to the duplicates in each group at the one
+     * file of the group that is kept, the cover image if it is one of
+     * them and otherwise the first.  Returns the duplicates, which are
+     * no longer used and can be deleted.
+     */
+    QList<Resource *> MergeDuplicateResources(const QList<QList<Resource *>> &groups);
+
     static std::tuple<QString, QStringList> GetMediaInHTMLFileMapped(HTMLResource *html_resource);
     static std::tuple<QString, QStringList> GetImagesInHTMLFileMapped(HTMLResource *html_resource);
     static std::tuple<QString, QStringList> GetVideoInHTMLFileMapped(HTMLResource *html_resource);
     static std::tuple<QString, QStringList> GetAudioInHTMLFileMapped(HTMLResource *html_resource);
     static std::tuple<QString, std::pair<int,int> > GetWordCountsInHTMLFileMapped(HTMLResource *html_resource);
+    static QList<uint> GetCharactersInHTMLFileMapped(HTMLResource *html_resource);
     
 
     bool CheckHTMLFilesForWellFormedness(const QList<HTMLResource*> html_resources);
@@ -262,7 +301,7 @@ public:
      * If the merge fails, returns resource which caused the failure, otherwise returns null.
      */
     Resource *MergeResources(QList<Resource *> resources);
-    static QPair<QString, QString> UpdateAndExtractBodyInOneFile(Resource * resource, const QStringList &merged_bookpaths);
+    static QPair<QString, QString> UpdateAndExtractBodyInOneFile(Resource * resource, const QSet<QString> &merged_bookpaths);
 
 
     QList <Resource *> GetAllResources();
@@ -282,6 +321,15 @@ public:
      */
     bool IsModified() const;
 
+    /**
+     * The compression profile used when this book is saved,
+     * empty to use the one set in the preferences.
+     * See ExportEPUB::CompressionProfiles().
+     */
+    QString GetSaveCompression() const;
+
+    void SetSaveCompression(const QString &profile);
+
     /**
      * Returns whether or not a resource's data is well formed
      * whether or not it is open in a tab
@@ -304,6 +352,17 @@ public:
      */
     void ReformatAllHTML(bool to_valid);
 
+    /**
+     * Reformats every stylesheet, and the style blocks of every html file
+     * when include_style_blocks is set.  The css is serialized in worker
+     * threads and all of the new texts are set at the end.  Files whose
+     * css can not be parsed are left alone.
+     *
+     * @return The book paths of the files with css parse errors.
+     */
+    QStringList ReformatAllStylesheets(CSSInfo::CSSFormat format, bool include_style_blocks);
+    static std::tuple<QString, bool> ReformatCSSInResourceMapped(Resource *resource, CSSInfo::CSSFormat format);
+
     /**
      * Checks for the presence of obfuscated fonts in the book.
      *
@@ -318,18 +377,6 @@ public:
      */
     std::tuple<bool, QString, QString> HasUndefinedURLFragments();
 
-    /**
-     * Get all href values in all relative links from supplied HTMLResources
-     * using QtConcurrent. Return hash of hrefs keyed on filename.
-     */
-    static QHash<QString, QStringList> GetRelLinksInAllFiles(const QList<HTMLResource *> &html_resources);
-
-    /**
-     * Get all id values from supplied HTMLResources using QtConcurrent.
-     * Return hash of ids keyed on filename.
-     */
-    static QHash<QString, QStringList> GetIDsInAllFiles(const QList<HTMLResource *> &html_resources);
-
 public slots:
 
     /**
@@ -419,17 +466,6 @@ private:
     NewSectionResult CreateOneNewSection(NewSection section_info,
                                          const QHash<QString, QString> &html_updates);
 
-    /**
-     * Get all href values in all relative links from one HTMLResource
-     * Return QPair(filename, hrefs).
-     */
-    static QPair<QString, QStringList> GetRelLinksInOneFile(HTMLResource *html_resource);
-
-    /**
-     * Get all id values from one HTMLResource. Return QPair(filename, ids).
-     */
-    static QPair<QString, QStringList> GetOneFileIDs(HTMLResource *html_resource);
-
 
     ////////////////////////////
     // PRIVATE MEMBER VARIABLES
@@ -446,6 +482,11 @@ private:
      */
     bool m_IsModified;
 
+    /**
+     * The compression profile chosen for this book, if any.
+     */
+    QString m_SaveCompression;
+
 };
 
 #endif // BOOK_H
@@ -23,7 +23,8 @@
 
 #include <QString>
 #include <QStringList>
-#include <QMultiHash>
+#include <QMap>
+#include <QSet>
 #include <QHashIterator>
 #include <QApplication>
 #include <QProgressDialog>
@@ -33,11 +34,12 @@
 #include "BookManipulation/Book.h"
 #include "BookManipulation/BookReports.h"
 #include "BookManipulation/FolderKeeper.h"
+#include "BookManipulation/ReportCache.h"
 #include "Parsers/CSSInfo.h"
 #include "Parsers/HTMLStyleInfo.h"
 #include "Parsers/GumboInterface.h"
-#include "Query/CSelection.h"
-#include "Query/CNode.h"
+#include "Parsers/StyleCascade.h"
+#include "Query/CSelectorIndex.h"
 #include "Misc/SettingsStore.h"
 #include "Misc/Utility.h"
 
@@ -53,13 +55,12 @@ QList<BookReports::StyleData *> BookReports::GetHTMLClassUsage(QSharedPointer<Bo
     QList<HTMLResource *> html_resources = book->GetFolderKeeper()->GetResourceTypeList<HTMLResource>(false);
     QList<CSSResource *> css_resources = book->GetFolderKeeper()->GetResourceTypeList<CSSResource>(false);
 
-    // Parse each css file once and store its parser object
-    QHash<QString, CSSInfo * > css_parsers;
+    // Each css file keeps the parse of its current text
+    QHash<QString, QSharedPointer<const CSSInfo> > css_parsers;
     foreach(CSSResource * css_resource, css_resources) {
         QString css_filename = css_resource->GetRelativePath();
         if (!css_parsers.contains(css_filename)) {
-            CSSInfo * cp = new CSSInfo(css_resource->GetText()); 
-            css_parsers[css_filename] = cp;
+            css_parsers[css_filename] = css_resource->GetCSSInfo();
         }
     }
 
@@ -73,31 +74,24 @@ QList<BookReports::StyleData *> BookReports::GetHTMLClassUsage(QSharedPointer<Bo
     for (int i = 0; i < usage_future.results().count(); i++) {
         html_classes_usage.append(usage_future.resultAt(i));
     }
-    
-    // clean up after ourselves
-    foreach(QString css_filename, css_parsers.keys()) {
-        CSSInfo* cp = css_parsers[css_filename];
-        delete cp;
-    }
-    css_parsers.clear();
     return html_classes_usage;
 }
 
 
 QList<BookReports::StyleData *> BookReports::ClassesUsedInHTMLFileMapped(HTMLResource* html_resource,
-                                                                         const QHash<QString, CSSInfo*> &css_parsers)
+                                                                         const QHash<QString, QSharedPointer<const CSSInfo> > &css_parsers)
 {
     QList<BookReports::StyleData *> html_classes_usage;
 
     // Get the unique list of classes in this file
     // list of element_name.class_name
-    QStringList classes_in_file = XhtmlDoc::GetAllDescendantClasses(html_resource->GetText());
+    QStringList classes_in_file = html_resource->GetParsedFact(HTMLResource::Fact_Classes);
     classes_in_file.removeDuplicates();
 
     // Get the linked stylesheets for this file
     // returned as list of bookpaths to the stylesheets
     QStringList linked_stylesheets;
-    QStringList stylelinks = XhtmlDoc::GetLinkedStylesheets(html_resource->GetText());
+    QStringList stylelinks = html_resource->GetParsedFact(HTMLResource::Fact_LinkedStylesheets);
     QString html_folder = html_resource->GetFolder();
     // convert links relative to a html resource to their book paths
     foreach(QString stylelink, stylelinks) {
@@ -122,7 +116,7 @@ QList<BookReports::StyleData *> BookReports::ClassesUsedInHTMLFileMapped(HTMLRes
         // css_filename here is a bookpath as used above
         foreach(QString css_filename, linked_stylesheets) {
             if (css_parsers.contains(css_filename)) {
-                CSSInfo * css_info = css_parsers[css_filename];
+                QSharedPointer<const CSSInfo> css_info = css_parsers.value(css_filename);
                 CSSInfo::CSSSelector *selector = css_info->getCSSSelectorForElementClass(element_part, class_part);
                 // If class matched a selector in a linked stylesheet, we're done
                 if (selector && (!selector->className.isEmpty())) {
@@ -143,94 +137,120 @@ QList<BookReports::StyleData *> BookReports::ClassesUsedInHTMLFileMapped(HTMLRes
 // These are used with the new Query gumbo query to help determine if selectors of all
 // types have been used or not
 
-QList<BookReports::StyleData *> BookReports::GetAllCSSSelectorsUsed(QSharedPointer<Book> book, bool show_progress)
+QList<BookReports::SelectorUsage> BookReports::GetAllCSSSelectorsUsed(QSharedPointer<Book> book, bool show_progress)
 {
-    QMultiHash<QString, QString> selectors_used;
-
     QList<CSSResource *> css_resources = book->GetFolderKeeper()->GetResourceTypeList<CSSResource>(false);
 
-    // Parse each css file once and store its parser object
-    QHash<QString, CSSInfo * > css_parsers;
+    // The positions in the selector index are part of the cached values
+    // so the stylesheets are always added in book path order
+    QMap<QString, CSSResource *> css_by_path;
     foreach(CSSResource * css_resource, css_resources) {
-        QString css_filename = css_resource->GetRelativePath();
-        if (!css_parsers.contains(css_filename)) {
-            CSSInfo * cp = new CSSInfo(css_resource->GetText());
-            css_parsers[css_filename] = cp;
+        css_by_path.insert(css_resource->GetRelativePath(), css_resource);
+    }
+
+    // Parse every selector only once for the whole book, the selectors of
+    // a stylesheet take up one range of the index.  The positions found in
+    // an html file stay valid until the stylesheets change so they are all
+    // part of the cache context
+    CSelectorIndex css_index;
+    QHash<QString, std::pair<int, int> > css_ranges;
+    QList<QList<CSSInfo::CSSSelector *> > css_selectors;
+    // holds on to the parses that own the selectors
+    QList<QSharedPointer<const CSSInfo> > css_parsers;
+    QString css_stamp;
+    foreach(QString css_filename, css_by_path.keys()) {
+        CSSResource * css_resource = css_by_path.value(css_filename);
+        QSharedPointer<const CSSInfo> cp = css_resource->GetCSSInfo();
+        QList<CSSInfo::CSSSelector *> selectors = cp->getAllSelectors();
+        int first = css_index.size();
+        foreach(CSSInfo::CSSSelector * selector, selectors) {
+            css_index.add(selector->text.toStdString());
         }
+        css_ranges.insert(css_filename, std::make_pair(first, selectors.count()));
+        css_parsers.append(cp);
+        css_selectors.append(selectors);
+        css_stamp += css_filename + USEP + QString::number(css_resource->GetRevision()) + USEP;
     }
 
     QList<HTMLResource *> html_resources = book->GetFolderKeeper()->GetResourceTypeList<HTMLResource>(false);
 
-    QFuture< QList< std::pair<QString,QString> > > usage_future;
-    usage_future = QtConcurrent::mapped(html_resources,
-                                        std::bind(AllSelectorsUsedInHTMLFileMapped,
-                                                  std::placeholders::_1, css_parsers));
-
-    int num_futures = usage_future.results().count();
-    for (int i = 0; i < num_futures; ++i) {
-        for (int j = 0; j < usage_future.resultAt(i).count(); j++) {
-            std::pair<QString, QString> res = usage_future.resultAt(i).at(j);
-            if (!selectors_used.contains(res.first, res.second)) {
-                selectors_used.insert(res.first, res.second);
+    const QList<BookReports::SelectorMatches> usage =
+        book->GetFolderKeeper()->GetReportCache()->Map<BookReports::SelectorMatches>(ReportCache::Report_SelectorsUsed,
+                                                                                      html_resources, qHash(css_stamp),
+                                                                                      std::bind(AllSelectorsUsedInHTMLFileMapped,
+                                                                                                std::placeholders::_1, css_ranges,
+                                                                                                &css_index));
+
+    // Each file only hands back positions so merging is a matter of
+    // counting, the first file in book order is the one shown
+    std::vector<int> file_count(css_index.size(), 0);
+    std::vector<int> first_file(css_index.size(), -1);
+    for (int i = 0; i < usage.count(); ++i) {
+        foreach(int j, usage.at(i).css_matched) {
+            if (first_file[j] < 0) {
+                first_file[j] = i;
             }
+            file_count[j]++;
         }
     }
 
-    // Now build up the list of StyleData in css stylesheets
-    QList<BookReports::StyleData *> css_selector_usage;
-    foreach(QString css_filename, css_parsers.keys()) {
-        if (css_parsers.contains(css_filename)) {
-            CSSInfo * cp = css_parsers[css_filename];
-            QList<CSSInfo::CSSSelector *> selectors = cp->getAllSelectors();
-            foreach(CSSInfo::CSSSelector * selector, selectors) {
-                BookReports::StyleData* sd = new BookReports::StyleData();
-                sd->css_filename = css_filename;
-                sd->css_selector_text = selector->text;
-                sd->css_selector_position = selector->pos;
-                QString key = css_filename + USEP + QString::number(selector->pos) + USEP + selector->text;
-                QList<QString> htmlfiles = selectors_used.values(key);
-                if (!htmlfiles.isEmpty()) {
-                    sd->html_filename = htmlfiles.at(0);
+    // Now build up the list of selectors in css stylesheets
+    QList<BookReports::SelectorUsage> css_selector_usage;
+    QStringList css_filenames = css_by_path.keys();
+    for (int k = 0; k < css_filenames.count(); ++k) {
+        int first = css_ranges.value(css_filenames.at(k)).first;
+        const QList<CSSInfo::CSSSelector *> &selectors = css_selectors.at(k);
+        for (int j = 0; j < selectors.count(); ++j) {
+            BookReports::SelectorUsage su;
+            su.css_filename = css_filenames.at(k);
+            su.css_selector_text = selectors.at(j)->text;
+            su.css_selector_position = selectors.at(j)->pos;
+            su.html_file_count = file_count[first + j];
+            if (su.html_file_count > 0) {
+                // if Query selector parse error occurs to be most safe
+                // assume this selector is used
+                if (css_index.parseError(first + j)) {
+                    su.html_filename = "*** Selector Parse Error ***";
+                } else {
+                    su.html_filename = html_resources.at(first_file[first + j])->GetRelativePath();
                 }
-                css_selector_usage.append(sd);
             }
+            css_selector_usage.append(su);
         }
     }
-    // Now build up the list of StyleData in html internal style tags
-    foreach(HTMLResource* hresource, html_resources) {
-        HTMLStyleInfo hp(hresource->GetText());
-        if (hp.hasStyles()) {
-            QList<CSSInfo::CSSSelector *> selectors = hp.getAllSelectors();
-            foreach(CSSInfo::CSSSelector * selector, selectors) {
-                BookReports::StyleData* sd = new BookReports::StyleData();
-                sd->css_filename = hresource->GetRelativePath();
-                sd->css_selector_text = selector->text;
-                sd->css_selector_position = selector->pos;
-                QString key = hresource->GetRelativePath() + USEP + QString::number(selector->pos) + USEP + selector->text;
-                QList<QString> htmlfiles = selectors_used.values(key);
-                if (!htmlfiles.isEmpty()) {
-                    sd->html_filename = htmlfiles.at(0);
+    // Now build up the list of selectors in html internal style tags
+    for (int i = 0; i < html_resources.count(); ++i) {
+        HTMLResource* hresource = html_resources.at(i);
+        QSharedPointer<const HTMLStyleInfo> hp = hresource->GetStyleInfo();
+        if (hp->hasStyles()) {
+            QList<CSSInfo::CSSSelector *> selectors = hp->getAllSelectors();
+            for (int j = 0; j < selectors.count(); ++j) {
+                BookReports::SelectorUsage su;
+                su.css_filename = hresource->GetRelativePath();
+                su.css_selector_text = selectors.at(j)->text;
+                su.css_selector_position = selectors.at(j)->pos;
+                su.html_file_count = 0;
+                if (usage.at(i).style_errors.contains(j)) {
+                    su.html_filename = "*** Selector Parse Error ***";
+                    su.html_file_count = 1;
+                } else if (usage.at(i).style_matched.contains(j)) {
+                    su.html_filename = hresource->GetRelativePath();
+                    su.html_file_count = 1;
                 }
-                css_selector_usage.append(sd);
+                css_selector_usage.append(su);
             }
         }
     }
 
-    // clean up after ourselves
-    foreach(QString css_filename, css_parsers.keys()) {
-        CSSInfo* cp = css_parsers[css_filename];
-        delete cp;
-    }
-    css_parsers.clear();
-
     return css_selector_usage;
 }
 
 
-QList< std::pair<QString,QString> > BookReports::AllSelectorsUsedInHTMLFileMapped(HTMLResource* html_resource,
-                                                                          const QHash<QString, CSSInfo *> &css_parsers)
+BookReports::SelectorMatches BookReports::AllSelectorsUsedInHTMLFileMapped(HTMLResource* html_resource,
+                                                                           const QHash<QString, std::pair<int, int> > &css_ranges,
+                                                                           const CSelectorIndex *css_index)
 {
-    QList< std::pair<QString, QString> > selectors_used;
+    BookReports::SelectorMatches matches;
 
     QStringList linked_stylesheets = html_resource->GetLinkedStylesheets();
     
@@ -240,44 +260,127 @@ QList< std::pair<QString,QString> > BookReports::AllSelectorsUsedInHTMLFileMappe
     // and see if they match something in this html file
     // file names are all bookpaths
 
+    std::vector<bool> wanted(css_index->size(), false);
+    bool any_wanted = false;
     foreach(QString css_filename, linked_stylesheets) {
-        if (css_parsers.contains(css_filename)) {
-            CSSInfo * cp = css_parsers[css_filename];
-            QList<CSSInfo::CSSSelector *> selectors = cp->getAllSelectors();
-            foreach(CSSInfo::CSSSelector * selector, selectors) {
-                // Use Gumbo Query Library to see if selector is found
-                CSelection c = gi.find(selector->text);
-                // if Query selector parse error occurs to be most safe
-                // assume this selector is used in this file
-                std::pair<QString, QString> res;
-                QString foundin = html_resource->GetRelativePath();
-                if (c.parseError()) foundin = "*** Selector Parse Error ***";
-                if (c.parseError() || (c.nodeNum() > 0 && c.nodeAt(0).valid())) {
-                    res.first = css_filename + USEP + QString::number(selector->pos) + USEP + selector->text;
-                    res.second = foundin;
-                    selectors_used.append(res);
-                }
+        if (css_ranges.contains(css_filename)) {
+            std::pair<int, int> range = css_ranges.value(css_filename);
+            for (int i = range.first; i < range.first + range.second; i++) {
+                wanted[i] = true;
+                any_wanted = true;
+            }
+        }
+    }
+    if (any_wanted) {
+        std::vector<bool> found = gi.findany(*css_index, wanted);
+        for (size_t i = 0; i < wanted.size(); i++) {
+            // selectors that can not be parsed are reported by the caller
+            if (wanted[i] && (found[i] || css_index->parseError(i))) {
+                matches.css_matched.append(i);
             }
         }
     }
 
     // now look for internal <style> tags in this HTML File and test their selectors as well
-    HTMLStyleInfo hp(html_resource->GetText());
-    if (hp.hasStyles()) {
-        QList<CSSInfo::CSSSelector *> selectors = hp.getAllSelectors();
+    QSharedPointer<const HTMLStyleInfo> hp = html_resource->GetStyleInfo();
+    if (hp->hasStyles()) {
+        QList<CSSInfo::CSSSelector *> selectors = hp->getAllSelectors();
+        CSelectorIndex style_index;
         foreach(CSSInfo::CSSSelector * selector, selectors) {
-            CSelection c = gi.find(selector->text);
-            // if Query selector parse error occurs to be most safe
-            // assume this selector is used in this file
-            std::pair<QString, QString> res;
-            QString foundin = html_resource->GetRelativePath();
-            if (c.parseError()) foundin = "*** Selector Parse Error ***";
-            if (c.parseError() || (c.nodeNum() > 0 && c.nodeAt(0).valid())) {
-                res.first = html_resource->GetRelativePath() + USEP + QString::number(selector->pos) + USEP + selector->text;
-                res.second = foundin;
-                selectors_used.append(res);
+            style_index.add(selector->text.toStdString());
+        }
+        std::vector<bool> found = gi.findany(style_index);
+        for (int i = 0; i < selectors.count(); i++) {
+            if (style_index.parseError(i)) {
+                matches.style_errors.append(i);
+            } else if (found[i]) {
+                matches.style_matched.append(i);
+            }
+        }
+    }
+    return matches;
+}
+
+
+QList<BookReports::StyleData *> BookReports::GetOverriddenCSSSelectors(QSharedPointer<Book> book)
+{
+    // Every style sheet and inline style of the book goes into one cascade,
+    // each html file then only looks at its own
+    StyleCascade cascade;
+    QString css_stamp;
+    QList<CSSResource *> css_resources = book->GetFolderKeeper()->GetResourceTypeList<CSSResource>(false);
+    foreach(CSSResource * css_resource, css_resources) {
+        QSharedPointer<const CSSInfo> cp = css_resource->GetCSSInfo();
+        cascade.AddSelectors(css_resource->GetRelativePath(), cp->getAllSelectors());
+        css_stamp += css_resource->GetRelativePath() + USEP + QString::number(css_resource->GetRevision()) + USEP;
+    }
+    QList<HTMLResource *> html_resources = book->GetFolderKeeper()->GetResourceTypeList<HTMLResource>(false);
+    foreach(HTMLResource* html_resource, html_resources) {
+        QSharedPointer<const HTMLStyleInfo> hp = html_resource->GetStyleInfo();
+        if (hp->hasStyles()) {
+            cascade.AddSelectors(html_resource->GetRelativePath(), hp->getAllSelectors());
+        }
+    }
+
+    // the keys returned only name the selectors of the file and its own
+    // style sheets so only those need to be in the cache context
+    const QList< std::pair<QStringList, QStringList> > usage =
+        book->GetFolderKeeper()->GetReportCache()->Map< std::pair<QStringList, QStringList> >(ReportCache::Report_SelectorsOverridden,
+                                                                                            html_resources, qHash(css_stamp),
+                                                                                            std::bind(SelectorsCascadeInHTMLFileMapped,
+                                                                                                      std::placeholders::_1, &cascade));
+
+    QHash<QString, QString> matched_in;
+    QSet<QString> effective;
+    for (int i = 0; i < usage.count(); ++i) {
+        foreach(QString key, usage.at(i).first) {
+            if (!matched_in.contains(key)) {
+                matched_in.insert(key, html_resources.at(i)->GetRelativePath());
+            }
+        }
+        foreach(QString key, usage.at(i).second) {
+            effective.insert(key);
+        }
+    }
+
+    QList<BookReports::StyleData *> overridden;
+    for (int i = 0; i < cascade.count(); i++) {
+        const StyleCascade::Rule &rule = cascade.GetRule(i);
+        QString key = rule.bookpath + USEP + QString::number(rule.pos) + USEP + rule.text;
+        if (matched_in.contains(key) && !effective.contains(key)) {
+            BookReports::StyleData* sd = new BookReports::StyleData();
+            sd->css_filename = rule.bookpath;
+            sd->css_selector_text = rule.text;
+            sd->css_selector_position = rule.pos;
+            sd->html_filename = matched_in.value(key);
+            overridden.append(sd);
+        }
+    }
+    return overridden;
+}
+
+
+std::pair<QStringList, QStringList> BookReports::SelectorsCascadeInHTMLFileMapped(HTMLResource* html_resource,
+                                                                                const StyleCascade *cascade)
+{
+    QStringList matched;
+    QStringList effective;
+
+    // linked style sheets in the order they are linked, then the inline styles
+    QStringList stylesheets = html_resource->GetLinkedStylesheets();
+    stylesheets.append(html_resource->GetRelativePath());
+
+    GumboInterface gi = GumboInterface(html_resource->GetText(), "any_version");
+    StyleCascade::Usage usage = cascade->GetUsage(gi, stylesheets);
+    for (int i = 0; i < cascade->count(); i++) {
+        if (usage.matched.at(i)) {
+            const StyleCascade::Rule &rule = cascade->GetRule(i);
+            QString key = rule.bookpath + USEP + QString::number(rule.pos) + USEP + rule.text;
+            matched.append(key);
+            if (usage.effective.at(i)) {
+                effective.append(key);
             }
         }
     }
-    return selectors_used;
+    return std::make_pair(matched, effective);
 }
@@ -31,6 +31,8 @@
 
 
 class QString;
+class CSelectorIndex;
+class StyleCascade;
 
 
 class BookReports
@@ -48,20 +50,52 @@ public:
         int css_selector_position;
     };
 
+    // One row of the selector usage report, kept by value.
+    // html_filename is the first html file the selector matches in
+    // and html_file_count the number of html files it matches in.
+    struct SelectorUsage {
+        QString css_filename;
+        QString css_selector_text;
+        int css_selector_position;
+        QString html_filename;
+        int html_file_count;
+    };
+
+    // What one html file adds to the selector usage report: the positions
+    // in the book selector index of the selectors of its linked stylesheets
+    // that match, and the positions among its own style tag selectors of
+    // those that match or could not be parsed.
+    struct SelectorMatches {
+        QList<int> css_matched;
+        QList<int> style_matched;
+        QList<int> style_errors;
+    };
+
     static QList<BookReports::StyleData *> GetHTMLClassUsage(QSharedPointer<Book> book, 
                                                              bool show_progress = false);
 
     static QList<BookReports::StyleData *> ClassesUsedInHTMLFileMapped(HTMLResource* html_resource, 
-                                                                       const QHash<QString,CSSInfo*> &css_parsers);
+                                                                       const QHash<QString, QSharedPointer<const CSSInfo> > &css_parsers);
+
 
+    static QList<BookReports::SelectorUsage> GetAllCSSSelectorsUsed(QSharedPointer<Book> book,
+                                                                    bool show_progress = false);
 
-    static QList<BookReports::StyleData *> GetAllCSSSelectorsUsed(QSharedPointer<Book> book,
-                                                                  bool show_progress = false);
+    static BookReports::SelectorMatches AllSelectorsUsedInHTMLFileMapped(HTMLResource* html_resource,
+                                                                         const QHash<QString, std::pair<int, int> > &css_ranges,
+                                                                         const CSelectorIndex *css_index);
 
-    static QList< std::pair<QString,QString> > AllSelectorsUsedInHTMLFileMapped(HTMLResource* html_resource,
-                                                                            const QHash<QString, CSSInfo*> &css_parsers);
+    // The selectors that match an element in some html file but that, in every
+    // html file, lose each of their properties to a more specific or later rule.
+    // html_filename is one of the files the selector matches in.
+    static QList<BookReports::StyleData *> GetOverriddenCSSSelectors(QSharedPointer<Book> book);
+
+    static std::pair<QStringList, QStringList> SelectorsCascadeInHTMLFileMapped(HTMLResource* html_resource,
+                                                                                const StyleCascade *cascade);
 
 
 };
 
+Q_DECLARE_METATYPE(BookReports::SelectorMatches)
+
 #endif // BOOKREPORTS_H
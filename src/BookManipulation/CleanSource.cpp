@@ -22,20 +22,30 @@
 
 #include "EmbedPython/EmbeddedPython.h"
 
+#include <functional>
+
+#include <QtConcurrent/QtConcurrent>
+#include <QtCore/QEventLoop>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QHash>
 #include <QtCore/QString>
 #include <QtCore/QStringList>
-#include <QtCore/QWriteLocker>
+#include <QtCore/QVector>
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QProgressDialog>
 #include <QRegularExpression>
 #include <QRegularExpressionMatch>
+#include <QXmlStreamReader>
 
 #include "BookManipulation/CleanSource.h"
 #include "BookManipulation/XhtmlDoc.h"
 #include "Parsers/GumboInterface.h"
+#include "Parsers/OPFParser.h"
+#include "Misc/SettingsSnapshot.h"
 #include "Misc/SettingsStore.h"
 #include "sigil_constants.h"
 #include "sigil_exception.h"
+#include "Misc/Trace.h"
 #include "Misc/Utility.h"
 #include <utility>
 
@@ -95,6 +105,222 @@ QString CleanSource::XMLPrettyPrintBS4(const QString &source, const QString mtyp
     return res.toString();
 }
 
+// Tags whose children the bs4 xml serializer puts on lines of their own
+static const QStringList XML_PARENT_TAGS = QStringList() << "package" << "metadata" << "manifest"
+                                                         << "spine" << "guide" << "ncx" << "head"
+                                                         << "doctitle" << "docauthor" << "navmap"
+                                                         << "navpoint" << "navlabel" << "pagelist"
+                                                         << "pagetarget";
+
+static const QString XML_INDENT = "  ";
+
+enum XMLNodeType {
+    XML_DOCUMENT,
+    XML_ELEMENT,
+    XML_TEXT,
+    XML_MARKUP
+};
+
+// One node of the tree XMLPrettyPrint builds, the children are
+// held as indexes into the list of all nodes
+struct XMLNode
+{
+    XMLNodeType type;
+    QString name;
+    QString local_name;
+    QString attributes;
+    QString text;
+    QList<int> children;
+
+    XMLNode(XMLNodeType ntype = XML_DOCUMENT) : type(ntype) {}
+};
+
+
+static QStringList VoidTagsForMediaType(const QString &mtype)
+{
+    if (mtype == "application/oebps-package+xml") {
+        return QStringList() << "item" << "itemref" << "mediatype" << "mediaType" << "reference";
+    }
+    if (mtype == "application/x-dtbncx+xml") {
+        return QStringList() << "meta" << "reference" << "content";
+    }
+    if (mtype == "application/smil+xml") {
+        return QStringList() << "text" << "audio";
+    }
+    if (mtype == "application/oebps-page-map+xml") {
+        return QStringList() << "page";
+    }
+    return QStringList() << "meta" << "item" << "itemref" << "reference" << "content";
+}
+
+
+static QString EscapeXMLText(const QString &text)
+{
+    QString escaped = text;
+    escaped.replace('&', "&amp;");
+    escaped.replace('<', "&lt;");
+    escaped.replace('>', "&gt;");
+    return escaped;
+}
+
+
+static QString QuoteXMLAttribute(const QString &value)
+{
+    QString escaped = EscapeXMLText(value);
+    escaped.replace('"', "&quot;");
+    return "\"" + escaped + "\"";
+}
+
+
+static bool ParseXMLTree(const QString &source, QList<XMLNode> &nodes)
+{
+    QXmlStreamReader reader(source);
+    nodes.clear();
+    nodes << XMLNode(XML_DOCUMENT);
+    QList<int> open;
+    open << 0;
+    while (!reader.atEnd()) {
+        reader.readNext();
+        XMLNode node;
+        switch (reader.tokenType()) {
+            case QXmlStreamReader::StartElement:
+                node.type = XML_ELEMENT;
+                node.name = reader.qualifiedName().toString();
+                node.local_name = reader.name().toString();
+                foreach(const QXmlStreamNamespaceDeclaration &ns, reader.namespaceDeclarations()) {
+                    QString key = ns.prefix().isEmpty() ? QString("xmlns") : "xmlns:" + ns.prefix().toString();
+                    node.attributes += " " + key + "=" + QuoteXMLAttribute(ns.namespaceUri().toString());
+                }
+                foreach(const QXmlStreamAttribute &attr, reader.attributes()) {
+                    node.attributes += " " + attr.qualifiedName().toString() + "=" + QuoteXMLAttribute(attr.value().toString());
+                }
+                break;
+            case QXmlStreamReader::EndElement:
+                open.removeLast();
+                continue;
+            case QXmlStreamReader::Characters: {
+                // cdata and entities can split a run of text into pieces
+                XMLNode &parent = nodes[open.last()];
+                if (!parent.children.isEmpty() && (nodes.at(parent.children.last()).type == XML_TEXT)) {
+                    nodes[parent.children.last()].text += reader.text().toString();
+                    continue;
+                }
+                node.type = XML_TEXT;
+                node.text = reader.text().toString();
+                break;
+            }
+            case QXmlStreamReader::Comment:
+                node.type = XML_MARKUP;
+                node.text = "<!--" + reader.text().toString() + "-->";
+                break;
+            case QXmlStreamReader::ProcessingInstruction:
+                node.type = XML_MARKUP;
+                node.text = "<?" + reader.processingInstructionTarget().toString();
+                if (!reader.processingInstructionData().isEmpty()) {
+                    node.text += " " + reader.processingInstructionData().toString();
+                }
+                node.text += "?>";
+                break;
+            case QXmlStreamReader::DTD:
+                node.type = XML_MARKUP;
+                node.text = reader.text().toString();
+                break;
+            case QXmlStreamReader::EntityReference:
+                // bs4 escapes every entity that xml itself does not define
+                node.type = XML_MARKUP;
+                node.text = "&amp;" + reader.name().toString() + ";";
+                break;
+            default:
+                continue;
+        }
+        int index = nodes.count();
+        nodes << node;
+        nodes[open.last()].children << index;
+        if (node.type == XML_ELEMENT) {
+            open << index;
+        }
+    }
+    return !reader.hasError();
+}
+
+
+static QString SerializeXMLNode(const QList<XMLNode> &nodes, int index, int level, bool has_next, const QStringList &void_tags);
+
+static QString SerializeXMLContents(const QList<XMLNode> &nodes, int index, int level, const QStringList &void_tags)
+{
+    const XMLNode &node = nodes.at(index);
+    bool is_parent = (node.type == XML_ELEMENT) && XML_PARENT_TAGS.contains(node.local_name.toLower());
+    QStringList pieces;
+    for (int i = 0; i < node.children.count(); i++) {
+        const XMLNode &child = nodes.at(node.children.at(i));
+        if (child.type == XML_ELEMENT) {
+            pieces << SerializeXMLNode(nodes, node.children.at(i), level, i < node.children.count() - 1, void_tags);
+            continue;
+        }
+        QString text = child.text.trimmed();
+        if (child.type == XML_TEXT) {
+            text = EscapeXMLText(text);
+        }
+        if (!text.isEmpty()) {
+            if (is_parent && pieces.isEmpty()) {
+                pieces << XML_INDENT.repeated(level - 1);
+            }
+            pieces << text;
+        }
+    }
+    return pieces.join("");
+}
+
+
+static QString SerializeXMLNode(const QList<XMLNode> &nodes, int index, int level, bool has_next, const QStringList &void_tags)
+{
+    const XMLNode &node = nodes.at(index);
+    bool is_parent = XML_PARENT_TAGS.contains(node.local_name.toLower());
+    bool is_empty = false;
+    if (void_tags.contains(node.local_name)) {
+        // a void tag holding nothing but whitespace still counts as empty
+        is_empty = node.children.isEmpty() ||
+                   ((node.children.count() == 1) &&
+                    (nodes.at(node.children.first()).type == XML_TEXT) &&
+                    nodes.at(node.children.first()).text.trimmed().isEmpty());
+    }
+    QString indent_space = XML_INDENT.repeated(level - 1);
+    QString contents;
+    if (!is_empty) {
+        contents = SerializeXMLContents(nodes, index, is_parent ? level + 1 : level, void_tags);
+    }
+    QString result = indent_space + "<" + node.name + node.attributes + (is_empty ? "/>" : ">");
+    if (is_parent) {
+        result += "\n";
+    }
+    result += contents;
+    if ((!contents.isEmpty() && !contents.endsWith('\n') && is_parent) || is_empty) {
+        result += "\n";
+    }
+    if (!is_empty) {
+        if (is_parent) {
+            result += indent_space;
+        }
+        result += "</" + node.name + ">";
+        if (has_next) {
+            result += "\n";
+        }
+    }
+    return result;
+}
+
+
+// Mirrors the layout repairXML gets from bs4 so either one can be used
+QString CleanSource::XMLPrettyPrint(const QString &source, const QString mtype)
+{
+    QList<XMLNode> nodes;
+    if (!ParseXMLTree(source, nodes)) {
+        return QString();
+    }
+    return "<?xml version=\"1.0\" encoding=\"utf-8\" ?>\n" +
+           SerializeXMLContents(nodes, 0, 1, VoidTagsForMediaType(mtype));
+}
+
 // convert the source to valid XHTML
 QString CleanSource::ToValidXHTML(const QString &source, const QString &version)
 {
@@ -105,55 +331,28 @@ QString CleanSource::ToValidXHTML(const QString &source, const QString &version)
     return newsource;
 }
 
+// Checked with QXmlStreamReader right here, so unlike a round trip
+// through the embedded python this is safe to run from any thread
+// and any number of checks can run at once.
 XhtmlDoc::WellFormedError CleanSource::WellFormedXMLCheck(const QString &source, const QString mtype)
 {
-    XhtmlDoc::WellFormedError error; 
-    int rv = 0;
-    QString error_traceback;
-    QList<QVariant> args;
-    args.append(QVariant(source));
-    args.append(QVariant(mtype));
-    EmbeddedPython * epython  = EmbeddedPython::instance();
-
-    QVariant res = epython->runInPython( QString("xmlprocessor"),
-                                         QString("WellFormedXMLCheck"),
-                                         args,
-                                         &rv,
-                                         error_traceback);    
-    if (rv != 0) {
-        Utility::DisplayStdWarningDialog(QString("error in xmlprocessor WellFormedXMLCheck: ") + QString::number(rv), 
-                                         error_traceback);
-        // an error happened during check, return well-formed as true
-        return error;
+    Q_UNUSED(mtype);
+    XhtmlDoc::WellFormedError error;
+    QXmlStreamReader reader(source);
+    while (!reader.atEnd()) {
+        reader.readNext();
+    }
+    if (reader.hasError()) {
+        error.line    = reader.lineNumber();
+        error.column  = reader.columnNumber();
+        error.message = reader.errorString();
     }
-    QStringList errors = res.toStringList();
-    error.line = errors.at(0).toInt();
-    error.column = errors.at(1).toInt();
-    error.message = errors.at(2);
     return error;
 }
 
 bool CleanSource::IsWellFormedXML(const QString &source, const QString mtype)
 {
-    int rv = 0;
-    QString error_traceback;
-    QList<QVariant> args;
-    args.append(QVariant(source));
-    args.append(QVariant(mtype));
-    EmbeddedPython * epython  = EmbeddedPython::instance();
-
-    QVariant res = epython->runInPython( QString("xmlprocessor"),
-                                         QString("IsWellFormedXML"),
-                                         args,
-                                         &rv,
-                                         error_traceback);    
-    if (rv != 0) {
-        Utility::DisplayStdWarningDialog(QString("error in xmlprocessor IsWellFormedXML: ") + QString::number(rv), 
-                                         error_traceback);
-        // an error happened during check return well-formed as true
-        return true;
-    }
-    return res.toBool();
+    return WellFormedXMLCheck(source, mtype).line == -1;
 }
 
 QString CleanSource::ProcessXML(const QString &source, const QString mtype)
@@ -164,6 +363,18 @@ QString CleanSource::ProcessXML(const QString &source, const QString mtype)
             return source;
         }
     }
+    if (mtype == "application/oebps-package+xml") {
+        // a well formed opf is rebuilt here, only a broken one needs python
+        QString pretty = XMLPrettyPrint(source, mtype);
+        if (!pretty.isEmpty()) {
+            OPFParser opfparser;
+            opfparser.parse(pretty);
+            return opfparser.convert_to_xml();
+        }
+    } else if (IsWellFormedXML(source, mtype)) {
+        // well formed xml is left as is
+        return source;
+    }
     return XMLPrettyPrintBS4(source, mtype);
 }
 
@@ -263,9 +474,7 @@ QString CleanSource::PrettifyDOCTYPEHeader(const QString &source)
 
 QString CleanSource::CharToEntity(const QString &source, const QString &version)
 {
-    SettingsStore settings;
-    QString new_source = source;
-    QList<std::pair <ushort, QString>> codenames = settings.preserveEntityCodeNames();
+    const QList<std::pair <ushort, QString>> codenames = SettingsSnapshot::instance()->Current()->preserve_entity_codenames;
     std::pair <ushort, QString> epair;
     bool has_numeric_nbsp = false;
     foreach(epair, codenames) {
@@ -274,42 +483,133 @@ QString CleanSource::CharToEntity(const QString &source, const QString &version)
             has_numeric_nbsp = true;
         } 
     }
-    // now intelligently handle the replacements
+    // now intelligently work out the entity for each character
+    QHash<ushort, QString> entities;
+    ushort lowest = 0xffff;
     foreach(epair, codenames) {
         QString codename = epair.second.toLower();
+        QString entity;
         if (version.startsWith("2")) {
-            new_source.replace(QChar(epair.first), codename);
+            entity = codename;
         } else if (version.startsWith("3")) {
             // only use numeric entities in epub3
             if (codename.startsWith("&#")) { 
-                new_source.replace(QChar(epair.first), codename);
+                entity = codename;
             } else if ((codename == "&nbsp;") && !has_numeric_nbsp) {
-                new_source.replace(QChar(epair.first), "&#160;");
+                entity = "&#160;";
             }
         }
+        // the first entity given for a character is the one used
+        if (!entity.isEmpty() && !entities.contains(epair.first)) {
+            entities.insert(epair.first, entity);
+            lowest = qMin(lowest, epair.first);
+        }
+    }
+    if (entities.isEmpty()) {
+        return source;
+    }
+
+    // One pass over the text instead of a replace per entity.  Most
+    // characters are below every preserved one and are skipped without
+    // a lookup, and a text with nothing to convert is returned as is.
+    const QChar *text = source.constData();
+    const int length = source.length();
+    int pos = 0;
+    while (pos < length && (text[pos].unicode() < lowest || !entities.contains(text[pos].unicode()))) {
+        pos++;
+    }
+    if (pos == length) {
+        return source;
+    }
+    QString new_source;
+    new_source.reserve(length + length / 16);
+    int run = 0;
+    for (; pos < length; pos++) {
+        ushort c = text[pos].unicode();
+        if (c < lowest) {
+            continue;
+        }
+        QHash<ushort, QString>::const_iterator it = entities.constFind(c);
+        if (it != entities.constEnd()) {
+            new_source.append(text + run, pos - run);
+            new_source.append(it.value());
+            run = pos + 1;
+        }
     }
+    new_source.append(text + run, length - run);
     return new_source;
 }
 
 
 bool CleanSource::ReformatAll(QList <HTMLResource *> resources, QString(clean_func)(const QString &source, const QString &version))
 {
-    QProgressDialog progress(QObject::tr("Cleaning..."), 0, 0, resources.count(), Utility::GetMainWindow());
-    progress.setMinimumDuration(PROGRESS_BAR_MINIMUM_DURATION);
-    int progress_value = 0;
-    progress.setValue(progress_value);
-    bool book_modified = false;
+    TRACE_OPERATION(operation, "CleanSource::ReformatAll",
+                    clean_func == CleanSource::Mend ? QObject::tr("Mend All") : QObject::tr("Mend and Prettify All"));
+    operation.AddArg("files", resources.count());
+
+    // Take a snapshot of every text first so the workers only ever see
+    // plain strings, and nothing is locked while they clean
+    QList<std::pair<QString, QString>> sources;
+    QList<quint64> revisions;
     foreach(HTMLResource * resource, resources) {
-        progress.setValue(progress_value++);
-        qApp->processEvents();
-        QWriteLocker locker(&resource->GetLock());
-        QString source = resource->GetText();
-        QString version = resource->GetEpubVersion();
-        QString newsource = clean_func(source, version);
-        if (newsource != source) {
-            book_modified = true;
-            resource->SetText(newsource);
+        TextResource::TextSnapshot snapshot = resource->GetTextSnapshot();
+        sources.append(std::make_pair(snapshot.text, resource->GetEpubVersion()));
+        revisions.append(snapshot.revision);
+    }
+    QFuture<std::pair<bool, QString>> future = QtConcurrent::mapped(sources, std::bind(CleanOneText, std::placeholders::_1, clean_func));
+
+    // Only the calling thread sets the new text, a batch at a time as
+    // the workers report them
+    bool book_modified = false;
+    QVector<bool> applied(resources.count(), false);
+    auto apply_results = [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            if (applied.at(i) || !future.isResultReadyAt(i)) {
+                continue;
+            }
+            applied[i] = true;
+            std::pair<bool, QString> result = future.resultAt(i);
+            // a file edited while it was being cleaned keeps the edit
+            if (result.first && resources.at(i)->SetTextIfRevision(result.second, revisions.at(i))) {
+                book_modified = true;
+            }
+        }
+    };
+
+    // batch mode cleans books off the GUI thread with no progress shown
+    if (Utility::IsGUIThread()) {
+        QProgressDialog progress(QObject::tr("Cleaning..."), QObject::tr("Cancel"), 0, resources.count(), Utility::GetMainWindow());
+        progress.setMinimumDuration(PROGRESS_BAR_MINIMUM_DURATION);
+        QFutureWatcher<std::pair<bool, QString>> watcher;
+        QEventLoop loop;
+        QObject::connect(&watcher, &QFutureWatcher<std::pair<bool, QString>>::resultsReadyAt, &loop, apply_results);
+        QObject::connect(&watcher, &QFutureWatcher<std::pair<bool, QString>>::progressValueChanged, &progress, &QProgressDialog::setValue);
+        QObject::connect(&watcher, &QFutureWatcher<std::pair<bool, QString>>::finished, &loop, &QEventLoop::quit);
+        QObject::connect(&progress, &QProgressDialog::canceled, &watcher, &QFutureWatcher<std::pair<bool, QString>>::cancel);
+        watcher.setFuture(future);
+        // the progress dialog is modal so only its Cancel button takes input
+        if (!watcher.isFinished()) {
+            loop.exec();
+        }
+        if (progress.wasCanceled()) {
+            future.cancel();
         }
     }
+    future.waitForFinished();
+
+    // whatever was cleaned before a cancel is kept
+    apply_results(0, resources.count());
     return book_modified;
 }
+
+
+// Runs in a worker thread.
+std::pair<bool, QString> CleanSource::CleanOneText(const std::pair<QString, QString> &source_and_version,
+                                                   QString(clean_func)(const QString &source, const QString &version))
+{
+    QString newsource = clean_func(source_and_version.first, source_and_version.second);
+    if (newsource == source_and_version.first) {
+        return std::make_pair(false, QString());
+    }
+    return std::make_pair(true, newsource);
+}
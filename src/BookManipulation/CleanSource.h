@@ -24,6 +24,8 @@
 #ifndef CLEANSOURCE_H
 #define CLEANSOURCE_H
 
+#include <utility>
+
 #include <QtCore/QList>
 
 #include "ResourceObjects/HTMLResource.h"
@@ -49,10 +51,21 @@ public:
 
     static QString XMLPrettyPrintBS4(const QString &source, const QString mtype="");
 
+    // Native version of XMLPrettyPrintBS4 for well formed xml, returns
+    // an empty string if the source needs repairs first
+    static QString XMLPrettyPrint(const QString &source, const QString mtype="");
+
     static QString PrettifyDOCTYPEHeader(const QString &source);
 
     static QString CharToEntity(const QString &source, const QString &version);
 
+    /**
+     * Runs clean_fun over every resource in worker threads.  On the GUI
+     * thread a progress dialog is shown whose Cancel leaves the files
+     * not cleaned yet as they were.
+     *
+     * @return true if the text of any resource changed.
+     */
     static bool ReformatAll(QList <HTMLResource *> resources, QString(clean_fun)(const QString &source, const QString &version));
 
     /** 
@@ -76,6 +89,14 @@ private:
      */
     static QString RemoveMetaCharset(const QString &source);
 
+    /**
+     * Cleans one file's text and version in a worker thread.
+     *
+     * @return whether the text changed and the new text.
+     */
+    static std::pair<bool, QString> CleanOneText(const std::pair<QString, QString> &source_and_version,
+                                                 QString(clean_fun)(const QString &source, const QString &version));
+
 };
 
 
@@ -0,0 +1,365 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <algorithm>
+#include <functional>
+
+#include <QtConcurrent/QtConcurrent>
+#include <QtCore/QStringView>
+#include <QtCore/QUrl>
+
+#include "BookManipulation/Book.h"
+#include "BookManipulation/CleanSource.h"
+#include "BookManipulation/DeletePlan.h"
+#include "BookManipulation/FolderKeeper.h"
+#include "BookManipulation/ReferenceIndex.h"
+#include "Misc/Utility.h"
+#include "Parsers/GumboInterface.h"
+#include "Parsers/TagLister.h"
+#include "ResourceObjects/HTMLResource.h"
+#include "ResourceObjects/NCXResource.h"
+#include "ResourceObjects/OPFResource.h"
+
+// The NCX elements that are entries, each with one content
+static const QStringList NCX_ENTRY_TAGS = QStringList() << "navPoint" << "navTarget" << "pageTarget";
+
+// The attributes that name a file, the element holding one is
+// removed unless it is a link
+static const QStringList FILE_ATTRIBUTES = QStringList() << "href" << "src" << "data";
+
+
+static void CollectElements(GumboNode *node, QList<GumboNode *> &elements)
+{
+    if ((node->type != GUMBO_NODE_ELEMENT) && (node->type != GUMBO_NODE_TEMPLATE) &&
+        (node->type != GUMBO_NODE_DOCUMENT)) {
+        return;
+    }
+    GumboVector *children;
+    if (node->type == GUMBO_NODE_DOCUMENT) {
+        children = &node->v.document.children;
+    } else {
+        elements.append(node);
+        children = &node->v.element.children;
+    }
+    for (unsigned int i = 0; i < children->length; ++i) {
+        CollectElements(static_cast<GumboNode *>(children->data[i]), elements);
+    }
+}
+
+
+// A Nav entry with entries inside it keeps them, and itself
+static bool HasNestedList(GumboNode *item)
+{
+    GumboVector *children = &item->v.element.children;
+    for (unsigned int i = 0; i < children->length; ++i) {
+        GumboNode *child = static_cast<GumboNode *>(children->data[i]);
+        if ((child->type == GUMBO_NODE_ELEMENT) &&
+            ((child->v.element.tag == GUMBO_TAG_OL) || (child->v.element.tag == GUMBO_TAG_UL))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static bool HasNestedEntry(TagLister &taglist, int open, int close)
+{
+    for (int i = open + 1; i < close; ++i) {
+        TagLister::TagInfo ti = taglist.at(i);
+        if ((ti.ttype == "begin") && NCX_ENTRY_TAGS.contains(ti.tname)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+DeletePlan::DeletePlan(QSharedPointer<Book> book, const QList<Resource *> &resources)
+    :
+    m_Book(book),
+    m_Resources(resources),
+    m_NavResource(book->GetConstOPF()->GetNavResource()),
+    m_Prepared(false)
+{
+    foreach(Resource *resource, resources) {
+        m_Removed.insert(resource->GetRelativePath());
+    }
+}
+
+
+void DeletePlan::Prepare()
+{
+    if (m_Prepared) {
+        return;
+    }
+    m_Prepared = true;
+    FolderKeeper *folder_keeper = m_Book->GetFolderKeeper();
+
+    // Only the files the reference index says refer to a removed
+    // file are parsed, less the removed files themselves
+    QList<TextResource *> resources;
+    QList<HTMLResource *> referrers = folder_keeper->GetReferenceIndex()->GetFilesAffectedBy(
+        folder_keeper->GetResourceTypeList<HTMLResource>(false), m_Removed.values());
+    bool removes_html = false;
+    foreach(Resource *resource, m_Resources) {
+        removes_html = removes_html || (resource->Type() == Resource::HTMLResourceType);
+    }
+    foreach(HTMLResource *html_resource, referrers) {
+        if (!m_Removed.contains(html_resource->GetRelativePath())) {
+            resources.append(html_resource);
+        }
+    }
+    // the NCX only ever points at html files
+    NCXResource *ncx_resource = m_Book->GetNCX();
+    if (removes_html && ncx_resource && !m_Removed.contains(ncx_resource->GetRelativePath())) {
+        resources.append(ncx_resource);
+    }
+
+    m_Updates = QtConcurrent::blockingMapped<QList<FileUpdate>>(resources, std::bind(&DeletePlan::Prune, this, std::placeholders::_1));
+}
+
+
+QList<DeletePlan::Reference> DeletePlan::GetReferences() const
+{
+    QList<Reference> references;
+    foreach(const FileUpdate &update, m_Updates) {
+        references.append(update.references);
+    }
+    return references;
+}
+
+
+void DeletePlan::Apply()
+{
+    Prepare();
+    for (int i = 0; i < m_Updates.count(); ++i) {
+        FileUpdate update = m_Updates.at(i);
+        // a file edited since Prepare is pruned again
+        while (update.changed && !update.resource->SetTextIfRevision(update.text, update.revision)) {
+            update = Prune(update.resource);
+        }
+        m_Updates[i] = update;
+    }
+    m_Book->GetFolderKeeper()->BulkRemoveResources(m_Resources);
+}
+
+
+DeletePlan::FileUpdate DeletePlan::Prune(TextResource *resource) const
+{
+    HTMLResource *html_resource = qobject_cast<HTMLResource *>(resource);
+    if (html_resource) {
+        return PruneHTML(html_resource, m_Removed, html_resource == m_NavResource);
+    }
+    return PruneNCX(resource, m_Removed);
+}
+
+
+// Runs in a worker thread.
+DeletePlan::FileUpdate DeletePlan::PruneHTML(HTMLResource *html_resource, const QSet<QString> &removed, bool is_nav)
+{
+    FileUpdate update;
+    update.resource = html_resource;
+    update.bookpath = html_resource->GetRelativePath();
+    TextResource::TextSnapshot snapshot = html_resource->GetTextSnapshot();
+    update.revision = snapshot.revision;
+    QString startdir = Utility::startingDir(update.bookpath);
+
+    GumboInterface gi = GumboInterface(snapshot.text, html_resource->GetEpubVersion());
+    gi.parse();
+    QList<GumboNode *> elements;
+    CollectElements(gi.get_document_node(), elements);
+    QList<GumboNode *> doomed;
+    foreach(GumboNode *node, elements) {
+        QString tag = QString::fromStdString(gi.get_tag_name(node));
+        GumboElement *element = &node->v.element;
+        // backwards so that removing an attribute leaves the rest in place
+        for (int i = static_cast<int>(element->attributes.length) - 1; i >= 0; --i) {
+            GumboAttribute *attr = static_cast<GumboAttribute *>(element->attributes.data[i]);
+            QString name = QString::fromUtf8(attr->name);
+            QString value = QString::fromUtf8(attr->value);
+            Reference reference;
+            reference.bookpath = update.bookpath;
+            reference.element = tag;
+            reference.removed = true;
+
+            if (name == "srcset") {
+                QStringList kept;
+                foreach(QString candidate, value.split(',', Qt::SkipEmptyParts)) {
+                    reference.target = TargetBookPath(candidate.trimmed().section(' ', 0, 0), startdir);
+                    if (removed.contains(reference.target)) {
+                        update.references.append(reference);
+                    } else {
+                        kept.append(candidate.trimmed());
+                    }
+                }
+                if (kept.isEmpty()) {
+                    gumbo_element_remove_attribute(element, attr);
+                    update.changed = true;
+                } else if (kept.count() < value.split(',', Qt::SkipEmptyParts).count()) {
+                    gumbo_attribute_set_value(attr, kept.join(", ").toUtf8().constData());
+                    update.changed = true;
+                }
+                continue;
+            }
+
+            if (!FILE_ATTRIBUTES.contains(name) && (name != "poster")) {
+                continue;
+            }
+            reference.target = TargetBookPath(value, startdir);
+            if (!removed.contains(reference.target)) {
+                continue;
+            }
+            update.changed = true;
+            if ((tag == "a") || (tag == "area") || (name == "poster")) {
+                GumboNode *item = node->parent;
+                if (is_nav && (tag == "a") && item && (item->type == GUMBO_NODE_ELEMENT) &&
+                    (item->v.element.tag == GUMBO_TAG_LI) && !HasNestedList(item)) {
+                    reference.element = "li";
+                    doomed.append(item);
+                } else {
+                    gumbo_element_remove_attribute(element, attr);
+                }
+            } else {
+                doomed.append(node);
+            }
+            update.references.append(reference);
+        }
+    }
+
+    // A node inside another one being removed goes with it, so all
+    // are picked before any is destroyed
+    QSet<GumboNode *> doomed_set(doomed.begin(), doomed.end());
+    QList<GumboNode *> outermost;
+    foreach(GumboNode *node, doomed_set) {
+        bool inside_doomed = false;
+        for (GumboNode *ancestor = node->parent; ancestor; ancestor = ancestor->parent) {
+            if (doomed_set.contains(ancestor)) {
+                inside_doomed = true;
+                break;
+            }
+        }
+        if (!inside_doomed && node->parent) {
+            outermost.append(node);
+        }
+    }
+    foreach(GumboNode *node, outermost) {
+        gumbo_remove_from_parent(node);
+        gumbo_destroy_node(node);
+    }
+
+    // what is still there, such as a url in a style, is only reported
+    foreach(QString ref, gi.get_all_link_targets()) {
+        QString target = TargetBookPath(ref, startdir);
+        if (removed.contains(target)) {
+            Reference reference;
+            reference.bookpath = update.bookpath;
+            reference.target = target;
+            reference.element = "style";
+            update.references.append(reference);
+        }
+    }
+
+    if (update.changed) {
+        update.text = CleanSource::CharToEntity(gi.getxhtml(), html_resource->GetEpubVersion());
+    }
+    return update;
+}
+
+
+// Runs in a worker thread.  Only the removed entries are cut out,
+// the rest of the source is left exactly as it is.
+DeletePlan::FileUpdate DeletePlan::PruneNCX(TextResource *ncx_resource, const QSet<QString> &removed)
+{
+    FileUpdate update;
+    update.resource = ncx_resource;
+    update.bookpath = ncx_resource->GetRelativePath();
+    TextResource::TextSnapshot snapshot = ncx_resource->GetTextSnapshot();
+    update.revision = snapshot.revision;
+    const QString &source = snapshot.text;
+    QString startdir = Utility::startingDir(update.bookpath);
+
+    QList<std::pair<int, int>> cuts;
+    TagLister taglist(source);
+    for (int i = 0; i < static_cast<int>(taglist.size()); ++i) {
+        TagLister::TagInfo ti = taglist.at(i);
+        if (((ti.ttype != "begin") && (ti.ttype != "single")) || (ti.tname != "content")) {
+            continue;
+        }
+        TagLister::AttInfo ainfo;
+        TagLister::parseAttribute(QStringView(source).mid(ti.pos, ti.len), "src", ainfo);
+        if (ainfo.vpos < 0) {
+            continue;
+        }
+        Reference reference;
+        reference.bookpath = update.bookpath;
+        reference.target = TargetBookPath(Utility::DecodeXML(ainfo.avalue), startdir);
+        reference.element = "content";
+        if (!removed.contains(reference.target)) {
+            continue;
+        }
+        int open = taglist.findParentTag(i);
+        int close = open >= 0 ? taglist.findCloseTagForOpen(open) : -1;
+        if ((close > open) && !HasNestedEntry(taglist, open, close)) {
+            TagLister::TagInfo open_tag = taglist.at(open);
+            TagLister::TagInfo close_tag = taglist.at(close);
+            reference.element = open_tag.tname;
+            reference.removed = true;
+            // along with the indent and line break in front of it
+            int start = open_tag.pos;
+            while ((start > 0) && ((source.at(start - 1) == ' ') || (source.at(start - 1) == '\t'))) {
+                start--;
+            }
+            if ((start > 0) && (source.at(start - 1) == '\n')) {
+                start--;
+            }
+            cuts.append(std::make_pair(start, close_tag.pos + close_tag.len));
+        }
+        update.references.append(reference);
+    }
+
+    if (cuts.isEmpty()) {
+        return update;
+    }
+    std::sort(cuts.begin(), cuts.end());
+    update.text.reserve(source.length());
+    int pos = 0;
+    foreach(const auto &cut, cuts) {
+        update.text.append(QStringView(source).mid(pos, cut.first - pos));
+        pos = cut.second;
+    }
+    update.text.append(QStringView(source).mid(pos));
+    update.changed = true;
+    return update;
+}
+
+
+QString DeletePlan::TargetBookPath(const QString &ref, const QString &startdir)
+{
+    // external links and data urls never name a file in the book
+    if (ref.contains(':')) {
+        return QString();
+    }
+    QString path = QUrl(ref).path();
+    if (path.isEmpty()) {
+        return QString();
+    }
+    return Utility::buildBookPath(path, startdir);
+}
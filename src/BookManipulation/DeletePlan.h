@@ -0,0 +1,129 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef DELETEPLAN_H
+#define DELETEPLAN_H
+
+#include <QtCore/QList>
+#include <QtCore/QSet>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QString>
+
+class Book;
+class HTMLResource;
+class Resource;
+class TextResource;
+
+/**
+ * Removes files from a book together with the references to them.
+ *
+ * The reference index names the html files that refer to the files
+ * being removed, so only those and the NCX are parsed, each once and
+ * all in parallel.  In them an image, stylesheet, script or other
+ * embedded file that names a removed file is removed, a link to one
+ * loses its href, and a Nav or NCX entry for a removed file is
+ * removed when it has no entries inside it.  The OPF manifest, spine,
+ * guide and cover are then updated with a single write.
+ *
+ * A reference that can not be removed on its own, such as a url in a
+ * style, is left and reported.
+ */
+class DeletePlan
+{
+
+public:
+
+    /**
+     * A reference to a removed file.
+     */
+    struct Reference {
+        // the file that holds it
+        QString bookpath;
+        // the removed file it names
+        QString target;
+        // the element it is in, as "img" or "navPoint"
+        QString element;
+        // false if it was left in place
+        bool removed = false;
+    };
+
+    DeletePlan(QSharedPointer<Book> book, const QList<Resource *> &resources);
+
+    /**
+     * Finds the references to the files and works out the new text
+     * of every file that holds some.  Called by Apply if not before,
+     * for a caller that first wants to show what will happen.
+     */
+    void Prepare();
+
+    /**
+     * The references found by Prepare.
+     */
+    QList<Reference> GetReferences() const;
+
+    /**
+     * Updates the files that refer to the removed ones and then
+     * removes the files.
+     */
+    void Apply();
+
+private:
+
+    struct FileUpdate {
+        TextResource *resource = NULL;
+        QString bookpath;
+        quint64 revision = 0;
+        QString text;
+        bool changed = false;
+        QList<Reference> references;
+    };
+
+    // Run in worker threads.
+    static FileUpdate PruneHTML(HTMLResource *html_resource, const QSet<QString> &removed, bool is_nav);
+    static FileUpdate PruneNCX(TextResource *ncx_resource, const QSet<QString> &removed);
+
+    FileUpdate Prune(TextResource *resource) const;
+
+    static QString TargetBookPath(const QString &ref, const QString &startdir);
+
+
+    ///////////////////////////////
+    // PRIVATE MEMBER VARIABLES
+    ///////////////////////////////
+
+    QSharedPointer<Book> m_Book;
+
+    QList<Resource *> m_Resources;
+
+    /**
+     * The book paths of m_Resources.
+     */
+    QSet<QString> m_Removed;
+
+    HTMLResource *m_NavResource;
+
+    bool m_Prepared;
+
+    QList<FileUpdate> m_Updates;
+};
+
+#endif // DELETEPLAN_H
@@ -34,6 +34,11 @@
 #include <QDebug>
 
 #include "BookManipulation/FolderKeeper.h"
+#include "BookManipulation/ReferenceIndex.h"
+#include "BookManipulation/FragmentIndex.h"
+#include "BookManipulation/TextCountMonitor.h"
+#include "BookManipulation/WellFormedMonitor.h"
+#include "BookManipulation/ReportCache.h"
 #include "sigil_constants.h"
 #include "sigil_exception.h"
 #include "ResourceObjects/AudioResource.h"
@@ -66,17 +71,48 @@ static const QString CONTAINER_XML       = "<?xml version=\"1.0\" encoding=\"UTF
         "   </rootfiles>\n"
         "</container>\n";
 
+// How often the text held in memory is checked against its budget
+static const int TEXT_BUDGET_CHECK_MS = 30000;
+
+// File change notifications are collected for this long so that a tool
+// rewriting many files is handled as one batch
+static const int FILE_CHANGE_DELAY_MS = 250;
+
 FolderKeeper::FolderKeeper(QObject *parent)
     :
     QObject(parent),
     m_OPF(NULL),
     m_NCX(NULL),
+    m_SortedHTMLRevision(0),
+    m_SortedHTMLValid(false),
     m_FSWatcher(new QFileSystemWatcher()),
+    m_ReferenceIndex(new ReferenceIndex(this)),
+    m_FragmentIndex(new FragmentIndex(this)),
+    m_WellFormedMonitor(new WellFormedMonitor(this)),
+    m_TextCountMonitor(new TextCountMonitor(this)),
+    m_ReportCache(new ReportCache(this)),
+    m_WatchingSuspended(false),
+    m_DeferredFiles(NULL),
     m_FullPathToMainFolder(m_TempFolder.GetPath())
 {
     CreateGroupToFoldersMap();
+    m_FileChangeTimer.setSingleShot(true);
+    m_FileChangeTimer.setInterval(FILE_CHANGE_DELAY_MS);
     connect(m_FSWatcher, SIGNAL(fileChanged(const QString &)),
             this,        SLOT(ResourceFileChanged(const QString &)), Qt::DirectConnection);
+    connect(m_FSWatcher, SIGNAL(directoryChanged(const QString &)),
+            this,        SLOT(WatchedFolderChanged(const QString &)), Qt::DirectConnection);
+    connect(&m_FileChangeTimer, SIGNAL(timeout()), this, SLOT(ProcessFileChanges()));
+    connect(this,             SIGNAL(ResourceRemoved(const Resource *)),
+            m_ReferenceIndex, SLOT(Forget(const Resource *)));
+    connect(this,             SIGNAL(ResourceRemoved(const Resource *)),
+            m_FragmentIndex,  SLOT(Forget(const Resource *)));
+    connect(this,             SIGNAL(ResourceRemoved(const Resource *)),
+            m_ReportCache,    SLOT(Forget(const Resource *)));
+    connect(this,               SIGNAL(ResourceRemoved(const Resource *)),
+            m_TextCountMonitor, SLOT(Forget(const Resource *)));
+    connect(&m_TextBudgetTimer, SIGNAL(timeout()), this, SLOT(EnforceTextMemoryBudget()));
+    m_TextBudgetTimer.start(TEXT_BUDGET_CHECK_MS);
 }
 
 
@@ -91,12 +127,18 @@ FolderKeeper::~FolderKeeper()
         m_FSWatcher = 0;
     }
 
+    // Deleting the resources below must not extract their files first
+    delete m_DeferredFiles;
+    m_DeferredFiles = NULL;
+
     foreach(Resource *resource, m_Resources.values()) {
         // We disconnect the Deleted signal, since if we don't
         // the OPF will try to update itself on every resource
         // removal (and there's no point to that, FolderKeeper is dying).
         // Disconnecting this speeds up FolderKeeper destruction.
         disconnect(resource, SIGNAL(Deleted(const Resource *)), this, SLOT(RemoveResource(const Resource *)));
+        // the indexes forget it as they do for a single removal
+        emit ResourceRemoved(resource);
         resource->Delete();
     }
 }
@@ -159,8 +201,6 @@ Resource *FolderKeeper::AddContentFileToFolder(const QString &fullfilepath,
     QString group = DetermineFileGroup(norm_file_path, mt);
     QString resdesc = MediaTypes::instance()->GetResourceDescFromMediaType(mt, "Resource");
 
-    QDir folder(m_FullPathToMainFolder);
-
     Resource *resource = NULL;
     QString new_file_path;
 
@@ -175,7 +215,7 @@ Resource *FolderKeeper::AddContentFileToFolder(const QString &fullfilepath,
         if (!bookpath.isEmpty()) {
             // use the specified bookpath to determine both file name and location
             if (!Utility::startingDir(bookpath).isEmpty()) {
-                folder.mkpath(Utility::startingDir(bookpath));
+                MakeFolder(Utility::startingDir(bookpath));
             }
             new_file_path = m_FullPathToMainFolder + "/" + bookpath;
         } else {
@@ -190,7 +230,7 @@ Resource *FolderKeeper::AddContentFileToFolder(const QString &fullfilepath,
             QString folder_to_use = folderpath;
             if (folder_to_use == "\\") folder_to_use = GetDefaultFolderForGroup(group);
             if (!folder_to_use.isEmpty()) {
-                folder.mkpath(folder_to_use);
+                MakeFolder(folder_to_use);
                 new_file_path = m_FullPathToMainFolder + "/" + folder_to_use + "/" + filename;
             } else {
                 new_file_path = m_FullPathToMainFolder + "/" + filename;
@@ -231,6 +271,7 @@ Resource *FolderKeeper::AddContentFileToFolder(const QString &fullfilepath,
         }
 
         m_Resources[ resource->GetIdentifier() ] = resource;
+        AddToTypeBuckets(resource);
 
         // Note:  m_FullPathToMainFolder **never** ends with a "/"
         QString book_path = bookpath;
@@ -238,6 +279,7 @@ Resource *FolderKeeper::AddContentFileToFolder(const QString &fullfilepath,
             book_path = new_file_path.right(new_file_path.length() - m_FullPathToMainFolder.length() - 1);
         }
         m_Path2Resource[ book_path ] = resource;
+        AddToFileNameIndex(resource, book_path);
         resource->SetEpubVersion(m_OPF->GetEpubVersion());
         resource->SetMediaType(mt);
         resource->SetShortPathName(filename);
@@ -268,6 +310,15 @@ Resource *FolderKeeper::AddContentFileToFolder(const QString &fullfilepath,
     connect(resource, SIGNAL(Moved(const Resource *, QString)),
             this,     SLOT(ResourceMoved(const Resource *, QString)), Qt::DirectConnection);
 
+    XMLResource *xml_resource = qobject_cast<XMLResource *>(resource);
+    if (xml_resource) {
+        m_WellFormedMonitor->Watch(xml_resource);
+    }
+    HTMLResource *html_resource = qobject_cast<HTMLResource *>(resource);
+    if (html_resource) {
+        m_TextCountMonitor->Watch(html_resource);
+    }
+
     if (update_opf) {
         emit ResourceAdded(resource);
     }
@@ -276,6 +327,23 @@ Resource *FolderKeeper::AddContentFileToFolder(const QString &fullfilepath,
 }
 
 
+QList<Resource *> FolderKeeper::AddContentFilesToFolder(const QStringList &fullfilepaths)
+{
+    QList<Resource *> resources;
+    try {
+        foreach(const QString &fullfilepath, fullfilepaths) {
+            resources.append(AddContentFileToFolder(fullfilepath, false));
+        }
+    } catch (FileDoesNotExist&) {
+        // the files added so far still need their manifest entries
+        m_OPF->BulkAddResources(resources);
+        throw;
+    }
+    m_OPF->BulkAddResources(resources);
+    return resources;
+}
+
+
 QIcon FolderKeeper::GetFileIconFromMediaType(const QString& mt)
 {
     if (m_FileIconCache.contains(mt)) return m_FileIconCache[mt];
@@ -285,13 +353,81 @@ QIcon FolderKeeper::GetFileIconFromMediaType(const QString& mt)
 
 int FolderKeeper::GetHighestReadingOrder() const
 {
-    int count_of_html_resources = 0;
-    foreach(Resource * resource, m_Resources.values()) {
-        if (resource->Type() == Resource::HTMLResourceType) {
-            ++count_of_html_resources;
+    return m_TypeBuckets.value(&HTMLResource::staticMetaObject).count() - 1;
+}
+
+
+int FolderKeeper::GetSortedHTMLPosition(const Resource *resource) const
+{
+    QList<HTMLResource *> htmls;
+    QHash<const Resource *, int> positions;
+    GetSortedHTMLSnapshot(htmls, positions);
+    return positions.value(resource, -1);
+}
+
+
+QList<HTMLResource *> FolderKeeper::GetSortedHTMLResources() const
+{
+    QList<HTMLResource *> htmls;
+    QHash<const Resource *, int> positions;
+    GetSortedHTMLSnapshot(htmls, positions);
+    return htmls;
+}
+
+
+void FolderKeeper::GetSortedHTMLSnapshot(QList<HTMLResource *> &htmls, QHash<const Resource *, int> &positions) const
+{
+    // the spine order can only change with the text of the OPF
+    quint64 revision = m_OPF ? m_OPF->GetRevision() : 0;
+    {
+        QMutexLocker locker(&m_SortedHTMLMutex);
+        if (m_SortedHTMLValid && (revision == m_SortedHTMLRevision)) {
+            htmls = m_SortedHTML;
+            positions = m_SortedHTMLPositions;
+            return;
+        }
+    }
+    htmls = ListResourceSort(GetResourceTypeList<HTMLResource>(false));
+    positions.clear();
+    positions.reserve(htmls.count());
+    for (int i = 0; i < htmls.count(); ++i) {
+        positions.insert(htmls.at(i), i);
+    }
+    QMutexLocker locker(&m_SortedHTMLMutex);
+    m_SortedHTML = htmls;
+    m_SortedHTMLPositions = positions;
+    m_SortedHTMLRevision = revision;
+    m_SortedHTMLValid = true;
+}
+
+
+void FolderKeeper::AddToTypeBuckets(Resource *resource)
+{
+    m_TypeBuckets[resource->metaObject()].append(resource);
+    InvalidateSortedHTML();
+}
+
+
+void FolderKeeper::RemoveFromTypeBuckets(const Resource *resource)
+{
+    Resource *stored = const_cast<Resource *>(resource);
+    QHash<const QMetaObject *, QList<Resource *>>::iterator bucket = m_TypeBuckets.find(resource->metaObject());
+    if (bucket != m_TypeBuckets.end()) {
+        bucket.value().removeOne(stored);
+        if (bucket.value().isEmpty()) {
+            m_TypeBuckets.erase(bucket);
         }
     }
-    return count_of_html_resources - 1;
+    InvalidateSortedHTML();
+}
+
+
+void FolderKeeper::InvalidateSortedHTML() const
+{
+    QMutexLocker locker(&m_SortedHTMLMutex);
+    m_SortedHTMLValid = false;
+    m_SortedHTML.clear();
+    m_SortedHTMLPositions.clear();
 }
 
 
@@ -382,21 +518,42 @@ Resource *FolderKeeper::GetResourceByIdentifier(const QString &identifier) const
 // uses a case insensitive match since can be used on case insensitive file systems
 QString FolderKeeper::GetBookPathByPathEnd(const QString& path_end) const
 {
-    foreach(Resource *resource, m_Resources.values()) {
+    // only resources with the same file name can match
+    foreach(Resource *resource, m_FileNameIndex.value(FileNameKey(path_end))) {
         QString bookpath = resource->GetRelativePath();
         if (bookpath.endsWith(path_end, Qt::CaseInsensitive)) {
-            // make sure full file names match too
-            QString filename = bookpath.split('/').last();
-            QString othername = path_end.split('/').last();
-            if (filename.compare(othername, Qt::CaseInsensitive) == 0) {
-                return bookpath ;
-            }
+            return bookpath ;
         }
     }
     return "";
 }
 
 
+QString FolderKeeper::FileNameKey(const QString &bookpath)
+{
+    return bookpath.mid(bookpath.lastIndexOf('/') + 1).toCaseFolded();
+}
+
+
+void FolderKeeper::AddToFileNameIndex(Resource *resource, const QString &bookpath)
+{
+    m_FileNameIndex[FileNameKey(bookpath)].append(resource);
+}
+
+
+void FolderKeeper::RemoveFromFileNameIndex(const Resource *resource, const QString &bookpath)
+{
+    Resource *stored = const_cast<Resource *>(resource);
+    QHash<QString, QList<Resource *>>::iterator names = m_FileNameIndex.find(FileNameKey(bookpath));
+    if (names != m_FileNameIndex.end()) {
+        names.value().removeOne(stored);
+        if (names.value().isEmpty()) {
+            m_FileNameIndex.erase(names);
+        }
+    }
+}
+
+
 // a Book path is the path from the m_MainFolder to that file O(1) as a hash
 Resource *FolderKeeper::GetResourceByBookPath(const QString &bookpath) const
 {
@@ -423,6 +580,36 @@ OPFResource *FolderKeeper::GetOPF() const
 }
 
 
+ReferenceIndex *FolderKeeper::GetReferenceIndex() const
+{
+    return m_ReferenceIndex;
+}
+
+
+FragmentIndex *FolderKeeper::GetFragmentIndex() const
+{
+    return m_FragmentIndex;
+}
+
+
+ReportCache *FolderKeeper::GetReportCache() const
+{
+    return m_ReportCache;
+}
+
+
+WellFormedMonitor *FolderKeeper::GetWellFormedMonitor() const
+{
+    return m_WellFormedMonitor;
+}
+
+
+TextCountMonitor *FolderKeeper::GetTextCountMonitor() const
+{
+    return m_TextCountMonitor;
+}
+
+
 // Note this routine can now return nullptr on epub3
 NCXResource *FolderKeeper::GetNCX() const
 {
@@ -446,7 +633,9 @@ OPFResource*FolderKeeper::AddOPFToFolder(const QString &version, const QString &
     m_OPF->SetMediaType("application/oebps-package+xml");
     m_OPF->SetShortPathName(OPFBookPath.split('/').last());
     m_Resources[ m_OPF->GetIdentifier() ] = m_OPF;
+    AddToTypeBuckets(m_OPF);
     m_Path2Resource[ m_OPF->GetRelativePath() ] = m_OPF;
+    AddToFileNameIndex(m_OPF, m_OPF->GetRelativePath());
     // cache file icons by media type
     QFileInfo fi(m_OPF->GetFullPath());
     if (!m_FileIconCache.contains("application/oebps-package+xml")) {
@@ -470,6 +659,20 @@ OPFResource*FolderKeeper::AddOPFToFolder(const QString &version, const QString &
 }
 
 
+// Only called with m_AccessMutex held.  Every file added to a folder
+// used to ask the file system whether the folder was there, which is
+// slow when the temp folder is on a network drive.
+void FolderKeeper::MakeFolder(const QString &folderpath)
+{
+    if (m_FoldersMade.contains(folderpath)) {
+        return;
+    }
+    QDir folder(m_FullPathToMainFolder);
+    folder.mkpath(folderpath);
+    m_FoldersMade.insert(folderpath);
+}
+
+
 void FolderKeeper::UpdateContainerXML(const QString& FullPathToMainFolder, const QString& opfbookpath)
 {
     QDir folder(FullPathToMainFolder);
@@ -502,7 +705,9 @@ NCXResource*FolderKeeper::AddNCXToFolder(const QString &version,
     m_NCX->FillWithDefaultText(version, textdir);
     m_NCX->SetMainID(m_OPF->GetMainIdentifierValue());
     m_Resources[ m_NCX->GetIdentifier() ] = m_NCX;
+    AddToTypeBuckets(m_NCX);
     m_Path2Resource[ m_NCX->GetRelativePath() ] = m_NCX;
+    AddToFileNameIndex(m_NCX, m_NCX->GetRelativePath());
     // cache file icons by media type
     QFileInfo fi(m_NCX->GetFullPath());
     if (!m_FileIconCache.contains("application/x-dtbncx+xml")) {
@@ -567,13 +772,12 @@ void FolderKeeper::BulkRemoveResources(const QList<Resource *>resources)
     foreach(Resource * resource, resources) {
         m_Resources.remove(resource->GetIdentifier());
         m_Path2Resource.remove(resource->GetRelativePath());
-
-        if (m_FSWatcher->files().contains(resource->GetFullPath())) {
-            m_FSWatcher->removePath(resource->GetFullPath());
-        }
-
-        m_SuspendedWatchedFiles.removeAll(resource->GetFullPath());
+        RemoveFromFileNameIndex(resource, resource->GetRelativePath());
+        RemoveFromTypeBuckets(resource);
+        UnwatchResourceFile(resource->GetFullPath());
         disconnect(resource, SIGNAL(Deleted(const Resource *)), this, SLOT(RemoveResource(const Resource *)));
+        // the indexes forget it as they do for a single removal
+        emit ResourceRemoved(resource);
         resource->Delete();
     }
 }
@@ -582,12 +786,9 @@ void FolderKeeper::RemoveResource(const Resource *resource)
 {
     m_Resources.remove(resource->GetIdentifier());
     m_Path2Resource.remove(resource->GetRelativePath());
-
-    if (m_FSWatcher->files().contains(resource->GetFullPath())) {
-        m_FSWatcher->removePath(resource->GetFullPath());
-    }
-
-    m_SuspendedWatchedFiles.removeAll(resource->GetFullPath());
+    RemoveFromFileNameIndex(resource, resource->GetRelativePath());
+    RemoveFromTypeBuckets(resource);
+    UnwatchResourceFile(resource->GetFullPath());
     emit ResourceRemoved(resource);
 }
 
@@ -606,9 +807,12 @@ void FolderKeeper::BulkRenameResources(const QList<Resource *> resources, const
             QString newbookpath = rsc->GetRelativePath();
             m_Path2Resource.remove(oldbookpath);
             m_Path2Resource[newbookpath] = rsc;
+            RemoveFromFileNameIndex(rsc, oldbookpath);
+            AddToFileNameIndex(rsc, newbookpath);
         }
     }
     m_OPF->BulkResourcesRenamed(renamedDict);
+    InvalidateSortedHTML();
     updateShortPathNames();
 }
 
@@ -621,9 +825,12 @@ void FolderKeeper::ResourceRenamed(const Resource *resource, const QString &old_
     Resource * res = m_Path2Resource[book_path];
     m_Path2Resource.remove(book_path);
     m_Path2Resource[resource->GetRelativePath()] = res;
+    RemoveFromFileNameIndex(resource, book_path);
+    AddToFileNameIndex(res, resource->GetRelativePath());
     if (resource != m_OPF) {
         m_OPF->ResourceRenamed(resource, old_full_path);
     }
+    InvalidateSortedHTML();
     updateShortPathNames();
 }
 
@@ -644,6 +851,7 @@ void FolderKeeper::BulkMoveResources(const QList<Resource *>resources, const QSt
         }
     }
     m_OPF->BulkResourcesMoved(movedDict);
+    InvalidateSortedHTML();
     updateShortPathNames();
 }
 
@@ -656,42 +864,122 @@ void FolderKeeper::ResourceMoved(const Resource *resource, const QString &old_fu
     m_Path2Resource.remove(book_path);
     m_Path2Resource[resource->GetRelativePath()] = res;
     m_OPF->ResourceMoved(resource, old_full_path);
+    InvalidateSortedHTML();
     updateShortPathNames();
 }
 
-void FolderKeeper::ResourceFileChanged(const QString &path) const
+void FolderKeeper::ResourceFileChanged(const QString &path)
+{
+    m_ChangedFiles.insert(path);
+    m_FileChangeTimer.start();
+}
+
+
+void FolderKeeper::WatchedFolderChanged(const QString &folder)
 {
-    // The file may have been deleted prior to writing a new version - give it a chance to write.
-    QTime wake_time = QTime::currentTime().addMSecs(1000);
+    foreach(const QString &path, m_WatchedFolders.value(folder)) {
+        m_ChangedFiles.insert(path);
+    }
+    m_FileChangeTimer.start();
+}
 
-    while (!QFile::exists(path) && QTime::currentTime() < wake_time) {
-        QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+
+void FolderKeeper::ProcessFileChanges()
+{
+    // ResumeWatchingResources drops whatever Sigil itself changed
+    if (m_WatchingSuspended) {
+        return;
     }
 
-    // The signal is also received after resource files are removed / renamed,
-    // but it can be safely ignored because QFileSystemWatcher automatically stops watching them.
-    if (QFile::exists(path)) {
+    QSet<QString> changed_files = m_ChangedFiles;
+    m_ChangedFiles.clear();
+    QStringList watched = m_FSWatcher->files();
+    foreach(const QString &path, changed_files) {
+        // A file that is missing is probably being replaced, the
+        // folder notification will bring it back here once it is.
+        if (!m_WatchedFiles.contains(path) || !QFile::exists(path)) {
+            continue;
+        }
+
+        FileStamp stamp = GetFileStamp(path);
+        if (stamp == m_WatchedFiles.value(path)) {
+            continue;
+        }
+        m_WatchedFiles[path] = stamp;
+
         // Some editors write the updated contents to a temporary file
         // and then atomically move it over the watched file.
         // In this case QFileSystemWatcher loses track of the file, so we have to add it again.
-        if (!m_FSWatcher->files().contains(path)) {
+        if (!watched.contains(path)) {
             m_FSWatcher->addPath(path);
         }
 
-        foreach(Resource *resource, m_Resources.values()) {
-            if (resource->GetFullPath() == path) {
-                resource->FileChangedOnDisk();
-                return;
-            }
+        // Note:  m_FullPathToMainFolder **never** ends with a "/"
+        QString book_path = path.right(path.length() - m_FullPathToMainFolder.length() - 1);
+        Resource *resource = m_Path2Resource.value(book_path, NULL);
+        if (resource) {
+            resource->FileChangedOnDisk();
+        }
+    }
+}
+
+
+FolderKeeper::FileStamp FolderKeeper::GetFileStamp(const QString &path)
+{
+    QFileInfo fi(path);
+    FileStamp stamp;
+    stamp.modified = fi.lastModified().toMSecsSinceEpoch();
+    stamp.size = fi.size();
+    return stamp;
+}
+
+
+void FolderKeeper::EnforceTextMemoryBudget()
+{
+    qint64 budget = static_cast<qint64>(SettingsStore().textMemoryBudget()) * 1024 * 1024;
+    if (budget <= 0) {
+        return;
+    }
+
+    QList<TextResource *> text_resources = GetResourceTypeList<TextResource>();
+    qint64 total = 0;
+    QList<std::pair<quint64, TextResource *>> by_access;
+    foreach(TextResource *text_resource, text_resources) {
+        total += text_resource->GetTextMemorySize();
+        by_access.append(std::make_pair(text_resource->GetLastAccess(), text_resource));
+    }
+    if (total <= budget) {
+        return;
+    }
+
+    std::sort(by_access.begin(), by_access.end(),
+              [](const std::pair<quint64, TextResource *> &a, const std::pair<quint64, TextResource *> &b) {
+                  return a.first < b.first;
+              });
+    for (const auto &entry : by_access) {
+        if (total <= budget) {
+            break;
+        }
+        qint64 size = entry.second->GetTextMemorySize();
+        if (entry.second->EvictText()) {
+            total -= size;
         }
     }
 }
 
+
 void FolderKeeper::WatchResourceFile(const Resource *resource)
 {
     if (OpenExternally::mayOpen(resource->Type())) {
-        if (!m_FSWatcher->files().contains(resource->GetFullPath())) {
-            m_FSWatcher->addPath(resource->GetFullPath());
+        QString path = resource->GetFullPath();
+        if (!m_WatchedFiles.contains(path)) {
+            m_WatchedFiles.insert(path, GetFileStamp(path));
+            m_FSWatcher->addPath(path);
+            QString folder = QFileInfo(path).absolutePath();
+            if (!m_WatchedFolders.contains(folder)) {
+                m_FSWatcher->addPath(folder);
+            }
+            m_WatchedFolders[folder].insert(path);
         }
 
         // when the file is changed externally, mark the owning Book as modified
@@ -701,24 +989,78 @@ void FolderKeeper::WatchResourceFile(const Resource *resource)
     }
 }
 
+
+void FolderKeeper::UnwatchResourceFile(const QString &path)
+{
+    if (!m_WatchedFiles.contains(path)) {
+        return;
+    }
+    m_WatchedFiles.remove(path);
+    m_ChangedFiles.remove(path);
+    m_FSWatcher->removePath(path);
+    QString folder = QFileInfo(path).absolutePath();
+    QHash<QString, QSet<QString>>::iterator files = m_WatchedFolders.find(folder);
+    if (files != m_WatchedFolders.end()) {
+        files.value().remove(path);
+        if (files.value().isEmpty()) {
+            m_WatchedFolders.erase(files);
+            m_FSWatcher->removePath(folder);
+        }
+    }
+}
+
+
 void FolderKeeper::SuspendWatchingResources()
 {
-    if (m_SuspendedWatchedFiles.isEmpty() && !m_FSWatcher->files().isEmpty()) {
-        m_SuspendedWatchedFiles.append(m_FSWatcher->files());
-        m_FSWatcher->removePaths(m_SuspendedWatchedFiles);
+    m_WatchingSuspended = true;
+}
+
+
+void FolderKeeper::DeferExtraction(const QString &zippath, const QList<DeferredFiles::Entry> &entries)
+{
+    delete m_DeferredFiles;
+    m_DeferredFiles = new DeferredFiles(zippath, entries);
+    m_DeferredFiles->Start();
+}
+
+
+void FolderKeeper::WaitForDeferredFiles()
+{
+    if (m_DeferredFiles) {
+        m_DeferredFiles->WaitForAll();
     }
 }
 
+
 void FolderKeeper::ResumeWatchingResources()
 {
-    if (!m_SuspendedWatchedFiles.isEmpty()) {
-        foreach(QString path, m_SuspendedWatchedFiles) {
-            if (QFile::exists(path)) {
-                m_FSWatcher->addPath(path);
+    if (!m_WatchingSuspended) {
+        return;
+    }
+    m_WatchingSuspended = false;
+
+    // Whatever happened to the watched files meanwhile was done by
+    // Sigil, so take their current state as the one to compare against.
+    // Files moved or renamed away are no longer watched, as before.
+    // Saving replaces a file with a new one, which QFileSystemWatcher
+    // loses track of, so those are added again.
+    QStringList gone;
+    QStringList still_watched = m_FSWatcher->files();
+    QHash<QString, FileStamp>::iterator watched;
+    for (watched = m_WatchedFiles.begin(); watched != m_WatchedFiles.end(); ++watched) {
+        if (QFile::exists(watched.key())) {
+            watched.value() = GetFileStamp(watched.key());
+            if (!still_watched.contains(watched.key())) {
+                m_FSWatcher->addPath(watched.key());
             }
+        } else {
+            gone.append(watched.key());
         }
-        m_SuspendedWatchedFiles.clear();
     }
+    foreach(const QString &path, gone) {
+        UnwatchResourceFile(path);
+    }
+    m_ChangedFiles.clear();
 }
 
 
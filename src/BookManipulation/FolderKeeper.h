@@ -24,11 +24,17 @@
 #ifndef FOLDERKEEPER_H
 #define FOLDERKEEPER_H
 
+#include <algorithm>
+#include <climits>
+#include <utility>
+
 #include <QtCore/QObject>
 #include <QtCore/QString>
 #include <QtCore/QHash>
 #include <QtCore/QList>
 #include <QtCore/QMutex>
+#include <QtCore/QSet>
+#include <QtCore/QTimer>
 #include <QFileSystemWatcher>
 #include <QIcon>
 
@@ -42,9 +48,15 @@
 #include "ResourceObjects/SVGResource.h"
 #include "ResourceObjects/OPFResource.h"
 
+#include "Misc/DeferredFiles.h"
 #include "Misc/TempFolder.h"
 
 class NCXResource;
+class ReferenceIndex;
+class FragmentIndex;
+class WellFormedMonitor;
+class TextCountMonitor;
+class ReportCache;
 
 /**
  * Stores the resources of a book.
@@ -97,6 +109,15 @@ public:
                                      const QString &bookpath = QString(),
                                      const QString &folderpath = QString("\\"));
 
+    /**
+     * Adds many files to the default folders for their types with a
+     * single update of the OPF manifest and spine at the end.
+     *
+     * @param fullfilepaths The full paths to the files to add.
+     * @return The newly created resources, in the order of the paths.
+     */
+    QList<Resource *> AddContentFilesToFolder(const QStringList &fullfilepaths);
+
 
     QIcon GetFileIconFromMediaType(const QString &mt);
 
@@ -109,6 +130,14 @@ public:
      */
     int GetHighestReadingOrder() const;
 
+    /**
+     * Returns the position of an html file in reading order, as in
+     * GetResourceTypeList<HTMLResource>(true), without a search.
+     *
+     * @return The position, -1 if the resource is not an html file.
+     */
+    int GetSortedHTMLPosition(const Resource *resource) const;
+
     /**
      * Returns a book-wide unique filename. Given a filename,
      * if a file with the same name already exists, a number suffix
@@ -167,7 +196,8 @@ public:
     // Non-throw version also available returns NULL if no resource matches
     Resource *GetResourceByBookPathNoThrow(const QString &bookpath) const;
 
-    // this is O(n) but no filesystem is queried
+    // looks only at the resources with the same file name, held
+    // in m_FileNameIndex, and no filesystem is queried
     QString GetBookPathByPathEnd(const QString& path_end) const;
     
 
@@ -188,6 +218,42 @@ public:
      */
     NCXResource *GetNCX() const;
 
+    /**
+     * Returns the index of which html files refer to each book path.
+     *
+     * @return The reference index.
+     */
+    ReferenceIndex *GetReferenceIndex() const;
+
+    /**
+     * Returns the index of the ids of the html files and the links
+     * into them.
+     *
+     * @return The fragment index.
+     */
+    FragmentIndex *GetFragmentIndex() const;
+
+    /**
+     * Returns the store of what each html file adds to the Reports.
+     *
+     * @return The report cache.
+     */
+    ReportCache *GetReportCache() const;
+
+    /**
+     * Returns the background checker of edited xml files.
+     *
+     * @return The well formed monitor.
+     */
+    WellFormedMonitor *GetWellFormedMonitor() const;
+
+    /**
+     * Returns the live word and character counts of the html files.
+     *
+     * @return The text count monitor.
+     */
+    TextCountMonitor *GetTextCountMonitor() const;
+
     NCXResource* AddNCXToFolder(const QString &version,
                                 const QString& bookpath=QString(),
                                 const QString& first_textdir=QString("\\"));
@@ -232,10 +298,24 @@ public:
 
     /**
      * Dueing Save operations from Sigil we need to suspend/resume file watching.
+     * The watches stay in place; changes made while suspended are ignored.
      */
     void SuspendWatchingResources();
     void ResumeWatchingResources();
 
+    /**
+     * Leaves the given files of the epub at zippath in the archive
+     * and starts extracting them in the background.  Their files in
+     * the book folder stay empty until then.
+     */
+    void DeferExtraction(const QString &zippath, const QList<DeferredFiles::Entry> &entries);
+
+    /**
+     * Returns once every file left in the archive by DeferExtraction
+     * has been extracted.
+     */
+    void WaitForDeferredFiles();
+
 signals:
 
     /**
@@ -282,7 +362,26 @@ private slots:
     /**
      * Called by the FSWatcher when a watched file has changed on disk.
      */
-    void ResourceFileChanged(const QString &path) const;
+    void ResourceFileChanged(const QString &path);
+
+    /**
+     * Called by the FSWatcher when a file in the folder of a watched
+     * file is created, removed or renamed, which is how editors that
+     * save by replacing the file show up.
+     */
+    void WatchedFolderChanged(const QString &folder);
+
+    /**
+     * Hands the files that really changed since the last burst
+     * of notifications to their resources.
+     */
+    void ProcessFileChanges();
+
+    /**
+     * Drops the text of the least recently read unchanged files
+     * until the text held in memory fits the budget set in the preferences.
+     */
+    void EnforceTextMemoryBudget();
 
 private:
 
@@ -292,6 +391,13 @@ private:
 
     QString buildShortName(const QString &bookpath, int lvl);
 
+    /**
+     * Makes a folder inside the main folder the first time it is asked for.
+     *
+     * @param folderpath The path of the folder relative to the main folder.
+     */
+    void MakeFolder(const QString &folderpath);
+
     /**
      * Dereferences two pointers and compares the values with "<".
      *
@@ -305,6 +411,45 @@ private:
     template<typename T>
     QList<T *> ListResourceSort(const QList<T *> &resource_list) const;
 
+    /**
+     * Returns the html files in reading order, sorted again
+     * only after the files or the OPF have changed.
+     */
+    QList<HTMLResource *> GetSortedHTMLResources() const;
+
+    /**
+     * Shared copies of the sorted html list and the position of each
+     * file in it, both made again only after the files or the OPF
+     * have changed.
+     */
+    void GetSortedHTMLSnapshot(QList<HTMLResource *> &htmls, QHash<const Resource *, int> &positions) const;
+
+    void AddToTypeBuckets(Resource *resource);
+
+    void RemoveFromTypeBuckets(const Resource *resource);
+
+    static QString FileNameKey(const QString &bookpath);
+    void AddToFileNameIndex(Resource *resource, const QString &bookpath);
+    void RemoveFromFileNameIndex(const Resource *resource, const QString &bookpath);
+
+    void InvalidateSortedHTML() const;
+
+    void UnwatchResourceFile(const QString &path);
+
+    /**
+     * The time stamp and size of a file, to tell real changes
+     * from repeated or stale notifications.
+     */
+    struct FileStamp {
+        qint64 modified;
+        qint64 size;
+        bool operator==(const FileStamp &other) const {
+            return (modified == other.modified) && (size == other.size);
+        }
+    };
+
+    static FileStamp GetFileStamp(const QString &path);
+
 
     ///////////////////////////////
     // PRIVATE MEMBER VARIABLES
@@ -331,6 +476,26 @@ private:
 
     QHash<QString, Resource *> m_Path2Resource;
 
+    /**
+     * The resources grouped by their most derived class, so that
+     * the resources of one type are found without looking at the rest.
+     */
+    QHash<const QMetaObject *, QList<Resource *>> m_TypeBuckets;
+
+    /**
+     * The resources with each file name, case folded, so that
+     * a path end only has to be checked against those.
+     */
+    QHash<QString, QList<Resource *>> m_FileNameIndex;
+
+    mutable QList<HTMLResource *> m_SortedHTML;
+    mutable QHash<const Resource *, int> m_SortedHTMLPositions;
+    mutable quint64 m_SortedHTMLRevision;
+    mutable bool m_SortedHTMLValid;
+    mutable QMutex m_SortedHTMLMutex;
+
+    QTimer m_TextBudgetTimer;
+
     /**
      * Ensures thread-safe access to the m_Resources hash.
      */
@@ -345,7 +510,57 @@ private:
      * Watches the files on disk for any changes in case the resources have been modified from outside Sigil.
      */
     QFileSystemWatcher *m_FSWatcher;
-    QStringList m_SuspendedWatchedFiles;
+
+    /**
+     * Limits the html files rename and move updates have to look at.
+     */
+    ReferenceIndex *m_ReferenceIndex;
+
+    /**
+     * Answers whether any link points at an undefined fragment.
+     */
+    FragmentIndex *m_FragmentIndex;
+
+    /**
+     * Checks edited xml files in the background.
+     */
+    WellFormedMonitor *m_WellFormedMonitor;
+
+    /**
+     * Counts the words of edited html files in the background.
+     */
+    TextCountMonitor *m_TextCountMonitor;
+
+    /**
+     * Lets the Reports dialog skip the html files that are unchanged.
+     */
+    ReportCache *m_ReportCache;
+
+    /**
+     * The watched files with their stamps when last seen.
+     */
+    QHash<QString, FileStamp> m_WatchedFiles;
+
+    /**
+     * The watched files in each watched folder.
+     */
+    QHash<QString, QSet<QString>> m_WatchedFolders;
+
+    /**
+     * Files notified about since the last ProcessFileChanges.
+     */
+    QSet<QString> m_ChangedFiles;
+
+    /**
+     * The folders inside the main folder already made, guarded by m_AccessMutex.
+     */
+    QSet<QString> m_FoldersMade;
+
+    QTimer m_FileChangeTimer;
+
+    bool m_WatchingSuspended;
+
+    DeferredFiles *m_DeferredFiles;
 
     QString m_FullPathToMainFolder;
 
@@ -359,11 +574,12 @@ template<class T>
 QList<T *> FolderKeeper::GetResourceTypeList(bool should_be_sorted) const
 {
     QList<T *> onetype_resources;
-    foreach(Resource * resource, m_Resources.values()) {
-        T *type_resource = qobject_cast<T *>(resource);
-
-        if (type_resource) {
-            onetype_resources.append(type_resource);
+    QHash<const QMetaObject *, QList<Resource *>>::const_iterator bucket;
+    for (bucket = m_TypeBuckets.constBegin(); bucket != m_TypeBuckets.constEnd(); ++bucket) {
+        if (bucket.key()->inherits(&T::staticMetaObject)) {
+            foreach(Resource *resource, bucket.value()) {
+                onetype_resources.append(static_cast<T *>(resource));
+            }
         }
     }
 
@@ -378,11 +594,15 @@ template<class T>
 QList<Resource *> FolderKeeper::GetResourceTypeAsGenericList(bool should_be_sorted) const
 {
     QList<Resource *> resources;
-    foreach(Resource * resource, m_Resources.values()) {
-        T *type_resource = qobject_cast<T *>(resource);
-
-        if (type_resource) {
-            resources.append(resource);
+    QHash<const QMetaObject *, QList<Resource *>>::const_iterator bucket;
+    for (bucket = m_TypeBuckets.constBegin(); bucket != m_TypeBuckets.constEnd(); ++bucket) {
+        if (bucket.key()->inherits(&T::staticMetaObject)) {
+            // a single matching bucket is handed out as a shared copy
+            if (resources.isEmpty()) {
+                resources = bucket.value();
+            } else {
+                resources.append(bucket.value());
+            }
         }
     }
 
@@ -394,6 +614,22 @@ QList<Resource *> FolderKeeper::GetResourceTypeAsGenericList(bool should_be_sort
 }
 
 
+// The sorted html list is kept between calls since nearly
+// every pass over the book asks for it.
+template<> inline
+QList<HTMLResource *> FolderKeeper::GetResourceTypeList<HTMLResource>(bool should_be_sorted) const
+{
+    if (should_be_sorted) {
+        return GetSortedHTMLResources();
+    }
+    QList<HTMLResource *> htmls;
+    foreach(Resource *resource, m_TypeBuckets.value(&HTMLResource::staticMetaObject)) {
+        htmls.append(static_cast<HTMLResource *>(resource));
+    }
+    return htmls;
+}
+
+
 template<typename T> inline
 QList<T *> FolderKeeper::ListResourceSort(const QList<T *> &resource_list)  const
 {
@@ -408,22 +644,23 @@ QList<T *> FolderKeeper::ListResourceSort(const QList<T *> &resource_list)  cons
 template<> inline
 QList<HTMLResource *> FolderKeeper::ListResourceSort<HTMLResource>(const QList<HTMLResource *> &resource_list) const
 {
-    QStringList spine_order_filenames = GetOPF()->GetSpineOrderBookPaths();
-    QList<HTMLResource *> htmls = resource_list;
+    QHash<QString, int> spine_positions = GetOPF()->GetSpinePositions();
+    QList<std::pair<int, HTMLResource *>> positioned;
+    foreach(HTMLResource *html, resource_list) {
+        // It's possible that there are certain HTML files in the
+        // given resource list that are not in the spine filenames,
+        // for several reasons. So we make sure they sort to the end
+        // of the list in the order they were given.
+        positioned.append(std::make_pair(spine_positions.value(html->GetRelativePath(), INT_MAX), html));
+    }
+    std::stable_sort(positioned.begin(), positioned.end(),
+                     [](const std::pair<int, HTMLResource *> &a, const std::pair<int, HTMLResource *> &b) {
+                         return a.first < b.first;
+                     });
     QList<HTMLResource *> sorted_htmls;
-    foreach(const QString & spine_filename, spine_order_filenames) {
-        for (int i = 0; i < htmls.count(); ++i) {
-            if (spine_filename == htmls[ i ]->GetRelativePath()) {
-                sorted_htmls.append(htmls.takeAt(i));
-                break;
-            }
-        }
+    for (const auto &entry : positioned) {
+        sorted_htmls.append(entry.second);
     }
-    // It's possible that there are certain HTML files in the
-    // given resource list that are not in the spine filenames,
-    // for several reasons. So we make sure we add them to the end
-    // of the sorted list.
-    sorted_htmls.append(htmls);
     return sorted_htmls;
 }
 
@@ -0,0 +1,256 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QtConcurrent/QtConcurrent>
+#include <QDebug>
+
+#include "BookManipulation/FragmentIndex.h"
+#include "Misc/Utility.h"
+#include "ResourceObjects/HTMLResource.h"
+
+#if 0
+#define DBG if(1)
+#else
+#define DBG if(0)
+#endif
+
+FragmentIndex::FragmentIndex(QObject *parent)
+    :
+    QObject(parent)
+{
+}
+
+
+std::tuple<bool, QString, QString> FragmentIndex::FindUndefinedFragment(const QList<HTMLResource *> &html_resources)
+{
+    Refresh(html_resources);
+
+    QMutexLocker locker(&m_AccessMutex);
+    if (!m_Broken.isEmpty()) {
+        foreach(HTMLResource *html_resource, html_resources) {
+            if (m_Broken.contains(html_resource)) {
+                const Entry &entry = m_Entries[html_resource];
+                return std::make_tuple(true, entry.broken.first(), entry.bookpath);
+            }
+        }
+    }
+    return std::make_tuple(false, QString(), QString());
+}
+
+
+QHash<QString, QSet<QString>> FragmentIndex::GetIds(const QList<HTMLResource *> &html_resources)
+{
+    Refresh(html_resources);
+
+    QMutexLocker locker(&m_AccessMutex);
+    QHash<QString, QSet<QString>> ids;
+    foreach(HTMLResource *html_resource, html_resources) {
+        const Entry &entry = m_Entries[html_resource];
+        ids.insert(entry.bookpath, entry.ids);
+    }
+    return ids;
+}
+
+
+QHash<QString, QStringList> FragmentIndex::GetIdLists(const QList<HTMLResource *> &html_resources)
+{
+    Refresh(html_resources);
+
+    QMutexLocker locker(&m_AccessMutex);
+    QHash<QString, QStringList> ids;
+    ids.reserve(html_resources.count());
+    foreach(HTMLResource *html_resource, html_resources) {
+        const Entry &entry = m_Entries[html_resource];
+        ids.insert(entry.bookpath, entry.ordered_ids);
+    }
+    return ids;
+}
+
+
+std::pair<int, qint64> FragmentIndex::MemoryUsage()
+{
+    QMutexLocker locker(&m_AccessMutex);
+    qint64 total = 0;
+    foreach(const Entry &entry, m_Entries) {
+        total += sizeof(Entry) + entry.bookpath.capacity() * sizeof(QChar) + entry.ordered_ids.capacity() * sizeof(QString);
+        foreach(const QString &id, entry.ids) {
+            total += id.capacity() * sizeof(QChar);
+        }
+        foreach(const Link &link, entry.links) {
+            total += sizeof(Link) + (link.href.capacity() + link.target.capacity() + link.id.capacity()) * sizeof(QChar);
+        }
+    }
+    return std::make_pair(static_cast<int>(m_Entries.count()), total);
+}
+
+
+void FragmentIndex::Forget(const Resource *resource)
+{
+    QMutexLocker locker(&m_AccessMutex);
+    QSet<const Resource *> recheck;
+    RemoveEntry(resource, recheck);
+    foreach(const Resource *referrer, recheck) {
+        CheckLinks(referrer);
+    }
+}
+
+
+void FragmentIndex::Refresh(const QList<HTMLResource *> &html_resources)
+{
+    QList<HTMLResource *> stale;
+    QList<const Resource *> dropped;
+    {
+        QMutexLocker locker(&m_AccessMutex);
+        QSet<const Resource *> current;
+        int known = 0;
+        foreach(HTMLResource *html_resource, html_resources) {
+            current.insert(html_resource);
+            QHash<const Resource *, Entry>::const_iterator it = m_Entries.constFind(html_resource);
+            if (it == m_Entries.constEnd()) {
+                stale.append(html_resource);
+                continue;
+            }
+            known++;
+            if ((it->revision != html_resource->GetRevision()) ||
+                (it->bookpath != html_resource->GetRelativePath())) {
+                stale.append(html_resource);
+            }
+        }
+        if (m_Entries.count() > known) {
+            foreach(const Resource *resource, m_Entries.keys()) {
+                if (!current.contains(resource)) {
+                    dropped.append(resource);
+                }
+            }
+        }
+    }
+    if (stale.isEmpty() && dropped.isEmpty()) {
+        return;
+    }
+
+    DBG qDebug() << "FragmentIndex reading" << stale.count() << "files and dropping" << dropped.count();
+    QList<Entry> entries = QtConcurrent::blockingMapped(stale, ReadEntry);
+
+    QMutexLocker locker(&m_AccessMutex);
+    // Besides the files read again, the files that link into any
+    // of them may have gained or lost a broken link
+    QSet<const Resource *> recheck;
+    foreach(const Resource *resource, dropped) {
+        RemoveEntry(resource, recheck);
+    }
+    foreach(const Resource *resource, stale) {
+        RemoveEntry(resource, recheck);
+    }
+    for (int i = 0; i < stale.count(); ++i) {
+        const Resource *resource = stale.at(i);
+        const Entry &entry = entries.at(i);
+        m_Entries.insert(resource, entry);
+        m_Files.insert(entry.bookpath, resource);
+        foreach(const Link &link, entry.links) {
+            m_Referrers[link.target].insert(resource);
+        }
+        recheck.insert(resource);
+    }
+    foreach(const Resource *resource, stale) {
+        recheck.unite(m_Referrers.value(m_Entries[resource].bookpath));
+    }
+    foreach(const Resource *resource, recheck) {
+        CheckLinks(resource);
+    }
+}
+
+
+// The caller must hold m_AccessMutex.
+void FragmentIndex::RemoveEntry(const Resource *resource, QSet<const Resource *> &recheck)
+{
+    if (!m_Entries.contains(resource)) {
+        return;
+    }
+    const Entry &entry = m_Entries[resource];
+    recheck.unite(m_Referrers.value(entry.bookpath));
+    recheck.remove(resource);
+    foreach(const Link &link, entry.links) {
+        QSet<const Resource *> &referrers = m_Referrers[link.target];
+        referrers.remove(resource);
+        if (referrers.isEmpty()) {
+            m_Referrers.remove(link.target);
+        }
+    }
+    if (m_Files.value(entry.bookpath) == resource) {
+        m_Files.remove(entry.bookpath);
+    }
+    m_Broken.remove(resource);
+    m_Entries.remove(resource);
+}
+
+
+// The caller must hold m_AccessMutex.
+void FragmentIndex::CheckLinks(const Resource *resource)
+{
+    if (!m_Entries.contains(resource)) {
+        return;
+    }
+    Entry &entry = m_Entries[resource];
+    entry.broken.clear();
+    foreach(const Link &link, entry.links) {
+        // only links into the book's own html files can be checked
+        const Resource *target = m_Files.value(link.target, NULL);
+        if (target && !m_Entries[target].ids.contains(link.id)) {
+            entry.broken.append(link.href);
+        }
+    }
+    if (entry.broken.isEmpty()) {
+        m_Broken.remove(resource);
+    } else {
+        m_Broken.insert(resource);
+    }
+}
+
+
+// Runs in a worker thread.
+FragmentIndex::Entry FragmentIndex::ReadEntry(HTMLResource *html_resource)
+{
+    Entry entry;
+    // Read the revision before the facts so an edit made in
+    // the meantime leaves the entry stale rather than wrong
+    entry.revision = html_resource->GetRevision();
+    entry.bookpath = html_resource->GetRelativePath();
+    QString htmldir = html_resource->GetFolder();
+    entry.ordered_ids = html_resource->GetParsedFact(HTMLResource::Fact_Ids);
+    foreach(const QString &id, entry.ordered_ids) {
+        entry.ids.insert(id);
+    }
+    foreach(QString ahref, html_resource->GetParsedFact(HTMLResource::Fact_RelativeAnchorHrefs)) {
+        // each href is relative to the file and raw
+        std::pair<QString, QString> hrefparts = Utility::parseRelativeHREF(ahref);
+        QString dest_id = hrefparts.second;
+        if (dest_id.startsWith("#")) dest_id = dest_id.mid(1, -1);
+        if (dest_id.isEmpty()) {
+            continue;
+        }
+        Link link;
+        link.href = ahref;
+        link.target = hrefparts.first.isEmpty() ? entry.bookpath : Utility::buildBookPath(hrefparts.first, htmldir);
+        link.id = dest_id;
+        entry.links.append(link);
+    }
+    return entry;
+}
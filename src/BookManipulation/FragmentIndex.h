@@ -0,0 +1,148 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef FRAGMENTINDEX_H
+#define FRAGMENTINDEX_H
+
+#include <tuple>
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+class Resource;
+class HTMLResource;
+
+/**
+ * Keeps the ids of every html file and the links with a fragment
+ * that each one makes, along with which of those links point at an
+ * id that does not exist.
+ *
+ * Only the files whose text or book path has changed since the last
+ * use are read again, and only their links and the links into them
+ * are checked again, so asking whether any fragment is broken costs
+ * about as much as the edits made since it was last asked.
+ */
+class FragmentIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    FragmentIndex(QObject *parent = NULL);
+
+    /**
+     * Looks for a link in html_resources to a fragment id that is
+     * not defined in the html file it points to.
+     *
+     * @return A tuple (undefined fragments exist?, href, bookpath
+     *         of the file with the href), the first one found in
+     *         the order html_resources are given.
+     */
+    std::tuple<bool, QString, QString> FindUndefinedFragment(const QList<HTMLResource *> &html_resources);
+
+    /**
+     * The ids defined in each of html_resources keyed on book path.
+     */
+    QHash<QString, QSet<QString>> GetIds(const QList<HTMLResource *> &html_resources);
+
+    /**
+     * The ids defined in each of html_resources keyed on book path,
+     * in the order they appear in the file.
+     */
+    QHash<QString, QStringList> GetIdLists(const QList<HTMLResource *> &html_resources);
+
+    /**
+     * The number of files indexed and roughly how many bytes
+     * are kept for them.
+     */
+    std::pair<int, qint64> MemoryUsage();
+
+public slots:
+
+    /**
+     * Drops everything known about a resource that has been removed.
+     */
+    void Forget(const Resource *resource);
+
+private:
+
+    struct Link {
+        QString href;
+        QString target;
+        QString id;
+    };
+
+    struct Entry {
+        quint64 revision;
+        QString bookpath;
+        QSet<QString> ids;
+        // the same ids in file order, sharing their strings with ids
+        QStringList ordered_ids;
+        QList<Link> links;
+        // the hrefs of links whose id is missing from their target
+        QStringList broken;
+    };
+
+    /**
+     * Brings the index up to date with html_resources, dropping
+     * the files that are no longer among them.
+     */
+    void Refresh(const QList<HTMLResource *> &html_resources);
+
+    // The caller must hold m_AccessMutex for these.
+    void RemoveEntry(const Resource *resource, QSet<const Resource *> &recheck);
+    void CheckLinks(const Resource *resource);
+
+    // Runs in a worker thread.
+    static Entry ReadEntry(HTMLResource *html_resource);
+
+
+    ///////////////////////////////
+    // PRIVATE MEMBER VARIABLES
+    ///////////////////////////////
+
+    QHash<const Resource *, Entry> m_Entries;
+
+    /**
+     * The indexed file at each book path.
+     */
+    QHash<QString, const Resource *> m_Files;
+
+    /**
+     * The files with links to a fragment in each book path.
+     */
+    QHash<QString, QSet<const Resource *>> m_Referrers;
+
+    /**
+     * The files with at least one broken link.
+     */
+    QSet<const Resource *> m_Broken;
+
+    QMutex m_AccessMutex;
+};
+
+#endif // FRAGMENTINDEX_H
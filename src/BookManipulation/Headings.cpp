@@ -72,7 +72,22 @@ QList<Headings::Heading> Headings::GetHeadingListForOneFile(HTMLResource *html_r
         bool include_unwanted_headings)
 {
     Q_ASSERT(html_resource);
-    QString source = html_resource->GetText();
+    QList<Headings::Heading> headings = html_resource->GetHeadings();
+    if (include_unwanted_headings) {
+        return headings;
+    }
+    QList<Headings::Heading> wanted;
+    foreach(const Headings::Heading &heading, headings) {
+        if (heading.include_in_toc) {
+            wanted.append(heading);
+        }
+    }
+    return wanted;
+}
+
+
+QList<Headings::Heading> Headings::ParseHeadings(HTMLResource *html_resource, const QString &source)
+{
     QString version = html_resource->GetEpubVersion();
     GumboInterface gi = GumboInterface(source, version);
     gi.parse();
@@ -132,9 +147,7 @@ QList<Headings::Heading> Headings::GetHeadingListForOneFile(HTMLResource *html_r
         heading.at_file_start = (i == 0) && ((node_line - body_line) < ALLOWED_HEADING_DISTANCE);
         heading.is_changed     = false;
 
-        if (heading.include_in_toc || include_unwanted_headings) {
-            headings.append(heading);
-        }
+        headings.append(heading);
     }
 
     return headings;
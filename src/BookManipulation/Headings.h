@@ -88,12 +88,19 @@ public:
     // the list is flat, the headings are *not* in a hierarchy tree.
     // Set include_unwanted_headings to true to get headings that the
     // user has marked as unwanted.
+    // The headings of each file are kept with it until its text
+    // changes, so only the files edited since the last call are parsed.
     static QList<Heading> GetHeadingList(QList<HTMLResource *> html_resources,
                                          bool include_unwanted_headings = false);
 
     static QList<Heading> GetHeadingListForOneFile(HTMLResource *html_resource,
             bool include_unwanted_headings = false);
 
+    // Parses every heading, wanted or not, out of source,
+    // the text of html_resource.  Use GetHeadingListForOneFile
+    // instead to get the cached headings of the resource.
+    static QList<Heading> ParseHeadings(HTMLResource *html_resource, const QString &source);
+
     // Takes a flat list of headings and returns a list with those
     // headings sorted into a hierarchy
     static QList<Heading> MakeHeadingHeirarchy(const QList<Heading> &headings);
@@ -21,6 +21,7 @@
 **
 *************************************************************************/
 
+#include <functional>
 #include <memory>
 
 #include <QtCore/QtCore>
@@ -32,46 +33,104 @@
 
 #include "ResourceObjects/HTMLResource.h"
 #include "Parsers/GumboInterface.h"
+#include "PCRE2/LiteralPrefilter.h"
 #include "BookManipulation/XhtmlDoc.h"
 #include "MiscEditors/IndexEditorModel.h"
 #include "BookManipulation/Index.h"
 #include "MiscEditors/IndexEntries.h"
+#include "Misc/Trace.h"
+#include "Misc/Utility.h"
 #include "sigil_constants.h"
 
 const QString SIGIL_INDEX_CLASS = "sigil_index_marker";
 const QString SIGIL_INDEX_ID_PREFIX = "sigil_index_id_";
 
-bool Index::BuildIndex(QList<HTMLResource *> html_resources)
+bool Index::BuildIndex(QList<HTMLResource *> html_resources,
+                       const QList<IndexEditorModel::indexEntry> &index_terms,
+                       IndexEntries &index_entries)
 {
-    IndexEntries::instance()->Clear();
-    // Display progress dialog
-    QProgressDialog progress(QObject::tr("Creating Index..."), QObject::tr("Cancel"), 0, html_resources.count(), QApplication::activeWindow());
-    progress.setMinimumDuration(0);
-    int progress_value = 0;
-    progress.setValue(progress_value);
-    qApp->processEvents();
-    // Must do sequentially in order to keep sections in order
-    foreach(HTMLResource * html_resource, html_resources) {
-        // Set progress value and ensure dialog has time to display when doing extensive updates
+    TRACE_SPAN(span, "Index::BuildIndex");
+    TRACE_ARG(span, "files", html_resources.count());
+    index_entries.Clear();
+
+    // Compile every index pattern once for the whole book rather than for
+    // every id node, and build a prefilter so that each node's text is only
+    // run against the patterns whose literal text actually appears in it.
+    IndexPatterns patterns;
+    QStringList pattern_strings;
+    foreach(const IndexEditorModel::indexEntry &entry, index_terms) {
+        if (!entry.pattern.isEmpty()) {
+            patterns.entries.append(entry);
+            patterns.regexes.append(QRegularExpression(entry.pattern));
+            pattern_strings.append(entry.pattern);
+        }
+    }
+    LiteralPrefilter prefilter(pattern_strings);
+    patterns.prefilter = &prefilter;
+
+    // Each file is matched on its own in a worker thread.  The results
+    // come back in the order of html_resources so merging them in that
+    // order keeps the sections of the index in book order.
+    QFuture<FileIndexResult> future = QtConcurrent::mapped(html_resources, std::bind(IndexOneFile, std::placeholders::_1, &patterns));
+
+    // Books indexed off the GUI thread have no one to show progress to
+    if (Utility::IsGUIThread()) {
+        QProgressDialog progress(QObject::tr("Creating Index..."), QObject::tr("Cancel"), 0, html_resources.count(), QApplication::activeWindow());
+        progress.setMinimumDuration(0);
+        progress.setValue(0);
+        qApp->processEvents();
+
+        QFutureWatcher<FileIndexResult> watcher;
+        QEventLoop loop;
+        QObject::connect(&watcher, &QFutureWatcher<FileIndexResult>::progressValueChanged, &progress, &QProgressDialog::setValue);
+        QObject::connect(&watcher, &QFutureWatcher<FileIndexResult>::finished, &loop, &QEventLoop::quit);
+        QObject::connect(&progress, &QProgressDialog::canceled, &watcher, &QFutureWatcher<FileIndexResult>::cancel);
+        watcher.setFuture(future);
+        // the progress dialog is modal so only its Cancel button takes input
+        if (!watcher.isFinished()) {
+            loop.exec();
+        }
         if (progress.wasCanceled()) {
-            return false;
+            future.cancel();
         }
+    }
+    future.waitForFinished();
+    // Nothing has been written yet so a cancel leaves the book untouched
+    if (future.isCanceled()) {
+        return false;
+    }
 
-        progress.setValue(progress_value++);
-        qApp->processEvents();
-        AddIndexIDsOneFile(html_resource);
+    // Only the GUI thread fills the index entries and sets the new text
+    for (int i = 0; i < future.resultCount(); i++) {
+        FileIndexResult result = future.resultAt(i);
+        HTMLResource *html_resource = html_resources.at(i);
+        // a file edited while it was being indexed is indexed again,
+        // its hits have to match the ids in the text that is kept
+        while (result.updated && !html_resource->SetTextIfRevision(result.new_text, result.revision)) {
+            result = IndexOneFile(html_resource, &patterns);
+        }
+        foreach(const IndexHit &hit, result.hits) {
+            index_entries.AddOneEntry(hit.text, result.bookpath, hit.id);
+        }
     }
     return true;
 }
 
-void Index::AddIndexIDsOneFile(HTMLResource *html_resource)
+
+// Runs in a worker thread.  Only reads the resource and returns
+// everything it found so the caller can merge the files in order.
+Index::FileIndexResult Index::IndexOneFile(HTMLResource *html_resource, const IndexPatterns *patterns)
 {
-    QWriteLocker locker(&html_resource->GetLock());
-    QString source = html_resource->GetText();
+    FileIndexResult result;
+    result.updated = false;
+    result.bookpath = html_resource->GetRelativePath();
+    TextResource::TextSnapshot snapshot = html_resource->GetTextSnapshot();
+    QString source = snapshot.text;
+    result.revision = snapshot.revision;
     QString version = html_resource->GetEpubVersion();
+
     GumboInterface gi = GumboInterface(source, version);
     QList<GumboNode*> nodes = XhtmlDoc::GetIDNodes(gi, gi.get_root_node());
-    bool resource_updated = false;
     int index_id_number = 1;
     foreach(GumboNode * node, nodes) {
         QString index_id_value;
@@ -87,7 +146,7 @@ void Index::AddIndexIDsOneFile(HTMLResource *html_resource)
             if (index_id_value.startsWith(SIGIL_INDEX_ID_PREFIX)) {
                 GumboElement* element = &node->v.element;
                 gumbo_element_remove_attribute(element, attr);
-                resource_updated = true;
+                result.updated = true;
             }
         }
 
@@ -116,63 +175,73 @@ void Index::AddIndexIDsOneFile(HTMLResource *html_resource)
         // Use the existing id if there is one, else add one if node contains index item
         attr = gumbo_get_attribute(&node->v.element.attributes, "id");
         if (attr) {
-            CreateIndexEntry(text_node_text, html_resource, index_id_value, is_custom_index_entry, custom_index_value);
+            CreateIndexEntry(text_node_text, index_id_value, is_custom_index_entry, custom_index_value, *patterns, result.hits);
         } else {
             index_id_value = SIGIL_INDEX_ID_PREFIX + QString::number(index_id_number);
 
-            if (CreateIndexEntry(text_node_text, html_resource, index_id_value, is_custom_index_entry, custom_index_value)) {
+            if (CreateIndexEntry(text_node_text, index_id_value, is_custom_index_entry, custom_index_value, *patterns, result.hits)) {
                 GumboElement* element = &node->v.element;
                 gumbo_element_set_attribute(element, "id", index_id_value.toUtf8().constData()); 
-                resource_updated = true;
+                result.updated = true;
                 index_id_number++;
             }
         }
     }
 
-    if (resource_updated) {
-        html_resource->SetText(gi.getxhtml());
+    if (result.updated) {
+        result.new_text = gi.getxhtml();
     }
+    return result;
 }
 
 
-bool Index::CreateIndexEntry(const QString text, HTMLResource *html_resource, QString index_id_value, bool is_custom_index_entry, QString custom_index_value)
+bool Index::CreateIndexEntry(const QString text, QString index_id_value, bool is_custom_index_entry, QString custom_index_value, const IndexPatterns &patterns, QList<IndexHit> &hits)
 {
     bool created_index = false;
-    QList<IndexEditorModel::indexEntry *> entries;
 
     if (is_custom_index_entry) {
-        IndexEditorModel::indexEntry *custom_entry = new IndexEditorModel::indexEntry();
+        IndexEditorModel::indexEntry custom_entry;
         // need to escape text to prevent it being interpreted 
         // as a QRegularExpression special character
-        custom_entry->pattern = QRegularExpression::escape(text);
-        custom_entry->index_entry = custom_index_value;
-        entries.append(custom_entry);
-    } else {
-        entries = IndexEditorModel::instance()->GetEntries();
+        custom_entry.pattern = QRegularExpression::escape(text);
+        custom_entry.index_entry = custom_index_value;
+        if (!custom_entry.pattern.isEmpty() && text.contains(QRegularExpression(custom_entry.pattern))) {
+            hits.append(MakeIndexHit(custom_entry, index_id_value));
+            created_index = true;
+        }
+        return created_index;
     }
 
-    foreach(IndexEditorModel::indexEntry * entry, entries) {
-        QString index_pattern = entry->pattern;
-        if (index_pattern.isEmpty()) {
+    QList<bool> candidates = patterns.prefilter->Candidates(text);
+    for (int i = 0; i < patterns.entries.count(); i++) {
+        // text without the pattern's literal prefix can never match it
+        if (!candidates.at(i)) {
             continue;
         }
-
-        QRegularExpression index_regex(index_pattern);
-
-        if (text.contains(index_regex)) {
+        if (text.contains(patterns.regexes.at(i))) {
+            hits.append(MakeIndexHit(patterns.entries.at(i), index_id_value));
             created_index = true;
-            QString index_entry = entry->index_entry;
-            if (index_entry.isEmpty()) {
-                // If no index text, use the pattern
-                IndexEntries::instance()->AddOneEntry(index_pattern, html_resource->GetRelativePath(), index_id_value);
-            } else if (entry->index_entry.endsWith("/")) {
-                // If index text is a category then append the pattern
-                IndexEntries::instance()->AddOneEntry(index_entry + index_pattern, html_resource->GetRelativePath(), index_id_value);
-            } else {
-                // Use the given index text
-                IndexEntries::instance()->AddOneEntry(index_entry, html_resource->GetRelativePath(), index_id_value);
-            }
         }
     }
     return created_index;
 }
+
+
+Index::IndexHit Index::MakeIndexHit(const IndexEditorModel::indexEntry &entry, const QString &index_id_value)
+{
+    IndexHit hit;
+    hit.id = index_id_value;
+    QString index_pattern = entry.pattern;
+    QString index_entry = entry.index_entry;
+    if (index_entry.isEmpty()) {
+        // If no index text, use the pattern
+        hit.text = index_pattern;
+    } else if (index_entry.endsWith("/")) {
+        // If index text is a category then append the pattern
+        hit.text = index_entry + index_pattern;
+    } else {
+        // Use the given index text
+        hit.text = index_entry;
+    }
+    return hit;
+}
@@ -25,23 +25,68 @@
 #ifndef INDEX_H
 #define INDEX_H
 
+#include <QtCore/QList>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QString>
+
+#include "MiscEditors/IndexEditorModel.h"
+
 class HTMLResource;
+class LiteralPrefilter;
+
+class IndexEntries;
 
 /**
  * Houses the Index process.
  * Ids are added via static routines to all files if text matches Index settings.
- * Patterns are read from the Index dialog model and written to the Index Entry storage.
+ * The patterns are taken from the caller, who reads them from the Index dialog
+ * model, and the entries found are written to the IndexEntries given.
  */
 class Index
 {
 
 public:
-    static bool BuildIndex(QList<HTMLResource *> html_resources);
+    static bool BuildIndex(QList<HTMLResource *> html_resources,
+                           const QList<IndexEditorModel::indexEntry> &index_terms,
+                           IndexEntries &index_entries);
 
 private:
-    static void AddIndexIDsOneFile(HTMLResource *html_resource);
+    /**
+     * The index patterns compiled once for a whole BuildIndex run.
+     */
+    struct IndexPatterns {
+        QList<IndexEditorModel::indexEntry> entries;
+        QList<QRegularExpression> regexes;
+        const LiteralPrefilter *prefilter = nullptr;
+    };
+
+    /**
+     * One index entry found in a file, the entry text and the id
+     * of the element it points to.
+     */
+    struct IndexHit {
+        QString text;
+        QString id;
+    };
+
+    /**
+     * Everything found in one file.  new_text holds the file with
+     * its index ids updated and is only set when updated is true.
+     * revision is that of the text the file was indexed from.
+     */
+    struct FileIndexResult {
+        QString bookpath;
+        QList<IndexHit> hits;
+        bool updated;
+        QString new_text;
+        quint64 revision;
+    };
+
+    static FileIndexResult IndexOneFile(HTMLResource *html_resource, const IndexPatterns *patterns);
+
+    static bool CreateIndexEntry(const QString text, QString index_id_name, bool is_custom_index_entry, QString custom_index_name, const IndexPatterns &patterns, QList<IndexHit> &hits);
 
-    static bool CreateIndexEntry(const QString text, HTMLResource *html_resource, QString index_id_name, bool is_custom_index_entry, QString custom_index_name);
+    static IndexHit MakeIndexHit(const IndexEditorModel::indexEntry &entry, const QString &index_id_value);
 };
 
 #endif // INDEX_H
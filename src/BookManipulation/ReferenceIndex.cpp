@@ -0,0 +1,167 @@
+/************************************************************************
+**
+**  Copyright (C) 2015-2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QtConcurrent/QtConcurrent>
+#include <QUrl>
+#include <QDebug>
+
+#include "BookManipulation/ReferenceIndex.h"
+#include "Misc/Utility.h"
+#include "ResourceObjects/HTMLResource.h"
+
+#if 0
+#define DBG if(1)
+#else
+#define DBG if(0)
+#endif
+
+ReferenceIndex::ReferenceIndex(QObject *parent)
+    :
+    QObject(parent)
+{
+}
+
+
+QList<HTMLResource *> ReferenceIndex::GetFilesAffectedBy(const QList<HTMLResource *> &html_resources,
+                                                         const QStringList &bookpaths)
+{
+    Refresh(html_resources);
+
+    QMutexLocker locker(&m_AccessMutex);
+    QSet<const Resource *> affected;
+    foreach(QString bookpath, bookpaths) {
+        affected.unite(m_Referrers.value(bookpath));
+    }
+
+    QList<HTMLResource *> files;
+    foreach(HTMLResource *html_resource, html_resources) {
+        if (affected.contains(html_resource) || bookpaths.contains(html_resource->GetCurrentBookRelPath())) {
+            files.append(html_resource);
+        }
+    }
+    DBG qDebug() << "ReferenceIndex" << files.count() << "of" << html_resources.count() << "files affected";
+    return files;
+}
+
+
+std::pair<int, qint64> ReferenceIndex::MemoryUsage()
+{
+    QMutexLocker locker(&m_AccessMutex);
+    qint64 total = 0;
+    foreach(const Entry &entry, m_Entries) {
+        total += sizeof(Entry) + entry.bookpath.capacity() * sizeof(QChar);
+        foreach(const QString &target, entry.targets) {
+            total += target.capacity() * sizeof(QChar);
+        }
+    }
+    QHashIterator<QString, QSet<const Resource *>> it(m_Referrers);
+    while (it.hasNext()) {
+        it.next();
+        total += it.key().capacity() * sizeof(QChar) + it.value().count() * sizeof(const Resource *);
+    }
+    return std::make_pair(static_cast<int>(m_Entries.count()), total);
+}
+
+
+void ReferenceIndex::Forget(const Resource *resource)
+{
+    QMutexLocker locker(&m_AccessMutex);
+    RemoveReferrer(resource);
+    m_Entries.remove(resource);
+}
+
+
+void ReferenceIndex::Refresh(const QList<HTMLResource *> &html_resources)
+{
+    QList<HTMLResource *> stale;
+    {
+        QMutexLocker locker(&m_AccessMutex);
+        foreach(HTMLResource *html_resource, html_resources) {
+            if (!m_Entries.contains(html_resource)) {
+                stale.append(html_resource);
+                continue;
+            }
+            const Entry &entry = m_Entries[html_resource];
+            if ((entry.revision != html_resource->GetRevision()) ||
+                (entry.bookpath != html_resource->GetCurrentBookRelPath())) {
+                stale.append(html_resource);
+            }
+        }
+    }
+    if (stale.isEmpty()) {
+        return;
+    }
+
+    DBG qDebug() << "ReferenceIndex reading links of" << stale.count() << "files";
+    QList<Entry> entries = QtConcurrent::blockingMapped(stale, ReadEntry);
+
+    QMutexLocker locker(&m_AccessMutex);
+    for (int i = 0; i < stale.count(); ++i) {
+        const Resource *resource = stale.at(i);
+        RemoveReferrer(resource);
+        const Entry &entry = entries.at(i);
+        foreach(QString target, entry.targets) {
+            m_Referrers[target].insert(resource);
+        }
+        m_Entries.insert(resource, entry);
+    }
+}
+
+
+// The caller must hold m_AccessMutex.
+void ReferenceIndex::RemoveReferrer(const Resource *resource)
+{
+    if (!m_Entries.contains(resource)) {
+        return;
+    }
+    foreach(QString target, m_Entries[resource].targets) {
+        QSet<const Resource *> &referrers = m_Referrers[target];
+        referrers.remove(resource);
+        if (referrers.isEmpty()) {
+            m_Referrers.remove(target);
+        }
+    }
+}
+
+
+// Runs in a worker thread.
+ReferenceIndex::Entry ReferenceIndex::ReadEntry(HTMLResource *html_resource)
+{
+    Entry entry;
+    // Read the revision before the links so an edit made in
+    // the meantime leaves the entry stale rather than wrong
+    entry.revision = html_resource->GetRevision();
+    entry.bookpath = html_resource->GetCurrentBookRelPath();
+    QString startdir = Utility::startingDir(entry.bookpath);
+    foreach(QString target, html_resource->GetParsedFact(HTMLResource::Fact_LinkTargets)) {
+        // external links and data urls never name a file in the book
+        if (target.contains(':')) {
+            continue;
+        }
+        QString path = QUrl(target).path();
+        if (path.isEmpty()) {
+            continue;
+        }
+        entry.targets.append(Utility::buildBookPath(path, startdir));
+    }
+    entry.targets.removeDuplicates();
+    return entry;
+}
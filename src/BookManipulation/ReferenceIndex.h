@@ -0,0 +1,109 @@
+/************************************************************************
+**
+**  Copyright (C) 2015-2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef REFERENCEINDEX_H
+#define REFERENCEINDEX_H
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+class Resource;
+class HTMLResource;
+
+/**
+ * Keeps track of which html files refer to each book path.
+ *
+ * The links of a file are only read again when its text or its
+ * book path has changed since they were last read, so after the
+ * first use only the files that were edited are parsed again.
+ * Renames and moves use this to run the source updates on just
+ * the html files that can actually be changed by them.
+ */
+class ReferenceIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    ReferenceIndex(QObject *parent = NULL);
+
+    /**
+     * Returns those html_resources that refer to any of the
+     * bookpaths or that are themselves at one of them, in the
+     * order they were given.  The bookpaths are the paths from
+     * before the rename, as returned by GetCurrentBookRelPath.
+     */
+    QList<HTMLResource *> GetFilesAffectedBy(const QList<HTMLResource *> &html_resources,
+                                             const QStringList &bookpaths);
+
+    /**
+     * The number of files indexed and roughly how many bytes of
+     * links are kept for them.
+     */
+    std::pair<int, qint64> MemoryUsage();
+
+public slots:
+
+    /**
+     * Drops everything known about a resource that has been removed.
+     */
+    void Forget(const Resource *resource);
+
+private:
+
+    struct Entry {
+        quint64 revision;
+        QString bookpath;
+        QStringList targets;
+    };
+
+    /**
+     * Reads the links of every html resource whose entry is out of date.
+     */
+    void Refresh(const QList<HTMLResource *> &html_resources);
+
+    void RemoveReferrer(const Resource *resource);
+
+    // Runs in a worker thread.
+    static Entry ReadEntry(HTMLResource *html_resource);
+
+
+    ///////////////////////////////
+    // PRIVATE MEMBER VARIABLES
+    ///////////////////////////////
+
+    QHash<const Resource *, Entry> m_Entries;
+
+    /**
+     * The html resources that refer to each book path.
+     */
+    QHash<QString, QSet<const Resource *>> m_Referrers;
+
+    QMutex m_AccessMutex;
+};
+
+#endif // REFERENCEINDEX_H
@@ -0,0 +1,78 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include "BookManipulation/ReportCache.h"
+
+ReportCache::ReportCache(QObject *parent)
+    :
+    QObject(parent)
+{
+}
+
+
+void ReportCache::Forget(const Resource *resource)
+{
+    QMutexLocker locker(&m_AccessMutex);
+    m_Entries.remove(resource);
+}
+
+
+std::pair<int, qint64> ReportCache::MemoryUsage()
+{
+    QMutexLocker locker(&m_AccessMutex);
+    int count = 0;
+    qint64 total = 0;
+    foreach(const auto &entries, m_Entries) {
+        foreach(const Entry &entry, entries) {
+            count++;
+            total += sizeof(Entry) + entry.bookpath.capacity() * sizeof(QChar);
+        }
+    }
+    return std::make_pair(count, total);
+}
+
+
+QVariant ReportCache::Find(Report report, HTMLResource *html_resource, quint64 revision, quint64 context)
+{
+    QMutexLocker locker(&m_AccessMutex);
+    if (!m_Entries.contains(html_resource) || !m_Entries[html_resource].contains(report)) {
+        return QVariant();
+    }
+    const Entry &entry = m_Entries[html_resource][report];
+    if ((entry.revision != revision) ||
+        (entry.context != context) ||
+        (entry.bookpath != html_resource->GetCurrentBookRelPath())) {
+        return QVariant();
+    }
+    return entry.value;
+}
+
+
+void ReportCache::Store(Report report, HTMLResource *html_resource, quint64 revision, quint64 context, const QVariant &value)
+{
+    Entry entry;
+    entry.revision = revision;
+    entry.context = context;
+    entry.bookpath = html_resource->GetCurrentBookRelPath();
+    entry.value = value;
+    QMutexLocker locker(&m_AccessMutex);
+    m_Entries[html_resource].insert(report, entry);
+}
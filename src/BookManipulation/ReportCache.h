@@ -0,0 +1,141 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef REPORTCACHE_H
+#define REPORTCACHE_H
+
+#include <QtConcurrent/QtConcurrent>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QVariant>
+
+#include "ResourceObjects/HTMLResource.h"
+
+class Resource;
+
+/**
+ * Keeps what each html file contributes to the Reports dialog.
+ *
+ * A value is stored with the revision and book path of the file it
+ * was computed from, together with a context stamp for anything else
+ * it depends on such as the stylesheets or the dictionaries.  Values
+ * are only computed again for the files where one of these changed,
+ * so reopening Reports after an edit only parses the edited files.
+ */
+class ReportCache : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    enum Report {
+        Report_WordCounts = 0,
+        Report_LinkElements,
+        Report_Characters,
+        Report_SelectorsUsed,
+        Report_SelectorsOverridden
+    };
+
+    ReportCache(QObject *parent = NULL);
+
+    /**
+     * Returns fn(html_resource) for every one of html_resources, in
+     * order.  fn is only run, in worker threads, for the resources
+     * without an up to date value stored for report and context.
+     */
+    template <typename T, typename F>
+    QList<T> Map(Report report, const QList<HTMLResource *> &html_resources, quint64 context, F fn)
+    {
+        QList<T> values;
+        QList<HTMLResource *> stale;
+        QList<quint64> revisions;
+        QList<int> positions;
+        foreach(HTMLResource *html_resource, html_resources) {
+            // Read the revision before the text is used so that a value
+            // is never stored against a newer revision than its text
+            quint64 revision = html_resource->GetRevision();
+            QVariant value = Find(report, html_resource, revision, context);
+            if (value.isValid()) {
+                values.append(value.value<T>());
+            } else {
+                positions.append(values.count());
+                values.append(T());
+                stale.append(html_resource);
+                revisions.append(revision);
+            }
+        }
+        if (stale.isEmpty()) {
+            return values;
+        }
+
+        QList<T> results = QtConcurrent::blockingMapped<QList<T>>(stale, fn);
+        for (int i = 0; i < stale.count(); ++i) {
+            Store(report, stale.at(i), revisions.at(i), context, QVariant::fromValue(results.at(i)));
+            values[positions.at(i)] = results.at(i);
+        }
+        return values;
+    }
+
+    /**
+     * The number of values stored and roughly how many bytes their
+     * entries use, not counting what is inside each value.
+     */
+    std::pair<int, qint64> MemoryUsage();
+
+public slots:
+
+    /**
+     * Drops everything known about a resource that has been removed.
+     */
+    void Forget(const Resource *resource);
+
+private:
+
+    struct Entry {
+        quint64 revision;
+        quint64 context;
+        QString bookpath;
+        QVariant value;
+    };
+
+    /**
+     * Returns the stored value, or an invalid QVariant if there is none
+     * or it was computed from another revision, book path or context.
+     */
+    QVariant Find(Report report, HTMLResource *html_resource, quint64 revision, quint64 context);
+
+    void Store(Report report, HTMLResource *html_resource, quint64 revision, quint64 context, const QVariant &value);
+
+
+    ///////////////////////////////
+    // PRIVATE MEMBER VARIABLES
+    ///////////////////////////////
+
+    QHash<const Resource *, QHash<int, Entry>> m_Entries;
+
+    QMutex m_AccessMutex;
+};
+
+#endif // REPORTCACHE_H
@@ -0,0 +1,267 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+
+#include <QtConcurrent/QtConcurrent>
+#include <QDebug>
+
+#include "BookManipulation/TextCountMonitor.h"
+#include "Misc/HTMLSpellCheck.h"
+#include "Misc/SettingsSnapshot.h"
+#include "Misc/SpellCheck.h"
+#include "sigil_constants.h"
+#include "Parsers/QuickParser.h"
+#include "ResourceObjects/HTMLResource.h"
+
+#if 0
+#define DBG if(1)
+#else
+#define DBG if(0)
+#endif
+
+// How long the edits have to stop before the files are counted
+static const int COUNT_DELAY_MS = 500;
+
+// The longest entity counted as one character
+static const int MAX_ENTITY_LENGTH = 32;
+
+TextCountMonitor::TextCountMonitor(QObject *parent)
+    :
+    QObject(parent),
+    m_Active(false),
+    m_Context(0),
+    m_Watcher(new QFutureWatcher<Counts>(this))
+{
+    m_Timer.setSingleShot(true);
+    m_Timer.setInterval(COUNT_DELAY_MS);
+    connect(&m_Timer, SIGNAL(timeout()), this, SLOT(CountPending()));
+    connect(m_Watcher, SIGNAL(finished()), this, SLOT(CountFinished()));
+}
+
+
+TextCountMonitor::~TextCountMonitor()
+{
+    // The workers only hold copies of the text
+    m_Watcher->disconnect(this);
+    m_Watcher->cancel();
+    m_Watcher->waitForFinished();
+}
+
+
+// Resources are added from the import workers too, so the counting
+// itself is left to the GUI thread
+void TextCountMonitor::Watch(HTMLResource *resource)
+{
+    connect(resource, SIGNAL(Modified()), this, SLOT(ResourceModified()));
+    {
+        QMutexLocker locker(&m_PendingMutex);
+        m_Pending.insert(resource, resource);
+    }
+    QMetaObject::invokeMethod(this, "ResourceAdded", Qt::QueuedConnection);
+}
+
+
+TextCountMonitor::Counts TextCountMonitor::GetCounts(const HTMLResource *resource)
+{
+    Activate();
+    return m_Counts.value(resource).counts;
+}
+
+
+TextCountMonitor::Counts TextCountMonitor::GetBookCounts()
+{
+    Activate();
+    return m_BookCounts;
+}
+
+
+void TextCountMonitor::Forget(const Resource *resource)
+{
+    {
+        QMutexLocker locker(&m_PendingMutex);
+        m_Pending.remove(static_cast<const HTMLResource *>(resource));
+    }
+    if (m_Counts.contains(resource)) {
+        Entry entry = m_Counts.take(resource);
+        m_BookCounts.words -= entry.counts.words;
+        m_BookCounts.characters -= entry.counts.characters;
+        emit CountsChanged();
+    }
+}
+
+
+void TextCountMonitor::ResourceAdded()
+{
+    if (m_Active && !m_Timer.isActive()) {
+        m_Timer.start();
+    }
+}
+
+
+void TextCountMonitor::ResourceModified()
+{
+    HTMLResource *resource = qobject_cast<HTMLResource *>(sender());
+    if (resource) {
+        QMutexLocker locker(&m_PendingMutex);
+        m_Pending.insert(resource, resource);
+    }
+    if (m_Active) {
+        m_Timer.start();
+    }
+}
+
+
+void TextCountMonitor::Activate()
+{
+    if (m_Active) {
+        return;
+    }
+    m_Active = true;
+    CountPending();
+}
+
+
+void TextCountMonitor::CountPending()
+{
+    if (m_Watcher->isRunning()) {
+        m_Timer.start();
+        return;
+    }
+
+    // Another dictionary or setting can split the same text into
+    // other words
+    quint64 context = CurrentContext();
+    bool recount = context != m_Context;
+    QList<QPointer<HTMLResource>> pending;
+    if (recount) {
+        m_Context = context;
+        foreach(const Entry &entry, m_Counts) {
+            pending.append(entry.resource);
+        }
+    }
+    {
+        QMutexLocker locker(&m_PendingMutex);
+        pending.append(m_Pending.values());
+        m_Pending.clear();
+    }
+
+    // Copy every text now, on the GUI thread, so the workers
+    // never touch a resource that may be deleted under them
+    QList<QString> texts;
+    m_Counting.clear();
+    foreach(QPointer<HTMLResource> resource, pending) {
+        if (!resource) {
+            continue;
+        }
+        quint64 revision = resource->GetRevision();
+        if (!recount && m_Counts.contains(resource) && (m_Counts[resource].revision == revision)) {
+            // already counted at this revision
+            continue;
+        }
+        texts.append(resource->GetText());
+        m_Counting.append(std::make_pair(resource, revision));
+    }
+    if (texts.isEmpty()) {
+        return;
+    }
+
+    DBG qDebug() << "TextCountMonitor counting" << texts.count() << "files";
+    m_Watcher->setFuture(QtConcurrent::mapped(texts, CountText));
+}
+
+
+void TextCountMonitor::CountFinished()
+{
+    for (int i = 0; i < m_Counting.count(); ++i) {
+        HTMLResource *resource = m_Counting.at(i).first;
+        if (!resource || !m_Watcher->future().isResultReadyAt(i)) {
+            continue;
+        }
+        Entry &entry = m_Counts[resource];
+        m_BookCounts.words -= entry.counts.words;
+        m_BookCounts.characters -= entry.counts.characters;
+        entry.resource = resource;
+        entry.revision = m_Counting.at(i).second;
+        entry.counts = m_Watcher->resultAt(i);
+        m_BookCounts.words += entry.counts.words;
+        m_BookCounts.characters += entry.counts.characters;
+    }
+    m_Counting.clear();
+    emit CountsChanged();
+
+    // what was edited while counting
+    QMutexLocker locker(&m_PendingMutex);
+    if (!m_Pending.isEmpty() && !m_Timer.isActive()) {
+        m_Timer.start();
+    }
+}
+
+
+TextCountMonitor::Counts TextCountMonitor::CountText(const QString &text)
+{
+    Counts counts;
+    counts.words = HTMLSpellCheck::CountAllWords(text);
+
+    QuickParser qp(text, "");
+    bool in_body = false;
+    while (true) {
+        QuickParser::MarkupSpan ms = qp.parse_next_span();
+        if (ms.pos < 0) {
+            break;
+        }
+        if (ms.type != QuickParser::TextMarkup) {
+            if (qp.name(ms.name) == "body") {
+                in_body = ms.type == QuickParser::BeginMarkup;
+            }
+            continue;
+        }
+        const QString &parent = qp.name(ms.parent);
+        if (!in_body || (parent == "script") || (parent == "style")) {
+            continue;
+        }
+        QStringView segment = qp.markup(ms);
+        for (int i = 0; i < segment.length(); i++) {
+            QChar c = segment.at(i);
+            if (c.isSpace() || c.isLowSurrogate()) {
+                continue;
+            }
+            if (c == '&') {
+                int end = segment.indexOf(QChar(';'), i);
+                if ((end > i) && (end - i <= MAX_ENTITY_LENGTH)) {
+                    QStringView entity = segment.sliced(i, end - i + 1);
+                    i = end;
+                    if ((entity == QL1SV("&nbsp;")) || (entity == QL1SV("&#160;"))) {
+                        continue;
+                    }
+                }
+            }
+            counts.characters++;
+        }
+    }
+    return counts;
+}
+
+
+quint64 TextCountMonitor::CurrentContext()
+{
+    return (SpellCheck::instance()->generation() << 1) |
+           (SettingsSnapshot::instance()->Current()->spellcheck_numbers ? 1 : 0);
+}
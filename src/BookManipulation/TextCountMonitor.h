@@ -0,0 +1,167 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+
+#pragma once
+#ifndef TEXTCOUNTMONITOR_H
+#define TEXTCOUNTMONITOR_H
+
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QPointer>
+#include <QtCore/QString>
+#include <QtCore/QTimer>
+
+class HTMLResource;
+class Resource;
+
+/**
+ * Keeps the word and character counts of every html file, and of the
+ * whole book, for the status bar.
+ *
+ * The files edited since they were last counted are counted again in
+ * a background thread shortly after the edits stop, so reading the
+ * counts never scans the book.  Nothing is counted until the counts
+ * are first asked for, so batch mode never pays for them.
+ */
+class TextCountMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    struct Counts {
+        int words = 0;
+        // the characters of the text, not counting white space, an
+        // entity counts as one
+        int characters = 0;
+    };
+
+    TextCountMonitor(QObject *parent = NULL);
+    ~TextCountMonitor();
+
+    /**
+     * Counts the resource again each time its text is edited.
+     * Safe to call from any thread.
+     */
+    void Watch(HTMLResource *resource);
+
+    /**
+     * Returns the counts of the resource as of its last count, which
+     * can be a moment behind the edits.
+     */
+    Counts GetCounts(const HTMLResource *resource);
+
+    /**
+     * Returns the counts of the whole book as of the last count.
+     */
+    Counts GetBookCounts();
+
+    /**
+     * Counts the text the way the status bar shows it.  Safe to call
+     * from any thread.
+     */
+    static Counts CountText(const QString &text);
+
+public slots:
+
+    /**
+     * Drops the counts of a resource that has been removed.
+     */
+    void Forget(const Resource *resource);
+
+signals:
+
+    /**
+     * Emitted on the GUI thread whenever counts were updated.
+     */
+    void CountsChanged();
+
+private slots:
+
+    void ResourceAdded();
+
+    void ResourceModified();
+
+    /**
+     * Starts counting the files edited since the last count.
+     */
+    void CountPending();
+
+    void CountFinished();
+
+private:
+
+    /**
+     * Starts counting on the first request for counts.
+     */
+    void Activate();
+
+    /**
+     * The word counts depend on the word characters of the
+     * dictionaries and on whether numbers are words.
+     */
+    static quint64 CurrentContext();
+
+    struct Entry {
+        QPointer<HTMLResource> resource;
+        quint64 revision = 0;
+        Counts counts;
+    };
+
+
+    ///////////////////////////////
+    // PRIVATE MEMBER VARIABLES
+    ///////////////////////////////
+
+    bool m_Active;
+
+    /**
+     * Files added or edited since they were last counted.
+     */
+    QHash<const HTMLResource *, QPointer<HTMLResource>> m_Pending;
+    QMutex m_PendingMutex;
+
+    /**
+     * The files being counted and the revision of the text taken from each.
+     */
+    QList<std::pair<QPointer<HTMLResource>, quint64>> m_Counting;
+
+    /**
+     * The last counts of each file, and their sum.
+     */
+    QHash<const Resource *, Entry> m_Counts;
+    Counts m_BookCounts;
+
+    /**
+     * The context m_Counts were counted in.
+     */
+    quint64 m_Context;
+
+    QFutureWatcher<Counts> *m_Watcher;
+
+    QTimer m_Timer;
+};
+
+#endif // TEXTCOUNTMONITOR_H
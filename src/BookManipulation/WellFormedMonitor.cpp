@@ -0,0 +1,134 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+
+#include <QtConcurrent/QtConcurrent>
+#include <QDebug>
+
+#include "BookManipulation/WellFormedMonitor.h"
+#include "ResourceObjects/XMLResource.h"
+
+#if 0
+#define DBG if(1)
+#else
+#define DBG if(0)
+#endif
+
+// How long the edits have to stop before the files are checked
+static const int CHECK_DELAY_MS = 1000;
+
+WellFormedMonitor::WellFormedMonitor(QObject *parent)
+    :
+    QObject(parent),
+    m_Watcher(new QFutureWatcher<XhtmlDoc::WellFormedError>(this))
+{
+    m_Timer.setSingleShot(true);
+    m_Timer.setInterval(CHECK_DELAY_MS);
+    connect(&m_Timer, SIGNAL(timeout()), this, SLOT(CheckPending()));
+    connect(m_Watcher, SIGNAL(finished()), this, SLOT(CheckFinished()));
+}
+
+
+WellFormedMonitor::~WellFormedMonitor()
+{
+    // The workers only hold copies of the text
+    m_Watcher->disconnect(this);
+    m_Watcher->cancel();
+    m_Watcher->waitForFinished();
+}
+
+
+void WellFormedMonitor::Watch(XMLResource *resource)
+{
+    connect(resource, SIGNAL(Modified()), this, SLOT(ResourceModified()));
+}
+
+
+void WellFormedMonitor::CheckNow(XMLResource *resource)
+{
+    if (!resource || resource->IsWellFormedKnown()) {
+        return;
+    }
+    if (!m_Pending.contains(resource)) {
+        m_Pending.append(resource);
+    }
+    // a check already running has the timer wait for it
+    m_Timer.stop();
+    CheckPending();
+}
+
+
+void WellFormedMonitor::ResourceModified()
+{
+    XMLResource *resource = qobject_cast<XMLResource *>(sender());
+    if (resource && !m_Pending.contains(resource)) {
+        m_Pending.append(resource);
+    }
+    m_Timer.start();
+}
+
+
+void WellFormedMonitor::CheckPending()
+{
+    if (m_Watcher->isRunning()) {
+        m_Timer.start();
+        return;
+    }
+
+    // Copy every text now, on the GUI thread, so the workers
+    // never touch a resource that may be deleted under them
+    QList<std::pair<QString, QString>> texts;
+    m_Checking.clear();
+    foreach(QPointer<XMLResource> resource, m_Pending) {
+        if (!resource || resource->IsWellFormedKnown()) {
+            continue;
+        }
+        quint64 revision = resource->GetRevision();
+        texts.append(std::make_pair(resource->GetText(), resource->GetMediaType()));
+        m_Checking.append(std::make_pair(resource, revision));
+    }
+    m_Pending.clear();
+    if (texts.isEmpty()) {
+        return;
+    }
+
+    DBG qDebug() << "WellFormedMonitor checking" << texts.count() << "files";
+    m_Watcher->setFuture(QtConcurrent::mapped(texts, CheckText));
+}
+
+
+void WellFormedMonitor::CheckFinished()
+{
+    for (int i = 0; i < m_Checking.count(); ++i) {
+        // a resource edited again keeps no verdict for the old text
+        XMLResource *resource = m_Checking.at(i).first;
+        if (resource && m_Watcher->future().isResultReadyAt(i)) {
+            resource->StoreWellFormedError(m_Checking.at(i).second, m_Watcher->resultAt(i));
+        }
+    }
+    m_Checking.clear();
+}
+
+
+XhtmlDoc::WellFormedError WellFormedMonitor::CheckText(const std::pair<QString, QString> &text_and_mtype)
+{
+    return XMLResource::CheckWellFormed(text_and_mtype.first, text_and_mtype.second);
+}
@@ -0,0 +1,103 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+
+#pragma once
+#ifndef WELLFORMEDMONITOR_H
+#define WELLFORMEDMONITOR_H
+
+#include <utility>
+
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QPointer>
+#include <QtCore/QString>
+#include <QtCore/QTimer>
+
+#include "BookManipulation/XhtmlDoc.h"
+
+class XMLResource;
+
+/**
+ * Checks whether edited xml files are still well formed in a
+ * background thread shortly after the edits stop, so that the
+ * saves, merges and plugin runs that need every file to be well
+ * formed find the verdicts already kept by the resources.
+ */
+class WellFormedMonitor : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    WellFormedMonitor(QObject *parent = NULL);
+    ~WellFormedMonitor();
+
+    /**
+     * Checks the resource again each time its text is edited.
+     */
+    void Watch(XMLResource *resource);
+
+    /**
+     * Starts the check of an edited resource right away instead of
+     * waiting for the edits to stop, as when its tab is left and the
+     * verdict may soon be asked for.
+     */
+    void CheckNow(XMLResource *resource);
+
+private slots:
+
+    void ResourceModified();
+
+    /**
+     * Starts checking the files edited since the last check.
+     */
+    void CheckPending();
+
+    void CheckFinished();
+
+private:
+
+    // Runs in a worker thread.
+    static XhtmlDoc::WellFormedError CheckText(const std::pair<QString, QString> &text_and_mtype);
+
+
+    ///////////////////////////////
+    // PRIVATE MEMBER VARIABLES
+    ///////////////////////////////
+
+    /**
+     * Files edited since they were last checked.
+     */
+    QList<QPointer<XMLResource>> m_Pending;
+
+    /**
+     * The files being checked and the revision of the text taken from each.
+     */
+    QList<std::pair<QPointer<XMLResource>, quint64>> m_Checking;
+
+    QFutureWatcher<XhtmlDoc::WellFormedError> *m_Watcher;
+
+    QTimer m_Timer;
+};
+
+#endif // WELLFORMEDMONITOR_H
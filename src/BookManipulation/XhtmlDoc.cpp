@@ -23,6 +23,7 @@
 
 #include <memory>
 #include <string>
+#include <utility>
 #include <QtCore/QHash>
 #include <QtCore/QList>
 #include <QtCore/QString>
@@ -117,35 +118,195 @@ QString XhtmlDoc::ResolveCustomEntities(const QString &source)
 }
 
 
+// Finds the '>' that ends the tag starting at pos, skipping
+// over any inside quoted attribute values
+static int FindHeadTagEnd(const QStringView text, int pos)
+{
+    QChar quote;
+    for (int i = pos + 1; i < text.length(); i++) {
+        QChar c = text.at(i);
+        if (!quote.isNull()) {
+            if (c == quote) quote = QChar();
+        } else if ((c == '"') || (c == '\'')) {
+            quote = c;
+        } else if (c == '>') {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+static bool IsHeadTagBlank(QChar c)
+{
+    return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r') || (c == '\f');
+}
+
+
+// Attribute values as QXmlStreamReader would report them
+static QString DecodeHeadAttributeValue(const QStringView value)
+{
+    if (!value.contains(QChar('&'))) {
+        return value.toString();
+    }
+    QString decoded;
+    int p = 0;
+    int amp = value.indexOf(QChar('&'));
+    while (amp != -1) {
+        decoded.append(value.mid(p, amp - p));
+        int semi = value.indexOf(QChar(';'), amp);
+        if (semi == -1) break;
+        QStringView ref = value.mid(amp + 1, semi - amp - 1);
+        bool ok = false;
+        uint cp = 0;
+        if (ref.startsWith(QChar('#'))) {
+            if (ref.startsWith(QLatin1String("#x"), Qt::CaseInsensitive)) {
+                cp = ref.mid(2).toUInt(&ok, 16);
+            } else {
+                cp = ref.mid(1).toUInt(&ok, 10);
+            }
+            if (ok) {
+                char32_t ucs = cp;
+                decoded.append(QString::fromUcs4(&ucs, 1));
+            }
+        } else {
+            QString entity = value.mid(amp, semi - amp + 1).toString();
+            QString text = Utility::DecodeXML(entity);
+            ok = text != entity;
+            if (ok) decoded.append(text);
+        }
+        if (!ok) {
+            decoded.append(value.mid(amp, semi - amp + 1));
+        }
+        p = semi + 1;
+        amp = value.indexOf(QChar('&'), p);
+    }
+    decoded.append(value.mid(p));
+    return decoded;
+}
+
+
+// Fills in the attributes of a tag, named the way CreateXMLElement names them
+static void ParseHeadTagAttributes(const QStringView tag, int p, QHash<QString, QString> &attributes)
+{
+    int n = tag.length() - 1; // skip ending '>'
+    while (p < n) {
+        while ((p < n) && (IsHeadTagBlank(tag.at(p)) || (tag.at(p) == '/'))) p++;
+        int s = p;
+        while ((p < n) && !IsHeadTagBlank(tag.at(p)) && (tag.at(p) != '=') && (tag.at(p) != '/')) p++;
+        if (p == s) break;
+        QString attribute_name = tag.mid(s, p - s).toString();
+        attribute_name = attribute_name.mid(attribute_name.indexOf(QChar(':')) + 1);
+        if (!Utility::IsMixedCase(attribute_name)) {
+            attribute_name = attribute_name.toLower();
+        }
+        while ((p < n) && IsHeadTagBlank(tag.at(p))) p++;
+        if ((p >= n) || (tag.at(p) != '=')) {
+            attributes[ attribute_name ] = QString();
+            continue;
+        }
+        p++;
+        while ((p < n) && IsHeadTagBlank(tag.at(p))) p++;
+        int b = p;
+        int e;
+        if ((p < n) && ((tag.at(p) == '"') || (tag.at(p) == '\''))) {
+            b = p + 1;
+            e = tag.indexOf(tag.at(p), b);
+            if ((e == -1) || (e > n)) e = n;
+            p = e + 1;
+        } else {
+            while ((p < n) && !IsHeadTagBlank(tag.at(p))) p++;
+            e = p;
+        }
+        attributes[ attribute_name ] = DecodeHeadAttributeValue(tag.mid(b, e - b));
+    }
+}
+
+
 // Returns a list of XMLElements representing all
 // the elements of the specified tag name
-// in the head section of the provided XHTML source code
+// in the head section of the provided XHTML source code.
+// Only the head is looked at, the scan stops at the end of
+// the head or the start of the body, and the source does not
+// have to be well formed.
 QList<XhtmlDoc::XMLElement> XhtmlDoc::GetTagsInHead(const QString &source, const QString &tag_name)
 {
-    // TODO: how about replacing uses of this function
-    // with XPath expressions? Profile for speed.
-    QXmlStreamReader reader(source);
+    const QStringView text(source);
     bool in_head = false;
     QList<XMLElement> matching_elements;
-
-    while (!reader.atEnd()) {
-        reader.readNext();
-
-        if (reader.isStartElement()) {
-            if (reader.name().compare(QLatin1String("head"),Qt::CaseInsensitive) == 0) {
+    int line = 1;
+    int line_pos = 0;
+
+    int pos = text.indexOf(QChar('<'));
+    while (pos != -1) {
+        QStringView rest = text.mid(pos);
+        int end = -1;
+        if (rest.startsWith(QLatin1String("<!--"))) {
+            end = text.indexOf(QLatin1String("-->"), pos + 4);
+            if (end != -1) end += 2;
+        } else if (rest.startsWith(QLatin1String("<![CDATA["))) {
+            end = text.indexOf(QLatin1String("]]>"), pos + 9);
+            if (end != -1) end += 2;
+        } else if (rest.startsWith(QLatin1String("<?"))) {
+            end = text.indexOf(QLatin1String("?>"), pos + 2);
+            if (end != -1) end += 1;
+        } else if (rest.startsWith(QLatin1String("<!"))) {
+            // a doctype, possibly with an internal subset of entities
+            end = text.indexOf(QChar('>'), pos);
+            int subset = text.indexOf(QChar('['), pos);
+            if ((subset != -1) && (end != -1) && (subset < end)) {
+                end = text.indexOf(QChar(']'), subset);
+                if (end != -1) end = text.indexOf(QChar('>'), end);
+            }
+        } else {
+            end = FindHeadTagEnd(text, pos);
+            if (end == -1) break;
+            QStringView tag = text.mid(pos, end - pos + 1);
+            bool is_end_tag = (tag.length() > 1) && (tag.at(1) == '/');
+            int s = is_end_tag ? 2 : 1;
+            int p = s;
+            while ((p < tag.length()) && !IsHeadTagBlank(tag.at(p)) && (tag.at(p) != '/') && (tag.at(p) != '>')) p++;
+            QStringView qualified_name = tag.mid(s, p - s);
+            QStringView name = qualified_name.mid(qualified_name.indexOf(QChar(':')) + 1);
+            bool is_single = !is_end_tag && tag.endsWith(QLatin1String("/>"));
+
+            if (is_end_tag) {
+                if (name.compare(QLatin1String("head"), Qt::CaseInsensitive) == 0) break;
+            } else if (name.compare(QLatin1String("body"), Qt::CaseInsensitive) == 0) {
+                break;
+            } else if (name.compare(QLatin1String("head"), Qt::CaseInsensitive) == 0) {
                 in_head = true;
-            } else if (in_head && reader.name().compare(tag_name) == 0) {
-                matching_elements.append(CreateXMLElement(reader));
+            } else {
+                // the contents of these may hold a '<' that is not a tag
+                bool raw = (name == QLatin1String("script")) || (name == QLatin1String("style"));
+                bool matches = in_head && (name == tag_name);
+                int close = -1;
+                if (!is_single && (raw || matches)) {
+                    close = text.indexOf(QString("</") + qualified_name.toString(), end + 1);
+                }
+                if (matches) {
+                    XMLElement element;
+                    line += text.mid(line_pos, pos - line_pos).count(QChar('\n'));
+                    line_pos = pos;
+                    element.lineno = line;
+                    element.name = name.toString();
+                    ParseHeadTagAttributes(tag, p, element.attributes);
+                    QStringView content;
+                    if (close != -1) content = text.mid(end + 1, close - end - 1);
+                    if (content.startsWith(QLatin1String("<![CDATA[")) && content.endsWith(QLatin1String("]]>"))) {
+                        element.text = content.mid(9, content.length() - 12).toString();
+                    } else {
+                        element.text = Utility::DecodeXML(content.toString());
+                    }
+                    matching_elements.append(element);
+                }
+                if (raw && !is_single) {
+                    end = (close == -1) ? text.length() - 1 : close;
+                }
             }
-        } else if (reader.isEndElement() &&
-                   (reader.name().compare(QLatin1String("head"),Qt::CaseInsensitive) == 0)) {
-            break;
         }
-    }
-
-    if (reader.hasError()) {
-        std::string msg = reader.errorString().toStdString() + ": " + QString::number(reader.lineNumber()).toStdString() + ": " + QString::number(reader.columnNumber()).toStdString();
-        throw (ErrorParsingXml(msg));
+        if (end == -1) break;
+        pos = text.indexOf(QChar('<'), end + 1);
     }
 
     return matching_elements;
@@ -341,10 +502,14 @@ bool XhtmlDoc::IsDataWellFormed(const QString &data, QString version)
 }
 
 QStringList XhtmlDoc::GetSGFSectionSplits(const QString &source,
-        const QString &custom_header)
+        const QString &custom_header,
+        QList<QStringList> *section_ids)
 {
     
     QStringList sections;
+    if (section_ids) {
+        section_ids->clear();
+    }
     TagLister taglist(source);
 
     // abort if no body tags exist
@@ -387,14 +552,50 @@ QStringList XhtmlDoc::GetSGFSectionSplits(const QString &source,
             start_pos = body_contents_end;
         }
     }
+
+    // Walk the tags of the body once, keeping the begin tags that are
+    // still open, so the tags each section has to reopen are known
+    // without walking back to the body tag for every section.  The ids
+    // each section will hold are picked up on the same walk.
+    QList<std::pair<int, int>> open_tags;
+    int t = bo + 1;
     for (int i=0; i < section_starts.size(); i++) {
+        int next_start = (i + 1 < section_starts.size()) ? section_starts[i + 1] : body_contents_end;
+        QStringList open_tag_list;
+        QStringList ids;
+        for (const std::pair<int, int> &open_tag : open_tags) {
+            open_tag_list << source.mid(open_tag.first, open_tag.second);
+            if (section_ids) {
+                AppendTagId(QStringView(source).mid(open_tag.first, open_tag.second), ids);
+            }
+        }
+        for (; t < bc; t++) {
+            TagLister::TagInfo ti = taglist.at(t);
+            if (ti.pos >= next_start) break;
+            if (ti.ttype == "begin") {
+                open_tags << std::make_pair(ti.pos, ti.len);
+            } else if (ti.ttype == "end") {
+                for (int j = open_tags.size() - 1; j >= 0; j--) {
+                    if (open_tags[j].first == ti.open_pos) {
+                        open_tags.removeAt(j);
+                        break;
+                    }
+                }
+            }
+            // the marker itself holds no ids worth keeping
+            if (section_ids && (ti.pos < section_ends[i]) && ((ti.ttype == "begin") || (ti.ttype == "single"))) {
+                AppendTagId(QStringView(source).mid(ti.pos, ti.len), ids);
+            }
+        }
         QString text = Utility::Substring(section_starts[i], section_ends[i], source);
-        QStringList open_tag_list = GetUnmatchedTagsForPosition(section_starts[i], taglist);
         QString open_tag_source = "";
         if (!open_tag_list.isEmpty()) open_tag_source = open_tag_list.join(" ");
         sections.append(header + open_tag_source + text + "</body>\n</html>\n");
         // let gumbo/mend fill in any necessary closing tags for any open tags
         // at the end of each section
+        if (section_ids) {
+            section_ids->append(ids);
+        }
     }
     // if body is empty (no split marker) then sections will be empty which should not happen
     // handle this special case
@@ -405,17 +606,21 @@ QStringList XhtmlDoc::GetSGFSectionSplits(const QString &source,
     return sections;
 }
 
+
+void XhtmlDoc::AppendTagId(const QStringView tagstring, QStringList &ids)
+{
+    if (!tagstring.contains(QLatin1String("id"))) return;
+    TagLister::AttInfo ainfo;
+    TagLister::parseAttribute(tagstring, "id", ainfo);
+    if (ainfo.pos != -1 && !ainfo.avalue.isEmpty()) {
+        ids << ainfo.avalue;
+    }
+}
+
 // return all links in raw encoded form
 QStringList XhtmlDoc::GetLinkedStylesheets(const QString &source)
 {
-    QList<XhtmlDoc::XMLElement> link_tag_nodes;
-
-    try {
-        link_tag_nodes = XhtmlDoc::GetTagsInHead(source, "link");
-    } catch (ErrorParsingXml&) {
-        // Nothing really. If we can't get the CSS style tags,
-        // than that's it. No CSS returned.
-    }
+    QList<XhtmlDoc::XMLElement> link_tag_nodes = XhtmlDoc::GetTagsInHead(source, "link");
 
     QStringList linked_css_paths;
     foreach(XhtmlDoc::XMLElement element, link_tag_nodes) {
@@ -437,14 +642,7 @@ QStringList XhtmlDoc::GetLinkedStylesheets(const QString &source)
 // return all linked javascripts in raw encoded form
 QStringList XhtmlDoc::GetLinkedJavascripts(const QString &source)
 {
-    QList<XhtmlDoc::XMLElement> script_tag_nodes;
-
-    try {
-        script_tag_nodes = XhtmlDoc::GetTagsInHead(source, "script");
-    } catch (ErrorParsingXml&) {
-        // Nothing really. If we can't get the script tags,                                                      
-        // than that's it. No scripts returned.
-    }
+    QList<XhtmlDoc::XMLElement> script_tag_nodes = XhtmlDoc::GetTagsInHead(source, "script");
 
     QStringList linked_js_paths;
     foreach(XhtmlDoc::XMLElement element, script_tag_nodes) {
@@ -64,7 +64,8 @@ public:
 
     // Returns a list of XMLElements representing all
     // the elements of the specified tag name
-    // in the head section of the provided XHTML source code
+    // in the head section of the provided XHTML source code,
+    // without looking at anything past the start of the body
     static QList<XMLElement> GetTagsInHead(const QString &source, const QString &tag_name);
 
     // Returns a list of XMLElements representing all
@@ -115,10 +116,13 @@ public:
      * @param source The source which we want to split.
      * @param custom_header An option custom header to be used instead of
      *                      the one in the current source.
+     * @param section_ids If given, filled with the ids each of the
+     *                    split sections holds, in the same order.
      * @return The split sections.
      */
     static QStringList GetSGFSectionSplits(const QString &source,
-                                           const QString &custom_header = QString());
+                                           const QString &custom_header = QString(),
+                                           QList<QStringList> *section_ids = NULL);
 
     // Return a list of all linked CSS stylesheets
     static QStringList GetLinkedStylesheets(const QString &source);
@@ -154,6 +158,9 @@ public:
 
 private:
 
+    // Appends the value of the id attribute of the tag, if it has one
+    static void AppendTagId(const QStringView tagstring, QStringList &ids);
+
     // Accepts a reference to an XML stream reader positioned on an XML element.
     // Returns an XMLElement struct with the data in the stream.
     static XMLElement CreateXMLElement(QXmlStreamReader &reader);
@@ -120,6 +120,9 @@ QString AutomateEditor::GetAutomateList()
             } else if (cmd.startsWith("SetPluginParameter")) {
                 value = cmd.mid(19,-1).trimmed();
                 cmd = "SetPluginParameter";
+            } else if (cmd.startsWith("SetSaveCompression")) {
+                value = cmd.mid(19,-1).trimmed();
+                cmd = "SetSaveCompression";
             }
             autodata << cmd + _GS + "" + _US + value + _GS + "" + _RS;
         }
@@ -166,6 +169,9 @@ void AutomateEditor::selectTool()
         } else if (code == "SetPluginParameter") {
             QString content = tr("[String parameter for next Plugin run here]");
             insertRow(code, code, content, "");
+        } else if (code == "SetSaveCompression") {
+            QString content = tr("[fast, balanced or archival]");
+            insertRow(code, code, content, "");
         } else {
             insertRow(code, code, "", "");
         }
@@ -305,6 +311,7 @@ void AutomateEditor::loadToolElements()
          "GenerateTOC" << "GenerateTOC" << tr("Generate TOC from Heading Tags.") <<
          "MendPrettifyHTML" << "MendPrettifyHTML" << tr("Mend and Prettify all XHtml files.") <<
          "MendHTML" << "MendHTML"  << tr("Mend All XHtml files.") <<
+         "MinifyCSS" << "MinifyCSS" << tr("Minify All CSS and inline style blocks.") <<
          "ReformatCSSMultipleLines" << "ReformatCSSMultipleLines" << tr("Reformat All CSS to Multiple Lines format.") <<
          "ReformatCSSSingleLines" << "ReformatCSSSingleLines" << tr("Reformat All CSS to Single Lines format.") <<
          "RemoveNCXGuideFromEpub3" << "RemoveNCXGuideFromEpub3" << tr("Remove NCX and OPF Guide from Epub3.") <<
@@ -316,6 +323,7 @@ void AutomateEditor::loadToolElements()
          "SetBookBrowserToAllImages" << "SetBookBrowserToAllImages" << tr("Select all Image Files in BookBrowser") << 
          "SetBookBrowserToInitialSelection" << "SetBookBrowserToInitialSelection" << tr("Reset BookBrowser to its initial selection") <<
          "SetPluginParameter" << "SetPluginParameter" << tr("set a string parameter to be passed to the next plugin.") <<
+         "SetSaveCompression" << "SetSaveCompression" << tr("set the compression profile used when this epub is saved.") <<
 
          "SplitOnSGFSectionMarkers" << "SplitOnSGFSectionMarkers" << tr("Split XHtml files on Sigil Section Markers") <<
          "StandardizeEpub" << "StandardizeEpub" << tr("Convert Epub layout to Sigil's historic Standard form.") <<
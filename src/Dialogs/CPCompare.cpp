@@ -28,8 +28,6 @@
 #include <QToolButton>
 #include <QListWidget>
 #include <QApplication>
-#include <QtConcurrent>
-#include <QFuture>
 #include <QFileInfo>
 #include <QMessageBox>
 #include <QDebug>
@@ -40,10 +38,10 @@
 #include "Dialogs/ViewAV.h"
 #include "Dialogs/ViewFont.h"
 #include "Dialogs/ChgViewer.h"
+#include "Misc/DiffEngine.h"
 #include "Misc/SettingsStore.h"
 #include "Misc/Utility.h"
 #include "EmbedPython/DiffRec.h"
-#include "EmbedPython/PythonRoutines.h"
 
 #include "Dialogs/CPCompare.h"
 
@@ -169,7 +167,22 @@ void CPCompare::handle_add_request()
 void CPCompare::handle_mod_request()
 {
     QStringList pathlist = m_mlist->get_selections();
-    PythonRoutines pr;
+
+    // diff all of the selected text files together
+    QList<QPair<QString, QString>> textpaths;
+    foreach(QString apath, pathlist) {
+        if (TEXT_EXTENSIONS.contains(QFileInfo(apath).suffix().toLower())) {
+            textpaths << qMakePair(m_cpdir + "/" + apath, m_bookroot + "/" + apath);
+        }
+    }
+    QList<QList<DiffRecord::DiffRec>> diffs;
+    if (!textpaths.isEmpty()) {
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        diffs = DiffEngine::ParsedDiffFiles(textpaths);
+        QApplication::restoreOverrideCursor();
+    }
+
+    int textno = 0;
     foreach(QString apath, pathlist) {
         QString leftpath = m_cpdir + "/" + apath;
         QString rightpath = m_bookroot + "/" + apath;
@@ -177,15 +190,7 @@ void CPCompare::handle_mod_request()
         QFileInfo lfi(leftpath);
         QString ext = fi.suffix().toLower();
         if (TEXT_EXTENSIONS.contains(ext)) {
-
-            QApplication::setOverrideCursor(Qt::WaitCursor);
-            QFuture<QList<DiffRecord::DiffRec>> bfuture =
-                QtConcurrent::run(&PythonRoutines::GenerateParsedNDiffInPython, &pr, leftpath, rightpath);
-            bfuture.waitForFinished();
-            QList<DiffRecord::DiffRec> diffinfo = bfuture.result();
-            QApplication::restoreOverrideCursor();
-
-            ChgViewer* cv = new ChgViewer(diffinfo, tr("Checkpoint:") + " " + apath, tr("Current:") + " " + apath, this);
+            ChgViewer* cv = new ChgViewer(diffs.at(textno++), tr("Checkpoint:") + " " + apath, tr("Current:") + " " + apath, this);
             cv->show();
             cv->raise();
         } else {
@@ -502,8 +502,8 @@ void ClipEditor::AutoFill()
     QList<CSSResource *> css_resources = m_Book->GetFolderKeeper()->GetResourceTypeList<CSSResource>(false);
 
     foreach(CSSResource * css_resource, css_resources) {
-        CSSInfo css_info(css_resource->GetText());
-        QList<CSSInfo::CSSSelector *> selectors = css_info.getClassSelectors();
+        QSharedPointer<const CSSInfo> css_info = css_resource->GetCSSInfo();
+        QList<CSSInfo::CSSSelector *> selectors = css_info->getClassSelectors();
         foreach(CSSInfo::CSSSelector *selector, selectors) {
             QString text = selector->text;
             if (!text.contains(".")) {
@@ -36,6 +36,7 @@
 #include "ResourceObjects/TextResource.h"
 #include "PCRE2/PCRECache.h"
 #include "PCRE2/SPCRE.h"
+#include "PCRE2/PCREReplaceTextBuilder.h"
 #include "Dialogs/StyledTextDelegate.h"
 #include "MainUI/FindReplace.h"
 #include "Dialogs/DryRunReplace.h"
@@ -153,22 +154,25 @@ void DryRunReplace::CreateTable()
         if (!text.isEmpty()) {
 
             // search the text using the search_regex and get all matches
-            SPCRE *spcre = PCRECache::instance()->getObject(search_regex);
-            QList<SPCRE::MatchInfo> match_info = spcre->getEveryMatchInfo(text);
+            QSharedPointer<SPCRE> spcre = PCRECache::instance()->getObject(search_regex);
+            SPCRE::MatchArray matches = spcre->getEveryMatchArray(text);
+
+            // parse the replacement pattern once for all of the matches
+            PCREReplaceTextBuilder builder;
+            bool can_replace = builder.Compile(*spcre, replace_text);
 
             // loop through matches to build up before and after snippets for table
             // and build table in reverse offset order
-            for (int i = match_info.count() - 1; i >=  0; i--) {
-                QString match_segment = Utility::Substring(match_info.at(i).offset.first,
-                                                           match_info.at(i).offset.second, 
-                                                           text);
+            for (int i = matches.count() - 1; i >=  0; i--) {
+                QString match_segment = Utility::Substring(matches.start(i), matches.end(i), text);
                 QString new_text;
-                bool can_replace = spcre->replaceText(match_segment, match_info.at(i).capture_groups_offsets, 
-                                                      replace_text, new_text);
+                if (can_replace) {
+                    builder.AppendReplacementText(text, matches.groups(i), matches.group_count, new_text);
+                }
 
                 // set pre and post context strings
-                QString prior_context  = GetPriorContext(match_info.at(i).offset.first, text, m_context_amt);
-                QString post_context = GetPostContext(match_info.at(i).offset.second, text, m_context_amt);
+                QString prior_context  = GetPriorContext(matches.start(i), text, m_context_amt);
+                QString post_context = GetPostContext(matches.end(i), text, m_context_amt);
                 
                 // finally create before and after snippets
                 QString orig_snip = prior_context + match_segment + post_context;
@@ -179,7 +183,7 @@ void DryRunReplace::CreateTable()
                     new_snip = orig_snip;
                     new_text = match_segment;
                 }
-                int start = match_info.at(i).offset.first;
+                int start = matches.start(i);
 
                 // finally add a row to the table
                 QList<QStandardItem *> rowItems;
@@ -337,11 +337,11 @@ void EditTOC::AddEntry(bool above)
 
 void EditTOC::MakeDefaultFirstSelection()
 {
-    QStandardItem *root_item = m_TOCModel->invisibleRootItem();
+    QStandardItem *root_item = m_TableOfContents->invisibleRootItem();
     // Set the default to the first item
     if (root_item->rowCount() > 0) {
         ui.TOCTree->selectionModel()->clear();
-        ui.TOCTree->selectionModel()->select(m_TOCModel->index(0, 0, QModelIndex()), QItemSelectionModel::Select | QItemSelectionModel::Rows);
+        ui.TOCTree->selectionModel()->select(m_TableOfContents->index(0, 0, QModelIndex()), QItemSelectionModel::Select | QItemSelectionModel::Rows);
     }
 }
 
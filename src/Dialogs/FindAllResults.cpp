@@ -0,0 +1,359 @@
+/************************************************************************
+**
+**  Copyright (C) 2022 Kevin B. Hendricks, Stratford, Ontario
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QPushButton>
+#include <QTreeView>
+#include <QHeaderView>
+#include <QModelIndex>
+#include <QApplication>
+#include "Misc/FileSearchIndex.h"
+#include "Misc/NumericItem.h"
+#include "Misc/SettingsStore.h"
+#include "ResourceObjects/Resource.h"
+#include "Dialogs/StyledTextDelegate.h"
+#include "MainUI/FindReplace.h"
+#include "Dialogs/FindAllResults.h"
+
+
+static const QString SETTINGS_GROUP = "findall_report";
+
+// These need to be changed if columns added or deleted
+static const int OFFSET_COL = 2;
+static const int MATCH_COL = 3;
+
+// Position of the file in the list of resources searched, used
+// to keep the file rows in order as results arrive out of order
+static const int ORDER_ROLE = Qt::UserRole + 4;
+
+// Edits are collected for this long before the files are scanned again
+static const int RESCAN_DELAY_MS = 500;
+
+FindAllResults::FindAllResults(QWidget* parent)
+    :
+    QDialog(parent),
+    m_ItemModel(new QStandardItemModel),
+    m_TextDelegate(new StyledTextDelegate(this)),
+    m_SearchIndex(new FileSearchIndex(this)),
+    m_Stopped(false)
+{
+    m_FindReplace = qobject_cast<FindReplace*>(parent);
+    ui.setupUi(this);
+    setAttribute(Qt::WA_DeleteOnClose, true);
+    ui.amtcb->setSizeAdjustPolicy(QComboBox::AdjustToContents);
+    ui.amtcb->addItem("10",10);
+    ui.amtcb->addItem("20",20);
+    ui.amtcb->addItem("30",30);
+    ui.amtcb->addItem("40",40);
+    ui.amtcb->addItem("50",50);
+    ui.amtcb->setEditable(false);
+    m_RescanTimer.setSingleShot(true);
+    m_RescanTimer.setInterval(RESCAN_DELAY_MS);
+    ReadSettings();
+    connectSignalsSlots();
+    ui.resultsTree->setSortingEnabled(false);
+    // only impacts non-delegated columns
+    ui.resultsTree->setTextElideMode(Qt::ElideLeft);
+    ui.Refresh->setAutoDefault(false);
+    ui.Refresh->setDefault(false);
+    ui.Refresh->setFocusPolicy(Qt::TabFocus);
+    ui.Stop->setAutoDefault(false);
+    ui.Stop->setDefault(false);
+    ui.Stop->setFocusPolicy(Qt::TabFocus);
+    ui.closeButton->setAutoDefault(false);
+    ui.closeButton->setDefault(false);
+    ui.closeButton->setFocusPolicy(Qt::TabFocus);
+}
+
+FindAllResults::~FindAllResults()
+{
+    m_SearchIndex->Clear();
+    m_ItemModel->clear();
+    delete m_ItemModel;
+}
+
+
+void FindAllResults::closeEvent(QCloseEvent *e)
+{
+    WriteSettings();
+    QDialog::closeEvent(e);
+}
+
+void FindAllResults::reject()
+{
+    WriteSettings();
+    QDialog::reject();
+}
+
+void FindAllResults::CreateTable()
+{
+    m_FindReplace->ShowMessage(tr("... Finding all matches"));
+    m_RescanTimer.stop();
+    m_SearchIndex->Clear();
+    m_ItemModel->clear();
+    m_FileItems.clear();
+    m_Counts.clear();
+    m_PendingRescan.clear();
+    m_Stopped = false;
+
+    QStringList header;
+    header.append(tr("Book Path"));
+    header.append(tr("Line"));
+    header.append(tr("Offset"));
+    header.append(tr("Match"));
+    m_ItemModel->setHorizontalHeaderLabels(header);
+    ui.resultsTree->setSelectionBehavior(QAbstractItemView::SelectRows);
+    ui.resultsTree->setModel(m_ItemModel);
+    // set styled text item delegate for the match column
+    ui.resultsTree->setItemDelegateForColumn(MATCH_COL, m_TextDelegate);
+
+    QList<Resource*> resources = m_FindReplace->GetAllResourcesToSearch();
+    QString search_regex = m_FindReplace->GetSearchRegex();
+
+    UpdateCount();
+    if (resources.isEmpty() || search_regex.isEmpty()) {
+        SetScanning(false);
+        return;
+    }
+    SetScanning(true);
+    m_SearchIndex->SetContextLength(m_context_amt);
+    m_SearchIndex->Start(search_regex, resources);
+}
+
+
+void FindAllResults::ResourceScanned(Resource *resource, int count)
+{
+    bool expanded = true;
+    if (m_FileItems.contains(resource)) {
+        QStandardItem *old_item = m_FileItems.take(resource);
+        expanded = ui.resultsTree->isExpanded(old_item->index());
+        m_ItemModel->removeRow(old_item->row());
+    }
+    m_Counts.insert(resource, count);
+    UpdateCount();
+    if (count == 0) {
+        return;
+    }
+
+    int order = m_SearchIndex->GetResources().indexOf(resource);
+    QList<FileSearchIndex::Match> matches = m_SearchIndex->Matches(resource);
+
+    QList<QStandardItem *> file_row;
+    QStandardItem *file_item = new QStandardItem();
+    file_item->setText(resource->GetRelativePath());
+    file_item->setData(order, ORDER_ROLE);
+    file_row << file_item;
+    file_row << new QStandardItem();
+    file_row << new QStandardItem();
+    QStandardItem *count_item = new QStandardItem();
+    count_item->setText(tr("%n match(es)", "", count));
+    file_row << count_item;
+    for (int i = 0; i < file_row.count(); i++) {
+        file_row[i]->setEditable(false);
+    }
+
+    foreach(const FileSearchIndex::Match &match, matches) {
+        QList<QStandardItem *> rowItems;
+
+        rowItems << new QStandardItem();
+
+        // Line
+        NumericItem *line_item = new NumericItem();
+        line_item->setText(QString::number(match.line));
+        line_item->setTextAlignment(Qt::AlignRight|Qt::AlignVCenter);
+        rowItems << line_item;
+
+        // Offset
+        NumericItem *offset_item = new NumericItem();
+        offset_item->setText(QString::number(match.offset));
+        offset_item->setTextAlignment(Qt::AlignRight|Qt::AlignVCenter);
+        rowItems << offset_item;
+
+        // Match in context
+        QStandardItem *item = new QStandardItem();
+        item->setText(match.prior_context + match.matched_text + match.post_context);
+        item->setData(match.prior_context.length(), Qt::UserRole+1);
+        item->setData(match.prior_context.length() + match.matched_text.length(), Qt::UserRole+2);
+        item->setData(match.matched_text, Qt::UserRole+3);
+        rowItems << item;
+
+        for (int i = 0; i < rowItems.count(); i++) {
+            rowItems[i]->setEditable(false);
+        }
+        file_item->appendRow(rowItems);
+    }
+
+    // Keep the files in the order they are searched
+    QStandardItem *root_item = m_ItemModel->invisibleRootItem();
+    int row = 0;
+    while (row < root_item->rowCount() && root_item->child(row, 0)->data(ORDER_ROLE).toInt() < order) {
+        row++;
+    }
+    m_ItemModel->insertRow(row, file_row);
+    m_FileItems.insert(resource, file_item);
+    ui.resultsTree->setExpanded(file_item->index(), expanded);
+    if (m_ItemModel->rowCount() == 1) {
+        for (int i = 0; i < ui.resultsTree->header()->count(); i++) {
+            ui.resultsTree->resizeColumnToContents(i);
+        }
+    }
+}
+
+
+void FindAllResults::ResourceInvalidated(Resource *resource)
+{
+    m_PendingRescan.insert(resource);
+    m_RescanTimer.start();
+}
+
+
+void FindAllResults::RescanPending()
+{
+    QList<Resource *> resources = m_SearchIndex->GetResources();
+    foreach(Resource *resource, m_PendingRescan) {
+        if (resources.contains(resource)) {
+            // Emits ResourceScanned which replaces the rows of the file
+            m_SearchIndex->Matches(resource);
+        } else {
+            // The file has been deleted
+            if (m_FileItems.contains(resource)) {
+                m_ItemModel->removeRow(m_FileItems.take(resource)->row());
+            }
+            m_Counts.remove(resource);
+        }
+    }
+    m_PendingRescan.clear();
+    UpdateCount();
+}
+
+
+void FindAllResults::ScanFinished()
+{
+    // a cancelled scan also finishes, Stop has already updated the status
+    if (m_Stopped) {
+        return;
+    }
+    SetScanning(false);
+    m_FindReplace->ShowMessage(tr("Find All"));
+}
+
+
+void FindAllResults::Stop()
+{
+    m_Stopped = true;
+    m_SearchIndex->Cancel();
+    SetScanning(false);
+    ui.statuslbl->setText(tr("Stopped"));
+}
+
+
+void FindAllResults::UpdateCount()
+{
+    int count = 0;
+    foreach(int file_count, m_Counts) {
+        count += file_count;
+    }
+    // display the count above the table (with a buffer to the right)
+    ui.cntamt->setText(QString::number(count) + "   ");
+}
+
+
+void FindAllResults::SetScanning(bool scanning)
+{
+    ui.Stop->setEnabled(scanning);
+    ui.statuslbl->setText(scanning ? tr("Searching...") : QString());
+}
+
+
+void FindAllResults::DoubleClick()
+{
+    QModelIndexList selected = ui.resultsTree->selectionModel()->selectedRows(0);
+    if (selected.isEmpty()) {
+        return;
+    }
+    QModelIndex index = selected.first();
+    QModelIndex file_index = index.parent();
+    if (!file_index.isValid()) {
+        // a file row, go to its first match
+        file_index = index;
+        index = m_ItemModel->index(0, 0, file_index);
+        if (!index.isValid()) {
+            return;
+        }
+    }
+    QString bookpath = m_ItemModel->itemFromIndex(file_index)->text();
+    int pos = m_ItemModel->itemFromIndex(index.sibling(index.row(), OFFSET_COL))->text().toInt();
+    m_FindReplace->EmitOpenFileRequest(bookpath, -1, pos);
+}
+
+void FindAllResults::ReadSettings()
+{
+    SettingsStore settings;
+    settings.beginGroup(SETTINGS_GROUP);
+    QByteArray geometry = settings.value("geometry").toByteArray();
+    if (!geometry.isNull()) {
+        restoreGeometry(geometry);
+    }
+    m_context_amt = settings.value("context",20).toInt();
+    SetContextCB(m_context_amt);
+    settings.endGroup();
+}
+
+void FindAllResults::SetContextCB(int val)
+{
+    int index = 0;
+    if (val >= 20) index = 1;
+    if (val >= 30) index = 2;
+    if (val >= 40) index = 3;
+    if (val >= 50) index = 4;
+    ui.amtcb->setCurrentIndex(index);
+}
+
+void FindAllResults::ChangeContext()
+{
+    int val = ui.amtcb->currentData().toInt();
+    if (val != m_context_amt) {
+        m_context_amt = val;
+        CreateTable();
+    }
+}
+
+void FindAllResults::WriteSettings()
+{
+    SettingsStore settings;
+    settings.beginGroup(SETTINGS_GROUP);
+    settings.setValue("geometry", saveGeometry());
+    settings.setValue("context", m_context_amt);
+    settings.endGroup();
+}
+
+
+void FindAllResults::connectSignalsSlots()
+{
+    connect(m_SearchIndex, SIGNAL(ResourceScanned(Resource *, int)), this, SLOT(ResourceScanned(Resource *, int)));
+    connect(m_SearchIndex, SIGNAL(ResourceInvalidated(Resource *)), this, SLOT(ResourceInvalidated(Resource *)));
+    connect(m_SearchIndex, SIGNAL(Finished()), this, SLOT(ScanFinished()));
+    connect(&m_RescanTimer, SIGNAL(timeout()), this, SLOT(RescanPending()));
+    connect(ui.Refresh, SIGNAL(clicked()), this, SLOT(CreateTable()));
+    connect(ui.Stop, SIGNAL(clicked()), this, SLOT(Stop()));
+    connect(ui.closeButton, SIGNAL(clicked()), this, SLOT(close()));
+    connect(ui.resultsTree, SIGNAL(doubleClicked(const QModelIndex &)), this, SLOT(DoubleClick()));
+    connect(ui.amtcb, SIGNAL(currentIndexChanged(int)), this, SLOT(ChangeContext()));
+}
@@ -0,0 +1,110 @@
+/************************************************************************
+**
+**  Copyright (C) 2022 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef FINDALLRESULTS_H
+#define FINDALLRESULTS_H
+
+#include <QDialog>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QStandardItemModel>
+#include <QTimer>
+#include "Dialogs/StyledTextDelegate.h"
+#include "ui_FindAllResults.h"
+
+
+class QCloseEvent;
+class QString;
+class FindReplace;
+class FileSearchIndex;
+class Resource;
+
+/**
+ * Lists every match of the current search, grouped by file.
+ *
+ * The table fills in as the background scan finishes each file
+ * and a file that is edited while the dialog is open is scanned
+ * again on its own.
+ */
+class FindAllResults: public QDialog
+{
+    Q_OBJECT
+
+public:
+    FindAllResults(QWidget* parent=NULL);
+    ~FindAllResults();
+
+public slots:
+
+    void CreateTable();
+
+    void DoubleClick();
+
+    void closeEvent(QCloseEvent *e);
+    void reject();
+
+private slots:
+    void ResourceScanned(Resource *resource, int count);
+    void ResourceInvalidated(Resource *resource);
+    void ScanFinished();
+    void RescanPending();
+    void Stop();
+    void ChangeContext();
+
+private:
+    void UpdateCount();
+    void SetScanning(bool scanning);
+
+    void ReadSettings();
+    void WriteSettings();
+
+    void SetContextCB(int val);
+
+    void connectSignalsSlots();
+
+    QStandardItemModel *m_ItemModel;
+
+    StyledTextDelegate* m_TextDelegate;
+
+    FindReplace * m_FindReplace;
+
+    FileSearchIndex *m_SearchIndex;
+
+    // The top level row of each file that has matches
+    QHash<Resource *, QStandardItem *> m_FileItems;
+
+    QHash<Resource *, int> m_Counts;
+
+    // Files edited since they were last scanned
+    QSet<Resource *> m_PendingRescan;
+
+    QTimer m_RescanTimer;
+
+    bool m_Stopped;
+
+    int m_context_amt;
+
+    Ui::FindAllResults ui;
+};
+
+#endif // FINDALLRESULTS_H
@@ -32,6 +32,7 @@
 
 #include "Misc/SettingsStore.h"
 #include "Misc/Utility.h"
+#include "Misc/WebProfileMgr.h"
 #include "Dialogs/Inspector.h"
 
 static const QString SETTINGS_GROUP = "inspect_dialog";
@@ -68,6 +69,8 @@ Inspector::Inspector(QWidget *parent, Qt::WindowFlags flags) :
         storageDir.mkpath(inspectorStorePath);
     }
     m_inspectView->page()->profile()->setPersistentStoragePath(inspectorStorePath);
+    // the inspector is only hidden when closed, not deleted
+    WebProfileMgr::instance()->DiscardWhenHidden(m_inspectView);
 
     LoadSettings();
     connect(m_inspectView->page(), SIGNAL(loadFinished(bool)), this, SLOT(UpdateFinishedState(bool)));
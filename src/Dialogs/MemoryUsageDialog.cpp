@@ -0,0 +1,125 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QtCore/QLocale>
+#include <QtGui/QClipboard>
+#include <QtWidgets/QApplication>
+#include <QtWidgets/QDialogButtonBox>
+#include <QtWidgets/QHeaderView>
+#include <QtWidgets/QLabel>
+#include <QtWidgets/QPushButton>
+#include <QtWidgets/QTableWidget>
+#include <QtWidgets/QVBoxLayout>
+
+#include "Dialogs/MemoryUsageDialog.h"
+#include "Misc/SettingsStore.h"
+
+static const QString SETTINGS_GROUP = "memory_usage";
+
+MemoryUsageDialog::MemoryUsageDialog(QSharedPointer<Book> book, QWidget *parent)
+    :
+    QDialog(parent),
+    m_Book(book),
+    m_MainWindow(parent),
+    m_Table(new QTableWidget(this)),
+    m_Total(new QLabel(this))
+{
+    setWindowTitle(tr("Memory Usage"));
+    m_Table->setColumnCount(3);
+    m_Table->setHorizontalHeaderLabels(QStringList() << tr("Held by") << tr("Items") << tr("Size"));
+    m_Table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_Table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_Table->verticalHeader()->hide();
+    m_Table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    QPushButton *refresh = buttons->addButton(tr("Refresh"), QDialogButtonBox::ActionRole);
+    QPushButton *copy = buttons->addButton(tr("Copy"), QDialogButtonBox::ActionRole);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(m_Table);
+    layout->addWidget(m_Total);
+    layout->addWidget(buttons);
+
+    connect(refresh, SIGNAL(clicked()), this, SLOT(Refresh()));
+    connect(copy, SIGNAL(clicked()), this, SLOT(CopyToClipboard()));
+    connect(buttons, SIGNAL(rejected()), this, SLOT(reject()));
+
+    ReadSettings();
+    Refresh();
+}
+
+
+MemoryUsageDialog::~MemoryUsageDialog()
+{
+    WriteSettings();
+}
+
+
+void MemoryUsageDialog::Refresh()
+{
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    m_Items = MemoryUsage::Collect(m_Book, m_MainWindow);
+    MemoryUsage::AddToTrace(m_Items);
+    QApplication::restoreOverrideCursor();
+
+    QLocale locale;
+    m_Table->setRowCount(m_Items.count());
+    for (int i = 0; i < m_Items.count(); ++i) {
+        const MemoryUsage::Item &item = m_Items.at(i);
+        m_Table->setItem(i, 0, new QTableWidgetItem(item.name));
+        QTableWidgetItem *count_item = new QTableWidgetItem(QString::number(item.count));
+        count_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        m_Table->setItem(i, 1, count_item);
+        QTableWidgetItem *size_item = new QTableWidgetItem(locale.formattedDataSize(item.bytes));
+        size_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        m_Table->setItem(i, 2, size_item);
+    }
+    m_Table->resizeColumnsToContents();
+    m_Total->setText(tr("Total: %1").arg(locale.formattedDataSize(MemoryUsage::Total(m_Items))));
+}
+
+
+void MemoryUsageDialog::CopyToClipboard()
+{
+    QApplication::clipboard()->setText(MemoryUsage::ToText(m_Items));
+}
+
+
+void MemoryUsageDialog::ReadSettings()
+{
+    SettingsStore settings;
+    settings.beginGroup(SETTINGS_GROUP);
+    QByteArray geometry = settings.value("geometry").toByteArray();
+    if (!geometry.isNull()) {
+        restoreGeometry(geometry);
+    }
+    settings.endGroup();
+}
+
+
+void MemoryUsageDialog::WriteSettings()
+{
+    SettingsStore settings;
+    settings.beginGroup(SETTINGS_GROUP);
+    settings.setValue("geometry", saveGeometry());
+    settings.endGroup();
+}
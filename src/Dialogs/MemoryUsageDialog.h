@@ -0,0 +1,69 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef MEMORYUSAGEDIALOG_H
+#define MEMORYUSAGEDIALOG_H
+
+#include <QtCore/QSharedPointer>
+#include <QtWidgets/QDialog>
+
+#include "Misc/MemoryUsage.h"
+
+class Book;
+class QLabel;
+class QTableWidget;
+
+/**
+ * Shows how much memory the book, its open tabs and the caches hold.
+ */
+class MemoryUsageDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+
+    MemoryUsageDialog(QSharedPointer<Book> book, QWidget *parent);
+    ~MemoryUsageDialog();
+
+public slots:
+
+    void Refresh();
+
+    void CopyToClipboard();
+
+private:
+
+    void ReadSettings();
+    void WriteSettings();
+
+    QSharedPointer<Book> m_Book;
+
+    QWidget *m_MainWindow;
+
+    QTableWidget *m_Table;
+
+    QLabel *m_Total;
+
+    QList<MemoryUsage::Item> m_Items;
+};
+
+#endif // MEMORYUSAGEDIALOG_H
@@ -19,8 +19,6 @@
 **
 *************************************************************************/
 
-#include "EmbedPython/PythonRoutines.h"
-
 #include <QString>
 #include <QChar>
 #include <QString>
@@ -63,7 +61,7 @@ MetaEditor::MetaEditor(QWidget *parent)
     view->setWordWrap(true);
     m_book = m_mainWindow->GetCurrentBook();
     m_version = m_book->GetConstOPF()->GetEpubVersion();
-    m_opfdata = m_book->GetOPF()->GetText();
+    m_metadata.ExtractRecognizedMetadata(m_book->GetConstOPF()->GetPackage(), m_version);
 
     if (m_version.startsWith('3')) { 
         loadMetadataElements();
@@ -252,12 +250,7 @@ void MetaEditor::loadE2Choices()
 
 
 QString MetaEditor::GetOPFMetadata() {
-    PythonRoutines pr;
-    MetadataPieces mdp = pr.GetMetadataInPython(m_opfdata, m_version);
-    QString adata = mdp.data;
-    m_otherxml = mdp.otherxml;
-    m_metatag = mdp.metatag;
-    m_idlist = mdp.idlist;
+    QString adata = m_metadata.GetRecognizedMetadata();
     // Translate to Human Readable Form
     // and set original codes as tooltips
     QStringList nlist;
@@ -309,10 +302,8 @@ QString MetaEditor::GetOPFMetadata() {
 }
 
 
-QString MetaEditor::SetNewOPFMetadata(QString& data) 
+QList<MetaEntry> MetaEditor::SetNewOPFMetadata(QString& data) 
 {
-    QString newopfdata = m_opfdata;
-    MetadataPieces mdp;
     // Translate from Human Readable Form
     QStringList dlist = data.split(_RS, Qt::SkipEmptyParts);
     QStringList nlist;
@@ -363,16 +354,7 @@ QString MetaEditor::SetNewOPFMetadata(QString& data)
             nlist.append(elem + _US + value + _RS);
         }
     }
-    mdp.data = nlist.join("");
-    mdp.otherxml = m_otherxml;
-    mdp.metatag = m_metatag;
-    mdp.idlist = m_idlist;
-    PythonRoutines pr;
-    QString results = pr.SetNewMetadataInPython(mdp, m_opfdata, m_version);
-    if (!results.isEmpty()) {
-        newopfdata = results;
-    }
-    return newopfdata;
+    return m_metadata.BuildMetadata(nlist.join(""));
 }
 
 void MetaEditor::MakeDefaultFirstSelection()
@@ -728,8 +710,8 @@ void MetaEditor::saveData()
     TreeModel *model = qobject_cast<TreeModel *>(view->model());
     QString data = model->getAllModelData();
 
-    QString newopfdata = SetNewOPFMetadata(data);
-    m_book->GetOPF()->SetText(newopfdata);
+    QList<MetaEntry> metadata = SetNewOPFMetadata(data);
+    m_book->GetOPF()->SetMetadata(m_metadata.GetMetadataTag(), metadata);
     QDialog::accept();
 }
 
@@ -27,6 +27,7 @@
 #include <QModelIndex>
 #include <QHash>
 #include "Misc/DescriptiveInfo.h"
+#include "Parsers/OPFMetadata.h"
 
 #include "ui_MetaEditor.h"
 
@@ -96,7 +97,7 @@ private slots:
     void ReadSettings();
 
     QString GetOPFMetadata();
-    QString SetNewOPFMetadata(QString& data);
+    QList<MetaEntry> SetNewOPFMetadata(QString& data);
 
     QHash<QString, DescriptiveInfo> m_ElementInfo;
     QHash<QString, QString> m_ElementCode;
@@ -114,10 +115,7 @@ private slots:
     MetaEditorItemDelegate * m_cbDelegate;
     QSharedPointer<Book> m_book;
     QString m_version;
-    QString m_opfdata;
-    QString m_otherxml;
-    QString m_metatag;
-    QStringList m_idlist;
+    OPFMetadata m_metadata;
     
 };
 
@@ -0,0 +1,156 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QtCore/QFileInfo>
+#include <QtWidgets/QDialogButtonBox>
+#include <QtWidgets/QFileDialog>
+#include <QtWidgets/QHeaderView>
+#include <QtWidgets/QPushButton>
+#include <QtWidgets/QTableWidget>
+#include <QtWidgets/QVBoxLayout>
+
+#include "Dialogs/PerformanceHistory.h"
+#include "Misc/SettingsStore.h"
+#include "Misc/Utility.h"
+#include "sigil_exception.h"
+
+static const QString SETTINGS_GROUP = "performance_history";
+static const QString DEFAULT_FILENAME = "performance_history.csv";
+
+PerformanceHistory::PerformanceHistory(QWidget *parent)
+    :
+    QDialog(parent),
+    m_Table(new QTableWidget(this))
+{
+    setWindowTitle(tr("Performance History"));
+    m_Table->setColumnCount(5);
+    m_Table->setHorizontalHeaderLabels(QStringList() << tr("Finished") << tr("Book") << tr("Operation")
+                                                     << tr("Time") << tr("Details"));
+    m_Table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_Table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_Table->verticalHeader()->hide();
+    m_Table->horizontalHeader()->setStretchLastSection(true);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    QPushButton *export_csv = buttons->addButton(tr("Export CSV..."), QDialogButtonBox::ActionRole);
+    QPushButton *clear = buttons->addButton(tr("Clear"), QDialogButtonBox::ActionRole);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addWidget(m_Table);
+    layout->addWidget(buttons);
+
+    connect(export_csv, SIGNAL(clicked()), this, SLOT(ExportCSV()));
+    connect(clear, SIGNAL(clicked()), this, SLOT(ClearHistory()));
+    connect(buttons, SIGNAL(rejected()), this, SLOT(reject()));
+    connect(OperationLog::instance(), &OperationLog::EntryAdded, this, &PerformanceHistory::AddEntry);
+    connect(OperationLog::instance(), &OperationLog::Cleared, this, &PerformanceHistory::Reload);
+
+    ReadSettings();
+    Reload();
+}
+
+
+PerformanceHistory::~PerformanceHistory()
+{
+    WriteSettings();
+}
+
+
+void PerformanceHistory::Reload()
+{
+    m_Table->setRowCount(0);
+    foreach(const OperationLog::Entry &entry, OperationLog::instance()->GetEntries()) {
+        AddEntry(entry);
+    }
+    m_Table->resizeColumnsToContents();
+}
+
+
+void PerformanceHistory::AddEntry(const OperationLog::Entry &entry)
+{
+    int row = m_Table->rowCount();
+    m_Table->insertRow(row);
+    m_Table->setItem(row, 0, new QTableWidgetItem(entry.finished.toString("HH:mm:ss")));
+    m_Table->setItem(row, 1, new QTableWidgetItem(entry.book));
+    m_Table->setItem(row, 2, new QTableWidgetItem(entry.label));
+    QTableWidgetItem *time_item = new QTableWidgetItem(OperationLog::FormatDuration(entry.milliseconds));
+    time_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+    m_Table->setItem(row, 3, time_item);
+    m_Table->setItem(row, 4, new QTableWidgetItem(entry.details));
+    m_Table->scrollToBottom();
+}
+
+
+void PerformanceHistory::ExportCSV()
+{
+    QString filter_string = "*.csv;;*.txt;;*.*";
+    QString default_filter = "";
+    QFileDialog::Options options = QFileDialog::Options();
+#ifdef Q_OS_MAC
+    options = options | QFileDialog::DontUseNativeDialog;
+#endif
+
+    QString destination = QFileDialog::getSaveFileName(this,
+                                                       tr("Save Performance History As Comma Separated File"),
+                                                       m_LastDirSaved + "/" + DEFAULT_FILENAME,
+                                                       filter_string,
+                                                       &default_filter,
+                                                       options);
+    if (destination.isEmpty()) {
+        return;
+    }
+
+    try {
+        Utility::WriteUnicodeTextFile(OperationLog::instance()->ToCSV(), destination);
+    } catch (CannotOpenFile&) {
+        Utility::warning(this, tr("Sigil"), tr("Cannot save report file."));
+    }
+    m_LastDirSaved = QFileInfo(destination).absolutePath();
+}
+
+
+void PerformanceHistory::ClearHistory()
+{
+    OperationLog::instance()->Clear();
+}
+
+
+void PerformanceHistory::ReadSettings()
+{
+    SettingsStore settings;
+    settings.beginGroup(SETTINGS_GROUP);
+    QByteArray geometry = settings.value("geometry").toByteArray();
+    if (!geometry.isNull()) {
+        restoreGeometry(geometry);
+    }
+    m_LastDirSaved = settings.value("last_dir_saved").toString();
+    settings.endGroup();
+}
+
+
+void PerformanceHistory::WriteSettings()
+{
+    SettingsStore settings;
+    settings.beginGroup(SETTINGS_GROUP);
+    settings.setValue("geometry", saveGeometry());
+    settings.setValue("last_dir_saved", m_LastDirSaved);
+    settings.endGroup();
+}
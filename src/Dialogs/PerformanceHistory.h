@@ -0,0 +1,68 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef PERFORMANCEHISTORY_H
+#define PERFORMANCEHISTORY_H
+
+#include <QtWidgets/QDialog>
+
+#include "Misc/OperationLog.h"
+
+class QTableWidget;
+
+/**
+ * Lists the book wide operations run this session with how long each
+ * took, so that the books that are slow to work on stand out.  Rows
+ * are added while the panel is open and can be saved as csv.
+ */
+class PerformanceHistory : public QDialog
+{
+    Q_OBJECT
+
+public:
+
+    PerformanceHistory(QWidget *parent);
+    ~PerformanceHistory();
+
+public slots:
+
+    void ExportCSV();
+
+    void ClearHistory();
+
+private slots:
+
+    void AddEntry(const OperationLog::Entry &entry);
+
+    void Reload();
+
+private:
+
+    void ReadSettings();
+    void WriteSettings();
+
+    QTableWidget *m_Table;
+
+    QString m_LastDirSaved;
+};
+
+#endif // PERFORMANCEHISTORY_H
@@ -32,17 +32,23 @@
 #include <QProcessEnvironment>
 #include <QApplication>
 #include <QPalette>
+#include <QScopeGuard>
+#include <QtConcurrent/QtConcurrent>
 
 #include "MainUI/MainWindow.h"
 #include "MainUI/BookBrowser.h"
+#include "Misc/OperationLog.h"
 #include "Misc/Plugin.h"
 #include "Misc/PluginDB.h"
+#include "Misc/PluginSession.h"
 #include "Misc/SettingsStore.h"
+#include "Misc/Trace.h"
 #include "Misc/Utility.h"
 #include "Misc/TempFolder.h"
 #include "Tabs/TabManager.h"
 #include "BookManipulation/CleanSource.h"
 #include "BookManipulation/XhtmlDoc.h"
+#include "Exporters/ExportEPUB.h"
 #include "Dialogs/PluginRunner.h"
 #include "sigil_constants.h"
 
@@ -66,7 +72,8 @@ PluginRunner::PluginRunner(TabManager *tabMgr, QWidget *parent)
       m_fontMangling(""),
       m_result(""),
       m_xhtml_net_change(0),
-      m_ready(false)
+      m_ready(false),
+      m_inSession(false)
 
 {
     // get book manipulation objects
@@ -105,6 +112,10 @@ PluginRunner::PluginRunner(TabManager *tabMgr, QWidget *parent)
 
 PluginRunner::~PluginRunner()
 {
+    // the checks read and write files in the output folder
+    for (int i = 0; i < m_wellFormedChecks.count(); i++) {
+        m_wellFormedChecks[i].waitForFinished();
+    }
 }
 
 QStringList PluginRunner::SupportedEngines()
@@ -137,6 +148,7 @@ int PluginRunner::exec(const QString &name)
     m_pluginsFolder = PluginDB::pluginsPath();
     m_pluginType = plugin->get_type();
     m_pluginAutoClose = plugin->get_autoclose();
+    m_pluginSession = plugin->get_session();
 
     m_engine = plugin->get_engine();
     // Use the bundled interpreter if user requested it (and plugin supports it)
@@ -277,15 +289,19 @@ void PluginRunner::startPlugin()
     ui.textEdit->clear();
     ui.textEdit->setOverwriteMode(true);
     ui.textEdit->setPlainText("");
+    m_runTimer.start();
 
     // create the sigil cfg file in the output directory
     writeSigilCFG();
 
     // prepare for the plugin by flushing all current book changes to disk
-    m_mainWindow->SaveTabData();
-    m_book->GetFolderKeeper()->SuspendWatchingResources();
-    m_book->SaveAllResourcesToDisk();
-    m_book->GetFolderKeeper()->ResumeWatchingResources();
+    {
+        TRACE_SPAN(span, "PluginRunner::SaveBook");
+        m_mainWindow->SaveTabData();
+        m_book->GetFolderKeeper()->SuspendWatchingResources();
+        m_book->SaveAllResourcesToDisk();
+        m_book->GetFolderKeeper()->ResumeWatchingResources();
+    }
     ui.startButton->setEnabled(false);
     ui.okButton->setEnabled(false);
     ui.cancelButton->setEnabled(true);
@@ -413,8 +429,25 @@ void PluginRunner::startPlugin()
 
     // For plugins to handle mismatches between PyQt5 and PySide6
     env.insert("SIGIL_QT_RUNTIME_VERSION", QString(qVersion()));
-    m_process.setProcessEnvironment(env);
-    m_process.start(executable, args);
+    // plugins that ask for it, or all of them if the user wants, reuse the launcher left
+    // running by the last run, falling back to a launcher of their own if it is still busy
+    if ((m_pluginSession == "true") || settings.pluginWarmHost()) {
+        PluginSession *session = PluginSession::instance();
+        connect(session, SIGNAL(RunOutput(const QByteArray &)), this, SLOT(outputReceived(const QByteArray &)));
+        connect(session, SIGNAL(RunError(const QByteArray &)), this, SLOT(errorReceived(const QByteArray &)));
+        connect(session, SIGNAL(RunFinished(int, QProcess::ExitStatus)), this, SLOT(pluginFinished(int, QProcess::ExitStatus)));
+        connect(session, SIGNAL(RunFailed(QProcess::ProcessError)), this, SLOT(processError(QProcess::ProcessError)));
+        // the last four arguments describe the run, the rest start the launcher
+        m_inSession = session->Run(executable, args.mid(0, args.count() - 4), args.mid(args.count() - 4),
+                                   env, m_process.workingDirectory());
+        if (!m_inSession) {
+            session->disconnect(this);
+        }
+    }
+    if (!m_inSession) {
+        m_process.setProcessEnvironment(env);
+        m_process.start(executable, args);
+    }
     ui.statusLbl->setText(tr("Status: running"));
 
     // this starts the infinite progress bar
@@ -424,14 +457,41 @@ void PluginRunner::startPlugin()
 
 void PluginRunner::processOutput()
 {
-    QByteArray newbytedata = m_process.readAllStandardOutput();
-    ui.textEdit->insertPlainText(newbytedata);
-    m_pluginOutput = m_pluginOutput + newbytedata;
+    outputReceived(m_process.readAllStandardOutput());
+}
+
+
+void PluginRunner::outputReceived(const QByteArray &data)
+{
+    ui.textEdit->insertPlainText(data);
+    m_pluginOutput = m_pluginOutput + data;
+}
+
+
+void PluginRunner::errorReceived(const QByteArray &data)
+{
+    ui.textEdit->append(data);
+}
+
+
+void PluginRunner::leaveSession()
+{
+    if (m_inSession) {
+        PluginSession::instance()->disconnect(this);
+        m_inSession = false;
+    }
 }
 
 
 void PluginRunner::pluginFinished(int exitcode, QProcess::ExitStatus exitstatus)
 {
+    TRACE_SPAN(span, "PluginRunner::ApplyResults");
+    TRACE_ARG(span, "plugin", m_pluginName);
+    // however the run ends it goes in the Performance History
+    auto log_run = qScopeGuard([this]() {
+        OperationLog::instance()->Add(tr("Plugin: %1").arg(m_pluginName), m_runTimer.elapsed(), m_result);
+    });
+    leaveSession();
     if (exitstatus == QProcess::CrashExit) {
         ui.textEdit->append(tr("Launcher process crashed"));
         m_result = "crashed";
@@ -555,8 +615,7 @@ void PluginRunner::pluginFinished(int exitcode, QProcess::ExitStatus exitstatus)
 
 void PluginRunner::processError()
 {
-    QByteArray newbytedata = m_process.readAllStandardError();
-    ui.textEdit->append(newbytedata);
+    errorReceived(m_process.readAllStandardError());
 }
 
 
@@ -565,6 +624,7 @@ void PluginRunner::processError(QProcess::ProcessError error)
     if (error == QProcess::FailedToStart) {
         ui.textEdit->append(tr("Plugin failed to start"));
     }
+    leaveSession();
     ui.okButton->setEnabled(true);
     ui.cancelButton->setEnabled(false);
 
@@ -587,6 +647,11 @@ void PluginRunner::cancelPlugin()
     // qDebug() << "in cancelPlugin()";
     m_result = "cancelled";
 
+    if (m_inSession) {
+        leaveSession();
+        PluginSession::instance()->Stop();
+    }
+
     if (m_process.state() == QProcess::Running) {
         m_process.terminate();
     }
@@ -629,6 +694,11 @@ bool PluginRunner::processResultXML()
             } else if (name == "msg") {
                 QString msg = reader.readElementText();
                 ui.textEdit->append(msg);
+            } else if (name == "savecompression") {
+                QString profile = reader.readElementText().trimmed();
+                if (ExportEPUB::CompressionProfiles().contains(profile)) {
+                    m_book->SetSaveCompression(profile);
+                }
             } else if (CHANGESTAGS.contains(name)) {
                 QStringList info;
                 QString href;
@@ -655,8 +725,10 @@ bool PluginRunner::processResultXML()
                     if (mime == "application/xhtml+xml") {
                         m_xhtml_net_change++;
                     }
+                    queueWellFormedCheck(href, mime);
                 } else {
                     m_filesToModify.append(fileinfo);
+                    queueWellFormedCheck(href, mime);
                 }
             } else if (name == "validationresult") {
                 QXmlStreamAttributes attr = reader.attributes();
@@ -706,78 +778,71 @@ bool PluginRunner::processResultXML()
 
 
 
+// Runs in a worker thread for each added or modified file as soon as
+// processResultXML reads it. Xhtml is only checked, xml can't really
+// be validated without a full dtd so any changes to it are repaired
+// to be safe. Only the native checks run here, a repair may need
+// python and its error dialogs.
+PluginRunner::FileCheck PluginRunner::checkOneFile(const QString &filePath, const QString &mime)
+{
+    FileCheck check;
+    QString data = Utility::ReadUnicodeTextFile(filePath);
+    if (mime == "application/xhtml+xml") {
+        check.error = XhtmlDoc::WellFormedErrorForSource(data);
+        return check;
+    }
+    check.mtype = mime;
+    if (check.mtype == "application/oebs-page-map+xml") check.mtype = "application/oebps-page-map+xml";
+    if (!CleanSource::IsWellFormedXML(data, check.mtype)) {
+        check.needs_repair = true;
+        return check;
+    }
+    QString newdata = CleanSource::ProcessXML(data, check.mtype);
+    if (newdata != data) {
+        Utility::WriteUnicodeTextFile(newdata, filePath);
+    }
+    return check;
+}
+
+
+void PluginRunner::queueWellFormedCheck(const QString &href, const QString &mime)
+{
+    static const QStringList CHECKED_MIMES = QStringList() << "application/xhtml+xml"
+                                                           << "application/oebps-package+xml"
+                                                           << "application/x-dtbncx+xml"
+                                                           << "application/oebs-page-map+xml"
+                                                           << "application/oebps-page-map+xml"
+                                                           << "application/smil+xml";
+    if (!CHECKED_MIMES.contains(mime) || m_checkedHrefs.contains(href)) {
+        return;
+    }
+    m_checkedHrefs << href;
+    m_wellFormedChecks << QtConcurrent::run(checkOneFile, m_outputDir + "/" + href, mime);
+}
+
+
 bool PluginRunner::checkIsWellFormed()
 {
     bool well_formed = true;
     bool proceed = true;
     QStringList errors;
-    // Build of list of xhtml, html, and xml files that were modifed or added
-    QStringList xhtmlFilesToCheck;
-    QStringList xmlFilesToCheck;
-    if (!m_filesToAdd.isEmpty()) {
-        foreach (QString fileinfo, m_filesToAdd) {
-            QStringList fdata = fileinfo.split(SEP);
-            QString href = fdata[ hrefField ];
-            QString id   = fdata[ idField   ];
-            QString mime = fdata[ mimeField ];
-            if (mime == "application/oebps-package+xml") {
-                xmlFilesToCheck.append(href);
-            } else if (mime == "application/x-dtbncx+xml") {
-                xmlFilesToCheck.append(href);
-            } else if (mime == "application/oebs-page-map+xml") {
-                xmlFilesToCheck.append(href);
-            } else if (mime == "application/xhtml+xml") {
-                xhtmlFilesToCheck.append(href);
-            } else if (mime == "application/smil+xml") {
-                xmlFilesToCheck.append(href);
-            }
-        }
+    if (!m_wellFormedChecks.isEmpty()) {
+        ui.statusLbl->setText(tr("Status: checking") + " " +
+                              tr("%n file(s)", "", m_wellFormedChecks.count()));
     }
-    if (!m_filesToModify.isEmpty()) {
-        foreach (QString fileinfo, m_filesToModify) {
-            QStringList fdata = fileinfo.split(SEP);
-            QString href = fdata[ hrefField ];
-            QString id   = fdata[ idField   ];
-            QString mime = fdata[ mimeField ];
-            if (mime == "application/oebps-package+xml") {
-                xmlFilesToCheck.append(href);
-            } else if (mime == "application/x-dtbncx+xml") {
-                xmlFilesToCheck.append(href);
-            } else if (mime == "application/oebs-page-map+xml") {
-                xmlFilesToCheck.append(href);
-            } else if (mime == "application/xhtml+xml") {
-                xhtmlFilesToCheck.append(href);
-            } else if (mime == "application/smil+xml") {
-                xmlFilesToCheck.append(href);
-            }
-        }
-    }
-    if (!xhtmlFilesToCheck.isEmpty()) {
-        foreach (QString href, xhtmlFilesToCheck) {
-            QString filePath = m_outputDir + "/" + href;
-            ui.statusLbl->setText(tr("Status: checking") + " " + href);
+    for (int i = 0; i < m_wellFormedChecks.count(); i++) {
+        FileCheck check = m_wellFormedChecks[i].result();
+        if (check.needs_repair) {
+            QString filePath = m_outputDir + "/" + m_checkedHrefs.at(i);
+            ui.statusLbl->setText(tr("Status: checking") + " " + m_checkedHrefs.at(i));
             QString data = Utility::ReadUnicodeTextFile(filePath);
-            XhtmlDoc::WellFormedError error = XhtmlDoc::WellFormedErrorForSource(data);
-            if (error.line != -1) {
-                errors.append(tr("Incorrect XHTML:") + " " + href + " " + tr("Line/Col") + " " + QString::number(error.line) +
-                              "," + QString::number(error.column) + " " + error.message);
-                well_formed = false;
-            }
+            Utility::WriteUnicodeTextFile(CleanSource::ProcessXML(data, check.mtype), filePath);
         }
-    }
-    if (!xmlFilesToCheck.isEmpty()) {
-        foreach (QString href, xmlFilesToCheck) {
-            // can't really validate without a full dtd so
-            // auto repair any xml file changes to be safe
-            QString filePath = m_outputDir + "/" + href;
-            ui.statusLbl->setText(tr("Status: checking") + " " + href);
-            QString mtype = "application/oebs-page-map+xml";
-            if (href.endsWith(".opf")) mtype = "application/oebps-package+xml";
-            if (href.endsWith(".ncx")) mtype = "application/x-dtbncx+xml";
-            if (href.endsWith(".smil")) mtype = "application/oebps-package+xml";
-            QString data = Utility::ReadUnicodeTextFile(filePath);
-            QString newdata = CleanSource::ProcessXML(data, mtype);
-            Utility::WriteUnicodeTextFile(newdata, filePath);
+        XhtmlDoc::WellFormedError error = check.error;
+        if (error.line != -1) {
+            errors.append(tr("Incorrect XHTML:") + " " + m_checkedHrefs.at(i) + " " + tr("Line/Col") + " " + QString::number(error.line) +
+                          "," + QString::number(error.column) + " " + error.message);
+            well_formed = false;
         }
     }
     if ((!well_formed) && (!errors.isEmpty())) {
@@ -27,8 +27,11 @@
 #include <QDialog>
 #include <QProgressBar>
 #include <QProcess>
+#include <QFuture>
+#include <QElapsedTimer>
 // #include <QDebug>
 
+#include "BookManipulation/XhtmlDoc.h"
 #include "Misc/TempFolder.h"
 #include "Misc/ValidationResult.h"
 #include "ResourceObjects/CSSResource.h"
@@ -87,6 +90,8 @@ private slots:
     void processError();
     void processError(QProcess::ProcessError error);
     void processOutput();
+    void outputReceived(const QByteArray &data);
+    void errorReceived(const QByteArray &data);
     void pluginFinished(int exitcode, QProcess::ExitStatus exitstatus );
     void showConsole();
 
@@ -94,6 +99,19 @@ private:
 
     bool processResultXML();
     bool checkIsWellFormed();
+    void queueWellFormedCheck(const QString &href, const QString &mime);
+
+    struct FileCheck {
+        QString mtype;
+        XhtmlDoc::WellFormedError error;
+        // broken xml is repaired back on the gui thread
+        bool needs_repair;
+
+        FileCheck() : needs_repair(false) {}
+    };
+
+    static FileCheck checkOneFile(const QString &filePath, const QString &mime);
+
     bool deleteFiles(const QStringList &);
     bool addFiles(const QStringList &);
     bool modifyFiles(const QStringList &);
@@ -102,6 +120,8 @@ private:
 
     void connectSignalsToSlots();
 
+    void leaveSession();
+
     QProcess m_process;
 
     MainWindow *m_mainWindow;
@@ -121,6 +141,7 @@ private:
     QString m_bookRoot;
     QString m_pluginType;
     QString m_pluginAutoClose;
+    QString m_pluginSession;
     QByteArray m_pluginOutput;
     QString m_algorithm;
     QString m_fontMangling;
@@ -129,8 +150,16 @@ private:
     QStringList m_filesToAdd;
     QStringList m_filesToModify;
     QList<ValidationResult> m_validationResults;
+
+    // checks of the added and modified files, started as the result xml is read
+    QStringList m_checkedHrefs;
+    QList<QFuture<FileCheck>> m_wellFormedChecks;
+
     QString m_result;
 
+    // from the start of the run to its results being applied
+    QElapsedTimer m_runTimer;
+
     int m_xhtml_net_change;
 
     QHash <QString, Resource *> m_hrefToRes;
@@ -138,6 +167,9 @@ private:
 
     bool m_ready;
 
+    // the current run went to the shared PluginSession launcher
+    bool m_inSession;
+
     static const QString SEP;
     static const QString _RS;
     static const QString OPFFILEINFO;
@@ -116,6 +116,8 @@ PreferencesWidget::ResultActions GeneralSettingsWidget::saveSettings()
     settings.setRemoteOn(new_remote_on_level);
     settings.setJavascriptOn(new_javascript_on_level);
     settings.setClipboardHistoryLimit(int(ui.clipLimitSpin->value()));
+    settings.setUndoMemoryPerFile(ui.undoPerFileSpin->value());
+    settings.setUndoMemoryTotal(ui.undoTotalSpin->value());
     settings.setTempFolderHome(new_temp_folder_home);
     settings.setDisableGPU(new_disable_gpu);
     // if you change this setting you need to restart sigil to see the change
@@ -155,6 +157,8 @@ void GeneralSettingsWidget::readSettings()
     int javascriptOn = settings.javascriptOn();
     ui.AllowJavascript->setChecked(javascriptOn);
     ui.clipLimitSpin->setValue(int(settings.clipboardHistoryLimit()));
+    ui.undoPerFileSpin->setValue(settings.undoMemoryPerFile());
+    ui.undoTotalSpin->setValue(settings.undoMemoryTotal());
     QString temp_folder_home = settings.tempFolderHome();
     ui.lineEdit->setText(temp_folder_home);
     m_disable_gpu = settings.disableGPU();
@@ -28,6 +28,7 @@
 #include <QtWidgets/QScrollArea>
 
 #include "Dialogs/Preferences.h"
+#include "Misc/SettingsSnapshot.h"
 #include "Misc/SettingsStore.h"
 #include "Misc/Utility.h"
 #include "PreferenceWidgets/AppearanceWidget.h"
@@ -111,6 +112,7 @@ void Preferences::saveSettings()
 
     QApplication::restoreOverrideCursor();
     settings.endGroup();
+    SettingsSnapshot::instance()->Reload();
 
     if (m_restartSigil) {
         Utility::warning(this, tr("Sigil"), tr("Changes will take effect when you restart Sigil."));
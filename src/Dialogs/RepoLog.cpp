@@ -73,9 +73,11 @@ RepoLog::~RepoLog()
 
 void RepoLog::LoadViewer()
 {
-    QStringList recs = m_data.split("\n");
-    foreach(QString rec, recs) {
-        m_view->insertPlainText(rec + "\n");
+    // every line of the log ends in a newline
+    m_view->SetText(m_data + "\n");
+    int count = m_data.count('\n') + 1;
+    m_blockmap.reserve(count);
+    for (int i = 0; i < count; i++) {
         m_blockmap << "";
     }
     m_view->setBlockMap(m_blockmap);
@@ -38,7 +38,6 @@
 #include "Misc/SettingsStore.h"
 #include "Misc/Utility.h"
 #include "Misc/XMLEntities.h"
-#include "Parsers/GumboInterface.h"
 #include "ResourceObjects/HTMLResource.h"
 
 static const QString SETTINGS_GROUP = "reports";
@@ -94,8 +93,7 @@ void CharactersInHTMLFilesWidget::SetupTable()
 
 void CharactersInHTMLFilesWidget::AddTableData()
 {
-    const QList<HTMLResource *> html_resources = m_Book->GetHTMLResources();
-    QList<uint> characters = GetDisplayedCharacters(html_resources);
+    QList<uint> characters = m_Book->GetCharactersInHTMLFiles();
     QString all_characters;
     foreach (uint unichr, characters) {
         // if (QChar::isSurrogate(unichr)) {
@@ -155,35 +153,6 @@ void CharactersInHTMLFilesWidget::AddTableData()
     }
 }
 
-QList <uint> CharactersInHTMLFilesWidget::GetDisplayedCharacters(QList<HTMLResource *> resources)
-{
-    
-    QSet<uint> character_set;
-    foreach (HTMLResource *resource, resources) {
-        QString replaced_html = resource->GetText();
-        replaced_html = replaced_html.replace("<html>", "<html xmlns=\"http://www.w3.org/1999/xhtml\">");
-        QString version = "any_version";
-        GumboInterface gi = GumboInterface(replaced_html, version);
-        QString text = gi.get_body_text();
-        for (int i=0; i < text.length(); i++) {
-            QChar c = text.at(i);
-            if (c != '\n') {
-                if (c.isHighSurrogate()) {
-                    if (++i < text.length()) {
-                        QChar d = text.at(i);
-                        character_set.insert(QChar::surrogateToUcs4(c,d));
-                    }
-                    // intentionally skip high surrogate withouts a following character as invalid
-                } else {
-                    character_set.insert(c.unicode());
-                }
-            }
-        }
-    }
-    return character_set.values();
-}
-
-
 void CharactersInHTMLFilesWidget::FilterEditTextChangedSlot(const QString &text)
 {
     const QString lowercaseText = text.toLower();
@@ -68,8 +68,6 @@ private:
     void SetupTable();
     void AddTableData();
 
-    QList <uint> GetDisplayedCharacters(QList<HTMLResource *> resources);
-
     QSharedPointer<Book> m_Book;
 
     QStandardItemModel *m_ItemModel;
@@ -21,7 +21,10 @@
 **
 *************************************************************************/
 
+#include <functional>
+
 #include <QtCore/QFile>
+#include <QtConcurrent/QtConcurrent>
 #include <QtGui/QFont>
 #include <QtWidgets/QFileDialog>
 #include <QtWidgets/QMessageBox>
@@ -41,6 +44,13 @@
 static const int THUMBNAIL_SIZE = 100;
 static const int THUMBNAIL_SIZE_INCREMENT = 50;
 
+// These need to be changed if columns added or deleted
+static const int WIDTH_COL = 3;
+static const int HEIGHT_COL = 4;
+static const int PIXELS_COL = 5;
+static const int COLOR_COL = 6;
+static const int ICON_COL = 7;
+
 static const QString SETTINGS_GROUP = "reports";
 static const QString DEFAULT_REPORT_FILE = "ImageFilesReport.csv";
 
@@ -48,6 +58,9 @@ ImageFilesWidget::ImageFilesWidget()
     :
     m_ItemModel(new QStandardItemModel),
     m_ThumbnailSize(THUMBNAIL_SIZE),
+    m_Watcher(NULL),
+    m_SortColumn(1),
+    m_SortOrder(Qt::AscendingOrder),
     m_ContextMenu(new QMenu(this)),
     m_LastDirSaved(QString()),
     m_LastFileSaved(QString())
@@ -61,6 +74,11 @@ ImageFilesWidget::ImageFilesWidget()
 
 ImageFilesWidget::~ImageFilesWidget()
 {
+    if (m_Watcher) {
+        m_Watcher->disconnect(this);
+        m_Watcher->cancel();
+        m_Watcher->waitForFinished();
+    }
     delete m_ItemModel;
 }
 
@@ -85,6 +103,9 @@ void ImageFilesWidget::SetupTable(int sort_column, Qt::SortOrder sort_order)
         m_AllImageResources.append(svg_resource);
     }
 
+    CancelDecoding();
+    m_SortColumn = sort_column;
+    m_SortOrder = sort_order;
     m_ItemModel->clear();
     QStringList header;
     header.append(tr("Name"));
@@ -108,15 +129,10 @@ void ImageFilesWidget::SetupTable(int sort_column, Qt::SortOrder sort_order)
     double total_size = 0;
     int total_links = 0;
     QHash<QString, QStringList> image_html_files_hash = m_Book->GetHTMLFilesUsingImages();
+    QStringList pending_paths;
     foreach(Resource * resource, m_AllImageResources) {
         QString filepath = resource->GetRelativePath();
         QString path = resource->GetFullPath();
-        QImage image;
-        if (resource->Type() == Resource::SVGResourceType) {
-            image = Utility::RenderSvgToImage(path);
-        } else {
-            image.load(path);
-        }
         QList<QStandardItem *> rowItems;
         // Filename
         QStandardItem *name_item = new QStandardItem();
@@ -143,35 +159,18 @@ void ImageFilesWidget::SetupTable(int sort_column, Qt::SortOrder sort_order)
         }
 
         rowItems << link_item;
-        // Width
-        NumericItem *width_item = new NumericItem();
-        width_item->setText(QString("%L1").arg(image.width()));
-        width_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-        rowItems << width_item;
-        // Height
-        NumericItem *height_item = new NumericItem();
-        height_item->setText(QString("%L1").arg(image.height()));
-        height_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-        rowItems << height_item;
-        // Pixels
-        NumericItem *pixel_item = new NumericItem();
-        pixel_item->setText(QString("%L1").arg(image.width() * image.height()));
-        pixel_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
-        rowItems << pixel_item;
+        // Width, Height and Pixels are filled in by SetImageDetails
+        for (int i = WIDTH_COL; i <= PIXELS_COL; i++) {
+            NumericItem *number_item = new NumericItem();
+            number_item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            rowItems << number_item;
+        }
         // Color
-        QStandardItem *color_item = new QStandardItem();
-        color_item->setText(image.allGray() ? "Grayscale" : "Color");
-        rowItems << color_item;
+        rowItems << new QStandardItem();
 
         // Thumbnail
-        QPixmap pixmap = QPixmap::fromImage(image);
         if (m_ThumbnailSize) {
-            if (pixmap.height() > m_ThumbnailSize || pixmap.width() > m_ThumbnailSize) {
-                pixmap = pixmap.scaled(QSize(m_ThumbnailSize, m_ThumbnailSize), Qt::KeepAspectRatio);
-            }
-            QStandardItem *icon_item = new QStandardItem();
-            icon_item->setData(QVariant(pixmap), Qt::DecorationRole);
-            rowItems << icon_item;
+            rowItems << new QStandardItem();
         }
 
         for (int i = 0; i < rowItems.count(); i++) {
@@ -179,7 +178,27 @@ void ImageFilesWidget::SetupTable(int sort_column, Qt::SortOrder sort_order)
         }
 
         m_ItemModel->appendRow(rowItems);
+
+        ThumbnailCache::Info info;
+        if (ThumbnailCache::Find(path, m_ThumbnailSize, info)) {
+            SetImageDetails(name_item->row(), info);
+        } else {
+            m_PendingItems.insert(filepath, name_item);
+            m_PendingBookPaths << filepath;
+            pending_paths << path;
+        }
     }
+    // The sizes only need the image headers so they are shown, and
+    // can be sorted on, before the images themselves are decoded
+    QList<QSize> sizes = ThumbnailCache::GetSizes(pending_paths);
+    for (int i = 0; i < sizes.count(); i++) {
+        int row = m_PendingItems.value(m_PendingBookPaths.at(i))->row();
+        const QSize &size = sizes.at(i);
+        m_ItemModel->item(row, WIDTH_COL)->setText(QString("%L1").arg(size.width()));
+        m_ItemModel->item(row, HEIGHT_COL)->setText(QString("%L1").arg(size.height()));
+        m_ItemModel->item(row, PIXELS_COL)->setText(QString("%L1").arg(size.width() * size.height()));
+    }
+
     // Sort before adding the totals row
     // Since sortIndicator calls this routine, must disconnect/reconnect while resorting
     disconnect(ui.fileTree->header(), SIGNAL(sortIndicatorChanged(int, Qt::SortOrder)), this, SLOT(Sort(int, Qt::SortOrder)));
@@ -234,6 +253,74 @@ void ImageFilesWidget::SetupTable(int sort_column, Qt::SortOrder sort_order)
     for (int i = 0; i < ui.fileTree->header()->count(); i++) {
         ui.fileTree->resizeColumnToContents(i);
     }
+
+    if (!pending_paths.isEmpty()) {
+        // Decoding every image takes a while on a large book so the
+        // rest of the table is shown first and the image details
+        // and thumbnails fill in as the workers finish each one
+        m_Watcher = new QFutureWatcher<ThumbnailCache::Info>(this);
+        connect(m_Watcher, SIGNAL(resultReadyAt(int)), this, SLOT(ImageDetailsReady(int)));
+        connect(m_Watcher, SIGNAL(finished()), this, SLOT(ImageDetailsFinished()));
+        m_Watcher->setFuture(QtConcurrent::mapped(pending_paths, std::bind(ThumbnailCache::Get, std::placeholders::_1, m_ThumbnailSize)));
+    }
+}
+
+void ImageFilesWidget::SetImageDetails(int row, const ThumbnailCache::Info &info)
+{
+    m_ItemModel->item(row, WIDTH_COL)->setText(QString("%L1").arg(info.width));
+    m_ItemModel->item(row, HEIGHT_COL)->setText(QString("%L1").arg(info.height));
+    m_ItemModel->item(row, PIXELS_COL)->setText(QString("%L1").arg(info.width * info.height));
+    // an image that can not be read has no pixels, so none of them are coloured
+    m_ItemModel->item(row, COLOR_COL)->setText(!info.valid || info.all_gray ? "Grayscale" : "Color");
+    if (m_ThumbnailSize) {
+        m_ItemModel->item(row, ICON_COL)->setData(QVariant(QPixmap::fromImage(info.thumbnail)), Qt::DecorationRole);
+    }
+}
+
+void ImageFilesWidget::ImageDetailsReady(int index)
+{
+    if (!m_Watcher || m_Watcher->isCanceled() || (index < 0) || (index >= m_PendingBookPaths.count())) {
+        return;
+    }
+    QStandardItem *name_item = m_PendingItems.take(m_PendingBookPaths.at(index));
+    if (name_item) {
+        SetImageDetails(name_item->row(), m_Watcher->resultAt(index));
+    }
+}
+
+void ImageFilesWidget::ImageDetailsFinished()
+{
+    m_PendingItems.clear();
+    m_PendingBookPaths.clear();
+    if (m_SortColumn != COLOR_COL) {
+        return;
+    }
+    // The rows were sorted while the colours were still blank,
+    // sort them again keeping the totals row at the bottom
+    int last_row = m_ItemModel->rowCount() - 1;
+    if (last_row < 1) {
+        return;
+    }
+    QList<QStandardItem *> totals = m_ItemModel->takeRow(last_row);
+    m_ItemModel->sort(m_SortColumn, m_SortOrder);
+    m_ItemModel->appendRow(totals);
+    for (int i = 0; i < ui.fileTree->header()->count(); i++) {
+        ui.fileTree->resizeColumnToContents(i);
+    }
+}
+
+void ImageFilesWidget::CancelDecoding()
+{
+    if (m_Watcher) {
+        // The workers only touch the image files and the
+        // thumbnail cache so there is no need to wait for them
+        m_Watcher->disconnect(this);
+        m_Watcher->cancel();
+        m_Watcher->deleteLater();
+        m_Watcher = NULL;
+    }
+    m_PendingItems.clear();
+    m_PendingBookPaths.clear();
 }
 
 void ImageFilesWidget::IncreaseThumbnailSize()
@@ -25,6 +25,7 @@
 #ifndef IMAGEFILESWIDGET_H
 #define IMAGEFILESWIDGET_H
 
+#include <QtCore/QFutureWatcher>
 #include <QtCore/QSharedPointer>
 #include <QAction>
 #include <QtWidgets/QMenu>
@@ -37,6 +38,7 @@
 #include "ResourceObjects/Resource.h"
 #include "BookManipulation/Book.h"
 #include "Dialogs/ReportsWidgets/ReportsWidget.h"
+#include "Misc/ThumbnailCache.h"
 
 #include "ui_ReportsImageFilesWidget.h"
 
@@ -75,7 +77,13 @@ private slots:
 
     void Save();
 
+    void ImageDetailsReady(int index);
+    void ImageDetailsFinished();
+
 private:
+    void SetImageDetails(int row, const ThumbnailCache::Info &info);
+    void CancelDecoding();
+
     void ReadSettings();
     void WriteSettings();
 
@@ -92,6 +100,19 @@ private:
 
     int m_ThumbnailSize;
 
+    QFutureWatcher<ThumbnailCache::Info> *m_Watcher;
+
+    /**
+     * The name item of each row still waiting for its image details,
+     * keyed by book path, and the book paths in the order they were
+     * handed to the workers.
+     */
+    QHash<QString, QStandardItem *> m_PendingItems;
+    QStringList m_PendingBookPaths;
+
+    int m_SortColumn;
+    Qt::SortOrder m_SortOrder;
+
     QPointer<QMenu> m_ContextMenu;
 
     QAction *m_Delete;
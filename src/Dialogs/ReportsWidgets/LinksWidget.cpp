@@ -30,6 +30,7 @@
 
 #include "sigil_exception.h"
 #include "BookManipulation/FolderKeeper.h"
+#include "BookManipulation/FragmentIndex.h"
 #include "BookManipulation/XhtmlDoc.h"
 #include "Dialogs/ReportsWidgets/LinksWidget.h"
 #include "Misc/HTMLSpellCheck.h"
@@ -91,7 +92,10 @@ void LinksWidget::SetupTable(int sort_column, Qt::SortOrder sort_order)
     QHash<QString, QList<XhtmlDoc::XMLElement> > links = m_Book->GetLinkElements();
 
     // Key is book path of html file
-    QHash<QString, QStringList> all_ids = m_Book->GetIdsInHTMLFiles();
+    QHash<QString, QSet<QString>> all_ids = m_Book->GetFolderKeeper()->GetFragmentIndex()->GetIds(m_HTMLResources);
+
+    // Key is book path of html file, the first anchor with each id
+    QHash<QString, QHash<QString, int>> anchor_ids;
 
     // html_filenames is a list of html book paths
     QStringList html_filenames;
@@ -186,13 +190,18 @@ void LinksWidget::SetupTable(int sort_column, Qt::SortOrder sort_order)
                 XhtmlDoc::XMLElement target;
                 bool found = false;
 
-                foreach(XhtmlDoc::XMLElement target_element, links[bkpath]) {
-                    if (href_id == target_element.attributes["id"]) {
-                        target = target_element;
-                        found = true;
-                        break;
+                if (!anchor_ids.contains(bkpath)) {
+                    QHash<QString, int> &ids = anchor_ids[bkpath];
+                    const QList<XhtmlDoc::XMLElement> &target_links = links[bkpath];
+                    for (int i = target_links.count() - 1; i >= 0; i--) {
+                        ids.insert(target_links.at(i).attributes.value("id"), i);
                     }
                 }
+                int target_index = anchor_ids[bkpath].value(href_id, -1);
+                if (target_index != -1) {
+                    target = links[bkpath].at(target_index);
+                    found = true;
+                }
                 if (found) {
 
                     // Target Text
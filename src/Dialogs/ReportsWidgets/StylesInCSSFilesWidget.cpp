@@ -62,9 +62,10 @@ void StylesInCSSFilesWidget::CreateReport(QSharedPointer<Book> book)
 {
     m_Book = book;
     SetupTable();
-    QList<BookReports::StyleData *> css_selector_usage = BookReports::GetAllCSSSelectorsUsed(m_Book, true);
-    AddTableData(css_selector_usage);
-    qDeleteAll(css_selector_usage);
+    QList<BookReports::SelectorUsage> css_selector_usage = BookReports::GetAllCSSSelectorsUsed(m_Book, true);
+    QList<BookReports::StyleData *> css_selector_overridden = BookReports::GetOverriddenCSSSelectors(m_Book);
+    AddTableData(css_selector_usage, css_selector_overridden);
+    qDeleteAll(css_selector_overridden);
 
     for (int i = 0; i < ui.fileTree->header()->count(); i++) {
         ui.fileTree->resizeColumnToContents(i);
@@ -82,6 +83,7 @@ void StylesInCSSFilesWidget::SetupTable()
     header.append(tr("CSS File"));
     header.append(tr("CSS Selector"));
     header.append(tr("Used In HTML File"));
+    header.append(tr("Overridden In HTML File"));
     m_ItemModel->setHorizontalHeaderLabels(header);
     ui.fileTree->setSelectionBehavior(QAbstractItemView::SelectRows);
     ui.fileTree->setModel(m_ItemModel);
@@ -89,32 +91,49 @@ void StylesInCSSFilesWidget::SetupTable()
     ui.fileTree->header()->setToolTip(
         tr("<p>This is a list of the CSS selectors in all CSS files and whether or not the selector was matched in an HTML file.<p>") %
         tr("<p>NOTE:</p>") %
-        tr("<p>Due to the complexities of CSS you must check your code manually to be absolutely certain if a selector is used or not.</p>") % tr("<p>Note: Only one HTML File is listed among the many possible matches.</p>")
+        tr("<p>Due to the complexities of CSS you must check your code manually to be absolutely certain if a selector is used or not.</p>") % tr("<p>Note: Only one HTML File is listed among the many possible matches.</p>") %
+        tr("<p>A selector is listed as overridden when every property it sets is replaced by a more specific or later rule in every HTML file it matches. Media queries are not taken into account.</p>")
     );
 }
 
-void StylesInCSSFilesWidget::AddTableData(const QList<BookReports::StyleData *> css_selectors_usage)
+void StylesInCSSFilesWidget::AddTableData(const QList<BookReports::SelectorUsage> &css_selectors_usage,
+                                          const QList<BookReports::StyleData *> css_selectors_overridden)
 {
-    foreach(BookReports::StyleData *selector_usage, css_selectors_usage) {
+    QHash<QString, QString> overridden_in;
+    foreach(BookReports::StyleData *selector_overridden, css_selectors_overridden) {
+        QString key = selector_overridden->css_filename % QChar(31) % QString::number(selector_overridden->css_selector_position) %
+                      QChar(31) % selector_overridden->css_selector_text;
+        overridden_in.insert(key, selector_overridden->html_filename);
+    }
+    foreach(const BookReports::SelectorUsage &selector_usage, css_selectors_usage) {
         // Write the table entries
         QList<QStandardItem *> rowItems;
         // File name
         QStandardItem *filename_item = new QStandardItem();
-        QString css_short_filename = selector_usage->css_filename;
+        QString css_short_filename = selector_usage.css_filename;
         css_short_filename = css_short_filename.right(css_short_filename.length() - css_short_filename.lastIndexOf('/') - 1);
         filename_item->setText(css_short_filename);
-        filename_item->setData(selector_usage->css_filename);
-        filename_item->setToolTip(selector_usage->css_filename);
+        filename_item->setData(selector_usage.css_filename);
+        filename_item->setToolTip(selector_usage.css_filename);
         rowItems << filename_item;
         // Selector
         QStandardItem *selector_text_item = new QStandardItem();
-        selector_text_item->setText(selector_usage->css_selector_text);
-        selector_text_item->setData(selector_usage->css_selector_position);
+        selector_text_item->setText(selector_usage.css_selector_text);
+        selector_text_item->setData(selector_usage.css_selector_position);
         rowItems << selector_text_item;
         // Found in
         QStandardItem *found_in_item = new QStandardItem();
-        found_in_item->setText(selector_usage->html_filename);
+        found_in_item->setText(selector_usage.html_filename);
+        if (selector_usage.html_file_count > 1) {
+            found_in_item->setToolTip(tr("Used in %n HTML file(s)", "", selector_usage.html_file_count));
+        }
         rowItems << found_in_item;
+        // Overridden in
+        QStandardItem *overridden_in_item = new QStandardItem();
+        QString key = selector_usage.css_filename % QChar(31) % QString::number(selector_usage.css_selector_position) %
+                      QChar(31) % selector_usage.css_selector_text;
+        overridden_in_item->setText(overridden_in.value(key));
+        rowItems << overridden_in_item;
 
         for (int i = 0; i < rowItems.count(); i++) {
             rowItems[i]->setEditable(false);
@@ -136,7 +155,8 @@ void StylesInCSSFilesWidget::FilterEditTextChangedSlot(const QString &text)
     for (int row = 0; row < root_item->rowCount(); row++) {
         if (text.isEmpty() || root_item->child(row, 0)->text().toLower().contains(lowercaseText) ||
             root_item->child(row, 1)->text().toLower().contains(lowercaseText) ||
-            root_item->child(row, 2)->text().toLower().contains(lowercaseText)) {
+            root_item->child(row, 2)->text().toLower().contains(lowercaseText) ||
+            root_item->child(row, 3)->text().toLower().contains(lowercaseText)) {
             ui.fileTree->setRowHidden(row, parent_index, false);
 
             if (first_visible_row == -1) {
@@ -77,7 +77,8 @@ private:
 
     void SetupTable();
 
-    void AddTableData(const QList<BookReports::StyleData *> css_selectors_usage);
+    void AddTableData(const QList<BookReports::SelectorUsage> &css_selectors_usage,
+                      const QList<BookReports::StyleData *> css_selectors_overridden);
 
     QSharedPointer<Book> m_Book;
 
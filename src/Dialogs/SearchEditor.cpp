@@ -306,14 +306,13 @@ void SearchEditor::SetCurrentEntriesFromFullName(const QString &name)
     QStandardItem * nameditem = m_SearchEditorModel->GetItemFromName(name);
     if (nameditem) {
         QList<QStandardItem *> items = m_SearchEditorModel->GetNonGroupItems(nameditem);
-        if (!ItemsAreUnique(items)) {
-            return;
-        }
-
-        foreach(SearchEditorModel::searchEntry* entry, m_SearchEditorModel->GetEntries(items)) {
-            m_CurrentSearchEntries << entry;
+        if (ItemsAreUnique(items)) {
+            foreach(SearchEditorModel::searchEntry* entry, m_SearchEditorModel->GetEntries(items)) {
+                m_CurrentSearchEntries << entry;
+            }
         }
     }
+    emit CurrentEntriesChanged();
 }
 
 
@@ -460,6 +459,7 @@ void SearchEditor::SelectionChanged()
     foreach(SearchEditorModel::searchEntry* entry, GetSelectedEntries()) {
         m_CurrentSearchEntries << entry;
     }
+    emit CurrentEntriesChanged();
 }
 
 
@@ -78,6 +78,7 @@ signals:
     void RestartSearch();
     void ShowStatusMessageRequest(const QString &message);
     void CountsReportCountRequest(SearchEditorModel::searchEntry* entry, int& count);
+    void CurrentEntriesChanged();
 
 protected:
     bool eventFilter(QObject *obj, QEvent *ev);
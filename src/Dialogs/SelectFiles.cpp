@@ -36,6 +36,7 @@
 
 #include "MainUI/MainWindow.h"
 #include "Misc/SettingsStore.h"
+#include "Misc/ThumbnailCache.h"
 #include "Misc/WebProfileMgr.h"
 #include "sigil_constants.h"
 #include "ViewEditors/SimplePage.h"
@@ -210,16 +211,8 @@ void SelectFiles::SetImages()
 
         // Do not show thumbnail if file is not an image
         if ((type == Resource::ImageResourceType || type == Resource::SVGResourceType) && m_ThumbnailSize) {
-            QImage image;
-            if (type == Resource::ImageResourceType) {
-                image.load(resource->GetFullPath());
-            } else {
-                image = Utility::RenderSvgToImage(resource->GetFullPath());
-            }
-            QPixmap pixmap = QPixmap::fromImage(image);
-            if (pixmap.height() > m_ThumbnailSize || pixmap.width() > m_ThumbnailSize) {
-                pixmap = pixmap.scaled(QSize(m_ThumbnailSize, m_ThumbnailSize), Qt::KeepAspectRatio);
-            }
+            // decoded once and then kept by the thumbnail cache
+            QPixmap pixmap = QPixmap::fromImage(ThumbnailCache::Get(resource->GetFullPath(), m_ThumbnailSize).thumbnail);
             QStandardItem *icon_item = new QStandardItem();
             icon_item->setData(QVariant(pixmap), Qt::DecorationRole);
             icon_item->setEditable(false);
@@ -343,19 +336,19 @@ void SelectFiles::SetPreviewImage()
     if (resource_type == Resource::ImageResourceType || resource_type == Resource::SVGResourceType) {
 
         // Define detailed information label
-        const QImage img(path);
+        const ThumbnailCache::Info img = ThumbnailCache::Get(path, 0);
         const QUrl imgUrl = QUrl::fromLocalFile(path);
-        QString colors_shades = img.isGrayscale() ? tr("shades") : tr("colors");
-        QString grayscale_color = img.isGrayscale() ? tr("Grayscale") : tr("Color");
+        QString colors_shades = img.grayscale ? tr("shades") : tr("colors");
+        QString grayscale_color = img.grayscale ? tr("Grayscale") : tr("Color");
         QString colorsInfo = "";
 
-        if (img.depth() == 32) {
-            colorsInfo = QString(" %1bpp").arg(img.bitPlaneCount());
-        } else if (img.depth() > 0) {
-            colorsInfo = QString(" %1bpp (%2 %3)").arg(img.bitPlaneCount()).arg(img.colorCount()).arg(colors_shades);
+        if (img.depth == 32) {
+            colorsInfo = QString(" %1bpp").arg(img.bit_planes);
+        } else if (img.depth > 0) {
+            colorsInfo = QString(" %1bpp (%2 %3)").arg(img.bit_planes).arg(img.color_count).arg(colors_shades);
         }
 
-        details = QString("%2x%3px | %4 KB | %5%6").arg(img.width()).arg(img.height())
+        details = QString("%2x%3px | %4 KB | %5%6").arg(img.width).arg(img.height)
                   .arg(fsize).arg(grayscale_color).arg(colorsInfo);
 
         // MainWindow::clearMemoryCaches();
@@ -65,26 +65,33 @@ SelectHyperlink::SelectHyperlink(QString default_href,
 void SelectHyperlink::SetList()
 {
     m_SelectHyperlinkModel->clear();
+    m_LowercaseTargets.clear();
+    m_TargetRows.clear();
+    m_Matches.clear();
+    m_MatchedFilter.clear();
     QStringList header;
     header.append(tr("Targets in the Book"));
     m_SelectHyperlinkModel->setHorizontalHeaderLabels(header);
     ui.list->setSelectionBehavior(QAbstractItemView::SelectRows);
     ui.list->setModel(m_SelectHyperlinkModel);
-    // Get the complete list of valid targets
+    // Get the complete list of valid targets from the fragment index
     // Key is the book path of the html file
     m_IDNames = m_Book->GetIdsInHTMLFiles();
+    QList<QStandardItem *> items;
     if (m_restype == "html") {
         // Display in-file targets first, then in order
-        AddEntry(m_CurrentResource);
+        AddEntry(m_CurrentResource, items);
     }
     foreach(Resource * resource, m_Resources) {
         if (resource != m_CurrentResource) {
-            AddEntry(resource);
+            AddEntry(resource, items);
         }
     }
+    // Adding every row at once lets the view lay them out only once
+    m_SelectHyperlinkModel->invisibleRootItem()->appendRows(items);
 }
 
-void SelectHyperlink::AddEntry(Resource *resource)
+void SelectHyperlink::AddEntry(Resource *resource, QList<QStandardItem *> &items)
 {
     if (!resource) {
         return;
@@ -92,6 +99,10 @@ void SelectHyperlink::AddEntry(Resource *resource)
 
     QString filename = resource->ShortPathName();
     QString bkpath = resource->GetRelativePath();
+    QString relpath;
+    if (!(m_CurrentResource == resource)) {
+        relpath = resource->GetRelativePathFromResource(m_CurrentResource);
+    }
     QStringList ids = QStringList() << "" << m_IDNames[bkpath];
     foreach(QString id, ids) {
         // Do not allow linking to index entries because they can be regenerated
@@ -103,9 +114,8 @@ void SelectHyperlink::AddEntry(Resource *resource)
         // filepath is a relative link from m_CurrentResource to resource
         // target is a short unique name for this resource for use in table only
         QString target;
-        QString filepath;
+        QString filepath = relpath;
         if (!(m_CurrentResource == resource)) {
-           filepath = resource->GetRelativePathFromResource(m_CurrentResource);
            target = filename;
         }
         
@@ -118,13 +128,13 @@ void SelectHyperlink::AddEntry(Resource *resource)
         if (target.isEmpty()) target = filename;
         if (filepath.isEmpty()) filepath = "#";
 
-        QList<QStandardItem *> rowItems;
         QStandardItem *target_item = new QStandardItem();
         target_item->setText(target);
         target_item->setData(filepath);
-        rowItems << target_item;
-        m_SelectHyperlinkModel->appendRow(rowItems);
-        rowItems[0]->setEditable(false);
+        target_item->setEditable(false);
+        m_TargetRows.insert(filepath, items.count());
+        m_LowercaseTargets.append(target.toLower());
+        items << target_item;
     }
 }
 
@@ -159,16 +169,12 @@ void SelectHyperlink::SelectText(QString &text)
             target = m_CurrentResource->ShortPathName() + text;
         }
 
-        for (int row = 0; row < root_item->rowCount(); row++) {
-            QStandardItem *child = root_item->child(row, 0);
-            // Convert selection text to proper href 
-            QString selection = child->data().toString();
-
-            if (target == selection) {
-                ui.list->selectionModel()->select(m_SelectHyperlinkModel->index(row, 0, parent_index), QItemSelectionModel::Select | QItemSelectionModel::Rows);
-                ui.list->setFocus();
-                ui.list->setCurrentIndex(child->index());
-            }
+        QHash<QString, int>::const_iterator it = m_TargetRows.constFind(target);
+        if (it != m_TargetRows.constEnd()) {
+            QStandardItem *child = root_item->child(it.value(), 0);
+            ui.list->selectionModel()->select(m_SelectHyperlinkModel->index(it.value(), 0, parent_index), QItemSelectionModel::Select | QItemSelectionModel::Rows);
+            ui.list->setFocus();
+            ui.list->setCurrentIndex(child->index());
         }
     }
 }
@@ -178,24 +184,39 @@ void SelectHyperlink::FilterEditTextChangedSlot(const QString &text)
     const QString lowercaseText = text.toLower();
     QStandardItem *root_item = m_SelectHyperlinkModel->invisibleRootItem();
     QModelIndex parent_index;
-    // Hide rows that don't contain the filter text
-    int first_visible_row = -1;
-
-    for (int row = 0; row < root_item->rowCount(); row++) {
-        if (text.isEmpty() || root_item->child(row, 0)->text().toLower().contains(lowercaseText)) {
-            ui.list->setRowHidden(row, parent_index, false);
-
-            if (first_visible_row == -1) {
-                first_visible_row = row;
+    // Typing more of the filter can only hide rows, so then only
+    // the rows that matched the last filter need to be looked at
+    bool narrowing = !m_MatchedFilter.isEmpty() && lowercaseText.contains(m_MatchedFilter);
+    QList<int> matches;
+
+    ui.list->setUpdatesEnabled(false);
+    if (narrowing) {
+        foreach(int row, m_Matches) {
+            if (m_LowercaseTargets.at(row).contains(lowercaseText)) {
+                matches.append(row);
+            } else {
+                ui.list->setRowHidden(row, parent_index, true);
+            }
+        }
+    } else {
+        // Hide rows that don't contain the filter text
+        for (int row = 0; row < m_LowercaseTargets.count(); row++) {
+            bool hidden = !text.isEmpty() && !m_LowercaseTargets.at(row).contains(lowercaseText);
+            if (!hidden) {
+                matches.append(row);
+            }
+            if (ui.list->isRowHidden(row, parent_index) != hidden) {
+                ui.list->setRowHidden(row, parent_index, hidden);
             }
-        } else {
-            ui.list->setRowHidden(row, parent_index, true);
         }
     }
+    ui.list->setUpdatesEnabled(true);
+    m_Matches = matches;
+    m_MatchedFilter = lowercaseText;
 
-    if (!text.isEmpty() && first_visible_row != -1) {
+    if (!text.isEmpty() && !matches.isEmpty()) {
         // Select the first non-hidden row
-        ui.list->setCurrentIndex(root_item->child(first_visible_row, 0)->index());
+        ui.list->setCurrentIndex(root_item->child(matches.first(), 0)->index());
     } else {
         // Clear current and selection, which clears preview image
         ui.list->setCurrentIndex(QModelIndex());
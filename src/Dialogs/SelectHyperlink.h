@@ -61,7 +61,7 @@ private:
     void ReadSettings();
     void connectSignalsSlots();
 
-    void AddEntry(Resource *resource);
+    void AddEntry(Resource *resource, QList<QStandardItem *> &items);
 
     QString GetSelectedText();
 
@@ -75,6 +75,16 @@ private:
 
     QHash<QString, QStringList> m_IDNames;
 
+    // The target of each row in lower case for the filter
+    QStringList m_LowercaseTargets;
+
+    // The row of each href
+    QHash<QString, int> m_TargetRows;
+
+    // The rows shown for the last filter text
+    QList<int> m_Matches;
+    QString m_MatchedFilter;
+
     QList<Resource *> m_Resources;
 
     QSharedPointer<Book> m_Book;
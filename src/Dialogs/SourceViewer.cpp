@@ -104,14 +104,12 @@ void SourceViewer::ReloadViewer()
 
 void SourceViewer::LoadViewer()
 {
-    int blockno = 0;
-    int lineno = 1;
-    QStringList recs = m_data.split("\n");
-    foreach(QString rec, recs) {
-        m_view->insertPlainText(rec + "\n");
+    // every line of the source ends in a newline
+    m_view->SetText(m_data + "\n");
+    int count = m_data.count('\n') + 1;
+    m_blockmap.reserve(count);
+    for (int lineno = 1; lineno <= count; lineno++) {
         m_blockmap << QString::number(lineno);
-        blockno++;
-        lineno++;
     }
     m_view->setBlockMap(m_blockmap);
 
@@ -267,6 +267,7 @@ void SpellcheckEditor::CreateModel(int sort_column, Qt::SortOrder sort_order)
     int total_misspelled_words = 0;
     SpellCheck *sc = SpellCheck::instance();
     Language *lp = Language::instance();
+    QHash<QString, bool> verdicts = sc->spellAll(unique_words.keys());
     
     QHashIterator<QString, int> i(unique_words);
     while (i.hasNext()) {
@@ -276,7 +277,7 @@ void SpellcheckEditor::CreateModel(int sort_column, Qt::SortOrder sort_order)
         QString lang = lp->GetLanguageName(code, code);
         QString word = HTMLSpellCheckML::textOf(lcword);
         int count = unique_words.value(lcword);
-        bool misspelled = !sc->spell(lcword);
+        bool misspelled = !verdicts.value(lcword, true);
         if (misspelled) {
             total_misspelled_words++;
         }
@@ -435,8 +436,26 @@ void SpellcheckEditor::UpdateSuggestions()
     QString word = GetSelectedWord();
     if (!word.isEmpty()) {
         SpellCheck *sc = SpellCheck::instance();
-        ui.cbChangeAll->addItems(sc->suggest(word));
+        QStringList suggestions;
+        if (sc->cachedSuggestions(word, false, suggestions)) {
+            m_SuggestionWord.clear();
+            ui.cbChangeAll->addItems(suggestions);
+            return;
+        }
+        m_SuggestionWord = word;
+        m_SuggestionWatcher.setFuture(sc->suggestAsync(word));
+    }
+}
+
+void SpellcheckEditor::SuggestionsReady()
+{
+    // the selection may have moved on while Hunspell was busy
+    if (m_SuggestionWord.isEmpty() || m_SuggestionWord != GetSelectedWord()) {
+        return;
     }
+    m_SuggestionWord.clear();
+    ui.cbChangeAll->clear();
+    ui.cbChangeAll->addItems(m_SuggestionWatcher.result());
 }
 
 void SpellcheckEditor::FindSelectedWord()
@@ -456,14 +475,18 @@ void SpellcheckEditor::SelectionChanged(const QItemSelection &selected, const QI
 
 void SpellcheckEditor::FilterEditTextChangedSlot(const QString &text)
 {
-    const QString lowercaseText = text.toLower();
     QModelIndex root_index = m_SpellcheckEditorModel->indexFromItem(m_SpellcheckEditorModel->invisibleRootItem());
 
+    // Only rows that change are touched so the view lays out once
+    ui.SpellcheckEditorTree->setUpdatesEnabled(false);
     for (int row = 0; row < m_SpellcheckEditorModel->invisibleRootItem()->rowCount(); row++) {
         QStandardItem *item = m_SpellcheckEditorModel->item(row, 0);
-        bool hidden = !(text.isEmpty() || item->text().toLower().contains(lowercaseText));
-        ui.SpellcheckEditorTree->setRowHidden(item->row(), root_index, hidden);
+        bool hidden = !(text.isEmpty() || item->text().contains(text, Qt::CaseInsensitive));
+        if (ui.SpellcheckEditorTree->isRowHidden(row, root_index) != hidden) {
+            ui.SpellcheckEditorTree->setRowHidden(row, root_index, hidden);
+        }
     }
+    ui.SpellcheckEditorTree->setUpdatesEnabled(true);
 }
 
 void SpellcheckEditor::Sort(int logicalindex, Qt::SortOrder order)
@@ -618,6 +641,7 @@ void SpellcheckEditor::ConnectSignalsSlots()
     connect(ui.Ignore, SIGNAL(clicked()), this, SLOT(Ignore()));
     connect(ui.Add, SIGNAL(clicked()), this, SLOT(Add()));
     connect(ui.ChangeAll, SIGNAL(clicked()), this, SLOT(ChangeAll()));
+    connect(&m_SuggestionWatcher, SIGNAL(finished()), this, SLOT(SuggestionsReady()));
     connect(ui.SpellcheckEditorTree, SIGNAL(customContextMenuRequested(const QPoint &)),
             this,        SLOT(OpenContextMenu(const QPoint &)));
 
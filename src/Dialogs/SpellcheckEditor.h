@@ -32,6 +32,7 @@
 #include <QShortcut>
 #include <QSharedPointer>
 #include <QPointer>
+#include <QFutureWatcher>
 
 #include "Misc/SettingsStore.h"
 #include "BookManipulation/Book.h"
@@ -73,6 +74,7 @@ private slots:
     void FindSelectedWord();
     void SelectionChanged(const QItemSelection &selected, const QItemSelection &deselected);
     void UpdateSuggestions();
+    void SuggestionsReady();
 
     void DictionaryChanged(QString dictionary);
     void ChangeState(int state);
@@ -128,6 +130,11 @@ private:
 
     int m_SelectRow;
 
+    // Suggestions are found on the spell check thread, the word they
+    // were asked for is kept so that late answers can be ignored
+    QFutureWatcher<QStringList> m_SuggestionWatcher;
+    QString m_SuggestionWord;
+
     QShortcut * m_FilterSC;
     QShortcut * m_ShowAllSC;
     QShortcut * m_AwareSC;
@@ -27,10 +27,12 @@
 #include <QStringList>
 #include <QVariant>
 #include <QMetaType>
+#include <QSysInfo>
 #include <QStandardPaths>
 #include <QDir>
 #include <QDebug>
 
+#include "Misc/PluginDB.h"
 #include "Misc/Utility.h"
 #include "sigil_constants.h"
 
@@ -164,15 +166,16 @@
  */
 
 
-QMutex EmbeddedPython::m_mutex;
-
 EmbeddedPython* EmbeddedPython::m_instance = 0;
+QMutex EmbeddedPython::m_instancemutex;
 int EmbeddedPython::m_pyobjmetaid = 0;
 int EmbeddedPython::m_listintmetaid = 0;
 PyThreadState * EmbeddedPython::m_threadstate = NULL;
 
 EmbeddedPython* EmbeddedPython::instance()
 {
+    // callers on other threads wait here while the interpreter starts
+    QMutexLocker locker(&m_instancemutex);
     if (m_instance == 0) {
         m_instance = new EmbeddedPython();
     }
@@ -353,6 +356,9 @@ EmbeddedPython::EmbeddedPython()
     m_threadstate = PyEval_SaveThread();
     m_pyobjmetaid = qMetaTypeId<PyObjectPtr>();
     m_listintmetaid = qMetaTypeId<QList<int> >();
+
+    addToPythonSysPath(embeddedRoot());
+    addToPythonSysPath(PluginDB::launcherRoot() + "/python");
 }
 
 
@@ -401,7 +407,6 @@ QString EmbeddedPython::embeddedRoot()
 
 bool EmbeddedPython::addToPythonSysPath(const QString &mpath)
 {
-    EmbeddedPython::m_mutex.lock();
     PyGILState_STATE gstate = PyGILState_Ensure();
         
     PyObject* sysPath    = NULL;
@@ -419,12 +424,11 @@ bool EmbeddedPython::addToPythonSysPath(const QString &mpath)
     }
     Py_XDECREF(aPath);
     PyGILState_Release(gstate);
-    EmbeddedPython::m_mutex.unlock();
     return success;
 }
 
-// run interpreter without initiating/locking/unlocking GIL 
-// in a single thread at a time
+// run interpreter from any thread, holding only the GIL so that other
+// threads can run python whenever this one releases it in C code
 QVariant EmbeddedPython::runInPython(const QString &mname, 
                                      const QString &fname, 
                                      const QVariantList &args, 
@@ -432,7 +436,6 @@ QVariant EmbeddedPython::runInPython(const QString &mname,
                                      QString &tb,
                                      bool ret_python_object)
 {
-    EmbeddedPython::m_mutex.lock();
     PyGILState_STATE gstate = PyGILState_Ensure();
     QVariant  res        = QVariant(QString());
     PyObject *moduleName = NULL;
@@ -495,13 +498,12 @@ cleanup:
     Py_XDECREF(moduleName);
 
     PyGILState_Release(gstate);
-    EmbeddedPython::m_mutex.unlock();
     return res;
 }
 
 
 // given an existing python object instance, invoke one of its methods 
-// grabs mutex to prevent need for Python GIL
+// while holding the GIL
 QVariant EmbeddedPython::callPyObjMethod(PyObjectPtr &pyobj, 
                                          const QString &methname, 
                                          const QVariantList &args, 
@@ -509,7 +511,6 @@ QVariant EmbeddedPython::callPyObjMethod(PyObjectPtr &pyobj,
                                          QString &tb,
                                          bool ret_python_object)
 {
-    EmbeddedPython::m_mutex.lock();
     PyGILState_STATE gstate = PyGILState_Ensure();
 
     QVariant  res        = QVariant(QString());
@@ -558,7 +559,6 @@ QVariant EmbeddedPython::callPyObjMethod(PyObjectPtr &pyobj,
     Py_XDECREF(func);
 
     PyGILState_Release(gstate);
-    EmbeddedPython::m_mutex.unlock();
     return res;
 }
 
@@ -567,6 +567,44 @@ QVariant EmbeddedPython::callPyObjMethod(PyObjectPtr &pyobj,
 // *** from runInPython and callPyObjMethod with lock held
 
 
+// Book files, diffs and nav data pass through here so each string
+// is copied exactly once, straight between the QString's utf-16 and
+// python's own storage, without a utf-8 copy or strlen in between.
+static PyObject *QStringToPyObject(const QString &text)
+{
+    int byteorder = (QSysInfo::ByteOrder == QSysInfo::LittleEndian) ? -1 : 1;
+    // lone surrogates become U+FFFD as they did when going through utf-8
+    return PyUnicode_DecodeUTF16(reinterpret_cast<const char *>(text.utf16()),
+                                 static_cast<Py_ssize_t>(text.size()) * 2,
+                                 "replace",
+                                 &byteorder);
+}
+
+
+static QString PyUnicodeToQString(PyObject *po)
+{
+    if (PyUnicode_READY(po) != 0) {
+        return QString();
+    }
+    qsizetype len = static_cast<qsizetype>(PyUnicode_GET_LENGTH(po));
+    int kind = PyUnicode_KIND(po);
+    if (kind == PyUnicode_1BYTE_KIND) {
+        // latin 1 according to PEP 393
+        return QString::fromLatin1(reinterpret_cast<const char *>(PyUnicode_1BYTE_DATA(po)), len);
+    }
+    if (kind == PyUnicode_2BYTE_KIND) {
+        return QString::fromUtf16(reinterpret_cast<const char16_t *>(PyUnicode_2BYTE_DATA(po)), len);
+    }
+    if (kind == PyUnicode_4BYTE_KIND) {
+        return QString::fromUcs4(reinterpret_cast<const char32_t *>(PyUnicode_4BYTE_DATA(po)), len);
+    }
+    // convert to utf8 since not a known kind
+    Py_ssize_t size = 0;
+    const char *utf8 = PyUnicode_AsUTF8AndSize(po, &size);
+    return QString::fromUtf8(utf8, static_cast<qsizetype>(size));
+}
+
+
 // Convert PyObject types to their QVariant equivalents 
 // call recursively to allow populating QVariant lists and lists of lists
 QVariant EmbeddedPython::PyObjectToQVariant(PyObject *po, bool ret_python_object)
@@ -583,42 +621,25 @@ QVariant EmbeddedPython::PyObjectToQVariant(PyObject *po, bool ret_python_object
         res = QVariant(PyFloat_AsDouble(po));
 
     } else if (PyBytes_Check(po)) {
-        res = QVariant(QByteArray(PyBytes_AsString(po)));
+        res = QVariant(QByteArray(PyBytes_AS_STRING(po), PyBytes_GET_SIZE(po)));
 
     } else if (PyUnicode_Check(po)) {
-
-        int kind = PyUnicode_KIND(po);
-
-        if (PyUnicode_READY(po) != 0)
-            return res;
-
-        if (kind == PyUnicode_1BYTE_KIND) {
-            // latin 1 according to PEP 393
-            res = QVariant(QString::fromLatin1(reinterpret_cast<const char *>(PyUnicode_1BYTE_DATA(po)), -1));
-
-        } else if (kind == PyUnicode_2BYTE_KIND) {
-            res = QVariant(QString::fromUtf16(reinterpret_cast<char16_t*>(PyUnicode_2BYTE_DATA(po)), -1));
-
-        } else if (kind == PyUnicode_4BYTE_KIND) {
-            // PyUnicode_4BYTE_KIND
-            res = QVariant(QString::fromUcs4(reinterpret_cast<char32_t*>(PyUnicode_4BYTE_DATA(po)), -1));
-        } else {
-            // convert to utf8 since not a known
-            res = QVariant(QString::fromUtf8(PyUnicode_AsUTF8(po),-1));
-        }
+        res = QVariant(PyUnicodeToQString(po));
 
     } else if (PyTuple_Check(po)) {
         QVariantList vlist;
-        int n = PyTuple_Size(po);
-        for (int i=0; i< n; i++) {
+        Py_ssize_t n = PyTuple_Size(po);
+        vlist.reserve(n);
+        for (Py_ssize_t i=0; i< n; i++) {
             vlist.append(PyObjectToQVariant(PyTuple_GetItem(po,i)));
         }
         res = QVariant(vlist);
 
     } else if (PyList_Check(po)) {
         QVariantList vlist;
-        int n = PyList_Size(po);
-        for (int i=0; i< n; i++) {
+        Py_ssize_t n = PyList_Size(po);
+        vlist.reserve(n);
+        for (Py_ssize_t i=0; i< n; i++) {
             vlist.append(PyObjectToQVariant(PyList_GetItem(po,i)));
         }
         res = QVariant(vlist);
@@ -659,25 +680,21 @@ PyObject* EmbeddedPython::QVariantToPyObject(const QVariant &v)
             value = Py_BuildValue("K", v.toULongLong(&ok));
             break;
         case QMetaType::QString:
-            // since QString's utf-16 may contain surrogates or may only be pure ascii we have no easy
-            // to know the proper string storage type to use internal to python (latin1, ucs2, ucs4)
-            // so punt and create utf-8 and let python handle the conversion internally via its c-api
-            value = Py_BuildValue("s", v.toString().toUtf8().constData());
+            value = QStringToPyObject(v.toString());
             break;
         case QMetaType::QByteArray:
-            value = Py_BuildValue("y", v.toByteArray().constData());
+            {
+              QByteArray bytes = v.toByteArray();
+              value = PyBytes_FromStringAndSize(bytes.constData(), static_cast<Py_ssize_t>(bytes.size()));
+            }
             break;
         case QMetaType::QStringList:
             {
               QStringList vlist = v.toStringList();
               value = PyList_New(vlist.size());
               int pos = 0;
-              foreach(QString av, vlist) {
-                  // since QString's utf-16 may contain surrogates or may only be pure ascii we have no easy
-                  // to know the proper string storage type to use internal to python (latin1, ucs2, ucs4)
-                  // so punt and create utf-8 and let python handle the conversion internally via its c-api
-                  PyObject* strval = Py_BuildValue("s", av.toUtf8().constData());
-                  PyList_SetItem(value, pos, strval);
+              foreach(const QString &av, vlist) {
+                  PyList_SetItem(value, pos, QStringToPyObject(av));
                   pos++;
                }
             }
@@ -687,7 +704,7 @@ PyObject* EmbeddedPython::QVariantToPyObject(const QVariant &v)
               QVariantList vlist = v.toList();
               value = PyList_New(vlist.size());
               int pos = 0;
-              foreach(QVariant av, vlist) {
+              foreach(const QVariant &av, vlist) {
                   PyList_SetItem(value, pos, QVariantToPyObject(av));
                   pos++;
               }
@@ -26,13 +26,17 @@
 
 #include <Python.h>
 #include <QCoreApplication>
+#include <QMutex>
 #include <QString>
 #include <QVariant>
-#include <QMutex>
 #include "EmbedPython/PyObjectPtr.h"
 
 /**
  * Singleton.
+ *
+ * The interpreter is only started by the first call to instance(),
+ * from whichever thread needs python first, so launches that never
+ * run python do not pay for starting it.
  */
 
 class EmbeddedPython
@@ -73,8 +77,8 @@ private:
     QString getPythonErrorTraceback(const QString& default_error = "Error: traceback report is missing",
                                     bool useMsgBox = true);
 
-    static QMutex m_mutex;
     static EmbeddedPython *m_instance;
+    static QMutex m_instancemutex;
     static int m_pyobjmetaid;
     static PyThreadState *m_threadstate;
     static int m_listintmetaid;
@@ -23,114 +23,24 @@
 
 #include <QString>
 #include <QList>
+#include <QMutexLocker>
 #include <QVariant>
 
 #include "Misc/Utility.h"
 #include "EmbedPython/PythonRoutines.h"
 
-
-QString PythonRoutines::GenerateNcxInPython(const QString &navdata, const QString &navbkpath, 
-                                            const QString &ncxdir, const QString &doctitle, 
-                                            const QString &mainid)
-{
-    QString results;
-    int rv = -1;
-    QString error_traceback;
-    QList<QVariant> args;
-    args.append(QVariant(navdata));
-    args.append(QVariant(navbkpath));
-    args.append(QVariant(ncxdir));
-    args.append(QVariant(doctitle));
-    args.append(QVariant(mainid));
-
-    EmbeddedPython * epython  = EmbeddedPython::instance();
-
-    QVariant res = epython->runInPython( QString("ncxgenerator"),
-                                         QString("generateNCX"),
-                                         args,
-                                         &rv,
-                                         error_traceback);
-    if (rv == 0) {
-        results = res.toString();
-    }
-    return results;
-}
-
-
-MetadataPieces PythonRoutines::GetMetadataInPython(const QString& opfdata, const QString& version) 
-{
-    int rv = 0;
-    QString traceback;
-    MetadataPieces mdp;
-
-    QString module = "metaproc2";
-    if (version.startsWith('3')) module = "metaproc3";
-    QList<QVariant> args;
-    args.append(QVariant(opfdata));
-    EmbeddedPython* epp = EmbeddedPython::instance();
-    QVariant res = epp->runInPython(module, QString("process_metadata"), args, &rv, traceback, true);
-    if (rv) {
-        fprintf(stderr, "process_meta error %d traceback %s\n",rv, traceback.toStdString().c_str());
-    }
-    PyObjectPtr mpo = PyObjectPtr(res);
-    args.clear();
-    res = epp->callPyObjMethod(mpo, QString("get_recognized_metadata"), args, &rv, traceback);
-    if (rv) {
-        fprintf(stderr, "get_recognized_metadata error %d traceback %s\n",rv, traceback.toStdString().c_str());
-    }
-    mdp.data = res.toString();
-    args.clear();
-    res = epp->callPyObjMethod(mpo, QString("get_other_meta_xml"), args, &rv, traceback);
-    if (rv) {
-        fprintf(stderr, "get_other_meta_xml error %d traceback %s\n",rv, traceback.toStdString().c_str());
-    }
-    mdp.otherxml = res.toString();
-    args.clear();
-    res = epp->callPyObjMethod(mpo, QString("get_id_list"), args, &rv, traceback);
-    if (rv) {
-        fprintf(stderr, "get_id_list error %d traceback %s\n",rv, traceback.toStdString().c_str());
-    }
-    mdp.idlist = res.toStringList();
-    args.clear();
-    res = epp->callPyObjMethod(mpo, QString("get_metadata_tag"), args, &rv, traceback);
-    if (rv) {
-        fprintf(stderr, "get_metadata_tag error %d traceback %s\n",rv, traceback.toStdString().c_str());
-    }
-    mdp.metatag = res.toString();
-    return mdp;
-}
-
-
-QString PythonRoutines::SetNewMetadataInPython(const MetadataPieces& mdp, const QString& opfdata, const QString& version) 
-{
-    int rv = 0;
-    QString traceback;
-    QString newopfdata= opfdata;
-    QString module = "metaproc2";
-    if (version.startsWith('3')) module = "metaproc3";
-    QList<QVariant> args;
-    args.append(QVariant(mdp.data));
-    args.append(QVariant(mdp.otherxml));
-    args.append(QVariant(mdp.idlist));
-    args.append(QVariant(mdp.metatag));
-    args.append(QVariant(opfdata));
-    EmbeddedPython* epp = EmbeddedPython::instance();
-    QVariant res = epp->runInPython(module, QString("set_new_metadata"), args, &rv, traceback, true);
-    if (rv) {
-        fprintf(stderr, "set_new_metadata error %d traceback %s\n",rv, traceback.toStdString().c_str());
-        return newopfdata;
-    }
-    newopfdata = res.toString();
-    return newopfdata;
-}
+// dulwich does not expect two threads to work on the repositories at once
+QMutex PythonRoutines::m_RepoMutex;
 
 
 QString PythonRoutines::PerformRepoCommitInPython(const QString &localRepo, 
                                                   const QString &bookid, 
                                                   const QStringList &bookinfo,
                                                   const QString &bookroot, 
-                                                  const QStringList &bookfiles) 
+                                                  const QStringList &bookfiles,
+                                                  const QStringList &bookhashes)
 {
+    QMutexLocker locker(&m_RepoMutex);
     QString results;
     int rv = -1;
     QString error_traceback;
@@ -140,6 +50,7 @@ QString PythonRoutines::PerformRepoCommitInPython(const QString &localRepo,
     args.append(QVariant(bookinfo));
     args.append(QVariant(bookroot));
     args.append(QVariant(bookfiles));
+    args.append(QVariant(bookhashes));
 
     EmbeddedPython * epython  = EmbeddedPython::instance();
 
@@ -157,6 +68,7 @@ QString PythonRoutines::PerformRepoCommitInPython(const QString &localRepo,
 
 bool PythonRoutines::PerformRepoEraseInPython(const QString& localRepo, const QString& bookid)
 {
+    QMutexLocker locker(&m_RepoMutex);
     bool results = false;
     int rv = -1;
     QString error_traceback;
@@ -179,6 +91,7 @@ bool PythonRoutines::PerformRepoEraseInPython(const QString& localRepo, const QS
 
 QStringList PythonRoutines::GetRepoTagsInPython(const QString& localRepo, const QString& bookid)
 {
+    QMutexLocker locker(&m_RepoMutex);
     QStringList results;
     int rv = -1;
     QString error_traceback;
@@ -201,6 +114,7 @@ QStringList PythonRoutines::GetRepoTagsInPython(const QString& localRepo, const
 
 bool PythonRoutines::ChangeRepoTagMsgInPython(const QString& localRepo, const QString& bookid, const QString& tagname, const QString& newmessage)
 {
+    QMutexLocker locker(&m_RepoMutex);
     bool results = false;
     int rv = -1;
     QString error_traceback;
@@ -230,6 +144,7 @@ QString PythonRoutines::GenerateEpubFromTagInPython(const QString& localRepo,
                                                     const QString& filename,
                                                     const QString& destpath)
 {
+    QMutexLocker locker(&m_RepoMutex);
     QString results;
     int rv = -1;
     QString error_traceback;
@@ -259,6 +174,7 @@ QString PythonRoutines::GenerateDiffFromCheckPoints(const QString& localRepo,
                                     const QString& leftchkpoint,
                                     const QString& rightchkpoint)
 {
+    QMutexLocker locker(&m_RepoMutex);
     QString results;
     int rv = -1;
     QString error_traceback;
@@ -284,6 +200,7 @@ QString PythonRoutines::GenerateDiffFromCheckPoints(const QString& localRepo,
 QString PythonRoutines::GenerateRepoLogSummaryInPython(const QString& localRepo,
                                                        const QString& bookid)
 {
+    QMutexLocker locker(&m_RepoMutex);
     QString results;
     int rv = -1;
     QString error_traceback;
@@ -393,11 +310,48 @@ QList<QStringList> PythonRoutines::GetCurrentStatusVsDestDirInPython(const QStri
 }
 
 
+// returns 3 string lists: deleted, added, and modified (in that order)
+QList<QStringList> PythonRoutines::GetCurrentStatusVsTagInPython(const QString& localRepo,
+                                                                 const QString& bookid,
+                                                                 const QString& tagname,
+                                                                 const QStringList& bookfiles,
+                                                                 const QStringList& bookhashes)
+{
+    QMutexLocker locker(&m_RepoMutex);
+    QList<QStringList> results;
+    int rv = -1;
+    QString error_traceback;
+    QList<QVariant> args;
+    args.append(QVariant(localRepo));
+    args.append(QVariant(bookid));
+    args.append(QVariant(tagname));
+    args.append(QVariant(bookfiles));
+    args.append(QVariant(bookhashes));
+
+    EmbeddedPython * epython  = EmbeddedPython::instance();
+
+    QVariant res = epython->runInPython( QString("repomanager"),
+                                         QString("get_current_status_vs_tag"),
+                                         args,
+                                         &rv,
+                                         error_traceback);
+    if (rv == 0) {
+        QVariantList vlist = res.toList();
+        foreach(QVariant qv, vlist) {
+            results << qv.toStringList();
+        }
+    }
+    return results;
+}
+
+
 QString PythonRoutines::CopyTagToDestDirInPython(const QString& localRepo,
                                                  const QString& bookid,
                                                  const QString& tagname,
-                                                 const QString& destdir)
+                                                 const QString& destdir,
+                                                 const QStringList& bookpaths)
 {
+    QMutexLocker locker(&m_RepoMutex);
     QString results;
     int rv = -1;
     QString error_traceback;
@@ -406,6 +360,7 @@ QString PythonRoutines::CopyTagToDestDirInPython(const QString& localRepo,
     args.append(QVariant(bookid));
     args.append(QVariant(tagname));
     args.append(QVariant(destdir));
+    args.append(QVariant(bookpaths));
 
     EmbeddedPython * epython  = EmbeddedPython::instance();
 
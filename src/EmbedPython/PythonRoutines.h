@@ -28,16 +28,10 @@
 #include <QStringList>
 #include <QVariant>
 #include <QMetaType>
+#include <QMutex>
 
 #include "EmbedPython/DiffRec.h"
 
-struct MetadataPieces {
-    QString data;
-    QString otherxml;
-    QStringList idlist;
-    QString metatag;
-};
-
 class PythonRoutines
 {
 
@@ -45,18 +39,12 @@ public:
 
     PythonRoutines() {};
 
-    QString GenerateNcxInPython(const QString &navdata, const QString &navbkpath,
-                                const QString &ncx_dir, const QString &doctitle, const QString &mainid);
-
-    MetadataPieces GetMetadataInPython(const QString& opfdata, const QString& version);
-
-    QString SetNewMetadataInPython(const MetadataPieces& mdp, const QString& opfdata, const QString& version);
-
     QString PerformRepoCommitInPython(  const QString&     localRepo,
                                         const QString&     bookid,
                                         const QStringList& bookinfo,
                                         const QString&     bookroot,
-                                        const QStringList& bookfiles );
+                                        const QStringList& bookfiles,
+                                        const QStringList& bookhashes );
 
     bool PerformRepoEraseInPython(      const QString& localRepo, 
                                         const QString& bookid ); 
@@ -87,16 +75,27 @@ public:
 
     QString GenerateUnifiedDiffInPython(const QString& path1, const QString& path2);
 
+    // writes the files of the tag straight from the repo's object store,
+    // just the bookpaths given unless that list is empty
     QString CopyTagToDestDirInPython(const QString& localRepo,
                                      const QString& bookid,
                                      const QString& tagname,
-                                     const QString& destdir);
+                                     const QString& destdir,
+                                     const QStringList& bookpaths);
 
     // returns 3 stringlists in the following order: deleted, added, modified
     QList<QStringList> GetCurrentStatusVsDestDirInPython(const QString& bookroot,
                                                          const QStringList& bookfiles,
                                                          const QString& destdir);
 
+    // same as above against the tree of a checkpoint, using the git blob ids
+    // of the bookfiles rather than comparing them against a checkout
+    QList<QStringList> GetCurrentStatusVsTagInPython(const QString& localRepo,
+                                                     const QString& bookid,
+                                                     const QString& tagname,
+                                                     const QStringList& bookfiles,
+                                                     const QStringList& bookhashes);
+
     QString RebaseManifestIDsInPython(const QString& opfdata);
 
 
@@ -105,7 +104,12 @@ private:
     ///////////////////////////////
     // PRIVATE MEMBER VARIABLES
     ///////////////////////////////
-    
+
+    /**
+     * Held by every routine that works on a checkpoint repository.
+     * Everything else may run python alongside them.
+     */
+    static QMutex m_RepoMutex;
 };
 
 Q_DECLARE_METATYPE(QList<int>);
@@ -24,20 +24,30 @@
 #define NOMINMAX
 #endif
 
+#include <algorithm>
+#include <functional>
 #include <string>
 #include <string.h>
+#include <tuple>
 
 #include <zip.h>
+#include <unzip.h>
 #ifdef _WIN32
 #include <iowin32.h>
 #endif
 
+#include <QBuffer>
 #include <QDateTime>
 #include <QDir>
 #include <QDirIterator>
 #include <QFile>
 #include <QFileInfo>
-#include <QTemporaryFile>
+#include <QHash>
+#include <QReadLocker>
+#include <QScopedPointer>
+#include <QSet>
+#include <QtEndian>
+#include <QtConcurrent/QtConcurrent>
 #include <QTextStream>
 
 #include "BookManipulation/CleanSource.h"
@@ -46,29 +56,539 @@
 #include "Exporters/EncryptionXmlWriter.h"
 #include "Exporters/ExportEPUB.h"
 #include "Misc/Utility.h"
-#include "Misc/TempFolder.h"
 #include "Misc/FontObfuscation.h"
+#include "Misc/FontSubset.h"
+#include "Misc/ImageOptimizer.h"
+#include "Misc/MappedZipArchive.h"
+#include "Misc/SettingsStore.h"
+#include "Misc/Trace.h"
 #include "ResourceObjects/Resource.h"
 #include "ResourceObjects/FontResource.h"
+#include "ResourceObjects/ImageResource.h"
+#include "ResourceObjects/TextResource.h"
 #include "sigil_constants.h"
 #include "sigil_exception.h"
 
 #define BUFF_SIZE 8192
 
+// Fixed parts of the zip end of central directory and central directory records
+static const int EOCD_SIZE = 22;
+static const int CENTRAL_RECORD_SIZE = 46;
+
+// Files up to this size are deflated into memory by the workers
+static const qint64 MAX_IN_MEMORY_ENTRY = 32 * 1024 * 1024;
+
+// How much file data a batch of workers may hold in memory at once
+static const qint64 MAX_BATCH_SIZE = 256 * 1024 * 1024;
+
+// Formats that are already compressed, the fast profile stores them
+static const QStringList INCOMPRESSIBLE_EXTENSIONS = QStringList() <<
+    "jpg" << "jpeg" << "png" << "gif" << "webp" <<
+    "woff" << "woff2" <<
+    "mp3" << "m4a" << "aac" << "oga" << "ogg" << "opus" <<
+    "mp4" << "m4v" << "ogv" << "webm";
+
+#ifndef MAX_PATH
+// Set Max length to 256 because that's the max path size on many systems.
+#define MAX_PATH 256
+#endif
+
 const QString BODY_START = "<\\s*body[^>]*>";
 const QString BODY_END   = "</\\s*body\\s*>";
 
 const QString CONTAINER_XML_FILE_NAME  = "container.xml";
 const QString ENCRYPTION_XML_FILE_NAME = "encryption.xml";
 
-static const QString METAINF_FOLDER_SUFFIX = "/META-INF";
-
 static const char * EPUB_MIME_DATA = "application/epub+zip";
 
+/**
+ * The epub being replaced by a save.  Its entries whose bytes have not
+ * changed are copied into the new archive still compressed.
+ */
+struct SourceArchive {
+    struct Entry {
+        unz64_file_pos pos;
+        size_t size;
+        QString crc;
+    };
+
+    SourceArchive(const QString &zippath)
+        :
+        archive(zippath),
+        zfile(NULL)
+    {
+        if (!QFileInfo(zippath).isFile()) {
+            return;
+        }
+        zfile = archive.Open();
+        if (zfile == NULL) {
+            return;
+        }
+        int res = unzGoToFirstFile(zfile);
+        while (res == UNZ_OK) {
+            char file_name[MAX_PATH] = {0};
+            unz_file_info64 file_info;
+            unzGetCurrentFileInfo64(zfile, &file_info, file_name, MAX_PATH, NULL, 0, NULL, 0);
+            // names are only known to be utf-8 if flagged so or plain ascii
+            bool is_ascii = true;
+            for (const char *c = file_name; *c; ++c) {
+                if (static_cast<unsigned char>(*c) >= 0x80) is_ascii = false;
+            }
+            if ((file_info.flag & (1<<11)) || is_ascii) {
+                Entry entry;
+                unzGetFilePos64(zfile, &entry.pos);
+                entry.size = file_info.uncompressed_size;
+                entry.crc = QString("%1").arg(file_info.crc, 8, 16, QLatin1Char('0'));
+                entries.insert(QString::fromUtf8(file_name), entry);
+            }
+            res = unzGoToNextFile(zfile);
+        }
+    }
+
+    ~SourceArchive()
+    {
+        if (zfile) {
+            unzClose(zfile);
+        }
+    }
+
+    /**
+     * Returns true if the archive has relpath with the given size and
+     * CRC.  Only reads the entry list so workers may call it.
+     */
+    bool Has(const QString &relpath, size_t size, const QString &crc) const
+    {
+        if (!zfile || !entries.contains(relpath)) {
+            return false;
+        }
+        Entry entry = entries.value(relpath);
+        return (entry.size == size) && (entry.crc == crc);
+    }
+
+    /**
+     * Opens the raw compressed data of relpath if the archive has it
+     * with the given size and CRC.
+     */
+    bool OpenRaw(const QString &relpath, size_t size, const QString &crc, int *method, int *level)
+    {
+        if (!Has(relpath, size, crc)) {
+            return false;
+        }
+        unz64_file_pos pos = entries.value(relpath).pos;
+        return (unzGoToFilePos64(zfile, &pos) == UNZ_OK) &&
+               (unzOpenCurrentFile2(zfile, method, level, 1) == UNZ_OK);
+    }
+
+    MappedZipArchive archive;
+    unzFile zfile;
+    QHash<QString, Entry> entries;
+};
+
+
+/**
+ * How hard the entries of the archive are compressed.
+ */
+struct CompressionProfile {
+    // the deflate level used for everything not stored
+    int level;
+
+    // store formats that are compressed already
+    bool store_compressed;
+
+    // copy entries unchanged since the old epub instead of
+    // compressing them again
+    bool reuse_entries;
+};
+
+
+static CompressionProfile GetCompressionProfile(const QString &name)
+{
+    CompressionProfile profile;
+    profile.level = 8;
+    profile.store_compressed = false;
+    profile.reuse_entries = true;
+    if (name == "fast") {
+        profile.level = 1;
+        profile.store_compressed = true;
+    } else if (name == "archival") {
+        // entries of the old epub may have been written by a faster profile
+        profile.level = Z_BEST_COMPRESSION;
+        profile.reuse_entries = false;
+    }
+    return profile;
+}
+
+
+/**
+ * One file of the book on its way into the archive.
+ */
+struct ExportEntry {
+    QString relpath;
+    QString file_path;
+    qint64 size;
+    int method;
+    int level;
+
+    // set when the bytes written differ from the file in the book
+    // folder, such as obfuscated fonts, and content holds them
+    bool generated;
+    QByteArray content;
+
+    // filled in by CompressEntry
+    bool ok;
+    QString crc;
+    bool in_source;
+    bool in_memory;
+    QByteArray data;
+};
+
+
+// Runs in a worker thread.
+// Files small enough are read and deflated into memory here so that
+// the writer only has to append them.  Bigger ones are only checked
+// against the old epub and left for the writer to stream.
+// source is NULL when entries of the old epub must not be reused.
+static ExportEntry CompressEntry(ExportEntry entry, const SourceArchive *source)
+{
+    entry.ok = true;
+    entry.in_source = false;
+    entry.in_memory = false;
+    if (!entry.generated && (entry.size > MAX_IN_MEMORY_ENTRY)) {
+        entry.crc = Utility::FileCRC32(entry.file_path);
+        entry.in_source = source && source->Has(entry.relpath, entry.size, entry.crc);
+        return entry;
+    }
+
+    QByteArray content = entry.content;
+    if (!entry.generated) {
+        QFile file(entry.file_path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            entry.ok = false;
+            return entry;
+        }
+        content = file.readAll();
+        file.close();
+    }
+    entry.size = content.size();
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, reinterpret_cast<const Bytef *>(content.constData()), static_cast<uInt>(content.size()));
+    entry.crc = QString("%1").arg(static_cast<quint32>(crc), 8, 16, QLatin1Char('0'));
+    entry.in_source = source && source->Has(entry.relpath, entry.size, entry.crc);
+    if (entry.in_source) {
+        return entry;
+    }
+
+    if (entry.method != Z_DEFLATED) {
+        entry.data = content;
+        entry.in_memory = true;
+        return entry;
+    }
+
+    // a raw deflate stream, the same as minizip writes
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, entry.level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        entry.ok = false;
+        return entry;
+    }
+    entry.data.resize(deflateBound(&zs, content.size()));
+    zs.next_in = reinterpret_cast<Bytef *>(content.data());
+    zs.avail_in = static_cast<uInt>(content.size());
+    zs.next_out = reinterpret_cast<Bytef *>(entry.data.data());
+    zs.avail_out = static_cast<uInt>(entry.data.size());
+    int res = deflate(&zs, Z_FINISH);
+    entry.data.resize(zs.total_out);
+    deflateEnd(&zs);
+    if (res != Z_STREAM_END) {
+        entry.ok = false;
+        entry.data.clear();
+        return entry;
+    }
+    entry.in_memory = true;
+    return entry;
+}
+
+
+// Runs in a worker thread.
+static bool IsHexDigit(const QChar &c)
+{
+    return c.isDigit() || ((c.toLower() >= 'a') && (c.toLower() <= 'f'));
+}
+
+
+static ExportEntry ChecksumEntry(ExportEntry entry)
+{
+    if (entry.generated) {
+        uLong crc = crc32(0L, Z_NULL, 0);
+        crc = crc32(crc, reinterpret_cast<const Bytef *>(entry.content.constData()), static_cast<uInt>(entry.content.size()));
+        entry.crc = QString("%1").arg(static_cast<quint32>(crc), 8, 16, QLatin1Char('0'));
+        return entry;
+    }
+    entry.crc = Utility::FileCRC32(entry.file_path);
+    return entry;
+}
+
+
+// Runs in a worker thread.
+// Returns the book path and the bytes of a text held in memory.
+static std::tuple<QString, QByteArray> TextFileDataMapped(TextResource *resource)
+{
+    QReadLocker locker(&resource->GetLock());
+    return std::make_tuple(resource->GetRelativePath(), resource->GetFileData());
+}
+
+
+// Runs in a worker thread.
+// Returns the subset of the font file, empty if it is left as it is.
+static QByteArray SubsetFontFile(const QString &filepath, const QSet<uint> &codepoints)
+{
+    QFile file(filepath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return FontSubset::SubsetTrueType(file.readAll(), codepoints);
+}
+
+
+/**
+ * A central directory record of the epub being updated in place.
+ */
+struct DirectoryRecord {
+    QString name;
+    quint64 offset;
+    qint64 size;
+    QString crc;
+    QByteArray raw;
+};
+
+
+static bool OffsetLessThan(const DirectoryRecord &r1, const DirectoryRecord &r2)
+{
+    return r1.offset < r2.offset;
+}
+
+
+// Reads the central directory of a zip that does not use zip64.
+static bool ReadCentralDirectory(QFile &zip, QList<DirectoryRecord> &records, quint64 *directory_offset)
+{
+    qint64 zip_size = zip.size();
+    qint64 tail_size = qMin(zip_size, static_cast<qint64>(EOCD_SIZE + 0xffff));
+    if (tail_size < EOCD_SIZE || !zip.seek(zip_size - tail_size)) {
+        return false;
+    }
+    QByteArray tail = zip.read(tail_size);
+    int eocd = tail.lastIndexOf(QByteArray("PK\x05\x06", 4));
+    if ((eocd < 0) || (tail.size() - eocd < EOCD_SIZE)) {
+        return false;
+    }
+    // a zip64 end of central directory locator comes right before it
+    if ((eocd >= 20) && (tail.mid(eocd - 20, 4) == QByteArray("PK\x06\x07", 4))) {
+        return false;
+    }
+    const uchar *end = reinterpret_cast<const uchar *>(tail.constData()) + eocd;
+    quint16 count = qFromLittleEndian<quint16>(end + 10);
+    quint32 size = qFromLittleEndian<quint32>(end + 12);
+    quint32 offset = qFromLittleEndian<quint32>(end + 16);
+    if ((count == 0xffff) || (size == 0xffffffff) || (offset == 0xffffffff) ||
+        (static_cast<qint64>(offset) + size > zip_size) || !zip.seek(offset)) {
+        return false;
+    }
+    QByteArray directory = zip.read(size);
+    if (directory.size() != static_cast<int>(size)) {
+        return false;
+    }
+
+    int pos = 0;
+    for (int i = 0; i < count; ++i) {
+        if ((directory.size() - pos < CENTRAL_RECORD_SIZE) || (directory.mid(pos, 4) != QByteArray("PK\x01\x02", 4))) {
+            return false;
+        }
+        const uchar *rec = reinterpret_cast<const uchar *>(directory.constData()) + pos;
+        quint16 flag = qFromLittleEndian<quint16>(rec + 8);
+        quint32 crc = qFromLittleEndian<quint32>(rec + 16);
+        quint32 usize = qFromLittleEndian<quint32>(rec + 24);
+        int name_len = qFromLittleEndian<quint16>(rec + 28);
+        int record_len = CENTRAL_RECORD_SIZE + name_len + qFromLittleEndian<quint16>(rec + 30) + qFromLittleEndian<quint16>(rec + 32);
+        quint32 local_offset = qFromLittleEndian<quint32>(rec + 42);
+        if ((directory.size() - pos < record_len) || (usize == 0xffffffff) || (local_offset == 0xffffffff)) {
+            return false;
+        }
+        QByteArray name = directory.mid(pos + CENTRAL_RECORD_SIZE, name_len);
+        bool is_ascii = true;
+        foreach(char c, name) {
+            if (static_cast<unsigned char>(c) >= 0x80) is_ascii = false;
+        }
+        if (!(flag & (1<<11)) && !is_ascii) {
+            return false;
+        }
+        DirectoryRecord record;
+        record.name = QString::fromUtf8(name);
+        record.offset = local_offset;
+        record.size = usize;
+        record.crc = QString("%1").arg(crc, 8, 16, QLatin1Char('0'));
+        record.raw = directory.mid(pos, record_len);
+        records << record;
+        pos += record_len;
+    }
+    *directory_offset = offset;
+    return true;
+}
+
+
+// Cuts the epub at path off where its first entry that is not in files
+// unchanged begins, and closes what is left of it with a central
+// directory of its own so that minizip can append the rest.  The entries
+// kept are taken out of files.  Returns false, leaving the epub alone,
+// when it can not be updated like this or too much of it has changed.
+static bool TruncateForIncrementalSave(const QString &path, QList<ExportEntry> &files, QScopedPointer<SourceArchive> &source)
+{
+    QList<DirectoryRecord> records;
+    quint64 directory_offset = 0;
+    qint64 zip_size = 0;
+    {
+        QFile zip(path);
+        if (!zip.open(QIODevice::ReadOnly) || !ReadCentralDirectory(zip, records, &directory_offset)) {
+            return false;
+        }
+        zip_size = zip.size();
+    }
+    std::sort(records.begin(), records.end(), OffsetLessThan);
+    uLong mime_crc = crc32(0L, Z_NULL, 0);
+    mime_crc = crc32(mime_crc, reinterpret_cast<const Bytef *>(EPUB_MIME_DATA), static_cast<uInt>(strlen(EPUB_MIME_DATA)));
+    if (records.isEmpty() || (records.first().name != "mimetype") || (records.first().offset != 0) ||
+        (records.first().size != static_cast<qint64>(strlen(EPUB_MIME_DATA))) ||
+        (records.first().crc != QString("%1").arg(static_cast<quint32>(mime_crc), 8, 16, QLatin1Char('0')))) {
+        return false;
+    }
+
+    files = QtConcurrent::blockingMapped(files, ChecksumEntry);
+    QHash<QString, int> file_index;
+    for (int i = 0; i < files.count(); ++i) {
+        file_index.insert(files.at(i).relpath, i);
+    }
+
+    QByteArray kept_directory = records.first().raw;
+    QSet<int> kept;
+    int count = 1;
+    for (; count < records.count(); ++count) {
+        const DirectoryRecord &record = records.at(count);
+        int i = file_index.value(record.name, -1);
+        if ((i < 0) || kept.contains(i) || (files.at(i).size != record.size) || (files.at(i).crc != record.crc)) {
+            break;
+        }
+        kept.insert(i);
+        kept_directory.append(record.raw);
+    }
+    quint64 cut = (count < records.count()) ? records.at(count).offset : directory_offset;
+    if (static_cast<qint64>(cut) < zip_size / 2) {
+        return false;
+    }
+
+    // From here on the old epub is written to
+    source.reset();
+    QFile zip(path);
+    if (!zip.open(QIODevice::ReadWrite) || !zip.resize(cut) || !zip.seek(cut)) {
+        throw(CannotWriteFile(path.toStdString()));
+    }
+    uchar eocd[EOCD_SIZE] = {0};
+    qToLittleEndian<quint32>(0x06054b50, eocd);
+    qToLittleEndian<quint16>(count, eocd + 8);
+    qToLittleEndian<quint16>(count, eocd + 10);
+    qToLittleEndian<quint32>(kept_directory.size(), eocd + 12);
+    qToLittleEndian<quint32>(cut, eocd + 16);
+    kept_directory.append(reinterpret_cast<const char *>(eocd), EOCD_SIZE);
+    if (zip.write(kept_directory) != kept_directory.size()) {
+        throw(CannotWriteFile(path.toStdString()));
+    }
+    zip.close();
+
+    QList<ExportEntry> remaining;
+    for (int i = 0; i < files.count(); ++i) {
+        if (!kept.contains(i)) {
+            remaining << files.at(i);
+        }
+    }
+    files = remaining;
+    return true;
+}
+
+
+// Adds one entry to the archive, from the old epub, from memory or
+// streamed from its file.  On failure the entry is closed again and
+// false is returned.
+static bool WriteEntry(zipFile zfile, const ExportEntry &entry, zip_fileinfo *fileInfo, SourceArchive *source)
+{
+    int method = entry.method;
+    int level = entry.level;
+    bool from_source = entry.in_source && source->OpenRaw(entry.relpath, entry.size, entry.crc, &method, &level);
+    bool raw = from_source || entry.in_memory;
+
+    // Add the file entry to the archive.
+    // We should check the uncompressed file size. If it's over >= 0xffffffff the last parameter (zip64) should be 1.
+    if (zipOpenNewFileInZip4_64(zfile, entry.relpath.toUtf8().constData(), fileInfo, NULL, 0, NULL, 0, NULL, method, level, raw ? 1 : 0, 15, 8, Z_DEFAULT_STRATEGY, NULL, 0, 0x0b00, 1<<11, 0) != ZIP_OK) {
+        if (from_source) unzCloseCurrentFile(source->zfile);
+        return false;
+    }
+
+    if (entry.in_memory) {
+        if (zipWriteInFileInZip(zfile, entry.data.constData(), static_cast<unsigned int>(entry.data.size())) != ZIP_OK) {
+            zipCloseFileInZip(zfile);
+            return false;
+        }
+        return zipCloseFileInZipRaw64(zfile, entry.size, entry.crc.toULong(NULL, 16)) == ZIP_OK;
+    }
+
+    // the file on disk to write
+    QFile dfile(entry.file_path);
+
+    if (!from_source && !dfile.open(QIODevice::ReadOnly)) {
+        zipCloseFileInZip(zfile);
+        return false;
+    }
+
+    // Write the data from the file on disk, or the compressed
+    // data from the old epub, into the archive.
+    char buff[BUFF_SIZE] = {0};
+    qint64 read = 0;
+
+    while ((read = from_source ? unzReadCurrentFile(source->zfile, buff, BUFF_SIZE) : dfile.read(buff, BUFF_SIZE)) > 0) {
+        if (zipWriteInFileInZip(zfile, buff, read) != ZIP_OK) {
+            break;
+        }
+    }
+
+    if (from_source) {
+        unzCloseCurrentFile(source->zfile);
+    } else {
+        dfile.close();
+    }
+
+    // There was an error reading the file on disk or writing it out.
+    if (read != 0) {
+        zipCloseFileInZip(zfile);
+        return false;
+    }
+
+    int closed = from_source ? zipCloseFileInZipRaw64(zfile, entry.size, entry.crc.toULong(NULL, 16)) : zipCloseFileInZip(zfile);
+    return closed == ZIP_OK;
+}
+
 
 // Constructor;
 // the first parameter is the location where the book
 // should be save to, and the second is the book to be saved
+QStringList ExportEPUB::CompressionProfiles()
+{
+    return QStringList() << "fast" << "balanced" << "archival";
+}
+
+
+QStringList ExportEPUB::ImageOptimizationProfiles()
+{
+    return QStringList() << "none" << "lossless" << "lossy";
+}
+
+
 ExportEPUB::ExportEPUB(const QString &fullfilepath, QSharedPointer<Book> book)
     :
     m_FullFilePath(fullfilepath),
@@ -87,6 +607,7 @@ ExportEPUB::~ExportEPUB()
 // specified in the constructor
 void ExportEPUB::WriteBook()
 {
+    TRACE_SPAN(span, "ExportEPUB::WriteBook");
     // Obfuscating fonts needs an UUID ident
     if (m_Book->HasObfuscatedFonts()) {
         m_Book->GetOPF()->EnsureUUIDIdentifierPresent();
@@ -96,44 +617,145 @@ void ExportEPUB::WriteBook()
         m_Book->GetOPF()->AddSigilVersionMeta();
     }
     m_Book->GetOPF()->AddModificationDateMeta();
-    m_Book->SaveAllResourcesToDisk();
-    TempFolder tempfolder;
-    CreatePublication(tempfolder.GetPath());
-
-    if (m_Book->HasObfuscatedFonts()) {
-        ObfuscateFonts(tempfolder.GetPath());
+    {
+        TRACE_SPAN(phase, "Book::SaveAllResourcesToDisk");
+        m_Book->SaveAllResourcesToDisk();
+    }
+    QHash<QString, QByteArray> generated;
+    {
+        TRACE_SPAN(phase, "ExportEPUB::CreatePublication");
+        generated = CreatePublication();
     }
 
-    SaveFolderAsEpubToLocation(tempfolder.GetPath(), m_FullFilePath);
+    {
+        TRACE_SPAN(phase, "ExportEPUB::SaveFolderAsEpubToLocation");
+        SaveFolderAsEpubToLocation(m_Book->GetFolderKeeper()->GetFullPathToMainFolder(), m_FullFilePath, generated);
+    }
 }
 
-// Creates the publication from the Book
-// (creates XHTML, CSS, OPF, NCX files etc.)
-void ExportEPUB::CreatePublication(const QString &fullfolderpath)
+// Works out the files of the publication that differ from the ones
+// in the book folder, which are zipped as they are
+QHash<QString, QByteArray> ExportEPUB::CreatePublication()
 {
-    Utility::CopyFiles(m_Book->GetFolderKeeper()->GetFullPathToMainFolder(), fullfolderpath);
+    QHash<QString, QByteArray> generated;
+
+    // Text held in memory is zipped from its bytes rather than read back from disk
+    {
+        TRACE_SPAN(phase, "ExportEPUB::GetTextFileData");
+        QList<TextResource *> text_resources = m_Book->GetFolderKeeper()->GetResourceTypeList<TextResource>();
+        QFuture<std::tuple<QString, QByteArray>> future = QtConcurrent::mapped(text_resources, TextFileDataMapped);
+        for (int i = 0; i < future.results().count(); ++i) {
+            QString relpath;
+            QByteArray data;
+            std::tie(relpath, data) = future.resultAt(i);
+            if (!data.isEmpty()) {
+                generated.insert(relpath, data);
+            }
+        }
+    }
+
+    SettingsStore ss;
+    QString image_profile = ss.imageOptimization();
+    if ((image_profile != "none") && ImageOptimizationProfiles().contains(image_profile)) {
+        TRACE_SPAN(phase, "ExportEPUB::OptimizeImages");
+        OptimizeImages(generated, image_profile);
+    }
+
+    // Fonts are subset before they are obfuscated
+    if (ss.subsetFonts()) {
+        TRACE_SPAN(phase, "ExportEPUB::SubsetFonts");
+        SubsetFonts(generated);
+    }
 
     if (m_Book->HasObfuscatedFonts()) {
-        CreateEncryptionXML(fullfolderpath + METAINF_FOLDER_SUFFIX);
+        ObfuscateFonts(generated);
+        generated.insert("META-INF/" + ENCRYPTION_XML_FILE_NAME, CreateEncryptionXML());
     }
+    return generated;
 }
 
-void ExportEPUB::SaveFolderAsEpubToLocation(const QString &fullfolderpath, const QString &fullfilepath)
+void ExportEPUB::SaveFolderAsEpubToLocation(const QString &fullfolderpath, const QString &fullfilepath,
+                                            const QHash<QString, QByteArray> &generated)
 {
     QString tempFile = fullfolderpath + "-tmp.epub";
     QDateTime timeNow = QDateTime::currentDateTime();
     QString modified_now = timeNow.toString("yyyy-MM-dd hh:mm:ss");
     zip_fileinfo fileInfo;
+    QScopedPointer<SourceArchive> source(new SourceArchive(fullfilepath));
+    SettingsStore ss;
+    QString profile_name = m_Book->GetSaveCompression();
+    if (profile_name.isEmpty()) {
+        profile_name = ss.epubCompression();
+    }
+    CompressionProfile profile = GetCompressionProfile(profile_name);
+
+    // Write all the files in our directory path to the archive.
+    QList<ExportEntry> files;
+    QDirIterator it(fullfolderpath, QDir::Files | QDir::NoDotAndDotDot | QDir::Readable | QDir::Hidden, QDirIterator::Subdirectories);
+
+    while (it.hasNext()) {
+        it.next();
+        QString relpath = it.filePath().remove(fullfolderpath);
+
+        while (relpath.startsWith("/")) {
+            relpath = relpath.remove(0, 1);
+        }
+
+        // do not double add the mimetype file
+        if (relpath == "mimetype") continue;
+
+        ExportEntry entry;
+        entry.relpath = relpath;
+        entry.file_path = it.filePath();
+        entry.size = QFileInfo(it.filePath()).size();
+        files << entry;
+    }
+
+    // Files that are not in the book folder at all, such as encryption.xml
+    QSet<QString> on_disk;
+    foreach(const ExportEntry &entry, files) {
+        on_disk.insert(entry.relpath);
+    }
+    foreach(const QString &relpath, generated.keys()) {
+        if (!on_disk.contains(relpath)) {
+            ExportEntry entry;
+            entry.relpath = relpath;
+            entry.file_path = fullfolderpath + "/" + relpath;
+            files << entry;
+        }
+    }
+
+    for (int i = 0; i < files.count(); ++i) {
+        ExportEntry &entry = files[i];
+        entry.generated = generated.contains(entry.relpath);
+        if (entry.generated) {
+            entry.content = generated.value(entry.relpath);
+            entry.size = entry.content.size();
+        }
+        entry.method = Z_DEFLATED;
+        entry.level = profile.level;
+        if (profile.store_compressed && INCOMPRESSIBLE_EXTENSIONS.contains(QFileInfo(entry.relpath).suffix().toLower())) {
+            entry.method = 0;
+            entry.level = 0;
+        }
+    }
+
+    // After small edits the old epub is kept up to the first entry that
+    // changed and only what follows is written again, straight into it.
+    bool incremental = ss.incrementalSave() && QFileInfo(fullfilepath).isFile() &&
+                       TruncateForIncrementalSave(fullfilepath, files, source);
+    QString zippath = incremental ? fullfilepath : tempFile;
+    int append = incremental ? APPEND_STATUS_ADDINZIP : APPEND_STATUS_CREATE;
 #ifdef Q_OS_WIN32
     zlib_filefunc64_def ffunc;
     fill_win32_filefunc64W(&ffunc);
-    zipFile zfile = zipOpen2_64(Utility::QStringToStdWString(QDir::toNativeSeparators(tempFile)).c_str(), APPEND_STATUS_CREATE, NULL, &ffunc);
+    zipFile zfile = zipOpen2_64(Utility::QStringToStdWString(QDir::toNativeSeparators(zippath)).c_str(), append, NULL, &ffunc);
 #else
-    zipFile zfile = zipOpen64(QDir::toNativeSeparators(tempFile).toUtf8().constData(), APPEND_STATUS_CREATE);
+    zipFile zfile = zipOpen64(QDir::toNativeSeparators(zippath).toUtf8().constData(), append);
 #endif
 
     if (zfile == NULL) {
-        throw (CannotOpenFile(tempFile.toStdString()));
+        throw (CannotOpenFile(zippath.toStdString()));
     }
 
     memset(&fileInfo, 0, sizeof(fileInfo));
@@ -145,112 +767,89 @@ void ExportEPUB::SaveFolderAsEpubToLocation(const QString &fullfolderpath, const
     fileInfo.tmz_date.tm_year = timeNow.date().year();
 
      // Write the mimetype. This must be uncompressed and the first entry in the archive.
-    if (zipOpenNewFileInZip64(zfile, "mimetype", &fileInfo, NULL, 0, NULL, 0, NULL, Z_NO_COMPRESSION, 0, 0) != ZIP_OK) {
-        zipClose(zfile, NULL);
-        QFile::remove(tempFile);
-        throw(CannotStoreFile("mimetype"));
-    }
-
-    if (zipWriteInFileInZip(zfile, EPUB_MIME_DATA, (unsigned int)strlen(EPUB_MIME_DATA)) != ZIP_OK) {
-        zipCloseFileInZip(zfile);
-        zipClose(zfile, NULL);
-        QFile::remove(tempFile);
-        throw(CannotStoreFile("mimetype"));
-    }
-
-    zipCloseFileInZip(zfile);
-    // Write all the files in our directory path to the archive.
-    QDirIterator it(fullfolderpath, QDir::Files | QDir::NoDotAndDotDot | QDir::Readable | QDir::Hidden, QDirIterator::Subdirectories);
-
-    while (it.hasNext()) {
-        it.next();
-        QString relpath = it.filePath().remove(fullfolderpath);
-
-        while (relpath.startsWith("/")) {
-            relpath = relpath.remove(0, 1);
-        }
-
-        // do not double add the mimetype file
-        if (relpath == "mimetype") continue;
-
-        QFileInfo tfile(it.filePath());
-
-        // Set the proper zip file info if possible
-        QString amodified = modified_now;
-        size_t afilesize = tfile.size();
-        QString afilecrc = Utility::FileCRC32(it.filePath());
-        Resource* resource = m_Book->GetFolderKeeper()->GetResourceByBookPathNoThrow(relpath);
-        if (resource) {
-            QString savedcrc  = resource->GetSavedCRC32();
-            QString saveddate = resource->GetSavedDate();
-            size_t savedsize = resource->GetSavedSize();
-            if ( (savedsize == afilesize) && (savedcrc == afilecrc) ) {
-                amodified = saveddate;
-            } else {
-                resource->SetSavedDate(amodified);
-                resource->SetSavedSize(afilesize);
-                resource->SetSavedCRC32(afilecrc);
-            }
-        }
-        QDateTime moddate = QDateTime::fromString(amodified, "yyyy-MM-dd hh:mm:ss");
-        memset(&fileInfo, 0, sizeof(fileInfo));
-        fileInfo.tmz_date.tm_sec  = moddate.time().second();
-        fileInfo.tmz_date.tm_min  = moddate.time().minute();
-        fileInfo.tmz_date.tm_hour = moddate.time().hour();
-        fileInfo.tmz_date.tm_mday = moddate.date().day();
-        fileInfo.tmz_date.tm_mon  = moddate.date().month() - 1;
-        fileInfo.tmz_date.tm_year = moddate.date().year();
-
-        // Add the file entry to the archive.
-        // We should check the uncompressed file size. If it's over >= 0xffffffff the last parameter (zip64) should be 1.
-        if (zipOpenNewFileInZip4_64(zfile, relpath.toUtf8().constData(), &fileInfo, NULL, 0, NULL, 0, NULL, Z_DEFLATED, 8, 0, 15, 8, Z_DEFAULT_STRATEGY, NULL, 0, 0x0b00, 1<<11, 0) != ZIP_OK) {
+    // An epub updated in place still has it.
+    if (!incremental) {
+        if (zipOpenNewFileInZip64(zfile, "mimetype", &fileInfo, NULL, 0, NULL, 0, NULL, Z_NO_COMPRESSION, 0, 0) != ZIP_OK) {
             zipClose(zfile, NULL);
             QFile::remove(tempFile);
-            throw(CannotStoreFile(relpath.toStdString()));
+            throw(CannotStoreFile("mimetype"));
         }
 
-        // the file on disk to write
-        QFile dfile(it.filePath());
-
-        if (!dfile.open(QIODevice::ReadOnly)) {
+        if (zipWriteInFileInZip(zfile, EPUB_MIME_DATA, (unsigned int)strlen(EPUB_MIME_DATA)) != ZIP_OK) {
             zipCloseFileInZip(zfile);
             zipClose(zfile, NULL);
             QFile::remove(tempFile);
-            throw(CannotOpenFile(it.fileName().toStdString()));
+            throw(CannotStoreFile("mimetype"));
+        }
+
+        zipCloseFileInZip(zfile);
+    }
+
+    // Workers compress a batch of files into memory while this thread
+    // appends each one as soon as it and those before it are done.
+    const SourceArchive *reusable = profile.reuse_entries ? source.data() : NULL;
+    int next = 0;
+    while (next < files.count()) {
+        QList<ExportEntry> batch;
+        qint64 batch_size = 0;
+        while ((next < files.count()) &&
+               (batch.isEmpty() || (batch_size + qMin(files.at(next).size, MAX_IN_MEMORY_ENTRY) <= MAX_BATCH_SIZE))) {
+            batch_size += qMin(files.at(next).size, MAX_IN_MEMORY_ENTRY);
+            batch << files.at(next++);
         }
+        QFuture<ExportEntry> compressed = QtConcurrent::mapped(batch, std::bind(CompressEntry, std::placeholders::_1, reusable));
 
-        // Write the data from the file on disk into the archive.
-        char buff[BUFF_SIZE] = {0};
-        qint64 read = 0;
+        for (int i = 0; i < batch.count(); ++i) {
+            ExportEntry entry = compressed.resultAt(i);
 
-        while ((read = dfile.read(buff, BUFF_SIZE)) > 0) {
-            if (zipWriteInFileInZip(zfile, buff, read) != ZIP_OK) {
-                dfile.close();
-                zipCloseFileInZip(zfile);
+            if (!entry.ok) {
+                compressed.waitForFinished();
                 zipClose(zfile, NULL);
                 QFile::remove(tempFile);
-                throw(CannotStoreFile(relpath.toStdString()));
+                throw(CannotOpenFile(QFileInfo(entry.file_path).fileName().toStdString()));
             }
-        }
 
-        dfile.close();
-
-        // There was an error reading the file on disk.
-        if (read < 0) {
-            zipCloseFileInZip(zfile);
-            zipClose(zfile, NULL);
-            QFile::remove(tempFile);
-            throw(CannotStoreFile(relpath.toStdString()));
-        }
+            // Set the proper zip file info if possible
+            QString amodified = modified_now;
+            size_t afilesize = entry.size;
+            QString afilecrc = entry.crc;
+            Resource* resource = m_Book->GetFolderKeeper()->GetResourceByBookPathNoThrow(entry.relpath);
+            if (resource) {
+                QString savedcrc  = resource->GetSavedCRC32();
+                QString saveddate = resource->GetSavedDate();
+                size_t savedsize = resource->GetSavedSize();
+                if ( (savedsize == afilesize) && (savedcrc == afilecrc) ) {
+                    amodified = saveddate;
+                } else {
+                    resource->SetSavedDate(amodified);
+                    resource->SetSavedSize(afilesize);
+                    resource->SetSavedCRC32(afilecrc);
+                }
+            }
+            QDateTime moddate = QDateTime::fromString(amodified, "yyyy-MM-dd hh:mm:ss");
+            memset(&fileInfo, 0, sizeof(fileInfo));
+            fileInfo.tmz_date.tm_sec  = moddate.time().second();
+            fileInfo.tmz_date.tm_min  = moddate.time().minute();
+            fileInfo.tmz_date.tm_hour = moddate.time().hour();
+            fileInfo.tmz_date.tm_mday = moddate.date().day();
+            fileInfo.tmz_date.tm_mon  = moddate.date().month() - 1;
+            fileInfo.tmz_date.tm_year = moddate.date().year();
 
-        if (zipCloseFileInZip(zfile) != ZIP_OK) {
-            zipClose(zfile, NULL);
-            QFile::remove(tempFile);
-            throw(CannotStoreFile(relpath.toStdString()));
+            if (!WriteEntry(zfile, entry, &fileInfo, source.data())) {
+                compressed.waitForFinished();
+                zipClose(zfile, NULL);
+                QFile::remove(tempFile);
+                throw(CannotStoreFile(entry.relpath.toStdString()));
+            }
         }
     }
 
     zipClose(zfile, NULL);
+    // let go of the old epub before it is overwritten
+    source.reset();
+    if (incremental) {
+        return;
+    }
     // Overwrite the contents of the real file with the contents from the temp
     // file we saved the data do. We do this instead of simply copying the file
     // because a file copy will lose extended attributes such as labels on OS X.
@@ -296,24 +895,23 @@ void ExportEPUB::SaveFolderAsEpubToLocation(const QString &fullfolderpath, const
 }
 
 
-void ExportEPUB::CreateEncryptionXML(const QString &fullfolderpath)
+QByteArray ExportEPUB::CreateEncryptionXML()
 {
-    QTemporaryFile file;
+    QByteArray xml;
+    QBuffer buffer(&xml);
 
-    if (!file.open()) {
-    std::string msg = file.fileName().toStdString() + ": " + file.errorString().toStdString();
-        throw (CannotOpenFile(msg));
+    if (!buffer.open(QIODevice::WriteOnly)) {
+        throw (CannotOpenFile(ENCRYPTION_XML_FILE_NAME.toStdString()));
     }
 
-    EncryptionXmlWriter enc(m_Book.data(), file);
+    EncryptionXmlWriter enc(m_Book.data(), buffer);
     enc.WriteXML();
-    // Write to disk immediately
-    file.flush();
-    QFile::copy(file.fileName(), fullfolderpath + "/" + ENCRYPTION_XML_FILE_NAME);
+    buffer.close();
+    return xml;
 }
 
 
-void ExportEPUB::ObfuscateFonts(const QString &fullfolderpath)
+void ExportEPUB::ObfuscateFonts(QHash<QString, QByteArray> &generated)
 {
     QString uuid_id = m_Book->GetOPF()->GetUUIDIdentifierValue();
     QString main_id = m_Book->GetPublicationIdentifier();
@@ -325,12 +923,124 @@ void ExportEPUB::ObfuscateFonts(const QString &fullfolderpath)
             continue;
         }
 
-        QString font_path = fullfolderpath + "/" + font_resource->GetRelativePath();
+        QString relpath = font_resource->GetRelativePath();
+        QByteArray contents = generated.value(relpath);
+        if (!generated.contains(relpath)) {
+            QFile file(font_resource->GetFullPath());
+            if (!file.open(QIODevice::ReadOnly)) {
+                throw(CannotOpenFile(font_resource->GetFullPath().toStdString()));
+            }
+            contents = file.readAll();
+        }
 
         if (algorithm == ADOBE_FONT_ALGO_ID) {
-            FontObfuscation::ObfuscateFile(font_path, algorithm, uuid_id);
+            FontObfuscation::ObfuscateData(contents, algorithm, uuid_id);
         } else {
-            FontObfuscation::ObfuscateFile(font_path, algorithm, main_id);
+            FontObfuscation::ObfuscateData(contents, algorithm, main_id);
+        }
+        generated.insert(relpath, contents);
+    }
+}
+
+
+void ExportEPUB::SubsetFonts(QHash<QString, QByteArray> &generated)
+{
+    QStringList font_paths;
+    QStringList font_relpaths;
+    QList<FontResource *> font_resources = m_Book->GetFolderKeeper()->GetResourceTypeList<FontResource>();
+    foreach(FontResource *font_resource, font_resources) {
+        font_paths.append(font_resource->GetFullPath());
+        font_relpaths.append(font_resource->GetRelativePath());
+    }
+    if (font_paths.isEmpty()) {
+        return;
+    }
+    // a font that can not be subset is left as it is
+    QList<QByteArray> subsets = QtConcurrent::blockingMapped<QList<QByteArray>>(font_paths,
+                                    std::bind(SubsetFontFile, std::placeholders::_1, GetUsedCodePoints()));
+    for (int i = 0; i < subsets.count(); ++i) {
+        if (!subsets.at(i).isEmpty()) {
+            generated.insert(font_relpaths.at(i), subsets.at(i));
+        }
+    }
+}
+
+
+void ExportEPUB::OptimizeImages(QHash<QString, QByteArray> &generated, const QString &profile)
+{
+    SettingsStore ss;
+    int jpeg_quality = -1;
+    qint64 max_pixels = 0;
+    if (profile == "lossy") {
+        jpeg_quality = ss.imageJpegQuality();
+        max_pixels = ss.imageMaxPixels();
+    }
+
+    QStringList image_paths;
+    QStringList image_relpaths;
+    QList<ImageResource *> image_resources = m_Book->GetFolderKeeper()->GetResourceTypeList<ImageResource>();
+    foreach(ImageResource *image_resource, image_resources) {
+        image_paths.append(image_resource->GetFullPath());
+        image_relpaths.append(image_resource->GetRelativePath());
+    }
+    if (image_paths.isEmpty()) {
+        return;
+    }
+    // an image that can not be made smaller is left as it is
+    QList<QByteArray> optimized = QtConcurrent::blockingMapped<QList<QByteArray>>(image_paths,
+                                      std::bind(ImageOptimizer::OptimizeFile, std::placeholders::_1, jpeg_quality, max_pixels));
+    for (int i = 0; i < optimized.count(); ++i) {
+        if (!optimized.at(i).isEmpty()) {
+            generated.insert(image_relpaths.at(i), optimized.at(i));
+        }
+    }
+}
+
+
+QSet<uint> ExportEPUB::GetUsedCodePoints()
+{
+    // The text of the html bodies with every entity resolved
+    QSet<uint> codepoints;
+    foreach(uint c, m_Book->GetCharactersInHTMLFiles()) {
+        codepoints.insert(c);
+    }
+
+    // Along with every character of the sources, which takes in the content
+    // of generated text in stylesheets and text in svg images.  Markup only
+    // adds ascii which the bodies nearly always use already.
+    QList<TextResource *> text_resources;
+    foreach(HTMLResource *resource, m_Book->GetFolderKeeper()->GetResourceTypeList<HTMLResource>()) {
+        text_resources.append(resource);
+    }
+    foreach(CSSResource *resource, m_Book->GetFolderKeeper()->GetResourceTypeList<CSSResource>()) {
+        text_resources.append(resource);
+    }
+    foreach(SVGResource *resource, m_Book->GetFolderKeeper()->GetResourceTypeList<SVGResource>()) {
+        text_resources.append(resource);
+    }
+    foreach(TextResource *resource, text_resources) {
+        QString text;
+        {
+            QReadLocker locker(&resource->GetLock());
+            text = resource->GetText();
+        }
+        foreach(uint c, text.toUcs4()) {
+            codepoints.insert(c);
+        }
+        // css escapes such as content: "\201C"
+        if (resource->Type() == Resource::CSSResourceType) {
+            int pos = text.indexOf('\\');
+            while (pos >= 0) {
+                int end = pos + 1;
+                while ((end < text.length()) && (end - pos <= 6) && IsHexDigit(text.at(end))) {
+                    end++;
+                }
+                if (end > pos + 1) {
+                    codepoints.insert(text.mid(pos + 1, end - pos - 1).toUInt(NULL, 16));
+                }
+                pos = text.indexOf('\\', end);
+            }
         }
     }
+    return codepoints;
 }
@@ -45,24 +45,48 @@ public:
     // specified in the constructor
     virtual void WriteBook();
 
+    // The names of the compression profiles a book can be saved with:
+    // "fast" stores images, fonts and media that are compressed already
+    // and deflates the rest at level 1, "balanced" is the default and
+    // "archival" deflates everything at the highest level
+    static QStringList CompressionProfiles();
+
+    // The names of the image optimization profiles: "none" leaves the
+    // images as they are, "lossless" writes PNGs again at the highest
+    // zlib level and "lossy" also encodes JPEGs again at the quality
+    // asked for and scales down images with too many pixels
+    static QStringList ImageOptimizationProfiles();
+
 private:
 
-    // Creates the publication from the Book
-    // (creates XHTML, CSS, OPF, NCX files etc.)
-    void virtual CreatePublication(const QString &fullfolderpath);
+    // Returns the files of the publication whose contents differ
+    // from the book folder, by book path: the subset and obfuscated
+    // fonts and encryption.xml.  Nothing else is copied.
+    QHash<QString, QByteArray> CreatePublication();
 
     // Saves the publication in the specified folder
-    // to the specified file path as an epub;
-    // the second optional parameter specifies the
-    // mimetype to write to the special "mimetype" file
-    void SaveFolderAsEpubToLocation(const QString &fullfolderpath, const QString &fullfilepath);
+    // to the specified file path as an epub,
+    // the files in generated are written from memory
+    void SaveFolderAsEpubToLocation(const QString &fullfolderpath, const QString &fullfilepath,
+                                    const QHash<QString, QByteArray> &generated);
+
+    // Returns the publication's encryption.xml file,
+    // for the fonts to obfuscate
+    QByteArray CreateEncryptionXML();
+
+    // Obfuscates the fonts marked for obfuscation into generated
+    void ObfuscateFonts(QHash<QString, QByteArray> &generated);
+
+    // Drops the glyphs of the characters no text uses from
+    // the fonts into generated, one font per thread
+    void SubsetFonts(QHash<QString, QByteArray> &generated);
 
-    // Creates the publication's encryption.xml file,
-    // if there are any fonts to obfuscate
-    void CreateEncryptionXML(const QString &fullfolderpath);
+    // Makes the PNG and JPEG images smaller into generated,
+    // one image per thread
+    void OptimizeImages(QHash<QString, QByteArray> &generated, const QString &profile);
 
-    // Obfuscates the fonts marked for obfuscation
-    void ObfuscateFonts(const QString &fullfolderpath);
+    // The characters the text of the book could show
+    QSet<uint> GetUsedCodePoints();
 
     ///////////////////////////////
     // PROTECTED MEMBER VARIABLES
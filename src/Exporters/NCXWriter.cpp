@@ -68,6 +68,12 @@ void NCXWriter::WriteXMLFromHeadings()
 }
 
 
+void NCXWriter::SetPageList(const QList<NavPageListEntry> &pagelist)
+{
+    m_PageList = pagelist;
+}
+
+
 void NCXWriter::WriteXML()
 {
     m_Writer->writeStartDocument();
@@ -81,6 +87,11 @@ void NCXWriter::WriteXML()
     WriteHead();
     WriteDocTitle();
     WriteNavMap();
+    if (!m_PageList.isEmpty()) {
+        // the fallback navPoint takes a play order as well
+        int nav_points = m_TOCRootEntry.children.isEmpty() ? 1 : GetTOCCount(m_TOCRootEntry);
+        WritePageList(nav_points + 1);
+    }
     m_Writer->writeEndElement();
     m_Writer->writeEndDocument();
 }
@@ -97,10 +108,10 @@ void NCXWriter::WriteHead()
     m_Writer->writeAttribute("content", QString::number(GetTOCDepth()));
     m_Writer->writeEmptyElement("meta");
     m_Writer->writeAttribute("name", "dtb:totalPageCount");
-    m_Writer->writeAttribute("content", "0");
+    m_Writer->writeAttribute("content", QString::number(m_PageList.count()));
     m_Writer->writeEmptyElement("meta");
     m_Writer->writeAttribute("name", "dtb:maxPageNumber");
-    m_Writer->writeAttribute("content", "0");
+    m_Writer->writeAttribute("content", QString::number(m_PageList.count()));
     m_Writer->writeEndElement();
 }
 
@@ -144,6 +155,33 @@ void NCXWriter::WriteNavMap()
 }
 
 
+void NCXWriter::WritePageList(int play_order)
+{
+    m_Writer->writeStartElement("pageList");
+    foreach(const NavPageListEntry &page, m_PageList) {
+        m_Writer->writeStartElement("pageTarget");
+        m_Writer->writeAttribute("id", QString("navPoint-%1").arg(play_order));
+        m_Writer->writeAttribute("playOrder", QString("%1").arg(play_order));
+        m_Writer->writeAttribute("type", "normal");
+        // the value must be a number, page names like xiv are left without one
+        QString pagename = page.pagename.simplified();
+        bool is_number = false;
+        int value = pagename.toInt(&is_number);
+        if (is_number && (value > 0)) {
+            m_Writer->writeAttribute("value", QString::number(value));
+        }
+        play_order++;
+        m_Writer->writeStartElement("navLabel");
+        m_Writer->writeTextElement("text", pagename);
+        m_Writer->writeEndElement();
+        m_Writer->writeEmptyElement("content");
+        m_Writer->writeAttribute("src", ConvertBookPathToNCXRelative(page.href));
+        m_Writer->writeEndElement();
+    }
+    m_Writer->writeEndElement();
+}
+
+
 void NCXWriter::WriteFallbackNavPoint()
 {
     m_Writer->writeStartElement("navPoint");
@@ -220,6 +258,16 @@ void NCXWriter::WriteNavPoint(const TOCModel::TOCEntry &entry, int &play_order)
 }
 
 
+int NCXWriter::GetTOCCount(const TOCModel::TOCEntry &entry) const
+{
+    int count = 0;
+    foreach(const TOCModel::TOCEntry &child, entry.children) {
+        count += 1 + GetTOCCount(child);
+    }
+    return count;
+}
+
+
 int NCXWriter::GetTOCDepth() const
 {
     int max_depth = 0;
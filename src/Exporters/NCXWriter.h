@@ -27,6 +27,7 @@
 #include "BookManipulation/Headings.h"
 #include "Exporters/XMLWriter.h"
 #include "MainUI/TOCModel.h"
+#include "ResourceObjects/NavProcessor.h"
 
 class Resource;
 
@@ -52,6 +53,13 @@ public:
 
     void WriteXMLFromHeadings();
 
+    /**
+     * Sets the pages written to the <pageList> element, their
+     * hrefs must be URLEncoded book paths.  No <pageList> is
+     * written when there are none.
+     */
+    void SetPageList(const QList<NavPageListEntry> &pagelist);
+
 private:
 
     /**
@@ -69,6 +77,12 @@ private:
      */
     void WriteNavMap();
 
+    /**
+     * Writes the <pageList> element, its play order
+     * continues on from that of the <navMap>.
+     */
+    void WritePageList(int play_order);
+
     /**
      * Writes a fallback <navPoint> for when the book has no headings.
      */
@@ -82,6 +96,11 @@ private:
      */
     void WriteNavPoint(const TOCModel::TOCEntry &entry , int &play_order);
 
+    /**
+     * Returns how many <navPoint>s the TOC tree needs.
+     */
+    int GetTOCCount(const TOCModel::TOCEntry &entry) const;
+
     /**
      * Returns the depth of the TOC tree
      *
@@ -116,6 +135,8 @@ private:
 
     TOCModel::TOCEntry m_TOCRootEntry;
 
+    QList<NavPageListEntry> m_PageList;
+
     QString m_version;
     const Resource * m_ncxresource;
 };
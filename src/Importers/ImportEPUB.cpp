@@ -30,6 +30,7 @@
 #include "iowin32.h"
 #endif
 
+#include <algorithm>
 #include <string>
 
 #include <QApplication>
@@ -58,7 +59,9 @@
 #include "Misc/MediaTypes.h"
 #include "Misc/FontObfuscation.h"
 #include "Misc/HTMLEncodingResolver.h"
+#include "Misc/MappedZipArchive.h"
 #include "Misc/SettingsStore.h"
+#include "Misc/Trace.h"
 #include "Misc/Utility.h"
 #include "ResourceObjects/CSSResource.h"
 #include "ResourceObjects/HTMLResource.h"
@@ -113,13 +116,17 @@ QSharedPointer<Book> ImportEPUB::GetBook(bool extract_metadata)
 {
     QList<HTMLResource *> non_well_formed;
     SettingsStore ss;
+    TRACE_SPAN(span, "ImportEPUB::GetBook");
 
     if (!Utility::IsFileReadable(m_FullFilePath)) {
         throw (EPUBLoadParseError(QString(QObject::tr("Cannot read EPUB: %1")).arg(QDir::toNativeSeparators(m_FullFilePath)).toStdString()));
     }
 
     // These read the EPUB file
-    ExtractContainer();
+    {
+        TRACE_SPAN(phase, "ImportEPUB::ExtractContainer");
+        ExtractContainer();
+    }
 
     QHash<QString, QString> encrypted_files = ParseEncryptionXml();
 
@@ -127,18 +134,28 @@ QSharedPointer<Book> ImportEPUB::GetBook(bool extract_metadata)
         throw (FileEncryptedWithDrm(""));
     }
 
-    QApplication::setOverrideCursor(Qt::WaitCursor);
+    // books are also loaded off the GUI thread in batch mode
+    bool show_busy = Utility::IsGUIThread();
+    if (show_busy) {
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+    }
 
     LocateOPF();
     m_opfDir = QFileInfo(m_OPFFilePath).dir();
     // These mutate the m_Book object
-    ReadOPF();
+    {
+        TRACE_SPAN(phase, "ImportEPUB::ReadOPF");
+        ReadOPF();
+    }
     AddObfuscatedButUndeclaredFonts(encrypted_files);
     AddNonStandardAppleXML();
 
     m_Book->GetFolderKeeper()->SetGroupFolders(m_ManifestFilePaths, m_ManifestMediaTypes);
 
-    LoadInfrastructureFiles();
+    {
+        TRACE_SPAN(phase, "ImportEPUB::LoadInfrastructureFiles");
+        LoadInfrastructureFiles();
+    }
 
     // Check for files missing in the Manifest and create warning
     QStringList notInManifest;
@@ -158,7 +175,10 @@ QSharedPointer<Book> ImportEPUB::GetBook(bool extract_metadata)
         AddLoadWarning(warning);
     }
 
-    LoadFolderStructure();
+    {
+        TRACE_SPAN(phase, "ImportEPUB::LoadFolderStructure");
+        LoadFolderStructure();
+    }
 
     const QList<Resource *> resources = m_Book->GetFolderKeeper()->GetResourceList();
 
@@ -177,12 +197,16 @@ QSharedPointer<Book> ImportEPUB::GetBook(bool extract_metadata)
     bool autofix = ((ss.cleanOn() & CLEANON_OPEN) == CLEANON_OPEN);
     bool checkit = true;
 
-    QFuture<std::pair<HTMLResource*, bool> > html_future;
-    html_future = QtConcurrent::mapped(hresources, std::bind(InitialLoadAndCheckOneHTMLFile, std::placeholders::_1, checkit));
-    for (int i = 0; i < html_future.results().count(); i++) {
-        std::pair<HTMLResource*, bool> res = html_future.resultAt(i);
-        if (!res.second) {
-            non_well_formed.append(res.first);
+    {
+        TRACE_SPAN(phase, "ImportEPUB::CheckWellFormed");
+        TRACE_ARG(phase, "files", hresources.count());
+        QFuture<std::pair<HTMLResource*, bool> > html_future;
+        html_future = QtConcurrent::mapped(hresources, std::bind(InitialLoadAndCheckOneHTMLFile, std::placeholders::_1, checkit, m_PreloadedHTML));
+        for (int i = 0; i < html_future.results().count(); i++) {
+            std::pair<HTMLResource*, bool> res = html_future.resultAt(i);
+            if (!res.second) {
+                non_well_formed.append(res.first);
+            }
         }
     }
     if (!non_well_formed.isEmpty()) {
@@ -210,7 +234,10 @@ QSharedPointer<Book> ImportEPUB::GetBook(bool extract_metadata)
         }
     }
 
-    ProcessFontFiles(resources, encrypted_files);
+    {
+        TRACE_SPAN(phase, "ImportEPUB::ProcessFontFiles");
+        ProcessFontFiles(resources, encrypted_files);
+    }
 
     if (m_PackageVersion.startsWith('3')) {
         HTMLResource * nav_resource = NULL;
@@ -263,11 +290,17 @@ QSharedPointer<Book> ImportEPUB::GetBook(bool extract_metadata)
 
     // since we no longer run universal updates we should run 
     // InitialLoad on all TextResources to make sure everything gets loaded
-    m_Book->GetFolderKeeper()->PerformInitialLoads();
+    {
+        TRACE_SPAN(phase, "ImportEPUB::PerformInitialLoads");
+        m_Book->GetFolderKeeper()->PerformInitialLoads();
+    }
+    TRACE_ARG(span, "resources", resources.count());
 
     // If we have modified the book to add spine attribute, manifest item or NCX mark as changed.
     m_Book->SetModified(GetLoadWarnings().count() > 0);
-    QApplication::restoreOverrideCursor();
+    if (show_busy) {
+        QApplication::restoreOverrideCursor();
+    }
     return m_Book;
 }
 
@@ -415,18 +448,25 @@ void ImportEPUB::ExtractContainer()
     if (!cp437) {
         cp437 = new QStringDecoder("IBM437");
     }
-#ifdef Q_OS_WIN32
-    zlib_filefunc64_def ffunc;
-    fill_win32_filefunc64W(&ffunc);
-    unzFile zfile = unzOpen2_64(Utility::QStringToStdWString(QDir::toNativeSeparators(m_FullFilePath)).c_str(), &ffunc);
-#else
-    unzFile zfile = unzOpen64(QDir::toNativeSeparators(m_FullFilePath).toUtf8().constData());
-#endif
+    MappedZipArchive archive(m_FullFilePath);
+    unzFile zfile = archive.Open();
 
     if (zfile == NULL) {
         throw (EPUBLoadParseError(QString(QObject::tr("Cannot unzip EPUB: %1")).arg(QDir::toNativeSeparators(m_FullFilePath)).toStdString()));
     }
 
+    // The central directory is read first so that all folders can be
+    // created up front and the entries then inflated in parallel.
+    QList<ZipEntry> entries;
+    QHash<QString, int> entry_for_path;
+    QSet<QString> folders;
+
+    // Audio and video are left in the archive until they are used
+    // or the background extraction gets to them.
+    SettingsStore ss;
+    bool defer_media = ss.deferMediaExtraction();
+    QHash<QString, DeferredFiles::Entry> deferred;
+
     // Note: zip archives can do utf-8 but they do NOT have a standard for Unicode NormalizationForm
     // we will choose to use NFC
     res = unzGoToFirstFile(zfile);
@@ -498,14 +538,10 @@ void ImportEPUB::ExtractContainer()
                 }
 
                 if (evil_or_corrupt_epub) {
-                    unzCloseCurrentFile(zfile);
                     unzClose(zfile);
                     throw (EPUBLoadParseError(QString(QObject::tr("Possible evil or corrupt epub file name: %1")).arg(original_path).toStdString()));
                 }
 
-                // We use the dir object to create the path in the temporary directory.
-                // Unfortunately, we need a dir ojbect to do this as it's not a static function.
-                QDir dir(m_ExtractedFolderPath);
                 // Full file path in the temporary directory.
                 QString file_path = m_ExtractedFolderPath + "/" + qfile_name;
                 QFileInfo qfile_info(file_path);
@@ -514,10 +550,10 @@ void ImportEPUB::ExtractContainer()
 
                 // Is this entry a directory?
                 if (file_info.uncompressed_size == 0 && qfile_name.endsWith('/')) {
-                    dir.mkpath(qfile_name);
+                    folders.insert(m_ExtractedFolderPath + "/" + qfile_name);
                     continue;
                 } else {
-                    if (!qfile_info.path().isEmpty()) dir.mkpath(qfile_info.path());
+                    if (!qfile_info.path().isEmpty()) folders.insert(qfile_info.path());
                     // add it to the list of files found inside the zip
                     if (cp437_file_name.isEmpty()) {
                         m_ZipFilePaths << qfile_name;
@@ -528,63 +564,218 @@ void ImportEPUB::ExtractContainer()
                     }
                 }
 
-                // Open the file entry in the archive for reading.
-                if (unzOpenCurrentFile(zfile) != UNZ_OK) {
-                    unzClose(zfile);
-                    throw (EPUBLoadParseError(QString(QObject::tr("Cannot extract file: %1")).arg(qfile_name).toStdString()));
-                }
-
-                // Open the file on disk to write the entry in the archive to.
-                QFile entry(file_path);
-
-                if (!entry.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-                    unzCloseCurrentFile(zfile);
-                    unzClose(zfile);
-                    throw (EPUBLoadParseError(QString(QObject::tr("Cannot extract file: %1")).arg(qfile_name).toStdString()));
-                }
-
-                // Buffered reading and writing.
-                char buff[BUFF_SIZE] = {0};
-                int read = 0;
-
-                while ((read = unzReadCurrentFile(zfile, buff, BUFF_SIZE)) > 0) {
-                    entry.write(buff, read);
+                ZipEntry entry;
+                unz64_file_pos pos;
+                unzGetFilePos64(zfile, &pos);
+                entry.pos_in_zip_directory = pos.pos_in_zip_directory;
+                entry.num_of_file = pos.num_of_file;
+                entry.name = qfile_name;
+                entry.file_path = file_path;
+                if (!cp437_file_name.isEmpty() && cp437_file_name != qfile_name) {
+                    entry.copy_path = m_ExtractedFolderPath + "/" + cp437_file_name;
                 }
-
-                entry.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner |
-                                     QFileDevice::ReadUser  | QFileDevice::WriteUser  |
-                                     QFileDevice::ReadOther);
-                entry.close();
-
-                // Read errors are marked by a negative read amount.
-                if (read < 0) {
-                    unzCloseCurrentFile(zfile);
-                    unzClose(zfile);
-                    throw (EPUBLoadParseError(QString(QObject::tr("Cannot extract file: %1")).arg(qfile_name).toStdString()));
+                entry.size = file_info.uncompressed_size;
+
+                QString group = MediaTypes::instance()->GetGroupFromMediaType(
+                    MediaTypes::instance()->GetMediaTypeFromExtension(qfile_info.suffix().toLower()));
+                if (defer_media && entry.copy_path.isEmpty() && (group == "Audio" || group == "Video")) {
+                    DeferredFiles::Entry dentry;
+                    dentry.pos_in_zip_directory = entry.pos_in_zip_directory;
+                    dentry.num_of_file = entry.num_of_file;
+                    dentry.file_path = file_path;
+                    deferred[file_path] = dentry;
+                    if (entry_for_path.contains(file_path)) {
+                        // an earlier entry with the same name is of no use now
+                        entries[entry_for_path.take(file_path)].file_path.clear();
+                    }
+                    m_FileInfoFromZip[bookpath] = std::make_tuple(afilesize, afilecrc, modified);
+                    continue;
                 }
+                deferred.remove(file_path);
 
-                // The file was read but the CRC did not match.
-                // We don't check the read file size vs the uncompressed file size
-                // because if they're different there should be a CRC error.
-                if (unzCloseCurrentFile(zfile) == UNZ_CRCERROR) {
-                    unzClose(zfile);
-                    throw (EPUBLoadParseError(QString(QObject::tr("Cannot extract file: %1")).arg(qfile_name).toStdString()));
-                }
-                if (!cp437_file_name.isEmpty() && cp437_file_name != qfile_name) {
-                    QString cp437_file_path = m_ExtractedFolderPath + "/" + cp437_file_name;
-                    QFile::copy(file_path, cp437_file_path);
+                // A name repeated in the archive was overwritten by
+                // its later entries when they were extracted in order
+                if (entry_for_path.contains(file_path)) {
+                    entries[entry_for_path[file_path]] = entry;
+                } else {
+                    entry_for_path[file_path] = entries.count();
+                    entries << entry;
                 }
                 m_FileInfoFromZip[bookpath] = std::make_tuple(afilesize, afilecrc, modified);
             }
         } while ((res = unzGoToNextFile(zfile)) == UNZ_OK);
     }
 
+    unzClose(zfile);
+
     if (res != UNZ_END_OF_LIST_OF_FILE) {
-        unzClose(zfile);
         throw (EPUBLoadParseError(QString(QObject::tr("Cannot open EPUB: %1")).arg(QDir::toNativeSeparators(m_FullFilePath)).toStdString()));
     }
 
+    // Parents sort before their children so each mkpath only
+    // has to create the last level.
+    QStringList folder_list = folders.values();
+    folder_list.sort();
+    QDir dir(m_ExtractedFolderPath);
+    foreach(QString folder, folder_list) {
+        dir.mkpath(folder);
+    }
+
+    // Entries dropped in favour of a later deferred one
+    for (int i = entries.count() - 1; i >= 0; --i) {
+        if (entries.at(i).file_path.isEmpty()) {
+            entries.removeAt(i);
+        }
+    }
+
+    // Empty stand ins so the files can be added to the book as usual
+    foreach(const DeferredFiles::Entry &dentry, deferred) {
+        QFile placeholder(dentry.file_path);
+        if (!placeholder.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            throw (EPUBLoadParseError(QString(QObject::tr("Cannot extract file: %1")).arg(dentry.file_path).toStdString()));
+        }
+        placeholder.close();
+    }
+
+    // The container.xml and OPF go first so the package version is known
+    // and HTML files can be checked while the rest is still inflating.
+    QList<ZipEntry> package_entries;
+    for (int i = entries.count() - 1; i >= 0; --i) {
+        if ((entries.at(i).name == "META-INF/container.xml") || entries.at(i).name.toLower().endsWith(".opf")) {
+            package_entries << entries.takeAt(i);
+        }
+    }
+    QString package_failure = ExtractZipEntries(&archive, package_entries, QString());
+    if (!package_failure.isEmpty()) {
+        throw (EPUBLoadParseError(QString(QObject::tr("Cannot extract file: %1")).arg(package_failure).toStdString()));
+    }
+    QString version = PeekPackageVersion(m_ExtractedFolderPath);
+
+    // Split the entries between the workers by their uncompressed size,
+    // biggest first, each worker opening the archive once for its share.
+    int num_workers = qMax(1, qMin(QThread::idealThreadCount(), entries.count()));
+    std::sort(entries.begin(), entries.end(),
+              [](const ZipEntry &a, const ZipEntry &b) { return a.size > b.size; });
+    QList<QList<ZipEntry>> shares;
+    QList<quint64> share_sizes;
+    for (int i = 0; i < num_workers; ++i) {
+        shares << QList<ZipEntry>();
+        share_sizes << 0;
+    }
+    foreach(const ZipEntry &entry, entries) {
+        int smallest = 0;
+        for (int i = 1; i < num_workers; ++i) {
+            if (share_sizes.at(i) < share_sizes.at(smallest)) {
+                smallest = i;
+            }
+        }
+        shares[smallest] << entry;
+        share_sizes[smallest] += entry.size;
+    }
+
+    const QList<QString> failures = QtConcurrent::blockingMapped(shares, std::bind(&ImportEPUB::ExtractZipEntries, this, &archive, std::placeholders::_1, version));
+    foreach(const QString &failed_name, failures) {
+        if (!failed_name.isEmpty()) {
+            throw (EPUBLoadParseError(QString(QObject::tr("Cannot extract file: %1")).arg(failed_name).toStdString()));
+        }
+    }
+
+    if (!deferred.isEmpty()) {
+        m_Book->GetFolderKeeper()->DeferExtraction(m_FullFilePath, deferred.values());
+    }
+}
+
+
+// Runs in a worker thread.
+QString ImportEPUB::ExtractZipEntries(MappedZipArchive *archive, const QList<ZipEntry> &entries, const QString &version)
+{
+    if (entries.isEmpty()) {
+        return QString();
+    }
+    unzFile zfile = archive->Open();
+    if (zfile == NULL) {
+        return entries.first().name;
+    }
+
+    foreach(const ZipEntry &zentry, entries) {
+        unz64_file_pos pos;
+        pos.pos_in_zip_directory = zentry.pos_in_zip_directory;
+        pos.num_of_file = zentry.num_of_file;
+        if ((unzGoToFilePos64(zfile, &pos) != UNZ_OK) ||
+            !archive->ExtractCurrentFile(zfile, zentry.file_path)) {
+            unzClose(zfile);
+            return zentry.name;
+        }
+        if (!zentry.copy_path.isEmpty()) {
+            QFile::copy(zentry.file_path, zentry.copy_path);
+        }
+        if (!version.isEmpty()) {
+            QString suffix = QFileInfo(zentry.name).suffix().toLower();
+            if ((suffix == "xhtml") || (suffix == "html") || (suffix == "htm")) {
+                QString path = zentry.copy_path.isEmpty() ? zentry.file_path : zentry.copy_path;
+                QMutexLocker locker(&m_PreloadMutex);
+                m_PreloadedHTML.insert(path, QtConcurrent::run(PreloadHTMLFile, path, version));
+            }
+        }
+    }
     unzClose(zfile);
+    return QString();
+}
+
+
+QString ImportEPUB::PeekPackageVersion(const QString &folder)
+{
+    QString opf_path;
+    QFile container_file(folder + "/META-INF/container.xml");
+    if (!container_file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    QXmlStreamReader container(&container_file);
+    while (!container.atEnd() && opf_path.isEmpty()) {
+        container.readNext();
+        if (container.isStartElement() && container.name().compare(QLatin1String("rootfile")) == 0 &&
+            container.attributes().value("", "media-type") == OEBPS_MIMETYPE) {
+            opf_path = folder + "/" + container.attributes().value("", "full-path").toString();
+        }
+    }
+    container_file.close();
+
+    QFile opf_file(opf_path);
+    if (opf_path.isEmpty() || !opf_file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    QXmlStreamReader opf(&opf_file);
+    while (!opf.atEnd()) {
+        opf.readNext();
+        if (opf.isStartElement()) {
+            // the package is the root element
+            if (opf.name().compare(QLatin1String("package")) != 0) {
+                return QString();
+            }
+            QString version = opf.attributes().value("", "version").toString();
+            if (version == "1.0") version = "2.0";
+            return version;
+        }
+    }
+    return QString();
+}
+
+
+// Runs in a worker thread.
+ImportEPUB::PreloadedHTML ImportEPUB::PreloadHTMLFile(const QString &fullfilepath, const QString &version)
+{
+    PreloadedHTML preload;
+    preload.version = version;
+    preload.loaded = true;
+    preload.well_formed = false;
+    try {
+        preload.text = HTMLEncodingResolver::ReadHTMLFile(fullfilepath);
+    } catch (...) {
+        preload.loaded = false;
+        return preload;
+    }
+    preload.well_formed = IsHTMLTextWellFormed(preload.text, version);
+    return preload;
 }
 
 void ImportEPUB::LocateOPF()
@@ -1091,7 +1282,8 @@ QString ImportEPUB::PrepareOPFForReading(const QString &source)
 }
 
 
-std::pair<HTMLResource*, bool> ImportEPUB::InitialLoadAndCheckOneHTMLFile(HTMLResource *hresource, bool checkit)
+std::pair<HTMLResource*, bool> ImportEPUB::InitialLoadAndCheckOneHTMLFile(HTMLResource *hresource, bool checkit,
+                                                                          const QHash<QString, QFuture<PreloadedHTML>> &preloaded)
 {
     std::pair<HTMLResource*, bool> res;
     res.first = hresource;
@@ -1099,9 +1291,23 @@ std::pair<HTMLResource*, bool> ImportEPUB::InitialLoadAndCheckOneHTMLFile(HTMLRe
 
     QString version = hresource->GetEpubVersion();
 
+    // Use the text read while the epub was extracted if there is any,
+    // a preload that has not started yet is run right here.
+    QString fullpath = hresource->GetFullPath();
+    if (preloaded.contains(fullpath)) {
+        PreloadedHTML preload = preloaded.value(fullpath).result();
+        if (preload.loaded) {
+            hresource->SetText(preload.text);
+            if (checkit) {
+                res.second = (preload.version == version) ? preload.well_formed : IsHTMLTextWellFormed(preload.text, version);
+            }
+            return res;
+        }
+    }
+
     try {
         // Load the initial content into the HTMLResource
-        hresource->SetText(HTMLEncodingResolver::ReadHTMLFile(hresource->GetFullPath()));
+        hresource->SetText(HTMLEncodingResolver::ReadHTMLFile(fullpath));
     } catch (...) {
         if (checkit) {
             res.second = false;
@@ -1109,27 +1315,30 @@ std::pair<HTMLResource*, bool> ImportEPUB::InitialLoadAndCheckOneHTMLFile(HTMLRe
         }
     }
     if (checkit) {
-        if (!XhtmlDoc::IsDataWellFormed(hresource->GetText(),version)) {
-            res.second = false;
-            return res;
-        } else {
-            QString txt = hresource->GetText();
-            // had cases of very large files with no line breaks
-            // so mark them as not well formed
-            if (txt.size() > 307200) {
-                int lines = 0;
-                QChar *uc = txt.data();
-                QChar *e = uc + txt.size();
-                while((uc != e) && (lines < 5)) {
-                    if (uc->unicode() == 0x000A) lines++;
-                    ++uc;
-                }
-                if (lines < 5) {
-                    res.second = false;
-                    return res;
-                };
-            }
-        }
+        res.second = IsHTMLTextWellFormed(hresource->GetText(), version);
     }
     return res;
 }
+
+
+bool ImportEPUB::IsHTMLTextWellFormed(const QString &text, const QString &version)
+{
+    if (!XhtmlDoc::IsDataWellFormed(text, version)) {
+        return false;
+    }
+    // had cases of very large files with no line breaks
+    // so mark them as not well formed
+    if (text.size() > 307200) {
+        int lines = 0;
+        const QChar *uc = text.constData();
+        const QChar *e = uc + text.size();
+        while((uc != e) && (lines < 5)) {
+            if (uc->unicode() == 0x000A) lines++;
+            ++uc;
+        }
+        if (lines < 5) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -26,7 +26,9 @@
 #define IMPORTEPUB_H
 
 #include <QCoreApplication>
+#include <QFuture>
 #include <QHash>
+#include <QMutex>
 #include <QSet>
 #include <QStringList>
 #include <tuple>
@@ -36,6 +38,7 @@
 
 class HTMLResource;
 class CSSResource;
+class MappedZipArchive;
 class QXmlStreamReader;
 
 class ImportEPUB : public Importer
@@ -58,6 +61,48 @@ private:
      */
     void ExtractContainer();
 
+    /**
+     * One file in the archive, located by its position
+     * in the zip central directory.
+     */
+    struct ZipEntry {
+        quint64 pos_in_zip_directory;
+        quint64 num_of_file;
+        QString name;
+        QString file_path;
+        QString copy_path;
+        quint64 size;
+    };
+
+    /**
+     * An HTML file read and checked as soon as it was extracted,
+     * before the OPF says which files are the book's XHTML.
+     */
+    struct PreloadedHTML {
+        QString text;
+        QString version;
+        bool loaded;
+        bool well_formed;
+    };
+
+    /**
+     * Inflates the entries using a handle of its own on the archive.
+     * When version is known each HTML file extracted is queued to
+     * be preloaded right away.
+     *
+     * @return The name of the entry that could not be extracted,
+     *         or an empty string if they all were.
+     */
+    QString ExtractZipEntries(MappedZipArchive *archive, const QList<ZipEntry> &entries, const QString &version);
+
+    /**
+     * Reads the package version from the OPF named in the extracted
+     * container.xml, an empty string if it can not be found.
+     */
+    static QString PeekPackageVersion(const QString &folder);
+
+    static PreloadedHTML PreloadHTMLFile(const QString &fullfilepath, const QString &version);
+
     /**
      * Locates the OPF file in the extracted folder.
      * The path to the OPF is then stored in m_OPFFilePath.
@@ -163,7 +208,10 @@ private:
     void ProcessFontFiles(const QList<Resource *> &resources,
                           const QHash<QString, QString> &encrypted_files);
 
-    static std::pair<HTMLResource*, bool> InitialLoadAndCheckOneHTMLFile(HTMLResource *hresource, bool checkit);
+    static std::pair<HTMLResource*, bool> InitialLoadAndCheckOneHTMLFile(HTMLResource *hresource, bool checkit,
+                                                                         const QHash<QString, QFuture<PreloadedHTML>> &preloaded);
+
+    static bool IsHTMLTextWellFormed(const QString &text, const QString &version);
 
     /**
      * The main temp folder where files are stored.
@@ -239,6 +287,12 @@ private:
 
     QHash<QString, std::tuple<size_t, QString, QString> > m_FileInfoFromZip;
 
+    /**
+     * The HTML files being preloaded, by their full path.
+     */
+    QHash<QString, QFuture<PreloadedHTML>> m_PreloadedHTML;
+    QMutex m_PreloadMutex;
+
     bool m_HasSpineItems;
     bool m_NCXNotInManifest;
     QString m_NCXId;
@@ -24,6 +24,7 @@
 #include <functional>
 
 #include <QtCore>
+#include <QCryptographicHash>
 #include <QDir>
 #include <QFileInfo>
 #include <QFutureSynchronizer>
@@ -251,95 +252,116 @@ void ImportHTML::UpdateFiles(HTMLResource *html_resource,
 // as the files get a new name, the references are updated
 QHash<QString, QString> ImportHTML::LoadFolderStructure(const QString &source)
 {
-    QStringList mediapaths = XhtmlDoc::GetPathsToMediaFiles(source);
-    QStringList stylepaths = XhtmlDoc::GetPathsToStyleFiles(source);
-    QFutureSynchronizer<QHash<QString, QString>> sync;
-    sync.addFuture(QtConcurrent::run(&ImportHTML::LoadMediaFiles, this,  mediapaths));
-    sync.addFuture(QtConcurrent::run(&ImportHTML::LoadStyleFiles, this,  stylepaths));
-    sync.waitForFinished();
-    QList<QFuture<QHash<QString, QString>>> futures = sync.futures();
-    int num_futures = futures.count();
-    QHash<QString, QString> updates;
-
-    for (int i = 0; i < num_futures; ++i) {
-        updates.insert(futures.at(i).result());
-    }
-
-    return updates;
+    QStringList file_paths = XhtmlDoc::GetPathsToMediaFiles(source);
+    file_paths.append(XhtmlDoc::GetPathsToStyleFiles(source));
+    return LoadFiles(file_paths);
 }
 
 
-// note file_paths here are hrefs to media files from the html file being imported 
-// that should be imported as well
+// note file_paths here are hrefs to media and style files from the
+// html file being imported that should be imported as well
 
-QHash<QString, QString> ImportHTML::LoadMediaFiles(const QStringList & file_paths)
+QHash<QString, QString> ImportHTML::LoadFiles(const QStringList & file_paths)
 {
     QHash<QString, QString> updates;
     QFileInfo hinfo = QFileInfo(m_FullFilePath);
     QDir folder(hinfo.absoluteDir());
-    // Load the media files (images, video, audio) into the book and
-    // update all references with new urls
-    foreach(QString file_path, file_paths) {
-        try {
-            QString filename = QFileInfo(file_path).fileName();
-            QString fullfilepath  = QFileInfo(folder, file_path).absoluteFilePath();
-            QString newpath;
-            QString existing_book_path = m_Book->GetFolderKeeper()->GetBookPathByPathEnd(filename);
-
-            if (m_IgnoreDuplicates && !existing_book_path.isEmpty()) {
-                newpath = newpath = existing_book_path;
-            } else {
-                Resource * resource = m_Book->GetFolderKeeper()->AddContentFileToFolder(fullfilepath);
-                newpath = resource->GetRelativePath();
-                m_AddedBookPaths << newpath;
-            }
 
-            updates[ fullfilepath ] = newpath;
-        } catch (FileDoesNotExist&) {
+    QStringList fullfilepaths;
+    QSet<QString> seen;
+    foreach(QString file_path, file_paths) {
+        QString fullfilepath  = QFileInfo(folder, file_path).absoluteFilePath();
+        if (!QFileInfo(fullfilepath).exists()) {
             // Do not touch link if it is already broken
             QString target_file = hinfo.absolutePath() + "/" + file_path;
             target_file = Utility::resolveRelativeSegmentsInFilePath(target_file, "/");
             updates[target_file] = "";
-            // Do nothing. If the referenced file does not exist,
-            // well then we don't load it.
-            // qDebug() << "broken link ImportHTML" << m_FullFilePath << file_path << target_file;
+            continue;
+        }
+        if (!seen.contains(fullfilepath)) {
+            seen.insert(fullfilepath);
+            fullfilepaths << fullfilepath;
         }
     }
-    return updates;
-}
-
 
-QHash<QString, QString> ImportHTML::LoadStyleFiles(const QStringList & file_paths )
-{
-    QHash<QString, QString> updates;
-    QFileInfo hinfo = QFileInfo(m_FullFilePath);
-    QDir folder(hinfo.absoluteDir());
-    foreach(QString file_path, file_paths) {
-        try {
-            QString filename = QFileInfo(file_path).fileName();
-            QString fullfilepath  = QFileInfo(folder, file_path).absoluteFilePath();
-            QString newpath;
+    // Web pages often use the same image under many paths,
+    // so files are compared by contents and each is stored once
+    QList<QByteArray> hashes = QtConcurrent::blockingMapped<QList<QByteArray>>(fullfilepaths, HashFileContents);
+
+    QStringList to_copy;
+    QHash<QString, QString> stored_as;
+    QHash<QByteArray, QString> first_with_hash;
+    QHash<QString, QString> first_with_name;
+    for (int i = 0; i < fullfilepaths.count(); ++i) {
+        QString fullfilepath = fullfilepaths.at(i);
+        QString filename = QFileInfo(fullfilepath).fileName();
+        if (m_IgnoreDuplicates) {
             QString existing_book_path = m_Book->GetFolderKeeper()->GetBookPathByPathEnd(filename);
-
-            if (m_IgnoreDuplicates && !existing_book_path.isEmpty()) {
-                newpath = existing_book_path;
-            } else {
-                Resource * resource = m_Book->GetFolderKeeper()->AddContentFileToFolder(fullfilepath);
-                newpath = resource->GetRelativePath();
-                m_AddedBookPaths << newpath;
+            if (!existing_book_path.isEmpty()) {
+                updates[ fullfilepath ] = existing_book_path;
+                continue;
+            }
+            if (first_with_name.contains(filename.toCaseFolded())) {
+                stored_as[ fullfilepath ] = first_with_name.value(filename.toCaseFolded());
+                continue;
             }
+        }
+        const QByteArray &hash = hashes.at(i);
+        if (!hash.isEmpty() && first_with_hash.contains(hash)) {
+            stored_as[ fullfilepath ] = first_with_hash.value(hash);
+            continue;
+        }
+        if (!hash.isEmpty()) {
+            first_with_hash[ hash ] = fullfilepath;
+        }
+        first_with_name[ filename.toCaseFolded() ] = fullfilepath;
+        to_copy << fullfilepath;
+    }
 
-            updates[ fullfilepath ] = newpath;
-        } catch (FileDoesNotExist&) {
-            // Do not touch link if it is already broken
-            QString target_file = hinfo.absolutePath() + "/" + file_path;
-            target_file = Utility::resolveRelativeSegmentsInFilePath(target_file, "/");
-            updates[target_file] = "";
-            // Do nothing. If the referenced file does not exist,
-            // well then we don't load it.
-            // qDebug() << "broken link ImportHTML" << m_FullFilePath << file_path << target_file;
+    // Load the files into the book all at once and
+    // update all references with new urls
+    QStringList newpaths = QtConcurrent::blockingMapped(to_copy, std::bind(&ImportHTML::AddFileToBook, this, std::placeholders::_1));
+    for (int i = 0; i < to_copy.count(); ++i) {
+        QString newpath = newpaths.at(i);
+        if (!newpath.isEmpty()) {
+            m_AddedBookPaths << newpath;
         }
+        updates[ to_copy.at(i) ] = newpath;
+    }
+    QHashIterator<QString, QString> same(stored_as);
+    while (same.hasNext()) {
+        same.next();
+        updates[ same.key() ] = updates.value(same.value());
     }
 
     return updates;
 }
+
+
+// Runs in a worker thread.
+QByteArray ImportHTML::HashFileContents(const QString &fullfilepath)
+{
+    QFile file(fullfilepath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    QCryptographicHash hasher(QCryptographicHash::Sha1);
+    if (!hasher.addData(&file)) {
+        return QByteArray();
+    }
+    return hasher.result();
+}
+
+
+// Runs in a worker thread.
+// Returns the book path of the new resource, empty if the file has gone
+QString ImportHTML::AddFileToBook(const QString &fullfilepath)
+{
+    try {
+        return m_Book->GetFolderKeeper()->AddContentFileToFolder(fullfilepath)->GetRelativePath();
+    } catch (FileDoesNotExist&) {
+        // Do nothing. If the referenced file does not exist,
+        // well then we don't load it.
+    }
+    return QString();
+}
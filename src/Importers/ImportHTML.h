@@ -74,9 +74,12 @@ private:
 
     // Returns a hash with keys being old references (URLs) to resources,
     // and values being the new references to those resources.
-    QHash<QString, QString> LoadMediaFiles(const QStringList & file_paths);
+    // Files with the same contents are only stored once.
+    QHash<QString, QString> LoadFiles(const QStringList & file_paths);
 
-    QHash<QString, QString> LoadStyleFiles(const QStringList & file_paths);
+    static QByteArray HashFileContents(const QString &fullfilepath);
+
+    QString AddFileToBook(const QString &fullfilepath);
 
 
     ///////////////////////////////
@@ -20,6 +20,9 @@
 **
 *************************************************************************/
 
+#include <QtCore/QFile>
+#include <QtCore/QTextStream>
+
 #include "BookManipulation/CleanSource.h"
 #include "BookManipulation/FolderKeeper.h"
 #include "BookManipulation/XhtmlDoc.h"
@@ -36,6 +39,11 @@
 const QString FIRST_SECTION_PREFIX = "Section0001";
 const QString FIRST_SECTION_NAME   = FIRST_SECTION_PREFIX + ".xhtml";
 
+// The text is split into sections of about this many characters
+// so that a very large file does not end up as one file too big
+// to edit, and so that only one section is held at a time
+const int MAX_SECTION_LENGTH = 512 * 1024;
+
 // Constructor;
 // The parameter is the file to be imported
 ImportTXT::ImportTXT(const QString &fullfilepath)
@@ -61,9 +69,7 @@ QSharedPointer<Book> ImportTXT::GetBook(bool extract_metadata)
         m_Book->GetFolderKeeper()->AddOPFToFolder(m_EpubVersion);
     } 
 
-    QString source = LoadSource();
-    HTMLResource * new_resource = CreateHTMLResource(source);
-    InitializeHTMLResource(source, new_resource);
+    HTMLResource * new_resource = LoadSections().first();
 
     // Before returning the new book, if it is epub3, make sure it has a nav
     if (m_EpubVersion.startsWith('3')) {
@@ -92,53 +98,68 @@ QSharedPointer<Book> ImportTXT::GetBook(bool extract_metadata)
 }
 
 
-QString ImportTXT::LoadSource() const
+// Reads the file a line at a time, wrapping paragraphs into <p>
+// tags, and adds a section to the book whenever enough text has
+// been collected.  Returns the sections in reading order.
+QList<HTMLResource *> ImportTXT::LoadSections()
 {
-    QString source = Utility::ReadUnicodeTextFile(m_FullFilePath);
-    source = CreateParagraphs(source.split(QChar('\n')));
-    return CleanSource::Mend(source, m_EpubVersion);
-}
-
+    QFile file(m_FullFilePath);
+    if (!file.open(QFile::ReadOnly)) {
+        std::string msg = m_FullFilePath.toStdString() + ": " + file.errorString().toStdString();
+        throw(CannotOpenFile(msg));
+    }
+    QTextStream in(&file);
+    // Input should be UTF-8
+    // This will automatically switch reading from
+    // UTF-8 to UTF-16 if a BOM is detected
+    in.setAutoDetectUnicode(true);
 
-HTMLResource *ImportTXT::CreateHTMLResource(const QString &source)
-{
     TempFolder tempfolder;
-    QString fullfilepath = tempfolder.GetPath() + "/" + FIRST_SECTION_NAME;
-    Utility::WriteUnicodeTextFile(source, fullfilepath);
-    m_Book->GetFolderKeeper()->AddContentFileToFolder(fullfilepath);
-    return m_Book->GetFolderKeeper()->GetResourceTypeList<HTMLResource>()[ 0 ];
-}
-
-
-void ImportTXT::InitializeHTMLResource(const QString &source, HTMLResource *resource)
-{
-    resource->SetText(source);
-}
-
-
-// Accepts a list of text lines and returns
-// a string with paragraphs wrapped into <p> tags
-QString ImportTXT::CreateParagraphs(const QStringList &lines) const
-{
-    QString text = "";
+    QList<HTMLResource *> sections;
+    QString text;
     QString paragraph = "<p>";
-    int num_lines = lines.count();
-
-    for (int i = 0; i < num_lines; ++i) {
-        QString line = lines.at(i);
-
-        if (line.isEmpty() || line[ 0 ].isSpace()) {
-            text.append(paragraph.append("</p>\n"));
-            paragraph = "<p>";
+    QString line;
+
+    while (in.readLineInto(&line)) {
+        // readLineInto only knows about \n and \r\n line endings
+        foreach(QString part, line.split(QChar('\r'))) {
+            // a paragraph with no blank or indented line in it
+            // is also ended once it is as long as a section
+            if (part.isEmpty() || part[ 0 ].isSpace() || (paragraph.length() >= MAX_SECTION_LENGTH)) {
+                text.append(paragraph.append("</p>\n"));
+                paragraph = "<p>";
+
+                // sections only ever end between paragraphs
+                if (text.length() >= MAX_SECTION_LENGTH) {
+                    sections.append(AddSection(text, tempfolder.GetPath(), sections.count()));
+                    text.clear();
+                }
+            }
+
+            // We prepend a space so words on
+            // line breaks don't get merged
+            paragraph.append(QString(Utility::UseNFC(part).prepend(" ")).toHtmlEscaped());
         }
-
-        // We prepend a space so words on
-        // line breaks don't get merged
-        paragraph.append(QString(line.prepend(" ")).toHtmlEscaped());
     }
 
     text.append(paragraph.append("</p>\n"));
-    return text;
+    sections.append(AddSection(text, tempfolder.GetPath(), sections.count()));
+    return sections;
 }
 
 
+// Writes one section straight into the book; the copy in the
+// temporary folder is removed again as soon as it has been added
+HTMLResource *ImportTXT::AddSection(const QString &text, const QString &folder, int index)
+{
+    QString filename = FIRST_SECTION_NAME;
+    if (index > 0) {
+        filename = QString("Section%1.xhtml").arg(index + 1, 4, 10, QChar('0'));
+    }
+    QString fullfilepath = folder + "/" + filename;
+    Utility::WriteUnicodeTextFile(CleanSource::Mend(text, m_EpubVersion), fullfilepath);
+    HTMLResource *resource = qobject_cast<HTMLResource *>(m_Book->GetFolderKeeper()->AddContentFileToFolder(fullfilepath));
+    QFile::remove(fullfilepath);
+    resource->InitialLoad();
+    return resource;
+}
@@ -24,6 +24,7 @@
 #ifndef IMPORTTXT_H
 #define IMPORTTXT_H
 
+#include <QtCore/QList>
 #include <QtCore/QSharedPointer>
 #include <QtCore/QUrl>
 
@@ -44,15 +45,9 @@ public:
 
 private:
 
-    QString LoadSource() const;
+    QList<HTMLResource *> LoadSections();
 
-    HTMLResource *CreateHTMLResource(const QString &source);
-
-    void InitializeHTMLResource(const QString &source, HTMLResource *resource);
-
-    // Accepts a list of text lines and returns
-    // a string with paragraphs wrapped into <p> tags
-    QString CreateParagraphs(const QStringList &lines) const;
+    HTMLResource *AddSection(const QString &text, const QString &folder, int index);
 
     QString m_EpubVersion;
 };
@@ -28,6 +28,7 @@
 #include <QTreeView>
 #include <QProgressDialog>
 #include <QScrollBar>
+#include <QSet>
 #include <QVariant>
 #include <QTimer>
 #include <QPaintEvent>
@@ -35,6 +36,7 @@
 #include <QDebug>
 
 #include "BookManipulation/Book.h"
+#include "BookManipulation/DeletePlan.h"
 #include "BookManipulation/FolderKeeper.h"
 #include "Dialogs/DeleteFiles.h"
 #include "Dialogs/RenameTemplate.h"
@@ -790,6 +792,38 @@ QStringList BookBrowser::AddExisting(bool only_multimedia, bool only_images)
     }
     bool yes_to_all = false;
     bool no_to_all = false;
+    // Plain files are added in batches with a single OPF update for each
+    QStringList pending_paths;
+    QSet<QString> pending_names;
+    QSet<QString> pending_covers;
+    auto add_pending = [&]() {
+        if (pending_paths.isEmpty()) {
+            return;
+        }
+        QList<Resource *> resources = m_Book->GetFolderKeeper()->AddContentFilesToFolder(pending_paths);
+        for (int i = 0; i < resources.count(); ++i) {
+            Resource *resource = resources.at(i);
+            added_book_paths << resource->GetRelativePath();
+            // if replacing a cover image, set the cover image semantics
+            if (pending_covers.contains(pending_paths.at(i))) {
+                ImageResource* new_image_resource = qobject_cast<ImageResource *>(resource);
+                if (new_image_resource) {
+                    m_Book->GetOPF()->SetResourceAsCoverImage(new_image_resource);
+                }
+            }
+            // TODO: adding a CSS file should add the referenced fonts too
+            if (resource->Type() == Resource::CSSResourceType) {
+                CSSResource *css_resource = qobject_cast<CSSResource *> (resource);
+                css_resource->InitialLoad();
+            }
+        }
+        pending_paths.clear();
+        pending_names.clear();
+        pending_covers.clear();
+    };
+    // each imported html file is moved after the one before it
+    // without writing the OPF just for that
+    m_Book->GetOPF()->BeginSpineEdit();
     foreach(QString filepath, filepaths) {
         if (file_count > 1) {
             // Set progress value and ensure dialog has time to display when doing extensive updates
@@ -818,6 +852,11 @@ QStringList BookBrowser::AddExisting(bool only_multimedia, bool only_images)
         }
 
         QString filename = QFileInfo(filepath).fileName();
+        // a file of the same name still waiting to be added has to be
+        // in the book to be found below
+        if (pending_names.contains(filename)) {
+            add_pending();
+        }
         bool CoverImageSemanticsSet = false;
         // try to see if an existing file has this filename and allow overwriting
         QString existing_book_path = m_Book->GetFolderKeeper()->GetBookPathByPathEnd(filename);
@@ -871,9 +910,12 @@ QStringList BookBrowser::AddExisting(bool only_multimedia, bool only_images)
         }
 
         if (QFileInfo(filepath).fileName() == "page-map.xml") {
+            add_pending();
             Resource * res = m_Book->GetFolderKeeper()->AddContentFileToFolder(filepath, true, QString("application/oebps-page-map+xml"));
             added_book_paths << res->GetRelativePath(); 
         } else if (TEXT_EXTENSIONS.contains(QFileInfo(filepath).suffix().toLower())) {
+            // the import may add the files it links to
+            add_pending();
             ImportHTML html_import(filepath);
             XhtmlDoc::WellFormedError error = html_import.CheckValidToLoad();
 
@@ -904,23 +946,16 @@ QStringList BookBrowser::AddExisting(bool only_multimedia, bool only_images)
                 }
             }
         } else {
-            Resource *resource = m_Book->GetFolderKeeper()->AddContentFileToFolder(filepath);
-            added_book_paths << resource->GetRelativePath();
-            // if replacing a cover image, set the cover image semantics
+            pending_paths << filepath;
+            pending_names.insert(filename);
             if (CoverImageSemanticsSet) {
-                ImageResource* new_image_resource = qobject_cast<ImageResource *>(resource);
-                if (new_image_resource) {
-                    m_Book->GetOPF()->SetResourceAsCoverImage(new_image_resource);
-                }
-            }
-            // TODO: adding a CSS file should add the referenced fonts too
-            if (resource->Type() == Resource::CSSResourceType) {
-                CSSResource *css_resource = qobject_cast<CSSResource *> (resource);
-                css_resource->InitialLoad();
+                pending_covers.insert(filepath);
             }
         }
 
     }
+    add_pending();
+    m_Book->GetOPF()->CommitSpineEdit();
     // turn off the QProgress Dialog by setting it as reaching its target
     progress.setValue(file_count);
 
@@ -1578,12 +1613,16 @@ void BookBrowser::RemoveResources(QList<Resource *> tab_resources, QList<Resourc
     }
 
 
-    // Delete the resources
-    if (resources.size() > 50) {
-        m_Book->GetFolderKeeper()->BulkRemoveResources(resources);
-    } else {
-        foreach(Resource * resource, resources) {
-            resource->Delete();
+    // Delete the resources along with the references to them
+    DeletePlan delete_plan(m_Book, resources);
+    delete_plan.Apply();
+    int removed_references = 0;
+    int left_references = 0;
+    foreach(const DeletePlan::Reference &reference, delete_plan.GetReferences()) {
+        if (reference.removed) {
+            removed_references++;
+        } else {
+            left_references++;
         }
     }
     emit ResourcesDeleted();
@@ -1601,6 +1640,14 @@ void BookBrowser::RemoveResources(QList<Resource *> tab_resources, QList<Resourc
     }
 
     QApplication::restoreOverrideCursor();
+
+    if (left_references > 0) {
+        emit ShowStatusMessageRequest(tr("%1 files deleted, %2 references to them removed, %3 left in place")
+                                      .arg(resources.count()).arg(removed_references).arg(left_references));
+    } else {
+        emit ShowStatusMessageRequest(tr("%1 files deleted, %2 references to them removed")
+                                      .arg(resources.count()).arg(removed_references));
+    }
 }
 
 
@@ -1758,6 +1805,23 @@ void BookBrowser::LinkStylesheets()
     emit LinkStylesheetsToResourcesRequest(ValidSelectedResources(Resource::HTMLResourceType));
 }
 
+void BookBrowser::SetLanguage()
+{
+    QList <Resource *> resources = ValidSelectedResources();
+
+    if (resources.isEmpty()) {
+        return;
+    }
+
+    Resource::ResourceType resource_type = resources.first()->Type();
+
+    if (resource_type != Resource::HTMLResourceType) {
+        return;
+    }
+
+    emit SetLanguageOfResourcesRequest(ValidSelectedResources(Resource::HTMLResourceType));
+}
+
 void BookBrowser::LinkJavascripts()
 {
     QList <Resource *> resources = ValidSelectedResources();
@@ -1896,6 +1960,7 @@ void BookBrowser::CreateContextMenuActions()
     m_LinkStylesheets         = new QAction(tr("Link Stylesheets..."),   this);
     m_LinkJavascripts         = new QAction(tr("Link Javascripts..."),   this);
     m_AddSemantics            = new QAction(tr("Add Semantics..."),      this);
+    m_SetLanguage             = new QAction(tr("Set Language..."),       this);
     m_ValidateWithW3C         = new QAction(tr("Validate with W3C"),     this);
     m_OpenWith                = new QAction(tr("Open With") + "...",     this);
     m_SaveAs                  = new QAction(tr("Save As") + "...",       this);
@@ -1928,6 +1993,8 @@ void BookBrowser::CreateContextMenuActions()
     sm->registerAction(this, m_LinkJavascripts, "MainWindow.BookBrowser.LinkJavascripts");
     m_AddSemantics->setToolTip(tr("Add Semantics to selected file(s)."));
     sm->registerAction(this, m_AddSemantics, "MainWindow.BookBrowser.AddSemantics");
+    m_SetLanguage->setToolTip(tr("Set the language of selected file(s)."));
+    sm->registerAction(this, m_SetLanguage, "MainWindow.BookBrowser.SetLanguage");
     // Has to be added to the book browser itself as well
     // for the keyboard shortcut to work.
     addAction(m_CopyHTML);
@@ -1939,6 +2006,7 @@ void BookBrowser::CreateContextMenuActions()
     addAction(m_LinkStylesheets);
     addAction(m_LinkJavascripts);
     addAction(m_AddSemantics);
+    addAction(m_SetLanguage);
 }
 
 
@@ -1987,6 +2055,7 @@ bool BookBrowser::SuccessfullySetupContextMenu(const QPoint &point)
             m_ContextMenu->addAction(m_LinkJavascripts);
             m_LinkJavascripts->setEnabled(AllJSResources().count() > 0);
             m_ContextMenu->addAction(m_AddSemantics);
+            m_ContextMenu->addAction(m_SetLanguage);
         }
 
         if (resource->Type() == Resource::FontResourceType) {
@@ -2186,6 +2255,7 @@ void BookBrowser::ConnectSignalsToSlots()
     connect(m_LinkStylesheets,         SIGNAL(triggered()), this, SLOT(LinkStylesheets()));
     connect(m_LinkJavascripts,         SIGNAL(triggered()), this, SLOT(LinkJavascripts()));
     connect(m_AddSemantics,            SIGNAL(triggered()), this, SLOT(AddSemanticCode()));
+    connect(m_SetLanguage,             SIGNAL(triggered()), this, SLOT(SetLanguage()));
     connect(m_SaveAs,                  SIGNAL(triggered()), this, SLOT(SaveAs()));
     connect(m_ValidateWithW3C,         SIGNAL(triggered()), this, SLOT(ValidateStylesheetWithW3C()));
     connect(m_OpenWith,                SIGNAL(triggered()), this, SLOT(OpenWith()));
@@ -268,6 +268,8 @@ signals:
 
     void LinkJavascriptsToResourcesRequest(QList<Resource *> resources);
 
+    void SetLanguageOfResourcesRequest(QList<Resource *> resources);
+
     void RemoveResourcesRequest();
 
     void OpenFileRequest(QString, int, int);
@@ -359,6 +361,8 @@ private slots:
 
     void LinkJavascripts();
 
+    void SetLanguage();
+
     /**
      * Clears obfuscation for the current resource.
      */
@@ -533,6 +537,7 @@ private:
     QAction *m_LinkStylesheets;
     QAction *m_LinkJavascripts;
     QAction *m_AddSemantics;
+    QAction *m_SetLanguage;
     QAction *m_SaveAs;
     QAction *m_ValidateWithW3C;
 
@@ -37,13 +37,16 @@
 #include <QDebug>
 
 #include "Dialogs/DryRunReplace.h"
+#include "Dialogs/FindAllResults.h"
 #include "Dialogs/ReplacementChooser.h"
 #include "Tabs/TextTab.h"
 #include "Tabs/FlowTab.h"
 #include "MainUI/FindReplace.h"
 #include "Misc/SettingsStore.h"
 #include "Misc/Utility.h"
+#include "Misc/FileSearchIndex.h"
 #include "Misc/FindReplaceQLineEdit.h"
+#include "PCRE2/PCRECache.h"
 #include "PCRE2/PCREErrors.h"
 #include "ResourceObjects/Resource.h"
 #include "ResourceObjects/TextResource.h"
@@ -87,12 +90,14 @@ FindReplace::FindReplace(MainWindow *main_window)
 
       m_SearchRunning(false),
       m_DryRunRunning(false),
+      m_FindAllRunning(false),
       m_ShiftUsed(false),
       m_DotAllCheckAction(nullptr),
       m_MinimalMatchCheckAction(nullptr),
       m_AutoTokeniseCheckAction(nullptr),
       m_UnicodePropertyCheckAction(nullptr),
-      m_menu(nullptr)
+      m_menu(nullptr),
+      m_FileSearchIndex(new FileSearchIndex(this))
 {
     ui.setupUi(this);
     FindReplaceQLineEdit *find_ledit = new FindReplaceQLineEdit(this);
@@ -231,13 +236,19 @@ bool FindReplace::isSearchXML()
     if (isWhereSVG() || isWhereMiscXML()) return true;
     if (isWhereCSS() || isWhereJS()) return false;
     if (isWhereCF() || m_LookWhereCurrentFile) {
-        Resource * current_resource = GetCurrentResource();
-        QString mt = current_resource->GetMediaType();
-        if (mt.endsWith("+xml") || mt == "application/xml" || mt == "text/xml") return true;
+        return isCurrentResourceXML();
     }
     return false;
 }
 
+bool FindReplace::isCurrentResourceXML()
+{
+    Resource * current_resource = GetCurrentResource();
+    if (!current_resource) return false;
+    QString mt = current_resource->GetMediaType();
+    return mt.endsWith("+xml") || mt == "application/xml" || mt == "text/xml";
+}
+
 
 bool FindReplace::isWhereSVG()
 {
@@ -300,6 +311,7 @@ bool FindReplace::isWhereAll()
 
 void FindReplace::close()
 {
+    m_FileSearchIndex->Clear();
     WriteSettingsVisible(false);
     QWidget::close();
 }
@@ -386,7 +398,11 @@ void FindReplace::ResetKeyModifiers()
 void FindReplace::FindClicked()
 {
     SetKeyModifiers();
-    Find();
+    if (m_ShiftUsed) {
+        PerformFindAll();
+    } else {
+        Find();
+    }
     ResetKeyModifiers();
 }
 
@@ -681,6 +697,36 @@ void FindReplace::PerformDryRunReplace()
     dr->activateWindow();
 }
 
+// Builds a table of every match that fills in from the background scan
+void FindReplace::PerformFindAll()
+{
+    // The background scan can not check spelling
+    if (m_SpellCheck) {
+        Find();
+        return;
+    }
+
+    if (m_FindAllRunning) return;
+
+    m_MainWindow->GetCurrentContentTab()->SaveTabContent();
+
+    if (IsNewSearch()) {
+        SetStartingResource(true);
+        SetPreviousSearch();
+    }
+
+    if (!IsValidFindText()) return;
+
+    m_FindAllRunning = true;
+    FindAllResults* fa = new FindAllResults(this);
+    connect(fa, &QWidget::destroyed, this, &FindReplace::FindAllComplete);
+    fa->CreateTable();
+    // do this non-modally
+    fa->show();
+    fa->raise();
+    fa->activateWindow();
+}
+
 // Allows you to delete unwanted replacements and apply those remaining
 void FindReplace::ChooseReplacements()
 {
@@ -822,6 +868,7 @@ void FindReplace::clearMessage()
 {
     if (!m_IsSearchGroupRunning) {
         ui.message->clear();
+        ui.message->setToolTip(QString());
         emit ShowMessageRequest("");
     }
 }
@@ -975,34 +1022,41 @@ QString FindReplace::GetSearchRegex()
         return QString();
     }
 
-    QString text = GetFind();
+    return BuildSearchRegex(GetFind(), GetSearchMode(), m_RegexOptionTextOnly, m_RegexOptionDotAll,
+                            m_RegexOptionMinimalMatch, m_RegexOptionUnicodeProperty, isSearchXML());
+}
+
+QString FindReplace::BuildSearchRegex(const QString &find, SearchMode mode, bool text_only, bool dot_all,
+                                      bool minimal_match, bool unicode_property, bool search_xml)
+{
+    QString text = find;
     // Convert &#x2029; to match line separator used by plainText.
     text.replace(QRegularExpression("\\R"), "\n");
 
     QString search(text);
 
     // Search type
-    if (GetSearchMode() == FindReplace::SearchMode_Normal || GetSearchMode() == FindReplace::SearchMode_Case_Sensitive) {
+    if (mode == FindReplace::SearchMode_Normal || mode == FindReplace::SearchMode_Case_Sensitive) {
         search = QRegularExpression::escape(search);
-        if (m_RegexOptionTextOnly && isSearchXML()) {
+        if (text_only && search_xml) {
             // must be immediately before the user search
             search = PrependRegexOptionToSearch(REGEX_OPTION_TEXT_ONLY, search);
         }
-        if (GetSearchMode() == FindReplace::SearchMode_Normal) {
+        if (mode == FindReplace::SearchMode_Normal) {
             search = PrependRegexOptionToSearch(REGEX_OPTION_IGNORE_CASE, search);
         }
     } else {
         // must be immediately before the user search
-        if (m_RegexOptionTextOnly && isSearchXML()) {
+        if (text_only && search_xml) {
             search = PrependRegexOptionToSearch(REGEX_OPTION_TEXT_ONLY, search);
         }
-        if (m_RegexOptionDotAll) {
+        if (dot_all) {
             search = PrependRegexOptionToSearch(REGEX_OPTION_DOT_ALL, search);
         }
-        if (m_RegexOptionMinimalMatch) {
+        if (minimal_match) {
             search = PrependRegexOptionToSearch(REGEX_OPTION_MINIMAL_MATCH, search);
         }
-        if (m_RegexOptionUnicodeProperty) {
+        if (unicode_property) {
             search = PrependRegexOptionToSearch(REGEX_OPTION_UCP, search);
         }
     }
@@ -1010,6 +1064,71 @@ QString FindReplace::GetSearchRegex()
     return search;
 }
 
+QStringList FindReplace::GetSearchRegexes(const QList<SearchEditorModel::searchEntry *> &search_entries)
+{
+    QStringList regexes;
+    if (m_SpellCheck) {
+        return regexes;
+    }
+
+    // Look where controls other than CF in the order UpdateSearchControls
+    // checks them, and whether they search xml
+    static const QList<std::pair<QString, bool>> LOOK_WHERE_XML = {
+        {"AH", true}, {"SH", true}, {"TH", true},
+        {"AC", false}, {"SC", false}, {"TC", false},
+        {"OP", true}, {"NX", true}, {"SV", true},
+        {"SJ", false}, {"SX", true}
+    };
+
+    foreach(SearchEditorModel::searchEntry *search_entry, search_entries) {
+        if (!search_entry || search_entry->find.isEmpty()) {
+            continue;
+        }
+        // Anything the controls do not set is left as it is now
+        const QString &controls = search_entry->controls;
+        SearchMode mode = GetSearchMode();
+        bool text_only = m_RegexOptionTextOnly;
+        bool dot_all = m_RegexOptionDotAll;
+        bool minimal_match = m_RegexOptionMinimalMatch;
+        bool unicode_property = m_RegexOptionUnicodeProperty;
+        bool search_xml = isSearchXML();
+        if (!controls.isEmpty()) {
+            if (controls.contains("NL")) {
+                mode = FindReplace::SearchMode_Normal;
+            } else if (controls.contains("RX")) {
+                mode = FindReplace::SearchMode_Regex;
+            } else if (controls.contains("CS")) {
+                mode = FindReplace::SearchMode_Case_Sensitive;
+            }
+            text_only = controls.contains("TO");
+            dot_all = controls.contains("DA");
+            minimal_match = controls.contains("MM");
+            unicode_property = controls.contains("UN");
+
+            if (controls.contains("CF")) {
+                search_xml = isCurrentResourceXML();
+            } else {
+                foreach(const auto &where, LOOK_WHERE_XML) {
+                    if (controls.contains(where.first)) {
+                        search_xml = where.second;
+                        break;
+                    }
+                }
+            }
+        }
+        regexes << BuildSearchRegex(search_entry->find, mode, text_only, dot_all,
+                                    minimal_match, unicode_property, search_xml);
+    }
+    return regexes;
+}
+
+void FindReplace::PrecompileSelectedSearches()
+{
+    // these entries are owned by the Search Editor who will clean up as needed
+    QList<SearchEditorModel::searchEntry*> search_entries = m_MainWindow->SearchEditorGetCurrentEntries();
+    PCRECache::instance()->setPinned(GetSearchRegexes(search_entries));
+}
+
 QString FindReplace::PrependRegexOptionToSearch(const QString &option, const QString &search)
 {
     if (search.startsWith(REGEX_OPTION_UCP)) {
@@ -1318,6 +1437,20 @@ Resource *FindReplace::GetNextContainingResource(Searchable::Direction direction
     QList<Resource *> resources = GetFilesToSearch();
     if (resources.isEmpty()) return NULL;
 
+    // The files searched do not change while stepping through them,
+    // so each step only has to look up where it is
+    QHash<Resource *, int> positions;
+    positions.reserve(resources.count());
+    for (int i = resources.count() - 1; i >= 0; --i) {
+        positions.insert(resources.at(i), i);
+    }
+
+    // Let the workers find out which files hold a match while we step
+    // through them, this does nothing if the same scan is already running
+    if (!m_SpellCheck) {
+        m_FileSearchIndex->Start(GetSearchRegex(), resources);
+    }
+
     // If no starting resource we will need to set one first and then search it.
     // Otherwise,  this resource was part of the current selection (or earlier) and has already been
     // searched in FindInAllFiles
@@ -1336,7 +1469,7 @@ Resource *FindReplace::GetNextContainingResource(Searchable::Direction direction
     if (need_to_check_assigned_starting_resource) {
         DBG qDebug() << "Trying newly assigned first resource: " << next_resource->GetRelativePath();
         if (next_resource) {
-            if (ResourceContainsCurrentRegex(next_resource)) {
+            if (ResourceContainsMatch(next_resource)) {
                 DBG qDebug() << "Found it";
                 return next_resource;
             }
@@ -1356,7 +1489,7 @@ Resource *FindReplace::GetNextContainingResource(Searchable::Direction direction
 
     while (!passed_starting_resource || (next_resource != starting_resource)) {
         
-        next_resource = GetNextResource(next_resource, direction);
+        next_resource = GetNextResource(resources, positions, next_resource, direction);
 
         if (next_resource == starting_resource) {
             return NULL;
@@ -1364,7 +1497,7 @@ Resource *FindReplace::GetNextContainingResource(Searchable::Direction direction
 
         if (next_resource) {
             DBG qDebug() << "Trying Next Resource: " << next_resource->GetRelativePath();
-            if (ResourceContainsCurrentRegex(next_resource)) {
+            if (ResourceContainsMatch(next_resource)) {
                 DBG qDebug() << "Found it";
                 return next_resource;
             } else {
@@ -1382,9 +1515,19 @@ Resource *FindReplace::GetNextContainingResource(Searchable::Direction direction
 }
 
 
-Resource *FindReplace::GetNextResource(Resource *current_resource, Searchable::Direction direction)
+bool FindReplace::ResourceContainsMatch(Resource *resource)
+{
+    // Hunspell can not be used from the background scan
+    if (m_SpellCheck) {
+        return ResourceContainsCurrentRegex(resource);
+    }
+    return m_FileSearchIndex->Contains(resource);
+}
+
+
+Resource *FindReplace::GetNextResource(const QList<Resource *> &resources, const QHash<Resource *, int> &positions,
+                                       Resource *current_resource, Searchable::Direction direction)
 {
-    QList <Resource *> resources = GetFilesToSearch();
     int max_reading_order       = resources.count() - 1;
     int current_reading_order   = 0;
     int next_reading_order      = 0;
@@ -1392,16 +1535,8 @@ Resource *FindReplace::GetNextResource(Resource *current_resource, Searchable::D
     if (resources.isEmpty()) return NULL;
 
     // Find the current resource in the tabbed/selected/all resource entries
-    int i = 0;
     if (current_resource) {
-        foreach(Resource * resource, resources) {
-            if (resource && (resource->GetRelativePath() == current_resource->GetRelativePath())) {
-                current_reading_order = i;
-                break;
-            }
-
-            i++;
-        }
+        current_reading_order = positions.value(current_resource, 0);
     }
 
     // We wrap back (if needed)
@@ -1943,10 +2078,12 @@ void FindReplace::ReplaceAllSearch()
     SetKeyModifiers();
     m_IsSearchGroupRunning = true;
     int count = 0;
-    foreach(SearchEditorModel::searchEntry * search_entry, search_entries) {
-        LoadSearch(search_entry);
-        count += ReplaceAll();
-        m_MainWindow->SearchEditorRecordEntryAsCompleted(search_entry);
+    if (!ReplaceAllSearchBatch(search_entries, count)) {
+        foreach(SearchEditorModel::searchEntry * search_entry, search_entries) {
+            LoadSearch(search_entry);
+            count += ReplaceAll();
+            m_MainWindow->SearchEditorRecordEntryAsCompleted(search_entry);
+        }
     }
     m_IsSearchGroupRunning = false;
 
@@ -1961,6 +2098,55 @@ void FindReplace::ReplaceAllSearch()
 
 
 
+// Run a group of saved searches that all look in multiple files as one
+// batch so that every file is loaded and updated only once no matter how
+// many searches are in the group.  Returns false without making any
+// changes if the group can not be batched so the caller can run the
+// searches one by one.
+bool FindReplace::ReplaceAllSearchBatch(const QList<SearchEditorModel::searchEntry*> &search_entries, int &count)
+{
+    if (search_entries.count() < 2 || m_LookWhereCurrentFile || m_SpellCheck || IsMarkedText()) {
+        return false;
+    }
+
+    m_MainWindow->GetCurrentContentTab()->SaveTabContent();
+
+    QList<SearchOperations::ReplaceEntry> batch;
+    QStringList names;
+    foreach(SearchEditorModel::searchEntry * search_entry, search_entries) {
+        names << (search_entry->name.isEmpty() ? search_entry->find.left(50) : search_entry->name.left(50));
+        LoadSearch(search_entry);
+        if (isWhereCF() || !IsValidFindText()) {
+            return false;
+        }
+        SearchOperations::ReplaceEntry entry;
+        entry.search_regex = GetSearchRegex();
+        entry.replacement = GetReplace();
+        entry.resources = GetFilesToSearch(true);
+        batch << entry;
+    }
+
+    SetCodeViewIfNeeded();
+    QList<int> counts = SearchOperations::ReplaceInAllFilesBatch(batch);
+
+    QStringList report;
+    count = 0;
+    for (int i = 0; i < counts.count(); i++) {
+        count += counts.at(i);
+        report << QString("%1: %2").arg(names.at(i).toHtmlEscaped()).arg(counts.at(i));
+        m_MainWindow->SearchEditorRecordEntryAsCompleted(search_entries.at(i));
+    }
+
+    // report how many replacements each search made
+    ui.message->setToolTip(report.join("<br/>"));
+
+    if (count > 0) {
+        m_MainWindow->GetCurrentBook()->SetModified(true);
+        m_MainWindow->GetCurrentContentTab()->ContentChangedExternally();
+    }
+    return true;
+}
+
 void FindReplace::SetSearchMode(int search_mode)
 {
     ui.cbSearchMode->setCurrentIndex(0);
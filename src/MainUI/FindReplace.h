@@ -39,6 +39,7 @@ class QMenu;
 class QAction;
 class Resource;
 class MainWindow;
+class FileSearchIndex;
 
 class FindReplace : public QWidget
 {
@@ -119,12 +120,18 @@ public slots:
     void ReplaceAllSearch();
     void DoRestart();
 
+    // Compiles the regexes of the saved searches selected in the Search
+    // Editor ahead of them being run and keeps them compiled.
+    void PrecompileSelectedSearches();
+
     // Shows a message in the main window.
     void ShowMessage(const QString &message);
     void clearMessage();
 
     void DryRunComplete() { m_DryRunRunning = false; clearMessage(); };
 
+    void FindAllComplete() { m_FindAllRunning = false; clearMessage(); };
+
     bool FindMisspelledWord();
 
     void SetRegexOptionDotAll(bool new_state);
@@ -202,6 +209,9 @@ private slots:
     // Does a Dry Run Find A// / Replace All  and shows results in table
     void PerformDryRunReplace();
 
+    // Lists every match in a table that fills in as files are searched
+    void PerformFindAll();
+
     // Allows a user to choose which matches in Replace All should
     // be applied
     void ChooseReplacements();
@@ -248,6 +258,15 @@ private:
     // options and fields and then returns it.
     QString PrependRegexOptionToSearch(const QString &option, const QString &search);
 
+    QString BuildSearchRegex(const QString &find, SearchMode mode, bool text_only, bool dot_all,
+                             bool minimal_match, bool unicode_property, bool search_xml);
+
+    // The regex each entry would be searched with once loaded, worked
+    // out from its controls without loading it.
+    QStringList GetSearchRegexes(const QList<SearchEditorModel::searchEntry *> &search_entries);
+
+    bool isCurrentResourceXML();
+
     QList <Resource *> GetFilesToSearch(bool force_all = false);
 
     bool IsCurrentFileInSelection();
@@ -260,11 +279,14 @@ private:
 
     int ReplaceInAllFiles();
 
+    bool ReplaceAllSearchBatch(const QList<SearchEditorModel::searchEntry*> &search_entries, int &count);
+
     bool FindInAllFiles(Searchable::Direction direction);
 
     Resource *GetNextContainingResource(Searchable::Direction direction);
 
-    Resource *GetNextResource(Resource *current_resource, Searchable::Direction direction);
+    Resource *GetNextResource(const QList<Resource *> &resources, const QHash<Resource *, int> &positions,
+                              Resource *current_resource, Searchable::Direction direction);
 
     Resource *GetCurrentResource();
 
@@ -275,6 +297,9 @@ private:
     template<class T>
     bool ResourceContainsCurrentRegex(T *resource);
 
+    // Uses the background scan of the files to search when it can
+    bool ResourceContainsMatch(Resource *resource);
+
     /**
      * Returns a list of all the strings
      * currently stored in the find combo box.
@@ -383,6 +408,8 @@ private:
 
     bool m_DryRunRunning;
 
+    bool m_FindAllRunning;
+
     bool m_ShiftUsed;
 
     QAction* m_DotAllCheckAction;
@@ -390,6 +417,9 @@ private:
     QAction* m_AutoTokeniseCheckAction;
     QAction* m_UnicodePropertyCheckAction;
     QMenu*   m_menu;
+
+    // Scans the files to search ahead of Find in all files
+    FileSearchIndex *m_FileSearchIndex;
 };
 
 
@@ -38,6 +38,7 @@
 #include "MainUI/MainApplication.h"
 #include "Misc/SigilDarkStyle.h"
 #include "Misc/SettingsStore.h"
+#include "Misc/StallWatchdog.h"
 #include "Widgets/CaretStyle.h"
 
 #define DBG if(1)
@@ -47,7 +48,8 @@ MainApplication::MainApplication(int &argc, char **argv)
       m_isDark(false),
       m_accumulatedQss(QString()),
       m_PaletteChangeTimer(new QTimer()),
-      m_AlwaysUseNFC(true)
+      m_AlwaysUseNFC(true),
+      m_StallWatchdog(NULL)
 {
 
     // Do this only once early on in the Sigil startup
@@ -64,6 +66,12 @@ MainApplication::MainApplication(int &argc, char **argv)
     connect(m_PaletteChangeTimer, SIGNAL(timeout()),this, SLOT(systemColorChanged()));
     m_PaletteChangeTimer->stop();
 
+    // Report anything that blocks the event loop for too long
+    if (StallWatchdog::IsEnabled()) {
+        m_StallWatchdog = new StallWatchdog();
+        m_StallWatchdog->start();
+    }
+
 // Connect system color scheme change signal to reporting mechanism
 // Note: This mechanism is very very unreliable on Linux (across many distributions and desktops)
 // So fall back to the QApplication:Palette change event instead for all of Linux for now
@@ -80,6 +88,14 @@ MainApplication::MainApplication(int &argc, char **argv)
 #endif
 }
 
+MainApplication::~MainApplication()
+{
+    if (m_StallWatchdog) {
+        m_StallWatchdog->Stop();
+        delete m_StallWatchdog;
+    }
+}
+
 void MainApplication::saveInPreviewCache(const QString &key, const QString& xhtml)
 {
     m_PreviewCache[key] = xhtml;
@@ -232,6 +248,17 @@ void MainApplication::windowsLightThemeChange()
     }
 }
 
+std::pair<int, qint64> MainApplication::previewCacheMemoryUsage() const
+{
+    qint64 total = 0;
+    QHashIterator<QString, QString> it(m_PreviewCache);
+    while (it.hasNext()) {
+        it.next();
+        total += (it.key().capacity() + it.value().capacity()) * sizeof(QChar);
+    }
+    return std::make_pair(static_cast<int>(m_PreviewCache.count()), total);
+}
+
 void MainApplication::updateAccumulatedQss(QString &qss) const
 {
     m_accumulatedQss = qss;
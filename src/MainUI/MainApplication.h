@@ -33,17 +33,21 @@
 #include <QHash>
 #include <QTimer>
 
+class StallWatchdog;
+
 class MainApplication : public QApplication
 {
     Q_OBJECT
 
 public:
     MainApplication(int &argc, char **argv);
+    ~MainApplication();
 
     bool isDarkMode() { return m_isDark; }
 
     void saveInPreviewCache(const QString &key, const QString& xhtml);
     QString loadFromPreviewCache(const QString &key);
+    std::pair<int, qint64> previewCacheMemoryUsage() const;
     void updateAccumulatedQss(QString &qss) const;
     bool AlwaysUseNFC(){ return m_AlwaysUseNFC; };
     
@@ -67,6 +71,7 @@ private:
     mutable QString m_accumulatedQss;
     QTimer * m_PaletteChangeTimer;
     bool m_AlwaysUseNFC = true;
+    StallWatchdog *m_StallWatchdog;
 };
 
 #endif // MAINAPPLICATION_H
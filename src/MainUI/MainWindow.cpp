@@ -32,6 +32,7 @@
 #include <QImage>
 #include <QGuiApplication>
 #include <QScreen>
+#include <QEventLoop>
 #include <QFileDialog>
 #include <QInputDialog>
 #include <QMessageBox>
@@ -54,6 +55,9 @@
 #include "BookManipulation/CleanSource.h"
 #include "BookManipulation/Index.h"
 #include "BookManipulation/FolderKeeper.h"
+#include "BookManipulation/AutosaveJournal.h"
+#include "BookManipulation/TextCountMonitor.h"
+#include "BookManipulation/WellFormedMonitor.h"
 #include "Dialogs/About.h"
 #include "Dialogs/ClipEditor.h"
 #include "Dialogs/ClipboardHistorySelector.h"
@@ -69,6 +73,8 @@
 #include "Dialogs/PluginRunner.h"
 #include "Dialogs/Preferences.h"
 #include "Dialogs/RepoLog.h"
+#include "Dialogs/MemoryUsageDialog.h"
+#include "Dialogs/PerformanceHistory.h"
 #include "Dialogs/ChgViewer.h"
 #include "Dialogs/CPCompare.h"
 #include "Dialogs/SearchEditor.h"
@@ -89,12 +95,17 @@
 #include "MainUI/PreviewWindow.h"
 #include "MainUI/TableOfContents.h"
 #include "MainUI/ValidationResultsView.h"
+#include "Misc/BatchRenderer.h"
+#include "Misc/CheckpointHashes.h"
 #include "Misc/HTMLSpellCheck.h"
 #include "Misc/HTMLSpellCheckML.h"
 #include "Misc/KeyboardShortcutManager.h"
 #include "Misc/Landmarks.h"
+#include "Misc/Language.h"
 #include "Misc/MediaTypes.h"
+#include "Misc/MemoryUsage.h"
 #include "Misc/OpenExternally.h"
+#include "Misc/OperationLog.h"
 #include "Misc/Plugin.h"
 #include "Misc/PluginDB.h"
 #include "EmbedPython/PythonRoutines.h"
@@ -102,8 +113,11 @@
 #include "Misc/SleepFunctions.h"
 #include "Misc/SpellCheck.h"
 #include "Misc/TempFolder.h"
+#include "Misc/ThumbnailCache.h"
+#include "Misc/Trace.h"
 #include "Misc/TOCHTMLWriter.h"
 #include "Misc/Utility.h"
+#include "MiscEditors/IndexEntries.h"
 #include "MiscEditors/IndexHTMLWriter.h"
 #include "Parsers/HTMLStyleInfo.h"
 #include "ResourceObjects/HTMLResource.h"
@@ -112,6 +126,7 @@
 #include "ResourceObjects/NavProcessor.h"
 #include "sigil_constants.h"
 #include "sigil_exception.h"
+#include "SourceUpdates/LanguageUpdates.h"
 #include "SourceUpdates/LinkUpdates.h"
 #include "SourceUpdates/JavascriptUpdates.h"
 #include "SourceUpdates/WordUpdates.h"
@@ -136,6 +151,12 @@ static const int ZOOM_SLIDER_MAX    = 1000;
 static const int ZOOM_SLIDER_MIDDLE = 500;
 static const int ZOOM_SLIDER_WIDTH  = 140;
 
+// longest the Preview waits after an edit, however slow the page
+static const int MAX_PREVIEW_DELAY  = 3000;
+
+// how often the memory in use is added to a trace
+static const int MEMORY_TRACE_INTERVAL_MS = 10000;
+
 static const QString DONATE         = "https://sigil-ebook.com/donate";
 static const QString SIGIL_WEBSITE  = "https://sigil-ebook.com/sigil";
 static const QString USER_GUIDE_URL = "https://sigil-ebook.com//sigil/guide";
@@ -174,6 +195,7 @@ static const QStringList AUTOMATE_TOOLS = QStringList() <<
     "GenerateTOC" <<
     "MendPrettifyHTML" <<
     "MendHTML" <<
+    "MinifyCSS" <<
     "ReformatCSSMultipleLines" <<
     "ReformatCSSSingleLines" <<
     "RemoveNCXGuideFromEpub3" <<
@@ -185,6 +207,7 @@ static const QStringList AUTOMATE_TOOLS = QStringList() <<
     "SetBookBrowserToAllImages" <<
     "SetBookBrowserToInitialSelection" <<
     "SetPluginParameter" <<
+    "SetSaveCompression" <<
     "SplitOnSGFSectionMarkers" <<
     "StandardizeEpub" <<
     "UpdateManifestProperties" <<
@@ -216,6 +239,7 @@ MainWindow::MainWindow(const QString &openfilepath,
     m_PreviewWindow(NULL),
     m_slZoomSlider(NULL),
     m_lbZoomLabel(NULL),
+    m_lbTextCounts(NULL),
     c_SaveFilters(GetSaveFiltersMap()),
     c_LoadFilters(GetLoadFiltersMap()),
     m_casingChangeGroup(new QActionGroup(this)),
@@ -224,6 +248,7 @@ MainWindow::MainWindow(const QString &openfilepath,
     m_IndexEditor(new IndexEditor(this)),
     m_SpellcheckEditor(new SpellcheckEditor(this)),
     m_SelectCharacter(new SelectCharacter(this)),
+    m_PerformanceHistory(NULL),
     m_ViewImage(new ViewImage(this, false)),
     m_Reports(new Reports(this)),
     m_preserveHeadingAttributes(true),
@@ -244,7 +269,8 @@ MainWindow::MainWindow(const QString &openfilepath,
     m_SaveCSS(false),
     m_IsClosing(false),
     m_headingActionGroup(new QActionGroup(this)),
-    m_UsingAutomate(false)
+    m_UsingAutomate(false),
+    m_AutosaveJournal(new AutosaveJournal(this))
 {
     ui.setupUi(this);
     // Telling Qt to delete this window
@@ -263,6 +289,12 @@ MainWindow::MainWindow(const QString &openfilepath,
     ChangeSignalsWhenTabChanges(NULL, m_TabManager->GetCurrentContentTab());
     LoadInitialFile(openfilepath, version, is_internal);
     loadPluginsMenu();
+
+    if (Trace::IsEnabled()) {
+        QTimer *memory_timer = new QTimer(this);
+        connect(memory_timer, SIGNAL(timeout()), this, SLOT(TraceMemoryUsage()));
+        memory_timer->start(MEMORY_TRACE_INTERVAL_MS);
+    }
 }
 
 MainWindow::~MainWindow()
@@ -419,8 +451,9 @@ bool MainWindow::Automate(const QStringList &commands)
             else if (cmd == "AddCover")                   success = AddCover();
             else if (cmd == "GenerateTOC")                success = GenerateTOC(true);
             else if (cmd == "CreateHTMLTOC")              success = CreateHTMLTOC();
-            else if (cmd == "ReformatCSSMultipleLines")   success = ReformatAllStylesheets(true);
-            else if (cmd == "ReformatCSSSingleLines")     success = ReformatAllStylesheets(false);
+            else if (cmd == "ReformatCSSMultipleLines")   success = ReformatAllStylesheets(CSSInfo::MultipleLineFormat);
+            else if (cmd == "ReformatCSSSingleLines")     success = ReformatAllStylesheets(CSSInfo::SingleLineFormat);
+            else if (cmd == "MinifyCSS")                  success = ReformatAllStylesheets(CSSInfo::MinifiedFormat, true);
             // allow some control over what is selected in BookBrowser because some plugins
             // use that to control which files they work on
             else if (cmd == "SetBookBrowserToAllCSS")   {
@@ -460,6 +493,12 @@ bool MainWindow::Automate(const QStringList &commands)
             m_AutomatePluginParameter  = cmd.mid(19, -1).trimmed();
             success = true;
 
+        // Allow Automate to pick how the epub is compressed when saved
+        } else if (cmd.startsWith("SetSaveCompression")) {
+            QString profile = cmd.mid(19, -1).trimmed();
+            success = ExportEPUB::CompressionProfiles().contains(profile);
+            if (success) m_Book->SetSaveCompression(profile);
+
         // handle saved search and its full name parameter     
         } else if (cmd.startsWith("RunSavedSearchReplaceAll")) {
             QString fullname = cmd.mid(25, -1).trimmed();
@@ -553,7 +592,12 @@ void MainWindow::loadPluginsMenu()
         i++;
     }
 
-    QHash<QString, Plugin *> plugins = pdb->all_plugins();
+    // The plugins are read from disk once the window is shown and
+    // plugins_changed rebuilds this menu, so do not force it here
+    QHash<QString, Plugin *> plugins;
+    if (pdb->is_loaded()) {
+        plugins = pdb->all_plugins();
+    }
 
     // first set default icons for quick launch plugin buttons
     // Do we need this?  Aren't these set in Form_Files/main.ui
@@ -893,11 +937,14 @@ bool MainWindow::RepoCommit()
     // add in the META-INF/container.xml file
     bookfiles << "META-INF/container.xml";
 
+    // only files changed since the last checkpoint are actually read here
+    QStringList bookhashes = CheckpointHashes::BlobHashes(bookroot, bookfiles);
+
     // now perform the commit using python in a separate thread since this
     // may take a while depending on the speed of the filesystem
     PythonRoutines pr;
     QFuture<QString> future = QtConcurrent::run(&PythonRoutines::PerformRepoCommitInPython, &pr,
-                                                localRepo, bookid, bookinfo, bookroot, bookfiles);
+                                                localRepo, bookid, bookinfo, bookroot, bookfiles, bookhashes);
     future.waitForFinished();
     QString commit_result = future.result();
 
@@ -1074,27 +1121,23 @@ void MainWindow::RepoDiff(QString bookid)
         return;
     }
 
-    // checkout this tag version and copy it to a tempfolder
-    TempFolder destdir;
-    QApplication::setOverrideCursor(Qt::WaitCursor);
-    QFuture<QString> cfuture = QtConcurrent::run(&PythonRoutines::CopyTagToDestDirInPython, &pr,
-                                                 localRepo, bookid, chkpoint1, destdir.GetPath() );
-    cfuture.waitForFinished();
-    QString copied = cfuture.result();
-    QApplication::restoreOverrideCursor();
-
-    // get  the status of the changes since that tag
+    // get the status of the changes since that tag, only the files changed
+    // since the last checkpoint or diff are actually read to hash them
     QString bookroot = m_Book->GetFolderKeeper()->GetFullPathToMainFolder();
     QStringList bookfiles = m_Book->GetFolderKeeper()->GetAllBookPaths();
     bookfiles << "META-INF/container.xml";
 
     QApplication::setOverrideCursor(Qt::WaitCursor);
-    
-    QFuture<QList<QStringList> > dfuture = QtConcurrent::run(&PythonRoutines::GetCurrentStatusVsDestDirInPython,
-                                             &pr, bookroot, bookfiles, destdir.GetPath());
+    QStringList bookhashes = CheckpointHashes::BlobHashes(bookroot, bookfiles);
+    QFuture<QList<QStringList> > dfuture = QtConcurrent::run(&PythonRoutines::GetCurrentStatusVsTagInPython,
+                                             &pr, localRepo, bookid, chkpoint1, bookfiles, bookhashes);
     dfuture.waitForFinished();
     QList<QStringList> sres = dfuture.result();
     QApplication::restoreOverrideCursor();
+    if (sres.count() != 3) {
+        ShowMessageOnStatusBar(tr("Diff Failed."));
+        return;
+    }
     // order is deleted, added, and modified
     QStringList dlist(sres.at(0));
     QStringList alist(sres.at(1));
@@ -1105,6 +1148,17 @@ void MainWindow::RepoDiff(QString bookid)
         return;
     } 
 
+    // copy the deleted and modified files of this tag version to a tempfolder
+    // to explore the changes, nothing else of it is looked at
+    TempFolder destdir;
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QFuture<QString> cfuture = QtConcurrent::run(&PythonRoutines::CopyTagToDestDirInPython, &pr,
+                                                 localRepo, bookid, chkpoint1, destdir.GetPath(),
+                                                 dlist + mlist);
+    cfuture.waitForFinished();
+    QString copied = cfuture.result();
+    QApplication::restoreOverrideCursor();
+
     // use CPCompare dialog modally to allow the user to explore the changes
     CPCompare comp(bookroot, destdir.GetPath(), dlist, alist, mlist, this);
     comp.exec();
@@ -1665,10 +1719,64 @@ void MainWindow::ShowLastOpenFileWarnings()
 
 void MainWindow::showEvent(QShowEvent *event)
 {
+    // only the first window shown looks for journals left by a crash
+    static bool recovery_offered = false;
+    if (!recovery_offered) {
+        recovery_offered = true;
+        QTimer::singleShot(0, this, SLOT(OfferAutosaveRecovery()));
+    }
     m_IsInitialLoad = false;
     QMainWindow::showEvent(event);
 }
 
+
+void MainWindow::OfferAutosaveRecovery()
+{
+    foreach(const QString &journal_path, AutosaveJournal::OrphanedJournals()) {
+        AutosaveJournal::Contents contents;
+        if (!AutosaveJournal::Read(journal_path, contents) || contents.entries.isEmpty()) {
+            AutosaveJournal::Remove(journal_path);
+            continue;
+        }
+
+        QString name = contents.epub_path.isEmpty() ? tr("a new book") : QDir::toNativeSeparators(contents.epub_path);
+        QMessageBox::StandardButton button_pressed = Utility::warning(this, tr("Sigil"),
+                tr("Sigil did not close normally while %1 was being edited.\n\n"
+                   "Do you want to recover the changes to %n file(s) that were saved automatically? "
+                   "Choose Cancel to be asked again the next time Sigil starts.", "", contents.entries.count()).arg(name),
+                QMessageBox::Yes|QMessageBox::No|QMessageBox::Cancel);
+        if (button_pressed == QMessageBox::Cancel) {
+            continue;
+        }
+        if (button_pressed == QMessageBox::No) {
+            AutosaveJournal::Remove(journal_path);
+            continue;
+        }
+
+        // the edits can only be put back into a book that has none of its own
+        if (m_Book->IsModified()) {
+            ShowMessageOnStatusBar(tr("Save or close the current book to recover the changes."));
+            return;
+        }
+        bool loaded = true;
+        if (contents.epub_path.isEmpty()) {
+            if (!m_CurrentFilePath.isEmpty()) {
+                CreateNewBook();
+            }
+        } else if (contents.epub_path != m_CurrentFilePath) {
+            loaded = LoadFile(contents.epub_path);
+        }
+        if (!loaded) {
+            continue;
+        }
+        int count = AutosaveJournal::Replay(m_Book, contents);
+        AutosaveJournal::Remove(journal_path);
+        ShowMessageOnStatusBar(tr("Recovered changes to %n file(s).", "", count));
+        // one book per window
+        return;
+    }
+}
+
 void MainWindow::DebugCurrentWidgetSizes() 
 {
     DWINGEO {
@@ -1738,6 +1846,9 @@ void MainWindow::closeEvent(QCloseEvent *event)
 
         DBG qDebug() << "in close event after maybe save";
 
+        // closing normally, whatever was not saved was meant to be dropped
+        m_AutosaveJournal->Discard();
+
 #ifdef Q_OS_MAC
         // since we are closing this window, disconnect signals that might be invoked
         // by a user during closing operations to help prevent segfaults on close
@@ -2139,8 +2250,8 @@ void MainWindow::GoToLinkedStyleDefinition(const QString &element_name, const QS
                 first_css_resource = css_resource;
             }
             if (css_resource) {
-                CSSInfo css_info(css_resource->GetText());
-                CSSInfo::CSSSelector *selector = css_info.getCSSSelectorForElementClass(element_name, style_class_name);
+                QSharedPointer<const CSSInfo> css_info = css_resource->GetCSSInfo();
+                CSSInfo::CSSSelector *selector = css_info->getCSSSelectorForElementClass(element_name, style_class_name);
 
                 // All of this is actually handled in CSSInfo and is NOT needed here
 
@@ -2169,8 +2280,8 @@ void MainWindow::GoToLinkedStyleDefinition(const QString &element_name, const QS
                 Resource * resource = m_Book->GetFolderKeeper()->GetResourceByBookPath(bookpath);
                 CSSResource *css_resource = qobject_cast<CSSResource*>( resource );
                 if (css_resource) {
-                    CSSInfo css_info(css_resource->GetText());
-                    QList<CSSInfo::CSSSelector*> combinators = css_info.getAllSelectorsWithCombinators();
+                    QSharedPointer<const CSSInfo> css_info = css_resource->GetCSSInfo();
+                    QList<CSSInfo::CSSSelector*> combinators = css_info->getAllSelectorsWithCombinators();
                     foreach(CSSInfo::CSSSelector* selector, combinators) {
                         QString asel = selector->text;
                         if (asel.startsWith(sel1) || asel.startsWith(sel2)) {
@@ -2389,7 +2500,7 @@ bool MainWindow::AddCover()
             // Add the filename and dimensions of the image to the HTML source.
             QString image_relative_path = image_resource->GetRelativePathFromResource(html_cover_resource);
             image_relative_path = Utility::URLEncodePath(image_relative_path);
-            QImage img(image_resource->GetFullPath());
+            QSize img = ThumbnailCache::GetSize(image_resource->GetFullPath());
             QString text = html_cover_resource->GetText();
             QString width = QString::number(img.width());
             QString height = QString::number(img.height());
@@ -2493,14 +2604,7 @@ bool MainWindow::GenerateNCXGuideFromNav()
 
     // find existing nav document if there is one
     HTMLResource * nav_resource = m_Book->GetConstOPF()->GetNavResource();
-    QString navbkpath = "";
-    QString navdata = "";
-    if (nav_resource) {
-        navdata = CleanSource::Mend(nav_resource->GetText(),"3.0");
-        navbkpath = nav_resource->GetRelativePath();
-    }
-
-    if ((!nav_resource) || navdata.isEmpty()) {
+    if ((!nav_resource) || nav_resource->GetText().trimmed().isEmpty()) {
         ShowMessageOnStatusBar(tr("NCX and Guide generation failed."));
         QApplication::restoreOverrideCursor();
         return false;
@@ -2517,29 +2621,9 @@ bool MainWindow::GenerateNCXGuideFromNav()
         m_Book->GetOPF()->UpdateNCXOnSpine(NCXId);
     }
 
-    QString ncxdir = Utility::startingDir(ncx_resource->GetRelativePath());
-
-    QStringList mvalues = m_Book->GetConstOPF()->GetDCMetadataValues("dc:title");
-    QString doctitle = "UNKNOWN";
-    if (!mvalues.isEmpty()) {
-        doctitle = mvalues.at(0);
-    } 
-    QString mainid = m_Book->GetConstOPF()->GetMainIdentifierValue();
-
-    // Now build the ncx in python in a separate thread since may be an long job
-    PythonRoutines pr;
-    QFuture<QString> future = QtConcurrent::run(&PythonRoutines::GenerateNcxInPython, &pr, navdata, 
-                                             navbkpath, ncxdir, doctitle, mainid);
-    future.waitForFinished();
-    QString ncxdata = future.result();
-
-    if (ncxdata.isEmpty()) {
-        ShowMessageOnStatusBar(tr("NCX and Guide generation failed."));
-        QApplication::restoreOverrideCursor();
-        return false;
-    }
-
-    ncx_resource->SetText(ncxdata);
+    // the nav is parsed here rather than handed to python as it
+    // may be large and NavProcessor already knows how to read it
+    ncx_resource->GenerateNCXFromNav(m_Book.data(), nav_resource);
     ncx_resource->SaveToDisk();
 
     // now create the opf guide from the nav
@@ -2663,6 +2747,9 @@ void MainWindow::CreateIndex()
         }
     }
 
+    TRACE_OPERATION(operation, "MainWindow::CreateIndex", tr("Generate Index"));
+    operation.AddArg("files", html_resources.count());
+
     // Close the tab so the focus saving doesn't overwrite the text were
     // replacing in the resource.
     if (index_resource != NULL) {
@@ -2685,7 +2772,14 @@ void MainWindow::CreateIndex()
 
     // Scan the book, add ids for any tag containing at least one index entry and store the
     // document index entry at the same time (including custom and from the index editor).
-    if (!Index::BuildIndex(html_resources)) {
+    // GetEntries creates each entry with new so we must clean them up.
+    QList<IndexEditorModel::indexEntry> index_terms;
+    foreach(IndexEditorModel::indexEntry * entry, IndexEditorModel::instance()->GetEntries()) {
+        index_terms.append(*entry);
+        delete entry;
+    }
+    IndexEntries index_entries;
+    if (!Index::BuildIndex(html_resources, index_terms, index_entries)) {
         QApplication::restoreOverrideCursor();
         return;
     }
@@ -2695,7 +2789,7 @@ void MainWindow::CreateIndex()
     QString stylebookpath = styleresource->GetRelativePath();
 
     // Write out the HTML index file.
-    IndexHTMLWriter index(indexbookpath, stylebookpath);
+    IndexHTMLWriter index(indexbookpath, stylebookpath, &index_entries);
     index_resource->SetText(index.WriteXML(version));
 
     // Normally Setting a semantic on a resource that already has it set will remove the semantic.
@@ -2729,10 +2823,15 @@ void MainWindow::DeleteReportsStyles(QList<BookReports::StyleData *> reports_sty
     DeleteStyles delete_styles(css_styles_to_delete, this);
     connect(&delete_styles, SIGNAL(OpenFileRequest(QString, int, int)), this, SLOT(OpenFile(QString, int, int)));
 
-    if (delete_styles.exec() != QDialog::Accepted) {
+    bool accepted = delete_styles.exec() == QDialog::Accepted;
+
+    // the dialog hands back its own copies of the marked selectors
+    foreach(const QList<CSSInfo::CSSSelector *> &selectors, css_styles_to_delete) {
+        qDeleteAll(selectors);
+    }
+    if (!accepted) {
         return;
     }
-
     css_styles_to_delete = delete_styles.GetStylesToDelete();
 
     if (css_styles_to_delete.count() < 1) {
@@ -2742,11 +2841,10 @@ void MainWindow::DeleteReportsStyles(QList<BookReports::StyleData *> reports_sty
     QApplication::setOverrideCursor(Qt::WaitCursor);
 
     // Actually delete the styles
-    QHashIterator<QString, QList<CSSInfo::CSSSelector *>> stylesheets_to_delete(css_styles_to_delete);
+    DeleteCSSStyles(css_styles_to_delete);
 
-    while (stylesheets_to_delete.hasNext()) {
-        stylesheets_to_delete.next();
-        DeleteCSSStyles(stylesheets_to_delete.key(), stylesheets_to_delete.value());
+    foreach(const QList<CSSInfo::CSSSelector *> &selectors, css_styles_to_delete) {
+        qDeleteAll(selectors);
     }
 
     ShowMessageOnStatusBar(tr("Styles deleted."));
@@ -2784,6 +2882,69 @@ void MainWindow::ReportsDialog()
     m_Reports->activateWindow();
 }
 
+void MainWindow::RenderProofs()
+{
+    QList<Resource *> resources = GetAllHTMLResources();
+    if (resources.isEmpty()) {
+        return;
+    }
+    QStringList formats = QStringList() << tr("PDF") << tr("PNG");
+    bool ok;
+    QString format = QInputDialog::getItem(this, tr("Render Proofs"), tr("Render each HTML file as:"),
+                                           formats, 0, false, &ok);
+    if (!ok) {
+        return;
+    }
+    QFileDialog::Options options = QFileDialog::Options() | QFileDialog::ShowDirsOnly;
+#ifdef Q_OS_MAC
+    options = options | QFileDialog::DontUseNativeDialog;
+#endif
+    QString dirname = QFileDialog::getExistingDirectory(this, tr("Choose the directory to save the proofs to"),
+                                                        m_LastFolderOpen, options);
+    if (dirname.isEmpty()) {
+        return;
+    }
+
+    // the proofs are rendered from the files on disk
+    SaveTabData();
+    m_Book->GetFolderKeeper()->SuspendWatchingResources();
+    m_Book->SaveAllResourcesToDisk();
+    m_Book->GetFolderKeeper()->ResumeWatchingResources();
+
+    bool as_pdf = (format == formats.at(0));
+    QString suffix = as_pdf ? ".pdf" : ".png";
+    QList<BatchRenderer::Job> jobs;
+    int order = 1;
+    foreach(Resource *resource, resources) {
+        // numbered so the proofs list in reading order
+        BatchRenderer::Job job;
+        job.fullpath = resource->GetFullPath();
+        job.output_path = dirname + "/" + QString("%1_").arg(order++, 3, 10, QChar('0')) +
+                          QFileInfo(resource->Filename()).completeBaseName() + suffix;
+        jobs << job;
+    }
+
+    BatchRenderer renderer;
+    QProgressDialog progress(tr("Rendering proofs..."), tr("Cancel"), 0, jobs.count(), this);
+    progress.setValue(0);
+    QEventLoop loop;
+    connect(&renderer, SIGNAL(Progress(int)), &progress, SLOT(setValue(int)));
+    connect(&progress, SIGNAL(canceled()), &renderer, SLOT(Cancel()));
+    connect(&renderer, SIGNAL(Finished()), &loop, SLOT(quit()));
+    renderer.Start(jobs, as_pdf ? BatchRenderer::PDF_OUTPUT : BatchRenderer::PNG_OUTPUT);
+    if (renderer.IsRunning()) {
+        loop.exec();
+    }
+    bool cancelled = progress.wasCanceled();
+    progress.reset();
+
+    QStringList failed = renderer.GetFailed();
+    if (!failed.isEmpty() && !cancelled) {
+        Utility::warning(this, tr("Sigil"), tr("%n proof(s) could not be rendered.", "", failed.count()));
+    }
+    ShowMessageOnStatusBar(tr("%n proof(s) rendered.", "", jobs.count() - failed.count()));
+}
+
 // This routine accepts a file_path that is a book path
 void MainWindow::OpenFile(QString bookpath, int line, int position)
 {
@@ -2824,32 +2985,27 @@ void MainWindow::DeleteFilenames(QStringList files_to_delete)
     RemoveResources(resources);
 }
 
-bool MainWindow::DeleteCSSStyles(const QString &bookpath, QList<CSSInfo::CSSSelector *> css_selectors)
+bool MainWindow::DeleteCSSStyles(const QHash<QString, QList<CSSInfo::CSSSelector *>> &css_styles_to_delete)
 {
     // Save our tabs data as we will be modifying the underlying resources
     SaveTabData();
     bool is_modified = false;
-    bool is_found = false;
-    // Try our CSS resources first as most likely place for a style
-    QList<Resource *> css_resources = m_BookBrowser->AllCSSResources();
-    foreach(Resource * resource, css_resources) {
-        if (resource->GetRelativePath() == bookpath) {
-            CSSResource *css_resource = qobject_cast<CSSResource *>(resource);
-            is_found = true;
-            is_modified = css_resource->DeleteCSStyles(css_selectors);
-            break;
+    QHashIterator<QString, QList<CSSInfo::CSSSelector *>> stylesheets_to_delete(css_styles_to_delete);
+    while (stylesheets_to_delete.hasNext()) {
+        stylesheets_to_delete.next();
+        Resource *resource = m_Book->GetFolderKeeper()->GetResourceByBookPathNoThrow(stylesheets_to_delete.key());
+        if (!resource) {
+            continue;
         }
-    }
-
-    if (!is_found) {
-        // Try an inline style instead
-        QList<Resource *> html_resources = GetAllHTMLResources();
-        foreach(Resource * resource, html_resources) {
-            if (resource->GetRelativePath() == bookpath) {
-                HTMLResource *html_resource = qobject_cast<HTMLResource *>(resource);
-                is_modified = html_resource->DeleteCSStyles(css_selectors);
-                break;
-            }
+        // Stylesheets are the most likely place for a style, else it is an inline style
+        CSSResource *css_resource = qobject_cast<CSSResource *>(resource);
+        if (css_resource) {
+            is_modified = css_resource->DeleteCSStyles(stylesheets_to_delete.value()) || is_modified;
+            continue;
+        }
+        HTMLResource *html_resource = qobject_cast<HTMLResource *>(resource);
+        if (html_resource) {
+            is_modified = html_resource->DeleteCSStyles(stylesheets_to_delete.value()) || is_modified;
         }
     }
 
@@ -2882,8 +3038,7 @@ bool MainWindow::DeleteUnusedMedia(bool in_automate)
     foreach(Resource *resource, css_resources) {
         CSSResource *css_resource = qobject_cast<CSSResource *>(resource);
         QString startdir = css_resource->GetFolder();
-        CSSInfo css_info(css_resource->GetText());
-            QStringList urllist = css_info.getAllPropertyValues("");
+        QStringList urllist = css_resource->GetCSSInfo()->getAllPropertyValues("");
             foreach (QString url, urllist) {
                 QRegularExpressionMatch match = url_file_search.match(url);
                 if (match.hasMatch()) {
@@ -2924,6 +3079,47 @@ bool MainWindow::DeleteUnusedMedia(bool in_automate)
     return true;
 }
 
+bool MainWindow::MergeDuplicateFiles()
+{
+    SaveTabData();
+    if (!m_Book.data()->GetNonWellFormedHTMLFiles().isEmpty()) {
+        Utility::warning(this, tr("Sigil"), tr("Merge Duplicate Files cancelled due to XML not well formed."));
+        return false;
+    }
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QList<QList<Resource *>> groups = m_Book->GetDuplicateResources();
+    QApplication::restoreOverrideCursor();
+
+    if (groups.isEmpty()) {
+        Utility::information(this, tr("Sigil"), tr("There are no duplicate files to merge."));
+        return true;
+    }
+
+    int count = 0;
+    foreach(const QList<Resource *> &group, groups) {
+        count += group.count() - 1;
+    }
+    QMessageBox::StandardButton button_pressed;
+    button_pressed = Utility::question(this, tr("Sigil"),
+                                       tr("%n file(s) have the same contents as another file in the book.\n\n"
+                                          "Change all links to them to use the file that is kept and then delete them?", "", count));
+    if (button_pressed != QMessageBox::Yes) {
+        return false;
+    }
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QList<Resource *> duplicates = m_Book->MergeDuplicateResources(groups);
+    QApplication::restoreOverrideCursor();
+
+    // the duplicates are no longer used so deleting them is safe
+    // whichever of them are picked
+    RemoveResources(duplicates);
+    ShowMessageOnStatusBar(tr("Duplicate files merged."));
+    return true;
+}
+
+
 bool MainWindow::DeleteUnusedStyles(bool in_automate)
 {
     SaveTabData();
@@ -2936,12 +3132,16 @@ bool MainWindow::DeleteUnusedStyles(bool in_automate)
     QStringList activeclassselectors = m_Book->GetOPF()->GetMediaOverlayActiveClassSelectors();
     
     // This one handles all selector types
-    QList<BookReports::StyleData *> css_selector_usage = BookReports::GetAllCSSSelectorsUsed(m_Book, true);
+    QList<BookReports::SelectorUsage> css_selector_usage = BookReports::GetAllCSSSelectorsUsed(m_Book, true);
     QList<BookReports::StyleData *> css_selectors_to_delete;
-    foreach(BookReports::StyleData *selector, css_selector_usage) {
-        if (selector->html_filename.isEmpty()) {
-            if (!activeclassselectors.contains(selector->css_selector_text)) {
-                css_selectors_to_delete.append(selector);
+    foreach(const BookReports::SelectorUsage &selector, css_selector_usage) {
+        if (selector.html_filename.isEmpty()) {
+            if (!activeclassselectors.contains(selector.css_selector_text)) {
+                BookReports::StyleData *style = new BookReports::StyleData();
+                style->css_filename = selector.css_filename;
+                style->css_selector_text = selector.css_selector_text;
+                style->css_selector_position = selector.css_selector_position;
+                css_selectors_to_delete.append(style);
             }
         }
     }
@@ -2955,7 +3155,7 @@ bool MainWindow::DeleteUnusedStyles(bool in_automate)
             Utility::information(this, tr("Sigil"), tr("There are no unused stylesheet selectors to delete."));
         }
     }
-    qDeleteAll(css_selector_usage);
+    qDeleteAll(css_selectors_to_delete);
     return true;
 }
 
@@ -3669,6 +3869,70 @@ h->ShortPathName()));
     QApplication::restoreOverrideCursor();
 }
 
+void MainWindow::SetLanguageOfResources(QList <Resource *> resources)
+{
+    if (resources.isEmpty()) {
+        return;
+    }
+
+    SaveTabData();
+
+    // Check if data is well formed before saving
+    foreach (Resource *r, resources) {
+        HTMLResource *h = qobject_cast<HTMLResource *>(r);
+        if (!h) {
+            continue;
+        }
+        if (!h->FileIsWellFormed()) {
+            Utility::warning(this, tr("Sigil"), tr("Set Language cancelled: %1, XML not well formed.").arg(h->ShortPathName()));
+            return;
+        }
+    }
+
+    // Choose the language, offering the primary language of the book first
+    Language *lang = Language::instance();
+    QString none_name = tr("(none)");
+    QStringList langnames = QStringList() << none_name << lang->GetSortedPrimaryLanguageNames();
+    QString primary_name = lang->GetLanguageName(m_Book->GetOPF()->GetPrimaryBookLanguage());
+    int current = primary_name.isEmpty() ? 0 : qMax(0, langnames.indexOf(primary_name));
+    bool ok;
+    QString langname = QInputDialog::getItem(this, tr("Set Language"), tr("Language of the selected file(s):"),
+                                             langnames, current, false, &ok);
+    if (!ok) {
+        return;
+    }
+    QString langcode = langname == none_name ? QString() : lang->GetLanguageCode(langname, langname);
+
+    Resource *current_resource = NULL;
+    ContentTab *tab = m_TabManager->GetCurrentContentTab();
+
+    if (tab != NULL) {
+        current_resource = tab->GetLoadedResource();
+    }
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    // Convert HTML resources into HTMLResource types
+    QList<HTMLResource *>html_resources;
+    foreach(Resource *resource, resources) {
+        html_resources.append(qobject_cast<HTMLResource *>(resource));
+    }
+    QList<HTMLResource *> changed_resources = LanguageUpdates::UpdateLanguageInAllFiles(html_resources, langcode);
+
+    // The files left alone keep their text, and with it their cached spellcheck and counts
+    if (!changed_resources.isEmpty()) {
+        m_Book->SetModified();
+        m_BookBrowser->Refresh();
+        HTMLResource *current_html_resource = qobject_cast<HTMLResource *>(current_resource);
+        if (current_html_resource && changed_resources.contains(current_html_resource)) {
+            OpenResource(current_resource);
+        }
+    }
+
+    SelectResources(resources);
+    QApplication::restoreOverrideCursor();
+    ShowMessageOnStatusBar(tr("Language set in %n file(s).", "", changed_resources.count()));
+}
+
 QList<std::pair<QString, bool>> MainWindow::GetJavascriptsMap(QList<Resource *> resources)
 {
     QList<std::pair<QString, bool>> javascript_map;
@@ -3778,6 +4042,7 @@ bool MainWindow::GenerateTOC(bool skip_selector)
 
         is_headings_changed = toc.IsBookChanged();
     }
+    TRACE_OPERATION(operation, "MainWindow::GenerateTOC", tr("Generate TOC"));
     QApplication::setOverrideCursor(Qt::WaitCursor);
 
     bool is_toc_changed = false;
@@ -4051,6 +4316,42 @@ void MainWindow::SigilWebsite()
 }
 
 
+void MainWindow::ShowMemoryUsage()
+{
+    SaveTabData();
+    MemoryUsageDialog dialog(m_Book, this);
+    dialog.exec();
+}
+
+
+void MainWindow::TraceMemoryUsage()
+{
+    MemoryUsage::AddToTrace(MemoryUsage::Collect(m_Book, this));
+}
+
+
+void MainWindow::ShowPerformanceHistory()
+{
+    if (!m_PerformanceHistory) {
+        m_PerformanceHistory = new PerformanceHistory(this);
+    }
+    m_PerformanceHistory->show();
+    m_PerformanceHistory->raise();
+    m_PerformanceHistory->activateWindow();
+}
+
+
+void MainWindow::OperationFinished(const OperationLog::Entry &entry)
+{
+    QWidget *active = QApplication::activeWindow();
+    if (!active || ((active != this) && (active->parentWidget() != this))) {
+        return;
+    }
+    m_lbOperationTime->setText(tr("%1: %2").arg(entry.label, OperationLog::FormatDuration(entry.milliseconds)));
+    m_lbOperationTime->show();
+}
+
+
 void MainWindow::AboutDialog()
 {
     About about(this);
@@ -4085,7 +4386,8 @@ void MainWindow::PreferencesDialog()
     }
     if (prefers.isReloadPreviewRequired()) {
         if (m_PreviewWindow) {
-            UpdatePreview();
+            // reloads its preferences and asks for the page again
+            m_PreviewWindow->ReloadPreview();
         }
     }
 
@@ -4188,7 +4490,7 @@ bool MainWindow::RenameClassInHtml(const QString& oldname, const QString& newnam
     return m_Book->RenameClassInHTML(css_bookpath, oldname, newname);
 }
 
-bool MainWindow::ReformatAllStylesheets(bool multiple_line_format)
+bool MainWindow::ReformatAllStylesheets(CSSInfo::CSSFormat format, bool include_style_blocks)
 {
     SaveTabData();
     QList<Resource *> css_resources = m_BookBrowser->AllCSSResources();
@@ -4198,9 +4500,12 @@ bool MainWindow::ReformatAllStylesheets(bool multiple_line_format)
         return true;
     }
 
-    foreach(Resource * resource, css_resources) {
-        CSSResource *css_resource = qobject_cast<CSSResource *>(resource);
-        css_resource->ReformatCSS(multiple_line_format);
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QStringList parse_errors = m_Book->ReformatAllStylesheets(format, include_style_blocks);
+    QApplication::restoreOverrideCursor();
+    if (!parse_errors.isEmpty()) {
+        Utility::DisplayStdWarningDialog(tr("CSS Error: "),
+                                         tr("These files could not be parsed and were not changed:") + "\n" + parse_errors.join("\n"));
     }
     return true;
 }
@@ -4213,6 +4518,15 @@ void MainWindow::ChangeSignalsWhenTabChanges(ContentTab *old_tab, ContentTab *ne
     MakeTabConnections(new_tab);
     // Clear selection if the tab changed.
     ClearMarkedText(old_tab);
+    // Check the file just left now, in the background, so a save
+    // soon after finds its well formed verdict already kept
+    if (old_tab && !m_Book.isNull()) {
+        XMLResource *xml_resource = qobject_cast<XMLResource *>(old_tab->GetLoadedResource());
+        if (xml_resource) {
+            m_Book->GetFolderKeeper()->GetWellFormedMonitor()->CheckNow(xml_resource);
+        }
+    }
+    UpdateTextCountsLabel();
 }
 
 
@@ -4547,9 +4861,9 @@ void MainWindow::SetStateActionsStaticView()
 void MainWindow::SetupPreviewTimer()
 {
     SettingsStore ss;
-    int tv = ss.uiPreviewTimeout();
+    m_PreviewTimeout = ss.uiPreviewTimeout();
     m_PreviewTimer.setSingleShot(true);
-    m_PreviewTimer.setInterval(tv);
+    m_PreviewTimer.setInterval(m_PreviewTimeout);
     connect(&m_PreviewTimer, SIGNAL(timeout()), this, SLOT(UpdatePreview()));
     m_PreviewTimer.stop();
 }
@@ -4560,7 +4874,17 @@ void MainWindow::UpdatePreviewRequest()
     if (m_PreviewTimer.isActive()) {
         m_PreviewTimer.stop();
     }
-    m_PreviewTimer.start();
+    // leave the renderer to the page being edited
+    if (m_PreviewWindow) {
+        m_PreviewWindow->CancelPrefetch();
+    }
+    // wait at least as long as the last page took to show, so that
+    // typing into a slow page does not keep the Preview reloading
+    int delay = m_PreviewTimeout;
+    if (m_PreviewWindow) {
+        delay = qBound<qint64>(m_PreviewTimeout, m_PreviewWindow->LastUpdateDuration(), MAX_PREVIEW_DELAY);
+    }
+    m_PreviewTimer.start(delay);
 }
 
 void MainWindow::UpdatePreviewCSSRequest()
@@ -4668,6 +4992,23 @@ void MainWindow::UpdatePreview()
     }
 }
 
+void MainWindow::PrefetchNextPreviewPage()
+{
+    if (m_IsClosing || !m_PreviousHTMLResource) return;
+
+    QString bookpath = m_PreviousHTMLResource->GetRelativePath();
+    QStringList spine = m_Book->GetOPF()->GetSpineOrderBookPaths();
+    int pos = spine.indexOf(bookpath);
+    if ((pos < 0) || (pos + 1 >= spine.count())) return;
+
+    HTMLResource *next_resource = qobject_cast<HTMLResource *>(
+        m_Book->GetFolderKeeper()->GetResourceByBookPathNoThrow(spine.at(pos + 1)));
+    if (!next_resource) return;
+
+    DBG qDebug() << "MW: prefetching " << next_resource->GetRelativePath();
+    m_PreviewWindow->PrefetchPage(next_resource->GetFullPath(), next_resource->GetText());
+}
+
 void MainWindow::InspectHTML()
 {
     m_PreviewWindow->show();
@@ -4688,6 +5029,29 @@ void MainWindow::UpdateCursorPositionLabel(int line, int column)
     }
 }
 
+void MainWindow::UpdateTextCountsLabel()
+{
+    if (!m_lbTextCounts || m_Book.isNull()) {
+        return;
+    }
+    TextCountMonitor *monitor = m_Book->GetFolderKeeper()->GetTextCountMonitor();
+    TextCountMonitor::Counts book_counts = monitor->GetBookCounts();
+    HTMLResource *html_resource = NULL;
+    ContentTab *tab = GetCurrentContentTab();
+    if (tab) {
+        html_resource = qobject_cast<HTMLResource *>(tab->GetLoadedResource());
+    }
+    if (html_resource) {
+        TextCountMonitor::Counts counts = monitor->GetCounts(html_resource);
+        m_lbTextCounts->setText(tr("Words: %L1 of %L2, Characters: %L3 of %L4")
+                                .arg(counts.words).arg(book_counts.words)
+                                .arg(counts.characters).arg(book_counts.characters));
+    } else {
+        m_lbTextCounts->setText(tr("Words: %L1, Characters: %L2")
+                                .arg(book_counts.words).arg(book_counts.characters));
+    }
+}
+
 void MainWindow::SliderZoom(int slider_value)
 {
     ContentTab *tab = m_TabManager->GetCurrentContentTab();
@@ -4843,10 +5207,11 @@ bool MainWindow::SplitOnSGFSectionMarkers()
     QList<Resource *> changed_resources;
     foreach(Resource * resource, html_resources) {
         HTMLResource *html_resource = qobject_cast<HTMLResource *>(resource);
-        QStringList new_sections = html_resource->SplitOnSGFSectionMarkers();
+        QList<QStringList> section_ids;
+        QStringList new_sections = html_resource->SplitOnSGFSectionMarkers(&section_ids);
 
         if (!new_sections.isEmpty()) {
-            m_Book->CreateNewSections(new_sections, html_resource);
+            m_Book->CreateNewSections(new_sections, html_resource, section_ids);
             changed_resources.append(resource);
         }
     }
@@ -5074,6 +5439,7 @@ void MainWindow::SetNewBook(QSharedPointer<Book> new_book)
     m_TabManager->CloseOtherTabs();
     m_TabManager->CloseAllTabs(true);
     m_Book = new_book;
+    m_AutosaveJournal->SetBook(m_Book);
     m_BookBrowser->SetBook(m_Book);
     m_TableOfContents->SetBook(m_Book);
     m_ValidationResultsView->SetBook(m_Book);
@@ -5085,12 +5451,19 @@ void MainWindow::SetNewBook(QSharedPointer<Book> new_book)
     ResetLinkOrStyleBookmark();
     SettingsStore settings;
     settings.setRenameTemplate("");
+    // get the dictionaries of the book's languages opening while it is shown
+    if (settings.spellCheck()) {
+        sc->preloadDictionaries(m_Book->GetConstOPF()->GetDCMetadataValues("dc:language"));
+    }
     connect(m_Book.data(),     SIGNAL(ModifiedStateChanged(bool)), this, SLOT(setWindowModified(bool)));
     connect(m_Book.data(),     SIGNAL(ResourceUpdatedFromDiskRequest(Resource *)), this, SLOT(ResourceUpdatedFromDisk(Resource *)));
     connect(m_BookBrowser,     SIGNAL(ShowStatusMessageRequest(const QString &, int)), this, SLOT(ShowMessageOnStatusBar(const QString &, int)));
     connect(m_BookBrowser,     SIGNAL(ResourcesDeleted()), this, SLOT(ResourcesAddedOrDeletedOrMoved()));
     connect(m_BookBrowser,     SIGNAL(ResourcesAdded()), this, SLOT(ResourcesAddedOrDeletedOrMoved()));
     connect(m_BookBrowser,     SIGNAL(ResourcesMoved()), this, SLOT(ResourcesAddedOrDeletedOrMoved()));
+    connect(m_Book->GetFolderKeeper()->GetTextCountMonitor(), SIGNAL(CountsChanged()),
+            this, SLOT(UpdateTextCountsLabel()));
+    UpdateTextCountsLabel();
 }
 
 void MainWindow::ResourcesAddedOrDeletedOrMoved()
@@ -5338,6 +5711,7 @@ void MainWindow::SetValidationResults(const QList<ValidationResult> &results)
 
 bool MainWindow::SaveFile(const QString &fullfilepath, bool update_current_filename)
 {
+    TRACE_OPERATION(operation, "MainWindow::SaveFile", tr("Save"));
     SettingsStore ss;
 
     try {
@@ -5402,6 +5776,7 @@ bool MainWindow::SaveFile(const QString &fullfilepath, bool update_current_filen
         if (update_current_filename) {
             m_Book->SetModified(false);
             UpdateUiWithCurrentFile(fullfilepath);
+            m_AutosaveJournal->BookSaved();
         }
 
         if (not_well_formed) {
@@ -5573,6 +5948,9 @@ void MainWindow::UpdateUiWithCurrentFile(const QString &fullfilepath, bool just_
         m_CurrentFilePath = fullfilepath;
         m_CurrentFileName = m_CurrentFilePath.isEmpty() ? DEFAULT_FILENAME : QFileInfo(m_CurrentFilePath).fileName();
     }
+    if (isActiveWindow()) {
+        OperationLog::instance()->SetCurrentBook(m_CurrentFileName);
+    }
     QString epubversion = m_Book->GetConstOPF()->GetEpubVersion();
 
     // Update the titlebar
@@ -5581,6 +5959,7 @@ void MainWindow::UpdateUiWithCurrentFile(const QString &fullfilepath, bool just_
     } else {
         setWindowTitle(tr("%1[*] - epub%2 - %3").arg(m_CurrentFileName).arg(epubversion).arg(tr("Sigil")));
     }
+    m_AutosaveJournal->SetEpubPath(m_CurrentFilePath);
     if (m_CurrentFilePath.isEmpty()) {
         return;
     }
@@ -5877,6 +6256,13 @@ void MainWindow::ExtendUI()
     ui.menuToolbars->addAction(ui.toolBarIndexActions->toggleViewAction());
     ui.menuToolbars->addAction(ui.toolBarAutomate->toggleViewAction());
     ui.toolBarClips->setVisible(false);
+    m_lbOperationTime = new QLabel(QString(""), statusBar());
+    m_lbOperationTime->setToolTip(tr("How long the last book wide operation took, see Help > Performance History"));
+    m_lbOperationTime->hide();
+    statusBar()->addPermanentWidget(m_lbOperationTime);
+    m_lbTextCounts = new QLabel(QString(""), statusBar());
+    m_lbTextCounts->setToolTip(tr("Words and characters, not counting spaces, in the current file and in the whole book"));
+    statusBar()->addPermanentWidget(m_lbTextCounts);
     m_lbCursorPosition = new QLabel(QString(""), statusBar());
     statusBar()->addPermanentWidget(m_lbCursorPosition);
     UpdateCursorPositionLabel(0, 0);
@@ -6016,6 +6402,7 @@ void MainWindow::ExtendUI()
     sm->registerAction(this, ui.actionIgnoreMisspelledWord, "MainWindow.IgnoreMispelledWord");
     sm->registerAction(this, ui.actionClearIgnoredWords, "MainWindow.ClearIgnoredWords");
     sm->registerAction(this, ui.actionReports, "MainWindow.Reports");
+    sm->registerAction(this, ui.actionRenderProofs, "MainWindow.RenderProofs");
     sm->registerAction(this, ui.actionSearchEditor, "MainWindow.SearchEditor");
     sm->registerAction(this, ui.actionClipEditor, "MainWindow.ClipEditor");
     sm->registerAction(this, ui.actionAddToIndex, "MainWindow.AddToIndex");
@@ -6023,6 +6410,7 @@ void MainWindow::ExtendUI()
     sm->registerAction(this, ui.actionCreateIndex, "MainWindow.CreateIndex");
     sm->registerAction(this, ui.actionDeleteUnusedMedia, "MainWindow.DeleteUnusedMedia");
     sm->registerAction(this, ui.actionDeleteUnusedStyles, "MainWindow.DeleteUnusedStyles");
+    sm->registerAction(this, ui.actionMergeDuplicateFiles, "MainWindow.MergeDuplicateFiles");
     // View
     sm->registerAction(this, ui.actionZoomIn, "MainWindow.ZoomIn");
     sm->registerAction(this, ui.actionZoomOut, "MainWindow.ZoomOut");
@@ -6060,6 +6448,8 @@ void MainWindow::ExtendUI()
     sm->registerAction(this, ui.actionTutorials, "MainWindow.FAQ");
     sm->registerAction(this, ui.actionDonate, "MainWindow.Donate");
     sm->registerAction(this, ui.actionSigilWebsite, "MainWindow.SigilWebsite");
+    sm->registerAction(this, ui.actionMemoryUsage, "MainWindow.MemoryUsage");
+    sm->registerAction(this, ui.actionPerformanceHistory, "MainWindow.PerformanceHistory");
     sm->registerAction(this, ui.actionAbout, "MainWindow.About");
 
     // Clips
@@ -6176,6 +6566,7 @@ void MainWindow::changeEvent(QEvent *e)
     if (e->type() == QEvent::ActivationChange) {
         if(isActiveWindow()) {
             DWINGEO qDebug() << "Main Window is transitioning from inactive to active: ";
+            OperationLog::instance()->SetCurrentBook(m_CurrentFileName);
 
             if (m_FirstTime) {
                 if (!m_LastState.isEmpty()) restoreState(m_LastState);
@@ -6232,6 +6623,7 @@ void MainWindow::ConnectSignalsToSlots()
     connect(m_PreviewWindow, SIGNAL(ZoomFactorChanged(float)),     this, SLOT(UpdateZoomSlider(float)));
     connect(m_PreviewWindow, SIGNAL(GoToPreviewLocationRequest()), this, SLOT(GoToPreviewLocation()));
     connect(m_PreviewWindow, SIGNAL(RequestPreviewReload()),       this, SLOT(UpdatePreview())); 
+    connect(m_PreviewWindow, SIGNAL(PageShown()),                  this, SLOT(PrefetchNextPreviewPage()));
     connect(m_PreviewWindow, SIGNAL(OpenUrlRequest(const QUrl &)), this, SLOT(OpenUrl(const QUrl &)));
     connect(m_PreviewWindow, SIGNAL(ScrollToFragmentRequest(const QString &)), this, SLOT(ScrollCVToFragment(const QString &)));
     connect(qApp, SIGNAL(focusChanged(QWidget *, QWidget *)), this, SLOT(ApplicationFocusChanged(QWidget *, QWidget *)));
@@ -6300,6 +6692,9 @@ void MainWindow::ConnectSignalsToSlots()
     connect(ui.actionUserGuide,     SIGNAL(triggered()), this, SLOT(UserGuide()));
     connect(ui.actionDonate,        SIGNAL(triggered()), this, SLOT(Donate()));
     connect(ui.actionSigilWebsite,  SIGNAL(triggered()), this, SLOT(SigilWebsite()));
+    connect(ui.actionMemoryUsage,   SIGNAL(triggered()), this, SLOT(ShowMemoryUsage()));
+    connect(ui.actionPerformanceHistory, SIGNAL(triggered()), this, SLOT(ShowPerformanceHistory()));
+    connect(OperationLog::instance(), &OperationLog::EntryAdded, this, &MainWindow::OperationFinished);
     connect(ui.actionAbout,         SIGNAL(triggered()), this, SLOT(AboutDialog()));
     // Tools
     connect(ui.actionStandardize,   SIGNAL(triggered()), this, SLOT(StandardizeEpub()));
@@ -6322,6 +6717,7 @@ void MainWindow::ConnectSignalsToSlots()
     connect(ui.actionEditTOC,       SIGNAL(triggered()), this, SLOT(EditTOCDialog()));
     connect(ui.actionCreateHTMLTOC, SIGNAL(triggered()), this, SLOT(CreateHTMLTOC()));
     connect(ui.actionReports,       SIGNAL(triggered()), this, SLOT(ReportsDialog()));
+    connect(ui.actionRenderProofs,  SIGNAL(triggered()), this, SLOT(RenderProofs()));
     connect(ui.actionClipEditor,    SIGNAL(triggered()), this, SLOT(ClipEditorDialog()));
     connect(ui.actionSearchEditor,  SIGNAL(triggered()), this, SLOT(SearchEditorDialog()));
     connect(ui.actionIndexEditor,   SIGNAL(triggered()), this, SLOT(IndexEditorDialog()));
@@ -6329,6 +6725,7 @@ void MainWindow::ConnectSignalsToSlots()
     connect(ui.actionCreateIndex,   SIGNAL(triggered()), this, SLOT(CreateIndex()));
     connect(ui.actionDeleteUnusedMedia,    SIGNAL(triggered()), this, SLOT(DeleteUnusedMedia()));
     connect(ui.actionDeleteUnusedStyles,    SIGNAL(triggered()), this, SLOT(DeleteUnusedStyles()));
+    connect(ui.actionMergeDuplicateFiles,   SIGNAL(triggered()), this, SLOT(MergeDuplicateFiles()));
     // Change case
     connect(m_casingChangeGroup,    SIGNAL(triggered(QAction*)), this, SLOT(ChangeCasing(QAction*)));
     // View
@@ -6391,6 +6788,7 @@ void MainWindow::ConnectSignalsToSlots()
             this, SLOT(OpenResource(Resource *)));
     connect(m_BookBrowser, SIGNAL(MergeResourcesRequest(QList<Resource *>)), this, SLOT(MergeResources(QList<Resource *>)));
     connect(m_BookBrowser, SIGNAL(LinkStylesheetsToResourcesRequest(QList<Resource *>)), this, SLOT(LinkStylesheetsToResources(QList<Resource *>)));
+    connect(m_BookBrowser, SIGNAL(SetLanguageOfResourcesRequest(QList<Resource *>)), this, SLOT(SetLanguageOfResources(QList<Resource *>)));
     connect(m_BookBrowser, SIGNAL(LinkJavascriptsToResourcesRequest(QList<Resource *>)), this, SLOT(LinkJavascriptsToResources(QList<Resource *>)));
     connect(m_BookBrowser, SIGNAL(RemoveResourcesRequest()), this, SLOT(RemoveResources()));
     connect(m_BookBrowser, SIGNAL(OpenFileRequest(QString, int, int)), this, SLOT(OpenFile(QString, int, int)));
@@ -6420,6 +6818,7 @@ void MainWindow::ConnectSignalsToSlots()
     connect(m_SearchEditor, SIGNAL(LoadSelectedSearchRequest(SearchEditorModel::searchEntry *)),
             m_FindReplace,   SLOT(LoadSearch(SearchEditorModel::searchEntry *)));
     connect(m_SearchEditor, SIGNAL(RestartSearch()), m_FindReplace, SLOT(DoRestart()));
+    connect(m_SearchEditor, SIGNAL(CurrentEntriesChanged()), m_FindReplace, SLOT(PrecompileSelectedSearches()));
     connect(m_SearchEditor, SIGNAL(CountsReportCountRequest(SearchEditorModel::searchEntry*, int&)),
             m_FindReplace, SLOT(CountsReportCount(SearchEditorModel::searchEntry*, int&)));
 
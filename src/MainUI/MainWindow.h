@@ -41,6 +41,7 @@
 #include "MainUI/FindReplace.h"
 #include "MainUI/TOCModel.h"
 #include "Parsers/CSSInfo.h"
+#include "Misc/OperationLog.h"
 #include "Misc/PasteTarget.h"
 #include "Misc/SettingsStore.h"
 #include "Misc/ValidationResult.h"
@@ -60,6 +61,7 @@ class QSignalMapper;
 class QSlider;
 class QTimer;
 class QActionGroup;
+class AutosaveJournal;
 class FindReplace;
 class TabManager;
 class BookBrowser;
@@ -70,6 +72,7 @@ class SearchEditor;
 class ClipEditor;
 class ClipsWindow;
 class SelectCharacter;
+class PerformanceHistory;
 class ViewImage;
 class FlowTab;
 class QWidget;
@@ -392,11 +395,28 @@ private slots:
 
     void ReportsDialog();
 
-    bool DeleteCSSStyles(const QString &filename, QList<CSSInfo::CSSSelector *> css_selectors);
+    /**
+     * Renders every HTML file in reading order to a PDF or PNG
+     * proof in a folder the user picks.
+     */
+    void RenderProofs();
+
+    /**
+     * Removes the given selectors from each stylesheet or html file,
+     * keyed by book path.  Every file is rewritten at most once.
+     */
+    bool DeleteCSSStyles(const QHash<QString, QList<CSSInfo::CSSSelector *>> &css_styles_to_delete);
 
     bool DeleteUnusedMedia(bool in_automate = false);
     bool DeleteUnusedStyles(bool in_automate = false);
 
+    /**
+     * Finds the images, fonts and other binary files that have the
+     * same contents as another file, points every reference to them
+     * at the one file that is kept and offers to delete the rest.
+     */
+    bool MergeDuplicateFiles();
+
     void InsertFileDialog();
 
     void InsertSpecialCharacter();
@@ -468,6 +488,27 @@ private slots:
      */
     void SigilWebsite();
 
+    /**
+     * Shows the memory held by the book, its tabs and the caches.
+     */
+    void ShowMemoryUsage();
+
+    /**
+     * Adds the memory in use to the trace, see Misc/MemoryUsage.h.
+     */
+    void TraceMemoryUsage();
+
+    /**
+     * Offers to recover the edits kept by the autosave journal of a
+     * session that did not end normally, see AutosaveJournal.
+     */
+    void OfferAutosaveRecovery();
+
+    /**
+     * Shows the book wide operations run this session and their times.
+     */
+    void ShowPerformanceHistory();
+
     /**
      * Implements About action functionality.
      */
@@ -491,7 +532,7 @@ private slots:
 
     bool ValidateStylesheetsWithW3C();
 
-    bool ReformatAllStylesheets(bool multiple_line_format);
+    bool ReformatAllStylesheets(CSSInfo::CSSFormat format, bool include_style_blocks = false);
 
     bool CharLessThan(const QChar &s1, const QChar &s2);
 
@@ -551,6 +592,12 @@ private slots:
     void UpdatePreviewCSSRequest();
     void ScrollPreview();
     void UpdatePreview();
+
+    /**
+     * Has Preview load the spine item after the one it shows in the
+     * background, so stepping to it shows at once.
+     */
+    void PrefetchNextPreviewPage();
     void InspectHTML();
 
     /**
@@ -564,6 +611,18 @@ private slots:
      */
     void UpdateCursorPositionLabel(int line, int column);
 
+    /**
+     * Shows the word and character counts of the current html file
+     * and of the book, as last counted in the background.
+     */
+    void UpdateTextCountsLabel();
+
+    /**
+     * Shows how long an operation took in the status bar, when it
+     * ran in this window or a dialog of it.
+     */
+    void OperationFinished(const OperationLog::Entry &entry);
+
     /**
      * Zooms the current view with the new zoom slider value.
      *
@@ -634,6 +693,8 @@ private slots:
 
     void LinkJavascriptsToResources(QList <Resource *> resources);
 
+    void SetLanguageOfResources(QList <Resource *> resources);
+
     void ResourceUpdatedFromDisk(Resource *resource);
 
     void UpdateWord(QString old_word, QString new_word);
@@ -975,6 +1036,16 @@ private:
      */
     QLabel *m_lbCursorPosition;
 
+    /**
+     * The label that displays how long the last operation took.
+     */
+    QLabel *m_lbOperationTime;
+
+    /**
+     * The label that displays the live word and character counts.
+     */
+    QLabel *m_lbTextCounts;
+
     /**
      * The slider which the user can use to zoom.
      */
@@ -1019,6 +1090,9 @@ private:
 
     SelectCharacter *m_SelectCharacter;
 
+    // made when first shown
+    PerformanceHistory *m_PerformanceHistory;
+
     ViewImage *m_ViewImage;
 
     Reports *m_Reports;
@@ -1044,6 +1118,11 @@ private:
 
     QTimer m_PreviewTimer;
 
+    /**
+     * The shortest wait before the Preview is updated, from the preferences.
+     */
+    int m_PreviewTimeout;
+
     HTMLResource *m_PreviousHTMLResource;
     QString m_PreviousHTMLText;
     QList<ElementIndex> m_PreviousHTMLLocation;
@@ -1081,6 +1160,8 @@ private:
     QString m_AutomatePluginParameter;
 
     bool m_inShowLastOpenWarnings = false;
+
+    AutosaveJournal *m_AutosaveJournal;
     
     /**
      * Holds all the widgets Qt Designer created for us.
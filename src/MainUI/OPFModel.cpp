@@ -22,6 +22,8 @@
 
 #include <limits>
 
+#include <QtCore/QReadLocker>
+#include <QtConcurrent/QtConcurrent>
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QFileIconProvider>
 #include <QMessageBox>
@@ -31,6 +33,8 @@
 #include "MainUI/OPFModel.h"
 #include "MainUI/OPFModelItem.h"
 #include "Misc/SettingsStore.h"
+#include "Misc/TaskScheduler.h"
+#include "Misc/Trace.h"
 #include "Misc/Utility.h"
 #include "ResourceObjects/Resource.h"
 #include "ResourceObjects/HTMLResource.h"
@@ -41,6 +45,9 @@
 #include "sigil_exception.h"
 #include "SourceUpdates/UniversalUpdates.h"
 
+// Items whose tooltips are filled in per pass of the event loop
+static const int DECORATION_BATCH_SIZE = 100;
+
 static const QList<QChar> FORBIDDEN_FILENAME_CHARS = QList<QChar>() << '<' << '>' << ':'
         << '"' << '/' << '\\'
         << '|' << '?' << '*';
@@ -62,6 +69,9 @@ OPFModel::OPFModel(QObject *parent)
             this, SLOT(RowsRemovedHandler(const QModelIndex &, int, int)));
     connect(this, SIGNAL(itemChanged(QStandardItem *)),
             this, SLOT(ItemChangedHandler(QStandardItem *)));
+    connect(&m_DecorationWatcher, SIGNAL(finished()), this, SLOT(TooltipSuffixesLoaded()));
+    connect(&m_DecorationTimer, SIGNAL(timeout()), this, SLOT(DecorateNextBatch()));
+    m_DecorationTimer.setInterval(0);
     QList<QStandardItem *> items;
     items.append(m_TextFolderItem);
     items.append(m_StylesFolderItem);
@@ -84,8 +94,22 @@ OPFModel::OPFModel(QObject *parent)
 }
 
 
+OPFModel::~OPFModel()
+{
+    // the worker holds a reference to the book
+    m_DecorationWatcher.waitForFinished();
+    CommitReadingOrders();
+}
+
+
 void OPFModel::SetBook(QSharedPointer<Book> book)
 {
+    // nothing in the old book's model can be kept
+    StopDecorating();
+    CommitReadingOrders();
+    m_RefreshInProgress = true;
+    ClearModel();
+    m_RefreshInProgress = false;
     m_Book = book;
     connect(this, SIGNAL(BookContentModified()), m_Book.data(), SLOT(SetModified()));
     Refresh();
@@ -94,11 +118,15 @@ void OPFModel::SetBook(QSharedPointer<Book> book)
 
 void OPFModel::Refresh()
 {
+    TRACE_SPAN(span, "OPFModel::Refresh");
     m_RefreshInProgress = true;
+    m_DecorationTimer.stop();
+    m_PendingDecorations.clear();
     InitializeModel();
     SortFilesByFilenames();
     SortHTMLFilesByReadingOrder();
     m_RefreshInProgress = false;
+    StartDecorating();
 }
 
 
@@ -298,13 +326,36 @@ void OPFModel::RowsRemovedHandler(const QModelIndex &parent, int start, int end)
         return;
     }
 
+    // A drop removes each moved range of rows on its own, so the spine
+    // is only edited here and written once the drop is done
+    if (!m_SpineEditBook) {
+        m_SpineEditBook = m_Book;
+        m_SpineEditBook->GetOPF()->BeginSpineEdit();
+        QTimer::singleShot(0, this, SLOT(CommitReadingOrders()));
+    }
     UpdateHTMLReadingOrders();
 }
 
 
+void OPFModel::CommitReadingOrders()
+{
+    if (!m_SpineEditBook) {
+        return;
+    }
+    m_SpineEditBook->GetOPF()->CommitSpineEdit();
+    m_SpineEditBook.clear();
+}
+
+
 void OPFModel::ItemChangedHandler(QStandardItem *item)
 {
     Q_ASSERT(item);
+
+    // items updated by a refresh have not been renamed by the user
+    if (m_RefreshInProgress) {
+        return;
+    }
+
     const QString &identifier = item->data().toString();
 
     if (!identifier.isEmpty()) {
@@ -431,7 +482,8 @@ bool OPFModel:: RenameResourceList(const QList<Resource *> &resources, const QSt
     }
 
     if (update.count() > 0) {
-        UniversalUpdates::PerformUniversalUpdates(true, m_Book->GetFolderKeeper()->GetResourceList(), update);
+        UniversalUpdates::PerformUniversalUpdates(true, m_Book->GetFolderKeeper()->GetResourceList(), update,
+                                                   QList<XMLResource *>(), m_Book->GetFolderKeeper()->GetReferenceIndex());
         emit BookContentModified();
     }
 
@@ -520,7 +572,8 @@ bool OPFModel::MoveResourceList(const QList<Resource *> &resources, const QStrin
     }
 
     if (update.count() > 0) {
-        UniversalUpdates::PerformUniversalUpdates(true, m_Book->GetFolderKeeper()->GetResourceList(), update);
+        UniversalUpdates::PerformUniversalUpdates(true, m_Book->GetFolderKeeper()->GetResourceList(), update,
+                                                   QList<XMLResource *>(), m_Book->GetFolderKeeper()->GetReferenceIndex());
         emit BookContentModified();
     }
 
@@ -537,47 +590,43 @@ bool OPFModel::MoveResourceList(const QList<Resource *> &resources, const QStrin
 void OPFModel::InitializeModel()
 {
     Q_ASSERT(m_Book);
-    ClearModel();
     QList<Resource *> resources = m_Book->GetFolderKeeper()->GetResourceList();
     QHash <Resource *, int> reading_order_all = m_Book->GetOPF()->GetReadingOrderAll(resources);
-    QString version = m_Book->GetConstOPF()->GetEpubVersion();
-    QHash <QString, QString> semantic_type_all;
-    QHash <QString, QString> manifest_properties_all;
     SettingsStore ss;
-    if (version.startsWith('3')) {
-        NavProcessor navproc(m_Book->GetConstOPF()->GetNavResource());
-        semantic_type_all = navproc.GetLandmarkNameForPaths();
-        manifest_properties_all = m_Book->GetOPF()->GetManifestPropertiesForPaths();
-    } else { 
-        semantic_type_all = m_Book->GetOPF()->GetGuideSemanticNameForPaths();
-    }
+    bool show_full_path = ss.showFullPathOn();
+
+    // The items already in the model are kept and only updated where
+    // they differ, so the view keeps its selection, expansion and scroll
+    // position and no icons are looked up again.
+    QHash<QString, QStandardItem *> existing_items = GetItemsByIdentifier();
 
     foreach(Resource * resource, resources) {
-        AlphanumericItem * item;
-        QIcon fileicon = m_Book->GetFolderKeeper()->GetFileIconFromMediaType(resource->GetMediaType());
-        if (ss.showFullPathOn()) {
-            item = new AlphanumericItem(fileicon, resource->GetRelativePath());
-        } else {
-            item = new AlphanumericItem(fileicon, resource->ShortPathName());
-        }
-        item->setDropEnabled(false);
-        item->setData(resource->GetIdentifier());
-        QString tooltip = resource->GetRelativePath();
         QString path = resource->GetRelativePath();
-        if (resource->Type() == Resource::FontResourceType) {
-            FontResource* font_res = qobject_cast<FontResource *>(resource);
-            if (font_res) {
-                tooltip = tooltip + " (" + font_res->GetDescription() + ")";
+        QString text = show_full_path ? path : resource->ShortPathName();
+        bool is_top_level = resource->Type() == Resource::OPFResourceType ||
+                            resource->Type() == Resource::NCXResourceType;
+
+        QStandardItem *item = existing_items.take(resource->GetIdentifier());
+        bool is_new = (item == NULL);
+        if (is_new) {
+            QIcon fileicon = m_Book->GetFolderKeeper()->GetFileIconFromMediaType(resource->GetMediaType());
+            item = new AlphanumericItem(fileicon, text);
+            item->setDropEnabled(false);
+            item->setData(resource->GetIdentifier());
+            // the full tooltip is filled in by DecorateNextBatch
+            item->setToolTip(path);
+            if (is_top_level) {
+                item->setEditable(true);
             }
+            if (resource->Type() != Resource::HTMLResourceType) {
+                item->setDragEnabled(false);
+            }
+        } else if (item->text() != text) {
+            item->setText(text);
         }
-
-        if (semantic_type_all.contains(path)) {
-            tooltip += " (" + semantic_type_all[path] + ")";
-        }
-        if (manifest_properties_all.contains(path)) {
-            tooltip += " [" + manifest_properties_all[path] + "]";
+        if (!is_top_level) {
+            m_PendingDecorations.append(resource->GetIdentifier());
         }
-        item->setToolTip(tooltip);
 
         if (resource->Type() == Resource::HTMLResourceType) {
             int reading_order = -1;
@@ -587,47 +636,212 @@ void OPFModel::InitializeModel()
                 reading_order = NO_READING_ORDER;
             }
 
-            item->setData(reading_order, READING_ORDER_ROLE);
             // Remove the extension for alphanumeric sorting
-            QString name;
-            if (ss.showFullPathOn()) {
-                name = resource->GetRelativePath().left(resource->GetRelativePath().lastIndexOf('.'));
-            } else {
-                name = resource->ShortPathName().left(resource->ShortPathName().lastIndexOf('.'));
+            QString name = text.left(text.lastIndexOf('.'));
+            if (item->data(READING_ORDER_ROLE).toInt() != reading_order || is_new) {
+                item->setData(reading_order, READING_ORDER_ROLE);
+            }
+            if (item->data(ALPHANUMERIC_ORDER_ROLE).toString() != name) {
+                item->setData(name, ALPHANUMERIC_ORDER_ROLE);
+            }
+        }
+
+        if (is_new) {
+            GetFolderForResource(resource)->appendRow(item);
+        }
+    }
+
+    // Whatever is left belongs to files that are no longer in the book
+    foreach(QStandardItem *item, existing_items) {
+        QStandardItem *parent = item->parent() ? item->parent() : invisibleRootItem();
+        parent->removeRow(item->row());
+    }
+}
+
+
+void OPFModel::StartDecorating()
+{
+    m_DecorationTimer.stop();
+    m_TooltipSuffixes.clear();
+    // Replacing the future means only the latest refresh reports back
+    m_DecorationWatcher.setFuture(TaskScheduler::Run(TaskScheduler::BackgroundLane, &OPFModel::LoadTooltipSuffixes, m_Book));
+}
+
+
+void OPFModel::StopDecorating()
+{
+    m_DecorationWatcher.cancel();
+    m_DecorationWatcher.waitForFinished();
+    m_DecorationTimer.stop();
+    m_PendingDecorations.clear();
+    m_TooltipSuffixes.clear();
+}
+
+
+// Runs in a worker thread.
+QHash<QString, QString> OPFModel::LoadTooltipSuffixes(QSharedPointer<Book> book)
+{
+    QHash<QString, QString> semantic_type_all;
+    QHash<QString, QString> manifest_properties_all;
+    QString version = book->GetConstOPF()->GetEpubVersion();
+    if (version.startsWith('3')) {
+        HTMLResource *nav_resource = book->GetConstOPF()->GetNavResource();
+        bool has_nav = false;
+        if (nav_resource) {
+            QReadLocker locker(&nav_resource->GetLock());
+            has_nav = !nav_resource->GetText().isEmpty();
+        }
+        // An empty nav would be filled in by NavProcessor, which is
+        // not something to do from here.
+        if (has_nav) {
+            NavProcessor navproc(nav_resource);
+            semantic_type_all = navproc.GetLandmarkNameForPaths();
+        }
+        manifest_properties_all = book->GetOPF()->GetManifestPropertiesForPaths();
+    } else {
+        semantic_type_all = book->GetOPF()->GetGuideSemanticNameForPaths();
+    }
+
+    QHash<QString, QString> suffixes;
+    foreach(QString path, semantic_type_all.keys()) {
+        suffixes[path] = " (" + semantic_type_all[path] + ")";
+    }
+    foreach(QString path, manifest_properties_all.keys()) {
+        suffixes[path] += " [" + manifest_properties_all[path] + "]";
+    }
+    return suffixes;
+}
+
+
+void OPFModel::TooltipSuffixesLoaded()
+{
+    if (m_DecorationWatcher.isCanceled()) {
+        return;
+    }
+    m_TooltipSuffixes = m_DecorationWatcher.result();
+    m_DecorationTimer.start();
+}
+
+
+void OPFModel::DecorateNextBatch()
+{
+    if (!m_Book) {
+        m_PendingDecorations.clear();
+    }
+    if (m_PendingDecorations.isEmpty()) {
+        m_DecorationTimer.stop();
+        return;
+    }
+
+    QHash<QString, QStandardItem *> items = GetItemsByIdentifier();
+    m_RefreshInProgress = true;
+    int count = 0;
+    while (!m_PendingDecorations.isEmpty() && count < DECORATION_BATCH_SIZE) {
+        QString identifier = m_PendingDecorations.takeFirst();
+        QStandardItem *item = items.value(identifier);
+        Resource *resource = m_Book->GetFolderKeeper()->GetResourceByIdentifier(identifier);
+        if (!item || !resource) {
+            // removed since the refresh that queued it
+            continue;
+        }
+        QString path = resource->GetRelativePath();
+        QString tooltip = path;
+        if (resource->Type() == Resource::FontResourceType) {
+            FontResource* font_res = qobject_cast<FontResource *>(resource);
+            if (font_res) {
+                tooltip = tooltip + " (" + font_res->GetDescription() + ")";
+            }
+        }
+        tooltip += m_TooltipSuffixes.value(path);
+        if (item->toolTip() != tooltip) {
+            item->setToolTip(tooltip);
+        }
+        count++;
+    }
+    m_RefreshInProgress = false;
+}
+
+
+QHash<QString, QStandardItem *> OPFModel::GetItemsByIdentifier()
+{
+    QHash<QString, QStandardItem *> items;
+    for (int i = 0; i < invisibleRootItem()->rowCount(); ++i) {
+        QStandardItem *child = invisibleRootItem()->child(i);
+        if (IsFolderItem(child)) {
+            for (int j = 0; j < child->rowCount(); ++j) {
+                QStandardItem *item = child->child(j);
+                items.insert(item->data().toString(), item);
             }
-            item->setData(name, ALPHANUMERIC_ORDER_ROLE);
-            m_TextFolderItem->appendRow(item);
-        } else if (resource->Type() == Resource::CSSResourceType) {
-            item->setDragEnabled(false);
-            m_StylesFolderItem->appendRow(item);
-        } else if (resource->Type() == Resource::ImageResourceType ||
-                   resource->Type() == Resource::SVGResourceType
-                  ) {
-            item->setDragEnabled(false);
-            m_ImagesFolderItem->appendRow(item);
-        } else if (resource->Type() == Resource::FontResourceType) {
-            item->setDragEnabled(false);
-            m_FontsFolderItem->appendRow(item);
-        } else if (resource->Type() == Resource::AudioResourceType) {
-            item->setDragEnabled(false);
-            m_AudioFolderItem->appendRow(item);
-        } else if (resource->Type() == Resource::VideoResourceType) {
-            item->setDragEnabled(false);
-            m_VideoFolderItem->appendRow(item);
-        } else if (resource->Type() == Resource::PdfResourceType) {
-            item->setDragEnabled(false);
-            m_MiscFolderItem->appendRow(item);
-        } else if (resource->Type() == Resource::OPFResourceType ||
-                   resource->Type() == Resource::NCXResourceType) {
-            item->setEditable(true);
-            item->setDragEnabled(false);
-            item->setToolTip(resource->GetRelativePath());
-            appendRow(item);
         } else {
-            item->setDragEnabled(false);
-            m_MiscFolderItem->appendRow(item);
+            items.insert(child->data().toString(), child);
         }
     }
+    return items;
+}
+
+
+QStandardItem *OPFModel::GetFolderForResource(Resource *resource)
+{
+    switch (resource->Type()) {
+        case Resource::HTMLResourceType:
+            return m_TextFolderItem;
+        case Resource::CSSResourceType:
+            return m_StylesFolderItem;
+        case Resource::ImageResourceType:
+        case Resource::SVGResourceType:
+            return m_ImagesFolderItem;
+        case Resource::FontResourceType:
+            return m_FontsFolderItem;
+        case Resource::AudioResourceType:
+            return m_AudioFolderItem;
+        case Resource::VideoResourceType:
+            return m_VideoFolderItem;
+        case Resource::OPFResourceType:
+        case Resource::NCXResourceType:
+            return invisibleRootItem();
+        default:
+            return m_MiscFolderItem;
+    }
+}
+
+
+bool OPFModel::IsFolderItem(QStandardItem *item) const
+{
+    return item == m_TextFolderItem   ||
+           item == m_StylesFolderItem ||
+           item == m_ImagesFolderItem ||
+           item == m_FontsFolderItem  ||
+           item == m_MiscFolderItem   ||
+           item == m_AudioFolderItem  ||
+           item == m_VideoFolderItem;
+}
+
+
+bool OPFModel::IsSorted(QStandardItem *folder) const
+{
+    for (int i = 1; i < folder->rowCount(); ++i) {
+        if (*folder->child(i) < *folder->child(i - 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool OPFModel::IsInReadingOrder() const
+{
+    // files with the same reading order are left in filename order
+    for (int i = 1; i < m_TextFolderItem->rowCount(); ++i) {
+        QStandardItem *previous = m_TextFolderItem->child(i - 1);
+        QStandardItem *current = m_TextFolderItem->child(i);
+        int previous_order = previous->data(READING_ORDER_ROLE).toInt();
+        int current_order = current->data(READING_ORDER_ROLE).toInt();
+        if (current_order < previous_order ||
+            (current_order == previous_order && *current < *previous)) {
+            return false;
+        }
+    }
+    return true;
 }
 
 
@@ -707,7 +921,13 @@ void OPFModel::ClearModel()
 void OPFModel::SortFilesByFilenames()
 {
     for (int i = 0; i < invisibleRootItem()->rowCount(); ++i) {
-        invisibleRootItem()->child(i)->sortChildren(0);
+        QStandardItem *folder = invisibleRootItem()->child(i);
+        if (folder == m_TextFolderItem && IsInReadingOrder()) {
+            continue;
+        }
+        if (!IsSorted(folder)) {
+            folder->sortChildren(0);
+        }
     }
 }
 
@@ -716,7 +936,9 @@ void OPFModel::SortHTMLFilesByReadingOrder()
 {
     int old_sort_role = sortRole();
     setSortRole(READING_ORDER_ROLE);
-    m_TextFolderItem->sortChildren(0);
+    if (!IsSorted(m_TextFolderItem)) {
+        m_TextFolderItem->sortChildren(0);
+    }
     setSortRole(old_sort_role);
 }
 
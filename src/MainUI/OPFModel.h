@@ -24,7 +24,11 @@
 #ifndef OPFMODEL_H
 #define OPFMODEL_H
 
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QHash>
 #include <QtCore/QSharedPointer>
+#include <QtCore/QStringList>
+#include <QtCore/QTimer>
 #include <QtGui/QStandardItemModel>
 
 #include "BookManipulation/Book.h"
@@ -59,6 +63,8 @@ public:
      */
     OPFModel(QObject *parent = 0);
 
+    ~OPFModel();
+
     /**
      * Sets the model's book.
      *
@@ -205,15 +211,74 @@ private slots:
      */
     void ItemChangedHandler(QStandardItem *item);
 
+    /**
+     * Starts filling in the tooltips once the worker has
+     * read the semantics and manifest properties.
+     */
+    void TooltipSuffixesLoaded();
+
+    /**
+     * Fills in the full tooltips of the next batch of items.
+     */
+    void DecorateNextBatch();
+
+    /**
+     * Writes the spine changed by the rows removed since
+     * the handler opened the spine edit.
+     */
+    void CommitReadingOrders();
+
 
 private:
 
     /**
-     * Initializes an empty model with data. It is filled
-     * using information from the stored book.
+     * Brings the model in line with the stored book, adding and
+     * removing items for added and removed files and updating
+     * the rest in place.
      */
     void InitializeModel();
 
+    /**
+     * Returns every file item in the model keyed by resource identifier.
+     */
+    QHash<QString, QStandardItem *> GetItemsByIdentifier();
+
+    /**
+     * Returns the folder item that holds the items for the resource.
+     */
+    QStandardItem *GetFolderForResource(Resource *resource);
+
+    bool IsFolderItem(QStandardItem *item) const;
+
+    /**
+     * Returns \c true if the children of the folder are already
+     * in the order sortChildren would give them.
+     */
+    bool IsSorted(QStandardItem *folder) const;
+
+    /**
+     * Returns \c true if the text folder is sorted by reading order
+     * with ties sorted by filename, as a full refresh leaves it.
+     */
+    bool IsInReadingOrder() const;
+
+    /**
+     * Starts reading what the tooltips need from the OPF and nav in
+     * a worker thread, so that the plain items are shown first.
+     */
+    void StartDecorating();
+
+    /**
+     * Drops any tooltip work still pending for the current book.
+     */
+    void StopDecorating();
+
+    /**
+     * Returns the semantic names and manifest properties of every
+     * file as the text appended to its tooltip, keyed by book path.
+     */
+    static QHash<QString, QString> LoadTooltipSuffixes(QSharedPointer<Book> book);
+
     /**
      * Updates the reading orders of the HTMLResources
      * with their order in the model.
@@ -287,6 +352,23 @@ private:
     QStandardItem *m_MiscFolderItem;   /**< The Misc folder item. */
     QStandardItem *m_AudioFolderItem;
     QStandardItem *m_VideoFolderItem;
+
+    QFutureWatcher<QHash<QString, QString>> m_DecorationWatcher;
+
+    QTimer m_DecorationTimer;
+
+    /**
+     * Identifiers of the items whose tooltips are still to be filled in.
+     */
+    QStringList m_PendingDecorations;
+
+    QHash<QString, QString> m_TooltipSuffixes;
+
+    /**
+     * The book whose OPF has a spine edit opened by RowsRemovedHandler,
+     * null when there is none.
+     */
+    QSharedPointer<Book> m_SpineEditBook;
 };
 
 
@@ -37,15 +37,24 @@
 #include <QProgressBar>
 #include <QApplication>
 #include <QToolButton>
+#include <QtConcurrent/QtConcurrent>
 #include <QDebug>
 #include <QFrame>
 #include <QWidget>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPointer>
 
 #include "MainUI/PreviewWindow.h"
 #include "Dialogs/Inspector.h"
 #include "Parsers/GumboInterface.h"
 #include "Misc/SleepFunctions.h"
 #include "Misc/SettingsStore.h"
+#include "Misc/TaskScheduler.h"
+#include "Misc/Trace.h"
 #include "Misc/Utility.h"
 #include "Misc/webviewprinter.h"
 #include "ViewEditors/ViewPreview.h"
@@ -61,10 +70,49 @@ static const QString MATHJAX3_CONFIG =
 "    MathJax = { "
 "      loader: { "
 "        load: [ '[mml]/mml3', 'core', 'input/mml', 'output/svg' ] "
+"      }, "
+"      startup: { "
+"        pageReady: function() { "
+"          return MathJax.startup.defaultPageReady().then(function() { "
+"            performance.mark('sigil-mathjax-typeset'); "
+"          }); "
+"        } "
 "      } "
 "    }; "
 " </script> ";
 
+// What the page measured itself, in milliseconds since navigation started
+static const QString PAGE_TIMINGS_JS =
+"(function() { "
+"  var nav = performance.getEntriesByType('navigation')[0]; "
+"  var res = performance.getEntriesByType('resource'); "
+"  var slowest = null; "
+"  for (var i = 0; i < res.length; i++) { "
+"    if (!slowest || (res[i].duration > slowest.duration)) slowest = res[i]; "
+"  } "
+"  var mj = performance.getEntriesByName('sigil-mathjax-typeset'); "
+"  return JSON.stringify({ "
+"    dom: nav ? Math.round(nav.domContentLoadedEventEnd) : -1, "
+"    load: nav ? Math.round(nav.loadEventEnd) : -1, "
+"    resources: res.length, "
+"    slowest: slowest ? slowest.name.split('/').pop().split('?')[0] : '', "
+"    slowest_ms: slowest ? Math.round(slowest.duration) : 0, "
+"    mathjax: mj.length ? Math.round(mj[mj.length - 1].startTime) : -1, "
+"    now: Math.round(performance.now()) "
+"  }); "
+"})();";
+
+static const QString TIMINGS_LOG = "preview_timings.log";
+static const qint64 MAX_TIMINGS_LOG_SIZE = 1024 * 1024;
+
+struct TimingsResultFunctor {
+    QPointer<PreviewWindow> pw;
+    TimingsResultFunctor(PreviewWindow *pw) : pw(pw) {}
+    void operator()(const QVariant &result) {
+        if (pw) pw->TimingsReady(result);
+    }
+};
+
 
 #define DBG if(0)
 
@@ -91,13 +139,31 @@ PreviewWindow::PreviewWindow(QWidget *parent)
     m_usingMathML(false),
     m_cycleCSSLevel(0),
     m_skipPrintPreview(false),
-    m_WebViewPrinter(new WebViewPrinter(this))
+    m_WebViewPrinter(new WebViewPrinter(this)),
+    m_previewDark(0),
+    m_HasPendingUpdate(false),
+    m_LastUpdateDuration(0),
+    m_PrepareWatcher(new QFutureWatcher<PreparedPage>(this)),
+    m_PrefetchWatcher(new QFutureWatcher<PreparedPage>(this)),
+    m_PrefetchBudget(0),
+    m_ShowTimings(!Utility::GetEnvironmentVar("SIGIL_PREVIEW_TIMINGS").isEmpty()),
+    m_TimingsPending(false),
+    m_PreparedAt(0),
+    m_SetDocumentAt(0),
+    m_LoadedAt(0),
+    m_ScrolledAt(0),
+    m_TimingsOverlay(NULL)
 {
     m_progress->reset();
     m_progress->setMinimum(0);
     m_progress->setMaximum(100);
     setWindowTitle(tr("Preview"));
     SetupView();
+    // edits to a chapter only replace what changed in the live page
+    m_Preview->SetLivePatching(true);
+    if (m_ShowTimings) {
+        m_TimingsOverlay = new TextOverlay(m_Preview);
+    }
     LoadSettings();
     ConnectSignalsToSlots();
     setFocusPolicy(Qt::NoFocus);
@@ -181,6 +247,7 @@ void PreviewWindow::hideEvent(QHideEvent * event)
     }
 
     if ((m_Preview) && m_Preview->isVisible()) {
+        DropPrefetch();
         m_Preview->hide();
     }
 }
@@ -360,39 +427,137 @@ bool PreviewWindow::UpdatePage(QString filename_url, QString text, QList<Element
     }
 
     if (m_updatingPage) {
-        DBG qDebug() << "delaying PV UpdatePage request as currently loading a page: ";
-        return false;
+        // only the latest request is shown once the current load is done,
+        // anything asked for in between is already out of date
+        DBG qDebug() << "holding PV UpdatePage request as currently loading a page: ";
+        m_PendingFilename = filename_url;
+        m_PendingText = text;
+        m_PendingLocation = location;
+        m_HasPendingUpdate = true;
+        return true;
     }
 
     m_updatingPage = true;
+    m_HasPendingUpdate = false;
     SetCaretLocation(location);
     m_progress->setRange(0,100);
     m_progress->setValue(0);
-
-    QRegularExpression mathused("<\\s*math [^>]*>");
-    QRegularExpressionMatch mo = mathused.match(text);
-    m_usingMathML = mo.hasMatch();
+    m_UpdateTime.start();
+    m_TimingsPending = false;
 
     DBG qDebug() << "PV UpdatePage " << filename_url;
     DBG { foreach(ElementIndex ei, location) qDebug()<< "PV name: " << ei.name << " index: " << ei.index; }
 
+    // Everything that needs the GUI thread is worked out here,
+    // the scanning and injecting is done by a worker
+    m_Filepath = filename_url;
+    m_PrepareWatcher->setFuture(TaskScheduler::Run(TaskScheduler::InteractiveLane, PreparePage, text, DarkStyle(), UserCSSURL(), m_mathjaxurl));
+    return true;
+}
 
-    //if isDarkMode is set, inject a local style in head
-    SettingsStore settings;
-    if (Utility::IsDarkMode() && settings.previewDark()) {
-        text = Utility::AddDarkCSS(text);
+QString PreviewWindow::DarkStyle() const
+{
+    if (Utility::IsDarkMode() && m_previewDark) {
         DBG qDebug() << "Preview injecting dark style: ";
+        return Utility::DarkCSSStyle();
+    }
+    return QString();
+}
+
+QString PreviewWindow::UserCSSURL() const
+{
+    if (!m_usercssurls.isEmpty() && (m_cycleCSSLevel > 0)) {
+        return m_usercssurls.at(m_cycleCSSLevel - 1);
+    }
+    return QString();
+}
+
+void PreviewWindow::PrefetchPage(QString filename_url, QString text)
+{
+    if (!m_Preview->isVisible() || m_Inspector->isVisible() || (m_PrefetchBudget <= 0) ||
+        (filename_url == m_Filepath) || text.isEmpty()) {
+        return;
+    }
+    if (text.size() * static_cast<qint64>(sizeof(QChar)) > static_cast<qint64>(m_PrefetchBudget) * 1024 * 1024) {
+        DBG qDebug() << "PV not prefetching as it is over the budget: " << filename_url;
+        return;
+    }
+    // the page being shown comes first
+    if (m_updatingPage || m_PrefetchWatcher->isRunning()) {
+        return;
+    }
+    DBG qDebug() << "PV prefetching " << filename_url;
+    m_PrefetchFilepath = filename_url;
+    m_PrefetchWatcher->setFuture(TaskScheduler::Run(TaskScheduler::BackgroundLane, PreparePage, text, DarkStyle(), UserCSSURL(), m_mathjaxurl));
+}
+
+void PreviewWindow::PrefetchPrepared()
+{
+    // cancelled or overtaken by an update while being prepared
+    if (m_PrefetchFilepath.isEmpty() || m_updatingPage) {
+        m_PrefetchFilepath.clear();
+        return;
+    }
+    PreparedPage prepared = m_PrefetchWatcher->result();
+    m_Preview->PrefetchDocument(m_PrefetchFilepath, prepared.text,
+                                m_previewDark ? Utility::WebViewBackgroundColor(false) : QColor(Qt::white));
+    m_PrefetchFilepath.clear();
+}
+
+void PreviewWindow::CancelPrefetch()
+{
+    m_PrefetchFilepath.clear();
+    m_Preview->CancelPrefetch(true);
+}
+
+void PreviewWindow::DropPrefetch()
+{
+    m_PrefetchFilepath.clear();
+    m_Preview->CancelPrefetch();
+}
+
+void PreviewWindow::PagePrepared()
+{
+    TRACE_SPAN(span, "PreviewWindow::SetDocument");
+    PreparedPage prepared = m_PrepareWatcher->result();
+    m_PreparedAt = m_UpdateTime.elapsed();
+    m_usingMathML = prepared.using_mathml;
+    // the same colour Utility::WebViewBackgroundColor(true) picks
+    m_Preview->GetPage()->setBackgroundColor(m_previewDark ? Utility::WebViewBackgroundColor(false) : QColor(Qt::white));
+    m_Preview->CustomSetDocument(m_Filepath, prepared.text);
+    m_SetDocumentAt = m_UpdateTime.elapsed();
+
+    m_progress->setValue(10);
+}
+
+// Runs in a worker thread.
+PreviewWindow::PreparedPage PreviewWindow::PreparePage(const QString &page_text, const QString &dark_style,
+                                                       const QString &user_css_url, const QString &mathjax_url)
+{
+    static const QRegularExpression mathused("<\\s*math [^>]*>");
+    TRACE_SPAN(span, "PreviewWindow::PreparePage");
+    TRACE_ARG(span, "chars", page_text.length());
+
+    PreparedPage prepared;
+    QString text = page_text;
+    prepared.using_mathml = mathused.match(text).hasMatch();
+
+    //if isDarkMode is set, inject a local style in head
+    if (!dark_style.isEmpty()) {
+        int endheadpos = text.indexOf("</head>");
+        if (endheadpos != -1) {
+            text.insert(endheadpos, dark_style);
+        }
     }
-    m_Preview->page()->setBackgroundColor(Utility::WebViewBackgroundColor(true));
 
     // If the user has set a default stylesheet inject it last
     // so it can override anything above it
-    if (!m_usercssurls.isEmpty() && (m_cycleCSSLevel > 0)) {
+    if (!user_css_url.isEmpty()) {
         int endheadpos = text.indexOf("</head>");
         if (endheadpos > 1) {
             QString inject_userstyles = 
               "<link rel=\"stylesheet\" type=\"text/css\" "
-                "href=\"" + m_usercssurls.at(m_cycleCSSLevel - 1) + "\" />\n";
+                "href=\"" + user_css_url + "\" />\n";
             DBG qDebug() << "Preview injecting stylesheet: " << inject_userstyles;
             text.insert(endheadpos, inject_userstyles);
         }
@@ -400,24 +565,20 @@ bool PreviewWindow::UpdatePage(QString filename_url, QString text, QList<Element
 
     // If this page uses mathml tags, inject a polyfill
     // MathJax.js so that the mathml appears in the Preview Window
-    if (m_usingMathML) {
+    if (prepared.using_mathml) {
         int endheadpos = text.indexOf("</head>");
         if (endheadpos > 1) {
             QString inject_mathjax;
-            if (m_mathjaxurl.endsWith("startup.js")) {
-                inject_mathjax = MATHJAX3_CONFIG + "<script type=\"text/javascript\" async=\"async\" id=\"MathJax-script\" src=\"" + m_mathjaxurl + "\"></script>\n";
+            if (mathjax_url.endsWith("startup.js")) {
+                inject_mathjax = MATHJAX3_CONFIG + "<script type=\"text/javascript\" async=\"async\" id=\"MathJax-script\" src=\"" + mathjax_url + "\"></script>\n";
             } else {
-                inject_mathjax = "<script type=\"text/javascript\" async=\"async\" id=\"MathJax-script\" src=\"" + m_mathjaxurl + "\"></script>\n";
+                inject_mathjax = "<script type=\"text/javascript\" async=\"async\" id=\"MathJax-script\" src=\"" + mathjax_url + "\"></script>\n";
             }
             text.insert(endheadpos, inject_mathjax);
         }
     }
-
-    m_Filepath = filename_url;
-    m_Preview->CustomSetDocument(filename_url, text);
-
-    m_progress->setValue(10);
-    return true;
+    prepared.text = text;
+    return prepared;
 }
 
 void PreviewWindow::UpdatePageDone()
@@ -439,6 +600,10 @@ void PreviewWindow::UpdatePageDone()
     // need to delay long enough for Zoom changes to be reflected in View widget
     // before trying to center it on a location.
     QTimer::singleShot(30, this, SLOT(DelayedScrollTo()));
+    m_LastUpdateDuration = m_UpdateTime.elapsed();
+    m_LoadedAt = m_LastUpdateDuration;
+    m_TimingsPending = m_ShowTimings;
+    DBG qDebug() << "PreviewWindow UpdatePage took" << m_LastUpdateDuration << "ms";
     m_updatingPage = false;
 }
 
@@ -446,6 +611,83 @@ void PreviewWindow::DelayedScrollTo()
 {
     m_Preview->StoreCaretLocationUpdate(m_location);
     m_Preview->ExecuteCaretUpdate();
+    if (m_TimingsPending) {
+        m_TimingsPending = false;
+        m_ScrolledAt = m_UpdateTime.elapsed();
+        ReportTimings();
+    }
+    if (m_HasPendingUpdate && !m_updatingPage) {
+        m_HasPendingUpdate = false;
+        UpdatePage(m_PendingFilename, m_PendingText, m_PendingLocation);
+        return;
+    }
+    if (!m_updatingPage) {
+        emit PageShown();
+    }
+}
+
+void PreviewWindow::ReportTimings()
+{
+    m_TimingsPath = m_Filepath;
+    m_Preview->GetPage()->runJavaScript(PAGE_TIMINGS_JS, QWebEngineScript::MainWorld, TimingsResultFunctor(this));
+}
+
+void PreviewWindow::TimingsReady(const QVariant &page_timings)
+{
+    QJsonObject page = QJsonDocument::fromJson(page_timings.toString().toUtf8()).object();
+    bool patched = m_Preview->WasLivePatched();
+    QString mathjax;
+    if (!m_usingMathML) {
+        mathjax = "-";
+    } else if (patched) {
+        mathjax = "patched";
+    } else if (page.value("mathjax").toInt(-1) < 0) {
+        mathjax = "pending";
+    } else {
+        mathjax = QString::number(page.value("mathjax").toInt()) + " ms";
+    }
+    QString filename = QFileInfo(m_TimingsPath).fileName();
+
+    QStringList lines;
+    lines << filename + (patched ? " (patched)" : "");
+    lines << tr("prepare:  %1 ms").arg(m_PreparedAt);
+    lines << tr("set:      %1 ms").arg(m_SetDocumentAt);
+    lines << tr("loaded:   %1 ms").arg(m_LoadedAt);
+    lines << tr("scrolled: %1 ms").arg(m_ScrolledAt);
+    if (!patched) {
+        lines << tr("page dom: %1 ms  load: %2 ms").arg(page.value("dom").toInt()).arg(page.value("load").toInt());
+        lines << tr("resources: %1  slowest: %2 %3 ms").arg(page.value("resources").toInt())
+                 .arg(page.value("slowest").toString()).arg(page.value("slowest_ms").toInt());
+    }
+    lines << tr("mathjax:  %1").arg(mathjax);
+    if (m_TimingsOverlay) {
+        m_TimingsOverlay->setText(lines.join("\n"));
+    }
+
+    QStringList fields;
+    fields << QDateTime::currentDateTime().toString(Qt::ISODate) << m_TimingsPath
+           << (patched ? "patched" : "loaded")
+           << QString::number(m_PreparedAt) << QString::number(m_SetDocumentAt)
+           << QString::number(m_LoadedAt) << QString::number(m_ScrolledAt)
+           << QString::number(page.value("dom").toInt(-1)) << QString::number(page.value("load").toInt(-1))
+           << QString::number(page.value("resources").toInt()) << page.value("slowest").toString()
+           << QString::number(page.value("slowest_ms").toInt()) << mathjax;
+    LogTimings(fields.join("\t"));
+}
+
+void PreviewWindow::LogTimings(const QString &line)
+{
+    QString logpath = Utility::DefinePrefsDir() + "/" + TIMINGS_LOG;
+    QFileInfo fi(logpath);
+    if (fi.exists() && (fi.size() > MAX_TIMINGS_LOG_SIZE)) {
+        QFile::remove(logpath + ".1");
+        QFile::rename(logpath, logpath + ".1");
+    }
+    QFile logfile(logpath);
+    if (logfile.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        logfile.write(line.toUtf8() + "\n");
+        logfile.close();
+    }
 }
 
 void PreviewWindow::ScrollTo(QList<ElementIndex> location)
@@ -685,6 +927,9 @@ void PreviewWindow::InspectPreviewPage()
     // non-modal dialog
     if (!m_Inspector->isVisible()) {
         DBG qDebug() << "inspecting";
+        // the inspected page must not be swapped for a prefetched one
+        DropPrefetch();
+        m_Preview->GetPage();
         m_Inspector->InspectPageofView(m_Preview);
         m_Inspector->show();
         m_Inspector->raise();
@@ -707,12 +952,12 @@ void PreviewWindow::PrintRendered()
 
 void PreviewWindow::SelectAllPreview()
 {
-    m_Preview->triggerPageAction(QWebEnginePage::SelectAll);
+    m_Preview->GetPage()->triggerAction(QWebEnginePage::SelectAll);
 }
 
 void PreviewWindow::CopyPreview()
 {
-    m_Preview->triggerPageAction(QWebEnginePage::Copy);
+    m_Preview->GetPage()->triggerAction(QWebEnginePage::Copy);
 }
 
 void PreviewWindow::ReloadPreview()
@@ -723,6 +968,10 @@ void PreviewWindow::ReloadPreview()
     //force reset m_updatingPage in case a signal is lost
     m_progress->reset();
     m_updatingPage = false;
+    m_HasPendingUpdate = false;
+    // a reload also picks up a change to the preview dark preference
+    LoadSettings();
+    DropPrefetch();
     emit RequestPreviewReload();
 }
 
@@ -737,6 +986,8 @@ void PreviewWindow::LoadSettings()
 {
     SettingsStore settings;
     m_use_focus_highlight = settings.uiHighlightFocusWidgetEnabled();
+    m_previewDark = settings.previewDark();
+    m_PrefetchBudget = settings.previewPrefetchBudget();
     // settings.beginGroup(SETTINGS_GROUP);
     // m_Layout->restoreState(settings.value("layout").toByteArray());
     // settings.endGroup();
@@ -747,6 +998,8 @@ void PreviewWindow::ConnectSignalsToSlots()
     connect(m_Preview,   SIGNAL(ZoomFactorChanged(float)),  this, SIGNAL(ZoomFactorChanged(float)));
     connect(m_Preview,   SIGNAL(LinkClicked(const QUrl &)), this, SLOT(LinkClicked(const QUrl &)));
     connect(m_Preview,   SIGNAL(DocumentLoaded()),          this, SLOT(UpdatePageDone()));
+    connect(m_PrepareWatcher, SIGNAL(finished()),           this, SLOT(PagePrepared()));
+    connect(m_PrefetchWatcher, SIGNAL(finished()),          this, SLOT(PrefetchPrepared()));
     connect(m_Preview,   SIGNAL(ViewProgress(int)),         this, SLOT(setProgress(int)));
     connect(m_inspectAction,  SIGNAL(triggered()),          this, SLOT(InspectPreviewPage()));
     connect(m_selectAction,   SIGNAL(triggered()),          this, SLOT(SelectAllPreview()));
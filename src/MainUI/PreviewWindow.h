@@ -26,6 +26,8 @@
 #define PREVIEWWINDOW_H
 
 #include <QAction>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
 #include <QtWebEngineWidgets>
 #include <QtWebEngineCore>
 #include <QWebEngineView>
@@ -41,6 +43,7 @@ class QVBoxLayout;
 class QHBoxLayout;
 class QProgressBar;
 class OverlayHelperWidget;
+class TextOverlay;
 class WebViewPrinter;
 class QToolButton;
 class QWidget;
@@ -62,6 +65,11 @@ public:
     void setMathJaxURL(QString mathjaxurl) { m_mathjaxurl = mathjaxurl; };
     void setUserCSSURLs(const QStringList&  usercssurls);
 
+    /**
+     * How long the last page update took to show, in milliseconds.
+     */
+    qint64 LastUpdateDuration() const { return m_LastUpdateDuration; };
+
 public slots:
     bool UpdatePage(QString filename, QString text, QList<ElementIndex> location);
     void UpdatePageDone();
@@ -88,6 +96,31 @@ public slots:
     void PrintStarted();
     void PrintEnded();
     void SetFocusOnPreview();
+    void PagePrepared();
+
+    /**
+     * Prepares and loads a page in the background so that it shows
+     * at once if it is asked for next, unchanged.  Does nothing while
+     * the page is hidden or inspected, or if the text does not fit
+     * the prefetch budget.
+     * @param filename_url The full path of the file.
+     * @param text The text of the file.
+     */
+    void PrefetchPage(QString filename_url, QString text);
+
+    /**
+     * Stops a prefetch still being prepared or loaded, one that is
+     * done is kept since its text is checked again before it is shown.
+     */
+    void CancelPrefetch();
+    void PrefetchPrepared();
+
+    /**
+     * Shows and logs the stage timings of the last update together
+     * with the timings the page itself measured.
+     * @param page_timings The JSON the page timings script returned.
+     */
+    void TimingsReady(const QVariant &page_timings);
     
 signals:
     void Shown();
@@ -95,6 +128,12 @@ signals:
     void GoToPreviewLocationRequest();
     void RequestPreviewReload();
 
+    /**
+     * Emitted once a page update is fully shown and no other update
+     * is waiting.
+     */
+    void PageShown();
+
     /**
      * Emitted whenever Preview wants to open an URL.
      * @param url The URL to open.
@@ -122,10 +161,42 @@ protected:
     virtual void paintEvent(QPaintEvent* event);
 
 private:
+    struct PreparedPage {
+        QString text;
+        bool using_mathml;
+    };
+
+    /**
+     * Finds out if the page uses MathML and injects the dark style, the
+     * user stylesheet and MathJax into its head.  Runs in a worker thread.
+     */
+    static PreparedPage PreparePage(const QString &page_text, const QString &dark_style,
+                                    const QString &user_css_url, const QString &mathjax_url);
+
     void SetupView();
     void LoadSettings();
     void ConnectSignalsToSlots();
     void UpdateWindowTitle();
+    void ReportTimings();
+
+    /**
+     * The dark style and the user stylesheet a page is prepared with,
+     * empty if none is injected.
+     */
+    QString DarkStyle() const;
+    QString UserCSSURL() const;
+
+    /**
+     * Stops any prefetch and frees a prefetched page.
+     */
+    void DropPrefetch();
+
+    /**
+     * Appends a line to the timings log in the preferences folder,
+     * the log is started over once it grows too large.
+     */
+    static void LogTimings(const QString &line);
+
     bool fixup_fullscreen_svg_images(const QString &text);
     
     const QString titleText();
@@ -169,6 +240,38 @@ private:
     WebViewPrinter *m_WebViewPrinter;
     bool m_use_focus_highlight;
 
+    int m_previewDark;
+
+    /**
+     * The latest update asked for while a page was loading,
+     * it replaces any asked for before it.
+     */
+    bool m_HasPendingUpdate;
+    QString m_PendingFilename;
+    QString m_PendingText;
+    QList<ElementIndex> m_PendingLocation;
+
+    QElapsedTimer m_UpdateTime;
+    qint64 m_LastUpdateDuration;
+
+    QFutureWatcher<PreparedPage> *m_PrepareWatcher;
+
+    QFutureWatcher<PreparedPage> *m_PrefetchWatcher;
+    QString m_PrefetchFilepath;
+    int m_PrefetchBudget;
+
+    /**
+     * Set by SIGIL_PREVIEW_TIMINGS, the time each stage of an update
+     * was reached in milliseconds since the update started.
+     */
+    bool m_ShowTimings;
+    bool m_TimingsPending;
+    qint64 m_PreparedAt;
+    qint64 m_SetDocumentAt;
+    qint64 m_LoadedAt;
+    qint64 m_ScrolledAt;
+    QString m_TimingsPath;
+    TextOverlay *m_TimingsOverlay;
 };
 
 #endif // PREVIEWWINDOW_H
@@ -25,9 +25,11 @@
 #include <QtConcurrent/QtConcurrent>
 #include <QtWidgets/QApplication>
 #include <QXmlStreamReader>
+#include <QQueue>
 
 #include "MainUI/TOCModel.h"
 #include "Misc/Utility.h"
+#include "ResourceObjects/HTMLResource.h"
 #include "ResourceObjects/NCXResource.h"
 #include "ResourceObjects/OPFResource.h"
 #include "ResourceObjects/NavProcessor.h"
@@ -35,11 +37,16 @@
 
 TOCModel::TOCModel(QObject *parent)
     :
-    QStandardItemModel(parent),
+    QAbstractItemModel(parent),
     m_Book(NULL),
     m_RefreshInProgress(false),
-    m_TocRootWatcher(new QFutureWatcher<TOCModel::TOCEntry>(this))
+    m_TocRootWatcher(new QFutureWatcher<TOCModel::FlatTOC>(this)),
+    m_FlatValid(false),
+    m_RootCacheRevision(0),
+    m_RootCacheValid(false)
 {
+    m_Flat.top_count = 0;
+    m_Flat.revision = 0;
     connect(m_TocRootWatcher, SIGNAL(finished()), this, SLOT(RefreshEnd()));
 }
 
@@ -52,19 +59,22 @@ void TOCModel::SetBook(QSharedPointer<Book> book)
         m_Book = book;
         m_EpubVersion = m_Book->GetConstOPF()->GetEpubVersion();
     }
+    {
+        QMutexLocker locker(&m_RootCacheMutex);
+        m_RootCacheValid = false;
+    }
+    m_FlatValid = false;
     Refresh();
 }
 
 
 QString TOCModel::GetBookPathForIndex(const QModelIndex &index)
 {
-    QStandardItem *item = itemFromIndex(index);
-
-    if (!item) {
+    if (!index.isValid()) {
         return QString();
     }
 
-    return item->data().toString();
+    return m_Flat.nodes.at(index.internalId()).target;
 }
 
 
@@ -80,8 +90,18 @@ void TOCModel::Refresh()
         return;
     }
 
+    // nothing to do if the file shown has not changed
+    if (m_FlatValid) {
+        QMutexLocker book_lock(&m_UsingBookMutex);
+        TextResource *resource = GetTOCResource();
+        if (resource && (resource->GetRevision() == m_Flat.revision) &&
+            (resource->GetRelativePath() == m_Flat.path)) {
+            return;
+        }
+    }
+
     m_RefreshInProgress = true;
-    m_TocRootWatcher->setFuture(QtConcurrent::run(&TOCModel::GetRootTOCEntry, this));
+    m_TocRootWatcher->setFuture(QtConcurrent::run(&TOCModel::LoadFlatTOC, this));
 }
 
 
@@ -93,13 +113,80 @@ void TOCModel::RefreshEnd()
 }
 
 
+TextResource *TOCModel::GetTOCResource()
+{
+    if (!m_Book) {
+        return NULL;
+    }
+    if (m_EpubVersion.startsWith('3')) {
+        return m_Book->GetConstOPF()->GetNavResource();
+    }
+    return m_Book->GetNCX();
+}
+
+
 TOCModel::TOCEntry TOCModel::GetRootTOCEntry()
 {
+    // Read the revision before the text so that the text used is
+    // never older than the revision the result is stored against
+    HTMLResource *nav_resource = NULL;
+    QString path;
+    quint64 revision = 0;
+    bool cacheable = false;
+    {
+        QMutexLocker book_lock(&m_UsingBookMutex);
+        TextResource *resource = GetTOCResource();
+        if (resource) {
+            path = resource->GetRelativePath();
+            revision = resource->GetRevision();
+            cacheable = true;
+        }
+        if (m_EpubVersion.startsWith('3')) {
+            nav_resource = m_Book->GetConstOPF()->GetNavResource();
+        }
+    }
+    if (cacheable) {
+        QMutexLocker locker(&m_RootCacheMutex);
+        if (m_RootCacheValid && (revision == m_RootCacheRevision) && (path == m_RootCachePath)) {
+            return m_RootCache;
+        }
+    }
+
+    TOCModel::TOCEntry root;
     if (m_EpubVersion.startsWith('3')) {
-        NavProcessor navproc(m_Book->GetConstOPF()->GetNavResource());
-        return navproc.GetRootTOCEntry();
+        NavProcessor navproc(nav_resource);
+        root = navproc.GetRootTOCEntry();
+    } else {
+        root = ParseNCX(GetNCXText());
+    }
+
+    if (cacheable) {
+        QMutexLocker locker(&m_RootCacheMutex);
+        m_RootCache = root;
+        m_RootCachePath = path;
+        m_RootCacheRevision = revision;
+        m_RootCacheValid = true;
     }
-    return ParseNCX(GetNCXText());
+    return root;
+}
+
+
+TOCModel::FlatTOC TOCModel::LoadFlatTOC()
+{
+    QString path;
+    quint64 revision = 0;
+    {
+        QMutexLocker book_lock(&m_UsingBookMutex);
+        TextResource *resource = GetTOCResource();
+        if (resource) {
+            path = resource->GetRelativePath();
+            revision = resource->GetRevision();
+        }
+    }
+    FlatTOC flat_toc = FlattenEntries(GetRootTOCEntry());
+    flat_toc.path = path;
+    flat_toc.revision = revision;
+    return flat_toc;
 }
 
 
@@ -184,28 +271,137 @@ TOCModel::TOCEntry TOCModel::ParseNavPoint(QXmlStreamReader &ncx)
 }
 
 
-void TOCModel::BuildModel(const TOCModel::TOCEntry &root_entry)
+TOCModel::FlatTOC TOCModel::FlattenEntries(const TOCModel::TOCEntry &root_entry)
 {
-    clear();
-    foreach(const TOCModel::TOCEntry & child_entry, root_entry.children) {
-        AddEntryToParentItem(child_entry, invisibleRootItem());
+    FlatTOC flat_toc;
+    flat_toc.top_count = root_entry.children.count();
+    flat_toc.revision = 0;
+
+    // each queued entry is already in the array at the paired index
+    QQueue<QPair<const TOCModel::TOCEntry *, int>> pending;
+    for (int row = 0; row < root_entry.children.count(); row++) {
+        const TOCModel::TOCEntry &child = root_entry.children.at(row);
+        Node node;
+        node.text = child.text;
+        node.target = child.target;
+        node.parent = -1;
+        node.row = row;
+        node.first_child = 0;
+        node.child_count = 0;
+        flat_toc.nodes.append(node);
+        pending.enqueue(qMakePair(&child, flat_toc.nodes.count() - 1));
+    }
+    while (!pending.isEmpty()) {
+        QPair<const TOCModel::TOCEntry *, int> current = pending.dequeue();
+        const TOCModel::TOCEntry *entry = current.first;
+        int parent = current.second;
+        flat_toc.nodes[parent].first_child = flat_toc.nodes.count();
+        flat_toc.nodes[parent].child_count = entry->children.count();
+        for (int row = 0; row < entry->children.count(); row++) {
+            const TOCModel::TOCEntry &child = entry->children.at(row);
+            Node node;
+            node.text = child.text;
+            node.target = child.target;
+            node.parent = parent;
+            node.row = row;
+            node.first_child = 0;
+            node.child_count = 0;
+            flat_toc.nodes.append(node);
+            pending.enqueue(qMakePair(&child, flat_toc.nodes.count() - 1));
+        }
+    }
+    return flat_toc;
+}
+
+
+void TOCModel::BuildModel(const TOCModel::FlatTOC &flat_toc)
+{
+    beginResetModel();
+    m_Flat = flat_toc;
+    m_FlatValid = true;
+    endResetModel();
+}
+
+
+QModelIndex TOCModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if ((row < 0) || (column != 0)) {
+        return QModelIndex();
+    }
+    if (!parent.isValid()) {
+        if (row >= m_Flat.top_count) {
+            return QModelIndex();
+        }
+        return createIndex(row, column, quintptr(row));
+    }
+    const Node &node = m_Flat.nodes.at(parent.internalId());
+    if (row >= node.child_count) {
+        return QModelIndex();
+    }
+    return createIndex(row, column, quintptr(node.first_child + row));
+}
+
+
+QModelIndex TOCModel::parent(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return QModelIndex();
+    }
+    int parent = m_Flat.nodes.at(index.internalId()).parent;
+    if (parent < 0) {
+        return QModelIndex();
+    }
+    return createIndex(m_Flat.nodes.at(parent).row, 0, quintptr(parent));
+}
+
+
+int TOCModel::rowCount(const QModelIndex &parent) const
+{
+    if (!parent.isValid()) {
+        return m_Flat.top_count;
+    }
+    if (parent.column() != 0) {
+        return 0;
+    }
+    return m_Flat.nodes.at(parent.internalId()).child_count;
+}
+
+
+int TOCModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return 1;
+}
+
+
+bool TOCModel::hasChildren(const QModelIndex &parent) const
+{
+    return rowCount(parent) > 0;
+}
+
+
+QVariant TOCModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) {
+        return QVariant();
+    }
+    const Node &node = m_Flat.nodes.at(index.internalId());
+    if (role == Qt::DisplayRole) {
+        return node.text;
+    }
+    if ((role == Qt::ToolTipRole) || (role == Qt::UserRole + 1)) {
+        return node.target;
     }
+    return QVariant();
 }
 
 
-void TOCModel::AddEntryToParentItem(const TOCEntry &entry, QStandardItem *parent)
+Qt::ItemFlags TOCModel::flags(const QModelIndex &index) const
 {
-    Q_ASSERT(parent);
-    QStandardItem *item = new QStandardItem(entry.text);
-    item->setData(entry.target);
-    item->setToolTip(entry.target);
-    item->setEditable(false);
-    item->setDragEnabled(false);
-    item->setDropEnabled(false);
-    parent->appendRow(item);
-    foreach(const TOCModel::TOCEntry & child_entry, entry.children) {
-        AddEntryToParentItem(child_entry, item);
+    if (!index.isValid()) {
+        return Qt::NoItemFlags;
     }
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
 }
 
 
@@ -24,16 +24,17 @@
 #ifndef TOCMODEL_H
 #define TOCMODEL_H
 
+#include <QtCore/QAbstractItemModel>
 #include <QtCore/QFutureWatcher>
 #include <QtCore/QMutex>
 #include <QtCore/QSharedPointer>
-#include <QtGui/QStandardItemModel>
+#include <QtCore/QVector>
 
 #include "BookManipulation/Book.h"
 
 class NCXResource;
+class TextResource;
 class QModelIndex;
-class QStandardItem;
 class QXmlStreamReader;
 class QUrl;
 
@@ -41,8 +42,14 @@ class QUrl;
 /**
  * A hierarchical model for the NCX structure.
  * Meant to be used with a Qt View class (like QTreeView).
+ *
+ * The entries are kept in one flat array with the children of each
+ * entry next to each other, so a book with tens of thousands of TOC
+ * entries needs no item objects and the views only ever ask about
+ * the rows they show.  The NCX or Nav is only parsed again once its
+ * text has changed.
  */
-class TOCModel : public QStandardItemModel
+class TOCModel : public QAbstractItemModel
 {
     Q_OBJECT
 
@@ -82,6 +89,15 @@ public:
      */
     void Refresh();
 
+    // inherited
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+    QModelIndex parent(const QModelIndex &index) const;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    Qt::ItemFlags flags(const QModelIndex &index) const;
+
     /**
      * Represents a single entry in the NCX TOC.
      */
@@ -116,7 +132,8 @@ public:
 
     /**
      * Reads the NCX file or Nav file, parses it and returns the root TOC
-     * entry (that entry is the tree start). 
+     * entry (that entry is the tree start).  The entry parsed last is
+     * returned as long as the file has not changed since.
      * @return The root TOCEntry.
      */
     TOCEntry GetRootTOCEntry();
@@ -135,6 +152,40 @@ private slots:
 
 private:
 
+    /**
+     * An entry of the flattened tree.  The children of an entry
+     * are the child_count nodes starting at first_child.
+     */
+    struct Node {
+        QString text;
+        QString target;
+        int parent;
+        int row;
+        int first_child;
+        int child_count;
+    };
+
+    /**
+     * The flattened tree built by a refresh, the top level
+     * entries are its first top_count nodes.
+     */
+    struct FlatTOC {
+        QVector<Node> nodes;
+        int top_count;
+        QString path;
+        quint64 revision;
+    };
+
+    /**
+     * Parses the TOC and flattens it.  Runs in a worker thread.
+     */
+    FlatTOC LoadFlatTOC();
+
+    /**
+     * The Nav on epub3 and the NCX on epub2, can be NULL.
+     */
+    TextResource *GetTOCResource();
+
     /**
      * Reads the NCX file and returns the text in it.
      *
@@ -162,17 +213,15 @@ private:
     QString ConvertHREFToBookPath(const QString& ahref);
 
     /**
-     * Builds the actual display model from the tree of TOCEntries.
-     *
-     * @param root_entry The root TOC entry.
+     * Lays the tree out breadth first so that the
+     * children of every entry end up side by side.
      */
-    void BuildModel(const TOCEntry &root_entry);
+    static FlatTOC FlattenEntries(const TOCEntry &root_entry);
 
     /**
-     * Adds the provided entry as an item child to the provided parent.
-     * Calls itself recursively if the entry has children of it's own.
+     * Swaps in the flattened tree for the one shown.
      */
-    void AddEntryToParentItem(const TOCEntry &entry, QStandardItem *parent);
+    void BuildModel(const FlatTOC &flat_toc);
 
 
     ///////////////////////////////
@@ -198,9 +247,25 @@ private:
      * Watches the completion of the GetRootNCXEntry func
      * and signals the RefreshEnd func when the root NCX entry is ready.
      */
-    QFutureWatcher<TOCEntry> *m_TocRootWatcher;
+    QFutureWatcher<FlatTOC> *m_TocRootWatcher;
 
     QString m_EpubVersion;
+
+    /**
+     * The tree shown and the revision of the file it was read from.
+     */
+    FlatTOC m_Flat;
+    bool m_FlatValid;
+
+    /**
+     * The root entry GetRootTOCEntry parsed last, guarded by
+     * m_RootCacheMutex as it is filled in from the worker thread.
+     */
+    TOCEntry m_RootCache;
+    QString m_RootCachePath;
+    quint64 m_RootCacheRevision;
+    bool m_RootCacheValid;
+    QMutex m_RootCacheMutex;
 };
 
 
@@ -20,14 +20,16 @@
 **
 *************************************************************************/
 
-#include "EmbedPython/EmbeddedPython.h"
-
+#include <QtConcurrent/QtConcurrent>
+#include <QtCore/QReadLocker>
 #include <QFileInfo>
 #include <QApplication>
 #include <QHeaderView>
 #include <QTableWidget>
 #include <QRegularExpression>
 #include <QVariant>
+#include <QEventLoop>
+#include <QFutureWatcher>
 #include <QFileDialog>
 #include <QPaintEvent>
 #include <QStylePainter>
@@ -35,7 +37,9 @@
 #include "BookManipulation/Book.h"
 #include "BookManipulation/FolderKeeper.h"
 #include "MainUI/ValidationResultsView.h"
+#include "Misc/SanityCheck.h"
 #include "Misc/Utility.h"
+#include "ResourceObjects/HTMLResource.h"
 #include "sigil_exception.h"
 
 #if(0)
@@ -193,67 +197,70 @@ void ValidationResultsView::paintEvent(QPaintEvent *event)
 }
 
 
-QStringList ValidationResultsView::ValidateFile(QString &apath)
+// Runs in a worker thread.
+QList<ValidationResult> ValidationResultsView::ValidateFile(const FileToCheck &file)
 {
-    int rv = 0;
-    QString error_traceback;
-    QStringList results;
-
-    QList<QVariant> args;
-    args.append(QVariant(apath));
-
-    EmbeddedPython * epython  = EmbeddedPython::instance();
-
-    QVariant res = epython->runInPython( QString("sanitycheck"),
-                                         QString("perform_sanity_check"),
-                                         args,
-                                         &rv,
-                                         error_traceback);    
-    if (rv != 0) {
-        Utility::DisplayStdWarningDialog(QString("error in sanitycheck perform_sanity_check: ") + QString::number(rv), 
-                                         error_traceback);
-        // an error happened - make no changes
-        return results;
+    QList<ValidationResult> results;
+    SanityCheck check(file.text);
+    foreach(const SanityCheck::Error &error, check.Check()) {
+        QString msg = error.message + QString(".  near column %1").arg(error.column);
+        results.append(ValidationResult(ValidationResult::ResType_Error, file.bookpath, error.line, -1, msg));
     }
-    return res.toStringList();
+    return results;
 }
 
 
 void ValidationResultsView::ValidateCurrentBook()
 {
     ClearResults();
-    QList<ValidationResult> results;
     QApplication::setOverrideCursor(Qt::WaitCursor);
-    m_Book->SaveAllResourcesToDisk();
 
+    // Copy every text now, on the GUI thread, so that the
+    // workers only ever see plain strings
+    QList<FileToCheck> files;
     QList<Resource *> resources = m_Book->GetFolderKeeper()->GetResourceList();
     foreach (Resource * resource, resources) {
         if (resource->Type() == Resource::HTMLResourceType) {
-            QString apath = resource->GetFullPath();
-            QString bookpath = resource->GetRelativePath();
-            QStringList reslst = ValidateFile(apath);
-            if (!reslst.isEmpty()) {
-                foreach (QString res, reslst) {
-                    QStringList details = res.split(SEP);
-                    ValidationResult::ResType vtype;
-                    QString etype = details[0];
-                    if (etype == "info") {
-                        vtype = ValidationResult::ResType_Info;
-                    } else if (etype == "warning") {
-                        vtype = ValidationResult::ResType_Warn;
-                    } else if (etype == "error") {
-                        vtype = ValidationResult::ResType_Error;
-                    } else {
-                        continue;
-                    }
-                    QString filename = details[1];
-                    int lineno = details[2].toInt();
-                    int charoffset = details[3].toInt();
-                    QString msg = details[4];
-                    results.append(ValidationResult(vtype,bookpath,lineno,charoffset,msg));
-                }
-            }
+            HTMLResource *html_resource = qobject_cast<HTMLResource *>(resource);
+            FileToCheck file;
+            file.bookpath = resource->GetRelativePath();
+            QReadLocker locker(&html_resource->GetLock());
+            file.text = html_resource->GetText();
+            files << file;
+        }
+    }
+
+    // Show the problems of each file as soon as it is checked
+    bool first = true;
+    QFutureWatcher<QList<ValidationResult>> watcher;
+    QEventLoop loop;
+    connect(&watcher, &QFutureWatcher<QList<ValidationResult>>::resultReadyAt, &loop, [&](int index) {
+        QList<ValidationResult> file_results = watcher.resultAt(index);
+        if (file_results.isEmpty()) {
+            return;
+        }
+        if (first) {
+            m_ResultTable->clear();
+            ConfigureTableForResults();
+            show();
+            raise();
+            first = false;
         }
+        AppendResults(file_results);
+    });
+    connect(&watcher, &QFutureWatcher<QList<ValidationResult>>::finished, &loop, &QEventLoop::quit);
+    watcher.setFuture(QtConcurrent::mapped(files, ValidateFile));
+
+    // The caller (an Automate list among others) reads the
+    // results as soon as this returns so wait for them here
+    if (!watcher.isFinished()) {
+        loop.exec();
+    }
+
+    // and list them in book order once they are all in
+    QList<ValidationResult> results;
+    for (int i = 0; i < files.count(); i++) {
+        results.append(watcher.resultAt(i));
     }
     QApplication::restoreOverrideCursor();
     DisplayResults(results);
@@ -344,6 +351,14 @@ void ValidationResultsView::DisplayResults(const QList<ValidationResult> &result
     }
 
     ConfigureTableForResults();
+    AppendResults(results);
+}
+
+
+void ValidationResultsView::AppendResults(const QList<ValidationResult> &results)
+{
+    // rows move about as items are set while sorting is on
+    m_ResultTable->setSortingEnabled(false);
 
     Q_FOREACH(ValidationResult result, results) {
         int rownum = m_ResultTable->rowCount();
@@ -388,6 +403,7 @@ void ValidationResultsView::DisplayResults(const QList<ValidationResult> &result
         SetItemPalette(item, row_brush);
         m_ResultTable->setItem(rownum, 3, item);
     }
+    m_ResultTable->setSortingEnabled(true);
 
     // Make Line and Offset columns as small as possible
     // Ditto for Filename
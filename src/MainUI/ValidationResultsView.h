@@ -58,12 +58,13 @@ public:
     ValidationResultsView(QWidget *parent = 0);
 
     /**
-     * Validates the epub file given and displays the results.
+     * Checks that every xhtml file of the book is well-formed and
+     * displays the results.  The files are checked in parallel and the
+     * problems of each are shown as soon as it is done, but this only
+     * returns once all of them have been checked.
      */
     void ValidateCurrentBook();
 
-    QStringList ValidateFile(QString &apath);
-
     void LoadResults(const QList<ValidationResult> &results);
 
     /**
@@ -131,6 +132,11 @@ private:
      */
     void DisplayResults(const QList<ValidationResult> &results);
 
+    /**
+     * Adds rows for the given results below those already shown.
+     */
+    void AppendResults(const QList<ValidationResult> &results);
+
     /**
      * Informs the user that no problems were found.
      */
@@ -151,6 +157,13 @@ private:
 
     void SetItemPalette(QTableWidgetItem * item, QBrush &row_brush);
 
+    struct FileToCheck {
+        QString bookpath;
+        QString text;
+    };
+
+    static QList<ValidationResult> ValidateFile(const FileToCheck &file);
+
 
     ///////////////////////////////
     // PRIVATE MEMBER VARIABLES
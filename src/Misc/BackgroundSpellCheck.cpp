@@ -0,0 +1,138 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+
+#include <QtConcurrent/QtConcurrent>
+#include <QtCore/QThreadPool>
+#include <QtGui/QSyntaxHighlighter>
+#include <QtGui/QTextBlock>
+#include <QtGui/QTextDocument>
+#include <QDebug>
+
+#include "Misc/SpellCheck.h"
+#include "Misc/BackgroundSpellCheck.h"
+
+#if 0
+#define DBG if(1)
+#else
+#define DBG if(0)
+#endif
+
+static QThreadPool *SpellCheckPool()
+{
+    static QThreadPool *pool = NULL;
+    if (!pool) {
+        pool = new QThreadPool();
+        pool->setMaxThreadCount(1);
+    }
+    return pool;
+}
+
+
+BackgroundSpellCheck::BackgroundSpellCheck(QSyntaxHighlighter *highlighter)
+    :
+    QObject(highlighter),
+    m_Highlighter(highlighter)
+{
+    connect(&m_Watcher, SIGNAL(finished()), this, SLOT(BatchFinished()));
+}
+
+
+BackgroundSpellCheck::~BackgroundSpellCheck()
+{
+    // the batch only holds copies of the words
+    m_Watcher.disconnect(this);
+}
+
+
+void BackgroundSpellCheck::Queue(const QTextBlock &block, const QStringList &words)
+{
+    if (words.isEmpty() || !block.isValid()) {
+        return;
+    }
+    foreach(const QString &word, words) {
+        m_QueuedWords.insert(word);
+    }
+    if (!m_QueuedBlockNumbers.contains(block.blockNumber())) {
+        m_QueuedBlockNumbers.insert(block.blockNumber());
+        m_QueuedBlocks.append(QTextCursor(block));
+    }
+    if (!m_Watcher.isRunning()) {
+        StartBatch();
+    }
+}
+
+
+void BackgroundSpellCheck::Clear()
+{
+    m_QueuedWords.clear();
+    m_QueuedBlocks.clear();
+    m_QueuedBlockNumbers.clear();
+    m_BatchBlocks.clear();
+}
+
+
+void BackgroundSpellCheck::StartBatch()
+{
+    if (m_QueuedWords.isEmpty()) {
+        return;
+    }
+    QStringList words = m_QueuedWords.values();
+    m_QueuedWords.clear();
+    m_BatchBlocks = m_QueuedBlocks;
+    m_QueuedBlocks.clear();
+    m_QueuedBlockNumbers.clear();
+    DBG qDebug() << "BackgroundSpellCheck checking" << words.count() << "words";
+    m_Watcher.setFuture(QtConcurrent::run(SpellCheckPool(), CheckWords, words));
+}
+
+
+void BackgroundSpellCheck::BatchFinished()
+{
+    QList<QTextCursor> blocks = m_BatchBlocks;
+    m_BatchBlocks.clear();
+    // words queued while the batch ran go next, the blocks below
+    // will not queue the ones just checked again
+    StartBatch();
+    QTextDocument *document = m_Highlighter->document();
+    if (!document) {
+        return;
+    }
+    // only formats change, which must not look like an edit to the
+    // document's contentsChanged listeners
+    document->blockSignals(true);
+    foreach(const QTextCursor &cursor, blocks) {
+        if (cursor.document() == document) {
+            m_Highlighter->rehighlightBlock(cursor.block());
+        }
+    }
+    document->blockSignals(false);
+}
+
+
+// Runs in the worker thread.
+void BackgroundSpellCheck::CheckWords(const QStringList &words)
+{
+    SpellCheck *sc = SpellCheck::instance();
+    foreach(const QString &word, words) {
+        sc->spellPS(word);
+    }
+}
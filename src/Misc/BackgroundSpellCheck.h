@@ -0,0 +1,104 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+
+#pragma once
+#ifndef BACKGROUNDSPELLCHECK_H
+#define BACKGROUNDSPELLCHECK_H
+
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtGui/QTextCursor>
+
+class QSyntaxHighlighter;
+class QTextBlock;
+
+/**
+ * Checks the spelling of words a highlighter has no verdict for yet
+ * in a worker thread and then has the highlighter redo the blocks
+ * they were found in.
+ *
+ * The verdicts end up in the SpellCheck cache so the highlighter
+ * finds them there the second time around.  All instances share a
+ * single worker thread since Hunspell can only be used by one
+ * thread at a time anyway.
+ */
+class BackgroundSpellCheck : public QObject
+{
+    Q_OBJECT
+
+public:
+    BackgroundSpellCheck(QSyntaxHighlighter *highlighter);
+    ~BackgroundSpellCheck();
+
+    /**
+     * Queues words found in block to be checked.  The block is
+     * highlighted again once they have been.
+     */
+    void Queue(const QTextBlock &block, const QStringList &words);
+
+    /**
+     * Forgets everything queued, a batch already being checked
+     * still finishes but no blocks are highlighted for it.
+     */
+    void Clear();
+
+private slots:
+    void BatchFinished();
+
+private:
+    void StartBatch();
+
+    static void CheckWords(const QStringList &words);
+
+
+    ///////////////////////////////
+    // PRIVATE MEMBER VARIABLES
+    ///////////////////////////////
+
+    QSyntaxHighlighter *m_Highlighter;
+
+    QSet<QString> m_QueuedWords;
+
+    /**
+     * Cursors keep track of the blocks while the text is edited.
+     */
+    QList<QTextCursor> m_QueuedBlocks;
+
+    /**
+     * The numbers the queued blocks had when they were queued, only
+     * used to avoid queueing the same block twice.
+     */
+    QSet<int> m_QueuedBlockNumbers;
+
+    /**
+     * The blocks to highlight again when the running batch is done.
+     */
+    QList<QTextCursor> m_BatchBlocks;
+
+    QFutureWatcher<void> m_Watcher;
+};
+
+#endif // BACKGROUNDSPELLCHECK_H
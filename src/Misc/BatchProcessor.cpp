@@ -0,0 +1,492 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <functional>
+#include <iostream>
+
+#include <QtConcurrent/QtConcurrent>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QEventLoop>
+#include <QtCore/QFileInfo>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtGui/QStandardItem>
+
+#include "BookManipulation/Book.h"
+#include "BookManipulation/BookReports.h"
+#include "BookManipulation/CleanSource.h"
+#include "BookManipulation/FolderKeeper.h"
+#include "Exporters/ExportEPUB.h"
+#include "Importers/ImportEPUB.h"
+#include "Misc/BatchProcessor.h"
+#include "Misc/SearchOperations.h"
+#include "Misc/Trace.h"
+#include "Misc/Utility.h"
+#include "MiscEditors/SearchEditorModel.h"
+#include "ResourceObjects/CSSResource.h"
+#include "ResourceObjects/HTMLResource.h"
+#include "ResourceObjects/NCXResource.h"
+#include "ResourceObjects/OPFResource.h"
+#include "ResourceObjects/SVGResource.h"
+#include "SourceUpdates/UniversalUpdates.h"
+#include "sigil_exception.h"
+
+// The same options FindReplace::GetSearchRegex puts in front of a search
+static const QString REGEX_OPTION_UCP = "(*UCP)";
+static const QString REGEX_OPTION_IGNORE_CASE = "(?i)";
+static const QString REGEX_OPTION_DOT_ALL = "(?s)";
+static const QString REGEX_OPTION_MINIMAL_MATCH = "(?U)";
+static const QString REGEX_OPTION_TEXT_ONLY = "<[^<>]*>(*SKIP)(*F)|";
+
+static const QString USAGE = "usage: --batch [jobs=N] [rename=TEMPLATE] [search=NAME ...] "
+                             "[find=REGEX replace=TEXT ...] [clean=mend|prettify] "
+                             "[reports=DIR] [output=DIR] [timings=FILE] book.epub ...";
+
+// (*UCP) only works as the very first thing in a pattern
+static QString PrependOption(const QString &option, const QString &search)
+{
+    if (search.startsWith(REGEX_OPTION_UCP)) {
+        return REGEX_OPTION_UCP + option + search.mid(REGEX_OPTION_UCP.length());
+    }
+    return option + search;
+}
+
+
+int BatchProcessor::Run(const QStringList &arguments)
+{
+    Options options;
+    QStringList epub_paths;
+    QString error;
+    if (!ParseArguments(arguments, options, epub_paths, error) || epub_paths.isEmpty()) {
+        if (!error.isEmpty()) {
+            std::cout << error.toStdString() << std::endl;
+        }
+        std::cout << USAGE.toStdString() << std::endl;
+        return 1;
+    }
+
+    // Each book runs in its own worker, the work inside a book still
+    // spreads over the global pool as it does in the GUI
+    QThreadPool pool;
+    pool.setMaxThreadCount(options.jobs);
+
+    QStringList timings;
+    timings << Utility::createCSVLine(QStringList() << "Book" << "Step" << "Milliseconds");
+
+    int failed = 0;
+    QFutureWatcher<Result> watcher;
+    QEventLoop loop;
+    QObject::connect(&watcher, &QFutureWatcher<Result>::resultReadyAt, &loop, [&](int index) {
+        Result result = watcher.resultAt(index);
+        if (!result.saved) {
+            failed++;
+        }
+        std::cout << result.line.toStdString() << std::endl;
+        for (const std::pair<QString, qint64> &step : result.steps) {
+            timings << Utility::createCSVLine(QStringList() << epub_paths.at(index) << step.first << QString::number(step.second));
+        }
+    });
+    QObject::connect(&watcher, &QFutureWatcher<Result>::finished, &loop, &QEventLoop::quit);
+    watcher.setFuture(QtConcurrent::mapped(&pool, epub_paths, std::bind(ProcessBook, std::placeholders::_1, options)));
+
+    // The GUI thread has to keep running its event loop while the books
+    // are processed, their resources live on it
+    if (!watcher.isFinished()) {
+        loop.exec();
+    }
+
+    if (!options.timings_path.isEmpty()) {
+        Utility::WriteUnicodeTextFile(timings.join('\n') + '\n', options.timings_path);
+    }
+    return failed > 0 ? 1 : 0;
+}
+
+
+bool BatchProcessor::ParseArguments(const QStringList &arguments, Options &options, QStringList &epub_paths, QString &error)
+{
+    options.jobs = QThread::idealThreadCount();
+    bool after_find = false;
+    foreach(QString argument, arguments) {
+        QString key = argument.section('=', 0, 0);
+        QString value = argument.section('=', 1);
+        bool follows_find = after_find;
+        after_find = key == "find";
+        if (key == "jobs") {
+            bool ok;
+            options.jobs = value.toInt(&ok);
+            if (!ok || (options.jobs < 1)) {
+                error = QString("jobs must be a number above 0: %1").arg(value);
+                return false;
+            }
+        } else if (key == "rename") {
+            if (value.isEmpty()) {
+                error = "rename needs a template such as Section0001.xhtml";
+                return false;
+            }
+            options.rename_template = value;
+        } else if (key == "search") {
+            if (!AddSavedSearches(value, options.searches, error)) {
+                return false;
+            }
+        } else if (key == "find") {
+            if (value.isEmpty()) {
+                error = "find needs a regex";
+                return false;
+            }
+            Search search;
+            search.name = value;
+            search.regex = Utility::UseNFC(value);
+            search.target = Target_HTML;
+            options.searches << search;
+        } else if (key == "replace") {
+            if (!follows_find) {
+                error = QString("replace must come right after a find: %1").arg(value);
+                return false;
+            }
+            options.searches.last().replacement = Utility::UseNFC(value);
+        } else if (key == "clean") {
+            if (value == "mend") {
+                options.clean = Clean_Mend;
+            } else if (value == "prettify") {
+                options.clean = Clean_MendPrettify;
+            } else {
+                error = QString("clean must be mend or prettify: %1").arg(value);
+                return false;
+            }
+        } else if ((key == "reports") || (key == "output")) {
+            QString dir = QFileInfo(value).absoluteFilePath();
+            if (!QDir().mkpath(dir)) {
+                error = QString("can not create the folder %1").arg(dir);
+                return false;
+            }
+            if (key == "reports") {
+                options.reports_dir = dir;
+            } else {
+                options.output_dir = dir;
+            }
+        } else if (key == "timings") {
+            options.timings_path = QFileInfo(value).absoluteFilePath();
+        } else {
+            epub_paths << QFileInfo(argument).absoluteFilePath();
+        }
+    }
+    return true;
+}
+
+
+bool BatchProcessor::AddSavedSearches(const QString &name, QList<Search> &searches, QString &error)
+{
+    SearchEditorModel *model = SearchEditorModel::instance();
+    QStandardItem *item = model->GetItemFromName(name);
+    if (!item) {
+        error = QString("there is no saved search named %1").arg(name);
+        return false;
+    }
+
+    // a group runs every search in it, and in the groups in it, in order
+    QList<SearchEditorModel::searchEntry *> entries = model->GetEntries(model->GetNonGroupItems(item));
+    foreach(SearchEditorModel::searchEntry *entry, entries) {
+        QString controls = entry->controls;
+        Search search;
+        search.name = entry->fullname;
+        search.replacement = Utility::UseNFC(entry->replace);
+
+        // checked in the same order as FindReplace::UpdateSearchControls,
+        // there is no current, selected or tabbed file so those look in all
+        if (controls.contains("CF") || controls.contains("AH") || controls.contains("SH") ||
+            controls.contains("TH") || controls.isEmpty()) {
+            search.target = Target_HTML;
+        } else if (controls.contains("AC") || controls.contains("SC") || controls.contains("TC")) {
+            search.target = Target_CSS;
+        } else if (controls.contains("OP")) {
+            search.target = Target_OPF;
+        } else if (controls.contains("NX")) {
+            search.target = Target_NCX;
+        } else if (controls.contains("SV")) {
+            search.target = Target_SVG;
+        } else {
+            error = QString("the saved search %1 looks in files batch mode can not search").arg(entry->fullname);
+            qDeleteAll(entries);
+            return false;
+        }
+
+        QString find = Utility::UseNFC(entry->find);
+        find.replace(QRegularExpression("\\R"), "\n");
+        if (find.isEmpty()) {
+            error = QString("the saved search %1 has nothing to find").arg(entry->fullname);
+            qDeleteAll(entries);
+            return false;
+        }
+        bool text_only = controls.contains("TO") && (search.target != Target_CSS);
+        if (controls.contains("RX")) {
+            search.regex = find;
+            if (text_only) {
+                search.regex = PrependOption(REGEX_OPTION_TEXT_ONLY, search.regex);
+            }
+            if (controls.contains("DA")) {
+                search.regex = PrependOption(REGEX_OPTION_DOT_ALL, search.regex);
+            }
+            if (controls.contains("MM")) {
+                search.regex = PrependOption(REGEX_OPTION_MINIMAL_MATCH, search.regex);
+            }
+            if (controls.contains("UN")) {
+                search.regex = PrependOption(REGEX_OPTION_UCP, search.regex);
+            }
+        } else {
+            search.regex = QRegularExpression::escape(find);
+            if (text_only) {
+                search.regex = PrependOption(REGEX_OPTION_TEXT_ONLY, search.regex);
+            }
+            if (!controls.contains("CS")) {
+                search.regex = PrependOption(REGEX_OPTION_IGNORE_CASE, search.regex);
+            }
+        }
+        searches << search;
+    }
+    qDeleteAll(entries);
+    return true;
+}
+
+
+BatchProcessor::Result BatchProcessor::ProcessBook(const QString &epub_path, const Options &options)
+{
+    TRACE_SPAN(span, "BatchProcessor::ProcessBook");
+    QElapsedTimer timer;
+    timer.start();
+    QElapsedTimer step_timer;
+    QFileInfo epub_info(epub_path);
+    QStringList done;
+    Result result;
+    QSharedPointer<Book> book;
+    try {
+        step_timer.start();
+        ImportEPUB importer(epub_path);
+        book = importer.GetBook();
+        result.steps << std::make_pair(QString("open"), step_timer.restart());
+
+        if (!options.rename_template.isEmpty()) {
+            int count = RenameHTMLFiles(book, options.rename_template);
+            if (count > 0) {
+                book->SetModified(true);
+            }
+            done << QString("%1 files renamed").arg(count);
+            result.steps << std::make_pair(QString("rename"), step_timer.restart());
+        }
+
+        if (!options.searches.isEmpty()) {
+            QList<SearchOperations::ReplaceEntry> batch;
+            foreach(const Search &search, options.searches) {
+                SearchOperations::ReplaceEntry entry;
+                entry.search_regex = search.regex;
+                entry.replacement = search.replacement;
+                entry.resources = TargetResources(book, search.target);
+                batch << entry;
+            }
+            int count = 0;
+            foreach(int entry_count, SearchOperations::ReplaceInAllFilesBatch(batch)) {
+                count += entry_count;
+            }
+            if (count > 0) {
+                book->SetModified(true);
+            }
+            done << QString("%1 replacements").arg(count);
+            result.steps << std::make_pair(QString("replace"), step_timer.restart());
+        }
+
+        if (options.clean != Clean_None) {
+            QList<HTMLResource *> html_resources = book->GetFolderKeeper()->GetResourceTypeList<HTMLResource>(true);
+            bool modified = CleanSource::ReformatAll(html_resources,
+                                                     options.clean == Clean_Mend ? CleanSource::Mend : CleanSource::MendPrettify);
+            if (modified) {
+                book->SetModified(true);
+            }
+            done << (options.clean == Clean_Mend ? "mended" : "mended and prettified");
+            result.steps << std::make_pair(QString("clean"), step_timer.restart());
+        }
+
+        if (!options.reports_dir.isEmpty()) {
+            WriteReports(book, options.reports_dir + "/" + epub_info.completeBaseName());
+            done << "reports written";
+            result.steps << std::make_pair(QString("reports"), step_timer.restart());
+        }
+
+        QString save_path = epub_path;
+        if (!options.output_dir.isEmpty()) {
+            save_path = options.output_dir + "/" + epub_info.fileName();
+        }
+        ExportEPUB exporter(save_path, book);
+        exporter.WriteBook();
+        result.saved = true;
+        done << "saved";
+        result.steps << std::make_pair(QString("save"), step_timer.restart());
+    } catch (std::exception &e) {
+        done << QString("failed: %1").arg(e.what());
+    }
+
+    // The resources of a book live on the GUI thread so the book is
+    // handed back to it to be deleted there
+    if (book) {
+        book->moveToThread(QCoreApplication::instance()->thread());
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [book]() {}, Qt::QueuedConnection);
+    }
+
+    result.line = QString("%1: %2 (%3 ms)").arg(epub_path).arg(done.join(", ")).arg(timer.elapsed());
+    if (result.saved) {
+        result.steps << std::make_pair(QString("total"), timer.elapsed());
+    }
+    return result;
+}
+
+
+// Names the files the way BookBrowser::RenameSelected does, the digits
+// at the end of the template give the first number and its width
+int BatchProcessor::RenameHTMLFiles(QSharedPointer<Book> book, const QString &rename_template)
+{
+    QString template_name = rename_template;
+    QString new_extension;
+    if (template_name.contains(".")) {
+        new_extension = template_name.right(template_name.length() - template_name.lastIndexOf("."));
+        template_name = template_name.left(template_name.lastIndexOf("."));
+    }
+    int pos = template_name.length() - 1;
+    while (pos >= 0 && template_name[pos].isDigit()) {
+        pos--;
+    }
+    QString template_base = template_name.left(pos + 1);
+    QString template_number_string = template_name.mid(pos + 1);
+    if (template_number_string.isEmpty()) {
+        template_number_string = "1";
+    }
+    int template_number = template_number_string.toInt();
+
+    QList<Resource *> resources = book->GetFolderKeeper()->GetResourceTypeAsGenericList<HTMLResource>(true);
+    QStringList book_filenames = book->GetFolderKeeper()->GetAllFilenames();
+    QList<Resource *> bulk_rename;
+    QStringList new_filenames;
+    QStringList old_paths;
+    foreach(Resource *resource, resources) {
+        QString old_filename = resource->Filename();
+        QString file_extension = new_extension;
+        if (file_extension.isEmpty() && old_filename.contains('.')) {
+            file_extension = old_filename.right(old_filename.length() - old_filename.lastIndexOf('.'));
+        }
+        QString name = QString("%1%2").arg(template_base)
+                       .arg(template_number++, template_number_string.length(), 10, QChar('0'))
+                       .append(file_extension);
+        if ((book_filenames.contains(name) && (old_filename != name)) || new_filenames.contains(name)) {
+            throw std::runtime_error(QString("renaming to %1 would give two files the same name").arg(name).toStdString());
+        }
+        if (old_filename != name) {
+            bulk_rename << resource;
+            new_filenames << name;
+            old_paths << resource->GetRelativePath();
+        }
+    }
+    if (bulk_rename.isEmpty()) {
+        return 0;
+    }
+
+    // the same updates OPFModel::RenameResourceList makes
+    book->GetFolderKeeper()->BulkRenameResources(bulk_rename, new_filenames);
+    QHash<QString, QString> update;
+    for (int i = 0; i < bulk_rename.count(); i++) {
+        Resource *resource = bulk_rename.at(i);
+        if (resource->GetRelativePath() != old_paths.at(i)) {
+            resource->SetCurrentBookRelPath(old_paths.at(i));
+            update[old_paths.at(i)] = resource->GetRelativePath();
+        }
+    }
+    if (!update.isEmpty()) {
+        UniversalUpdates::PerformUniversalUpdates(true, book->GetFolderKeeper()->GetResourceList(), update,
+                                                   QList<XMLResource *>(), book->GetFolderKeeper()->GetReferenceIndex());
+    }
+    return update.count();
+}
+
+
+QList<Resource *> BatchProcessor::TargetResources(QSharedPointer<Book> book, Target target)
+{
+    QList<Resource *> resources;
+    switch (target) {
+        case Target_HTML:
+            resources = book->GetFolderKeeper()->GetResourceTypeAsGenericList<HTMLResource>(true);
+            break;
+        case Target_CSS:
+            resources = book->GetFolderKeeper()->GetResourceTypeAsGenericList<CSSResource>(true);
+            break;
+        case Target_OPF:
+            resources << book->GetOPF();
+            break;
+        case Target_NCX:
+            // need not exist
+            if (book->GetNCX()) {
+                resources << book->GetNCX();
+            }
+            break;
+        case Target_SVG:
+            resources = book->GetFolderKeeper()->GetResourceTypeAsGenericList<SVGResource>(true);
+            break;
+    }
+    return resources;
+}
+
+
+// The same columns as the All Files, Classes and Styles reports save
+void BatchProcessor::WriteReports(QSharedPointer<Book> book, const QString &report_path)
+{
+    book->SaveAllResourcesToDisk();
+
+    QStringList files;
+    files << Utility::createCSVLine(QStringList() << "Name" << "Media Type" << "Size (Bytes)");
+    foreach(Resource *resource, book->GetFolderKeeper()->GetResourceList()) {
+        files << Utility::createCSVLine(QStringList() << resource->GetRelativePath()
+                                                      << resource->GetMediaType()
+                                                      << QString::number(QFileInfo(resource->GetFullPath()).size()));
+    }
+    Utility::WriteUnicodeTextFile(files.join('\n') + '\n', report_path + "_files.csv");
+
+    QStringList classes;
+    classes << Utility::createCSVLine(QStringList() << "File" << "HTML Tag" << "Class" << "Matched CSS File" << "Matched CSS Selector");
+    QList<BookReports::StyleData *> class_usage = BookReports::GetHTMLClassUsage(book);
+    foreach(BookReports::StyleData *usage, class_usage) {
+        classes << Utility::createCSVLine(QStringList() << usage->html_filename
+                                                        << usage->html_element_name
+                                                        << usage->html_class_name
+                                                        << usage->css_filename
+                                                        << usage->css_selector_text);
+    }
+    qDeleteAll(class_usage);
+    Utility::WriteUnicodeTextFile(classes.join('\n') + '\n', report_path + "_classes.csv");
+
+    QStringList styles;
+    styles << Utility::createCSVLine(QStringList() << "CSS File" << "Class Selector" << "Count" << "First Used In");
+    foreach(const BookReports::SelectorUsage &usage, BookReports::GetAllCSSSelectorsUsed(book)) {
+        styles << Utility::createCSVLine(QStringList() << usage.css_filename
+                                                       << usage.css_selector_text
+                                                       << QString::number(usage.html_file_count)
+                                                       << usage.html_filename);
+    }
+    Utility::WriteUnicodeTextFile(styles.join('\n') + '\n', report_path + "_styles.csv");
+}
@@ -0,0 +1,152 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+#include <QtCore/QList>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+class Book;
+class Resource;
+
+/**
+ * Processes books without a main window, for build servers.
+ *
+ * Run as "Sigil --batch [key=value ...] book.epub ..." to load each
+ * book with ImportEPUB, rename its html files, run searches over it,
+ * Mend or Mend and Prettify its html, write its reports and save it
+ * with ExportEPUB, in that order.
+ * No MainWindow, tab or WebEngine view is ever made, and when no
+ * QT_QPA_PLATFORM is set the offscreen platform is used so that no
+ * display is needed.  The keys are
+ *
+ *     jobs=N             books processed at once, the number of cores
+ *                        by default
+ *     rename=TEMPLATE    rename the html files in reading order as
+ *                        Rename in the Book Browser does, for example
+ *                        Section0001.xhtml, and update every link
+ *     search=NAME        the full name of a saved search or group to
+ *                        replace all with, may be given more than once
+ *     find=REGEX         a regex to replace all with in the html files,
+ *     replace=TEXT       replace=TEXT after it gives its replacement
+ *     clean=mend|prettify
+ *     reports=DIR        write csv reports of each book into DIR
+ *     output=DIR         save the books into DIR rather than over
+ *                        the originals
+ *     timings=FILE       write how long each step of each book took
+ *                        to the csv FILE
+ *
+ * One line is printed on stdout for each book as it finishes.
+ * The timings are what ci_scripts/perf_compare.py compares between
+ * two builds.
+ * Plugins can not be run since PluginRunner applies their results
+ * through the main window.
+ */
+class BatchProcessor
+{
+
+public:
+
+    enum CleanMode {
+        Clean_None,
+        Clean_Mend,
+        Clean_MendPrettify
+    };
+
+    enum Target {
+        Target_HTML,
+        Target_CSS,
+        Target_OPF,
+        Target_NCX,
+        Target_SVG
+    };
+
+    /**
+     * A saved search turned into the regex the Find & Replace
+     * panel would build from it.
+     */
+    struct Search {
+        QString name;
+        QString regex;
+        QString replacement;
+        Target target;
+    };
+
+    struct Options {
+        int jobs = 0;
+        QString rename_template;
+        QList<Search> searches;
+        CleanMode clean = Clean_None;
+        QString reports_dir;
+        QString output_dir;
+        QString timings_path;
+    };
+
+    /**
+     * What happened to one book, with the milliseconds each
+     * step took in the order they ran.
+     */
+    struct Result {
+        bool saved = false;
+        QString line;
+        QList<std::pair<QString, qint64>> steps;
+    };
+
+    /**
+     * Processes every book in the arguments.
+     *
+     * @return 0 if every book was processed and saved, 1 otherwise.
+     */
+    static int Run(const QStringList &arguments);
+
+    /**
+     * Reads the key=value arguments into options and the rest
+     * into epub_paths.  Saved searches are looked up here, so this
+     * must be called from the GUI thread.
+     *
+     * @return false, with error set, if an argument is not understood.
+     */
+    static bool ParseArguments(const QStringList &arguments, Options &options, QStringList &epub_paths, QString &error);
+
+    /**
+     * Runs the steps in options over one book and saves it.  Safe to
+     * call for several books at once from worker threads.
+     *
+     * @return whether the book was saved and the line to print for it.
+     */
+    static Result ProcessBook(const QString &epub_path, const Options &options);
+
+private:
+
+    static int RenameHTMLFiles(QSharedPointer<Book> book, const QString &rename_template);
+
+    static bool AddSavedSearches(const QString &name, QList<Search> &searches, QString &error);
+
+    static QList<Resource *> TargetResources(QSharedPointer<Book> book, Target target);
+
+    static void WriteReports(QSharedPointer<Book> book, const QString &report_path);
+};
+
+#endif // BATCHPROCESSOR_H
@@ -0,0 +1,234 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QtCore/QThread>
+#include <QtCore/QTimer>
+#include <QtCore/QUrl>
+#include <QtGui/QPageLayout>
+#include <QtGui/QPageSize>
+#include <QtGui/QPixmap>
+#include <QtWebEngineCore/QWebEnginePage>
+#include <QtWebEngineCore/QWebEngineProfile>
+#include <QtWebEngineWidgets/QWebEngineView>
+#include <QDebug>
+
+#include "Misc/BatchRenderer.h"
+#include "Misc/WebProfileMgr.h"
+
+#if 0
+#define DBG if(1)
+#else
+#define DBG if(0)
+#endif
+
+// Every view runs a renderer process so do not start too many
+static const int MAX_PARALLELISM = 8;
+
+static const int DEFAULT_PAGE_WIDTH = 1000;
+
+static const int VIEW_HEIGHT = 800;
+
+// Keeps a full page image within what QPixmap can hold
+static const int MAX_PAGE_HEIGHT = 16384;
+
+// Time for a resized view to be laid out and painted again
+static const int SETTLE_DELAY_MS = 100;
+
+BatchRenderer::BatchRenderer(QObject *parent)
+    :
+    QObject(parent),
+    m_Format(PDF_OUTPUT),
+    m_Parallelism(qBound(1, QThread::idealThreadCount(), MAX_PARALLELISM)),
+    m_PageWidth(DEFAULT_PAGE_WIDTH),
+    m_NextJob(0),
+    m_Done(0)
+{
+}
+
+
+BatchRenderer::~BatchRenderer()
+{
+    ClearPool();
+}
+
+
+void BatchRenderer::SetParallelism(int count)
+{
+    m_Parallelism = qBound(1, count, MAX_PARALLELISM);
+}
+
+
+void BatchRenderer::SetPageWidth(int width)
+{
+    m_PageWidth = qMax(width, 100);
+}
+
+
+void BatchRenderer::Start(const QList<Job> &jobs, OutputFormat format)
+{
+    if (IsRunning()) {
+        return;
+    }
+    m_Jobs = jobs;
+    m_Format = format;
+    m_NextJob = 0;
+    m_Done = 0;
+    m_Failed.clear();
+    if (m_Jobs.isEmpty()) {
+        emit Finished();
+        return;
+    }
+
+    int count = qMin(m_Parallelism, m_Jobs.count());
+    DBG qDebug() << "BatchRenderer rendering" << m_Jobs.count() << "files with" << count << "views";
+    QWebEngineProfile *profile = WebProfileMgr::instance()->GetPreviewProfile();
+    for (int i = 0; i < count; i++) {
+        QWebEngineView *view = new QWebEngineView();
+        view->setPage(new QWebEnginePage(profile, view));
+        view->setAttribute(Qt::WA_DontShowOnScreen);
+        view->resize(m_PageWidth, VIEW_HEIGHT);
+        view->show();
+        connect(view->page(), SIGNAL(loadFinished(bool)), this, SLOT(PageLoaded(bool)));
+        connect(view->page(), SIGNAL(pdfPrintingFinished(const QString &, bool)),
+                this, SLOT(PdfFinished(const QString &, bool)));
+        m_Views << view;
+    }
+    foreach(QWebEngineView *view, m_Views) {
+        StartNext(view);
+    }
+}
+
+
+void BatchRenderer::Cancel()
+{
+    if (!IsRunning()) {
+        return;
+    }
+    for (int job = m_NextJob; job < m_Jobs.count(); job++) {
+        m_Failed << m_Jobs.at(job).output_path;
+    }
+    foreach(int job, m_ViewJobs) {
+        m_Failed << m_Jobs.at(job).output_path;
+    }
+    ClearPool();
+    emit Finished();
+}
+
+
+void BatchRenderer::StartNext(QWebEngineView *view)
+{
+    if (m_NextJob >= m_Jobs.count()) {
+        return;
+    }
+    int job = m_NextJob++;
+    m_ViewJobs.insert(view, job);
+    view->resize(m_PageWidth, VIEW_HEIGHT);
+    QUrl url = QUrl::fromLocalFile(m_Jobs.at(job).fullpath);
+    url.setScheme("sigil");
+    url.setHost("");
+    view->page()->load(url);
+}
+
+
+void BatchRenderer::PageLoaded(bool ok)
+{
+    QWebEngineView *view = ViewForPage(sender());
+    if (!view || !m_ViewJobs.contains(view)) {
+        return;
+    }
+    if (!ok) {
+        JobDone(view, false);
+        return;
+    }
+    const Job &job = m_Jobs.at(m_ViewJobs.value(view));
+    if (m_Format == PDF_OUTPUT) {
+        QPageLayout layout(QPageSize(QPageSize::A4), QPageLayout::Portrait, QMarginsF(10, 10, 10, 10), QPageLayout::Millimeter);
+        view->page()->printToPdf(job.output_path, layout);
+        return;
+    }
+    // lay the view out as tall as the page so the image holds all of it
+    int height = qBound(1, qRound(view->page()->contentsSize().height()), MAX_PAGE_HEIGHT);
+    view->resize(m_PageWidth, height);
+    QTimer::singleShot(SETTLE_DELAY_MS, view, [this, view]() { GrabPage(view); });
+}
+
+
+void BatchRenderer::GrabPage(QWebEngineView *view)
+{
+    if (!m_ViewJobs.contains(view)) {
+        return;
+    }
+    const Job &job = m_Jobs.at(m_ViewJobs.value(view));
+    QPixmap pixmap = view->grab();
+    JobDone(view, !pixmap.isNull() && pixmap.save(job.output_path, "PNG"));
+}
+
+
+void BatchRenderer::PdfFinished(const QString &path, bool ok)
+{
+    QWebEngineView *view = ViewForPage(sender());
+    if (!view || !m_ViewJobs.contains(view)) {
+        return;
+    }
+    DBG qDebug() << "BatchRenderer printed" << path << ok;
+    JobDone(view, ok);
+}
+
+
+void BatchRenderer::JobDone(QWebEngineView *view, bool ok)
+{
+    QString output_path = m_Jobs.at(m_ViewJobs.take(view)).output_path;
+    if (!ok) {
+        m_Failed << output_path;
+    }
+    m_Done++;
+    emit JobFinished(output_path, ok);
+    emit Progress(m_Done);
+    if (m_Done >= m_Jobs.count()) {
+        ClearPool();
+        emit Finished();
+        return;
+    }
+    StartNext(view);
+}
+
+
+void BatchRenderer::ClearPool()
+{
+    m_ViewJobs.clear();
+    foreach(QWebEngineView *view, m_Views) {
+        view->page()->disconnect(this);
+        view->stop();
+        view->deleteLater();
+    }
+    m_Views.clear();
+}
+
+
+QWebEngineView *BatchRenderer::ViewForPage(QObject *page) const
+{
+    foreach(QWebEngineView *view, m_Views) {
+        if (view->page() == page) {
+            return view;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,159 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef BATCHRENDERER_H
+#define BATCHRENDERER_H
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+class QWebEnginePage;
+class QWebEngineView;
+
+/**
+ * Renders a list of book files to PDF or PNG proofs, several at a
+ * time, using a pool of hidden web views.
+ *
+ * The views share the Preview profile and so its sigil: scheme
+ * handler, a file looks just as it does in the Preview less any
+ * dark mode styling.  The files are loaded from disk, so any edits
+ * must be saved before starting.  Each file gets a view of its own
+ * from the pool as soon as one is free, the views are only made
+ * when a run starts and are dropped when it ends.
+ */
+class BatchRenderer : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    enum OutputFormat {
+        PDF_OUTPUT,
+        PNG_OUTPUT
+    };
+
+    /**
+     * A file to render and where to write what it renders to.
+     */
+    struct Job {
+        QString fullpath;
+        QString output_path;
+    };
+
+    BatchRenderer(QObject *parent = NULL);
+    ~BatchRenderer();
+
+    /**
+     * Sets how many files are rendered at the same time, each one
+     * is rendered by a WebEngine process of its own.  Takes effect
+     * on the next Start.
+     */
+    void SetParallelism(int count);
+
+    /**
+     * Sets the width in pixels PNG proofs are laid out at, the
+     * height is that of the whole page.
+     */
+    void SetPageWidth(int width);
+
+    /**
+     * Starts rendering the jobs in the background.  Does nothing
+     * if a run is already going.
+     */
+    void Start(const QList<Job> &jobs, OutputFormat format);
+
+    /**
+     * Stops the run, files being rendered are dropped and
+     * Finished is emitted right away.
+     */
+    void Cancel();
+
+    bool IsRunning() const { return !m_Views.isEmpty(); };
+
+    /**
+     * The output paths of the jobs of the last run that failed.
+     */
+    QStringList GetFailed() const { return m_Failed; };
+
+signals:
+
+    /**
+     * Emitted each time a job is done, done is the number of
+     * jobs finished so far whether they worked or not.
+     */
+    void Progress(int done);
+
+    void JobFinished(const QString &output_path, bool success);
+
+    /**
+     * Emitted once every job is done or the run is cancelled.
+     */
+    void Finished();
+
+private slots:
+
+    void PageLoaded(bool ok);
+
+    void PdfFinished(const QString &path, bool ok);
+
+private:
+
+    void StartNext(QWebEngineView *view);
+
+    void GrabPage(QWebEngineView *view);
+
+    void JobDone(QWebEngineView *view, bool ok);
+
+    void ClearPool();
+
+    QWebEngineView *ViewForPage(QObject *page) const;
+
+    ///////////////////////////////
+    // PRIVATE MEMBER VARIABLES
+    ///////////////////////////////
+
+    QList<Job> m_Jobs;
+
+    OutputFormat m_Format;
+
+    int m_Parallelism;
+
+    int m_PageWidth;
+
+    int m_NextJob;
+
+    int m_Done;
+
+    QStringList m_Failed;
+
+    QList<QWebEngineView *> m_Views;
+
+    /**
+     * The job each busy view is rendering.
+     */
+    QHash<QWebEngineView *, int> m_ViewJobs;
+};
+
+#endif // BATCHRENDERER_H
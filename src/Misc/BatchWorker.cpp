@@ -0,0 +1,332 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <iostream>
+
+#include <QtConcurrent/QtConcurrent>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QEventLoop>
+#include <QtCore/QFileInfo>
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QSysInfo>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <QtNetwork/QLocalSocket>
+
+#include "Misc/BatchWorker.h"
+#include "Misc/Trace.h"
+#include "Misc/Utility.h"
+
+static const QString USAGE = "usage: --worker queue=NAME results=DIR [slots=N] [node=NAME]";
+
+// how long to wait for the queue to take the connection
+static const int CONNECT_TIMEOUT_MS = 30000;
+
+// the ids become file names
+static const QRegularExpression JOB_ID("^[A-Za-z0-9][A-Za-z0-9._-]*$");
+
+
+int BatchWorker::Run(const QStringList &arguments)
+{
+    QString queue_name;
+    QString results_dir;
+    int slot_count = QThread::idealThreadCount();
+    QString node = QString("%1:%2").arg(QSysInfo::machineHostName()).arg(QCoreApplication::applicationPid());
+    foreach(QString argument, arguments) {
+        QString key = argument.section('=', 0, 0);
+        QString value = argument.section('=', 1);
+        if (key == "queue") {
+            queue_name = value;
+        } else if (key == "results") {
+            results_dir = QFileInfo(value).absoluteFilePath();
+        } else if (key == "slots") {
+            bool ok;
+            slot_count = value.toInt(&ok);
+            if (!ok || (slot_count < 1)) {
+                std::cout << QString("slots must be a number above 0: %1").arg(value).toStdString() << std::endl;
+                return 1;
+            }
+        } else if (key == "node") {
+            node = value;
+        } else {
+            std::cout << QString("not a worker argument: %1").arg(argument).toStdString() << std::endl;
+            std::cout << USAGE.toStdString() << std::endl;
+            return 1;
+        }
+    }
+    if (queue_name.isEmpty() || results_dir.isEmpty()) {
+        std::cout << USAGE.toStdString() << std::endl;
+        return 1;
+    }
+    if (!QDir().mkpath(results_dir)) {
+        std::cout << QString("can not create the folder %1").arg(results_dir).toStdString() << std::endl;
+        return 1;
+    }
+
+    QLocalSocket socket;
+    socket.connectToServer(queue_name);
+    if (!socket.waitForConnected(CONNECT_TIMEOUT_MS)) {
+        std::cout << QString("can not connect to the queue %1: %2").arg(queue_name)
+                     .arg(socket.errorString()).toStdString() << std::endl;
+        return 1;
+    }
+
+    // slot_count bounds the books open on this node, the work inside a
+    // book still spreads over the global pool
+    QThreadPool pool;
+    pool.setMaxThreadCount(slot_count);
+
+    int running = 0;
+    int requested = 0;
+    int failed = 0;
+    bool drained = false;
+    bool disconnected = false;
+    QEventLoop loop;
+
+    // Asks for no more jobs than there are free slots so that the
+    // queue is the one place jobs wait, and quits once nothing is
+    // running and no answer is still to come
+    auto request_jobs = [&]() {
+        while (!drained && !disconnected && (running + requested < slot_count)) {
+            QJsonObject request;
+            request["type"] = "request";
+            request["node"] = node;
+            Send(socket, request);
+            requested++;
+        }
+        if ((running == 0) && (disconnected || (drained && (requested == 0)))) {
+            loop.quit();
+        }
+    };
+
+    auto report = [&](QJsonObject result) {
+        result["node"] = node;
+        if (!result["saved"].toBool()) {
+            failed++;
+        }
+        std::cout << result["line"].toString().toStdString() << std::endl;
+        if (!disconnected) {
+            Send(socket, result);
+        }
+    };
+
+    QObject::connect(&socket, &QLocalSocket::readyRead, &loop, [&]() {
+        while (socket.canReadLine()) {
+            QByteArray line = socket.readLine().trimmed();
+            if (line.isEmpty()) {
+                continue;
+            }
+            requested = qMax(0, requested - 1);
+            QJsonObject message = QJsonDocument::fromJson(line).object();
+            if (message["type"].toString() == "none") {
+                drained = true;
+                continue;
+            }
+
+            Job job;
+            QString error;
+            if (!ReadJob(message, job, error)) {
+                report(FailedResult(job, error));
+                continue;
+            }
+            QJsonObject saved = SavedResult(results_dir, job);
+            if (!saved.isEmpty()) {
+                report(saved);
+                continue;
+            }
+
+            // the saved searches are looked up here, on the GUI thread
+            BatchProcessor::Options options;
+            QStringList extra_args;
+            if (!BatchProcessor::ParseArguments(job.args, options, extra_args, error)) {
+                report(FailedResult(job, error));
+                continue;
+            }
+            if (!extra_args.isEmpty()) {
+                report(FailedResult(job, QString("job arguments must be key=value: %1").arg(extra_args.join(" "))));
+                continue;
+            }
+            if (options.output_dir.isEmpty()) {
+                options.output_dir = results_dir + "/" + job.id;
+                if (!QDir().mkpath(options.output_dir)) {
+                    report(FailedResult(job, QString("can not create the folder %1").arg(options.output_dir)));
+                    continue;
+                }
+            }
+
+            running++;
+            QFutureWatcher<BatchProcessor::Result> *watcher = new QFutureWatcher<BatchProcessor::Result>();
+            QObject::connect(watcher, &QFutureWatcher<BatchProcessor::Result>::finished, &loop, [&, watcher, job, options]() {
+                report(JobResult(results_dir, job, options, watcher->result()));
+                watcher->deleteLater();
+                running--;
+                request_jobs();
+            });
+            watcher->setFuture(QtConcurrent::run(&pool, BatchProcessor::ProcessBook, job.epub_path, options));
+        }
+        request_jobs();
+    });
+
+    // the jobs that are running still finish so that a retry of them
+    // somewhere else can find their results
+    QObject::connect(&socket, &QLocalSocket::disconnected, &loop, [&]() {
+        disconnected = true;
+        request_jobs();
+    });
+
+    request_jobs();
+    if (socket.state() == QLocalSocket::ConnectedState) {
+        loop.exec();
+    }
+    return failed > 0 ? 1 : 0;
+}
+
+
+bool BatchWorker::ReadJob(const QJsonObject &message, Job &job, QString &error)
+{
+    job.id = message["id"].toString();
+    job.epub_path = message["epub"].toString();
+    foreach(QJsonValue arg, message["args"].toArray()) {
+        job.args << arg.toString();
+    }
+    if (message["type"].toString() != "job") {
+        error = QString("not a job: %1").arg(message["type"].toString());
+        return false;
+    }
+    if (!JOB_ID.match(job.id).hasMatch()) {
+        error = QString("a job id can only have letters, digits, '.', '_' and '-': %1").arg(job.id);
+        return false;
+    }
+    if (job.epub_path.isEmpty() || !QFileInfo(job.epub_path).isFile()) {
+        error = QString("there is no book at %1").arg(job.epub_path);
+        return false;
+    }
+    job.epub_path = QFileInfo(job.epub_path).absoluteFilePath();
+    return true;
+}
+
+
+QJsonObject BatchWorker::FailedResult(const Job &job, const QString &error)
+{
+    QJsonObject result;
+    result["type"] = "result";
+    result["id"] = job.id;
+    result["saved"] = false;
+    result["line"] = QString("%1: failed: %2").arg(job.epub_path).arg(error);
+    return result;
+}
+
+
+// The result a run of the same job that saved left behind, empty if
+// there is none
+QJsonObject BatchWorker::SavedResult(const QString &results_dir, const Job &job)
+{
+    QString path = ResultPath(results_dir, job.id);
+    if (!QFileInfo(path).isFile()) {
+        return QJsonObject();
+    }
+    QJsonObject saved;
+    try {
+        saved = QJsonDocument::fromJson(Utility::ReadUnicodeTextFile(path).toUtf8()).object();
+    } catch (std::exception &) {
+        return QJsonObject();
+    }
+    QJsonObject saved_job = saved["job"].toObject();
+    if ((saved_job["epub"].toString() != job.epub_path) ||
+        (saved_job["args"].toArray() != QJsonArray::fromStringList(job.args)) ||
+        !saved["saved"].toBool()) {
+        return QJsonObject();
+    }
+    saved.remove("job");
+    saved["reused"] = true;
+    return saved;
+}
+
+
+QJsonObject BatchWorker::JobResult(const QString &results_dir, const Job &job,
+                                   const BatchProcessor::Options &options,
+                                   const BatchProcessor::Result &result)
+{
+    QJsonObject steps;
+    QStringList log;
+    log << result.line;
+    for (const std::pair<QString, qint64> &step : result.steps) {
+        steps[step.first] = step.second;
+        log << QString("%1: %2 ms").arg(step.first).arg(step.second);
+    }
+
+    QJsonObject message;
+    message["type"] = "result";
+    message["id"] = job.id;
+    message["saved"] = result.saved;
+    message["line"] = result.line;
+    message["steps"] = steps;
+    message["output"] = options.output_dir;
+    if (!options.reports_dir.isEmpty()) {
+        message["reports"] = options.reports_dir;
+    }
+    message["reused"] = false;
+
+    try {
+        QString log_path = results_dir + "/" + job.id + ".log";
+        Utility::SaveUnicodeTextFile(log.join('\n') + '\n', log_path);
+        message["log"] = log_path;
+
+        // the spans of this node so far, this job's among them
+        if (Trace::IsEnabled()) {
+            Trace::Write();
+            message["trace"] = QFileInfo(qEnvironmentVariable("SIGIL_TRACE_FILE")).absoluteFilePath();
+        }
+
+        // written last, and whole or not at all, so a job only counts
+        // as done here once everything it made is in place
+        if (result.saved) {
+            QJsonObject saved_job;
+            saved_job["epub"] = job.epub_path;
+            saved_job["args"] = QJsonArray::fromStringList(job.args);
+            QJsonObject saved = message;
+            saved["job"] = saved_job;
+            Utility::SaveUnicodeTextFile(QString::fromUtf8(QJsonDocument(saved).toJson()),
+                                         ResultPath(results_dir, job.id));
+        }
+    } catch (std::exception &e) {
+        message["saved"] = false;
+        message["line"] = QString("%1: failed: %2").arg(job.epub_path).arg(e.what());
+    }
+    return message;
+}
+
+
+void BatchWorker::Send(QLocalSocket &socket, const QJsonObject &message)
+{
+    socket.write(QJsonDocument(message).toJson(QJsonDocument::Compact) + '\n');
+    socket.flush();
+}
+
+
+QString BatchWorker::ResultPath(const QString &results_dir, const QString &id)
+{
+    return results_dir + "/" + id + ".json";
+}
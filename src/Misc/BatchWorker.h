@@ -0,0 +1,113 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef BATCHWORKER_H
+#define BATCHWORKER_H
+
+#include <QtCore/QJsonObject>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+#include "Misc/BatchProcessor.h"
+
+class QLocalSocket;
+
+/**
+ * Takes batch jobs from a queue so that one list of books can be
+ * spread over many machines.
+ *
+ * Run as "Sigil --worker queue=NAME results=DIR [slots=N] [node=NAME]"
+ * and the worker connects to the local socket NAME, the queue, and
+ * asks it for work.  Every message either way is one line of json.
+ * The worker sends
+ *
+ *     {"type": "request", "node": NODE}
+ *
+ * for each of its slots that is free, and the queue answers each
+ * request with one of
+ *
+ *     {"type": "job", "id": ID, "epub": PATH, "args": [KEY=VALUE, ...]}
+ *     {"type": "none"}
+ *
+ * where args are the keys of BatchProcessor, so a job can be a saved
+ * search group, a Mend, the reports and an output folder.  When a job
+ * ends the worker sends
+ *
+ *     {"type": "result", "id": ID, "node": NODE, "saved": BOOL,
+ *      "line": TEXT, "steps": {STEP: MS, ...}, "output": DIR,
+ *      "reports": DIR, "log": FILE, "trace": FILE, "reused": BOOL}
+ *
+ * The keys are
+ *
+ *     queue=NAME    the QLocalServer name or socket path of the queue
+ *     results=DIR   where the log and result of each job are kept
+ *     slots=N       jobs run at once on this node, the number of
+ *                   cores by default
+ *     node=NAME     how this worker names itself, the host name and
+ *                   process id by default
+ *
+ * A job is safe to hand out again after a node goes away.  The books
+ * are never saved over the original, a job without output=DIR saves
+ * into DIR/ID under results, and the result of a job that saved is
+ * kept in results as ID.json.  A job that comes again with the same
+ * id, book and args is answered from that file, "reused" set, rather
+ * than run again.  A job that failed is run again from the start.
+ * The worker exits once the queue has no more jobs for it and its
+ * running jobs are done, or when the queue closes the socket.
+ * Plugins can not be run, as in batch mode.
+ */
+class BatchWorker
+{
+
+public:
+
+    /**
+     * Takes and runs jobs until the queue has none left.
+     *
+     * @return 0 if every job this node ran was saved, 1 otherwise.
+     */
+    static int Run(const QStringList &arguments);
+
+private:
+
+    struct Job {
+        QString id;
+        QString epub_path;
+        QStringList args;
+    };
+
+    static bool ReadJob(const QJsonObject &message, Job &job, QString &error);
+
+    static QJsonObject FailedResult(const Job &job, const QString &error);
+
+    static QJsonObject SavedResult(const QString &results_dir, const Job &job);
+
+    static QJsonObject JobResult(const QString &results_dir, const Job &job,
+                                 const BatchProcessor::Options &options,
+                                 const BatchProcessor::Result &result);
+
+    static void Send(QLocalSocket &socket, const QJsonObject &message);
+
+    static QString ResultPath(const QString &results_dir, const QString &id);
+};
+
+#endif // BATCHWORKER_H
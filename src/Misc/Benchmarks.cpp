@@ -0,0 +1,159 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <algorithm>
+#include <iostream>
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QReadLocker>
+
+#include "BookManipulation/Book.h"
+#include "BookManipulation/FolderKeeper.h"
+#include "Exporters/ExportEPUB.h"
+#include "Importers/ImportEPUB.h"
+#include "Misc/Benchmarks.h"
+#include "Misc/HTMLSpellCheckML.h"
+#include "Misc/TempFolder.h"
+#include "Misc/Utility.h"
+#include "Parsers/CSSInfo.h"
+#include "Parsers/GumboInterface.h"
+#include "Parsers/TagLister.h"
+#include "PCRE2/PCRECache.h"
+#include "sigil_exception.h"
+
+static const int DEFAULT_REPEATS = 5;
+
+// Searches of the kind people save in the Saved Searches
+static const QStringList SEARCHES = QStringList() <<
+                                    "<[^>]+>" <<
+                                    "(?i)\\bthe\\b" <<
+                                    "(?s)<p[^>]*>.*?</p>" <<
+                                    "\\s+</p>";
+
+int Benchmarks::Run(const QStringList &epub_paths)
+{
+    int repeats = Utility::GetEnvironmentVar("SIGIL_BENCHMARK_REPEATS").toInt();
+    if (repeats < 1) {
+        repeats = DEFAULT_REPEATS;
+    }
+    int result = 0;
+
+    foreach(QString epub_path, epub_paths) {
+        std::cout << "# " << QFileInfo(epub_path).absoluteFilePath().toStdString() << std::endl;
+        QSharedPointer<Book> book;
+        try {
+            ImportEPUB importer(epub_path);
+            book = importer.GetBook(false);
+        } catch (std::exception &e) {
+            std::cout << "# could not load: " << e.what() << std::endl;
+            result = 1;
+            continue;
+        }
+
+        QStringList html_texts;
+        qint64 html_bytes = 0;
+        foreach(HTMLResource *resource, book->GetFolderKeeper()->GetResourceTypeList<HTMLResource>(true)) {
+            QReadLocker locker(&resource->GetLock());
+            html_texts << resource->GetText();
+            html_bytes += html_texts.last().length();
+        }
+        QStringList css_texts;
+        qint64 css_bytes = 0;
+        foreach(CSSResource *resource, book->GetFolderKeeper()->GetResourceTypeList<CSSResource>(true)) {
+            QReadLocker locker(&resource->GetLock());
+            css_texts << resource->GetText();
+            css_bytes += css_texts.last().length();
+        }
+        QStringList file_paths;
+        qint64 file_bytes = 0;
+        foreach(Resource *resource, book->GetFolderKeeper()->GetResourceList()) {
+            file_paths << resource->GetFullPath();
+            file_bytes += QFileInfo(file_paths.last()).size();
+        }
+
+        Measure("gumbo parse", html_texts.count(), html_bytes, repeats, [&]() {
+            foreach(const QString &text, html_texts) {
+                GumboInterface gi(text, "any_version");
+                gi.parse();
+            }
+        });
+        Measure("tag lister", html_texts.count(), html_bytes, repeats, [&]() {
+            foreach(const QString &text, html_texts) {
+                TagLister taglist(text);
+            }
+        });
+        Measure("word list", html_texts.count(), html_bytes, repeats, [&]() {
+            foreach(const QString &text, html_texts) {
+                HTMLSpellCheckML::GetWordList(text);
+            }
+        });
+        Measure("css parse", css_texts.count(), css_bytes, repeats, [&]() {
+            foreach(const QString &text, css_texts) {
+                CSSInfo css_info(text);
+            }
+        });
+        for (int i = 0; i < SEARCHES.count(); i++) {
+            QString search = SEARCHES.at(i);
+            Measure(QString("pcre search %1").arg(i + 1), html_texts.count(), html_bytes, repeats, [&]() {
+                foreach(const QString &text, html_texts) {
+                    PCRECache::instance()->getObject(search)->getEveryMatchInfo(text);
+                }
+            });
+        }
+        Measure("file crc32", file_paths.count(), file_bytes, repeats, [&]() {
+            foreach(const QString &path, file_paths) {
+                Utility::FileCRC32(path);
+            }
+        });
+        TempFolder tempfolder;
+        QString export_path = tempfolder.GetPath() + "/benchmark.epub";
+        Measure("export epub", file_paths.count(), file_bytes, repeats, [&]() {
+            // always a full write, never an incremental one
+            QFile::remove(export_path);
+            ExportEPUB exporter(export_path, book);
+            exporter.WriteBook();
+        });
+    }
+    return result;
+}
+
+
+void Benchmarks::Measure(const QString &name, int items, qint64 bytes, int repeats, std::function<void()> fn)
+{
+    fn();
+    QList<double> runs;
+    QElapsedTimer timer;
+    for (int i = 0; i < repeats; i++) {
+        timer.start();
+        fn();
+        runs << timer.nsecsElapsed() / 1000000.0;
+    }
+    std::sort(runs.begin(), runs.end());
+    QString line = QString("%1 %2 files %3 bytes  min %4 ms  median %5 ms")
+                   .arg(name, -20)
+                   .arg(items, 6)
+                   .arg(bytes, 11)
+                   .arg(runs.first(), 9, 'f', 2)
+                   .arg(runs.at(runs.count() / 2), 9, 'f', 2);
+    std::cout << line.toStdString() << std::endl;
+}
@@ -0,0 +1,60 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <functional>
+
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+/**
+ * Times the parsing, regex, checksum and zip code on real books.
+ *
+ * Run as "Sigil --benchmark book.epub ..." to load each book and
+ * time the html and css parsers, the tag lister, word splitting,
+ * a few typical searches, the crc of every file and writing the
+ * epub back out.  Every case runs once to warm up and then
+ * SIGIL_BENCHMARK_REPEATS times (5 by default), the fastest and
+ * the median run are printed on stdout one line per case, so two
+ * builds can be compared over the same books.
+ */
+class Benchmarks
+{
+
+public:
+
+    /**
+     * Runs every case over each book.
+     *
+     * @return 0 if every book could be loaded, 1 otherwise.
+     */
+    static int Run(const QStringList &epub_paths);
+
+private:
+
+    static void Measure(const QString &name, int items, qint64 bytes, int repeats, std::function<void()> fn);
+};
+
+#endif // BENCHMARKS_H
@@ -0,0 +1,332 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <iostream>
+
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QHash>
+#include <QtCore/QTextStream>
+#include <QtGui/QColor>
+#include <QtGui/QImage>
+#include <QtGui/QLinearGradient>
+#include <QtGui/QPainter>
+
+#include "BookManipulation/Book.h"
+#include "BookManipulation/FolderKeeper.h"
+#include "Exporters/ExportEPUB.h"
+#include "Misc/BookGenerator.h"
+#include "Misc/MediaTypes.h"
+#include "Misc/TempFolder.h"
+#include "Misc/Utility.h"
+#include "ResourceObjects/HTMLResource.h"
+#include "ResourceObjects/NavProcessor.h"
+#include "ResourceObjects/NCXResource.h"
+#include "ResourceObjects/OPFResource.h"
+#include "sigil_constants.h"
+#include "sigil_exception.h"
+
+// The layout of a standard Sigil epub
+static const QString OPF_BOOKPATH = "OEBPS/content.opf";
+static const QString NCX_BOOKPATH = "OEBPS/toc.ncx";
+static const QString TEXT_FOLDER = "OEBPS/Text";
+static const QStringList GROUP_BOOKPATHS = QStringList() <<
+                                           "OEBPS/content.opf" << "OEBPS/Text/marker.xhtml" <<
+                                           "OEBPS/Styles/marker.css" << "OEBPS/Fonts/marker.otf" <<
+                                           "OEBPS/Images/marker.jpg" << "OEBPS/Audio/marker.mp3" <<
+                                           "OEBPS/Video/marker.mp4" << "OEBPS/Misc/marker.xml" <<
+                                           "OEBPS/toc.ncx";
+
+static const QString STYLE_NAME = "style.css";
+
+// Enough common words of each language for the text to look
+// plausible to the spell checker and the word reports
+static const QHash<QString, QStringList> WORDS = {
+    { "en", QString("the of and to in is was that for it with as his on be at by had not are but from or have an they which one you were her all she there would their we him been has when who will more no if out so said what up its about into than them can only other new some could time these two may then do first any my now such like our over man me even most made after also did many before must through back years where much your way well down should because each just those people how too little state good very make world still own see men work long get here between both life being under never day same another know while last might us great old year off come since against go came right used take three").split(" ") },
+    { "fr", QString("le de un être et à il avoir ne je son que se qui ce dans en du elle au pour pas que vous par sur faire plus dire me on mon lui nous comme mais pouvoir avec tout y aller voir en bien où sans tu ou leur homme si deux mari moi vouloir te femme venir quand grand celui notre devoir là jour prendre même votre rien petit encore aussi quelque dont tout mer trouver donner temps ça peu même falloir sous parler alors main chose ton mettre vie savoir yeux passer autre après regarder toujours puis jamais cela aimer non heure croire cent monde donc enfant fois seul autre entendre").split(" ") },
+    { "de", QString("der die und in den von zu das mit sich des auf für ist im dem nicht ein eine als auch es an werden aus er hat dass sie nach wird bei einer um am sind noch wie einem über einen so zum war haben nur oder aber vor zur bis mehr durch man sein wurde sei hatte kann gegen vom können schon wenn habe seine ihre dann unter wir soll ich eines jahr zwei jahren diese dieser wieder keine seiner worden und will zwischen immer millionen was sagte gibt alle diesem seit muss doch jetzt drei neue damit bereits da ab ihr ihrer").split(" ") },
+    { "es", QString("de la que el en y a los se del las un por con no una su para es al lo como más o pero sus le ha me si sin sobre este ya entre cuando todo esta ser son dos también fue había era muy años hasta desde está mi porque qué sólo han yo hay vez puede todos así nos ni parte tiene él uno donde bien tiempo mismo ese ahora cada e vida otro después te otros aunque esa eso hace otra gobierno tan durante siempre día tanto ella tres sí dijo sido gran país según menos").split(" ") },
+    { "ru", QString("и в не на я быть он с что а по это она этот к но они мы как из у который то за свой что весь год от так о для ты же все тот мочь вы человек такой его сказать только или ещё бы себя один как уже до время если сам когда другой вот говорить наш мой знать стать при чтобы дело жизнь кто первый очень два день её новый рука даже во со раз где там под можно ну какой после их работа без самый потом надо хотеть ли слово идти большой должен место иметь ничто").split(" ") },
+    { "el", QString("και το να η της του σε με που την για τα δεν από είναι των θα τη ο στο στην ότι οι ένα τους μου στα τον μια αλλά αυτό στις πολύ στη κι ή ήταν στον έχει μας τις όταν στους γιατί θέλω εγώ επίσης όπως μόνο είχε πως πιο έχουν ενώ εκεί αν πρέπει ακόμα όλα μετά όμως πουλί σήμερα καλά μέσα χρόνια ενός κάθε ώρα χώρα μέρα δύο τρία λόγο νέα ζωή").split(" ") },
+    { "ja", QString("日本 時間 今日 自分 世界 学校 先生 友達 仕事 電車 会社 映画 音楽 写真 天気 料理 家族 部屋 言葉 意味 問題 質問 答え 勉強 旅行 季節 春 夏 秋 冬 山 川 海 空 花 木 雨 雪 風 星 月 火 水 金 土 人 子 女 男 手 目 口 耳 足 心 話 本 車 道 町").split(" ") },
+    { "zh", QString("的 一 是 不 了 人 我 在 有 他 这 中 大 来 上 国 个 到 说 们 为 子 和 你 地 出 道 也 时 年 得 就 那 要 下 以 生 会 自 着 去 之 过 家 学 对 可 她 里 后 小 么 心 多 天 而 能 好 都 然 没 日 于 起 还 发 成 事 只 作 当 想 看 文 无 开 手 十 用 主 行 方 又 如 前 所 本 见 经 头 面 公 同 三 已 老 从 动 两 长").split(" ") }
+};
+
+// The properties the stylesheet rules take in turn
+static const QStringList PROPERTIES = QStringList() <<
+                                      "margin: 0 0 %1em 0" << "text-indent: %1em" <<
+                                      "font-size: %1em" << "line-height: 1.%1" <<
+                                      "padding-left: %1em" << "letter-spacing: 0.0%1em";
+
+
+int BookGenerator::Run(const QStringList &arguments)
+{
+    Shape shape;
+    if (arguments.isEmpty() || !ParseShape(arguments.mid(1), shape)) {
+        std::cout << "usage: --generate-book out.epub [version=2.0|3.0] [chapters=N] [paragraphs=N] [words=N] "
+                     "[ids=N] [links=N] [css-rules=N] [images=N] [image-width=N] [image-height=N] "
+                     "[toc-depth=1-6] [index-terms=N] [languages=en,fr,...] [seed=N]" << std::endl;
+        return 1;
+    }
+    try {
+        Write(QFileInfo(arguments.first()).absoluteFilePath(), shape);
+    } catch (std::exception &e) {
+        std::cout << "could not write the book: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+bool BookGenerator::ParseShape(const QStringList &arguments, Shape &shape)
+{
+    QHash<QString, int *> counts;
+    counts["chapters"] = &shape.chapters;
+    counts["paragraphs"] = &shape.paragraphs;
+    counts["words"] = &shape.words;
+    counts["ids"] = &shape.ids;
+    counts["links"] = &shape.links;
+    counts["css-rules"] = &shape.css_rules;
+    counts["images"] = &shape.images;
+    counts["image-width"] = &shape.image_width;
+    counts["image-height"] = &shape.image_height;
+    counts["toc-depth"] = &shape.toc_depth;
+    counts["index-terms"] = &shape.index_terms;
+
+    foreach(QString argument, arguments) {
+        QString key = argument.section('=', 0, 0);
+        QString value = argument.section('=', 1);
+        bool ok = true;
+        if (counts.contains(key)) {
+            *counts[key] = value.toInt(&ok);
+            ok = ok && (*counts[key] >= 0);
+        } else if (key == "version") {
+            shape.version = value;
+            ok = (value == "2.0") || (value == "3.0");
+        } else if (key == "languages") {
+            shape.languages = value.split(',', Qt::SkipEmptyParts);
+            ok = !shape.languages.isEmpty();
+        } else if (key == "seed") {
+            shape.seed = value.toUInt(&ok);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            std::cout << "not understood: " << argument.toStdString() << std::endl;
+            return false;
+        }
+    }
+    shape.chapters = qMax(shape.chapters, 1);
+    shape.paragraphs = qMax(shape.paragraphs, 1);
+    shape.ids = qMin(shape.ids, shape.paragraphs);
+    shape.toc_depth = qBound(1, shape.toc_depth, 6);
+    shape.image_width = qMax(shape.image_width, 1);
+    shape.image_height = qMax(shape.image_height, 1);
+    return true;
+}
+
+
+void BookGenerator::Write(const QString &epub_path, const Shape &shape)
+{
+    QRandomGenerator random(shape.seed);
+    TempFolder tempfolder;
+    QStringList file_paths;
+
+    QString style_path = tempfolder.GetPath() + "/" + STYLE_NAME;
+    Utility::WriteUnicodeTextFile(StyleText(shape), style_path);
+    file_paths << style_path;
+
+    for (int i = 0; i < shape.images; ++i) {
+        QImage image(shape.image_width, shape.image_height, QImage::Format_RGB32);
+        QPainter painter(&image);
+        QLinearGradient gradient(0, 0, shape.image_width, shape.image_height);
+        gradient.setColorAt(0, QColor::fromHsv(random.bounded(360), 160, 220));
+        gradient.setColorAt(1, QColor::fromHsv(random.bounded(360), 200, 120));
+        painter.fillRect(image.rect(), gradient);
+        painter.end();
+        QString image_path = tempfolder.GetPath() + "/" + ImageName(i);
+        image.save(image_path, "JPG", 85);
+        file_paths << image_path;
+    }
+
+    for (int c = 0; c < shape.chapters; ++c) {
+        QString chapter_path = tempfolder.GetPath() + "/" + ChapterName(c);
+        Utility::WriteUnicodeTextFile(ChapterText(c, shape, random), chapter_path);
+        file_paths << chapter_path;
+    }
+
+    QStringList mtypes;
+    foreach(QString bookpath, GROUP_BOOKPATHS) {
+        mtypes << MediaTypes::instance()->GetMediaTypeFromExtension(bookpath.split(".").last());
+    }
+    QSharedPointer<Book> book = QSharedPointer<Book>(new Book());
+    // a new book needs its OPF before anything else
+    book->GetFolderKeeper()->AddOPFToFolder(shape.version, OPF_BOOKPATH);
+    book->GetFolderKeeper()->SetGroupFolders(GROUP_BOOKPATHS, mtypes);
+    book->GetFolderKeeper()->AddContentFilesToFolder(file_paths);
+
+    if (shape.version.startsWith('3')) {
+        HTMLResource *nav_resource = book->CreateEmptyNavFile(true, TEXT_FOLDER, "nav.xhtml", TEXT_FOLDER);
+        book->GetOPF()->SetNavResource(nav_resource);
+        book->GetOPF()->SetItemRefLinear(nav_resource, false);
+        NavProcessor navproc(nav_resource);
+        navproc.GenerateTOCFromBookContents(book.data());
+    } else {
+        book->GetFolderKeeper()->AddNCXToFolder(shape.version, NCX_BOOKPATH, TEXT_FOLDER);
+        NCXResource *ncx_resource = book->GetNCX();
+        QString ncx_id = book->GetOPF()->AddNCXItem(ncx_resource->GetFullPath(), "ncx");
+        book->GetOPF()->UpdateNCXOnSpine(ncx_id);
+        ncx_resource->GenerateNCXFromBookContents(book.data());
+    }
+
+    ExportEPUB exporter(epub_path, book);
+    exporter.WriteBook();
+}
+
+
+QString BookGenerator::ChapterText(int chapter, const Shape &shape, QRandomGenerator &random)
+{
+    QString language = shape.languages.first();
+    QString text;
+    QTextStream out(&text);
+    out << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+    if (shape.version.startsWith('3')) {
+        out << "<!DOCTYPE html>\n\n"
+            << "<html xmlns=\"http://www.w3.org/1999/xhtml\" xmlns:epub=\"http://www.idpf.org/2007/ops\""
+            << " lang=\"" << language << "\" xml:lang=\"" << language << "\">\n";
+    } else {
+        out << "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.1//EN\"\n"
+            << "  \"http://www.w3.org/TR/xhtml11/DTD/xhtml11.dtd\">\n\n"
+            << "<html xmlns=\"http://www.w3.org/1999/xhtml\" xml:lang=\"" << language << "\">\n";
+    }
+    out << "<head>\n  <title>Chapter " << chapter + 1 << "</title>\n"
+        << "  <link href=\"../Styles/" << STYLE_NAME << "\" type=\"text/css\" rel=\"stylesheet\"/>\n"
+        << "</head>\n\n<body>\n"
+        << "  <h1 id=\"chapter" << chapter + 1 << "\">Chapter " << chapter + 1 << "</h1>\n\n";
+
+    // The lower heading levels come round in turn so the toc nests to toc_depth
+    int sections = shape.toc_depth > 1 ? 4 * (shape.toc_depth - 1) : 0;
+    int section_step = sections > 0 ? qMax(shape.paragraphs / (sections + 1), 1) : 0;
+    int section = 0;
+    // The links of the chapter go to the first paragraphs with an id
+    int link_step = shape.links > 0 ? qMax(shape.paragraphs / shape.links, 1) : 0;
+    int links = 0;
+
+    for (int p = 0; p < shape.paragraphs; ++p) {
+        if ((section_step > 0) && (p > 0) && (p % section_step == 0) && (section < sections)) {
+            int level = 2 + section % (shape.toc_depth - 1);
+            out << "  <h" << level << " id=\"s" << chapter + 1 << "_" << section + 1 << "\">Section "
+                << chapter + 1 << "." << section + 1 << "</h" << level << ">\n\n";
+            section++;
+        }
+
+        // the images go round the chapters, one before a paragraph
+        int image = chapter + p * shape.chapters;
+        if (image < shape.images) {
+            out << "  <div class=\"figure\"><img alt=\"\" src=\"../Images/" << ImageName(image) << "\"/></div>\n\n";
+        }
+
+        QString paragraph_language = shape.languages.at(p % shape.languages.count());
+        out << "  <p";
+        if (p < shape.ids) {
+            out << " id=\"p" << chapter + 1 << "_" << p + 1 << "\"";
+        }
+        if (shape.css_rules > 0) {
+            out << " class=\"c" << random.bounded(shape.css_rules) << "\"";
+        }
+        if (paragraph_language != language) {
+            if (shape.version.startsWith('3')) {
+                out << " lang=\"" << paragraph_language << "\"";
+            }
+            out << " xml:lang=\"" << paragraph_language << "\"";
+        }
+        out << ">";
+
+        // and so do the index terms, at the start of a paragraph
+        int term = chapter + p * shape.chapters;
+        if (term < shape.index_terms) {
+            out << "<span class=\"" << SIGIL_INDEX_CLASS << "\" title=\"Term " << term + 1 << "\">Term "
+                << term + 1 << "</span> ";
+        }
+
+        out << ParagraphText(paragraph_language, shape.words, random);
+
+        if ((link_step > 0) && (p % link_step == 0) && (links < shape.links) && (shape.ids > 0)) {
+            int target = random.bounded(shape.chapters);
+            out << " <a href=\"" << (target == chapter ? QString() : ChapterName(target)) << "#p" << target + 1 << "_"
+                << random.bounded(shape.ids) + 1 << "\">see also</a>";
+            links++;
+        }
+        out << "</p>\n\n";
+    }
+    out << "</body>\n</html>\n";
+    out.flush();
+    return text;
+}
+
+
+QString BookGenerator::ParagraphText(const QString &language, int words, QRandomGenerator &random)
+{
+    QStringList word_list = WORDS.value(language.section('-', 0, 0), WORDS.value("en"));
+    QStringList paragraph;
+    for (int i = 0; i < words; ++i) {
+        paragraph << word_list.at(random.bounded(word_list.count()));
+    }
+    if (!paragraph.isEmpty()) {
+        paragraph.first()[0] = paragraph.first().at(0).toUpper();
+    }
+    return paragraph.join(" ") + ".";
+}
+
+
+QString BookGenerator::StyleText(const Shape &shape)
+{
+    QString text;
+    QTextStream out(&text);
+    out << "body {\n  margin: 0 5%;\n}\n\n"
+        << "div.figure {\n  text-align: center;\n}\n\n"
+        << "div.figure img {\n  max-width: 100%;\n}\n\n";
+    for (int i = 0; i < shape.css_rules; ++i) {
+        // plain class rules mostly, with some that need the tree to match
+        if (i % 10 == 9) {
+            out << "h1 ~ p.c" << i;
+        } else if (i % 10 == 8) {
+            out << "body > p.c" << i << ":first-child";
+        } else {
+            out << ".c" << i;
+        }
+        out << " {\n  " << PROPERTIES.at(i % PROPERTIES.count()).arg(1 + i % 3) << ";\n}\n\n";
+    }
+    out.flush();
+    return text;
+}
+
+
+QString BookGenerator::ChapterName(int chapter)
+{
+    return QString("chapter%1.xhtml").arg(chapter + 1, 5, 10, QChar('0'));
+}
+
+
+QString BookGenerator::ImageName(int image)
+{
+    return QString("image%1.jpg").arg(image + 1, 5, 10, QChar('0'));
+}
@@ -0,0 +1,104 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef BOOKGENERATOR_H
+#define BOOKGENERATOR_H
+
+#include <QtCore/QRandomGenerator>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+/**
+ * Writes made up books of any size for scale testing.
+ *
+ * Run as "Sigil --generate-book out.epub key=value ..." where the
+ * keys are those of Shape with dashes, for example chapters=2000
+ * or languages=en,fr,el.  The book is built in a Book and written
+ * with ExportEPUB so it looks to ImportEPUB, the reports and search
+ * exactly as a book saved by Sigil does.  The same shape and seed
+ * always give the same book.
+ */
+class BookGenerator
+{
+
+public:
+
+    struct Shape {
+        QString version = "3.0";
+        int chapters = 100;
+        // per chapter
+        int paragraphs = 50;
+        // per paragraph
+        int words = 60;
+        // paragraphs with an id, per chapter
+        int ids = 20;
+        // links to ids in other chapters, per chapter
+        int links = 20;
+        int css_rules = 200;
+        int images = 20;
+        int image_width = 800;
+        int image_height = 600;
+        // heading levels in each chapter, which is the depth of the toc
+        int toc_depth = 2;
+        // index markers over the whole book
+        int index_terms = 50;
+        // paragraphs take these in turn, the first is the book language
+        QStringList languages = QStringList() << "en";
+        quint32 seed = 1;
+    };
+
+    /**
+     * Writes a book with the shape given by arguments to the
+     * path in the first argument.
+     *
+     * @return 0 on success, 1 if the arguments or the write failed.
+     */
+    static int Run(const QStringList &arguments);
+
+    /**
+     * Reads key=value arguments into a shape.
+     *
+     * @return false if an argument is not understood.
+     */
+    static bool ParseShape(const QStringList &arguments, Shape &shape);
+
+    /**
+     * Writes a book of the shape to epub_path.
+     *
+     * @throws what Book and ExportEPUB throw.
+     */
+    static void Write(const QString &epub_path, const Shape &shape);
+
+private:
+
+    static QString ChapterText(int chapter, const Shape &shape, QRandomGenerator &random);
+
+    static QString ParagraphText(const QString &language, int words, QRandomGenerator &random);
+
+    static QString StyleText(const Shape &shape);
+
+    static QString ChapterName(int chapter);
+
+    static QString ImageName(int image);
+};
+
+#endif // BOOKGENERATOR_H
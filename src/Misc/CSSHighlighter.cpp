@@ -20,6 +20,7 @@
 *************************************************************************/
 
 #include <QApplication>
+#include <QTextBlockUserData>
 
 #include "Misc/CSSHighlighter.h"
 #include "Misc/SettingsStore.h"
@@ -68,8 +69,55 @@ static const int transitions[ 10 ][ 9 ] = {
 };
 
 
+// Blocks at least this long keep how they were highlighted so that an
+// edit only scans again from a little before the change
+static const int LONG_BLOCK_LENGTH = 16 * 1024;
+
+// Distance between the states kept for a long block
+static const int CHECKPOINT_DISTANCE = 4 * 1024;
+
+
+class CSSHighlighter::LongBlockData : public QTextBlockUserData
+{
+public:
+    QString text;
+    int initial;
+    int end_state;
+    QVector<Segment> segments;
+    QVector<Checkpoint> checkpoints;
+};
+
+
+void CSSHighlighter::AddSegment(QVector<Segment> &segments, int text_length, int start, int length, int state)
+{
+    if (start >= text_length || length <= 0) {
+        return;
+    }
+
+    switch (state) {
+        case Selector:
+        case Property:
+        case Value:
+        case Pseudo1:
+        case Pseudo2:
+        case Quote:
+        case Comment:
+        case MaybeCommentEnd: {
+            Segment segment = { start, length, state };
+            segments.append(segment);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+
 CSSHighlighter::CSSHighlighter(QObject *parent)
-    : QSyntaxHighlighter(parent)
+    : QSyntaxHighlighter(parent),
+      m_firstHighlightedBlock(-1),
+      m_lastHighlightedBlock(-1)
 {
     SettingsStore settings;
     if (Utility::IsDarkMode()) {
@@ -77,6 +125,16 @@ CSSHighlighter::CSSHighlighter(QObject *parent)
     } else {
         m_codeViewAppearance = settings.codeViewAppearance();
     }
+
+    // states with no format of their own are left unformatted
+    m_Formats[Selector].setForeground(m_codeViewAppearance.css_selector_color);
+    m_Formats[Property].setForeground(m_codeViewAppearance.css_property_color);
+    m_Formats[Value].setForeground(m_codeViewAppearance.css_value_color);
+    m_Formats[Pseudo1].setForeground(m_codeViewAppearance.css_selector_color);
+    m_Formats[Pseudo2].setForeground(m_codeViewAppearance.css_selector_color);
+    m_Formats[Quote].setForeground(m_codeViewAppearance.css_quote_color);
+    m_Formats[Comment].setForeground(m_codeViewAppearance.css_comment_color);
+    m_Formats[MaybeCommentEnd].setForeground(m_codeViewAppearance.css_comment_color);
 }
 
 void CSSHighlighter::do_rehighlight()
@@ -86,10 +144,22 @@ void CSSHighlighter::do_rehighlight()
     QApplication::restoreOverrideCursor();
 }
 
+void CSSHighlighter::SetHighlightedBlocks(int first, int last)
+{
+    m_firstHighlightedBlock = first;
+    m_lastHighlightedBlock = last;
+}
+
 void CSSHighlighter::highlightBlock(const QString &text)
 {
-    int lastIndex = 0;
-    bool lastWasSlash = false;
+    if (m_firstHighlightedBlock >= 0) {
+        int block_number = currentBlock().blockNumber();
+        if ((block_number < m_firstHighlightedBlock) || (block_number > m_lastHighlightedBlock)) {
+            setCurrentBlockState(-1);
+            return;
+        }
+    }
+
     int state = previousBlockState();
     int save_state = 0;
 
@@ -116,7 +186,116 @@ void CSSHighlighter::highlightBlock(const QString &text)
         state = save_state;
     }
 
-    for (int i = 0; i < text.length(); i++) {
+    Checkpoint start = { 0, state, save_state, 0, false, 0 };
+
+    if (text.length() < LONG_BLOCK_LENGTH) {
+        if (currentBlockUserData()) {
+            setCurrentBlockUserData(NULL);
+        }
+        QVector<Segment> segments;
+        int block_state = Scan(text, start, segments, NULL, NULL, 0, 0);
+        ApplySegments(segments);
+        setCurrentBlockState(block_state);
+        return;
+    }
+
+    LongBlockData *old = static_cast<LongBlockData *>(currentBlockUserData());
+    LongBlockData *data = new LongBlockData();
+    data->text = text;
+    data->initial = state + (save_state << 16);
+
+    if (old && (old->initial == data->initial) && !old->checkpoints.isEmpty()) {
+        // only the text between the common start and end has changed
+        int old_length = old->text.length();
+        int common = qMin(old_length, text.length());
+        const QChar *old_chars = old->text.constData();
+        const QChar *chars = text.constData();
+        int prefix = 0;
+        while (prefix < common && old_chars[prefix] == chars[prefix]) {
+            prefix++;
+        }
+        int suffix = 0;
+        while (suffix < common - prefix && old_chars[old_length - 1 - suffix] == chars[text.length() - 1 - suffix]) {
+            suffix++;
+        }
+
+        // the first checkpoint is always the start of the block
+        int k = old->checkpoints.count() - 1;
+        while (k > 0 && old->checkpoints.at(k).pos > prefix) {
+            k--;
+        }
+        const Checkpoint &resume = old->checkpoints.at(k);
+        data->segments = old->segments.mid(0, resume.segments);
+        data->checkpoints = old->checkpoints.mid(0, k + 1);
+        data->end_state = Scan(text, resume, data->segments, &data->checkpoints, old, prefix, suffix);
+    } else {
+        data->checkpoints.append(start);
+        data->end_state = Scan(text, start, data->segments, &data->checkpoints, NULL, 0, 0);
+    }
+
+    ApplySegments(data->segments);
+    // deletes the old data
+    setCurrentBlockUserData(data);
+    setCurrentBlockState(data->end_state);
+}
+
+
+int CSSHighlighter::Scan(const QString &text, const Checkpoint &from, QVector<Segment> &segments,
+                         QVector<Checkpoint> *checkpoints, const LongBlockData *old, int prefix, int suffix)
+{
+    int state = from.state;
+    int save_state = from.save_state;
+    int lastIndex = from.last_index;
+    bool lastWasSlash = from.last_was_slash;
+    const int length = text.length();
+
+    // Past the change the old scan can be picked up again at any of its
+    // checkpoints where this one is in the same state, from then on both
+    // see the same text and the old ranges only need to be moved over
+    int delta = 0;
+    int next_old = 0;
+    if (old) {
+        delta = length - old->text.length();
+        int unchanged_from = old->text.length() - suffix;
+        while (next_old < old->checkpoints.count() &&
+               ((old->checkpoints.at(next_old).pos < unchanged_from) ||
+                (old->checkpoints.at(next_old).pos + delta <= from.pos))) {
+            next_old++;
+        }
+    }
+    int next_checkpoint = (from.pos / CHECKPOINT_DISTANCE + 1) * CHECKPOINT_DISTANCE;
+
+    for (int i = from.pos; i < length; i++) {
+        if (old && (next_old < old->checkpoints.count()) && (old->checkpoints.at(next_old).pos + delta == i)) {
+            const Checkpoint &cp = old->checkpoints.at(next_old);
+            if ((cp.state == state) && (cp.save_state == save_state) &&
+                (cp.last_was_slash == lastWasSlash) && (cp.last_index + delta == lastIndex)) {
+                int offset = segments.count() - cp.segments;
+                for (int j = cp.segments; j < old->segments.count(); j++) {
+                    Segment segment = old->segments.at(j);
+                    segment.start += delta;
+                    segments.append(segment);
+                }
+                if (checkpoints) {
+                    for (int j = next_old; j < old->checkpoints.count(); j++) {
+                        Checkpoint checkpoint = old->checkpoints.at(j);
+                        checkpoint.pos += delta;
+                        checkpoint.last_index += delta;
+                        checkpoint.segments += offset;
+                        checkpoints->append(checkpoint);
+                    }
+                }
+                return old->end_state;
+            }
+            next_old++;
+        }
+
+        if (checkpoints && (i == next_checkpoint)) {
+            Checkpoint checkpoint = { i, state, save_state, lastIndex, lastWasSlash, int(segments.count()) };
+            checkpoints->append(checkpoint);
+            next_checkpoint += CHECKPOINT_DISTANCE;
+        }
+
         int token = ALNUM;
         const char character = text.at(i).toLatin1();
 
@@ -148,7 +327,7 @@ void CSSHighlighter::highlightBlock(const QString &text)
             bool include_token = new_state == MaybeCommentEnd ||
                                  (state == MaybeCommentEnd && new_state != Comment) ||
                                  state == Quote;
-            highlight(text, lastIndex, i - lastIndex + include_token, state);
+            AddSegment(segments, length, lastIndex, i - lastIndex + include_token, state);
 
             if (new_state == Comment) {
                 lastIndex = i - 1;    // include the slash and star
@@ -167,51 +346,14 @@ void CSSHighlighter::highlightBlock(const QString &text)
         }
     }
 
-    highlight(text, lastIndex, text.length() - lastIndex, state);
-    setCurrentBlockState(state + (save_state << 16));
+    AddSegment(segments, length, lastIndex, length - lastIndex, state);
+    return state + (save_state << 16);
 }
 
 
-void CSSHighlighter::highlight(const QString &text, int start, int length, int state)
+void CSSHighlighter::ApplySegments(const QVector<Segment> &segments)
 {
-    if (start >= text.length() || length <= 0) {
-        return;
-    }
-
-    QTextCharFormat format;
-
-    switch (state) {
-        case Selector:
-            setFormat(start, length, m_codeViewAppearance.css_selector_color);
-            break;
-
-        case Property:
-            setFormat(start, length, m_codeViewAppearance.css_property_color);
-            break;
-
-        case Value:
-            setFormat(start, length, m_codeViewAppearance.css_value_color);
-            break;
-
-        case Pseudo1:
-            setFormat(start, length, m_codeViewAppearance.css_selector_color);
-            break;
-
-        case Pseudo2:
-            setFormat(start, length, m_codeViewAppearance.css_selector_color);
-            break;
-
-        case Quote:
-            setFormat(start, length, m_codeViewAppearance.css_quote_color);
-            break;
-
-        case Comment:
-        case MaybeCommentEnd:
-            format.setForeground(m_codeViewAppearance.css_comment_color);
-            setFormat(start, length, format);
-            break;
-
-        default:
-            break;
+    foreach(const Segment &segment, segments) {
+        setFormat(segment.start, segment.length, m_Formats[segment.state]);
     }
 }
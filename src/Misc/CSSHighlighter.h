@@ -22,10 +22,22 @@
 #ifndef CSSHIGHLIGHTER_H
 #define CSSHIGHLIGHTER_H
 
+#include <QtCore/QVector>
 #include <QtGui/QSyntaxHighlighter>
 
 #include "Misc/SettingsStore.h"
 
+/**
+ * Highlights css with a small state machine run over each block.
+ *
+ * A very long block, such as a whole minified style sheet on one
+ * line, keeps the states the machine passed through every few
+ * thousand characters along with the ranges it formatted.  When such
+ * a block is edited the scan starts again from the last of these
+ * before the change and stops as soon as it is back in the state
+ * the last scan was in at the same place, the rest of the ranges
+ * are just moved over.
+ */
 class CSSHighlighter : public QSyntaxHighlighter
 {
     Q_OBJECT
@@ -36,14 +48,61 @@ public:
 
     void do_rehighlight();
 
+    /**
+     * Limits highlighting to the blocks numbered first to last.  The
+     * other blocks are left plain and the block after them starts
+     * over from the initial state.  A first of -1 highlights every
+     * block again.
+     */
+    void SetHighlightedBlocks(int first, int last);
+
 protected:
 
     void highlightBlock(const QString &text);
-    void highlight(const QString &, int start, int length, int state);
 
 private:
 
+    // A stretch of text in one state
+    struct Segment {
+        int start;
+        int length;
+        int state;
+    };
+
+    // Where the scan was just before the character at pos
+    struct Checkpoint {
+        int pos;
+        int state;
+        int save_state;
+        int last_index;
+        bool last_was_slash;
+        int segments;
+    };
+
+    class LongBlockData;
+
+    /**
+     * Runs the state machine over text starting from the checkpoint
+     * from, adding to segments and, when checkpoints is not NULL, to
+     * checkpoints.  When old is given the scan stops once it is in
+     * step again with the old scan of the block and the rest is taken
+     * from it.  Returns the block state to store.
+     */
+    int Scan(const QString &text, const Checkpoint &from, QVector<Segment> &segments,
+             QVector<Checkpoint> *checkpoints, const LongBlockData *old, int prefix, int suffix);
+
+    // Only keeps the states that have a format of their own
+    static void AddSegment(QVector<Segment> &segments, int text_length, int start, int length, int state);
+
+    void ApplySegments(const QVector<Segment> &segments);
+
     SettingsStore::CodeViewAppearance m_codeViewAppearance;
+
+    // the format of each parser state, set up once
+    QTextCharFormat m_Formats[10];
+
+    int m_firstHighlightedBlock;
+    int m_lastHighlightedBlock;
 };
 
 #endif // CSSHIGHLIGHTER_H
@@ -0,0 +1,113 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QtConcurrent/QtConcurrent>
+#include <QDebug>
+
+#include "Misc/CheckpointHashes.h"
+
+#if 0
+#define DBG if(1)
+#else
+#define DBG if(0)
+#endif
+
+static const qint64 HASH_BLOCK_SIZE = 1024 * 1024;
+
+QHash<QString, CheckpointHashes::Entry> CheckpointHashes::m_Entries;
+QMutex CheckpointHashes::m_Mutex;
+
+
+QStringList CheckpointHashes::BlobHashes(const QString &bookroot, const QStringList &bookpaths)
+{
+    QStringList hashes;
+    QStringList fullpaths;
+    QList<QFileInfo> infos;
+    QStringList misses;
+    {
+        QMutexLocker locker(&m_Mutex);
+        foreach(QString bookpath, bookpaths) {
+            QString fullpath = bookroot + "/" + bookpath;
+            QFileInfo fi(fullpath);
+            fullpaths << fullpath;
+            infos << fi;
+            QHash<QString, Entry>::const_iterator it = m_Entries.constFind(fullpath);
+            if (it != m_Entries.constEnd() && fi.exists() &&
+                it->size == fi.size() && it->modified == fi.lastModified()) {
+                hashes << it->hash;
+            } else {
+                hashes << QString();
+                misses << fullpath;
+            }
+        }
+    }
+    DBG qDebug() << "CheckpointHashes hashing" << misses.count() << "of" << bookpaths.count() << "files";
+
+    QList<QString> computed = QtConcurrent::blockingMapped(misses, HashFile);
+
+    QMutexLocker locker(&m_Mutex);
+    int j = 0;
+    for (int i = 0; i < hashes.count(); i++) {
+        if (!hashes.at(i).isEmpty()) {
+            continue;
+        }
+        QString hash = computed.at(j++);
+        hashes[i] = hash;
+        if (hash.isEmpty()) {
+            m_Entries.remove(fullpaths.at(i));
+            continue;
+        }
+        Entry entry;
+        entry.size = infos.at(i).size();
+        entry.modified = infos.at(i).lastModified();
+        entry.hash = hash;
+        m_Entries.insert(fullpaths.at(i), entry);
+    }
+    return hashes;
+}
+
+
+// Runs in a worker thread.
+// A git blob id is the sha1 of "blob <size>\0" followed by the contents
+QString CheckpointHashes::HashFile(const QString &fullpath)
+{
+    QFile file(fullpath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    QCryptographicHash hasher(QCryptographicHash::Sha1);
+    QByteArray header = "blob " + QByteArray::number(file.size());
+    header.append('\0');
+    hasher.addData(header);
+    qint64 remaining = file.size();
+    while (remaining > 0) {
+        QByteArray block = file.read(HASH_BLOCK_SIZE);
+        if (block.isEmpty()) {
+            return QString();
+        }
+        hasher.addData(block);
+        remaining -= block.size();
+    }
+    return QString::fromLatin1(hasher.result().toHex());
+}
@@ -0,0 +1,68 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef CHECKPOINTHASHES_H
+#define CHECKPOINTHASHES_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+/**
+ * Keeps the git blob id of every book file handed to a checkpoint.
+ *
+ * A file is only read and hashed again when its size or modification
+ * time has changed since the last checkpoint, much like git's own index.
+ * Since a book wide save leaves files that already hold the current
+ * revision of their resource alone, only the files edited since the
+ * last checkpoint end up being read.  The repo manager compares these
+ * ids with its staged ones so it copies and stages just those files.
+ */
+class CheckpointHashes
+{
+public:
+    /**
+     * Returns the git blob id (hex sha1) of each bookpath under bookroot,
+     * in the same order.  An entry is empty if its file could not be read.
+     */
+    static QStringList BlobHashes(const QString &bookroot, const QStringList &bookpaths);
+
+private:
+    struct Entry {
+        qint64 size;
+        QDateTime modified;
+        QString hash;
+    };
+
+    static QString HashFile(const QString &fullpath);
+
+    /**
+     * Cached entries keyed by full file path.
+     */
+    static QHash<QString, Entry> m_Entries;
+
+    static QMutex m_Mutex;
+};
+
+#endif // CHECKPOINTHASHES_H
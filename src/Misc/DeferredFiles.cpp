@@ -0,0 +1,236 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QtConcurrent/QtConcurrent>
+#include <QtCore/QMutexLocker>
+#include <QDebug>
+
+#include "Misc/DeferredFiles.h"
+#include "Misc/MappedZipArchive.h"
+#include "Misc/TaskScheduler.h"
+
+#if 0
+#define DBG if(1)
+#else
+#define DBG if(0)
+#endif
+
+QMutex DeferredFiles::s_InstancesMutex;
+QList<DeferredFiles *> DeferredFiles::s_Instances;
+QAtomicInt DeferredFiles::s_PendingFiles;
+
+DeferredFiles::DeferredFiles(const QString &zippath, const QList<Entry> &entries)
+    :
+    m_Archive(new MappedZipArchive(zippath)),
+    m_Cancelled(false),
+    m_BackgroundRunning(false)
+{
+    foreach(const Entry &entry, entries) {
+        if (!m_Pending.contains(entry.file_path)) {
+            m_Order << entry.file_path;
+        }
+        m_Pending.insert(entry.file_path, entry);
+    }
+    s_PendingFiles.fetchAndAddOrdered(m_Pending.count());
+    QMutexLocker locker(&s_InstancesMutex);
+    s_Instances << this;
+}
+
+
+DeferredFiles::~DeferredFiles()
+{
+    {
+        QMutexLocker locker(&m_Mutex);
+        m_Cancelled = true;
+    }
+    m_Future.waitForFinished();
+    {
+        QMutexLocker locker(&s_InstancesMutex);
+        s_Instances.removeAll(this);
+    }
+    QMutexLocker locker(&m_Mutex);
+    s_PendingFiles.fetchAndAddOrdered(-m_Pending.count());
+    m_Pending.clear();
+    delete m_Archive;
+    m_Archive = NULL;
+}
+
+
+void DeferredFiles::Start()
+{
+    {
+        QMutexLocker locker(&m_Mutex);
+        m_BackgroundRunning = true;
+    }
+    m_Future = TaskScheduler::Run(TaskScheduler::BackgroundLane, &DeferredFiles::ExtractInBackground, this);
+}
+
+
+void DeferredFiles::WaitForAll()
+{
+    m_Future.waitForFinished();
+    // anything the background thread could not get to
+    QStringList remaining;
+    {
+        QMutexLocker locker(&m_Mutex);
+        remaining = m_Pending.keys();
+    }
+    foreach(QString file_path, remaining) {
+        MaterializeOne(file_path);
+    }
+    QMutexLocker locker(&m_Mutex);
+    while (!m_InProgress.isEmpty()) {
+        m_FileDone.wait(&m_Mutex);
+    }
+    ReleaseArchiveIfDone();
+}
+
+
+void DeferredFiles::Materialize(const QString &file_path)
+{
+    if (s_PendingFiles.loadAcquire() == 0) {
+        return;
+    }
+    QMutexLocker locker(&s_InstancesMutex);
+    foreach(DeferredFiles *instance, s_Instances) {
+        instance->MaterializeOne(file_path);
+    }
+}
+
+
+void DeferredFiles::Forget(const QString &file_path)
+{
+    if (s_PendingFiles.loadAcquire() == 0) {
+        return;
+    }
+    QMutexLocker locker(&s_InstancesMutex);
+    foreach(DeferredFiles *instance, s_Instances) {
+        instance->ForgetOne(file_path);
+    }
+}
+
+
+// Runs in a worker thread.
+void DeferredFiles::ExtractInBackground()
+{
+    void *zfile = NULL;
+    int next = 0;
+    while (true) {
+        Entry entry;
+        {
+            QMutexLocker locker(&m_Mutex);
+            while (next < m_Order.count() && !m_Pending.contains(m_Order.at(next))) {
+                next++;
+            }
+            if (m_Cancelled || (next >= m_Order.count())) {
+                break;
+            }
+            entry = m_Pending.take(m_Order.at(next));
+            m_InProgress.insert(entry.file_path);
+        }
+        if (!zfile) {
+            zfile = m_Archive->Open();
+        }
+        Extract(zfile, entry);
+        QMutexLocker locker(&m_Mutex);
+        FileDone(entry.file_path);
+    }
+    if (zfile) {
+        unzClose(zfile);
+    }
+    QMutexLocker locker(&m_Mutex);
+    m_BackgroundRunning = false;
+    ReleaseArchiveIfDone();
+}
+
+
+void DeferredFiles::MaterializeOne(const QString &file_path)
+{
+    Entry entry;
+    {
+        QMutexLocker locker(&m_Mutex);
+        while (m_InProgress.contains(file_path)) {
+            m_FileDone.wait(&m_Mutex);
+        }
+        if (!m_Pending.contains(file_path)) {
+            return;
+        }
+        entry = m_Pending.take(file_path);
+        m_InProgress.insert(file_path);
+    }
+    DBG qDebug() << "DeferredFiles extracting on demand" << file_path;
+    void *zfile = m_Archive->Open();
+    Extract(zfile, entry);
+    if (zfile) {
+        unzClose(zfile);
+    }
+    QMutexLocker locker(&m_Mutex);
+    FileDone(file_path);
+    ReleaseArchiveIfDone();
+}
+
+
+void DeferredFiles::ForgetOne(const QString &file_path)
+{
+    QMutexLocker locker(&m_Mutex);
+    while (m_InProgress.contains(file_path)) {
+        m_FileDone.wait(&m_Mutex);
+    }
+    if (m_Pending.remove(file_path)) {
+        s_PendingFiles.deref();
+        ReleaseArchiveIfDone();
+    }
+}
+
+
+bool DeferredFiles::Extract(void *zfile, const Entry &entry)
+{
+    unz64_file_pos pos;
+    pos.pos_in_zip_directory = entry.pos_in_zip_directory;
+    pos.num_of_file = entry.num_of_file;
+    if (!zfile ||
+        (unzGoToFilePos64(zfile, &pos) != UNZ_OK) ||
+        !m_Archive->ExtractCurrentFile(zfile, entry.file_path)) {
+        qDebug() << "Cannot extract deferred file: " << entry.file_path;
+        return false;
+    }
+    return true;
+}
+
+
+void DeferredFiles::FileDone(const QString &file_path)
+{
+    m_InProgress.remove(file_path);
+    s_PendingFiles.deref();
+    m_FileDone.wakeAll();
+}
+
+
+// The mapping is given up as soon as it is no longer needed so that
+// the epub it was opened from can be overwritten by a save.
+void DeferredFiles::ReleaseArchiveIfDone()
+{
+    if (m_Archive && m_Pending.isEmpty() && m_InProgress.isEmpty() && !m_BackgroundRunning) {
+        DBG qDebug() << "DeferredFiles all files extracted";
+        delete m_Archive;
+        m_Archive = NULL;
+    }
+}
@@ -0,0 +1,143 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef DEFERREDFILES_H
+#define DEFERREDFILES_H
+
+#include <QtCore/QAtomicInt>
+#include <QtCore/QFuture>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QWaitCondition>
+
+class MappedZipArchive;
+
+/**
+ * Files of an opened epub that were left in the archive.
+ *
+ * An empty file stands in for each one in the book folder until it
+ * is extracted, either by a background thread started with Start or
+ * on the calling thread as soon as something asks for the file
+ * through Materialize.  Resource::GetFullPath does that, so code that
+ * reads a resource's file always finds it complete.
+ */
+class DeferredFiles
+{
+
+public:
+
+    /**
+     * A file to extract, located by its position
+     * in the zip central directory.
+     */
+    struct Entry {
+        quint64 pos_in_zip_directory;
+        quint64 num_of_file;
+        QString file_path;
+    };
+
+    DeferredFiles(const QString &zippath, const QList<Entry> &entries);
+
+    /**
+     * Stops the background extraction.  Files not
+     * extracted by then stay empty.
+     */
+    ~DeferredFiles();
+
+    /**
+     * Starts extracting every file in a background thread.
+     */
+    void Start();
+
+    /**
+     * Returns once every file has been extracted.
+     */
+    void WaitForAll();
+
+    /**
+     * Extracts file_path right away if it is still in the
+     * archive and waits for it if it is being extracted.
+     * Does nothing for any other path.
+     */
+    static void Materialize(const QString &file_path);
+
+    /**
+     * Drops file_path from the files still to extract,
+     * used when the file is about to be deleted.
+     */
+    static void Forget(const QString &file_path);
+
+private:
+
+    void ExtractInBackground();
+
+    void MaterializeOne(const QString &file_path);
+
+    void ForgetOne(const QString &file_path);
+
+    bool Extract(void *zfile, const Entry &entry);
+
+    /**
+     * Called with m_Mutex held once a file is no longer pending.
+     */
+    void FileDone(const QString &file_path);
+
+    void ReleaseArchiveIfDone();
+
+    MappedZipArchive *m_Archive;
+
+    QHash<QString, Entry> m_Pending;
+
+    /**
+     * The order of the files in the archive, which is
+     * the order the background thread extracts them in.
+     */
+    QStringList m_Order;
+
+    QSet<QString> m_InProgress;
+
+    QMutex m_Mutex;
+
+    QWaitCondition m_FileDone;
+
+    bool m_Cancelled;
+
+    bool m_BackgroundRunning;
+
+    QFuture<void> m_Future;
+
+    static QMutex s_InstancesMutex;
+
+    static QList<DeferredFiles *> s_Instances;
+
+    /**
+     * Files pending or in progress over every instance, so that
+     * Materialize costs nothing once everything is extracted.
+     */
+    static QAtomicInt s_PendingFiles;
+};
+
+#endif // DEFERREDFILES_H
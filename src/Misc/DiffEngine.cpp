@@ -0,0 +1,585 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+#include <QFile>
+#include <QHash>
+#include <QStringDecoder>
+#include <QtConcurrent/QtConcurrent>
+
+#include "Misc/DiffEngine.h"
+
+// Lines (or characters) that occur more often than this in a region
+// are never used as histogram anchors
+static const int MAX_CHAIN_LENGTH = 64;
+
+// Regions without a rare enough anchor are handed to Myers if they
+// are this small, and Myers gives up once this many edits are needed
+static const int MYERS_LIMIT = 8192;
+static const int MYERS_MAX_EDITS = 1024;
+
+// Replaced blocks are paired up line by line like ndiff does, which
+// compares every line with every other, so bigger blocks are first
+// cut into position wise pieces of at most FANCY_PIECE lines a side
+static const int FANCY_PIECE = 50;
+static const qint64 FANCY_PAIR_LIMIT = FANCY_PIECE * FANCY_PIECE;
+
+// ndiff pairs two lines as a change if they are at least this similar
+static const double FANCY_CUTOFF = 0.75;
+
+static const QString SIMILAR = "0";
+static const QString RIGHTONLY = "1";
+static const QString LEFTONLY = "2";
+static const QString CHANGED = "3";
+
+
+QList<DiffRecord::DiffRec> DiffEngine::ParsedDiff(const QString &text1, const QString &text2)
+{
+    QStringList a = SplitLines(text1);
+    QStringList b = SplitLines(text2);
+
+    // intern every line so the diff only ever compares ints
+    QHash<QString, int> ids;
+    std::vector<int> ai;
+    std::vector<int> bi;
+    ai.reserve(a.count());
+    bi.reserve(b.count());
+    foreach(const QString &line, a) {
+        ai.push_back(ids.insert(line, ids.value(line, ids.count())).value());
+    }
+    foreach(const QString &line, b) {
+        bi.push_back(ids.insert(line, ids.value(line, ids.count())).value());
+    }
+
+    QList<DiffRecord::DiffRec> records;
+    foreach(const Opcode &op, Diff(ai, bi)) {
+        if (op.tag == 'e') {
+            for (int i = op.i1; i < op.i2; i++) {
+                records << Record(SIMILAR, a.at(i));
+            }
+        } else if (op.tag == 'd') {
+            for (int i = op.i1; i < op.i2; i++) {
+                records << Record(LEFTONLY, a.at(i));
+            }
+        } else if (op.tag == 'i') {
+            for (int j = op.j1; j < op.j2; j++) {
+                records << Record(RIGHTONLY, b.at(j));
+            }
+        } else {
+            FancyReplace(a, op.i1, op.i2, b, op.j1, op.j2, records);
+        }
+    }
+    return records;
+}
+
+
+QList<DiffRecord::DiffRec> DiffEngine::ParsedDiffFiles(const QString &path1, const QString &path2)
+{
+    return ParsedDiff(ReadText(path1), ReadText(path2));
+}
+
+
+QList<QList<DiffRecord::DiffRec>> DiffEngine::ParsedDiffFiles(const QList<QPair<QString, QString>> &paths)
+{
+    return QtConcurrent::blockingMapped(paths, ParsedDiffPair);
+}
+
+
+QList<DiffRecord::DiffRec> DiffEngine::ParsedDiffPair(const QPair<QString, QString> &paths)
+{
+    return ParsedDiffFiles(paths.first, paths.second);
+}
+
+
+QList<DiffEngine::Opcode> DiffEngine::Diff(const std::vector<int> &a, const std::vector<int> &b)
+{
+    std::vector<int> match(a.size(), -1);
+    HistogramDiff(a, b, match);
+    return OpcodesFromMatches(match, a.size(), b.size());
+}
+
+
+// Finds the rarest element the two regions have in common, matches the
+// longest run around it and works on both sides of the run in turn.
+// match[i] is set to the index in b that a[i] is matched with.
+void DiffEngine::HistogramDiff(const std::vector<int> &a, const std::vector<int> &b, std::vector<int> &match)
+{
+    struct Region {
+        int alo;
+        int ahi;
+        int blo;
+        int bhi;
+    };
+    std::vector<Region> pending;
+    pending.push_back({0, (int) a.size(), 0, (int) b.size()});
+
+    while (!pending.empty()) {
+        Region r = pending.back();
+        pending.pop_back();
+
+        while (r.alo < r.ahi && r.blo < r.bhi && a[r.alo] == b[r.blo]) {
+            match[r.alo++] = r.blo++;
+        }
+        while (r.alo < r.ahi && r.blo < r.bhi && a[r.ahi - 1] == b[r.bhi - 1]) {
+            match[--r.ahi] = --r.bhi;
+        }
+        if (r.alo == r.ahi || r.blo == r.bhi) {
+            continue;
+        }
+
+        // chain together the occurrences of each element of a
+        QHash<int, int> counts;
+        QHash<int, int> first;
+        std::vector<int> next(r.ahi - r.alo, -1);
+        for (int i = r.ahi - 1; i >= r.alo; i--) {
+            QHash<int, int>::iterator it = first.find(a[i]);
+            if (it != first.end()) {
+                next[i - r.alo] = it.value();
+                it.value() = i;
+            } else {
+                first.insert(a[i], i);
+            }
+            counts[a[i]]++;
+        }
+
+        // the rarest common element, ties go to the one nearest the
+        // middle of b so the regions left over stay balanced
+        int best_count = INT_MAX;
+        int best_j = -1;
+        int mid = (r.blo + r.bhi) / 2;
+        for (int j = r.blo; j < r.bhi; j++) {
+            QHash<int, int>::const_iterator it = counts.constFind(b[j]);
+            if (it == counts.constEnd()) {
+                continue;
+            }
+            if (it.value() < best_count ||
+                (it.value() == best_count && std::abs(j - mid) < std::abs(best_j - mid))) {
+                best_count = it.value();
+                best_j = j;
+            }
+        }
+        if (best_j < 0) {
+            continue;
+        }
+        if (best_count > MAX_CHAIN_LENGTH) {
+            // only common elements are left, anchor on one of them
+            // anyway if the region is too big or too different for Myers
+            if (((r.ahi - r.alo) + (r.bhi - r.blo) <= MYERS_LIMIT) &&
+                MyersDiff(a, r.alo, r.ahi, b, r.blo, r.bhi, match)) {
+                continue;
+            }
+        }
+
+        int best_a = 0;
+        int best_b = 0;
+        int best_len = 0;
+        for (int i = first.value(b[best_j]); i != -1; i = next[i - r.alo]) {
+            int sa = i;
+            int sb = best_j;
+            while (sa > r.alo && sb > r.blo && a[sa - 1] == b[sb - 1]) {
+                sa--;
+                sb--;
+            }
+            int ea = i + 1;
+            int eb = best_j + 1;
+            while (ea < r.ahi && eb < r.bhi && a[ea] == b[eb]) {
+                ea++;
+                eb++;
+            }
+            if (ea - sa > best_len) {
+                best_a = sa;
+                best_b = sb;
+                best_len = ea - sa;
+            }
+        }
+        for (int k = 0; k < best_len; k++) {
+            match[best_a + k] = best_b + k;
+        }
+        pending.push_back({best_a + best_len, r.ahi, best_b + best_len, r.bhi});
+        pending.push_back({r.alo, best_a, r.blo, best_b});
+    }
+}
+
+
+// The greedy O(ND) algorithm, keeping the furthest reaching paths of
+// every step so the edit path can be walked back afterwards.
+// Returns false, matching nothing, if too many edits are needed.
+bool DiffEngine::MyersDiff(const std::vector<int> &a, int alo, int ahi,
+                           const std::vector<int> &b, int blo, int bhi,
+                           std::vector<int> &match)
+{
+    int n = ahi - alo;
+    int m = bhi - blo;
+    int max = std::min(n + m, MYERS_MAX_EDITS);
+    std::vector<int> v(2 * max + 3, 0);
+    std::vector<std::vector<int>> trace;
+    int edits = -1;
+    for (int d = 0; d <= max && edits < 0; d++) {
+        for (int k = -d; k <= d; k += 2) {
+            int x;
+            if (k == -d || (k != d && v[max + k - 1] < v[max + k + 1])) {
+                x = v[max + k + 1];
+            } else {
+                x = v[max + k - 1] + 1;
+            }
+            int y = x - k;
+            while (x < n && y < m && a[alo + x] == b[blo + y]) {
+                x++;
+                y++;
+            }
+            v[max + k] = x;
+            if (x >= n && y >= m) {
+                edits = d;
+                break;
+            }
+        }
+        trace.push_back(std::vector<int>(v.begin() + max - d, v.begin() + max + d + 1));
+    }
+    if (edits < 0) {
+        return false;
+    }
+
+    int x = n;
+    int y = m;
+    for (int d = edits; d > 0; d--) {
+        // the paths after step d - 1, index k + d - 1
+        const std::vector<int> &pv = trace[d - 1];
+        int k = x - y;
+        int prev_k;
+        if (k == -d || (k != d && pv[k - 1 + d - 1] < pv[k + 1 + d - 1])) {
+            prev_k = k + 1;
+        } else {
+            prev_k = k - 1;
+        }
+        int prev_x = pv[prev_k + d - 1];
+        int prev_y = prev_x - prev_k;
+        while (x > prev_x && y > prev_y) {
+            x--;
+            y--;
+            match[alo + x] = blo + y;
+        }
+        x = prev_x;
+        y = prev_y;
+    }
+    while (x > 0 && y > 0) {
+        x--;
+        y--;
+        match[alo + x] = blo + y;
+    }
+    return true;
+}
+
+
+QList<DiffEngine::Opcode> DiffEngine::OpcodesFromMatches(const std::vector<int> &match, int n, int m)
+{
+    QList<Opcode> ops;
+    int i = 0;
+    int j = 0;
+    while (i < n || j < m) {
+        int ni = i;
+        while (ni < n && match[ni] < 0) {
+            ni++;
+        }
+        int nj = ni < n ? match[ni] : m;
+        if (ni > i || nj > j) {
+            char tag = (ni > i && nj > j) ? 'r' : (ni > i ? 'd' : 'i');
+            ops.append({tag, i, ni, j, nj});
+        }
+        if (ni >= n) {
+            break;
+        }
+        int ei = ni;
+        int ej = nj;
+        while (ei < n && match[ei] == ej) {
+            ei++;
+            ej++;
+        }
+        ops.append({'e', ni, ei, nj, ej});
+        i = ei;
+        j = ej;
+    }
+    return ops;
+}
+
+
+// Same line boundaries as python's str.splitlines()
+QStringList DiffEngine::SplitLines(const QString &text)
+{
+    QStringList lines;
+    int start = 0;
+    int n = text.length();
+    for (int i = 0; i < n; i++) {
+        ushort c = text.at(i).unicode();
+        bool separator = (c == '\n') || (c == '\r') || (c == 0x0b) || (c == 0x0c) ||
+                         ((c >= 0x1c) && (c <= 0x1e)) || (c == 0x85) || (c == 0x2028) || (c == 0x2029);
+        if (!separator) {
+            continue;
+        }
+        lines << text.mid(start, i - start);
+        if ((c == '\r') && (i + 1 < n) && (text.at(i + 1) == QChar('\n'))) {
+            i++;
+        }
+        start = i + 1;
+    }
+    if (start < n) {
+        lines << text.mid(start);
+    }
+    return lines;
+}
+
+
+// Like generate_parsed_ndiff a file that is missing or not valid utf-8 reads as empty
+QString DiffEngine::ReadText(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    QStringDecoder decoder(QStringDecoder::Utf8);
+    QString text = decoder.decode(file.readAll());
+    if (decoder.hasError()) {
+        return QString();
+    }
+    return text;
+}
+
+
+std::vector<int> DiffEngine::Chars(const QString &line)
+{
+    std::vector<int> chars;
+    chars.reserve(line.length());
+    for (int i = 0; i < line.length(); i++) {
+        chars.push_back(line.at(i).unicode());
+    }
+    return chars;
+}
+
+
+double DiffEngine::Ratio(const QString &line1, const QString &line2)
+{
+    int total = line1.length() + line2.length();
+    if (total == 0) {
+        return 1.0;
+    }
+    int matches = 0;
+    foreach(const Opcode &op, Diff(Chars(line1), Chars(line2))) {
+        if (op.tag == 'e') {
+            matches += op.i2 - op.i1;
+        }
+    }
+    return 2.0 * matches / total;
+}
+
+
+// An upper bound on Ratio from the characters the lines have in common
+double DiffEngine::QuickRatio(const QHash<ushort, int> &bcount, const QString &aline, int total)
+{
+    QHash<ushort, int> avail;
+    int matches = 0;
+    for (int i = 0; i < aline.length(); i++) {
+        ushort c = aline.at(i).unicode();
+        QHash<ushort, int>::iterator it = avail.find(c);
+        if (it == avail.end()) {
+            it = avail.insert(c, bcount.value(c));
+        }
+        if (it.value() > 0) {
+            matches++;
+        }
+        it.value()--;
+    }
+    return 2.0 * matches / total;
+}
+
+
+// Finds the most similar pair of lines in the block, shows it as a changed
+// line and does the same for the lines above and below it
+void DiffEngine::FancyReplace(const QStringList &a, int alo, int ahi,
+                              const QStringList &b, int blo, int bhi,
+                              QList<DiffRecord::DiffRec> &records)
+{
+    qint64 na = ahi - alo;
+    qint64 nb = bhi - blo;
+    if (na * nb > FANCY_PAIR_LIMIT) {
+        int pieces = (std::max(na, nb) + FANCY_PIECE - 1) / FANCY_PIECE;
+        for (int p = 0; p < pieces; p++) {
+            FancyHelper(a, alo + na * p / pieces, alo + na * (p + 1) / pieces,
+                        b, blo + nb * p / pieces, blo + nb * (p + 1) / pieces, records);
+        }
+        return;
+    }
+
+    double best_ratio = 0.74;
+    int best_i = -1;
+    int best_j = -1;
+    int eqi = -1;
+    int eqj = -1;
+    for (int j = blo; j < bhi; j++) {
+        const QString &bline = b.at(j);
+        QHash<ushort, int> bcount;
+        for (int k = 0; k < bline.length(); k++) {
+            bcount[bline.at(k).unicode()]++;
+        }
+        for (int i = alo; i < ahi; i++) {
+            const QString &aline = a.at(i);
+            if (aline == bline) {
+                if (eqi < 0) {
+                    eqi = i;
+                    eqj = j;
+                }
+                continue;
+            }
+            int total = aline.length() + bline.length();
+            if (2.0 * std::min(aline.length(), bline.length()) / total <= best_ratio) {
+                continue;
+            }
+            if (QuickRatio(bcount, aline, total) <= best_ratio) {
+                continue;
+            }
+            double ratio = Ratio(aline, bline);
+            if (ratio > best_ratio) {
+                best_ratio = ratio;
+                best_i = i;
+                best_j = j;
+            }
+        }
+    }
+
+    if (best_ratio < FANCY_CUTOFF) {
+        // no close pair, an identical pair is the only sync point left
+        if (eqi < 0) {
+            PlainReplace(a, alo, ahi, b, blo, bhi, records);
+            return;
+        }
+        best_i = eqi;
+        best_j = eqj;
+    } else {
+        eqi = -1;
+    }
+
+    FancyHelper(a, alo, best_i, b, blo, best_j, records);
+    if (eqi < 0) {
+        AppendChanged(a.at(best_i), b.at(best_j), records);
+    } else {
+        records << Record(SIMILAR, a.at(best_i));
+    }
+    FancyHelper(a, best_i + 1, ahi, b, best_j + 1, bhi, records);
+}
+
+
+void DiffEngine::FancyHelper(const QStringList &a, int alo, int ahi,
+                             const QStringList &b, int blo, int bhi,
+                             QList<DiffRecord::DiffRec> &records)
+{
+    if (alo < ahi) {
+        if (blo < bhi) {
+            FancyReplace(a, alo, ahi, b, blo, bhi, records);
+        } else {
+            for (int i = alo; i < ahi; i++) {
+                records << Record(LEFTONLY, a.at(i));
+            }
+        }
+    } else {
+        for (int j = blo; j < bhi; j++) {
+            records << Record(RIGHTONLY, b.at(j));
+        }
+    }
+}
+
+
+// The shorter side goes first, as in ndiff
+void DiffEngine::PlainReplace(const QStringList &a, int alo, int ahi,
+                              const QStringList &b, int blo, int bhi,
+                              QList<DiffRecord::DiffRec> &records)
+{
+    if (bhi - blo < ahi - alo) {
+        FancyHelper(a, 0, 0, b, blo, bhi, records);
+        FancyHelper(a, alo, ahi, b, 0, 0, records);
+    } else {
+        FancyHelper(a, alo, ahi, b, 0, 0, records);
+        FancyHelper(a, 0, 0, b, blo, bhi, records);
+    }
+}
+
+
+// The change strings mark each character of the line with ' ' if it is
+// unchanged and '^', '-' or '+' if it was replaced, deleted or inserted
+void DiffEngine::AppendChanged(const QString &aline, const QString &bline, QList<DiffRecord::DiffRec> &records)
+{
+    QString atags;
+    QString btags;
+    foreach(const Opcode &op, Diff(Chars(aline), Chars(bline))) {
+        int la = op.i2 - op.i1;
+        int lb = op.j2 - op.j1;
+        if (op.tag == 'r') {
+            atags += QString(la, '^');
+            btags += QString(lb, '^');
+        } else if (op.tag == 'd') {
+            atags += QString(la, '-');
+        } else if (op.tag == 'i') {
+            btags += QString(lb, '+');
+        } else {
+            atags += QString(la, ' ');
+            btags += QString(lb, ' ');
+        }
+    }
+    // keep tabs and such from the line itself and drop trailing blanks
+    for (int k = 0; k < atags.length(); k++) {
+        if ((atags.at(k) == QChar(' ')) && aline.at(k).isSpace()) {
+            atags[k] = aline.at(k);
+        }
+    }
+    for (int k = 0; k < btags.length(); k++) {
+        if ((btags.at(k) == QChar(' ')) && bline.at(k).isSpace()) {
+            btags[k] = bline.at(k);
+        }
+    }
+    while (!atags.isEmpty() && atags.back().isSpace()) {
+        atags.chop(1);
+    }
+    while (!btags.isEmpty() && btags.back().isSpace()) {
+        btags.chop(1);
+    }
+
+    if (atags.isEmpty() && btags.isEmpty()) {
+        records << Record(LEFTONLY, aline);
+        records << Record(RIGHTONLY, bline);
+        return;
+    }
+    DiffRecord::DiffRec dr;
+    dr.code = CHANGED;
+    dr.line = aline;
+    dr.newline = bline;
+    dr.leftchanges = atags;
+    dr.rightchanges = btags;
+    records << dr;
+}
+
+
+DiffRecord::DiffRec DiffEngine::Record(const QString &code, const QString &line)
+{
+    DiffRecord::DiffRec dr;
+    dr.code = code;
+    dr.line = line;
+    return dr;
+}
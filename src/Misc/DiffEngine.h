@@ -0,0 +1,121 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef DIFFENGINE_H
+#define DIFFENGINE_H
+
+#include <vector>
+
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+
+#include "EmbedPython/DiffRec.h"
+
+/**
+ * Line by line comparison of two texts in the form shown by ChgViewer.
+ *
+ * This produces the same records as repomanager's generate_parsed_ndiff
+ * (difflib.ndiff run through sdifflibparser) without its quadratic cost.
+ * Lines are interned to ints and matched with a histogram diff, which
+ * anchors on the rarest common lines and falls back to a Myers diff for
+ * small regions.  Runs of replaced lines are then paired up by similarity
+ * the way ndiff does, and each pair gets the same character level diff
+ * to mark the changed characters.
+ *
+ * All members are static and thread safe.
+ */
+class DiffEngine
+{
+public:
+
+    /**
+     * Compares two texts, split into lines as python's splitlines does.
+     */
+    static QList<DiffRecord::DiffRec> ParsedDiff(const QString &text1, const QString &text2);
+
+    /**
+     * Compares two utf-8 text files, a missing file compares as empty.
+     */
+    static QList<DiffRecord::DiffRec> ParsedDiffFiles(const QString &path1, const QString &path2);
+
+    /**
+     * Compares many pairs of files (left path, right path) in parallel.
+     * The results are in the order of the pairs.
+     */
+    static QList<QList<DiffRecord::DiffRec>> ParsedDiffFiles(const QList<QPair<QString, QString>> &paths);
+
+private:
+
+    struct Opcode {
+        char tag; // 'e'qual, 'r'eplace, 'd'elete, 'i'nsert
+        int i1;
+        int i2;
+        int j1;
+        int j2;
+    };
+
+    /**
+     * Returns the grouped edit operations turning a into b.
+     */
+    static QList<Opcode> Diff(const std::vector<int> &a, const std::vector<int> &b);
+
+    static void HistogramDiff(const std::vector<int> &a, const std::vector<int> &b, std::vector<int> &match);
+
+    static bool MyersDiff(const std::vector<int> &a, int alo, int ahi,
+                          const std::vector<int> &b, int blo, int bhi,
+                          std::vector<int> &match);
+
+    static QList<Opcode> OpcodesFromMatches(const std::vector<int> &match, int n, int m);
+
+    static QStringList SplitLines(const QString &text);
+
+    static QString ReadText(const QString &path);
+
+    static std::vector<int> Chars(const QString &line);
+
+    static double Ratio(const QString &line1, const QString &line2);
+
+    static double QuickRatio(const QHash<ushort, int> &bcount, const QString &aline, int total);
+
+    static void FancyReplace(const QStringList &a, int alo, int ahi,
+                             const QStringList &b, int blo, int bhi,
+                             QList<DiffRecord::DiffRec> &records);
+
+    static void FancyHelper(const QStringList &a, int alo, int ahi,
+                            const QStringList &b, int blo, int bhi,
+                            QList<DiffRecord::DiffRec> &records);
+
+    static void PlainReplace(const QStringList &a, int alo, int ahi,
+                             const QStringList &b, int blo, int bhi,
+                             QList<DiffRecord::DiffRec> &records);
+
+    static void AppendChanged(const QString &aline, const QString &bline, QList<DiffRecord::DiffRec> &records);
+
+    static DiffRecord::DiffRec Record(const QString &code, const QString &line);
+
+    static QList<DiffRecord::DiffRec> ParsedDiffPair(const QPair<QString, QString> &paths);
+};
+
+#endif // DIFFENGINE_H
@@ -0,0 +1,280 @@
+/************************************************************************
+**
+**  Copyright (C) 2015-2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <functional>
+
+#include <QtCore/QReadLocker>
+#include <QtConcurrent/QtConcurrent>
+#include <QDebug>
+
+#include "Misc/FileSearchIndex.h"
+#include "PCRE2/PCRECache.h"
+#include "ResourceObjects/TextResource.h"
+
+#if 0
+#define DBG if(1)
+#else
+#define DBG if(0)
+#endif
+
+FileSearchIndex::FileSearchIndex(QObject *parent)
+    :
+    QObject(parent),
+    m_ContextLength(0),
+    m_Watcher(NULL)
+{
+}
+
+
+FileSearchIndex::~FileSearchIndex()
+{
+    if (m_Watcher) {
+        m_Watcher->disconnect(this);
+        m_Watcher->cancel();
+        m_Watcher->waitForFinished();
+    }
+}
+
+
+void FileSearchIndex::Start(const QString &search_regex, const QList<Resource *> &resources)
+{
+    if (m_Watcher && (search_regex == m_SearchRegex) && (resources == m_Resources)) {
+        return;
+    }
+
+    Clear();
+    if (search_regex.isEmpty() || resources.isEmpty()) {
+        return;
+    }
+
+    m_SearchRegex = search_regex;
+    m_Resources = resources;
+    m_ScanOrder = resources;
+
+    // Copy every text now, on the GUI thread, so that the workers
+    // only ever see plain strings.
+    QList<Snapshot> snapshots;
+    foreach(Resource *resource, resources) {
+        snapshots << TakeSnapshot(resource);
+        connect(resource, SIGNAL(Modified()), this, SLOT(ResourceModified()));
+        connect(resource, SIGNAL(Deleted(const Resource *)), this, SLOT(ResourceDeleted(const Resource *)));
+    }
+
+    DBG qDebug() << "FileSearchIndex starting scan of" << snapshots.count() << "resources";
+    m_Watcher = new QFutureWatcher<QList<Match>>(this);
+    connect(m_Watcher, SIGNAL(resultReadyAt(int)), this, SLOT(BackgroundResultReady(int)));
+    connect(m_Watcher, SIGNAL(finished()), this, SLOT(BackgroundFinished()));
+    m_Watcher->setFuture(QtConcurrent::mapped(snapshots, std::bind(ScanText, std::placeholders::_1, search_regex, m_ContextLength)));
+}
+
+
+void FileSearchIndex::Clear()
+{
+    if (m_Watcher) {
+        // The workers only hold copies of the text so there is
+        // no need to wait for them to notice they were cancelled
+        m_Watcher->disconnect(this);
+        m_Watcher->cancel();
+        m_Watcher->deleteLater();
+        m_Watcher = NULL;
+    }
+    DisconnectResources();
+    m_SearchRegex.clear();
+    m_Resources.clear();
+    m_ScanOrder.clear();
+    m_Results.clear();
+    m_Stale.clear();
+}
+
+
+void FileSearchIndex::Cancel()
+{
+    if (m_Watcher) {
+        m_Watcher->cancel();
+    }
+}
+
+
+void FileSearchIndex::SetContextLength(int amt)
+{
+    if (amt != m_ContextLength) {
+        Clear();
+        m_ContextLength = amt;
+    }
+}
+
+
+bool FileSearchIndex::Contains(Resource *resource)
+{
+    return !Matches(resource).isEmpty();
+}
+
+
+QList<FileSearchIndex::Match> FileSearchIndex::Matches(Resource *resource)
+{
+    if (!m_Results.contains(resource)) {
+        DBG qDebug() << "FileSearchIndex scanning on demand" << resource;
+        StoreResult(resource, ScanText(TakeSnapshot(resource), m_SearchRegex, m_ContextLength));
+    }
+    return m_Results.value(resource);
+}
+
+
+bool FileSearchIndex::IsScanned(Resource *resource) const
+{
+    return m_Results.contains(resource);
+}
+
+
+void FileSearchIndex::BackgroundResultReady(int index)
+{
+    if (!m_Watcher || m_Watcher->isCanceled() || (index < 0) || (index >= m_ScanOrder.count())) {
+        return;
+    }
+    Resource *resource = m_ScanOrder.at(index);
+
+    // A result computed from text that has changed since, or one already
+    // replaced by an on demand scan, is of no use.
+    if (m_Stale.contains(resource) || m_Results.contains(resource)) {
+        return;
+    }
+    StoreResult(resource, m_Watcher->resultAt(index));
+}
+
+
+void FileSearchIndex::BackgroundFinished()
+{
+    DBG qDebug() << "FileSearchIndex scan finished";
+    emit Finished();
+}
+
+
+void FileSearchIndex::ResourceModified()
+{
+    Resource *resource = qobject_cast<Resource *>(sender());
+    if (resource) {
+        m_Results.remove(resource);
+        m_Stale.insert(resource);
+        emit ResourceInvalidated(resource);
+    }
+}
+
+
+void FileSearchIndex::ResourceDeleted(const Resource *resource)
+{
+    Resource *deleted = const_cast<Resource *>(resource);
+    m_Results.remove(deleted);
+    m_Stale.insert(deleted);
+    m_Resources.removeAll(deleted);
+}
+
+
+void FileSearchIndex::StoreResult(Resource *resource, const QList<Match> &matches)
+{
+    m_Results.insert(resource, matches);
+    emit ResourceScanned(resource, matches.count());
+}
+
+
+void FileSearchIndex::DisconnectResources()
+{
+    foreach(Resource *resource, m_Resources) {
+        disconnect(resource, 0, this, 0);
+    }
+}
+
+
+// Runs in a worker thread.
+QList<FileSearchIndex::Match> FileSearchIndex::ScanText(const Snapshot &snapshot, const QString &search_regex, int context_amt)
+{
+    QList<Match> matches;
+    if (snapshot.text.isEmpty()) {
+        return matches;
+    }
+
+    QList<SPCRE::MatchInfo> match_info = PCRECache::instance()->getObject(search_regex)->getEveryMatchInfo(snapshot.text);
+
+    // Matches come back in text order so the line count only
+    // ever has to move forward
+    int line = 1;
+    int pos = 0;
+    foreach(const SPCRE::MatchInfo &mi, match_info) {
+        int offset = mi.offset.first;
+        for (; pos < offset; pos++) {
+            if (snapshot.text.at(pos) == QChar('\n')) {
+                line++;
+            }
+        }
+        Match match;
+        match.bookpath = snapshot.bookpath;
+        match.offset = offset;
+        match.length = mi.offset.second - mi.offset.first;
+        match.line = line;
+        if (context_amt > 0) {
+            match.prior_context = GetPriorContext(offset, snapshot.text, context_amt);
+            match.matched_text = snapshot.text.mid(offset, match.length);
+            match.post_context = GetPostContext(mi.offset.second, snapshot.text, context_amt);
+        }
+        matches << match;
+    }
+    return matches;
+}
+
+
+// Context breaks at whitespace so that snippets do not
+// start or end part way through a word
+QString FileSearchIndex::GetPriorContext(int match_start, const QString &text, int amt)
+{
+    int context_start = match_start - amt;
+    if (context_start < 0) context_start = 0;
+    while (context_start < match_start && !text.at(context_start).isSpace()) {
+        context_start++;
+    }
+    QString prior_context = text.mid(context_start, match_start - context_start);
+    prior_context.replace('\n', ' ');
+    return prior_context;
+}
+
+
+QString FileSearchIndex::GetPostContext(int match_end, const QString &text, int amt)
+{
+    int context_end = match_end + amt;
+    if (context_end > text.length()) context_end = text.length();
+    while (context_end > match_end && !text.at(context_end - 1).isSpace()) {
+        context_end--;
+    }
+    QString post_context = text.mid(match_end, context_end - match_end);
+    post_context.replace('\n', ' ');
+    return post_context;
+}
+
+
+FileSearchIndex::Snapshot FileSearchIndex::TakeSnapshot(Resource *resource)
+{
+    Snapshot snapshot;
+    snapshot.bookpath = resource->GetRelativePath();
+    TextResource *text_resource = qobject_cast<TextResource *>(resource);
+    if (text_resource) {
+        QReadLocker locker(&text_resource->GetLock());
+        snapshot.text = text_resource->GetText();
+    }
+    return snapshot;
+}
@@ -0,0 +1,197 @@
+/************************************************************************
+**
+**  Copyright (C) 2015-2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef FILESEARCHINDEX_H
+#define FILESEARCHINDEX_H
+
+#include <QtCore/QFutureWatcher>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+
+class Resource;
+
+/**
+ * Scans the text of a list of resources for a search regex in
+ * worker threads and keeps the matches found in each one.
+ *
+ * Find in all files uses this to know which file holds the next
+ * match without opening a tab for every file it passes over.
+ * The text of every resource is copied on the GUI thread when a
+ * scan starts so the workers never touch a QTextDocument.  When a
+ * resource is modified its result is dropped and it is rescanned
+ * the next time it is asked about.
+ *
+ * Spell check searches can not use this since Hunspell is not
+ * safe to use from multiple threads.
+ */
+class FileSearchIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * A single match found by the scan.  The context strings are
+     * only filled in when a context length has been set.
+     */
+    struct Match {
+        QString bookpath;
+        int offset;
+        int length;
+        int line;
+        QString prior_context;
+        QString matched_text;
+        QString post_context;
+    };
+
+    FileSearchIndex(QObject *parent = NULL);
+    ~FileSearchIndex();
+
+    /**
+     * Starts scanning resources for search_regex in the background.
+     * Does nothing if a scan for the same regex over the same
+     * resources has already been started, so it is cheap to call
+     * before every find.  Any other running scan is cancelled.
+     */
+    void Start(const QString &search_regex, const QList<Resource *> &resources);
+
+    /**
+     * Cancels any running scan and forgets all results.
+     */
+    void Clear();
+
+    /**
+     * Stops the background scan but keeps the results found so far.
+     * Resources it did not reach are still scanned on demand.
+     */
+    void Cancel();
+
+    /**
+     * Sets how many characters of text around each match are kept
+     * with it, 0 keeps none.  Changing it forgets all results.
+     */
+    void SetContextLength(int amt);
+
+    /**
+     * Returns true if the resource contains a match.  If the background
+     * scan has not reached the resource yet, or it has been modified
+     * since, it is scanned right away on the calling thread.
+     */
+    bool Contains(Resource *resource);
+
+    /**
+     * Returns the matches found in the resource, scanning it
+     * first as Contains does if needed.
+     */
+    QList<Match> Matches(Resource *resource);
+
+    /**
+     * Returns true if the resource has an up to date result.
+     */
+    bool IsScanned(Resource *resource) const;
+
+    QString GetSearchRegex() const { return m_SearchRegex; };
+
+    QList<Resource *> GetResources() const { return m_Resources; };
+
+signals:
+
+    /**
+     * Emitted each time a resource has been scanned, in the background
+     * or on demand.
+     */
+    void ResourceScanned(Resource *resource, int count);
+
+    /**
+     * Emitted when the background scan of every resource is done.
+     */
+    void Finished();
+
+    /**
+     * Emitted when a resource is modified and its matches are dropped.
+     */
+    void ResourceInvalidated(Resource *resource);
+
+private slots:
+
+    void BackgroundResultReady(int index);
+
+    void BackgroundFinished();
+
+    void ResourceModified();
+
+    void ResourceDeleted(const Resource *resource);
+
+private:
+
+    struct Snapshot {
+        QString bookpath;
+        QString text;
+    };
+
+    static QList<Match> ScanText(const Snapshot &snapshot, const QString &search_regex, int context_amt);
+
+    static QString GetPriorContext(int match_start, const QString &text, int amt);
+
+    static QString GetPostContext(int match_end, const QString &text, int amt);
+
+    static Snapshot TakeSnapshot(Resource *resource);
+
+    void StoreResult(Resource *resource, const QList<Match> &matches);
+
+    void DisconnectResources();
+
+
+    ///////////////////////////////
+    // PRIVATE MEMBER VARIABLES
+    ///////////////////////////////
+
+    QString m_SearchRegex;
+
+    QList<Resource *> m_Resources;
+
+    /**
+     * The resources in the order they were handed to the workers,
+     * used to map a background result back to its resource.
+     */
+    QList<Resource *> m_ScanOrder;
+
+    /**
+     * The up to date matches of every resource scanned so far.
+     */
+    QHash<Resource *, QList<Match>> m_Results;
+
+    /**
+     * Resources modified or deleted after their text was copied
+     * for the background scan.
+     */
+    QSet<Resource *> m_Stale;
+
+    int m_ContextLength;
+
+    QFutureWatcher<QList<Match>> *m_Watcher;
+};
+
+#endif // FILESEARCHINDEX_H
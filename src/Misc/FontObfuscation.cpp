@@ -55,15 +55,8 @@ QByteArray AdobeKeyFromIdentifier(const QString &identifier)
 }
 
 
-void IdpfObfuscate(const QString &filepath, const QString &identifier)
+void IdpfObfuscate(QByteArray &contents, const QString &identifier)
 {
-    QFile file(filepath);
-
-    if (!file.open(QFile::ReadWrite)) {
-        return;
-    }
-
-    QByteArray contents = file.readAll();
     QByteArray key = IdpfKeyFromIdentifier(identifier);
     int key_size   = key.size();
     if (key_size == 0) {
@@ -73,21 +66,11 @@ void IdpfObfuscate(const QString &filepath, const QString &identifier)
     for (int i = 0; (i < IDPF_METHOD_NUM_BYTES) && (i < contents.size()); ++i) {
         contents[ i ] = contents[ i ] ^ key[ i % key_size ];
     }
-
-    file.seek(0);
-    file.write(contents);
 }
 
 
-void AdobeObfuscate(const QString &filepath, const QString &identifier)
+void AdobeObfuscate(QByteArray &contents, const QString &identifier)
 {
-    QFile file(filepath);
-
-    if (!file.open(QFile::ReadWrite)) {
-        return;
-    }
-
-    QByteArray contents = file.readAll();
     QByteArray key = AdobeKeyFromIdentifier(identifier);
     int key_size   = key.size();
     if (key_size == 0) {
@@ -97,33 +80,50 @@ void AdobeObfuscate(const QString &filepath, const QString &identifier)
     for (int i = 0; (i < ADOBE_METHOD_NUM_BYTES) && (i < contents.size()); ++i) {
         contents[ i ] = contents[ i ] ^ key[ i % key_size ];
     }
-
-    file.seek(0);
-    file.write(contents);
 }
 
 };
 
 
-void FontObfuscation::ObfuscateFile(const QString &filepath,
+void FontObfuscation::ObfuscateData(QByteArray &contents,
                                     const QString &algorithm,
                                     const QString &identifier)
 {
-    if (!QFileInfo(filepath).exists() ||
-        algorithm.isEmpty()             ||
-        identifier.isEmpty()) {
-        std::string msg = filepath.toStdString() + ": " + algorithm.toStdString() + ": " + identifier.toStdString();
+    if (algorithm.isEmpty() || identifier.isEmpty()) {
+        std::string msg = algorithm.toStdString() + ": " + identifier.toStdString();
         throw(FontObfuscationError(msg));
     }
 
     if (algorithm == ADOBE_FONT_ALGO_ID) {
-        AdobeObfuscate(filepath, identifier);
+        AdobeObfuscate(contents, identifier);
     } else if (algorithm == IDPF_FONT_ALGO_ID) {
-        IdpfObfuscate(filepath, identifier);
+        IdpfObfuscate(contents, identifier);
     } else {
-        std::string msg = filepath.toStdString() + ": " + algorithm.toStdString() + ": " + identifier.toStdString();
+        std::string msg = algorithm.toStdString() + ": " + identifier.toStdString();
         throw(FontObfuscationError(msg));
     }
 }
 
 
+void FontObfuscation::ObfuscateFile(const QString &filepath,
+                                    const QString &algorithm,
+                                    const QString &identifier)
+{
+    if (!QFileInfo(filepath).exists() ||
+        algorithm.isEmpty()             ||
+        identifier.isEmpty()) {
+        std::string msg = filepath.toStdString() + ": " + algorithm.toStdString() + ": " + identifier.toStdString();
+        throw(FontObfuscationError(msg));
+    }
+
+    QFile file(filepath);
+
+    if (!file.open(QFile::ReadWrite)) {
+        return;
+    }
+
+    QByteArray contents = file.readAll();
+    ObfuscateData(contents, algorithm, identifier);
+    file.seek(0);
+    file.write(contents);
+}
@@ -23,10 +23,21 @@
 #ifndef FONTOBFUSCATION_H
 #define FONTOBFUSCATION_H
 
+class QByteArray;
 class QString;
 
 namespace FontObfuscation
 {
+/**
+ * Obfuscates (or deobfuscates) the font data in memory.
+ */
+void ObfuscateData(QByteArray &contents,
+                   const QString &algorithm,
+                   const QString &identifier);
+
+/**
+ * Obfuscates (or deobfuscates) the font file in place.
+ */
 void ObfuscateFile(const QString &filepath,
                    const QString &algorithm,
                    const QString &identifier);
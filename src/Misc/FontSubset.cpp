@@ -0,0 +1,416 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <algorithm>
+#include <vector>
+
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+#include <QtCore/QList>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+
+#include "Misc/FontSubset.h"
+
+static const quint32 TRUETYPE_VERSION = 0x00010000;
+static const quint32 HEAD_MAGIC_SUM = 0xB1B0AFBA;
+
+// Flags of a composite glyph component
+static const quint16 ARG_1_AND_2_ARE_WORDS = 0x0001;
+static const quint16 WE_HAVE_A_SCALE = 0x0008;
+static const quint16 MORE_COMPONENTS = 0x0020;
+static const quint16 WE_HAVE_AN_X_AND_Y_SCALE = 0x0040;
+static const quint16 WE_HAVE_A_TWO_BY_TWO = 0x0080;
+
+namespace
+{
+
+struct Table {
+    quint32 tag;
+    quint32 offset;
+    quint32 length;
+    QByteArray data;
+};
+
+
+constexpr quint32 Tag(const char *name)
+{
+    return (quint32(quint8(name[0])) << 24) | (quint32(quint8(name[1])) << 16) |
+           (quint32(quint8(name[2])) << 8) | quint32(quint8(name[3]));
+}
+
+
+// Reads past the end return 0, the callers check the sizes
+// that matter so a damaged font can never be read out of bounds
+quint16 U16(const QByteArray &data, qint64 pos)
+{
+    if ((pos < 0) || (pos + 2 > data.size())) {
+        return 0;
+    }
+    const uchar *p = reinterpret_cast<const uchar *>(data.constData()) + pos;
+    return (quint16(p[0]) << 8) | quint16(p[1]);
+}
+
+
+quint32 U32(const QByteArray &data, qint64 pos)
+{
+    return (quint32(U16(data, pos)) << 16) | quint32(U16(data, pos + 2));
+}
+
+
+void Put16(QByteArray &data, qint64 pos, quint16 value)
+{
+    data[pos] = char(value >> 8);
+    data[pos + 1] = char(value & 0xff);
+}
+
+
+void Put32(QByteArray &data, qint64 pos, quint32 value)
+{
+    Put16(data, pos, quint16(value >> 16));
+    Put16(data, pos + 2, quint16(value & 0xffff));
+}
+
+
+void Append16(QByteArray &data, quint16 value)
+{
+    data.append(char(value >> 8));
+    data.append(char(value & 0xff));
+}
+
+
+void Append32(QByteArray &data, quint32 value)
+{
+    Append16(data, quint16(value >> 16));
+    Append16(data, quint16(value & 0xffff));
+}
+
+
+void Pad(QByteArray &data, int alignment)
+{
+    while (data.size() % alignment) {
+        data.append('\0');
+    }
+}
+
+
+quint32 Checksum(const QByteArray &data, qint64 start, qint64 length)
+{
+    quint32 sum = 0;
+    for (qint64 pos = start; pos < start + length; pos += 4) {
+        sum += U32(data, pos);
+    }
+    return sum;
+}
+
+
+// Only unicode subtables are used, a code point of a
+// symbol or Macintosh subtable means something else
+bool IsUnicodeCmap(quint16 platform, quint16 encoding)
+{
+    return (platform == 0) || ((platform == 3) && ((encoding == 1) || (encoding == 10)));
+}
+
+
+// Marks every glyph a unicode subtable maps as mapped, and the glyphs of
+// the code points used as kept.  Returns false if there is no subtable
+// it can read.
+bool ReadCmap(const QByteArray &cmap, const QSet<uint> &codepoints, std::vector<bool> &mapped, std::vector<bool> &keep)
+{
+    const uint num_glyphs = mapped.size();
+    bool found = false;
+    auto map = [&](uint cp, uint gid) {
+        if (gid < num_glyphs) {
+            mapped[gid] = true;
+            if (codepoints.contains(cp)) {
+                keep[gid] = true;
+            }
+        }
+    };
+
+    quint16 num_subtables = U16(cmap, 2);
+    for (int i = 0; i < num_subtables; ++i) {
+        qint64 record = 4 + 8 * i;
+        if (!IsUnicodeCmap(U16(cmap, record), U16(cmap, record + 2))) {
+            continue;
+        }
+        qint64 sub = U32(cmap, record + 4);
+        quint16 format = U16(cmap, sub);
+        if (format == 0) {
+            for (uint c = 0; c < 256; ++c) {
+                map(c, quint8(cmap.at(std::min<qint64>(sub + 6 + c, cmap.size() - 1))));
+            }
+            found = true;
+        } else if (format == 4) {
+            quint16 seg_count_x2 = U16(cmap, sub + 6);
+            qint64 ends = sub + 14;
+            qint64 starts = ends + seg_count_x2 + 2;
+            qint64 deltas = starts + seg_count_x2;
+            qint64 range_offsets = deltas + seg_count_x2;
+            for (int s = 0; s < seg_count_x2 / 2; ++s) {
+                quint16 end = U16(cmap, ends + 2 * s);
+                quint16 start = U16(cmap, starts + 2 * s);
+                quint16 delta = U16(cmap, deltas + 2 * s);
+                quint16 range_offset = U16(cmap, range_offsets + 2 * s);
+                for (uint c = start; (c <= end) && (c != 0xFFFF); ++c) {
+                    uint gid;
+                    if (range_offset == 0) {
+                        gid = (c + delta) & 0xFFFF;
+                    } else {
+                        gid = U16(cmap, range_offsets + 2 * s + range_offset + 2 * (c - start));
+                        if (gid != 0) {
+                            gid = (gid + delta) & 0xFFFF;
+                        }
+                    }
+                    map(c, gid);
+                }
+            }
+            found = true;
+        } else if (format == 6) {
+            quint16 first = U16(cmap, sub + 6);
+            quint16 count = U16(cmap, sub + 8);
+            for (uint c = 0; c < count; ++c) {
+                map(first + c, U16(cmap, sub + 10 + 2 * c));
+            }
+            found = true;
+        } else if ((format == 12) || (format == 13)) {
+            quint32 num_groups = U32(cmap, sub + 12);
+            for (quint32 g = 0; (g < num_groups) && (sub + 16 + 12 * g + 12 <= cmap.size()); ++g) {
+                qint64 group = sub + 16 + 12 * g;
+                quint32 start = U32(cmap, group);
+                quint32 end = std::min<quint32>(U32(cmap, group + 4), 0x10FFFF);
+                quint32 start_gid = U32(cmap, group + 8);
+                for (quint32 c = start; c <= end; ++c) {
+                    map(c, format == 12 ? start_gid + (c - start) : start_gid);
+                }
+            }
+            found = true;
+        }
+    }
+    return found;
+}
+
+}
+
+
+QByteArray FontSubset::SubsetTrueType(const QByteArray &font, const QSet<uint> &codepoints)
+{
+    if ((font.size() < 12) || ((U32(font, 0) != TRUETYPE_VERSION) && (U32(font, 0) != Tag("true")))) {
+        return QByteArray();
+    }
+    quint16 num_tables = U16(font, 4);
+    if (12 + 16 * num_tables > font.size()) {
+        return QByteArray();
+    }
+
+    QList<Table> tables;
+    int head = -1, maxp = -1, loca = -1, glyf = -1, cmap = -1;
+    for (int i = 0; i < num_tables; ++i) {
+        qint64 record = 12 + 16 * i;
+        Table table;
+        table.tag = U32(font, record);
+        table.offset = U32(font, record + 8);
+        table.length = U32(font, record + 12);
+        if (qint64(table.offset) + table.length > font.size()) {
+            return QByteArray();
+        }
+        // glyph variations and outlines that are not in glyf
+        // can not be subset this way
+        if ((table.tag == Tag("CFF ")) || (table.tag == Tag("CFF2")) || (table.tag == Tag("gvar"))) {
+            return QByteArray();
+        }
+        // a signature no longer holds once the glyphs change
+        if (table.tag == Tag("DSIG")) {
+            continue;
+        }
+        table.data = font.mid(table.offset, table.length);
+        if (table.tag == Tag("head")) head = tables.count();
+        if (table.tag == Tag("maxp")) maxp = tables.count();
+        if (table.tag == Tag("loca")) loca = tables.count();
+        if (table.tag == Tag("glyf")) glyf = tables.count();
+        if (table.tag == Tag("cmap")) cmap = tables.count();
+        tables.append(table);
+    }
+    if ((head < 0) || (maxp < 0) || (loca < 0) || (glyf < 0) || (cmap < 0) || (tables.at(head).length < 54)) {
+        return QByteArray();
+    }
+
+    const QByteArray &glyf_data = tables.at(glyf).data;
+    const QByteArray &loca_data = tables.at(loca).data;
+    bool short_loca = U16(tables.at(head).data, 50) == 0;
+    uint num_glyphs = U16(tables.at(maxp).data, 4);
+    if ((num_glyphs == 0) || (loca_data.size() < qint64(num_glyphs + 1) * (short_loca ? 2 : 4))) {
+        return QByteArray();
+    }
+    std::vector<quint32> offsets(num_glyphs + 1);
+    for (uint g = 0; g <= num_glyphs; ++g) {
+        offsets[g] = short_loca ? 2 * quint32(U16(loca_data, 2 * g)) : U32(loca_data, 4 * g);
+        if (((g > 0) && (offsets[g] < offsets[g - 1])) || (offsets[g] > quint32(glyf_data.size()))) {
+            return QByteArray();
+        }
+    }
+
+    std::vector<bool> mapped(num_glyphs, false);
+    std::vector<bool> keep(num_glyphs, false);
+    if (!ReadCmap(tables.at(cmap).data, codepoints, mapped, keep)) {
+        return QByteArray();
+    }
+    // .notdef and every glyph that is not mapped, which layout
+    // features may still substitute for a used one
+    QList<uint> stack;
+    for (uint g = 0; g < num_glyphs; ++g) {
+        if ((g == 0) || !mapped[g]) {
+            keep[g] = true;
+        }
+        if (keep[g]) {
+            stack.append(g);
+        }
+    }
+
+    // The components of the kept composite glyphs are kept as well
+    while (!stack.isEmpty()) {
+        uint g = stack.takeLast();
+        qint64 pos = offsets[g];
+        qint64 end = offsets[g + 1];
+        if ((end - pos < 10) || !(U16(glyf_data, pos) & 0x8000)) {
+            continue;
+        }
+        pos += 10;
+        quint16 flags;
+        do {
+            flags = U16(glyf_data, pos);
+            uint component = U16(glyf_data, pos + 2);
+            pos += 4;
+            pos += (flags & ARG_1_AND_2_ARE_WORDS) ? 4 : 2;
+            if (flags & WE_HAVE_A_SCALE) {
+                pos += 2;
+            } else if (flags & WE_HAVE_AN_X_AND_Y_SCALE) {
+                pos += 4;
+            } else if (flags & WE_HAVE_A_TWO_BY_TWO) {
+                pos += 8;
+            }
+            if ((component < num_glyphs) && !keep[component]) {
+                keep[component] = true;
+                stack.append(component);
+            }
+        } while ((flags & MORE_COMPONENTS) && (pos + 4 <= end));
+    }
+
+    bool dropped = false;
+    for (uint g = 0; g < num_glyphs; ++g) {
+        if (!keep[g] && (offsets[g + 1] > offsets[g])) {
+            dropped = true;
+            break;
+        }
+    }
+    if (!dropped) {
+        return QByteArray();
+    }
+
+    // Glyphs in the short loca format are already word aligned
+    QByteArray new_glyf;
+    QByteArray new_loca;
+    for (uint g = 0; g < num_glyphs; ++g) {
+        if (short_loca) {
+            Append16(new_loca, quint16(new_glyf.size() / 2));
+        } else {
+            Append32(new_loca, quint32(new_glyf.size()));
+        }
+        if (keep[g]) {
+            new_glyf.append(glyf_data.constData() + offsets[g], offsets[g + 1] - offsets[g]);
+            Pad(new_glyf, short_loca ? 2 : 4);
+        }
+    }
+    if (short_loca) {
+        Append16(new_loca, quint16(new_glyf.size() / 2));
+    } else {
+        Append32(new_loca, quint32(new_glyf.size()));
+    }
+    tables[glyf].data = new_glyf;
+    tables[loca].data = new_loca;
+    // checkSumAdjustment is worked out once the whole font is laid out
+    Put32(tables[head].data, 8, 0);
+
+    std::sort(tables.begin(), tables.end(), [](const Table &t1, const Table &t2) {
+        return t1.tag < t2.tag;
+    });
+    head = -1;
+    quint16 count = tables.count();
+    quint16 entry_selector = 0;
+    while ((2 << entry_selector) <= count) {
+        entry_selector++;
+    }
+    quint16 search_range = 16 << entry_selector;
+
+    QByteArray out;
+    Append32(out, U32(font, 0));
+    Append16(out, count);
+    Append16(out, search_range);
+    Append16(out, entry_selector);
+    Append16(out, count * 16 - search_range);
+    qint64 offset = 12 + 16 * count;
+    for (int i = 0; i < tables.count(); ++i) {
+        Table &table = tables[i];
+        table.offset = offset;
+        table.length = table.data.size();
+        offset += (table.length + 3) & ~3;
+        if (table.tag == Tag("head")) {
+            head = i;
+        }
+    }
+    for (int i = 0; i < tables.count(); ++i) {
+        const Table &table = tables.at(i);
+        QByteArray padded = table.data;
+        Pad(padded, 4);
+        Append32(out, table.tag);
+        Append32(out, Checksum(padded, 0, padded.size()));
+        Append32(out, table.offset);
+        Append32(out, table.length);
+    }
+    for (int i = 0; i < tables.count(); ++i) {
+        out.append(tables.at(i).data);
+        Pad(out, 4);
+    }
+    Put32(out, tables.at(head).offset + 8, HEAD_MAGIC_SUM - Checksum(out, 0, out.size()));
+
+    if (out.size() >= font.size()) {
+        return QByteArray();
+    }
+    return out;
+}
+
+
+bool FontSubset::SubsetFile(const QString &filepath, const QSet<uint> &codepoints)
+{
+    QFile file(filepath);
+
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+
+    QByteArray subset = SubsetTrueType(file.readAll(), codepoints);
+    file.close();
+    if (subset.isEmpty() || !file.open(QFile::WriteOnly | QFile::Truncate)) {
+        return false;
+    }
+
+    return file.write(subset) == subset.size();
+}
@@ -0,0 +1,61 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef FONTSUBSET_H
+#define FONTSUBSET_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QSet>
+
+class QString;
+
+/**
+ * Drops the outlines of the glyphs a book can never show from
+ * TrueType fonts.
+ *
+ * Glyph ids are kept as they are so the cmap, metrics, kerning
+ * and layout tables stay valid and are copied unchanged, the
+ * outline of every glyph that is only reachable through the
+ * cmap entry of an unused code point is simply emptied.  Glyphs
+ * not in the cmap at all, such as ligatures and alternates, are
+ * always kept along with the components of every kept composite.
+ * Fonts with CFF outlines, variable fonts, collections and WOFF
+ * files are left alone.
+ */
+namespace FontSubset
+{
+/**
+ * Returns the subset of the font data keeping the glyphs of
+ * codepoints, or an empty array if the font can not be subset
+ * or nothing would be dropped.
+ */
+QByteArray SubsetTrueType(const QByteArray &font, const QSet<uint> &codepoints);
+
+/**
+ * Subsets the font file in place.
+ *
+ * @return \c true if the file was rewritten.
+ */
+bool SubsetFile(const QString &filepath, const QSet<uint> &codepoints);
+}
+
+#endif // FONTSUBSET_H
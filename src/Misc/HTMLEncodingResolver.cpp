@@ -21,10 +21,17 @@
 **
 *************************************************************************/
 
+#include <optional>
 #include <string>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIGIL_HAVE_SSE2
+#endif
+
 #include <QFile>
 #include <QString>
+#include <QStringList>
 #include <QRegularExpression>
 #include <QDebug>
 #include "Misc/HTMLEncodingResolver.h"
@@ -54,7 +61,16 @@ QString HTMLEncodingResolver::ReadHTMLFile(const QString &fullfilepath)
 
     QByteArray data = file.readAll();
 
-    return Utility::ConvertLineEndingsAndNormalize(GetDecoderForHTML(data).decode(data));
+    // Text that is, or may be, utf-8 is checked and converted in one go
+    QByteArray encoding = GetDeclaredEncoding(data);
+    QString text;
+    if ((encoding.isEmpty() || (encoding == "UTF-8")) && DecodeUtf8(data, text)) {
+        return Utility::ConvertLineEndingsAndNormalize(text);
+    }
+    if (encoding.isEmpty()) {
+        return Utility::ConvertLineEndingsAndNormalize(QStringDecoder::decoderForHtml(data).decode(data));
+    }
+    return Utility::ConvertLineEndingsAndNormalize(QStringDecoder(encoding).decode(data));
 }
 
 
@@ -63,16 +79,32 @@ QString HTMLEncodingResolver::ReadHTMLFile(const QString &fullfilepath)
 // We use this function because Qt's QTextCodec::codecForHtml() function
 // leaves a *lot* to be desired.
 QStringDecoder HTMLEncodingResolver::GetDecoderForHTML(const QByteArray &raw_text)
+{
+    QByteArray encoding = GetDeclaredEncoding(raw_text);
+    if (!encoding.isEmpty()) {
+        return QStringDecoder(encoding);
+    }
+
+    // See if all characters within this document are utf-8.
+    if (IsValidUtf8(raw_text)) {
+        return QStringDecoder("UTF-8");
+    }
+
+    // Finally, let Qt guess
+    return QStringDecoder::decoderForHtml(raw_text);
+}
+
+
+QByteArray HTMLEncodingResolver::GetDeclaredEncoding(const QByteArray &raw_text)
 {
     unsigned char c1;
     unsigned char c2;
     unsigned char c3;
     unsigned char c4;
     QString text;
-    QStringDecoder decoder;
 
     if (raw_text.length() < 4) {
-        return QStringDecoder("UTF-8");
+        return "UTF-8";
     }
 
     // Check the BOM if present.
@@ -81,56 +113,118 @@ QStringDecoder HTMLEncodingResolver::GetDecoderForHTML(const QByteArray &raw_tex
     c3 = raw_text.at(2);
     c4 = raw_text.at(3);
     if (c1 == 0xEF && c2 == 0xBB && c3 == 0xBF) {
-        return QStringDecoder("UTF-8");
+        return "UTF-8";
     } else if (c1 == 0xFF && c2 == 0xFE && c3 == 0 && c4 == 0) {
-        return QStringDecoder("UTF-32LE");
+        return "UTF-32LE";
     } else if (c1 == 0 && c2 == 0 && c3 == 0xFE && c4 == 0xFF) {
-        return QStringDecoder("UTF-32BE");
+        return "UTF-32BE";
     } else if (c1 == 0xFE && c2 == 0xFF) {
-        return QStringDecoder("UTF-16BE");
+        return "UTF-16BE";
     } else if (c1 == 0xFF && c2 == 0xFE) {
-        return QStringDecoder("UTF-16LE");
+        return "UTF-16LE";
     }
 
     // Alternating char followed by 0 is typical of utf 16 le without BOM.
     if (c1 != 0 && c2 == 0 && c3 != 0 && c4 == 0) {
-        return QStringDecoder("UTF-16LE");
+        return "UTF-16LE";
     }
 
     // Try to find an ecoding specified in the file itself.
     text = Utility::Substring(0, 1024, raw_text);
 
-    // Check if the xml encoding attribute is set.
-    QRegularExpression enc_re(ENCODING_ATTRIBUTE);
-    QRegularExpressionMatch enc_mo = enc_re.match(text);
-    if (enc_mo.hasMatch()) {
-        QByteArray ba(enc_mo.captured(1).toLatin1());
-        ba = FixupCodePageMapping(ba);
-        QStringDecoder decoder = QStringDecoder(ba);
-        if (decoder.isValid()) {
-            return decoder;
+    // Check if the xml encoding attribute is set, then
+    // if the charset is set in the head.
+    QStringList attributes = QStringList() << ENCODING_ATTRIBUTE << CHARSET_ATTRIBUTE;
+    foreach(QString attribute, attributes) {
+        QRegularExpression attr_re(attribute);
+        QRegularExpressionMatch attr_mo = attr_re.match(text);
+        if (attr_mo.hasMatch()) {
+            QByteArray ba(attr_mo.captured(1).toLatin1());
+            ba = FixupCodePageMapping(ba);
+            if (QStringDecoder(ba).isValid()) {
+                std::optional<QStringConverter::Encoding> known = QStringConverter::encodingForName(ba.constData());
+                if (known && (*known == QStringConverter::Utf8)) {
+                    return "UTF-8";
+                }
+                return ba;
+            }
         }
     }
 
-    // Check if the charset is set in the head.
-    QRegularExpression char_re(CHARSET_ATTRIBUTE);
-    QRegularExpressionMatch char_mo = char_re.match(text);
-    if (char_mo.hasMatch()) {
-        QByteArray ba(char_mo.captured(1).toLatin1());
-        ba = FixupCodePageMapping(ba);
-        QStringDecoder decoder = QStringDecoder(ba);
-        if (decoder.isValid()) {
-            return decoder;
+    return QByteArray();
+}
+
+
+// Plain ascii here is what IsValidUtf8 accepts as a single byte:
+// tab, line feed, carriage return and the printable characters.
+static inline bool IsPlainAscii(unsigned char c)
+{
+    return (0x20 <= c && c <= 0x7E) || c == 0x09 || c == 0x0A || c == 0x0D;
+}
+
+
+// Returns how many bytes of plain ascii text start at p.
+// Most of an HTML file is markup, so this is where the time goes.
+static inline qsizetype AsciiRunLength(const unsigned char *p, const unsigned char *end)
+{
+    const unsigned char *start = p;
+#ifdef SIGIL_HAVE_SSE2
+    const __m128i space_less_one = _mm_set1_epi8(0x1F);
+    const __m128i del = _mm_set1_epi8(0x7F);
+    const __m128i tab = _mm_set1_epi8(0x09);
+    const __m128i lf = _mm_set1_epi8(0x0A);
+    const __m128i cr = _mm_set1_epi8(0x0D);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        // bytes of 0x80 and up compare as negative and so fail the first test
+        __m128i ok = _mm_and_si128(_mm_cmpgt_epi8(chunk, space_less_one), _mm_cmplt_epi8(chunk, del));
+        ok = _mm_or_si128(ok, _mm_cmpeq_epi8(chunk, tab));
+        ok = _mm_or_si128(ok, _mm_cmpeq_epi8(chunk, lf));
+        ok = _mm_or_si128(ok, _mm_cmpeq_epi8(chunk, cr));
+        if (_mm_movemask_epi8(ok) != 0xFFFF) {
+            break;
         }
+        p += 16;
     }
-
-    // See if all characters within this document are utf-8.
-    if (IsValidUtf8(raw_text)) {
-        return QStringDecoder("UTF-8");
+#endif
+    while (p < end && IsPlainAscii(*p)) {
+        ++p;
     }
+    return p - start;
+}
 
-    // Finally, let Qt guess
-    return QStringDecoder::decoderForHtml(raw_text);
+
+// Returns the length of the multi-byte sequence at p and stores its
+// code point, or returns 0 if it is not one IsValidUtf8 accepts.
+static inline int Utf8SequenceLength(const unsigned char *p, const unsigned char *end, char32_t *code_point)
+{
+    qsizetype avail = end - p;
+    unsigned char b0 = p[0];
+    unsigned char b1 = avail > 1 ? p[1] : 0;
+    unsigned char b2 = avail > 2 ? p[2] : 0;
+    unsigned char b3 = avail > 3 ? p[3] : 0;
+    bool c1 = (0x80 <= b1 && b1 <= 0xBF);
+    bool c2 = (0x80 <= b2 && b2 <= 0xBF);
+    bool c3 = (0x80 <= b3 && b3 <= 0xBF);
+
+    // non-overlong 2-byte
+    if ((0xC2 <= b0 && b0 <= 0xDF) && c1) {
+        *code_point = ((b0 & 0x1F) << 6) | (b1 & 0x3F);
+        return 2;
+    }
+    if ((b0 == 0xE0 && (0xA0 <= b1 && b1 <= 0xBF) && c2) ||                      // excluding overlongs
+        (((0xE1 <= b0 && b0 <= 0xEC) || b0 == 0xEE || b0 == 0xEF) && c1 && c2) ||  // straight 3-byte
+        (b0 == 0xED && (0x80 <= b1 && b1 <= 0x9F) && c2)) {                       // excluding surrogates
+        *code_point = ((b0 & 0x0F) << 12) | ((b1 & 0x3F) << 6) | (b2 & 0x3F);
+        return 3;
+    }
+    if ((b0 == 0xF0 && (0x90 <= b1 && b1 <= 0xBF) && c2 && c3) ||               // planes 1-3
+        ((0xF1 <= b0 && b0 <= 0xF3) && c1 && c2 && c3) ||                        // planes 4-15
+        (b0 == 0xF4 && (0x80 <= b1 && b1 <= 0x8F) && c2 && c3)) {               // plane 16
+        *code_point = ((b0 & 0x07) << 18) | ((b1 & 0x3F) << 12) | ((b2 & 0x3F) << 6) | (b3 & 0x3F);
+        return 4;
+    }
+    return 0;
 }
 
 
@@ -139,74 +233,81 @@ QStringDecoder HTMLEncodingResolver::GetDecoderForHTML(const QByteArray &raw_tex
 // If it's valid, this is probably a UTF-8 string.
 bool HTMLEncodingResolver::IsValidUtf8(const QByteArray &string)
 {
-    // This is an implementation of the Perl code written here:
+    // This follows the Perl code written here:
     //   http://www.w3.org/International/questions/qa-forms-utf-8
     //
     // Basically, UTF-8 has a very specific byte-pattern. This function
     // checks if the sent byte-sequence conforms to this pattern.
     // If it does, chances are *very* high that this is UTF-8.
-    //
-    // This function is written to be fast, not pretty.
     if (string.isNull()) {
         return false;
     }
 
-    int index = 0;
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(string.constData());
+    const unsigned char *end = p + string.size();
+    char32_t code_point;
 
-    while (index < string.size()) {
-        QByteArray dword = string.mid(index, 4);
-
-        if (dword.size() < 4) {
-            dword = dword.leftJustified(4, '\0');
+    while (p < end) {
+        p += AsciiRunLength(p, end);
+        if (p == end) {
+            break;
         }
+        int length = Utf8SequenceLength(p, end, &code_point);
+        if (length == 0) {
+            return false;
+        }
+        p += length;
+    }
+
+    return true;
+}
+
+
+bool HTMLEncodingResolver::DecodeUtf8(const QByteArray &string, QString &text)
+{
+    if (string.isNull()) {
+        return false;
+    }
 
-        const unsigned char *bytes = (const unsigned char *) dword.constData();
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(string.constData());
+    const unsigned char *end = p + string.size();
 
-        // ASCII
-        if (bytes[0] == 0x09 ||
-            bytes[0] == 0x0A ||
-            bytes[0] == 0x0D ||
-            (0x20 <= bytes[0] && bytes[0] <= 0x7E)
-           ) {
-            index += 1;
+    // the BOM is dropped, as QStringDecoder does
+    if ((string.size() >= 3) && (p[0] == 0xEF) && (p[1] == 0xBB) && (p[2] == 0xBF)) {
+        p += 3;
+    }
+
+    // never more utf-16 code units than there are bytes
+    QString result(end - p, Qt::Uninitialized);
+    char16_t *out = reinterpret_cast<char16_t *>(result.data());
+    char16_t *out_start = out;
+    char32_t code_point;
+
+    while (p < end) {
+        qsizetype run = AsciiRunLength(p, end);
+        for (qsizetype i = 0; i < run; ++i) {
+            out[i] = p[i];
         }
-        // non-overlong 2-byte
-        else if ((0xC2 <= bytes[0] && bytes[0] <= 0xDF) &&
-                 (0x80 <= bytes[1] && bytes[1] <= 0xBF)
-                ) {
-            index += 2;
-        } else if ((bytes[0] == 0xE0                         &&              // excluding overlongs
-                    (0xA0 <= bytes[1] && bytes[1] <= 0xBF) &&
-                    (0x80 <= bytes[2] && bytes[2] <= 0xBF)) ||
-                   (((0xE1 <= bytes[0] && bytes[0] <= 0xEC) ||               // straight 3-byte
-                     bytes[0] == 0xEE                         ||
-                     bytes[0] == 0xEF) &&
-                    (0x80 <= bytes[1] && bytes[1] <= 0xBF)   &&
-                    (0x80 <= bytes[2] && bytes[2] <= 0xBF)) ||
-                   (bytes[0] == 0xED                         &&              // excluding surrogates
-                    (0x80 <= bytes[1] && bytes[1] <= 0x9F) &&
-                    (0x80 <= bytes[2] && bytes[2] <= 0xBF))
-                  ) {
-            index += 3;
-        } else if ((bytes[0] == 0xF0                         &&              // planes 1-3
-                    (0x90 <= bytes[1] && bytes[1] <= 0xBF) &&
-                    (0x80 <= bytes[2] && bytes[2] <= 0xBF) &&
-                    (0x80 <= bytes[3] && bytes[3] <= 0xBF)) ||
-                   ((0xF1 <= bytes[0] && bytes[0] <= 0xF3) &&              // planes 4-15
-                    (0x80 <= bytes[1] && bytes[1] <= 0xBF) &&
-                    (0x80 <= bytes[2] && bytes[2] <= 0xBF) &&
-                    (0x80 <= bytes[3] && bytes[3] <= 0xBF)) ||
-                   (bytes[0] == 0xF4                         &&            // plane 16
-                    (0x80 <= bytes[1] && bytes[1] <= 0x8F) &&
-                    (0x80 <= bytes[2] && bytes[2] <= 0xBF) &&
-                    (0x80 <= bytes[3] && bytes[3] <= 0xBF))
-                  ) {
-            index += 4;
-        } else {
+        out += run;
+        p += run;
+        if (p == end) {
+            break;
+        }
+        int length = Utf8SequenceLength(p, end, &code_point);
+        if (length == 0) {
             return false;
         }
+        if (code_point > 0xFFFF) {
+            *out++ = QChar::highSurrogate(code_point);
+            *out++ = QChar::lowSurrogate(code_point);
+        } else {
+            *out++ = static_cast<char16_t>(code_point);
+        }
+        p += length;
     }
 
+    result.truncate(out - out_start);
+    text = result;
     return true;
 }
 
@@ -46,11 +46,20 @@ private:
     // leaves a *lot* to be desired.
     static QStringDecoder GetDecoderForHTML(const QByteArray &raw_text);
 
+    // Returns the encoding named by the BOM or declared in the document,
+    // always "UTF-8" for utf-8, or an empty array if there is none.
+    static QByteArray GetDeclaredEncoding(const QByteArray &raw_text);
+
     // This function goes through the entire byte array
     // and tries to see whether this is a valid UTF-8 sequence.
     // If it's valid, this is probably a UTF-8 string.
     static bool IsValidUtf8(const QByteArray &string);
 
+    // Checks the byte array the same way as IsValidUtf8 and converts it
+    // in the same pass.  Returns false, leaving text alone, if it is not
+    // valid utf-8.
+    static bool DecodeUtf8(const QByteArray &string, QString &text);
+
     static QByteArray FixupCodePageMapping(const QByteArray& ba);
 };
 
@@ -20,12 +20,13 @@
 **
 *************************************************************************/
 
+#include <QtCore/QHash>
 #include <QtCore/QString>
 #include <QRegularExpression>
 
 #include "Misc/HTMLEncodingResolver.h"
 #include "Misc/Utility.h"
-#include "Misc/SettingsStore.h"
+#include "Misc/SettingsSnapshot.h"
 #include "Misc/SpellCheck.h"
 #include "Misc/HTMLSpellCheck.h"
 #include "sigil_constants.h"
@@ -35,12 +36,65 @@ const int MAX_WORD_LENGTH  = 90;
 
 const QString ENTITYWORDCHARS = ";#01234567890abcdefABCDEFxX";
 
+static bool MatchesSearch(const QString &word, const QRegularExpression &search, const QString &search_regex)
+{
+    if (search_regex.isEmpty()) {
+        return true;
+    }
+    return search.match(word).capturedStart() != -1;
+}
+
 QList<HTMLSpellCheck::MisspelledWord> HTMLSpellCheck::GetMisspelledWords(const QString &orig_text,
         int start_offset,
         int end_offset,
         const QString &search_regex,
         bool first_only,
         bool include_all_words)
+{
+    SpellCheck *sc = SpellCheck::instance();
+    QRegularExpression search(search_regex);
+    QList<HTMLSpellCheck::MisspelledWord> misspellings;
+    QList<HTMLSpellCheck::MisspelledWord> candidates;
+
+    foreach(const WordTokenizer::Span &span, GetWordSpans(orig_text, start_offset, end_offset)) {
+        struct MisspelledWord misspelled_word;
+        misspelled_word.text = orig_text.mid(span.offset, span.length);
+        misspelled_word.offset = span.offset;
+        misspelled_word.length = span.length;
+        const QString &word = misspelled_word.text;
+
+        if (include_all_words || first_only) {
+            if ((include_all_words || !sc->spellPS(word)) && MatchesSearch(word, search, search_regex)) {
+                misspellings.append(misspelled_word);
+
+                if (first_only) {
+                    return misspellings;
+                }
+            }
+        } else {
+            // checked all together once the whole text is split up
+            candidates.append(misspelled_word);
+        }
+    }
+
+    if (!candidates.isEmpty()) {
+        QStringList words;
+        foreach(const MisspelledWord &candidate, candidates) {
+            words << candidate.text;
+        }
+        QHash<QString, bool> verdicts = sc->spellPSAll(words);
+        foreach(const MisspelledWord &candidate, candidates) {
+            if (!verdicts.value(candidate.text, true) && MatchesSearch(candidate.text, search, search_regex)) {
+                misspellings.append(candidate);
+            }
+        }
+    }
+
+    return misspellings;
+}
+
+
+QList<WordTokenizer::Span> HTMLSpellCheck::GetWordSpans(const QString &orig_text, int start_offset, int end_offset)
 {
     SpellCheck *sc = SpellCheck::instance();
     QString wordChars = sc->getWordChars();
@@ -51,14 +105,12 @@ QList<HTMLSpellCheck::MisspelledWord> HTMLSpellCheck::GetMisspelledWords(const Q
     bool in_invalid_word = false;
     bool in_entity = false;
     int word_start = 0;
-    SettingsStore ss;
-    bool use_nums = ss.spellCheckNumbers();
-    QRegularExpression search(search_regex);
-    QList<HTMLSpellCheck::MisspelledWord> misspellings;
+    WordTokenizer tokenizer(wordChars, SettingsSnapshot::instance()->Current()->spellcheck_numbers);
+    QList<WordTokenizer::Span> spans;
     // Make sure text has beginning/end boundary markers for easier parsing
     QString text = QChar(' ') + orig_text + QChar(' ');
     // Ignore <style...</style> wherever it appears - change to spaces to keep text positions
-    QRegularExpression style_re("<style[^<]*</style>");
+    static const QRegularExpression style_re("<style[^<]*</style>");
 
     QRegularExpressionMatchIterator i = style_re.globalMatch(text);
     while (i.hasNext()) {
@@ -75,7 +127,7 @@ QList<HTMLSpellCheck::MisspelledWord> HTMLSpellCheck::GetMisspelledWords(const Q
             QChar prev_c = i > 0 ? text.at(i - 1) : QChar(' ');
             QChar next_c = i < text.length() - 1 ? text.at(i + 1) : QChar(' ');
 
-            if (IsBoundary(prev_c, c, next_c, wordChars, use_nums)) {
+            if (tokenizer.IsBoundary(prev_c, c, next_c)) {
                 // If we're in an entity and we hit a boundary and it isn't
                 // part of an entity then this is an invalid entity.
                 if (in_entity && !ENTITYWORDCHARS.contains(c)) {
@@ -84,30 +136,12 @@ QList<HTMLSpellCheck::MisspelledWord> HTMLSpellCheck::GetMisspelledWords(const Q
 
                 // Check possibilities that would mean this isn't a word worth considering.
                 if (!in_invalid_word && !in_entity && word_start != -1 && (i - word_start) > 0) {
-                    QString word = Utility::Substring(word_start, i, text);
-
-                    if (!word.isEmpty() && word_start > start_offset && word_start <= end_offset) {
-                        if (include_all_words || !sc->spellPS(word)) {
-                            int cap_start = -1;
-
-                            if (!search_regex.isEmpty()) {
-                                QRegularExpressionMatch mo = search.match(word);
-                                cap_start = mo.capturedStart();
-                            }
-
-                            if (search_regex.isEmpty() || cap_start != -1) {
-                                struct MisspelledWord misspelled_word;
-                                misspelled_word.text = word;
-                                // Make sure we account for the extra boundary added at the beginning
-                                misspelled_word.offset = word_start - 1;
-                                misspelled_word.length = i - word_start ;
-                                misspellings.append(misspelled_word);
-
-                                if (first_only) {
-                                    return misspellings;
-                                }
-                            }
-                        }
+                    if (word_start > start_offset && word_start <= end_offset) {
+                        WordTokenizer::Span span;
+                        // Make sure we account for the extra boundary added at the beginning
+                        span.offset = word_start - 1;
+                        span.length = i - word_start;
+                        spans.append(span);
                     }
                 }
 
@@ -143,35 +177,7 @@ QList<HTMLSpellCheck::MisspelledWord> HTMLSpellCheck::GetMisspelledWords(const Q
         }
     }
 
-    return misspellings;
-}
-
-bool HTMLSpellCheck::IsValidChar(const QChar & c, bool use_nums)
-{ 
-    if (use_nums) return c.isLetterOrNumber();
-    return c.isLetter();
-}
-
-bool HTMLSpellCheck::IsBoundary(QChar prev_c, QChar c, QChar next_c, const QString & wordChars, bool use_nums)
-{
-        
-    if (IsValidChar(c,use_nums) ) return false;
-    if (c == '.' && wordChars.contains(c)) return false;  // allow ending period for abbreviations
-    
-    // Single quotes of ' and curly version and hyphen/emdash are sometimes a boundary
-    // and sometimes not, depending on whether they are surrounded by letters or not.
-    // A sentence which 'has some text' should treat the ' as a boundary but didn't should not.
-    bool is_potential_boundary = (c == '-' || 
-                                  c == QChar(0x2012) || 
-                                  c == '\'' || 
-                                  c == QChar(0x2019) ||
-                                  (!wordChars.isEmpty() && wordChars.contains(c)));
-    // and here too
-    // if (is_potential_boundary && (!prev_c.isLetter() || !next_c.isLetter())) {
-    if (is_potential_boundary && (!IsValidChar(prev_c, use_nums) || !IsValidChar(next_c, use_nums))) {
-        return true;
-    }
-    return !(is_potential_boundary && (IsValidChar(prev_c, use_nums) || IsValidChar(next_c, use_nums)));
+    return spans;
 }
 
 
@@ -236,7 +242,7 @@ int HTMLSpellCheck::CountMisspelledWords(const QString &text)
 
 int HTMLSpellCheck::CountAllWords(const QString &text)
 {
-    return CountMisspelledWords(text, 0, text.length(), "", false, true);
+    return GetWordSpans(text, 0, text.length()).count();
 }
 
 QStringList HTMLSpellCheck::GetAllWords(const QString &text)
@@ -25,6 +25,7 @@
 #define HTMLSPELLCHECK_H
 
 #include <QtCore/QStringList>
+#include "Misc/WordTokenizer.h"
 
 class HTMLSpellCheck
 {
@@ -75,8 +76,11 @@ public:
 
 private:
 
-    static bool IsBoundary(QChar prev_c, QChar c, QChar next_c, const QString & wordChars, bool use_nums);
-    static bool IsValidChar(const QChar & c, bool use_nums);
+    /**
+     * The spans of the words of the html text that start between
+     * the two offsets, skipping markup and style blocks.
+     */
+    static QList<WordTokenizer::Span> GetWordSpans(const QString &text, int start_offset, int end_offset);
 };
 
 #endif // HTMLSPELLCHECK_H
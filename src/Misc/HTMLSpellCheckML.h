@@ -24,7 +24,9 @@
 #ifndef HTMLSPELLCHECKML_H
 #define HTMLSPELLCHECKML_H
 
+#include <QHash>
 #include <QStringList>
+#include "Misc/WordTokenizer.h"
 
 class HTMLSpellCheckML
 {
@@ -40,19 +42,17 @@ public:
     static QList<AWord> GetWordList(const QString &text, const QString &default_lang = "");
     static QList<AWord> GetWords(const QString &text, const QString &default_lang="");
     static QStringList GetAllWords(const QString &text, const QString &default_lang="");
+    static QHash<QString, int> CountWords(const QString &text, const QString &default_lang="");
     static int WordPosition(QString text, QString word, int start_pos, const QString &default_lang="");
     static QString textOf(const QString &word);
     static QString langOf(const QString &word);
 
 private:
 
-    static bool IsBoundary(QChar prev_c, QChar c, QChar next_c, const QString & wordChars, bool use_nums);
-    static bool IsValidChar(const QChar & c, bool use_nums);
     static void parse_text_into_words(QList<AWord> &wordlist,
-                                      const QString &wc,
-                                      bool  use_nums,
+                                      const WordTokenizer &tokenizer,
                                       const QString &lang,
-                                      const QString &parsetext,
+                                      const QStringView parsetext,
                                       int   pos);
 };
 
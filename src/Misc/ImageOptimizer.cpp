@@ -0,0 +1,150 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <cmath>
+
+#include <QtCore/QBuffer>
+#include <QtCore/QByteArray>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QString>
+#include <QtGui/QImage>
+#include <QtGui/QImageReader>
+#include <QtGui/QImageWriter>
+
+#include "Misc/ImageOptimizer.h"
+
+// How many bytes of results are kept before the cache starts over
+static const qint64 MAX_CACHE_SIZE = 64 * 1024 * 1024;
+
+namespace
+{
+
+// results by the hash of the image data and the options,
+// an empty result means it could not be made smaller
+QHash<QByteArray, QByteArray> s_Cache;
+qint64 s_CacheSize = 0;
+QMutex s_CacheMutex;
+
+
+QByteArray FormatFromSuffix(const QString &suffix)
+{
+    QString lower = suffix.toLower();
+    if (lower == "png") {
+        return "png";
+    }
+    if ((lower == "jpg") || (lower == "jpeg")) {
+        return "jpeg";
+    }
+    return QByteArray();
+}
+
+
+QByteArray Optimize(const QByteArray &data, const QByteArray &format, int jpeg_quality, qint64 max_pixels)
+{
+    QByteArray source(data);
+    QBuffer input(&source);
+    input.open(QIODevice::ReadOnly);
+    QImageReader reader(&input, format);
+    if (reader.supportsAnimation() && (reader.imageCount() > 1)) {
+        return QByteArray();
+    }
+    QSize size = reader.size();
+    qint64 pixels = static_cast<qint64>(size.width()) * size.height();
+    bool downscale = (max_pixels > 0) && (pixels > max_pixels);
+    bool reencode = (format == "png") || (jpeg_quality >= 0);
+    if (!downscale && !reencode) {
+        return QByteArray();
+    }
+
+    // a jpeg written again loses its exif orientation so it is applied
+    reader.setAutoTransform(format == "jpeg");
+    QImage image = reader.read();
+    if (image.isNull()) {
+        return QByteArray();
+    }
+    if (downscale) {
+        double scale = std::sqrt(static_cast<double>(max_pixels) / pixels);
+        QSize scaled(qMax(1, static_cast<int>(image.width() * scale)), qMax(1, static_cast<int>(image.height() * scale)));
+        image = image.scaled(scaled, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+
+    QByteArray result;
+    QBuffer output(&result);
+    output.open(QIODevice::WriteOnly);
+    QImageWriter writer(&output, format);
+    if (format == "png") {
+        // the png writer takes quality 0 as the highest zlib level
+        writer.setQuality(0);
+    } else {
+        writer.setQuality((jpeg_quality >= 0) ? jpeg_quality : 90);
+        writer.setOptimizedWrite(true);
+    }
+    if (!writer.write(image) || (result.size() >= data.size())) {
+        return QByteArray();
+    }
+    return result;
+}
+
+};
+
+
+QByteArray ImageOptimizer::OptimizeImage(const QByteArray &data, const QString &suffix, int jpeg_quality, qint64 max_pixels)
+{
+    QByteArray format = FormatFromSuffix(suffix);
+    if (format.isEmpty() || data.isEmpty()) {
+        return QByteArray();
+    }
+
+    QByteArray key = QCryptographicHash::hash(data, QCryptographicHash::Sha1) + format +
+                     QByteArray::number(jpeg_quality) + ":" + QByteArray::number(max_pixels);
+    {
+        QMutexLocker locker(&s_CacheMutex);
+        if (s_Cache.contains(key)) {
+            return s_Cache.value(key);
+        }
+    }
+
+    QByteArray result = Optimize(data, format, jpeg_quality, max_pixels);
+    QMutexLocker locker(&s_CacheMutex);
+    if (s_CacheSize + result.size() > MAX_CACHE_SIZE) {
+        s_Cache.clear();
+        s_CacheSize = 0;
+    }
+    s_Cache.insert(key, result);
+    s_CacheSize += result.size();
+    return result;
+}
+
+
+QByteArray ImageOptimizer::OptimizeFile(const QString &filepath, int jpeg_quality, qint64 max_pixels)
+{
+    QFile file(filepath);
+
+    if (!file.open(QFile::ReadOnly)) {
+        return QByteArray();
+    }
+
+    return OptimizeImage(file.readAll(), filepath.section('.', -1), jpeg_quality, max_pixels);
+}
@@ -0,0 +1,62 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef IMAGEOPTIMIZER_H
+#define IMAGEOPTIMIZER_H
+
+#include <QtCore/QByteArray>
+
+class QString;
+
+/**
+ * Makes the PNG and JPEG images written into an epub smaller.
+ *
+ * PNGs are written again at the highest zlib level with the same
+ * pixels.  JPEGs can only be made smaller by encoding them again at
+ * a lower quality, which is only done when a quality is asked for.
+ * Images with more pixels than a limit can be scaled down.  A result
+ * is only used when it is smaller than the original, and results are
+ * kept by the hash of the image data so that saving the same images
+ * again costs nothing.  Animated images are left alone.
+ */
+namespace ImageOptimizer
+{
+/**
+ * Returns the optimized image data, or an empty array if the image
+ * can not be made smaller.
+ *
+ * @param data The image file data.
+ * @param suffix The file extension, which says the format.
+ * @param jpeg_quality The quality to encode JPEGs again at,
+ *                     -1 to leave them as they are.
+ * @param max_pixels Images with more pixels are scaled down
+ *                   to this many, 0 for no limit.
+ */
+QByteArray OptimizeImage(const QByteArray &data, const QString &suffix, int jpeg_quality, qint64 max_pixels);
+
+/**
+ * As OptimizeImage for the file at filepath, which is not changed.
+ */
+QByteArray OptimizeFile(const QString &filepath, int jpeg_quality, qint64 max_pixels);
+}
+
+#endif // IMAGEOPTIMIZER_H
@@ -57,7 +57,7 @@ void KeyboardShortcutManager::registerAction(QWidget * win, QAction *action, con
         defined = true;
     } else {
         s = createShortcut(keySequence);
-        m_shortcuts.insert(id, s);
+        insertShortcut(id, s);
     }
 
     s.setName(action->iconText());
@@ -75,13 +75,17 @@ void KeyboardShortcutManager::registerAction(QWidget * win, QAction *action, con
 
     // If we are registering with a KeyboardShortcut that was previously created
     // we don't want to over write the key sequence.
-    if (!defined && !keySequenceInUse(keySequence)) {
+    bool set_sequence = !defined && !keySequenceInUse(keySequence);
+    bool set_default = !defaultKeySequenceInUse(keySequence);
+    removeFromIndex(s);
+    if (set_sequence) {
         s.setKeySequence(keySequence);
     }
 
-    if (!defaultKeySequenceInUse(keySequence)) {
+    if (set_default) {
         s.setDefaultKeySequence(keySequence);
     }
+    addToIndex(s);
 
     // Set the keyboard shortcut that is associated with this id.
     QList<QAction *> actions = s.getAllActions();
@@ -104,7 +108,7 @@ void KeyboardShortcutManager::registerShortcut(QShortcut *shortcut, const QStrin
         defined = true;
     } else {
         s = createShortcut(keySequence);
-        m_shortcuts.insert(id, s);
+        insertShortcut(id, s);
     }
 
     // Use the actions tool tip (falls back to text) if no description
@@ -119,13 +123,17 @@ void KeyboardShortcutManager::registerShortcut(QShortcut *shortcut, const QStrin
 
     // If we are registering with a KeyboardShortcut that was previously created
     // we don't want to over write the key sequence.
-    if (!defined && !keySequenceInUse(keySequence)) {
+    bool set_sequence = !defined && !keySequenceInUse(keySequence);
+    bool set_default = !defaultKeySequenceInUse(keySequence);
+    removeFromIndex(s);
+    if (set_sequence) {
         s.setKeySequence(keySequence);
     }
 
-    if (!defaultKeySequenceInUse(keySequence)) {
+    if (set_default) {
         s.setDefaultKeySequence(keySequence);
     }
+    addToIndex(s);
 
     // Set the keyboard shortcut that is associated with this id.
     s.shortcut()->setKey(s.keySequence());
@@ -163,12 +171,14 @@ bool KeyboardShortcutManager::setKeySequence(const QString &sid, const QKeySeque
 
     if (!m_shortcuts.contains(sid)) {
         s = createShortcut(keySequence, keySequence);
-        m_shortcuts.insert(sid, s);
+        insertShortcut(sid, s);
     } else {
         s = m_shortcuts.value(sid);
     }
 
+    removeFromIndex(s);
     s.setKeySequence(keySequence);
+    addToIndex(s);
 
     // When a new MainWindow is closed, its QActions
     // are reaped which could leave behind dangling 
@@ -194,7 +204,14 @@ bool KeyboardShortcutManager::setDefaultKeySequence(const QString &id, const QKe
     }
 
     KeyboardShortcut s = m_shortcuts.value(id);
+    bool managed = m_shortcuts.contains(id);
+    if (managed) {
+        removeFromIndex(s);
+    }
     s.setDefaultKeySequence(keySequence);
+    if (managed) {
+        addToIndex(s);
+    }
     return true;
 }
 
@@ -212,6 +229,9 @@ void KeyboardShortcutManager::setDescription(const QString &id, const QString &d
 
 void KeyboardShortcutManager::unregisterId(const QString &id)
 {
+    if (m_shortcuts.contains(id)) {
+        removeFromIndex(m_shortcuts.value(id));
+    }
     m_shortcuts.remove(id);
     m_savedShortcuts.remove(id);
 }
@@ -263,13 +283,15 @@ void KeyboardShortcutManager::unregisterAll()
 {
     m_shortcuts.clear();
     m_savedShortcuts.clear();
+    m_keySequenceCount.clear();
+    m_defaultKeySequenceCount.clear();
 }
 
 KeyboardShortcut KeyboardShortcutManager::keyboardShortcut(const QString &id)
 {
     if (!m_shortcuts.contains(id)) {
         KeyboardShortcut s = createShortcut(QKeySequence(), QKeySequence());
-        m_shortcuts.insert(id, s);
+        insertShortcut(id, s);
     }
 
     return m_shortcuts.value(id);
@@ -286,12 +308,7 @@ bool KeyboardShortcutManager::keySequenceInUse(const QKeySequence &keySequence)
         return false;
     }
 
-    foreach(KeyboardShortcut s, m_shortcuts) {
-        if (s.keySequence() == keySequence) {
-            return true;
-        }
-    }
-    return false;
+    return m_keySequenceCount.contains(keySequence);
 }
 
 bool KeyboardShortcutManager::defaultKeySequenceInUse(const QKeySequence &keySequence)
@@ -300,12 +317,7 @@ bool KeyboardShortcutManager::defaultKeySequenceInUse(const QKeySequence &keySeq
         return false;
     }
 
-    foreach(KeyboardShortcut s, m_shortcuts) {
-        if (s.defaultKeySequence() == keySequence) {
-            return true;
-        }
-    }
-    return false;
+    return m_defaultKeySequenceCount.contains(keySequence);
 }
 
 void KeyboardShortcutManager::writeSettings()
@@ -361,7 +373,38 @@ void KeyboardShortcutManager::readSettings()
 void KeyboardShortcutManager::restoreSavedShortcutForId(const QString &id)
 {
     if (m_savedShortcuts.contains(id)) {
-        m_shortcuts.insert(id, m_savedShortcuts.value(id));
+        insertShortcut(id, m_savedShortcuts.value(id));
         m_savedShortcuts.remove(id);
     }
 }
+
+void KeyboardShortcutManager::insertShortcut(const QString &id, const KeyboardShortcut &s)
+{
+    if (m_shortcuts.contains(id)) {
+        removeFromIndex(m_shortcuts.value(id));
+    }
+    m_shortcuts.insert(id, s);
+    addToIndex(s);
+}
+
+void KeyboardShortcutManager::addToIndex(KeyboardShortcut s)
+{
+    if (!s.keySequence().isEmpty()) {
+        m_keySequenceCount[s.keySequence()]++;
+    }
+    if (!s.defaultKeySequence().isEmpty()) {
+        m_defaultKeySequenceCount[s.defaultKeySequence()]++;
+    }
+}
+
+void KeyboardShortcutManager::removeFromIndex(KeyboardShortcut s)
+{
+    QHash<QKeySequence, int>::iterator it = m_keySequenceCount.find(s.keySequence());
+    if (!s.keySequence().isEmpty() && (it != m_keySequenceCount.end()) && (--it.value() == 0)) {
+        m_keySequenceCount.erase(it);
+    }
+    it = m_defaultKeySequenceCount.find(s.defaultKeySequence());
+    if (!s.defaultKeySequence().isEmpty() && (it != m_defaultKeySequenceCount.end()) && (--it.value() == 0)) {
+        m_defaultKeySequenceCount.erase(it);
+    }
+}
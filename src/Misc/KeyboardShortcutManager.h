@@ -210,9 +210,29 @@ private:
      */
     void restoreSavedShortcutForId(const QString &id);
 
+    /**
+     * Adds or replaces the managed shortcut for id, keeping
+     * the key sequence index up to date.
+     */
+    void insertShortcut(const QString &id, const KeyboardShortcut &s);
+
+    /**
+     * Count, or stop counting, the key sequences of a managed shortcut.
+     * A shortcut must be taken out of the index before its key sequences
+     * are changed and put back in after.
+     */
+    void addToIndex(KeyboardShortcut s);
+    void removeFromIndex(KeyboardShortcut s);
+
     // Tracks the KeyboardShortcuts we are managing.
     QHash<QString, KeyboardShortcut> m_shortcuts;
 
+    // How many managed shortcuts use each key sequence and default
+    // key sequence, so that registering hundreds of actions does not
+    // walk every shortcut for each one.
+    QHash<QKeySequence, int> m_keySequenceCount;
+    QHash<QKeySequence, int> m_defaultKeySequenceCount;
+
     // Tracks the last saved shortcuts. The ini file may contain shortcuts from
     // older versions of Sigil which we will want removed to avoid issues.
     // A saved shortcut will be ignored until its id has been registered by Sigil
@@ -29,9 +29,15 @@
 #ifndef LOCALEAWARE_H
 #define LOCALEAWARE_H
 
+#include <optional>
+
 #include <QString>
+#include <QCollator>
 #include <QStandardItem>
 
+// Sorting a column compares each item many times, so the collation
+// key of the text is made once, the first time it is needed, and
+// kept until the text changes.
 class LocaleAwareItem: public QStandardItem
 {
 
@@ -40,10 +46,31 @@ public:
         : QStandardItem() {
     }
 
+    void setData(const QVariant &value, int role = Qt::UserRole + 1) {
+        if ((role == Qt::DisplayRole) || (role == Qt::EditRole)) {
+            m_SortKey.reset();
+        }
+        QStandardItem::setData(value, role);
+    }
+
 private:
+    const QCollatorSortKey &sortKey() const {
+        if (!m_SortKey) {
+            static const QCollator collator;
+            m_SortKey = collator.sortKey(text());
+        }
+        return *m_SortKey;
+    }
+
     bool operator<(const QStandardItem &other) const {
-        return QString::localeAwareCompare(text(), other.text()) < 0;
+        const LocaleAwareItem *item = dynamic_cast<const LocaleAwareItem *>(&other);
+        if (!item) {
+            return QString::localeAwareCompare(text(), other.text()) < 0;
+        }
+        return sortKey().compare(item->sortKey()) < 0;
     }
+
+    mutable std::optional<QCollatorSortKey> m_SortKey;
 };
 
 #endif // LOCALEAWARE_H
@@ -0,0 +1,248 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#ifdef _WIN32
+#include "iowin32.h"
+#endif
+
+#include <QtCore/QDir>
+
+#include "Misc/MappedZipArchive.h"
+#include "Misc/Utility.h"
+
+// This is the same read buffer size used by Java and Perl.
+static const int BUFF_SIZE = 8192;
+
+// crc32 takes its length as a uInt
+static const quint64 CRC_CHUNK_SIZE = 1 << 30;
+
+MappedZipArchive::MappedZipArchive(const QString &zippath)
+    :
+    m_ZipPath(zippath),
+    m_File(zippath),
+    m_Data(NULL),
+    m_Size(0)
+{
+    if (m_File.open(QIODevice::ReadOnly) && (m_File.size() > 0)) {
+        m_Data = m_File.map(0, m_File.size());
+        if (m_Data) {
+            m_Size = m_File.size();
+        }
+    }
+}
+
+
+MappedZipArchive::~MappedZipArchive()
+{
+    if (m_Data) {
+        m_File.unmap(m_Data);
+    }
+    m_File.close();
+}
+
+
+unzFile MappedZipArchive::Open()
+{
+    if (!m_Data) {
+#ifdef Q_OS_WIN32
+        zlib_filefunc64_def ffunc;
+        fill_win32_filefunc64W(&ffunc);
+        return unzOpen2_64(Utility::QStringToStdWString(QDir::toNativeSeparators(m_ZipPath)).c_str(), &ffunc);
+#else
+        return unzOpen64(QDir::toNativeSeparators(m_ZipPath).toUtf8().constData());
+#endif
+    }
+    zlib_filefunc64_def ffunc;
+    ffunc.zopen64_file = OpenStream;
+    ffunc.zread_file = ReadStream;
+    ffunc.zwrite_file = WriteStream;
+    ffunc.ztell64_file = TellStream;
+    ffunc.zseek64_file = SeekStream;
+    ffunc.zclose_file = CloseStream;
+    ffunc.zerror_file = ErrorStream;
+    ffunc.opaque = this;
+    // the name is not used by OpenStream but minizip wants one
+    return unzOpen2_64(m_ZipPath.toUtf8().constData(), &ffunc);
+}
+
+
+bool MappedZipArchive::ExtractCurrentFile(unzFile zfile, const QString &file_path)
+{
+    unz_file_info64 file_info;
+    if (unzGetCurrentFileInfo64(zfile, &file_info, NULL, 0, NULL, 0, NULL, 0) != UNZ_OK) {
+        return false;
+    }
+
+    // Open the file entry in the archive for reading.
+    if (unzOpenCurrentFile(zfile) != UNZ_OK) {
+        return false;
+    }
+
+    // Open the file on disk to write the entry in the archive to.
+    QFile entry(file_path);
+
+    if (!entry.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        unzCloseCurrentFile(zfile);
+        return false;
+    }
+
+    bool stored = m_Data && (file_info.compression_method == 0) && !(file_info.flag & 1);
+    if (stored) {
+        if (!WriteStoredEntry(zfile, file_info, entry)) {
+            entry.close();
+            unzCloseCurrentFile(zfile);
+            return false;
+        }
+    } else {
+        // Buffered reading and writing.
+        char buff[BUFF_SIZE] = {0};
+        int read = 0;
+
+        while ((read = unzReadCurrentFile(zfile, buff, BUFF_SIZE)) > 0) {
+            entry.write(buff, read);
+        }
+
+        // Read errors are marked by a negative read amount.
+        if (read < 0) {
+            entry.close();
+            unzCloseCurrentFile(zfile);
+            return false;
+        }
+    }
+
+    entry.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner |
+                         QFileDevice::ReadUser  | QFileDevice::WriteUser  |
+                         QFileDevice::ReadOther);
+    entry.close();
+
+    // The file was read but the CRC did not match.
+    // We don't check the read file size vs the uncompressed file size
+    // because if they're different there should be a CRC error.
+    return unzCloseCurrentFile(zfile) != UNZ_CRCERROR;
+}
+
+
+// minizip only checks the CRC of what is read through unzReadCurrentFile,
+// so a stored entry written from the mapping is checked here instead.
+bool MappedZipArchive::WriteStoredEntry(unzFile zfile, const unz_file_info64 &file_info, QFile &entry)
+{
+    quint64 offset = unzGetCurrentFileZStreamPos64(zfile);
+    quint64 size = file_info.compressed_size;
+    if ((size != file_info.uncompressed_size) || (offset > m_Size) || (size > m_Size - offset)) {
+        return false;
+    }
+
+    const uchar *data = m_Data + offset;
+    uLong crc = crc32(0L, Z_NULL, 0);
+    for (quint64 done = 0; done < size; done += CRC_CHUNK_SIZE) {
+        crc = crc32(crc, data + done, static_cast<uInt>(qMin(CRC_CHUNK_SIZE, size - done)));
+    }
+    if (crc != file_info.crc) {
+        return false;
+    }
+    return entry.write(reinterpret_cast<const char *>(data), size) == static_cast<qint64>(size);
+}
+
+
+voidpf ZCALLBACK MappedZipArchive::OpenStream(voidpf opaque, const void *filename, int mode)
+{
+    Q_UNUSED(filename);
+    MappedZipArchive *archive = static_cast<MappedZipArchive *>(opaque);
+    if ((mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER) != ZLIB_FILEFUNC_MODE_READ) {
+        return NULL;
+    }
+    Stream *stream = new Stream;
+    stream->data = archive->m_Data;
+    stream->size = archive->m_Size;
+    stream->pos = 0;
+    return stream;
+}
+
+
+uLong ZCALLBACK MappedZipArchive::ReadStream(voidpf opaque, voidpf stream, void *buf, uLong size)
+{
+    Q_UNUSED(opaque);
+    Stream *s = static_cast<Stream *>(stream);
+    quint64 available = s->pos < s->size ? s->size - s->pos : 0;
+    quint64 amount = qMin(static_cast<quint64>(size), available);
+    memcpy(buf, s->data + s->pos, amount);
+    s->pos += amount;
+    return static_cast<uLong>(amount);
+}
+
+
+uLong ZCALLBACK MappedZipArchive::WriteStream(voidpf opaque, voidpf stream, const void *buf, uLong size)
+{
+    Q_UNUSED(opaque);
+    Q_UNUSED(stream);
+    Q_UNUSED(buf);
+    Q_UNUSED(size);
+    return 0;
+}
+
+
+ZPOS64_T ZCALLBACK MappedZipArchive::TellStream(voidpf opaque, voidpf stream)
+{
+    Q_UNUSED(opaque);
+    return static_cast<Stream *>(stream)->pos;
+}
+
+
+long ZCALLBACK MappedZipArchive::SeekStream(voidpf opaque, voidpf stream, ZPOS64_T offset, int origin)
+{
+    Q_UNUSED(opaque);
+    Stream *s = static_cast<Stream *>(stream);
+    quint64 base = 0;
+    switch (origin) {
+        case ZLIB_FILEFUNC_SEEK_SET:
+            base = 0;
+            break;
+        case ZLIB_FILEFUNC_SEEK_CUR:
+            base = s->pos;
+            break;
+        case ZLIB_FILEFUNC_SEEK_END:
+            base = s->size;
+            break;
+        default:
+            return -1;
+    }
+    if (offset > s->size || base > s->size - offset) {
+        return -1;
+    }
+    s->pos = base + offset;
+    return 0;
+}
+
+
+int ZCALLBACK MappedZipArchive::CloseStream(voidpf opaque, voidpf stream)
+{
+    Q_UNUSED(opaque);
+    delete static_cast<Stream *>(stream);
+    return 0;
+}
+
+
+int ZCALLBACK MappedZipArchive::ErrorStream(voidpf opaque, voidpf stream)
+{
+    Q_UNUSED(opaque);
+    Q_UNUSED(stream);
+    return 0;
+}
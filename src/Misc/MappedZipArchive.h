@@ -0,0 +1,94 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef MAPPEDZIPARCHIVE_H
+#define MAPPEDZIPARCHIVE_H
+
+#include <QtCore/QFile>
+#include <QtCore/QString>
+
+#include "unzip.h"
+
+/**
+ * A zip archive mapped into memory for minizip to read from.
+ *
+ * Every handle returned by Open reads straight from the mapping,
+ * so several threads can each open their own handle on the same
+ * archive without it being read from disk more than once.  Entries
+ * that are stored rather than deflated, which is the case for most
+ * images in an epub, are written out from the mapping in one go.
+ *
+ * If the archive can not be mapped the handles fall back to
+ * minizip's regular file access.
+ */
+class MappedZipArchive
+{
+
+public:
+
+    MappedZipArchive(const QString &zippath);
+
+    ~MappedZipArchive();
+
+    bool IsMapped() const { return m_Data != NULL; };
+
+    /**
+     * Opens a new minizip handle on the archive, to be closed with
+     * unzClose.  Returns NULL if the archive can not be read.
+     */
+    unzFile Open();
+
+    /**
+     * Writes the current entry of a handle from Open to file_path.
+     *
+     * @return \c true if the entry was read, written and passed its CRC check.
+     */
+    bool ExtractCurrentFile(unzFile zfile, const QString &file_path);
+
+private:
+
+    struct Stream {
+        const uchar *data;
+        quint64 size;
+        quint64 pos;
+    };
+
+    static voidpf ZCALLBACK OpenStream(voidpf opaque, const void *filename, int mode);
+    static uLong ZCALLBACK ReadStream(voidpf opaque, voidpf stream, void *buf, uLong size);
+    static uLong ZCALLBACK WriteStream(voidpf opaque, voidpf stream, const void *buf, uLong size);
+    static ZPOS64_T ZCALLBACK TellStream(voidpf opaque, voidpf stream);
+    static long ZCALLBACK SeekStream(voidpf opaque, voidpf stream, ZPOS64_T offset, int origin);
+    static int ZCALLBACK CloseStream(voidpf opaque, voidpf stream);
+    static int ZCALLBACK ErrorStream(voidpf opaque, voidpf stream);
+
+    bool WriteStoredEntry(unzFile zfile, const unz_file_info64 &file_info, QFile &entry);
+
+    QString m_ZipPath;
+
+    QFile m_File;
+
+    uchar *m_Data;
+
+    quint64 m_Size;
+};
+
+#endif // MAPPEDZIPARCHIVE_H
@@ -19,9 +19,11 @@
 **
 *************************************************************************/
 
+#include <algorithm>
+
 #include <QString>
 #include <QStringList>
-#include <QHash>
+#include <QStringView>
 #include "sigil_constants.h"
 #include "Misc/MediaTypes.h"
 
@@ -58,277 +60,279 @@ const QStringList MISC_XML_MIMETYPES   = QStringList() << "application/oebps-pag
                                                        << "text/xml";
 
 
-MediaTypes *MediaTypes::m_instance = 0;
+// The tables are sorted by key, which the static_asserts below check,
+// so they are searched in place.  They are built by the compiler and
+// never change, so looking something up needs no lock and makes no
+// strings beyond the one returned, which only points at the table.
 
-MediaTypes *MediaTypes::instance()
+namespace
 {
-    if (m_instance == 0) {
-        m_instance = new MediaTypes();
-    }
-
-    return m_instance;
-}
-
 
-QString MediaTypes::GetMediaTypeFromExtension(const QString &extension, const QString &fallback)
+struct MediaTypeEntry {
+    QStringView key;
+    QStringView value;
+};
+
+// default to using the preferred media-types from the epub 3.2 spec
+// https://www.w3.org/publishing/epub3/epub-spec.html#sec-cmt-supported
+constexpr MediaTypeEntry EXT_TO_MTYPE[] = {
+    { u"bm",    u"image/bmp"                               },
+    { u"bmp",   u"image/bmp"                               },
+    { u"css",   u"text/css"                                },
+    { u"epub",  u"application/epub+zip"                    },
+    { u"gif",   u"image/gif"                               },
+    { u"htm",   u"application/xhtml+xml"                   },
+    { u"html",  u"application/xhtml+xml"                   },
+    { u"jpeg",  u"image/jpeg"                              },
+    { u"jpg",   u"image/jpeg"                              },
+    { u"js",    u"application/javascript"                  },
+    { u"m4a",   u"audio/mp4"                               },
+    { u"m4v",   u"video/mp4"                               },
+    { u"mp3",   u"audio/mpeg"                              },
+    { u"mp4",   u"video/mp4"                               },
+    { u"ncx",   u"application/x-dtbncx+xml"                },
+    { u"oga",   u"audio/ogg"                               },
+    { u"ogg",   u"audio/ogg"                               },
+    { u"ogv",   u"video/ogg"                               },
+    { u"opf",   u"application/oebps-package+xml"           },
+    { u"opus",  u"audio/opus"                              },
+    { u"otf",   u"font/otf"                                },
+    { u"pdf",   u"application/pdf"                         },
+    { u"pls",   u"application/pls+xml"                     },
+    { u"png",   u"image/png"                               },
+    { u"smil",  u"application/smil+xml"                    },
+    { u"svg",   u"image/svg+xml"                           },
+    { u"tif",   u"image/tiff"                              },
+    { u"tiff",  u"image/tiff"                              },
+    { u"ttc",   u"font/collection"                         },
+    { u"ttf",   u"font/ttf"                                },
+    { u"ttml",  u"application/ttml+xml"                    },
+    { u"txt",   u"text/plain"                              },
+    { u"vtt",   u"text/vtt"                                },
+    { u"webm",  u"video/webm"                              },
+    { u"webp",  u"image/webp"                              },
+    { u"woff",  u"font/woff"                               },
+    { u"woff2", u"font/woff2"                              },
+    { u"xhtml", u"application/xhtml+xml"                   },
+    { u"xml",   u"application/xml"                         },
+    { u"xpgt",  u"application/vnd.adobe-page-template+xml" },
+};
+
+// the deprecated font mediatypes are kept
+// See https://www.iana.org/assignments/media-types/media-types.xhtml#font
+constexpr MediaTypeEntry MTYPE_TO_GROUP[] = {
+    { u"application/adobe-page-template+xml",     u"Misc"   },
+    { u"application/ecmascript",                  u"Misc"   },
+    { u"application/font-otf",                    u"Fonts"  },
+    { u"application/font-sfnt",                   u"Fonts"  },
+    { u"application/font-ttf",                    u"Fonts"  },
+    { u"application/font-woff",                   u"Fonts"  },
+    { u"application/font-woff2",                  u"Fonts"  },
+    { u"application/javascript",                  u"Misc"   },
+    { u"application/oebps-package+xml",           u"opf"    },
+    { u"application/oebps-page-map+xml",          u"Misc"   },
+    { u"application/pdf",                         u"Misc"   },
+    { u"application/pls+xml",                     u"Misc"   },
+    { u"application/smil+xml",                    u"Misc"   },
+    { u"application/ttml+xml",                    u"Video"  },
+    { u"application/vnd.adobe-page-map+xml",      u"Misc"   },
+    { u"application/vnd.adobe-page-template+xml", u"Misc"   },
+    { u"application/vnd.ms-opentype",             u"Fonts"  },
+    { u"application/x-dtbncx+xml",                u"ncx"    },
+    { u"application/x-dtbook+xml",                u"Text"   },
+    { u"application/x-font-opentype",             u"Fonts"  },
+    { u"application/x-font-otf",                  u"Fonts"  },
+    { u"application/x-font-truetype",             u"Fonts"  },
+    { u"application/x-font-truetype-collection",  u"Fonts"  },
+    { u"application/x-font-ttf",                  u"Fonts"  },
+    { u"application/x-javascript",                u"Misc"   },
+    { u"application/x-opentype-font",             u"Fonts"  },
+    { u"application/x-truetype-font",             u"Fonts"  },
+    { u"application/xhtml+xml",                   u"Text"   },
+    { u"application/xml",                         u"Misc"   },
+    { u"audio/mp3",                               u"Audio"  },
+    { u"audio/mp4",                               u"Audio"  },
+    { u"audio/mpeg",                              u"Audio"  },
+    { u"audio/ogg",                               u"Audio"  },
+    { u"audio/opus",                              u"Audio"  },
+    { u"font/collection",                         u"Fonts"  },
+    { u"font/otf",                                u"Fonts"  },
+    { u"font/sfnt",                               u"Fonts"  },
+    { u"font/ttf",                                u"Fonts"  },
+    { u"font/woff",                               u"Fonts"  },
+    { u"font/woff2",                              u"Fonts"  },
+    { u"image/bmp",                               u"Images" },
+    { u"image/gif",                               u"Images" },
+    { u"image/jpeg",                              u"Images" },
+    { u"image/png",                               u"Images" },
+    { u"image/svg+xml",                           u"Images" },
+    { u"image/tiff",                              u"Images" },
+    { u"image/webp",                              u"Images" },
+    { u"text/css",                                u"Styles" },
+    { u"text/html",                               u"Text"   },
+    { u"text/javascript",                         u"Misc"   },
+    { u"text/plain",                              u"Misc"   },
+    { u"text/vtt",                                u"Video"  },
+    { u"text/xml",                                u"Misc"   },
+    { u"video/mp4",                               u"Video"  },
+    { u"video/ogg",                               u"Video"  },
+    { u"video/webm",                              u"Video"  },
+    { u"vnd.apple.ibooks+xml",                    u"other"  },
+};
+
+constexpr MediaTypeEntry MTYPE_TO_RDESC[] = {
+    { u"application/adobe-page-template+xml",     u"XMLResource"      },  // not a core media type
+    { u"application/ecmascript",                  u"MiscTextResource" },
+    { u"application/font-otf",                    u"FontResource"     },
+    { u"application/font-sfnt",                   u"FontResource"     },
+    { u"application/font-ttf",                    u"FontResource"     },
+    { u"application/font-woff",                   u"FontResource"     },
+    { u"application/font-woff2",                  u"FontResource"     },
+    { u"application/javascript",                  u"MiscTextResource" },
+    { u"application/oebps-package+xml",           u"OPFResource"      },
+    { u"application/oebps-page-map+xml",          u"XMLResource"      },  // not a core media type
+    { u"application/pdf",                         u"PdfResource"      },  // not a core media type
+    { u"application/pls+xml",                     u"XMLResource"      },
+    { u"application/smil+xml",                    u"XMLResource"      },
+    { u"application/ttml+xml",                    u"VideoResource"    },
+    { u"application/vnd.adobe-page-map+xml",      u"XMLResource"      },  // not a core media type
+    { u"application/vnd.adobe-page-template+xml", u"XMLResource"      },  // not a core media type
+    { u"application/vnd.ms-opentype",             u"FontResource"     },
+    { u"application/x-dtbncx+xml",                u"NCXResource"      },
+    { u"application/x-dtbook+xml",                u"HTMLResource"     },  // not a core media type
+    { u"application/x-font-opentype",             u"FontResource"     },
+    { u"application/x-font-otf",                  u"FontResource"     },
+    { u"application/x-font-truetype",             u"FontResource"     },
+    { u"application/x-font-truetype-collection",  u"FontResource"     },
+    { u"application/x-font-ttf",                  u"FontResource"     },
+    { u"application/x-javascript",                u"MiscTextResource" },
+    { u"application/x-opentype-font",             u"FontResource"     },
+    { u"application/x-truetype-font",             u"FontResource"     },
+    { u"application/xhtml+xml",                   u"HTMLResource"     },
+    { u"application/xml",                         u"XMLResource"      },  // not a core media type
+    { u"audio/mp3",                               u"AudioResource"    },
+    { u"audio/mp4",                               u"AudioResource"    },
+    { u"audio/mpeg",                              u"AudioResource"    },
+    { u"audio/ogg",                               u"AudioResource"    },  // epub 3.3 now a core media type
+    { u"audio/opus",                              u"AudioResource"    },  // epub 3.3 now a core media type
+    { u"font/collection",                         u"FontResource"     },  // not a core media type
+    { u"font/otf",                                u"FontResource"     },
+    { u"font/ttf",                                u"FontResource"     },
+    { u"font/woff",                               u"FontResource"     },
+    { u"font/woff2",                              u"FontResource"     },
+    { u"image/bmp",                               u"ImageResource"    },  // not a core media type
+    { u"image/gif",                               u"ImageResource"    },
+    { u"image/jpeg",                              u"ImageResource"    },
+    { u"image/png",                               u"ImageResource"    },
+    { u"image/svg+xml",                           u"SVGResource"      },
+    { u"image/tiff",                              u"ImageResource"    },  // not a core media type
+    { u"image/webp",                              u"ImageResource"    },  // not a core media type
+    { u"text/css",                                u"CSSResource"      },
+    { u"text/html",                               u"HTMLResource"     },  // not a core media type
+    { u"text/javascript",                         u"MiscTextResource" },
+    { u"text/plain",                              u"MiscTextResource" },  // not a core media type
+    { u"text/vtt",                                u"VideoResource"    },
+    { u"text/xml",                                u"XMLResource"      },  // not a core media type
+    { u"video/mp4",                               u"VideoResource"    },
+    { u"video/ogg",                               u"VideoResource"    },
+    { u"video/webm",                              u"VideoResource"    },
+    { u"vnd.apple.ibooks+xml",                    u"Resource"         },
+};
+
+constexpr bool KeyLess(QStringView a, QStringView b)
 {
-    return m_ExtToMType.value(extension, fallback);
+    qsizetype n = a.size() < b.size() ? a.size() : b.size();
+    for (qsizetype i = 0; i < n; i++) {
+        if (a.at(i).unicode() != b.at(i).unicode()) {
+            return a.at(i).unicode() < b.at(i).unicode();
+        }
+    }
+    return a.size() < b.size();
 }
 
-QString MediaTypes::GetGroupFromMediaType(const QString &media_type, const QString &fallback)
+template <size_t N>
+constexpr bool IsSorted(const MediaTypeEntry (&table)[N])
 {
-    QString group = m_MTypeToGroup.value(media_type, "");
-    if (group.isEmpty()) {
-        if (media_type.startsWith("image/")) group = "Images";
-        if (media_type.startsWith("application/font")) group = "Fonts";
-        if (media_type.startsWith("application/x-font")) group = "Fonts";
-        if (media_type.startsWith("font/"))  group = "Fonts";
-        if (media_type.startsWith("audio/")) group = "Audio";
-        if (media_type.startsWith("video/")) group = "Video";
-        if (media_type.contains("adobe") && media_type.contains("template")) group = "Misc";
-        if (media_type.startsWith("application/pdf")) group = "Misc";
+    for (size_t i = 1; i < N; i++) {
+        if (!KeyLess(table[i - 1].key, table[i].key)) {
+            return false;
+        }
     }
-    if (group.isEmpty()) return fallback;
-    return group;
+    return true;
 }
 
-// epub devs use wrong mediatypes just about everyplace so try to be 
-// robust to unknown mediatypes if they fit known patterns
-QString MediaTypes::GetResourceDescFromMediaType(const QString &media_type, const QString &fallback)
+static_assert(IsSorted(EXT_TO_MTYPE), "EXT_TO_MTYPE must be sorted by key");
+static_assert(IsSorted(MTYPE_TO_GROUP), "MTYPE_TO_GROUP must be sorted by key");
+static_assert(IsSorted(MTYPE_TO_RDESC), "MTYPE_TO_RDESC must be sorted by key");
+
+template <size_t N>
+QString Lookup(const MediaTypeEntry (&table)[N], const QStringView key, const QString &fallback)
 {
-    QString desc = m_MTypeToRDesc.value(media_type, "");
-    if (desc.isEmpty()) {
-        if (media_type.startsWith("image/")) desc = "ImageResource";
-        if (media_type.startsWith("application/font")) desc = "FontResource";
-        if (media_type.startsWith("application/x-font")) desc = "FontResource";
-        if (media_type.startsWith("font/"))  desc = "FontResource";
-        if (media_type.startsWith("audio/")) desc = "AudioResource";
-        if (media_type.startsWith("video/")) desc = "VideoResource";
-        if (media_type.contains("adobe") && media_type.contains("template")) desc = "XMLResource";
-        if (media_type.startsWith("application/pdf")) desc = "PdfResource";
+    const MediaTypeEntry *end = table + N;
+    const MediaTypeEntry *it = std::lower_bound(table, end, key,
+                                                [](const MediaTypeEntry &entry, const QStringView akey) {
+                                                    return KeyLess(entry.key, akey);
+                                                });
+    if ((it == end) || (it->key != key)) {
+        return fallback;
     }
-    if (desc.isEmpty()) return fallback;
-    return desc;
+    return QString::fromRawData(it->value.data(), it->value.size());
 }
 
+}
 
-MediaTypes::MediaTypes()
+
+MediaTypes *MediaTypes::instance()
 {
-    SetExtToMTypeMap();
-    SetMTypeToGroupMap();
-    SetMTypeToRDescMap();
+    // there is nothing to fill in so the instance is safe
+    // to make and use from any thread
+    static MediaTypes media_types;
+    return &media_types;
 }
 
-void MediaTypes::SetExtToMTypeMap()
+
+QString MediaTypes::GetMediaTypeFromExtension(const QStringView extension, const QString &fallback) const
 {
-    if (!m_ExtToMType.isEmpty()) {
-        return;
-    }
-    // default to using the preferred media-types ffrom the epub 3.2 spec
-    // https://www.w3.org/publishing/epub3/epub-spec.html#sec-cmt-supported
-    m_ExtToMType[ "bm"    ] = "image/bmp";
-    m_ExtToMType[ "bmp"   ] = "image/bmp";
-    m_ExtToMType[ "css"   ] = "text/css";
-    m_ExtToMType[ "epub"  ] = "application/epub+zip";
-    m_ExtToMType[ "gif"   ] = "image/gif";
-    m_ExtToMType[ "htm"   ] = "application/xhtml+xml";
-    m_ExtToMType[ "html"  ] = "application/xhtml+xml";
-    m_ExtToMType[ "jpeg"  ] = "image/jpeg";
-    m_ExtToMType[ "jpg"   ] = "image/jpeg";
-    m_ExtToMType[ "js"    ] = "application/javascript";
-    m_ExtToMType[ "m4a"   ] = "audio/mp4";
-    m_ExtToMType[ "m4v"   ] = "video/mp4";
-    m_ExtToMType[ "mp3"   ] = "audio/mpeg";
-    m_ExtToMType[ "mp4"   ] = "video/mp4";
-    m_ExtToMType[ "ncx"   ] = "application/x-dtbncx+xml";
-    m_ExtToMType[ "oga"   ] = "audio/ogg";
-    m_ExtToMType[ "ogg"   ] = "audio/ogg";
-    m_ExtToMType[ "ogv"   ] = "video/ogg";
-    m_ExtToMType[ "opf"   ] = "application/oebps-package+xml";
-    m_ExtToMType[ "opus"  ] = "audio/opus";
-    m_ExtToMType[ "otf"   ] = "font/otf";
-    m_ExtToMType[ "pls"   ] = "application/pls+xml";
-    m_ExtToMType[ "pdf"   ] = "application/pdf";
-    m_ExtToMType[ "png"   ] = "image/png";
-    m_ExtToMType[ "smil"  ] = "application/smil+xml";
-    m_ExtToMType[ "svg"   ] = "image/svg+xml";
-    m_ExtToMType[ "tif"   ] = "image/tiff";
-    m_ExtToMType[ "tiff"  ] = "image/tiff";
-    m_ExtToMType[ "ttc"   ] = "font/collection";
-    m_ExtToMType[ "ttf"   ] = "font/ttf";
-    m_ExtToMType[ "ttml"  ] = "application/ttml+xml";
-    m_ExtToMType[ "txt"   ] = "text/plain";
-    m_ExtToMType[ "vtt"   ] = "text/vtt";
-    m_ExtToMType[ "webm"  ] = "video/webm";
-    m_ExtToMType[ "webp"  ] = "image/webp";
-    m_ExtToMType[ "woff"  ] = "font/woff";
-    m_ExtToMType[ "woff2" ] = "font/woff2";
-    m_ExtToMType[ "xhtml" ] = "application/xhtml+xml";
-    m_ExtToMType[ "xml"   ] = "application/xml";
-    m_ExtToMType[ "xpgt"  ] = "application/vnd.adobe-page-template+xml";
+    return Lookup(EXT_TO_MTYPE, extension, fallback);
 }
 
-
-void MediaTypes::SetMTypeToGroupMap()
+QString MediaTypes::GetGroupFromMediaType(const QStringView media_type, const QString &fallback) const
 {
-    if (!m_MTypeToGroup.isEmpty()) {
-        return;
+    QString group = Lookup(MTYPE_TO_GROUP, media_type, QString());
+    if (group.isEmpty()) {
+        if (media_type.startsWith(QL1SV("image/"))) group = "Images";
+        if (media_type.startsWith(QL1SV("application/font"))) group = "Fonts";
+        if (media_type.startsWith(QL1SV("application/x-font"))) group = "Fonts";
+        if (media_type.startsWith(QL1SV("font/")))  group = "Fonts";
+        if (media_type.startsWith(QL1SV("audio/"))) group = "Audio";
+        if (media_type.startsWith(QL1SV("video/"))) group = "Video";
+        if (media_type.contains(QL1SV("adobe")) && media_type.contains(QL1SV("template"))) group = "Misc";
+        if (media_type.startsWith(QL1SV("application/pdf"))) group = "Misc";
     }
-    m_MTypeToGroup[ "image/jpeg"                              ] = "Images";
-    m_MTypeToGroup[ "image/png"                               ] = "Images";
-    m_MTypeToGroup[ "image/gif"                               ] = "Images";
-    m_MTypeToGroup[ "image/svg+xml"                           ] = "Images";
-    m_MTypeToGroup[ "image/bmp"                               ] = "Images";
-    m_MTypeToGroup[ "image/tiff"                              ] = "Images";
-    m_MTypeToGroup[ "image/webp"                              ] = "Images";
-
-    m_MTypeToGroup[ "application/xhtml+xml"                   ] = "Text";
-    m_MTypeToGroup[ "application/x-dtbook+xml"                ] = "Text";
-    m_MTypeToGroup[ "text/html"                               ] = "Text";
-
-    m_MTypeToGroup[ "font/woff2"                              ] = "Fonts";
-    m_MTypeToGroup[ "font/woff"                               ] = "Fonts";
-    m_MTypeToGroup[ "font/otf"                                ] = "Fonts";
-    m_MTypeToGroup[ "font/ttf"                                ] = "Fonts";
-    m_MTypeToGroup[ "font/sfnt"                               ] = "Fonts";
-    m_MTypeToGroup[ "font/collection"                         ] = "Fonts";
-    m_MTypeToGroup[ "application/vnd.ms-opentype"             ] = "Fonts";
-
-    // deprecated font mediatypes
-    // See https://www.iana.org/assignments/media-types/media-types.xhtml#font
-    m_MTypeToGroup[ "application/font-ttf"                    ] = "Fonts";
-    m_MTypeToGroup[ "application/font-otf"                    ] = "Fonts";
-    m_MTypeToGroup[ "application/font-sfnt"                   ] = "Fonts";
-    m_MTypeToGroup[ "application/font-woff"                   ] = "Fonts";
-    m_MTypeToGroup[ "application/font-woff2"                  ] = "Fonts";
-    m_MTypeToGroup[ "application/x-truetype-font"             ] = "Fonts";
-    m_MTypeToGroup[ "application/x-opentype-font"             ] = "Fonts";
-    m_MTypeToGroup[ "application/x-font-ttf"                  ] = "Fonts";
-    m_MTypeToGroup[ "application/x-font-otf"                  ] = "Fonts";
-    m_MTypeToGroup[ "application/x-font-opentype"             ] = "Fonts";
-    m_MTypeToGroup[ "application/x-font-truetype"             ] = "Fonts";
-    m_MTypeToGroup[ "application/x-font-truetype-collection"  ] = "Fonts";
-
-    m_MTypeToGroup[ "audio/mpeg"                              ] = "Audio";
-    m_MTypeToGroup[ "audio/mp3"                               ] = "Audio";
-    m_MTypeToGroup[ "audio/mp4"                               ] = "Audio";
-    m_MTypeToGroup[ "audio/ogg"                               ] = "Audio";
-    m_MTypeToGroup[ "audio/opus"                              ] = "Audio";
-
-    m_MTypeToGroup[ "video/mp4"                               ] = "Video";
-    m_MTypeToGroup[ "video/ogg"                               ] = "Video";
-    m_MTypeToGroup[ "video/webm"                              ] = "Video";
-    m_MTypeToGroup[ "text/vtt"                                ] = "Video";
-    m_MTypeToGroup[ "application/ttml+xml"                    ] = "Video";
-
-    m_MTypeToGroup[ "text/css"                                ] = "Styles";
-
-    m_MTypeToGroup[ "application/x-dtbncx+xml"                ] = "ncx";
-
-    m_MTypeToGroup[ "application/oebps-package+xml"           ] = "opf";
-
-    m_MTypeToGroup[ "application/oebps-page-map+xml"          ] = "Misc";
-    m_MTypeToGroup[ "application/vnd.adobe-page-map+xml"      ] = "Misc";
-
-    m_MTypeToGroup[ "application/smil+xml"                    ] = "Misc";
-    m_MTypeToGroup[ "application/pls+xml"                     ] = "Misc";
-
-    m_MTypeToGroup[ "application/xml"                         ] = "Misc";
-    m_MTypeToGroup[ "text/xml"                                ] = "Misc";
-    
-    m_MTypeToGroup[ "application/adobe-page-template+xml"     ] = "Misc";
-    m_MTypeToGroup[ "application/vnd.adobe-page-template+xml" ] = "Misc";
-
-    m_MTypeToGroup[ "application/javascript"                  ] = "Misc";
-    m_MTypeToGroup[ "application/ecmascript"                  ] = "Misc";
-    m_MTypeToGroup[ "application/x-javascript"                ] = "Misc";
-    m_MTypeToGroup[ "text/javascript"                         ] = "Misc";
-
-    m_MTypeToGroup[ "application/pdf"                         ] = "Misc";
-
-    m_MTypeToGroup[ "text/plain"                              ] = "Misc";
-
-    m_MTypeToGroup[ "vnd.apple.ibooks+xml"                    ] = "other";
+    if (group.isEmpty()) return fallback;
+    return group;
 }
 
-
-void MediaTypes::SetMTypeToRDescMap()
+// epub devs use wrong mediatypes just about everyplace so try to be 
+// robust to unknown mediatypes if they fit known patterns
+QString MediaTypes::GetResourceDescFromMediaType(const QStringView media_type, const QString &fallback) const
 {
-    if (!m_MTypeToRDesc.isEmpty()) {
-        return;
+    QString desc = Lookup(MTYPE_TO_RDESC, media_type, QString());
+    if (desc.isEmpty()) {
+        if (media_type.startsWith(QL1SV("image/"))) desc = "ImageResource";
+        if (media_type.startsWith(QL1SV("application/font"))) desc = "FontResource";
+        if (media_type.startsWith(QL1SV("application/x-font"))) desc = "FontResource";
+        if (media_type.startsWith(QL1SV("font/")))  desc = "FontResource";
+        if (media_type.startsWith(QL1SV("audio/"))) desc = "AudioResource";
+        if (media_type.startsWith(QL1SV("video/"))) desc = "VideoResource";
+        if (media_type.contains(QL1SV("adobe")) && media_type.contains(QL1SV("template"))) desc = "XMLResource";
+        if (media_type.startsWith(QL1SV("application/pdf"))) desc = "PdfResource";
     }
-    m_MTypeToRDesc[ "application/xhtml+xml"                   ] = "HTMLResource";
-    m_MTypeToRDesc[ "application/x-dtbook+xml"                ] = "HTMLResource";  // not a core media type
-    m_MTypeToRDesc[ "text/html"                               ] = "HTMLResource";  // not a core media type
-
-    m_MTypeToRDesc[ "text/css"                                ] = "CSSResource";
-
-    m_MTypeToRDesc[ "application/oebps-package+xml"           ] = "OPFResource";
-    m_MTypeToRDesc[ "application/x-dtbncx+xml"                ] = "NCXResource";
-
-    m_MTypeToRDesc[ "image/jpeg"                              ] = "ImageResource";
-    m_MTypeToRDesc[ "image/png"                               ] = "ImageResource";
-    m_MTypeToRDesc[ "image/gif"                               ] = "ImageResource";
-    m_MTypeToRDesc[ "image/bmp"                               ] = "ImageResource";  // not a core media type
-    m_MTypeToRDesc[ "image/tiff"                              ] = "ImageResource";  // not a core media type
-    m_MTypeToRDesc[ "image/webp"                              ] = "ImageResource";  // not a core media type
-
-    m_MTypeToRDesc[ "image/svg+xml"                           ] = "SVGResource";
-
-    m_MTypeToRDesc[ "font/woff2"                              ] = "FontResource";
-    m_MTypeToRDesc[ "font/woff"                               ] = "FontResource";
-    m_MTypeToRDesc[ "font/otf"                                ] = "FontResource";
-    m_MTypeToRDesc[ "font/ttf"                                ] = "FontResource";
-    m_MTypeToRDesc[ "application/vnd.ms-opentype"             ] = "FontResource";
-    m_MTypeToRDesc[ "font/collection"                         ] = "FontResource";  // not a core media type
-
-    // All of these are now deprecated
-    // See: https://www.iana.org/assignments/media-types/media-types.xhtml#font
-    m_MTypeToRDesc[ "application/x-font-truetype-collection"  ] = "FontResource";
-    m_MTypeToRDesc[ "application/x-font-ttf"                  ] = "FontResource";
-    m_MTypeToRDesc[ "application/x-font-otf"                  ] = "FontResource";
-    m_MTypeToRDesc[ "application/x-font-opentype"             ] = "FontResource";
-    m_MTypeToRDesc[ "application/x-font-truetype"             ] = "FontResource";
-    m_MTypeToRDesc[ "application/x-truetype-font"             ] = "FontResource";
-    m_MTypeToRDesc[ "application/x-opentype-font"             ] = "FontResource";
-    m_MTypeToRDesc[ "application/font-ttf"                    ] = "FontResource";
-    m_MTypeToRDesc[ "application/font-otf"                    ] = "FontResource";
-    m_MTypeToRDesc[ "application/font-sfnt"                   ] = "FontResource";
-    m_MTypeToRDesc[ "application/font-woff"                   ] = "FontResource";
-    m_MTypeToRDesc[ "application/font-woff2"                  ] = "FontResource";
-
-    m_MTypeToRDesc[ "audio/mpeg"                              ] = "AudioResource";
-    m_MTypeToRDesc[ "audio/mp3"                               ] = "AudioResource";
-    m_MTypeToRDesc[ "audio/mp4"                               ] = "AudioResource";
-    m_MTypeToRDesc[ "audio/ogg"                               ] = "AudioResource";  // epub 3.3 now a core media type
-    m_MTypeToRDesc[ "audio/opus"                              ] = "AudioResource";  // epub 3.3 now a core media type
-
-    m_MTypeToRDesc[ "video/mp4"                               ] = "VideoResource";  
-    m_MTypeToRDesc[ "video/ogg"                               ] = "VideoResource";
-    m_MTypeToRDesc[ "video/webm"                              ] = "VideoResource";
-    m_MTypeToRDesc[ "text/vtt"                                ] = "VideoResource";
-    m_MTypeToRDesc[ "application/ttml+xml"                    ] = "VideoResource";
-
-    m_MTypeToRDesc[ "application/smil+xml"                    ] = "XMLResource";
-    m_MTypeToRDesc[ "application/pls+xml"                     ] = "XMLResource";
-
-    m_MTypeToRDesc[ "application/oebps-page-map+xml"          ] = "XMLResource";  // not a core media type
-    m_MTypeToRDesc[ "application/vnd.adobe-page-map+xml"      ] = "XMLResource";  // not a core media type
-    m_MTypeToRDesc[ "application/adobe-page-template+xml"     ] = "XMLResource";  // not a core media type
-    m_MTypeToRDesc[ "application/vnd.adobe-page-template+xml" ] = "XMLResource";  // not a core media type
-
-    m_MTypeToRDesc[ "application/javascript"                  ] = "MiscTextResource";
-    m_MTypeToRDesc[ "application/x-javascript"                ] = "MiscTextResource";
-    m_MTypeToRDesc[ "application/ecmascript"                  ] = "MiscTextResource";
-    m_MTypeToRDesc[ "text/javascript"                         ] = "MiscTextResource";
-    m_MTypeToRDesc[ "text/plain"                              ] = "MiscTextResource";  // not a core media type
-    
-    m_MTypeToRDesc[ "application/xml"                         ] = "XMLResource";  // not a core media type
-    m_MTypeToRDesc[ "text/xml"                                ] = "XMLResource";  // not a core media type
-
-    m_MTypeToRDesc[ "application/pdf"                         ] = "PdfResource";  // not a core media type
+    if (desc.isEmpty()) return fallback;
+    return desc;
+}
 
-    m_MTypeToRDesc[ "vnd.apple.ibooks+xml"                    ] = "Resource";
 
+MediaTypes::MediaTypes()
+{
 }
-
@@ -24,14 +24,17 @@
 #define MEDIATYPES_H
 
 #include <QCoreApplication>
-#include <QHash>
-class QString;
+#include <QString>
+#include <QStringView>
 
 
 /**
  * Singleton.
  *
  * MediaTypes
+ *
+ * The tables are built at compile time and only ever read, so
+ * the instance is safe to use from any thread.
  */
  
 
@@ -42,27 +45,13 @@ class MediaTypes
 public:
 
     static MediaTypes *instance();
-    QString GetMediaTypeFromExtension(const QString &extension, const QString &fallback = "");
-    QString GetGroupFromMediaType(const QString &mediatype, const QString &fallback = "");
-    QString GetResourceDescFromMediaType(const QString &mediatype, const QString &fallback = "");
+    QString GetMediaTypeFromExtension(const QStringView extension, const QString &fallback = "") const;
+    QString GetGroupFromMediaType(const QStringView mediatype, const QString &fallback = "") const;
+    QString GetResourceDescFromMediaType(const QStringView mediatype, const QString &fallback = "") const;
 
 private:
 
     MediaTypes();
-
-    void SetExtToMTypeMap();
-
-    void SetMTypeToGroupMap();
-
-    void SetMTypeToRDescMap();
-
-    QHash<QString, QString> m_ExtToMType;
-    
-    QHash<QString, QString> m_MTypeToGroup;
-
-    QHash<QString, QString>m_MTypeToRDesc;
-    
-    static MediaTypes *m_instance;
 };
 
 #endif // MEDIATYPES_H
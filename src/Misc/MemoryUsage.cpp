@@ -0,0 +1,193 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QtCore/QFile>
+#include <QtCore/QLocale>
+#include <QtCore/QSet>
+#include <QtCore/QVariantMap>
+#include <QtWidgets/QApplication>
+#include <QtWidgets/QWidget>
+#include <QWebEnginePage>
+#include <QWebEngineView>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+#include "BookManipulation/Book.h"
+#include "BookManipulation/FolderKeeper.h"
+#include "BookManipulation/FragmentIndex.h"
+#include "BookManipulation/ReferenceIndex.h"
+#include "BookManipulation/ReportCache.h"
+#include "MainUI/MainApplication.h"
+#include "Misc/MemoryUsage.h"
+#include "Misc/PreviewResourceCache.h"
+#include "Misc/ThumbnailCache.h"
+#include "Misc/Trace.h"
+#include "PCRE2/PCRECache.h"
+#include "ResourceObjects/TextResource.h"
+#include "ViewEditors/CodeViewEditor.h"
+
+static MemoryUsage::Item MakeItem(const char *key, const QString &name, int count, qint64 bytes)
+{
+    MemoryUsage::Item item;
+    item.key = key;
+    item.name = name;
+    item.count = count;
+    item.bytes = bytes;
+    return item;
+}
+
+
+static MemoryUsage::Item MakeItem(const char *key, const QString &name, const std::pair<int, qint64> &usage)
+{
+    return MakeItem(key, name, usage.first, usage.second);
+}
+
+
+// The resident size of another process, where the system tells us
+static qint64 ProcessResidentSize(qint64 pid)
+{
+#ifdef Q_OS_LINUX
+    QFile statm(QString("/proc/%1/statm").arg(pid));
+    if (statm.open(QIODevice::ReadOnly)) {
+        QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.count() > 1) {
+            return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+#else
+    Q_UNUSED(pid);
+#endif
+    return 0;
+}
+
+
+QList<MemoryUsage::Item> MemoryUsage::Collect(QSharedPointer<Book> book, QWidget *main_window)
+{
+    QList<Item> items;
+    if (book) {
+        FolderKeeper *folder_keeper = book->GetFolderKeeper();
+        QList<TextResource *> text_resources = folder_keeper->GetResourceTypeList<TextResource>();
+        qint64 text_bytes = 0;
+        int document_count = 0;
+        qint64 document_bytes = 0;
+        foreach(TextResource *text_resource, text_resources) {
+            text_bytes += text_resource->GetTextMemorySize();
+            qint64 size = text_resource->GetDocumentMemorySize();
+            if (size > 0) {
+                document_count++;
+                document_bytes += size;
+            }
+        }
+        items << MakeItem("resource_text", QObject::tr("Text of files"), text_resources.count(), text_bytes);
+        items << MakeItem("text_documents", QObject::tr("Text documents of open tabs"), document_count, document_bytes);
+        items << MakeItem("reference_index", QObject::tr("Link index"), folder_keeper->GetReferenceIndex()->MemoryUsage());
+        items << MakeItem("fragment_index", QObject::tr("Fragment index"), folder_keeper->GetFragmentIndex()->MemoryUsage());
+        items << MakeItem("report_cache", QObject::tr("Reports cache (without values)"), folder_keeper->GetReportCache()->MemoryUsage());
+    }
+
+    if (main_window) {
+        QList<CodeViewEditor *> editors = main_window->findChildren<CodeViewEditor *>();
+        qint64 tag_list_bytes = 0;
+        qint64 highlight_bytes = 0;
+        foreach(CodeViewEditor *editor, editors) {
+            tag_list_bytes += editor->GetTagListMemorySize();
+            highlight_bytes += editor->GetHighlightMemorySize();
+        }
+        items << MakeItem("tag_lists", QObject::tr("Tag lists of code views"), editors.count(), tag_list_bytes);
+        items << MakeItem("highlighting", QObject::tr("Syntax highlighting"), editors.count(), highlight_bytes);
+    }
+
+    PCRECache::Statistics regex_stats = PCRECache::instance()->statistics();
+    items << MakeItem("regex_cache", QObject::tr("Compiled regexes (%1 pinned, %2 of %3 cached, %4 hits, %5 misses)")
+                                     .arg(regex_stats.pinned).arg(regex_stats.cached).arg(regex_stats.capacity)
+                                     .arg(regex_stats.hits).arg(regex_stats.misses),
+                      PCRECache::instance()->memoryUsage());
+    items << MakeItem("thumbnails", QObject::tr("Image thumbnails"), ThumbnailCache::MemoryUsage());
+    items << MakeItem("preview_files", QObject::tr("Preview file cache"), PreviewResourceCache::MemoryUsage());
+    MainApplication *main_application = qobject_cast<MainApplication *>(qApp);
+    if (main_application) {
+        items << MakeItem("preview_pages", QObject::tr("Preview page cache"), main_application->previewCacheMemoryUsage());
+    }
+
+    // views that share a renderer process count it once
+    QSet<qint64> renderers;
+    int page_count = 0;
+    int discarded_count = 0;
+    foreach(QWidget *widget, QApplication::allWidgets()) {
+        QWebEngineView *view = qobject_cast<QWebEngineView *>(widget);
+        if (!view || !view->page()) {
+            continue;
+        }
+        page_count++;
+        if (view->page()->lifecycleState() == QWebEnginePage::LifecycleState::Discarded) {
+            discarded_count++;
+        }
+        qint64 pid = view->page()->renderProcessPid();
+        if (pid > 0) {
+            renderers.insert(pid);
+        }
+    }
+    qint64 renderer_bytes = 0;
+    foreach(qint64 pid, renderers) {
+        renderer_bytes += ProcessResidentSize(pid);
+    }
+    items << MakeItem("web_renderers", QObject::tr("Web renderer processes (%1 pages, %2 discarded)")
+                                       .arg(page_count).arg(discarded_count),
+                      renderers.count(), renderer_bytes);
+    return items;
+}
+
+
+qint64 MemoryUsage::Total(const QList<Item> &items)
+{
+    qint64 total = 0;
+    foreach(const Item &item, items) {
+        total += item.bytes;
+    }
+    return total;
+}
+
+
+void MemoryUsage::AddToTrace(const QList<Item> &items)
+{
+    if (!Trace::IsEnabled()) {
+        return;
+    }
+    QVariantMap values;
+    foreach(const Item &item, items) {
+        values.insert(QString::fromUtf8(item.key), item.bytes);
+    }
+    Trace::Counter("Memory", values);
+}
+
+
+QString MemoryUsage::ToText(const QList<Item> &items)
+{
+    QLocale locale;
+    QStringList lines;
+    foreach(const Item &item, items) {
+        lines << QString("%1: %2 (%3)").arg(item.name).arg(locale.formattedDataSize(item.bytes)).arg(item.count);
+    }
+    lines << QString("%1: %2").arg(QObject::tr("Total")).arg(locale.formattedDataSize(Total(items)));
+    return lines.join("\n");
+}
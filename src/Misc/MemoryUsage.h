@@ -0,0 +1,74 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include <QtCore/QList>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QString>
+
+class Book;
+class QWidget;
+
+/**
+ * Adds up the memory held by the text of a book, the editors open on
+ * it and the caches, so a large session can be sized and trimmed.
+ *
+ * The figures are estimates from the sizes of the strings, images and
+ * compiled patterns held, they leave out allocator overhead.  The
+ * WebEngine renderer processes are given by their resident size where
+ * the system reports it (Linux), elsewhere only by their count.
+ */
+class MemoryUsage
+{
+
+public:
+
+    struct Item {
+        // untranslated, names the value in a trace
+        const char *key;
+        QString name;
+        int count;
+        qint64 bytes;
+    };
+
+    /**
+     * Measures book and the editors that are children of main_window,
+     * along with the caches shared by every book.  GUI thread only.
+     */
+    static QList<Item> Collect(QSharedPointer<Book> book, QWidget *main_window);
+
+    static qint64 Total(const QList<Item> &items);
+
+    /**
+     * Adds the sizes to the trace as a counter, when tracing.
+     */
+    static void AddToTrace(const QList<Item> &items);
+
+    /**
+     * Returns the items as lines of plain text, to attach to reports.
+     */
+    static QString ToText(const QList<Item> &items);
+};
+
+#endif // MEMORYUSAGE_H
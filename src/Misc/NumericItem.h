@@ -36,18 +36,44 @@
 #include <QStandardItem>
 #include <QLocale>
 
+// The value of the text is parsed once, the first time it is
+// compared, and kept until the text changes.
 class NumericItem: public QStandardItem
 {
 
 public:
     NumericItem(QWidget *parent = 0)
-        : QStandardItem() {
+        : QStandardItem(),
+          m_HaveValue(false),
+          m_Value(0) {
+    }
+
+    void setData(const QVariant &value, int role = Qt::UserRole + 1) {
+        if ((role == Qt::DisplayRole) || (role == Qt::EditRole)) {
+            m_HaveValue = false;
+        }
+        QStandardItem::setData(value, role);
     }
 
 private:
+    float value() const {
+        if (!m_HaveValue) {
+            m_Value = QLocale().toFloat(text());
+            m_HaveValue = true;
+        }
+        return m_Value;
+    }
+
     bool operator<(const QStandardItem &other) const {
-        return QLocale().toFloat(text())  < QLocale().toFloat(other.text());
+        const NumericItem *item = dynamic_cast<const NumericItem *>(&other);
+        if (!item) {
+            return value() < QLocale().toFloat(other.text());
+        }
+        return value() < item->value();
     }
+
+    mutable bool  m_HaveValue;
+    mutable float m_Value;
 };
 
 #endif // NUMERICITEM_H
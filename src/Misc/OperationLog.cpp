@@ -0,0 +1,106 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QtCore/QStringList>
+
+#include "Misc/OperationLog.h"
+#include "Misc/Utility.h"
+
+// A long session keeps only the latest entries
+static const int MAX_ENTRIES = 1000;
+
+OperationLog *OperationLog::m_instance = 0;
+
+OperationLog *OperationLog::instance()
+{
+    if (m_instance == 0) {
+        m_instance = new OperationLog();
+    }
+
+    return m_instance;
+}
+
+
+OperationLog::OperationLog()
+{
+}
+
+
+void OperationLog::Add(const QString &label, qint64 milliseconds, const QString &details)
+{
+    Entry entry;
+    entry.finished = QDateTime::currentDateTime();
+    entry.book = m_CurrentBook;
+    entry.label = label;
+    entry.milliseconds = milliseconds;
+    entry.details = details;
+    if (m_Entries.count() >= MAX_ENTRIES) {
+        m_Entries.removeFirst();
+    }
+    m_Entries.append(entry);
+    emit EntryAdded(entry);
+}
+
+
+QList<OperationLog::Entry> OperationLog::GetEntries() const
+{
+    return m_Entries;
+}
+
+
+void OperationLog::Clear()
+{
+    m_Entries.clear();
+    emit Cleared();
+}
+
+
+void OperationLog::SetCurrentBook(const QString &book)
+{
+    m_CurrentBook = book;
+}
+
+
+QString OperationLog::ToCSV() const
+{
+    QStringList lines;
+    lines << Utility::createCSVLine(QStringList() << "Finished" << "Book" << "Operation" << "Milliseconds" << "Details");
+    foreach(const Entry &entry, m_Entries) {
+        lines << Utility::createCSVLine(QStringList() << entry.finished.toString(Qt::ISODate)
+                                                      << entry.book
+                                                      << entry.label
+                                                      << QString::number(entry.milliseconds)
+                                                      << entry.details);
+    }
+    return lines.join('\n') + '\n';
+}
+
+
+QString OperationLog::FormatDuration(qint64 milliseconds)
+{
+    if (milliseconds < 1000) {
+        return tr("%1 ms").arg(milliseconds);
+    }
+    if (milliseconds < 60000) {
+        return tr("%1 s").arg(milliseconds / 1000.0, 0, 'f', 1);
+    }
+    return tr("%1 min %2 s").arg(milliseconds / 60000).arg((milliseconds % 60000) / 1000);
+}
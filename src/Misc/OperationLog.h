@@ -0,0 +1,94 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef OPERATIONLOG_H
+#define OPERATIONLOG_H
+
+#include <QtCore/QDateTime>
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+
+/**
+ * The book wide operations run this session and how long each took,
+ * for the status bar and the Performance History.
+ *
+ * Entries come from TRACE_OPERATION spans, see Misc/Trace.h, and from
+ * operations such as plugin runs that do not end in the scope they
+ * start in.  GUI thread only.
+ */
+class OperationLog : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    struct Entry {
+        QDateTime finished;
+        // the file name of the book the active window had open
+        QString book;
+        QString label;
+        qint64 milliseconds;
+        QString details;
+    };
+
+    static OperationLog *instance();
+
+    void Add(const QString &label, qint64 milliseconds, const QString &details = QString());
+
+    QList<Entry> GetEntries() const;
+
+    void Clear();
+
+    /**
+     * Sets the book the entries added from now on are for.
+     */
+    void SetCurrentBook(const QString &book);
+
+    /**
+     * Returns every entry as csv, with a header line.
+     */
+    QString ToCSV() const;
+
+    /**
+     * Returns milliseconds the way the status bar shows them.
+     */
+    static QString FormatDuration(qint64 milliseconds);
+
+signals:
+
+    void EntryAdded(const OperationLog::Entry &entry);
+
+    void Cleared();
+
+private:
+
+    OperationLog();
+
+    QList<Entry> m_Entries;
+
+    QString m_CurrentBook;
+
+    static OperationLog *m_instance;
+};
+
+#endif // OPERATIONLOG_H
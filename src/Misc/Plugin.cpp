@@ -67,6 +67,9 @@ Plugin::Plugin(const QHash<QString, QString> &info)
     if (info.contains("autoclose")) {
         set_autoclose(info.value("autoclose"));
     }
+    if (info.contains("session")) {
+        set_session(info.value("session"));
+    }
     if (info.contains("iconpath")) {
         set_iconpath(info.value("iconpath"));
     }
@@ -91,6 +94,7 @@ QHash<QString, QString> Plugin::serialize()
     info.insert("oslist", get_oslist());
     info.insert("autostart", get_autostart());
     info.insert("autoclose", get_autoclose());
+    info.insert("session", get_session());
     info.insert("iconpath", get_iconpath());
 
     return info;
@@ -150,6 +154,14 @@ QString Plugin::get_autoclose()
   return m_autoclose;
 }
 
+QString Plugin::get_session()
+{
+  if (m_session.isEmpty()) {
+     return "false";
+  }
+  return m_session;
+}
+
 QString Plugin::get_oslist()
 {
     return m_oslist;
@@ -215,6 +227,13 @@ void Plugin::set_autoclose(const QString &val)
     }
 }
 
+void Plugin::set_session(const QString &val)
+{
+    if (!val.isEmpty()) {
+        m_session = val.toLower();
+    }
+}
+
 void Plugin::set_iconpath(const QString &val)
 {
     m_iconpath = val;
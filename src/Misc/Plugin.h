@@ -47,6 +47,7 @@ public:
     QString get_oslist();
     QString get_autostart();
     QString get_autoclose();
+    QString get_session();
     QString get_iconpath();
 
     void set_name(const QString &val);
@@ -58,6 +59,7 @@ public:
     void set_oslist(const QString &val);
     void set_autostart(const QString &val);
     void set_autoclose(const QString &val);
+    void set_session(const QString &val);
     void set_iconpath(const QString &val);
 
 private:
@@ -70,6 +72,7 @@ private:
     QString m_oslist;
     QString m_autostart;
     QString m_autoclose;
+    QString m_session;
     QString m_iconpath;
 };
 
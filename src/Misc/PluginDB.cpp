@@ -29,6 +29,7 @@
 #include "Misc/Plugin.h"
 #include "Misc/PluginDB.h"
 #include "Misc/SettingsStore.h"
+#include "Misc/Trace.h"
 #include "Misc/Utility.h"
 #include "sigil_constants.h"
 
@@ -44,6 +45,8 @@ PluginDB *PluginDB::instance()
 }
 
 PluginDB::PluginDB()
+    :
+    m_loaded(false)
 {
     SettingsStore ss;
 
@@ -130,9 +133,11 @@ QString PluginDB::launcherRoot()
 
 void PluginDB::load_plugins_from_disk(bool force)
 {
+    TRACE_SPAN(span, "PluginDB::load_plugins_from_disk");
     QDir        d(pluginsPath());
     QStringList dplugins;
 
+    m_loaded = true;
     if (!d.exists()) {
         return;
     }
@@ -244,11 +249,17 @@ void PluginDB::remove_all_plugins()
 
 Plugin *PluginDB::get_plugin(const QString &name)
 {
+    if (!m_loaded) {
+        load_plugins_from_disk();
+    }
     return m_plugins.value(name);
 }
 
 QHash<QString, Plugin *> PluginDB::all_plugins()
 {
+    if (!m_loaded) {
+        load_plugins_from_disk();
+    }
     return m_plugins;
 }
 
@@ -307,6 +318,8 @@ Plugin *PluginDB::load_plugin(const QString &name)
                 plugin->set_autostart(reader.readElementText());
             } else if (reader.name().compare(QLatin1String("autoclose")) == 0) {
                 plugin->set_autoclose(reader.readElementText());
+            } else if (reader.name().compare(QLatin1String("session")) == 0) {
+                plugin->set_session(reader.readElementText());
             }
         }
     }
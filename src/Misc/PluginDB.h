@@ -55,6 +55,13 @@ public:
     Plugin *get_plugin(const QString &name);
     QHash<QString, Plugin *> all_plugins();
 
+    /**
+     * True once the plugins have been read from disk.  Reading them
+     * is put off until after the main window is shown, anything that
+     * asks for a plugin before then reads them right away.
+     */
+    bool is_loaded() const { return m_loaded; };
+
     QStringList engines();
     QString get_engine_path(const QString &engine);
     void set_engine_path(const QString &engine, const QString &path);
@@ -75,6 +82,7 @@ private:
 
     QHash<QString, Plugin *> m_plugins;
     QHash<QString, QString> m_engine_paths;
+    bool m_loaded;
 
     static PluginDB *m_instance;
 };
@@ -0,0 +1,199 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include "Misc/PluginSession.h"
+
+// Written by launcher.py after the result xml of every session run
+static const QByteArray END_OF_RUN = QByteArray("\x1d" "sigil plugin session: run finished" "\x1d\n");
+
+// A fresh launcher is started after this many runs
+static const int MAX_RUNS_PER_LAUNCHER = 25;
+
+// and an unused one is shut down after this long
+static const int IDLE_TIMEOUT_MS = 10 * 60 * 1000;
+
+PluginSession *PluginSession::m_instance = 0;
+
+PluginSession *PluginSession::instance()
+{
+    if (m_instance == 0) {
+        m_instance = new PluginSession(qApp);
+    }
+    return m_instance;
+}
+
+
+PluginSession::PluginSession(QObject *parent)
+    : QObject(parent),
+      m_Busy(false),
+      m_RunCount(0)
+{
+    m_IdleTimer.setSingleShot(true);
+    m_IdleTimer.setInterval(IDLE_TIMEOUT_MS);
+    connect(&m_IdleTimer, SIGNAL(timeout()), this, SLOT(IdleTimeout()));
+    connect(&m_Process, SIGNAL(readyReadStandardOutput()), this, SLOT(ReadOutput()));
+    connect(&m_Process, SIGNAL(readyReadStandardError()), this, SLOT(ReadError()));
+    connect(&m_Process, SIGNAL(finished(int, QProcess::ExitStatus)), this, SLOT(ProcessFinished(int, QProcess::ExitStatus)));
+    connect(&m_Process, SIGNAL(errorOccurred(QProcess::ProcessError)), this, SLOT(ProcessError(QProcess::ProcessError)));
+}
+
+
+PluginSession::~PluginSession()
+{
+    m_Busy = false;
+    if (m_Process.state() != QProcess::NotRunning) {
+        // the launcher leaves its loop once its stdin is closed
+        m_Process.closeWriteChannel();
+        if (!m_Process.waitForFinished(1000)) {
+            m_Process.kill();
+            m_Process.waitForFinished(1000);
+        }
+    }
+    m_instance = 0;
+}
+
+
+bool PluginSession::Run(const QString &executable,
+                        const QStringList &start_args,
+                        const QStringList &run_args,
+                        const QProcessEnvironment &env,
+                        const QString &workdir)
+{
+    if (m_Busy) {
+        return false;
+    }
+    QString key = QStringList(QStringList() << executable << start_args << workdir << env.toStringList()).join(QChar(31));
+    if ((m_Process.state() != QProcess::NotRunning) &&
+        ((key != m_Key) || (m_RunCount >= MAX_RUNS_PER_LAUNCHER))) {
+        Stop();
+    }
+    m_IdleTimer.stop();
+    m_Pending.clear();
+    m_Busy = true;
+    m_RunCount++;
+    if (m_Process.state() == QProcess::NotRunning) {
+        m_Key = key;
+        m_Process.setProcessEnvironment(env);
+        m_Process.setWorkingDirectory(workdir);
+        m_Process.start(executable, QStringList() << start_args << "--session");
+    }
+    QJsonDocument request(QJsonArray::fromStringList(run_args));
+    m_Process.write(request.toJson(QJsonDocument::Compact) + "\n");
+    return true;
+}
+
+
+void PluginSession::Stop()
+{
+    m_Busy = false;
+    m_RunCount = 0;
+    m_IdleTimer.stop();
+    if (m_Process.state() != QProcess::NotRunning) {
+        m_Process.kill();
+        m_Process.waitForFinished(2000);
+    }
+    m_Key.clear();
+    m_Pending.clear();
+}
+
+
+void PluginSession::ReadOutput()
+{
+    m_Pending += m_Process.readAllStandardOutput();
+    if (!m_Busy) {
+        m_Pending.clear();
+        return;
+    }
+    int end = m_Pending.indexOf(END_OF_RUN);
+    if (end == -1) {
+        // hold back just enough to catch a marker split across reads
+        int keep = qMin(m_Pending.size(), END_OF_RUN.size() - 1);
+        QByteArray data = m_Pending.left(m_Pending.size() - keep);
+        m_Pending = m_Pending.right(keep);
+        if (!data.isEmpty()) {
+            emit RunOutput(data);
+        }
+        return;
+    }
+    QByteArray data = m_Pending.left(end);
+    m_Pending.clear();
+    RunDone();
+    if (!data.isEmpty()) {
+        emit RunOutput(data);
+    }
+    emit RunFinished(0, QProcess::NormalExit);
+}
+
+
+void PluginSession::ReadError()
+{
+    QByteArray data = m_Process.readAllStandardError();
+    if (m_Busy && !data.isEmpty()) {
+        emit RunError(data);
+    }
+}
+
+
+void PluginSession::ProcessFinished(int exitcode, QProcess::ExitStatus exitstatus)
+{
+    m_Key.clear();
+    m_RunCount = 0;
+    m_IdleTimer.stop();
+    if (!m_Busy) {
+        return;
+    }
+    // the launcher went away part way through a run
+    m_Busy = false;
+    if (!m_Pending.isEmpty()) {
+        emit RunOutput(m_Pending);
+        m_Pending.clear();
+    }
+    emit RunFinished(exitcode, exitstatus);
+}
+
+
+void PluginSession::ProcessError(QProcess::ProcessError error)
+{
+    if (m_Busy && (error == QProcess::FailedToStart)) {
+        m_Busy = false;
+        m_Key.clear();
+        emit RunFailed(error);
+    }
+}
+
+
+void PluginSession::IdleTimeout()
+{
+    if (!m_Busy) {
+        Stop();
+    }
+}
+
+
+void PluginSession::RunDone()
+{
+    m_Busy = false;
+    m_IdleTimer.start();
+}
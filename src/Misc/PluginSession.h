@@ -0,0 +1,116 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef PLUGINSESSION_H
+#define PLUGINSESSION_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+/**
+ * Singleton.
+ *
+ * Keeps one plugin launcher running between plugin runs for plugins
+ * that ask for it with <session>true</session> in their plugin.xml.
+ * Each run is handed to the launcher as a line of json on its stdin
+ * and the launcher marks the end of each run's output on its stdout,
+ * so the interpreter start up and the launcher's imports are only
+ * paid for once.
+ *
+ * The launcher is recycled after a number of runs and shut down
+ * when it has sat idle for a while, so whatever plugins leave behind
+ * in it does not pile up.
+ */
+class PluginSession : public QObject
+{
+    Q_OBJECT
+
+public:
+    static PluginSession *instance();
+    ~PluginSession();
+
+    /**
+     * Starts a plugin run.  The launcher is (re)started first if it is
+     * not running or was started with a different interpreter, launcher
+     * or environment.  start_args are the interpreter arguments ending
+     * with the launcher path, run_args the arguments the launcher takes
+     * for a single run.  Returns false if another run is still going.
+     */
+    bool Run(const QString &executable,
+             const QStringList &start_args,
+             const QStringList &run_args,
+             const QProcessEnvironment &env,
+             const QString &workdir);
+
+    /**
+     * Kills the launcher, ending any run in progress without
+     * emitting RunFinished.
+     */
+    void Stop();
+
+    bool IsBusy() const { return m_Busy; };
+
+signals:
+    void RunOutput(const QByteArray &data);
+    void RunError(const QByteArray &data);
+    void RunFinished(int exitcode, QProcess::ExitStatus exitstatus);
+    void RunFailed(QProcess::ProcessError error);
+
+private slots:
+    void ReadOutput();
+    void ReadError();
+    void ProcessFinished(int exitcode, QProcess::ExitStatus exitstatus);
+    void ProcessError(QProcess::ProcessError error);
+    void IdleTimeout();
+
+private:
+    PluginSession(QObject *parent);
+
+    void RunDone();
+
+    QProcess m_Process;
+
+    /**
+     * What the running launcher was started with.
+     */
+    QString m_Key;
+
+    /**
+     * Output held back in case it is the start of the end of run marker.
+     */
+    QByteArray m_Pending;
+
+    bool m_Busy;
+
+    int m_RunCount;
+
+    QTimer m_IdleTimer;
+
+    static PluginSession *m_instance;
+};
+
+#endif // PLUGINSESSION_H
@@ -0,0 +1,147 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QBuffer>
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+
+#include "Misc/PreviewResourceCache.h"
+
+#if 0
+#define DBG if(1)
+#else
+#define DBG if(0)
+#endif
+
+// Files bigger than this are memory mapped rather than cached
+static const qint64 MAX_CACHED_FILE_SIZE = 4 * 1024 * 1024;
+
+static const qint64 MAX_CACHE_SIZE = 64 * 1024 * 1024;
+
+QHash<QString, PreviewResourceCache::Entry> PreviewResourceCache::m_Entries;
+qint64 PreviewResourceCache::m_TotalBytes = 0;
+quint64 PreviewResourceCache::m_UseCount = 0;
+QMutex PreviewResourceCache::m_Mutex;
+
+
+std::pair<int, qint64> PreviewResourceCache::MemoryUsage()
+{
+    QMutexLocker locker(&m_Mutex);
+    return std::make_pair(static_cast<int>(m_Entries.count()), m_TotalBytes);
+}
+
+
+QIODevice *PreviewResourceCache::Open(const QString &fullpath)
+{
+    QFileInfo fi(fullpath);
+    if (!fi.exists()) {
+        return NULL;
+    }
+    if (fi.size() > MAX_CACHED_FILE_SIZE) {
+        return OpenMapped(fullpath);
+    }
+
+    QByteArray data;
+    {
+        QMutexLocker locker(&m_Mutex);
+        QHash<QString, Entry>::iterator it = m_Entries.find(fullpath);
+        if (it != m_Entries.end() && it->size == fi.size() && it->modified == fi.lastModified()) {
+            it->last_used = ++m_UseCount;
+            data = it->data;
+        }
+    }
+
+    if (data.isNull()) {
+        QFile file(fullpath);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return NULL;
+        }
+        data = file.readAll();
+        file.close();
+        Entry entry;
+        entry.size = fi.size();
+        entry.modified = fi.lastModified();
+        entry.data = data;
+        Store(fullpath, entry);
+    }
+
+    // the buffer shares the cached bytes, nothing is copied
+    QBuffer *buffer = new QBuffer();
+    buffer->setData(data);
+    buffer->open(QIODevice::ReadOnly);
+    return buffer;
+}
+
+
+QIODevice *PreviewResourceCache::OpenMapped(const QString &fullpath)
+{
+    QFile *file = new QFile(fullpath);
+    uchar *mapped = NULL;
+    if (file->open(QIODevice::ReadOnly)) {
+        mapped = file->size() > 0 ? file->map(0, file->size()) : NULL;
+    }
+    if (!mapped) {
+        delete file;
+        // fall back to reading it the ordinary way
+        QFile plain(fullpath);
+        if (!plain.open(QIODevice::ReadOnly)) {
+            return NULL;
+        }
+        QBuffer *buffer = new QBuffer();
+        buffer->setData(plain.readAll());
+        buffer->open(QIODevice::ReadOnly);
+        return buffer;
+    }
+    DBG qDebug() << "PreviewResourceCache mapping" << fullpath;
+    QBuffer *buffer = new QBuffer();
+    buffer->setData(QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), file->size()));
+    buffer->open(QIODevice::ReadOnly);
+    // the map lasts as long as the file, so tie it to the buffer
+    file->setParent(buffer);
+    return buffer;
+}
+
+
+void PreviewResourceCache::Store(const QString &fullpath, const Entry &entry)
+{
+    QMutexLocker locker(&m_Mutex);
+    QHash<QString, Entry>::iterator it = m_Entries.find(fullpath);
+    if (it != m_Entries.end()) {
+        m_TotalBytes -= it->data.size();
+        m_Entries.erase(it);
+    }
+    while (!m_Entries.isEmpty() && (m_TotalBytes + entry.data.size() > MAX_CACHE_SIZE)) {
+        QHash<QString, Entry>::iterator oldest = m_Entries.begin();
+        for (QHash<QString, Entry>::iterator e = m_Entries.begin(); e != m_Entries.end(); ++e) {
+            if (e->last_used < oldest->last_used) {
+                oldest = e;
+            }
+        }
+        DBG qDebug() << "PreviewResourceCache dropping" << oldest.key();
+        m_TotalBytes -= oldest->data.size();
+        m_Entries.erase(oldest);
+    }
+    Entry stored = entry;
+    stored.last_used = ++m_UseCount;
+    m_Entries.insert(fullpath, stored);
+    m_TotalBytes += stored.data.size();
+}
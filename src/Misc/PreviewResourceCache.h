@@ -0,0 +1,85 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef PREVIEWRESOURCECACHE_H
+#define PREVIEWRESOURCECACHE_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+#include <utility>
+
+class QIODevice;
+
+/**
+ * Keeps the bytes of the files the Preview pages use, the stylesheets,
+ * fonts and images, so that loading a page again, or the next chapter
+ * using the same files, does not read them all from disk again.
+ *
+ * An entry stands for the file while its size and modification time
+ * are unchanged, so a saved stylesheet is read again on the next load.
+ * The cache only grows to a fixed total size, dropping the files used
+ * least recently, and files too big for it are handed to WebEngine
+ * straight from a memory map instead.
+ */
+class PreviewResourceCache
+{
+public:
+    /**
+     * Returns a read only device holding the contents of the file at
+     * fullpath, or NULL if it can not be read.  The caller owns it.
+     */
+    static QIODevice *Open(const QString &fullpath);
+
+    /**
+     * The number of files cached and the bytes they hold.
+     */
+    static std::pair<int, qint64> MemoryUsage();
+
+private:
+    struct Entry {
+        qint64 size;
+        QDateTime modified;
+        QByteArray data;
+        quint64 last_used;
+    };
+
+    static QIODevice *OpenMapped(const QString &fullpath);
+
+    static void Store(const QString &fullpath, const Entry &entry);
+
+    /**
+     * Cached entries keyed by full file path.
+     */
+    static QHash<QString, Entry> m_Entries;
+
+    static qint64 m_TotalBytes;
+
+    static quint64 m_UseCount;
+
+    static QMutex m_Mutex;
+};
+
+#endif // PREVIEWRESOURCECACHE_H
@@ -0,0 +1,114 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+
+#include <QtCore/QElapsedTimer>
+#include <QtGui/QSyntaxHighlighter>
+#include <QtGui/QTextBlock>
+#include <QtGui/QTextDocument>
+#include <QtWidgets/QPlainTextEdit>
+#include <QDebug>
+
+#include "Misc/RehighlightScheduler.h"
+
+#if 0
+#define DBG if(1)
+#else
+#define DBG if(0)
+#endif
+
+// How long each idle time chunk may keep the event loop waiting
+static const int CHUNK_MS = 15;
+
+
+RehighlightScheduler::RehighlightScheduler(QSyntaxHighlighter *highlighter, QPlainTextEdit *editor)
+    :
+    QObject(highlighter),
+    m_Highlighter(highlighter),
+    m_Editor(editor)
+{
+    m_Timer.setSingleShot(true);
+    m_Timer.setInterval(0);
+    connect(&m_Timer, SIGNAL(timeout()), this, SLOT(HighlightChunk()));
+}
+
+
+void RehighlightScheduler::Start()
+{
+    Stop();
+    QTextDocument *document = m_Highlighter->document();
+    if (!document || (m_Editor->document() != document)) {
+        return;
+    }
+
+    // We block signals from the document while highlighting takes place,
+    // because we do not want the contentsChanged() signal to be fired
+    // which would mark the underlying resource as needing saving.
+    QTextBlock block = m_Editor->cursorForPosition(QPoint(0, 0)).block();
+    int last = m_Editor->cursorForPosition(QPoint(0, m_Editor->viewport()->height())).blockNumber();
+    document->blockSignals(true);
+    while (block.isValid() && (block.blockNumber() <= last)) {
+        m_Highlighter->rehighlightBlock(block);
+        block = block.next();
+    }
+    document->blockSignals(false);
+
+    // the blocks on screen come round again, which costs
+    // less than keeping track of them
+    m_Next = QTextCursor(document);
+    m_Timer.start();
+}
+
+
+void RehighlightScheduler::Stop()
+{
+    m_Timer.stop();
+    m_Next = QTextCursor();
+}
+
+
+void RehighlightScheduler::HighlightChunk()
+{
+    QTextDocument *document = m_Highlighter->document();
+    if (!document || (m_Next.document() != document)) {
+        // the highlighter has moved on to another document
+        Stop();
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QTextBlock block = m_Next.block();
+    document->blockSignals(true);
+    while (block.isValid() && (timer.elapsed() < CHUNK_MS)) {
+        m_Highlighter->rehighlightBlock(block);
+        block = block.next();
+    }
+    document->blockSignals(false);
+
+    if (!block.isValid()) {
+        DBG qDebug() << "RehighlightScheduler finished";
+        Stop();
+        return;
+    }
+    m_Next.setPosition(block.position());
+    m_Timer.start();
+}
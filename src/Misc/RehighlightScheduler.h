@@ -0,0 +1,84 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+
+#pragma once
+#ifndef REHIGHLIGHTSCHEDULER_H
+#define REHIGHLIGHTSCHEDULER_H
+
+#include <QtCore/QObject>
+#include <QtCore/QTimer>
+#include <QtGui/QTextCursor>
+
+class QPlainTextEdit;
+class QSyntaxHighlighter;
+
+/**
+ * Highlights a whole document again without blocking the UI.
+ *
+ * The blocks on screen are done right away and the rest of the
+ * document a chunk at a time whenever the event loop is idle.  This
+ * relies on the block states left by the last full pass still being
+ * right, so it is meant for changes of formats or spelling, not for
+ * a newly set document.
+ */
+class RehighlightScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * The scheduler is owned by the highlighter, editor is the
+     * view used to find the blocks that are on screen.
+     */
+    RehighlightScheduler(QSyntaxHighlighter *highlighter, QPlainTextEdit *editor);
+
+    /**
+     * Starts a new pass over the document, dropping whatever is
+     * left of one already running.
+     */
+    void Start();
+
+    void Stop();
+
+private slots:
+    void HighlightChunk();
+
+private:
+
+    ///////////////////////////////
+    // PRIVATE MEMBER VARIABLES
+    ///////////////////////////////
+
+    QSyntaxHighlighter *m_Highlighter;
+
+    QPlainTextEdit *m_Editor;
+
+    /**
+     * Sits at the start of the next block to highlight, a cursor
+     * so that it follows the text as it is edited.
+     */
+    QTextCursor m_Next;
+
+    QTimer m_Timer;
+};
+
+#endif // REHIGHLIGHTSCHEDULER_H
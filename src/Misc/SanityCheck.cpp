@@ -0,0 +1,370 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QString>
+#include <QStringList>
+
+#include "Misc/SanityCheck.h"
+
+static const QString WHITESPACE_CHARS = " \n\r\t";
+static const QString TAG_NAME_DELIMITERS = ">/ \f\t\r\n";
+static const QString VALUE_DELIMITERS = ">/ ";
+
+// longer tag names mean the tag was not delimited properly
+static const int MAX_TAG_LEN = 20;
+
+static const QStringList VOID_TAGS = QStringList() << "area" << "base" << "basefont" << "bgsound"
+    << "br" << "col" << "command" << "embed" << "event-source" << "frame" << "hr" << "img" << "input"
+    << "keygen" << "link" << "menuitem" << "meta" << "param" << "source" << "spacer" << "track"
+    << "wbr" << "mbp:pagebreak";
+
+
+// a null char past either end so loops stop at the end of the string
+static QChar CharAt(const QString &s, int p)
+{
+    if ((p < 0) || (p >= s.length())) {
+        return QChar();
+    }
+    return s.at(p);
+}
+
+
+static bool IsOneOf(QChar c, const QString &chars)
+{
+    return !c.isNull() && chars.contains(c);
+}
+
+
+SanityCheck::SanityCheck(const QString &source)
+    :
+    m_Source(source),
+    m_Pos(0),
+    m_PrevPos(0),
+    m_Line(1),
+    m_Column(0),
+    m_TagLine(-1),
+    m_TagColumn(-1),
+    m_HtmlCount(0),
+    m_BodyCount(0),
+    m_HeadCount(0),
+    m_XmlDeclarationCount(0),
+    m_DoctypeCount(0),
+    m_HasError(false)
+{
+}
+
+
+QList<SanityCheck::Error> SanityCheck::Check()
+{
+    QString markup;
+    bool is_tag = false;
+    while (!m_HasError && ParseML(markup, is_tag)) {
+        if (!is_tag) {
+            // keep track of line and column while looking for stray < and >
+            foreach(QChar c, markup) {
+                if ((c == '<') || (c == '>')) {
+                    AddError(m_Line, m_Column, "illegal character in text");
+                }
+                m_Column++;
+                if (c == '\n') {
+                    m_Line++;
+                    m_Column = 0;
+                }
+            }
+            continue;
+        }
+
+        m_TagLine = m_Line;
+        m_TagColumn = m_Column;
+        foreach(QChar c, markup) {
+            m_Column++;
+            if (c == '\n') {
+                m_Line++;
+                m_Column = 0;
+            }
+        }
+
+        QString tname;
+        QString ttype;
+        QHash<QString, QString> tattr;
+        if (!ParseTag(markup, tname, ttype, tattr) || !CheckTag(tname, ttype, tattr)) {
+            break;
+        }
+        if (ttype == "begin") {
+            m_TagPath << tname;
+            m_TagPositions << std::make_pair(m_TagLine, m_TagColumn);
+        } else if (ttype == "end") {
+            m_TagPath.removeLast();
+            m_TagPositions.removeLast();
+        }
+    }
+
+    if (!m_HasError) {
+        if (m_HtmlCount != 1) {
+            AddError(1, 0, "Missing or multiple \"html\" tags");
+        }
+        if (m_BodyCount != 1) {
+            AddError(1, 0, "Missing or multiple \"body\" tags");
+        }
+        if (m_HeadCount != 1) {
+            AddError(1, 0, "Missing or multiple \"head\" tags");
+        }
+        if (m_XmlDeclarationCount != 1) {
+            AddError(1, 0, "Missing or multiple \"xml declaration header\"");
+        }
+    }
+    return m_Errors;
+}
+
+
+// Returns the leading text or the next tag, false at the end of the source
+bool SanityCheck::ParseML(QString &markup, bool &is_tag)
+{
+    m_PrevPos = m_Pos;
+    int p = m_Pos;
+    if (p >= m_Source.length()) {
+        return false;
+    }
+    if (m_Source.at(p) != '<') {
+        int res = m_Source.indexOf('<', p);
+        if (res == -1) {
+            res = m_Source.length();
+        }
+        m_Pos = res;
+        markup = m_Source.mid(p, res - p);
+        is_tag = false;
+        return true;
+    }
+    int te;
+    if (m_Source.mid(p, 4) == "<!--") {
+        // comments and cdata may run over many lines and hold < and >
+        te = m_Source.indexOf("-->", p + 1);
+        if (te != -1) {
+            te = te + 2;
+        }
+    } else if (m_Source.mid(p, 9) == "<![CDATA[") {
+        te = m_Source.indexOf("]]>", p + 9);
+        if (te != -1) {
+            te = te + 2;
+        }
+    } else {
+        te = m_Source.indexOf('>', p + 1);
+        int ntb = m_Source.indexOf('<', p + 1);
+        if ((ntb != -1) && (ntb < te)) {
+            m_Pos = ntb;
+            markup = m_Source.mid(p, ntb - p);
+            is_tag = false;
+            return true;
+        }
+    }
+    is_tag = true;
+    if (te == -1) {
+        // never closed, an empty tag is reported as not delimited
+        m_Pos = m_Source.length();
+        markup = QString();
+        return true;
+    }
+    m_Pos = te + 1;
+    markup = m_Source.mid(p, te + 1 - p);
+    return true;
+}
+
+
+// Identifies the name of the tag, its type ("begin", "end", "single" or one
+// of the special types) and the attributes of begin and single tags.
+bool SanityCheck::ParseTag(const QString &s, QString &tname, QString &ttype, QHash<QString, QString> &tattr)
+{
+    int taglen = s.length();
+    int p = 1;
+    while (CharAt(s, p) == ' ') p++;
+    if (CharAt(s, p) == '/') {
+        ttype = "end";
+        p++;
+        while (CharAt(s, p) == ' ') p++;
+    }
+    int b = p;
+
+    // special cases that need not have spaces after their names
+    if (s.mid(b, 3) == "!--") {
+        tname = "!--";
+        ttype = "comment";
+        return true;
+    }
+    if (s.mid(b, 8) == "![CDATA[") {
+        tname = "![CDATA[";
+        ttype = "cdata";
+        return true;
+    }
+    if (s.mid(b, 4) == "?xml") {
+        tname = "?xml";
+        ttype = "xmlheader";
+        return true;
+    }
+    if (CharAt(s, b) == '?') {
+        tname = "?";
+        ttype = "pi";
+        return true;
+    }
+
+    while (!IsOneOf(CharAt(s, p), TAG_NAME_DELIMITERS)) {
+        p++;
+        if (((p - b) > MAX_TAG_LEN) || (p >= taglen)) {
+            AddError(m_TagLine, m_TagColumn, "Tag name not properly delimited: \"" + s.mid(b, p - b) + "\"");
+            return false;
+        }
+    }
+    tname = s.mid(b, p - b).toLower();
+    if (tname.contains('\'') || tname.contains('"')) {
+        AddError(m_TagLine, m_TagColumn, "Tag attribute not properly space delimited: \"" + s.mid(b, p - b) + "\"");
+        return false;
+    }
+    if (tname == "!doctype") {
+        tname = "!DOCTYPE";
+        ttype = "doctype";
+        return true;
+    }
+    if (!ttype.isEmpty()) {
+        return true;
+    }
+
+    while (s.indexOf('=', p) != -1) {
+        while (IsOneOf(CharAt(s, p), WHITESPACE_CHARS)) p++;
+        b = p;
+        while (CharAt(s, p) != '=') p++;
+        QString aname = s.mid(b, p - b).toLower();
+        while (!aname.isEmpty() && WHITESPACE_CHARS.contains(aname.at(aname.length() - 1))) {
+            aname.chop(1);
+        }
+        p++;
+        while (IsOneOf(CharAt(s, p), WHITESPACE_CHARS)) p++;
+        QString val;
+        QChar qt = CharAt(s, p);
+        if ((qt == '"') || (qt == '\'')) {
+            p++;
+            b = p;
+            while (CharAt(s, p) != qt) {
+                p++;
+                if (p >= taglen) {
+                    AddError(m_TagLine, m_TagColumn, "Attribute \"" + aname + "\" has unmatched quotes on attribute value");
+                    return false;
+                }
+            }
+            val = s.mid(b, p - b);
+            p++;
+        } else {
+            b = p;
+            while (!IsOneOf(CharAt(s, p), VALUE_DELIMITERS)) {
+                p++;
+                if (p >= taglen) {
+                    AddError(m_TagLine, m_TagColumn, "Attribute \"" + aname + "\" has unterminated attribute value");
+                    return false;
+                }
+            }
+            val = s.mid(b, p - b);
+        }
+        tattr[aname] = val;
+    }
+    ttype = "begin";
+    if (s.indexOf('/', p) >= 0) {
+        ttype = "single";
+    }
+    return true;
+}
+
+
+bool SanityCheck::CheckTag(const QString &tname, const QString &ttype, const QHash<QString, QString> &tattr)
+{
+    // basic structure
+    if ((tname == "html") && (ttype == "begin")) {
+        m_HtmlCount++;
+        if (m_BodyCount > 0) {
+            AddError(m_TagLine, m_TagColumn, "Tag \"html\" found after \"body\"");
+            return false;
+        }
+    }
+    if ((tname == "body") && (ttype == "begin")) {
+        m_BodyCount++;
+        if (m_HtmlCount == 0) {
+            AddError(m_TagLine, m_TagColumn, "Tag \"body\" found before \"html\"");
+            return false;
+        }
+    }
+    if ((tname == "head") && (ttype == "begin")) {
+        m_HeadCount++;
+        if (m_BodyCount > 0) {
+            AddError(m_TagLine, m_TagColumn, "Tag \"head\" found after \"body\"");
+            return false;
+        }
+    }
+    if ((tname == "p") && (ttype == "begin") && m_TagPath.contains("p")) {
+        AddError(m_TagLine, m_TagColumn, "Can not nest a \"p\" tag inside another \"p\" tag");
+        return false;
+    }
+    if (tname == "?xml") {
+        m_XmlDeclarationCount++;
+        if ((m_HtmlCount > 0) || (m_DoctypeCount > 0)) {
+            AddError(m_TagLine, m_TagColumn, "An xml declaration must come before the \"html\" tag and DOCTYPE");
+            return false;
+        }
+    }
+    if (tname == "!DOCTYPE") {
+        m_DoctypeCount++;
+        if (m_HtmlCount > 0) {
+            AddError(m_TagLine, m_TagColumn, "A DOCTYPE must come before the \"html\" tag");
+            return false;
+        }
+    }
+    if ((tname == "link") && (tattr.value("rel") == "stylesheet") && (tattr.value("type") != "text/css")) {
+        AddError(m_TagLine, m_TagColumn, "Missing or incorrect type=\"text/css\" in css link tag");
+        return false;
+    }
+
+    // nesting
+    if (ttype == "end") {
+        if (m_TagPath.isEmpty() || (m_TagPath.last() != tname)) {
+            QString msg = "Improperly nested tags: parsing end tag \"" + tname +
+                          "\" but current parse path is \"" + m_TagPath.join('.') + "\"";
+            if (!m_TagPositions.isEmpty()) {
+                msg += QString(". See line %1 col %2").arg(m_TagPositions.last().first).arg(m_TagPositions.last().second);
+            }
+            AddError(m_TagLine, m_TagColumn, msg);
+            return false;
+        }
+    }
+
+    // void tags must be self-closed
+    if (VOID_TAGS.contains(tname) && (ttype == "end")) {
+        AddError(m_TagLine, m_TagColumn, "Void tag: " + tname + " has an illegal ending tag");
+        return false;
+    }
+    return true;
+}
+
+
+void SanityCheck::AddError(int line, int column, const QString &message)
+{
+    Error error;
+    error.line = line;
+    error.column = column;
+    error.message = message;
+    m_Errors << error;
+    m_HasError = true;
+}
@@ -0,0 +1,97 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef SANITYCHECK_H
+#define SANITYCHECK_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+
+/**
+ * A quick well-formed check of an xhtml file.
+ *
+ * Walks the markup once looking for the mistakes that break the
+ * parsing of a file: bad tag delimiters, unquoted or unterminated
+ * attribute values, improperly nested tags, end tags on void tags,
+ * nested p tags, a missing or repeated html, head, body or xml
+ * declaration and stylesheet links without type="text/css".
+ *
+ * Checking stops at the first problem found in the markup since
+ * anything after it can not be trusted.  It only reads the text it is
+ * given, so many files can be checked at once on worker threads.
+ */
+class SanityCheck
+{
+public:
+
+    struct Error {
+        int line;
+        int column;
+        QString message;
+    };
+
+    SanityCheck(const QString &source);
+
+    /**
+     * Checks the source.
+     *
+     * @return The problems found, an empty list if there are none.
+     */
+    QList<Error> Check();
+
+private:
+    bool ParseML(QString &markup, bool &is_tag);
+
+    bool ParseTag(const QString &tag, QString &tname, QString &ttype, QHash<QString, QString> &tattr);
+
+    bool CheckTag(const QString &tname, const QString &ttype, const QHash<QString, QString> &tattr);
+
+    void AddError(int line, int column, const QString &message);
+
+    QString m_Source;
+
+    // parser position
+    int m_Pos;
+    int m_PrevPos;
+    int m_Line;
+    int m_Column;
+    int m_TagLine;
+    int m_TagColumn;
+
+    // for the basic structure checks
+    int m_HtmlCount;
+    int m_BodyCount;
+    int m_HeadCount;
+    int m_XmlDeclarationCount;
+    int m_DoctypeCount;
+
+    // the open tags and where each of them started
+    QStringList m_TagPath;
+    QList<std::pair<int, int>> m_TagPositions;
+
+    bool m_HasError;
+    QList<Error> m_Errors;
+};
+
+#endif // SANITYCHECK_H
@@ -22,15 +22,21 @@
 
 #include <signal.h>
 
+#include <functional>
+
 #include <QtCore/QtCore>
+#include <QtConcurrent/QtConcurrent>
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QProgressDialog>
 
 #include "BookManipulation/CleanSource.h"
 #include "Misc/SearchOperations.h"
 #include "Misc/SettingsStore.h"
+#include "Misc/Trace.h"
 #include "Misc/Utility.h"
+#include "PCRE2/LiteralPrefilter.h"
 #include "PCRE2/PCRECache.h"
+#include "PCRE2/PCREReplaceTextBuilder.h"
 #include "Misc/HTMLSpellCheck.h"
 #include "ResourceObjects/HTMLResource.h"
 #include "ResourceObjects/TextResource.h"
@@ -41,16 +47,30 @@ int SearchOperations::CountInFiles(const QString &search_regex,
                                    QList<Resource *> resources,
                                    bool check_spelling)
 {
-    QProgressDialog progress(QObject::tr("Counting occurrences.."), 0, 0, resources.count(), Utility::GetMainWindow());
-    progress.setMinimumDuration(PROGRESS_BAR_MINIMUM_DURATION);
+    TRACE_SPAN(span, "SearchOperations::CountInFiles");
+    TRACE_ARG(span, "files", resources.count());
+    QScopedPointer<QProgressDialog> progress(CreateProgress(QObject::tr("Counting occurrences.."), resources.count()));
     int progress_value = 0;
-    progress.setValue(progress_value);
-    // Count sequentially in order to see if occassional crashes are due to threading
     int count = 0;
-    foreach(Resource * resource, resources) {
-        progress.setValue(progress_value++);
-        qApp->processEvents();
-        count += CountInFile(search_regex, resource, check_spelling);
+
+    // Hunspell is not safe to use from multiple threads so spell check
+    // counts stay sequential
+    if (check_spelling) {
+        foreach(Resource * resource, resources) {
+            if (progress) {
+                progress->setValue(progress_value++);
+                qApp->processEvents();
+            }
+            count += CountInFile(search_regex, resource, check_spelling);
+        }
+        return count;
+    }
+
+    // SPCRE and PCRECache are thread safe so count every file in parallel
+    QFuture<int> future = QtConcurrent::mapped(resources, std::bind(CountInFile, std::placeholders::_1, search_regex, false));
+    WaitForFuture(future, progress.data());
+    for (int i = 0; i < future.resultCount(); i++) {
+        count += future.resultAt(i);
     }
     return count;
 }
@@ -60,23 +80,127 @@ int SearchOperations::ReplaceInAllFIles(const QString &search_regex,
                                         const QString &replacement,
                                         QList<Resource *> resources)
 {
-    QProgressDialog progress(QObject::tr("Replacing search term..."), 0, 0, resources.count(), Utility::GetMainWindow());
-    progress.setMinimumDuration(PROGRESS_BAR_MINIMUM_DURATION);
-    int progress_value = 0;
-    progress.setValue(progress_value);
-    // Replace sequentially in order to see if occassional crashes are due to threading
+    TRACE_OPERATION(operation, "SearchOperations::ReplaceInAllFiles", QObject::tr("Replace All"));
+    operation.AddArg("files", resources.count());
+    QScopedPointer<QProgressDialog> progress(CreateProgress(QObject::tr("Replacing search term..."), resources.count()));
+
+    // The worker threads only read the resource text and build the new text.
+    // All SetText calls happen here in the GUI thread, in resource order,
+    // so that any QTextDocument updates are never made from a worker.
+    QFuture<std::tuple<QString, int, quint64>> future = QtConcurrent::mapped(resources, std::bind(ReplaceInFile, std::placeholders::_1, search_regex, replacement));
+    WaitForFuture(future, progress.data());
+
     int count = 0;
-    foreach(Resource * resource, resources) {
-        progress.setValue(progress_value++);
-        qApp->processEvents();
-        count += ReplaceInFile(search_regex, replacement, resource);
+    for (int i = 0; i < future.results().count(); i++) {
+        QString new_text;
+        int file_count;
+        quint64 revision;
+        std::tie(new_text, file_count, revision) = future.resultAt(i);
+        TextResource *text_resource = qobject_cast<TextResource *>(resources.at(i));
+        if (!text_resource) {
+            continue;
+        }
+        // a file that changed after the worker read it is replaced again here
+        while (file_count > 0 && !text_resource->SetTextIfRevision(new_text, revision)) {
+            std::tie(new_text, file_count, revision) = ReplaceInFile(text_resource, search_regex, replacement);
+        }
+        count += file_count;
     }
     return count;
 }
 
 
-int SearchOperations::CountInFile(const QString &search_regex,
-                                  Resource *resource,
+QList<int> SearchOperations::ReplaceInAllFilesBatch(const QList<ReplaceEntry> &entries)
+{
+    TRACE_OPERATION(operation, "SearchOperations::ReplaceInAllFilesBatch", QObject::tr("Replace All"));
+    operation.AddArg("searches", entries.count());
+    QList<int> counts;
+    QList<QSet<Resource *>> entry_resources;
+    QList<Resource *> resources;
+    QSet<Resource *> seen;
+    QStringList patterns;
+    foreach(const ReplaceEntry &entry, entries) {
+        counts << 0;
+        patterns << entry.search_regex;
+        QSet<Resource *> entry_set;
+        foreach(Resource *resource, entry.resources) {
+            entry_set.insert(resource);
+            if (!seen.contains(resource)) {
+                seen.insert(resource);
+                resources << resource;
+            }
+        }
+        entry_resources << entry_set;
+    }
+
+    if (resources.isEmpty()) {
+        return counts;
+    }
+
+    QScopedPointer<QProgressDialog> progress(CreateProgress(QObject::tr("Replacing search term..."), resources.count()));
+
+    // One scan of each file tells us which entries could possibly match it
+    LiteralPrefilter prefilter(patterns);
+
+    QFuture<std::tuple<QString, QList<int>, quint64>> future = QtConcurrent::mapped(resources, std::bind(ReplaceBatchInFile, std::placeholders::_1, entries, entry_resources, &prefilter));
+    WaitForFuture(future, progress.data());
+
+    // As with ReplaceInAllFIles only the GUI thread sets the new text
+    for (int i = 0; i < future.results().count(); i++) {
+        QString new_text;
+        QList<int> file_counts;
+        quint64 revision;
+        std::tie(new_text, file_counts, revision) = future.resultAt(i);
+        TextResource *text_resource = qobject_cast<TextResource *>(resources.at(i));
+        // a file that changed after the worker read it is replaced again here
+        while (text_resource && FileTotal(file_counts) > 0 && !text_resource->SetTextIfRevision(new_text, revision)) {
+            std::tie(new_text, file_counts, revision) = ReplaceBatchInFile(text_resource, entries, entry_resources, &prefilter);
+        }
+        for (int j = 0; j < file_counts.count(); j++) {
+            counts[j] += file_counts.at(j);
+        }
+    }
+    return counts;
+}
+
+
+// Off the GUI thread, as in batch mode, there is no progress to show
+QProgressDialog *SearchOperations::CreateProgress(const QString &label, int maximum)
+{
+    if (!Utility::IsGUIThread()) {
+        return NULL;
+    }
+    QProgressDialog *progress = new QProgressDialog(label, 0, 0, maximum, Utility::GetMainWindow());
+    progress->setMinimumDuration(PROGRESS_BAR_MINIMUM_DURATION);
+    progress->setValue(0);
+    return progress;
+}
+
+
+// Runs the event loop until the future is done, updating the progress
+// dialog as files complete.  User input is held off so that no resource
+// can be edited while the workers are reading it.  Without a progress
+// dialog it simply blocks until the future is done.
+template <typename T>
+void SearchOperations::WaitForFuture(QFuture<T> &future, QProgressDialog *progress)
+{
+    if (!progress) {
+        future.waitForFinished();
+        return;
+    }
+    QFutureWatcher<T> watcher;
+    QEventLoop loop;
+    QObject::connect(&watcher, &QFutureWatcher<T>::progressValueChanged, progress, &QProgressDialog::setValue);
+    QObject::connect(&watcher, &QFutureWatcher<T>::finished, &loop, &QEventLoop::quit);
+    watcher.setFuture(future);
+    if (!watcher.isFinished()) {
+        loop.exec(QEventLoop::ExcludeUserInputEvents);
+    }
+}
+
+
+int SearchOperations::CountInFile(Resource *resource,
+                                  const QString &search_regex,
                                   bool check_spelling)
 {
     // QReadLocker locker(&resource->GetLock());
@@ -102,75 +226,87 @@ int SearchOperations::CountInHTMLFile(const QString &search_regex,
                                       HTMLResource *html_resource,
                                       bool check_spelling)
 {
-    QReadLocker locker(&html_resource->GetLock());
-    // note you can not use a reference here because the text returned from
-    // any text resource can come from an internal cache that can go away
-    const QString text = html_resource->GetText();
+    // the snapshot shares the text and never changes under us
+    const QString text = html_resource->GetTextSnapshot().text;
     if (check_spelling) {
         return HTMLSpellCheck::CountMisspelledWords(text, 0, text.length(), search_regex);
     } else {
-        return PCRECache::instance()->getObject(search_regex)->getEveryMatchInfo(text).count();
+        return PCRECache::instance()->getObject(search_regex)->getMatchCount(text);
     }
 }
 
 int SearchOperations::CountInTextFile(const QString &search_regex, TextResource *text_resource)
 {
-    QReadLocker locker(&text_resource->GetLock());
-    // note you can not use a reference here because the text returned from
-    // any text resource can come from an internal cache that can go away
-    const QString text = text_resource->GetText();
-    return PCRECache::instance()->getObject(search_regex)->getEveryMatchInfo(text).count();
+    // the snapshot shares the text and never changes under us
+    const QString text = text_resource->GetTextSnapshot().text;
+    return PCRECache::instance()->getObject(search_regex)->getMatchCount(text);
 }
 
 
-int SearchOperations::ReplaceInFile(const QString &search_regex,
-                                    const QString &replacement,
-                                    Resource *resource)
+// Runs in a worker thread.  Returns the replaced text and the number of
+// replacements made, the text is only filled in if something was replaced.
+std::tuple<QString, int, quint64> SearchOperations::ReplaceInFile(Resource *resource,
+                                                                  const QString &search_regex,
+                                                                  const QString &replacement)
 {
-    // QWriteLocker locker(&resource->GetLock());
-    HTMLResource *html_resource = qobject_cast<HTMLResource *>(resource);
-
-    if (html_resource) {
-        return ReplaceHTMLInFile(search_regex, replacement, html_resource);
-    }
-
     TextResource *text_resource = qobject_cast<TextResource *>(resource);
 
-    if (text_resource) {
-        return ReplaceTextInFile(search_regex, replacement, text_resource);
+    // We should never get here.
+    if (!text_resource) {
+        return std::make_tuple(QString(), 0, quint64(0));
     }
 
-    // We should never get here.
-    return 0;
+    int count;
+    QString new_text;
+    TextResource::TextSnapshot snapshot = text_resource->GetTextSnapshot();
+    std::tie(new_text, count) = PerformGlobalReplace(snapshot.text, search_regex, replacement);
+    if (count == 0) {
+        new_text = QString();
+    }
+    return std::make_tuple(new_text, count, snapshot.revision);
 }
 
 
-int SearchOperations::ReplaceHTMLInFile(const QString &search_regex,
-                                        const QString &replacement,
-                                        HTMLResource *html_resource)
+// Runs in a worker thread.  Applies each entry that includes this
+// resource, in order, to the text and returns the final text along with
+// the number of replacements made by every entry.  Entries whose required
+// literal text is not in the file are skipped without running PCRE; since
+// a replacement can introduce new literals the candidates are recomputed
+// whenever the text changes.
+std::tuple<QString, QList<int>, quint64> SearchOperations::ReplaceBatchInFile(Resource *resource,
+                                                                              const QList<ReplaceEntry> &entries,
+                                                                              const QList<QSet<Resource *>> &entry_resources,
+                                                                              const LiteralPrefilter *prefilter)
 {
-    // SettingsStore ss;
-    QWriteLocker locker(&html_resource->GetLock());
-    int count;
-    QString new_text;
-    QString text = html_resource->GetText();
-    std::tie(new_text, count) = PerformGlobalReplace(text, search_regex, replacement);
-    html_resource->SetText(new_text);
-    return count;
- }
+    QList<int> counts;
+    TextResource *text_resource = qobject_cast<TextResource *>(resource);
 
+    if (!text_resource) {
+        for (int i = 0; i < entries.count(); i++) counts << 0;
+        return std::make_tuple(QString(), counts, quint64(0));
+    }
 
-int SearchOperations::ReplaceTextInFile(const QString &search_regex,
-                                        const QString &replacement,
-                                        TextResource *text_resource)
-{
-    QWriteLocker locker(&text_resource->GetLock());
-    int count;
-    QString new_text;
-    QString text = text_resource->GetText();
-    std::tie(new_text, count) = PerformGlobalReplace(text, search_regex, replacement);
-    text_resource->SetText(new_text);
-    return count;
+    TextResource::TextSnapshot snapshot = text_resource->GetTextSnapshot();
+    QString text = snapshot.text;
+    bool changed = false;
+    QList<bool> candidates = prefilter->Candidates(text);
+    for (int i = 0; i < entries.count(); i++) {
+        int count = 0;
+        if (entry_resources.at(i).contains(resource) && candidates.at(i)) {
+            std::tie(text, count) = PerformGlobalReplace(text, entries.at(i).search_regex, entries.at(i).replacement);
+        }
+        if (count > 0) {
+            changed = true;
+            if (i + 1 < entries.count()) {
+                candidates = prefilter->Candidates(text);
+            }
+        }
+        counts << count;
+    }
+    if (!changed) {
+        text = QString();
+    }
+    return std::make_tuple(text, counts, snapshot.revision);
 }
 
 
@@ -178,21 +314,34 @@ std::tuple<QString, int> SearchOperations::PerformGlobalReplace(const QString &t
         const QString &search_regex,
         const QString &replacement)
 {
-    QString new_text = text;
     int count = 0;
-    SPCRE *spcre = PCRECache::instance()->getObject(search_regex);
-    QList<SPCRE::MatchInfo> match_info = spcre->getEveryMatchInfo(text);
+    QSharedPointer<SPCRE> spcre = PCRECache::instance()->getObject(search_regex);
+    SPCRE::MatchArray matches = spcre->getEveryMatchArray(text);
 
-    for (int i =  match_info.count() - 1; i >= 0; i--) {
-        QString match_segement = Utility::Substring(match_info.at(i).offset.first, match_info.at(i).offset.second, new_text);
-        QString replacement_text;
+    if (matches.count() == 0) {
+        return std::make_tuple(text, count);
+    }
 
-        if (spcre->replaceText(match_segement, match_info.at(i).capture_groups_offsets, replacement, replacement_text)) {
-            new_text.replace(match_info.at(i).offset.first, match_info.at(i).offset.second - match_info.at(i).offset.first, replacement_text);
-            count++;
-        }
+    // Parse the replacement pattern once for every match
+    PCREReplaceTextBuilder builder;
+    if (!builder.Compile(*spcre, replacement)) {
+        return std::make_tuple(text, count);
     }
 
+    // Build the new text front to back in a single buffer, copying the
+    // unchanged text between matches and appending each replacement.
+    QString new_text;
+    new_text.reserve(text.length() + matches.count() * replacement.length());
+    QStringView source(text);
+    int last_end = 0;
+    for (int i = 0; i < matches.count(); i++) {
+        new_text += source.sliced(last_end, matches.start(i) - last_end);
+        builder.AppendReplacementText(text, matches.groups(i), matches.group_count, new_text);
+        last_end = matches.end(i);
+        count++;
+    }
+    new_text += source.sliced(last_end);
+
     return std::make_tuple(new_text, count);
 }
 
@@ -204,7 +353,7 @@ std::tuple<QString, int> SearchOperations::PerformHTMLSpellCheckReplace(const QS
     QString new_text = text;
     int count = 0;
     int offset = 0;
-    SPCRE *spcre = PCRECache::instance()->getObject(search_regex);
+    QSharedPointer<SPCRE> spcre = PCRECache::instance()->getObject(search_regex);
     QList<HTMLSpellCheck::MisspelledWord> check_spelling = HTMLSpellCheck::GetMisspelledWords(text, 0, text.length(), search_regex);
     foreach(HTMLSpellCheck::MisspelledWord misspelled_word, check_spelling) {
         SPCRE::MatchInfo match_info = spcre->getFirstMatchInfo(misspelled_word.text);
@@ -223,6 +372,16 @@ std::tuple<QString, int> SearchOperations::PerformHTMLSpellCheckReplace(const QS
 }
 
 
+int SearchOperations::FileTotal(const QList<int> &counts)
+{
+    int total = 0;
+    foreach(int count, counts) {
+        total += count;
+    }
+    return total;
+}
+
+
 void SearchOperations::Accumulate(int &first, const int &second)
 {
     first += second;
@@ -24,15 +24,31 @@
 #ifndef SEARCHOPERATIONS_H
 #define SEARCHOPERATIONS_H
 
+#include <QtCore/QFuture>
+#include <QtCore/QList>
+#include <QtCore/QSet>
+#include <QtCore/QString>
+
+class QProgressDialog;
 class Resource;
 class TextResource;
 class HTMLResource;
+class LiteralPrefilter;
 
 class SearchOperations
 {
 
 public:
 
+    /**
+     * One search and replace of a batch run by ReplaceInAllFilesBatch.
+     */
+    struct ReplaceEntry {
+        QString search_regex;
+        QString replacement;
+        QList<Resource *> resources;
+    };
+
     /**
      * Returns the number of matching occurrences.
      *
@@ -44,14 +60,38 @@ public:
                             bool check_spelling = false);
 
 
+    /**
+     * Replaces every match in every resource.
+     *
+     * Files are searched and replaced in parallel but the new text
+     * is only set on each resource from the calling (GUI) thread.
+     *
+     * @return The number of replacements made.
+     */
     static int ReplaceInAllFIles(const QString &search_regex,
                                  const QString &replacement,
                                  QList<Resource *> resources);
 
+    /**
+     * Runs an ordered list of search and replaces over their files.
+     *
+     * The text of each file is read once, every entry that applies to
+     * that file is run over it in order, and the result is set once.
+     *
+     * @param entries The searches to run in order.
+     * @return The number of replacements made by each entry.
+     */
+    static QList<int> ReplaceInAllFilesBatch(const QList<ReplaceEntry> &entries);
+
 private:
 
-    static int CountInFile(const QString &search_regex,
-                           Resource *resource,
+    static QProgressDialog *CreateProgress(const QString &label, int maximum);
+
+    template <typename T>
+    static void WaitForFuture(QFuture<T> &future, QProgressDialog *progress);
+
+    static int CountInFile(Resource *resource,
+                           const QString &search_regex,
                            bool check_spelling);
 
 
@@ -63,17 +103,14 @@ private:
     static int CountInTextFile(const QString &search_regex,
                                TextResource *text_resource);
 
-    static int ReplaceInFile(const QString &search_regex,
-                             const QString &replacement,
-                             Resource *resource);
+    static std::tuple<QString, int, quint64> ReplaceInFile(Resource *resource,
+                                                           const QString &search_regex,
+                                                           const QString &replacement);
 
-    static int ReplaceHTMLInFile(const QString &search_regex,
-                                 const QString &replacement,
-                                 HTMLResource *html_resource);
-
-    static int ReplaceTextInFile(const QString &search_regex,
-                                 const QString &replacement,
-                                 TextResource *text_resource);
+    static std::tuple<QString, QList<int>, quint64> ReplaceBatchInFile(Resource *resource,
+                                                                       const QList<ReplaceEntry> &entries,
+                                                                       const QList<QSet<Resource *>> &entry_resources,
+                                                                       const LiteralPrefilter *prefilter);
 
     static std::tuple<QString, int> PerformGlobalReplace(const QString &text,
             const QString &search_regex,
@@ -83,6 +120,8 @@ private:
             const QString &search_regex,
             const QString &replacement);
 
+    static int FileTotal(const QList<int> &counts);
+
     static void Accumulate(int &first, const int &second);
 };
 
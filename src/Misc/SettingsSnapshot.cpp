@@ -0,0 +1,67 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <atomic>
+
+#include "Misc/SettingsStore.h"
+#include "Misc/SettingsSnapshot.h"
+
+SettingsSnapshot *SettingsSnapshot::instance()
+{
+    // Unlike the other singletons this one is asked for from worker
+    // threads, so it is made the thread safe way.  main makes it first
+    // so that it lives in the GUI thread.
+    static SettingsSnapshot *snapshot = new SettingsSnapshot();
+    return snapshot;
+}
+
+
+SettingsSnapshot::SettingsSnapshot()
+    : m_Values(Load())
+{
+}
+
+
+std::shared_ptr<const SettingsSnapshot::Values> SettingsSnapshot::Current() const
+{
+    return std::atomic_load(&m_Values);
+}
+
+
+void SettingsSnapshot::Reload()
+{
+    std::atomic_store(&m_Values, Load());
+    emit Changed();
+}
+
+
+std::shared_ptr<const SettingsSnapshot::Values> SettingsSnapshot::Load()
+{
+    SettingsStore ss;
+    std::shared_ptr<Values> values = std::make_shared<Values>();
+    values->preserve_entity_codenames = ss.preserveEntityCodeNames();
+    values->default_metadata_lang = ss.defaultMetadataLang().replace("_", "-");
+    values->spellcheck_numbers = ss.spellCheckNumbers();
+    values->highlight_open_close_tags = ss.highlightOpenCloseTags();
+    values->undo_memory_per_file = qint64(ss.undoMemoryPerFile()) * 1024 * 1024;
+    values->undo_memory_total = qint64(ss.undoMemoryTotal()) * 1024 * 1024;
+    return values;
+}
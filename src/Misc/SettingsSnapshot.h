@@ -0,0 +1,80 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef SETTINGSSNAPSHOT_H
+#define SETTINGSSNAPSHOT_H
+
+#include <memory>
+#include <utility>
+
+#include <QtCore/QList>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+
+/**
+ * The settings read on hot paths, loaded from the SettingsStore once
+ * and again each time the Preferences are saved.
+ *
+ * Current() can be called from any thread without a lock.  A caller
+ * keeps the values it was handed even if they are reloaded meanwhile.
+ * Settings here must only be changed through the Preferences.
+ */
+class SettingsSnapshot : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    struct Values {
+        QList<std::pair<ushort, QString>> preserve_entity_codenames;
+        // with '-' in place of '_', the way the spellcheck wants it
+        QString default_metadata_lang;
+        bool spellcheck_numbers;
+        bool highlight_open_close_tags;
+        // in bytes, 0 for no limit
+        qint64 undo_memory_per_file;
+        qint64 undo_memory_total;
+    };
+
+    static SettingsSnapshot *instance();
+
+    std::shared_ptr<const Values> Current() const;
+
+    /**
+     * Reads the settings again and emits Changed.  GUI thread only.
+     */
+    void Reload();
+
+signals:
+
+    void Changed();
+
+private:
+
+    SettingsSnapshot();
+
+    static std::shared_ptr<const Values> Load();
+
+    std::shared_ptr<const Values> m_Values;
+};
+
+#endif // SETTINGSSNAPSHOT_H
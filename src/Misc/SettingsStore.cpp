@@ -82,6 +82,11 @@ static QString KEY_CSS_EPUB2_VALIDATION_SPEC = SETTINGS_GROUP + "/" + "css_epub2
 static QString KEY_CSS_EPUB3_VALIDATION_SPEC = SETTINGS_GROUP + "/" + "css_epub3_validation_spec";
 
 static QString KEY_TEMP_FOLDER = SETTINGS_GROUP + "/" + "temp_folder_path";
+static QString KEY_TEMP_FOLDER_MEMORY_BUDGET = SETTINGS_GROUP + "/" + "temp_folder_memory_budget";
+static QString KEY_TAB_HIBERNATE_LIMIT = SETTINGS_GROUP + "/" + "tab_hibernate_limit";
+static QString KEY_TAB_HIBERNATE_MINUTES = SETTINGS_GROUP + "/" + "tab_hibernate_minutes";
+static QString KEY_UNDO_MEMORY_PER_FILE = SETTINGS_GROUP + "/" + "undo_memory_per_file";
+static QString KEY_UNDO_MEMORY_TOTAL = SETTINGS_GROUP + "/" + "undo_memory_total";
 
 static QString KEY_APPEARANCE_PREFS_TAB_INDEX = SETTINGS_GROUP + "/" + "appearance_prefs_tab_index";
 static QString KEY_PREVIEW_FONT_FAMILY_STANDARD = SETTINGS_GROUP + "/" + "preview_font_family_standard";
@@ -111,6 +116,18 @@ static QString KEY_CODE_VIEW_XHTML_HTML_COMMENT_COLOR = SETTINGS_GROUP + "/" + "
 
 static QString KEY_CODE_VIEW_HIGHLIGHT_OPEN_CLOSE_TAGS = SETTINGS_GROUP + "/" + "code_view_highlight_open_close_tags";
 static QString KEY_SKIP_PRINT_PREVIEW = SETTINGS_GROUP + "/" + "skipprintpreview";
+static QString KEY_TEXT_MEMORY_BUDGET = SETTINGS_GROUP + "/" + "text_memory_budget";
+static QString KEY_DEFER_MEDIA_EXTRACTION = SETTINGS_GROUP + "/" + "defer_media_extraction";
+static QString KEY_EPUB_COMPRESSION = SETTINGS_GROUP + "/" + "epub_compression";
+static QString KEY_INCREMENTAL_SAVE = SETTINGS_GROUP + "/" + "incremental_save";
+static QString KEY_PLUGIN_WARM_HOST = SETTINGS_GROUP + "/" + "plugin_warm_host";
+static QString KEY_SUBSET_FONTS = SETTINGS_GROUP + "/" + "subset_fonts";
+static QString KEY_IMAGE_OPTIMIZATION = SETTINGS_GROUP + "/" + "image_optimization";
+static QString KEY_IMAGE_JPEG_QUALITY = SETTINGS_GROUP + "/" + "image_jpeg_quality";
+static QString KEY_IMAGE_MAX_PIXELS = SETTINGS_GROUP + "/" + "image_max_pixels";
+static QString KEY_PREVIEW_PREFETCH_BUDGET = SETTINGS_GROUP + "/" + "preview_prefetch_budget";
+static QString KEY_WEB_RENDERER_LIMIT = SETTINGS_GROUP + "/" + "web_renderer_limit";
+static QString KEY_WEB_CACHE_SIZE = SETTINGS_GROUP + "/" + "web_cache_size";
 
 // Dark Appearance
 static QString KEY_CV_DARK_CSS_COMMENT_COLOR = SETTINGS_GROUP + "/" + "cv_dark_css_comment_color";
@@ -408,6 +425,36 @@ QString SettingsStore::cssEpub3ValidationSpec()
     return value(KEY_CSS_EPUB3_VALIDATION_SPEC, "css30").toString();
 }
 
+int SettingsStore::tempFolderMemoryBudget()
+{
+    clearSettingsGroup();
+    return qMax(value(KEY_TEMP_FOLDER_MEMORY_BUDGET, 0).toInt(), 0);
+}
+
+int SettingsStore::tabHibernateLimit()
+{
+    clearSettingsGroup();
+    return qMax(value(KEY_TAB_HIBERNATE_LIMIT, 20).toInt(), 0);
+}
+
+int SettingsStore::tabHibernateMinutes()
+{
+    clearSettingsGroup();
+    return qMax(value(KEY_TAB_HIBERNATE_MINUTES, 60).toInt(), 0);
+}
+
+int SettingsStore::undoMemoryPerFile()
+{
+    clearSettingsGroup();
+    return qMax(value(KEY_UNDO_MEMORY_PER_FILE, 64).toInt(), 0);
+}
+
+int SettingsStore::undoMemoryTotal()
+{
+    clearSettingsGroup();
+    return qMax(value(KEY_UNDO_MEMORY_TOTAL, 256).toInt(), 0);
+}
+
 QString SettingsStore::tempFolderHome()
 {
     clearSettingsGroup();
@@ -532,6 +579,84 @@ bool SettingsStore::skipPrintPreview()
   return value(KEY_SKIP_PRINT_PREVIEW, false).toBool();
 }
 
+int SettingsStore::textMemoryBudget()
+{
+    clearSettingsGroup();
+    int budget = value(KEY_TEXT_MEMORY_BUDGET, 1024).toInt();
+    return (budget >= 0) ? budget : 1024;
+}
+
+bool SettingsStore::deferMediaExtraction()
+{
+    clearSettingsGroup();
+    return value(KEY_DEFER_MEDIA_EXTRACTION, true).toBool();
+}
+
+QString SettingsStore::epubCompression()
+{
+    clearSettingsGroup();
+    return value(KEY_EPUB_COMPRESSION, "balanced").toString();
+}
+
+bool SettingsStore::incrementalSave()
+{
+    clearSettingsGroup();
+    return value(KEY_INCREMENTAL_SAVE, false).toBool();
+}
+
+bool SettingsStore::pluginWarmHost()
+{
+    clearSettingsGroup();
+    return value(KEY_PLUGIN_WARM_HOST, false).toBool();
+}
+
+bool SettingsStore::subsetFonts()
+{
+    clearSettingsGroup();
+    return value(KEY_SUBSET_FONTS, false).toBool();
+}
+
+QString SettingsStore::imageOptimization()
+{
+    clearSettingsGroup();
+    return value(KEY_IMAGE_OPTIMIZATION, "none").toString();
+}
+
+int SettingsStore::imageJpegQuality()
+{
+    clearSettingsGroup();
+    int quality = value(KEY_IMAGE_JPEG_QUALITY, 85).toInt();
+    return qBound(1, quality, 100);
+}
+
+qint64 SettingsStore::imageMaxPixels()
+{
+    clearSettingsGroup();
+    qint64 pixels = value(KEY_IMAGE_MAX_PIXELS, 0).toLongLong();
+    return (pixels >= 0) ? pixels : 0;
+}
+
+int SettingsStore::previewPrefetchBudget()
+{
+    clearSettingsGroup();
+    int budget = value(KEY_PREVIEW_PREFETCH_BUDGET, 8).toInt();
+    return (budget >= 0) ? budget : 8;
+}
+
+int SettingsStore::webRendererLimit()
+{
+    clearSettingsGroup();
+    int limit = value(KEY_WEB_RENDERER_LIMIT, 2).toInt();
+    return (limit >= 0) ? limit : 2;
+}
+
+int SettingsStore::webCacheSize()
+{
+    clearSettingsGroup();
+    int megabytes = value(KEY_WEB_CACHE_SIZE, 32).toInt();
+    return (megabytes >= 0) ? megabytes : 32;
+}
+
 void SettingsStore::setDefaultMetadataLang(const QString &lang)
 {
     clearSettingsGroup();
@@ -774,6 +899,36 @@ void SettingsStore::setCssEpub3ValidationSpec(const QString &spec)
     setValue(KEY_CSS_EPUB3_VALIDATION_SPEC, spec);
 }
 
+void SettingsStore::setTempFolderMemoryBudget(int megabytes)
+{
+    clearSettingsGroup();
+    setValue(KEY_TEMP_FOLDER_MEMORY_BUDGET, qMax(megabytes, 0));
+}
+
+void SettingsStore::setTabHibernateLimit(int tabs)
+{
+    clearSettingsGroup();
+    setValue(KEY_TAB_HIBERNATE_LIMIT, qMax(tabs, 0));
+}
+
+void SettingsStore::setTabHibernateMinutes(int minutes)
+{
+    clearSettingsGroup();
+    setValue(KEY_TAB_HIBERNATE_MINUTES, qMax(minutes, 0));
+}
+
+void SettingsStore::setUndoMemoryPerFile(int megabytes)
+{
+    clearSettingsGroup();
+    setValue(KEY_UNDO_MEMORY_PER_FILE, qMax(megabytes, 0));
+}
+
+void SettingsStore::setUndoMemoryTotal(int megabytes)
+{
+    clearSettingsGroup();
+    setValue(KEY_UNDO_MEMORY_TOTAL, qMax(megabytes, 0));
+}
+
 void SettingsStore::setTempFolderHome(const QString &path)
 {
     clearSettingsGroup();
@@ -883,6 +1038,78 @@ void SettingsStore::setSkipPrintPreview(bool skip)
   return setValue(KEY_SKIP_PRINT_PREVIEW, skip);
 }
 
+void SettingsStore::setTextMemoryBudget(int megabytes)
+{
+    clearSettingsGroup();
+    setValue(KEY_TEXT_MEMORY_BUDGET, megabytes);
+}
+
+void SettingsStore::setDeferMediaExtraction(bool defer)
+{
+    clearSettingsGroup();
+    setValue(KEY_DEFER_MEDIA_EXTRACTION, defer);
+}
+
+void SettingsStore::setEpubCompression(const QString &profile)
+{
+    clearSettingsGroup();
+    setValue(KEY_EPUB_COMPRESSION, profile);
+}
+
+void SettingsStore::setIncrementalSave(bool incremental)
+{
+    clearSettingsGroup();
+    setValue(KEY_INCREMENTAL_SAVE, incremental);
+}
+
+void SettingsStore::setPluginWarmHost(bool warm)
+{
+    clearSettingsGroup();
+    setValue(KEY_PLUGIN_WARM_HOST, warm);
+}
+
+void SettingsStore::setSubsetFonts(bool subset)
+{
+    clearSettingsGroup();
+    setValue(KEY_SUBSET_FONTS, subset);
+}
+
+void SettingsStore::setImageOptimization(const QString &profile)
+{
+    clearSettingsGroup();
+    setValue(KEY_IMAGE_OPTIMIZATION, profile);
+}
+
+void SettingsStore::setImageJpegQuality(int quality)
+{
+    clearSettingsGroup();
+    setValue(KEY_IMAGE_JPEG_QUALITY, quality);
+}
+
+void SettingsStore::setImageMaxPixels(qint64 pixels)
+{
+    clearSettingsGroup();
+    setValue(KEY_IMAGE_MAX_PIXELS, pixels);
+}
+
+void SettingsStore::setPreviewPrefetchBudget(int megabytes)
+{
+    clearSettingsGroup();
+    setValue(KEY_PREVIEW_PREFETCH_BUDGET, megabytes);
+}
+
+void SettingsStore::setWebRendererLimit(int limit)
+{
+    clearSettingsGroup();
+    setValue(KEY_WEB_RENDERER_LIMIT, limit);
+}
+
+void SettingsStore::setWebCacheSize(int megabytes)
+{
+    clearSettingsGroup();
+    setValue(KEY_WEB_CACHE_SIZE, megabytes);
+}
+
 void SettingsStore::clearAppearanceSettings()
 {
     clearSettingsGroup();
@@ -121,6 +121,33 @@ public:
      * Get path to temp folder home
      */
     QString tempFolderHome();
+
+    /**
+     * Get how many MB a memory backed filesystem must have free for
+     * the temp folders of books to be made there, 0 if they never are
+     */
+    int tempFolderMemoryBudget();
+
+    /**
+     * Get how many tabs keep their editors, the least recently used
+     * beyond that are hibernated, 0 for no limit
+     */
+    int tabHibernateLimit();
+
+    /**
+     * Get after how many minutes unused a tab is hibernated, 0 for never
+     */
+    int tabHibernateMinutes();
+
+    /**
+     * Get how many MB of undo history one open file may keep, 0 for no limit
+     */
+    int undoMemoryPerFile();
+
+    /**
+     * Get how many MB of undo history all open files may keep together, 0 for no limit
+     */
+    int undoMemoryTotal();
     
     /**
      * Whether automatic Spellcheck is enabled or not
@@ -269,6 +296,84 @@ public:
 
     bool skipPrintPreview();
 
+    /**
+     * How many megabytes of book text to keep in memory before
+     * unchanged files are dropped and read back from disk when needed.
+     *  0 no limit
+     */
+    int textMemoryBudget();
+
+    /**
+     * Whether audio and video files are left in the epub when it is
+     * opened and only extracted in the background or when first used.
+     */
+    bool deferMediaExtraction();
+
+    /**
+     * The compression profile used to save epubs,
+     * one of ExportEPUB::CompressionProfiles().
+     */
+    QString epubCompression();
+
+    /**
+     * Whether a save after small edits only rewrites the end of the
+     * epub in place instead of writing all of it again.
+     */
+    bool incrementalSave();
+
+    /**
+     * Whether every plugin runs in the launcher kept warm between
+     * runs, not just those whose plugin.xml asks for it.
+     */
+    bool pluginWarmHost();
+
+    /**
+     * Whether the glyphs no text of the book uses are dropped from
+     * the TrueType fonts of the epub written on save.  The fonts in
+     * the book itself are never changed.
+     */
+    bool subsetFonts();
+
+    /**
+     * The image optimization profile used for the epub written on
+     * save, one of ExportEPUB::ImageOptimizationProfiles().  The
+     * images in the book itself are never changed.
+     */
+    QString imageOptimization();
+
+    /**
+     * The quality JPEGs are encoded again at by the "lossy"
+     * image optimization profile.
+     */
+    int imageJpegQuality();
+
+    /**
+     * The most pixels an image may have before the "lossy" image
+     * optimization profile scales it down, 0 for no limit.
+     */
+    qint64 imageMaxPixels();
+
+    /**
+     * How many megabytes of text the next chapter may have for
+     * Preview to load it ahead of time in a hidden page.
+     *  0 no prefetching
+     */
+    int previewPrefetchBudget();
+
+    /**
+     * The most renderer processes WebEngine may start for all of the
+     * web views together, read at startup.
+     *  0 no limit
+     */
+    int webRendererLimit();
+
+    /**
+     * How many megabytes each web profile may keep in its in memory
+     * http cache.
+     *  0 lets WebEngine choose
+     */
+    int webCacheSize();
+
 public slots:
 
     /**
@@ -349,6 +454,32 @@ public slots:
      */
     void setTempFolderHome(const QString &path);
 
+    /**
+     * Set how many MB a memory backed filesystem must have free for
+     * the temp folders of books to be made there, 0 to turn it off
+     */
+    void setTempFolderMemoryBudget(int megabytes);
+
+    /**
+     * Set how many tabs keep their editors, 0 for no limit
+     */
+    void setTabHibernateLimit(int tabs);
+
+    /**
+     * Set after how many minutes unused a tab is hibernated, 0 for never
+     */
+    void setTabHibernateMinutes(int minutes);
+
+    /**
+     * Set how many MB of undo history one open file may keep, 0 for no limit
+     */
+    void setUndoMemoryPerFile(int megabytes);
+
+    /**
+     * Set how many MB of undo history all open files may keep together, 0 for no limit
+     */
+    void setUndoMemoryTotal(int megabytes);
+
     /**
      * Set whether automatic Spellcheck is enabled
      *
@@ -437,6 +568,30 @@ public slots:
     
     void setSkipPrintPreview(bool skip);
 
+    void setTextMemoryBudget(int megabytes);
+
+    void setDeferMediaExtraction(bool defer);
+
+    void setEpubCompression(const QString &profile);
+
+    void setIncrementalSave(bool incremental);
+
+    void setPluginWarmHost(bool warm);
+
+    void setSubsetFonts(bool subset);
+
+    void setImageOptimization(const QString &profile);
+
+    void setImageJpegQuality(int quality);
+
+    void setImageMaxPixels(qint64 pixels);
+
+    void setPreviewPrefetchBudget(int megabytes);
+
+    void setWebRendererLimit(int limit);
+
+    void setWebCacheSize(int megabytes);
+
 private:
     /**
      * Ensures there is not an open settings group which will cause the settings
@@ -31,14 +31,17 @@
 #include <QUrl>
 #include <QApplication>
 #include <QMutex>
+#include <QRecursiveMutex>
 #include <QMutexLocker>
 #include <QStringEncoder>
 #include <QStringDecoder>
+#include <QtConcurrent/QtConcurrent>
 #include <QDebug>
 
 #include "Misc/SpellCheck.h"
 #include "Misc/HTMLSpellCheckML.h"
 #include "Misc/SettingsStore.h"
+#include "Misc/Trace.h"
 #include "Misc/Utility.h"
 #include "sigil_constants.h"
 
@@ -48,10 +51,16 @@
 # include <stdlib.h>
 #endif
 
+// The verdicts are simply dropped once there are this many
+static const int MAX_VERDICTS = 100000;
+
 SpellCheck *SpellCheck::m_instance = 0;
 
 SpellCheck *SpellCheck::instance()
 {
+    // the background spell check and batch mode call this off the GUI thread
+    static QMutex instance_mutex;
+    QMutexLocker locker(&instance_mutex);
     if (m_instance == 0) {
         m_instance = new SpellCheck();
     }
@@ -60,13 +69,23 @@ SpellCheck *SpellCheck::instance()
 }
 
 SpellCheck::SpellCheck()
+    :
+    m_generation(0),
+    m_primaryLoaded(false),
+    m_loadSerial(0),
+    m_suggestRequest(0),
+    m_suggestGeneration(0)
 {
     DBG qDebug() << "In SpellCheck Constructor";
+    m_suggestPool.setMaxThreadCount(1);
     m_primary.handle = NULL;
     m_secondary.handle = NULL;
 
     // There is a considerable lag involved in loading the Spellcheck dictionaries
-    QApplication::setOverrideCursor(Qt::WaitCursor);
+    bool show_busy = Utility::IsGUIThread();
+    if (show_busy) {
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+    }
     loadDictionaryNames();
     // Create the user dictionary word list directiory if necessary.
     const QString user_directory = userDictionaryDirectory();
@@ -85,23 +104,42 @@ SpellCheck::SpellCheck()
         }
     }
 
-    QApplication::restoreOverrideCursor();
+    if (show_busy) {
+        QApplication::restoreOverrideCursor();
+    }
 
     UpdateLangCodeToDictMapping();
 
-    // Load the dictionary the user has selected
-    // now open primary and secondary dictionaries
+    // The primary and secondary dictionaries are only opened
+    // by the first spell check that needs them
+}
+
+
+void SpellCheck::loadPrimaryDictionaries()
+{
+    QMutexLocker locker(&mutex);
+    if (m_primaryLoaded) {
+        return;
+    }
+    m_primaryLoaded = true;
+    TRACE_SPAN(span, "SpellCheck::loadPrimaryDictionaries");
     SettingsStore settings;
-    loadDictionary(settings.dictionary());
-    if (!settings.secondary_dictionary().isEmpty()) {
-        loadDictionary(settings.secondary_dictionary());
+    if (!m_opendicts.contains(settings.dictionary())) {
+        loadDictionary(settings.dictionary());
+    }
+    QString secondary = settings.secondary_dictionary();
+    if (!secondary.isEmpty() && !m_opendicts.contains(secondary)) {
+        loadDictionary(secondary);
     }
 }
 
 void SpellCheck::UpdateLangCodeToDictMapping()
 {
     DBG qDebug() << "In UpdateLangCodeToDictMapping";
+    QMutexLocker locker(&mutex);
     m_langcode2dict.clear();
+    m_mlverdicts.clear();
+    m_generation.fetchAndAddOrdered(1);
 
     // create language code to dictionary name mapping
     foreach(QString dname, m_dictionaries.keys()) {
@@ -134,6 +172,9 @@ void SpellCheck::UnloadDictionary(const QString &dname)
 {
     DBG qDebug() << "In UnloadDictionary";
     QMutexLocker locker(&mutex);
+    if (m_loading.contains(dname)) {
+        DiscardPreloaded(dname);
+    }
     if (m_opendicts.contains(dname)) {
         HDictionary hdic = m_opendicts[dname];
         if (hdic.handle) {
@@ -142,12 +183,18 @@ void SpellCheck::UnloadDictionary(const QString &dname)
             delete hdic.handle;
         }
         m_opendicts.remove(dname);
+        m_addedWords.remove(dname);
+        clearVerdicts();
     }
 }
 
 void SpellCheck::UnloadAllDictionaries()
 {
     DBG qDebug() << "In UnloadAllDictionaries";
+    QMutexLocker locker(&mutex);
+    foreach(QString name, m_loading.keys()) {
+        DiscardPreloaded(name);
+    }
     foreach(QString name, m_opendicts.keys()) {
         UnloadDictionary(name);
     }
@@ -156,6 +203,13 @@ void SpellCheck::UnloadAllDictionaries()
 SpellCheck::~SpellCheck()
 {
     DBG qDebug() << "In SpellCheck destructor";
+    m_suggestPool.waitForDone();
+    foreach(HDictionary hdic, m_suggesters) {
+        delete hdic.encoder;
+        delete hdic.decoder;
+        delete hdic.handle;
+    }
+    m_suggesters.clear();
     UnloadAllDictionaries();
 
     if (m_instance) {
@@ -194,98 +248,296 @@ QString SpellCheck::currentPrimaryDictionary() const
 bool SpellCheck::spell(const QString &word)
 {
     DBG qDebug() << "In spell";
-    QString dname = m_langcode2dict.value(HTMLSpellCheckML::langOf(word), "");
+    return spellAll(QStringList() << word).value(word, true);
+}
 
-    // if no dictionary exists for this language treat it as correct
-    if (dname.isEmpty()) return true;
 
-    // if a dictionary exists but is not open yet, open it first
-    if (!m_opendicts.contains(dname)) {
-        loadDictionary(dname);
+QHash<QString, bool> SpellCheck::spellAll(const QStringList &words)
+{
+    DBG qDebug() << "In spellAll";
+    QMutexLocker locker(&mutex);
+    QHash<QString, bool> results;
+    QString default_lang;
+
+    // words that still need hunspell, grouped by dictionary
+    QHash<QString, QStringList> pending;
+    foreach(const QString &word, words) {
+        if (results.contains(word)) continue;
+        QHash<QString, bool>::const_iterator it = m_mlverdicts.constFind(word);
+        if (it != m_mlverdicts.constEnd()) {
+            results.insert(word, it.value());
+            continue;
+        }
+        QString lang;
+        int p = word.indexOf(":");
+        if (p != -1) {
+            lang = word.mid(0, p);
+        } else {
+            if (default_lang.isEmpty()) default_lang = HTMLSpellCheckML::langOf(word);
+            lang = default_lang;
+        }
+        QString dname = m_langcode2dict.value(lang, "");
+
+        // if no dictionary exists for this language treat it as correct
+        // and if a dictionary exists but is not open yet, open it first
+        if (!dname.isEmpty() && !m_opendicts.contains(dname)) {
+            loadDictionary(dname);
+        }
+        if (dname.isEmpty() || !m_opendicts.contains(dname)) {
+            results.insert(word, true);
+            continue;
+        }
+        results.insert(word, false);
+        pending[dname].append(word);
     }
-    if (!m_opendicts.contains(dname)) return true;
-    HDictionary hdic = m_opendicts[dname];
-    Q_ASSERT(hdic.encoder != nullptr);
-    Q_ASSERT(hdic.decoder != nullptr);
-    Q_ASSERT(hdic.handle != nullptr);
-    QByteArray ba = hdic.encoder->encode(Utility::getSpellingSafeText(HTMLSpellCheckML::textOf(word)));
-    bool res = hdic.handle->spell(ba.constData()) != 0;    
-    // bool res = hdic.handle->spell(hdic.encoder->fromUnicode(Utility::getSpellingSafeText(HTMLSpellCheckML::textOf(word))).constData()) != 0;
-    res = res || isIgnored(HTMLSpellCheckML::textOf(word));
-    return res;
+
+    foreach(QString dname, pending.keys()) {
+        HDictionary hdic = m_opendicts[dname];
+        Q_ASSERT(hdic.encoder != nullptr);
+        Q_ASSERT(hdic.handle != nullptr);
+        foreach(const QString &word, pending.value(dname)) {
+            QString text = HTMLSpellCheckML::textOf(word);
+            QByteArray ba = hdic.encoder->encode(Utility::getSpellingSafeText(text));
+            bool res = (hdic.handle->spell(ba.constData()) != 0) || m_ignoredWords.contains(text);
+            results.insert(word, res);
+            if (m_mlverdicts.size() >= MAX_VERDICTS) {
+                m_mlverdicts.clear();
+            }
+            m_mlverdicts.insert(word, res);
+        }
+    }
+    return results;
 }
 
 
 // Speed here is very important as it is invoked by the XHTMLHighlighter2 code
-// and this is the limiting factor
+// and this is the limiting factor, so every verdict is kept until the
+// dictionaries change
 // spell check word without langcode info in Primary and Secondary Dictionaries
 bool SpellCheck::spellPS(const QString &word)
 {
+    QMutexLocker locker(&mutex);
+    loadPrimaryDictionaries();
     if (!m_primary.handle) return true;
     if(m_ignoredWords.contains(word)) return true;
-    QByteArray pba = m_primary.encoder->encode(Utility::getSpellingSafeText(word));
+    QHash<QString, bool>::const_iterator it = m_verdicts.constFind(word);
+    if (it != m_verdicts.constEnd()) return it.value();
+    QString safe_word = Utility::getSpellingSafeText(word);
+    QByteArray pba = m_primary.encoder->encode(safe_word);
     bool res = m_primary.handle->spell(pba.constData()) !=0;
-    if (res) return true;
-    if (!m_secondary.handle) return false;
-    QByteArray sba = m_secondary.encoder->encode(Utility::getSpellingSafeText(word));
-    return m_secondary.handle->spell(sba.constData()) != 0;
+    if (!res && m_secondary.handle) {
+        QByteArray sba = m_secondary.encoder->encode(safe_word);
+        res = m_secondary.handle->spell(sba.constData()) != 0;
+    }
+    if (m_verdicts.size() >= MAX_VERDICTS) {
+        m_verdicts.clear();
+    }
+    m_verdicts.insert(word, res);
+    return res;
 }
 
 
-QStringList SpellCheck::suggest(const QString &word)
+bool SpellCheck::cachedSpellPS(const QString &word, bool &correct)
 {
-    DBG qDebug() << "In suggest";
-    QStringList suggestions;
-    char **suggestedWords;
-    QString dname = m_langcode2dict.value(HTMLSpellCheckML::langOf(word), "");
-    if (dname.isEmpty()) return suggestions;
-    if (!m_opendicts.contains(dname)) return suggestions;
-    HDictionary hdic = m_opendicts[dname];
-    Q_ASSERT(hdic.encoder != nullptr);
-    Q_ASSERT(hdic.decoder != nullptr);
-    Q_ASSERT(hdic.handle != nullptr);
-    QByteArray wba = hdic.encoder->encode(Utility::getSpellingSafeText(HTMLSpellCheckML::textOf(word)));
-    int count = hdic.handle->suggest(&suggestedWords, wba.constData());
-    bool possible_end_of_sentence = word.endsWith('.') && (word.count(".") == 1);
-    for (int i = 0; i < count; ++i) {
-        QString suggested_word = hdic.decoder->decode(suggestedWords[i]);
-        if (possible_end_of_sentence && !suggested_word.endsWith('.')) suggestions << suggested_word + ".";
-        suggestions << suggested_word;
+    QMutexLocker locker(&mutex);
+    loadPrimaryDictionaries();
+    if (!m_primary.handle || m_ignoredWords.contains(word)) {
+        correct = true;
+        return true;
+    }
+    QHash<QString, bool>::const_iterator it = m_verdicts.constFind(word);
+    if (it == m_verdicts.constEnd()) return false;
+    correct = it.value();
+    return true;
+}
+
+
+QHash<QString, bool> SpellCheck::spellPSAll(const QStringList &words)
+{
+    QMutexLocker locker(&mutex);
+    QHash<QString, bool> results;
+    foreach(const QString &word, words) {
+        if (!results.contains(word)) {
+            results.insert(word, spellPS(word));
+        }
     }
+    return results;
+}
 
-    hdic.handle->free_list(&suggestedWords, count);
-    return suggestions;
+
+void SpellCheck::clearVerdicts()
+{
+    QMutexLocker locker(&mutex);
+    m_verdicts.clear();
+    m_mlverdicts.clear();
+    m_generation.fetchAndAddOrdered(1);
+}
+
+
+quint64 SpellCheck::generation() const
+{
+    return m_generation.loadAcquire();
+}
+
+
+QStringList SpellCheck::suggest(const QString &word)
+{
+    DBG qDebug() << "In suggest";
+    return StartSuggestions(word, false, false).result();
 }
 
 
 // suggesttions for word without langcode using Primary and Secondary Dictionaries
 QStringList SpellCheck::suggestPS(const QString &word)
+{
+    return StartSuggestions(word, true, false).result();
+}
+
+
+QFuture<QStringList> SpellCheck::suggestAsync(const QString &word)
+{
+    return StartSuggestions(word, false);
+}
+
+
+QFuture<QStringList> SpellCheck::suggestPSAsync(const QString &word)
+{
+    return StartSuggestions(word, true);
+}
+
+
+bool SpellCheck::cachedSuggestions(const QString &word, bool primary_secondary, QStringList &suggestions)
+{
+    QString key = (primary_secondary ? "PS:" : "") + word;
+    QMutexLocker locker(&m_suggestMutex);
+    if ((m_suggestGeneration != generation()) || !m_suggestions.contains(key)) {
+        return false;
+    }
+    suggestions = m_suggestions.value(key);
+    return true;
+}
+
+
+// Requests that can not be dropped are made with a request number of 0
+QFuture<QStringList> SpellCheck::StartSuggestions(const QString &word, bool primary_secondary, bool droppable)
+{
+    quint64 request = 0;
+    if (droppable) {
+        request = m_suggestRequest.fetchAndAddOrdered(1) + 1;
+    }
+    return QtConcurrent::run(&m_suggestPool, &SpellCheck::FindSuggestions, this, word, primary_secondary, request);
+}
+
+
+// Runs on the suggestion thread.
+QStringList SpellCheck::FindSuggestions(const QString &word, bool primary_secondary, quint64 request)
 {
     QStringList suggestions;
-    char **suggestedWords;
-    char **suggestedWords2;
-    if (!m_primary.handle) return suggestions;
+    if (cachedSuggestions(word, primary_secondary, suggestions)) {
+        return suggestions;
+    }
+    // a newer request has been made while this one waited
+    if ((request != 0) && (request != m_suggestRequest.loadAcquire())) {
+        return suggestions;
+    }
+
+    // Take what is needed from the open dictionaries and let go of the
+    // mutex before the slow part so spell checks can go on meanwhile
+    struct Source {
+        HDictionary dictionary;
+        QString affpath;
+        QString dicpath;
+        QStringList added_words;
+        int limit;
+    };
+    QList<Source> sources;
+    quint64 dictionaries_generation;
+    QStringList open_dictionaries;
+    {
+        QMutexLocker locker(&mutex);
+        QList<std::pair<HDictionary, int>> used;
+        if (primary_secondary) {
+            loadPrimaryDictionaries();
+            used << std::make_pair(m_primary, 4) << std::make_pair(m_secondary, 4);
+        } else {
+            QString dname = m_langcode2dict.value(HTMLSpellCheckML::langOf(word), "");
+            if (m_opendicts.contains(dname)) {
+                used << std::make_pair(m_opendicts.value(dname), -1);
+            }
+        }
+        for (const std::pair<HDictionary, int> &use : used) {
+            if (!use.first.handle || !m_opendicts.contains(use.first.name)) continue;
+            Source source;
+            source.dictionary = m_opendicts.value(use.first.name);
+            source.affpath = QString("%1%2.aff").arg(m_dictionaries.value(use.first.name)).arg(use.first.name);
+            source.dicpath = QString("%1%2.dic").arg(m_dictionaries.value(use.first.name)).arg(use.first.name);
+            source.added_words = m_addedWords.value(use.first.name);
+            source.limit = use.second;
+            sources << source;
+        }
+        dictionaries_generation = generation();
+        open_dictionaries = m_opendicts.keys();
+    }
+
+    // let go of the suggesters of dictionaries that have been closed
+    foreach(QString dname, m_suggesters.keys()) {
+        if (!open_dictionaries.contains(dname)) {
+            HDictionary suggester = m_suggesters.take(dname);
+            delete suggester.encoder;
+            delete suggester.decoder;
+            delete suggester.handle;
+            m_suggesterWords.remove(dname);
+        }
+    }
+
+    QString text = primary_secondary ? word : HTMLSpellCheckML::textOf(word);
     bool possible_end_of_sentence = word.endsWith('.') && (word.count(".") == 1);
-    QByteArray pba = m_primary.encoder->encode(Utility::getSpellingSafeText(word));
-    int count = m_primary.handle->suggest(&suggestedWords, pba.constData());
-    int limit = count;
-    if (limit > 4) limit = 4;
-    for (int i = 0; i < limit; ++i) {
-        QString suggested_word = m_primary.decoder->decode(suggestedWords[i]);
-        if (possible_end_of_sentence && !suggested_word.endsWith('.')) suggested_word.append('.');
-        suggestions << suggested_word;
-    }
-    if (!m_secondary.handle) return suggestions;
-    QByteArray sba = m_secondary.encoder->encode(Utility::getSpellingSafeText(word));
-    count = m_secondary.handle->suggest(&suggestedWords2, sba.constData());
-    limit = count;
-    if (limit > 4) limit = 4;
-    for (int i = 0; i < limit; ++i) {
-        QString suggested_word = m_secondary.decoder->decode(suggestedWords2[i]);
-        if (possible_end_of_sentence && !suggested_word.endsWith('.')) suggested_word.append('.');
-        suggestions << suggested_word;
-    }
-    m_secondary.handle->free_list(&suggestedWords2, count);
+    foreach(const Source &source, sources) {
+        QString dname = source.dictionary.name;
+        HDictionary suggester = m_suggesters.value(dname);
+        if (suggester.serial != source.dictionary.serial) {
+            // the dictionary has been opened again since
+            delete suggester.encoder;
+            delete suggester.decoder;
+            delete suggester.handle;
+            suggester = OpenDictionary(dname, source.affpath, source.dicpath);
+            suggester.serial = source.dictionary.serial;
+            m_suggesters[dname] = suggester;
+            m_suggesterWords[dname] = 0;
+        }
+        if (!suggester.handle) continue;
+        for (int i = m_suggesterWords.value(dname); i < source.added_words.count(); i++) {
+            QByteArray ba = suggester.encoder->encode(Utility::getSpellingSafeText(HTMLSpellCheckML::textOf(source.added_words.at(i))));
+            suggester.handle->add(ba.constData());
+        }
+        m_suggesterWords[dname] = source.added_words.count();
+
+        char **suggestedWords;
+        QByteArray wba = suggester.encoder->encode(Utility::getSpellingSafeText(text));
+        int count = suggester.handle->suggest(&suggestedWords, wba.constData());
+        int limit = count;
+        if ((source.limit >= 0) && (limit > source.limit)) limit = source.limit;
+        for (int i = 0; i < limit; ++i) {
+            QString suggested_word = suggester.decoder->decode(suggestedWords[i]);
+            if (primary_secondary) {
+                if (possible_end_of_sentence && !suggested_word.endsWith('.')) suggested_word.append('.');
+            } else if (possible_end_of_sentence && !suggested_word.endsWith('.')) {
+                suggestions << suggested_word + ".";
+            }
+            suggestions << suggested_word;
+        }
+        suggester.handle->free_list(&suggestedWords, count);
+    }
+
+    QMutexLocker locker(&m_suggestMutex);
+    if (m_suggestGeneration != dictionaries_generation) {
+        m_suggestions.clear();
+        m_suggestGeneration = dictionaries_generation;
+    }
+    if (m_suggestions.size() >= MAX_VERDICTS) {
+        m_suggestions.clear();
+    }
+    m_suggestions.insert((primary_secondary ? "PS:" : "") + word, suggestions);
     return suggestions;
 }
 
@@ -293,19 +545,26 @@ QStringList SpellCheck::suggestPS(const QString &word)
 void SpellCheck::clearIgnoredWords()
 {
     DBG qDebug() << "In clearIgnoredWords";
+    QMutexLocker locker(&mutex);
     m_ignoredWords.clear();
+    m_mlverdicts.clear();
+    m_generation.fetchAndAddOrdered(1);
 }
 
 
 void SpellCheck::ignoreWord(const QString &word)
 {
     DBG qDebug() << "In ignoreWord";
+    QMutexLocker locker(&mutex);
     m_ignoredWords.insert(word);
+    m_mlverdicts.clear();
+    m_generation.fetchAndAddOrdered(1);
 }
 
 
 bool SpellCheck::isIgnored(const QString &word) {
     DBG qDebug() << "In isIgnored";
+    QMutexLocker locker(&mutex);
     return m_ignoredWords.contains(word);
 }
 
@@ -314,10 +573,13 @@ void SpellCheck::addWordToDictionary(const QString &word, const QString &dname)
 {
     DBG qDebug() << "In addWordToDictionary";
     if (dname.isEmpty()) return;
+    QMutexLocker locker(&mutex);
     if (m_opendicts.contains(dname)) {
         HDictionary hdic = m_opendicts[dname];
         QByteArray ba = hdic.encoder->encode(Utility::getSpellingSafeText(HTMLSpellCheckML::textOf(word)));
         hdic.handle->add(ba.constData());
+        m_addedWords[dname].append(word);
+        clearVerdicts();
     }
 }
 
@@ -340,30 +602,19 @@ void SpellCheck::loadDictionary(const QString &dname)
     // qDebug() << dic_delta;
     // qDebug() << alt_dic_delta;
 
-    // Create a new hunspell object.
+    // Use the Hunspell object preloadDictionaries started on, if any,
+    // otherwise create a new one.
     HDictionary hdic;
-    hdic.name = dname;
-    hdic.handle = new Hunspell(aff.toLocal8Bit().constData(), dic.toLocal8Bit().constData());
+    if (m_loading.contains(dname)) {
+        hdic = m_loading.take(dname).result();
+    } else {
+        hdic = OpenDictionary(dname, aff, dic);
+    }
     if (!hdic.handle) {
         qDebug() << "failed to load new Hunspell dictionary " << dname;
         return;
     }
-
-    // Get the encoding for the text in the dictionary.
-    QByteArray codecName(hdic.handle->get_dic_encoding());
-    if (codecName.startsWith("microsoft-cp125")) codecName.replace(0,sizeof("microsoft-cp") - 1 , "Windows-");
-    hdic.encoder = new QStringEncoder(codecName.data());
-    hdic.decoder = new QStringDecoder(codecName.data());
-    if (!hdic.encoder->isValid()) {
-        qDebug() << "failed to load codec: " << codecName << " from " << dname;
-        delete hdic.encoder;
-        delete hdic.decoder;
-        hdic.encoder = new QStringEncoder("UTF-8");
-        hdic.decoder = new QStringDecoder("UTF-8");
-    }
-
-    // Get the extra wordchars used for tokenization
-    hdic.wordchars = hdic.decoder->decode(hdic.handle->get_wordchars());
+    hdic.serial = ++m_loadSerial;
 
     // register it as an open dictionary
     m_opendicts[dname] = hdic;
@@ -398,10 +649,83 @@ void SpellCheck::loadDictionary(const QString &dname)
     else if (dname == settings.secondary_dictionary()) {
         m_secondary = hdic;
     }
+    clearVerdicts();
     return;
 }
 
 
+// Only touches the new Hunspell object so it can run on any thread
+// without holding the mutex.
+SpellCheck::HDictionary SpellCheck::OpenDictionary(const QString &dname, const QString &aff, const QString &dic)
+{
+    TRACE_SPAN(span, "SpellCheck::OpenDictionary");
+    HDictionary hdic;
+    hdic.name = dname;
+    hdic.handle = new Hunspell(aff.toLocal8Bit().constData(), dic.toLocal8Bit().constData());
+    if (!hdic.handle) {
+        return hdic;
+    }
+
+    // Get the encoding for the text in the dictionary.
+    QByteArray codecName(hdic.handle->get_dic_encoding());
+    if (codecName.startsWith("microsoft-cp125")) codecName.replace(0,sizeof("microsoft-cp") - 1 , "Windows-");
+    hdic.encoder = new QStringEncoder(codecName.data());
+    hdic.decoder = new QStringDecoder(codecName.data());
+    if (!hdic.encoder->isValid()) {
+        qDebug() << "failed to load codec: " << codecName << " from " << dname;
+        delete hdic.encoder;
+        delete hdic.decoder;
+        hdic.encoder = new QStringEncoder("UTF-8");
+        hdic.decoder = new QStringDecoder("UTF-8");
+    }
+
+    // Get the extra wordchars used for tokenization
+    hdic.wordchars = hdic.decoder->decode(hdic.handle->get_wordchars());
+    return hdic;
+}
+
+
+void SpellCheck::preloadDictionaries(const QStringList &langcodes)
+{
+    DBG qDebug() << "In preloadDictionaries" << langcodes;
+    QMutexLocker locker(&mutex);
+    SettingsStore settings;
+    QStringList dnames;
+    if (!m_primaryLoaded) {
+        dnames << settings.dictionary() << settings.secondary_dictionary();
+    }
+    foreach(QString lc, langcodes) {
+        lc.replace("_","-");
+        QString dname = m_langcode2dict.value(lc, "");
+        if (dname.isEmpty() && (lc.length() > 3)) {
+            dname = m_langcode2dict.value(lc.mid(0,2), "");
+        }
+        dnames << dname;
+    }
+
+    // Each dictionary gets a Hunspell object of its own so they
+    // are all parsed at the same time
+    foreach(QString dname, dnames) {
+        if (dname.isEmpty() || !m_dictionaries.contains(dname) ||
+            m_opendicts.contains(dname) || m_loading.contains(dname)) {
+            continue;
+        }
+        QString aff = QString("%1%2.aff").arg(m_dictionaries.value(dname)).arg(dname);
+        QString dic = QString("%1%2.dic").arg(m_dictionaries.value(dname)).arg(dname);
+        m_loading[dname] = QtConcurrent::run(OpenDictionary, dname, aff, dic);
+    }
+}
+
+
+void SpellCheck::DiscardPreloaded(const QString &dname)
+{
+    HDictionary hdic = m_loading.take(dname).result();
+    delete hdic.encoder;
+    delete hdic.decoder;
+    delete hdic.handle;
+}
+
+
 void SpellCheck::setDictionary(const QString &dname, bool forceReplace)
 {
     DBG qDebug() << "In setDictionary " << dname;
@@ -427,6 +751,7 @@ QString SpellCheck::getWordChars(const QString &lang)
 
     if (dname.isEmpty()) return "";
 
+    QMutexLocker locker(&mutex);
     // if a dictionary exists but is not open yet, open it first
     if (!m_opendicts.contains(dname)) {
         loadDictionary(dname);
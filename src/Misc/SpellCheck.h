@@ -27,7 +27,11 @@
 #include <QHash>
 #include <QString>
 #include <QStringList>
+#include <QRecursiveMutex>
+#include <QAtomicInteger>
+#include <QFuture>
 #include <QMutex>
+#include <QThreadPool>
 
 class Hunspell;
 class QStringEncoder;
@@ -45,6 +49,8 @@ public:
         QStringEncoder* encoder = nullptr;
         QStringDecoder* decoder = nullptr;;
         QString    wordchars;
+        // tells apart successive loads of the same dictionary
+        quint64    serial = 0;
     };
 
     static SpellCheck *instance();
@@ -62,12 +68,64 @@ public:
     bool spellPS(const QString &word);
     QStringList suggestPS(const QString &word);
 
+    /**
+     * Start finding suggestions on the suggestion thread, which has Hunspell
+     * objects of its own so that neither the caller nor spell checks on other
+     * threads wait for it.  Suggestions are kept per word until the
+     * dictionaries change.  A request that is still waiting when a newer one
+     * is made is dropped and finishes with no suggestions.
+     */
+    QFuture<QStringList> suggestAsync(const QString &word);
+    QFuture<QStringList> suggestPSAsync(const QString &word);
+
+    /**
+     * Looks up the suggestions an earlier request left behind.  Returns false
+     * if there are none for the current dictionaries.
+     */
+    bool cachedSuggestions(const QString &word, bool primary_secondary, QStringList &suggestions);
+
+    /**
+     * Looks up a verdict an earlier spellPS call left behind without
+     * touching Hunspell.  Returns false if the word has not been checked
+     * since the dictionaries or ignored words last changed.
+     */
+    bool cachedSpellPS(const QString &word, bool &correct);
+
+    /**
+     * Checks a whole list of words against the primary and secondary
+     * dictionaries under a single lock, sharing the verdicts spellPS
+     * keeps.  Returns the verdict of every distinct word.
+     */
+    QHash<QString, bool> spellPSAll(const QStringList &words);
+
+    /**
+     * The same for words carrying a language code, as checked by spell.
+     * The words are grouped by dictionary so each dictionary is looked up
+     * once and only for the words without a verdict since the dictionaries
+     * or the ignored words last changed.
+     */
+    QHash<QString, bool> spellAll(const QStringList &words);
+
+    /**
+     * Changes whenever a word could get a different verdict than
+     * before, so callers can tell when results they keep are stale.
+     */
+    quint64 generation() const;
+
     void clearIgnoredWords();
     void ignoreWord(const QString &word);
     bool isIgnored(const QString &word);
 
     QString getWordChars(const QString &lang="");
     void loadDictionary(const QString &dname);
+
+    /**
+     * Starts opening the primary and secondary dictionaries and those
+     * for the given language codes on worker threads, so a book in
+     * several languages does not wait for its dictionaries one after
+     * another.  The first spell check that needs one of them picks it up.
+     */
+    void preloadDictionaries(const QStringList &langcodes);
     void UnloadDictionary(const QString &dname);
     void UnloadAllDictionaries();
 
@@ -93,13 +151,44 @@ public:
 
 private:
     SpellCheck();
+    void clearVerdicts();
+    void loadPrimaryDictionaries();
+    static HDictionary OpenDictionary(const QString &dname, const QString &aff, const QString &dic);
+    QStringList FindSuggestions(const QString &word, bool primary_secondary, quint64 request);
+    QFuture<QStringList> StartSuggestions(const QString &word, bool primary_secondary, bool droppable = true);
+    void DiscardPreloaded(const QString &dname);
     QHash<QString, QString> m_dictionaries;
     QHash<QString, QString> m_langcode2dict;
-    mutable QMutex mutex;
+    // Hunspell is not thread safe, everything that uses a handle
+    // or the verdicts holds this
+    mutable QRecursiveMutex mutex;
     QHash<QString, struct HDictionary> m_opendicts;
+    // dictionaries preloadDictionaries is still opening
+    QHash<QString, QFuture<HDictionary>> m_loading;
+    quint64 m_loadSerial;
+    // every word added to each open dictionary, for the suggesters
+    QHash<QString, QStringList> m_addedWords;
+
+    // a single thread owns the suggesters, the Hunspell objects used
+    // only for suggestions, and how many added words each has been given
+    QThreadPool m_suggestPool;
+    QHash<QString, struct HDictionary> m_suggesters;
+    QHash<QString, int> m_suggesterWords;
+    QAtomicInteger<quint64> m_suggestRequest;
+    // the suggestions found for the dictionaries of m_suggestGeneration
+    QMutex m_suggestMutex;
+    QHash<QString, QStringList> m_suggestions;
+    quint64 m_suggestGeneration;
     QSet<QString> m_ignoredWords;
+    // spellPS results for the current dictionaries and ignored words
+    QHash<QString, bool> m_verdicts;
+    // spell results, keyed by the word with its language code
+    QHash<QString, bool> m_mlverdicts;
+    // bumped each time the verdicts are dropped
+    QAtomicInteger<quint64> m_generation;
     struct HDictionary m_primary;
     struct HDictionary m_secondary;
+    bool m_primaryLoaded;
     
     static SpellCheck *m_instance;
 };
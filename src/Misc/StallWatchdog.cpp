@@ -0,0 +1,325 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#if defined(Q_OS_WIN32) || defined(_WIN32)
+#include <windows.h>
+#else
+#include <errno.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+#endif
+#include <string.h>
+
+#include <algorithm>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+#include <QtCore/QTextStream>
+
+#include "Misc/StallWatchdog.h"
+#include "Misc/Trace.h"
+#include "Misc/Utility.h"
+#include "sigil_constants.h"
+
+static const int PING_INTERVAL_MS = 100;
+static const int DEFAULT_THRESHOLD_MS = 1000;
+
+// A stall that lasts minutes still gives a short report
+static const int MAX_SAMPLES = 300;
+static const int MAX_FRAMES = 48;
+static const int MAX_STACKS_REPORTED = 5;
+
+// How long to wait for the GUI thread to take its own sample
+static const int SAMPLE_TIMEOUT_MS = 50;
+
+#if !defined(_WIN32)
+
+// The GUI thread fills these in from the signal handler
+static const int SAMPLE_SIGNAL = SIGPROF;
+static void *s_Frames[MAX_FRAMES];
+static std::atomic<int> s_FrameCount(-1);
+
+static void SampleHandler(int)
+{
+    int saved_errno = errno;
+    s_FrameCount = backtrace(s_Frames, MAX_FRAMES);
+    errno = saved_errno;
+}
+
+#endif
+
+
+StallWatchdog::StallWatchdog(QObject *parent)
+    :
+    QThread(parent),
+    m_ThresholdMs(DEFAULT_THRESHOLD_MS),
+    m_ReportPath(Utility::GetEnvironmentVar("SIGIL_STALL_REPORT")),
+    m_Stopping(false),
+    m_PingPending(false),
+    m_PingSentAt(0),
+    m_GUIThread(0)
+{
+    int threshold = Utility::GetEnvironmentVar("SIGIL_STALL_THRESHOLD_MS").toInt();
+    if (threshold > 0) {
+        m_ThresholdMs = threshold;
+    }
+    m_Clock.start();
+
+    // The spans are kept so a stall can say which operation it is in
+    Trace::TrackActiveSpans();
+
+#if defined(_WIN32)
+    HANDLE thread = NULL;
+    DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &thread,
+                    THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION, FALSE, 0);
+    m_GUIThread = (quintptr) thread;
+#else
+    m_GUIThread = (quintptr) pthread_self();
+    // backtrace loads libgcc the first time it is used, which is
+    // not safe to do inside a signal handler
+    void *warm_up[1];
+    backtrace(warm_up, 1);
+    struct sigaction action;
+    action.sa_handler = SampleHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SAMPLE_SIGNAL, &action, NULL);
+#endif
+}
+
+
+StallWatchdog::~StallWatchdog()
+{
+    Stop();
+#if defined(_WIN32)
+    if (m_GUIThread) {
+        CloseHandle((HANDLE) m_GUIThread);
+    }
+#endif
+}
+
+
+bool StallWatchdog::IsEnabled()
+{
+    return !Utility::GetEnvironmentVar("SIGIL_STALL_REPORT").isEmpty();
+}
+
+
+void StallWatchdog::Stop()
+{
+    m_Stopping = true;
+    wait();
+}
+
+
+void StallWatchdog::run()
+{
+    bool stalled = false;
+    Stall stall;
+    while (!m_Stopping) {
+        if (!m_PingPending) {
+            if (stalled) {
+                WriteStall(stall, m_Clock.elapsed() - stall.started);
+                stalled = false;
+            }
+            m_PingPending = true;
+            m_PingSentAt = m_Clock.elapsed();
+            // the watchdog lives on the GUI thread so this runs there, and
+            // is dropped rather than run if the watchdog is deleted first
+            QMetaObject::invokeMethod(this, [this]() { Pong(); }, Qt::QueuedConnection);
+        }
+        msleep(PING_INTERVAL_MS);
+        if (!m_PingPending) {
+            continue;
+        }
+
+        qint64 blocked = m_Clock.elapsed() - m_PingSentAt;
+        if (blocked < m_ThresholdMs) {
+            continue;
+        }
+        if (!stalled) {
+            stalled = true;
+            stall.started = m_PingSentAt;
+            stall.spans.clear();
+            stall.sample_count = 0;
+            stall.stacks.clear();
+        }
+        // keep the deepest operation seen
+        QList<const char *> spans = Trace::ActiveSpans();
+        if (spans.count() > stall.spans.count()) {
+            stall.spans = spans;
+        }
+        if (stall.sample_count < MAX_SAMPLES) {
+            QStringList stack = SampleGUIStack();
+            if (!stack.isEmpty()) {
+                stall.stacks[stack]++;
+                stall.sample_count++;
+            }
+        }
+    }
+}
+
+
+void StallWatchdog::Pong()
+{
+    m_PingPending = false;
+}
+
+
+QStringList StallWatchdog::SampleGUIStack()
+{
+    QStringList frames;
+#if defined(_WIN32) && (defined(_M_X64) || defined(_M_ARM64))
+    HANDLE thread = (HANDLE) m_GUIThread;
+    if (!thread) {
+        return frames;
+    }
+    DWORD64 pcs[MAX_FRAMES];
+    int count = 0;
+
+    // Only walk the stack while the thread is suspended, naming
+    // the frames can wait until it is running again
+    if (SuspendThread(thread) == (DWORD) -1) {
+        return frames;
+    }
+    CONTEXT context;
+    memset(&context, 0, sizeof(context));
+    context.ContextFlags = CONTEXT_FULL;
+    if (GetThreadContext(thread, &context)) {
+        while (count < MAX_FRAMES) {
+#if defined(_M_X64)
+            DWORD64 pc = context.Rip;
+#else
+            DWORD64 pc = context.Pc;
+#endif
+            if (pc == 0) {
+                break;
+            }
+            pcs[count++] = pc;
+            DWORD64 image_base = 0;
+            PRUNTIME_FUNCTION function = RtlLookupFunctionEntry(pc, &image_base, NULL);
+            if (function) {
+                PVOID handler_data = NULL;
+                DWORD64 establisher_frame = 0;
+                RtlVirtualUnwind(UNW_FLAG_NHANDLER, image_base, pc, function, &context,
+                                 &handler_data, &establisher_frame, NULL);
+            } else {
+                // a leaf function, its return address is where the call left it
+#if defined(_M_X64)
+                context.Rip = *(DWORD64 *) context.Rsp;
+                context.Rsp += 8;
+#else
+                context.Pc = context.Lr;
+#endif
+            }
+#if defined(_M_ARM64)
+            if (context.Pc == pc) {
+                break;
+            }
+#endif
+        }
+    }
+    ResumeThread(thread);
+
+    for (int i = 0; i < count; ++i) {
+        HMODULE module = NULL;
+        wchar_t path[MAX_PATH];
+        QString frame = QString("0x%1").arg(pcs[i], 0, 16);
+        if (GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                               (LPCWSTR) pcs[i], &module) &&
+            GetModuleFileNameW(module, path, MAX_PATH)) {
+            QString name = QString::fromWCharArray(path);
+            name = name.mid(name.lastIndexOf('\\') + 1);
+            frame = QString("%1+0x%2").arg(name).arg(pcs[i] - (DWORD64) module, 0, 16);
+        }
+        frames << frame;
+    }
+#elif !defined(_WIN32)
+    s_FrameCount = -1;
+    if (pthread_kill((pthread_t) m_GUIThread, SAMPLE_SIGNAL) != 0) {
+        return frames;
+    }
+    QElapsedTimer waited;
+    waited.start();
+    while ((s_FrameCount < 0) && (waited.elapsed() < SAMPLE_TIMEOUT_MS)) {
+        usleep(1000);
+    }
+    int count = s_FrameCount;
+    if (count <= 0) {
+        return frames;
+    }
+    void *pcs[MAX_FRAMES];
+    memcpy(pcs, s_Frames, count * sizeof(void *));
+    char **symbols = backtrace_symbols(pcs, count);
+    if (!symbols) {
+        return frames;
+    }
+    // the first frames are the signal handler and the trampoline into it
+    for (int i = 2; i < count; ++i) {
+        QString frame = QString::fromLocal8Bit(symbols[i]);
+        frame = frame.mid(frame.lastIndexOf('/') + 1);
+        frames << frame;
+    }
+    free(symbols);
+#endif
+    return frames;
+}
+
+
+void StallWatchdog::WriteStall(const Stall &stall, qint64 duration)
+{
+    QFile file(m_ReportPath);
+    if (!file.open(QFile::WriteOnly | QFile::Append | QFile::Text)) {
+        return;
+    }
+    QTextStream out(&file);
+    out << "Sigil " << SIGIL_VERSION << " stalled for " << duration << " ms at "
+        << QDateTime::currentDateTime().toString(Qt::ISODate) << "\n";
+
+    QStringList spans;
+    foreach(const char *span, stall.spans) {
+        spans << QString::fromUtf8(span);
+    }
+    out << "  in: " << (spans.isEmpty() ? QString("no traced operation") : spans.join(" > ")) << "\n";
+
+    // the most frequent stacks are the ones where the time went
+    QList<QPair<int, QStringList>> stacks;
+    QHashIterator<QStringList, int> it(stall.stacks);
+    while (it.hasNext()) {
+        it.next();
+        stacks << qMakePair(it.value(), it.key());
+    }
+    std::sort(stacks.begin(), stacks.end(), [](const QPair<int, QStringList> &a, const QPair<int, QStringList> &b) {
+        return a.first > b.first;
+    });
+    out << "  " << stall.sample_count << " samples, " << stacks.count() << " distinct stacks\n";
+    for (int i = 0; i < stacks.count() && i < MAX_STACKS_REPORTED; ++i) {
+        out << "  " << stacks.at(i).first << " x\n";
+        foreach(const QString &frame, stacks.at(i).second) {
+            out << "    " << frame << "\n";
+        }
+    }
+    out << "\n";
+}
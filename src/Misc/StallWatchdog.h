@@ -0,0 +1,115 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef STALLWATCHDOG_H
+#define STALLWATCHDOG_H
+
+#include <atomic>
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QThread>
+
+/**
+ * Watches for the GUI event loop being blocked and reports what
+ * was running when it was.
+ *
+ * Set SIGIL_STALL_REPORT to the path of a text file and a thread
+ * posts a ping to the main event loop every 100 ms.  When a ping
+ * has gone unanswered for longer than SIGIL_STALL_THRESHOLD_MS
+ * (1000 ms if not set) the trace spans open on the GUI thread are
+ * noted and the stack of the GUI thread is sampled until the loop
+ * runs again.  The stall is then appended to the report with its
+ * length, the spans and its distinct stacks, most frequent first.
+ *
+ * Frames are shown as module and offset so a report from a release
+ * build can be symbolized with the matching debug symbols.
+ */
+class StallWatchdog : public QThread
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Must be created on the GUI thread, the one it watches.
+     */
+    StallWatchdog(QObject *parent = NULL);
+
+    ~StallWatchdog();
+
+    /**
+     * Returns true if SIGIL_STALL_REPORT is set.
+     */
+    static bool IsEnabled();
+
+    /**
+     * Stops the watching thread and waits for it to finish.
+     */
+    void Stop();
+
+protected:
+
+    void run();
+
+private:
+
+    struct Stall {
+        qint64 started;
+        QList<const char *> spans;
+        int sample_count;
+        QHash<QStringList, int> stacks;
+    };
+
+    /**
+     * Answers a ping, runs on the GUI thread.
+     */
+    void Pong();
+
+    /**
+     * Returns the frames of the GUI thread, innermost first.  Empty
+     * if the platform can not sample another thread.
+     */
+    QStringList SampleGUIStack();
+
+    void WriteStall(const Stall &stall, qint64 duration);
+
+    QElapsedTimer m_Clock;
+
+    int m_ThresholdMs;
+
+    QString m_ReportPath;
+
+    std::atomic<bool> m_Stopping;
+
+    std::atomic<bool> m_PingPending;
+
+    std::atomic<qint64> m_PingSentAt;
+
+    // The platform handle of the GUI thread
+    quintptr m_GUIThread;
+};
+
+#endif // STALLWATCHDOG_H
@@ -0,0 +1,78 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QMutex>
+#include <QThread>
+
+#include "Misc/TaskScheduler.h"
+
+static const int MAX_INTERACTIVE_THREADS = 2;
+
+static QMutex s_PoolsMutex;
+static QThreadPool *s_InteractivePool = NULL;
+static QThreadPool *s_BackgroundPool = NULL;
+
+
+QThreadPool *TaskScheduler::Pool(Lane lane)
+{
+    if (lane == BatchLane) {
+        return QThreadPool::globalInstance();
+    }
+    QMutexLocker locker(&s_PoolsMutex);
+    if (lane == InteractiveLane) {
+        if (!s_InteractivePool) {
+            s_InteractivePool = new QThreadPool();
+            s_InteractivePool->setMaxThreadCount(MAX_INTERACTIVE_THREADS);
+#if QT_VERSION >= QT_VERSION_CHECK(6,2,0)
+            s_InteractivePool->setThreadPriority(QThread::HighPriority);
+#endif
+        }
+        return s_InteractivePool;
+    }
+    if (!s_BackgroundPool) {
+        s_BackgroundPool = new QThreadPool();
+        // leave most of the cores to the other lanes
+        s_BackgroundPool->setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 4));
+#if QT_VERSION >= QT_VERSION_CHECK(6,2,0)
+        s_BackgroundPool->setThreadPriority(QThread::LowPriority);
+#endif
+    }
+    return s_BackgroundPool;
+}
+
+
+void TaskScheduler::WaitForDone()
+{
+    QThreadPool *interactive_pool;
+    QThreadPool *background_pool;
+    {
+        // the work waited for may queue more
+        QMutexLocker locker(&s_PoolsMutex);
+        interactive_pool = s_InteractivePool;
+        background_pool = s_BackgroundPool;
+    }
+    if (interactive_pool) {
+        interactive_pool->waitForDone();
+    }
+    if (background_pool) {
+        background_pool->waitForDone();
+    }
+}
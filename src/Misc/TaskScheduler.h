@@ -0,0 +1,89 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <utility>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
+
+/**
+ * Hands background work to one of three lanes so that long running
+ * jobs can not hold up the ones the user is waiting on.
+ *
+ * Each lane is a thread pool of its own.  The batch lane is the global
+ * pool, which every QtConcurrent call without a pool already uses.  The
+ * interactive lane keeps its own few threads so work the user is waiting
+ * on starts at once, and the background lane is limited to a share of
+ * the cores at a low priority.
+ *
+ * Run works just like QtConcurrent::run.  A function that takes a
+ * QPromise as its first argument can report progress through it and
+ * check isCanceled() to stop once the QFuture is cancelled, and a
+ * QFutureWatcher delivers the results and progress on the GUI thread.
+ */
+class TaskScheduler
+{
+public:
+    enum Lane {
+        /**
+         * Short work the user is waiting on to see something,
+         * like preparing a Preview page or reading a font.
+         */
+        InteractiveLane,
+
+        /**
+         * Work over the whole book started by the user,
+         * like loading, saving or updating links.
+         */
+        BatchLane,
+
+        /**
+         * Work nobody waits on, like prefetching, autosaving, extracting
+         * deferred files or removing temp folders.
+         */
+        BackgroundLane
+    };
+
+    /**
+     * Returns the thread pool of the lane.
+     */
+    static QThreadPool *Pool(Lane lane);
+
+    /**
+     * Runs function with args in a thread of the lane.
+     */
+    template <typename Function, typename... Args>
+    static auto Run(Lane lane, Function &&function, Args &&...args)
+    {
+        return QtConcurrent::run(Pool(lane), std::forward<Function>(function), std::forward<Args>(args)...);
+    }
+
+    /**
+     * Waits for the work queued on the interactive and background
+     * lanes, the global pool waits for its own on exit.
+     */
+    static void WaitForDone();
+};
+
+#endif // TASKSCHEDULER_H
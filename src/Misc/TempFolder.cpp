@@ -21,12 +21,14 @@
 *************************************************************************/
 
 #include <QDir>
+#include <QStorageInfo>
 #include <QtConcurrent>
 #include <QFuture>
 #include <QDebug>
 
 #include "Misc/TempFolder.h"
 #include "Misc/SettingsStore.h"
+#include "Misc/TaskScheduler.h"
 #include "Misc/Utility.h"
 
 TempFolder::TempFolder()
@@ -46,7 +48,7 @@ TempFolder::~TempFolder()
     // To be super safe here ...
     // only manually delete things if the temp directory is actually valid
     if (m_tempDir.isValid()) {
-        QFuture<bool> afuture = QtConcurrent::run(DeleteFolderAndFiles, m_tempDir.path());
+        QFuture<bool> afuture = TaskScheduler::Run(TaskScheduler::BackgroundLane, DeleteFolderAndFiles, m_tempDir.path());
     }
 }
 
@@ -71,8 +73,37 @@ QString TempFolder::GetPathToSigilScratchpad()
 }
 
 
+QString TempFolder::GetPathToMemoryScratchpad()
+{
+#if defined(Q_OS_LINUX)
+    static const QString MEMORY_FOLDER = "/dev/shm";
+    SettingsStore ss;
+    qint64 budget = ss.tempFolderMemoryBudget();
+    if (budget <= 0) {
+        return QString();
+    }
+    QStorageInfo storage(MEMORY_FOLDER);
+    if (!storage.isValid() || !storage.isReady() || storage.isReadOnly()) {
+        return QString();
+    }
+    // new temp folders go back to the disk once memory runs short,
+    // those already made stay where they are
+    if (storage.bytesAvailable() < budget * 1024 * 1024) {
+        return QString();
+    }
+    return MEMORY_FOLDER;
+#else
+    return QString();
+#endif
+}
+
+
 QString TempFolder::GetNewTempFolderTemplate()
 {
+    QString memory_path = GetPathToMemoryScratchpad();
+    if (!memory_path.isEmpty()) {
+        return memory_path + "/Sigil-XXXXXX";
+    }
     SettingsStore ss;
     QString temp_path = ss.tempFolderHome();
     if (temp_path == "<SIGIL_DEFAULT_TEMP_HOME>") {
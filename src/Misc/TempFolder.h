@@ -64,6 +64,15 @@ public:
      */
     static QString GetPathToSigilScratchpad();
 
+    /**
+     * Returns the memory backed folder new temp folders are made in
+     * when the user has given a budget for it and it has that much
+     * space free.  Only some platforms have one.
+     *
+     * @return Full path to the folder, empty if it is not to be used.
+     */
+    static QString GetPathToMemoryScratchpad();
+
 private:
 
     // We turn these of since TempFolder is an identity class.
@@ -0,0 +1,469 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QRegularExpression>
+#include <QXmlStreamReader>
+#include <QtConcurrent/QtConcurrent>
+#include <QSaveFile>
+#include <QDebug>
+
+#include "sigil_exception.h"
+#include "Misc/ThumbnailCache.h"
+#include "Misc/Utility.h"
+
+#if 0
+#define DBG if(1)
+#else
+#define DBG if(0)
+#endif
+
+// Thumbnails kept in memory, they are all dropped when there are more
+static const int MAX_MEMORY_THUMBNAILS = 1000;
+
+// Files kept on disk, the oldest are removed at the first use in
+// a session once there are more
+static const int MAX_CACHED_FILES = 20000;
+
+// Images with more pixels than this are read at PREVIEW_SIZE when
+// their format can be scaled while decoding
+static const qint64 LARGE_IMAGE_PIXELS = 16 * 1024 * 1024;
+static const int PREVIEW_SIZE = 2048;
+
+static const QString THUMBNAIL_FOLDER = "thumbnails";
+static const QString INFO_SUFFIX = ".info";
+
+// The content hashes the sizes are kept by are sha1 hex strings
+static const int SHA1_HEX_LENGTH = 40;
+
+QHash<QString, ThumbnailCache::Entry> ThumbnailCache::m_Entries;
+QHash<QString, QSize> ThumbnailCache::m_Sizes;
+int ThumbnailCache::m_ThumbnailCount = 0;
+bool ThumbnailCache::m_Pruned = false;
+QMutex ThumbnailCache::m_Mutex;
+
+
+std::pair<int, qint64> ThumbnailCache::MemoryUsage()
+{
+    QMutexLocker locker(&m_Mutex);
+    qint64 total = m_Sizes.count() * static_cast<qint64>(sizeof(QSize) + SHA1_HEX_LENGTH * sizeof(QChar));
+    foreach(const Entry &entry, m_Entries) {
+        total += sizeof(Entry) + entry.hash.capacity() * sizeof(QChar) + entry.info.thumbnail.sizeInBytes();
+    }
+    return std::make_pair(static_cast<int>(m_Entries.count()), total);
+}
+
+
+bool ThumbnailCache::Find(const QString &path, int thumbnail_size, Info &info)
+{
+    QFileInfo fi(path);
+    QMutexLocker locker(&m_Mutex);
+    QHash<QString, Entry>::const_iterator it = m_Entries.constFind(path);
+    if (it == m_Entries.constEnd() || !fi.exists() ||
+        it->size != fi.size() || it->modified != fi.lastModified() ||
+        it->thumbnail_size != thumbnail_size) {
+        return false;
+    }
+    info = it->info;
+    return true;
+}
+
+
+ThumbnailCache::Info ThumbnailCache::Get(const QString &path, int thumbnail_size)
+{
+    Info info;
+    if (Find(path, thumbnail_size, info)) {
+        return info;
+    }
+
+    QFileInfo fi(path);
+    QString hash;
+    bool prune = false;
+    {
+        QMutexLocker locker(&m_Mutex);
+        // an unchanged file whose thumbnail was asked for at another size,
+        // or dropped from memory, need not be hashed again
+        QHash<QString, Entry>::const_iterator it = m_Entries.constFind(path);
+        if (it != m_Entries.constEnd() && it->size == fi.size() && it->modified == fi.lastModified()) {
+            hash = it->hash;
+        }
+        if (!m_Pruned) {
+            m_Pruned = true;
+            prune = true;
+        }
+    }
+    if (prune) {
+        PruneCacheFolder();
+    }
+
+    QByteArray data;
+    if (hash.isEmpty()) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return info;
+        }
+        data = file.readAll();
+        hash = QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex());
+    }
+
+    if (!ReadCached(hash, thumbnail_size, info)) {
+        if (data.isEmpty()) {
+            QFile file(path);
+            if (file.open(QIODevice::ReadOnly)) {
+                data = file.readAll();
+            }
+        }
+        DBG qDebug() << "ThumbnailCache decoding" << path;
+        info = Decode(data, path, thumbnail_size);
+        if (info.valid) {
+            WriteCached(hash, thumbnail_size, info);
+        }
+    }
+
+    Entry entry;
+    entry.size = fi.size();
+    entry.modified = fi.lastModified();
+    entry.hash = hash;
+    entry.thumbnail_size = thumbnail_size;
+    entry.info = info;
+
+    QMutexLocker locker(&m_Mutex);
+    QHash<QString, Entry>::iterator old = m_Entries.find(path);
+    if (old != m_Entries.end() && !old->info.thumbnail.isNull()) {
+        m_ThumbnailCount--;
+    }
+    if (!info.thumbnail.isNull()) {
+        if (m_ThumbnailCount >= MAX_MEMORY_THUMBNAILS) {
+            // keep the hashes and details, the thumbnails are on disk
+            for (QHash<QString, Entry>::iterator it = m_Entries.begin(); it != m_Entries.end(); ++it) {
+                if (!it->info.thumbnail.isNull()) {
+                    it->info.thumbnail = QImage();
+                    it->thumbnail_size = -1;
+                }
+            }
+            m_ThumbnailCount = 0;
+        }
+        m_ThumbnailCount++;
+    }
+    m_Entries.insert(path, entry);
+    return info;
+}
+
+
+QSize ThumbnailCache::GetSize(const QString &path)
+{
+    QFileInfo fi(path);
+    QString hash;
+    {
+        QMutexLocker locker(&m_Mutex);
+        QHash<QString, Entry>::const_iterator it = m_Entries.constFind(path);
+        if (it != m_Entries.constEnd() && it->size == fi.size() && it->modified == fi.lastModified()) {
+            if (it->info.valid) {
+                return QSize(it->info.width, it->info.height);
+            }
+            hash = it->hash;
+            if (m_Sizes.contains(hash)) {
+                return m_Sizes.value(hash);
+            }
+        }
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QSize();
+    }
+    QByteArray data = file.readAll();
+    if (hash.isEmpty()) {
+        hash = QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex());
+    }
+
+    QMutexLocker locker(&m_Mutex);
+    QSize size;
+    if (m_Sizes.contains(hash)) {
+        size = m_Sizes.value(hash);
+    } else {
+        locker.unlock();
+        size = Probe(data, path);
+        locker.relock();
+        m_Sizes.insert(hash, size);
+    }
+    // remember the hash so Get need not work it out again
+    if (!m_Entries.contains(path)) {
+        Entry entry;
+        entry.size = fi.size();
+        entry.modified = fi.lastModified();
+        entry.hash = hash;
+        entry.thumbnail_size = -1;
+        m_Entries.insert(path, entry);
+    }
+    return size;
+}
+
+
+QList<QSize> ThumbnailCache::GetSizes(const QStringList &paths)
+{
+    return QtConcurrent::blockingMapped<QList<QSize>>(paths, GetSize);
+}
+
+
+// Runs in a worker thread.
+QSize ThumbnailCache::Probe(const QByteArray &data, const QString &path)
+{
+    if (QFileInfo(path).suffix().toLower() == "svg") {
+        return ProbeSvg(data);
+    }
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+    QSize size = reader.size();
+    if (!size.isValid()) {
+        // a few handlers can not tell without decoding
+        QImage image;
+        if (image.loadFromData(data) || image.load(path)) {
+            size = image.size();
+        }
+    }
+    return size;
+}
+
+
+// Works out the size QSvgRenderer::defaultSize would give from the
+// width, height and viewBox of the root element, without rendering.
+QSize ThumbnailCache::ProbeSvg(const QByteArray &data)
+{
+    QXmlStreamReader reader(data);
+    while (!reader.atEnd() && !reader.isStartElement()) {
+        reader.readNext();
+    }
+    if (!reader.isStartElement()) {
+        return QSize();
+    }
+    QXmlStreamAttributes atts = reader.attributes();
+    QSizeF viewbox;
+    QStringList box = atts.value("viewBox").toString().split(QRegularExpression("[\\s,]+"), Qt::SkipEmptyParts);
+    if (box.count() == 4) {
+        viewbox = QSizeF(box.at(2).toDouble(), box.at(3).toDouble());
+    }
+    double width = SvgLength(atts.value("width").toString(), viewbox.width());
+    double height = SvgLength(atts.value("height").toString(), viewbox.height());
+    return QSize(qRound(width), qRound(height));
+}
+
+
+// QtSvg converts absolute units at 90 dpi.
+double ThumbnailCache::SvgLength(const QString &length, double viewbox_length)
+{
+    QString value = length.trimmed();
+    if (value.isEmpty()) {
+        return viewbox_length;
+    }
+    if (value.endsWith('%')) {
+        return viewbox_length * value.chopped(1).toDouble() / 100.0;
+    }
+    QString unit = value.right(2).toLower();
+    double scale = 1.0;
+    if (unit == "px") {
+    } else if (unit == "pt") {
+        scale = 1.25;
+    } else if (unit == "pc") {
+        scale = 15.0;
+    } else if (unit == "mm") {
+        scale = 3.543307;
+    } else if (unit == "cm") {
+        scale = 35.43307;
+    } else if (unit == "in") {
+        scale = 90.0;
+    } else {
+        unit.clear();
+    }
+    if (!unit.isEmpty()) {
+        value.chop(2);
+    }
+    return value.toDouble() * scale;
+}
+
+
+// Runs in a worker thread.
+ThumbnailCache::Info ThumbnailCache::Decode(const QByteArray &data, const QString &path, int thumbnail_size)
+{
+    Info info;
+    QImage image;
+    if (QFileInfo(path).suffix().toLower() == "svg") {
+        try {
+            image = Utility::RenderSvgToImage(path);
+        } catch (CannotOpenFile&) {
+            // leave it as a null image
+        }
+    } else {
+        QBuffer buffer;
+        buffer.setData(data);
+        buffer.open(QIODevice::ReadOnly);
+        QImageReader reader(&buffer);
+        QSize size = reader.size();
+        if (size.isValid() && (qint64(size.width()) * size.height() > LARGE_IMAGE_PIXELS) &&
+            reader.supportsOption(QImageIOHandler::ScaledSize)) {
+            return DecodePreview(reader, size, thumbnail_size);
+        }
+        if (!image.loadFromData(data)) {
+            // let the file suffix decide the format
+            image.load(path);
+        }
+    }
+
+    info.width = image.width();
+    info.height = image.height();
+    info.all_gray = image.allGray();
+    info.grayscale = image.isGrayscale();
+    info.depth = image.depth();
+    info.bit_planes = image.bitPlaneCount();
+    info.color_count = image.colorCount();
+    info.valid = !image.isNull();
+    if (thumbnail_size > 0 && info.valid) {
+        info.thumbnail = MakeThumbnail(image, thumbnail_size);
+    }
+    return info;
+}
+
+
+// Runs in a worker thread.
+// The size and pixel format come from the image header and the colour
+// details from a preview the decoder scales down while reading, so a
+// huge scan or map never has to be held in memory at full size.
+ThumbnailCache::Info ThumbnailCache::DecodePreview(QImageReader &reader, const QSize &size, int thumbnail_size)
+{
+    Info info;
+    QImage::Format format = reader.imageFormat();
+    reader.setScaledSize(size.scaled(PREVIEW_SIZE, PREVIEW_SIZE, Qt::KeepAspectRatio));
+    QImage preview = reader.read();
+    if (preview.isNull()) {
+        return info;
+    }
+    DBG qDebug() << "ThumbnailCache read a" << preview.size() << "preview of a" << size << "image";
+    const QImage header(1, 1, format == QImage::Format_Invalid ? preview.format() : format);
+    info.width = size.width();
+    info.height = size.height();
+    info.all_gray = preview.allGray();
+    info.grayscale = preview.isGrayscale();
+    info.depth = header.depth();
+    info.bit_planes = header.bitPlaneCount();
+    info.color_count = preview.colorCount();
+    info.valid = true;
+    if (thumbnail_size > 0) {
+        info.thumbnail = MakeThumbnail(preview, thumbnail_size);
+    }
+    return info;
+}
+
+
+QImage ThumbnailCache::MakeThumbnail(const QImage &image, int thumbnail_size)
+{
+    if (image.width() > thumbnail_size || image.height() > thumbnail_size) {
+        return image.scaled(QSize(thumbnail_size, thumbnail_size), Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    return image;
+}
+
+
+bool ThumbnailCache::ReadCached(const QString &hash, int thumbnail_size, Info &info)
+{
+    QString base = CacheFolder() + "/" + hash;
+    QFile file(base + INFO_SUFFIX);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QList<QByteArray> fields = file.readAll().trimmed().split(' ');
+    if (fields.count() != 7) {
+        return false;
+    }
+    Info cached;
+    cached.width = fields.at(0).toInt();
+    cached.height = fields.at(1).toInt();
+    cached.all_gray = fields.at(2).toInt() != 0;
+    cached.grayscale = fields.at(3).toInt() != 0;
+    cached.depth = fields.at(4).toInt();
+    cached.bit_planes = fields.at(5).toInt();
+    cached.color_count = fields.at(6).toInt();
+    cached.valid = true;
+    if (thumbnail_size > 0) {
+        if (!cached.thumbnail.load(base + "-" + QString::number(thumbnail_size) + ".png", "PNG")) {
+            return false;
+        }
+    }
+    info = cached;
+    return true;
+}
+
+
+void ThumbnailCache::WriteCached(const QString &hash, int thumbnail_size, const Info &info)
+{
+    QString folder = CacheFolder();
+    if (!QDir().mkpath(folder)) {
+        return;
+    }
+    QString base = folder + "/" + hash;
+    // QSaveFile so that a thread reading the same image
+    // never sees a partly written file
+    QSaveFile file(base + INFO_SUFFIX);
+    if (file.open(QIODevice::WriteOnly)) {
+        QByteArray fields = QByteArray::number(info.width) + " " +
+                            QByteArray::number(info.height) + " " +
+                            QByteArray::number(info.all_gray ? 1 : 0) + " " +
+                            QByteArray::number(info.grayscale ? 1 : 0) + " " +
+                            QByteArray::number(info.depth) + " " +
+                            QByteArray::number(info.bit_planes) + " " +
+                            QByteArray::number(info.color_count) + "\n";
+        file.write(fields);
+        file.commit();
+    }
+    if (thumbnail_size > 0 && !info.thumbnail.isNull()) {
+        QSaveFile png(base + "-" + QString::number(thumbnail_size) + ".png");
+        if (png.open(QIODevice::WriteOnly) && info.thumbnail.save(&png, "PNG")) {
+            png.commit();
+        }
+    }
+}
+
+
+QString ThumbnailCache::CacheFolder()
+{
+    return Utility::DefinePrefsDir() + "/" + THUMBNAIL_FOLDER;
+}
+
+
+void ThumbnailCache::PruneCacheFolder()
+{
+    QDir folder(CacheFolder());
+    QFileInfoList files = folder.entryInfoList(QDir::Files, QDir::Time);
+    if (files.count() <= MAX_CACHED_FILES) {
+        return;
+    }
+    DBG qDebug() << "ThumbnailCache pruning" << files.count() << "files";
+    // newest first, keep three quarters
+    for (int i = MAX_CACHED_FILES * 3 / 4; i < files.count(); i++) {
+        QFile::remove(files.at(i).absoluteFilePath());
+    }
+}
@@ -0,0 +1,146 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QDateTime>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+
+#include <utility>
+
+class QImageReader;
+
+/**
+ * Keeps what the image reports, the image picker and the image viewer
+ * show about an image: its size, its colour details and a thumbnail.
+ *
+ * Working these out means decoding the whole image, so it is only done
+ * once for any image content.  The results are stored under the sha1 of
+ * the file contents in the preferences folder, so they survive between
+ * sessions and are shared between books, and the results for the images
+ * used most recently are also kept in memory.  Get is safe to call from
+ * worker threads, so views can fill in thumbnails as they become ready.
+ */
+class ThumbnailCache
+{
+public:
+    struct Info {
+        int width = 0;
+        int height = 0;
+        // every pixel is gray, as QImage::allGray
+        bool all_gray = false;
+        // the image uses a gray colour table, as QImage::isGrayscale
+        bool grayscale = false;
+        int depth = 0;
+        int bit_planes = 0;
+        int color_count = 0;
+        // null when asked for with a thumbnail size of 0
+        QImage thumbnail;
+        bool valid = false;
+    };
+
+    /**
+     * Returns the details of the image or svg at path with a thumbnail
+     * that fits in a square of thumbnail_size.  Looks in memory, then on
+     * disk and only decodes the image if neither has it.
+     */
+    static Info Get(const QString &path, int thumbnail_size);
+
+    /**
+     * The same but only looks in memory, so it is cheap enough to call on
+     * the GUI thread for every row of a view.  Returns false on a miss.
+     */
+    static bool Find(const QString &path, int thumbnail_size, Info &info);
+
+    /**
+     * Returns the size of the image at path without decoding it, from the
+     * image header or, for an svg, from the width, height and viewBox of
+     * its root element.  Sizes are kept in memory by content hash.
+     */
+    static QSize GetSize(const QString &path);
+
+    /**
+     * GetSize for every path, in worker threads.
+     */
+    static QList<QSize> GetSizes(const QStringList &paths);
+
+    /**
+     * The number of images known and roughly how many bytes their
+     * details and thumbnails use.
+     */
+    static std::pair<int, qint64> MemoryUsage();
+
+private:
+    struct Entry {
+        qint64 size;
+        QDateTime modified;
+        QString hash;
+        // the thumbnail_size the info was asked for with, -1 if none yet
+        int thumbnail_size;
+        Info info;
+    };
+
+    static QSize Probe(const QByteArray &data, const QString &path);
+
+    static QSize ProbeSvg(const QByteArray &data);
+
+    static double SvgLength(const QString &length, double viewbox_length);
+
+    static Info Decode(const QByteArray &data, const QString &path, int thumbnail_size);
+
+    static Info DecodePreview(QImageReader &reader, const QSize &size, int thumbnail_size);
+
+    static QImage MakeThumbnail(const QImage &image, int thumbnail_size);
+
+    static bool ReadCached(const QString &hash, int thumbnail_size, Info &info);
+
+    static void WriteCached(const QString &hash, int thumbnail_size, const Info &info);
+
+    static QString CacheFolder();
+
+    static void PruneCacheFolder();
+
+    /**
+     * Entries keyed by full file path.
+     */
+    static QHash<QString, Entry> m_Entries;
+
+    /**
+     * Image sizes keyed by the sha1 of the file contents.
+     */
+    static QHash<QString, QSize> m_Sizes;
+
+    static int m_ThumbnailCount;
+
+    static bool m_Pruned;
+
+    static QMutex m_Mutex;
+};
+
+#endif // THUMBNAILCACHE_H
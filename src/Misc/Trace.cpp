@@ -0,0 +1,300 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <atomic>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QMutex>
+#include <QtCore/QThread>
+
+#include "Misc/OperationLog.h"
+#include "Misc/Trace.h"
+#include "Misc/Utility.h"
+
+// Keeps a long session from using up memory, about 100 MB of spans
+static const int MAX_EVENTS = 1000000;
+
+namespace
+{
+
+struct TraceEvent {
+    const char *name;
+    // X for a span, C for a counter
+    char phase;
+    qint64 start;
+    qint64 duration;
+    int thread;
+    QList<QPair<const char *, QVariant>> args;
+    QVariantMap values;
+};
+
+}
+
+static QMutex s_EventsMutex;
+static QList<TraceEvent> s_Events;
+static QHash<int, QString> s_ThreadNames;
+static int s_Dropped = 0;
+static std::atomic<int> s_NextThread(1);
+static thread_local int t_ThreadNumber = 0;
+
+static std::atomic<bool> s_TrackActive(false);
+static QMutex s_ActiveMutex;
+static QList<const char *> s_ActiveSpans;
+
+// Operations open on the GUI thread
+static int s_OperationDepth = 0;
+
+
+// Nanoseconds since the first span started
+static qint64 Now()
+{
+    static QElapsedTimer timer = []() {
+        QElapsedTimer started;
+        started.start();
+        return started;
+    }();
+    return timer.nsecsElapsed();
+}
+
+
+static int ThreadNumber()
+{
+    if (t_ThreadNumber == 0) {
+        t_ThreadNumber = s_NextThread++;
+        QThread *thread = QThread::currentThread();
+        QString name = thread->objectName();
+        if (QCoreApplication::instance() && (thread == QCoreApplication::instance()->thread())) {
+            name = "GUI";
+        } else if (name.isEmpty()) {
+            name = QString("Thread %1").arg(t_ThreadNumber);
+        }
+        QMutexLocker locker(&s_EventsMutex);
+        s_ThreadNames.insert(t_ThreadNumber, name);
+    }
+    return t_ThreadNumber;
+}
+
+
+static bool IsGUIThread()
+{
+    // -1 until the thread is first asked about
+    static thread_local int is_gui = -1;
+    if (is_gui < 0) {
+        QCoreApplication *app = QCoreApplication::instance();
+        is_gui = (app && (QThread::currentThread() == app->thread())) ? 1 : 0;
+    }
+    return is_gui == 1;
+}
+
+
+static void Record(const TraceEvent &event)
+{
+    QMutexLocker locker(&s_EventsMutex);
+    if (s_Events.count() >= MAX_EVENTS) {
+        s_Dropped++;
+        return;
+    }
+    s_Events.append(event);
+}
+
+
+Trace::Span::Span(const char *name)
+    :
+    m_Name(name),
+    m_Start(IsEnabled() ? Now() : -1),
+    m_Active(false)
+{
+    if (s_TrackActive && IsGUIThread()) {
+        QMutexLocker locker(&s_ActiveMutex);
+        s_ActiveSpans.append(m_Name);
+        m_Active = true;
+    }
+}
+
+
+Trace::Span::~Span()
+{
+    if (m_Active) {
+        // spans are scoped so the last one opened is the first to close
+        QMutexLocker locker(&s_ActiveMutex);
+        if (!s_ActiveSpans.isEmpty()) {
+            s_ActiveSpans.removeLast();
+        }
+    }
+    if (m_Start < 0) {
+        return;
+    }
+    TraceEvent event;
+    event.name = m_Name;
+    event.phase = 'X';
+    event.start = m_Start;
+    event.duration = Now() - m_Start;
+    event.thread = ThreadNumber();
+    event.args = m_Args;
+    Record(event);
+}
+
+
+void Trace::Span::AddArg(const char *key, const QVariant &value)
+{
+    if (m_Start >= 0) {
+        m_Args.append(qMakePair(key, value));
+    }
+}
+
+
+Trace::Operation::Operation(const char *name, const QString &label)
+    :
+    m_Span(name),
+    m_Label(label),
+    m_Start(Now()),
+    m_Logged(IsGUIThread() && (s_OperationDepth == 0))
+{
+    if (IsGUIThread()) {
+        s_OperationDepth++;
+    }
+}
+
+
+Trace::Operation::~Operation()
+{
+    if (IsGUIThread()) {
+        s_OperationDepth--;
+    }
+    if (m_Logged) {
+        OperationLog::instance()->Add(m_Label, (Now() - m_Start) / 1000000, m_Details.join(", "));
+    }
+}
+
+
+void Trace::Operation::AddArg(const char *key, const QVariant &value)
+{
+    m_Span.AddArg(key, value);
+    m_Details.append(QString("%1: %2").arg(QString::fromUtf8(key), value.toString()));
+}
+
+
+bool Trace::IsEnabled()
+{
+    static const bool enabled = !Utility::GetEnvironmentVar("SIGIL_TRACE_FILE").isEmpty();
+    return enabled;
+}
+
+
+void Trace::Counter(const char *name, const QVariantMap &values)
+{
+    if (!IsEnabled()) {
+        return;
+    }
+    TraceEvent event;
+    event.name = name;
+    event.phase = 'C';
+    event.start = Now();
+    event.duration = 0;
+    event.thread = ThreadNumber();
+    event.values = values;
+    Record(event);
+}
+
+
+void Trace::TrackActiveSpans()
+{
+    s_TrackActive = true;
+}
+
+
+QList<const char *> Trace::ActiveSpans()
+{
+    QMutexLocker locker(&s_ActiveMutex);
+    return s_ActiveSpans;
+}
+
+
+void Trace::Write()
+{
+    if (!IsEnabled()) {
+        return;
+    }
+    QList<TraceEvent> events;
+    QHash<int, QString> thread_names;
+    int dropped;
+    {
+        QMutexLocker locker(&s_EventsMutex);
+        events = s_Events;
+        thread_names = s_ThreadNames;
+        dropped = s_Dropped;
+    }
+
+    // Complete events, with the threads named by metadata events
+    QJsonArray trace_events;
+    QHashIterator<int, QString> it(thread_names);
+    while (it.hasNext()) {
+        it.next();
+        QJsonObject args;
+        args["name"] = it.value();
+        QJsonObject name_event;
+        name_event["name"] = "thread_name";
+        name_event["ph"] = "M";
+        name_event["pid"] = 1;
+        name_event["tid"] = it.key();
+        name_event["args"] = args;
+        trace_events.append(name_event);
+    }
+    foreach(const TraceEvent &event, events) {
+        QJsonObject trace_event;
+        trace_event["name"] = QString::fromUtf8(event.name);
+        trace_event["cat"] = "sigil";
+        trace_event["ph"] = QString(QChar(event.phase));
+        trace_event["pid"] = 1;
+        trace_event["tid"] = event.thread;
+        trace_event["ts"] = event.start / 1000.0;
+        if (event.phase == 'C') {
+            trace_event["args"] = QJsonObject::fromVariantMap(event.values);
+        } else {
+            trace_event["dur"] = event.duration / 1000.0;
+        }
+        if (!event.args.isEmpty()) {
+            QJsonObject args;
+            for (int i = 0; i < event.args.count(); ++i) {
+                args[QString::fromUtf8(event.args.at(i).first)] = QJsonValue::fromVariant(event.args.at(i).second);
+            }
+            trace_event["args"] = args;
+        }
+        trace_events.append(trace_event);
+    }
+    QJsonObject other_data;
+    other_data["dropped_spans"] = dropped;
+    QJsonObject trace;
+    trace["traceEvents"] = trace_events;
+    trace["displayTimeUnit"] = "ms";
+    trace["otherData"] = other_data;
+
+    QFile file(Utility::GetEnvironmentVar("SIGIL_TRACE_FILE"));
+    if (file.open(QFile::WriteOnly | QFile::Truncate)) {
+        file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact));
+    }
+}
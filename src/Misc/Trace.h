@@ -0,0 +1,161 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QPair>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QVariant>
+
+/**
+ * Times scoped spans of the major operations for a Chrome trace.
+ *
+ * Set SIGIL_TRACE_FILE to the path of a json file and every span
+ * that ends while Sigil runs is written to it on exit, with the
+ * thread it ran on and its arguments.  The file opens in
+ * chrome://tracing or https://ui.perfetto.dev where spans that run
+ * inside one another on a thread show nested.  When the variable is
+ * not set a span costs one check of a flag, and building with
+ * -DDISABLE_TRACING=1 removes the spans altogether.
+ *
+ * Use the macros rather than the class so the spans compile away:
+ *
+ *     TRACE_SPAN(span, "Book::MergeResources");
+ *     TRACE_ARG(span, "files", resources.count());
+ *
+ * A book wide operation an editor starts, such as Replace All or
+ * Save, uses TRACE_OPERATION instead so that how long it took is
+ * also shown to the editor, see Misc/OperationLog.h.  Operations
+ * are kept in builds without tracing.
+ */
+class Trace
+{
+
+public:
+
+    class Span
+    {
+
+    public:
+
+        /**
+         * name must live as long as the program, a string literal.
+         */
+        Span(const char *name);
+
+        ~Span();
+
+        void AddArg(const char *key, const QVariant &value);
+
+    private:
+
+        const char *m_Name;
+
+        // -1 when tracing is off
+        qint64 m_Start;
+
+        // true if the span is on the active stack of the GUI thread
+        bool m_Active;
+
+        QList<QPair<const char *, QVariant>> m_Args;
+    };
+
+    /**
+     * A span that also adds how long it took to the OperationLog when
+     * it ends on the GUI thread.  One inside another operation, such as
+     * the Mend that a Save runs, is only traced.
+     */
+    class Operation
+    {
+
+    public:
+
+        /**
+         * name is as for Span, label is what the editor is shown.
+         */
+        Operation(const char *name, const QString &label);
+
+        ~Operation();
+
+        /**
+         * Adds the argument to the span and to the details shown.
+         */
+        void AddArg(const char *key, const QVariant &value);
+
+    private:
+
+        Span m_Span;
+
+        QString m_Label;
+
+        QStringList m_Details;
+
+        qint64 m_Start;
+
+        // false if off the GUI thread or inside another operation
+        bool m_Logged;
+    };
+
+    /**
+     * Returns true if SIGIL_TRACE_FILE is set.
+     */
+    static bool IsEnabled();
+
+    /**
+     * Records values that the trace draws as a graph over time, such
+     * as memory use.  name must live as long as the program.
+     */
+    static void Counter(const char *name, const QVariantMap &values);
+
+    /**
+     * Writes every span recorded so far to SIGIL_TRACE_FILE.
+     */
+    static void Write();
+
+    /**
+     * Starts keeping the names of the spans open on the GUI thread,
+     * even when no trace file is being written, for ActiveSpans.
+     */
+    static void TrackActiveSpans();
+
+    /**
+     * Returns the names of the spans open on the GUI thread right now,
+     * outermost first.  Safe to call from any thread.
+     */
+    static QList<const char *> ActiveSpans();
+};
+
+#ifndef SIGIL_NO_TRACING
+#define TRACE_SPAN(var, name) Trace::Span var(name)
+#define TRACE_ARG(var, key, value) var.AddArg(key, value)
+#else
+#define TRACE_SPAN(var, name) do {} while (0)
+#define TRACE_ARG(var, key, value) do {} while (0)
+#endif
+
+#define TRACE_OPERATION(var, name, label) Trace::Operation var(name, label)
+
+#endif // TRACE_H
@@ -26,11 +26,12 @@
 #include <QWebEngineUrlRequestJob>
 #include <QWebEngineUrlSchemeHandler>
 #include <QBuffer>
-#include <QFile>
 #include <QFileInfo>
 #include <QDebug>
 #include "MainUI/MainApplication.h"
+#include "Misc/DeferredFiles.h"
 #include "Misc/MediaTypes.h"
+#include "Misc/PreviewResourceCache.h"
 #include "Misc/Utility.h"
 #include "Misc/URLSchemeHandler.h"
 
@@ -64,6 +65,7 @@ void URLSchemeHandler::requestStarted(QWebEngineUrlRequestJob *request)
     } else {
         QUrl fileurl("file://" + url.path());
         QString local_file =  fileurl.toLocalFile();
+        DeferredFiles::Materialize(local_file);
         QFileInfo fi(local_file);
         if (fi.exists()) {
             QString mt = MediaTypes::instance()->GetMediaTypeFromExtension(fi.suffix().toLower(), "");
@@ -91,11 +93,14 @@ void URLSchemeHandler::requestStarted(QWebEngineUrlRequestJob *request)
                 return;
             }
             
-            QFile file(local_file);
-            if (file.open(QIODevice::ReadOnly)) {
-                data = file.readAll();
-                file.close();
+            // shared with every other page using the file
+            QIODevice *device = PreviewResourceCache::Open(local_file);
+            if (device && device->size() > 0) {
+                connect(request, SIGNAL(destroyed()), device, SLOT(deleteLater()));
+                request->reply(content_type.toUtf8(), device);
+                return;
             }
+            delete device;
         }
     }
     if (!data.isEmpty()) {
@@ -142,6 +142,14 @@ public:
     // file; if the file exists, it is truncated
     static void WriteUnicodeTextFile(const QString &text, const QString &fullfilepath);
 
+    // As WriteUnicodeTextFile but the UTF-8 is written in one go to a
+    // temporary file that then replaces the specified file, so the file
+    // is never left partly written
+    static void SaveUnicodeTextFile(const QString &text, const QString &fullfilepath);
+
+    // The bytes SaveUnicodeTextFile writes to the file for the text
+    static QByteArray UnicodeTextFileData(const QString &text);
+
     // Converts Mac and Windows style line endings to Unix style
     // line endings that are expected throughout the Qt framework
     // while converting to Unicode Normalization Form C
@@ -192,6 +200,10 @@ public:
 
     static QWidget *GetMainWindow();
 
+    // True when called from the GUI thread, the only thread that may
+    // touch widgets, cursors and progress dialogs
+    static bool IsGUIThread();
+
     static QString getSpellingSafeText(const QString &raw_text);
 
     static bool has_non_ascii_chars(const QString &str);
@@ -239,6 +251,10 @@ public:
     // inject dark mode css into html for Preview, AVTab, ImageTab, ViewImage, and SelectFiles
     static QString AddDarkCSS(const QString &html);
 
+    // the style AddDarkCSS puts at the end of the head, it uses the
+    // application palette so it must be built on the GUI thread
+    static QString DarkCSSStyle();
+
     // return the proper background color for QWebEngineView
     static QColor WebViewBackgroundColor(bool followpref = false);
     
@@ -20,10 +20,15 @@
 *************************************************************************/
 
 #include <QDir>
+#include <QEvent>
+#include <QPointer>
 #include <QString>
 #include <QStringList>
+#include <QTimer>
+#include <QWebEnginePage>
 #include <QWebEngineProfile>
 #include <QWebEngineSettings>
+#include <QWebEngineView>
 
 #include "Misc/Utility.h"
 #include "Misc/SettingsStore.h"
@@ -31,6 +36,59 @@
 #include "Misc/URLInterceptor.h"
 #include "Misc/WebProfileMgr.h"
 
+// how long a view stays hidden before its page is discarded
+static const int DISCARD_DELAY_MS = 30000;
+
+// Watches a view for DiscardWhenHidden
+class HiddenPageDiscarder : public QObject
+{
+public:
+    HiddenPageDiscarder(QWebEngineView *view)
+        : QObject(view),
+          m_View(view)
+    {
+        m_Timer.setSingleShot(true);
+        m_Timer.setInterval(DISCARD_DELAY_MS);
+        connect(&m_Timer, &QTimer::timeout, this, &HiddenPageDiscarder::Discard);
+        view->installEventFilter(this);
+    }
+
+    bool eventFilter(QObject *watched, QEvent *event) override
+    {
+        if (watched == m_View) {
+            if (event->type() == QEvent::Hide) {
+                m_Timer.start();
+            } else if (event->type() == QEvent::Show) {
+                m_Timer.stop();
+                QWebEnginePage *page = m_View->page();
+                if (page && (page->lifecycleState() != QWebEnginePage::LifecycleState::Active)) {
+                    page->setLifecycleState(QWebEnginePage::LifecycleState::Active);
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    void Discard()
+    {
+        QWebEnginePage *page = m_View ? m_View->page() : NULL;
+        if (!page || m_View->isVisible()) {
+            return;
+        }
+        // WebEngine keeps a page Active that is playing audio or has
+        // the inspector open, and Frozen if it cannot be discarded
+        QWebEnginePage::LifecycleState state = page->recommendedState();
+        if (state != QWebEnginePage::LifecycleState::Active) {
+            page->setLifecycleState(state);
+        }
+    }
+
+    QPointer<QWebEngineView> m_View;
+    QTimer m_Timer;
+};
+
+
 WebProfileMgr *WebProfileMgr::m_instance = 0;
 
 WebProfileMgr *WebProfileMgr::instance()
@@ -54,6 +112,22 @@ QWebEngineProfile* WebProfileMgr::GetOneTimeProfile()
 }
 
 
+void WebProfileMgr::DiscardWhenHidden(QWebEngineView *view)
+{
+    new HiddenPageDiscarder(view);
+}
+
+
+// The views only load local files, so a small cache kept in memory
+// does as well as one on disk and keeps each profile's use bounded
+void WebProfileMgr::LimitHttpCache(QWebEngineProfile *profile)
+{
+    SettingsStore ss;
+    profile->setHttpCacheType(QWebEngineProfile::MemoryHttpCache);
+    profile->setHttpCacheMaximumSize(ss.webCacheSize() * 1024 * 1024);
+}
+
+
 void WebProfileMgr::InitializeDefaultSettings(QWebEngineSettings* web_settings)
 {
     SettingsStore ss;
@@ -97,6 +171,7 @@ WebProfileMgr::WebProfileMgr()
     InitializeDefaultSettings(web_settings);
     // Use URLInterceptor for protection
     QWebEngineProfile::defaultProfile()->setUrlRequestInterceptor(m_URLint);
+    LimitHttpCache(QWebEngineProfile::defaultProfile());
 
     // create the profile for Preview
     SettingsStore ss;
@@ -122,6 +197,7 @@ WebProfileMgr::WebProfileMgr()
     // Use both our URLInterceptor and our URLSchemeHandler
     m_preview_profile->installUrlSchemeHandler("sigil", m_URLhandler);
     m_preview_profile->setUrlRequestInterceptor(m_URLint);
+    LimitHttpCache(m_preview_profile);
 
     // create the profile for OneTime
     m_onetime_profile = new QWebEngineProfile();
@@ -136,6 +212,7 @@ WebProfileMgr::WebProfileMgr()
     m_onetime_profile->setPersistentStoragePath(localStorePath);
     // Use URLInterceptor for protection
     m_onetime_profile->setUrlRequestInterceptor(m_URLint);
+    LimitHttpCache(m_onetime_profile);
 
 }
 
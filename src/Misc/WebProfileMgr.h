@@ -34,6 +34,8 @@
 class URLInterceptor;
 class URLSchemeHandler;
 class QWebEngineProfile;
+class QWebEngineSettings;
+class QWebEngineView;
 
 class WebProfileMgr
 {
@@ -43,11 +45,20 @@ public:
     static WebProfileMgr *instance();
     QWebEngineProfile* GetPreviewProfile();
     QWebEngineProfile* GetOneTimeProfile();
+
+    /**
+     * Discards the page of view once the view has been hidden for a
+     * while, so its renderer can give the memory back.  The page is
+     * brought back, and reloaded, when the view is shown again.
+     * Only for views whose page can simply be loaded again.
+     */
+    void DiscardWhenHidden(QWebEngineView *view);
     
 private:
 
     WebProfileMgr();
     void InitializeDefaultSettings(QWebEngineSettings* web_settings);
+    void LimitHttpCache(QWebEngineProfile *profile);
     URLInterceptor* m_URLint;
     URLSchemeHandler* m_URLhandler;
 
@@ -0,0 +1,104 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include "Misc/WordTokenizer.h"
+
+static const int MAX_WORD_LENGTH = 90;
+
+static const QString ENTITYWORDCHARS = ";#01234567890abcdefABCDEFxX";
+
+WordTokenizer::WordTokenizer(const QString &wordchars, bool use_nums)
+    :
+    m_WordChars(wordchars),
+    m_UseNums(use_nums)
+{
+    for (int c = 0; c < 256; c++) {
+        m_Latin1[c] = OtherClass(c);
+    }
+}
+
+
+uchar WordTokenizer::OtherClass(ushort c) const
+{
+    QChar ch(c);
+    uchar cls = 0;
+    if (m_UseNums ? ch.isLetterOrNumber() : ch.isLetter()) {
+        cls |= VALID;
+    }
+    bool in_wordchars = m_WordChars.contains(ch);
+    if ((c == '-') || (c == 0x2012) || (c == '\'') || (c == 0x2019) || in_wordchars) {
+        cls |= POTENTIAL;
+    }
+    // allow ending period for abbreviations
+    if ((c == '.') && in_wordchars) {
+        cls |= KEEP_DOT;
+    }
+    return cls;
+}
+
+
+// The text is scanned as if it had a space added at either end, so i
+// runs one past the text on both sides and text[i - 1] is character i
+void WordTokenizer::Tokenize(const QStringView text, int pos, QList<Span> &spans) const
+{
+    const QChar *data = text.constData();
+    const int n = text.length();
+    const QChar space(' ');
+    bool in_entity = false;
+    bool in_invalid_word = false;
+    int word_start = 0;
+
+    for (int i = 0; i < n + 2; i++) {
+        QChar c = (i == 0 || i > n) ? space : data[i - 1];
+
+        // a plain ascii letter is never a boundary so skip the whole run
+        if ((c.unicode() < 128) && (m_Latin1[c.unicode()] & VALID)) {
+            int j = i;
+            while ((j < n) && (data[j].unicode() < 128) && (m_Latin1[data[j].unicode()] & VALID)) {
+                j++;
+            }
+            if (!in_invalid_word && (j - word_start) > MAX_WORD_LENGTH) in_invalid_word = true;
+            i = j;
+            continue;
+        }
+
+        QChar prev_c = (i <= 1) ? space : data[i - 2];
+        QChar next_c = (i >= n) ? space : data[i];
+        if (IsBoundary(prev_c, c, next_c)) {
+            // If we're in an entity and we hit a boundary and it isn't
+            // part of an entity then this is an invalid entity.
+            if (in_entity && !ENTITYWORDCHARS.contains(c)) in_entity = false;
+            if (!in_invalid_word && !in_entity && (i - word_start) > 0) {
+                Span span;
+                span.offset = pos + word_start - 1;
+                span.length = i - word_start;
+                spans.append(span);
+            }
+            word_start = i + 1;
+            in_invalid_word = false;
+        } else {
+            // Ensure we're not dealing with some crazy run on text
+            if (!in_invalid_word && (i - word_start) > MAX_WORD_LENGTH) in_invalid_word = true;
+        }
+        if (c == QChar('&')) in_entity = true;
+        if (c == QChar(';')) in_entity = false;
+    }
+}
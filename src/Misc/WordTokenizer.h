@@ -0,0 +1,102 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef WORDTOKENIZER_H
+#define WORDTOKENIZER_H
+
+#include <QChar>
+#include <QList>
+#include <QString>
+#include <QStringView>
+
+/**
+ * Splits text into the words the spellchecker looks at.
+ *
+ * Words are returned as spans over the text so callers only make
+ * strings of the words they actually need.  The class of every
+ * Latin-1 character (word character, possible boundary, kept period)
+ * is worked out once when the tokenizer is made, so the scan itself
+ * is table lookups, and runs of plain ascii letters inside a word
+ * are skipped over without any boundary tests at all.
+ */
+class WordTokenizer
+{
+public:
+
+    struct Span {
+        int offset;
+        int length;
+    };
+
+    /**
+     * wordchars are the extra word characters of the dictionary,
+     * use_nums counts digits as letters.
+     */
+    WordTokenizer(const QString &wordchars, bool use_nums);
+
+    /**
+     * True if c does not belong to a word.  Hyphens, apostrophes and the
+     * dictionary's word characters only join letters on both sides.
+     */
+    bool IsBoundary(QChar prev_c, QChar c, QChar next_c) const
+    {
+        uchar cls = Class(c.unicode());
+        if (cls & (VALID | KEEP_DOT)) return false;
+        if (!(cls & POTENTIAL)) return true;
+        return !(IsValid(prev_c.unicode()) && IsValid(next_c.unicode()));
+    }
+
+    /**
+     * Appends the spans of the words in a run of plain text (no markup,
+     * entities are skipped), with offsets relative to the text plus pos.
+     */
+    void Tokenize(const QStringView text, int pos, QList<Span> &spans) const;
+
+private:
+
+    enum {
+        VALID = 1,
+        POTENTIAL = 2,
+        KEEP_DOT = 4
+    };
+
+    uchar Class(ushort c) const
+    {
+        if (c < 256) return m_Latin1[c];
+        return OtherClass(c);
+    }
+
+    bool IsValid(ushort c) const
+    {
+        return Class(c) & VALID;
+    }
+
+    uchar OtherClass(ushort c) const;
+
+    uchar m_Latin1[256];
+
+    QString m_WordChars;
+
+    bool m_UseNums;
+};
+
+#endif // WORDTOKENIZER_H
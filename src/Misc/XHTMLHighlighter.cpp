@@ -59,6 +59,30 @@ static const QString ENTITY_END             = ";";
 
 static const QString SPECIAL_SPACE_BEGIN    = "[\\x{00A0}\\x{2000}-\\x{200A}\\x{202F}\\x{3000}]+";
 
+// The expressions are compiled once and shared by every highlighter
+static QRegularExpression CompiledRegex(const QString &pattern)
+{
+    QRegularExpression regex(pattern);
+    regex.optimize();
+    return regex;
+}
+
+static const QRegularExpression RX_DOCTYPE_BEGIN       = CompiledRegex(DOCTYPE_BEGIN);
+static const QRegularExpression RX_HTML_ELEMENT_BEGIN  = CompiledRegex(HTML_ELEMENT_BEGIN);
+static const QRegularExpression RX_HTML_ELEMENT_NAME   = CompiledRegex(HTML_ELEMENT_NAME);
+static const QRegularExpression RX_HTML_ELEMENT_END    = CompiledRegex(HTML_ELEMENT_END);
+static const QRegularExpression RX_HTML_COMMENT_BEGIN  = CompiledRegex(HTML_COMMENT_BEGIN);
+static const QRegularExpression RX_HTML_COMMENT_END    = CompiledRegex(HTML_COMMENT_END);
+static const QRegularExpression RX_CSS_BEGIN           = CompiledRegex(CSS_BEGIN);
+static const QRegularExpression RX_CSS_END             = CompiledRegex(CSS_END);
+static const QRegularExpression RX_CSS_COMMENT_BEGIN   = CompiledRegex(CSS_COMMENT_BEGIN);
+static const QRegularExpression RX_CSS_COMMENT_END     = CompiledRegex(CSS_COMMENT_END);
+static const QRegularExpression RX_ATTRIBUTE_VALUE     = CompiledRegex(ATTRIBUTE_VALUE);
+static const QRegularExpression RX_ATTRIBUTE_NAME      = CompiledRegex(ATTRIBUTE_NAME);
+static const QRegularExpression RX_ENTITY_BEGIN        = CompiledRegex(ENTITY_BEGIN);
+static const QRegularExpression RX_ENTITY_END          = CompiledRegex(ENTITY_END);
+static const QRegularExpression RX_SPECIAL_SPACE_BEGIN = CompiledRegex(SPECIAL_SPACE_BEGIN);
+
 // Constructor
 XHTMLHighlighter::XHTMLHighlighter(bool checkSpelling, QObject *parent)
     : QSyntaxHighlighter(parent),
@@ -70,79 +94,33 @@ XHTMLHighlighter::XHTMLHighlighter(bool checkSpelling, QObject *parent)
 
 void XHTMLHighlighter::SetRules()
 {
-    m_Rules.clear();
-
     SettingsStore settings;
     if (Utility::IsDarkMode()) {
         m_codeViewAppearance = settings.codeViewDarkAppearance();
     } else {
         m_codeViewAppearance = settings.codeViewAppearance();
     }
+    m_enableSpellCheck = settings.spellCheck();
 
-    QTextCharFormat html_format;
-    QTextCharFormat doctype_format;
-    QTextCharFormat html_comment_format;
-    QTextCharFormat css_format;
-    QTextCharFormat css_comment_format;
-    QTextCharFormat attribute_name_format;
-    QTextCharFormat attribute_value_format;
-    QTextCharFormat entity_format;
-    QTextCharFormat special_space_format;
-
-    doctype_format        .setForeground(m_codeViewAppearance.xhtml_doctype_color);
-    html_format           .setForeground(m_codeViewAppearance.xhtml_html_color);
-    html_comment_format   .setForeground(m_codeViewAppearance.xhtml_html_comment_color);
-    css_format            .setForeground(m_codeViewAppearance.xhtml_css_color);
-    css_comment_format    .setForeground(m_codeViewAppearance.xhtml_css_comment_color);
-    attribute_name_format .setForeground(m_codeViewAppearance.xhtml_attribute_name_color);
-    attribute_value_format.setForeground(m_codeViewAppearance.xhtml_attribute_value_color);
-    entity_format         .setForeground(m_codeViewAppearance.xhtml_entity_color);
+    for (int i = 0; i < Format_Count; i++) {
+        m_Formats[i] = QTextCharFormat();
+    }
+    m_Formats[Format_DOCTYPE]       .setForeground(m_codeViewAppearance.xhtml_doctype_color);
+    m_Formats[Format_HTML]          .setForeground(m_codeViewAppearance.xhtml_html_color);
+    m_Formats[Format_HTMLComment]   .setForeground(m_codeViewAppearance.xhtml_html_comment_color);
+    m_Formats[Format_CSS]           .setForeground(m_codeViewAppearance.xhtml_css_color);
+    m_Formats[Format_CSSComment]    .setForeground(m_codeViewAppearance.xhtml_css_comment_color);
+    m_Formats[Format_AttributeName] .setForeground(m_codeViewAppearance.xhtml_attribute_name_color);
+    m_Formats[Format_AttributeValue].setForeground(m_codeViewAppearance.xhtml_attribute_value_color);
+    m_Formats[Format_Entity]        .setForeground(m_codeViewAppearance.xhtml_entity_color);
     // use the same color as for entities but as an underline since they are "spaces"
-    special_space_format  .setUnderlineColor(m_codeViewAppearance.xhtml_entity_color);
-    special_space_format  .setUnderlineStyle(QTextCharFormat::DashUnderline);
-    HighlightingRule rule;
-    rule.pattern = QRegularExpression(DOCTYPE_BEGIN);
-    rule.format  = doctype_format;
-    m_Rules[ "DOCTYPE_BEGIN" ] = rule;
-    rule.pattern = QRegularExpression(HTML_ELEMENT_BEGIN);
-    rule.format  = html_format;
-    m_Rules[ "HTML_ELEMENT_BEGIN" ] = rule;
-    rule.pattern = QRegularExpression(HTML_ELEMENT_END);
-    rule.format  = html_format;
-    m_Rules[ "HTML_ELEMENT_END" ] = rule;
-    rule.pattern = QRegularExpression(HTML_COMMENT_BEGIN);
-    rule.format  = html_comment_format;
-    m_Rules[ "HTML_COMMENT_BEGIN" ] = rule;
-    rule.pattern = QRegularExpression(HTML_COMMENT_END);
-    rule.format  = html_comment_format;
-    m_Rules[ "HTML_COMMENT_END" ] = rule;
-    rule.pattern = QRegularExpression(CSS_BEGIN);
-    rule.format  = css_format;
-    m_Rules[ "CSS_BEGIN" ] = rule;
-    rule.pattern = QRegularExpression(CSS_END);
-    rule.format  = css_format;
-    m_Rules[ "CSS_END" ] = rule;
-    rule.pattern = QRegularExpression(CSS_COMMENT_BEGIN);
-    rule.format  = css_comment_format;
-    m_Rules[ "CSS_COMMENT_BEGIN" ] = rule;
-    rule.pattern = QRegularExpression(CSS_COMMENT_END);
-    rule.format  = css_comment_format;
-    m_Rules[ "CSS_COMMENT_END" ] = rule;
-    rule.pattern = QRegularExpression(ATTRIBUTE_NAME);
-    rule.format  = attribute_name_format;
-    m_Rules[ "ATTRIBUTE_NAME" ] = rule;
-    rule.pattern = QRegularExpression(ATTRIBUTE_VALUE);
-    rule.format  = attribute_value_format;
-    m_Rules[ "ATTRIBUTE_VALUE" ] = rule;
-    rule.pattern = QRegularExpression(ENTITY_BEGIN);
-    rule.format  = entity_format;
-    m_Rules[ "ENTITY_BEGIN" ] = rule;
-    rule.pattern = QRegularExpression(ENTITY_END);
-    rule.format  = entity_format;
-    m_Rules[ "ENTITY_END" ] = rule;
-    rule.pattern = QRegularExpression(SPECIAL_SPACE_BEGIN);
-    rule.format  = special_space_format;
-    m_Rules[ "SPECIAL_SPACE_BEGIN" ] = rule;
+    m_Formats[Format_SpSpace]       .setUnderlineColor(m_codeViewAppearance.xhtml_entity_color);
+    m_Formats[Format_SpSpace]       .setUnderlineStyle(QTextCharFormat::DashUnderline);
+    m_Formats[Format_Spelling]      .setUnderlineColor(m_codeViewAppearance.spelling_underline_color);
+    // QTextCharFormat::SpellCheckUnderline has issues with Qt 5. It only displays
+    // at some zoom levels and often doesn't display at all. So we're using wave
+    // underline since it's good enough for most people.
+    m_Formats[Format_Spelling]      .setUnderlineStyle(QTextCharFormat::WaveUnderline);
 }
 
 // Overrides the function from QSyntaxHighlighter;
@@ -164,11 +142,8 @@ void XHTMLHighlighter::highlightBlock(const QString &text)
         return;
     }
 
-    SettingsStore settings;
-    bool enableSpellCheck = settings.spellCheck();
-
     // Run spell check over the text.
-    if (enableSpellCheck && m_checkSpelling) {
+    if (m_enableSpellCheck && m_checkSpelling) {
         CheckSpelling(text);
     }
 
@@ -197,62 +172,58 @@ void XHTMLHighlighter::do_rehighlight()
 
 
 // Returns the regex that matches the left bracket of a state
-QRegularExpression XHTMLHighlighter::GetLeftBracketRegEx(int state) const
+const QRegularExpression *XHTMLHighlighter::GetLeftBracketRegEx(int state) const
 {
-    QRegularExpression empty;
-
     switch (state) {
         case State_Entity:
-            return m_Rules.value("ENTITY_BEGIN").pattern;
+            return &RX_ENTITY_BEGIN;
 
         case State_HTML:
-            return m_Rules.value("HTML_ELEMENT_BEGIN").pattern;
+            return &RX_HTML_ELEMENT_BEGIN;
 
         case State_HTMLComment:
-            return m_Rules.value("HTML_COMMENT_BEGIN").pattern;
+            return &RX_HTML_COMMENT_BEGIN;
 
         case State_CSS:
-            return m_Rules.value("CSS_BEGIN").pattern;
+            return &RX_CSS_BEGIN;
 
         case State_CSSComment:
-            return m_Rules.value("CSS_COMMENT_BEGIN").pattern;
+            return &RX_CSS_COMMENT_BEGIN;
 
         case State_DOCTYPE:
-            return m_Rules.value("DOCTYPE_BEGIN").pattern;
+            return &RX_DOCTYPE_BEGIN;
 
         case State_SpSpace:
-            return m_Rules.value("SPECIAL_SPACE_BEGIN").pattern;
+            return &RX_SPECIAL_SPACE_BEGIN;
 
         default:
-            return empty;
+            return NULL;
     }
 }
 
 
 // Returns the regex that matches the right bracket of a state
-QRegularExpression XHTMLHighlighter::GetRightBracketRegEx(int state) const
+const QRegularExpression *XHTMLHighlighter::GetRightBracketRegEx(int state) const
 {
-    QRegularExpression empty;
-
     switch (state) {
         case State_Entity:
-            return m_Rules.value("ENTITY_END").pattern;
+            return &RX_ENTITY_END;
 
         case State_DOCTYPE:
         case State_HTML:
-            return m_Rules.value("HTML_ELEMENT_END").pattern;
+            return &RX_HTML_ELEMENT_END;
 
         case State_HTMLComment:
-            return m_Rules.value("HTML_COMMENT_END").pattern;
+            return &RX_HTML_COMMENT_END;
 
         case State_CSS:
-            return m_Rules.value("CSS_END").pattern;
+            return &RX_CSS_END;
 
         case State_CSSComment:
-            return m_Rules.value("CSS_COMMENT_END").pattern;
+            return &RX_CSS_COMMENT_END;
 
         default:
-            return empty;
+            return NULL;
     }
 }
 
@@ -299,24 +270,22 @@ void XHTMLHighlighter::FormatBody(const QString &text, int state, int index, int
 {
     if (state == State_HTML) {
         // First paint everything the color of the brackets
-        setFormat(index, length, m_Rules.value("HTML_ELEMENT_BEGIN").format);
-        QRegularExpression name  = m_Rules.value("ATTRIBUTE_NAME").pattern;
-        QRegularExpression value = m_Rules.value("ATTRIBUTE_VALUE").pattern;
+        setFormat(index, length, m_Formats[Format_HTML]);
         // Used to move over the line
         int main_index = index;
 
         // We skip over the left bracket (if it's present)
-        QRegularExpression bracket(HTML_ELEMENT_BEGIN);
-        QRegularExpressionMatch bracket_match = bracket.match(text, main_index);
-        if (bracket_match.hasMatch() && bracket_match.capturedStart() == main_index) {
+        QRegularExpressionMatch bracket_match = RX_HTML_ELEMENT_BEGIN.match(text, main_index,
+                QRegularExpression::NormalMatch, QRegularExpression::AnchorAtOffsetMatchOption);
+        if (bracket_match.hasMatch()) {
             main_index += bracket_match.capturedLength();
         }
 
         // We skip over the element name (if it's present)
         // because we want it to be the same color as the brackets
-        QRegularExpression elem_name(HTML_ELEMENT_NAME);
-        QRegularExpressionMatch elem_name_match = elem_name.match(text, main_index);
-        if (elem_name_match.hasMatch() && elem_name_match.capturedStart() == main_index) {
+        QRegularExpressionMatch elem_name_match = RX_HTML_ELEMENT_NAME.match(text, main_index,
+                QRegularExpression::NormalMatch, QRegularExpression::AnchorAtOffsetMatchOption);
+        if (elem_name_match.hasMatch()) {
             main_index += elem_name_match.capturedLength();
         }
 
@@ -324,7 +293,7 @@ void XHTMLHighlighter::FormatBody(const QString &text, int state, int index, int
             // Get the indexes of the attribute names and values
             int name_index = -1;
             int name_len = 0;
-            QRegularExpressionMatch name_match = name.match(text, main_index);
+            QRegularExpressionMatch name_match = RX_ATTRIBUTE_NAME.match(text, main_index);
             if (name_match.hasMatch()) {
                 name_index = name_match.capturedStart();
                 name_len = name_match.capturedLength();
@@ -332,7 +301,7 @@ void XHTMLHighlighter::FormatBody(const QString &text, int state, int index, int
 
             int value_index = -1;
             int value_len = 0;
-            QRegularExpressionMatch value_match = value.match(text, main_index);
+            QRegularExpressionMatch value_match = RX_ATTRIBUTE_VALUE.match(text, main_index);
             if (value_match.hasMatch()) {
                 value_index = value_match.capturedStart();
                 value_len = value_match.capturedLength();
@@ -343,8 +312,8 @@ void XHTMLHighlighter::FormatBody(const QString &text, int state, int index, int
             if (((name_index  != -1) && (name_index  < index + length)) ||
                 ((value_index != -1) && (value_index < index + length))) {
                 // ... otherwise format the found sections
-                setFormat(name_index,  name_len,  m_Rules.value("ATTRIBUTE_NAME").format);
-                setFormat(value_index, value_len, m_Rules.value("ATTRIBUTE_VALUE").format);
+                setFormat(name_index,  name_len,  m_Formats[Format_AttributeName]);
+                setFormat(value_index, value_len, m_Formats[Format_AttributeValue]);
             } else {
                 break;
             }
@@ -357,17 +326,17 @@ void XHTMLHighlighter::FormatBody(const QString &text, int state, int index, int
             }
         }
     } else if (state == State_HTMLComment) {
-        setFormat(index, length, m_Rules.value("HTML_COMMENT_BEGIN").format);
+        setFormat(index, length, m_Formats[Format_HTMLComment]);
     } else if (state == State_CSS) {
-        setFormat(index, length, m_Rules.value("CSS_BEGIN").format);
+        setFormat(index, length, m_Formats[Format_CSS]);
     } else if (state == State_CSSComment) {
-        setFormat(index, length, m_Rules.value("CSS_COMMENT_BEGIN").format);
+        setFormat(index, length, m_Formats[Format_CSSComment]);
     } else if (state == State_Entity) {
-        setFormat(index, length, m_Rules.value("ENTITY_BEGIN").format);
+        setFormat(index, length, m_Formats[Format_Entity]);
     } else if (state == State_SpSpace) {
-        setFormat(index, length, m_Rules.value("SPECIAL_SPACE_BEGIN").format);
+        setFormat(index, length, m_Formats[Format_SpSpace]);
     } else if (state == State_DOCTYPE) {
-        setFormat(index, length, m_Rules.value("DOCTYPE_BEGIN").format);
+        setFormat(index, length, m_Formats[Format_DOCTYPE]);
     }
 }
 
@@ -377,8 +346,8 @@ void XHTMLHighlighter::FormatBody(const QString &text, int state, int index, int
 // if it is, the node is formatted
 void XHTMLHighlighter::HighlightLine(const QString &text, int state)
 {
-    QRegularExpression left_bracket_regex  = GetLeftBracketRegEx(state);
-    QRegularExpression right_bracket_regex = GetRightBracketRegEx(state);
+    const QRegularExpression *left_bracket_regex  = GetLeftBracketRegEx(state);
+    const QRegularExpression *right_bracket_regex = GetRightBracketRegEx(state);
     int main_index = 0;
 
     // We loop over the line several times
@@ -389,16 +358,16 @@ void XHTMLHighlighter::HighlightLine(const QString &text, int state)
         int right_bracket_index = -1;
         int right_bracket_len = 0;
 
-        if (!left_bracket_regex.pattern().isEmpty()) {
-            QRegularExpressionMatch left_bracket_match = left_bracket_regex.match(text, main_index);
+        if (left_bracket_regex) {
+            QRegularExpressionMatch left_bracket_match = left_bracket_regex->match(text, main_index);
             if (left_bracket_match.hasMatch()) {
                 left_bracket_index = left_bracket_match.capturedStart();
                 left_bracket_len = left_bracket_match.capturedLength();
             }
         }
 
-        if (!right_bracket_regex.pattern().isEmpty()) {
-            QRegularExpressionMatch right_bracket_match = right_bracket_regex.match(text, main_index);
+        if (right_bracket_regex) {
+            QRegularExpressionMatch right_bracket_match = right_bracket_regex->match(text, main_index);
             if (right_bracket_match.hasMatch()) {
                 right_bracket_index = right_bracket_match.capturedStart();
                 right_bracket_len = right_bracket_match.capturedLength();
@@ -469,14 +438,8 @@ void XHTMLHighlighter::HighlightLine(const QString &text, int state)
 
 void XHTMLHighlighter::CheckSpelling(const QString &text)
 {
-    QTextCharFormat format;
-    format.setUnderlineColor(m_codeViewAppearance.spelling_underline_color);
-    // QTextCharFormat::SpellCheckUnderline has issues with Qt 5. It only displays
-    // at some zoom levels and often doesn't display at all. So we're using wave
-    // underline since it's good enough for most people.
-    format.setUnderlineStyle(QTextCharFormat::WaveUnderline);
     QList<HTMLSpellCheck::MisspelledWord> misspelled_words = HTMLSpellCheck::GetMisspelledWords(text);
     foreach(HTMLSpellCheck::MisspelledWord misspelled_word, misspelled_words) {
-        setFormat(misspelled_word.offset, misspelled_word.length, format);
+        setFormat(misspelled_word.offset, misspelled_word.length, m_Formats[Format_Spelling]);
     }
 }
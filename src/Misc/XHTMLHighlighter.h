@@ -52,10 +52,10 @@ protected:
 private:
 
     // Returns the regex that matches the left bracket of a state
-    QRegularExpression GetLeftBracketRegEx(int state) const;
+    const QRegularExpression *GetLeftBracketRegEx(int state) const;
 
     // Returns the regex that matches the right bracket of a state
-    QRegularExpression GetRightBracketRegEx(int state) const;
+    const QRegularExpression *GetRightBracketRegEx(int state) const;
 
     // Sets the requested state for the current text block
     void SetState(int state);
@@ -98,18 +98,30 @@ private:
         State_DOCTYPE       = 1 << 7
     };
 
-    struct HighlightingRule {
-        QRegularExpression pattern;
-        QTextCharFormat format;
+    enum FormatType {
+        Format_DOCTYPE = 0,
+        Format_HTML,
+        Format_HTMLComment,
+        Format_CSS,
+        Format_CSSComment,
+        Format_AttributeName,
+        Format_AttributeValue,
+        Format_Entity,
+        Format_SpSpace,
+        Format_Spelling,
+        Format_Count
     };
 
-    // Stores all of our highlighting rules
-    // and the text formats used
-    QHash<QString, HighlightingRule> m_Rules;
+    // The text formats used, the expressions
+    // themselves are shared by all highlighters
+    QTextCharFormat m_Formats[Format_Count];
 
     // Determine if spell check should be used on the document.
     bool m_checkSpelling;
 
+    // The spell check setting as of the last SetRules
+    bool m_enableSpellCheck;
+
     SettingsStore::CodeViewAppearance m_codeViewAppearance;
 };
 
@@ -30,6 +30,7 @@
 #include "Misc/SpellCheck.h"
 #include "Misc/Utility.h"
 #include "Misc/HTMLSpellCheck.h"
+#include "Misc/BackgroundSpellCheck.h"
 #include "Misc/SettingsStore.h"
 #include "Misc/XHTMLHighlighter2.h"
 #include "sigil_constants.h"
@@ -64,7 +65,15 @@ static const int State_CSSComment     = 19;
 
 
 static const QString CSS_BEGIN              = "<\\s*style[^>]*>";
-static const QRegularExpression RXCSSBegin(CSS_BEGIN);
+
+// optimize() compiles it up front rather than on its first match
+static QRegularExpression CompiledRegex(const QString &pattern)
+{
+    QRegularExpression regex(pattern);
+    regex.optimize();
+    return regex;
+}
+static const QRegularExpression RXCSSBegin = CompiledRegex(CSS_BEGIN);
 
 // Special Spaces
 // "[\\x{00A0}\\x{2000}-\\x{200A}\\x{202F}\\x{3000}]+";
@@ -80,54 +89,48 @@ static const QString WHITESPACE = " \f\t\r\n";
 // Constructor
 XHTMLHighlighter2::XHTMLHighlighter2(bool checkSpelling, QObject *parent)
     : QSyntaxHighlighter(parent),
-      m_checkSpelling(checkSpelling)
-
+      m_checkSpelling(checkSpelling),
+      m_BackgroundSpellCheck(new BackgroundSpellCheck(this)),
+      m_firstHighlightedBlock(-1),
+      m_lastHighlightedBlock(-1)
 {
     SetRules();
 }
 
 void XHTMLHighlighter2::SetRules()
 {
-    m_Rules.clear();
-
     SettingsStore settings;
     if (Utility::IsDarkMode()) {
         m_codeViewAppearance = settings.codeViewDarkAppearance();
     } else {
         m_codeViewAppearance = settings.codeViewAppearance();
     }
+    m_enableSpellCheck = settings.spellCheck();
 
-    QTextCharFormat html_format;
-    QTextCharFormat doctype_format;
-    QTextCharFormat html_comment_format;
-    QTextCharFormat css_format;
-    QTextCharFormat css_comment_format;
-    QTextCharFormat attribute_name_format;
-    QTextCharFormat attribute_value_format;
-    QTextCharFormat entity_format;
-    QTextCharFormat special_space_format;
-
-    doctype_format        .setForeground(m_codeViewAppearance.xhtml_doctype_color);
-    html_format           .setForeground(m_codeViewAppearance.xhtml_html_color);
-    html_comment_format   .setForeground(m_codeViewAppearance.xhtml_html_comment_color);
-    css_format            .setForeground(m_codeViewAppearance.xhtml_css_color);
-    css_comment_format    .setForeground(m_codeViewAppearance.xhtml_css_comment_color);
-    attribute_name_format .setForeground(m_codeViewAppearance.xhtml_attribute_name_color);
-    attribute_value_format.setForeground(m_codeViewAppearance.xhtml_attribute_value_color);
-    entity_format         .setForeground(m_codeViewAppearance.xhtml_entity_color);
-    special_space_format  .setUnderlineColor(m_codeViewAppearance.xhtml_entity_color);
-    special_space_format  .setUnderlineStyle(QTextCharFormat::DashUnderline);
-
-    m_Rules["doctype"] = doctype_format;
-    m_Rules["tagname"] = html_format;
-    m_Rules["comment"] = html_comment_format;
-    m_Rules["css"] = css_format;
-    m_Rules["css_comment"] = css_comment_format;
-    m_Rules["attname"] = attribute_name_format;
-    m_Rules["attvalue"] = attribute_value_format;
-    m_Rules["entity"] = entity_format;
-    m_Rules["spspace"] = special_space_format;    
+    for (int i = 0; i < Format_Count; i++) {
+        m_Formats[i] = QTextCharFormat();
+    }
+    m_Formats[Format_DOCTYPE]    .setForeground(m_codeViewAppearance.xhtml_doctype_color);
+    m_Formats[Format_TagName]    .setForeground(m_codeViewAppearance.xhtml_html_color);
+    m_Formats[Format_Comment]    .setForeground(m_codeViewAppearance.xhtml_html_comment_color);
+    m_Formats[Format_CSS]        .setForeground(m_codeViewAppearance.xhtml_css_color);
+    m_Formats[Format_CSSComment] .setForeground(m_codeViewAppearance.xhtml_css_comment_color);
+    m_Formats[Format_AttName]    .setForeground(m_codeViewAppearance.xhtml_attribute_name_color);
+    m_Formats[Format_AttValue]   .setForeground(m_codeViewAppearance.xhtml_attribute_value_color);
+    m_Formats[Format_Entity]     .setForeground(m_codeViewAppearance.xhtml_entity_color);
+    m_Formats[Format_SpSpace]    .setUnderlineColor(m_codeViewAppearance.xhtml_entity_color);
+    m_Formats[Format_SpSpace]    .setUnderlineStyle(QTextCharFormat::DashUnderline);
+    m_Formats[Format_Spelling]   .setUnderlineColor(m_codeViewAppearance.spelling_underline_color);
+    // QTextCharFormat::SpellCheckUnderline has issues with Qt 5. It only displays
+    // at some zoom levels and often doesn't display at all. So we're using wave
+    // underline since it's good enough for most people.
+    m_Formats[Format_Spelling]   .setUnderlineStyle(QTextCharFormat::WaveUnderline);
+}
 
+void XHTMLHighlighter2::SetHighlightedBlocks(int first, int last)
+{
+    m_firstHighlightedBlock = first;
+    m_lastHighlightedBlock = last;
 }
 
 // Overrides the function from QSyntaxHighlighter;
@@ -135,6 +138,14 @@ void XHTMLHighlighter2::SetRules()
 // a block (line of text) needs to be repainted
 void XHTMLHighlighter2::highlightBlock(const QString &text)
 {
+    if (m_firstHighlightedBlock >= 0) {
+        int block_number = currentBlock().blockNumber();
+        if ((block_number < m_firstHighlightedBlock) || (block_number > m_lastHighlightedBlock)) {
+            setCurrentBlockState(State_Text);
+            return;
+        }
+    }
+
     // By default, all block states are -1;
     // in our implementation regular text is state == 1
     int state = previousBlockState();
@@ -145,9 +156,7 @@ void XHTMLHighlighter2::highlightBlock(const QString &text)
     QChar ch;
 
     // Run spell check over the text if needed first.
-    SettingsStore settings;
-    bool enableSpellCheck = settings.spellCheck();
-    if (enableSpellCheck && m_checkSpelling) {
+    if (m_enableSpellCheck && m_checkSpelling) {
         CheckSpelling(text);
     }
 
@@ -169,7 +178,7 @@ void XHTMLHighlighter2::highlightBlock(const QString &text)
                         break;
                     } else pos++;
                 } 
-                setFormat(start, pos-start, m_Rules["comment"]);
+                setFormat(start, pos-start, m_Formats[Format_Comment]);
                 break;
             }
 
@@ -184,7 +193,7 @@ void XHTMLHighlighter2::highlightBlock(const QString &text)
                         break;
                     }
                 }
-                setFormat(start, pos - start, m_Rules["doctype"]);
+                setFormat(start, pos - start, m_Formats[Format_DOCTYPE]);
                 break;
                 
             }
@@ -233,7 +242,7 @@ void XHTMLHighlighter2::highlightBlock(const QString &text)
                         break;
                     }
                 }
-                setFormat(start, pos - start, m_Rules["tagname"]);
+                setFormat(start, pos - start, m_Formats[Format_TagName]);
                 break;
             }
             
@@ -250,7 +259,7 @@ void XHTMLHighlighter2::highlightBlock(const QString &text)
                     if (ch == '>') {
                         if (state == State_CSSInsideTag) nstate = State_CSS;
                         if (state == State_InsideTag) nstate = State_Text;
-                        setFormat(pos-1, 1, m_Rules["tagname"]);
+                        setFormat(pos-1, 1, m_Formats[Format_TagName]);
                         break;
                     }
                     if (!WHITESPACE.contains(ch)) {
@@ -287,7 +296,7 @@ void XHTMLHighlighter2::highlightBlock(const QString &text)
                         break;
                     }
                 }
-                setFormat(start, pos - start, m_Rules["attname"]);
+                setFormat(start, pos - start, m_Formats[Format_AttName]);
                 break;
             }
 
@@ -304,14 +313,14 @@ void XHTMLHighlighter2::highlightBlock(const QString &text)
                     if (ch == '\'') {
                         if (state == State_CSSAttValue) nstate = State_CSSSingleQuote;
                         if (state == State_AttValue) nstate = State_SingleQuote;
-                        setFormat(pos - 1, 1, m_Rules["attvalue"]);
+                        setFormat(pos - 1, 1, m_Formats[Format_AttValue]);
                         break;
                     }   
                     // handle opening double quote
                     if (ch == '"') {
                         if (state == State_CSSAttValue) nstate = State_CSSDoubleQuote;
                         if (state == State_AttValue) nstate = State_DoubleQuote;
-                        setFormat(pos - 1, 1, m_Rules["attvalue"]);
+                        setFormat(pos - 1, 1, m_Formats[Format_AttValue]);
                         break;
                     }
                     if (ch != ' ') {
@@ -334,7 +343,7 @@ void XHTMLHighlighter2::highlightBlock(const QString &text)
                     }
                     if (state == State_CSSAttValue) nstate = State_CSSInsideTag;
                     if (state == State_AttValue) nstate = State_InsideTag;
-                    setFormat(start, pos - start, m_Rules["attvalue"]);
+                    setFormat(start, pos - start, m_Formats[Format_AttValue]);
                 }
                 break;
             }
@@ -353,7 +362,7 @@ void XHTMLHighlighter2::highlightBlock(const QString &text)
                 }
                 if (state == State_CSSSingleQuote) nstate = State_CSSInsideTag;
                 if (state == State_SingleQuote) nstate = State_InsideTag;
-                setFormat(start, pos - start, m_Rules["attvalue"]);
+                setFormat(start, pos - start, m_Formats[Format_AttValue]);
                 break;
             }
 
@@ -371,7 +380,7 @@ void XHTMLHighlighter2::highlightBlock(const QString &text)
                 }
                 if (state == State_CSSDoubleQuote) nstate = State_CSSInsideTag;
                 if (state == State_DoubleQuote) nstate = State_InsideTag;
-                setFormat(start, pos - start, m_Rules["attvalue"]);
+                setFormat(start, pos - start, m_Formats[Format_AttValue]);
                 break;
             }
 
@@ -392,7 +401,7 @@ void XHTMLHighlighter2::highlightBlock(const QString &text)
                     }
                     pos++;
                 } 
-                setFormat(start, pos-start, m_Rules["css"]);
+                setFormat(start, pos-start, m_Formats[Format_CSS]);
                 break;
             }
 
@@ -407,7 +416,7 @@ void XHTMLHighlighter2::highlightBlock(const QString &text)
                         break;
                     } else pos++;
                 } 
-                setFormat(start, pos-start, m_Rules["css_comment"]);
+                setFormat(start, pos-start, m_Formats[Format_CSSComment]);
                 break;
             }
 
@@ -427,7 +436,8 @@ void XHTMLHighlighter2::highlightBlock(const QString &text)
                             DBG qDebug() << " found a doctype";
                             nstate = State_DOCTYPE;
                         }
-                        else if (text.indexOf(RXCSSBegin, pos) == pos) {
+                        else if (RXCSSBegin.match(text, pos, QRegularExpression::NormalMatch,
+                                                  QRegularExpression::AnchorAtOffsetMatchOption).hasMatch()) {
                             DBG qDebug() << " found a style";
                             nstate = State_CSSTagStart;
                         } else {
@@ -440,9 +450,9 @@ void XHTMLHighlighter2::highlightBlock(const QString &text)
                         while (pos < n && text[pos] != ';') {
                             pos++;
                         }
-                        setFormat(start, pos - start, m_Rules["entity"]);
+                        setFormat(start, pos - start, m_Formats[Format_Entity]);
                     } else if (SPECIAL_SPACES.contains(ch)) {
-                        setFormat(pos, 1, m_Rules["spspace"]);
+                        setFormat(pos, 1, m_Formats[Format_SpSpace]);
                         pos ++;
                     } else {
                         pos++;
@@ -470,16 +480,21 @@ void XHTMLHighlighter2::do_rehighlight()
 }
 
 
+// Only verdicts already in the SpellCheck cache are used here.  The
+// other words are checked in the background and this block is then
+// highlighted again, so typing never waits on Hunspell.
 void XHTMLHighlighter2::CheckSpelling(const QString &text)
 {
-    QTextCharFormat format;
-    format.setUnderlineColor(m_codeViewAppearance.spelling_underline_color);
-    // QTextCharFormat::SpellCheckUnderline has issues with Qt 5. It only displays
-    // at some zoom levels and often doesn't display at all. So we're using wave
-    // underline since it's good enough for most people.
-    format.setUnderlineStyle(QTextCharFormat::WaveUnderline);
-    QList<HTMLSpellCheck::MisspelledWord> misspelled_words = HTMLSpellCheck::GetMisspelledWords(text);
-    foreach(HTMLSpellCheck::MisspelledWord misspelled_word, misspelled_words) {
-        setFormat(misspelled_word.offset, misspelled_word.length, format);
+    SpellCheck *sc = SpellCheck::instance();
+    QStringList unchecked_words;
+    QList<HTMLSpellCheck::MisspelledWord> words = HTMLSpellCheck::GetMisspelledWords(text, 0, text.length(), "", false, true);
+    foreach(HTMLSpellCheck::MisspelledWord word, words) {
+        bool correct = true;
+        if (!sc->cachedSpellPS(word.text, correct)) {
+            unchecked_words << word.text;
+        } else if (!correct) {
+            setFormat(word.offset, word.length, m_Formats[Format_Spelling]);
+        }
     }
+    m_BackgroundSpellCheck->Queue(currentBlock(), unchecked_words);
 }
@@ -30,6 +30,7 @@
 #include "Misc/SettingsStore.h"
 
 class QTextDocument;
+class BackgroundSpellCheck;
 
 class XHTMLHighlighter2 : public QSyntaxHighlighter
 {
@@ -44,6 +45,14 @@ public:
 
     void SetRules();
 
+    /**
+     * Limits highlighting to the blocks numbered first to last.  The
+     * other blocks are left plain and the block after them is parsed
+     * as if it started in text.  A first of -1 highlights every
+     * block again.
+     */
+    void SetHighlightedBlocks(int first, int last);
+
 protected:
 
     // Overrides the function from QSyntaxHighlighter;
@@ -60,11 +69,33 @@ private:
     // PRIVATE MEMBER VARIABLES
     ///////////////////////////////
 
-    QHash<QString, QTextCharFormat> m_Rules;
+    enum FormatType {
+        Format_DOCTYPE = 0,
+        Format_TagName,
+        Format_Comment,
+        Format_CSS,
+        Format_CSSComment,
+        Format_AttName,
+        Format_AttValue,
+        Format_Entity,
+        Format_SpSpace,
+        Format_Spelling,
+        Format_Count
+    };
+
+    QTextCharFormat m_Formats[Format_Count];
 
     // Determine if spell check should be used on the document.
     bool m_checkSpelling;
 
+    // The spell check setting as of the last SetRules
+    bool m_enableSpellCheck;
+
+    BackgroundSpellCheck *m_BackgroundSpellCheck;
+
+    int m_firstHighlightedBlock;
+    int m_lastHighlightedBlock;
+
     SettingsStore::CodeViewAppearance m_codeViewAppearance;
 };
 
@@ -35,6 +35,10 @@
 
 static const QString SETTINGS_FILE = CLIPS_V6_SETTINGS_FILE;
 
+// Tidy the group separators of the names read in
+static const QRegularExpression GROUP_SEPARATOR("\\s*/+\\s*");
+static const QRegularExpression LEADING_SEPARATOR("^/");
+
 static const QString SETTINGS_GROUP         = "clip_entries";
 static const QString ENTRY_NAME             = "Name";
 static const QString ENTRY_TEXT             = "Text";
@@ -60,16 +64,21 @@ ClipEditorModel *ClipEditorModel::instance()
 ClipEditorModel::ClipEditorModel(QObject *parent)
     : QStandardItemModel(parent),
       m_FSWatcher(new QFileSystemWatcher()),
-      m_IsDataModified(false)
+      m_IsDataModified(false),
+      m_Loading(false)
 {
     m_SettingsPath = Utility::DefinePrefsDir() + "/" + SETTINGS_FILE;
     QStringList header;
     header.append(tr("Name"));
     header.append(tr("Text"));
     setHorizontalHeaderLabels(header);
+    bool have_file = QFile::exists(m_SettingsPath);
     LoadInitialData();
-    // Save it to make sure we have a file in case it was loaded from examples
-    SaveData();
+    // Save it to make sure we have a file in case it was loaded from examples,
+    // writing out every entry again when the file is already there is wasted
+    if (!have_file) {
+        SaveData();
+    }
 
     if (!m_FSWatcher->files().contains(m_SettingsPath)) {
         m_FSWatcher->addPath(m_SettingsPath);
@@ -338,14 +347,15 @@ void ClipEditorModel::LoadData(const QString &filename, QStandardItem *item)
     SettingsStore ss(settings_path);
 
     int size = ss.beginReadArray(SETTINGS_GROUP);
+    m_Loading = true;
 
     // Add one entry at a time to the list
     for (int i = 0; i < size; ++i) {
         ss.setArrayIndex(i);
         ClipEditorModel::clipEntry *entry = new ClipEditorModel::clipEntry();
         QString fullname = ss.value(ENTRY_NAME).toString();
-        fullname.replace(QRegularExpression("\\s*/+\\s*"), "/");
-        fullname.replace(QRegularExpression("^/"), "");
+        fullname.replace(GROUP_SEPARATOR, "/");
+        fullname.replace(LEADING_SEPARATOR, "");
         entry->is_group = fullname.endsWith("/");
         // Name is set to fullname only while looping through parent groups when adding
         entry->name = fullname;
@@ -355,6 +365,8 @@ void ClipEditorModel::LoadData(const QString &filename, QStandardItem *item)
         delete entry;
     }
     ss.endArray();
+    m_Loading = false;
+    m_LoadedGroups.clear();
 }
 
 void ClipEditorModel::AddFullNameEntry(ClipEditorModel::clipEntry *entry, QStandardItem *parent_item, int row)
@@ -383,21 +395,19 @@ void ClipEditorModel::AddFullNameEntry(ClipEditorModel::clipEntry *entry, QStand
         }
 
         foreach(QString group_name, group_names) {
-            bool found = false;
-
-            for (int r = 0; r < parent_item->rowCount(); r++) {
-                if (parent_item->child(r, 0)->data(IS_GROUP_ROLE).toBool() && parent_item->child(r, 0)->text() == group_name) {
-                    parent_item = parent_item->child(r, 0);
-                    found = true;
-                    break;
-                }
-            }
+            QStandardItem *group_item = FindGroup(parent_item, group_name);
 
-            if (!found) {
+            if (group_item) {
+                parent_item = group_item;
+            } else {
+                QStandardItem *group_parent = parent_item;
                 ClipEditorModel::clipEntry *new_entry = new ClipEditorModel::clipEntry();
                 new_entry->is_group = true;
                 new_entry->name = group_name;
                 parent_item = AddEntryToModel(new_entry, new_entry->is_group, parent_item, parent_item->rowCount());
+                if (m_Loading) {
+                    m_LoadedGroups[group_parent].insert(group_name, parent_item);
+                }
                 // fix memory leak
                 delete new_entry;
             }
@@ -411,6 +421,32 @@ void ClipEditorModel::AddFullNameEntry(ClipEditorModel::clipEntry *entry, QStand
     }
 }
 
+QStandardItem *ClipEditorModel::FindGroup(QStandardItem *parent_item, const QString &group_name)
+{
+    if (m_Loading) {
+        // Each group is scanned once per load, not once per entry read
+        QHash<QStandardItem *, QHash<QString, QStandardItem *>>::iterator it = m_LoadedGroups.find(parent_item);
+        if (it == m_LoadedGroups.end()) {
+            QHash<QString, QStandardItem *> groups;
+            for (int r = 0; r < parent_item->rowCount(); r++) {
+                QStandardItem *child = parent_item->child(r, 0);
+                if (child->data(IS_GROUP_ROLE).toBool() && !groups.contains(child->text())) {
+                    groups.insert(child->text(), child);
+                }
+            }
+            it = m_LoadedGroups.insert(parent_item, groups);
+        }
+        return it->value(group_name, NULL);
+    }
+
+    for (int r = 0; r < parent_item->rowCount(); r++) {
+        if (parent_item->child(r, 0)->data(IS_GROUP_ROLE).toBool() && parent_item->child(r, 0)->text() == group_name) {
+            return parent_item->child(r, 0);
+        }
+    }
+    return NULL;
+}
+
 QStandardItem *ClipEditorModel::AddEntryToModel(ClipEditorModel::clipEntry *entry, bool is_group, QStandardItem *parent_item, int row)
 {
     // parent_item must be a group item
@@ -26,6 +26,7 @@
 #ifndef CLIPEDITORMODEL_H
 #define CLIPEDITORMODEL_H
 
+#include <QtCore/QHash>
 #include <QtGui/QStandardItemModel>
 #include <QFileSystemWatcher>
 #include <QDropEvent>
@@ -102,6 +103,9 @@ private:
 
     QStandardItem *GetItemFromId(quintptr id, int row, QStandardItem *item = NULL) const;
 
+    // The group of that name directly under parent_item, if any
+    QStandardItem *FindGroup(QStandardItem *parent_item, const QString &group_name);
+
     QStandardItem *GetItemFromNumber(int clip_number);
 
     void AddExampleEntries();
@@ -113,6 +117,11 @@ private:
     QFileSystemWatcher *m_FSWatcher;
 
     bool m_IsDataModified;
+
+    // While a file is being read in, the groups already found under
+    // each parent by name, so entries are not matched by scanning
+    bool m_Loading;
+    QHash<QStandardItem *, QHash<QString, QStandardItem *>> m_LoadedGroups;
 };
 
 #endif // CLIPEDITORMODEL_H
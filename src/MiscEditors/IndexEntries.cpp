@@ -21,95 +21,120 @@
 **
 *************************************************************************/
 
-#include "Misc/Utility.h"
-#include "MiscEditors/IndexEntries.h"
-#include "MiscEditors/IndexEditorModel.h"
-
-IndexEntries *IndexEntries::m_instance = 0;
+#include <algorithm>
 
-IndexEntries *IndexEntries::instance()
-{
-    if (m_instance == 0) {
-        m_instance = new IndexEntries();
-    }
+#include <QCollator>
 
-    return m_instance;
-}
+#include "Misc/Utility.h"
+#include "MiscEditors/IndexEntries.h"
 
 IndexEntries::IndexEntries()
     :
-    m_BookIndexRootItem(new QStandardItem())
+    m_BookIndexRootItem(new QStandardItem()),
+    m_TreeBuilt(true)
 {
 }
 
 IndexEntries::~IndexEntries()
 {
-    if (m_instance) {
-        delete m_instance;
-        m_instance = 0;
-    }
+    delete m_BookIndexRootItem;
 }
 
 QStandardItem *IndexEntries::GetRootItem()
 {
+    if (!m_TreeBuilt) {
+        BuildTree();
+    }
     return m_BookIndexRootItem;
 }
 
 void IndexEntries::AddOneEntry(QString text, QString bookpath, QString index_id_value)
 {
-    QStandardItem *parent_item = m_BookIndexRootItem;
-    QStringList names = text.split("/", Qt::SkipEmptyParts);
-    names.append(Utility::URLEncodePath(bookpath) + "#" +  Utility::URLEncodePath(index_id_value));
-    // Add names in hierarchy
-    foreach(QString name, names) {
-        bool found = false;
-        int insert_at_row = -1;
+    Entry entry;
+    foreach(QString name, text.split("/", Qt::SkipEmptyParts)) {
+        entry.names.append(InternName(name));
+    }
+    entry.target = Utility::URLEncodePath(bookpath) + "#" +  Utility::URLEncodePath(index_id_value);
+    m_Entries.append(entry);
+    m_TreeBuilt = false;
+}
 
-        for (int r = 0; r < parent_item->rowCount(); r++) {
-            if (name == parent_item->child(r, 0)->text()) {
-                parent_item = parent_item->child(r, 0);
-                found = true;
-                break;
-            }
-            // If not already in tree, add the entry in sorted order
-            // Only sort categories - leave bookpath#id (last child) in order found
-            else if (parent_item->child(0, 0)->rowCount() && (name.toLower().localeAwareCompare(parent_item->child(r, 0)->text().toLower()) < 0)) {
-                insert_at_row = r ;
-                break;
-            }
-        }
 
-        if (!found) {
-            parent_item = AddEntryToModel(name, parent_item, insert_at_row);
-        }
+int IndexEntries::InternName(const QString &name)
+{
+    int id = m_NameIds.value(name, -1);
+    if (id == -1) {
+        id = m_Names.count();
+        m_Names.append(name);
+        m_NameIds.insert(name, id);
     }
+    return id;
 }
 
 
-QStandardItem *IndexEntries::AddEntryToModel(QString entry, QStandardItem *parent_item, int row)
+void IndexEntries::BuildTree()
 {
-    if (!parent_item) {
-        parent_item = m_BookIndexRootItem;
+    while (m_BookIndexRootItem->rowCount()) {
+        m_BookIndexRootItem->removeRow(0);
     }
 
-    QList<QStandardItem *> rowItems;
-    rowItems << new QStandardItem(entry);
-    // Append or insert the item into the model as needed
-    QStandardItem *new_item;
-
-    if (row < 0 || row >= parent_item->rowCount()) {
-        parent_item->appendRow(rowItems);
-        new_item = parent_item->child(parent_item->rowCount() - 1, 0);
-    } else {
-        parent_item->insertRow(row, rowItems);
-        new_item = parent_item->child(row, 0);
+    // Rank every name once, in locale aware order ignoring case.
+    // Names that collate the same keep the order they were first seen.
+    QCollator collator;
+    QList<QCollatorSortKey> keys;
+    keys.reserve(m_Names.count());
+    QList<int> order;
+    order.reserve(m_Names.count());
+    for (int i = 0; i < m_Names.count(); i++) {
+        keys.append(collator.sortKey(m_Names.at(i).toLower()));
+        order.append(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&keys](int a, int b) {
+        return keys.at(a).compare(keys.at(b)) < 0;
+    });
+    QList<int> rank(m_Names.count());
+    for (int i = 0; i < order.count(); i++) {
+        rank[order.at(i)] = i;
     }
 
-    return new_item;
+    // Only categories are sorted, the targets of each one stay in the
+    // order found, so the sort must be stable
+    std::stable_sort(m_Entries.begin(), m_Entries.end(), [&rank](const Entry &a, const Entry &b) {
+        return std::lexicographical_compare(a.names.begin(), a.names.end(), b.names.begin(), b.names.end(),
+                                            [&rank](int x, int y) { return rank.at(x) < rank.at(y); });
+    });
+
+    // Each entry shares the start of its path with the entry before it
+    // so the items of that path are all that needs to be kept
+    QList<int> path;
+    QList<QStandardItem *> items;
+    foreach(const Entry &entry, m_Entries) {
+        int common = 0;
+        while ((common < path.count()) && (common < entry.names.count()) &&
+               (path.at(common) == entry.names.at(common))) {
+            common++;
+        }
+        path = path.mid(0, common);
+        items = items.mid(0, common);
+        for (int i = common; i < entry.names.count(); i++) {
+            QStandardItem *parent_item = items.isEmpty() ? m_BookIndexRootItem : items.last();
+            QStandardItem *item = new QStandardItem(m_Names.at(entry.names.at(i)));
+            parent_item->appendRow(item);
+            path.append(entry.names.at(i));
+            items.append(item);
+        }
+        QStandardItem *parent_item = items.isEmpty() ? m_BookIndexRootItem : items.last();
+        parent_item->appendRow(new QStandardItem(entry.target));
+    }
+    m_TreeBuilt = true;
 }
 
 void IndexEntries::Clear()
 {
+    m_Entries.clear();
+    m_Names.clear();
+    m_NameIds.clear();
+    m_TreeBuilt = true;
     while (m_BookIndexRootItem->rowCount()) {
         m_BookIndexRootItem->removeRow(0);
     }
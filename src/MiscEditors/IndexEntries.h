@@ -25,16 +25,26 @@
 #ifndef INDEXENTRIES_H
 #define INDEXENTRIES_H
 
+#include <QHash>
+#include <QList>
 #include <QStandardItem>
+#include <QStringList>
 
 /**
  *   Holds the Index entries to put into the Index
+ *
+ *   Each index built has its own entries, so books can be
+ *   indexed side by side.
+ *
+ *   Entries are only collected as they are added.  The tree of
+ *   them is built in one pass, after they have been sorted once,
+ *   when it is next asked for.
  */
 class IndexEntries
 {
 
 public:
-    static IndexEntries *instance();
+    IndexEntries();
     ~IndexEntries();
 
     void Clear();
@@ -44,13 +54,26 @@ public:
     void AddOneEntry(QString text, QString bookpath, QString index_id_value);
 
 private:
-    IndexEntries();
+    struct Entry {
+        // indexes into m_Names of each level of the entry
+        QList<int> names;
+        QString target;
+    };
 
-    QStandardItem *AddEntryToModel(QString entry, QStandardItem *parent_item, int row);
+    int InternName(const QString &name);
+    void BuildTree();
 
     QStandardItem *m_BookIndexRootItem;
 
-    static IndexEntries *m_instance;
+    QList<Entry> m_Entries;
+
+    // whether the tree has every entry
+    bool m_TreeBuilt;
+
+    // every name used at any level, each stored once in the
+    // order first seen
+    QStringList m_Names;
+    QHash<QString, int> m_NameIds;
 };
 
 #endif // INDEXENTRIES_H
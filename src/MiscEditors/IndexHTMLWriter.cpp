@@ -55,11 +55,12 @@ static const QString TEMPLATE_END_TEXT =
     "</html>\n";
 
 
-IndexHTMLWriter::IndexHTMLWriter(const QString &index_bookpath, const QString &css_bookpath)
+IndexHTMLWriter::IndexHTMLWriter(const QString &index_bookpath, const QString &css_bookpath, IndexEntries *index_entries)
     :
     m_IndexHTMLFile(QString()),
     m_IndexBookPath(index_bookpath),
-    m_CSSBookPath(css_bookpath)
+    m_CSSBookPath(css_bookpath),
+    m_IndexEntries(index_entries)
 {
 }
 
@@ -83,7 +84,7 @@ QString IndexHTMLWriter::WriteXML(const QString &version)
 
 void IndexHTMLWriter::WriteEntries(QStandardItem *parent_item)
 {
-    QStandardItem *root_item = IndexEntries::instance()->GetRootItem();
+    QStandardItem *root_item = m_IndexEntries->GetRootItem();
 
     if (!parent_item) {
         parent_item = root_item;
@@ -25,13 +25,15 @@
 
 #include <QStandardItem>
 
+class IndexEntries;
+
 /**
  * Writes the Index into an HTML file of the EPUB publication.
  */
 class IndexHTMLWriter
 {
 public:
-    IndexHTMLWriter(const QString &index_bookpath, const QString &css_bookpath);
+    IndexHTMLWriter(const QString &index_bookpath, const QString &css_bookpath, IndexEntries *index_entries);
 
     QString WriteXML(const QString &version);
 
@@ -42,6 +44,8 @@ private:
 
     QString m_IndexBookPath;
     QString m_CSSBookPath;
+
+    IndexEntries *m_IndexEntries;
 };
 
 #endif // INDEXWRITER_H
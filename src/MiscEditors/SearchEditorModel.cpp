@@ -38,6 +38,10 @@
 
 static const QString SETTINGS_FILE = SEARCHES_V6_SETTINGS_FILE;
 
+// Tidy the group separators of the names read in
+static const QRegularExpression GROUP_SEPARATOR("\\s*/+\\s*");
+static const QRegularExpression LEADING_SEPARATOR("^/");
+
 static const QString SETTINGS_GROUP         = "search_entries";
 static const QString ENTRY_NAME             = "Name";
 static const QString ENTRY_FIND             = "Find";
@@ -65,7 +69,8 @@ SearchEditorModel *SearchEditorModel::instance()
 SearchEditorModel::SearchEditorModel(QObject *parent)
     : QStandardItemModel(parent),
       m_FSWatcher(new QFileSystemWatcher()),
-      m_IsDataModified(false)
+      m_IsDataModified(false),
+      m_Loading(false)
 {
     m_SettingsPath = Utility::DefinePrefsDir() + "/" + SETTINGS_FILE;
     QStringList header;
@@ -74,9 +79,13 @@ SearchEditorModel::SearchEditorModel(QObject *parent)
     header.append(tr("Replace"));
     header.append(tr("Controls"));
     setHorizontalHeaderLabels(header);
+    bool have_file = QFile::exists(m_SettingsPath);
     LoadInitialData();
-    // Save it to make sure we have a file in case it was loaded from examples
-    SaveData();
+    // Save it to make sure we have a file in case it was loaded from examples,
+    // writing out every entry again when the file is already there is wasted
+    if (!have_file) {
+        SaveData();
+    }
 
     if (!m_FSWatcher->files().contains(m_SettingsPath)) {
         m_FSWatcher->addPath(m_SettingsPath);
@@ -159,11 +168,6 @@ void SearchEditorModel::ItemChangedHandler(QStandardItem *item)
 {
     Q_ASSERT(item);
 
-    if (item->column() == 3) {
-        QString controls = item->text();
-        item->setToolTip(BuildControlsToolTip(controls));
-    }
-
     if (item->column() != 0) {
         SetDataModified(true);
         return;
@@ -312,14 +316,15 @@ void SearchEditorModel::LoadData(const QString &filename, QStandardItem *item)
     SettingsStore ss(settings_path);
 
     int size = ss.beginReadArray(SETTINGS_GROUP);
+    m_Loading = true;
 
     // Add one entry at a time to the list
     for (int i = 0; i < size; ++i) {
         ss.setArrayIndex(i);
         SearchEditorModel::searchEntry *entry = new SearchEditorModel::searchEntry();
         QString fullname = ss.value(ENTRY_NAME).toString();
-        fullname.replace(QRegularExpression("\\s*/+\\s*"), "/");
-        fullname.replace(QRegularExpression("^/"), "");
+        fullname.replace(GROUP_SEPARATOR, "/");
+        fullname.replace(LEADING_SEPARATOR, "");
         entry->is_group = fullname.endsWith("/");
         // Name is set to fullname only while looping through parent groups when adding
         entry->name = fullname;
@@ -332,6 +337,8 @@ void SearchEditorModel::LoadData(const QString &filename, QStandardItem *item)
         delete entry;
     }
     ss.endArray();
+    m_Loading = false;
+    m_LoadedGroups.clear();
 }
 
 
@@ -341,6 +348,7 @@ void SearchEditorModel::LoadTextData(const QString &filename, QStandardItem *ite
     QString groupname = fi.fileName() + "/";
     int cnt = 1;
     if (fi.exists()) {
+        m_Loading = true;
         QString data = Utility::ReadUnicodeTextFile(filename);
         QStringList datalines = data.split('\n');
         foreach(QString aline, datalines) {
@@ -363,8 +371,8 @@ void SearchEditorModel::LoadTextData(const QString &filename, QStandardItem *ite
                     // this was created by an Export so fullname is present
                     fullname = findreplace.at(0);
                 }
-                fullname.replace(QRegularExpression("\\s*/+\\s*"), "/");
-                fullname.replace(QRegularExpression("^/"), "");
+                fullname.replace(GROUP_SEPARATOR, "/");
+                fullname.replace(LEADING_SEPARATOR, "");
                 entry->is_group = fullname.endsWith("/");
                 // Name is set to fullname only while looping through parent groups when adding
                 entry->name = fullname;
@@ -379,6 +387,8 @@ void SearchEditorModel::LoadTextData(const QString &filename, QStandardItem *ite
                 cnt++;
             }
         }
+        m_Loading = false;
+        m_LoadedGroups.clear();
     }
 }
 
@@ -409,21 +419,19 @@ void SearchEditorModel::AddFullNameEntry(SearchEditorModel::searchEntry *entry,
         }
 
         foreach(QString group_name, group_names) {
-            bool found = false;
+            QStandardItem *group_item = FindGroup(parent_item, group_name);
 
-            for (int r = 0; r < parent_item->rowCount(); r++) {
-                if (parent_item->child(r, 0)->data(IS_GROUP_ROLE).toBool() && parent_item->child(r, 0)->text() == group_name) {
-                    parent_item = parent_item->child(r, 0);
-                    found = true;
-                    break;
-                }
-            }
-
-            if (!found) {
+            if (group_item) {
+                parent_item = group_item;
+            } else {
+                QStandardItem *group_parent = parent_item;
                 SearchEditorModel::searchEntry *new_entry = new SearchEditorModel::searchEntry();
                 new_entry->is_group = true;
                 new_entry->name = group_name;
                 parent_item = AddEntryToModel(new_entry, new_entry->is_group, parent_item, parent_item->rowCount());
+                if (m_Loading) {
+                    m_LoadedGroups[group_parent].insert(group_name, parent_item);
+                }
                 delete new_entry;
             }
         }
@@ -461,7 +469,7 @@ void SearchEditorModel::FillControls(const QList<QStandardItem*> &items)
 }
 
 
-QString SearchEditorModel::BuildControlsToolTip(const QString & controls)
+QString SearchEditorModel::BuildControlsToolTip(const QString & controls) const
 {
     QString tooltip_controls = "";
     if (controls != "") {
@@ -523,6 +531,32 @@ QString SearchEditorModel::BuildControlsToolTip(const QString & controls)
     return tooltip_controls;
 }
 
+QStandardItem *SearchEditorModel::FindGroup(QStandardItem *parent_item, const QString &group_name)
+{
+    if (m_Loading) {
+        // Each group is scanned once per load, not once per entry read
+        QHash<QStandardItem *, QHash<QString, QStandardItem *>>::iterator it = m_LoadedGroups.find(parent_item);
+        if (it == m_LoadedGroups.end()) {
+            QHash<QString, QStandardItem *> groups;
+            for (int r = 0; r < parent_item->rowCount(); r++) {
+                QStandardItem *child = parent_item->child(r, 0);
+                if (child->data(IS_GROUP_ROLE).toBool() && !groups.contains(child->text())) {
+                    groups.insert(child->text(), child);
+                }
+            }
+            it = m_LoadedGroups.insert(parent_item, groups);
+        }
+        return it->value(group_name, NULL);
+    }
+
+    for (int r = 0; r < parent_item->rowCount(); r++) {
+        if (parent_item->child(r, 0)->data(IS_GROUP_ROLE).toBool() && parent_item->child(r, 0)->text() == group_name) {
+            return parent_item->child(r, 0);
+        }
+    }
+    return NULL;
+}
+
 QStandardItem *SearchEditorModel::AddEntryToModel(SearchEditorModel::searchEntry *entry, bool is_group, QStandardItem *parent_item, int row)
 {
     bool clean_up_needed = false;
@@ -583,7 +617,6 @@ QStandardItem *SearchEditorModel::AddEntryToModel(SearchEditorModel::searchEntry
     rowItems[0]->setData(entry->is_group, IS_GROUP_ROLE);
     rowItems[0]->setData(entry->fullname, FULLNAME_ROLE);
     rowItems[0]->setToolTip(entry->fullname);
-    rowItems[3]->setToolTip(BuildControlsToolTip(entry->controls));
     
     // Add the new item to the model at the specified row
     QStandardItem *new_item;
@@ -865,5 +898,11 @@ QVariant SearchEditorModel::data(const QModelIndex &index, int role) const
         return data(this->index(0, 0), role).toSize();
     }
 
+    // The controls tooltip is only built for the rows actually hovered
+    // rather than kept on every item as the searches are read in
+    if (index.isValid() && index.column() == 3 && role == Qt::ToolTipRole) {
+        return BuildControlsToolTip(QStandardItemModel::data(index, Qt::DisplayRole).toString());
+    }
+
     return QStandardItemModel::data(index, role);
 }
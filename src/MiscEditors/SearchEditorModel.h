@@ -26,6 +26,7 @@
 #ifndef SEARCHEDITORMODEL_H
 #define SEARCHEDITORMODEL_H
 
+#include <QtCore/QHash>
 #include <QtGui/QStandardItemModel>
 #include <QFileSystemWatcher>
 #include <QDropEvent>
@@ -65,7 +66,7 @@ public:
 
     void FillControls(const QList<QStandardItem*> &items);
     
-    QString BuildControlsToolTip(const QString& controls);
+    QString BuildControlsToolTip(const QString& controls) const;
 
     QStandardItem *AddEntryToModel(SearchEditorModel::searchEntry *entry, bool is_group = false, QStandardItem *parent_item = NULL, int row = -1);
 
@@ -111,6 +112,9 @@ private:
 
     QStandardItem *GetItemFromId(quintptr id, int row, QStandardItem *item = NULL) const;
 
+    // The group of that name directly under parent_item, if any
+    QStandardItem *FindGroup(QStandardItem *parent_item, const QString &group_name);
+
     QString CheckEntries(QList<SearchEditorModel::searchEntry *> entries);
 
     void AddExampleEntries();
@@ -122,6 +126,11 @@ private:
     QFileSystemWatcher *m_FSWatcher;
 
     bool m_IsDataModified;
+
+    // While a file is being read in, the groups already found under
+    // each parent by name, so entries are not matched by scanning
+    bool m_Loading;
+    QHash<QStandardItem *, QHash<QString, QStandardItem *>> m_LoadedGroups;
 };
 
 #endif // SEARCHEDITORMODEL_H
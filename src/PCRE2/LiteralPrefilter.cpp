@@ -0,0 +1,333 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <algorithm>
+#include <deque>
+
+#include <QtCore/QChar>
+
+#include "PCRE2/LiteralPrefilter.h"
+
+static const int ROOT_NODE = 0;
+
+LiteralPrefilter::LiteralPrefilter(const QStringList &patterns)
+    :
+    m_PatternCount(patterns.count()),
+    m_LiteralCount(0)
+{
+    m_Nodes.push_back(Node());
+    for (int i = 0; i < patterns.count(); i++) {
+        bool caseless = false;
+        QString literal = RequiredLiteralPrefix(patterns.at(i), caseless);
+        if (literal.isEmpty()) {
+            m_AlwaysCandidate << true;
+        } else {
+            m_AlwaysCandidate << false;
+            AddLiteral(literal, i);
+            m_LiteralCount++;
+        }
+    }
+    BuildFailureLinks();
+}
+
+
+bool LiteralPrefilter::HasLiterals() const
+{
+    return m_LiteralCount > 0;
+}
+
+
+QList<bool> LiteralPrefilter::Candidates(const QString &text) const
+{
+    QList<bool> candidates = m_AlwaysCandidate;
+    if (m_LiteralCount == 0) {
+        return candidates;
+    }
+
+    int remaining = m_LiteralCount;
+    int state = ROOT_NODE;
+    const QChar *p = text.constData();
+    const QChar *end = p + text.length();
+    for (; p < end; ++p) {
+        state = Step(state, p->toCaseFolded().unicode());
+        const std::vector<int> &outputs = m_Nodes[state].outputs;
+        for (size_t i = 0; i < outputs.size(); i++) {
+            int pattern_index = outputs[i];
+            if (!candidates.at(pattern_index)) {
+                candidates[pattern_index] = true;
+                // every literal has been seen so nothing more can change
+                if (--remaining == 0) {
+                    return candidates;
+                }
+            }
+        }
+    }
+    return candidates;
+}
+
+
+QString LiteralPrefilter::RequiredLiteralPrefix(const QString &pattern, bool &caseless)
+{
+    caseless = false;
+
+    // quoting and comments can hide metacharacters from our simple scan
+    if (pattern.contains("\\Q") || pattern.contains("(?#")) {
+        return QString();
+    }
+
+    // Skip start of pattern items such as (*UCP) and option settings
+    // such as (?i) or (?s) which apply to everything after them.
+    int pos = 0;
+    while (pos < pattern.length() && pattern.at(pos) == '(') {
+        int close = pattern.indexOf(')', pos);
+        if (close == -1) {
+            return QString();
+        }
+        QString item = pattern.mid(pos + 1, close - pos - 1);
+        if (item.startsWith('*')) {
+            // only skip the verbs that change how the whole pattern is compiled
+            bool is_setting = true;
+            for (int i = 1; i < item.length(); i++) {
+                QChar c = item.at(i);
+                if (!(c.isUpper() || c.isDigit() || c == '_' || c == '=')) {
+                    is_setting = false;
+                    break;
+                }
+            }
+            if (!is_setting || item == "*F" || item == "*FAIL" || item == "*ACCEPT") {
+                break;
+            }
+        } else if (item.startsWith('?') && item.length() > 1) {
+            bool negate = false;
+            for (int i = 1; i < item.length(); i++) {
+                QChar c = item.at(i);
+                if (c == '-') {
+                    negate = true;
+                } else if (c == '^') {
+                    caseless = false;
+                } else if (c == 'i') {
+                    caseless = !negate;
+                } else if (c == 'x') {
+                    // extended mode changes the meaning of white space
+                    return QString();
+                } else if (!(c == 'm' || c == 'n' || c == 's' || c == 'U' || c == 'J')) {
+                    // not an option setting, so a group, lookaround, etc
+                    return QString();
+                }
+            }
+        } else {
+            break;
+        }
+        pos = close + 1;
+    }
+
+    QStringList alternatives = TopLevelAlternatives(pattern.mid(pos));
+    QStringList possible;
+    foreach(QString alternative, alternatives) {
+        // an alternative that always fails can never provide a match
+        if (alternative.endsWith("(*F)") || alternative.endsWith("(*FAIL)")) {
+            continue;
+        }
+        possible << alternative;
+    }
+    if (possible.count() != 1) {
+        return QString();
+    }
+
+    const QString body = possible.first();
+    QString literal;
+    int i = 0;
+    while (i < body.length()) {
+        QChar c = body.at(i);
+        if (c == '\\') {
+            if (i + 1 >= body.length()) {
+                break;
+            }
+            QChar n = body.at(i + 1);
+            // \d, \w, \b, \1, \x.. etc are not literals, but a backslash
+            // before anything else just takes away its special meaning
+            if (n.unicode() < 128 && n.isLetterOrNumber()) {
+                break;
+            }
+            literal.append(n);
+            i += 2;
+            continue;
+        }
+        if (c == '*' || c == '?' || c == '{') {
+            // the quantifier makes the last character optional
+            if (literal.length() > 1 && literal.at(literal.length() - 1).isLowSurrogate() &&
+                literal.at(literal.length() - 2).isHighSurrogate()) {
+                literal.chop(2);
+            } else {
+                literal.chop(1);
+            }
+            break;
+        }
+        if (c == '+' || c == '.' || c == '^' || c == '$' || c == '(' ||
+            c == ')' || c == '[' || c == ']' || c == '|') {
+            break;
+        }
+        literal.append(c);
+        i++;
+    }
+
+    // simple case folding only works within the BMP
+    if (caseless) {
+        for (int j = 0; j < literal.length(); j++) {
+            if (literal.at(j).isSurrogate()) {
+                literal.truncate(j);
+                break;
+            }
+        }
+    }
+    return literal;
+}
+
+
+QStringList LiteralPrefilter::TopLevelAlternatives(const QString &pattern)
+{
+    QStringList alternatives;
+    QString current;
+    int depth = 0;
+    bool in_class = false;
+    int class_first = -1;
+    int n = pattern.length();
+    for (int i = 0; i < n; i++) {
+        QChar c = pattern.at(i);
+        if (c == '\\') {
+            current.append(c);
+            if (i + 1 < n) {
+                current.append(pattern.at(++i));
+            }
+            continue;
+        }
+        if (in_class) {
+            if (c == '[' && i + 1 < n && pattern.at(i + 1) == ':') {
+                // posix class such as [:alpha:]
+                int close = pattern.indexOf(":]", i + 2);
+                if (close != -1) {
+                    current.append(pattern.mid(i, close + 2 - i));
+                    i = close + 1;
+                    continue;
+                }
+            }
+            if (c == ']' && i > class_first) {
+                in_class = false;
+            }
+            current.append(c);
+            continue;
+        }
+        if (c == '[') {
+            in_class = true;
+            class_first = i + 1;
+            if (class_first < n && pattern.at(class_first) == '^') {
+                class_first++;
+            }
+        } else if (c == '(') {
+            depth++;
+        } else if (c == ')') {
+            depth--;
+        } else if (c == '|' && depth == 0) {
+            alternatives << current;
+            current.clear();
+            continue;
+        }
+        current.append(c);
+    }
+    // if we could not make sense of the pattern treat it as unsplittable
+    // with more than one alternative so that no prefix is used
+    if (depth != 0 || in_class) {
+        return QStringList() << QString() << QString();
+    }
+    alternatives << current;
+    return alternatives;
+}
+
+
+void LiteralPrefilter::AddLiteral(const QString &literal, int pattern_index)
+{
+    int state = ROOT_NODE;
+    foreach(QChar ch, literal) {
+        char16_t c = ch.toCaseFolded().unicode();
+        int next = Child(state, c);
+        if (next < 0) {
+            next = (int) m_Nodes.size();
+            m_Nodes.push_back(Node());
+            std::vector<std::pair<char16_t, int>> &edges = m_Nodes[state].edges;
+            edges.insert(std::lower_bound(edges.begin(), edges.end(), std::make_pair(c, 0)), std::make_pair(c, next));
+        }
+        state = next;
+    }
+    m_Nodes[state].outputs.push_back(pattern_index);
+}
+
+
+void LiteralPrefilter::BuildFailureLinks()
+{
+    m_RootEdges.assign(0x10000, ROOT_NODE);
+    std::deque<int> queue;
+    for (size_t i = 0; i < m_Nodes[ROOT_NODE].edges.size(); i++) {
+        const std::pair<char16_t, int> &edge = m_Nodes[ROOT_NODE].edges[i];
+        m_RootEdges[edge.first] = edge.second;
+        m_Nodes[edge.second].fail = ROOT_NODE;
+        queue.push_back(edge.second);
+    }
+
+    // breadth first so every failure link points to a node already done
+    while (!queue.empty()) {
+        int state = queue.front();
+        queue.pop_front();
+        for (size_t i = 0; i < m_Nodes[state].edges.size(); i++) {
+            char16_t c = m_Nodes[state].edges[i].first;
+            int child = m_Nodes[state].edges[i].second;
+            int fail = Step(m_Nodes[state].fail, c);
+            m_Nodes[child].fail = fail;
+            const std::vector<int> &inherited = m_Nodes[fail].outputs;
+            m_Nodes[child].outputs.insert(m_Nodes[child].outputs.end(), inherited.begin(), inherited.end());
+            queue.push_back(child);
+        }
+    }
+}
+
+
+int LiteralPrefilter::Child(int state, char16_t c) const
+{
+    const std::vector<std::pair<char16_t, int>> &edges = m_Nodes[state].edges;
+    std::vector<std::pair<char16_t, int>>::const_iterator it =
+        std::lower_bound(edges.begin(), edges.end(), std::make_pair(c, 0));
+    if (it != edges.end() && it->first == c) {
+        return it->second;
+    }
+    return -1;
+}
+
+
+int LiteralPrefilter::Step(int state, char16_t c) const
+{
+    while (state != ROOT_NODE) {
+        int next = Child(state, c);
+        if (next >= 0) {
+            return next;
+        }
+        state = m_Nodes[state].fail;
+    }
+    return m_RootEdges[c];
+}
@@ -0,0 +1,114 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef LITERALPREFILTER_H
+#define LITERALPREFILTER_H
+
+#include <vector>
+
+#include <QtCore/QList>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+
+/**
+ * Quickly rules out regular expressions that can not match a text.
+ *
+ * For each pattern the literal text that every match must start with is
+ * extracted and all of these literals are compiled into one Aho-Corasick
+ * automaton.  A text is then scanned once, no matter how many patterns
+ * there are, to find which patterns could possibly match it.  Only those
+ * candidates need to be run through PCRE.
+ *
+ * Literals and text are compared case folded so the candidates are always
+ * a superset of the patterns that really match. Patterns without a usable
+ * literal prefix are always candidates.
+ *
+ * Once constructed the prefilter is read only and can be used from
+ * several threads at once.
+ */
+class LiteralPrefilter
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param patterns The PCRE patterns to build the prefilter for.
+     */
+    LiteralPrefilter(const QStringList &patterns);
+
+    /**
+     * Which patterns could match the text.
+     *
+     * @param text The text to scan.
+     * @return One entry for each pattern, true if it may match.
+     */
+    QList<bool> Candidates(const QString &text) const;
+
+    /**
+     * Is there at least one pattern with a literal prefix. If not
+     * every pattern is always a candidate and there is no point scanning.
+     */
+    bool HasLiterals() const;
+
+    /**
+     * The literal text every match of a pattern must start with.
+     *
+     * Leading (*VERB) and (?flags) items are skipped and alternatives that
+     * can never match, such as the text only "<[^<>]*>(*SKIP)(*F)|" prefix,
+     * are ignored.  Anything else that is not plain literal text ends the
+     * prefix.
+     *
+     * @param pattern The PCRE pattern.
+     * @param[out] caseless Set if the pattern matches without case.
+     * @return The required literal prefix or an empty string if there is none.
+     */
+    static QString RequiredLiteralPrefix(const QString &pattern, bool &caseless);
+
+private:
+    struct Node {
+        // sorted (character, child node) transitions
+        std::vector<std::pair<char16_t, int>> edges;
+        int fail = 0;
+        // patterns whose literal ends at this node
+        std::vector<int> outputs;
+    };
+
+    void AddLiteral(const QString &literal, int pattern_index);
+    void BuildFailureLinks();
+    int Child(int state, char16_t c) const;
+    int Step(int state, char16_t c) const;
+
+    static QStringList TopLevelAlternatives(const QString &pattern);
+
+    std::vector<Node> m_Nodes;
+
+    // Dense transitions out of the root node as most scanning happens there
+    std::vector<int> m_RootEdges;
+
+    // Patterns that have no literal prefix and so always match
+    QList<bool> m_AlwaysCandidate;
+
+    int m_PatternCount;
+    int m_LiteralCount;
+};
+
+#endif // LITERALPREFILTER_H
@@ -20,12 +20,22 @@
 **
 *************************************************************************/
 
+#include <QtConcurrent/QtConcurrent>
+
 #include "PCRE2/PCRECache.h"
+#include "Misc/TaskScheduler.h"
+
+// The least recently used cache always holds this many patterns and
+// grows to hold the largest group pinned, up to the maximum.
+static const int MIN_CACHED_PATTERNS = 20;
+static const int MAX_CACHED_PATTERNS = 200;
 
 PCRECache *PCRECache::m_instance = 0;
 
 PCRECache *PCRECache::instance()
 {
+    static QMutex instance_mutex;
+    QMutexLocker locker(&instance_mutex);
     if (m_instance == 0) {
         m_instance = new PCRECache();
     }
@@ -34,26 +44,157 @@ PCRECache *PCRECache::instance()
 }
 
 PCRECache::PCRECache()
+    :
+    m_hits(0),
+    m_misses(0)
 {
-  // defaults to maxCacheCost of 100
+    // every entry costs 1 so the max cost is the number of patterns
+    m_cache.setMaxCost(MIN_CACHED_PATTERNS);
 }
 
 bool PCRECache::insert(const QString &key, SPCRE *object)
 {
-    // raise cost of each entry to 5 to reduce memory footprint
-    return m_cache.insert(key, object, 5);
+    QMutexLocker locker(&m_mutex);
+    return m_cache.insert(key, new QSharedPointer<SPCRE>(object));
+}
+
+std::pair<int, qint64> PCRECache::memoryUsage()
+{
+    QMutexLocker locker(&m_mutex);
+    QList<QString> keys = m_cache.keys();
+    qint64 total = 0;
+    int count = keys.count();
+    foreach(const QString &key, keys) {
+        QSharedPointer<SPCRE> *cached = m_cache.object(key);
+        if (cached) {
+            total += (*cached)->getMemorySize();
+        }
+    }
+    foreach(const QSharedPointer<SPCRE> &spcre, m_pinned) {
+        if (spcre) {
+            total += spcre->getMemorySize();
+            count++;
+        }
+    }
+    return std::make_pair(count, total);
+}
+
+void PCRECache::setPinned(const QStringList &keys)
+{
+    QStringList to_compile;
+    {
+        QMutexLocker locker(&m_mutex);
+        QHash<QString, QSharedPointer<SPCRE>> pinned;
+        foreach(const QString &key, keys) {
+            if (key.isEmpty() || pinned.contains(key)) {
+                continue;
+            }
+            QSharedPointer<SPCRE> spcre = m_pinned.take(key);
+            if (!spcre) {
+                QSharedPointer<SPCRE> *cached = m_cache.take(key);
+                if (cached) {
+                    spcre = *cached;
+                    delete cached;
+                }
+            }
+            if (!spcre) {
+                to_compile << key;
+            }
+            pinned.insert(key, spcre);
+        }
+
+        // a group may be run again after another one so make room for it
+        int capacity = qBound(MIN_CACHED_PATTERNS, pinned.count(), MAX_CACHED_PATTERNS);
+        if (capacity > m_cache.maxCost()) {
+            m_cache.setMaxCost(capacity);
+        }
+
+        QHashIterator<QString, QSharedPointer<SPCRE>> it(m_pinned);
+        while (it.hasNext()) {
+            it.next();
+            if (it.value()) {
+                m_cache.insert(it.key(), new QSharedPointer<SPCRE>(it.value()));
+            }
+        }
+        m_pinned = pinned;
+    }
+
+    if (!to_compile.isEmpty()) {
+        TaskScheduler::Run(TaskScheduler::BackgroundLane, &PCRECache::compilePinned, this, to_compile);
+    }
+}
+
+// Runs in a worker thread.
+void PCRECache::compilePinned(const QStringList &keys)
+{
+    foreach(const QString &key, keys) {
+        {
+            QMutexLocker locker(&m_mutex);
+            // unpinned or already compiled by getObject in the meantime
+            if (!m_pinned.contains(key) || m_pinned.value(key)) {
+                continue;
+            }
+        }
+        // compile, and jit, without holding the lock
+        QSharedPointer<SPCRE> spcre(new SPCRE(key));
+        QMutexLocker locker(&m_mutex);
+        if (m_pinned.contains(key) && !m_pinned.value(key)) {
+            m_pinned.insert(key, spcre);
+        }
+    }
+}
+
+PCRECache::Statistics PCRECache::statistics()
+{
+    QMutexLocker locker(&m_mutex);
+    Statistics stats;
+    foreach(const QSharedPointer<SPCRE> &spcre, m_pinned) {
+        if (spcre) {
+            stats.pinned++;
+        }
+    }
+    stats.cached = m_cache.count();
+    stats.capacity = m_cache.maxCost();
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    return stats;
 }
 
-SPCRE *PCRECache::getObject(const QString &key)
+QSharedPointer<SPCRE> PCRECache::getObject(const QString &key)
 {
+    {
+        QMutexLocker locker(&m_mutex);
+        QSharedPointer<SPCRE> pinned = m_pinned.value(key);
+        if (pinned) {
+            m_hits++;
+            return pinned;
+        }
+        QSharedPointer<SPCRE> *cached = m_cache.object(key);
+        if (cached) {
+            m_hits++;
+            return *cached;
+        }
+        m_misses++;
+    }
+
     // Create a new SPCRE if it doesn't already exist.
     // The key is the pattern for initializing the SPCRE.
-    if (!m_cache.contains(key)) {
-        SPCRE *spcre = new SPCRE(key);
-        // raise cost of each entry to 5 to reduce memory footprint
-        m_cache.insert(key, spcre, 5);
+    // Compiling is done without the lock so other threads are not held
+    // up, if two threads compile the same pattern the first one is kept.
+    QSharedPointer<SPCRE> spcre(new SPCRE(key));
+
+    QMutexLocker locker(&m_mutex);
+    if (m_pinned.contains(key)) {
+        if (m_pinned.value(key)) {
+            return m_pinned.value(key);
+        }
+        m_pinned.insert(key, spcre);
         return spcre;
     }
-
-    return m_cache.object(key);
+    QSharedPointer<SPCRE> *cached = m_cache.object(key);
+    if (cached) {
+        return *cached;
+    }
+    m_cache.insert(key, new QSharedPointer<SPCRE>(spcre));
+    return spcre;
 }
@@ -26,7 +26,11 @@
 #define PCRECACHE_H
 
 #include <QtCore/QCache>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QSharedPointer>
 #include <QtCore/QString>
+#include <QtCore/QStringList>
 
 #include "PCRE2/SPCRE.h"
 
@@ -34,6 +38,15 @@
  * Singleton. A cache of SPCRE regular expression objects.
  *
  * The SPCRE's are cached to improve performance.
+ *
+ * The cache is safe to use from multiple threads.  Objects are handed
+ * out as shared pointers so an SPCRE in use by one thread stays alive
+ * even if another thread causes it to be evicted from the cache.
+ *
+ * The patterns of the saved searches about to be run can be pinned so
+ * that they are never evicted however many other patterns are used.
+ * The rest are kept least recently used first, in a cache that grows
+ * to hold the largest group of patterns pinned so far.
  */
 class PCRECache
 {
@@ -62,7 +75,34 @@ public:
      *
      * @param key The key associated with the SPCRE.
      */
-    SPCRE *getObject(const QString &key);
+    QSharedPointer<SPCRE> getObject(const QString &key);
+
+    /**
+     * The number of patterns cached and roughly how many bytes they use.
+     */
+    std::pair<int, qint64> memoryUsage();
+
+    /**
+     * Keep these patterns compiled until the next call, compiling any not
+     * already cached in a worker thread.  Patterns pinned before that
+     * are not in the new list go back to the least recently used cache.
+     *
+     * @param keys The patterns to pin.
+     */
+    void setPinned(const QStringList &keys);
+
+    struct Statistics {
+        int pinned = 0;
+        int cached = 0;
+        int capacity = 0;
+        qint64 hits = 0;
+        qint64 misses = 0;
+    };
+
+    /**
+     * How often getObject found the pattern already compiled.
+     */
+    Statistics statistics();
 
 private:
     /**
@@ -70,8 +110,17 @@ private:
      */
     PCRECache();
 
+    // Compiles the pinned patterns that are not compiled yet.
+    void compilePinned(const QStringList &keys);
+
     // The cache that we store the SPCRE's.
-    QCache<QString, SPCRE> m_cache;
+    QCache<QString, QSharedPointer<SPCRE>> m_cache;
+    // Pinned patterns, null until compiled.
+    QHash<QString, QSharedPointer<SPCRE>> m_pinned;
+    qint64 m_hits;
+    qint64 m_misses;
+    // Guards m_cache, m_pinned and the statistics
+    QMutex m_mutex;
     // The single instance of the cache.
     static PCRECache *m_instance;
 };
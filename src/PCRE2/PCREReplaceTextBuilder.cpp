@@ -21,6 +21,8 @@
 *************************************************************************/
 
 #include <QtCore/QChar>
+#include <QtCore/QStringView>
+#include <QtCore/QVarLengthArray>
 
 #include "PCRE2/PCREReplaceTextBuilder.h"
 #include "Misc/Utility.h"
@@ -28,8 +30,9 @@
 #define is_hex(a) (((a) >= '0' && (a) <= '9') || ((a) >= 'a' && (a) <= 'f') || ((a) >= 'A' && (a) <= 'F') ? true : false)
 
 PCREReplaceTextBuilder::PCREReplaceTextBuilder()
+    : m_caseChangeState(CaseChange_None),
+      m_compiled(false)
 {
-    resetState();
 }
 
 
@@ -51,7 +54,19 @@ bool PCREReplaceTextBuilder::BuildReplacementText(SPCRE &sre,
         const QString &replacement_pattern,
         QString &out)
 {
-    resetState();
+    if (!Compile(sre, replacement_pattern)) {
+        return false;
+    }
+
+    out.clear();
+    AppendReplacementText(text, 0, capture_groups_offsets, out);
+    return true;
+}
+
+bool PCREReplaceTextBuilder::Compile(SPCRE &sre, const QString &replacement_pattern)
+{
+    m_ops.clear();
+    m_compiled = false;
 
     if (!sre.isValid()) {
         return false;
@@ -63,7 +78,8 @@ bool PCREReplaceTextBuilder::BuildReplacementText(SPCRE &sre,
     // This is a simple and quick way that will catch a large number of
     // cases but not all.
     if (!replacement_pattern.contains("\\")) {
-        out = replacement_pattern;
+        addTextOp(replacement_pattern);
+        m_compiled = true;
         return true;
     }
 
@@ -87,9 +103,11 @@ bool PCREReplaceTextBuilder::BuildReplacementText(SPCRE &sre,
     bool in_control = false;
 
     // We are going to parse the replacment pattern one character at a time
-    // to build the final replacement string. We need to replace subpatterns
-    // numbered and named with the text matched by the regex. As well as
-    // do any required case chagnes.
+    // into a list of operations (literal text, back references and case
+    // changes) that can then be expanded for every match without parsing
+    // the pattern again. We need to replace subpatterns numbered and named
+    // with the text matched by the regex. As well as do any required case
+    // chagnes.
     //
     // We do a linear replacement one character at a time instead of using
     // a regex because we don't want false positives or replacments
@@ -130,47 +148,40 @@ bool PCREReplaceTextBuilder::BuildReplacementText(SPCRE &sre,
                 // # is special because it's a numbered back reference.
                 // We processed it here.
                 if (c.isDigit()) {
-                    int backref_number = c.digitValue();
-
-                    // Check if this number is a back reference we can
-                    // actually get.
-                    if (backref_number >= 0 && backref_number < capture_groups_offsets.count()) {
-                        accumulateReplcementText(Utility::Substring(capture_groups_offsets.at(backref_number).first, capture_groups_offsets.at(backref_number).second, text));
-                    } else {
-                        accumulateReplcementText(invalid_control);
-                    }
-
+                    // Whether this number is a back reference we can
+                    // actually get is checked for each match.
+                    addBackrefOp(c.digitValue(), invalid_control);
                     in_control = false;
                 }
                 // Metacharacters
                 else if (c == 'a') {
-                    accumulateReplcementText("\a");
+                    addTextOp("\a");
                     in_control = false;
                 } else if (c == 'b') {
-                    accumulateReplcementText("\b");
+                    addTextOp("\b");
                     in_control = false;
                 } else if (c == 'f') {
-                    accumulateReplcementText("\f");
+                    addTextOp("\f");
                     in_control = false;
                 } else if (c == 'n') {
-                    accumulateReplcementText("\n");
+                    addTextOp("\n");
                     in_control = false;
                 } else if (c == 'r') {
-                    accumulateReplcementText("\r");
+                    addTextOp("\r");
                     in_control = false;
                 } else if (c == 't') {
-                    accumulateReplcementText("\t");
+                    addTextOp("\t");
                     in_control = false;
                 } else if (c == 'v') {
-                    accumulateReplcementText("\v");
+                    addTextOp("\v");
                     in_control = false;
                 } else if (c == '\\') {
-                    accumulateReplcementText("\\");
+                    addTextOp("\\");
                     in_control = false;
                 }
                 // End case change.
                 else if (c == 'E') {
-                    m_caseChangeState = CaseChange_None;
+                    addCaseOp(CaseChange_None);
                     in_control = false;
                 }
                 // Backreference.
@@ -179,22 +190,22 @@ bool PCREReplaceTextBuilder::BuildReplacementText(SPCRE &sre,
                 }
                 // Lower case next character.
                 else if (c == 'l') {
-                    trySetCaseChange(CaseChange_LowerNext);
+                    addCaseOp(CaseChange_LowerNext);
                     in_control = false;
                 }
                 // Lower case until \E.
                 else if (c == 'L') {
-                    trySetCaseChange(CaseChange_Lower);
+                    addCaseOp(CaseChange_Lower);
                     in_control = false;
                 }
                 // Upper case next character.
                 else if (c == 'u') {
-                    trySetCaseChange(CaseChange_UpperNext);
+                    addCaseOp(CaseChange_UpperNext);
                     in_control = false;
                 }
                 // Upper case until \E.
                 else if (c == 'U') {
-                    trySetCaseChange(CaseChange_Upper);
+                    addCaseOp(CaseChange_Upper);
                     in_control = false;
                 }
             }
@@ -209,7 +220,7 @@ bool PCREReplaceTextBuilder::BuildReplacementText(SPCRE &sre,
                             backref_name.clear();
                         } else {
                             in_control = false;
-                            accumulateReplcementText(invalid_control);
+                            addTextOp(invalid_control);
                         }
                     } else {
                         if ((c == '}' && backref_bracket_start_char == '{') ||
@@ -225,14 +236,7 @@ bool PCREReplaceTextBuilder::BuildReplacementText(SPCRE &sre,
                                 backref_number = sre.getCaptureStringNumber(backref_name);
                             }
 
-                            // Check if there is we have a back reference we can
-                            // actually get.
-                            if (backref_number >= 0 && backref_number < capture_groups_offsets.count()) {
-                                accumulateReplcementText(Utility::Substring(capture_groups_offsets.at(backref_number).first, capture_groups_offsets.at(backref_number).second, text));
-                            } else {
-                                accumulateReplcementText(invalid_control);
-                            }
-
+                            addBackrefOp(backref_number, invalid_control);
                             in_control = false;
                         } else {
                             backref_name += c;
@@ -244,14 +248,14 @@ bool PCREReplaceTextBuilder::BuildReplacementText(SPCRE &sre,
                     } else if (c == '}' && in_hex6 && IsValidHex6(control_x6_hex)) {
                         int hl = control_x6_hex.length();
                         if (hl == 2 || hl == 4) {
-                            accumulateReplcementText(QChar(control_x6_hex.toUInt(NULL, 16)));
+                            addTextOp(QString(QChar(control_x6_hex.toUInt(NULL, 16))));
                         } else {
                             uint achar;
                             QString extended_plane = control_x6_hex.left(2);
                             QString remainder = control_x6_hex.right(4);
                             achar = remainder.toUInt(NULL, 16);
                             achar = (65536 * extended_plane.toUInt(NULL, 16)) + achar;
-                            accumulateReplcementText(QString::fromUcs4(reinterpret_cast<char32_t*>(&achar), 1));
+                            addTextOp(QString::fromUcs4(reinterpret_cast<char32_t*>(&achar), 1));
                         }
                         in_control = false;
                         in_hex6 = false;
@@ -262,18 +266,18 @@ bool PCREReplaceTextBuilder::BuildReplacementText(SPCRE &sre,
                         } else {
                             control_x_hex += c;
                             if (control_x_hex.length() == 2) {
-                                accumulateReplcementText(QChar(control_x_hex.toUInt(NULL, 16)));
+                                addTextOp(QString(QChar(control_x_hex.toUInt(NULL, 16))));
                                 in_control = false;
                             }
                         }
                     } else {
-                        accumulateReplcementText(invalid_control);
+                        addTextOp(invalid_control);
                         in_control = false;
                     }
                 }
                 // Invalid or unsupported control.
                 else {
-                    accumulateReplcementText(invalid_control);
+                    addTextOp(invalid_control);
                     in_control = false;
                 }
             }
@@ -296,7 +300,7 @@ bool PCREReplaceTextBuilder::BuildReplacementText(SPCRE &sre,
             }
             // Normal text.
             else {
-                accumulateReplcementText(c);
+                addTextOp(QString(c));
             }
         }
     }
@@ -305,63 +309,133 @@ bool PCREReplaceTextBuilder::BuildReplacementText(SPCRE &sre,
     // a back reference then we have an invalid back reference because
     // it never ended. Put the invalid reference into the replacment string.
     if (in_control) {
-        accumulateReplcementText(invalid_control);
+        addTextOp(invalid_control);
     }
 
-    out = m_finalText;
+    m_compiled = true;
     return true;
 }
 
-void PCREReplaceTextBuilder::accumulateReplcementText(const QChar &ch)
+void PCREReplaceTextBuilder::AppendReplacementText(const QString &text,
+        int match_start,
+        const QList<std::pair<int, int>> &capture_groups_offsets,
+        QString &out)
+{
+    QVarLengthArray<int, 64> groups;
+    foreach(const auto &group, capture_groups_offsets) {
+        groups.append(match_start + group.first);
+        groups.append(match_start + group.second);
+    }
+    AppendReplacementText(text, groups.constData(), capture_groups_offsets.count(), out);
+}
+
+void PCREReplaceTextBuilder::AppendReplacementText(const QString &text,
+        const int *groups,
+        int group_count,
+        QString &out)
 {
-    m_finalText += processTextSegement(ch);
+    if (!m_compiled) {
+        return;
+    }
+
+    m_caseChangeState = CaseChange_None;
+    QStringView subject(text);
+
+    foreach(const ReplaceOp &op, m_ops) {
+        switch (op.type) {
+            case ReplaceOp::Op_Text:
+                appendSegment(op.text, out);
+                break;
+
+            case ReplaceOp::Op_Backref:
+                // Check if this is a back reference we can actually get.
+                if (op.value >= 0 && op.value < group_count) {
+                    int start = groups[2 * op.value];
+                    int end = groups[2 * op.value + 1];
+                    // groups that did not take part in the match have no text
+                    if (start >= 0 && end > start && end <= subject.length()) {
+                        appendSegment(subject.sliced(start, end - start), out);
+                    }
+                } else {
+                    appendSegment(op.text, out);
+                }
+                break;
+
+            case ReplaceOp::Op_Case:
+                if (op.value == CaseChange_None) {
+                    m_caseChangeState = CaseChange_None;
+                } else {
+                    trySetCaseChange(static_cast<CaseChange>(op.value));
+                }
+                break;
+        }
+    }
 }
 
-void PCREReplaceTextBuilder::accumulateReplcementText(const QString &text)
+void PCREReplaceTextBuilder::addTextOp(const QString &text)
 {
-    m_finalText += processTextSegement(text);
+    if (text.isEmpty()) {
+        return;
+    }
+    // merge runs of literal text so they are appended in one go
+    if (!m_ops.isEmpty() && m_ops.last().type == ReplaceOp::Op_Text) {
+        m_ops.last().text += text;
+        return;
+    }
+    ReplaceOp op;
+    op.type = ReplaceOp::Op_Text;
+    op.text = text;
+    m_ops.append(op);
 }
 
-QString PCREReplaceTextBuilder::processTextSegement(const QChar &ch)
+void PCREReplaceTextBuilder::addBackrefOp(int number, const QString &invalid_control)
 {
-    return processTextSegement(QString(ch));
+    ReplaceOp op;
+    op.type = ReplaceOp::Op_Backref;
+    op.value = number;
+    op.text = invalid_control;
+    m_ops.append(op);
 }
 
-QString PCREReplaceTextBuilder::processTextSegement(const QString &text)
+void PCREReplaceTextBuilder::addCaseOp(CaseChange state)
 {
-    QString processedText;
+    ReplaceOp op;
+    op.type = ReplaceOp::Op_Case;
+    op.value = state;
+    m_ops.append(op);
+}
 
+void PCREReplaceTextBuilder::appendSegment(QStringView text, QString &out)
+{
     if (text.length() == 0) {
-        return processedText;
+        return;
     }
 
     switch (m_caseChangeState) {
         case CaseChange_LowerNext:
-            processedText += text.at(0).toLower();
-            processedText += text.mid(1);
+            out += text.at(0).toLower();
+            out += text.mid(1);
             m_caseChangeState = CaseChange_None;
             break;
 
         case CaseChange_Lower:
-            processedText += text.toLower();
+            out += text.toString().toLower();
             break;
 
         case CaseChange_UpperNext:
-            processedText += text.at(0).toUpper();
-            processedText += text.mid(1);
+            out += text.at(0).toUpper();
+            out += text.mid(1);
             m_caseChangeState = CaseChange_None;
             break;
 
         case CaseChange_Upper:
-            processedText += text.toUpper();
+            out += text.toString().toUpper();
             break;
 
         default:
-            processedText += text;
+            out += text;
             break;
     }
-
-    return processedText;
 }
 
 void PCREReplaceTextBuilder::trySetCaseChange(CaseChange state)
@@ -370,9 +444,3 @@ void PCREReplaceTextBuilder::trySetCaseChange(CaseChange state)
         m_caseChangeState = state;
     }
 }
-
-void PCREReplaceTextBuilder::resetState()
-{
-    m_finalText.clear();
-    m_caseChangeState = CaseChange_None;
-}
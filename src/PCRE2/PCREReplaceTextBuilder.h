@@ -25,7 +25,9 @@
 #ifndef PCREREPLACETEXTBUILDER_H
 #define PCREREPLACETEXTBUILDER_H
 
+#include <QtCore/QList>
 #include <QtCore/QString>
+#include <QtCore/QStringView>
 
 #include "PCRE2/SPCRE.h"
 
@@ -33,6 +35,10 @@ class QChar;
 
 /**
  * Build replacement text from a given replacement pattern.
+ *
+ * The replacement pattern is compiled once into a list of operations
+ * (literal text, back references and case changes) which can then be
+ * expanded for any number of matches without being parsed again.
  */
 class PCREReplaceTextBuilder
 {
@@ -61,6 +67,46 @@ public:
                               const QString &replacement_pattern,
                               QString &out);
 
+    /**
+     * Parse a replacement pattern for use with AppendReplacementText.
+     *
+     * Named back references are resolved against the SPCRE here.
+     *
+     * @param sre The SPCRE the pattern will be used with.
+     * @param replacement_pattern The replacement pattern.
+     *
+     * @return True if the pattern can be used to build replacements.
+     */
+    bool Compile(SPCRE &sre, const QString &replacement_pattern);
+
+    /**
+     * Append the replacement for one match to out.
+     *
+     * @param text The full text that was searched.
+     * @param match_start The offset of the match within text.
+     * @param capture_groups_offsets The offsets of the captured subpatterns,
+     * relative to match_start.
+     * @param[out] out The string to append the replacement to.
+     */
+    void AppendReplacementText(const QString &text,
+                               int match_start,
+                               const QList<std::pair<int, int>> &capture_groups_offsets,
+                               QString &out);
+
+    /**
+     * Append the replacement for one match of an SPCRE::MatchArray to out.
+     *
+     * @param text The full text that was searched.
+     * @param groups group_count (start, end) pairs within text, the whole
+     * match first.
+     * @param group_count The number of pairs in groups.
+     * @param[out] out The string to append the replacement to.
+     */
+    void AppendReplacementText(const QString &text,
+                               const int *groups,
+                               int group_count,
+                               QString &out);
+
 private:
     /**
      * The state of case changes.
@@ -74,47 +120,36 @@ private:
     };
 
     /**
-     * Reset the state of the replacement process.
+     * One step of a compiled replacement pattern.
      */
-    void resetState();
-    
+    struct ReplaceOp {
+        enum OpType {
+            Op_Text,
+            Op_Backref,
+            Op_Case
+        };
+        OpType type = Op_Text;
+        // Literal text, or the original control text to use when a back
+        // reference does not exist in the match.
+        QString text;
+        // Back reference number or CaseChange state.
+        int value = -1;
+    };
+
     bool IsValidHex6(QString& hv);
-    
-    /**
-     * Add to the final replacement text we are building.
-     *
-     * Processes by calling processTextSegement before adding.
-     *
-     * @param ch The character to add.
-     */
-    void accumulateReplcementText(const QChar &ch);
-    /**
-     * Add to the final replacement text we are building.
-     *
-     * Processes by calling processTextSegement before adding.
-     *
-     * @param text The text to add.
-     */
-    void accumulateReplcementText(const QString &text);
+
+    void addTextOp(const QString &text);
+    void addBackrefOp(int number, const QString &invalid_control);
+    void addCaseOp(CaseChange state);
 
     /**
      * Processes the text segment making any changes necessary based upon
-     * the state.
-     *
-     * @param ch The character to process.
-     *
-     * @return The processed and transformed text.
-     */
-    QString processTextSegement(const QChar &ch);
-    /**
-     * Processes the text segment making any changes necessary based upon
-     * the state.
+     * the state and appends it to out.
      *
      * @param text The text to process.
-     *
-     * @return The processed and transformed text.
+     * @param[out] out The string to append to.
      */
-    QString processTextSegement(const QString &text);
+    void appendSegment(QStringView text, QString &out);
 
     /**
      * Change the case state if possible.
@@ -128,8 +163,9 @@ private:
 
     // Case change state.
     CaseChange m_caseChangeState;
-    // The final replacement text.
-    QString m_finalText;
+    // The compiled replacement pattern.
+    QList<ReplaceOp> m_ops;
+    bool m_compiled;
 };
 
 #endif // PCREREPLACETEXTBUILDER_H
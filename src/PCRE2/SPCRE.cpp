@@ -28,21 +28,84 @@
 #include "Misc/Utility.h"
 #include "sigil_constants.h"
 
-#define PCRE_NO_JIT 1
-
 // The maximum number of catpures that we will allow.
 const int PCRE_MAX_CAPTURE_GROUPS = 30;
 
+// Characters before the end of the range first searched for a last match
+const int LAST_MATCH_WINDOW = 65536;
+
+// JIT stack sizes in bytes.  Every pattern starts small and the
+// maximum is scaled up for long or capture heavy patterns which
+// need more stack to backtrack through large UTF-16 texts.
+const size_t JIT_STACK_START_SIZE = 32 * 1024;
+const size_t JIT_STACK_BASE_MAX_SIZE = 1024 * 1024;
+const size_t JIT_STACK_LIMIT_SIZE = 16 * 1024 * 1024;
+
+static bool ProbeJIT()
+{
+    // allow users to force the interpreter if jit misbehaves on their platform
+    if (qEnvironmentVariableIsSet("SIGIL_DISABLE_PCRE_JIT")) {
+        return false;
+    }
+    uint32_t have_jit = 0;
+    return (pcre2_config_16(PCRE2_CONFIG_JIT, &have_jit) >= 0) && (have_jit == 1);
+}
+
+bool SPCRE::JITAvailable()
+{
+    static const bool have_jit = ProbeJIT();
+    return have_jit;
+}
+
+// Per thread match state.  The compiled pattern and its match context
+// are shared by every thread and are only ever read while matching,
+// but match data and jit stacks are written to during a match and so
+// each thread gets its own.  The jit stack is grown as needed to the
+// largest maximum any pattern matched on this thread has asked for.
+struct SPCREThreadState
+{
+    pcre2_match_data *matchdata = NULL;
+    pcre2_jit_stack *jitstack = NULL;
+    size_t jitstack_max = 0;
+
+    ~SPCREThreadState()
+    {
+        if (matchdata) pcre2_match_data_free_16(matchdata);
+        if (jitstack) pcre2_jit_stack_free_16(jitstack);
+    }
+};
+
+static thread_local SPCREThreadState t_state;
+
+static pcre2_match_data *ThreadMatchData()
+{
+    if (!t_state.matchdata) {
+        // room for the full match plus every capture group we will report
+        t_state.matchdata = pcre2_match_data_create_16(PCRE_MAX_CAPTURE_GROUPS + 1, NULL);
+    }
+    return t_state.matchdata;
+}
+
+// pcre2 jit stack callback, data points to the pattern's maximum stack size
+static pcre2_jit_stack *ThreadJITStack(void *data)
+{
+    size_t max_size = *static_cast<size_t *>(data);
+    if (!t_state.jitstack || (t_state.jitstack_max < max_size)) {
+        if (t_state.jitstack) pcre2_jit_stack_free_16(t_state.jitstack);
+        t_state.jitstack = pcre2_jit_stack_create_16(JIT_STACK_START_SIZE, max_size, NULL);
+        t_state.jitstack_max = t_state.jitstack ? max_size : 0;
+    }
+    // a NULL return makes pcre2 fall back to its small machine stack
+    return t_state.jitstack;
+}
+
 SPCRE::SPCRE(const QString &patten)
 {
     m_pattern = patten;
     m_re = NULL;
-    m_matchdata = NULL;
     m_mcontext = NULL;
-
-#ifndef PCRE_NO_JIT
-    m_jitstack = NULL;
-#endif
+    m_jitStackMax = 0;
+    m_jit = false;
 
     m_captureSubpatternCount = 0;
     m_error = QString();
@@ -54,23 +117,23 @@ SPCRE::SPCRE(const QString &patten)
     // Pattern is valid.
     if (m_re != NULL) {
         m_valid = true;
-        m_matchdata = pcre2_match_data_create_from_pattern_16(m_re, NULL);
-
 
-#ifndef PCRE_NO_JIT
-        int rc = pcre2_jit_compile_16(m_re, PCRE2_JIT_COMPLETE);
-        if (rc == 0) {
+        // pcre2_jit_compile can fail even when jit support is compiled in
+        // (for example when the platform forbids executable memory), in which
+        // case we simply stay with the interpreter
+        if (JITAvailable() && (pcre2_jit_compile_16(m_re, PCRE2_JIT_COMPLETE) == 0)) {
+            m_jit = true;
+            m_jitStackMax = jitStackMaxSize();
             m_mcontext = pcre2_match_context_create_16(NULL);
-            m_jitstack = pcre2_jit_stack_create_16(32*1024, 1024*1024, NULL);
-            if (m_jitstack != NULL) {
-                pcre2_jit_stack_assign_16(m_mcontext, NULL, m_jitstack);
+            if (m_mcontext) {
+                pcre2_jit_stack_assign_16(m_mcontext, ThreadJITStack, &m_jitStackMax);
             }
         }
-#endif
 
-        // Store the number of capture patterns (pairs).
-        // pcre2_pattern_info_16(m_re, PCRE2_INFO_CAPTURECOUNT, &m_captureSubpatternCount);
-        m_captureSubpatternCount = pcre2_get_ovector_count_16(m_matchdata);
+        // Store the number of capture patterns (pairs) including the full match.
+        uint32_t capturecount = 0;
+        pcre2_pattern_info_16(m_re, PCRE2_INFO_CAPTURECOUNT, &capturecount);
+        m_captureSubpatternCount = (int) capturecount + 1;
     }
     // Pattern is not valid.
     else {
@@ -93,22 +156,10 @@ SPCRE::~SPCRE()
         m_re = NULL;
     }
 
-    if (m_matchdata != NULL) {
-        pcre2_match_data_free_16(m_matchdata);
-        m_matchdata = NULL;
-    }
-
-#ifndef PCRE_NO_JIT
-    if (m_jitstack) {
-        pcre2_jit_stack_free_16(m_jitstack);
-        m_jitstack = NULL;
-    }
     if (m_mcontext) {
         pcre2_match_context_free_16(m_mcontext);
         m_mcontext = NULL;
     }
-#endif
-
 }
 
 bool SPCRE::isValid()
@@ -141,6 +192,60 @@ int SPCRE::getCaptureSubpatternCount()
     return m_captureSubpatternCount;
 }
 
+bool SPCRE::isJITCompiled()
+{
+    return m_jit;
+}
+
+qint64 SPCRE::getMemorySize()
+{
+    qint64 total = sizeof(SPCRE) + m_pattern.capacity() * sizeof(QChar);
+    if (m_re) {
+        size_t size = 0;
+        if (pcre2_pattern_info_16(m_re, PCRE2_INFO_SIZE, &size) == 0) {
+            total += size;
+        }
+        if (m_jit && (pcre2_pattern_info_16(m_re, PCRE2_INFO_JITSIZE, &size) == 0)) {
+            total += size;
+        }
+    }
+    return total;
+}
+
+// Scale the maximum jit stack to the pattern.  Simple literal searches
+// never get near the base size, but long alternations, back references
+// and deeply nested groups can recurse much further on big chapters.
+size_t SPCRE::jitStackMaxSize()
+{
+    uint32_t capturecount = 0;
+    uint32_t backrefmax = 0;
+    pcre2_pattern_info_16(m_re, PCRE2_INFO_CAPTURECOUNT, &capturecount);
+    pcre2_pattern_info_16(m_re, PCRE2_INFO_BACKREFMAX, &backrefmax);
+    size_t factor = 1 + capturecount / 8 + m_pattern.length() / 512;
+    if (backrefmax > 0) factor = factor * 2;
+    size_t max_size = JIT_STACK_BASE_MAX_SIZE * factor;
+    if (max_size > JIT_STACK_LIMIT_SIZE) max_size = JIT_STACK_LIMIT_SIZE;
+    return max_size;
+}
+
+// Run one match into this thread's match data, falling back to the
+// interpreter for this match only if the jit ran out of stack so that
+// no matches are silently lost.
+int SPCRE::match(const QString &text, PCRE2_SIZE start_offset, pcre2_match_data *matchdata)
+{
+    return match(text, start_offset, text.length(), matchdata);
+}
+
+// As above but the subject ends at end, as though the text were cut there
+int SPCRE::match(const QString &text, PCRE2_SIZE start_offset, PCRE2_SIZE end, pcre2_match_data *matchdata)
+{
+    int rc = pcre2_match_16(m_re, text.utf16(), end, start_offset, 0, matchdata, m_mcontext);
+    if (rc == PCRE2_ERROR_JIT_STACKLIMIT) {
+        rc = pcre2_match_16(m_re, text.utf16(), end, start_offset, PCRE2_NO_JIT, matchdata, m_mcontext);
+    }
+    return rc;
+}
+
 // get capture group number for named capture group
 int SPCRE::getCaptureStringNumber(const QString &name)
 {
@@ -161,22 +266,52 @@ int SPCRE::getCaptureStringNumber(const QString &name)
     return number;
 }
 
+// Steps through every non empty match within [start, end) of text in
+// order, handing the ovector of each to found.  All of the ways of getting
+// more than one match go through here so they agree on where matching
+// resumes after each match and when it stops.
+template<typename Found>
+void SPCRE::eachMatch(const QString &text, PCRE2_SIZE start, PCRE2_SIZE end, Found found)
+{
+    pcre2_match_data *matchdata = ThreadMatchData();
+    if (!matchdata) {
+        return;
+    }
+
+    // We keep track of the last offset as we move though the string matching
+    // sub strings.
+    PCRE2_SIZE last_offset = start;
+    bool done = false;
+    int rc = 0;
+
+    // Run until no matches are found.
+    do {
+
+        rc = match(text, last_offset, end, matchdata);
+
+        // NOTE: until a call to pcre2_match_16 happens even through matchdata exists
+        // and the ovector count is known, the pcre2_get_ovector_pointer returns a pointer
+        // to invalid ovector data
+        PCRE2_SIZE * ovector = pcre2_get_ovector_pointer_16(matchdata);
+
+        done = (ovector[1] == last_offset) || (ovector[0] >= ovector[1]);
+
+        last_offset = ovector[1];
+
+        if (rc >= 0 && ovector[0] < ovector[1]) {
+            found(ovector);
+        }
+    } while (rc >= 0 && !done);
+}
+
 QList<SPCRE::MatchInfo> SPCRE::getEveryMatchInfo(const QString &text)
 {
-    // This function is very similar to getNextMatchInfo but we don't
-    // want to put a call to getNextMatchInfo in a loop because it allocates
-    // a new ovector. We want to avoid this and only do one allocation so we
-    // reuse the logic and put the call to generateMatchInfo in the loop.
     QList<SPCRE::MatchInfo> info;
 
     if (m_re == NULL || text.isEmpty()) {
         return info;
     }
 
-    int rc = 0;
-
-    PCRE2_SIZE * ovector = NULL;
-
     // Set the size of the array based on the number of capture subpatterns
     // if it does not exceed our maximum size.
     int ovector_count = getCaptureSubpatternCount();
@@ -185,32 +320,57 @@ QList<SPCRE::MatchInfo> SPCRE::getEveryMatchInfo(const QString &text)
         ovector_count = PCRE_MAX_CAPTURE_GROUPS;
     }
 
-    // We keep track of the last offsets as we move though the string matching
-    // sub strings.
-    unsigned int last_offset[2] = {0};
-    bool done = false;
-    
-    // Run until no matches are found.
-    do {
+    eachMatch(text, 0, text.length(), [&](PCRE2_SIZE *ovector) {
+        info.append(generateMatchInfo(ovector, ovector_count));
+    });
 
-        rc = pcre2_match_16(m_re, text.utf16(), text.length(), last_offset[1], 0, m_matchdata, m_mcontext);
+    return info;
+}
 
-        // NOTE: until a call to pcre2_match_16 happens even through m_matchdata exists
-        // and the ovector count is known, the pcre2_get_ovector_pointer returns a pointer
-        // to invalid ovector data
-        ovector = pcre2_get_ovector_pointer_16(m_matchdata);
+SPCRE::MatchArray SPCRE::getEveryMatchArray(const QString &text)
+{
+    MatchArray matches;
 
-        done = (ovector[1] == last_offset[1]) || (ovector[0] >= ovector[1]);
+    if (m_re == NULL || text.isEmpty()) {
+        return matches;
+    }
 
-        last_offset[0] = (unsigned int)ovector[0];
-        last_offset[1] = (unsigned int)ovector[1];
+    int ovector_count = getCaptureSubpatternCount();
 
-        if (rc >= 0 && ovector[0] != ovector[1] && ovector[0] < ovector[1]) {
-            info.append(generateMatchInfo(ovector, ovector_count));
+    if (ovector_count > PCRE_MAX_CAPTURE_GROUPS) {
+        ovector_count = PCRE_MAX_CAPTURE_GROUPS;
+    }
+    matches.group_count = ovector_count;
+
+    eachMatch(text, 0, text.length(), [&](PCRE2_SIZE *ovector) {
+        for (int i = 0; i < 2 * ovector_count; i++) {
+            matches.offsets.append(ovector[i] == PCRE2_UNSET ? -1 : (int) ovector[i]);
         }
-    } while (rc >= 0 && !done);
-    
-    return info;
+    });
+
+    return matches;
+}
+
+int SPCRE::getMatchCount(const QString &text)
+{
+    return getMatchCount(text, 0, text.length());
+}
+
+int SPCRE::getMatchCount(const QString &text, int start, int end)
+{
+    int count = 0;
+    if (start < 0) start = 0;
+    if (end > text.length()) end = text.length();
+
+    if (m_re == NULL || start >= end) {
+        return count;
+    }
+
+    eachMatch(text, start, end, [&](PCRE2_SIZE *) {
+        count++;
+    });
+
+    return count;
 }
 
 SPCRE::MatchInfo SPCRE::getFirstMatchInfo(const QString &text)
@@ -239,8 +399,12 @@ SPCRE::MatchInfo SPCRE::getFirstMatchInfo(const QString &text)
     // MSVC doesn't support it.
     // int *ovector = new int[ovector_size];
     // memset(ovector, 0, sizeof(int)*ovector_size);
-    rc = pcre2_match_16(m_re, text.utf16(), text.length(), 0, 0, m_matchdata, m_mcontext);
-    PCRE2_SIZE * ovector = pcre2_get_ovector_pointer_16(m_matchdata);
+    pcre2_match_data *matchdata = ThreadMatchData();
+    if (!matchdata) {
+        return match_info;
+    }
+    rc = match(text, 0, matchdata);
+    PCRE2_SIZE * ovector = pcre2_get_ovector_pointer_16(matchdata);
 
     if (rc >= 0 && ovector[0] != ovector[1]) {
         match_info = generateMatchInfo(ovector, ovector_count);
@@ -261,6 +425,97 @@ SPCRE::MatchInfo SPCRE::getLastMatchInfo(const QString &text)
     }
 }
 
+SPCRE::MatchInfo SPCRE::getFirstMatchInfo(const QString &text, int start, int end)
+{
+    SPCRE::MatchInfo match_info;
+    if (start < 0) start = 0;
+    if (end > text.length()) end = text.length();
+
+    if (m_re == NULL || start >= end) {
+        return match_info;
+    }
+
+    int ovector_count = getCaptureSubpatternCount();
+
+    if (ovector_count > PCRE_MAX_CAPTURE_GROUPS) {
+        ovector_count = PCRE_MAX_CAPTURE_GROUPS;
+    }
+
+    pcre2_match_data *matchdata = ThreadMatchData();
+    if (!matchdata) {
+        return match_info;
+    }
+    int rc = match(text, start, end, matchdata);
+    PCRE2_SIZE * ovector = pcre2_get_ovector_pointer_16(matchdata);
+
+    if (rc >= 0 && ovector[0] != ovector[1]) {
+        match_info = generateMatchInfo(ovector, ovector_count);
+    }
+
+    return match_info;
+}
+
+SPCRE::MatchInfo SPCRE::getLastMatchInfo(const QString &text, int start, int end)
+{
+    if (start < 0) start = 0;
+    if (end > text.length()) end = text.length();
+
+    if (m_re == NULL || start >= end) {
+        return SPCRE::MatchInfo();
+    }
+
+    // Look in a window before end first, only going further back, twice as
+    // far each time, when it holds no match.  At worst this steps through
+    // the text about twice, rather than always stepping through all of it.
+    // Like any backwards search, a match that starts inside an earlier one
+    // may be the one found.
+    int window = LAST_MATCH_WINDOW;
+    int window_start = end;
+    do {
+        window_start = (end - start > window) ? end - window : start;
+        SPCRE::MatchInfo match_info = lastMatchInRange(text, window_start, end);
+        if (match_info.offset.first != -1) {
+            return match_info;
+        }
+        window *= 2;
+    } while (window_start > start);
+
+    return SPCRE::MatchInfo();
+}
+
+SPCRE::MatchInfo SPCRE::lastMatchInRange(const QString &text, int start, int end)
+{
+    SPCRE::MatchInfo match_info;
+    pcre2_match_data *matchdata = ThreadMatchData();
+    if (!matchdata) {
+        return match_info;
+    }
+
+    int ovector_count = getCaptureSubpatternCount();
+
+    if (ovector_count > PCRE_MAX_CAPTURE_GROUPS) {
+        ovector_count = PCRE_MAX_CAPTURE_GROUPS;
+    }
+
+    // Only the start of the last match is kept while stepping through
+    PCRE2_SIZE last_start = 0;
+    bool found = false;
+    eachMatch(text, start, end, [&](PCRE2_SIZE *ovector) {
+        last_start = ovector[0];
+        found = true;
+    });
+
+    if (found) {
+        // Match the last one again so its capture groups are in the ovector
+        int rc = match(text, last_start, end, matchdata);
+        PCRE2_SIZE * ovector = pcre2_get_ovector_pointer_16(matchdata);
+        if (rc >= 0 && ovector[0] < ovector[1]) {
+            match_info = generateMatchInfo(ovector, ovector_count);
+        }
+    }
+    return match_info;
+}
+
 bool SPCRE::replaceText(const QString &text, const QList<std::pair<int, int>> &capture_groups_offsets, const QString &replacement_pattern, QString &out)
 {
     PCREReplaceTextBuilder builder;
@@ -31,6 +31,7 @@
 #include <utility>
 
 #include <QList>
+#include <QVector>
 #include <QString>
 
 using std::pair;
@@ -41,6 +42,10 @@ using std::pair;
  * Used to find matches within a string and create replacements.
  *
  * This class is a wrapper for the PCRE2 C library.
+ *
+ * The compiled pattern is immutable after construction so a single SPCRE
+ * can be used from several threads at once.  Match data and jit stacks
+ * are kept per thread.
  */
 class SPCRE
 {
@@ -73,6 +78,33 @@ public:
         }
     };
 
+    /**
+     * Every match in a text kept in one flat array rather than as a
+     * MatchInfo, with its own list of capture groups, per match.
+     *
+     * Each match takes group_count (start, end) pairs, the whole match
+     * first.  Unlike MatchInfo all offsets are within the full text and a
+     * group that did not take part in the match is -1, -1.
+     */
+    struct MatchArray {
+        int group_count = 0;
+        QVector<int> offsets;
+
+        int count() const {
+            return group_count > 0 ? offsets.count() / (2 * group_count) : 0;
+        }
+        int start(int i) const {
+            return offsets.at(2 * group_count * i);
+        }
+        int end(int i) const {
+            return offsets.at(2 * group_count * i + 1);
+        }
+        // The group_count pairs of match i
+        const int *groups(int i) const {
+            return offsets.constData() + 2 * group_count * i;
+        }
+    };
+
     /**
      * Is the pattern valid.
      *
@@ -117,6 +149,28 @@ public:
      */
     int getCaptureStringNumber(const QString &name);
 
+    /**
+     * Was the pattern compiled by the PCRE2 JIT.
+     *
+     * @return True if matching will use the JIT, false if the interpreter.
+     */
+    bool isJITCompiled();
+
+    /**
+     * Is JIT compilation available at runtime.
+     *
+     * Checks pcre2_config(PCRE2_CONFIG_JIT) once.  The JIT can be disabled
+     * by setting the SIGIL_DISABLE_PCRE_JIT environment variable.
+     *
+     * @return True if PCRE2 was built with JIT support.
+     */
+    static bool JITAvailable();
+
+    /**
+     * Roughly how many bytes the compiled pattern and its JIT code use.
+     */
+    qint64 getMemorySize();
+
     /**
      * Generate match information from a segment of text. Finds all matching
      * instances of pattern within the given text.
@@ -129,6 +183,33 @@ public:
     MatchInfo getFirstMatchInfo(const QString &text);
     MatchInfo getLastMatchInfo(const QString &text);
 
+    /**
+     * Every match within text, as getEveryMatchInfo finds them, in a single
+     * array.  For walking through a large number of matches in order.
+     */
+    MatchArray getEveryMatchArray(const QString &text);
+
+    /**
+     * The number of matches getEveryMatchInfo would find, without keeping
+     * any of them.  The second form only counts matches within
+     * [start, end) of text.
+     */
+    int getMatchCount(const QString &text);
+    int getMatchCount(const QString &text, int start, int end);
+
+    /**
+     * Find the first or last match that lies within [start, end) of text
+     * without copying that part of it out.  The text before start is seen
+     * by lookbehinds and anchors, matching never reads past end.  The
+     * offsets returned are within the whole text.
+     *
+     * The last match is looked for in windows growing backwards from end
+     * so that a match just before end does not need every match from
+     * start onwards to be found first.
+     */
+    MatchInfo getFirstMatchInfo(const QString &text, int start, int end);
+    MatchInfo getLastMatchInfo(const QString &text, int start, int end);
+
     /**
      * Replaces the given text using a replacement pattern. The matched text is
      * required because the replacement pattern can references the capture
@@ -148,6 +229,17 @@ public:
 private:
     MatchInfo generateMatchInfo(PCRE2_SIZE* ovector, int ovector_count);
 
+    int match(const QString &text, PCRE2_SIZE start_offset, pcre2_match_data *matchdata);
+    int match(const QString &text, PCRE2_SIZE start_offset, PCRE2_SIZE end, pcre2_match_data *matchdata);
+
+    template<typename Found>
+    void eachMatch(const QString &text, PCRE2_SIZE start, PCRE2_SIZE end, Found found);
+
+    // The last match found stepping through [start, end) of the text
+    MatchInfo lastMatchInRange(const QString &text, int start, int end);
+
+    size_t jitStackMaxSize();
+
     // Store if the pattern is valid.
     bool m_valid;
 
@@ -161,18 +253,18 @@ private:
     // The compiled regular expression.
     pcre2_code *m_re;
 
-    // The place to store match data results.
-    pcre2_match_data *m_matchdata;
-
     // The number of capture subpatterns with the expression.
     int m_captureSubpatternCount;
 
     // The place to store match context info such as JIT
+    // Only read while matching so it is shared across threads.
     pcre2_match_context * m_mcontext;
 
-#ifndef PCRE_NO_JIT
-    pcre2_jit_stack* m_jitstack;
-#endif
+    // The largest jit stack this pattern may need
+    size_t m_jitStackMax;
+
+    // Was the pattern successfully jit compiled
+    bool m_jit;
 
 };
 
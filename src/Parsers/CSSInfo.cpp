@@ -22,6 +22,8 @@
 **
 *************************************************************************/
 
+#include <QHash>
+#include <QSet>
 #include <QString>
 #include <QRegularExpression>
 #include <QDebug>
@@ -54,7 +56,7 @@ CSSInfo::~CSSInfo()
 }
 
 
-QList<CSSInfo::CSSSelector *> CSSInfo::getAllSelectors()
+QList<CSSInfo::CSSSelector *> CSSInfo::getAllSelectors() const
 {
     QList<CSSInfo::CSSSelector *> selectors;
     foreach(CSSInfo::CSSSelector * cssSelector, m_CSSSelectors) {
@@ -64,7 +66,7 @@ QList<CSSInfo::CSSSelector *> CSSInfo::getAllSelectors()
 }
 
 
-QList<CSSInfo::CSSSelector *> CSSInfo::getClassSelectors(const QString filterClassName)
+QList<CSSInfo::CSSSelector *> CSSInfo::getClassSelectors(const QString filterClassName) const
 {
     QList<CSSInfo::CSSSelector *> selectors;
     foreach(CSSInfo::CSSSelector * cssSelector, m_CSSSelectors) {
@@ -78,7 +80,7 @@ QList<CSSInfo::CSSSelector *> CSSInfo::getClassSelectors(const QString filterCla
 }
 
 
-CSSInfo::CSSSelector *CSSInfo::getCSSSelectorForElementClass(const QString &elementName, const QString &className)
+CSSInfo::CSSSelector *CSSInfo::getCSSSelectorForElementClass(const QString &elementName, const QString &className) const
 {
     if (!className.isEmpty()) {
         // Find the selector(s) if any with this class name
@@ -112,7 +114,7 @@ CSSInfo::CSSSelector *CSSInfo::getCSSSelectorForElementClass(const QString &elem
 }
 
 
-QList<CSSInfo::CSSSelector *> CSSInfo::getAllSelectorsWithCombinators()
+QList<CSSInfo::CSSSelector *> CSSInfo::getAllSelectorsWithCombinators() const
 {
     QList<CSSInfo::CSSSelector *> matches;
     foreach(CSSInfo::CSSSelector * cssSelector, m_CSSSelectors) {
@@ -126,7 +128,7 @@ QList<CSSInfo::CSSSelector *> CSSInfo::getAllSelectorsWithCombinators()
 }
 
 
-QList<CSSInfo::CSSSelector *> CSSInfo::getAllCSSSelectorsForElementClass(const QString &elementName, const QString &className)
+QList<CSSInfo::CSSSelector *> CSSInfo::getAllCSSSelectorsForElementClass(const QString &elementName, const QString &className) const
 {
     QList<CSSInfo::CSSSelector *> matches;
     if (!className.isEmpty()) {
@@ -157,7 +159,7 @@ QList<CSSInfo::CSSSelector *> CSSInfo::getAllCSSSelectorsForElementClass(const Q
 }
 
 
-QStringList CSSInfo::getAllPropertyValues(QString property)
+QStringList CSSInfo::getAllPropertyValues(QString property) const
 {
     QStringList property_values;
     bool inselector = false;
@@ -182,77 +184,80 @@ QStringList CSSInfo::getAllPropertyValues(QString property)
 }
 
 
-QString CSSInfo::getReformattedCSSText(bool multipleLineFormat)
+QString CSSInfo::getReformattedCSSText(bool multipleLineFormat) const
 {
-    QString csstext(m_source);
-
-    CSSParser cp;
-    cp.set_level("CSS3.0"); // most permissive
-    cp.parse_css(csstext);
-
-    QVector<QString> errors = cp.get_parse_errors();
-    if (!errors.isEmpty()) {
+    // the tokens from the constructor are serialized again rather
+    // than parsing the source a second time
+    if (!m_parse_errors.isEmpty()) {
         QString error_msg = "";
-        for(int i = 0; i < errors.size(); i++) {
-            error_msg = error_msg + "CSS Parser Error: " + errors[i] +  "\n";
+        for(int i = 0; i < m_parse_errors.size(); i++) {
+            error_msg = error_msg + "CSS Parser Error: " + m_parse_errors[i] +  "\n";
         }
         Utility::DisplayStdWarningDialog(QString("CSS Error: "), error_msg); 
         // a css parser error happened, return unchanged original
-        return csstext;
+        return m_source;
     }
     
-    QString new_csstext = cp.serialize_css(false, multipleLineFormat);
-    return new_csstext;
+    return getSerializedCSSText(multipleLineFormat ? MultipleLineFormat : SingleLineFormat);
+}
+
+
+QString CSSInfo::getSerializedCSSText(CSSFormat format) const
+{
+    if (!m_parse_errors.isEmpty()) {
+        return m_source;
+    }
+    CSSParser cp;
+    cp.set_level("CSS3.0"); // most permissive
+    cp.set_csstokens(m_csstokens);
+    if (format == MinifiedFormat) {
+        return cp.serialize_css_minified();
+    }
+    return cp.serialize_css(false, format == MultipleLineFormat);
 }
 
 
-QString CSSInfo::removeMatchingSelectors(QList<CSSSelector *> cssSelectors)
+QString CSSInfo::removeMatchingSelectors(QList<CSSSelector *> cssSelectors) const
 {
-    // First try to find a CSS selector currently parsed that matches each of the selectors supplied.
-    QList<CSSSelector *> remove_selectors;
+    // Index the selectors to remove by position (unique key) and text
+    // so that each parsed selector and token is only looked at once
+    QHash<int, QSet<QString> > remove_keys;
     foreach(CSSSelector * css_selector, cssSelectors) {
-        foreach(CSSSelector * match_selector, m_CSSSelectors) {
-            if ((match_selector->pos == css_selector->pos) &&
-                (match_selector->text == css_selector->text)) {
-                remove_selectors.append(match_selector);
-            }
-        }
+        remove_keys[css_selector->pos].insert(css_selector->text);
     }
 
-    // If no matches found, return a null string to caller
-    if (remove_selectors.isEmpty()) {
+    // If none of the selectors currently parsed match, return a null string to caller
+    bool found_match = false;
+    foreach(CSSSelector * match_selector, m_CSSSelectors) {
+        if (remove_keys.value(match_selector->pos).contains(match_selector->text)) {
+            found_match = true;
+            break;
+        }
+    }
+    if (!found_match) {
         return QString();
     }
 
-    // Sort the selectors by pos ascending.
-    std::sort(remove_selectors.begin(), remove_selectors.end(), dereferencedLessThan<CSSSelector>);
-
     QVector<CSSParser::token> new_csstokens;
+    new_csstokens.reserve(m_csstokens.size());
 
     int i = 0;
     while(i < m_csstokens.size()) {
         CSSParser::token atoken = m_csstokens[i];
         bool store_it = true;
         if (atoken.type == CSSParser::SEL_START && !atoken.data.startsWith('@')) {
-            // we have a selector
+            // we have a selector, drop the ones at this position
+            // whose text is to be removed
             QStringList sels = CSSParser::splitGroupSelector(atoken.data);
-
-            // now walk though the remove selector list looking
-            // for matching selector by position (unique key) and text and if matching
-            // remove this selector
-            foreach(CSSSelector * css_selector, remove_selectors) {
-                if (css_selector->pos < atoken.pos) continue;
-                if (css_selector->pos == atoken.pos) {
-                    int found = -1;
-                    for (int i = 0; i < sels.size(); i++) {
-                        if (css_selector->text == sels.at(i)) {
-                            found = i;
-                            break;
-                        }
+            if (remove_keys.contains(atoken.pos)) {
+                const QSet<QString> &texts = remove_keys[atoken.pos];
+                QStringList kept;
+                foreach(const QString &sel, sels) {
+                    if (!texts.contains(sel)) {
+                        kept.append(sel);
                     }
-                    if (found != -1) sels.removeAt(found);
                 }
-                if (css_selector->pos > atoken.pos) break;
+                sels = kept;
             }
             if (!sels.isEmpty()) {
                 // recreate this token
@@ -294,9 +299,9 @@ void CSSInfo::parseStyles(const QString &text, int offset)
     cp.parse_css(text);
 
     // report any parser errors (should we abort?)
-    QVector<QString> errors = cp.get_parse_errors();
-    for(int i = 0; i < errors.size(); i++) {
-        qDebug() << "  CSS Parser Error: " << errors[i] << "\n";
+    m_parse_errors = cp.get_parse_errors();
+    for(int i = 0; i < m_parse_errors.size(); i++) {
+        qDebug() << "  CSS Parser Error: " << m_parse_errors[i] << "\n";
     }
 
     // now store the sequence of parsed tokens
@@ -325,18 +330,44 @@ void CSSInfo::parseStyles(const QString &text, int offset)
 void CSSInfo::generateSelectorsList()
 {
     // now walk the sequence of previously parsed tokens
+    int at_depth = 0;
     int i = 0;
     while(i < m_csstokens.size()) {
         CSSParser::token atoken = m_csstokens[i];
 
+        if (atoken.type == CSSParser::AT_START) {
+            at_depth++;
+        } else if (atoken.type == CSSParser::AT_END) {
+            if (at_depth > 0) at_depth--;
+        }
+
         if (atoken.type == CSSParser::SEL_START && !atoken.data.startsWith('@')) {
             QStringList sels = CSSParser::splitGroupSelector(atoken.data);
 
+            // the declarations are shared by every selector of the group
+            QStringList properties;
+            QStringList important_properties;
+            int j = i + 1;
+            while (j < m_csstokens.size() && m_csstokens[j].type != CSSParser::SEL_END) {
+                if (m_csstokens[j].type == CSSParser::PROPERTY) {
+                    QString property = m_csstokens[j].data.toLower();
+                    properties.append(property);
+                    if ((j + 1 < m_csstokens.size()) && (m_csstokens[j + 1].type == CSSParser::VALUE) &&
+                        m_csstokens[j + 1].data.contains("!important", Qt::CaseInsensitive)) {
+                        important_properties.append(property);
+                    }
+                }
+                j++;
+            }
+
             foreach(QString asel, sels) {
 
                 CSSSelector *selector = new CSSSelector();
                 selector->text = asel;
                 selector->pos = atoken.pos;
+                selector->properties = properties;
+                selector->importantProperties = important_properties;
+                selector->inAtRule = at_depth > 0;
 
                 // if a pure class selector or pure element selector
                 bool uses_pseudoclasses = asel.contains(':');
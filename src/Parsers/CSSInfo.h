@@ -30,6 +30,12 @@
 #include <QStringList>
 #include "Parsers/qCSSParser.h"
 
+/**
+ * The selectors and tokens of a style sheet.  Once constructed a
+ * CSSInfo is never changed, so the copy a CSSResource keeps for its
+ * current text can be shared by any number of threads as long as
+ * they only use the const routines.
+ */
 class CSSInfo : public QObject
 {
     Q_OBJECT
@@ -42,32 +48,41 @@ public:
 
     ~CSSInfo();
 
+    enum CSSFormat {
+        MultipleLineFormat,
+        SingleLineFormat,
+        MinifiedFormat
+    };
+
     struct CSSSelector {
         int pos;                    /* The position in the file of the full selector name          */
         QString text;               /* The text of this selector                  */
         QString className;          /* The classname(s) (stripped of periods) if a class selector  */
         QString elementName;        /* The element names if any (stripped of any ids/attributes)   */
+        QStringList properties;     /* The lowercase names of the properties the rule sets         */
+        QStringList importantProperties; /* Those of the properties marked !important              */
+        bool inAtRule;              /* Inside an @media or other at-rule block                     */
 
         bool operator<(const CSSSelector &rhs) const {
             return pos < rhs.pos;
         }
     };
 
-    QList<CSSSelector*> getAllSelectors();
+    QList<CSSSelector*> getAllSelectors() const;
 
-    QList<CSSSelector*> getAllSelectorsWithCombinators();
+    QList<CSSSelector*> getAllSelectorsWithCombinators() const;
 
     /**
      * Return selectors subset for only class based CSS declarations.
      */
-    QList<CSSSelector *> getClassSelectors(const QString filterClassName = "");
+    QList<CSSSelector *> getClassSelectors(const QString filterClassName = "") const;
 
     /**
      * Search for a matching class selector  given an element name and an optional
      * class name for the style.
      * Looks in order of: elementName.style, .style
      */
-    CSSSelector *getCSSSelectorForElementClass(const QString &elementName, const QString &className);
+    CSSSelector *getCSSSelectorForElementClass(const QString &elementName, const QString &className) const;
 
     /**
      * Search for *all* CSS selector that match an elementName, and classname
@@ -75,18 +90,27 @@ public:
      * relate to more than one style
      */
 
-    QList<CSSSelector *> getAllCSSSelectorsForElementClass(const QString &elementName, const QString &className);
+    QList<CSSSelector *> getAllCSSSelectorsForElementClass(const QString &elementName, const QString &className) const;
 
     /**
      * Return a list of all property values for the given property in the CSS.
      */
-    QStringList getAllPropertyValues(QString property);
+    QStringList getAllPropertyValues(QString property) const;
 
     /**
      * Return the original text with a reformatted appearance either to
      * a multiple line style (each property on its own line) or single line style.
      */
-    QString getReformattedCSSText(bool multipleLineFormat);
+    QString getReformattedCSSText(bool multipleLineFormat) const;
+
+    /**
+     * Return the text serialized in the given format without reporting
+     * parse errors, so it can be used from worker threads.  The original
+     * text is returned unchanged if the css could not be parsed.
+     */
+    QString getSerializedCSSText(CSSFormat format) const;
+
+    bool hasParseErrors() const { return !m_parse_errors.isEmpty(); };
 
     /**
      * Search for a CSSSelector with the same definition of original group text and pos as this,
@@ -94,7 +118,7 @@ public:
      * If not found returns a null string.
      * Note the caller must intialise a new CSSInfo object to re-parse the updated text for another remove.
      */
-    QString removeMatchingSelectors(QList<CSSSelector *> cssSelectors);
+    QString removeMatchingSelectors(QList<CSSSelector *> cssSelectors) const;
 
     // QString replaceBlockComments(const QString &text);
 
@@ -104,6 +128,7 @@ private:
 
     QList<CSSSelector *> m_CSSSelectors;
     QVector<CSSParser::token> m_csstokens;
+    QVector<QString> m_parse_errors;
 
     QString m_source;
     int m_posoffset;
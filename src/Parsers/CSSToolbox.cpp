@@ -393,13 +393,14 @@ QStringList CSSToolbox::get_linked_css_hrefs(const QString &source)
     QuickParser qp(source);
     QStringList css_hrefs;
     while(true) {
-        QuickParser::MarkupInfo mi = qp.parse_next();
-        if (mi.pos < 0) break;
-        if (mi.text.isEmpty()) {
-            if (mi.tname == "link" && mi.tpath.contains(".head")) {
-                if (mi.tattr.value("rel", "") == "stylesheet") css_hrefs << mi.tattr.value("href","");
+        QuickParser::MarkupSpan ms = qp.parse_next_span();
+        if (ms.pos < 0) break;
+        if (ms.type != QuickParser::TextMarkup) {
+            const QString &tname = qp.name(ms.name);
+            if (tname == "link" && qp.tag_path().contains(".head")) {
+                if (qp.attribute(ms, "rel") == "stylesheet") css_hrefs << qp.attribute(ms, "href");
             }
-            if ((mi.tname == "head") && (mi.ttype == "end")) break;
+            if ((tname == "head") && (ms.type == QuickParser::EndMarkup)) break;
         }
     }
     return css_hrefs;
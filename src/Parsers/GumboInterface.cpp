@@ -19,6 +19,8 @@
 **
 *************************************************************************/
 
+#include <string.h>
+
 #include <QString>
 #include <QStringList>
 #include <QRegularExpression>
@@ -26,10 +28,13 @@
 #include <QDir>
 #include <QUrl>
 #include <QFileInfo>
+#include <QStringEncoder>
+#include <QStringDecoder>
 // #include <QDebug>
 
 #include "Misc/Utility.h"
 #include "Query/CSelection.h"
+#include "Query/CSelectorIndex.h"
 #include "Query/CNode.h"
 #include "Parsers/GumboInterface.h"
 #include "string_buffer.h"
@@ -98,6 +103,8 @@ static std::unordered_set<std::string> href_src_tags       = {
 
 static const QChar POUND_SIGN    = QChar::fromLatin1('#');
 static const QChar FORWARD_SLASH = QChar::fromLatin1('/');
+static const char XML_HEADER[] = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+static const int XML_HEADER_LEN = sizeof(XML_HEADER) - 1;
 static const std::string aSRC = std::string("src");
 static const std::string aHREF = std::string("href");
 static const std::string aPOSTER = std::string("poster");
@@ -105,6 +112,16 @@ static const std::string aDATA = std::string("data");
 static const std::string aSRCSET = std::string("srcset");
 QHash<QString,QString> EmptyHash = QHash<QString,QString>();
 
+// urls in css that name other files
+static const QRegularExpression STYLE_URL_REFERENCE(
+    "(?:(?:src|background|background-image|list-style|list-style-image|border-image|border-image-source|content)\\s*:|@import)\\s*"
+    "[^;\\}\\(\"']*"
+    "(?:"
+    "url\\([\"']?([^\\(\\)\"']*)[\"']?\\)"
+    "|"
+    "[\"']([^\\(\\)\"']*)[\"']"
+    ")");
+
 // These need to match the GumboAttributeNamespaceEnum sequence
 static const char * attribute_nsprefixes[4] = { "", "xlink:", "xml:", "xmlns:" };
  
@@ -118,11 +135,18 @@ static const char * attribute_nsprefixes[4] = { "", "xlink:", "xml:", "xmlns:" }
 // Do NOT change or delete m_utf8src once set until after you 
 // have properly destroyed the gumbo output tree
 
+// Gumbo is handed m_utf8src from m_srcoffset on so that any xml
+// header can be skipped without moving the rest of the source
+
 GumboInterface::GumboInterface(const QString &source, const QString &version)
     : m_source(source),
       m_output(NULL),
+      m_arena(NULL),
       m_utf8src(""),
+      m_srcoffset(0),
       m_sourceupdates(EmptyHash),
+      m_styleupdates(EmptyHash),
+      m_queuedupdates(NoUpdates),
       m_newcsslinks(""),
       m_currentbkpath(""),
       m_currentdir(""),
@@ -136,8 +160,33 @@ GumboInterface::GumboInterface(const QString &source, const QString &version)
 GumboInterface::GumboInterface(const QString &source, const QString &version, const QHash<QString,QString> & source_updates)
     : m_source(source),
       m_output(NULL),
+      m_arena(NULL),
       m_utf8src(""),
+      m_srcoffset(0),
       m_sourceupdates(source_updates),
+      m_styleupdates(source_updates),
+      m_queuedupdates(NoUpdates),
+      m_newcsslinks(""),
+      m_currentbkpath(""),
+      m_currentdir(""),
+      m_newbody(""),
+      m_version(version),
+      m_newbookpath("")
+{
+}
+
+
+// style urls are updated from style_updates by perform_source_updates in the same pass
+GumboInterface::GumboInterface(const QString &source, const QString &version, const QHash<QString,QString> & source_updates,
+                               const QHash<QString,QString> & style_updates)
+    : m_source(source),
+      m_output(NULL),
+      m_arena(NULL),
+      m_utf8src(""),
+      m_srcoffset(0),
+      m_sourceupdates(source_updates),
+      m_styleupdates(style_updates),
+      m_queuedupdates(style_updates.isEmpty() ? NoUpdates : StyleUpdates),
       m_newcsslinks(""),
       m_currentbkpath(""),
       m_currentdir(""),
@@ -155,6 +204,77 @@ GumboInterface::~GumboInterface()
         m_output = NULL;
         m_utf8src = "";
     }
+    // everything the parse allocated goes in one go
+    if (m_arena != NULL) {
+        gumbo_arena_destroy(m_arena);
+        m_arena = NULL;
+    }
+}
+
+
+// Makes an arena current for the gumbo calls made while it is in scope
+// and restores whatever was current before.  Nodes and attributes added
+// after the parse come from the heap and are freed by gumbo_destroy_output
+// as usual, it skips over the blocks that live in the arena.
+class GumboArenaScope
+{
+public:
+    GumboArenaScope(GumboArena* arena) : m_previous(gumbo_arena_set_current(arena)) {}
+    ~GumboArenaScope() { gumbo_arena_set_current(m_previous); }
+private:
+    GumboArena* m_previous;
+};
+
+
+// Transcodes m_source straight into m_utf8src with no intermediate QByteArray
+void GumboInterface::load_utf8_source()
+{
+    QStringEncoder encoder(QStringConverter::Utf8);
+    m_utf8src.resize(encoder.requiredSpace(m_source.length()));
+    char* end = encoder.appendToBuffer(&m_utf8src[0], m_source);
+    m_utf8src.resize(end - m_utf8src.data());
+    m_srcoffset = 0;
+}
+
+
+// Returns the offset just past any xml header line and the whitespace after it
+size_t GumboInterface::xml_header_end()
+{
+    if (m_utf8src.compare(0,5,"<?xml") != 0) return 0;
+    size_t end = m_utf8src.find_first_of('>', 5);
+    end = m_utf8src.find_first_not_of("\n\r\t\v\f ",end+1);
+    if (end == std::string::npos) return m_utf8src.length();
+    return end;
+}
+
+
+// Decodes serialized output directly into a QString sized for it,
+// optionally preceded by the xml header
+QString GumboInterface::to_qstring(const std::string &utf8out, bool add_header)
+{
+    int start = add_header ? XML_HEADER_LEN : 0;
+    QString result(start + utf8out.length(), Qt::Uninitialized);
+    QChar* out = result.data();
+    for (int i = 0; i < start; i++) {
+        *out++ = QLatin1Char(XML_HEADER[i]);
+    }
+    QStringDecoder decoder(QStringConverter::Utf8);
+    QChar* end = decoder.appendToBuffer(out, QByteArrayView(utf8out.data(), utf8out.length()));
+    result.truncate(end - result.constData());
+    return result;
+}
+
+
+// Returns NULL (plain heap allocation) if disabled by SIGIL_DISABLE_GUMBO_ARENA
+GumboArena* GumboInterface::create_arena()
+{
+    static const bool use_arena = !qEnvironmentVariableIsSet("SIGIL_DISABLE_GUMBO_ARENA");
+    if (!use_arena) return NULL;
+    if (m_arena == NULL) {
+        // the tree usually needs a few times the size of the source
+        m_arena = gumbo_arena_create(m_utf8src.length() * 2);
+    }
+    return m_arena;
 }
 
 
@@ -162,13 +282,9 @@ void GumboInterface::parse()
 {
     if (!m_source.isEmpty() && (m_output == NULL)) {
 
-        m_utf8src = m_source.toStdString();
-        // remove any xml header line and any trailing whitespace
-        if (m_utf8src.compare(0,5,"<?xml") == 0) {
-            size_t end = m_utf8src.find_first_of('>', 5);
-            end = m_utf8src.find_first_not_of("\n\r\t\v\f ",end+1);
-            m_utf8src.erase(0,end);
-        }
+        load_utf8_source();
+        // skip over any xml header line and any trailing whitespace
+        m_srcoffset = xml_header_end();
 
         // In case we ever have to revert to earlier versions, please note the following
         // additional initialization is needed because Microsoft Visual Studio 2013 (and earlier?)
@@ -184,13 +300,15 @@ void GumboInterface::parse()
         myoptions.max_errors = 50;
 
         // GumboInterface::m_mutex.lock();
-        m_output = gumbo_parse_with_options(&myoptions, m_utf8src.data(), m_utf8src.length());
+        GumboArenaScope arena_scope(create_arena());
+        m_output = gumbo_parse_with_options(&myoptions, m_utf8src.data() + m_srcoffset,
+                                            m_utf8src.length() - m_srcoffset);
         // GumboInterface::m_mutex.unlock();
     }
 }
 
 
-void GumboInterface::parse_fragment()
+void GumboInterface::parse_fragment(GumboTag context, GumboNamespaceEnum context_namespace)
 {
     if (!m_source.isEmpty() && (m_output == NULL)) {
 
@@ -207,10 +325,98 @@ void GumboInterface::parse_fragment()
         myoptions.max_tree_depth = 400;
         myoptions.max_errors = 50;
 
-        m_utf8src = m_source.toStdString();
+        load_utf8_source();
+        GumboArenaScope arena_scope(create_arena());
         m_output = gumbo_parse_fragment(&myoptions, m_utf8src.data(), m_utf8src.length(),
-                                        GUMBO_TAG_BODY, GUMBO_NAMESPACE_HTML);
-        m_output = gumbo_parse_with_options(&myoptions, m_utf8src.data(), m_utf8src.length());
+                                        context, context_namespace);
+    }
+}
+
+
+bool GumboInterface::replace_contents_of_node(GumboNode* node, const QString &contents)
+{
+    if (!m_output || !node || ((node->type != GUMBO_NODE_ELEMENT) && (node->type != GUMBO_NODE_TEMPLATE))) {
+        return false;
+    }
+
+    GumboOptions myoptions = kGumboDefaultOptions;
+    myoptions.tab_stop = 4;
+    myoptions.use_xhtml_rules = true;
+    myoptions.stop_on_first_error = false;
+    myoptions.max_tree_depth = 400;
+    myoptions.max_errors = 50;
+
+    // the new nodes point into their source so it lives as long as the tree
+    QByteArray utf8 = contents.toUtf8();
+    m_fragmentsrcs.push_back(std::string(utf8.constData(), utf8.length()));
+    const std::string &fragsrc = m_fragmentsrcs.back();
+
+    GumboArenaScope arena_scope(create_arena());
+    GumboOutput* fragment = gumbo_parse_fragment(&myoptions, fragsrc.data(), fragsrc.length(),
+                                                 node->v.element.tag, node->v.element.tag_namespace);
+
+    // the contents start just after the start tag of node
+    GumboSourcePosition base = node->v.element.start_pos;
+    const GumboStringPiece &start_tag = node->v.element.original_tag;
+    for (size_t i = 0; i < start_tag.length; i++) {
+        if (start_tag.data[i] == '\n') {
+            base.line++;
+            base.column = 1;
+        } else {
+            base.column++;
+        }
+    }
+    base.offset += start_tag.length;
+
+    // drop the old children, anything of theirs in the arena goes with it
+    GumboVector* children = &node->v.element.children;
+    for (unsigned int i = 0; i < children->length; i++) {
+        GumboNode* child = static_cast<GumboNode*>(children->data[i]);
+        child->parent = NULL;
+        gumbo_destroy_node(child);
+    }
+    children->length = 0;
+
+    // and move the new ones over from the root of the fragment
+    GumboVector* newchildren = &fragment->root->v.element.children;
+    for (unsigned int i = 0; i < newchildren->length; i++) {
+        GumboNode* child = static_cast<GumboNode*>(newchildren->data[i]);
+        child->parent = NULL;
+        child->index_within_parent = -1;
+        shift_source_positions(child, base);
+        gumbo_append_node(node, child);
+    }
+    newchildren->length = 0;
+    gumbo_destroy_output(fragment);
+    return true;
+}
+
+
+// Moves a position counted from the start of a fragment
+// to one counted from base, where the fragment starts
+static void shift_source_position(GumboSourcePosition &pos, const GumboSourcePosition &base)
+{
+    // parser inserted nodes have no position
+    if (pos.line == 0) return;
+    if (pos.line == 1) {
+        pos.column += base.column - 1;
+    }
+    pos.line += base.line - 1;
+    pos.offset += base.offset;
+}
+
+
+void GumboInterface::shift_source_positions(GumboNode* node, const GumboSourcePosition &base)
+{
+    if ((node->type == GUMBO_NODE_ELEMENT) || (node->type == GUMBO_NODE_TEMPLATE)) {
+        shift_source_position(node->v.element.start_pos, base);
+        shift_source_position(node->v.element.end_pos, base);
+        GumboVector* children = &node->v.element.children;
+        for (unsigned int i = 0; i < children->length; i++) {
+            shift_source_positions(static_cast<GumboNode*>(children->data[i]), base);
+        }
+    } else if (node->type != GUMBO_NODE_DOCUMENT) {
+        shift_source_position(node->v.text.start_pos, base);
     }
 }
 
@@ -224,7 +430,7 @@ QString GumboInterface::repair()
         }
         std::string utf8out = serialize(m_output->document);
         rtrim(utf8out);
-        result =  "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n" + QString::fromStdString(utf8out);
+        result = to_qstring(utf8out, true);
     }
     return result;
 }
@@ -237,9 +443,10 @@ QString GumboInterface::get_fragment_xhtml()
         if (m_output == NULL) {
             parse_fragment();
         }
-        std::string utf8out = serialize(m_output->document);
+        // the fragment is parsed into the children of the root
+        std::string utf8out = serialize_contents(m_output->root);
         rtrim(utf8out);
-        result = QString::fromStdString(utf8out);
+        result = to_qstring(utf8out, false);
     }
     return result;
 }
@@ -254,7 +461,7 @@ QString GumboInterface::getxhtml()
         }
         std::string utf8out = serialize(m_output->document);
         rtrim(utf8out);
-        result =  "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n" + QString::fromStdString(utf8out);
+        result = to_qstring(utf8out, true);
     }
     return result;
 }
@@ -289,6 +496,29 @@ CSelection GumboInterface::find(const QString &aSelector)
     return CSelection(NULL);
 }
 
+std::vector<bool> GumboInterface::findany(const CSelectorIndex &index, const std::vector<bool> &wanted)
+{
+    if (!m_source.isEmpty()) {
+        if (m_output == NULL) {
+            parse();
+        }
+        return index.matchAny(m_output->root, wanted);
+    }
+    return std::vector<bool>(index.size(), false);
+}
+
+
+std::vector<std::pair<GumboNode*, std::vector<size_t> > > GumboInterface::findeach(const CSelectorIndex &index, const std::vector<bool> &wanted)
+{
+    if (!m_source.isEmpty()) {
+        if (m_output == NULL) {
+            parse();
+        }
+        return index.matchEach(m_output->root, wanted);
+    }
+    return std::vector<std::pair<GumboNode*, std::vector<size_t> > >();
+}
+
 
 QString GumboInterface::prettyprint(QString indent_chars)
 {
@@ -300,7 +530,7 @@ QString GumboInterface::prettyprint(QString indent_chars)
         std::string ind = indent_chars.toStdString();
         std::string utf8out = prettyprint(m_output->document, 0, ind);
         rtrim(utf8out);
-        result =  "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n" + QString::fromStdString(utf8out);
+        result = to_qstring(utf8out, true);
     }
     return result;
 }
@@ -330,10 +560,10 @@ QString GumboInterface::perform_source_updates(const QString& my_current_book_re
         if (m_output == NULL) {
             parse();
         }
-        enum UpdateTypes doupdates = SourceUpdates;
+        enum UpdateTypes doupdates = static_cast<UpdateTypes>(SourceUpdates | m_queuedupdates);
         std::string utf8out = serialize(m_output->document, doupdates);
         rtrim(utf8out);
-        result =  "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n" + QString::fromStdString(utf8out);
+        result = to_qstring(utf8out, true);
     }
     return result;
 }
@@ -354,7 +584,7 @@ QString GumboInterface::perform_style_updates(const QString& my_current_book_rel
         enum UpdateTypes doupdates = StyleUpdates;
         std::string utf8out = serialize(m_output->document, doupdates);
         rtrim(utf8out);
-        result =  "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n" + QString::fromStdString(utf8out);
+        result = to_qstring(utf8out, true);
     }
     return result;
 }
@@ -371,7 +601,7 @@ QString GumboInterface::perform_link_updates(const QString& newcsslinks)
         enum UpdateTypes doupdates = LinkUpdates;
         std::string utf8out = serialize(m_output->document, doupdates);
         rtrim(utf8out);
-        result =  "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n" + QString::fromStdString(utf8out);
+        result = to_qstring(utf8out, true);
     }
     return result;
 }
@@ -388,7 +618,36 @@ QString GumboInterface::perform_javascript_updates(const QString& newjslinks)
         enum UpdateTypes doupdates = JavascriptUpdates;
         std::string utf8out = serialize(m_output->document, doupdates);
         rtrim(utf8out);
-        result =  "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n" + QString::fromStdString(utf8out);
+        result = to_qstring(utf8out, true);
+    }
+    return result;
+}
+
+
+void GumboInterface::queue_link_updates(const QString& newcsslinks)
+{
+    m_newcsslinks = newcsslinks.toStdString();
+    m_queuedupdates = static_cast<UpdateTypes>(m_queuedupdates | LinkUpdates);
+}
+
+
+void GumboInterface::queue_javascript_updates(const QString& newjslinks)
+{
+    m_newjslinks = newjslinks.toStdString();
+    m_queuedupdates = static_cast<UpdateTypes>(m_queuedupdates | JavascriptUpdates);
+}
+
+
+QString GumboInterface::perform_queued_updates()
+{
+    QString result = "";
+    if (!m_source.isEmpty()) {
+        if (m_output == NULL) {
+            parse();
+        }
+        std::string utf8out = serialize(m_output->document, m_queuedupdates);
+        rtrim(utf8out);
+        result = to_qstring(utf8out, true);
     }
     return result;
 }
@@ -448,6 +707,37 @@ QString GumboInterface::get_body_contents()
     return QString::fromStdString(results);
 }
 
+bool GumboInterface::get_preview_parts(QString &head, QStringList &body_children)
+{
+    head.clear();
+    body_children.clear();
+    QList<GumboNode*> heads = get_all_nodes_with_tag(GUMBO_TAG_HEAD);
+    GumboNode* body = get_body_node();
+    if ((heads.count() != 1) || !body) {
+        return false;
+    }
+    std::string head_parts;
+    serialize_to(head_parts, heads.at(0), NoUpdates);
+    GumboVector* attribs = &body->v.element.attributes;
+    for (unsigned int i = 0; i < attribs->length; ++i) {
+        write_attribute(head_parts, static_cast<GumboAttribute*>(attribs->data[i]), false);
+    }
+    head = QString::fromStdString(head_parts);
+    GumboVector* children = &body->v.element.children;
+    for (unsigned int i = 0; i < children->length; ++i) {
+        GumboNode* child = static_cast<GumboNode*>(children->data[i]);
+        if (child->type == GUMBO_NODE_ELEMENT) {
+            std::string child_xhtml;
+            serialize_to(child_xhtml, child, NoUpdates);
+            body_children.append(QString::fromStdString(child_xhtml));
+        } else if ((child->type == GUMBO_NODE_TEXT) || (child->type == GUMBO_NODE_CDATA)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
 QString GumboInterface::get_body_text() 
 {
     if (!m_source.isEmpty()) {
@@ -613,7 +903,7 @@ QString GumboInterface::perform_body_updates(const QString & new_body)
     m_newbody = new_body.toStdString();
     enum UpdateTypes doupdates = BodyUpdates;
     std::string utf8out = serialize(m_output->document, doupdates);
-    result =  "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n" + QString::fromStdString(utf8out);
+    result = to_qstring(utf8out, true);
     m_newbody= "";
     return result;
 }
@@ -639,24 +929,25 @@ QList<GumboWellFormedError> GumboInterface::error_check()
 
     if (!m_source.isEmpty() && (m_output == NULL)) {
 
-        m_utf8src = m_source.toStdString();
-        // remove any xml header line and trailing whitespace
-        if (m_utf8src.compare(0,5,"<?xml") == 0) {
-            size_t end = m_utf8src.find_first_of('>', 0);
-            end = m_utf8src.find_first_not_of("\n\r\t\v\f ",end+1);
-            m_utf8src.erase(0,end);
+        load_utf8_source();
+        // skip over any xml header line and trailing whitespace
+        m_srcoffset = xml_header_end();
+        if (m_srcoffset > 0) {
             line_offset++;
         }
-        // add in epub version specific doctype if missing
-        if ((m_utf8src.compare(0,9,"<!DOCTYPE") != 0) && (m_utf8src.compare(0,9,"<!doctype") != 0)) {
+        // add in epub version specific doctype if missing, in place of the header
+        if ((m_utf8src.compare(m_srcoffset,9,"<!DOCTYPE") != 0) && (m_utf8src.compare(m_srcoffset,9,"<!doctype") != 0)) {
             if (m_version.startsWith('3')) {
-                m_utf8src.insert(0,"<!DOCTYPE html>\n");
+                m_utf8src.replace(0, m_srcoffset, "<!DOCTYPE html>\n");
             } else {
-                m_utf8src.insert(0, "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.1//EN\"\n  \"http://www.w3.org/TR/xhtml11/DTD/xhtml11.dtd\">\n\n");
+                m_utf8src.replace(0, m_srcoffset, "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.1//EN\"\n  \"http://www.w3.org/TR/xhtml11/DTD/xhtml11.dtd\">\n\n");
             }
+            m_srcoffset = 0;
             line_offset--;
         }
-        m_output = gumbo_parse_with_options(&myoptions, m_utf8src.data(), m_utf8src.length());
+        GumboArenaScope arena_scope(create_arena());
+        m_output = gumbo_parse_with_options(&myoptions, m_utf8src.data() + m_srcoffset,
+                                            m_utf8src.length() - m_srcoffset);
     }
     // qDebug() << QString::fromStdString(m_utf8src);
     const GumboVector* errors  = &m_output->errors;
@@ -697,7 +988,8 @@ QList<GumboWellFormedError> GumboInterface::fragment_error_check()
     myoptions.max_errors = -1;
 
     if (!m_source.isEmpty() && (m_output == NULL)) {
-        m_utf8src = m_source.toStdString();
+        load_utf8_source();
+        GumboArenaScope arena_scope(create_arena());
         m_output = gumbo_parse_fragment(&myoptions, m_utf8src.data(), m_utf8src.length(),
                                         GUMBO_TAG_BODY, GUMBO_NAMESPACE_HTML);
     }
@@ -818,6 +1110,70 @@ QStringList  GumboInterface::get_values_for_attr(GumboNode* node, const char* at
 }
 
 
+QStringList GumboInterface::get_all_link_targets()
+{
+    QStringList targets;
+    if (!m_source.isEmpty()) {
+        if (m_output == NULL) {
+            parse();
+        }
+        get_link_targets(m_output->root, targets);
+    }
+    return targets;
+}
+
+
+// Every url that perform_source_updates and perform_style_updates could
+// rewrite, as written in the source.  Errs on the side of returning too many.
+void GumboInterface::get_link_targets(GumboNode* node, QStringList &targets)
+{
+    if (node->type != GUMBO_NODE_ELEMENT) {
+        return;
+    }
+    std::string tagname = get_tag_name(node);
+    bool is_href_src_tag = in_set(href_src_tags, tagname);
+    GumboVector* attribs = &node->v.element.attributes;
+    for (unsigned int i = 0; i < attribs->length; ++i) {
+        GumboAttribute* at = static_cast<GumboAttribute*>(attribs->data[i]);
+        std::string name = at->name;
+        if (is_href_src_tag && ((name == aHREF) || (name == aSRC) || (name == aPOSTER) || (name == aDATA))) {
+            targets.append(QString::fromUtf8(at->value));
+        } else if (is_href_src_tag && (name == aSRCSET)) {
+            // each candidate is a url followed by an optional descriptor
+            foreach(QString candidate, QString::fromUtf8(at->value).split(',', Qt::SkipEmptyParts)) {
+                targets.append(candidate.trimmed().section(' ', 0, 0));
+            }
+        } else if (name == "style") {
+            get_style_url_targets(QString::fromUtf8(at->value), targets);
+        }
+    }
+    GumboVector* children = &node->v.element.children;
+    for (unsigned int i = 0; i < children->length; ++i) {
+        GumboNode* child = static_cast<GumboNode*>(children->data[i]);
+        if ((tagname == "style") && (child->type == GUMBO_NODE_TEXT)) {
+            get_style_url_targets(QString::fromUtf8(child->v.text.text), targets);
+        } else {
+            get_link_targets(child, targets);
+        }
+    }
+}
+
+
+void GumboInterface::get_style_url_targets(const QString &style, QStringList &targets)
+{
+    QRegularExpressionMatchIterator mi = STYLE_URL_REFERENCE.globalMatch(style);
+    while (mi.hasNext()) {
+        QRegularExpressionMatch mo = mi.next();
+        for (int i = 1; i <= STYLE_URL_REFERENCE.captureCount(); ++i) {
+            QString url = mo.captured(i).trimmed();
+            if (!url.isEmpty()) {
+                targets.append(url);
+            }
+        }
+    }
+}
+
+
 QHash<QString,QString> GumboInterface::get_attributes_of_node(GumboNode* node)
 {
     QHash<QString,QString> node_atts;
@@ -920,49 +1276,6 @@ void GumboInterface::rtrim(std::string &s)
 }
 
 
-void GumboInterface::ltrim(std::string &s)
-{
-    s.erase(0,s.find_first_not_of(" \n\r\t\v\f"));
-}
-
-
-void GumboInterface::ltrimnewlines(std::string &s)
-{
-    s.erase(0,s.find_first_not_of("\n\r"));
-}
-
-
-// delete everything up to and including the newline
-void GumboInterface::newlinetrim(std::string &s)
-{
-  size_t pos = s.find("\n");
-  if (pos != std::string::npos) {
-    s.erase(0, pos+1);
-  }
-}
-
-
-void GumboInterface::condense_whitespace(std::string &s)
-{
-    size_t n = s.length();
-    std::string val;
-    val.reserve(n);
-    std::string wspace = " \n\r\t\v\f";
-    char last_c = 'x';
-    for (size_t i=0; i < n; i++) {
-        char c = s.at(i);
-        if (wspace.find(c) != std::string::npos) {
-            c = ' ';
-        }
-        if ((c != ' ') || (last_c != ' ')) {
-            val.push_back(c);
-        }
-        last_c = c;
-    }
-    s = val;
-}
-
-
 void GumboInterface::replace_all(std::string &s, const char * s1, const char * s2)
 {
     std::string t1(s1);
@@ -1021,14 +1334,7 @@ std::string GumboInterface::update_style_urls(const std::string &source)
 {
     QString result = QString::fromStdString(source);
     // Now parse the text once looking urls and replacing them where needed
-    QRegularExpression reference(
-        "(?:(?:src|background|background-image|list-style|list-style-image|border-image|border-image-source|content)\\s*:|@import)\\s*"
-        "[^;\\}\\(\"']*"
-        "(?:"
-        "url\\([\"']?([^\\(\\)\"']*)[\"']?\\)"
-        "|"
-        "[\"']([^\\(\\)\"']*)[\"']"
-        ")");
+    const QRegularExpression &reference = STYLE_URL_REFERENCE;
     int start_index = 0;
     QRegularExpressionMatch mo = reference.match(result, start_index);
     do {
@@ -1046,7 +1352,7 @@ std::string GumboInterface::update_style_urls(const std::string &source)
             }
             // note destination may not have moved but we still need to update
             // the link
-            QString dest_newbkpath = m_sourceupdates.value(dest_oldbkpath, dest_oldbkpath);
+            QString dest_newbkpath = m_styleupdates.value(dest_oldbkpath, dest_oldbkpath);
             if (!dest_newbkpath.isEmpty() && !m_newbookpath.isEmpty()) {
                 QString new_href = Utility::buildRelativePath(m_newbookpath, dest_newbkpath);
                 if (new_href.isEmpty()) new_href = QFileInfo(dest_newbkpath).fileName();
@@ -1063,26 +1369,96 @@ std::string GumboInterface::update_style_urls(const std::string &source)
 
 
 
-std::string GumboInterface::substitute_xml_entities_into_text(const std::string &text)
+// The entity written out in place of each byte, NULL if the byte is
+// copied as is.  The single pass over the text replaces the rounds of
+// replace_all that had to be run with & first.
+struct EntityTable
 {
-    std::string result = text;
-    // replacing & must come first 
-    replace_all(result, "&", "&amp;");
-    replace_all(result, "<", "&lt;");
-    replace_all(result, ">", "&gt;");
-    return result;
+    const char * entity[256];
+
+    EntityTable(char quote)
+    {
+        for (int i = 0; i < 256; i++) entity[i] = NULL;
+        entity[(unsigned char) '&'] = "&amp;";
+        entity[(unsigned char) '<'] = "&lt;";
+        entity[(unsigned char) '>'] = "&gt;";
+        if (quote == '"') entity[(unsigned char) '"'] = "&quot;";
+        if (quote == '\'') entity[(unsigned char) '\''] = "&apos;";
+    }
+};
+
+static const EntityTable text_entities('\0');
+static const EntityTable dquote_entities('"');
+static const EntityTable squote_entities('\'');
+
+
+static void append_with_entities(std::string &out, const char * text, const EntityTable &table)
+{
+    const char * run = text;
+    const char * p = text;
+    for (; *p; ++p) {
+        const char * entity = table.entity[(unsigned char) *p];
+        if (entity) {
+            out.append(run, p - run);
+            out.append(entity);
+            run = p + 1;
+        }
+    }
+    out.append(run, p - run);
 }
 
 
-std::string GumboInterface::substitute_xml_entities_into_attributes(char quote, const std::string &text)
+static inline bool is_xml_space(char c)
 {
-    std::string result = substitute_xml_entities_into_text(text);
-    if (quote == '"') {
-        replace_all(result,"\"","&quot;");
-    } else if (quote == '\'') {
-        replace_all(result,"'","&apos;");
+    return (c == ' ') || (c == '\n') || (c == '\r') || (c == '\t') || (c == '\v') || (c == '\f');
+}
+
+
+// The routines below work on the part of the output buffer that
+// starts at pos, which is what a node has written so far
+
+static void rtrim_from(std::string &out, size_t pos)
+{
+    size_t n = out.length();
+    while ((n > pos) && is_xml_space(out[n-1])) n--;
+    out.resize(n);
+}
+
+
+static void ltrim_from(std::string &out, size_t pos, bool newlines_only = false)
+{
+    size_t n = pos;
+    while ((n < out.length()) && 
+           (newlines_only ? ((out[n] == '\n') || (out[n] == '\r')) : is_xml_space(out[n]))) n++;
+    if (n > pos) out.erase(pos, n - pos);
+}
+
+
+static bool is_blank_from(const std::string &out, size_t pos)
+{
+    for (size_t i = pos; i < out.length(); i++) {
+        if (!is_xml_space(out[i])) return false;
     }
-    return result;
+    return true;
+}
+
+
+// turn every run of whitespace into a single space
+static void condense_whitespace_from(std::string &out, size_t pos)
+{
+    size_t j = pos;
+    char last_c = 'x';
+    for (size_t i = pos; i < out.length(); i++) {
+        char c = out[i];
+        if (is_xml_space(c)) {
+            c = ' ';
+        }
+        if ((c != ' ') || (last_c != ' ')) {
+            out[j++] = c;
+        }
+        last_c = c;
+    }
+    out.resize(j);
 }
 
 
@@ -1171,67 +1547,110 @@ std::string GumboInterface::get_attribute_name(GumboAttribute * at)
 }
 
 
-std::string GumboInterface::build_attributes(GumboAttribute * at, bool no_entities, 
-                                             bool run_src_updates, bool run_style_updates)
+// room for the output of serializing the whole document in one go
+size_t GumboInterface::estimated_output_length()
+{
+    size_t n = m_utf8src.length();
+    return n + n / 8 + m_newbody.length() + m_newcsslinks.length() + m_newjslinks.length() + 256;
+}
+
+
+void GumboInterface::write_attribute(std::string &out, GumboAttribute * at, bool no_entities, 
+                                     bool run_src_updates, bool run_style_updates)
 {
-    std::string atts = " ";
-    std::string name = get_attribute_name(at);
-    std::string local_name = at->name;
-    atts.append(name);
-    std::string attvalue = at->value;
+    const char * local_name = at->name;
+    out.push_back(' ');
+    if ((at->attr_namespace != GUMBO_ATTR_NAMESPACE_NONE) && (strcmp(local_name, "xmlns") != 0)) {
+        out.append(attribute_nsprefixes[at->attr_namespace]);
+    }
+    out.append(local_name);
+
+    const char * attvalue = at->value;
+    std::string updated_value;
 
-    if (run_src_updates && (local_name == aHREF || local_name == aSRC || 
-                            local_name == aPOSTER || local_name == aDATA ||
-                            local_name == aSRCSET )) {
-        attvalue = update_attribute_value(attvalue);
+    if (run_src_updates && ((local_name == aHREF) || (local_name == aSRC) || 
+                            (local_name == aPOSTER) || (local_name == aDATA) ||
+                            (local_name == aSRCSET))) {
+        updated_value = update_attribute_value(attvalue);
+        attvalue = updated_value.c_str();
     }
 
-    if (run_style_updates && (local_name == "style")) {
-        attvalue = update_style_urls(attvalue);
+    if (run_style_updates && (strcmp(local_name, "style") == 0)) {
+        updated_value = update_style_urls(attvalue);
+        attvalue = updated_value.c_str();
     }
 
     // we handle empty attribute values like so: alt=""
     char quote = '"';
-    std::string qs="\"";
+    char qs = '"';
 
     // verify an original value existed since we create our own attributes
     // and if so determine the original quote character used if any
 
     if (at->original_value.data) {
-        if ( (!attvalue.empty())   || 
+        if ( (attvalue[0] != '\0')   || 
              (at->original_value.data[0] == '"') || 
              (at->original_value.data[0] == '\'') ) {
 
           quote = at->original_value.data[0];
-          if (quote == '\'') qs = std::string("'");
-          if (quote == '"') qs = std::string("\"");
+          if (quote == '\'') qs = '\'';
         }
     }
 
-    atts.append("=");
-    atts.append(qs);
+    out.push_back('=');
+    out.push_back(qs);
     if (no_entities) {
-        atts.append(attvalue);
+        out.append(attvalue);
+    } else if (quote == '"') {
+        append_with_entities(out, attvalue, dquote_entities);
+    } else if (quote == '\'') {
+        append_with_entities(out, attvalue, squote_entities);
     } else {
-        atts.append(substitute_xml_entities_into_attributes(quote, attvalue));
+        append_with_entities(out, attvalue, text_entities);
     }
-    atts.append(qs);
-    return atts;
+    out.push_back(qs);
 }
 
 
-// serialize children of a node
+std::string GumboInterface::serialize(GumboNode* node, enum UpdateTypes doupdates)
+{
+    std::string results;
+    results.reserve(estimated_output_length());
+    serialize_to(results, node, doupdates);
+    return results;
+}
+
+
+std::string GumboInterface::serialize_contents(GumboNode* node, enum UpdateTypes doupdates)
+{
+    std::string contents;
+    contents.reserve(estimated_output_length());
+    serialize_contents_to(contents, node, doupdates);
+    return contents;
+}
+
+
+std::string GumboInterface::prettyprint(GumboNode* node, int lvl, const std::string &indent_chars)
+{
+    std::string results;
+    results.reserve(estimated_output_length() * 2);
+    prettyprint_to(results, node, lvl, indent_chars);
+    return results;
+}
+
+
+// serialize children of a node onto the end of out
 // may be invoked recursively
 
-std::string GumboInterface::serialize_contents(GumboNode* node, enum UpdateTypes doupdates) {
-    std::string contents        = "";
+void GumboInterface::serialize_contents_to(std::string &out, GumboNode* node, enum UpdateTypes doupdates) {
+    size_t start                = out.length();
     std::string tagname         = get_tag_name(node);
     bool no_entity_substitution = in_set(no_entity_sub, tagname);
     bool keep_whitespace        = in_set(preserve_whitespace, tagname);
     bool is_inline              = in_set(nonbreaking_inline, tagname);
     bool is_structural          = in_set(structural_tags, tagname);
 
-    // build up result for each child, recursively if need be
+    // write out each child, recursively if need be
     GumboVector* children = &node->v.element.children;
 
     bool injected_newline = false;
@@ -1241,52 +1660,55 @@ std::string GumboInterface::serialize_contents(GumboNode* node, enum UpdateTypes
         GumboNode* child = static_cast<GumboNode*> (children->data[i]);
 
         if (child->type == GUMBO_NODE_TEXT) {
-            std::string text;
+            const char * text = child->v.text.text;
+            if (injected_newline && (text[0] == '\n')) text++;
             if (no_entity_substitution) {
-                text = std::string(child->v.text.text);
+                out.append(text);
             } else {
-                text = substitute_xml_entities_into_text(std::string(child->v.text.text));
+                append_with_entities(out, text, text_entities);
             }
-            if (injected_newline && !text.empty() && (text.at(0) == '\n')) text.erase(0,1);
             injected_newline = false;
-            contents.append(text);
 
         } else if (child->type == GUMBO_NODE_ELEMENT || child->type == GUMBO_NODE_TEMPLATE) {
-            std::string tagstring = serialize(child, doupdates);
-            // empty tagstring means this tag node is being removed
-            if (tagstring.empty()) {
+            // nothing written means this tag node is being removed
+            if (!serialize_to(out, child, doupdates)) {
                 // strip off trailing whitespace from predecessor tag
-                rtrim(contents);
-                contents.append("\n"); 
+                rtrim_from(out, start);
+                out.push_back('\n'); 
                 // strip out any associated newline in trailing whitespace node
                 injected_newline = true;
             } else {
-                contents.append(tagstring);
                 injected_newline = false;
                 std::string childname = get_tag_name(child);
                 if (in_head_without_title && (childname == "title")) in_head_without_title = false;
                 if (!is_inline && !keep_whitespace && !in_set(nonbreaking_inline,childname) && is_structural) {
-                    contents.append("\n");
+                    out.push_back('\n');
                     injected_newline = true;
                 }
             }
 
         } else if (child->type == GUMBO_NODE_WHITESPACE) {
             // try to keep all whitespace to keep as close to original as possible
-            std::string wspace = std::string(child->v.text.text);
+            const char * wspace = child->v.text.text;
             if (injected_newline) {
-                newlinetrim(wspace);
+                // delete everything up to and including the newline
+                const char * nl = strchr(wspace, '\n');
+                if (nl) wspace = nl + 1;
                 injected_newline = false;
             }
-            contents.append(wspace);
+            out.append(wspace);
             injected_newline = false;
 
         } else if (child->type == GUMBO_NODE_CDATA) {
-            contents.append("<![CDATA[" + std::string(child->v.text.text) + "]]>");
+            out.append("<![CDATA[");
+            out.append(child->v.text.text);
+            out.append("]]>");
             injected_newline = false;
 
         } else if (child->type == GUMBO_NODE_COMMENT) {
-            contents.append("<!--" + std::string(child->v.text.text) + "-->");
+            out.append("<!--");
+            out.append(child->v.text.text);
+            out.append("-->");
  
         } else {
             fprintf(stderr, "unknown element of type: %d\n", child->type); 
@@ -1294,152 +1716,142 @@ std::string GumboInterface::serialize_contents(GumboNode* node, enum UpdateTypes
         }
 
     }
-    if (in_head_without_title) contents.append("<title></title>");
-    return contents;
+    if (in_head_without_title) out.append("<title></title>");
 }
 
 
-// serialize a GumboNode back to html/xhtml
+// serialize a GumboNode back to html/xhtml onto the end of out
+// returns false without writing anything if the node is being removed
 // may be invoked recursively
 
-std::string GumboInterface::serialize(GumboNode* node, enum UpdateTypes doupdates) {
+bool GumboInterface::serialize_to(std::string &out, GumboNode* node, enum UpdateTypes doupdates) {
     // special case the document node
     if (node->type == GUMBO_NODE_DOCUMENT) {
-        std::string results = build_doctype(node);
-        results.append(serialize_contents(node, doupdates));
-        return results;
+        out.append(build_doctype(node));
+        serialize_contents_to(out, node, doupdates);
+        return true;
     }
 
-    std::string close = "";
-    std::string closeTag = "";
-    std::string atts = "";
     std::string tagname            = get_tag_name(node);
     bool need_special_handling     = in_set(special_handling, tagname);
     bool is_void_tag               = in_set(void_tags, tagname);
     bool no_entity_substitution    = in_set(no_entity_sub, tagname);
     bool is_href_src_tag           = in_set(href_src_tags, tagname);
     bool in_xml_ns                 = node->v.element.tag_namespace != GUMBO_NAMESPACE_HTML;
-    // bool is_inline                 = in_set(nonbreaking_inline, tagname);
+    bool in_head                   = (node->parent->type == GUMBO_NODE_ELEMENT) && 
+                                     (node->parent->v.element.tag == GUMBO_TAG_HEAD);
     bool is_jslink = false;
 
 
     // handle special case of stylesheet link missing type attribute
-    if ((tagname == "link") && (node->parent->type == GUMBO_NODE_ELEMENT) && 
-        (node->parent->v.element.tag == GUMBO_TAG_HEAD)) {
+    if ((tagname == "link") && in_head) {
         const GumboVector * attribs = &node->v.element.attributes;
         GumboAttribute* relatt = gumbo_get_attribute(attribs, "rel");
         GumboAttribute* typeatt = gumbo_get_attribute(attribs, "type");
         if (relatt && !typeatt) {
-            std::string rel = relatt->value;
-            if (rel == "stylesheet") {
+            if (strcmp(relatt->value, "stylesheet") == 0) {
                 gumbo_element_set_attribute(&node->v.element, "type", "text/css");
             }
         }
     }
     
-    // build attr string  
     GumboVector * attribs = &node->v.element.attributes;
-    for (unsigned int i=0; i< attribs->length; ++i) {
-        GumboAttribute* at = static_cast<GumboAttribute*>(attribs->data[i]);
-        atts.append(build_attributes(at, no_entity_substitution, ((doupdates & SourceUpdates) && is_href_src_tag), (doupdates & StyleUpdates)));
-    }
-
-    if (tagname == "script") {
-        if ((node->parent->type == GUMBO_NODE_ELEMENT) && 
-            (node->parent->v.element.tag == GUMBO_TAG_HEAD)) {
-            GumboAttribute* srcatt = gumbo_get_attribute(attribs, "src");
-            GumboAttribute* typeatt = gumbo_get_attribute(attribs, "type");
-            if (srcatt && typeatt) {
-                std::string script_src = srcatt->value;
-                std::string script_type = typeatt->value;
-                if (script_src.find(":") == std::string::npos) {
-                    if ((script_type == "application/javascript") || (script_type == "text/javascript")) {
-                        is_jslink = true;
-                    }
+
+    if ((tagname == "script") && in_head) {
+        GumboAttribute* srcatt = gumbo_get_attribute(attribs, "src");
+        GumboAttribute* typeatt = gumbo_get_attribute(attribs, "type");
+        if (srcatt && typeatt) {
+            if (strchr(srcatt->value, ':') == NULL) {
+                if ((strcmp(typeatt->value, "application/javascript") == 0) || 
+                    (strcmp(typeatt->value, "text/javascript") == 0)) {
+                    is_jslink = true;
                 }
             }
         }
     }
-    
+
+    if ((doupdates & LinkUpdates) && (tagname == "link") && in_head) {
+        return false;
+    }
+
+    if ((doupdates & JavascriptUpdates) && is_jslink) {
+        return false;
+    }
+
+    out.push_back('<');
+    out.append(tagname);
+
+    // write attributes
+    size_t atts_start = out.length();
+    for (unsigned int i=0; i< attribs->length; ++i) {
+        GumboAttribute* at = static_cast<GumboAttribute*>(attribs->data[i]);
+        write_attribute(out, at, no_entity_substitution, ((doupdates & SourceUpdates) && is_href_src_tag), (doupdates & StyleUpdates));
+    }
+
     // Make sure that the xmlns attribute exists as an html tag attribute
     if (tagname == "html") {
-        if (atts.find("xmlns=") == std::string::npos) {
-            atts.append(" xmlns=\"http://www.w3.org/1999/xhtml\"");
+        if (out.find("xmlns=", atts_start) == std::string::npos) {
+            out.append(" xmlns=\"http://www.w3.org/1999/xhtml\"");
         }
         if (m_version.startsWith('3')) {
-            if (atts.find("xmlns:epub") == std::string::npos) {
-                atts.append(" xmlns:epub=\"http://www.idpf.org/2007/ops\"");
+            if (out.find("xmlns:epub", atts_start) == std::string::npos) {
+                out.append(" xmlns:epub=\"http://www.idpf.org/2007/ops\"");
             }
         }
     }
 
-    // determine contents
-    std::string contents;
+    // the tag is closed once the contents are known
+    size_t tag_end = out.length();
+    out.push_back('>');
+    if (need_special_handling) out.push_back('\n');
 
+    // write contents
+    size_t contents_start = out.length();
     if ((tagname == "body") && (doupdates & BodyUpdates)) {
-        contents = m_newbody;
+        out.append(m_newbody);
     } else {
         // serialize your contents
-        contents = serialize_contents(node, doupdates);
+        serialize_contents_to(out, node, doupdates);
     }
 
     // determine closing tag type
-    std::string testcontents = contents;
-    ltrim(testcontents);
-    if (is_void_tag || (in_xml_ns && testcontents.empty())) {
-        close = "/";
-    } else {
-        closeTag = "</" + tagname + ">";
-    }
+    bool self_close = is_void_tag || (in_xml_ns && is_blank_from(out, contents_start));
 
-    if ((doupdates & StyleUpdates) && (tagname == "style") && 
-        (node->parent->type == GUMBO_NODE_ELEMENT) && 
-        (node->parent->v.element.tag == GUMBO_TAG_HEAD)) {
-        contents = update_style_urls(contents);
+    if ((doupdates & StyleUpdates) && (tagname == "style") && in_head) {
+        std::string updated = update_style_urls(out.substr(contents_start));
+        out.replace(contents_start, std::string::npos, updated);
     }
 
     if (need_special_handling) {
-        ltrimnewlines(contents);
-        rtrim(contents);
-        contents.append("\n");
+        ltrim_from(out, contents_start, true);
+        rtrim_from(out, contents_start);
+        out.push_back('\n');
     }
 
-    // build results
-    std::string results;
-
-    if ((doupdates & LinkUpdates) && (tagname == "link") && 
-        (node->parent->type == GUMBO_NODE_ELEMENT) && 
-        (node->parent->v.element.tag == GUMBO_TAG_HEAD)) {
-        return "";
-    }
-
-    if ((doupdates & JavascriptUpdates) && is_jslink) {
-        return "";
-    }
-
-    results.append("<"+tagname+atts+close+">");
-    
-    if (need_special_handling) results.append("\n");
-    results.append(contents);
-
     if ((doupdates & LinkUpdates) && (tagname == "head")) {
-        results.append(m_newcsslinks);
+        out.append(m_newcsslinks);
     }
 
     if ((doupdates & JavascriptUpdates) && (tagname == "head")) {
-        results.append(m_newjslinks);
+        out.append(m_newjslinks);
     }
 
-    results.append(closeTag);
-    if (need_special_handling) results.append("\n");
-    return results;
+    if (self_close) {
+        out.insert(tag_end, 1, '/');
+    } else {
+        out.append("</");
+        out.append(tagname);
+        out.push_back('>');
+    }
+    if (need_special_handling) out.push_back('\n');
+    return true;
 }
 
 
 
-std::string GumboInterface::prettyprint_contents(GumboNode* node, int lvl, const std::string indent_chars) 
+void GumboInterface::prettyprint_contents_to(std::string &out, GumboNode* node, int lvl, const std::string &indent_chars) 
 {
-    std::string contents        = "";
+    size_t start                = out.length();
     std::string tagname         = get_tag_name(node);
     bool no_entity_substitution = in_set(no_entity_sub, tagname);
     bool keep_whitespace        = in_set(preserve_whitespace, tagname);
@@ -1448,7 +1860,7 @@ std::string GumboInterface::prettyprint_contents(GumboNode* node, int lvl, const
     // bool is_other               = in_set(other_text_holders, tagname);
     char c                      = indent_chars.at(0);
     unsigned int n              = (unsigned int) indent_chars.length(); 
-    std::string indent_space    = std::string((lvl-1)*n,c);
+    size_t indent_len           = (lvl-1)*n;
     char last_char              = 'x';
     bool contains_block_tags    = false;
 
@@ -1462,102 +1874,103 @@ std::string GumboInterface::prettyprint_contents(GumboNode* node, int lvl, const
         GumboNode* child = static_cast<GumboNode*> (children->data[i]);
 
         if (child->type == GUMBO_NODE_TEXT) {
-            std::string val;
-
-            if (no_entity_substitution) {
-                val = std::string(child->v.text.text);
-            } else {
-                val = substitute_xml_entities_into_text(std::string(child->v.text.text));
-            }
+            const char * text = child->v.text.text;
 
             // if child of a structual element is text and follows a newline, indent it properly
             if (is_structural && last_char == '\n') {
-                contents.append(indent_space);
-                ltrim(val);
+                out.append(indent_len, c);
+                while (is_xml_space(*text)) text++;
+            }
+            size_t val_start = out.length();
+            if (no_entity_substitution) {
+                out.append(text);
+            } else {
+                append_with_entities(out, text, text_entities);
             }
             if (!keep_whitespace) {
                 // this includes structural, inline, and other text holders 
                 // okay to condense whitespace
-                condense_whitespace(val);
+                condense_whitespace_from(out, val_start);
             }
-            contents.append(val);
 
         } else if (child->type == GUMBO_NODE_ELEMENT || child->type == GUMBO_NODE_TEMPLATE) {
 
-            std::string val = prettyprint(child, lvl, indent_chars);
             std::string childname = get_tag_name(child);
+            bool child_is_inline = in_set(nonbreaking_inline, childname);
             if (in_head_without_title && (childname == "title")) in_head_without_title = false;
-            if (!in_set(nonbreaking_inline, childname)) {
+            if (!child_is_inline) {
                 contains_block_tags = true;
                 if (last_char != '\n') {
-                    contents.append("\n");
-                    if (tagname != "head" && tagname != "html") contents.append("\n");
+                    out.push_back('\n');
+                    if (tagname != "head" && tagname != "html") out.push_back('\n');
                     last_char='\n';
                 }
             }
             // if child of a structual element is inline and follows a newline, indent it properly
-            if (is_structural && in_set(nonbreaking_inline, childname) && (last_char == '\n')) {
-                contents.append(indent_space);
-                ltrim(val);
+            // (inline tags are written without any leading whitespace of their own)
+            if (is_structural && child_is_inline && (last_char == '\n')) {
+                out.append(indent_len, c);
             }    
-            contents.append(val);
+            prettyprint_to(out, child, lvl, indent_chars);
 
         } else if (child->type == GUMBO_NODE_WHITESPACE) {
 
             if (keep_whitespace) {
-                std::string wspace = std::string(child->v.text.text);
-                contents.append(wspace);
+                out.append(child->v.text.text);
             } else if (is_inline || in_set(other_text_holders, tagname)) {
-                if (std::string(" \t\v\f\r\n").find(last_char) == std::string::npos) {
-                    contents.append(std::string(" "));
+                if (!is_xml_space(last_char)) {
+                    out.push_back(' ');
                 }
             }
 
         } else if (child->type == GUMBO_NODE_CDATA) {
-            contents.append("<![CDATA[" + std::string(child->v.text.text) + "]]>");
+            out.append("<![CDATA[");
+            out.append(child->v.text.text);
+            out.append("]]>");
 
         } else if (child->type == GUMBO_NODE_COMMENT) {
-            contents.append("<!--" + std::string(child->v.text.text) + "-->");
+            out.append("<!--");
+            out.append(child->v.text.text);
+            out.append("-->");
  
         } else {
             fprintf(stderr, "unknown element of type: %d\n", child->type); 
         }
 
         // update last character of current contents
-        if (!contents.empty()) {
-            last_char = contents.at(contents.length()-1);
+        if (out.length() > start) {
+            last_char = out.at(out.length()-1);
         }
 
     }
 
     // inject epmpty title into head if one is missing
     if (in_head_without_title) {
-        if (last_char != '\n') contents.append("\n");
-        contents.append(indent_space + "<title></title>\n");
+        if (last_char != '\n') out.push_back('\n');
+        out.append(indent_len, c);
+        out.append("<title></title>\n");
         last_char = '\n';
     }
 
     // treat inline tags containing block tags like a block tag
     if (is_inline && contains_block_tags) {
-      if (last_char != '\n') contents.append("\n\n");
-      contents.append(indent_space);
+      if (last_char != '\n') out.append("\n\n");
+      out.append(indent_len, c);
     }
-
-    return contents;
 }
 
 
-// prettyprint a GumboNode back to html/xhtml
+// prettyprint a GumboNode back to html/xhtml onto the end of out
 // may be invoked recursively
 
-std::string GumboInterface::prettyprint(GumboNode* node, int lvl, const std::string indent_chars)
+void GumboInterface::prettyprint_to(std::string &out, GumboNode* node, int lvl, const std::string &indent_chars)
 {
 
     // special case the document node
     if (node->type == GUMBO_NODE_DOCUMENT) {
-      std::string results = build_doctype(node);
-      results.append(prettyprint_contents(node,lvl+1,indent_chars));
-      return results;
+      out.append(build_doctype(node));
+      prettyprint_contents_to(out, node, lvl+1, indent_chars);
+      return;
     }
 
     std::string tagname = get_tag_name(node);
@@ -1575,87 +1988,87 @@ std::string GumboInterface::prettyprint(GumboNode* node, int lvl, const std::str
         GumboAttribute* relatt = gumbo_get_attribute(attribs, "rel");
         GumboAttribute* typeatt = gumbo_get_attribute(attribs, "type");
         if (relatt && !typeatt) {
-            std::string rel = relatt->value;
-            if (rel == "stylesheet") {
+            if (strcmp(relatt->value, "stylesheet") == 0) {
                 gumbo_element_set_attribute(&node->v.element, "type", "text/css");
             }
         }
     }
-    
-    // build attr string
-    std::string atts = "";
+
     bool no_entity_substitution = in_set(no_entity_sub, tagname);
+    bool is_void_tag = in_set(void_tags, tagname);
+    bool keep_whitespace = in_set(preserve_whitespace, tagname);
+
+    char c = indent_chars.at(0);
+    unsigned int  n = (unsigned int) indent_chars.length(); 
+    size_t indent_len = (lvl-1)*n;
+
+    // inline tags are never indented
+    if (!is_inline) out.append(indent_len, c);
+
+    // write the start tag
+    out.push_back('<');
+    out.append(tagname);
     const GumboVector * attribs = &node->v.element.attributes;
     for (unsigned int i=0; i< attribs->length; ++i) {
         GumboAttribute* at = static_cast<GumboAttribute*>(attribs->data[i]);
-        atts.append(build_attributes(at, no_entity_substitution));
+        write_attribute(out, at, no_entity_substitution);
     }
+    size_t tag_end = out.length();
+    out.push_back('>');
+    // structural tags start their contents on a new line, dropped again if there are none
+    if (is_structural) out.push_back('\n');
 
-    bool is_void_tag = in_set(void_tags, tagname);
-
-    // get tag contents
-    std::string contents = "";
+    // write tag contents
+    size_t contents_start = out.length();
     if (!is_void_tag) {
         if (is_structural && tagname != "html") {
-            contents = prettyprint_contents(node, lvl+1, indent_chars);
+            prettyprint_contents_to(out, node, lvl+1, indent_chars);
         } else {
-            contents = prettyprint_contents(node, lvl, indent_chars);
+            prettyprint_contents_to(out, node, lvl, indent_chars);
         }
     }
 
-    bool keep_whitespace = in_set(preserve_whitespace, tagname);
     if (!keep_whitespace && !is_inline) {
-        rtrim(contents);
+        rtrim_from(out, contents_start);
     }
 
-    std::string testcontents = contents;
-    ltrim(testcontents);
-
-    bool single = is_void_tag || (in_xml_ns && testcontents.empty());
-
-    char c = indent_chars.at(0);
-    unsigned int  n = (unsigned int) indent_chars.length(); 
-    std::string indent_space = std::string((lvl-1)*n,c);
+    bool single = is_void_tag || (in_xml_ns && is_blank_from(out, contents_start));
 
     // handle self-closed tags with no contents first
     if (single) {
-        std::string selfclosetag = "<" + tagname + atts + "/>";
+        out.resize(tag_end);
+        out.append("/>");
         if (is_inline) {
             // always add newline after br tags when they are children of structural tags
             if ((tagname == "br") && in_set(structural_tags, parentname)) {
-              selfclosetag.append("\n");
-              if (!in_head && (tagname != "html")) selfclosetag.append("\n");
+              out.push_back('\n');
+              if (!in_head && (tagname != "html")) out.push_back('\n');
             }
-            return selfclosetag;
+            return;
         }
-        if (!in_head && (tagname != "html")) selfclosetag.append("\n");
-        return indent_space + selfclosetag + "\n";
+        if (!in_head && (tagname != "html")) out.push_back('\n');
+        out.push_back('\n');
+        return;
     } 
 
     // Handle the general case
-    std::string results;
-    std::string starttag = "<" + tagname +  atts + ">";
-    std::string closetag = "</" + tagname + ">";
-
     if (is_structural) {
-        results = indent_space + starttag;
-        if (!contents.empty()) {
-            results.append("\n" + contents + "\n" + indent_space);
-        }  
-        results.append(closetag + "\n");
-        if (!in_head && (tagname != "html")) results.append("\n");
-    } else if (is_inline) {
-        results = starttag;
-        results.append(contents);
-        results.append(closetag);
-    } else /** all others */ {
-        results = indent_space + starttag;
+        if (out.length() == contents_start) {
+            out.resize(tag_end + 1);
+        } else {
+            out.push_back('\n');
+            out.append(indent_len, c);
+        }
+    } else if (!is_inline) {
         if (!keep_whitespace) {
-            ltrim(contents);
+            ltrim_from(out, contents_start);
         }
-        results.append(contents);
-        results.append(closetag + "\n");
-        if (!in_head && (tagname != "html")) results.append("\n");
     }
-    return results;
+    out.append("</");
+    out.append(tagname);
+    out.push_back('>');
+    if (!is_inline) {
+        out.push_back('\n');
+        if (!in_head && (tagname != "html")) out.push_back('\n');
+    }
 }
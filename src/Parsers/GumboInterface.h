@@ -24,6 +24,7 @@
 #define GUMBO_INTERFACE
 
 #include <stdlib.h>
+#include <list>
 #include <string>
 #include <unordered_set>
 
@@ -31,6 +32,7 @@
 #include "gumbo_edit.h"
 
 #include "Query/CSelection.h"
+#include "Query/CSelectorIndex.h"
 
 #include <QString>
 #include <QList>
@@ -50,10 +52,22 @@ public:
 
     GumboInterface(const QString &source, const QString &version);
     GumboInterface(const QString &source, const QString &version, const QHash<QString, QString> &source_updates);
+    GumboInterface(const QString &source, const QString &version, const QHash<QString, QString> &source_updates,
+                   const QHash<QString, QString> &style_updates);
     ~GumboInterface();
 
     void    parse();
-    void    parse_fragment();
+
+    // parses the source as the contents of an element of type context
+    void    parse_fragment(GumboTag context = GUMBO_TAG_BODY, GumboNamespaceEnum context_namespace = GUMBO_NAMESPACE_HTML);
+
+    // parses contents in the context of node, an element of the parsed tree, and
+    // puts what it parses in place of the children of node so that an edit
+    // inside one element does not need the whole source parsed again.
+    // The positions of the new nodes are from the start of the source, those
+    // of nodes after node are still from before the edit.
+    // returns false if node is not an element
+    bool    replace_contents_of_node(GumboNode* node, const QString &contents);
     
     QString repair();
     
@@ -64,6 +78,15 @@ public:
     QList<GumboNode *> findnodes(const QString &aSelector);
     CSelection find(const QString &aSelector);
 
+    // returns for each selector in the index whether anything in the
+    // document matches it, looking only for those set in wanted
+    std::vector<bool> findany(const CSelectorIndex &index, const std::vector<bool> &wanted = std::vector<bool>());
+
+    // returns every element that a selector in the index matches with
+    // all of the selectors that match it, looking only for those set in wanted
+    std::vector<std::pair<GumboNode*, std::vector<size_t> > > findeach(const CSelectorIndex &index,
+                                                                     const std::vector<bool> &wanted = std::vector<bool>());
+
     QString prettyprint(QString indent_chars="  ");
 
     // returns list tags that match manifest properties
@@ -78,6 +101,11 @@ public:
     // returns body node or NULL if none exists
     GumboNode * get_body_node();
 
+    // serializes the head, followed by the attributes of the body, and each
+    // element child of the body on its own so that the Preview can tell which
+    // parts of a page changed, returns false if the body has text of its own
+    bool get_preview_parts(QString &head, QStringList &body_children);
+
     // routines for working with gumbo paths
     GumboNode* get_node_from_path(QList<unsigned int> & apath);
     QList<unsigned int> get_path_to_node(GumboNode* node);
@@ -91,6 +119,12 @@ public:
     QString perform_style_updates(const QString & my_current_book_relpath, const QString& newbookpath);
     QString perform_link_updates(const QString & newlinks);
     QString perform_javascript_updates(const QString & newjavascripts);
+
+    // queue link and javascript updates to be made by the next perform_source_updates 
+    // (or perform_queued_updates) so that they share its parse and serialization
+    void    queue_link_updates(const QString & newlinks);
+    void    queue_javascript_updates(const QString & newjavascripts);
+    QString perform_queued_updates();
     QString get_body_contents();
     QString perform_body_updates(const QString & new_body);
 
@@ -99,6 +133,9 @@ public:
     QStringList get_all_values_for_attribute(const QString & attname);
     QHash<QString,QString> get_attributes_of_node(GumboNode* node);
 
+    // every url in the source that source or style updates could change
+    QStringList get_all_link_targets();
+
     // routines for working with nodes with specific tags
     QList<GumboNode*> get_all_nodes_with_tag(GumboTag tag);
     QList<GumboNode*> get_all_nodes_with_tags(const QList<GumboTag> & tags);
@@ -136,39 +173,51 @@ private:
 
     QStringList get_values_for_attr(GumboNode* node, const char* attr_name);
 
+    void get_link_targets(GumboNode* node, QStringList &targets);
+
+    void get_style_url_targets(const QString &style, QStringList &targets);
+
     std::string serialize(GumboNode* node, enum UpdateTypes doupdates = NoUpdates);
 
     std::string serialize_contents(GumboNode* node, enum UpdateTypes doupdates = NoUpdates);
 
-    std::string prettyprint(GumboNode* node, int lvl, const std::string indent_chars);
+    std::string prettyprint(GumboNode* node, int lvl, const std::string &indent_chars);
+
+    // the serializers write into one output buffer, reserved up front,
+    // rather than returning a string for every node and attribute
+    bool serialize_to(std::string &out, GumboNode* node, enum UpdateTypes doupdates);
+
+    void serialize_contents_to(std::string &out, GumboNode* node, enum UpdateTypes doupdates);
+
+    void prettyprint_to(std::string &out, GumboNode* node, int lvl, const std::string &indent_chars);
 
-    std::string prettyprint_contents(GumboNode* node, int lvl, const std::string indent_chars);
+    void prettyprint_contents_to(std::string &out, GumboNode* node, int lvl, const std::string &indent_chars);
+
+    size_t estimated_output_length();
 
     std::string build_doctype(GumboNode *node);
 
     std::string get_attribute_name(GumboAttribute * at);
 
-    std::string build_attributes(GumboAttribute * at, bool no_entities, bool run_src_updates = false, bool run_style_updates = false);
+    void write_attribute(std::string &out, GumboAttribute * at, bool no_entities, bool run_src_updates = false, bool run_style_updates = false);
 
     std::string update_attribute_value(const std::string &href);
 
     std::string update_style_urls(const std::string& source);
 
-    std::string substitute_xml_entities_into_text(const std::string &text);
-
-    std::string substitute_xml_entities_into_attributes(char quote, const std::string &text);
-
     bool in_set(std::unordered_set<std::string> &s, std::string &key);
 
     void rtrim(std::string &s);
 
-    void ltrim(std::string &s);
+    void load_utf8_source();
+
+    size_t xml_header_end();
 
-    void ltrimnewlines(std::string &s);
+    QString to_qstring(const std::string &utf8out, bool add_header);
 
-    void newlinetrim(std::string &s);
+    GumboArena* create_arena();
 
-    void condense_whitespace(std::string &s);
+    void shift_source_positions(GumboNode* node, const GumboSourcePosition &base);
 
     void replace_all(std::string &s, const char * s1, const char * s2);
 
@@ -177,8 +226,15 @@ private:
 
     QString                         m_source;
     GumboOutput*                    m_output;
+    GumboArena*                     m_arena;
     std::string                     m_utf8src;
+    size_t                          m_srcoffset;
+    // the sources of contents spliced in by replace_contents_of_node,
+    // which the nodes parsed from them point into
+    std::list<std::string>          m_fragmentsrcs;
     const QHash<QString, QString> & m_sourceupdates;
+    const QHash<QString, QString> & m_styleupdates;
+    enum UpdateTypes                m_queuedupdates;
     std::string                     m_newcsslinks;
     std::string                     m_newjslinks;
     QString                         m_currentbkpath;
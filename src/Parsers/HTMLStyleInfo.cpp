@@ -61,7 +61,7 @@ HTMLStyleInfo::~HTMLStyleInfo()
 }
 
 
-QList<CSSInfo::CSSSelector *> HTMLStyleInfo::getAllSelectors()
+QList<CSSInfo::CSSSelector *> HTMLStyleInfo::getAllSelectors() const
 {
     QList<CSSInfo::CSSSelector *> selectors;
     foreach(CSSInfo * cp, m_styles) {
@@ -71,7 +71,7 @@ QList<CSSInfo::CSSSelector *> HTMLStyleInfo::getAllSelectors()
 }
 
 
-CSSInfo::CSSSelector *HTMLStyleInfo::getCSSSelectorForElementClass(const QString &elementName, const QString &className)
+CSSInfo::CSSSelector *HTMLStyleInfo::getCSSSelectorForElementClass(const QString &elementName, const QString &className) const
 {
     foreach(CSSInfo * cp, m_styles) {
         CSSInfo::CSSSelector * cs = cp->getCSSSelectorForElementClass(elementName, className);
@@ -81,7 +81,7 @@ CSSInfo::CSSSelector *HTMLStyleInfo::getCSSSelectorForElementClass(const QString
 }
 
 
-QList<CSSInfo::CSSSelector *> HTMLStyleInfo::getAllCSSSelectorsForElementClass(const QString &elementName, const QString &className)
+QList<CSSInfo::CSSSelector *> HTMLStyleInfo::getAllCSSSelectorsForElementClass(const QString &elementName, const QString &className) const
 {
     QList<CSSInfo::CSSSelector *> res;
     foreach(CSSInfo * cp, m_styles) {
@@ -91,7 +91,7 @@ QList<CSSInfo::CSSSelector *> HTMLStyleInfo::getAllCSSSelectorsForElementClass(c
 }
 
 
-QStringList HTMLStyleInfo::getAllPropertyValues(QString property)
+QStringList HTMLStyleInfo::getAllPropertyValues(QString property) const
 {
     QStringList res;
     foreach(CSSInfo * cp, m_styles) {
@@ -101,35 +101,61 @@ QStringList HTMLStyleInfo::getAllPropertyValues(QString property)
 }
 
 
-QString HTMLStyleInfo::getReformattedCSSText(bool multipleLineFormat)
+QString HTMLStyleInfo::getReformattedCSSText(bool multipleLineFormat) const
 {
     QStringList style_texts;
     foreach(CSSInfo * cp, m_styles) {
         QString text = cp->getReformattedCSSText(multipleLineFormat);
         style_texts << text;
     }
+    // IMPORTANT: After reformatting the styles users *must*
+    // Initialize a new HTMLStyleInfo object to work on the new text.
+    // This HTMLStyleInfo is now obsolete.
+    return replaceStyleTexts(style_texts);
+}
+
+
+QString HTMLStyleInfo::getSerializedCSSText(CSSInfo::CSSFormat format) const
+{
+    QStringList style_texts;
+    foreach(CSSInfo * cp, m_styles) {
+        style_texts << cp->getSerializedCSSText(format);
+    }
+    return replaceStyleTexts(style_texts);
+}
+
+
+bool HTMLStyleInfo::hasParseErrors() const
+{
+    foreach(CSSInfo * cp, m_styles) {
+        if (cp->hasParseErrors()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+QString HTMLStyleInfo::replaceStyleTexts(const QStringList &style_texts) const
+{
+    QString source = m_source;
     // now work *backwards* to substitute in each new piece of text
     // while keeping earlier start and length values correct. 
     for(int i = style_texts.length() - 1; i >= 0; i--) {
         QString ntext = style_texts.at(i);
         ntext = "\n" + ntext + "\n";
-        QString top = m_source.left(m_starts[i]);
-        QString bottom = m_source.mid(m_starts[i] + m_lengths[i]);
-        m_source = top + ntext + bottom;
+        QString top = source.left(m_starts[i]);
+        QString bottom = source.mid(m_starts[i] + m_lengths[i]);
+        source = top + ntext + bottom;
     }
-    
-
-    
-    // IMPORTANT: After reformatting the styles users *must*
-    // Initialize a new HTMLStyleInfo object to work on the new text.
-    // This HTMLStyleInfo is now obsolete.
-    return m_source;
+    return source;
 }
 
 
 // Use of this function will invalidate this object completely
-QString HTMLStyleInfo::removeMatchingSelectors(QList<CSSInfo::CSSSelector *> cssSelectors)
+QString HTMLStyleInfo::removeMatchingSelectors(QList<CSSInfo::CSSSelector *> cssSelectors) const
 {
+    QString source = m_source;
     QStringList style_texts;
     foreach(CSSInfo * cp, m_styles) {
         QString text = cp->removeMatchingSelectors(cssSelectors);
@@ -140,14 +166,14 @@ QString HTMLStyleInfo::removeMatchingSelectors(QList<CSSInfo::CSSSelector *> css
     for(int i = style_texts.length() - 1; i >= 0; i--) {
         QString ntext = style_texts.at(i);
         ntext = "\n" + ntext + "\n";
-        QString top = m_source.left(m_starts[i]);
-        QString bottom = m_source.mid(m_starts[i] + m_lengths[i]);
-        m_source = top + ntext + bottom;
+        QString top = source.left(m_starts[i]);
+        QString bottom = source.mid(m_starts[i] + m_lengths[i]);
+        source = top + ntext + bottom;
     }
     // IMPORTANT: After removing any selectors, users *must*
     // Initialize a new HTMLStyleInfo object to work on the new css text.
     // This HTMLStyleInfo is now obsolete.
-    return m_source;
+    return source;
 }
 
 
@@ -28,6 +28,12 @@
 #include "Parsers/CSSInfo.h"
 
 
+/**
+ * The styles of every inline style block of an HTML file.  Like
+ * CSSInfo it never changes once constructed so the copy an
+ * HTMLResource keeps for its current text can be shared across
+ * threads through the const routines.
+ */
 class HTMLStyleInfo : public QObject
 {
     Q_OBJECT
@@ -46,16 +52,16 @@ public:
     };
 
 
-    bool hasStyles() { return m_styles.size() > 0; };
+    bool hasStyles() const { return m_styles.size() > 0; };
 
-    QList<CSSInfo::CSSSelector *> getAllSelectors();
+    QList<CSSInfo::CSSSelector *> getAllSelectors() const;
 
     /**
      * Search for a matching class selector  given an element name and an optional
      * class name for the style.
      * Looks in order of: elementName.style, .style
      */
-    CSSInfo::CSSSelector *getCSSSelectorForElementClass(const QString &elementName, const QString &className);
+    CSSInfo::CSSSelector *getCSSSelectorForElementClass(const QString &elementName, const QString &className) const;
 
     /**
      * Search for *all* CSS selector that match an elementName, and classname
@@ -63,18 +69,26 @@ public:
      * relate to more than one style
      */
 
-    QList<CSSInfo::CSSSelector *> getAllCSSSelectorsForElementClass(const QString &elementName, const QString &className);
+    QList<CSSInfo::CSSSelector *> getAllCSSSelectorsForElementClass(const QString &elementName, const QString &className) const;
 
     /**
      * Return a list of all property values for the given property in the CSS.
      */
-    QStringList getAllPropertyValues(QString property);
+    QStringList getAllPropertyValues(QString property) const;
 
     /**
      * Return the original text with a reformatted appearance either to
      * a multiple line style (each property on its own line) or single line style.
      */
-    QString getReformattedCSSText(bool multipleLineFormat);
+    QString getReformattedCSSText(bool multipleLineFormat) const;
+
+    /**
+     * Return the html text with every style block serialized in the given
+     * format.  Nothing is reported, see CSSInfo::getSerializedCSSText.
+     */
+    QString getSerializedCSSText(CSSInfo::CSSFormat format) const;
+
+    bool hasParseErrors() const;
 
     /**
      * Search for a CSSSelector with the same definition of original group text and pos as this,
@@ -82,13 +96,14 @@ public:
      * If not found returns a null string.
      * Note the caller must intialise a new HTMLStyleInfo object to re-parse the updated text for another remove.
      */
-    QString removeMatchingSelectors(QList<CSSInfo::CSSSelector *> cssSelectors);
+    QString removeMatchingSelectors(QList<CSSInfo::CSSSelector *> cssSelectors) const;
 
     static QList<CSSProperty> getCSSProperties(const QString &text, const int &styleTextStartPos, const int &styleTextEndPos);
     static QString formatCSSProperties(QList<CSSProperty> new_properties, bool multipleLineFormat, const int &selectorIndent = 0);
 
 private:
     bool findInlineStyleBlock(const QString &text, int offset, int &styleStart, int &styleEnd);
+    QString replaceStyleTexts(const QStringList &style_texts) const;
     void generateSelectorsList();
 
     QList<CSSInfo *> m_styles;
@@ -0,0 +1,320 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+
+#include "Misc/Utility.h"
+#include "Parsers/OPFMetadata.h"
+
+static const QString _IN = "  ";
+static const QString _RS = QString(QChar(30)); // Ascii Record Separator
+static const QString _US = QString(QChar(31)); // Ascii Unit Separator
+
+static const QStringList RECOGNIZED_DC = QStringList() << "dc:identifier" << "dc:title" << "dc:creator"
+    << "dc:contributor" << "dc:source" << "dc:date" << "dc:language" << "dc:coverage" << "dc:description"
+    << "dc:format" << "dc:publisher" << "dc:relation" << "dc:rights" << "dc:subject" << "dc:type";
+
+// epub3 primary meta properties the editor shows as elements of their own
+static const QStringList RECOGNIZED_META = QStringList() << "belongs-to-collection" << "dcterms:issued"
+    << "dcterms:created" << "dcterms:modified" << "schema:accessibilitySummary" << "schema:accessMode"
+    << "schema:accessModeSufficient" << "schema:accessibilityFeature";
+
+// epub2 meta names that are never shown
+static const QStringList SKIPPED_EPUB2_META = QStringList() << "cover";
+
+// epub3 children that are attributes of the element, all others are refinements
+static const QStringList EPUB3_ATTRIBUTES = QStringList() << "id" << "xml:lang" << "dir" << "xmlns";
+
+// epub3 refinements that carry the scheme of their value
+static const QStringList SCHEMED_REFINEMENTS = QStringList() << "role" << "identifier-type"
+    << "title-type" << "collection-type";
+
+static const QHash<QString, QString> ID_ROOTS = {
+    { "dc:identifier",  "uid" },
+    { "dc:title",       "tle" },
+    { "dc:creator",     "cre" },
+    { "dc:contributor", "con" },
+    { "dc:source",      "src" },
+    { "dc:date",        "dat" },
+    { "dc:language",    "lng" },
+    { "dc:coverage",    "cov" },
+    { "dc:description", "des" },
+    { "dc:format",      "fmt" },
+    { "dc:publisher",   "pub" },
+    { "dc:relation",    "rln" },
+    { "dc:rights",      "rgt" },
+    { "dc:subject",     "sub" },
+    { "dc:type",        "typ" },
+};
+
+
+OPFMetadata::OPFMetadata()
+    :
+    m_Epub3(false)
+{
+}
+
+
+void OPFMetadata::ExtractRecognizedMetadata(const OPFParser &package, const QString &version)
+{
+    m_Epub3 = version.startsWith('3');
+    m_MetadataTag = package.m_metans;
+    m_Recognized.clear();
+    m_Other.clear();
+    m_IdToRecognized.clear();
+
+    m_IdList.clear();
+    QList<TagAtts> tags;
+    tags << package.m_package.m_atts << package.m_metans.m_atts << package.m_spineattr.m_atts;
+    foreach(const MetaEntry &me, package.m_metadata) {
+        tags << me.m_atts;
+    }
+    foreach(const SpineEntry &se, package.m_spine) {
+        tags << se.m_atts;
+    }
+    foreach(const TagAtts &atts, tags) {
+        QString id = atts.value("id");
+        if (!id.isEmpty()) {
+            m_IdList << id;
+        }
+    }
+    foreach(const ManifestEntry &me, package.m_manifest) {
+        m_IdList << me.m_id;
+    }
+
+    if (m_Epub3) {
+        ExtractEpub3(package);
+    } else {
+        ExtractEpub2(package);
+    }
+}
+
+
+void OPFMetadata::ExtractEpub2(const OPFParser &package)
+{
+    if (m_MetadataTag.m_atts.value("xmlns:dc").isEmpty()) {
+        m_MetadataTag.m_atts["xmlns:dc"] = "http://purl.org/dc/elements/1.1/";
+    }
+    foreach(MetaEntry me, package.m_metadata) {
+        // the unique identifier is left alone so that font
+        // obfuscation keyed on it keeps working
+        if ((me.m_name == "dc:identifier") && (me.m_atts.value("id") == package.m_package.m_uniqueid)) {
+            m_Other << me;
+        } else if (RECOGNIZED_DC.contains(me.m_name)) {
+            me.m_atts.remove("xmlns:dc");
+            if (me.m_name == "dc:language") {
+                me.m_content = FixLanguageCase(me.m_content);
+            }
+            AddRecognized(me);
+        } else if ((me.m_name == "meta") && me.m_atts.contains("name") &&
+                   !SKIPPED_EPUB2_META.contains(me.m_atts.value("name"))) {
+            MetaEntry named(me.m_atts.value("name"), me.m_atts.value("content"), me.m_atts);
+            named.m_atts.remove("name");
+            named.m_atts.remove("content");
+            AddRecognized(named);
+        } else {
+            m_Other << me;
+        }
+    }
+}
+
+
+void OPFMetadata::ExtractEpub3(const OPFParser &package)
+{
+    QList<MetaEntry> refines;
+    foreach(MetaEntry me, package.m_metadata) {
+        if ((me.m_name == "dc:identifier") && (me.m_atts.value("id") == package.m_package.m_uniqueid)) {
+            m_Other << me;
+        } else if (RECOGNIZED_DC.contains(me.m_name)) {
+            me.m_atts.remove("xmlns:dc");
+            if (me.m_name == "dc:language") {
+                me.m_content = FixLanguageCase(me.m_content);
+            }
+            AddRecognized(me);
+        } else if ((me.m_name == "meta") && me.m_atts.contains("refines")) {
+            refines << me;
+        } else if ((me.m_name == "meta") && me.m_atts.contains("property")) {
+            QString property = me.m_atts.value("property");
+            if (RECOGNIZED_META.contains(property)) {
+                me.m_name = property;
+                me.m_atts.remove("property");
+            }
+            AddRecognized(me);
+        } else {
+            m_Other << me;
+        }
+    }
+
+    // Refinements of recognized metadata become extra attributes of the
+    // element they refine, refinements of anything else are left alone
+    foreach(MetaEntry me, refines) {
+        QString target = me.m_atts.value("refines");
+        QString property = me.m_atts.value("property");
+        if (property.isEmpty() || !target.startsWith('#') || !m_IdToRecognized.contains(target.mid(1))) {
+            m_Other << me;
+            continue;
+        }
+        MetaEntry &refined = m_Recognized[m_IdToRecognized.value(target.mid(1))];
+        refined.m_atts[property] = me.m_content;
+        if (me.m_atts.contains("scheme")) {
+            refined.m_atts["scheme"] = me.m_atts.value("scheme");
+        }
+        if (property == "alternate-script") {
+            refined.m_atts["altlang"] = me.m_atts.value("xml:lang");
+        }
+        if (me.m_atts.contains("id")) {
+            m_IdList.removeOne(me.m_atts.value("id"));
+        }
+    }
+}
+
+
+void OPFMetadata::AddRecognized(const MetaEntry &entry)
+{
+    MetaEntry me(entry);
+    if (me.m_atts.contains("id")) {
+        QString id = me.m_atts.value("id");
+        m_IdToRecognized[id] = m_Recognized.count();
+        m_IdList.removeOne(id);
+    }
+    m_Recognized << me;
+}
+
+
+QString OPFMetadata::GetRecognizedMetadata() const
+{
+    QStringList data;
+    foreach(const MetaEntry &me, m_Recognized) {
+        data << me.m_name + _US + Utility::DecodeXML(me.m_content) + _RS;
+        QStringList keys = me.m_atts.keys();
+        keys.sort();
+        foreach(QString key, keys) {
+            data << _IN + key + _US + Utility::DecodeXML(me.m_atts.value(key)) + _RS;
+        }
+    }
+    return data.join("");
+}
+
+
+MetaNSEntry OPFMetadata::GetMetadataTag() const
+{
+    return m_MetadataTag;
+}
+
+
+QList<MetaEntry> OPFMetadata::BuildMetadata(const QString &data) const
+{
+    QList<MetaEntry> metadata;
+    QStringList idlist = m_IdList;
+    QStringList records = data.split(_RS, Qt::SkipEmptyParts);
+    int pos = 0;
+    while (pos < records.count()) {
+        // always starts with an element which may or may not have children
+        QStringList parts = records.at(pos).split(_US);
+        QString name = parts.at(0).trimmed();
+        QString content = parts.value(1).trimmed();
+        TagAtts atts;
+        TagAtts refines;
+        QString id;
+        if (m_Epub3) {
+            if (RECOGNIZED_META.contains(name)) {
+                atts["property"] = name;
+                name = "meta";
+            }
+        } else if (!RECOGNIZED_DC.contains(name)) {
+            atts["name"] = Utility::EncodeXML(name);
+            atts["content"] = Utility::EncodeXML(content);
+            name = "meta";
+            content = "";
+        }
+        pos++;
+
+        while ((pos < records.count()) && records.at(pos).startsWith(_IN)) {
+            parts = records.at(pos).split(_US);
+            QString aname = parts.at(0).trimmed();
+            QString avalue = Utility::EncodeXML(parts.value(1).trimmed());
+            if (aname == "id") {
+                id = ValidID(avalue, idlist);
+                idlist << id;
+                atts["id"] = id;
+            } else if (!m_Epub3 || EPUB3_ATTRIBUTES.contains(aname) || aname.startsWith("xmlns:") ||
+                       ((aname == "property") && (name == "meta"))) {
+                atts[aname] = avalue;
+            } else {
+                refines[aname] = avalue;
+            }
+            pos++;
+        }
+
+        // refinements need an id to point at
+        if (!refines.isEmpty() && id.isEmpty()) {
+            id = ValidID(ID_ROOTS.value(name, "num"), idlist);
+            idlist << id;
+            atts["id"] = id;
+        }
+        metadata << MetaEntry(name, Utility::EncodeXML(content), atts);
+
+        foreach(QString property, refines.keys()) {
+            if ((property == "scheme") || (property == "altlang")) {
+                continue;
+            }
+            TagAtts ratts;
+            ratts["refines"] = "#" + id;
+            ratts["property"] = property;
+            if ((property == "alternate-script") && refines.contains("altlang")) {
+                ratts["xml:lang"] = refines.value("altlang");
+            }
+            if (SCHEMED_REFINEMENTS.contains(property) && refines.contains("scheme")) {
+                ratts["scheme"] = refines.value("scheme");
+            }
+            metadata << MetaEntry("meta", refines.value(property), ratts);
+        }
+    }
+    metadata << m_Other;
+    return metadata;
+}
+
+
+QString OPFMetadata::FixLanguageCase(const QString &language)
+{
+    QStringList parts = language.split('-');
+    if (parts.count() == 1) {
+        return language.toLower();
+    }
+    if (parts.count() == 2) {
+        return parts.at(0).toLower() + "-" + parts.at(1).toUpper();
+    }
+    return language;
+}
+
+
+QString OPFMetadata::ValidID(const QString &id, const QStringList &idlist)
+{
+    QString nid = id;
+    int pos = 1;
+    while (idlist.contains(nid)) {
+        nid = id + QString("%1").arg(pos, 3, 10, QChar('0'));
+        pos++;
+    }
+    return nid;
+}
@@ -0,0 +1,103 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef OPFMETADATA_H
+#define OPFMETADATA_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+#include "Parsers/OPFParser.h"
+
+/**
+ * Splits the metadata of a parsed package into the metadata the
+ * Metadata Editor knows how to edit and everything else, and merges
+ * the edited metadata back into package metadata.
+ *
+ * The editable metadata is handed out as a text tree: one record per
+ * element holding its name and content, followed by one indented record
+ * per attribute or (for epub3) refinement of that element.  Records are
+ * ended by the ascii record separator and the name and value in each
+ * are split by the ascii unit separator.
+ *
+ * Everything the editor does not know about is kept exactly as parsed
+ * and is written back after the edited metadata.
+ */
+class OPFMetadata
+{
+public:
+
+    OPFMetadata();
+
+    /**
+     * Sorts the metadata of the package.
+     *
+     * @param package The parsed package, usually OPFResource::GetPackage()
+     * @param version The epub version, which decides how meta tags are read
+     */
+    void ExtractRecognizedMetadata(const OPFParser &package, const QString &version);
+
+    /**
+     * The editable metadata as a text tree.
+     */
+    QString GetRecognizedMetadata() const;
+
+    /**
+     * The metadata tag and its namespace attributes.
+     */
+    MetaNSEntry GetMetadataTag() const;
+
+    /**
+     * Converts the edited text tree back to metadata entries,
+     * the edited entries first and any other metadata after them.
+     *
+     * @param data The edited metadata in the form returned by GetRecognizedMetadata()
+     */
+    QList<MetaEntry> BuildMetadata(const QString &data) const;
+
+private:
+    void ExtractEpub2(const OPFParser &package);
+    void ExtractEpub3(const OPFParser &package);
+    void AddRecognized(const MetaEntry &entry);
+
+    static QString FixLanguageCase(const QString &language);
+
+    static QString ValidID(const QString &id, const QStringList &idlist);
+
+    bool m_Epub3;
+
+    MetaNSEntry m_MetadataTag;
+
+    // what the editor can change and what it must leave alone
+    QList<MetaEntry> m_Recognized;
+    QList<MetaEntry> m_Other;
+
+    // maps the id of a recognized element to its position in m_Recognized
+    QHash<QString, int> m_IdToRecognized;
+
+    // every id used in the package except those on recognized
+    // metadata, which are given out again when the metadata is rebuilt
+    QStringList m_IdList;
+};
+
+#endif // OPFMETADATA_H
@@ -37,8 +37,7 @@ QuickParser::QuickParser(const QString &source, QString default_lang)
       m_pos(0),
       m_next(0)
 {
-    m_LangPath << default_lang;
-    m_TagPath << "root";
+    resetPaths(default_lang);
 }
 
 
@@ -51,8 +50,7 @@ void QuickParser::reload_parser(const QString& source, QString default_language)
     m_source = source;
     m_pos = 0;
     m_next = 0;
-    m_LangPath = QStringList() << default_language;
-    m_TagPath = QStringList() << "root";
+    resetPaths(default_language);
 }
 
 
@@ -60,28 +58,115 @@ QuickParser::MarkupInfo QuickParser::parse_next()
 {
     MarkupInfo mi;
     mi.pos = -1;
+    MarkupSpan ms = parse_next_span();
+    if (ms.pos >= 0) {
+        QStringView markup = QStringView(m_source).sliced(ms.pos, ms.len);
+        if (ms.type == TextMarkup) {
+            mi.text = markup.toString();
+        } else {
+            parseTag(markup, mi);
+        }
+        mi.pos = ms.pos;
+        mi.lang = m_Langs.at(ms.lang);
+        mi.tpath = tag_path();
+    }
+    return mi;
+}
+
+
+QuickParser::MarkupSpan QuickParser::parse_next_span()
+{
+    MarkupSpan ms;
+    ms.pos = -1;
+    ms.len = 0;
+    ms.type = TextMarkup;
+    ms.name = 0;
+    ms.parent = 0;
+    ms.lang = 0;
     QStringView markup = parseML();
     if (!markup.isNull()) {
+        ms.pos = m_pos;
+        ms.len = markup.length();
         if ((markup.at(0) == '<') && (markup.at(markup.size() - 1) == '>')) {
-            parseTag(markup, mi);
-            if (mi.ttype == "begin") {
-                m_TagPath << mi.tname;
-                QString lang = mi.tattr.value("lang", QString());
-                if (lang.isEmpty()) lang = mi.tattr.value("xml:lang", QString());
-                if (lang.isEmpty()) lang = m_LangPath.last();
+            QStringView tname;
+            ms.type = scanTag(markup, tname);
+            ms.name = internName(tname);
+            if (ms.type == BeginMarkup) {
+                m_TagPath << ms.name;
+                int lang = m_LangPath.last();
+                // only a tag that mentions lang has its attributes parsed
+                if (markup.contains(QL1SV("lang"))) {
+                    QString value = attribute(ms, "lang");
+                    if (value.isEmpty()) value = attribute(ms, "xml:lang");
+                    if (!value.isEmpty()) lang = internLang(value);
+                }
                 m_LangPath << lang;
-            } else if (mi.ttype == "end") {
+            } else if ((ms.type == EndMarkup) && (m_TagPath.size() > 1)) {
                 m_TagPath.removeLast();
                 m_LangPath.removeLast();
             }
-        } else {
-            mi.text = markup.toString();
         }
-        mi.pos = m_pos;
-        mi.lang = m_LangPath.last();
-        mi.tpath = m_TagPath.join(".");
+        ms.parent = m_TagPath.last();
+        ms.lang = m_LangPath.last();
     }
-    return mi;
+    return ms;
+}
+
+
+QStringView QuickParser::markup(const MarkupSpan &ms) const
+{
+    if (ms.pos < 0) return QStringView();
+    return QStringView(m_source).sliced(ms.pos, ms.len);
+}
+
+
+const QString &QuickParser::name(int i) const
+{
+    return m_Names.at(i);
+}
+
+
+const QString &QuickParser::lang(int i) const
+{
+    return m_Langs.at(i);
+}
+
+
+QString QuickParser::attribute(const MarkupSpan &ms, const QString &aname) const
+{
+    if ((ms.type != BeginMarkup) && (ms.type != SingleMarkup)) return QString();
+    QStringView tagstring = markup(ms);
+    QStringView akey;
+    QStringView avalue;
+    int p = skipAnyBlanks(tagstring, 1);
+    p = stopWhenContains(tagstring, ">/ \f\t\r\n", p);
+    // a repeated attribute keeps its last value as in the TagAtts
+    QString result;
+    while ((p = nextAttribute(tagstring, p, akey, avalue)) >= 0) {
+        if (akey == aname) result = avalue.toString();
+    }
+    return result;
+}
+
+
+TagAtts QuickParser::attributes(const MarkupSpan &ms) const
+{
+    MarkupInfo mi;
+    if ((ms.type == BeginMarkup) || (ms.type == SingleMarkup)) {
+        parseTag(markup(ms), mi);
+    }
+    return mi.tattr;
+}
+
+
+QString QuickParser::tag_path() const
+{
+    QString path = "root";
+    for (int i = 1; i < m_TagPath.size(); i++) {
+        path.append('.');
+        path.append(m_Names.at(m_TagPath.at(i)));
+    }
+    return path;
 }
 
 
@@ -145,26 +230,26 @@ QStringView QuickParser::parseML()
     if (p >= m_source.length()) return QStringView();
     if (m_source.at(p) != '<') {
         // we have text leading up to a tag start
-        m_next = findTarget("<", p+1);
+        m_next = findTarget(u"<", p+1);
         return Utility::SubstringView(m_pos, m_next, m_source);
     }
     // we have a tag or special case
     // handle special cases first
-    QString tstart = Utility::Substring(p, p+9, m_source);
-    if (tstart.startsWith("<!--")) {
+    QStringView tstart = QStringView(m_source).sliced(p);
+    if (tstart.startsWith(QL1SV("<!--"))) {
         // include ending > as part of the string
-        m_next = findTarget("-->", p+4, true);
+        m_next = findTarget(u"-->", p+4, true);
         return Utility::SubstringView(m_pos, m_next, m_source);
     }
-    if (tstart.startsWith("<![CDATA[")) {
+    if (tstart.startsWith(QL1SV("<![CDATA["))) {
         // include ending > as part of the string
-        m_next = findTarget("]]>", p+9, true);
+        m_next = findTarget(u"]]>", p+9, true);
         return Utility::SubstringView(m_pos, m_next, m_source);
     }
     // include ending > as part of the string
-    m_next = findTarget(">", p+1, true);
+    m_next = findTarget(u">", p+1, true);
     
-    int ntb = findTarget("<", p+1);
+    int ntb = findTarget(u"<", p+1);
     if ((ntb != -1) && (ntb < m_next)) {
         m_next = ntb;
     }
@@ -172,7 +257,7 @@ QStringView QuickParser::parseML()
 }
 
 
-void QuickParser::parseTag(const QStringView tagstring, QuickParser::MarkupInfo& mi)
+void QuickParser::parseTag(const QStringView tagstring, QuickParser::MarkupInfo& mi) const
 {
     Q_ASSERT(tagstring.at(0) == '<');
     Q_ASSERT(tagstring.at(tagstring.size() - 1) == '>');
@@ -223,27 +308,12 @@ void QuickParser::parseTag(const QStringView tagstring, QuickParser::MarkupInfo&
 
     // handle the possibility of attributes (so begin or single tag type, not end)
     if (mi.ttype.isEmpty()) {
-        while (tagstring.indexOf(QChar('='), p) != -1) {
-            p = skipAnyBlanks(tagstring, p);
-            b = p;
-            p = stopWhenContains(tagstring, "=", p);
-            QString aname = Utility::Substring(b, p, tagstring).trimmed();
-            QString avalue;
-            p++;
-            p = skipAnyBlanks(tagstring, p);
-            if ((tagstring.at(p) == '\'') || (tagstring.at(p) == '"')) {
-                QString qc = tagstring.at(p);
-                p++;
-                b = p;
-                p = stopWhenContains(tagstring, qc, p);
-                avalue = Utility::Substring(b, p, tagstring);
-                p++;
-            } else {
-                b = p;
-                p = stopWhenContains(tagstring, ">/ ", p);
-                avalue = Utility::Substring(b, p, tagstring);
-            }
-            mi.tattr[aname] = avalue;
+        QStringView aname;
+        QStringView avalue;
+        int np;
+        while ((np = nextAttribute(tagstring, p, aname, avalue)) >= 0) {
+            mi.tattr[aname.toString()] = avalue.toString();
+            p = np;
         }
         mi.ttype = "begin";
         if (tagstring.indexOf(QChar('/'), p) >= 0) mi.ttype = "single";
@@ -252,7 +322,84 @@ void QuickParser::parseTag(const QStringView tagstring, QuickParser::MarkupInfo&
 }
 
 
-int QuickParser::findTarget(const QString &tgt, int p, bool after)
+// Works out only what parseTag would give as the tag name and type.
+// Anything else starting with <! is taken to be a comment.
+QuickParser::MarkupType QuickParser::scanTag(const QStringView tagstring, QStringView &tname) const
+{
+    QChar c = tagstring.at(1);
+    if (c == '?') {
+        if (tagstring.startsWith(QL1SV("<?xml"))) {
+            tname = u"?xml";
+            return XmlHeaderMarkup;
+        }
+        tname = u"?";
+        return PIMarkup;
+    }
+    if (c == '!') {
+        if (tagstring.startsWith(QL1SV("<!DOCTYPE")) || tagstring.startsWith(QL1SV("<!doctype"))) {
+            tname = u"!DOCTYPE";
+            return DoctypeMarkup;
+        }
+        if (tagstring.startsWith(QL1SV("<![CDATA[")) || tagstring.startsWith(QL1SV("<![cdata["))) {
+            tname = u"![CDATA[";
+            return CDataMarkup;
+        }
+        tname = tagstring.startsWith(QL1SV("<!--")) ? QStringView(u"!--") : QStringView();
+        return CommentMarkup;
+    }
+
+    MarkupType type = BeginMarkup;
+    int p = skipAnyBlanks(tagstring, 1);
+    if (tagstring.at(p) == '/') {
+        type = EndMarkup;
+        p++;
+        p = skipAnyBlanks(tagstring, p);
+    }
+    int b = p;
+    p = stopWhenContains(tagstring, ">/ \f\t\r\n", p);
+    tname = tagstring.sliced(b, p - b);
+    if (type == EndMarkup) return type;
+
+    // the attributes have to be stepped over to find a closing /
+    QStringView aname;
+    QStringView avalue;
+    int np;
+    while ((np = nextAttribute(tagstring, p, aname, avalue)) >= 0) {
+        p = np;
+    }
+    if (tagstring.indexOf(QChar('/'), p) >= 0) type = SingleMarkup;
+    return type;
+}
+
+
+// Finds the attribute that starts at or after p, returns the position
+// just past it or -1 if there are no more attributes.
+int QuickParser::nextAttribute(const QStringView tagstring, int p, QStringView &aname, QStringView &avalue)
+{
+    if (tagstring.indexOf(QChar('='), p) == -1) return -1;
+    p = skipAnyBlanks(tagstring, p);
+    int b = p;
+    p = stopWhenContains(tagstring, "=", p);
+    aname = tagstring.sliced(b, p - b).trimmed();
+    p++;
+    p = skipAnyBlanks(tagstring, p);
+    if ((tagstring.at(p) == '\'') || (tagstring.at(p) == '"')) {
+        QChar qc = tagstring.at(p);
+        p++;
+        b = p;
+        while ((p < tagstring.length()) && (tagstring.at(p) != qc)) p++;
+        avalue = tagstring.sliced(b, p - b);
+        p++;
+    } else {
+        b = p;
+        p = stopWhenContains(tagstring, ">/ ", p);
+        avalue = tagstring.sliced(b, p - b);
+    }
+    return p;
+}
+
+
+int QuickParser::findTarget(const QStringView tgt, int p, bool after)
 {
     int nxt = m_source.indexOf(tgt, p);
     if (nxt == -1) return m_source.length();
@@ -274,3 +421,40 @@ int QuickParser::stopWhenContains(const QStringView tgt, const QString& stopchar
     while((p < tgt.length()) && !stopchars.contains(tgt.at(p))) p++;
     return p;
 }
+
+
+void QuickParser::resetPaths(const QString &default_lang)
+{
+    m_Names.clear();
+    m_NameIds.clear();
+    m_Langs.clear();
+    m_LangIds.clear();
+    internName(u"");
+    m_TagPath = QList<int>() << internName(u"root");
+    m_LangPath = QList<int>() << internLang(default_lang);
+}
+
+
+int QuickParser::internName(const QStringView name)
+{
+    int id = m_NameIds.value(name, -1);
+    if (id == -1) {
+        id = m_Names.size();
+        m_Names << name.toString();
+        // the view must point into the stored copy, not the source
+        m_NameIds.insert(QStringView(m_Names.last()), id);
+    }
+    return id;
+}
+
+
+int QuickParser::internLang(const QStringView lang)
+{
+    int id = m_LangIds.value(lang, -1);
+    if (id == -1) {
+        id = m_Langs.size();
+        m_Langs << lang.toString();
+        m_LangIds.insert(QStringView(m_Langs.last()), id);
+    }
+    return id;
+}
@@ -24,6 +24,8 @@
 
 #include <QStringList>
 #include <QStringView>
+#include <QList>
+#include <QHash>
 
 #include "Parsers/TagAtts.h"
 
@@ -44,24 +46,74 @@ public:
         TagAtts tattr;
     };
 
+    enum MarkupType : quint8 {
+        TextMarkup = 0,
+        XmlHeaderMarkup,
+        PIMarkup,
+        CommentMarkup,
+        DoctypeMarkup,
+        CDataMarkup,
+        BeginMarkup,
+        SingleMarkup,
+        EndMarkup
+    };
+
+    // A piece of markup given as its place in the source.  Tag names
+    // and languages are each stored once by the parser and referred to
+    // by index, attributes are only parsed when asked for.
+    struct MarkupSpan {
+        int        pos;     // position in source, -1 once the source is used up
+        int        len;     // length in source
+        MarkupType type;
+        int        name;    // tag name, 0 (the empty name) for text
+        int        parent;  // name of the innermost open begin tag
+        int        lang;    // language in effect
+    };
+
     QuickParser(const QString &source, const QString default_lang = "en");
     ~QuickParser() {};
     void reload_parser(const QString &source, const QString default_lang = "en");
     MarkupInfo parse_next();
     QString serialize_markup(const MarkupInfo &mi);
+
+    // the span based parse, parse_next and parse_next_span share
+    // their place in the source and the open tags
+    MarkupSpan parse_next_span();
+    QStringView markup(const MarkupSpan &ms) const;
+    const QString &name(int i) const;
+    const QString &lang(int i) const;
+    // the value of one attribute of a begin or single tag
+    QString attribute(const MarkupSpan &ms, const QString &aname) const;
+    TagAtts attributes(const MarkupSpan &ms) const;
+    // the open tags ("." joined from "root"), built when asked for
+    QString tag_path() const;
     
 private:
     QStringView parseML();
-    void parseTag(const QStringView tagstring, MarkupInfo &mi);
-    int findTarget(const QString &tgt, int p, bool after=false);
-    int skipAnyBlanks(const QStringView segment, int p);
-    int stopWhenContains(const QStringView segment, const QString& stopchars, int p);
+    void parseTag(const QStringView tagstring, MarkupInfo &mi) const;
+    MarkupType scanTag(const QStringView tagstring, QStringView &tname) const;
+    static int nextAttribute(const QStringView tagstring, int p, QStringView &aname, QStringView &avalue);
+    int findTarget(const QStringView tgt, int p, bool after=false);
+    static int skipAnyBlanks(const QStringView segment, int p);
+    static int stopWhenContains(const QStringView segment, const QString& stopchars, int p);
+    int internName(const QStringView name);
+    int internLang(const QStringView lang);
+    void resetPaths(const QString &default_lang);
     
     QString      m_source;
     int          m_pos;
     int          m_next;
-    QStringList  m_TagPath;
-    QStringList  m_LangPath;
+
+    // names of the open begin tags and the languages they set,
+    // the first entry of each is for the root
+    QList<int>   m_TagPath;
+    QList<int>   m_LangPath;
+
+    // every tag name and language seen, each stored once
+    QStringList  m_Names;
+    QHash<QStringView, int> m_NameIds;
+    QStringList  m_Langs;
+    QHash<QStringView, int> m_LangIds;
 };
 
 #endif
@@ -0,0 +1,167 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <algorithm>
+
+#include <QRegularExpression>
+
+#include "Parsers/GumboInterface.h"
+#include "Parsers/StyleCascade.h"
+
+// The pseudo classes and pseudo elements the Query parser accepts
+// but treats as always matching
+static const QRegularExpression UNTESTABLE_PSEUDO("::|:(active|checked|disabled|enabled|focus|hover|in-range|invalid|"
+                                                  "link|optional|out-of-range|read-only|read-write|required|target|"
+                                                  "valid|visited|after|before|first-letter|first-line|selection)\\b",
+                                                  QRegularExpression::CaseInsensitiveOption);
+
+StyleCascade::StyleCascade()
+{
+}
+
+
+void StyleCascade::AddSelectors(const QString &bookpath, const QList<CSSInfo::CSSSelector *> &selectors)
+{
+    int sheet = m_Sheets.count();
+    m_Sheets.insert(bookpath, sheet);
+    int first = m_Rules.count();
+    foreach(CSSInfo::CSSSelector *selector, selectors) {
+        size_t i = m_Index.add(selector->text.toStdString());
+        Rule rule;
+        rule.bookpath = bookpath;
+        rule.sheet = sheet;
+        rule.pos = selector->pos;
+        rule.text = selector->text;
+        rule.specificity = m_Index.specificity(i);
+        rule.conditional = selector->inAtRule || selector->text.contains(UNTESTABLE_PSEUDO);
+        rule.properties = selector->properties;
+        rule.importantProperties = selector->importantProperties;
+        m_Rules.append(rule);
+    }
+    m_SheetRules.insert(bookpath, std::make_pair(first, m_Rules.count()));
+}
+
+
+QList<int> StyleCascade::MatchedRules(GumboNode *node, const QStringList &stylesheets) const
+{
+    QHash<int, int> sheet_order;
+    std::vector<bool> wanted = WantedRules(stylesheets, sheet_order);
+    QList<int> rules;
+    if (sheet_order.isEmpty()) {
+        return rules;
+    }
+    std::vector<size_t> matched = m_Index.matchElement(node, wanted);
+    for (size_t i = 0; i < matched.size(); i++) {
+        rules.append(int(matched[i]));
+    }
+    SortCascade(rules, sheet_order);
+    return rules;
+}
+
+
+StyleCascade::Usage StyleCascade::GetUsage(GumboInterface &gi, const QStringList &stylesheets) const
+{
+    Usage usage;
+    usage.matched.fill(false, m_Rules.count());
+    usage.effective.fill(false, m_Rules.count());
+    QHash<int, int> sheet_order;
+    std::vector<bool> wanted = WantedRules(stylesheets, sheet_order);
+    if (sheet_order.isEmpty()) {
+        return usage;
+    }
+    std::vector<std::pair<GumboNode *, std::vector<size_t>>> elements = gi.findeach(m_Index, wanted);
+    for (size_t e = 0; e < elements.size(); e++) {
+        const std::vector<size_t> &matched = elements[e].second;
+        QList<int> rules;
+        for (size_t i = 0; i < matched.size(); i++) {
+            rules.append(int(matched[i]));
+            usage.matched[int(matched[i])] = true;
+        }
+        SortCascade(rules, sheet_order);
+        MarkEffective(rules, usage.effective);
+    }
+    return usage;
+}
+
+
+std::vector<bool> StyleCascade::WantedRules(const QStringList &stylesheets, QHash<int, int> &sheet_order) const
+{
+    std::vector<bool> wanted(m_Rules.count(), false);
+    foreach(QString bookpath, stylesheets) {
+        if (!m_SheetRules.contains(bookpath) || sheet_order.contains(m_Sheets.value(bookpath))) {
+            continue;
+        }
+        sheet_order.insert(m_Sheets.value(bookpath), sheet_order.count());
+        std::pair<int, int> range = m_SheetRules.value(bookpath);
+        for (int i = range.first; i < range.second; i++) {
+            wanted[i] = true;
+        }
+    }
+    return wanted;
+}
+
+
+// Lowest specificity first, then by the order the html file links the
+// style sheets and last by the order of the rules in a style sheet
+void StyleCascade::SortCascade(QList<int> &rules, const QHash<int, int> &sheet_order) const
+{
+    std::stable_sort(rules.begin(), rules.end(), [this, &sheet_order](int a, int b) {
+        const Rule &ra = m_Rules.at(a);
+        const Rule &rb = m_Rules.at(b);
+        if (ra.specificity != rb.specificity) {
+            return ra.specificity < rb.specificity;
+        }
+        int oa = sheet_order.value(ra.sheet);
+        int ob = sheet_order.value(rb.sheet);
+        if (oa != ob) {
+            return oa < ob;
+        }
+        return a < b;
+    });
+}
+
+
+// Marks as effective every rule of one element that sets the value
+// of one of its properties, rules are given in cascade order
+void StyleCascade::MarkEffective(const QList<int> &rules, QVector<bool> &effective) const
+{
+    QHash<QString, int> normal_winner;
+    QHash<QString, int> important_winner;
+    foreach(int i, rules) {
+        const Rule &rule = m_Rules.at(i);
+        // nothing to override, or only applies some of the time
+        if (rule.conditional || rule.properties.isEmpty()) {
+            effective[i] = true;
+            continue;
+        }
+        foreach(QString property, rule.properties) {
+            normal_winner.insert(property, i);
+        }
+        foreach(QString property, rule.importantProperties) {
+            important_winner.insert(property, i);
+        }
+    }
+    QHashIterator<QString, int> it(normal_winner);
+    while (it.hasNext()) {
+        it.next();
+        effective[important_winner.value(it.key(), it.value())] = true;
+    }
+}
@@ -0,0 +1,128 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef STYLECASCADE_H
+#define STYLECASCADE_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "Parsers/CSSInfo.h"
+#include "Query/CSelectorIndex.h"
+
+class GumboInterface;
+
+/**
+ * The rules of a set of style sheets ordered the way the cascade
+ * applies them to an element.
+ *
+ * Every selector is added to a single CSelectorIndex once, so one
+ * cascade can be shared by threads that each work on their own html
+ * file as long as they only use the const routines.  Each html file
+ * names the style sheets that apply to it, in the order it links them.
+ *
+ * Media queries are not evaluated and pseudo classes such as :hover
+ * and pseudo elements can not be tested against the document, so the
+ * rules using them are marked conditional.  A conditional rule is never
+ * taken to override another one.
+ */
+class StyleCascade
+{
+
+public:
+
+    struct Rule {
+        QString bookpath;                 /* The style sheet, or html file of an inline style     */
+        int sheet;                        /* The order its style sheet was added in               */
+        int pos;                          /* The position of the selector in that file            */
+        QString text;                     /* The text of the selector                             */
+        unsigned int specificity;         /* See CSelector::specificity                           */
+        bool conditional;                 /* In an at-rule or using an untestable pseudo selector */
+        QStringList properties;
+        QStringList importantProperties;
+    };
+
+    /**
+     * Whether each rule matched an element and whether it set the value
+     * of at least one property of an element it matched.  A rule matched
+     * somewhere that never did is overridden wherever it applies.
+     */
+    struct Usage {
+        QVector<bool> matched;
+        QVector<bool> effective;
+    };
+
+    StyleCascade();
+
+    /**
+     * Adds the selectors of one style sheet, or of the inline styles of
+     * an html file, after any already added.  Each book path is only
+     * added once.
+     */
+    void AddSelectors(const QString &bookpath, const QList<CSSInfo::CSSSelector *> &selectors);
+
+    int count() const { return m_Rules.count(); };
+
+    const Rule &GetRule(int i) const { return m_Rules.at(i); };
+
+    /**
+     * Returns the rules of the style sheets that match the element node,
+     * in cascade order.  For a property the last rule in the list to set it
+     * wins, unless one of them sets it !important.  Style sheets are
+     * given as book paths in the order the html file links them.
+     */
+    QList<int> MatchedRules(GumboNode *node, const QStringList &stylesheets) const;
+
+    /**
+     * Matches the rules of the style sheets against every element of
+     * the document in a single walk.
+     */
+    Usage GetUsage(GumboInterface &gi, const QStringList &stylesheets) const;
+
+private:
+
+    std::vector<bool> WantedRules(const QStringList &stylesheets, QHash<int, int> &sheet_order) const;
+
+    void SortCascade(QList<int> &rules, const QHash<int, int> &sheet_order) const;
+
+    void MarkEffective(const QList<int> &rules, QVector<bool> &effective) const;
+
+    // Not copyable since the index is not
+    StyleCascade(const StyleCascade &);
+    StyleCascade &operator=(const StyleCascade &);
+
+    CSelectorIndex m_Index;
+
+    QList<Rule> m_Rules;
+
+    /**
+     * The position in m_Rules of the first rule of each style sheet
+     * and one past its last, with the order the sheets were added in.
+     */
+    QHash<QString, std::pair<int, int>> m_SheetRules;
+
+    QHash<QString, int> m_Sheets;
+};
+
+#endif // STYLECASCADE_H
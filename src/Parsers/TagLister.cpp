@@ -33,6 +33,9 @@
 
 // public interface
 
+// These need to match the TagType sequence
+static const QString TAG_TYPES[] = { "", "xmlheader", "pi", "comment", "doctype", "cdata", "begin", "single", "end" };
+
 // Default Constructor
 TagLister::TagLister()
     : m_source(""),
@@ -43,9 +46,7 @@ TagLister::TagLister()
       m_bodyOpenTag(-1),
       m_bodyCloseTag(-1)
 {
-    m_TagPath << "root";
-    m_TagPos << -1;
-    m_TagLen << 0;
+    resetNames();
 }
 
 // Normal Constructor
@@ -54,9 +55,7 @@ TagLister::TagLister(const QString &source)
       m_pos(0),
       m_next(0)
 {
-    m_TagPath << "root";
-    m_TagPos << -1;
-    m_TagLen << 0;
+    resetNames();
     buildTagList();
 }
 
@@ -66,26 +65,187 @@ void TagLister::reloadLister(const QString& source)
     m_source = source;
     m_pos = 0;
     m_next = 0;
-    m_TagPath = QStringList() << "root";
-    m_TagPos = QList<int>() << -1;
-    m_TagLen = QList<int>() << 0;
+    m_OpenTags.clear();
+    resetNames();
     buildTagList();
 }
 
-const TagLister::TagInfo& TagLister::at(int i)
+
+bool TagLister::updateLister(int position, int chars_removed, const QString &added_text)
+{
+    if (m_Tags.isEmpty() || (position < 0) || (chars_removed < 0) ||
+        (position + chars_removed > m_source.length())) {
+        return false;
+    }
+    // format only changes report the text as removed and added again
+    if (QStringView(m_source).mid(position, chars_removed) == added_text) {
+        return true;
+    }
+    int old_end = position + chars_removed;
+    int new_end = position + added_text.length();
+    int delta = added_text.length() - chars_removed;
+    m_source.replace(position, chars_removed, added_text);
+
+    // m_Tags always ends with a dummy entry
+    int ntags = m_Tags.size() - 1;
+
+    // tags that end before the edit can not be changed by it, so
+    // find the last of them (tags never overlap) and list again
+    // from its end.  A tag ending right at the edit could be an
+    // unterminated one that ran to the end of the source.
+    int lo = 0;
+    int hi = ntags;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (m_Tags.at(mid).pos + m_Tags.at(mid).len < position) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    int last_kept = lo - 1;
+    int first = last_kept + 1;
+    restoreTagStack(last_kept);
+    m_next = (last_kept >= 0) ? m_Tags.at(last_kept).pos + m_Tags.at(last_kept).len : 0;
+
+    // Once a new tag past the edit starts where an old tag started
+    // and the open tags are the same, every tag after it is as
+    // before just shifted by delta.  The old open tags are tracked
+    // old tag by old tag to know when that happens.
+    QList<OpenTag> old_open = m_OpenTags;
+    int j = first;
+    int resync = ntags;
+    QList<Tag> relisted;
+    Tag tag;
+    while (getNext(tag, first + relisted.size())) {
+        relisted << tag;
+        if (tag.pos >= new_end) {
+            int old_tpos = tag.pos - delta;
+            while ((j < ntags) && (m_Tags.at(j).pos < old_tpos)) {
+                trackTag(j, old_open);
+                j++;
+            }
+            if ((j < ntags) && (m_Tags.at(j).pos == old_tpos)) {
+                trackTag(j, old_open);
+                j++;
+                bool same = (old_open.size() == m_OpenTags.size());
+                for (int k = 0; same && (k < old_open.size()); k++) {
+                    const OpenTag &ot = old_open.at(k);
+                    const OpenTag &nt = m_OpenTags.at(k);
+                    int p = (ot.pos >= old_end) ? ot.pos + delta : ot.pos;
+                    same = (ot.name == nt.name) && (ot.len == nt.len) && (p == nt.pos);
+                }
+                if (same) {
+                    resync = j;
+                    break;
+                }
+            }
+        }
+    }
+
+    // The tags kept after the edit refer to the tags open at resync
+    // by index, so map the old index of each of those to its new one
+    QHash<int, int> reopened;
+    if (resync < ntags) {
+        for (int k = 0; k < old_open.size(); k++) {
+            if (old_open.at(k).index >= first) {
+                reopened.insert(old_open.at(k).index, m_OpenTags.at(k).index);
+            }
+        }
+    }
+
+    // splice the new tags in place of the old ones they replace
+    int nold = resync - first;
+    int nnew = relisted.size();
+    int shift = nnew - nold;
+    if (shift > 0) {
+        m_Tags.insert(first + nold, shift, Tag());
+    } else if (shift < 0) {
+        m_Tags.remove(first + nnew, -shift);
+    }
+    for (int k = 0; k < nnew; k++) {
+        m_Tags[first + k] = relisted.at(k);
+    }
+    int last = m_Tags.size() - 1;
+    for (int k = first + nnew; k < last; k++) {
+        Tag &kept = m_Tags[k];
+        kept.pos += delta;
+        if (kept.parent >= resync) {
+            kept.parent += shift;
+        } else if (kept.parent >= first) {
+            kept.parent = reopened.value(kept.parent, -1);
+        }
+        if (kept.open >= resync) {
+            kept.open += shift;
+        } else if (kept.open >= first) {
+            kept.open = reopened.value(kept.open, -1);
+        }
+    }
+    findBodyTags();
+    return true;
+}
+
+
+TagLister::TagInfo TagLister::at(int i)
 {
     if ((i < 0) || (i >= m_Tags.size())) {
         i = m_Tags.size() - 1; // last entry in list is a dummy entry
     }
-    return m_Tags.at(i);
+    const Tag &tag = m_Tags.at(i);
+    TagInfo ti;
+    ti.pos = tag.pos;
+    ti.len = tag.len;
+    ti.tname = m_Names.at(tag.name);
+    ti.ttype = TAG_TYPES[tag.type];
+    ti.open_pos = -1;
+    ti.open_len = -1;
+    if (tag.open != -1) {
+        ti.open_pos = m_Tags.at(tag.open).pos;
+        ti.open_len = m_Tags.at(tag.open).len;
+    }
+    return ti;
 }
 
 
 size_t TagLister::size() { return m_Tags.size(); }
 
 
+QString TagLister::getTagPath(int i)
+{
+    if ((i < 0) || (i >= m_Tags.size() - 1)) {
+        return QString();
+    }
+    // a begin tag is on its own path, a matched end tag has
+    // already closed the tag it would have shared one with
+    const Tag &tag = m_Tags.at(i);
+    int k = tag.parent;
+    if (tag.type == BeginTag) {
+        k = i;
+    } else if (tag.open != -1) {
+        k = m_Tags.at(tag.open).parent;
+    }
+    QStringList names;
+    for (; k != -1; k = m_Tags.at(k).parent) {
+        names.prepend(m_Names.at(m_Tags.at(k).name));
+    }
+    names.prepend("root");
+    return names.join(".");
+}
+
+
 const QString& TagLister::getSource() { return m_source; }
 
+qint64 TagLister::memorySize() const
+{
+    qint64 total = m_source.capacity() * sizeof(QChar);
+    total += m_Tags.capacity() * sizeof(Tag) + m_OpenTags.capacity() * sizeof(OpenTag);
+    foreach(const QString &name, m_Names) {
+        total += name.capacity() * sizeof(QChar);
+    }
+    total += m_NameIds.count() * (sizeof(QStringView) + sizeof(int));
+    return total;
+}
+
 bool TagLister::isPositionInBody(int pos)
 {
     if ((pos < m_bodyStartPos) || (pos > m_bodyEndPos)) {
@@ -97,8 +257,8 @@ bool TagLister::isPositionInBody(int pos)
 bool TagLister::isPositionInTag(int pos)
 {
     int i = findFirstTagOnOrAfter(pos);
-    TagLister::TagInfo ti = m_Tags.at(i);
-    if ((pos >= ti.pos) && (pos < ti.pos + ti.len)) {
+    const Tag &tag = m_Tags.at(i);
+    if ((pos >= tag.pos) && (pos < tag.pos + tag.len)) {
         return true;
     }
     return false;
@@ -107,9 +267,9 @@ bool TagLister::isPositionInTag(int pos)
 bool TagLister::isPositionInOpenTag(int pos)
 {
     int i = findFirstTagOnOrAfter(pos);
-    TagLister::TagInfo ti = m_Tags.at(i);
-    if ((pos >= ti.pos) && (pos < ti.pos + ti.len)) {
-        if ((ti.ttype == "begin") || (ti.ttype == "single")) return true;
+    const Tag &tag = m_Tags.at(i);
+    if ((pos >= tag.pos) && (pos < tag.pos + tag.len)) {
+        if ((tag.type == BeginTag) || (tag.type == SingleTag)) return true;
     }
     return false;
 }
@@ -117,9 +277,9 @@ bool TagLister::isPositionInOpenTag(int pos)
 bool TagLister::isPositionInCloseTag(int pos)
 {
     int i = findFirstTagOnOrAfter(pos);
-    TagLister::TagInfo ti = m_Tags.at(i);
-    if ((pos >= ti.pos) && (pos < ti.pos + ti.len)) {
-        if (ti.ttype == "end") return true;
+    const Tag &tag = m_Tags.at(i);
+    if ((pos >= tag.pos) && (pos < tag.pos + tag.len)) {
+        if (tag.type == EndTag) return true;
     }
     return false;
 }
@@ -128,25 +288,16 @@ bool TagLister::isPositionInCloseTag(int pos)
 int TagLister::findOpenTagForClose(int i)
 {
     if ((i < 0) || (i >= m_Tags.size())) return -1;
-    TagLister::TagInfo ti = m_Tags.at(i);
-    if (ti.ttype != "end") return -1;
-    int open_pos = ti.open_pos;
-    for (int j=i-1; j >= 0; j--) {
-        TagInfo tb = m_Tags.at(j);
-        if (tb.pos == open_pos) return j;
-    }
-    return -1;
+    if (m_Tags.at(i).type != EndTag) return -1;
+    return m_Tags.at(i).open;
 }
 
 int TagLister::findCloseTagForOpen(int i)
 {
     if ((i < 0) || (i >= m_Tags.size())) return -1;
-    TagLister::TagInfo ti = m_Tags.at(i);
-    if (ti.ttype != "begin") return -1;
-    int open_pos = ti.pos;
+    if (m_Tags.at(i).type != BeginTag) return -1;
     for (int j=i+1; j < m_Tags.size(); j++) {
-        TagInfo te = m_Tags.at(j);
-        if (te.open_pos == open_pos) return j;
+        if (m_Tags.at(j).open == i) return j;
     }
     return -1;
 }
@@ -158,27 +309,74 @@ int TagLister::findLastTagOnOrBefore(int pos)
 {
     // find that tag that starts immediately **after** pos and then
     // then use its predecessor 
-    int i = 0;
-    TagLister::TagInfo ti = at(i);
-    while((ti.pos <= pos) && (ti.len != -1)) {
-        i++;
-        ti = m_Tags.at(i);
+    int lo = 0;
+    int hi = m_Tags.size() - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (m_Tags.at(mid).pos <= pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
-    i--;
-    return i;
+    return lo - 1;
 }
 
 // m_Tags is padded with an ending dummy tag
 // So finding first tag on or after a pos will always work
 int TagLister::findFirstTagOnOrAfter(int pos)
 {
-    int i = 0;
-    TagLister::TagInfo ti = m_Tags.at(i);
-    while((ti.pos + ti.len <= pos) && (ti.len != -1)) {
-        i++;
-        ti = m_Tags.at(i);
+    // tags never overlap so their ends are in order too
+    int lo = 0;
+    int hi = m_Tags.size() - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (m_Tags.at(mid).pos + m_Tags.at(mid).len <= pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
-    return i;
+    return lo;
+}
+
+
+int TagLister::findParentTag(int i)
+{
+    if ((i < 0) || (i >= m_Tags.size() - 1)) return -1;
+    const Tag &tag = m_Tags.at(i);
+    // an end tag is listed inside the tag it closes
+    if ((tag.type == EndTag) && (tag.open != -1)) {
+        return m_Tags.at(tag.open).parent;
+    }
+    return tag.parent;
+}
+
+
+int TagLister::countElementsBefore(int i)
+{
+    int parent = findParentTag(i);
+    if ((i < 0) || (i >= m_Tags.size() - 1)) return 0;
+    if ((m_Tags.at(i).type == EndTag) && (m_Tags.at(i).open != -1)) {
+        i = m_Tags.at(i).open;
+    }
+    // walk back sibling by sibling, jumping over the
+    // whole of each earlier element from its end tag
+    int count = 0;
+    int k = i - 1;
+    while (k > parent) {
+        const Tag &tag = m_Tags.at(k);
+        if ((tag.type == EndTag) && (tag.open != -1) && (m_Tags.at(tag.open).parent == parent)) {
+            count++;
+            k = tag.open - 1;
+            continue;
+        }
+        if (((tag.type == BeginTag) || (tag.type == SingleTag)) && (tag.parent == parent)) {
+            count++;
+        }
+        k--;
+    }
+    return count;
 }
 
 
@@ -295,44 +493,40 @@ QString TagLister::extractAllAttributes(const QStringView tagstring)
 
 // private routines
 
-TagLister::TagInfo TagLister::getNext()
+bool TagLister::getNext(Tag &tag, int index)
 {
-    TagInfo mi;
-    mi.pos = -1;
-    mi.len = -1;
-    mi.open_pos = -1;
-    mi.open_len = -1;
     QStringView markup = parseML();
     while (!markup.isNull()) {
         if ((markup.at(0) == '<') && (markup.at(markup.size() - 1) == '>')) {
-            mi.pos = m_pos;
-            parseTag(markup, mi);
-            if (mi.ttype == "begin") {
-                m_TagPath << mi.tname;
-                m_TagPos << mi.pos;
-                m_TagLen << mi.len;
-            } else if (mi.ttype == "end") {
-                QString tname = m_TagPath.last();
-                if (tname == mi.tname) {
-                    m_TagPath.removeLast();
-                    mi.open_pos = m_TagPos.takeLast();
-                    mi.open_len = m_TagLen.takeLast();
+            tag.pos = m_pos;
+            tag.parent = m_OpenTags.isEmpty() ? -1 : m_OpenTags.last().index;
+            tag.open = -1;
+            parseTag(markup, tag);
+            if (tag.type == BeginTag) {
+                OpenTag ot;
+                ot.index = index;
+                ot.name = tag.name;
+                ot.pos = tag.pos;
+                ot.len = tag.len;
+                m_OpenTags << ot;
+            } else if (tag.type == EndTag) {
+                if (!m_OpenTags.isEmpty() && (m_OpenTags.last().name == tag.name)) {
+                    tag.open = m_OpenTags.takeLast().index;
                 } else {
+                    QString tname = m_OpenTags.isEmpty() ? QString("root") : m_Names.at(m_OpenTags.last().name);
+                    int tpos = m_OpenTags.isEmpty() ? -1 : m_OpenTags.last().pos;
                     qDebug() << "TagLister Error: Not well formed -  open close mismatch: ";
-                    qDebug() << "   open Tag: " << tname << " at position: " << m_TagPos.last();
-                    qDebug() << "   close Tag: " << mi.tname << " at position: " << mi.pos;
-                    mi.open_pos = -1;
-                    mi.open_len = -1;
+                    qDebug() << "   open Tag: " << tname << " at position: " << tpos;
+                    qDebug() << "   close Tag: " << m_Names.at(tag.name) << " at position: " << tag.pos;
                 }
             }
-            mi.tpath = m_TagPath.join(".");
-            return mi;
+            return true;
         }
         // skip anything not a tag
         markup = parseML();
     }
     // done
-    return mi;
+    return false;
 }
 
 
@@ -370,33 +564,35 @@ QStringView TagLister::parseML()
 }
 
 
-void TagLister::parseTag(const QStringView tagstring, TagLister::TagInfo& mi)
+void TagLister::parseTag(const QStringView tagstring, TagLister::Tag& tag)
 {
-    mi.len = tagstring.length();
+    tag.len = tagstring.length();
+    tag.name = 0;
+    tag.type = NoTagType;
     QChar c = tagstring.at(1);
     int p = 0;
     
     // first handle special cases
     if (c == '?') {
         if (tagstring.startsWith(QL1SV("<?xml"))) {
-            mi.tname = "?xml";
-            mi.ttype = "xmlheader";
+            tag.name = internName(u"?xml");
+            tag.type = XmlHeaderTag;
         } else {
-            mi.tname = "?";
-            mi.ttype = "pi";
+            tag.name = internName(u"?");
+            tag.type = PITag;
         }
         return;
     }
     if (c == '!') {
         if (tagstring.startsWith(QL1SV("<!--"))) {
-            mi.tname = "!--";
-            mi.ttype = "comment"; 
+            tag.name = internName(u"!--");
+            tag.type = CommentTag;
         } else if (tagstring.startsWith(QL1SV("<!DOCTYPE")) || tagstring.startsWith(QL1SV("<!doctype"))) {
-            mi.tname = "!DOCTYPE";
-            mi.ttype = "doctype";
+            tag.name = internName(u"!DOCTYPE");
+            tag.type = DoctypeTag;
         } else if (tagstring.startsWith(QL1SV("<![CDATA[")) || tagstring.startsWith(QL1SV("<![cdata["))) {
-            mi.tname = "![CDATA[";
-            mi.ttype = "cdata";
+            tag.name = internName(u"![CDATA[");
+            tag.type = CDataTag;
         }
         return;
     }
@@ -404,18 +600,18 @@ void TagLister::parseTag(const QStringView tagstring, TagLister::TagInfo& mi)
     // normal tag, extract tag name
     p = skipAnyBlanks(tagstring, 1);
     if (tagstring.at(p) == '/') {
-        mi.ttype = "end";
+        tag.type = EndTag;
         p++;
         p = skipAnyBlanks(tagstring, p);
     };
     int b = p;
     p = stopWhenContains(tagstring, ">/ \f\t\r\n", p);
-    mi.tname = Utility::Substring(b, p, tagstring);
+    tag.name = internName(tagstring.mid(b, p - b));
 
     // fill in tag type
-    if (mi.ttype.isEmpty()) {
-        mi.ttype = "begin";
-        if (tagstring.endsWith(QL1SV("/>")) || tagstring.endsWith(QL1SV("/ >"))) mi.ttype = "single";
+    if (tag.type == NoTagType) {
+        tag.type = BeginTag;
+        if (tagstring.endsWith(QL1SV("/>")) || tagstring.endsWith(QL1SV("/ >"))) tag.type = SingleTag;
     }
     return;
 }
@@ -444,34 +640,109 @@ int TagLister::stopWhenContains(const QStringView tgt, const QString& stopchars,
     return p;
 }
 
+
 void TagLister::buildTagList()
 {
         m_Tags.clear();
-        m_bodyStartPos = -1;
-        m_bodyEndPos = -1;
-        m_bodyOpenTag = -1;
-        m_bodyCloseTag = -1;
-        int i = 0;
-        TagLister::TagInfo ti = getNext();
-        while(ti.len != -1) {
-            if ((ti.tname == "body") && (ti.ttype == "begin")) {
-                m_bodyStartPos = ti.pos + ti.len;
+        Tag tag;
+        while(getNext(tag, m_Tags.size())) {
+            m_Tags << tag;
+        }
+        // set stop indicator as last record
+        tag.pos = -1;
+        tag.len = -1;
+        tag.name = 0;
+        tag.parent = -1;
+        tag.open = -1;
+        tag.type = NoTagType;
+        m_Tags << tag;
+        findBodyTags();
+}
+
+
+void TagLister::findBodyTags()
+{
+    m_bodyStartPos = -1;
+    m_bodyEndPos = -1;
+    m_bodyOpenTag = -1;
+    m_bodyCloseTag = -1;
+    // skip the dummy last record
+    for (int i = 0; i < m_Tags.size() - 1; i++) {
+        const Tag &tag = m_Tags.at(i);
+        if (tag.name == m_bodyName) {
+            if (tag.type == BeginTag) {
+                m_bodyStartPos = tag.pos + tag.len;
                 m_bodyOpenTag = i;
-            }
-            if ((ti.tname == "body") && (ti.ttype == "end")) {
-                m_bodyEndPos = ti.pos - 1;
+            } else if (tag.type == EndTag) {
+                m_bodyEndPos = tag.pos - 1;
                 m_bodyCloseTag = i;
             }
-            TagLister::TagInfo temp = ti;
-            m_Tags << temp;
-            i++;
-            ti = getNext();
         }
-        // set stop indicator as last record
-        TagLister::TagInfo temp;
-        temp.pos = -1;
-        temp.len = -1;
-        temp.open_pos = -1;
-        temp.open_len = -1;
-        m_Tags << temp;
+    }
+}
+
+
+// sets the open tags to what they were just after tag last_tag was listed
+void TagLister::restoreTagStack(int last_tag)
+{
+    m_OpenTags.clear();
+    if (last_tag < 0) {
+        return;
+    }
+    const Tag &tag = m_Tags.at(last_tag);
+    int k = tag.parent;
+    if (tag.type == BeginTag) {
+        k = last_tag;
+    } else if (tag.open != -1) {
+        k = m_Tags.at(tag.open).parent;
+    }
+    for (; k != -1; k = m_Tags.at(k).parent) {
+        OpenTag ot;
+        ot.index = k;
+        ot.name = m_Tags.at(k).name;
+        ot.pos = m_Tags.at(k).pos;
+        ot.len = m_Tags.at(k).len;
+        m_OpenTags.prepend(ot);
+    }
+}
+
+
+// must match how getNext opens and closes tags
+void TagLister::trackTag(int index, QList<OpenTag> &opentags) const
+{
+    const Tag &tag = m_Tags.at(index);
+    if (tag.type == BeginTag) {
+        OpenTag ot;
+        ot.index = index;
+        ot.name = tag.name;
+        ot.pos = tag.pos;
+        ot.len = tag.len;
+        opentags << ot;
+    } else if (tag.type == EndTag) {
+        if (!opentags.isEmpty() && (opentags.last().name == tag.name)) {
+            opentags.removeLast();
+        }
+    }
+}
+
+
+void TagLister::resetNames()
+{
+    m_Names.clear();
+    m_NameIds.clear();
+    internName(u"");
+    m_bodyName = internName(u"body");
+}
+
+
+int TagLister::internName(const QStringView name)
+{
+    int id = m_NameIds.value(name, -1);
+    if (id == -1) {
+        id = m_Names.size();
+        m_Names << name.toString();
+        // the view must point into the stored copy, not the source
+        m_NameIds.insert(QStringView(m_Names.last()), id);
+    }
+    return id;
 }
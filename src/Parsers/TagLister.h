@@ -25,6 +25,7 @@
 #include <QStringList>
 #include <QStringView>
 #include <QList>
+#include <QHash>
 
 class QString;
 
@@ -35,7 +36,6 @@ public:
     struct TagInfo {
         int     pos;      // position of tag in source
         int     len;      // length of tag in source
-        QString tpath;    // path of tag names to this tag ("." joined) 
         QString tname;    // tag name, ?xml, ?, !--, !DOCTYPE, ![CDATA[
         QString ttype;    // xmlheader, pi, comment, doctype, cdata, begin, single, end
         int     open_pos; // set if end tag to position of its corresponding begin tag
@@ -59,9 +59,17 @@ public:
 
     void reloadLister(const QString &source);
 
-    const TagInfo& at(int i);
+    // Replaces chars_removed characters at position in the source with
+    // added_text and re-lists only the tags the edit can have changed.
+    // Returns false if the edit does not fit the current source.
+    bool updateLister(int position, int chars_removed, const QString &added_text);
+
+    TagInfo at(int i);
     size_t size();
 
+    // path of tag names to tag i ("." joined), built when asked for
+    QString getTagPath(int i);
+
     bool isPositionInBody(int pos);
     bool isPositionInTag(int pos);
     bool isPositionInOpenTag(int pos);
@@ -72,21 +80,64 @@ public:
     int findOpenTagForClose(int i);
     int findCloseTagForOpen(int i);
     int findBodyOpenTag();
+    // the begin tag that tag i is inside of, -1 if none
+    int findParentTag(int i);
+    // how many begin and single tags inside the same parent come before tag i
+    int countElementsBefore(int i);
     int findBodyCloseTag();
 
     const QString& getSource();
 
+    // roughly how many bytes the copy of the source and the tag list use
+    qint64 memorySize() const;
+
     static void parseAttribute(const QStringView tagstring, const QString &attribute_name, AttInfo& ainfo);
     static QString serializeAttribute(const QString &aname, const QString &avalue);
     static QString extractAllAttributes(const QStringView tagstring);
     
 private:
-    TagInfo getNext();
+
+    enum TagType : quint8 {
+        NoTagType = 0,
+        XmlHeaderTag,
+        PITag,
+        CommentTag,
+        DoctypeTag,
+        CDataTag,
+        BeginTag,
+        SingleTag,
+        EndTag
+    };
+
+    // What is kept for each tag.  The strings of a TagInfo are
+    // only filled in when the tag is asked for.
+    struct Tag {
+        int     pos;
+        int     len;
+        int     name;     // index into m_Names
+        int     parent;   // index of the innermost open begin tag, -1 if none
+        int     open;     // set if end tag to the index of its begin tag
+        TagType type;
+    };
+
+    struct OpenTag {
+        int     index;
+        int     name;
+        int     pos;
+        int     len;
+    };
+
+    bool  getNext(Tag &tag, int index);
     void  buildTagList();
+    void  findBodyTags();
+    void  restoreTagStack(int last_tag);
+    void  trackTag(int index, QList<OpenTag> &opentags) const;
+    void  resetNames();
+    int   internName(const QStringView name);
 
     QStringView parseML();
 
-    void parseTag(const QStringView tagstring, TagInfo &mi);
+    void parseTag(const QStringView tagstring, Tag &tag);
 
     int findTarget(const QString &tgt, int p, bool after=false);
     static int skipAnyBlanks(const QStringView segment, int p);
@@ -95,10 +146,15 @@ private:
     QString        m_source;
     int            m_pos;
     int            m_next;
-    QStringList    m_TagPath;
-    QList<int>     m_TagPos;
-    QList<int>     m_TagLen;
-    QList<TagInfo> m_Tags;
+    QList<OpenTag> m_OpenTags;
+    QList<Tag>     m_Tags;
+
+    // every tag name seen, each stored once
+    QStringList    m_Names;
+    // views into m_Names
+    QHash<QStringView, int> m_NameIds;
+    int            m_bodyName;
+
     int            m_bodyStartPos;
     int            m_bodyEndPos;
     int            m_bodyOpenTag;
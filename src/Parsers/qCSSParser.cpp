@@ -41,6 +41,7 @@
 #include <QChar>
 #include <QString>
 #include <QTextStream>
+#include <utility>
 #include "Parsers/qCSSProperties.h"
 #include "Parsers/qCSSUtils.h"
 #include "Parsers/qCSSParser.h"
@@ -53,9 +54,19 @@
  * PAT = in @-block
  */
 
+// built once instead of for every character examined
+static const QString STRING_SKIP_CHARS = " \n\t\r\0xb";
+static const QString AT_RULE_SYMBOLS = "():/.";
+
 CSSParser::CSSParser()
 { 
     tokens = "{};:()@='\"/,\\!$%&*+.<>?[]^`|~";
+    for (int i = 0; i < 128; i++) {
+        token_table[i] = false;
+    }
+    for (int i = 0; i < tokens.length(); i++) {
+        token_table[tokens.at(i).unicode()] = true;
+    }
 
     // Used for serializing parsed css (multiline format)
     csstemplateM.push_back("  ");      //  0 - standard indentation
@@ -89,6 +100,22 @@ CSSParser::CSSParser()
     csstemplate1.push_back("\n");      // 12 - after comment
     csstemplate1.push_back("");        // 13 - after last line @-rule
 
+    // Used for serializing parsed css (minified)
+    csstemplateMin.push_back("");      //  0 - standard indentation
+    csstemplateMin.push_back("{");     //  1 - bracket after @-rule
+    csstemplateMin.push_back("");      //  2 - space after "," in selector
+    csstemplateMin.push_back("{");     //  3 - bracket after selector was "\n{\n"
+    csstemplateMin.push_back("");      //  4 - unused
+    csstemplateMin.push_back("");      //  5 - string after property before value
+    csstemplateMin.push_back(";");     //  6 - string after value
+    csstemplateMin.push_back("}");     //  7 - closing bracket - selector
+    csstemplateMin.push_back("");      //  8 - space between blocks {...}
+    csstemplateMin.push_back("}");     //  9 - closing bracket @-rule
+    csstemplateMin.push_back("");      // 10 - unused
+    csstemplateMin.push_back("");      // 11 - before comment
+    csstemplateMin.push_back("");      // 12 - after comment
+    csstemplateMin.push_back("");      // 13 - after last line @-rule
+
 
     // at_rule to parser state map
     at_rules["page"] = PIS;
@@ -194,14 +221,14 @@ QString CSSParser::get_type_name(CSSParser::token_type t)
 }
 
 
-void CSSParser::add_token(const token_type ttype, const QString data)
+void CSSParser::add_token(const token_type ttype, const QString &data)
 {
     token temp;
     temp.type = ttype;
     temp.pos = spos;
     temp.line = sline;
     temp.data = (ttype == COMMENT) ? data : CSSUtils::trim(data);
-    csstokens.push_back(temp);
+    csstokens.push_back(std::move(temp));
     if (ttype == SEL_START) selector_nest_level++;
     if (ttype == SEL_END) selector_nest_level--;
 }
@@ -228,7 +255,7 @@ void CSSParser::log(const QString msg, const message_type type, int iline)
     logs[line].push_back(new_msg);
 }
 
-QString CSSParser::unicode(QString& istring, int& i)
+QString CSSParser::unicode(const QString& istring, int& i)
 {
     ++i;
     QString add = "";
@@ -271,9 +298,10 @@ QString CSSParser::unicode(QString& istring, int& i)
 }
 
 
-bool CSSParser::is_token(QString& istring, const int i)
+bool CSSParser::is_token(const QString& istring, const int i)
 {
-    return (tokens.contains(istring[i]) && !CSSUtils::escaped(istring,i));
+    ushort c = istring[i].unicode();
+    return ((c < 128) && token_table[c] && !CSSUtils::escaped(istring,i));
 }
 
 
@@ -302,6 +330,25 @@ int CSSParser::_seeknocomment(const int key, int move)
 
 
 QString CSSParser::serialize_css(bool tostdout, bool multiline)
+{
+    QString output_string = serialize_tokens(multiline ? csstemplateM : csstemplate1, multiline, false);
+
+    if(tostdout)
+    {
+        QTextStream out(stdout, QIODevice::WriteOnly);
+        out << output_string << "\n";
+    }
+    return output_string;
+}
+
+
+QString CSSParser::serialize_css_minified()
+{
+    return serialize_tokens(csstemplateMin, false, true);
+}
+
+
+QString CSSParser::serialize_tokens(const QVector<QString> &csstemplate, bool multiline, bool minify)
 {
     QString output_string;
     QTextStream output(&output_string);
@@ -309,14 +356,6 @@ QString CSSParser::serialize_css(bool tostdout, bool multiline)
     int lvl = 0;
     QString indent = "";
 
-    QVector<QString> csstemplate;
-
-    if (multiline) {
-        csstemplate = csstemplateM;
-    } else {
-        csstemplate = csstemplate1;
-    }
-
     for (int i = 0; i < csstokens.size(); ++i)
     {
         switch (csstokens[i].type)
@@ -354,7 +393,9 @@ QString CSSParser::serialize_css(bool tostdout, bool multiline)
                 break;
 
             case VALUE:
-                output << csstokens[i].data << csstemplate[6];
+                output << csstokens[i].data;
+                // the last declaration of a block needs no semicolon
+                if (!minify || _seeknocomment(i, 1) != SEL_END) output << csstemplate[6];
                 break;
 
             case SEL_END:
@@ -377,7 +418,10 @@ QString CSSParser::serialize_css(bool tostdout, bool multiline)
                 break;
 
             case COMMENT:
-                if (multiline || (lvl == 0)) {
+                if (minify) {
+                    // keep the comments meant to survive minifying, such as licenses
+                    if (csstokens[i].data.startsWith('!')) output << "/*" << csstokens[i].data << "*/";
+                } else if (multiline || (lvl == 0)) {
                     output << csstemplate[11] <<  "/*" << csstokens[i].data << "*/" << csstemplate[12];
                 } else {
                     output << csstemplate[11] <<  "/*" << csstokens[i].data << "*/";
@@ -390,17 +434,11 @@ QString CSSParser::serialize_css(bool tostdout, bool multiline)
     }
 
     output_string = CSSUtils::trim(output_string);
-
-    if(tostdout)
-    {
-        QTextStream out(stdout, QIODevice::WriteOnly);
-        out << output_string << "\n";
-    }
     return output_string;
 }
 
 
-void CSSParser::parseInAtBlock(QString& css_input, int& i, parse_status& astatus, parse_status& afrom)
+void CSSParser::parseInAtBlock(const QString& css_input, int& i, parse_status& astatus, parse_status& afrom)
 {
     if(is_token(css_input,i))
     {
@@ -424,7 +462,7 @@ void CSSParser::parseInAtBlock(QString& css_input, int& i, parse_status& astatus
         }
         else /*if((css_input[i] == '(') || (css_input[i] == ':') || (css_input[i] == ')') || (css_input[i] == '.'))*/
         {
-            if(!QString("():/.").contains(css_input[i]))
+            if(!AT_RULE_SYMBOLS.contains(css_input[i]))
             {
                 // Strictly speaking, these are only permitted in @media rules 
                 log("Unexpected symbol '" + css_input[i] + "' in @-rule", Warning);
@@ -446,7 +484,7 @@ void CSSParser::parseInAtBlock(QString& css_input, int& i, parse_status& astatus
 }
 
 
-void CSSParser::parseInSelector(QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
+void CSSParser::parseInSelector(const QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
                                 bool& invalid_at, QChar& str_char, int str_size)
 {
     if(is_token(css_input,i))
@@ -540,7 +578,7 @@ void CSSParser::parseInSelector(QString& css_input, int& i, parse_status& astatu
 }
 
 
-void CSSParser::parseInProperty(QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
+void CSSParser::parseInProperty(const QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
                                 bool& invalid_at)
 {
 
@@ -605,7 +643,7 @@ void CSSParser::parseInProperty(QString& css_input, int& i, parse_status& astatu
 }
 
 
-void CSSParser::parseInValue(QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
+void CSSParser::parseInValue(const QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
                              bool& invalid_at, QChar& str_char, bool& pn, int str_size)
 {
     pn = (((css_input[i] == '\n' || css_input[i] == '\r') && property_is_next(css_input,i+1)) || i == str_size-1);
@@ -810,25 +848,26 @@ void CSSParser::parseInValue(QString& css_input, int& i, parse_status& astatus,
 }
 
 
-void CSSParser::parseInComment(QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
-                               QString& cur_comment)
+// The comment text is taken from the input in one piece when
+// the comment closes rather than built up a character at a time
+void CSSParser::parseInComment(const QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
+                               int& comment_start)
 {
-
+    if (comment_start < 0)
+    {
+        comment_start = i;
+    }
     if(css_input[i] == '*' && CSSUtils::s_at(css_input,i+1) == '/')
     {
         astatus = afrom;
+        add_token(COMMENT, css_input.mid(comment_start, i - comment_start));
+        comment_start = -1;
         ++i;
-        add_token(COMMENT, cur_comment);
-        cur_comment = "";
-    }
-    else
-    {
-        cur_comment += css_input[i];
     }
 }
 
 
-void CSSParser::parseInString(QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
+void CSSParser::parseInString(const QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
                               QChar& str_char, bool& str_in_str)
 {
 
@@ -842,16 +881,23 @@ void CSSParser::parseInString(QString& css_input, int& i, parse_status& astatus,
     {
         str_in_str = false;
     }
-    QString temp_add = ""; temp_add += css_input[i];
+    bool fix_newline = false;
     if( (css_input[i] == '\n' || css_input[i] == '\r') &&
         !(css_input[i-1] == '\\' && !CSSUtils::escaped(css_input,i-1)) )
     {
-        temp_add = "\\A ";
+        fix_newline = true;
         log("Fixed incorrect newline in string",Warning);
     }
-    if (!(str_char == ')' && QString(" \n\t\r\0xb").contains(css_input[i]) && !str_in_str))
+    if (!(str_char == ')' && STRING_SKIP_CHARS.contains(css_input[i]) && !str_in_str))
     {
-        cur_string += temp_add;
+        if (fix_newline)
+        {
+            cur_string += "\\A ";
+        }
+        else
+        {
+            cur_string += css_input[i];
+        }
     }
     if(css_input[i] == str_char && !CSSUtils::escaped(css_input,i) && str_in_str == false)
     {
@@ -869,15 +915,16 @@ void CSSParser::parseInString(QString& css_input, int& i, parse_status& astatus,
 }
 
 
-void CSSParser::parse_css(QString css_input)
+void CSSParser::parse_css(const QString &css_text)
 {
     reset_parser();
-    css_input = css_input.replace("\r\n","\n"); // Replace newlines
+    QString css_input = css_text;
+    css_input.replace("\r\n","\n"); // Replace newlines
     css_input += "\n";
     parse_status astatus = PIS, afrom;
     parse_status old_status = PIS;
     record_position(PIS, PIS, css_input, 0, true);
-    QString cur_comment;
+    int comment_start = -1;
 
     cur_sub_value_arr.clear();
     cur_function_arr.clear(); // Stack of nested function calls
@@ -887,6 +934,8 @@ void CSSParser::parse_css(QString css_input)
     bool pn = false;
 
     int str_size = css_input.length();
+    // a rough guess of the token count so the vector seldom regrows
+    csstokens.reserve(str_size / 32);
     for(int i = 0; i < str_size; ++i)
     {
         // track line number
@@ -929,7 +978,7 @@ void CSSParser::parse_css(QString css_input)
 
             /* Case in-comment */
             case PIC:
-                parseInComment(css_input, i, astatus, afrom, cur_comment);
+                parseInComment(css_input, i, astatus, afrom, comment_start);
                 break;
         }
     }
@@ -991,16 +1040,25 @@ QStringList CSSParser::splitGroupSelector(const QString& sel)
 }
 
 
-bool CSSParser::property_is_next(QString istring, int pos)
+// The trimmed text up to the next ':' must be a known property.
+// Property names are only made of letters, digits and '-' so the
+// scan can stop at the first other character instead of copying
+// the rest of the style sheet each time a value spans lines.
+bool CSSParser::property_is_next(const QString &istring, int pos)
 {
-    istring = istring.mid(pos,istring.length()-pos);
-    pos = CSSUtils::find_first_of(istring, ":");
-    if(pos == -1)
+    int len = istring.length();
+    while ((pos < len) && STRING_SKIP_CHARS.contains(istring[pos])) pos++;
+    int start = pos;
+    while ((pos < len) && (CSSUtils::ctype_alpha(istring[pos]) ||
+                           CSSUtils::ctype_digit(istring[pos]) ||
+                           (istring[pos] == '-') || (istring[pos] == '_'))) pos++;
+    int end = pos;
+    while ((pos < len) && STRING_SKIP_CHARS.contains(istring[pos])) pos++;
+    if ((pos >= len) || (istring[pos] != ':'))
     {
         return false;
     }
-    istring = CSSUtils::strtolower(CSSUtils::trim(istring.mid(0,pos)));
-    return CSSProperties::instance()->contains(istring);
+    return CSSProperties::instance()->contains(CSSUtils::strtolower(istring.mid(start, end - start)));
 }
 
 
@@ -1055,7 +1113,7 @@ void CSSParser::set_csstokens(const QVector<CSSParser::token> &ntokens)
 
 // update the position only for selected state transitions
 void CSSParser::record_position(parse_status old_status, parse_status new_status,
-                                QString &css_input, int i, bool force)
+                                const QString &css_input, int i, bool force)
 {
     // to reach here old_status must be != new_status
     bool record = false;
@@ -1078,7 +1136,7 @@ void CSSParser::record_position(parse_status old_status, parse_status new_status
     if ((old_status == PIC) && (new_status == PIS)) record = true; 
     
     if (record || force) {
-        spos = CSSUtils::find_first_not_of(css_input, " \n\t\r\0xb", i);
+        spos = CSSUtils::find_first_not_of(css_input, STRING_SKIP_CHARS, i);
         sline = line;
         for(int j = i+1; j <= spos; j++) {
             if (css_input[j] == '\n') sline++;
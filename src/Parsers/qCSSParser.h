@@ -86,12 +86,16 @@ public:
     // valid levels are "CSS1.0", "CSS2.0", "CSS2.1", "CSS3.0"
     void set_level(QString level = "CSS3.0");
 
-    void parse_css(QString css_input);
+    void parse_css(const QString &css_text);
 
     void reset_parser();        
 
     // serialize the current list of csstokens back to css
     QString serialize_css(bool tostdout = true, bool multiline = true);
+
+    // serialize the current list of csstokens with no whitespace that is not
+    // needed, dropping all comments but those that start with "/*!"
+    QString serialize_css_minified();
         
     // access charset, namespace and imports without having to walk csstokens
     QString get_charset();
@@ -125,21 +129,21 @@ public:
 
 private:
 
-    void parseInAtBlock(QString& css_input, int& i, parse_status& astatus, parse_status& afrom);
+    void parseInAtBlock(const QString& css_input, int& i, parse_status& astatus, parse_status& afrom);
 
-    void parseInSelector(QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
+    void parseInSelector(const QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
                          bool& invalid_at, QChar& str_char, int str_size);
 
-    void parseInProperty(QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
+    void parseInProperty(const QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
                          bool& invalid_at);
 
-    void parseInValue(QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
+    void parseInValue(const QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
                       bool& invalid_at, QChar& str_char, bool& pn, int str_size );
 
-    void parseInComment(QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
-                        QString& cur_comment);
+    void parseInComment(const QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
+                        int& comment_start);
 
-    void parseInString(QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
+    void parseInString(const QString& css_input, int& i, parse_status& astatus, parse_status& afrom,
                        QChar&  str_char, bool& str_in_str);
 
 
@@ -147,25 +151,27 @@ private:
     QVector<QString> get_logs(message_type t);
 
     // Pparses unicode notations
-    QString unicode(QString& istring, int& i);
+    QString unicode(const QString& istring, int& i);
         
     // checks if the chat in istring at i is a token
-    bool is_token(QString& istring, const int i);
+    bool is_token(const QString& istring, const int i);
                         
-    void add_token(const token_type ttype, const QString data);
+    void add_token(const token_type ttype, const QString &data);
         
     // Add a message to the message log
     void log(const QString msg, const message_type type, int iline = 0);
 
     // records token position information
     void record_position(parse_status old_status, parse_status new_status,
-                         QString &css_input, int i, bool force=false);
+                         const QString &css_input, int i, bool force=false);
         
     int _seeknocomment(const int key, const int move);
 
+    QString serialize_tokens(const QVector<QString> &csstemplate, bool multiline, bool minify);
+
     void explode_selectors();
 
-    static bool property_is_next(QString istring, int pos);
+    static bool property_is_next(const QString &istring, int pos);
 
 
 
@@ -174,8 +180,11 @@ private:
     QMap<QString, parse_status>  at_rules;
     QVector<QString> csstemplateM;
     QVector<QString> csstemplate1;
+    QVector<QString> csstemplateMin;
     QString css_level;
     QString tokens;
+    // lookup table of the ascii characters in tokens
+    bool token_table[128];
     int token_ptr;
 
     QMap<int, QVector<message> > logs;
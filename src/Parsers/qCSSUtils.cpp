@@ -40,6 +40,11 @@
  
 #include "Parsers/qCSSUtils.h"
 
+// built once instead of on every call
+static const QString WHITESPACE_CHARS = " \n\t\r\0xb";
+static const QString NO_SPACE_AFTER = "(=:";
+static const QString NO_SPACE_BEFORE = "),=:";
+
 QString CSSUtils::strtolower(QString istring)
 {
     int str_size = istring.length();
@@ -155,7 +160,7 @@ QString CSSUtils::build_value(const QVector<QString> subvalues)
             QChar next = s_at(subvalues[i+1], 0);
             // allow a space after a comma in a values list.  next line was:
             // if (QString("(,=:").contains(last) || QString("),=:").contains(next))
-            if (QString("(=:").contains(last) || QString("),=:").contains(next))
+            if (NO_SPACE_AFTER.contains(last) || NO_SPACE_BEFORE.contains(next))
             {
                 continue;
             }
@@ -196,13 +201,13 @@ bool CSSUtils::ctype_alpha(QChar c)
 
 const QString CSSUtils::trim(const QString istring)
 {
-    int first = find_first_not_of(istring, " \n\t\r\0xb");
+    int first = find_first_not_of(istring, WHITESPACE_CHARS);
     if (first == -1) {
         return QString();
     }
     else
     {
-        int last = find_last_not_of(istring, " \n\t\r\0xb");
+        int last = find_last_not_of(istring, WHITESPACE_CHARS);
         return istring.mid( first, last - first + 1);
     }
 }
@@ -210,7 +215,7 @@ const QString CSSUtils::trim(const QString istring)
 
 const QString CSSUtils::ltrim(const QString istring)
 {
-    int first = find_first_not_of(istring, " \n\t\r\0xb");
+    int first = find_first_not_of(istring, WHITESPACE_CHARS);
     if (first == -1) {
         return QString();
     }
@@ -223,7 +228,7 @@ const QString CSSUtils::ltrim(const QString istring)
 
 const QString CSSUtils::rtrim(const QString istring)
 {
-    int last = find_last_not_of(istring, " \n\t\r\0xb"); /// must succeed
+    int last = find_last_not_of(istring, WHITESPACE_CHARS); /// must succeed
     return istring.mid(0, last + 1);
 }
 
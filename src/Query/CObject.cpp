@@ -41,6 +41,16 @@ CObject::CObject()
     mReferences = 1;
 }
 
+CObject::CObject(const CObject&)
+{
+    mReferences = 1;
+}
+
+CObject& CObject::operator=(const CObject&)
+{
+    return *this;
+}
+
 CObject::~CObject()
 {
     if (mReferences != 1)
@@ -61,14 +71,10 @@ void CObject::release()
         // throw "something wrong, reference count is negative";
     }
 
-    if (mReferences == 1)
+    if (mReferences.fetch_sub(1) == 1)
     {
         delete this;
     }
-    else
-    {
-        mReferences--;
-    }
 }
 
 unsigned int CObject::references()
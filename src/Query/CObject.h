@@ -37,6 +37,8 @@
 #ifndef COBJECT_H_
 #define COBJECT_H_
 
+#include <atomic>
+
 class CObject
 {
 
@@ -44,6 +46,11 @@ class CObject
 
     CObject();
 
+    // a copy is a new object with a reference count of its own
+    CObject(const CObject&);
+
+    CObject& operator=(const CObject&);
+
     virtual ~CObject();
 
  public:
@@ -56,7 +63,8 @@ class CObject
 
  private:
 
-    int mReferences;
+    // atomic so compiled selectors can be shared between threads
+    std::atomic<int> mReferences;
 };
 
 #endif /* COBJECT_H_ */
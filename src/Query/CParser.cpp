@@ -39,6 +39,8 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
 
 class QueryParserException : public std::runtime_error
 {
@@ -87,6 +89,60 @@ CSelector* CParser::create(std::string aInput)
     return parser.parseSelectorGroup();
 }
 
+// Compiled selectors kept for reuse, dropped all at once when full
+static const size_t MAX_COMPILED = 4096;
+static std::mutex compiled_mutex;
+
+struct CompiledSelectors : public std::unordered_map<std::string, CSelector*>
+{
+    ~CompiledSelectors()
+    {
+        for (iterator it = begin(); it != end(); it++)
+        {
+            it->second->release();
+        }
+    }
+};
+
+static CompiledSelectors compiled;
+
+CSelector* CParser::compile(const std::string& aInput)
+{
+    {
+        std::lock_guard<std::mutex> locker(compiled_mutex);
+        std::unordered_map<std::string, CSelector*>::iterator it = compiled.find(aInput);
+        if (it != compiled.end())
+        {
+            it->second->retain();
+            return it->second;
+        }
+    }
+
+    // parse without the lock, errors are thrown to the caller as for create
+    CSelector* sel = create(aInput);
+
+    std::lock_guard<std::mutex> locker(compiled_mutex);
+    std::unordered_map<std::string, CSelector*>::iterator it = compiled.find(aInput);
+    if (it != compiled.end())
+    {
+        // another thread got there first
+        sel->release();
+        it->second->retain();
+        return it->second;
+    }
+    if (compiled.size() >= MAX_COMPILED)
+    {
+        for (it = compiled.begin(); it != compiled.end(); it++)
+        {
+            it->second->release();
+        }
+        compiled.clear();
+    }
+    sel->retain();
+    compiled[aInput] = sel;
+    return sel;
+}
+
 CSelector* CParser::parseSelectorGroup()
 {
     CSelector* ret = parseSelector();
@@ -57,6 +57,12 @@ class CParser
 
     static CSelector* create(std::string aInput);
 
+    // Returns the selector for aInput, only parsing it the first time it
+    // is asked for so the same selector run over every file of a book is
+    // parsed once.  The selector is shared and must not be changed, the
+    // caller owns one reference and must release it.
+    static CSelector* compile(const std::string& aInput);
+
  private:
 
     CSelector* parseSelectorGroup();
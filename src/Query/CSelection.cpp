@@ -51,7 +51,7 @@ CSelection::CSelection(GumboNode* apNode, bool error)
 
 CSelection::CSelection(std::vector<GumboNode*> aNodes, bool error)
 {
-    mNodes = aNodes;
+    mNodes = std::move(aNodes);
     mparseError = error;
 }
 
@@ -64,16 +64,25 @@ CSelection CSelection::find(std::string aSelector)
     // parsing the any selector can throw exceptions
     // try to fail gracefully 
     try {
-        CSelector* sel = CParser::create(aSelector);
+        CSelector* sel = CParser::compile(aSelector);
         std::vector<GumboNode*> ret;
-        for (std::vector<GumboNode*>::iterator it = mNodes.begin(); it != mNodes.end(); it++)
+        if (mNodes.size() == 1)
         {
-            GumboNode* pNode = *it;
-            std::vector<GumboNode*> matched = sel->matchAll(pNode);
-            ret = CQueryUtil::unionNodes(ret, matched);
+            // the usual case of a search from the root has nothing to merge
+            sel->matchAll(mNodes[0], ret);
+        }
+        else
+        {
+            for (std::vector<GumboNode*>::iterator it = mNodes.begin(); it != mNodes.end(); it++)
+            {
+                GumboNode* pNode = *it;
+                std::vector<GumboNode*> matched;
+                sel->matchAll(pNode, matched);
+                ret = CQueryUtil::unionNodes(ret, matched);
+            }
         }
         sel->release();
-        return CSelection(ret);
+        return CSelection(std::move(ret));
     } catch(const std::runtime_error &e) {
         std::cout << "***Query Parser Error***: " << e.what() << std::endl;
         return CSelection(NULL, true);
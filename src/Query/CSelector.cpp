@@ -35,11 +35,32 @@
  **********************************************************************************/
 
 #include <iostream>
+#include <string_view>
 
 #include "Query/CSelector.h"
 #include "Query/CQueryUtil.h"
 #include "Query/CNode.h"
 
+static const unsigned int SPECIFICITY_ID = 1 << 16;
+static const unsigned int SPECIFICITY_CLASS = 1 << 8;
+static const unsigned int SPECIFICITY_TYPE = 1;
+
+// adds each of the three counts on its own so one can not carry into the next
+static unsigned int addSpecificity(unsigned int a, unsigned int b)
+{
+    unsigned int ret = 0;
+    for (int shift = 0; shift <= 16; shift += 8)
+    {
+        unsigned int count = ((a >> shift) & 0xff) + ((b >> shift) & 0xff);
+        if (count > 0xff)
+        {
+            count = 0xff;
+        }
+        ret |= count << shift;
+    }
+    return ret;
+}
+
 bool CSelector::match(GumboNode* apNode)
 {
     switch (mOp)
@@ -202,10 +223,46 @@ bool CSelector::match(GumboNode* apNode)
     }
 }
 
-std::vector<GumboNode*> CSelector::filter(std::vector<GumboNode*> nodes)
+void CSelector::collectKeys(CSelectorKeys& aKeys, bool aSubject)
+{
+    if (mOp != ETag)
+    {
+        return;
+    }
+    if (aSubject)
+    {
+        aKeys.hasTag = true;
+        aKeys.tag = mTag;
+    }
+    else
+    {
+        aKeys.ancestors.push_back("t" + std::to_string(mTag));
+    }
+}
+
+unsigned int CSelector::specificity()
+{
+    switch (mOp)
+    {
+        case ETag:
+            return SPECIFICITY_TYPE;
+        case EEmpty:
+        case EOnlyChild:
+        case ENthChild:
+        case ERoot:
+        case ELang:
+            return SPECIFICITY_CLASS;
+        default:
+            // the universal selector, and the pseudo classes and
+            // pseudo elements that are parsed but never tested
+            return 0;
+    }
+}
+
+std::vector<GumboNode*> CSelector::filter(const std::vector<GumboNode*>& nodes)
 {
     std::vector<GumboNode*> ret;
-    for (std::vector<GumboNode*>::iterator it = nodes.begin(); it != nodes.end(); it++)
+    for (std::vector<GumboNode*>::const_iterator it = nodes.begin(); it != nodes.end(); it++)
     {
         GumboNode* n = *it;
         if (match(n))
@@ -223,6 +280,11 @@ std::vector<GumboNode*> CSelector::matchAll(GumboNode* apNode)
     return ret;
 }
 
+void CSelector::matchAll(GumboNode* apNode, std::vector<GumboNode*>& aNodes)
+{
+    matchAllInto(apNode, aNodes);
+}
+
 void CSelector::matchAllInto(GumboNode* apNode, std::vector<GumboNode*>& nodes)
 {
     if (match(apNode))
@@ -353,6 +415,41 @@ bool CBinarySelector::match(GumboNode* apNode)
     return false;
 }
 
+void CBinarySelector::collectKeys(CSelectorKeys& aKeys, bool aSubject)
+{
+    switch (mOp)
+    {
+        case EIntersection:
+            mpS1->collectKeys(aKeys, aSubject);
+            mpS2->collectKeys(aKeys, aSubject);
+            break;
+        case EChild:
+        case EDescendant:
+            // a parent is an ancestor too
+            mpS2->collectKeys(aKeys, aSubject);
+            mpS1->collectKeys(aKeys, false);
+            break;
+        case ESibling:
+            // the sibling itself has nothing to put in the index
+            mpS2->collectKeys(aKeys, aSubject);
+            break;
+        default:
+            // either side of a union may match so neither is required
+            break;
+    }
+}
+
+unsigned int CBinarySelector::specificity()
+{
+    unsigned int s1 = mpS1->specificity();
+    unsigned int s2 = mpS2->specificity();
+    if (mOp == EUnion)
+    {
+        return s1 > s2 ? s1 : s2;
+    }
+    return addSpecificity(s1, s2);
+}
+
 CAttributeSelector::CAttributeSelector(TOperator aOp, std::string aKey, std::string aValue)
 {
     mKey = aKey;
@@ -376,10 +473,12 @@ bool CAttributeSelector::match(GumboNode* apNode)
             continue;
         }
 
-        std::string value = attr->value;
+        // look at the value in place rather than copying it for every node
+        std::string_view value(attr->value);
         if (mKey == "class") {
             // right trim class values as trailing whitespace can not be part of a class name value
-            value.erase(value.find_last_not_of(" \n\r\t\f")+1);
+            size_t last = value.find_last_not_of(" \n\r\t\f");
+            value = value.substr(0, last == std::string_view::npos ? 0 : last + 1);
         }
         switch (mOp)
         {
@@ -398,7 +497,7 @@ bool CAttributeSelector::match(GumboNode* apNode)
                         {
                             length++;
                         }
-                        std::string segment = value.substr(j, length);
+                        std::string_view segment = value.substr(j, length);
                         if (segment == mValue)
                         {
                             return true;
@@ -412,7 +511,7 @@ bool CAttributeSelector::match(GumboNode* apNode)
                 {
                     return true;
                 }
-                if (value.size() < mValue.size())
+                if (value.size() <= mValue.size())
                 {
                     return false;
                 }
@@ -431,6 +530,46 @@ bool CAttributeSelector::match(GumboNode* apNode)
     return false;
 }
 
+void CAttributeSelector::collectKeys(CSelectorKeys& aKeys, bool aSubject)
+{
+    if (mValue.empty())
+    {
+        return;
+    }
+    if (mKey == "id" && mOp == EEquals)
+    {
+        if (aSubject)
+        {
+            aKeys.id = mValue;
+        }
+        else
+        {
+            aKeys.ancestors.push_back("#" + mValue);
+        }
+    }
+    else if (mKey == "class" && mOp == EIncludes)
+    {
+        if (aSubject)
+        {
+            aKeys.classes.push_back(mValue);
+        }
+        else
+        {
+            aKeys.ancestors.push_back("." + mValue);
+        }
+    }
+}
+
+// "[id=x]" is parsed the same way as "#x" so it counts as an id
+unsigned int CAttributeSelector::specificity()
+{
+    if (mKey == "id" && mOp == EEquals)
+    {
+        return SPECIFICITY_ID;
+    }
+    return SPECIFICITY_CLASS;
+}
+
 CUnarySelector::CUnarySelector(TOperator aOp, CSelector* apS)
 {
     mpS = apS;
@@ -501,6 +640,17 @@ bool CUnarySelector::match(GumboNode* apNode)
     }
 }
 
+// :not() and :has() count as their argument
+unsigned int CUnarySelector::specificity()
+{
+    return mpS->specificity();
+}
+
+unsigned int CTextSelector::specificity()
+{
+    return SPECIFICITY_CLASS;
+}
+
 bool CTextSelector::match(GumboNode* apNode)
 {
     std::string text;
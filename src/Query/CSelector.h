@@ -44,6 +44,25 @@
 #include <vector>
 #include "Query/CObject.h"
 
+// What an element must carry for a selector to have a chance of
+// matching it, used by CSelectorIndex to skip hopeless selectors.
+// Ancestor keys are "t" + tag number, "#" + id or "." + class.
+struct CSelectorKeys
+{
+    CSelectorKeys() : hasTag(false), tag(GumboTag(0)) {}
+
+    bool hasTag;
+
+    GumboTag tag;
+
+    std::string id;
+
+    std::vector<std::string> classes;
+
+    std::vector<std::string> ancestors;
+};
+
+
 class CSelector: public CObject
 {
 
@@ -114,10 +133,23 @@ class CSelector: public CObject
 
     virtual bool match(GumboNode* apNode);
 
-    std::vector<GumboNode*> filter(std::vector<GumboNode*> nodes);
+    // Adds the keys this selector needs on the element it matches, or on
+    // one of its ancestors when aSubject is false.  Only ever adds keys
+    // that are really required, so it is safe to add none.
+    virtual void collectKeys(CSelectorKeys& aKeys, bool aSubject);
+
+    // The cascade specificity of the selector packed as
+    // ids << 16 | classes << 8 | types, each count stops at 255.
+    // A union has the specificity of its most specific side.
+    virtual unsigned int specificity();
+
+    std::vector<GumboNode*> filter(const std::vector<GumboNode*>& nodes);
 
     std::vector<GumboNode*> matchAll(GumboNode* apNode);
 
+    // appends the matches to aNodes instead of returning a new vector
+    void matchAll(GumboNode* apNode, std::vector<GumboNode*>& aNodes);
+
  private:
 
     void init()
@@ -175,6 +207,8 @@ class CUnarySelector: public CSelector
 
     virtual bool match(GumboNode* apNode);
 
+    virtual unsigned int specificity();
+
  private:
 
     bool hasDescendantMatch(GumboNode* apNode, CSelector* apS);
@@ -221,6 +255,10 @@ class CBinarySelector: public CSelector
 
     virtual bool match(GumboNode* apNode);
 
+    virtual void collectKeys(CSelectorKeys& aKeys, bool aSubject);
+
+    virtual unsigned int specificity();
+
  private:
 
     CSelector* mpS1;
@@ -264,6 +302,10 @@ class CAttributeSelector: public CSelector
 
     virtual bool match(GumboNode* apNode);
 
+    virtual void collectKeys(CSelectorKeys& aKeys, bool aSubject);
+
+    virtual unsigned int specificity();
+
  private:
 
      std::string mKey;
@@ -303,6 +345,8 @@ class CTextSelector: public CSelector
 
      virtual bool match(GumboNode* apNode);
 
+     virtual unsigned int specificity();
+
  private:
 
     std::string mValue;
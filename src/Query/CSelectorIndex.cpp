@@ -0,0 +1,400 @@
+/**********************************************************************************
+ **
+ **  SigilQuery for Gumbo
+ **
+ **  A C++ library that provides jQuery-like selectors for Google's Gumbo-Parser.
+ **  Selector engine is an implementation based on cascadia.
+ **
+ **  Based on: "gumbo-query" https://github.com/lazytiger/gumbo-query
+ **  With bug fixes, extensions and improvements
+ **
+ **  The MIT License (MIT)
+ **  Copyright (c) 2021-2024 Kevin B. Hendricks, Stratford, Ontario Canada
+ **  Copyright (c) 2015 baimashi.com. 
+ **  Copyright (c) 2011 Andy Balholm. All rights reserved.
+ **
+ **
+ **  Permission is hereby granted, free of charge, to any person obtaining a copy
+ **  of this software and associated documentation files (the "Software"), to deal
+ **  in the Software without restriction, including without limitation the rights
+ **  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ **  copies of the Software, and to permit persons to whom the Software is
+ **  furnished to do so, subject to the following conditions:
+ **
+ **  The above copyright notice and this permission notice shall be included in
+ **  all copies or substantial portions of the Software.
+ **
+ **  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ **  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ **  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ **  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ **  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ **  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ **  THE SOFTWARE.
+ **
+ **********************************************************************************/
+
+#include <algorithm>
+#include <iostream>
+#include <functional>
+#include <stdexcept>
+
+#include "Query/CParser.h"
+#include "Query/CSelector.h"
+#include "Query/CSelectorIndex.h"
+
+// 4096 counters, each key sets two of them
+static const size_t BLOOM_BITS = 12;
+static const size_t BLOOM_MASK = (1 << BLOOM_BITS) - 1;
+
+CSelectorIndex::CSelectorIndex()
+{
+}
+
+CSelectorIndex::~CSelectorIndex()
+{
+    for (std::vector<Entry>::iterator it = mEntries.begin(); it != mEntries.end(); it++)
+    {
+        if (it->mpSelector != NULL)
+        {
+            it->mpSelector->release();
+        }
+    }
+}
+
+size_t CSelectorIndex::add(const std::string& aSelector)
+{
+    size_t pos = mEntries.size();
+    Entry entry;
+    entry.mpSelector = NULL;
+    entry.mError = false;
+    entry.mSpecificity = 0;
+    try {
+        entry.mpSelector = CParser::create(aSelector);
+    } catch(const std::runtime_error &e) {
+        std::cout << "***Query Parser Error***: " << e.what() << std::endl;
+        entry.mError = true;
+        mEntries.push_back(entry);
+        return pos;
+    }
+
+    entry.mSpecificity = entry.mpSelector->specificity();
+    CSelectorKeys keys;
+    entry.mpSelector->collectKeys(keys, true);
+    for (std::vector<std::string>::iterator it = keys.ancestors.begin(); it != keys.ancestors.end(); it++)
+    {
+        entry.mAncestorHashes.push_back(hashKey(*it));
+    }
+    mEntries.push_back(entry);
+
+    // an id is the rarest key, then a class, then the tag
+    if (!keys.id.empty())
+    {
+        mIds[keys.id].push_back(pos);
+    }
+    else if (!keys.classes.empty())
+    {
+        mClasses[keys.classes.front()].push_back(pos);
+    }
+    else if (keys.hasTag)
+    {
+        mTags[keys.tag].push_back(pos);
+    }
+    else
+    {
+        mUniversal.push_back(pos);
+    }
+    return pos;
+}
+
+std::vector<bool> CSelectorIndex::matchAny(GumboNode* apNode, const std::vector<bool>& aWanted) const
+{
+    MatchState state;
+    state.mFound.assign(mEntries.size(), false);
+    state.mBloom.assign(BLOOM_MASK + 1, 0);
+    state.mRemaining = 0;
+    // mark everything not looked for as already found so it is skipped
+    for (size_t i = 0; i < mEntries.size(); i++)
+    {
+        if (mEntries[i].mError || (!aWanted.empty() && (i >= aWanted.size() || !aWanted[i])))
+        {
+            state.mFound[i] = true;
+        }
+        else
+        {
+            state.mRemaining++;
+        }
+    }
+    if (apNode != NULL && state.mRemaining > 0)
+    {
+        matchNode(apNode, state);
+    }
+
+    std::vector<bool> ret(mEntries.size(), false);
+    for (size_t i = 0; i < mEntries.size(); i++)
+    {
+        bool wanted = !mEntries[i].mError && (aWanted.empty() || (i < aWanted.size() && aWanted[i]));
+        ret[i] = wanted && state.mFound[i];
+    }
+    return ret;
+}
+
+void CSelectorIndex::matchNode(GumboNode* apNode, MatchState& aState) const
+{
+    if (apNode->type != GUMBO_NODE_ELEMENT)
+    {
+        // only selectors without keys can match text and other nodes
+        testBucket(&mUniversal, apNode, aState);
+        return;
+    }
+
+    std::vector<std::string> keys;
+    elementKeys(apNode, keys);
+
+    GumboAttribute* id = gumbo_get_attribute(&apNode->v.element.attributes, "id");
+    if (id != NULL && id->value[0] != '\0')
+    {
+        std::unordered_map<std::string, std::vector<size_t> >::const_iterator it = mIds.find(id->value);
+        if (it != mIds.end())
+        {
+            testBucket(&it->second, apNode, aState);
+        }
+    }
+    for (std::vector<std::string>::iterator kt = keys.begin(); kt != keys.end(); kt++)
+    {
+        if ((*kt)[0] == '.')
+        {
+            std::unordered_map<std::string, std::vector<size_t> >::const_iterator it = mClasses.find(kt->substr(1));
+            if (it != mClasses.end())
+            {
+                testBucket(&it->second, apNode, aState);
+            }
+        }
+    }
+    std::unordered_map<int, std::vector<size_t> >::const_iterator tt = mTags.find(apNode->v.element.tag);
+    if (tt != mTags.end())
+    {
+        testBucket(&tt->second, apNode, aState);
+    }
+    testBucket(&mUniversal, apNode, aState);
+
+    if (aState.mRemaining == 0)
+    {
+        return;
+    }
+
+    // this element is an ancestor of everything below it
+    std::vector<size_t> hashes;
+    for (std::vector<std::string>::iterator kt = keys.begin(); kt != keys.end(); kt++)
+    {
+        size_t h = hashKey(*kt);
+        hashes.push_back(h);
+        aState.mBloom[h & BLOOM_MASK]++;
+        aState.mBloom[(h >> BLOOM_BITS) & BLOOM_MASK]++;
+    }
+    for (unsigned int i = 0; i < apNode->v.element.children.length && aState.mRemaining > 0; i++)
+    {
+        matchNode((GumboNode*) apNode->v.element.children.data[i], aState);
+    }
+    for (std::vector<size_t>::iterator ht = hashes.begin(); ht != hashes.end(); ht++)
+    {
+        aState.mBloom[*ht & BLOOM_MASK]--;
+        aState.mBloom[(*ht >> BLOOM_BITS) & BLOOM_MASK]--;
+    }
+}
+
+void CSelectorIndex::testBucket(const std::vector<size_t>* apBucket, GumboNode* apNode, MatchState& aState) const
+{
+    for (std::vector<size_t>::const_iterator it = apBucket->begin(); it != apBucket->end(); it++)
+    {
+        size_t i = *it;
+        if (aState.mFound[i])
+        {
+            continue;
+        }
+        const Entry& entry = mEntries[i];
+        bool possible = true;
+        for (std::vector<size_t>::const_iterator ht = entry.mAncestorHashes.begin(); ht != entry.mAncestorHashes.end(); ht++)
+        {
+            if (!mayContain(aState.mBloom, *ht))
+            {
+                possible = false;
+                break;
+            }
+        }
+        if (possible && entry.mpSelector->match(apNode))
+        {
+            aState.mFound[i] = true;
+            aState.mRemaining--;
+        }
+    }
+}
+
+std::vector<size_t> CSelectorIndex::matchElement(GumboNode* apNode, const std::vector<bool>& aWanted) const
+{
+    std::vector<size_t> matched;
+    if (apNode == NULL || apNode->type != GUMBO_NODE_ELEMENT)
+    {
+        return matched;
+    }
+    std::vector<unsigned short> bloom(BLOOM_MASK + 1, 0);
+    std::vector<std::string> keys;
+    for (GumboNode* parent = apNode->parent; parent != NULL; parent = parent->parent)
+    {
+        if (parent->type == GUMBO_NODE_ELEMENT)
+        {
+            keys.clear();
+            elementKeys(parent, keys);
+            addToBloom(keys, bloom, 1);
+        }
+    }
+    keys.clear();
+    elementKeys(apNode, keys);
+    collectElement(apNode, keys, bloom, aWanted, matched);
+    return matched;
+}
+
+std::vector<std::pair<GumboNode*, std::vector<size_t> > > CSelectorIndex::matchEach(GumboNode* apNode, const std::vector<bool>& aWanted) const
+{
+    std::vector<std::pair<GumboNode*, std::vector<size_t> > > matches;
+    if (apNode != NULL)
+    {
+        std::vector<unsigned short> bloom(BLOOM_MASK + 1, 0);
+        collectNode(apNode, bloom, aWanted, matches);
+    }
+    return matches;
+}
+
+void CSelectorIndex::collectNode(GumboNode* apNode, std::vector<unsigned short>& aBloom, const std::vector<bool>& aWanted,
+                                 std::vector<std::pair<GumboNode*, std::vector<size_t> > >& aMatches) const
+{
+    if (apNode->type != GUMBO_NODE_ELEMENT)
+    {
+        return;
+    }
+    std::vector<std::string> keys;
+    elementKeys(apNode, keys);
+    std::vector<size_t> matched;
+    collectElement(apNode, keys, aBloom, aWanted, matched);
+    if (!matched.empty())
+    {
+        aMatches.push_back(std::make_pair(apNode, matched));
+    }
+    addToBloom(keys, aBloom, 1);
+    for (unsigned int i = 0; i < apNode->v.element.children.length; i++)
+    {
+        collectNode((GumboNode*) apNode->v.element.children.data[i], aBloom, aWanted, aMatches);
+    }
+    addToBloom(keys, aBloom, -1);
+}
+
+// Looks in the same buckets as matchNode but keeps every match
+void CSelectorIndex::collectElement(GumboNode* apNode, const std::vector<std::string>& aKeys, const std::vector<unsigned short>& aBloom,
+                                    const std::vector<bool>& aWanted, std::vector<size_t>& aMatched) const
+{
+    GumboAttribute* id = gumbo_get_attribute(&apNode->v.element.attributes, "id");
+    if (id != NULL && id->value[0] != '\0')
+    {
+        std::unordered_map<std::string, std::vector<size_t> >::const_iterator it = mIds.find(id->value);
+        if (it != mIds.end())
+        {
+            collectBucket(&it->second, apNode, aBloom, aWanted, aMatched);
+        }
+    }
+    for (std::vector<std::string>::const_iterator kt = aKeys.begin(); kt != aKeys.end(); kt++)
+    {
+        if ((*kt)[0] == '.')
+        {
+            std::unordered_map<std::string, std::vector<size_t> >::const_iterator it = mClasses.find(kt->substr(1));
+            if (it != mClasses.end())
+            {
+                collectBucket(&it->second, apNode, aBloom, aWanted, aMatched);
+            }
+        }
+    }
+    std::unordered_map<int, std::vector<size_t> >::const_iterator tt = mTags.find(apNode->v.element.tag);
+    if (tt != mTags.end())
+    {
+        collectBucket(&tt->second, apNode, aBloom, aWanted, aMatched);
+    }
+    collectBucket(&mUniversal, apNode, aBloom, aWanted, aMatched);
+
+    // a class given twice looks in its bucket twice
+    std::sort(aMatched.begin(), aMatched.end());
+    aMatched.erase(std::unique(aMatched.begin(), aMatched.end()), aMatched.end());
+}
+
+void CSelectorIndex::collectBucket(const std::vector<size_t>* apBucket, GumboNode* apNode, const std::vector<unsigned short>& aBloom,
+                                   const std::vector<bool>& aWanted, std::vector<size_t>& aMatched) const
+{
+    for (std::vector<size_t>::const_iterator it = apBucket->begin(); it != apBucket->end(); it++)
+    {
+        size_t i = *it;
+        if (!aWanted.empty() && (i >= aWanted.size() || !aWanted[i]))
+        {
+            continue;
+        }
+        const Entry& entry = mEntries[i];
+        bool possible = true;
+        for (std::vector<size_t>::const_iterator ht = entry.mAncestorHashes.begin(); ht != entry.mAncestorHashes.end(); ht++)
+        {
+            if (!mayContain(aBloom, *ht))
+            {
+                possible = false;
+                break;
+            }
+        }
+        if (possible && entry.mpSelector->match(apNode))
+        {
+            aMatched.push_back(i);
+        }
+    }
+}
+
+void CSelectorIndex::addToBloom(const std::vector<std::string>& aKeys, std::vector<unsigned short>& aBloom, int aDelta) const
+{
+    for (std::vector<std::string>::const_iterator kt = aKeys.begin(); kt != aKeys.end(); kt++)
+    {
+        size_t h = hashKey(*kt);
+        aBloom[h & BLOOM_MASK] += aDelta;
+        aBloom[(h >> BLOOM_BITS) & BLOOM_MASK] += aDelta;
+    }
+}
+
+// The same keys CSelector::collectKeys produces for ancestors
+void CSelectorIndex::elementKeys(GumboNode* apNode, std::vector<std::string>& aKeys) const
+{
+    aKeys.push_back("t" + std::to_string(apNode->v.element.tag));
+    GumboAttribute* id = gumbo_get_attribute(&apNode->v.element.attributes, "id");
+    if (id != NULL && id->value[0] != '\0')
+    {
+        aKeys.push_back("#" + std::string(id->value));
+    }
+    GumboAttribute* cls = gumbo_get_attribute(&apNode->v.element.attributes, "class");
+    if (cls != NULL)
+    {
+        std::string value = cls->value;
+        const char* spaces = " \t\r\n\f";
+        size_t start = value.find_first_not_of(spaces);
+        while (start != std::string::npos)
+        {
+            size_t end = value.find_first_of(spaces, start);
+            if (end == std::string::npos)
+            {
+                end = value.size();
+            }
+            aKeys.push_back("." + value.substr(start, end - start));
+            start = value.find_first_not_of(spaces, end);
+        }
+    }
+}
+
+size_t CSelectorIndex::hashKey(const std::string& aKey)
+{
+    return std::hash<std::string>()(aKey);
+}
+
+bool CSelectorIndex::mayContain(const std::vector<unsigned short>& aBloom, size_t aHash)
+{
+    return aBloom[aHash & BLOOM_MASK] != 0 && aBloom[(aHash >> BLOOM_BITS) & BLOOM_MASK] != 0;
+}
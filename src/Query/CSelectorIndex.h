@@ -0,0 +1,158 @@
+/**********************************************************************************
+ **
+ **  SigilQuery for Gumbo
+ **
+ **  A C++ library that provides jQuery-like selectors for Google's Gumbo-Parser.
+ **  Selector engine is an implementation based on cascadia.
+ **
+ **  Based on: "gumbo-query" https://github.com/lazytiger/gumbo-query
+ **  With bug fixes, extensions and improvements
+ **
+ **  The MIT License (MIT)
+ **  Copyright (c) 2021-2024 Kevin B. Hendricks, Stratford, Ontario Canada
+ **  Copyright (c) 2015 baimashi.com. 
+ **  Copyright (c) 2011 Andy Balholm. All rights reserved.
+ **
+ **
+ **  Permission is hereby granted, free of charge, to any person obtaining a copy
+ **  of this software and associated documentation files (the "Software"), to deal
+ **  in the Software without restriction, including without limitation the rights
+ **  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ **  copies of the Software, and to permit persons to whom the Software is
+ **  furnished to do so, subject to the following conditions:
+ **
+ **  The above copyright notice and this permission notice shall be included in
+ **  all copies or substantial portions of the Software.
+ **
+ **  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ **  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ **  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ **  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ **  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ **  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ **  THE SOFTWARE.
+ **
+ **********************************************************************************/
+
+#ifndef CSELECTORINDEX_H_
+#define CSELECTORINDEX_H_
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "gumbo.h"
+#include "gumbo_edit.h"
+
+class CSelector;
+
+// Tests a large set of selectors against a document in a single walk.
+//
+// Every selector is parsed once, when it is added, and filed under the
+// id, class or tag its rightmost compound requires, so an element is only
+// matched against the selectors filed under its own id, classes and tag
+// plus those that require none of them.  The ids, classes and tags that
+// descendant and child combinators need on an ancestor are checked first
+// against a counting Bloom filter of the ancestors of the element.
+//
+// The index does not change while matching so one index can be shared
+// by threads matching different documents.
+class CSelectorIndex
+{
+
+ public:
+
+    CSelectorIndex();
+
+    virtual ~CSelectorIndex();
+
+ public:
+
+    // Returns the position of the selector in the index.  A selector
+    // that can not be parsed is kept, see parseError.
+    size_t add(const std::string& aSelector);
+
+    size_t size() const { return mEntries.size(); }
+
+    bool parseError(size_t i) const { return mEntries[i].mError; }
+
+    // See CSelector::specificity, 0 for a selector that failed to parse
+    unsigned int specificity(size_t i) const { return mEntries[i].mSpecificity; }
+
+    // Returns for every selector whether it matches apNode or one of its
+    // descendants.  Only the selectors set in aWanted are looked for, all
+    // of them if aWanted is empty.  Selectors that failed to parse are
+    // never reported as matching.
+    std::vector<bool> matchAny(GumboNode* apNode, const std::vector<bool>& aWanted = std::vector<bool>()) const;
+
+    // Returns the selectors that match the element apNode itself, in the
+    // order they were added.
+    std::vector<size_t> matchElement(GumboNode* apNode, const std::vector<bool>& aWanted = std::vector<bool>()) const;
+
+    // Returns every element at or below apNode that one of the selectors
+    // matches, in document order, each with the selectors that match it
+    // in the order they were added.
+    std::vector<std::pair<GumboNode*, std::vector<size_t> > > matchEach(GumboNode* apNode,
+                                                                      const std::vector<bool>& aWanted = std::vector<bool>()) const;
+
+ private:
+
+    struct Entry
+    {
+        CSelector* mpSelector;
+
+        bool mError;
+
+        unsigned int mSpecificity;
+
+        std::vector<size_t> mAncestorHashes;
+    };
+
+    struct MatchState
+    {
+        std::vector<bool> mFound;
+
+        std::vector<unsigned short> mBloom;
+
+        size_t mRemaining;
+    };
+
+    void matchNode(GumboNode* apNode, MatchState& aState) const;
+
+    void testBucket(const std::vector<size_t>* apBucket, GumboNode* apNode, MatchState& aState) const;
+
+    void collectNode(GumboNode* apNode, std::vector<unsigned short>& aBloom, const std::vector<bool>& aWanted,
+                     std::vector<std::pair<GumboNode*, std::vector<size_t> > >& aMatches) const;
+
+    void collectElement(GumboNode* apNode, const std::vector<std::string>& aKeys, const std::vector<unsigned short>& aBloom,
+                        const std::vector<bool>& aWanted, std::vector<size_t>& aMatched) const;
+
+    void collectBucket(const std::vector<size_t>* apBucket, GumboNode* apNode, const std::vector<unsigned short>& aBloom,
+                       const std::vector<bool>& aWanted, std::vector<size_t>& aMatched) const;
+
+    void addToBloom(const std::vector<std::string>& aKeys, std::vector<unsigned short>& aBloom, int aDelta) const;
+
+    void elementKeys(GumboNode* apNode, std::vector<std::string>& aKeys) const;
+
+    static size_t hashKey(const std::string& aKey);
+
+    static bool mayContain(const std::vector<unsigned short>& aBloom, size_t aHash);
+
+ private:
+
+    CSelectorIndex(const CSelectorIndex&);
+
+    CSelectorIndex& operator=(const CSelectorIndex&);
+
+    std::vector<Entry> mEntries;
+
+    std::unordered_map<std::string, std::vector<size_t> > mIds;
+
+    std::unordered_map<std::string, std::vector<size_t> > mClasses;
+
+    std::unordered_map<int, std::vector<size_t> > mTags;
+
+    std::vector<size_t> mUniversal;
+};
+
+#endif /* CSELECTORINDEX_H_ */
@@ -50,7 +50,8 @@ static const QString W3C_HTML_FORM = "<html>"
 
 CSSResource::CSSResource(const QString &mainfolder, const QString &fullfilepath, QObject *parent)
     : TextResource(mainfolder, fullfilepath, parent),
-      m_TemporaryValidationFiles(QList<QString>())
+      m_TemporaryValidationFiles(QList<QString>()),
+      m_CSSInfoRevision(0)
 {
 }
 
@@ -63,9 +64,9 @@ CSSResource::~CSSResource()
 
 bool CSSResource::DeleteCSStyles(QList<CSSInfo::CSSSelector *> css_selectors)
 {
-    CSSInfo css_info(GetText());
+    QSharedPointer<const CSSInfo> css_info = GetCSSInfo();
     // Search for selectors with the same definition and line and remove from text
-    const QString &new_resource_text = css_info.removeMatchingSelectors(css_selectors);
+    const QString &new_resource_text = css_info->removeMatchingSelectors(css_selectors);
 
     if (!new_resource_text.isNull()) {
         // At least one of the selector(s) was removed.
@@ -77,6 +78,29 @@ bool CSSResource::DeleteCSStyles(QList<CSSInfo::CSSSelector *> css_selectors)
     return false;
 }
 
+QSharedPointer<const CSSInfo> CSSResource::GetCSSInfo() const
+{
+    // Read the revision before the text so that the text used is
+    // never older than the revision the result is stored against
+    quint64 revision = GetRevision();
+    {
+        QMutexLocker locker(&m_CSSInfoMutex);
+        if (m_CSSInfo && (revision == m_CSSInfoRevision)) {
+            return m_CSSInfo;
+        }
+    }
+
+    QSharedPointer<const CSSInfo> css_info(new CSSInfo(GetText()));
+
+    QMutexLocker locker(&m_CSSInfoMutex);
+    if (!m_CSSInfo || (revision > m_CSSInfoRevision)) {
+        m_CSSInfo = css_info;
+        m_CSSInfoRevision = revision;
+    }
+    return css_info;
+}
+
+
 Resource::ResourceType CSSResource::Type() const
 {
     return Resource::CSSResourceType;
@@ -111,8 +135,7 @@ void CSSResource::ValidateStylesheetWithW3C()
 bool CSSResource::ReformatCSS(bool multiple_line_format)
 {
     QString original_text = GetText();
-    CSSInfo css_info(original_text);
-    const QString new_text = css_info.getReformattedCSSText(multiple_line_format);
+    const QString new_text = GetCSSInfo()->getReformattedCSSText(multiple_line_format);
 
     if (original_text != new_text) {
         SetText(new_text);
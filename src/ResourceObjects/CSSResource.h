@@ -27,6 +27,9 @@
 #ifndef CSSRESOURCE_H
 #define CSSRESOURCE_H
 
+#include <QtCore/QMutex>
+#include <QtCore/QSharedPointer>
+
 #include "Parsers/CSSInfo.h"
 #include "ResourceObjects/TextResource.h"
 
@@ -52,6 +55,16 @@ public:
 
     bool DeleteCSStyles(QList<CSSInfo::CSSSelector *> css_selectors);
 
+    /**
+     * Returns the parsed selectors and properties of the current text.
+     * The style sheet is only parsed again once its text has changed,
+     * and the result may be shared by any number of threads.  Callers
+     * must keep the pointer for as long as they use its selectors.
+     *
+     * @return The CSSInfo for the current revision of the text.
+     */
+    QSharedPointer<const CSSInfo> GetCSSInfo() const;
+
     bool ReformatCSS(bool multiple_line_format);
 
     // inherited
@@ -62,6 +75,13 @@ public:
 private:
 
     QList<QString> m_TemporaryValidationFiles;
+
+    /**
+     * The parse of the text at m_CSSInfoRevision.
+     */
+    mutable QSharedPointer<const CSSInfo> m_CSSInfo;
+    mutable quint64 m_CSSInfoRevision;
+    mutable QMutex m_CSSInfoMutex;
 };
 
 #endif // CSSRESOURCE_H
@@ -24,6 +24,7 @@
 
 #include <QFileInfo>
 #include <QString>
+#include <QUrl>
 // #include <QDebug>
 
 #include "BookManipulation/CleanSource.h"
@@ -53,7 +54,11 @@ HTMLResource::HTMLResource(const QString &mainfolder, const QString &fullfilepat
     XMLResource(mainfolder, fullfilepath, parent),
     m_Keeper(Keeper),
     m_LinkedBookPaths(QStringList()),
-    m_TOCCache("")
+    m_TOCCache(""),
+    m_ParsedFactsRevision(0),
+    m_HeadingsRevision(0),
+    m_HeadingsValid(false),
+    m_StyleInfoRevision(0)
 {
 }
 
@@ -88,6 +93,20 @@ void HTMLResource::SetText(const QString &text)
     TrackNewResources();
 }
 
+bool HTMLResource::SetTextIfRevision(const QString &text, quint64 revision)
+{
+    if (GetRevision() != revision) {
+        return false;
+    }
+    emit TextChanging();
+
+    if (!XMLResource::SetTextIfRevision(text, revision)) {
+        return false;
+    }
+    TrackNewResources();
+    return true;
+}
+
 QString HTMLResource::GetTOCCache()
 {
     if (m_TOCCache.isEmpty()) {
@@ -110,7 +129,7 @@ void HTMLResource::SaveToDisk(bool book_wide_save)
 
 QStringList HTMLResource::GetLinkedStylesheets()
 {
-    QStringList hreflist = XhtmlDoc::GetLinkedStylesheets(GetText());
+    QStringList hreflist = GetParsedFact(Fact_LinkedStylesheets);
     QString startdir = GetFolder();
     QStringList stylesheet_bookpaths;
     foreach(QString ahref, hreflist) {
@@ -125,7 +144,7 @@ QStringList HTMLResource::GetLinkedStylesheets()
 
 QStringList HTMLResource::GetLinkedJavascripts()
 {
-    QStringList srclist = XhtmlDoc::GetLinkedJavascripts(GetText());
+    QStringList srclist = GetParsedFact(Fact_LinkedJavascripts);
     QString startdir = GetFolder();
     QStringList javascript_bookpaths;
     foreach(QString src, srclist) {
@@ -142,10 +161,7 @@ QStringList HTMLResource::GetManifestProperties() const
 {
     QStringList properties;
     QReadLocker locker(&GetLock());
-    GumboInterface gi = GumboInterface(GetText(), GetEpubVersion());
-    gi.parse();
-    QStringList props = gi.get_all_properties();
-    props.removeDuplicates();
+    QStringList props = GetParsedFact(Fact_ManifestProperties);
     if (props.contains("math")) properties.append("mathml");
     if (props.contains("svg")) properties.append("svg");
     // nav as a property should only be used on the nav document and no where else
@@ -157,9 +173,139 @@ QStringList HTMLResource::GetManifestProperties() const
 }
 
 
-QStringList HTMLResource::SplitOnSGFSectionMarkers()
+QStringList HTMLResource::GetParsedFact(ParsedFact fact) const
 {
-    QStringList sections = XhtmlDoc::GetSGFSectionSplits(GetText());
+    // Read the revision before the text so that the text used is
+    // never older than the revision the result is stored against
+    quint64 revision = GetRevision();
+    {
+        QMutexLocker locker(&m_ParsedFactsMutex);
+        if (revision != m_ParsedFactsRevision) {
+            m_ParsedFacts.clear();
+            m_ParsedFactsRevision = revision;
+        }
+        if (m_ParsedFacts.contains(fact)) {
+            return m_ParsedFacts.value(fact);
+        }
+    }
+
+    QStringList values;
+    QString source = GetText();
+    switch (fact) {
+        case Fact_Ids:
+            values = XhtmlDoc::GetAllDescendantIDs(source);
+            break;
+        case Fact_Hrefs:
+            values = XhtmlDoc::GetAllDescendantHrefs(source);
+            break;
+        case Fact_Classes:
+            values = XhtmlDoc::GetAllDescendantClasses(source);
+            break;
+        case Fact_StyleUrls:
+            values = XhtmlDoc::GetAllDescendantStyleUrls(source);
+            break;
+        case Fact_LinkedStylesheets:
+            values = XhtmlDoc::GetLinkedStylesheets(source);
+            break;
+        case Fact_LinkedJavascripts:
+            values = XhtmlDoc::GetLinkedJavascripts(source);
+            break;
+        case Fact_ImagePaths:
+            values = XhtmlDoc::GetAllMediaPathsFromMediaChildren(source, GIMAGE_TAGS);
+            break;
+        case Fact_VideoPaths:
+            values = XhtmlDoc::GetAllMediaPathsFromMediaChildren(source, GVIDEO_TAGS);
+            break;
+        case Fact_AudioPaths:
+            values = XhtmlDoc::GetAllMediaPathsFromMediaChildren(source, GAUDIO_TAGS);
+            break;
+        case Fact_MediaPaths:
+            values = XhtmlDoc::GetAllMediaPathsFromMediaChildren(source, GIMAGE_TAGS + GVIDEO_TAGS + GAUDIO_TAGS);
+            break;
+        case Fact_ManifestProperties: {
+            GumboInterface gi = GumboInterface(source, GetEpubVersion());
+            gi.parse();
+            values = gi.get_all_properties();
+            values.removeDuplicates();
+            break;
+        }
+        case Fact_LinkTargets: {
+            GumboInterface gi = GumboInterface(source, GetEpubVersion());
+            gi.parse();
+            values = gi.get_all_link_targets();
+            values.removeDuplicates();
+            break;
+        }
+        case Fact_RelativeAnchorHrefs: {
+            GumboInterface gi = GumboInterface(source, GetEpubVersion());
+            gi.parse();
+            foreach(GumboNode *node, gi.get_all_nodes_with_tag(GUMBO_TAG_A)) {
+                GumboAttribute *attr = gumbo_get_attribute(&node->v.element.attributes, "href");
+                if (attr) {
+                    QString href = QString::fromUtf8(attr->value);
+                    if (QUrl(href).isRelative()) {
+                        values.append(href);
+                    }
+                }
+            }
+            break;
+        }
+    }
+
+    QMutexLocker locker(&m_ParsedFactsMutex);
+    if (revision == m_ParsedFactsRevision) {
+        m_ParsedFacts.insert(fact, values);
+    }
+    return values;
+}
+
+
+QList<Headings::Heading> HTMLResource::GetHeadings()
+{
+    quint64 revision = GetRevision();
+    {
+        QMutexLocker locker(&m_ParsedFactsMutex);
+        if (m_HeadingsValid && (revision == m_HeadingsRevision)) {
+            return m_Headings;
+        }
+    }
+
+    QList<Headings::Heading> headings = Headings::ParseHeadings(this, GetText());
+
+    QMutexLocker locker(&m_ParsedFactsMutex);
+    if (!m_HeadingsValid || (revision > m_HeadingsRevision)) {
+        m_Headings = headings;
+        m_HeadingsRevision = revision;
+        m_HeadingsValid = true;
+    }
+    return headings;
+}
+
+
+QSharedPointer<const HTMLStyleInfo> HTMLResource::GetStyleInfo() const
+{
+    quint64 revision = GetRevision();
+    {
+        QMutexLocker locker(&m_ParsedFactsMutex);
+        if (m_StyleInfo && (revision == m_StyleInfoRevision)) {
+            return m_StyleInfo;
+        }
+    }
+
+    QSharedPointer<const HTMLStyleInfo> style_info(new HTMLStyleInfo(GetText()));
+
+    QMutexLocker locker(&m_ParsedFactsMutex);
+    if (!m_StyleInfo || (revision > m_StyleInfoRevision)) {
+        m_StyleInfo = style_info;
+        m_StyleInfoRevision = revision;
+    }
+    return style_info;
+}
+
+
+QStringList HTMLResource::SplitOnSGFSectionMarkers(QList<QStringList> *section_ids)
+{
+    QStringList sections = XhtmlDoc::GetSGFSectionSplits(GetText(), QString(), section_ids);
     SetText(CleanSource::Mend(sections.takeFirst(),GetEpubVersion()));
     return sections;
 }
@@ -232,72 +378,69 @@ QString HTMLResource::GetLanguageAttribute()
 
 void HTMLResource::SetLanguageAttribute(const QString& langcode)
 {
-    QString lc(langcode);
     QString version = GetEpubVersion();
     GumboInterface gi = GumboInterface(GetText(),version);
     gi.parse();
+    if (SetLanguageInTree(gi, version, langcode)) {
+        SetText(gi.getxhtml());
+    }
+}
+
+
+// returns true if the attribute did not already have this value
+static bool SetElementAttribute(GumboElement* element, const char* name, const QString& value)
+{
+    QByteArray utf8 = value.toUtf8();
+    GumboAttribute* attr = gumbo_get_attribute(&element->attributes, name);
+    if (attr) {
+        if (utf8 == attr->value) return false;
+        // already exists so change its value
+        gumbo_attribute_set_value(attr, utf8.constData());
+    } else {
+        // doesn't exist yet so add it
+        gumbo_element_set_attribute(element, name, utf8.constData());
+    }
+    return true;
+}
+
+
+static bool RemoveElementAttribute(GumboElement* element, const char* name)
+{
+    GumboAttribute* attr = gumbo_get_attribute(&element->attributes, name);
+    if (!attr) return false;
+    gumbo_element_remove_attribute(element, attr);
+    return true;
+}
+
+
+bool HTMLResource::SetLanguageInTree(GumboInterface& gi, const QString& version, const QString& langcode)
+{
     QList<GumboNode*> htmltags = gi.get_all_nodes_with_tag(GUMBO_TAG_HTML);
-    if (htmltags.count() != 1) return;
-    GumboNode* node = htmltags.at(0);
-    if (lc.isEmpty()) {
+    if (htmltags.count() != 1) return false;
+    GumboElement* element = &htmltags.at(0)->v.element;
+    bool changed = false;
+    if (langcode.isEmpty()) {
         // remove any xml:lang or lang attributes on the html node
-        GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, "lang");
-        GumboElement* element = &node->v.element;
-        if (attr) {
-            gumbo_element_remove_attribute(element, attr);
-        }
-        attr = gumbo_get_attribute(&node->v.element.attributes, "xml:lang");
-        if (attr) {
-            gumbo_element_remove_attribute(element, attr);
-        }
+        changed |= RemoveElementAttribute(element, "lang");
+        changed |= RemoveElementAttribute(element, "xml:lang");
         // remove any dir attribute as well
-        attr = gumbo_get_attribute(&node->v.element.attributes, "dir");
-        if (attr) {
-            gumbo_element_remove_attribute(element, attr);
-        }
-        SetText(gi.getxhtml());
-        return;
+        changed |= RemoveElementAttribute(element, "dir");
+        return changed;
     }
     // we are adding or changing existing lang xml:lang attributes
-    QString sc(lc);
+    QString sc(langcode);
     if (sc.length() > 3) sc=sc.mid(0,2);
     if (version.startsWith("3")) {
         // set the lang attribute (is not valid by spec on epub2 no matter what epubcheck says)
-        GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, "lang");
-        GumboElement* element = &node->v.element;
-        if (attr) {
-            // already exists so change its value
-            gumbo_attribute_set_value(attr, lc.toUtf8().constData());
-        } else {
-            // doesn't exist yet so add it
-            gumbo_element_set_attribute(element, "lang", lc.toUtf8().constData());
-        }
+        changed |= SetElementAttribute(element, "lang", langcode);
     }
     // set the xml:lang attribute on both epub2 and epub3
-    {
-        GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, "xml:lang");
-        GumboElement* element = &node->v.element;
-        if (attr) {
-            // already exists so change its value
-            gumbo_attribute_set_value(attr, lc.toUtf8().constData());
-        } else {
-            // doesn't exist yet so add it
-            gumbo_element_set_attribute(element, "xml:lang", lc.toUtf8().constData());
-        }
-    }
+    changed |= SetElementAttribute(element, "xml:lang", langcode);
     // set the dir attribute only if RTL language code
     if (RTL_LC.contains(sc)){
-        GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, "dir");
-        GumboElement* element = &node->v.element;
-        if (attr) {
-            // already exists so change its value
-            gumbo_attribute_set_value(attr, "rtl");
-        } else {
-            // doesn't exist yet so add it
-            gumbo_element_set_attribute(element, "dir", "rtl");
-        }
+        changed |= SetElementAttribute(element, "dir", "rtl");
     }
-    SetText(gi.getxhtml());
+    return changed;
 }
 
 
@@ -327,9 +470,9 @@ void HTMLResource::TrackNewResources()
 
 bool HTMLResource::DeleteCSStyles(QList<CSSInfo::CSSSelector *> css_selectors)
 {
-    HTMLStyleInfo htmlcss_info(GetText());
+    QSharedPointer<const HTMLStyleInfo> htmlcss_info = GetStyleInfo();
     // Search for selectors with the same definition and line and remove from text
-    const QString &new_resource_text = htmlcss_info.removeMatchingSelectors(css_selectors);
+    const QString &new_resource_text = htmlcss_info->removeMatchingSelectors(css_selectors);
 
     if (!new_resource_text.isNull()) {
         // At least one of the selector(s) was removed.
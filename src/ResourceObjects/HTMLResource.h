@@ -25,12 +25,17 @@
 #define HTMLRESOURCE_H
 
 #include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QSharedPointer>
 
+#include "BookManipulation/Headings.h"
 #include "Parsers/CSSInfo.h"
+#include "Parsers/HTMLStyleInfo.h"
 #include "ResourceObjects/XMLResource.h"
 
 class QString;
 class FolderKeeper;
+class GumboInterface;
 
 /**
  * Represents an HTML file of the book.
@@ -45,6 +50,28 @@ class HTMLResource : public XMLResource
 
 public:
 
+    /**
+     * The lists that can be pulled out of a parse of the text
+     * and kept until the text changes.  The hrefs are exactly
+     * as found in the text, not converted to book paths.
+     * Fact_RelativeAnchorHrefs is the relative hrefs of a tags only.
+     */
+    enum ParsedFact {
+        Fact_Ids = 0,
+        Fact_Hrefs,
+        Fact_Classes,
+        Fact_StyleUrls,
+        Fact_LinkedStylesheets,
+        Fact_LinkedJavascripts,
+        Fact_ImagePaths,
+        Fact_VideoPaths,
+        Fact_AudioPaths,
+        Fact_MediaPaths,
+        Fact_ManifestProperties,
+        Fact_LinkTargets,
+        Fact_RelativeAnchorHrefs
+    };
+
     /**
      * Constructor.
      *
@@ -66,6 +93,8 @@ public:
 
     virtual void SetText(const QString &text);
 
+    virtual bool SetTextIfRevision(const QString &text, quint64 revision);
+
     virtual bool LoadFromDisk();
 
     void SaveToDisk(bool book_wide_save = false);
@@ -76,9 +105,11 @@ public:
      * The first section is set as the content of the resource,
      * and the others are returned.
      *
+     * @param section_ids If given, filled with the ids each section
+     *                    holds, starting with the first section.
      * @return The content of all the sections except the first.
      */
-    QStringList SplitOnSGFSectionMarkers();
+    QStringList SplitOnSGFSectionMarkers(QList<QStringList> *section_ids = NULL);
 
     /**
      * Returns the paths to all the linked resources
@@ -104,6 +135,43 @@ public:
     QString GetLanguageAttribute();
     void SetLanguageAttribute(const QString& langcode);
 
+    /**
+     * Sets the lang, xml:lang and dir attributes of the html element
+     * in an already parsed file to match langcode, or removes them
+     * when langcode is empty.
+     *
+     * @return True if any attribute was added, changed or removed.
+     */
+    static bool SetLanguageInTree(GumboInterface& gi, const QString& version, const QString& langcode);
+
+    /**
+     * Returns the requested list for the current text.  The text is
+     * only parsed the first time a fact is asked for after it changes.
+     * Safe to call from the worker threads of the Book mapped helpers.
+     *
+     * @param fact The list wanted.
+     * @return The list for the current revision of the text.
+     */
+    QStringList GetParsedFact(ParsedFact fact) const;
+
+    /**
+     * Returns every heading in the current text, including the ones
+     * marked as not wanted in the TOC.  Like GetParsedFact the text is
+     * only parsed again once it has changed, and it is safe to call
+     * from worker threads.
+     *
+     * @return The headings for the current revision of the text.
+     */
+    QList<Headings::Heading> GetHeadings();
+
+    /**
+     * Returns the parsed inline style blocks of the current text.
+     * Like GetParsedFact they are only parsed again once the text has
+     * changed, and the result may be shared across threads.
+     *
+     * @return The HTMLStyleInfo for the current revision of the text.
+     */
+    QSharedPointer<const HTMLStyleInfo> GetStyleInfo() const;
 
 
 signals:
@@ -127,6 +195,28 @@ private:
     QStringList m_LinkedBookPaths;
 
     QString m_TOCCache;
+
+    /**
+     * Lists already pulled from the text at m_ParsedFactsRevision.
+     */
+    mutable QHash<int, QStringList> m_ParsedFacts;
+    mutable quint64 m_ParsedFactsRevision;
+    mutable QMutex m_ParsedFactsMutex;
+
+    /**
+     * The headings found in the text at m_HeadingsRevision,
+     * guarded by m_ParsedFactsMutex.
+     */
+    QList<Headings::Heading> m_Headings;
+    quint64 m_HeadingsRevision;
+    bool m_HeadingsValid;
+
+    /**
+     * The inline styles of the text at m_StyleInfoRevision,
+     * guarded by m_ParsedFactsMutex.
+     */
+    mutable QSharedPointer<const HTMLStyleInfo> m_StyleInfo;
+    mutable quint64 m_StyleInfoRevision;
 };
 
 #endif // HTMLRESOURCE_H
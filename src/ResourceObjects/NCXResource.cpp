@@ -28,6 +28,7 @@
 #include "BookManipulation/CleanSource.h"
 #include "Exporters/NCXWriter.h"
 #include "ResourceObjects/NCXResource.h"
+#include "ResourceObjects/NavProcessor.h"
 #include "Misc/SettingsStore.h"
 #include "Misc/Utility.h"
 #include "sigil_constants.h"
@@ -160,6 +161,19 @@ void NCXResource::GenerateNCXFromTOCEntries(const Book *book, TOCModel::TOCEntry
     SetText(CleanSource::ProcessXML(QString::fromUtf8(raw_ncx.constData(), raw_ncx.size()), "application/x-dtbncx+xml"));
 }
 
+void NCXResource::GenerateNCXFromNav(const Book *book, HTMLResource *nav_resource)
+{
+    NavProcessor navproc(nav_resource);
+    QByteArray raw_ncx;
+    QBuffer buffer(&raw_ncx);
+    buffer.open(QIODevice::WriteOnly);
+    NCXWriter ncx(book, buffer, navproc.GetRootTOCEntry());
+    ncx.SetPageList(navproc.GetPageListBookPaths());
+    ncx.WriteXML();
+    buffer.close();
+    SetText(CleanSource::ProcessXML(QString::fromUtf8(raw_ncx.constData(), raw_ncx.size()), "application/x-dtbncx+xml"));
+}
+
 
 void NCXResource::FillWithDefaultText(const QString &version, const QString &default_text_folder)
 {
@@ -38,8 +38,29 @@ static const QString NAV_PAGELIST_PATTERN = "\\s*<!--\\s*SIGIL_REPLACE_PAGELIST_
 static const QString NAV_LANDMARKS_PATTERN = "\\s*<!--\\s*SIGIL_REPLACE_LANDMARKS_HERE\\s*-->\\s*";
 static const QString NAV_TOC_PATTERN = "\\s*<!--\\s*SIGIL_REPLACE_TOC_HERE\\s*-->\\s*";
 
+// The nav sections in the order they are replaced
+static const QStringList NAV_SECTION_TYPES = QStringList() << "toc" << "landmarks" << "page-list";
+
+static QString NavPlaceholderName(const QString & etype)
+{
+    if (etype == "toc") return "SIGIL_REPLACE_TOC_HERE";
+    if (etype == "landmarks") return "SIGIL_REPLACE_LANDMARKS_HERE";
+    return "SIGIL_REPLACE_PAGELIST_HERE";
+}
+
+static QString NavPlaceholderPattern(const QString & etype)
+{
+    if (etype == "toc") return NAV_TOC_PATTERN;
+    if (etype == "landmarks") return NAV_LANDMARKS_PATTERN;
+    return NAV_PAGELIST_PATTERN;
+}
+
 NavProcessor::NavProcessor(HTMLResource * nav_resource)
-  : m_NavResource(nav_resource)
+  : m_NavResource(nav_resource),
+    m_Editing(false),
+    m_HasEditTOC(false),
+    m_HasEditLandmarks(false),
+    m_HasEditPageList(false)
 {
     QReadLocker locker(&m_NavResource->GetLock());
     QString source = m_NavResource->GetText();
@@ -91,6 +112,7 @@ NavProcessor::NavProcessor(HTMLResource * nav_resource)
 
 NavProcessor::~NavProcessor()
 {
+    CommitEdit();
 }
 
 
@@ -98,6 +120,7 @@ QList<NavLandmarkEntry> NavProcessor::GetLandmarks()
 {
     QList<NavLandmarkEntry> landlist;
     if (!m_NavResource) return landlist; 
+    if (m_Editing && m_HasEditLandmarks) return m_EditLandmarks;
 
     QReadLocker locker(&m_NavResource->GetLock());
     QString source = m_NavResource->GetText();
@@ -144,6 +167,7 @@ QList<NavPageListEntry> NavProcessor::GetPageList()
 {
     QList<NavPageListEntry> pagelist;
     if (!m_NavResource) return pagelist; 
+    if (m_Editing && m_HasEditPageList) return m_EditPageList;
         
     QReadLocker locker(&m_NavResource->GetLock());
     QString source = m_NavResource->GetText();
@@ -184,10 +208,21 @@ QList<NavPageListEntry> NavProcessor::GetPageList()
 }
 
 
+QList<NavPageListEntry> NavProcessor::GetPageListBookPaths()
+{
+    QList<NavPageListEntry> pagelist = GetPageList();
+    for (int i = 0; i < pagelist.count(); ++i) {
+        pagelist[i].href = ConvertHREFToBookPath(pagelist.at(i).href);
+    }
+    return pagelist;
+}
+
+
 QList<NavTOCEntry> NavProcessor::GetTOC()
 {
     QList<NavTOCEntry> toclist;
     if (!m_NavResource) return toclist; 
+    if (m_Editing && m_HasEditTOC) return m_EditTOC;
         
     QReadLocker locker(&m_NavResource->GetLock());
     QString source = m_NavResource->GetText();
@@ -362,43 +397,16 @@ QString NavProcessor::BuildPageList(const QList<NavPageListEntry> & pagelist)
 void NavProcessor::SetPageList(const QList<NavPageListEntry> & pagelist)
 {
     if (!m_NavResource) return; 
-        
-    bool found_pagelist = false;
-    // QWriteLocker locker(&m_NavResource->GetLock());
-    GumboInterface gi = GumboInterface(m_NavResource->GetText(), "3.0");
-    gi.parse();
-    QList<GumboNode*> nav_nodes = gi.get_all_nodes_with_tag(GUMBO_TAG_NAV);
-    for (int i = 0; i < nav_nodes.length(); ++i) {
-        GumboNode* node = nav_nodes.at(i);
-        GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, "epub:type");
-        if (attr && (QString::fromUtf8(attr->value) == "page-list")) {
-            found_pagelist = true;
-            GumboNode* parent = node->parent;
-            unsigned int index_within_parent = node->index_within_parent;
-            gumbo_remove_from_parent(node);
-            gumbo_destroy_node(node);
-            GumboNode * placeholder = gumbo_create_text_node(GUMBO_NODE_COMMENT,"SIGIL_REPLACE_PAGELIST_HERE");
-            gumbo_insert_node(placeholder, parent, index_within_parent);
-            break;
-        }
-    }
-    if (!found_pagelist) {
-        QList<GumboNode*> body_nodes = gi.get_all_nodes_with_tag(GUMBO_TAG_BODY);
-        if (body_nodes.length() == 1) {
-            GumboNode* body = body_nodes.at(0);
-            GumboNode * placeholder = gumbo_create_text_node(GUMBO_NODE_COMMENT,"SIGIL_REPLACE_PAGELIST_HERE");
-            gumbo_append_node(body, placeholder);
-        }
-    }
-    QString nav_data = gi.getxhtml();
-    QString page_xml = BuildPageList(pagelist);
-    QRegularExpression pagelist_placeholder(NAV_PAGELIST_PATTERN, 
-                       QRegularExpression::MultilineOption | QRegularExpression::DotMatchesEverythingOption);
-    QRegularExpressionMatch mo = pagelist_placeholder.match(nav_data);
-    if (mo.hasMatch()) {
-        nav_data.replace(mo.capturedStart(), mo.capturedLength(), page_xml);
+
+    if (m_Editing) {
+        m_EditPageList = pagelist;
+        m_HasEditPageList = true;
+        return;
     }
-    m_NavResource->SetText(nav_data);
+    // QWriteLocker locker(&m_NavResource->GetLock());
+    QHash<QString, QString> sections;
+    sections["page-list"] = BuildPageList(pagelist);
+    ReplaceNavSections(sections);
 }
 
 
@@ -406,86 +414,117 @@ void NavProcessor::SetLandmarks(const QList<NavLandmarkEntry> & landlist)
 {
     if (!m_NavResource) return; 
 
-    bool found_landmarks = false;
+    if (m_Editing) {
+        m_EditLandmarks = landlist;
+        m_HasEditLandmarks = true;
+        return;
+    }
     // QWriteLocker locker(&m_NavResource->GetLock());
+    QHash<QString, QString> sections;
+    sections["landmarks"] = BuildLandmarks(landlist);
+    ReplaceNavSections(sections);
+}
+
+
+void NavProcessor::SetTOC(const QList<NavTOCEntry> & toclist)
+{
+    if (!m_NavResource) return; 
+
+    if (m_Editing) {
+        m_EditTOC = toclist;
+        m_HasEditTOC = true;
+        return;
+    }
+    // QWriteLocker locker(&m_NavResource->GetLock());
+    QHash<QString, QString> sections;
+    sections["toc"] = BuildTOC(toclist);
+    ReplaceNavSections(sections);
+}
+
+
+// Swaps each nav section named by its epub:type for a placeholder
+// comment in a single parse of the nav, then swaps the placeholders
+// for the new xml after a single serialization.
+// Caller must hold the write lock on the nav resource.
+void NavProcessor::ReplaceNavSections(const QHash<QString, QString> & sections)
+{
+    if (!m_NavResource || sections.isEmpty()) return;
+
     GumboInterface gi = GumboInterface(m_NavResource->GetText(), "3.0");
     gi.parse();
-    const QList<GumboNode*> nav_nodes = gi.get_all_nodes_with_tag(GUMBO_TAG_NAV);
-    for (int i = 0; i < nav_nodes.length(); ++i) {
-        GumboNode* node = nav_nodes.at(i);
-        GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, "epub:type");
-        if (attr && (QString::fromUtf8(attr->value) == "landmarks")) {
-            found_landmarks = true;
-            GumboNode * parent = node->parent;
-            unsigned int index_within_parent = node->index_within_parent;
-            gumbo_remove_from_parent(node);
-            gumbo_destroy_node(node);
-            GumboNode * placeholder = gumbo_create_text_node(GUMBO_NODE_COMMENT,"SIGIL_REPLACE_LANDMARKS_HERE");
-            gumbo_insert_node(placeholder, parent, index_within_parent);
-            break;
+    foreach(const QString & etype, NAV_SECTION_TYPES) {
+        if (!sections.contains(etype)) continue;
+        QByteArray placeholder_name = NavPlaceholderName(etype).toUtf8();
+        bool found_section = false;
+        const QList<GumboNode*> nav_nodes = gi.get_all_nodes_with_tag(GUMBO_TAG_NAV);
+        for (int i = 0; i < nav_nodes.length(); ++i) {
+            GumboNode* node = nav_nodes.at(i);
+            GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, "epub:type");
+            if (attr && (QString::fromUtf8(attr->value) == etype)) {
+                found_section = true;
+                GumboNode * parent = node->parent;
+                unsigned int index_within_parent = node->index_within_parent;
+                gumbo_remove_from_parent(node);
+                gumbo_destroy_node(node);
+                GumboNode * placeholder = gumbo_create_text_node(GUMBO_NODE_COMMENT, placeholder_name.constData());
+                gumbo_insert_node(placeholder, parent, index_within_parent);
+                break;
+            }
         }
-    }
-    if (!found_landmarks) {
-        QList<GumboNode*> body_nodes = gi.get_all_nodes_with_tag(GUMBO_TAG_BODY);
-        if (body_nodes.length() == 1) {
-            GumboNode* body = body_nodes.at(0);
-            GumboNode * placeholder = gumbo_create_text_node(GUMBO_NODE_COMMENT,"SIGIL_REPLACE_LANDMARKS_HERE");
-            gumbo_append_node(body, placeholder);
+        if (!found_section) {
+            QList<GumboNode*> body_nodes = gi.get_all_nodes_with_tag(GUMBO_TAG_BODY);
+            if (body_nodes.length() == 1) {
+                GumboNode* body = body_nodes.at(0);
+                GumboNode * placeholder = gumbo_create_text_node(GUMBO_NODE_COMMENT, placeholder_name.constData());
+                gumbo_append_node(body, placeholder);
+            }
         }
     }
     QString nav_data = gi.getxhtml();
-    QString land_xml = BuildLandmarks(landlist);
-    QRegularExpression landmarks_placeholder(NAV_LANDMARKS_PATTERN,
-                       QRegularExpression::MultilineOption | QRegularExpression::DotMatchesEverythingOption);
-    QRegularExpressionMatch mo = landmarks_placeholder.match(nav_data);
-    if (mo.hasMatch()) {
-        nav_data.replace(mo.capturedStart(), mo.capturedLength(), land_xml);
+    foreach(const QString & etype, NAV_SECTION_TYPES) {
+        if (!sections.contains(etype)) continue;
+        QRegularExpression section_placeholder(NavPlaceholderPattern(etype),
+                           QRegularExpression::MultilineOption | QRegularExpression::DotMatchesEverythingOption);
+        QRegularExpressionMatch mo = section_placeholder.match(nav_data);
+        if (mo.hasMatch()) {
+            nav_data.replace(mo.capturedStart(), mo.capturedLength(), sections.value(etype));
+        }
     }
     m_NavResource->SetText(nav_data);
 }
 
 
+void NavProcessor::BeginEdit()
+{
+    m_Editing = true;
+}
 
-void NavProcessor::SetTOC(const QList<NavTOCEntry> & toclist)
+
+void NavProcessor::CommitEdit()
 {
-    if (!m_NavResource) return; 
+    if (!m_Editing) return;
+    m_Editing = false;
 
-    bool found_toc = false;
-    // QWriteLocker locker(&m_NavResource->GetLock());
-    GumboInterface gi = GumboInterface(m_NavResource->GetText(), "3.0");
-    gi.parse();
-    const QList<GumboNode*> nav_nodes = gi.get_all_nodes_with_tag(GUMBO_TAG_NAV);
-    for (int i = 0; i < nav_nodes.length(); ++i) {
-        GumboNode* node = nav_nodes.at(i);
-        GumboAttribute* attr = gumbo_get_attribute(&node->v.element.attributes, "epub:type");
-        if (attr && (QString::fromUtf8(attr->value) == "toc")) {
-            found_toc = true;
-            GumboNode * parent = node->parent;
-            unsigned int index_within_parent = node->index_within_parent;
-            gumbo_remove_from_parent(node);
-            gumbo_destroy_node(node);
-            GumboNode * placeholder = gumbo_create_text_node(GUMBO_NODE_COMMENT,"SIGIL_REPLACE_TOC_HERE");
-            gumbo_insert_node(placeholder, parent, index_within_parent);
-            break;
-        }
+    QHash<QString, QString> sections;
+    if (m_HasEditTOC) {
+        sections["toc"] = BuildTOC(m_EditTOC);
     }
-    if (!found_toc) {
-        QList<GumboNode*> body_nodes = gi.get_all_nodes_with_tag(GUMBO_TAG_BODY);
-        if (body_nodes.length() == 1) {
-            GumboNode* body = body_nodes.at(0);
-            GumboNode * placeholder = gumbo_create_text_node(GUMBO_NODE_COMMENT,"SIGIL_REPLACE_TOC_HERE");
-            gumbo_append_node(body, placeholder);
-        }
+    if (m_HasEditLandmarks) {
+        sections["landmarks"] = BuildLandmarks(m_EditLandmarks);
     }
-    QString nav_data = gi.getxhtml();
-    QString toc_xml = BuildTOC(toclist);
-    QRegularExpression toc_placeholder(NAV_TOC_PATTERN, 
-                       QRegularExpression::MultilineOption | QRegularExpression::DotMatchesEverythingOption);
-    QRegularExpressionMatch mo = toc_placeholder.match(nav_data);
-    if (mo.hasMatch()) {
-        nav_data.replace(mo.capturedStart(), mo.capturedLength(), toc_xml);
+    if (m_HasEditPageList) {
+        sections["page-list"] = BuildPageList(m_EditPageList);
     }
-    m_NavResource->SetText(nav_data);
+    m_EditTOC.clear();
+    m_EditLandmarks.clear();
+    m_EditPageList.clear();
+    m_HasEditTOC = false;
+    m_HasEditLandmarks = false;
+    m_HasEditPageList = false;
+
+    if (!m_NavResource || sections.isEmpty()) return;
+    QWriteLocker locker(&m_NavResource->GetLock());
+    ReplaceNavSections(sections);
 }
 
 
@@ -23,6 +23,7 @@
 
 #include <QString>
 #include <QList>
+#include <QHash>
 #include "BookManipulation/Book.h"
 #include "BookManipulation/Headings.h"
 #include "ResourceObjects/HTMLResource.h"
@@ -58,6 +59,9 @@ public:
     QList<NavLandmarkEntry> GetLandmarks();
     QList<NavPageListEntry> GetPageList();
 
+    // The page list with its hrefs converted to URLEncoded book paths
+    QList<NavPageListEntry> GetPageListBookPaths();
+
     // Set Nav Section from Actual Book Headings
     bool GenerateTOCFromBookContents(const Book* book);
 
@@ -75,6 +79,13 @@ public:
     QHash<QString, QString> GetLandmarkCodeForPaths();
     QHash<QString, QString> GetLandmarkNameForPaths();
 
+    // Edit sessions let many list changes share one parse and one
+    // serialization of the nav.  Between BeginEdit and CommitEdit the
+    // Get and Set routines work on copies of the lists held here and
+    // the nav text is only rewritten by CommitEdit.  A session still
+    // open when the processor is destroyed is committed.
+    void BeginEdit();
+    void CommitEdit();
 
 private:    
     QString BuildTOC(const QList<NavTOCEntry> & toclist);
@@ -85,6 +96,9 @@ private:
     void SetLandmarks(const QList<NavLandmarkEntry> & landlist);
     void SetPageList(const QList<NavPageListEntry> & pagelist);
 
+    // Replace the nav sections keyed by epub:type with their new xml
+    void ReplaceNavSections(const QHash<QString, QString> & sections);
+
     int GetResourceLandmarkPos(const Resource * resource, const QList<NavLandmarkEntry> & landlist);
     QList<NavTOCEntry> GetNodeTOC(GumboInterface & gi, const GumboNode* node, int lvl);
     QList<NavTOCEntry> HeadingWalker(const Headings::Heading & heading, int lvl);
@@ -101,5 +115,13 @@ private:
     
     HTMLResource * m_NavResource;
     QString m_language;
+
+    bool m_Editing;
+    QList<NavTOCEntry> m_EditTOC;
+    bool m_HasEditTOC;
+    QList<NavLandmarkEntry> m_EditLandmarks;
+    bool m_HasEditLandmarks;
+    QList<NavPageListEntry> m_EditPageList;
+    bool m_HasEditPageList;
 };
 #endif  // NAVPROCESSORH
@@ -28,6 +28,7 @@
 #include <QtCore/QDir>
 #include <QtCore/QFileInfo>
 #include <QtCore/QUuid>
+#include <QtConcurrent/QtConcurrent>
 #include <QRegularExpression>
 #include <QRegularExpressionMatch>
 #include <QDateTime>
@@ -128,7 +129,14 @@ OPFResource::OPFResource(const QString &mainfolder,
              QObject *parent)
   : XMLResource(mainfolder, fullfilepath, parent),
     m_NavResource(NULL),
-    m_WarnedAboutVersion(false)
+    m_WarnedAboutVersion(false),
+    m_PackageRevision(0),
+    m_PackageValid(false),
+    m_SpineIndexRevision(0),
+    m_SpineIndexValid(false),
+    m_SpineEditDepth(0),
+    m_EditSpineRevision(0),
+    m_HasEditSpine(false)
 {
     FillWithDefaultText(version);
     // Make sure the file exists on disk.
@@ -200,15 +208,16 @@ bool OPFResource::LoadFromDisk()
 QList<Resource*> OPFResource::GetSpineOrderResources( const QList<Resource *> &resources)
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
-    const QHash<QString, Resource*> id_mapping = GetManifestIDResourceMapping(resources, p);
+    SpineIndex index = GetSpineIndex();
+    QHash<QString, Resource*> path_mapping;
+    foreach(Resource *resource, resources) {
+        path_mapping.insert(resource->GetRelativePath(), resource);
+    }
     QList<Resource *> spine_order;
-    for (int i = 0; i < p.m_spine.count(); ++i) {
-        QString idref = p.m_spine.at(i).m_idref;
-        if (id_mapping.contains(idref)) {
-            spine_order << id_mapping[idref];
+    foreach(const QString &bookpath, index.bookpaths) {
+        Resource *resource = path_mapping.value(bookpath, NULL);
+        if (resource) {
+            spine_order << resource;
         }
     }
     return spine_order;
@@ -217,17 +226,11 @@ QList<Resource*> OPFResource::GetSpineOrderResources( const QList<Resource *> &r
 QHash <Resource *, int>  OPFResource::GetReadingOrderAll( const QList <Resource *> resources)
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    QHash<QString, int> positions = GetSpineIndex().positions;
     QHash <Resource *, int> reading_order;
-    QHash<QString, int> id_order;
-    for (int i = 0; i < p.m_spine.count(); ++i) {
-        id_order[p.m_spine.at(i).m_idref] = i;
-    }
-    QHash<Resource *, QString> id_mapping = GetResourceManifestIDMapping(resources, p);
+    // files not in the spine have always been given 0
     foreach(Resource *resource, resources) {
-        reading_order[resource] = id_order[id_mapping[resource]];
+        reading_order[resource] = positions.value(resource->GetRelativePath(), 0);
     }
     return reading_order;
 }
@@ -236,18 +239,7 @@ QHash <Resource *, int>  OPFResource::GetReadingOrderAll( const QList <Resource
 int OPFResource::GetReadingOrder(const HTMLResource *html_resource) const
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
-    const Resource *resource = static_cast<const Resource *>(html_resource);
-    QString resource_id = GetResourceManifestID(resource, p);
-    for (int i = 0; i < p.m_spine.count(); ++i) {
-        QString idref = p.m_spine.at(i).m_idref;
-        if (resource_id == idref) {
-            return i;
-        }
-    }
-    return -1;
+    return GetSpineIndex().positions.value(html_resource->GetRelativePath(), -1);
 }
 
 void OPFResource::MoveReadingOrder(const HTMLResource* from_resource, const HTMLResource* after_resource)
@@ -257,9 +249,7 @@ void OPFResource::MoveReadingOrder(const HTMLResource* from_resource, const HTML
     const Resource *after_res = static_cast<const Resource *>(after_resource);
     if (from_res == NULL || after_res == NULL) return;
 
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     QString from_id = GetResourceManifestID(from_res, p);
     QString after_id = GetResourceManifestID(after_res, p);
 
@@ -281,16 +271,54 @@ void OPFResource::MoveReadingOrder(const HTMLResource* from_resource, const HTML
         if (from_pos > after_pos) after_pos += 1;
         p.m_spine.move(from_pos, after_pos);
     }
+    if (m_SpineEditDepth > 0) {
+        StoreEditSpine(p.m_spine);
+        return;
+    }
     UpdateText(p);
 }
 
 
+void OPFResource::BeginSpineEdit()
+{
+    QWriteLocker locker(&GetLock());
+    m_SpineEditDepth++;
+}
+
+
+void OPFResource::CommitSpineEdit()
+{
+    QWriteLocker locker(&GetLock());
+    if (m_SpineEditDepth == 0) return;
+    m_SpineEditDepth--;
+    if (m_SpineEditDepth > 0) return;
+
+    bool has_edit_spine;
+    {
+        QMutexLocker package_locker(&m_PackageMutex);
+        has_edit_spine = m_HasEditSpine && (m_EditSpineRevision == GetRevision());
+    }
+    if (has_edit_spine) {
+        // the parsed package already has the edited spine
+        UpdateText(GetParsedPackage());
+    }
+}
+
+
+void OPFResource::StoreEditSpine(const QList<SpineEntry> &spine)
+{
+    QMutexLocker locker(&m_PackageMutex);
+    m_EditSpine = spine;
+    m_EditSpineRevision = GetRevision();
+    m_HasEditSpine = true;
+    m_SpineIndexValid = false;
+}
+
+
 QString OPFResource::GetMainIdentifierValue() const
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     int i = GetMainIdentifier(p);
     if (i > -1) {
         return QString(p.m_metadata.at(i).m_content);
@@ -336,9 +364,7 @@ QString OPFResource::GetUUIDIdentifierValue()
 {
     EnsureUUIDIdentifierPresent();
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     for (int i=0; i < p.m_metadata.count(); ++i) {
         MetaEntry me = p.m_metadata.at(i);
         if(me.m_name.startsWith("dc:identifier")) {
@@ -358,9 +384,7 @@ QString OPFResource::GetUUIDIdentifierValue()
 void OPFResource::EnsureUUIDIdentifierPresent()
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     for (int i=0; i < p.m_metadata.count(); ++i) {
         MetaEntry me = p.m_metadata.at(i);
         if(me.m_name.startsWith("dc:identifier")) {
@@ -384,9 +408,7 @@ void OPFResource::EnsureUUIDIdentifierPresent()
 QString OPFResource::AddNCXItem(const QString &ncx_path, QString id)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     QString ncx_bkpath = ncx_path.right(ncx_path.length() - GetFullPathToBookFolder().length() - 1);
     QString ncx_rel_path = Utility::buildRelativePath(GetRelativePath(), ncx_bkpath);
     int n = p.m_manifest.count();
@@ -405,9 +427,7 @@ QString OPFResource::AddNCXItem(const QString &ncx_path, QString id)
 void OPFResource::UpdateNCXOnSpine(const QString &new_ncx_id)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     QString ncx_id = p.m_spineattr.m_atts.value(QString("toc"),"");
     if (new_ncx_id != ncx_id) {
         p.m_spineattr.m_atts[QString("toc")] = new_ncx_id;
@@ -418,9 +438,7 @@ void OPFResource::UpdateNCXOnSpine(const QString &new_ncx_id)
 void OPFResource::RemoveNCXOnSpine()
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     p.m_spineattr.m_atts.remove("toc");
     UpdateText(p);
 }
@@ -429,9 +447,7 @@ void OPFResource::RemoveNCXOnSpine()
 void OPFResource::UpdateNCXLocationInManifest(const NCXResource *ncx)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     QString ncx_id = p.m_spineattr.m_atts.value(QString("toc"), "");
     int pos = p.m_idpos.value(ncx_id, -1);
     if (pos > -1) {
@@ -450,9 +466,7 @@ void OPFResource::UpdateNCXLocationInManifest(const NCXResource *ncx)
 void OPFResource::AddSigilVersionMeta()
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     for (int i=0; i < p.m_metadata.count(); ++i) {
         MetaEntry me = p.m_metadata.at(i);
         if ((me.m_name == "meta") && (me.m_atts.contains("name"))) {  
@@ -477,9 +491,7 @@ void OPFResource::AddSigilVersionMeta()
 bool OPFResource::IsCoverImage(const ImageResource *image_resource) const
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     QString resource_id = GetResourceManifestID(image_resource, p);
     return IsCoverImageCheck(resource_id, p);
 }
@@ -499,9 +511,7 @@ bool OPFResource::IsCoverImageCheck(QString resource_id, const OPFParser & p) co
 bool OPFResource::CoverImageExists() const
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     return GetCoverMeta(p) > -1;
 }
 
@@ -510,9 +520,7 @@ void OPFResource::AutoFixWellFormedErrors()
 {
     QWriteLocker locker(&GetLock());
     const QStringList TEXT_EXTS = QStringList() << "htm" << "html" << "xhtml";
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     // auto fill in spine from manifest if completely empty
     if (p.m_spine.count() == 0) {
         std::vector< std::pair< QString, QString > > txts;
@@ -540,20 +548,21 @@ void OPFResource::AutoFixWellFormedErrors()
 QStringList OPFResource::GetSpineOrderBookPaths() const
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
-    QStringList book_paths_in_reading_order;
-    for (int i=0; i < p.m_spine.count(); ++i) {
-        SpineEntry sp = p.m_spine.at(i);
-        QString idref = sp.m_idref;
-        int pos = p.m_idpos.value(idref,-1);
-        if (pos > -1) {
-            QString apath = Utility::URLDecodePath(p.m_manifest.at(pos).m_href);
-            book_paths_in_reading_order.append(Utility::buildBookPath(apath,GetFolder()));
-        }
-    }
-    return book_paths_in_reading_order;
+    return GetSpineIndex().bookpaths;
+}
+
+
+QHash<QString, int> OPFResource::GetSpinePositions() const
+{
+    QReadLocker locker(&GetLock());
+    return GetSpineIndex().positions;
+}
+
+
+QHash<QString, QString> OPFResource::GetManifestBookPaths() const
+{
+    QReadLocker locker(&GetLock());
+    return GetSpineIndex().id_bookpaths;
 }
 
 
@@ -561,9 +570,7 @@ QStringList OPFResource::GetMediaOverlayActiveClassSelectors() const
 {
     QReadLocker locker(&GetLock());
     QStringList activeclassselectors;
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     for (int i=0; i < p.m_metadata.count(); ++i) {
         if (p.m_metadata.at(i).m_name == "meta") {
             MetaEntry me = p.m_metadata.at(i);
@@ -604,9 +611,7 @@ QString OPFResource::GetPrimaryBookLanguage() const
 QList<MetaEntry> OPFResource::GetDCMetadata() const
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     QList<MetaEntry> metadata;
     for (int i=0; i < p.m_metadata.count(); ++i) {
         if (p.m_metadata.at(i).m_name.startsWith("dc:")) {
@@ -618,6 +623,23 @@ QList<MetaEntry> OPFResource::GetDCMetadata() const
 }
 
 
+OPFParser OPFResource::GetPackage() const
+{
+    QReadLocker locker(&GetLock());
+    return GetParsedPackage();
+}
+
+
+void OPFResource::SetMetadata(const MetaNSEntry &metatag, const QList<MetaEntry> &metadata)
+{
+    QWriteLocker locker(&GetLock());
+    OPFParser p = GetParsedPackage();
+    p.m_metans = metatag;
+    p.m_metadata = metadata;
+    UpdateText(p);
+}
+
+
 QStringList OPFResource::GetDCMetadataValues(QString text) const
 {
     QStringList metavalues;
@@ -633,9 +655,7 @@ QStringList OPFResource::GetDCMetadataValues(QString text) const
 void OPFResource::SetDCMetadata(const QList<MetaEntry> &metadata)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     // this will not work with refines so it needs to be fixed
     RemoveDCElements(p);
     foreach(MetaEntry book_meta, metadata) {
@@ -650,9 +670,7 @@ void OPFResource::SetDCMetadata(const QList<MetaEntry> &metadata)
 void OPFResource::AddResource(const Resource *resource)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     ManifestEntry me;
     me.m_id = GetUniqueID(GetValidID(resource->Filename()),p);
     me.m_href = Utility::URLEncodePath(GetRelativePathToResource(resource));
@@ -671,6 +689,31 @@ void OPFResource::AddResource(const Resource *resource)
     UpdateText(p);
 }
 
+void OPFResource::BulkAddResources(const QList<Resource *> &resources)
+{
+    if (resources.isEmpty()) {
+        return;
+    }
+    QWriteLocker locker(&GetLock());
+    OPFParser p = GetParsedPackage();
+    foreach(Resource *resource, resources) {
+        ManifestEntry me;
+        me.m_id = GetUniqueID(GetValidID(resource->Filename()),p);
+        me.m_href = Utility::URLEncodePath(GetRelativePathToResource(resource));
+        me.m_mtype = GetResourceMimetype(resource);
+        int n = p.m_manifest.count();
+        p.m_manifest.append(me);
+        p.m_idpos[me.m_id] = n;
+        p.m_hrefpos[me.m_href] = n;
+        if (resource->Type() == Resource::HTMLResourceType) {
+            SpineEntry se;
+            se.m_idref = me.m_id;
+            p.m_spine.append(se);
+        }
+    }
+    UpdateText(p);
+}
+
 void OPFResource::RemoveCoverImageProperty(QString& resource_id, OPFParser& p)
 {
     // remove the cover image property from manifest with resource_id
@@ -748,11 +791,17 @@ void OPFResource::AddCoverMetaForImage(const Resource *resource, OPFParser &p)
 void OPFResource::BulkRemoveResources(const QList<Resource *>resources)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     if (p.m_manifest.isEmpty()) return;
 
+    // collect the landmark removals so the nav is rewritten only once
+    QString version = GetEpubVersion();
+    NavProcessor * navproc = NULL;
+    if (version.startsWith('3')) {
+        navproc = new NavProcessor(GetNavResource());
+        navproc->BeginEdit();
+    }
+
     foreach(Resource * resource, resources) {
         QString href = Utility::URLEncodePath(GetRelativePathToResource(resource));
         int pos = p.m_hrefpos.value(href, -1);
@@ -774,10 +823,8 @@ void OPFResource::BulkRemoveResources(const QList<Resource *>resources)
                 }
             }
             RemoveGuideReferenceForResource(resource, p);
-            QString version = GetEpubVersion();
-            if (version.startsWith('3')) {
-                NavProcessor navproc(GetNavResource());
-                navproc.RemoveLandmarkForResource(resource);
+            if (navproc) {
+                navproc->RemoveLandmarkForResource(resource);
             }
         }
         if (pos > -1) {
@@ -791,6 +838,10 @@ void OPFResource::BulkRemoveResources(const QList<Resource *>resources)
             }
         }
     }
+    if (navproc) {
+        navproc->CommitEdit();
+        delete navproc;
+    }
     UpdateText(p);
 }
 
@@ -798,9 +849,7 @@ void OPFResource::BulkRemoveResources(const QList<Resource *>resources)
 void OPFResource::RemoveResource(const Resource *resource)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     if (p.m_manifest.isEmpty()) return;
     QString href = Utility::URLEncodePath(GetRelativePathToResource(resource));
     int pos = p.m_hrefpos.value(href, -1);
@@ -845,9 +894,7 @@ void OPFResource::RemoveResource(const Resource *resource)
 void OPFResource::ClearSemanticCodesInGuide()
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     foreach(GuideEntry ge, p.m_guide) {
         p.m_guide.removeAt(0);
     }
@@ -860,9 +907,7 @@ void OPFResource::AddGuideSemanticCode(HTMLResource *html_resource, QString new_
     //first get primary book language
     QString lang = GetPrimaryBookLanguage();
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     QString current_code = GetGuideSemanticCodeForResource(html_resource, p);
 
     if ((current_code != new_code) || !toggle) {
@@ -940,9 +985,7 @@ void OPFResource::RemoveGuideReferenceForResource(const Resource *resource, OPFP
 void OPFResource::UpdateGuideFragments(QHash<QString,QString> &idupdates)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     for(int c=0; c < p.m_guide.size(); c++) {
         GuideEntry ge = p.m_guide.at(c);
         QString href = ge.m_href;
@@ -975,9 +1018,7 @@ void OPFResource::UpdateGuideAfterMerge(QList<Resource*> &merged_resources, QHas
         merged_bookpaths << res->GetRelativePath();
     }
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     for(int c=0; c < p.m_guide.size(); c++) {
         GuideEntry ge = p.m_guide.at(c);
         QString href = ge.m_href;
@@ -1024,9 +1065,7 @@ void OPFResource::SetGuideSemanticCodeForResource(QString code, const Resource *
 QString OPFResource::GetGuideSemanticCodeForResource(const Resource *resource) const
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     return GetGuideSemanticCodeForResource(resource, p);
 }
 
@@ -1040,9 +1079,7 @@ QString OPFResource::GetGuideSemanticNameForResource(Resource *resource)
 QHash <QString, QString>  OPFResource::GetSemanticCodeForPaths()
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
 
     QHash <QString, QString> semantic_types;
     foreach(GuideEntry ge, p.m_guide) {
@@ -1060,9 +1097,7 @@ QHash <QString, QString>  OPFResource::GetSemanticCodeForPaths()
 QHash <QString, QString>  OPFResource::GetGuideSemanticNameForPaths()
 {
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
 
     QHash <QString, QString> semantic_types;
     foreach(GuideEntry ge, p.m_guide) {
@@ -1091,9 +1126,7 @@ QHash <QString, QString>  OPFResource::GetGuideSemanticNameForPaths()
 void OPFResource::SetResourceAsCoverImage(ImageResource *image_resource)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     QString resource_id = GetResourceManifestID(image_resource, p);
 
     // First deal with any previous covers by removing 
@@ -1128,21 +1161,16 @@ void OPFResource::SetResourceAsCoverImage(ImageResource *image_resource)
 void OPFResource::UpdateSpineOrder(const QList<::HTMLResource *> html_files)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
+    QHash<QString, int> spine_positions;
+    for (int i = p.m_spine.count() - 1; i >= 0; --i) {
+        spine_positions.insert(p.m_spine.at(i).m_idref, i);
+    }
     QList<SpineEntry> new_spine;
     foreach(HTMLResource * html_resource, html_files) {
         const Resource *resource = static_cast<const Resource *>(html_resource);
         QString id = GetResourceManifestID(resource, p);
-        int found = -1;
-        for (int i = 0; i < p.m_spine.count(); ++i) {
-           SpineEntry se = p.m_spine.at(i);
-           if (se.m_idref == id) {
-               found = i;
-               break;
-           }
-        }
+        int found = spine_positions.value(id, -1);
         if (found > -1) {
             new_spine.append(p.m_spine.at(found));
         } else {
@@ -1153,6 +1181,10 @@ void OPFResource::UpdateSpineOrder(const QList<::HTMLResource *> html_files)
     }
     p.m_spine.clear();
     p.m_spine = new_spine;
+    if (m_SpineEditDepth > 0) {
+        StoreEditSpine(p.m_spine);
+        return;
+    }
     UpdateText(p);
 }
 
@@ -1160,9 +1192,7 @@ void OPFResource::UpdateSpineOrder(const QList<::HTMLResource *> html_files)
 void OPFResource::ResourceRenamed(const Resource *resource, QString old_full_path)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     // first convert old_full_path to old_bkpath
     QString old_bkpath = old_full_path.right(old_full_path.length() - GetFullPathToBookFolder().length() - 1);
     QString old_href = Utility::URLEncodePath(Utility::buildRelativePath(GetRelativePath(), old_bkpath));
@@ -1247,9 +1277,7 @@ void OPFResource::BulkResourcesMoved(const QHash<QString, Resource *> movedDict)
 {
     QWriteLocker locker(&GetLock());
     QString opf_start_dir = Utility::startingDir(GetRelativePath());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
 
     // a move should not impact the id so leave the old unique manifest id unchanged
     for (int i=0; i < p.m_manifest.count(); ++i) {
@@ -1274,9 +1302,7 @@ void OPFResource::BulkResourcesRenamed(const QHash<QString, Resource *> renamedD
 {
     QWriteLocker locker(&GetLock());
     QString opf_start_dir = Utility::startingDir(GetRelativePath());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
 
     // a rename should not impact the id so leave the old unique manifest id unchanged
     for (int i=0; i < p.m_manifest.count(); ++i) {
@@ -1440,9 +1466,7 @@ QString OPFResource::AddModificationDateMeta()
     datetime = local.toString(Qt::ISODate);
 
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
 
     QString epubversion = GetEpubVersion();
     if (epubversion.startsWith('3')) {
@@ -1559,7 +1583,94 @@ QString OPFResource::GetFileMimetype(const QString &filepath) const
 
 void OPFResource::UpdateText(const OPFParser &p)
 {
-    TextResource::SetText(p.convert_to_xml());
+    QString source = p.convert_to_xml();
+    TextResource::SetText(source);
+    {
+        // whatever spine was being edited is in p and so now in the text
+        QMutexLocker locker(&m_PackageMutex);
+        m_HasEditSpine = false;
+    }
+    // What convert_to_xml writes is already clean so it can be
+    // parsed straight away without going through ProcessXML.
+    // Parsing it rather than keeping p also rebuilds the id and
+    // href indexes that the edits to p may have left stale.
+    OPFParser package;
+    package.parse(source);
+    StorePackage(package, GetRevision());
+}
+
+
+OPFParser OPFResource::GetParsedPackage() const
+{
+    // Read the revision before the text so that the text used is
+    // never older than the revision the package is stored against
+    quint64 revision = GetRevision();
+    OPFParser package;
+    bool cached = false;
+    {
+        QMutexLocker locker(&m_PackageMutex);
+        if (m_PackageValid && (revision == m_PackageRevision)) {
+            package = m_Package;
+            cached = true;
+        }
+    }
+    if (!cached) {
+        QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
+        package.parse(source);
+        StorePackage(package, revision);
+    }
+
+    QMutexLocker locker(&m_PackageMutex);
+    // an edited spine left over from an older text is dropped
+    if (m_HasEditSpine && (m_EditSpineRevision == revision)) {
+        package.m_spine = m_EditSpine;
+    }
+    return package;
+}
+
+
+void OPFResource::StorePackage(const OPFParser &package, quint64 revision) const
+{
+    QMutexLocker locker(&m_PackageMutex);
+    m_Package = package;
+    m_PackageRevision = revision;
+    m_PackageValid = true;
+}
+
+
+OPFResource::SpineIndex OPFResource::GetSpineIndex() const
+{
+    quint64 revision = GetRevision();
+    {
+        QMutexLocker locker(&m_PackageMutex);
+        if (m_SpineIndexValid && (revision == m_SpineIndexRevision)) {
+            return m_SpineIndex;
+        }
+    }
+
+    OPFParser p = GetParsedPackage();
+    SpineIndex index;
+    QString folder = GetFolder();
+    for (int i = 0; i < p.m_manifest.count(); ++i) {
+        const ManifestEntry &me = p.m_manifest.at(i);
+        QString apath = Utility::URLDecodePath(me.m_href);
+        index.id_bookpaths.insert(me.m_id, Utility::buildBookPath(apath, folder));
+    }
+    for (int i = 0; i < p.m_spine.count(); ++i) {
+        QString bookpath = index.id_bookpaths.value(p.m_spine.at(i).m_idref);
+        if (!bookpath.isEmpty()) {
+            index.bookpaths.append(bookpath);
+            if (!index.positions.contains(bookpath)) {
+                index.positions.insert(bookpath, i);
+            }
+        }
+    }
+
+    QMutexLocker locker(&m_PackageMutex);
+    m_SpineIndex = index;
+    m_SpineIndexRevision = revision;
+    m_SpineIndexValid = true;
+    return index;
 }
 
 
@@ -1586,20 +1697,22 @@ QString OPFResource::ValidatePackageVersion(const QString& source)
 
 void OPFResource::UpdateManifestProperties(const QList<Resource*> resources)
 {
+    // Parse the files in worker threads before the opf is locked, the
+    // results are kept by each file against its revision
+    QList<QStringList> all_properties = QtConcurrent::blockingMapped<QList<QStringList>>(resources, GetManifestPropertiesMapped);
+
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     if (p.m_package.m_version != "3.0") {
         return;
     }
-    foreach(Resource* resource, resources) {
-        const HTMLResource* html_resource = static_cast<const HTMLResource *>(resource);
+    for (int i = 0; i < resources.count(); i++) {
+        const HTMLResource* html_resource = static_cast<const HTMLResource *>(resources.at(i));
         QString href = Utility::URLEncodePath(GetRelativePathToResource(html_resource));
         int pos = p.m_hrefpos.value(href, -1);
         if ((pos >= 0) && (pos < p.m_manifest.count())) {
             ManifestEntry me = p.m_manifest.at(pos);
-            QStringList properties = html_resource->GetManifestProperties();
+            QStringList properties = all_properties.at(i);
             // The nav must not lose the nav property
             if (html_resource == m_NavResource) {
                 if (!properties.contains("nav")) {
@@ -1637,14 +1750,18 @@ void OPFResource::UpdateManifestProperties(const QList<Resource*> resources)
 }
 
 
+QStringList OPFResource::GetManifestPropertiesMapped(Resource *resource)
+{
+    return static_cast<const HTMLResource *>(resource)->GetManifestProperties();
+}
+
+
 QString OPFResource::GetManifestPropertiesForResource(const Resource * resource)
 {
     QString properties;
     if (!resource) return properties;
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     if (!p.m_package.m_version.startsWith("3")) {
         return properties;
     }
@@ -1666,9 +1783,7 @@ QHash <QString, QString>  OPFResource::GetManifestPropertiesForPaths()
         return manifest_properties_all;
     }
     QReadLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     foreach(ManifestEntry me, p.m_manifest) {
         QString apath = Utility::URLDecodePath(me.m_href);
         if (me.m_atts.contains("properties")){
@@ -1694,9 +1809,7 @@ void OPFResource::SetNavResource(HTMLResource * nav_resource)
     // but do not overwrite any other existing properties
     if (m_NavResource) { 
         QWriteLocker locker(&GetLock());
-        QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-        OPFParser p;
-        p.parse(source);
+        OPFParser p = GetParsedPackage();
         QString href = Utility::URLEncodePath(GetRelativePathToResource(m_NavResource));
         int pos = p.m_hrefpos.value(href, -1);
         if ((pos >= 0) && (pos < p.m_manifest.count())) {
@@ -1718,9 +1831,7 @@ void OPFResource::SetNavResource(HTMLResource * nav_resource)
 void OPFResource::SetItemRefLinear(Resource * resource, bool linear)
 {
     QWriteLocker locker(&GetLock());
-    QString source = CleanSource::ProcessXML(GetText(),"application/oebps-package+xml");
-    OPFParser p;
-    p.parse(source);
+    OPFParser p = GetParsedPackage();
     QString resource_href_path = Utility::URLEncodePath(GetRelativePathToResource(resource));
     int pos = p.m_hrefpos.value(resource_href_path, -1);
     QString item_id = "";
@@ -26,6 +26,7 @@
 #define OPFRESOURCE_H
 
 #include <memory>
+#include <QMutex>
 #include "Misc/GuideItems.h"
 #include "ResourceObjects/XMLResource.h"
 #include "Parsers/OPFParser.h"
@@ -77,6 +78,17 @@ public:
 
     QList<Resource*> GetSpineOrderResources(const QList<Resource *> &resources);
 
+    /**
+     * Spine edits let any number of MoveReadingOrder and UpdateSpineOrder
+     * calls share one serialization of the OPF.  Between BeginSpineEdit and
+     * CommitSpineEdit they only change a copy of the spine held here, which
+     * every read of the package already sees, and the text is rewritten by
+     * CommitSpineEdit.  Any other change to the OPF writes out the edited
+     * spine with it.  Edits nest, only the outermost commit writes.
+     */
+    void BeginSpineEdit();
+    void CommitSpineEdit();
+
     QString GetMainIdentifierValue() const;
 
     void SaveToDisk(bool book_wide_save = false);
@@ -106,6 +118,17 @@ public:
 
     QStringList GetSpineOrderBookPaths() const;
 
+    /**
+     * Returns the position in the spine of every book path in it.
+     * A file listed more than once is given its first position.
+     */
+    QHash<QString, int> GetSpinePositions() const;
+
+    /**
+     * Returns the book path of every manifest id.
+     */
+    QHash<QString, QString> GetManifestBookPaths() const;
+
     void SetItemRefLinear(Resource * resource, bool linear);
 
     /**
@@ -130,6 +153,20 @@ public:
      */
     QList<MetaEntry> GetDCMetadata() const;
 
+    /**
+     * Returns the package as parsed from the current text.
+     * Repeated calls for the same text do not parse it again.
+     */
+    OPFParser GetPackage() const;
+
+    /**
+     * Replaces the whole <metadata> element of the package.
+     *
+     * @param metatag The metadata tag with its namespace attributes.
+     * @param metadata Every metadata entry, in the order to write them.
+     */
+    void SetMetadata(const MetaNSEntry &metatag, const QList<MetaEntry> &metadata);
+
     /**
      * Returns list of any Media Overlay Active Class Selctors if defined in OPF metadata
      */
@@ -164,6 +201,12 @@ public slots:
 
     void AddResource(const Resource *resource);
 
+    /**
+     * Adds the manifest and spine entries of many resources
+     * with a single rewrite of the OPF.
+     */
+    void BulkAddResources(const QList<Resource *> &resources);
+
     void RemoveResource(const Resource *resource);
     void BulkRemoveResources(const QList<Resource *>resources);
 
@@ -258,6 +301,8 @@ private:
 
     static QString GetOPFDefaultText(const QString &version);
 
+    static QStringList GetManifestPropertiesMapped(Resource *resource);
+
     void FillWithDefaultText(const QString &version=QString());
 
     QString GetUniqueID(const QString &preferred_id, const OPFParser &p) const;
@@ -266,8 +311,41 @@ private:
 
     QString GetFileMimetype(const QString &filepath) const;
 
+    /**
+     * Writes the package out as the new text and keeps it as the
+     * parsed package for that text.
+     */
     void UpdateText(const OPFParser &p);
 
+    /**
+     * Returns a copy of the package parsed from the current text.
+     * The text is only cleaned and parsed again after it has changed.
+     */
+    OPFParser GetParsedPackage() const;
+
+    /**
+     * The spine and manifest of a package keyed by book path
+     * instead of by manifest id and href.
+     */
+    struct SpineIndex {
+        QStringList bookpaths;
+        QHash<QString, int> positions;
+        QHash<QString, QString> id_bookpaths;
+    };
+
+    /**
+     * Returns the index of the package in the current text,
+     * built once for each revision of the text.
+     */
+    SpineIndex GetSpineIndex() const;
+
+    void StorePackage(const OPFParser &package, quint64 revision) const;
+
+    /**
+     * Keeps spine as the edited spine of the current text.
+     */
+    void StoreEditSpine(const QList<SpineEntry> &spine);
+
     QString ValidatePackageVersion(const QString &source);
 
     ///////////////////////////////
@@ -276,6 +354,26 @@ private:
 
     HTMLResource * m_NavResource;
     bool m_WarnedAboutVersion;
+
+    /**
+     * The package as parsed from the text at m_PackageRevision.
+     */
+    mutable OPFParser m_Package;
+    mutable quint64 m_PackageRevision;
+    mutable bool m_PackageValid;
+    mutable SpineIndex m_SpineIndex;
+    mutable quint64 m_SpineIndexRevision;
+    mutable bool m_SpineIndexValid;
+    mutable QMutex m_PackageMutex;
+
+    /**
+     * The spine as edited since BeginSpineEdit, only used while
+     * the text is still at m_EditSpineRevision.
+     */
+    int m_SpineEditDepth;
+    QList<SpineEntry> m_EditSpine;
+    quint64 m_EditSpineRevision;
+    bool m_HasEditSpine;
 };
 
 #endif // OPFRESOURCE_H
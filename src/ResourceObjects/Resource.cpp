@@ -27,6 +27,7 @@
 #include <QtCore/QTimer>
 #include <QtWidgets/QFileIconProvider>
 
+#include "Misc/DeferredFiles.h"
 #include "Misc/Utility.h"
 #include "ResourceObjects/Resource.h"
 
@@ -104,12 +105,14 @@ QString Resource::GetRelativePathToResource(const Resource* dest_resource) const
 {
     if (GetRelativePath() == dest_resource->GetRelativePath()) return "";
     // return Utility::relativePath(dest_resource->GetRelativePath(), dest_resource->GetFolder());
-    return Utility::relativePath(dest_resource->GetFullPath(), GetFullFolderPath());
+    return Utility::relativePath(dest_resource->m_FullFilePath, GetFullFolderPath());
 } 
 
 
 QString Resource::GetFullPath() const
 {
+    // whoever asks for the path may read the file
+    DeferredFiles::Materialize(m_FullFilePath);
     return m_FullFilePath;
 }
 
@@ -192,6 +195,7 @@ bool Resource::RenameTo(const QString &new_filename, bool in_bulk)
 {
     QString new_path;
     bool successful = false;
+    DeferredFiles::Materialize(m_FullFilePath);
     {
         QWriteLocker locker(&m_ReadWriteLock);
         new_path = QFileInfo(m_FullFilePath).absolutePath() + "/" + new_filename;
@@ -216,6 +220,7 @@ bool Resource::MoveTo(const QString &new_bookpath, bool in_bulk)
 {
     QString new_path;
     bool successful = false;
+    DeferredFiles::Materialize(m_FullFilePath);
     {
         QWriteLocker locker(&m_ReadWriteLock);
         new_path = GetFullPathToBookFolder() + "/" + new_bookpath;
@@ -238,6 +243,7 @@ bool Resource::MoveTo(const QString &new_bookpath, bool in_bulk)
 bool Resource::Delete()
 {
     bool successful = false;
+    DeferredFiles::Forget(m_FullFilePath);
     {
         QWriteLocker locker(&m_ReadWriteLock);
         successful = Utility::SDeleteFile(m_FullFilePath);
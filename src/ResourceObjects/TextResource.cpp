@@ -21,9 +21,11 @@
 *************************************************************************/
 
 #include <QtCore/QFile>
+#include <QtCore/QFileInfo>
 #include <QtCore/QString>
 #include <QtCore/QThread>
 #include <QtCore/QTimer>
+#include <QtCore/QDebug>
 #include <QtWidgets/QApplication>
 #include <QtWidgets/QPlainTextDocumentLayout>
 
@@ -31,26 +33,61 @@
 #include "ResourceObjects/TextResource.h"
 #include "sigil_exception.h"
 
+#if 0
+#define DBG if(1)
+#else
+#define DBG if(0)
+#endif
+
+// Shared by every resource so that access stamps can be compared
+static QAtomicInteger<quint64> s_AccessClock(0);
+
+// A rough figure for the block, fragment and layout records a
+// QTextDocument keeps for every line
+static const qint64 DOCUMENT_BLOCK_OVERHEAD = 200;
+
 TextResource::TextResource(const QString &mainfolder, const QString &fullfilepath, QObject *parent)
     :
     Resource(mainfolder, fullfilepath, parent),
     m_CacheInUse(false),
-    m_TextDocument(new TextDocument(this)),
-    m_IsLoaded(false)
+    m_TextDocument(NULL),
+    m_Evicted(false),
+    m_DiskRevision(0),
+    m_DiskRevisionValid(false),
+    m_SavedRevision(0),
+    m_SavedRevisionValid(false),
+    m_SavedFileTime(0),
+    m_SavedFileSize(0),
+    m_SavedTextHash(0),
+    m_SavedTextLength(0),
+    m_SavedTextValid(false),
+    m_FileDataRevision(0),
+    m_FileDataValid(false),
+    m_SnapshotRevision(0),
+    m_SnapshotValid(false),
+    m_LastAccess(0),
+    m_IsLoaded(false),
+    m_Revision(0)
 {
-    m_TextDocument->setDocumentLayout(new QPlainTextDocumentLayout(m_TextDocument));
-    connect(m_TextDocument, SIGNAL(contentsChanged()), this, SIGNAL(Modified()));
 }
 
 
 QString TextResource::GetText() const
 {
     QMutexLocker locker(&m_CacheAccessMutex);
+    m_LastAccess.storeRelease(s_AccessClock.fetchAndAddRelaxed(1) + 1);
 
     if (m_CacheInUse) {
         return m_Cache;
     }
 
+    if (!m_TextDocument) {
+        if (m_Evicted) {
+            ReloadEvictedText();
+        }
+        return m_Text;
+    }
+
     return m_TextDocument->toText();
 }
 
@@ -68,10 +105,17 @@ void TextResource::SetText(const QString &text)
     // when we return to the GUI thread. The single-shot timer makes sure
     // of that.
     if (QThread::currentThread() == QApplication::instance()->thread()) {
-        SetTextInternal(text);
+        if (m_TextDocument) {
+            SetTextInternal(text);
+        } else {
+            // workers may be reading m_Text
+            QMutexLocker locker(&m_CacheAccessMutex);
+            SetTextInternal(text);
+        }
     } else {
         QMutexLocker locker(&m_CacheAccessMutex);
         m_Cache = text;
+        IncrementRevision();
 
         // We want to make sure we schedule only one delayed update
         if (!m_CacheInUse) {
@@ -84,13 +128,54 @@ void TextResource::SetText(const QString &text)
 
 TextDocument& TextResource::GetTextDocumentForWriting()
 {
-    Q_ASSERT(m_TextDocument);
+    if (!m_TextDocument) {
+        CreateTextDocument();
+    }
     return *m_TextDocument;
 }
 
 
+void TextResource::ReleaseTextDocument()
+{
+    if (!m_TextDocument) {
+        return;
+    }
+
+    QMutexLocker locker(&m_CacheAccessMutex);
+    TextDocument *document = m_TextDocument;
+    m_Text = document->toText();
+    m_TextDocument = NULL;
+    // so that the snapshot does not keep a second copy of the text
+    m_Snapshot = QString();
+    m_SnapshotValid = false;
+    disconnect(document, 0, this, 0);
+    // anything still holding the document is torn down this event loop pass
+    document->deleteLater();
+}
+
+
+void TextResource::CreateTextDocument()
+{
+    QMutexLocker locker(&m_CacheAccessMutex);
+    if (m_Evicted) {
+        ReloadEvictedText();
+    }
+    TextDocument *document = new TextDocument(this);
+    document->setDocumentLayout(new QPlainTextDocumentLayout(document));
+    // the text itself has not changed so this is done before connecting
+    document->setPlainText(m_Text);
+    document->ResetUndoMemory();
+    document->setModified(false);
+    connect(document, SIGNAL(contentsChanged()), this, SLOT(IncrementRevision()));
+    connect(document, SIGNAL(contentsChanged()), this, SIGNAL(Modified()));
+    m_TextDocument = document;
+    m_Text.clear();
+}
+
+
 void TextResource::SaveToDisk(bool book_wide_save)
 {
+    bool written = false;
     {
         QWriteLocker locker(&GetLock());
 
@@ -103,20 +188,45 @@ void TextResource::SaveToDisk(bool book_wide_save)
         // when the user has not changed the text file.
         // (some text files have placeholder text on disk)
 
-        // But we always want to save the most up to date version
-
-        if (m_CacheInUse) {
-            Utility::WriteUnicodeTextFile(m_Cache, GetFullPath());
-        } else {
-            Utility::WriteUnicodeTextFile(GetText(), GetFullPath());
+        // But we always want to save the most up to date version,
+        // so the file is only left alone when it is known to hold
+        // the current revision and has not been touched since.
+
+        quint64 revision = GetRevision();
+        if (!FileHoldsRevision(revision)) {
+            QString text = GetText();
+            size_t text_hash = qHash(text);
+            bool unchanged = false;
+            {
+                QMutexLocker cache_locker(&m_CacheAccessMutex);
+                // a new revision whose text is what was last written,
+                // the file still holds it so only the revision moves on
+                unchanged = FileHoldsText(text, text_hash);
+                if (unchanged) {
+                    m_SavedRevision = revision;
+                    m_DiskRevision = revision;
+                }
+            }
+            if (!unchanged) {
+                Utility::SaveUnicodeTextFile(text, GetFullPath());
+                QMutexLocker cache_locker(&m_CacheAccessMutex);
+                // the file only stands in for the text if it reads back the same
+                SetDiskRevision(revision, Utility::ConvertLineEndingsAndNormalize(text) == text);
+                m_SavedTextHash = text_hash;
+                m_SavedTextLength = text.length();
+                m_SavedTextValid = m_SavedRevisionValid;
+                written = true;
+            }
         }
     }
 
-    if (!book_wide_save) {
+    if (written && !book_wide_save) {
         emit ResourceUpdatedOnDisk();
     }
 
-    m_TextDocument->setModified(false);
+    if (m_TextDocument) {
+        m_TextDocument->setModified(false);
+    }
     Resource::SaveToDisk(book_wide_save);
 }
 
@@ -144,11 +254,199 @@ void TextResource::InitialLoad()
       * it had been opened in a tab first.
       */
     QWriteLocker locker(&GetLock());
-    Q_ASSERT(m_TextDocument);
+    bool is_empty = m_TextDocument ? m_TextDocument->isEmpty() : (m_Text.isEmpty() && !m_Evicted);
 
-    if (m_TextDocument->isEmpty() && QFile::exists(GetFullPath())) {
+    if (is_empty && QFile::exists(GetFullPath())) {
         SetText(Utility::ReadUnicodeTextFile(GetFullPath()));
+        QMutexLocker cache_locker(&m_CacheAccessMutex);
+        SetDiskRevision(GetRevision());
+    }
+}
+
+
+quint64 TextResource::GetRevision() const
+{
+    return m_Revision.loadAcquire();
+}
+
+
+QByteArray TextResource::GetFileData() const
+{
+    quint64 revision = GetRevision();
+    {
+        QMutexLocker locker(&m_CacheAccessMutex);
+        if (!m_CacheInUse && (!m_IsLoaded || m_Evicted)) {
+            return QByteArray();
+        }
+        if (m_FileDataValid && (m_FileDataRevision == revision)) {
+            return m_FileData;
+        }
     }
+
+    // a change made meanwhile has a newer revision and is encoded again
+    QByteArray data = Utility::UnicodeTextFileData(GetText());
+    QMutexLocker locker(&m_CacheAccessMutex);
+    m_FileData = data;
+    m_FileDataRevision = revision;
+    m_FileDataValid = true;
+    return data;
+}
+
+
+TextResource::TextSnapshot TextResource::GetTextSnapshot() const
+{
+    TextSnapshot snapshot;
+    {
+        QMutexLocker locker(&m_CacheAccessMutex);
+        snapshot.revision = GetRevision();
+        if (m_SnapshotValid && (m_SnapshotRevision == snapshot.revision)) {
+            m_LastAccess.storeRelease(s_AccessClock.fetchAndAddRelaxed(1) + 1);
+            snapshot.text = m_Snapshot;
+            return snapshot;
+        }
+    }
+
+    // the revision is read before the text, so a change made meanwhile
+    // leaves the snapshot out of date and any SetTextIfRevision fails
+    snapshot.text = GetText();
+    QMutexLocker locker(&m_CacheAccessMutex);
+    if (GetRevision() == snapshot.revision) {
+        m_Snapshot = snapshot.text;
+        m_SnapshotRevision = snapshot.revision;
+        m_SnapshotValid = true;
+    }
+    return snapshot;
+}
+
+
+bool TextResource::SetTextIfRevision(const QString &text, quint64 revision)
+{
+    QMutexLocker locker(&m_CacheAccessMutex);
+    if (GetRevision() != revision) {
+        return false;
+    }
+    if (QThread::currentThread() == QApplication::instance()->thread()) {
+        if (m_TextDocument) {
+            // only this thread edits the document, and workers
+            // setting text go through m_Cache and the lock
+            locker.unlock();
+        }
+        SetTextInternal(text);
+    } else {
+        m_Cache = text;
+        IncrementRevision();
+        if (!m_CacheInUse) {
+            m_CacheInUse = true;
+            QTimer::singleShot(0, this, SLOT(DelayedUpdateToTextDocument()));
+        }
+    }
+    return true;
+}
+
+
+void TextResource::IncrementRevision()
+{
+    m_Revision.fetchAndAddOrdered(1);
+}
+
+
+qint64 TextResource::GetTextMemorySize() const
+{
+    QMutexLocker locker(&m_CacheAccessMutex);
+    qint64 length = m_CacheInUse ? m_Cache.length() : 0;
+    if (m_TextDocument) {
+        length += m_TextDocument->characterCount();
+    } else {
+        length += m_Text.length();
+    }
+    // without a document the snapshot shares m_Text
+    if (m_TextDocument && m_SnapshotValid) {
+        length += m_Snapshot.length();
+    }
+    return length * static_cast<qint64>(sizeof(QChar)) + (m_FileDataValid ? m_FileData.size() : 0);
+}
+
+
+qint64 TextResource::GetDocumentMemorySize() const
+{
+    QMutexLocker locker(&m_CacheAccessMutex);
+    if (!m_TextDocument) {
+        return 0;
+    }
+    return static_cast<qint64>(m_TextDocument->blockCount()) * DOCUMENT_BLOCK_OVERHEAD;
+}
+
+
+quint64 TextResource::GetLastAccess() const
+{
+    return m_LastAccess.loadAcquire();
+}
+
+
+bool TextResource::EvictText()
+{
+    QMutexLocker locker(&m_CacheAccessMutex);
+    if (m_TextDocument || m_CacheInUse || m_Evicted || m_Text.isEmpty() ||
+        !m_DiskRevisionValid || (m_DiskRevision != GetRevision()) || !FileIsAsSaved()) {
+        return false;
+    }
+    DBG qDebug() << "TextResource evicting" << GetRelativePath();
+    m_Text = QString();
+    m_Evicted = true;
+    m_FileData = QByteArray();
+    m_FileDataValid = false;
+    m_Snapshot = QString();
+    m_SnapshotValid = false;
+    return true;
+}
+
+
+void TextResource::ReloadEvictedText() const
+{
+    DBG qDebug() << "TextResource reloading" << GetRelativePath();
+    try {
+        m_Text = Utility::ReadUnicodeTextFile(GetFullPath());
+    } catch (CannotOpenFile &e) {
+        qDebug() << "TextResource could not read back evicted text:" << e.what();
+        m_Text = QString();
+    }
+    m_Evicted = false;
+}
+
+
+void TextResource::SetDiskRevision(quint64 revision, bool reads_back_same)
+{
+    QFileInfo info(GetFullPath());
+    m_SavedRevision = revision;
+    m_SavedRevisionValid = info.exists();
+    m_SavedFileTime = info.lastModified().toMSecsSinceEpoch();
+    m_SavedFileSize = info.size();
+    m_DiskRevision = revision;
+    m_DiskRevisionValid = m_SavedRevisionValid && reads_back_same;
+    // only known once the text has been written
+    m_SavedTextValid = false;
+}
+
+
+bool TextResource::FileIsAsSaved() const
+{
+    QFileInfo info(GetFullPath());
+    return info.exists() && (info.lastModified().toMSecsSinceEpoch() == m_SavedFileTime) &&
+           (info.size() == m_SavedFileSize);
+}
+
+
+bool TextResource::FileHoldsText(const QString &text, size_t text_hash) const
+{
+    return m_SavedTextValid && (text_hash == m_SavedTextHash) &&
+           (text.length() == m_SavedTextLength) && FileIsAsSaved();
+}
+
+
+bool TextResource::FileHoldsRevision(quint64 revision) const
+{
+    QMutexLocker locker(&m_CacheAccessMutex);
+    return m_SavedRevisionValid && (revision == m_SavedRevision) && FileIsAsSaved();
 }
 
 
@@ -163,6 +461,8 @@ bool TextResource::LoadFromDisk()
         const QString &text = Utility::ReadUnicodeTextFile(GetFullPath());
         QMutexLocker locker(&m_CacheAccessMutex);
         m_Cache = text;
+        IncrementRevision();
+        SetDiskRevision(GetRevision());
 
         // We want to make sure we schedule only one delayed update
         if (!m_CacheInUse) {
@@ -187,14 +487,26 @@ void TextResource::DelayedUpdateToTextDocument()
         return;
     }
 
-    SetTextInternal(m_Cache);
+    // the revision was bumped when the cache was filled
+    SetTextInternal(m_Cache, false);
 }
 
 
-void TextResource::SetTextInternal(const QString &text)
+void TextResource::SetTextInternal(const QString &text, bool is_new_revision)
 {
-    m_TextDocument->setPlainText(text);
-    m_TextDocument->setModified(false);
+    if (m_TextDocument) {
+        m_TextDocument->setPlainText(text);
+        // which also cleared the undo history
+        m_TextDocument->ResetUndoMemory();
+        m_TextDocument->setModified(false);
+    } else {
+        m_Text = text;
+        m_Evicted = false;
+        if (is_new_revision) {
+            IncrementRevision();
+        }
+        emit Modified();
+    }
     // Our resource has now been loaded with some text
     m_IsLoaded = true;
     m_CacheInUse = false;
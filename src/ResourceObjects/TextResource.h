@@ -24,6 +24,7 @@
 #ifndef TEXTRESOURCE_H
 #define TEXTRESOURCE_H
 
+#include <QtCore/QAtomicInteger>
 #include <QtCore/QMutex>
 #include "Widgets/TextDocument.h"
 #include "ResourceObjects/Resource.h"
@@ -34,6 +35,9 @@ class TextDocument;
 /**
  * A parent class for textual resources like CSS and SVG images.
  * Takes care of loading and caching content etc.
+ *
+ * The text is kept as a plain QString until a tab asks for the
+ * QTextDocument, and goes back to a plain QString when the tab closes.
  */
 class TextResource : public Resource
 {
@@ -41,6 +45,15 @@ class TextResource : public Resource
 
 public:
 
+    /**
+     * The text of the resource at one revision.  The text is shared,
+     * not copied, and never changes once the snapshot is taken.
+     */
+    struct TextSnapshot {
+        QString text;
+        quint64 revision;
+    };
+
     /**
      * Constructor.
      *
@@ -65,6 +78,7 @@ public:
     /**
      * Returns a reference to the QTextDocument that can be read and written to
      * in consumers. If you need just read access, use GetTextDocumentForReading().
+     * The document is created from the stored text the first time it is asked for.
      *
      * @warning Make sure to get a write lock externally before calling this function!
      *
@@ -72,6 +86,13 @@ public:
      */
     TextDocument &GetTextDocumentForWriting();
 
+    /**
+     * Moves the text out of the QTextDocument back into plain storage
+     * and deletes the document.  Called when the tab showing
+     * the resource closes; the undo history goes with the document.
+     */
+    void ReleaseTextDocument();
+
     // inherited
     void SaveToDisk(bool book_wide_save = false);
 
@@ -84,6 +105,65 @@ public:
 
     bool IsLoaded();
 
+    /**
+     * Returns a number that changes every time the text changes,
+     * so that anything derived from the text can be cached against it.
+     * Safe to call from any thread.
+     *
+     * @return The current revision of the text.
+     */
+    quint64 GetRevision() const;
+
+    /**
+     * Returns the UTF-8 bytes SaveToDisk writes for the current text,
+     * encoded once per revision. Safe to call from any thread.
+     *
+     * @return The bytes, empty if the text is not held in memory
+     *         and only the file on disk has it.
+     */
+    QByteArray GetFileData() const;
+
+    /**
+     * Returns the current text along with its revision, taken once per
+     * revision.  Workers can parse the snapshot without holding the
+     * resource lock and hand back what they made of it with
+     * SetTextIfRevision.  Safe to call from any thread.
+     */
+    TextSnapshot GetTextSnapshot() const;
+
+    /**
+     * Sets the text, like SetText, but only if the text is still at
+     * the revision of the snapshot it was made from.
+     *
+     * @return \c false if the text has changed since, nothing is set then.
+     */
+    virtual bool SetTextIfRevision(const QString &text, quint64 revision);
+
+    /**
+     * Returns roughly how many bytes of text the resource holds in memory.
+     */
+    qint64 GetTextMemorySize() const;
+
+    /**
+     * Returns roughly how many bytes the QTextDocument of an open tab
+     * holds on top of its text, 0 when there is no document.
+     */
+    qint64 GetDocumentMemorySize() const;
+
+    /**
+     * Returns a stamp that is larger the more recently the text was read.
+     */
+    quint64 GetLastAccess() const;
+
+    /**
+     * Drops the text from memory if it is exactly what is in the file
+     * on disk and no tab has it open. The file is read back again the
+     * next time the text is asked for.
+     *
+     * @return \c true if the text was dropped.
+     */
+    bool EvictText();
+
     // inherited
     virtual ResourceType Type() const;
 
@@ -98,6 +178,11 @@ private slots:
      */
     void DelayedUpdateToTextDocument();
 
+    /**
+     * Marks the text as changed.
+     */
+    void IncrementRevision();
+
 private:
 
     /**
@@ -105,7 +190,45 @@ private:
      *
      * @param text The text to set.
      */
-    void SetTextInternal(const QString &text);
+    void SetTextInternal(const QString &text, bool is_new_revision = true);
+
+    /**
+     * Creates m_TextDocument holding the text in m_Text.
+     */
+    void CreateTextDocument();
+
+    /**
+     * Reads the text back in after EvictText.
+     * m_CacheAccessMutex must be held.
+     */
+    void ReloadEvictedText() const;
+
+    /**
+     * Records that the file on disk holds the text at revision, and
+     * whether reading the file gives back exactly that text.
+     * m_CacheAccessMutex must be held.
+     */
+    void SetDiskRevision(quint64 revision, bool reads_back_same = true);
+
+    /**
+     * Returns \c true if the file still has the time stamp and size
+     * it had when SetDiskRevision was last called.
+     * m_CacheAccessMutex must be held.
+     */
+    bool FileIsAsSaved() const;
+
+    /**
+     * Returns \c true if writing the text at revision would not
+     * change the file on disk.
+     */
+    bool FileHoldsRevision(quint64 revision) const;
+
+    /**
+     * Returns \c true if the file was last written with text, which has
+     * the qHash text_hash, and has not been touched since.
+     * m_CacheAccessMutex must be held.
+     */
+    bool FileHoldsText(const QString &text, size_t text_hash) const;
 
 
     ///////////////////////////////
@@ -129,10 +252,65 @@ private:
 
     /**
      * The syntax colored cache of the TextResource text content.
+     * NULL while no tab has the resource open.
      */
     TextDocument *m_TextDocument;
 
+    /**
+     * The text while there is no m_TextDocument.
+     */
+    mutable QString m_Text;
+
+    /**
+     * If \c true, m_Text has been dropped and has to be read from disk.
+     */
+    mutable bool m_Evicted;
+
+    /**
+     * The revision of the text that the file on disk reads back as.
+     */
+    quint64 m_DiskRevision;
+    bool m_DiskRevisionValid;
+
+    /**
+     * The revision last written to or read from disk, with the
+     * time stamp and size the file had then.
+     */
+    quint64 m_SavedRevision;
+    bool m_SavedRevisionValid;
+    qint64 m_SavedFileTime;
+    qint64 m_SavedFileSize;
+
+    /**
+     * The qHash and length of the text last written, so that a new
+     * revision with the same text does not have to be written again.
+     */
+    size_t m_SavedTextHash;
+    int m_SavedTextLength;
+    bool m_SavedTextValid;
+
+    /**
+     * What GetFileData returned for m_FileDataRevision.
+     */
+    mutable QByteArray m_FileData;
+    mutable quint64 m_FileDataRevision;
+    mutable bool m_FileDataValid;
+
+    /**
+     * What GetTextSnapshot returned for m_SnapshotRevision.
+     */
+    mutable QString m_Snapshot;
+    mutable quint64 m_SnapshotRevision;
+    mutable bool m_SnapshotValid;
+
+    mutable QAtomicInteger<quint64> m_LastAccess;
+
     bool m_IsLoaded;
+
+    /**
+     * Bumped whenever the text document or the cache changes.
+     */
+    QAtomicInteger<quint64> m_Revision;
 };
 
 #endif // TEXTRESOURCE_H
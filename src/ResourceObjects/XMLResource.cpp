@@ -27,7 +27,9 @@
 #include "ResourceObjects/XMLResource.h"
 
 XMLResource::XMLResource(const QString &mainfolder, const QString &fullfilepath, QObject *parent)
-    : TextResource(mainfolder, fullfilepath, parent)
+    : TextResource(mainfolder, fullfilepath, parent),
+      m_WellFormedKnown(false),
+      m_WellFormedRevision(0)
 {
 }
 
@@ -41,31 +43,57 @@ Resource::ResourceType XMLResource::Type() const
 bool XMLResource::FileIsWellFormed() const
 {
     // TODO: expand this with a dialog to fix the problem
-    QReadLocker locker(&GetLock());
-    QString mtype = GetMediaType();
-    if ((mtype == "application/xhtml+xml") || (mtype == "application/x-dtbook+xml")) { 
-        XhtmlDoc::WellFormedError error = XhtmlDoc::WellFormedErrorForSource(GetText());
-        bool well_formed = error.line == -1;
-        return well_formed;
-    }
-    bool well_formed = CleanSource::IsWellFormedXML(GetText(),mtype);
-    return well_formed;
+    return WellFormedErrorLocation().line == -1;
 }
 
 
 XhtmlDoc::WellFormedError XMLResource::WellFormedErrorLocation() const
 {
-    QReadLocker locker(&GetLock());
-    QString mtype = GetMediaType();
+    // Read the revision before the text so that the text used is
+    // never older than the revision the result is stored against
+    quint64 revision = GetRevision();
+    {
+        QMutexLocker locker(&m_WellFormedMutex);
+        if (m_WellFormedKnown && (m_WellFormedRevision == revision)) {
+            return m_WellFormedError;
+        }
+    }
     XhtmlDoc::WellFormedError error;
-    if ((mtype == "application/xhtml+xml") || (mtype == "application/x-dtbook+xml")) { 
-        error = XhtmlDoc::WellFormedErrorForSource(GetText());
-    } else {
-        error = CleanSource::WellFormedXMLCheck(GetText(), mtype);
+    {
+        QReadLocker locker(&GetLock());
+        error = CheckWellFormed(GetText(), GetMediaType());
     }
+    StoreWellFormedError(revision, error);
     return error;
 }
 
+
+bool XMLResource::IsWellFormedKnown() const
+{
+    QMutexLocker locker(&m_WellFormedMutex);
+    return m_WellFormedKnown && (m_WellFormedRevision == GetRevision());
+}
+
+
+void XMLResource::StoreWellFormedError(quint64 revision, const XhtmlDoc::WellFormedError &error) const
+{
+    QMutexLocker locker(&m_WellFormedMutex);
+    if (revision == GetRevision()) {
+        m_WellFormedKnown = true;
+        m_WellFormedRevision = revision;
+        m_WellFormedError = error;
+    }
+}
+
+
+XhtmlDoc::WellFormedError XMLResource::CheckWellFormed(const QString &text, const QString &mtype)
+{
+    if ((mtype == "application/xhtml+xml") || (mtype == "application/x-dtbook+xml")) { 
+        return XhtmlDoc::WellFormedErrorForSource(text);
+    }
+    return CleanSource::WellFormedXMLCheck(text, mtype);
+}
+
 // The actual xml spec for allowed char in xml ids
 //
 //  NameStartChar ::=   ":" | [A-Z] | "_" | [a-z] | [#xC0-#xD6] |
@@ -23,6 +23,8 @@
 #ifndef XMLRESOURCE_H
 #define XMLRESOURCE_H
 
+#include <QtCore/QMutex>
+
 #include "BookManipulation/XhtmlDoc.h"
 #include "ResourceObjects/TextResource.h"
 
@@ -46,10 +48,34 @@ public:
 
     virtual ResourceType Type() const;
 
+    /**
+     * Whether the text is well formed.  The verdict is kept
+     * until the text changes.
+     */
     bool FileIsWellFormed() const;
 
+    /**
+     * The first well formed error in the text, with a line of -1
+     * if there is none.  It is kept until the text changes.
+     */
     XhtmlDoc::WellFormedError WellFormedErrorLocation() const;
 
+    /**
+     * Whether the verdict for the current text is already known.
+     */
+    bool IsWellFormedKnown() const;
+
+    /**
+     * Keeps the error found in the text of the given revision,
+     * unless the text has changed since.
+     */
+    void StoreWellFormedError(quint64 revision, const XhtmlDoc::WellFormedError &error) const;
+
+    /**
+     * Checks text of the given media type.  Safe to call from any thread.
+     */
+    static XhtmlDoc::WellFormedError CheckWellFormed(const QString &text, const QString &mtype);
+
 protected:
 
     /**
@@ -69,6 +95,12 @@ protected:
      */
     static bool IsValidIDCharacter(const QChar &character);
 
+private:
+
+    mutable QMutex m_WellFormedMutex;
+    mutable bool m_WellFormedKnown;
+    mutable quint64 m_WellFormedRevision;
+    mutable XhtmlDoc::WellFormedError m_WellFormedError;
 };
 
 #endif // XMLRESOURCE_H
@@ -71,6 +71,11 @@ class BookContainer(object):
             return 'en_US'
         return self._w.sigil_spellcheck_lang
 
+    # profile is one of "fast", "balanced" or "archival" and is used
+    # by Sigil the next time it saves this epub
+    def set_save_compression(self, profile):
+        self._w.save_compression = profile
+
 # OPF Acess and Manipulation Routines
 
 # toc and pagemap access routines
@@ -179,6 +184,21 @@ class BookContainer(object):
         # writes data to a currently existing file pointed to by the manifest id
         self._w.writefile(id, data)
 
+    def readfiles(self, ids):
+        # returns the contents of the files with the manifest ids in one call,
+        # in the same order (text files are utf-8 decoded)
+        return self._w.readfiles(ids)
+
+    def writefiles(self, id_data):
+        # writes many currently existing files in one call, id_data is a
+        # dictionary or a sequence of (manifest id, data) pairs
+        self._w.writefiles(id_data)
+
+    def set_memory_only(self, memory_only=True):
+        # while set, written files are only kept in memory and are shipped
+        # back to Sigil in one batch when the plugin finishes
+        self._w.set_memory_only(memory_only)
+
     # Modified for epub3
     def addfile(self, uniqueid, basename, data, mime=None, properties=None, fallback=None, overlay=None):
         # creates a new file in the manifest with unique manifest id, basename, data, and mimetype
@@ -226,6 +246,13 @@ class BookContainer(object):
             href = self._w.id_to_href[id]
             yield id, href
 
+    def text_data_iter(self):
+        # yields manifest id, href and contents of the text files in text_iter order
+        ids_hrefs = list(self.text_iter())
+        datas = self._w.readfiles([id for id, href in ids_hrefs])
+        for (id, href), data in zip(ids_hrefs, datas):
+            yield id, href, data
+
     def css_iter(self):
         # yields manifest id, href
         for id in sorted(self._w.id_to_mime):
@@ -154,6 +154,8 @@ class ProcessScript(object):
             self.wrapout.append('<wrapper type="%s">\n<result>failed</result>\n<changes/>\n' % script_type)
             return self.exitcode
         if script_type == "edit":
+            # ship back what was only written in memory
+            container._w.flush_pending()
             # write out the final updated opf to the outdir
             container._w.write_opf()
         # save the wrapper results to a file before exiting the thread
@@ -162,6 +164,8 @@ class ProcessScript(object):
         self.wrapout.append(_XML_HEADER)
         self.wrapout.append('<wrapper type="%s">\n' % script_type)
         self.wrapout.append('<result>success</result>\n')
+        if script_type == "edit" and container._w.save_compression is not None:
+            self.wrapout.append('<savecompression>%s</savecompression>\n' % container._w.save_compression)
         self.wrapout.append('<changes>\n')
         if script_type == "edit":
             for ftype, id, href in container._w.deleted:
@@ -313,5 +317,62 @@ def main(argv=sys.argv):
     sys.stdout.buffer.write(_utf8str(resultxml))
     return 0
 
+
+# must match END_OF_RUN in Sigil's PluginSession.cpp
+_SESSION_END = b"\x1dsigil plugin session: run finished\x1d\n"
+
+# runs one plugin for each line of json encoded launcher arguments read
+# from stdin until Sigil closes it, so the interpreter and the modules
+# plugins import stay loaded between runs
+def session(argv=sys.argv):
+    import json
+    # load up front what so many plugins use
+    for name in ['sigil_bs4', 'lxml.etree', 'regex', 'css_parser']:
+        try:
+            __import__(name)
+        except ImportError:
+            pass
+    base_path = list(sys.path)
+    base_cwd = os.getcwd()
+    base_environ = dict(os.environ)
+    stdout = sys.stdout
+    stderr = sys.stderr
+    for line in sys.stdin.buffer:
+        line = line.strip()
+        if not line:
+            continue
+        script_type = None
+        script_home = None
+        try:
+            args = json.loads(line.decode('utf-8'))
+            if len(args) == 4:
+                script_type = args[2]
+                script_home = os.path.dirname(args[3])
+            main([argv[0]] + args)
+        except BaseException as e:
+            # includes a plugin calling sys.exit
+            sys.stdout = stdout
+            sys.stderr = stderr
+            failed(script_type, msg=escapeit("Launcher: plugin session run failed: %s" % e))
+        # forget the plugin's own modules so that the next run imports them afresh
+        if script_home is not None:
+            home = os.path.normcase(os.path.abspath(script_home)) + os.sep
+            for name, module in list(sys.modules.items()):
+                mfile = getattr(module, '__file__', None)
+                if mfile and os.path.normcase(os.path.abspath(mfile)).startswith(home):
+                    del sys.modules[name]
+        sys.path[:] = base_path
+        os.chdir(base_cwd)
+        os.environ.clear()
+        os.environ.update(base_environ)
+        sys.stdout = stdout
+        sys.stderr = stderr
+        sys.stdout.flush()
+        sys.stdout.buffer.write(_SESSION_END)
+        sys.stdout.flush()
+    return 0
+
 if __name__ == "__main__":
+    if len(sys.argv) == 2 and sys.argv[1] == "--session":
+        sys.exit(session())
     sys.exit(main())
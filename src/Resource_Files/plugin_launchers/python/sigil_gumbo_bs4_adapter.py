@@ -32,6 +32,7 @@
 __author__ = 'jdtang@google.com (Jonathan Tang)'
 
 import sys
+import struct
 import sigil_gumboc as gumboc
 
 import sigil_bs4
@@ -156,6 +157,119 @@ def _add_next_prev_pointers(soup):
         node.previous_element = nodes[i - 1]
 
 
+# Building the soup from the flat table of gumbo_export_tree instead of
+# walking the ctypes structures saves a call into ctypes for every field
+# of every node
+
+_UINT = struct.Struct('=I')
+_TEXT_HEADER = struct.Struct('=III')
+_ELEMENT_HEADER = struct.Struct('=IIIIIIIIII')
+
+_NODE_DOCUMENT = 0
+_NODE_ELEMENT = 1
+_NODE_TEMPLATE = 6
+_EXPORT_UNKNOWN_TAG = 1
+
+_TEXT_CLASSES = {
+    2: sigil_bs4.element.NavigableString,     # TEXT
+    3: sigil_bs4.element.CData,               # CDATA
+    4: sigil_bs4.element.Comment,             # COMMENT
+    5: sigil_bs4.element.NavigableString,     # WHITESPACE
+}
+
+_ATTR_PREFIXES = [value.lower() for value in gumboc.AttributeNamespace._values_]
+_ATTR_URLS = gumboc.AttributeNamespace.URLS
+
+
+class _TableReader(object):
+
+    def __init__(self, table):
+        self.table = table
+        self.pos = 0
+
+    def uint(self):
+        value, = _UINT.unpack_from(self.table, self.pos)
+        self.pos += 4
+        return value
+
+    def unpack(self, fmt):
+        values = fmt.unpack_from(self.table, self.pos)
+        self.pos += fmt.size
+        return values
+
+    def string(self):
+        length, = _UINT.unpack_from(self.table, self.pos)
+        start = self.pos + 4
+        self.pos = start + length
+        return self.table[start:self.pos].decode('utf-8', 'replace')
+
+
+def _table_attrs(reader, count):
+    attrs = {}
+    for i in range(count):
+        namespace = reader.uint()
+        name = reader.string()
+        value = reader.string()
+        if namespace != 0:
+            prefix = _ATTR_PREFIXES[namespace] if name != 'xmlns' else None
+            name = sigil_bs4.element.NamespacedAttribute(prefix, name, _ATTR_URLS[namespace])
+        elif name == "class" and " " in value:
+            value = sigil_bs4.element.whitespace_re.split(value)
+        attrs[name] = value
+    return attrs
+
+
+def _table_node(soup, reader):
+    node_type = reader.uint()
+    if node_type == _NODE_ELEMENT or node_type == _NODE_TEMPLATE:
+        (namespace, flags, child_count, attr_count,
+         line, col, offset, end_line, end_col, end_offset) = reader.unpack(_ELEMENT_HEADER)
+        name = reader.string()
+        if flags & _EXPORT_UNKNOWN_TAG:
+            name = name.lower()
+        original = reader.string()
+        original_end_tag = reader.string()
+        tag = sigil_bs4.element.Tag(parser=soup,
+                                    name=name,
+                                    namespace=_NAMESPACES[namespace],
+                                    attrs=_table_attrs(reader, attr_count))
+        for i in range(child_count):
+            tag.append(_table_node(soup, reader))
+        tag.original = original
+        tag.line = line
+        tag.col = col
+        tag.offset = offset
+        tag.end_line = end_line
+        tag.end_col = end_col
+        tag.end_offset = end_offset
+        tag.original_end_tag = original_end_tag
+        return tag
+    line, col, offset = reader.unpack(_TEXT_HEADER)
+    text = _TEXT_CLASSES[node_type](reader.string())
+    text.original = reader.string()
+    text.line = line
+    text.col = col
+    text.offset = offset
+    return text
+
+
+def _parse_from_table(output):
+    reader = _TableReader(gumboc.export_tree(output.contents.document))
+    soup = sigil_bs4.BeautifulSoup('', "html.parser")
+    node_type = reader.uint()
+    has_doctype = reader.uint()
+    child_count = reader.uint()
+    name = reader.string()
+    pub_id = reader.string() or None
+    sys_id = reader.string() or None
+    if has_doctype:
+        doctype = sigil_bs4.element.Doctype.for_name_and_ids(name, pub_id, sys_id)
+        soup.object_was_parsed(doctype)
+    for i in range(child_count):
+        soup.append(_table_node(soup, reader))
+    return soup
+
+
 # The only input encoding that gumbo supports is utf-8
 # Any full unicode passed to the parser will be utf-8 encoded first
 # Also gumbo is an html5 parser and does not handle xml header declarations
@@ -163,6 +277,10 @@ def _add_next_prev_pointers(soup):
 # and added back when serialized or prettyprinted
 def parse(text, **kwargs):
     with gumboc.parse(text, **kwargs) as output:
+        if gumboc.has_export_tree():
+            soup = _parse_from_table(output)
+            _add_next_prev_pointers(soup.html)
+            return soup
         soup = sigil_bs4.BeautifulSoup('', "html.parser")
         _add_document(soup, output.contents.document.contents)
         for node in output.contents.document.contents.children:
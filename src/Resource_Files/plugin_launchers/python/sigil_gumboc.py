@@ -446,7 +446,33 @@ _tag_enum = _dll.gumbo_tag_enum
 _tag_enum.argtypes = [ctypes.c_char_p]
 _tag_enum.restype = Tag
 
+# an older library may not have the flat table export
+try:
+    _export_tree = _dll.gumbo_export_tree
+    _export_tree.argtypes = [_Ptr(Node), _Ptr(ctypes.c_size_t)]
+    _export_tree.restype = ctypes.c_void_p
+    _free_export = _dll.gumbo_free_export
+    _free_export.argtypes = [ctypes.c_void_p]
+    _free_export.restype = None
+except AttributeError:
+    _export_tree = None
+
+def has_export_tree():
+    return _export_tree is not None
+
+# Returns the tree below the node as the flat table described in
+# gumbo_export.h, in a single call into the library
+def export_tree(node):
+    length = ctypes.c_size_t(0)
+    table = _export_tree(node, ctypes.byref(length))
+    if table is None:
+        raise MemoryError('gumbo_export_tree ran out of memory')
+    try:
+        return ctypes.string_at(table, length.value)
+    finally:
+        _free_export(table)
+
 __all__ = ['StringPiece', 'SourcePosition', 'AttributeNamespace', 'Attribute',
            'Vector', 'AttributeVector', 'NodeVector', 'QuirksMode', 'Document',
            'Namespace', 'Tag', 'Element', 'Text', 'NodeType', 'Node',
-           'Options', 'Output', 'parse']
+           'Options', 'Output', 'parse', 'has_export_tree', 'export_tree']
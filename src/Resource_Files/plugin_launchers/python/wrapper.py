@@ -125,6 +125,7 @@ class Wrapper(object):
         self.colors = None
         self.using_automate = False
         self.automate_parameter = None
+        self.save_compression = None
         self.font_mangling = {}
         # File selected in Sigil's Book Browser
         self.selected = []
@@ -213,6 +214,10 @@ class Wrapper(object):
         self.modified = OrderedDict()
         self.added = []
         self.deleted = []
+        # in memory only mode written files are kept here by their
+        # path in outdir until flush_pending writes them all at once
+        self.memory_only = False
+        self.pending = OrderedDict()
 
         # walk the ebook directory tree building up initial list of
         # all unmanifested (other) files
@@ -623,6 +628,12 @@ class Wrapper(object):
         filepath = self.id_to_filepath.get(id, None)
         if filepath is None:
             raise WrapperException('Id does not exist in manifest')
+        mime = self.id_to_mime.get(id, '')
+        if filepath in self.pending:
+            data = self.pending[filepath]
+            if mime in TEXT_MIMETYPES:
+                data = _unicodestr(data)
+            return data
         # already added or modified it will be in outdir
         basedir = self.ebook_root
         if id in self.added or id in self.modified:
@@ -633,7 +644,6 @@ class Wrapper(object):
         data = ''
         with open(filepath, 'rb') as fp:
             data = fp.read()
-        mime = self.id_to_mime.get(id, '')
         if mime in TEXT_MIMETYPES:
             data = _unicodestr(data)
         return data
@@ -646,15 +656,55 @@ class Wrapper(object):
         if filepath is None:
             raise WrapperException('Id does not exist in manifest')
         mime = self.id_to_mime.get(id, '')
+        if mime in TEXT_MIMETYPES or isinstance(data, str):
+            data = _utf8str(data)
+        self._write_outdir_file(filepath, data)
+        self.modified[id] = 'file'
+
+    # reads many manifest files in one call, returns their contents
+    # in the order of the ids (text files are utf-8 decoded)
+    def readfiles(self, ids):
+        return [self.readfile(id) for id in ids]
+
+    # writes many manifest files in one call, id_data is a dictionary
+    # or a sequence of (manifest id, data) pairs
+    def writefiles(self, id_data):
+        if isinstance(id_data, dict):
+            id_data = id_data.items()
+        for id, data in id_data:
+            self.writefile(id, data)
+
+    # writes the file to its path in outdir or, in memory only mode,
+    # keeps it until flush_pending
+    def _write_outdir_file(self, filepath, data):
+        if self.memory_only:
+            self.pending[filepath] = data
+            return
+        self.pending.pop(filepath, None)
         filepath = os.path.join(self.outdir, filepath)
         base = os.path.dirname(filepath)
         if not os.path.exists(base):
             os.makedirs(base)
-        if mime in TEXT_MIMETYPES or isinstance(data, str):
-            data = _utf8str(data)
         with open(filepath, 'wb') as fp:
             fp.write(data)
-        self.modified[id] = 'file'
+
+    # in memory only mode written files are only shipped back to
+    # Sigil when the plugin is done or the mode is turned off
+    def set_memory_only(self, memory_only):
+        self.memory_only = bool(memory_only)
+        if not self.memory_only:
+            self.flush_pending()
+
+    def flush_pending(self):
+        pending = self.pending
+        self.pending = OrderedDict()
+        for filepath, data in pending.items():
+            filepath = os.path.join(self.outdir, filepath)
+            base = os.path.dirname(filepath)
+            if not os.path.exists(base):
+                os.makedirs(base)
+            with open(filepath, 'wb') as fp:
+                fp.write(data)
 
 
     def addfile(self, uniqueid, basename, data, mime=None, properties=None, fallback=None, overlay=None):
@@ -758,6 +808,7 @@ class Wrapper(object):
         if self.epub_version.startswith("2") and id == self.gettocid():
             raise WrapperException('Can not add or remove an ncx under epub2')
         add_to_deleted = True
+        self.pending.pop(filepath, None)
         # if file was added or modified, delete file from outdir
         if id in self.added or id in self.modified:
             filepath = os.path.join(self.outdir, filepath)
@@ -899,6 +950,11 @@ class Wrapper(object):
         filepath = self.book_href_to_filepath.get(id, None)
         if filepath is None:
             raise WrapperException('Book href does not exist')
+        if filepath in self.pending:
+            data = self.pending[filepath]
+            if self.getmime(id) in TEXT_MIMETYPES:
+                data = _unicodestr(data)
+            return data
         basedir = self.ebook_root
         if id in self.added or id in self.modified:
             basedir = self.outdir
@@ -928,14 +984,9 @@ class Wrapper(object):
             raise WrapperException('Book href does not exist')
         if id in PROTECTED_FILES or id == self.opfbookpath:
             raise WrapperException('Attempt to modify protected file')
-        filepath = os.path.join(self.outdir, filepath)
-        base = os.path.dirname(filepath)
-        if not os.path.exists(base):
-            os.makedirs(base)
         if isinstance(data, str):
             data = _utf8str(data)
-        with open(filepath, 'wb') as fp:
-            fp.write(data)
+        self._write_outdir_file(filepath, data)
         self.modified[id] = 'file'
 
     def addotherfile(self, book_href, data) :
@@ -973,6 +1024,7 @@ class Wrapper(object):
         if id in PROTECTED_FILES or id == self.opfbookpath:
             raise WrapperException('attempt to delete protected file')
         add_to_deleted = True
+        self.pending.pop(filepath, None)
         # if file was added or modified delete file from outdir
         if id in self.added or id in self.modified:
             filepath = os.path.join(self.outdir, filepath)
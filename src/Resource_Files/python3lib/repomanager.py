@@ -25,6 +25,7 @@ import sys
 import os
 import re
 import shutil
+import stat
 import datetime
 import time
 import io
@@ -81,6 +82,11 @@ _SKIP_CLEAN_LIST = [
 
 _SIGIL = b"Sigil <sigil@sigil-ebook.com>"
 
+# tag lists and log summaries keyed by repo path, each kept together
+# with the state of the refs it was built from
+_TAG_LIST_CACHE = {}
+_LOG_SUMMARY_CACHE = {}
+
 # convert string to utf-8
 def utf8_str(p, enc='utf-8'):
     if p is None:
@@ -180,6 +186,66 @@ def copy_book_contents_to_destination(book_home, filepaths, destdir):
     copied.append("mimetype")
     return copied
 
+# returns the indexes of the bookfiles whose blob ids differ from the ones
+# staged in the repo index, or None if the index can not be used
+def get_changed_vs_index(repo_path, bookfiles, bookhashes):
+    try:
+        index = Repo(repo_path).open_index()
+    except Exception:
+        return None
+    changed = []
+    for i, bkpath in enumerate(bookfiles):
+        ahash = bookhashes[i]
+        if not ahash:
+            return None
+        try:
+            staged = index.get_sha1(utf8_str(bkpath))
+        except KeyError:
+            staged = None
+        if staged != utf8_str(ahash):
+            changed.append(i)
+    return changed
+
+# HEAD and the tag refs are all the tag list and the log depend on,
+# editing a tag message gives the tag a new id
+def get_repo_state(r):
+    try:
+        head = r.refs[b"HEAD"]
+    except KeyError:
+        head = None
+    return (head, tuple(sorted(r.refs.as_dict(b"refs/tags").items())))
+
+# returns the blob id of every file in the tree keyed by its bookpath
+def get_tree_blob_ids(r, tree_id, prefix=""):
+    blob_ids = {}
+    for entry in r[tree_id].items():
+        apath = prefix + unicode_str(entry.path)
+        if stat.S_ISDIR(entry.mode):
+            blob_ids.update(get_tree_blob_ids(r, entry.sha, apath + "/"))
+        elif not stat.S_ISLNK(entry.mode) and entry.mode != 0o160000:
+            blob_ids[apath] = unicode_str(entry.sha)
+    return blob_ids
+
+# returns the commit a tag (or "HEAD") points to
+def get_tag_commit(r, tagname):
+    if tagname == "HEAD":
+        obj = r[b"HEAD"]
+    else:
+        obj = r[utf8_str("refs/tags/" + tagname)]
+    # if annotated tag get the commit it pointed to
+    if isinstance(obj, Tag):
+        obj = r[obj.object[1]]
+    return obj
+
+# the blob ids of the book files in a commit keyed by bookpath,
+# leaving out what walk_folder would skip in a checkout
+def get_book_blob_ids(r, commit):
+    blob_ids = get_tree_blob_ids(r, commit.tree)
+    for apath in list(blob_ids):
+        if apath.startswith(".git") or os.path.basename(apath) in _SKIP_CLEAN_LIST:
+            del blob_ids[apath]
+    return blob_ids
+
 def add_gitignore(repo_path):
     ignoredata = []
     ignoredata.append(".DS_Store")
@@ -278,6 +344,27 @@ def build_epub_from_folder_contents(foldpath, epub_filepath):
             outzip.write(pathof(filepath),pathof(file),zipfile.ZIP_DEFLATED)
     outzip.close()
 
+# same as build_epub_from_folder_contents for a checkout of the commit
+# but reads the blobs straight from the object store
+def build_epub_from_commit(r, commit, epub_filepath):
+    blob_ids = get_book_blob_ids(r, commit)
+    if 'mimetype' not in blob_ids:
+        raise Exception('mimetype file is missing')
+    date_time = time.localtime(commit.commit_time)[:6]
+    outzip = zipfile.ZipFile(pathof(epub_filepath), mode='w')
+    try:
+        zinfo = zipfile.ZipInfo('mimetype', date_time)
+        zinfo.compress_type = zipfile.ZIP_STORED
+        outzip.writestr(zinfo, r[utf8_str(blob_ids['mimetype'])].as_raw_string())
+        for apath in sorted(blob_ids):
+            if apath == 'mimetype' or not valid_file_to_copy(apath.replace("/", os.sep)):
+                continue
+            zinfo = zipfile.ZipInfo(apath, date_time)
+            zinfo.compress_type = zipfile.ZIP_DEFLATED
+            outzip.writestr(zinfo, r[utf8_str(blob_ids[apath])].as_raw_string())
+    finally:
+        outzip.close()
+
 # will lose any untracked or unstaged changes    
 # so add and commit to keep them before using this
 # repo_path here must be a full path
@@ -429,27 +516,19 @@ def generate_epub_from_tag(localRepo, bookid, tagname, filename, dest_path):
         if tagname not in taglst:
             return epub_file_path
 
-        # FIXME: there should **never** be unstaged changes or untracked files
-        # in the repo because of how Sigil handles it, but we really should use
-        # dulwich status to verify that before proceeding and abort otherwise.
-        # Just in case the user uses command line git to manipulate the repo 
-        # outside of Sigil's control leaving it in a dirty state
-
-        # Instead of cloning an entire repo just to do a checkout
-        # of a tag, do all work in the current repo
-        checkout_tag(repo_path, tagname)
-
-        # working directory of the repo should now be populated
+        # the epub is written straight from the tag's tree so
+        # the working directory of the repo is left alone
         epub_filepath = os.path.join(dest_path, epub_name)
+        os.chdir(repo_path)
         try:
-            build_epub_from_folder_contents(repo_path, epub_filepath)
+            with open_repo_closing(".") as r:
+                build_epub_from_commit(r, get_tag_commit(r, tagname), epub_filepath)
         except Exception as e:
             print("epub creation failed")
             print(str(e))
             epub_filepath = ""
             pass
-        # **always** restore the repo working directory HEAD before leaving
-        checkout_head(repo_path)
+        os.chdir(cdir)
     return epub_filepath
 
 
@@ -462,6 +541,11 @@ def get_tag_list(localRepo, bookid):
     if os.path.exists(repo_path):
         os.chdir(repo_path)
         with open_repo_closing(".") as r:
+            state = get_repo_state(r)
+            cached = _TAG_LIST_CACHE.get(os.path.abspath(repo_path))
+            if cached is not None and cached[0] == state:
+                os.chdir(cdir)
+                return list(cached[1])
             tags = sorted(r.refs.as_dict(b"refs/tags"))
             for atag in tags:
                 tagkey = b"refs/tags/" + atag
@@ -482,10 +566,11 @@ def get_tag_list(localRepo, bookid):
                     tag_date = time_str + " " + timezone_str
                     tag_message = unicode_str(obj.message)
                 taglst.append(tag_name + "|" + tag_date + "|" + tag_message)
+            _TAG_LIST_CACHE[os.path.abspath(repo_path)] = (state, list(taglst))
         os.chdir(cdir)
     return taglst
 
-def performCommit(localRepo, bookid, bookinfo, bookroot, bookfiles):
+def performCommit(localRepo, bookid, bookinfo, bookroot, bookfiles, bookhashes=None):
     has_error = False
     staged = []
     added=[]
@@ -529,17 +614,26 @@ def performCommit(localRepo, bookid, bookinfo, bookroot, bookfiles):
                     files_to_delete.append(afile)
         if len(files_to_delete) > 0:
             porcelain.rm(repo='.',paths=files_to_delete)
-        # copy over current files
-        copy_book_contents_to_destination(book_home, filepaths, repo_path)
-        (staged, unstaged, untracked) = porcelain.status(repo='.')
-        files_to_update = []
-        for afile in unstaged:
-            afile = pathof(afile)
-            files_to_update.append(afile)
-        for afile in untracked:
-            afile = pathof(afile)
-            files_to_update.append(afile)
-        (added, ignored) = porcelain.add(repo='.', paths=files_to_update)
+        changed = None
+        if bookhashes is not None and len(bookhashes) == len(bookfiles):
+            changed = get_changed_vs_index('.', bookfiles, bookhashes)
+        if changed is None:
+            # copy over current files
+            copy_book_contents_to_destination(book_home, filepaths, repo_path)
+            (staged, unstaged, untracked) = porcelain.status(repo='.')
+            files_to_update = []
+            for afile in unstaged:
+                afile = pathof(afile)
+                files_to_update.append(afile)
+            for afile in untracked:
+                afile = pathof(afile)
+                files_to_update.append(afile)
+        else:
+            # only copy over and stage the files whose contents changed
+            copy_book_contents_to_destination(book_home, [filepaths[i] for i in changed], repo_path)
+            files_to_update = [filepaths[i] for i in changed]
+        if len(files_to_update) > 0:
+            (added, ignored) = porcelain.add(repo='.', paths=files_to_update)
         commit_sha1 = porcelain.commit(repo='.',message=message, author=_SIGIL, committer=_SIGIL)
         # create annotated tags so we can get a date history
         tag = porcelain.tag_create(repo='.', tag=tagname, message=tagmessage, annotated=True, author=_SIGIL)
@@ -623,10 +717,17 @@ def generate_log_summary(localRepo, bookid):
     cdir = os.getcwd()
     if os.path.exists(repo_path):
         os.chdir(repo_path)
+        with open_repo_closing(".") as r:
+            state = get_repo_state(r)
+        cached = _LOG_SUMMARY_CACHE.get(os.path.abspath(repo_path))
+        if cached is not None and cached[0] == state:
+            os.chdir(cdir)
+            return cached[1]
         with StringIO() as sf:
             logsummary(repo=".", outstream=sf, stats=True)
             sf.seek(0)
             results = sf.getvalue()
+        _LOG_SUMMARY_CACHE[os.path.abspath(repo_path)] = (state, results)
         os.chdir(cdir)
     return results
 
@@ -673,34 +774,35 @@ def generate_unified_diff(path1, path2):
     return results
     
 
-def copy_tag_to_destdir(localRepo, bookid, tagname, destdir):
+# writes the files of the tag from the object store, without a checkout,
+# only the bookpaths given if any are
+def copy_tag_to_destdir(localRepo, bookid, tagname, destdir, bookpaths=None):
     # convert posix paths to os specific paths
     repo_home = pathof(localRepo)
     repo_home = repo_home.replace("/", os.sep)
     repo_path = os.path.join(repo_home, "epub_" + bookid)
     dest_path = pathof(destdir).replace("/", os.sep)
     copied = []
-    if tagname != "HEAD":
-        # checkout the proper base tag in the repo if needed
-        checkout_tag(repo_path, tagname)
-    # walk the list of files and copy them
-    repolist = walk_folder(repo_path)
-    for apath in repolist:
-        src = os.path.join(repo_path, apath)
-        dest = os.path.join(dest_path, apath)
-        # and make sure destination directory exists
-        base = os.path.dirname(dest)
-        if not os.path.exists(base):
-            os.makedirs(base)
-        data = b''
-        with open(src, 'rb') as f:
-            data = f.read()
-        with open(dest,'wb') as fp:
-            fp.write(data)
-        copied.append(apath)
-    # return the repo to its normal state if needed
-    if tagname != "HEAD":
-        checkout_head(repo_path)
+    if not os.path.exists(repo_path):
+        return ""
+    cdir = os.getcwd()
+    os.chdir(repo_path)
+    with open_repo_closing(".") as r:
+        blob_ids = get_book_blob_ids(r, get_tag_commit(r, tagname))
+        wanted = sorted(blob_ids)
+        if bookpaths:
+            wanted = [bkpath for bkpath in bookpaths if bkpath in blob_ids]
+        for bkpath in wanted:
+            apath = bkpath.replace("/", os.sep)
+            dest = os.path.join(dest_path, apath)
+            # and make sure destination directory exists
+            base = os.path.dirname(dest)
+            if not os.path.exists(base):
+                os.makedirs(base)
+            with open(dest,'wb') as fp:
+                fp.write(r[utf8_str(blob_ids[bkpath])].as_raw_string())
+            copied.append(apath)
+    os.chdir(cdir)
     return "\n".join(copied)
 
 
@@ -736,6 +838,40 @@ def get_current_status_vs_destdir(bookroot, bookfiles, destdir):
     return (deleted, added, modified)
 
 
+# Same as get_current_status_vs_destdir against a copy of the checkpoint,
+# but compares the git blob ids of the book files with the ones in the
+# checkpoint's tree so nothing is checked out or read from the repo.
+# A bookfile with no hash could not be read and is reported as added.
+def get_current_status_vs_tag(localRepo, bookid, tagname, bookfiles, bookhashes):
+    repo_home = pathof(localRepo)
+    repo_home = repo_home.replace("/", os.sep)
+    repo_path = os.path.join(repo_home, "epub_" + bookid)
+    deleted = []
+    added = []
+    modified = []
+    if not os.path.exists(repo_path):
+        return (deleted, added, modified)
+    cdir = os.getcwd()
+    os.chdir(repo_path)
+    with open_repo_closing(".") as r:
+        tree_ids = get_book_blob_ids(r, get_tag_commit(r, tagname))
+    os.chdir(cdir)
+    tree_ids.pop("mimetype", None)
+    bookset = set(bookfiles)
+    for apath in sorted(tree_ids):
+        if apath not in bookset:
+            deleted.append(apath)
+    for i, bkpath in enumerate(bookfiles):
+        if bkpath == "mimetype":
+            continue
+        ahash = bookhashes[i] if i < len(bookhashes) else ""
+        if bkpath not in tree_ids or not ahash:
+            added.append(bkpath)
+        elif ahash != tree_ids[bkpath]:
+            modified.append(bkpath)
+    return (deleted, added, modified)
+
+
 def update_annotated_tag_message(localRepo, bookid, tagname, newmessage):
     repo_home = pathof(localRepo)
     repo_home = repo_home.replace("/", os.sep)
@@ -36,24 +36,51 @@
 #include "ResourceObjects/HTMLResource.h"
 #include "ResourceObjects/NCXResource.h"
 #include "sigil_constants.h"
+#include "SourceUpdates/HTMLUpdatePlan.h"
 #include "SourceUpdates/AnchorUpdates.h"
 
 #define DBG if(0)
 
 void AnchorUpdates::UpdateAllAnchorsWithIDs(const QList<HTMLResource *> &html_resources)
 {
-    const QHash<QString, QString> &ID_locations = GetIDLocations(html_resources);
+    UpdateAllAnchorsWithIDs(html_resources, GetIDLocations(html_resources));
+}
+
+
+void AnchorUpdates::UpdateAllAnchorsWithIDs(const QList<HTMLResource *> &html_resources,
+                                            const QHash<QString, QString> &ID_locations)
+{
+    // The files the ids are in, worked out once rather than for every file
+    QSet<QString> bookpaths_impacted;
+    QString last_bookpath;
+    QHash<QString, QString>::const_iterator it;
+    for (it = ID_locations.constBegin(); it != ID_locations.constEnd(); ++it) {
+        // runs of ids share one file, so most are skipped without hashing
+        if (it.value() != last_bookpath) {
+            last_bookpath = it.value();
+            bookpaths_impacted.insert(last_bookpath);
+        }
+    }
     // The first file in the list is the orginating resource of the split
     QtConcurrent::blockingMap(html_resources, std::bind(UpdateAnchorsInOneFile, 
                                                         std::placeholders::_1, 
-                                                        ID_locations));
+                                                        std::cref(ID_locations),
+                                                        std::cref(bookpaths_impacted)));
 }
 
 
 void AnchorUpdates::UpdateExternalAnchors(const QList<HTMLResource *> &html_resources, const QString &originating_bookpath, const QList<HTMLResource *> new_files)
 {
-    const QHash<QString, QString> &ID_locations = GetIDLocations(new_files);
-    QtConcurrent::blockingMap(html_resources, std::bind(UpdateExternalAnchorsInOneFile, std::placeholders::_1, originating_bookpath, ID_locations));
+    UpdateExternalAnchors(html_resources, originating_bookpath, GetIDLocations(new_files));
+}
+
+
+void AnchorUpdates::UpdateExternalAnchors(const QList<HTMLResource *> &html_resources, const QString &originating_bookpath,
+                                          const QHash<QString, QString> &ID_locations)
+{
+    HTMLUpdatePlan plan;
+    plan.SetFragmentUpdates(originating_bookpath, ID_locations);
+    plan.ApplyToAllFiles(html_resources);
 }
 
 
@@ -63,29 +90,32 @@ void AnchorUpdates::UpdateAllAnchors(const QList<HTMLResource *> &html_resources
                                      HTMLResource *sink_res,
                                      const QHash<QString,QString> &section_id_map)
 {
-    QList<HTMLResource *> new_files;
-    new_files.append(sink_res);
     QString sink_bookpath = sink_res->GetRelativePath();
+    const QSet<QString> originating = QSet<QString>(originating_bookpaths.begin(), originating_bookpaths.end());
     QtConcurrent::blockingMap(html_resources, std::bind(UpdateAllAnchorsInOneFile, 
                                                         std::placeholders::_1,
-                                                        originating_bookpaths,
+                                                        std::cref(originating),
                                                         sink_bookpath,
-                                                        section_id_map));
+                                                        std::cref(section_id_map)));
 }
 
 
 QHash<QString, QString> AnchorUpdates::GetIDLocations(const QList<HTMLResource *> &html_resources)
 {
-    const QList<std::tuple<QString, QList<QString>>> &IDs_in_files = QtConcurrent::blockingMapped(html_resources, GetOneFileIDs);
+    // The workers only hand back the ids, the book path of each file
+    // is taken once here and shared by every id found in it
+    const QList<QStringList> IDs_in_files = QtConcurrent::blockingMapped(html_resources, GetOneFileIDs);
+    int count = 0;
+    foreach(const QStringList &file_element_IDs, IDs_in_files) {
+        count += file_element_IDs.count();
+    }
     QHash<QString, QString> ID_locations;
+    ID_locations.reserve(count);
 
     for (int i = 0; i < IDs_in_files.count(); ++i) {
-        QList<QString> file_element_IDs;
-        QString resource_bookpath;
-        std::tie(resource_bookpath, file_element_IDs) = IDs_in_files.at(i);
-
-        for (int j = 0; j < file_element_IDs.count(); ++j) {
-            ID_locations[ file_element_IDs.at(j) ] = resource_bookpath;
+        const QString resource_bookpath = html_resources.at(i)->GetRelativePath();
+        foreach(const QString &id, IDs_in_files.at(i)) {
+            ID_locations.insert(id, resource_bookpath);
         }
     }
 
@@ -93,7 +123,7 @@ QHash<QString, QString> AnchorUpdates::GetIDLocations(const QList<HTMLResource *
 }
 
 
-std::tuple<QString, QList<QString>> AnchorUpdates::GetOneFileIDs(HTMLResource *html_resource)
+QStringList AnchorUpdates::GetOneFileIDs(HTMLResource *html_resource)
 {
     Q_ASSERT(html_resource);
     QReadLocker locker(&html_resource->GetLock());
@@ -101,18 +131,17 @@ std::tuple<QString, QList<QString>> AnchorUpdates::GetOneFileIDs(HTMLResource *h
     QString version = html_resource->GetEpubVersion();
     GumboInterface gi = GumboInterface(newsource, version);
     gi.parse();
-    QList<QString> ids = gi.get_all_values_for_attribute(QString("id"));
-    return std::make_tuple(html_resource->GetRelativePath(), ids);
+    return gi.get_all_values_for_attribute(QString("id"));
 }
 
 
 void AnchorUpdates::UpdateAnchorsInOneFile(HTMLResource *html_resource,
-                                           const QHash<QString, QString> ID_locations)
+                                           const QHash<QString, QString> &ID_locations,
+                                           const QSet<QString> &bookpaths_impacted)
 {
     Q_ASSERT(html_resource);
     DBG qDebug() << "In UpdateAnchorsInOneFile: " << html_resource->GetRelativePath();
     DBG qDebug() << "ID_locations" << ID_locations;
-    QStringList bookpaths_impacted = ID_locations.values();
     DBG qDebug() << "bookpaths impacted: " << bookpaths_impacted;
     QWriteLocker locker(&html_resource->GetLock());
     QString version = html_resource->GetEpubVersion();
@@ -174,16 +203,11 @@ void AnchorUpdates::UpdateAnchorsInOneFile(HTMLResource *html_resource,
 }
 
 
-void AnchorUpdates::UpdateExternalAnchorsInOneFile(HTMLResource *html_resource, const QString &originating_bookpath, const QHash<QString, QString> ID_locations)
+bool AnchorUpdates::UpdateExternalAnchorsInTree(GumboInterface &gi, const QString &resource_bookpath, const QString &originating_bookpath, const QHash<QString, QString> &ID_locations)
 {
-    Q_ASSERT(html_resource);
-    DBG qDebug() << "UpdateExternalAnchorsInOneFile: " << html_resource->GetRelativePath() << originating_bookpath;
+    DBG qDebug() << "UpdateExternalAnchorsInTree: " << resource_bookpath << originating_bookpath;
     DBG qDebug() << "ID_locations: " << ID_locations;
-    QWriteLocker locker(&html_resource->GetLock());
-    QString version = html_resource->GetEpubVersion();
-    QString startdir = html_resource->GetFolder();
-    GumboInterface gi = GumboInterface(html_resource->GetText(), version);
-    gi.parse();
+    QString startdir = Utility::startingDir(resource_bookpath);
     const QList<GumboNode*> anchor_nodes = gi.get_all_nodes_with_tag(GUMBO_TAG_A);
 
     bool is_changed = false;
@@ -213,7 +237,7 @@ void AnchorUpdates::UpdateExternalAnchorsInOneFile(HTMLResource *html_resource,
                     target_bookpath = ID_locations.value(fragment_id);
                     DBG qDebug() << "....... NEW target_bookpath" << target_bookpath;
 
-                    QString attpath = Utility::buildRelativePath(html_resource->GetRelativePath(), target_bookpath);
+                    QString attpath = Utility::buildRelativePath(resource_bookpath, target_bookpath);
                     QString attribute_value = Utility::buildRelativeHREF(attpath, "#" + fragment_id);
                     DBG qDebug() << "....... attribute_value" << attribute_value;
 
@@ -223,10 +247,7 @@ void AnchorUpdates::UpdateExternalAnchorsInOneFile(HTMLResource *html_resource,
             }
         }
     }
-
-    if (is_changed) {
-        html_resource->SetText(CleanSource::CharToEntity(gi.getxhtml(), version));
-    }
+    return is_changed;
 }
 
 
@@ -235,7 +256,7 @@ void AnchorUpdates::UpdateExternalAnchorsInOneFile(HTMLResource *html_resource,
 // originating_bookpaths and change it to be in the sink resource which is a 
 // product of the merge
 void AnchorUpdates::UpdateAllAnchorsInOneFile(HTMLResource *html_resource,
-                                              const QList<QString> &originating_bookpaths,
+                                              const QSet<QString> &originating_bookpaths,
                                               const QString &sink_bookpath,
                                               const QHash<QString, QString> &section_id_map)
 {
@@ -286,10 +307,15 @@ void AnchorUpdates::UpdateAllAnchorsInOneFile(HTMLResource *html_resource,
 // use this after a split to update changed links in the NCX
 void AnchorUpdates::UpdateTOCEntries(NCXResource *ncx_resource, const QString &originating_bookpath, const QList<HTMLResource *> new_files)
 {
-    
+    UpdateTOCEntries(ncx_resource, originating_bookpath, GetIDLocations(new_files));
+}
+
+
+void AnchorUpdates::UpdateTOCEntries(NCXResource *ncx_resource, const QString &originating_bookpath,
+                                     const QHash<QString, QString> &ID_locations)
+{
     // this routine should only be run on epub2
     Q_ASSERT(ncx_resource);
-    const QHash<QString, QString> &ID_locations = GetIDLocations(new_files);
     // serialize the hash for passing to python
     QStringList dictkeys = ID_locations.keys();
     QStringList dictvals;
@@ -25,6 +25,7 @@
 
 class HTMLResource;
 class NCXResource;
+class GumboInterface;
 
 class AnchorUpdates
 {
@@ -33,6 +34,15 @@ public:
 
     static void UpdateAllAnchorsWithIDs(const QList<HTMLResource *> &html_resources);
 
+    /**
+     * As above but with the file each id is in already known.
+     *
+     * @param html_resources The files of the split, the originating resource first.
+     * @param ID_locations The bookpath of the file each id is now located in.
+     */
+    static void UpdateAllAnchorsWithIDs(const QList<HTMLResource *> &html_resources,
+                                        const QHash<QString, QString> &ID_locations);
+
     /**
      * Updates the anchors in html_resources that point to ids that were originally located in originating_filename
      * but are now distributed over the files referenced by new_files.
@@ -43,6 +53,9 @@ public:
      */
     static void UpdateExternalAnchors(const QList<HTMLResource *> &html_resources, const QString &originating_filename, const QList<HTMLResource *> new_files);
 
+    static void UpdateExternalAnchors(const QList<HTMLResource *> &html_resources, const QString &originating_filename,
+                                      const QHash<QString, QString> &ID_locations);
+
     /**
      * Updates the anchors in html_resources that point to ids that were originally located in originating_filenames
      * but are now merged into the file referenced by new_file. Updates both hrefs with and without fragment ids.
@@ -65,24 +78,45 @@ public:
      */
     static void UpdateTOCEntries(NCXResource *ncx_resource, const QString &originating_filename, const QList<HTMLResource *> new_files);
 
+    static void UpdateTOCEntries(NCXResource *ncx_resource, const QString &originating_filename,
+                                 const QHash<QString, QString> &ID_locations);
+
     static void UpdateTOCEntriesAfterMerge(NCXResource *ncx_resource, const QString &sink_filename, const QStringList &merged_filenames);
 
-private:
+    /**
+     * Does the work of UpdateExternalAnchors on the parsed tree of one file
+     * without serializing it so that it can be combined with other updates.
+     *
+     * @param gi The parsed file.
+     * @param resource_bookpath The bookpath of the parsed file.
+     * @param originating_filename The name of the original file for which references need to be reconciled.
+     * @param ID_locations The bookpath of the file each id is now located in.
+     * @return True if any href was changed.
+     */
+    static bool UpdateExternalAnchorsInTree(GumboInterface &gi, const QString &resource_bookpath,
+                                            const QString &originating_filename,
+                                            const QHash<QString, QString> &ID_locations);
 
+    /**
+     * Parses each of html_resources and returns the bookpath of the
+     * file each id is in.  An id found in more than one of them is
+     * given the last file it is in.
+     */
     static QHash<QString, QString> GetIDLocations(const QList<HTMLResource *> &html_resources);
 
-    static std::tuple<QString, QList<QString>> GetOneFileIDs(HTMLResource *html_resource);
+private:
+
+    // Runs in a worker thread.
+    static QStringList GetOneFileIDs(HTMLResource *html_resource);
 
+    // bookpaths_impacted is the set of the values of ID_locations
     static void UpdateAnchorsInOneFile(HTMLResource *html_resource,
-                                       const QHash<QString, QString> ID_locations);
-
-    static void UpdateExternalAnchorsInOneFile(HTMLResource *html_resource,
-                                               const QString &originating_filename,
-                                               const QHash<QString, QString> ID_locations);
+                                       const QHash<QString, QString> &ID_locations,
+                                       const QSet<QString> &bookpaths_impacted);
 
     // used for merges
     static void UpdateAllAnchorsInOneFile(HTMLResource *html_resource,
-                                          const QList<QString> &originating_filename_links,
+                                          const QSet<QString> &originating_filename_links,
                                           const QString &new_filename,
                                           const QHash<QString, QString> &section_id_map);
 };
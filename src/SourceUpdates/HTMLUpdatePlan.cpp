@@ -0,0 +1,182 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <functional>
+
+#include <QtCore/QtCore>
+#include <QtConcurrent/QtConcurrent>
+
+#include "BookManipulation/CleanSource.h"
+#include "Misc/Utility.h"
+#include "Parsers/GumboInterface.h"
+#include "ResourceObjects/HTMLResource.h"
+#include "SourceUpdates/AnchorUpdates.h"
+#include "SourceUpdates/HTMLUpdatePlan.h"
+
+HTMLUpdatePlan::HTMLUpdatePlan()
+    :
+    m_HasSourceUpdates(false),
+    m_HasFragmentUpdates(false),
+    m_HasStylesheetLinks(false),
+    m_HasJavascriptLinks(false),
+    m_HasLanguage(false)
+{
+}
+
+
+void HTMLUpdatePlan::SetSourceUpdates(const QHash<QString, QString> &html_updates,
+                                      const QHash<QString, QString> &css_updates)
+{
+    m_HasSourceUpdates = true;
+    m_HTMLUpdates = html_updates;
+    m_CSSUpdates = css_updates;
+}
+
+
+void HTMLUpdatePlan::SetFragmentUpdates(const QString &originating_bookpath,
+                                        const QHash<QString, QString> &id_locations)
+{
+    m_HasFragmentUpdates = true;
+    m_OriginatingBookPath = originating_bookpath;
+    m_IDLocations = id_locations;
+}
+
+
+void HTMLUpdatePlan::SetStylesheetLinks(const QStringList &stylesheets)
+{
+    m_HasStylesheetLinks = true;
+    m_Stylesheets = stylesheets;
+}
+
+
+void HTMLUpdatePlan::SetJavascriptLinks(const QStringList &javascripts)
+{
+    m_HasJavascriptLinks = true;
+    m_Javascripts = javascripts;
+}
+
+
+void HTMLUpdatePlan::SetLanguage(const QString &langcode)
+{
+    m_HasLanguage = true;
+    m_Language = langcode;
+}
+
+
+bool HTMLUpdatePlan::IsEmpty() const
+{
+    return !m_HasSourceUpdates && !m_HasFragmentUpdates && !m_HasStylesheetLinks && !m_HasJavascriptLinks &&
+           !m_HasLanguage;
+}
+
+
+QString HTMLUpdatePlan::Apply(const QString &source,
+                              const QString &currentpath,
+                              const QString &newbookpath,
+                              const QString &version,
+                              bool *changed) const
+{
+    if (changed) *changed = true;
+    QString newsource = source;
+    if (m_HasSourceUpdates) {
+        newsource = CleanSource::PreprocessSpecialCases(newsource);
+    }
+
+    GumboInterface gi = GumboInterface(newsource, version, m_HTMLUpdates, m_CSSUpdates);
+    gi.parse();
+
+    // fragments are fixed in the tree so the renames below still apply to them
+    bool fragments_changed = false;
+    if (m_HasFragmentUpdates) {
+        fragments_changed = AnchorUpdates::UpdateExternalAnchorsInTree(gi, currentpath, m_OriginatingBookPath, m_IDLocations);
+    }
+
+    bool language_changed = false;
+    if (m_HasLanguage) {
+        language_changed = HTMLResource::SetLanguageInTree(gi, version, m_Language);
+    }
+
+    if (m_HasStylesheetLinks) {
+        gi.queue_link_updates(BuildStylesheetLinks(newbookpath));
+    }
+    if (m_HasJavascriptLinks) {
+        gi.queue_javascript_updates(BuildJavascriptLinks(newbookpath));
+    }
+
+    if (m_HasSourceUpdates) {
+        newsource = gi.perform_source_updates(currentpath, newbookpath);
+    } else if (m_HasStylesheetLinks || m_HasJavascriptLinks || fragments_changed || language_changed) {
+        newsource = gi.perform_queued_updates();
+    } else {
+        if (changed) *changed = false;
+        return source;
+    }
+    return CleanSource::CharToEntity(newsource, version);
+}
+
+
+void HTMLUpdatePlan::ApplyToResource(HTMLResource *html_resource) const
+{
+    Q_ASSERT(html_resource);
+    QWriteLocker locker(&html_resource->GetLock());
+    bool changed = false;
+    QString newsource = Apply(html_resource->GetText(),
+                              html_resource->GetCurrentBookRelPath(),
+                              html_resource->GetRelativePath(),
+                              html_resource->GetEpubVersion(),
+                              &changed);
+    if (changed) {
+        html_resource->SetText(newsource);
+    }
+}
+
+
+void HTMLUpdatePlan::ApplyToAllFiles(const QList<HTMLResource *> &html_resources) const
+{
+    QtConcurrent::blockingMap(html_resources, std::bind(&HTMLUpdatePlan::ApplyToResource, this, std::placeholders::_1));
+}
+
+
+// The new links are relative to where the file will be once renamed
+QString HTMLUpdatePlan::BuildStylesheetLinks(const QString &newbookpath) const
+{
+    QString newcsslinks;
+    // m_Stylesheets is a list of stylesheet bookpaths
+    foreach(QString stylesheet, m_Stylesheets) {
+        QString ahref = Utility::buildRelativePath(newbookpath, m_HTMLUpdates.value(stylesheet, stylesheet));
+        ahref = Utility::URLEncodePath(ahref);
+        newcsslinks += "  <link href=\"" + ahref + "\" type=\"text/css\" rel=\"stylesheet\"/>\n";
+    }
+    return newcsslinks;
+}
+
+
+QString HTMLUpdatePlan::BuildJavascriptLinks(const QString &newbookpath) const
+{
+    QString newjslinks;
+    // m_Javascripts is a list of javascript bookpaths
+    foreach(QString javascript, m_Javascripts) {
+        QString ahref = Utility::buildRelativePath(newbookpath, m_HTMLUpdates.value(javascript, javascript));
+        ahref = Utility::URLEncodePath(ahref);
+        newjslinks += "  <script type=\"text/javascript\" src=\"" + ahref + "\" ></script>\n";
+    }
+    return newjslinks;
+}
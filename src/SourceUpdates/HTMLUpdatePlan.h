@@ -0,0 +1,131 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef HTMLUPDATEPLAN_H
+#define HTMLUPDATEPLAN_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+class HTMLResource;
+
+/**
+ * Collects the changes to be made to a set of html files so that
+ * all of them are made with a single parse and serialization of
+ * each file instead of one for every kind of change.
+ *
+ * All bookpaths given to the plan are the ones in use before any
+ * of its renames are made.
+ */
+class HTMLUpdatePlan
+{
+
+public:
+
+    HTMLUpdatePlan();
+
+    /**
+     * Bookpath renames, html_updates are used for hrefs and css_updates
+     * for urls in style attributes and style tags.
+     */
+    void SetSourceUpdates(const QHash<QString, QString> &html_updates,
+                          const QHash<QString, QString> &css_updates);
+
+    /**
+     * Hrefs to originating_bookpath#id are pointed at the file
+     * that id_locations says now holds the id.
+     */
+    void SetFragmentUpdates(const QString &originating_bookpath,
+                            const QHash<QString, QString> &id_locations);
+
+    /**
+     * The existing stylesheet links are replaced by links to stylesheets.
+     */
+    void SetStylesheetLinks(const QStringList &stylesheets);
+
+    /**
+     * The existing javascript links are replaced by links to javascripts.
+     */
+    void SetJavascriptLinks(const QStringList &javascripts);
+
+    /**
+     * The lang, xml:lang and dir attributes of the html element are
+     * set to match langcode, or removed when it is empty.
+     */
+    void SetLanguage(const QString &langcode);
+
+    bool IsEmpty() const;
+
+    /**
+     * Applies the plan to source, the text of the file at currentpath
+     * that will be at newbookpath once renamed.  Sets changed to false
+     * and returns source untouched when only fragments or the language
+     * are being updated and this file needs none of them.
+     */
+    QString Apply(const QString &source,
+                  const QString &currentpath,
+                  const QString &newbookpath,
+                  const QString &version,
+                  bool *changed = NULL) const;
+
+    /**
+     * Applies the plan to an html file and updates its text.
+     */
+    void ApplyToResource(HTMLResource *html_resource) const;
+
+    /**
+     * Applies the plan to every file in parallel.
+     */
+    void ApplyToAllFiles(const QList<HTMLResource *> &html_resources) const;
+
+private:
+
+    QString BuildStylesheetLinks(const QString &newbookpath) const;
+
+    QString BuildJavascriptLinks(const QString &newbookpath) const;
+
+
+    ///////////////////////////////
+    // PRIVATE MEMBER VARIABLES
+    ///////////////////////////////
+
+    bool m_HasSourceUpdates;
+    QHash<QString, QString> m_HTMLUpdates;
+    QHash<QString, QString> m_CSSUpdates;
+
+    bool m_HasFragmentUpdates;
+    QString m_OriginatingBookPath;
+    QHash<QString, QString> m_IDLocations;
+
+    bool m_HasStylesheetLinks;
+    QStringList m_Stylesheets;
+
+    bool m_HasJavascriptLinks;
+    QStringList m_Javascripts;
+
+    bool m_HasLanguage;
+    QString m_Language;
+};
+
+#endif // HTMLUPDATEPLAN_H
@@ -19,40 +19,16 @@
 **
 *************************************************************************/
 
-#include <functional>
-
 #include <QtCore/QtCore>
 #include <QtCore/QString>
-#include <QtConcurrent/QtConcurrent>
 
 #include "ResourceObjects/HTMLResource.h"
-#include "Misc/Utility.h"
-#include "Parsers/GumboInterface.h"
-#include "BookManipulation/CleanSource.h"
-#include "sigil_constants.h"
+#include "SourceUpdates/HTMLUpdatePlan.h"
 #include "SourceUpdates/JavascriptUpdates.h"
 
 void JavascriptUpdates::UpdateJavascriptsInAllFiles(const QList<HTMLResource *> &html_resources, const QList<QString> new_javascripts)
 {
-    QtConcurrent::blockingMap(html_resources, std::bind(UpdateJavascriptsInOneFile, std::placeholders::_1, new_javascripts));
-}
-
-void JavascriptUpdates::UpdateJavascriptsInOneFile(HTMLResource *html_resource, QList<QString> new_javascripts)
-{
-    Q_ASSERT(html_resource);
-
-    QString newjslinks;
-    // build the new javascript links, new_javascripts is a list of javascript bookpaths
-    foreach(QString javascript, new_javascripts) {
-        QString ahref = Utility::buildRelativePath(html_resource->GetRelativePath(), javascript);
-        ahref = Utility::URLEncodePath(ahref);
-        newjslinks += "  <script type=\"text/javascript\" src=\"" + ahref + "\" ></script>\n";
-    }
-    QWriteLocker locker(&html_resource->GetLock());
-    QString newsource = html_resource->GetText();
-    QString version = html_resource->GetEpubVersion();
-    GumboInterface gi = GumboInterface(newsource, version);
-    gi.parse();
-    newsource = gi.perform_javascript_updates(newjslinks);
-    html_resource->SetText(CleanSource::CharToEntity(newsource, version));
+    HTMLUpdatePlan plan;
+    plan.SetJavascriptLinks(new_javascripts);
+    plan.ApplyToAllFiles(html_resources);
 }
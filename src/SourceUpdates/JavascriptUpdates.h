@@ -40,9 +40,6 @@ public:
 
     static void UpdateJavascriptsInAllFiles(const QList<HTMLResource *> &html_resources, const QList<QString> new_javascripts);
 
-private:
-
-    static void UpdateJavascriptsInOneFile(HTMLResource *html_resource, const QList<QString> new_javascripts);
 };
 
 #endif // JAVASCRIPTUPDATES_H
@@ -0,0 +1,48 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#include <QtCore/QtCore>
+#include <QtCore/QString>
+
+#include "ResourceObjects/HTMLResource.h"
+#include "SourceUpdates/HTMLUpdatePlan.h"
+#include "SourceUpdates/LanguageUpdates.h"
+
+QList<HTMLResource *> LanguageUpdates::UpdateLanguageInAllFiles(const QList<HTMLResource *> &html_resources,
+                                                                const QString &langcode)
+{
+    QHash<HTMLResource *, quint64> revisions;
+    foreach(HTMLResource *html_resource, html_resources) {
+        revisions[html_resource] = html_resource->GetRevision();
+    }
+
+    HTMLUpdatePlan plan;
+    plan.SetLanguage(langcode);
+    plan.ApplyToAllFiles(html_resources);
+
+    QList<HTMLResource *> changed_resources;
+    foreach(HTMLResource *html_resource, html_resources) {
+        if (html_resource->GetRevision() != revisions.value(html_resource)) {
+            changed_resources.append(html_resource);
+        }
+    }
+    return changed_resources;
+}
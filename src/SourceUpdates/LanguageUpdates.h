@@ -0,0 +1,51 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef LANGUAGEUPDATES_H
+#define LANGUAGEUPDATES_H
+
+#include <QList>
+
+class HTMLResource;
+class QString;
+
+class LanguageUpdates
+{
+
+public:
+
+    /**
+     * Sets the language of html_resources by updating the lang, xml:lang
+     * and dir attributes of their html elements.  The files are rewritten
+     * in parallel and those that already have these attributes are left
+     * untouched, so only the caches of the rewritten files are dropped.
+     *
+     * @param html_resources A list of html files that need to be updated
+     * @param langcode The language code to set, empty to remove the language
+     * @return The files that were rewritten.
+     */
+    static QList<HTMLResource *> UpdateLanguageInAllFiles(const QList<HTMLResource *> &html_resources,
+                                                          const QString &langcode);
+
+};
+
+#endif // LANGUAGEUPDATES_H
@@ -42,9 +42,6 @@ public:
 
     static void UpdateLinksInAllFiles(const QList<HTMLResource *> &html_resources, const QList<QString> new_stylesheets);
 
-private:
-
-    static void UpdateLinksInOneFile(HTMLResource *html_resource, const QList<QString> new_stylesheets);
 };
 
 #endif // LINKUPDATES_H
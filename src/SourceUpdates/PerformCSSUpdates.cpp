@@ -27,6 +27,8 @@
 #include <QString>
 #include <QRegularExpression>
 #include <QRegularExpressionMatch>
+#include <QRegularExpressionMatchIterator>
+#include <QStringView>
 #include <QDebug>
 
 #include "Misc/Utility.h"
@@ -52,106 +54,96 @@ PerformCSSUpdates::PerformCSSUpdates(const QString &source,
 }
 
 
+// Compiled once and shared by every update, matching with a const
+// QRegularExpression is safe from the UniversalUpdates worker threads
+static const QRegularExpression REFERENCE(
+    "(?:(?:src|background|background-image|block|border|border-image|border-image-source|"
+    "content|cursor|list-style|list-style-image|mask|mask-image|(?:-webkit-)?shape-outside)\\s*:|"
+    "@import)\\s*"
+    "("
+    "[^;\\}]*"
+    ")"
+    "(?:;|\\})");
+
+static const QRegularExpression URLS(
+    "(?:"
+    "url\\([\"']?([^\\(\\)\"']*)[\"']?\\)"
+    ")");
+
+static const QRegularExpression IMPORTURLS(
+    "(?:"
+    "url\\([\"']?([^\\(\\)\"']*)[\"']?\\)"
+    "|"
+    "[\"']([^\\(\\)\"']*)[\"']"
+    ")");
+
+
 QString PerformCSSUpdates::operator()()
 {
-    QString result(m_Source);
     QString origDir = QFileInfo(m_CurrentPath).dir().path();
     QString destfile = QFileInfo(m_newbookpath).fileName();
-    const QList<QString> &keys = m_CSSUpdates.keys();
-    int num_keys = keys.count();
-    if (num_keys == 0) return result;
-
-    // Now parse the text once looking for keys and replacing them where needed
-    QRegularExpression reference(
-        "(?:(?:src|background|background-image|block|border|border-image|border-image-source|"
-        "content|cursor|list-style|list-style-image|mask|mask-image|(?:-webkit-)?shape-outside)\\s*:|"
-        "@import)\\s*"
-        "("
-        "[^;\\}]*"
-        ")"
-        "(?:;|\\})");
-
-    QRegularExpression urls(
-        "(?:"
-        "url\\([\"']?([^\\(\\)\"']*)[\"']?\\)"
-        ")");
+    if (m_CSSUpdates.isEmpty()) return m_Source;
 
-    QRegularExpression importurls(
-        "(?:"
-        "url\\([\"']?([^\\(\\)\"']*)[\"']?\\)"
-        "|"
-        "[\"']([^\\(\\)\"']*)[\"']"
-        ")");
+    // every url that can be updated needs one of these
+    if (!m_Source.contains("url(") && !m_Source.contains("@import")) return m_Source;
 
-    int start_index = 0;
-    int start_index_correction = 0;
-    QRegularExpressionMatch mo = reference.match(result, start_index);
-    // handle case if no initial match at all
-    if (!mo.hasMatch()) return result;
-    do {
-        bool changes_made = false;
-        for (int i = 1; i <= reference.captureCount(); ++i) {
+    // Walk the matches of the original text once, copying the text
+    // between them and the (possibly rewritten) fragments into result
+    QString result;
+    result.reserve(m_Source.length() + 256);
+    int copied_to = 0;
+    QRegularExpressionMatchIterator mi = REFERENCE.globalMatch(m_Source);
+    while (mi.hasNext()) {
+        QRegularExpressionMatch mo = mi.next();
+        for (int i = 1; i <= REFERENCE.captureCount(); ++i) {
             if (mo.captured(i).trimmed().isEmpty()) {
                 continue;
             }
-            DBG2 qDebug() << "start index is: " << QString::number(start_index);
-            DBG2 qDebug() << "i is: " << QString::number(i);
             DBG2 qDebug() << mo.captured(i) << " start: " << mo.capturedStart(i) << " len: " << mo.capturedLength(i);
             // Check the captured property attribute string fragment for multiple urls
-            int frag_start_index = 0;
-            int frag_index_correction = 0;
+            const QRegularExpression &urls = mo.captured().startsWith("@import", Qt::CaseInsensitive) ? IMPORTURLS : URLS;
             QString fragment = mo.captured(i);
-            if(mo.captured().startsWith("@import", Qt::CaseInsensitive)) {
-                DBG qDebug() << "Using alternate expression for @import urls";
-                DBG qDebug() << mo.captured();
-                urls.swap(importurls);
-            }
-            QRegularExpressionMatch frag_mo = urls.match(fragment, frag_start_index);
-            // only loop if at least one match was found
-            if (frag_mo.hasMatch()) {
-                DBG2 qDebug() << "urls.matches found " << QString::number(urls.captureCount());
-                do {
-                    for (int j = 1; j <= urls.captureCount(); ++j) {
-                        DBG2 qDebug() << "processing url match number: " << QString::number(j);
-                        DBG2 qDebug() << "frag_mo is: " << frag_mo.captured(j);
-                        if (frag_mo.captured(j).trimmed().isEmpty()) {
-                            continue;
-                        }
-                        QString apath = Utility::URLDecodePath(frag_mo.captured(j));
-                        QString dest_oldbkpath = Utility::buildBookPath(apath, origDir);
-                        // targets may not have moved but we may have
-                        QString dest_newbkpath = m_CSSUpdates.value(dest_oldbkpath,dest_oldbkpath);
-                        if (!dest_newbkpath.isEmpty() && !m_newbookpath.isEmpty()) {
-                            QString new_href = Utility::buildRelativePath(m_newbookpath, dest_newbkpath);
-                            if (new_href.isEmpty()) new_href = destfile;
-                            // Replace the old url with the new one
-                            // But only replace if string has changed. Otherwise any matched
-                            // quoted string content could potentially be unnecessarily url encoded.
-                            // The hope is to only encode urls that were actually modified by renames.
-                            if (new_href != frag_mo.captured(j)) {
-                                new_href = Utility::URLEncodePath(new_href);
-                                fragment.replace(frag_mo.capturedStart(j), frag_mo.capturedLength(j), new_href);
-                                frag_index_correction += new_href.length() - frag_mo.capturedLength(j);
-                                changes_made = true;
-                            }
+            QString new_fragment;
+            int frag_copied_to = 0;
+            bool changes_made = false;
+            QRegularExpressionMatchIterator fi = urls.globalMatch(fragment);
+            while (fi.hasNext()) {
+                QRegularExpressionMatch frag_mo = fi.next();
+                for (int j = 1; j <= urls.captureCount(); ++j) {
+                    DBG2 qDebug() << "frag_mo is: " << frag_mo.captured(j);
+                    if (frag_mo.captured(j).trimmed().isEmpty()) {
+                        continue;
+                    }
+                    QString apath = Utility::URLDecodePath(frag_mo.captured(j));
+                    QString dest_oldbkpath = Utility::buildBookPath(apath, origDir);
+                    // targets may not have moved but we may have
+                    QString dest_newbkpath = m_CSSUpdates.value(dest_oldbkpath,dest_oldbkpath);
+                    if (!dest_newbkpath.isEmpty() && !m_newbookpath.isEmpty()) {
+                        QString new_href = Utility::buildRelativePath(m_newbookpath, dest_newbkpath);
+                        if (new_href.isEmpty()) new_href = destfile;
+                        // Replace the old url with the new one
+                        // But only replace if string has changed. Otherwise any matched
+                        // quoted string content could potentially be unnecessarily url encoded.
+                        // The hope is to only encode urls that were actually modified by renames.
+                        if (new_href != frag_mo.captured(j)) {
+                            new_fragment.append(QStringView(fragment).mid(frag_copied_to, frag_mo.capturedStart(j) - frag_copied_to));
+                            new_fragment.append(Utility::URLEncodePath(new_href));
+                            frag_copied_to = frag_mo.capturedEnd(j);
+                            changes_made = true;
                         }
                     }
-                    frag_start_index = frag_mo.capturedEnd() + frag_index_correction;
-                    frag_index_correction = 0;
-                    frag_mo = urls.match(fragment, frag_start_index);
-                } while (frag_mo.hasMatch());
+                }
             }
             // Replace the original attribute string fragment with the new one
             if (changes_made) {
-                result.replace(mo.capturedStart(i), mo.capturedLength(i), fragment);
-                start_index_correction += fragment.length() - mo.capturedLength(i);
+                new_fragment.append(QStringView(fragment).mid(frag_copied_to));
+                result.append(QStringView(m_Source).mid(copied_to, mo.capturedStart(i) - copied_to));
+                result.append(new_fragment);
+                copied_to = mo.capturedEnd(i);
             }
-
         }
-        start_index = mo.capturedEnd() + start_index_correction;
-        start_index_correction = 0;
-        mo = reference.match(result, start_index);
-    } while (mo.hasMatch());
-
+    }
+    if (copied_to == 0) return m_Source;
+    result.append(QStringView(m_Source).mid(copied_to));
     return result;
 }
@@ -20,9 +20,7 @@
 **
 *************************************************************************/
 
-#include "Parsers/GumboInterface.h"
-#include "BookManipulation/CleanSource.h"
-#include "SourceUpdates/PerformCSSUpdates.h"
+#include "SourceUpdates/HTMLUpdatePlan.h"
 #include "SourceUpdates/PerformHTMLUpdates.h"
 
 PerformHTMLUpdates::PerformHTMLUpdates(const QString &source,
@@ -44,17 +42,8 @@ PerformHTMLUpdates::PerformHTMLUpdates(const QString &source,
 
 QString PerformHTMLUpdates::operator()()
 {
-    QString newsource = CleanSource::PreprocessSpecialCases(m_source);
-    { 
-        GumboInterface gi = GumboInterface(newsource, m_version, m_HTMLUpdates);
-        gi.parse();
-        newsource = gi.perform_source_updates(m_CurrentPath, m_newbookpath);
-    }
-    if (!m_CSSUpdates.isEmpty()) {
-        GumboInterface gi = GumboInterface(newsource, m_version, m_CSSUpdates);
-        gi.parse();
-        newsource = gi.perform_style_updates(m_CurrentPath, m_newbookpath);
-    }
-    return CleanSource::CharToEntity(newsource, m_version);
+    // href and style url updates are made in the same pass
+    HTMLUpdatePlan plan;
+    plan.SetSourceUpdates(m_HTMLUpdates, m_CSSUpdates);
+    return plan.Apply(m_source, m_CurrentPath, m_newbookpath, m_version);
 }
-
@@ -20,11 +20,15 @@
 **
 *************************************************************************/
 
-#include "EmbedPython/EmbeddedPython.h"
-#include <QFileInfo>
-#include <QDir>
+#include <QStringList>
 #include "Misc/Utility.h"
 #include "SourceUpdates/PerformNCXUpdates.h"
+#include "SourceUpdates/PerformXMLUpdates.h"
+
+// The tags and attributes of the NCX that hold links
+static const QStringList NCX_TAGS = QStringList() << "content";
+static const QStringList NCX_ATTRIBUTES = QStringList() << "src";
+
 
 PerformNCXUpdates::PerformNCXUpdates(const QString &source,
                                      const QString & newbookpath,
@@ -41,37 +45,5 @@ PerformNCXUpdates::PerformNCXUpdates(const QString &source,
 
 QString PerformNCXUpdates::operator()()
 {
-    QString newsource = m_source;
-
-    // serialize the hash for passing to python
-    QStringList dictkeys = m_XMLUpdates.keys();
-    QStringList dictvals;
-    foreach(QString key, dictkeys) {
-        dictvals.append(m_XMLUpdates.value(key));
-    }
-
-    int rv = 0;
-    QString error_traceback;
-
-    QList<QVariant> args;
-    args.append(QVariant(m_source));
-    args.append(QVariant(m_newbookpath));
-    args.append(QVariant(m_CurrentPath));
-    args.append(QVariant(dictkeys));
-    args.append(QVariant(dictvals));
-
-    EmbeddedPython * epython  = EmbeddedPython::instance();
-
-    QVariant res = epython->runInPython( QString("xmlprocessor"),
-                                         QString("performNCXSourceUpdates"),
-                                         args,
-                                         &rv,
-                                         error_traceback);    
-    if (rv != 0) {
-        Utility::DisplayStdWarningDialog(QString("error in xmlprocessor performNCXSourceUpdates: ") + QString::number(rv), 
-                                     error_traceback);
-        // an error happened - make no changes
-        return newsource;
-    }
-    return res.toString();
+    return PerformXMLUpdates::UpdateLinks(m_source, m_newbookpath, m_XMLUpdates, m_CurrentPath, NCX_TAGS, NCX_ATTRIBUTES);
 }
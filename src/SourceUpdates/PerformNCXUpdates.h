@@ -24,7 +24,13 @@
 #ifndef PERFORMNCXUPDATES_H
 #define PERFORMNCXUPDATES_H
 
+#include <QtCore/QHash>
 
+class QString;
+
+/**
+ * Performs path updates on the NCX.
+ */
 class PerformNCXUpdates
 {
 
@@ -20,12 +20,14 @@
 **
 *************************************************************************/
 
-#include "EmbedPython/EmbeddedPython.h"
 #include <QStringList>
-#include <QFileInfo>
-#include <QDir>
 #include "Misc/Utility.h"
 #include "SourceUpdates/PerformOPFUpdates.h"
+#include "SourceUpdates/PerformXMLUpdates.h"
+
+// The tags and attributes of the OPF that hold links
+static const QStringList OPF_TAGS = QStringList() << "link" << "item" << "reference" << "site";
+static const QStringList OPF_ATTRIBUTES = QStringList() << "href";
 
 
 PerformOPFUpdates::PerformOPFUpdates(const QString &source,
@@ -43,37 +45,5 @@ PerformOPFUpdates::PerformOPFUpdates(const QString &source,
 
 QString PerformOPFUpdates::operator()()
 {
-    QString newsource = m_source;
-
-    // serialize the hash for passing to python
-    QStringList dictkeys = m_XMLUpdates.keys();
-    QStringList dictvals;
-    foreach(QString key, dictkeys) {
-        dictvals.append(m_XMLUpdates.value(key));
-    }
-
-    int rv = 0;
-    QString error_traceback;
-
-    QList<QVariant> args;
-    args.append(QVariant(m_source));
-    args.append(QVariant(m_newbookpath));
-    args.append(QVariant(m_CurrentPath));
-    args.append(QVariant(dictkeys));
-    args.append(QVariant(dictvals));
-
-    EmbeddedPython * epython  = EmbeddedPython::instance();
-
-    QVariant res = epython->runInPython( QString("xmlprocessor"),
-                                         QString("performOPFSourceUpdates"),
-                                         args,
-                                         &rv,
-                                         error_traceback);    
-    if (rv != 0) {
-        Utility::DisplayStdWarningDialog(QString("error in xmlprocessor performOPFSourceUpdates: ") + QString::number(rv), 
-                                     error_traceback);
-        // an error happened - make no changes
-        return newsource;
-    }
-    return res.toString();
+    return PerformXMLUpdates::UpdateLinks(m_source, m_newbookpath, m_XMLUpdates, m_CurrentPath, OPF_TAGS, OPF_ATTRIBUTES);
 }
@@ -24,7 +24,13 @@
 #ifndef PERFORMOPFUPDATES_H
 #define PERFORMOPFUPDATES_H
 
+#include <QtCore/QHash>
 
+class QString;
+
+/**
+ * Performs path updates on the OPF.
+ */
 class PerformOPFUpdates
 {
 
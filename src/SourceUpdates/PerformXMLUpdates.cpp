@@ -20,15 +20,24 @@
 **
 *************************************************************************/
 
-#include "EmbedPython/EmbeddedPython.h"
+#include <algorithm>
+
 #include <QFileInfo>
 #include <QDir>
 #include <QStringList>
+#include <QStringView>
 
 #include "Misc/Utility.h"
+#include "Parsers/TagLister.h"
 #include "SourceUpdates/PerformXMLUpdates.h"
 #include "sigil_constants.h"
 
+// The tags and attributes that hold links in each kind of xml file
+static const QStringList SMIL_TAGS = QStringList() << "body" << "seq" << "text" << "audio" << "smil" << "par";
+static const QStringList SMIL_ATTRIBUTES = QStringList() << "src" << "epub:textref";
+static const QStringList PAGE_MAP_TAGS = QStringList() << "page";
+static const QStringList PAGE_MAP_ATTRIBUTES = QStringList() << "href";
+
 
 PerformXMLUpdates::PerformXMLUpdates(const QString &source,
                                      const QString &newbookpath,
@@ -47,60 +56,101 @@ PerformXMLUpdates::PerformXMLUpdates(const QString &source,
 
 QString PerformXMLUpdates::operator()()
 {
-    QString newsource = m_Source;
-
-    // serialize the hash for passing to python
-    QStringList dictkeys = m_XMLUpdates.keys();
-    QStringList dictvals;
-    foreach(QString key, dictkeys) {
-        dictvals.append(m_XMLUpdates.value(key));
-    }
-
-    int rv = 0;
-    QString error_traceback;
-
-    QList<QVariant> args;
-    args.append(QVariant(newsource));
-    args.append(QVariant(m_newbookpath));
-    args.append(QVariant(m_CurrentPath));
-    args.append(QVariant(dictkeys));
-    args.append(QVariant(dictvals));
-
-    QString routine;
-
     // MISC_XML_MIMETYPES is defined in BookManipulation/FolderKeeper.cpp and sigil_constants.h
     if (MISC_XML_MIMETYPES.contains(m_MediaType)) {
         if (m_MediaType == "application/smil+xml") {
-            routine = "performSMILUpdates";
+            return UpdateLinks(m_Source, m_newbookpath, m_XMLUpdates, m_CurrentPath, SMIL_TAGS, SMIL_ATTRIBUTES);
         } else if ((m_MediaType == "application/oebps-page-map+xml") || 
            (m_MediaType == "application/vnd.adobe-page-map+xml"))  {
-            routine = "performPageMapUpdates";
-        } else {
-            // We allow editing, but currently have no python parsing/repair/link-updating routines. 
-            // Make no changes.
-            // application/adobe-page-template+xml, application/vnd.adobe-page-template+xml, "application/pls+xml"
-            return newsource;
+            return UpdateLinks(m_Source, m_newbookpath, m_XMLUpdates, m_CurrentPath, PAGE_MAP_TAGS, PAGE_MAP_ATTRIBUTES);
         }
-    // Utterly unsupported XML mimetypes
-    } else {
-        Utility::DisplayStdWarningDialog(QString("Unsupported XML media-type: ") + m_MediaType); 
-        // make no changes
-        return newsource;
+        // We allow editing, but currently have no parsing/repair/link-updating routines. 
+        // Make no changes.
+        // application/adobe-page-template+xml, application/vnd.adobe-page-template+xml, "application/pls+xml"
+        return m_Source;
     }
 
-    EmbeddedPython * epython  = EmbeddedPython::instance();
+    // Utterly unsupported XML mimetypes
+    Utility::DisplayStdWarningDialog(QString("Unsupported XML media-type: ") + m_MediaType); 
+    // make no changes
+    return m_Source;
+}
+
 
-    QVariant res = epython->runInPython( QString("xmlprocessor"),
-                                         routine,
-                                         args,
-                                         &rv,
-                                         error_traceback);    
-    if (rv != 0) {
-        Utility::DisplayStdWarningDialog(QString("error in xmlprocessor performXMLUpdates: ") + QString::number(rv), 
-                                     error_traceback);
-        // an error happened - make no changes
-        return newsource;
+QString PerformXMLUpdates::UpdateLinks(const QString &source,
+                                       const QString &newbookpath,
+                                       const QHash<QString, QString> &xml_updates,
+                                       const QString &currentpath,
+                                       const QStringList &tags,
+                                       const QStringList &attributes)
+{
+    // Only the attribute values are replaced, the rest of the
+    // source is left exactly as it is
+    struct Replacement {
+        int pos;
+        int len;
+        QString value;
+    };
+    QList<Replacement> replacements;
+    QString olddir = Utility::startingDir(currentpath);
+    TagLister taglist(source);
+
+    for (size_t i = 0; i < taglist.size(); ++i) {
+        TagLister::TagInfo ti = taglist.at(i);
+        if (((ti.ttype != "begin") && (ti.ttype != "single")) || !tags.contains(ti.tname)) {
+            continue;
+        }
+        QStringView tagstring = QStringView(source).mid(ti.pos, ti.len);
+        QList<Replacement> in_tag;
+        foreach(QString attribute, attributes) {
+            TagLister::AttInfo ainfo;
+            TagLister::parseAttribute(tagstring, attribute, ainfo);
+            if (ainfo.vpos < 0) {
+                continue;
+            }
+            QString ref = Utility::DecodeXML(ainfo.avalue);
+            // leave external links and links within the file alone
+            if (ref.contains(':') || ref.startsWith('#') || ref.isEmpty()) {
+                continue;
+            }
+            QString apath = Utility::URLDecodePath(ref.section('#', 0, 0));
+            QString fragment;
+            if (ref.contains('#')) {
+                fragment = Utility::URLDecodePath(ref.section('#', 1, 1));
+            }
+            QString oldtarget = Utility::buildBookPath(apath, olddir);
+            QString newtarget = xml_updates.value(oldtarget, oldtarget);
+            QString newref = Utility::URLEncodePath(Utility::buildRelativePath(newbookpath, newtarget));
+            if (!fragment.isEmpty()) {
+                newref = newref + "#" + Utility::URLEncodePath(fragment);
+            }
+            if (newref != ref) {
+                Replacement replacement;
+                replacement.pos = ti.pos + ainfo.vpos;
+                replacement.len = ainfo.vlen;
+                replacement.value = Utility::EncodeXML(newref);
+                in_tag << replacement;
+            }
+        }
+        // the attributes of a tag are not found in source order
+        std::sort(in_tag.begin(), in_tag.end(), [](const Replacement &a, const Replacement &b) {
+            return a.pos < b.pos;
+        });
+        replacements.append(in_tag);
+    }
+
+    if (replacements.isEmpty()) {
+        return source;
     }
 
-    return res.toString();
+    QString newsource;
+    newsource.reserve(source.length());
+    int pos = 0;
+    foreach(const Replacement &replacement, replacements) {
+        newsource.append(QStringView(source).mid(pos, replacement.pos - pos));
+        newsource.append(replacement.value);
+        pos = replacement.pos + replacement.len;
+    }
+    newsource.append(QStringView(source).mid(pos));
+    return newsource;
 }
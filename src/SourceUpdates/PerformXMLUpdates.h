@@ -27,9 +27,12 @@
 #include <QtCore/QHash>
 
 class QString;
+class QStringList;
 
 /**
  * Performs path updates on XML documents.
+ * Only the values of the links in SMIL and page-map files are
+ * rewritten, so the updates can run on any thread.
  */
 class PerformXMLUpdates
 {
@@ -45,6 +48,26 @@ public:
 
     QString operator()();
 
+    /**
+     * Rewrites the links held in the given attributes of the given
+     * tags of an xml document, leaving the rest of it as it is.
+     * Also used for the NCX and the OPF.
+     *
+     * @param source The document.
+     * @param newbookpath The book path of the document now.
+     * @param xml_updates The new book paths keyed by the old ones.
+     * @param currentpath The book path the links are relative to.
+     * @param tags The names of the tags with links.
+     * @param attributes The names of the attributes with links.
+     * @return The updated document.
+     */
+    static QString UpdateLinks(const QString &source,
+                               const QString &newbookpath,
+                               const QHash<QString, QString> &xml_updates,
+                               const QString &currentpath,
+                               const QStringList &tags,
+                               const QStringList &attributes);
+
 
 private:
     const QString &m_Source;
@@ -29,9 +29,11 @@
 #include <QRegularExpression>
 
 #include "BookManipulation/CleanSource.h"
+#include "BookManipulation/ReferenceIndex.h"
 #include "BookManipulation/XhtmlDoc.h"
 #include "Misc/HTMLEncodingResolver.h"
 #include "Misc/SettingsStore.h"
+#include "Misc/Trace.h"
 #include "Misc/Utility.h"
 #include "ResourceObjects/OPFResource.h"
 #include "ResourceObjects/NCXResource.h"
@@ -53,8 +55,11 @@
 QStringList UniversalUpdates::PerformUniversalUpdates(bool resources_already_loaded,
         const QList<Resource *> &resources,
         const QHash<QString, QString> &updates,
-        const QList<XMLResource *> &non_well_formed)
+        const QList<XMLResource *> &non_well_formed,
+        ReferenceIndex *reference_index)
 {
+    TRACE_SPAN(span, "UniversalUpdates::PerformUniversalUpdates");
+    TRACE_ARG(span, "updates", updates.count());
     QStringList updatekeys = updates.keys();
     QHash<QString, QString> html_updates;
     QHash<QString, QString> css_updates;
@@ -86,39 +91,52 @@ QStringList UniversalUpdates::PerformUniversalUpdates(bool resources_already_loa
     QFutureSynchronizer<void> sync;
     QFuture<QString> html_future;
     QFuture<void> css_future;
+    QFuture<void> xml_future;
 
     if (resources_already_loaded) {
+        if (reference_index) {
+            html_resources = reference_index->GetFilesAffectedBy(html_resources, updatekeys);
+        }
         html_future = QtConcurrent::mapped(html_resources, std::bind(UpdateOneHTMLFile, std::placeholders::_1, html_updates, css_updates));
         css_future = QtConcurrent::map(css_resources,  std::bind(UpdateOneCSSFile,  std::placeholders::_1, css_updates));
     } else {
         html_future = QtConcurrent::mapped(html_resources, std::bind(LoadAndUpdateOneHTMLFile, std::placeholders::_1, html_updates, css_updates, non_well_formed));
         css_future = QtConcurrent::map(css_resources,  std::bind(LoadAndUpdateOneCSSFile,  std::placeholders::_1, css_updates));
     }
+    xml_future = QtConcurrent::map(xml_resources, std::bind(UpdateOneXMLFile, std::placeholders::_1, xml_updates));
+    TRACE_ARG(span, "html_files", html_resources.count());
+    TRACE_ARG(span, "css_files", css_resources.count());
+    TRACE_ARG(span, "xml_files", xml_resources.count());
     sync.addFuture(QFuture<void>(html_future));
     sync.addFuture(css_future);
+    sync.addFuture(xml_future);
 
-    sync.waitForFinished();
+    // The links of the ncx and opf are worked out alongside
+    QFuture<QString> ncx_future;
+    QFuture<QString> opf_future;
+    if (ncx_resource) {
+        ncx_future = QtConcurrent::run(UpdatedNCXSource, ncx_resource, xml_updates);
+        sync.addFuture(QFuture<void>(ncx_future));
+    }
+    if (opf_resource) {
+        opf_future = QtConcurrent::run(UpdatedOPFSource, opf_resource, xml_updates);
+        sync.addFuture(QFuture<void>(opf_future));
+    }
+
+    {
+        TRACE_SPAN(phase, "UniversalUpdates::UpdateHTMLAndCSS");
+        sync.waitForFinished();
+    }
 
-    // We can't schedule these with QtConcurrent because they
+    // We can't set these with QtConcurrent because they
     // will (indirectly) call QTextDocument::setPlainText, and if
     // a tab is open for the ncx/opf, then an event needs to be sent
     // to the tab widget. Events can't cross threads, and we crash.
-    QString ncx_result;
     if (ncx_resource) {
-        ncx_result = UpdateNCXFile(ncx_resource, xml_updates);
+        UpdateNCXFile(ncx_resource, ncx_future.result());
     }
-    const QString opf_result = UpdateOPFFile(opf_resource, xml_updates);
-
-    // Handle other xml resources one by one since done in Embedded Python
-    foreach(XMLResource * xml_resource, xml_resources) {
-        QString mtype = xml_resource->GetMediaType();
-        QString currentpath = xml_resource->GetCurrentBookRelPath();
-        QString new_bookpath = xml_resource->GetRelativePath();
-        QString version = xml_resource->GetEpubVersion();
-        const QString &source = Utility::ReadUnicodeTextFile(xml_resource->GetFullPath());
-        xml_resource->SetText(PerformXMLUpdates(source, new_bookpath, xml_updates, currentpath, mtype)());
-        xml_resource->SetCurrentBookRelPath("");
-        xml_resource->SaveToDisk();
+    if (opf_resource) {
+        UpdateOPFFile(opf_resource, opf_future.result());
     }
 
     // Now assemble our list of errors if any.
@@ -132,14 +150,6 @@ QStringList UniversalUpdates::PerformUniversalUpdates(bool resources_already_loa
         }
     }
 
-    if (!ncx_result.isEmpty()) {
-        load_update_errors.append(ncx_result);
-    }
-
-    if (!opf_result.isEmpty()) {
-        load_update_errors.append(opf_result);
-    }
-
     return load_update_errors;
 }
 
@@ -227,6 +237,25 @@ void UniversalUpdates::UpdateOneCSSFile(CSSResource *css_resource,
 }
 
 
+void UniversalUpdates::UpdateOneXMLFile(XMLResource *xml_resource,
+                                        const QHash<QString, QString> &xml_updates)
+{
+    if (!xml_resource) {
+        return;
+    }
+    QWriteLocker locker(&xml_resource->GetLock());
+    QString mtype = xml_resource->GetMediaType();
+    QString currentpath = xml_resource->GetCurrentBookRelPath();
+    QString new_bookpath = xml_resource->GetRelativePath();
+    // text already in memory is used as it is, the rest is read from disk
+    const QString source = xml_resource->IsLoaded() ? xml_resource->GetText() :
+                           Utility::ReadUnicodeTextFile(xml_resource->GetFullPath());
+    xml_resource->SetText(PerformXMLUpdates(source, new_bookpath, xml_updates, currentpath, mtype)());
+    xml_resource->SetCurrentBookRelPath("");
+    xml_resource->SaveToDisk();
+}
+
+
 QString UniversalUpdates::LoadAndUpdateOneHTMLFile(HTMLResource *html_resource,
         const QHash<QString, QString> &html_updates,
         const QHash<QString, QString> &css_updates,
@@ -300,52 +329,37 @@ void UniversalUpdates::LoadAndUpdateOneCSSFile(CSSResource *css_resource,
 }
 
 
-QString UniversalUpdates::UpdateOPFFile(OPFResource *opf_resource,
-                                        const QHash<QString, QString> &xml_updates)
+QString UniversalUpdates::UpdatedOPFSource(OPFResource *opf_resource,
+                                           const QHash<QString, QString> &xml_updates)
 {
-    if (!opf_resource) {
-        return QString();
-    }
-
-    QWriteLocker locker(&opf_resource->GetLock());
-    const QString &source = opf_resource->GetText();
+    QReadLocker locker(&opf_resource->GetLock());
     QString currentpath = opf_resource->GetCurrentBookRelPath();
     QString new_bookpath = opf_resource->GetRelativePath();
-    try {
-        QString newsource = PerformOPFUpdates(source, new_bookpath, xml_updates, currentpath)();
-        opf_resource->SetText(newsource);
-        opf_resource->SetCurrentBookRelPath("");
-        return QString();
-    } catch (ErrorBuildingDOM&) {
-        // It would be great if we could just let this exception bubble up,
-        // but we can't since QtConcurrent doesn't let exceptions cross threads.
-        // So we just leave the old source in the resource.
-        return QString(QObject::tr("Invalid OPF file: %1")).arg(opf_resource->GetRelativePath());
-    }
+    return PerformOPFUpdates(opf_resource->GetText(), new_bookpath, xml_updates, currentpath)();
 }
 
 
-QString UniversalUpdates::UpdateNCXFile(NCXResource *ncx_resource,
-                                        const QHash<QString, QString> &xml_updates)
+QString UniversalUpdates::UpdatedNCXSource(NCXResource *ncx_resource,
+                                           const QHash<QString, QString> &xml_updates)
 {
-    if (!ncx_resource) {
-        return QString();
-    }
-
-    QWriteLocker locker(&ncx_resource->GetLock());
-    const QString &source = ncx_resource->GetText();
+    QReadLocker locker(&ncx_resource->GetLock());
     QString currentpath = ncx_resource->GetCurrentBookRelPath();
     QString new_bookpath = ncx_resource->GetRelativePath();
+    return PerformNCXUpdates(ncx_resource->GetText(), new_bookpath, xml_updates, currentpath)();
+}
 
-    try {
-        QString newsource = PerformNCXUpdates(source, new_bookpath, xml_updates, currentpath)();
-        ncx_resource->SetText(CleanSource::PrettifyDOCTYPEHeader(newsource));
-        ncx_resource->SetCurrentBookRelPath("");
-        return QString();
-    } catch (ErrorBuildingDOM&) {
-        // It would be great if we could just let this exception bubble up,
-        // but we can't since QtConcurrent doesn't let exceptions cross threads.
-        // So we just leave the old source in the resource.
-        return QString(QObject::tr("Invalid NCX file: %1")).arg(ncx_resource->GetRelativePath());
-    }
+
+void UniversalUpdates::UpdateOPFFile(OPFResource *opf_resource, const QString &newsource)
+{
+    QWriteLocker locker(&opf_resource->GetLock());
+    opf_resource->SetText(newsource);
+    opf_resource->SetCurrentBookRelPath("");
+}
+
+
+void UniversalUpdates::UpdateNCXFile(NCXResource *ncx_resource, const QString &newsource)
+{
+    QWriteLocker locker(&ncx_resource->GetLock());
+    ncx_resource->SetText(CleanSource::PrettifyDOCTYPEHeader(newsource));
+    ncx_resource->SetCurrentBookRelPath("");
 }
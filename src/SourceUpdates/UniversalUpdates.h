@@ -29,6 +29,7 @@ class XMLResource;
 class NCXResource;
 class OPFResource;
 class Resource;
+class ReferenceIndex;
 
 
 class UniversalUpdates
@@ -37,10 +38,13 @@ class UniversalUpdates
 public:
 
     // Returns a list of errors if any that occurred while loading.
+    // When a reference_index is given only the html files it finds
+    // are affected by the updates are updated.
     static QStringList PerformUniversalUpdates(bool resources_already_loaded,
             const QList<Resource *> &resources,
             const QHash<QString, QString> &updates,
-            const QList<XMLResource *> &non_well_formed=QList<XMLResource *>());
+            const QList<XMLResource *> &non_well_formed=QList<XMLResource *>(),
+            ReferenceIndex *reference_index=NULL);
 
     static std::tuple <QHash<QString, QString>,
            QHash<QString, QString>,
@@ -59,16 +63,24 @@ private:
     static void UpdateOneCSSFile(CSSResource *css_resource,
                                  const QHash<QString, QString> &css_updates);
 
+    static void UpdateOneXMLFile(XMLResource *xml_resource,
+                                 const QHash<QString, QString> &xml_updates);
+
     static QString LoadAndUpdateOneHTMLFile(HTMLResource *html_resource,
                                             const QHash<QString, QString> &html_updates,
                                             const QHash<QString, QString> &css_updates,
                                             const QList<XMLResource *> &non_well_formed=QList<XMLResource *>());
 
-    static QString UpdateOPFFile(OPFResource *opf_resource,
-                                 const QHash<QString, QString> &xml_updates);
+    // Run in a worker thread, the text is set by UpdateOPFFile/UpdateNCXFile
+    static QString UpdatedOPFSource(OPFResource *opf_resource,
+                                    const QHash<QString, QString> &xml_updates);
 
-    static QString UpdateNCXFile(NCXResource *ncx_resource,
-                                 const QHash<QString, QString> &xml_updates);
+    static QString UpdatedNCXSource(NCXResource *ncx_resource,
+                                    const QHash<QString, QString> &xml_updates);
+
+    static void UpdateOPFFile(OPFResource *opf_resource, const QString &newsource);
+
+    static void UpdateNCXFile(NCXResource *ncx_resource, const QString &newsource);
 };
 
 #endif // UNIVERSALUPDATES_H
@@ -36,27 +36,53 @@ void WordUpdates::UpdateWordInAllFiles(const QList<HTMLResource *> &html_resourc
                                        const QString& old_word,
                                        const QString& new_word)
 {
-    QtConcurrent::blockingMap(html_resources, std::bind(UpdateWordsInOneFile, std::placeholders::_1, default_lang, old_word, new_word));
+    QHash<QString, QString> replacements;
+    replacements.insert(old_word, new_word);
+    UpdateWordsInAllFiles(html_resources, default_lang, replacements);
+}
+
+void WordUpdates::UpdateWordsInAllFiles(const QList<HTMLResource *> &html_resources,
+                                        const QString& default_lang,
+                                        const QHash<QString, QString>& replacements)
+{
+    if (replacements.isEmpty()) {
+        return;
+    }
+    QtConcurrent::blockingMap(html_resources, std::bind(UpdateWordsInOneFile, std::placeholders::_1,
+                                                        std::cref(default_lang), std::cref(replacements)));
 }
 
 void WordUpdates::UpdateWordsInOneFile(HTMLResource *html_resource,
                                        const QString& default_lang,
-                                       const QString& old_word,
-                                       const QString& new_word)
+                                       const QHash<QString, QString>& replacements)
 {
-    // qDebug() << "UpdateWordsInOneFile " << html_resource->Filename() << old_word << new_word;
+    // qDebug() << "UpdateWordsInOneFile " << html_resource->Filename() << replacements.count();
     Q_ASSERT(html_resource);
     QWriteLocker locker(&html_resource->GetLock());
-    QString text = html_resource->GetText();
+    const QString text = html_resource->GetText();
     QList<HTMLSpellCheckML::AWord> words = HTMLSpellCheckML::GetWords(text, default_lang);
 
-    // Change in reverse to preserve location information
-    for (int i = words.count() - 1; i >= 0; i--) {
-        HTMLSpellCheckML::AWord word = words[i];
-        if (word.text != old_word) {
+    // The words come in text order so the new text is built front
+    // to back, copying the runs between the words that change
+    QString new_text;
+    bool changed = false;
+    int run = 0;
+    foreach(const HTMLSpellCheckML::AWord &word, words) {
+        QHash<QString, QString>::const_iterator it = replacements.constFind(word.text);
+        if (it == replacements.constEnd()) {
             continue;
         }
-        text.replace(word.offset, word.length, HTMLSpellCheckML::textOf(new_word));
+        if (!changed) {
+            new_text.reserve(text.length() + text.length() / 16);
+            changed = true;
+        }
+        new_text.append(QStringView(text).mid(run, word.offset - run));
+        new_text.append(HTMLSpellCheckML::textOf(it.value()));
+        run = word.offset + word.length;
+    }
+    if (!changed) {
+        return;
     }
-    html_resource->SetText(text);
+    new_text.append(QStringView(text).mid(run));
+    html_resource->SetText(new_text);
 }
@@ -24,6 +24,9 @@
 #ifndef WORDUPDATES_H
 #define WORDUPDATES_H
 
+#include <QHash>
+#include <QString>
+
 class HTMLResource;
 
 class WordUpdates
@@ -36,11 +39,22 @@ public:
                                      const QString& old_word,
                                      const QString& new_word);
 
+    /**
+     * Makes every replacement in one pass over the words of each file.
+     *
+     * @param html_resources The files to update.
+     * @param default_lang The language of words without their own.
+     * @param replacements The new word for each old one, both with
+     *                     their language as the spellcheck words have it.
+     */
+    static void UpdateWordsInAllFiles(const QList<HTMLResource *> &html_resources,
+                                      const QString& default_lang,
+                                      const QHash<QString, QString>& replacements);
+
 private:
     static void UpdateWordsInOneFile(HTMLResource *html_resource,
                                      const QString &default_lang,
-                                     const QString &old_word,
-                                     const QString &new_word);
+                                     const QHash<QString, QString> &replacements);
 };
 
 #endif // WORDUPDATES_H
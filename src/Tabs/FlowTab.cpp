@@ -116,6 +116,10 @@ FlowTab::~FlowTab()
         m_wCodeView = 0;
     }
 
+    if (!GetResourceWasDeleted()) {
+        m_HTMLResource->ReleaseTextDocument();
+    }
+
     m_HTMLResource = NULL;
 
 }
@@ -636,13 +640,9 @@ QString FlowTab::GetShortPathName()
 
 bool FlowTab::IsDataWellFormed()
 {
-    // The content has been changed or was in a not well formed state when last checked.
-    QString version = m_HTMLResource->GetEpubVersion();
-
-    // So lets play safe and have a fallback to use the resource text if CV is not loaded yet.
-    XhtmlDoc::WellFormedError error = (m_wCodeView != NULL)
-        ? XhtmlDoc::WellFormedErrorForSource(m_wCodeView->toPlainText(),version)
-        : XhtmlDoc::WellFormedErrorForSource(m_HTMLResource->GetText(),version);
+    // The Code View edits the resource's own text document, so the
+    // verdict the resource keeps for its text holds for the tab too.
+    XhtmlDoc::WellFormedError error = m_HTMLResource->WellFormedErrorLocation();
     m_safeToLoad = error.line == -1;
     if (!m_safeToLoad) {
           m_WellFormedCheckComponent->DemandAttentionIfAllowed(error);
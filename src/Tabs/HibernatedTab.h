@@ -0,0 +1,57 @@
+/************************************************************************
+**
+**  Copyright (C) 2024 Kevin B. Hendricks, Stratford, Ontario, Canada
+**
+**  This file is part of Sigil.
+**
+**  Sigil is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  Sigil is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with Sigil.  If not, see <http://www.gnu.org/licenses/>.
+**
+*************************************************************************/
+
+#pragma once
+#ifndef HIBERNATEDTAB_H
+#define HIBERNATEDTAB_H
+
+#include "Tabs/ContentTab.h"
+
+class Resource;
+
+/**
+ * Stands in for a tab whose editor has been destroyed to save memory.
+ * Only the resource and where the cursor was are kept, TabManager
+ * makes the real tab again when this one is made current.
+ */
+class HibernatedTab : public ContentTab
+{
+    Q_OBJECT
+
+public:
+
+    /**
+     * Constructor.
+     *
+     * @param resource The resource the tab was for.
+     * @param cursor_position Where the cursor was in the text.
+     * @param parent The QObject's parent.
+     */
+    HibernatedTab(Resource *resource, int cursor_position, QWidget *parent = 0);
+
+    int GetCursorPosition() const;
+
+private:
+
+    int m_CursorPosition;
+};
+
+#endif // HIBERNATEDTAB_H
@@ -43,6 +43,7 @@
 #include "ViewEditors/SimplePage.h"
 #include "Misc/OpenExternally.h"
 #include "Misc/SettingsStore.h"
+#include "Misc/ThumbnailCache.h"
 #include "Misc/WebProfileMgr.h"
 #include "Misc/Utility.h"
 #include "Misc/webviewprinter.h"
@@ -83,6 +84,7 @@ ImageTab::ImageTab(ImageResource *resource, QWidget *parent)
 {
     QWebEngineProfile* profile = WebProfileMgr::instance()->GetOneTimeProfile();
     m_WebView->setPage(new SimplePage(profile, m_WebView));
+    WebProfileMgr::instance()->DiscardWhenHidden(m_WebView);
     m_WebView->setContextMenuPolicy(Qt::CustomContextMenu);
     m_WebView->setFocusPolicy(Qt::NoFocus);
     m_WebView->setAcceptDrops(false);
@@ -195,19 +197,20 @@ void ImageTab::RefreshContent()
     const QFileInfo fileInfo = QFileInfo(path);
     const double ffsize = fileInfo.size() / 1024.0;
     const QString fsize = QLocale().toString(ffsize, 'f', 2);
-    const QImage img(path);
+    // the web view decodes the image itself, only its details are needed here
+    const ThumbnailCache::Info img = ThumbnailCache::Get(path, 0);
     const QUrl imgUrl = QUrl::fromLocalFile(path);
-    QString colors_shades = img.isGrayscale() ? tr("shades") : tr("colors");
-    QString grayscale_color = img.isGrayscale() ? tr("Grayscale") : tr("Color");
+    QString colors_shades = img.grayscale ? tr("shades") : tr("colors");
+    QString grayscale_color = img.grayscale ? tr("Grayscale") : tr("Color");
     QString colorsInfo = "";
 
-    if (img.depth() == 32) {
-        colorsInfo = QString(" %1bpp").arg(img.bitPlaneCount());
-    } else if (img.depth() > 0) {
-        colorsInfo = QString(" %1bpp (%2 %3)").arg(img.bitPlaneCount()).arg(img.colorCount()).arg(colors_shades);
+    if (img.depth == 32) {
+        colorsInfo = QString(" %1bpp").arg(img.bit_planes);
+    } else if (img.depth > 0) {
+        colorsInfo = QString(" %1bpp (%2 %3)").arg(img.bit_planes).arg(img.color_count).arg(colors_shades);
     }
 
-    QString html = IMAGE_HTML_BASE.arg(imgUrl.toString()).arg(img.width()).arg(img.height()).arg(fsize)
+    QString html = IMAGE_HTML_BASE.arg(imgUrl.toString()).arg(img.width).arg(img.height).arg(fsize)
                          .arg(grayscale_color).arg(colorsInfo);
 
     if (Utility::IsDarkMode()) {
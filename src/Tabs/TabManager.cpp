@@ -20,10 +20,14 @@
 **
 *************************************************************************/
 
+#include <algorithm>
+
+#include <QtCore/QDateTime>
 #include <QPalette>
 #include <QApplication>
 #include <QDebug>
 #include "BookManipulation/CleanSource.h"
+#include "Misc/SettingsStore.h"
 #include "ResourceObjects/Resource.h"
 #include "ResourceObjects/CSSResource.h"
 #include "ResourceObjects/OPFResource.h"
@@ -37,6 +41,7 @@
 #include "Tabs/PdfTab.h"
 #include "Tabs/AVTab.h"
 #include "Tabs/FontTab.h"
+#include "Tabs/HibernatedTab.h"
 #include "Tabs/CSSTab.h"
 #include "Tabs/FlowTab.h"
 #include "Tabs/ImageTab.h"
@@ -49,6 +54,8 @@
 #include "Tabs/WellFormedContent.h"
 #include "Tabs/TabBar.h"
 
+// How often the tabs are checked for any to hibernate
+static const int HIBERNATE_CHECK_MS = 60000;
 
 TabManager::TabManager(QWidget *parent)
     :
@@ -71,6 +78,10 @@ TabManager::TabManager(QWidget *parent)
     setTabsClosable(true);
     // setElideMode(Qt::ElideRight); this is the default after qt-5.6
     setUsesScrollButtons(true);
+
+    m_HibernateTimer.setInterval(HIBERNATE_CHECK_MS);
+    connect(&m_HibernateTimer, SIGNAL(timeout()), this, SLOT(HibernateIdleTabs()));
+    m_HibernateTimer.start();
 }
 
 
@@ -380,6 +391,14 @@ void TabManager::MakeCentralTab(ContentTab *tab)
 void TabManager::EmitTabChanged(int new_index)
 {
     ContentTab *current_tab = qobject_cast<ContentTab *>(currentWidget());
+    if (qobject_cast<HibernatedTab *>(current_tab)) {
+        // the new tab scrolls Preview itself once it has loaded
+        current_tab = WakeTab(currentIndex(), -1, current_tab->GetCursorPosition(), QString(), QUrl());
+        m_newTab = current_tab;
+    }
+    if (current_tab) {
+        m_LastUsed[current_tab] = QDateTime::currentMSecsSinceEpoch();
+    }
     // the result of the qobject_cast can be NULL and that is okay
     if (m_LastContentTab != current_tab) {
         // qDebug() << "Emitting TabChanged Signal";
@@ -483,6 +502,7 @@ void TabManager::DeleteTab(ContentTab *tab_to_delete)
             emit TabChanged(prevtab,  next_tab);
             emit UpdatePreviewAfterExistingTabSwitch();
         }
+        m_LastUsed.remove(tab);
         tab->deleteLater();
         m_tabs_deletion_in_use = !m_TabsToDelete.isEmpty();
     }
@@ -558,6 +578,20 @@ bool TabManager::SwitchedToExistingTab(const Resource *resource,
     // If the resource is already opened in
     // some tab, then we just switch to it
     if (resource_index != -1) {
+        HibernatedTab *hibernated = qobject_cast<HibernatedTab *>(widget(resource_index));
+        if (hibernated) {
+            if ((line_to_scroll_to <= 0) && (position_to_scroll_to < 0) &&
+                caret_location_to_scroll_to.isEmpty() && fragment.isEmpty()) {
+                position_to_scroll_to = hibernated->GetCursorPosition();
+            }
+            ContentTab *tab = WakeTab(resource_index, line_to_scroll_to, position_to_scroll_to,
+                                      caret_location_to_scroll_to, fragment);
+            m_newTab = tab;
+            setCurrentIndex(resource_index);
+            tab->setFocus();
+            return true;
+        }
+
         // the next line will cause TabChanged to be emitted which will update Preview
         // but to whatever location this tab has now now after scrolling
         setCurrentIndex(resource_index);
@@ -774,9 +808,111 @@ bool TabManager::AddNewContentTab(ContentTab *new_tab, bool precede_current_tab)
 
     connect(new_tab, SIGNAL(DeleteMe(ContentTab *)), this, SLOT(DeleteTab(ContentTab *)));
     connect(new_tab, SIGNAL(TabRenamed(ContentTab *)), this, SLOT(UpdateTabName(ContentTab *)));
+    m_LastUsed.insert(new_tab, QDateTime::currentMSecsSinceEpoch());
+    // more tabs may now be open than are kept live
+    QTimer::singleShot(0, this, SLOT(HibernateIdleTabs()));
     return true;
 }
 
+
+void TabManager::HibernateIdleTabs()
+{
+    SettingsStore settings;
+    int limit = settings.tabHibernateLimit();
+    qint64 idle_ms = qint64(settings.tabHibernateMinutes()) * 60000;
+    if ((limit == 0) && (idle_ms == 0)) {
+        return;
+    }
+
+    QList<ContentTab *> live_tabs;
+    for (int i = 0; i < count(); ++i) {
+        ContentTab *tab = qobject_cast<ContentTab *>(widget(i));
+        if (tab && !qobject_cast<HibernatedTab *>(tab)) {
+            live_tabs.append(tab);
+        }
+    }
+    // least recently used first
+    std::stable_sort(live_tabs.begin(), live_tabs.end(), [&](ContentTab *a, ContentTab *b) {
+        return m_LastUsed.value(a) < m_LastUsed.value(b);
+    });
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    int excess = limit > 0 ? live_tabs.count() - limit : 0;
+    for (int i = 0; i < live_tabs.count(); ++i) {
+        ContentTab *tab = live_tabs.at(i);
+        bool idle = (idle_ms > 0) && (now - m_LastUsed.value(tab) >= idle_ms);
+        if ((i >= excess) && !idle) {
+            continue;
+        }
+        if ((tab == currentWidget()) || tab->IsModified() || !tab->IsLoadingFinished()) {
+            continue;
+        }
+        HibernateTab(indexOf(tab));
+    }
+}
+
+
+void TabManager::HibernateTab(int index)
+{
+    ContentTab *tab = qobject_cast<ContentTab *>(widget(index));
+    Q_ASSERT(tab);
+    tab->SaveTabContent();
+    HibernatedTab *hibernated = new HibernatedTab(tab->GetLoadedResource(), tab->GetCursorPosition(), this);
+    ReplaceTab(index, hibernated);
+    // deleted right away so that the text document it releases is
+    // gone before the tab can be woken again
+    delete tab;
+}
+
+
+ContentTab *TabManager::WakeTab(int index,
+                                int line_to_scroll_to,
+                                int position_to_scroll_to,
+                                const QString &caret_location_to_scroll_to,
+                                const QUrl &fragment)
+{
+    ContentTab *hibernated = qobject_cast<ContentTab *>(widget(index));
+    Q_ASSERT(hibernated);
+    ContentTab *tab = CreateTabForResource(hibernated->GetLoadedResource(), line_to_scroll_to, position_to_scroll_to,
+                                           caret_location_to_scroll_to, fragment, true);
+    if (!tab) {
+        return hibernated;
+    }
+    ReplaceTab(index, tab)->deleteLater();
+    return tab;
+}
+
+
+ContentTab *TabManager::ReplaceTab(int index, ContentTab *new_tab)
+{
+    ContentTab *old_tab = qobject_cast<ContentTab *>(widget(index));
+    bool was_current = index == currentIndex();
+
+    // as in DeleteTab the tab switches must not reenter EmitTabChanged
+    disconnect(this, SIGNAL(currentChanged(int)), this, SLOT(EmitTabChanged(int)));
+#if defined(Q_OS_MAC)
+    // no icons, see AddNewContentTab
+    insertTab(index, new_tab, new_tab->GetShortPathName());
+#else
+    insertTab(index, new_tab, new_tab->GetIcon(), new_tab->GetShortPathName());
+#endif
+    setTabToolTip(index, new_tab->GetShortPathName());
+    if (was_current) {
+        setCurrentIndex(index);
+    }
+    removeTab(index + 1);
+    connect(this, SIGNAL(currentChanged(int)), this, SLOT(EmitTabChanged(int)));
+
+    disconnect(old_tab, 0, this, 0);
+    connect(new_tab, SIGNAL(DeleteMe(ContentTab *)), this, SLOT(DeleteTab(ContentTab *)));
+    connect(new_tab, SIGNAL(TabRenamed(ContentTab *)), this, SLOT(UpdateTabName(ContentTab *)));
+    m_LastUsed.insert(new_tab, m_LastUsed.take(old_tab));
+    if (m_LastContentTab == old_tab) {
+        m_LastContentTab = new_tab;
+    }
+    return old_tab;
+}
+
 void TabManager::UpdateTabDisplay()
 {
     for (int i = 0; i < count(); ++i) {
@@ -24,6 +24,8 @@
 #ifndef TABMANAGER_H
 #define TABMANAGER_H
 
+#include <QtCore/QHash>
+#include <QtCore/QTimer>
 #include <QtCore/QUrl>
 #include <QtWidgets/QTabWidget>
 
@@ -224,8 +226,38 @@ private slots:
 
     void SetFocusInTab();
 
+    /**
+     * Hibernates the least recently used tabs beyond the limit set in
+     * the settings and those that have not been used for long enough.
+     */
+    void HibernateIdleTabs();
+
 private:
 
+    /**
+     * Swaps the tab at index for a HibernatedTab, destroying its editor.
+     *
+     * @param index The index of the tab to hibernate.
+     */
+    void HibernateTab(int index);
+
+    /**
+     * Makes the real tab again for the HibernatedTab at index.
+     *
+     * @return The new tab, or the hibernated one if the tab could not be made.
+     */
+    ContentTab *WakeTab(int index,
+                        int line_to_scroll_to,
+                        int position_to_scroll_to,
+                        const QString &caret_location_to_scroll_to,
+                        const QUrl &fragment);
+
+    /**
+     * Puts new_tab in place of the tab at index, keeping it current if
+     * it was.  The replaced tab is returned for the caller to delete.
+     */
+    ContentTab *ReplaceTab(int index, ContentTab *new_tab);
+
     /**
      * Returns the element of the UI that houses well-formed XML data.
      *
@@ -300,6 +332,13 @@ private:
     QList<ContentTab*> m_TabsToDelete;
     bool m_tabs_deletion_in_use;
     ContentTab * m_newTab;
+
+    /**
+     * When each live tab was last made current, in ms since the epoch.
+     */
+    QHash<ContentTab *, qint64> m_LastUsed;
+
+    QTimer m_HibernateTimer;
 };
 
 #endif // TABMANAGER_H
@@ -58,6 +58,11 @@ TextTab::~TextTab()
         delete m_wCodeView;
         m_wCodeView = 0;
     }
+
+    // Only the tab has any use for the document
+    if (!GetResourceWasDeleted()) {
+        m_TextResource->ReleaseTextDocument();
+    }
 }
 
 
@@ -36,7 +36,7 @@
 #include <QColor>
 #include <QScrollBar>
 #include <QShortcut>
-#include <QXmlStreamReader>
+#include <QStaticText>
 #include <QRegularExpression>
 #include <QRegularExpressionMatch>
 #include <QRegularExpressionMatchIterator>
@@ -46,7 +46,10 @@
 #include <QPrinter>
 #include <QApplication>
 #include <QInputDialog>
+#include <QTextBlock>
+#include <QTextLayout>
 #include <QTimer>
+#include <QFutureWatcher>
 #include <QDebug>
 
 #include "BookManipulation/Book.h"
@@ -58,6 +61,8 @@
 #include "Misc/XHTMLHighlighter2.h"
 #include "Dialogs/ClipEditor.h"
 #include "Misc/CSSHighlighter.h"
+#include "Misc/RehighlightScheduler.h"
+#include "Misc/SettingsSnapshot.h"
 #include "Misc/SettingsStore.h"
 #include "Misc/SpellCheck.h"
 #include "Misc/HTMLSpellCheck.h"
@@ -73,8 +78,9 @@ const QString BREAK_TAG_INSERT    = "<hr class=\"sigil_split_marker\" />";
 
 static const int TAB_SPACES_WIDTH        = 4;
 static const int LINE_NUMBER_MARGIN      = 5;
+// More laid out line numbers than this are dropped and laid out again
+static const int MAX_CACHED_LINE_NUMBERS = 2000;
 
-static const QString XML_OPENING_TAG        = "(<[^>/][^>]*[^>/]>|<[^>/]>)";
 static const QString NEXT_CLOSE_TAG_LOCATION = "</\\s*[^>]+>";
 static const QString NEXT_TAG_LOCATION      = "<[^!>]+>";
 static const QString TAG_NAME_SEARCH        = "<\\s*([^\\s>]+)";
@@ -87,12 +93,18 @@ static const QString STARTING_INDENT_USED = "(^\\s*)[^\\s]";
 
 static const uint MAX_SPELLING_SUGGESTIONS = 10;
 
+// Documents longer than this (in characters) are opened in large file
+// mode: only the blocks on screen are highlighted and features that
+// have to look at the whole text on every cursor move are turned off
+static const int LARGE_FILE_LENGTH = 8 * 1024 * 1024;
+
 
 CodeViewEditor::CodeViewEditor(HighlighterType high_type, bool check_spelling, QWidget *parent)
     :
     QPlainTextEdit(parent),
     m_isUndoAvailable(false),
     m_LastBlockCount(0),
+    m_LineNumberAreaWidth(-1),
     m_LineNumberAreaBlockNumber(-1),
     m_LineNumberArea(new LineNumberArea(this)),
     m_ScrollOneLineUp(new QShortcut(QKeySequence(Qt::ControlModifier | Qt::Key_Up), this, 0, 0, Qt::WidgetShortcut)),
@@ -112,7 +124,11 @@ CodeViewEditor::CodeViewEditor(HighlighterType high_type, bool check_spelling, Q
     m_MarkedTextStart(-1),
     m_MarkedTextEnd(-1),
     m_ReplacingInMarkedText(false),
-    m_regen_taglist(true)
+    m_regen_taglist(true),
+    m_LargeFile(false),
+    m_FirstHighlightedBlock(-1),
+    m_LastHighlightedBlock(-1),
+    m_RehighlightScheduler(NULL)
 {
     if (!qEnvironmentVariableIsSet("SIGIL_ALLOW_CODEVIEW_DROP")) setAcceptDrops(false);
     if (high_type == CodeViewEditor::Highlight_XHTML) {
@@ -123,6 +139,9 @@ CodeViewEditor::CodeViewEditor(HighlighterType high_type, bool check_spelling, Q
     } else {
         m_Highlighter = NULL;
     }
+    if (m_Highlighter) {
+        m_RehighlightScheduler = new RehighlightScheduler(m_Highlighter, this);
+    }
 
 
     // if we use the following we can get instances
@@ -199,8 +218,21 @@ void CodeViewEditor::CustomSetDocument(TextDocument &ndocument)
 {
     SettingsStore settings;
     setDocument(&ndocument);
+    // connect before the highlighter so the tag list sees the edit first
+    connect(&ndocument, SIGNAL(contentsChange(int, int, int)),
+            this,       SLOT(UpdateTagList(int, int, int)), Qt::UniqueConnection);
     ndocument.setModified(false);
+    m_LargeFile = ndocument.characterCount() > LARGE_FILE_LENGTH;
+    m_FirstHighlightedBlock = -1;
+    m_LastHighlightedBlock = -1;
     if (m_Highlighter) {
+        // a large file starts with nothing highlighted and then only
+        // the blocks that are scrolled into view are
+        if (m_LargeFile) {
+            SetHighlightedBlocks(0, -1);
+        } else {
+            SetHighlightedBlocks(-1, -1);
+        }
         m_Highlighter->setDocument(&ndocument);
         // The QSyntaxHighlighter will setup a singleShot timer to do the highlighting
         // in response to setDocument being called. This causes a problem because we
@@ -208,7 +240,7 @@ void CodeViewEditor::CustomSetDocument(TextDocument &ndocument)
         // QTextDocument gets fired by the syntax highlighting. This in turn causes issues
         // with our own logic trying to do stuff in response to genunine document changes.
         // So we will synchronously highlight now, and block signals while doing so.
-        RehighlightDocument();
+        RehighlightDocumentNow();
     }
 
     ResetFont();
@@ -614,34 +646,47 @@ void CodeViewEditor::LineNumberAreaPaintEvent(QPaintEvent *event)
     QPainter painter(m_LineNumberArea);
     // Paint the background first
     painter.fillRect(event->rect(), m_codeViewAppearance.line_number_background_color);
+    painter.setPen(m_codeViewAppearance.line_number_foreground_color);
     // A "block" represents a line of text
     QTextBlock block = firstVisibleBlock();
     // Blocks are numbered from zero,
     // but we count lines of text from one
     int blockNumber  = block.blockNumber() + 1;
+    // Only the first block needs its geometry looked up, the
+    // tops of the others follow from the heights of those above
+    qreal top = blockBoundingGeometry(block).translated(contentOffset()).top();
+    int right = m_LineNumberArea->width() - LINE_NUMBER_MARGIN;
 
     // We loop through all the visible and
     // unobscured blocks and paint line numbers for each
     while (block.isValid()) {
         // Getting the Y coordinates for the top of a block.
-        int topY = (int) blockBoundingGeometry(block).translated(contentOffset()).top();
+        int topY = (int) top;
 
         // Ignore blocks that are not visible.
         if (!block.isVisible() || (topY > event->rect().bottom())) {
             break;
         }
 
-        // Draw the number in the line number area.
-        painter.setPen(m_codeViewAppearance.line_number_foreground_color);
-        QString number_to_paint = QString::number(blockNumber);
-        painter.drawText(- LINE_NUMBER_MARGIN,
-                         topY,
-                         m_LineNumberArea->width(),
-                         fontMetrics().height(),
-                         Qt::AlignRight,
-                         number_to_paint
-                        );
+        qreal height = blockBoundingRect(block).height();
+        // Blocks above the part being repainted need no number
+        if (top + height >= event->rect().top()) {
+            // The numbers are laid out once and kept, so that
+            // scrolling back and forth only draws them again
+            QHash<int, QStaticText>::const_iterator it = m_LineNumberTexts.constFind(blockNumber);
+            if (it == m_LineNumberTexts.constEnd()) {
+                if (m_LineNumberTexts.count() >= MAX_CACHED_LINE_NUMBERS) {
+                    m_LineNumberTexts.clear();
+                }
+                QStaticText number_to_paint(QString::number(blockNumber));
+                number_to_paint.setTextFormat(Qt::PlainText);
+                number_to_paint.prepare(QTransform(), m_LineNumberArea->font());
+                it = m_LineNumberTexts.insert(blockNumber, number_to_paint);
+            }
+            painter.drawStaticText(QPointF(right - it->size().width(), topY), *it);
+        }
         // Move to the next block and block number.
+        top += height;
         block = block.next();
         blockNumber++;
     }
@@ -716,14 +761,35 @@ void CodeViewEditor::ReplaceDocumentText(const QString &new_text)
     QString txt = Utility::UseNFC(new_text);
     QTextCursor cursor = textCursor();
     cursor.beginEditBlock();
-    cursor.select(QTextCursor::Document);
-    cursor.removeSelectedText();
-    cursor.insertText(txt);
+    ReplaceChangedText(cursor, toPlainText(), txt);
     cursor.endEditBlock();
     m_regen_taglist = true; // just in case
 }
 
 
+void CodeViewEditor::ReplaceChangedText(QTextCursor &cursor, const QString &old_text, const QString &new_text)
+{
+    const int old_length = old_text.length();
+    const int new_length = new_text.length();
+    int limit = qMin(old_length, new_length);
+    int prefix = 0;
+    while (prefix < limit && old_text.at(prefix) == new_text.at(prefix)) {
+        prefix++;
+    }
+    limit -= prefix;
+    int suffix = 0;
+    while (suffix < limit && old_text.at(old_length - 1 - suffix) == new_text.at(new_length - 1 - suffix)) {
+        suffix++;
+    }
+    if ((prefix == old_length) && (prefix == new_length)) {
+        return;
+    }
+    cursor.setPosition(prefix);
+    cursor.setPosition(old_length - suffix, QTextCursor::KeepAnchor);
+    cursor.insertText(new_text.mid(prefix, new_length - prefix - suffix));
+}
+
+
 void CodeViewEditor::ScrollToTop()
 {
     verticalScrollBar()->setValue(0);
@@ -844,6 +910,25 @@ bool CodeViewEditor::IsLoadingFinished()
     return m_isLoadFinished;
 }
 
+qint64 CodeViewEditor::GetTagListMemorySize() const
+{
+    return m_TagList.memorySize();
+}
+
+qint64 CodeViewEditor::GetHighlightMemorySize() const
+{
+    if (!m_Highlighter) {
+        return 0;
+    }
+    qint64 total = 0;
+    for (QTextBlock block = document()->begin(); block.isValid(); block = block.next()) {
+        if (block.layout()) {
+            total += block.layout()->formats().count() * sizeof(QTextLayout::FormatRange);
+        }
+    }
+    return total;
+}
+
 int CodeViewEditor::GetCursorPosition() const
 {
     const int position = textCursor().position();
@@ -936,9 +1021,12 @@ bool CodeViewEditor::FindNext(const QString &search_regex,
                               bool marked_text,
                               int split_at)
 {
-    SPCRE *spcre = PCRECache::instance()->getObject(search_regex);
+    QSharedPointer<SPCRE> spcre = PCRECache::instance()->getObject(search_regex);
     SPCRE::MatchInfo match_info;
-    QString txt = toPlainText();
+    // The tag list keeps its copy of the text up to date as it is edited
+    // so there is no need to take a fresh one for every find
+    MaybeRegenerateTagList();
+    QString txt = m_TagList.getSource();
     int start_offset = 0;
     int start = 0;
     int end = txt.length();
@@ -977,15 +1065,18 @@ bool CodeViewEditor::FindNext(const QString &search_regex,
         if (misspelled_words) {
             match_info = GetMisspelledWord(txt, 0, selection_offset, search_regex, search_direction);
         } else {
-            match_info = spcre->getLastMatchInfo(Utility::Substring(start, selection_offset, txt));
+            // offsets are within the whole text
+            match_info = spcre->getLastMatchInfo(txt, start, selection_offset);
+            start_offset = 0;
         }
     } else {
         if (misspelled_words) {
             match_info = GetMisspelledWord(txt, selection_offset, txt.length(), search_regex, search_direction);
+            start_offset = selection_offset;
         } else {
-            match_info = spcre->getFirstMatchInfo(Utility::Substring(selection_offset, end, txt));
+            match_info = spcre->getFirstMatchInfo(txt, selection_offset, end);
+            start_offset = 0;
         }
-        start_offset = selection_offset;
     }
 
     if (marked_text) {
@@ -1034,8 +1125,9 @@ bool CodeViewEditor::FindNext(const QString &search_regex,
 
 int CodeViewEditor::Count(const QString &search_regex, Searchable::Direction direction, bool wrap, bool marked_text)
 {
-    SPCRE *spcre = PCRECache::instance()->getObject(search_regex);
-    QString txt= toPlainText();
+    QSharedPointer<SPCRE> spcre = PCRECache::instance()->getObject(search_regex);
+    MaybeRegenerateTagList();
+    QString txt = m_TagList.getSource();
     int start = 0;
     int end = txt.length();
 
@@ -1048,20 +1140,18 @@ int CodeViewEditor::Count(const QString &search_regex, Searchable::Direction dir
     }
     if (!wrap) {
         if (direction == Searchable::Direction_Up) {
-            txt = Utility::Substring(start, textCursor().position(), txt);
+            end = textCursor().position();
         } else {
-            txt = Utility::Substring(textCursor().position(), end, txt);
+            start = textCursor().position();
         }
-    } else if (marked_text) {
-        txt = Utility::Substring(start, end, txt);
     }
-    return spcre->getEveryMatchInfo(txt).count();
+    return spcre->getMatchCount(txt, start, end);
 }
 
 
 bool CodeViewEditor::ReplaceSelected(const QString &search_regex, const QString &replacement, Searchable::Direction direction, bool replace_current)
 {
-    SPCRE *spcre = PCRECache::instance()->getObject(search_regex);
+    QSharedPointer<SPCRE> spcre = PCRECache::instance()->getObject(search_regex);
     int selection_start = textCursor().selectionStart();
     int selection_end = textCursor().selectionEnd();
 
@@ -1153,7 +1243,7 @@ int CodeViewEditor::ReplaceAll(const QString &search_regex,
     }
     int marked_text_length = text.length();
 
-    SPCRE *spcre = PCRECache::instance()->getObject(search_regex);
+    QSharedPointer<SPCRE> spcre = PCRECache::instance()->getObject(search_regex);
     QList<SPCRE::MatchInfo> match_info = spcre->getEveryMatchInfo(text);
 
     // Run though all match offsets making the replacement in reverse order.
@@ -1194,9 +1284,7 @@ int CodeViewEditor::ReplaceAll(const QString &search_regex,
     int cursor_position = cursor.selectionStart();
     cursor.beginEditBlock();
     // Replace all text in the document with the new text.
-    cursor.setPosition(cursor_position);
-    cursor.select(QTextCursor::Document);
-    cursor.insertText(text);
+    ReplaceChangedText(cursor, toPlainText(), text);
     cursor.endEditBlock();
 
     // Restore the cursor position
@@ -1474,28 +1562,29 @@ bool CodeViewEditor::AddSpellCheckContextMenu(QMenu *menu)
         // If a misspelled word is selected try to offer spelling suggestions.
         if (offer_spelling) {
             SpellCheck *sc = SpellCheck::instance();
-            QStringList suggestions = sc->suggestPS(selected_word);
-            QAction *suggestAction = 0;
-
-            // We want to limit the number of suggestions so we don't
-            // get a huge context menu.
-            for (unsigned int i = 0; i < std::min(static_cast<uint>(suggestions.length()), MAX_SPELLING_SUGGESTIONS); ++i) {
-                suggestAction = new QAction(suggestions.at(i), menu);
-                connect(suggestAction, SIGNAL(triggered()), m_spellingMapper, SLOT(map()));
-                m_spellingMapper->setMapping(suggestAction, suggestions.at(i));
-
-                // If the menu is empty we need to append rather than insert our actions.
-                if (!topAction) {
-                    menu->addAction(suggestAction);
-                } else {
-                    menu->insertAction(topAction, suggestAction);
-                }
+
+            // Hunspell can take a while over suggestions so the menu opens
+            // with a placeholder that they replace once they are found
+            QAction *placeholder = new QAction(tr("Finding suggestions..."), menu);
+            placeholder->setEnabled(false);
+            QAction *separator = NULL;
+            if (!topAction) {
+                menu->addAction(placeholder);
+            } else {
+                menu->insertAction(topAction, placeholder);
+                // Keep our spelling actions differentiated from the default menu actions.
+                separator = menu->insertSeparator(topAction);
             }
 
-            // Add a separator to keep our spelling actions differentiated from
-            // the default menu actions.
-            if (!suggestions.isEmpty() && topAction) {
-                menu->insertSeparator(topAction);
+            QStringList suggestions;
+            if (sc->cachedSuggestions(selected_word, true, suggestions)) {
+                AddSpellingSuggestions(menu, placeholder, separator, suggestions);
+            } else {
+                QFutureWatcher<QStringList> *watcher = new QFutureWatcher<QStringList>(menu);
+                connect(watcher, &QFutureWatcher<QStringList>::finished, menu, [=]() {
+                    AddSpellingSuggestions(menu, placeholder, separator, watcher->result());
+                });
+                watcher->setFuture(sc->suggestPSAsync(selected_word));
             }
 
             // Allow the user to add the misspelled word to their default user dictionary.
@@ -1545,6 +1634,24 @@ bool CodeViewEditor::AddSpellCheckContextMenu(QMenu *menu)
     return offer_spelling;
 }
 
+void CodeViewEditor::AddSpellingSuggestions(QMenu *menu, QAction *placeholder, QAction *separator, const QStringList &suggestions)
+{
+    // We want to limit the number of suggestions so we don't
+    // get a huge context menu.
+    for (unsigned int i = 0; i < std::min(static_cast<uint>(suggestions.length()), MAX_SPELLING_SUGGESTIONS); ++i) {
+        QAction *suggestAction = new QAction(suggestions.at(i), menu);
+        connect(suggestAction, SIGNAL(triggered()), m_spellingMapper, SLOT(map()));
+        m_spellingMapper->setMapping(suggestAction, suggestions.at(i));
+        menu->insertAction(placeholder, suggestAction);
+    }
+    menu->removeAction(placeholder);
+    delete placeholder;
+    if (suggestions.isEmpty() && separator) {
+        menu->removeAction(separator);
+        delete separator;
+    }
+}
+
 QString CodeViewEditor::GetCurrentWordAtCaret(bool select_word)
 {
     QTextCursor c = textCursor();
@@ -2012,8 +2119,7 @@ void CodeViewEditor::RenameClass()
         if (cssdata != newcssdata) {
             QTextCursor cursor = textCursor();
             cursor.beginEditBlock();
-            cursor.select(QTextCursor::Document);
-            cursor.insertText(newcssdata);
+            ReplaceChangedText(cursor, toPlainText(), newcssdata);
             cursor.endEditBlock();
             ScrollToLine(lineno);
         }
@@ -2267,8 +2373,6 @@ void CodeViewEditor::EmitFilteredCursorMoved()
 
 void CodeViewEditor::TextChangedFilter()
 {
-    m_regen_taglist = true;
-
     // Clear marked text to prevent marked area not matching entered text
     // if user types text, uses Undo, etc.
     if (!m_ReplacingInMarkedText && IsMarkedText()) {
@@ -2292,6 +2396,27 @@ void CodeViewEditor::RehighlightDocument()
     // }
 
     if (m_Highlighter) {
+        XHTMLHighlighter2* xhl = qobject_cast<XHTMLHighlighter2*>(m_Highlighter);
+        if (xhl) {
+            xhl->SetRules();
+        }
+        if (m_LargeFile) {
+            // forget what was highlighted so the blocks on screen
+            // are all done again, the others are as they scroll in
+            m_FirstHighlightedBlock = -1;
+            m_LastHighlightedBlock = -1;
+            HighlightVisibleBlocks();
+        } else {
+            m_RehighlightScheduler->Start();
+        }
+    }
+}
+
+
+void CodeViewEditor::RehighlightDocumentNow()
+{
+    if (m_Highlighter) {
+        m_RehighlightScheduler->Stop();
         // We block signals from the document while highlighting takes place,
         // because we do not want the contentsChanged() signal to be fired
         // which would mark the underlying resource as needing saving.
@@ -2317,8 +2442,14 @@ void CodeViewEditor::UpdateUndoAvailable(bool available)
 
 void CodeViewEditor::UpdateLineNumberAreaMargin()
 {
-    // The left margin width depends on width of the line number area
-    setViewportMargins(CalculateLineNumberAreaWidth(), 0, 0, 0);
+    // The left margin width depends on width of the line number area.
+    // Setting the margins lays out the viewport again, so only do
+    // it when the number of digits has actually changed.
+    int width = CalculateLineNumberAreaWidth();
+    if (width != m_LineNumberAreaWidth) {
+        m_LineNumberAreaWidth = width;
+        setViewportMargins(width, 0, 0, 0);
+    }
 }
 
 
@@ -2337,6 +2468,101 @@ void CodeViewEditor::UpdateLineNumberArea(const QRect &area_to_update, int verti
 }
 
 
+void CodeViewEditor::HighlightVisibleBlocks()
+{
+    if (!m_LargeFile || !m_Highlighter) {
+        return;
+    }
+
+    QTextBlock block = firstVisibleBlock();
+    int first = block.blockNumber();
+    int last = first - 1;
+    int bottom = viewport()->rect().bottom();
+    qreal top = blockBoundingGeometry(block).translated(contentOffset()).top();
+    while (block.isValid() && (top <= bottom)) {
+        top += blockBoundingRect(block).height();
+        block = block.next();
+        last++;
+    }
+    if (last < first) {
+        last = first;
+    }
+    if ((first == m_FirstHighlightedBlock) && (last == m_LastHighlightedBlock)) {
+        return;
+    }
+
+    int old_first = m_FirstHighlightedBlock;
+    int old_last = m_LastHighlightedBlock;
+    m_FirstHighlightedBlock = first;
+    m_LastHighlightedBlock = last;
+    SetHighlightedBlocks(first, last);
+
+    // Blocks that stayed on screen are already highlighted.  As in
+    // RehighlightDocument the format changes must not look like edits.
+    document()->blockSignals(true);
+    block = document()->findBlockByNumber(first);
+    for (int i = first; (i <= last) && block.isValid(); i++) {
+        if ((i < old_first) || (i > old_last)) {
+            m_Highlighter->rehighlightBlock(block);
+        }
+        block = block.next();
+    }
+    document()->blockSignals(false);
+}
+
+
+void CodeViewEditor::SetHighlightedBlocks(int first, int last)
+{
+    XHTMLHighlighter2* xhl = qobject_cast<XHTMLHighlighter2*>(m_Highlighter);
+    CSSHighlighter* chl = qobject_cast<CSSHighlighter*>(m_Highlighter);
+    if (xhl) {
+        xhl->SetHighlightedBlocks(first, last);
+    } else if (chl) {
+        chl->SetHighlightedBlocks(first, last);
+    }
+}
+
+
+void CodeViewEditor::UpdateTagList(int position, int chars_removed, int chars_added)
+{
+    // nothing to keep in step if the whole list is rebuilt anyway
+    if (m_regen_taglist) {
+        return;
+    }
+
+    // the final block separator is not part of the plain text
+    int length = document()->characterCount() - 1;
+    if (position + chars_added > length) {
+        m_regen_taglist = true;
+        return;
+    }
+
+    QTextCursor cursor(document());
+    cursor.setPosition(position);
+    cursor.setPosition(position + chars_added, QTextCursor::KeepAnchor);
+    QString added_text = cursor.selectedText();
+
+    // make it match what toPlainText would have returned
+    for (QChar &c : added_text) {
+        switch (c.unicode()) {
+            case 0xfdd0: // QTextBeginningOfFrame
+            case 0xfdd1: // QTextEndOfFrame
+            case QChar::ParagraphSeparator:
+            case QChar::LineSeparator:
+                c = QChar('\n');
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (!m_TagList.updateLister(position, chars_removed, added_text) ||
+        (m_TagList.getSource().length() != length)) {
+        m_regen_taglist = true;
+    }
+}
+
+
 void CodeViewEditor::MaybeRegenerateTagList()
 {
     // calling toPlainText before the initial load is finished causes
@@ -2355,8 +2581,6 @@ void CodeViewEditor::HighlightCurrentLine(bool highlight_tags)
 {
     QList<QTextEdit::ExtraSelection> extraSelections;
 
-    SettingsStore settings;
-
     // Draw the full width line color.
     QTextEdit::ExtraSelection selection_line;
     if (hasFocus()) {
@@ -2369,7 +2593,8 @@ void CodeViewEditor::HighlightCurrentLine(bool highlight_tags)
     selection_line.cursor.clearSelection();
     extraSelections.append(selection_line);
 
-    if (highlight_tags && settings.highlightOpenCloseTags()) {
+    // matching the tags means copying the whole text on every cursor move
+    if (highlight_tags && !m_LargeFile && SettingsSnapshot::instance()->Current()->highlight_open_close_tags) {
 
         // If and only if cursor is inside a tag, highlight open and matching close
         // current cursor position is just before this char at position pos in text
@@ -2565,9 +2790,9 @@ bool CodeViewEditor::PasteClipEntry(ClipEditorModel::clipEntry *clip)
     }
 
     QTextCursor cursor = textCursor();
-    // Convert to plain text or \s won't get newlines
-    const QString &document_text = toPlainText();
-    QString selected_text = Utility::Substring(cursor.selectionStart(), cursor.selectionEnd(), document_text);
+    // Only the selection is needed, not a copy of the whole document.
+    // Use newlines or \s won't match them.
+    QString selected_text = cursor_selected_text(cursor).replace(QChar::ParagraphSeparator, '\n');
 
     if (selected_text.isEmpty()) {
         // Allow users to use the same entry for insert/replace
@@ -2580,18 +2805,24 @@ bool CodeViewEditor::PasteClipEntry(ClipEditorModel::clipEntry *clip)
         cursor.endEditBlock();
         setTextCursor(cursor);
     } else {
+        // The selection is the whole match, so run the replacement on
+        // the selected text alone instead of searching the document for it
         QString search_regex = "(?s)(" + QRegularExpression::escape(selected_text) + ")";
-        // We must do a Find before we do the Replace in order to ensure the match info that
-        // ReplaceSelected relies upon is loaded.
-        cursor.setPosition(cursor.selectionStart());
-        setTextCursor(cursor);
-        bool found = FindNext(search_regex, Searchable::Direction_Down, false, false, false);
-
-        if (found) {
-            ReplaceSelected(search_regex, clip->text, Searchable::Direction_Down, true);
+        QSharedPointer<SPCRE> spcre = PCRECache::instance()->getObject(search_regex);
+        SPCRE::MatchInfo match_info = spcre->getFirstMatchInfo(selected_text);
+        QString replaced_text;
+        if ((match_info.offset.first != -1) &&
+            spcre->replaceText(selected_text, match_info.capture_groups_offsets, clip->text, replaced_text)) {
+            cursor.beginEditBlock();
+            cursor.insertText(replaced_text);
+            cursor.endEditBlock();
+            setTextCursor(cursor);
+            if (!hasFocus()) {
+                // Have the tab saved as ReplaceSelected does when
+                // the clip is applied from elsewhere
+                emit FocusLost(this);
+            }
         }
-        cursor.setPosition(cursor.selectionEnd());
-        setTextCursor(cursor);
     }
 
     return true;
@@ -2613,6 +2844,7 @@ void CodeViewEditor::UpdateLineNumberAreaFont(const QFont &font)
 {
     m_LineNumberArea->setFont(font);
     m_LineNumberArea->MyUpdateGeometry();
+    m_LineNumberTexts.clear();
     UpdateLineNumberAreaMargin();
 }
 
@@ -2703,26 +2935,38 @@ QString CodeViewEditor::GetCaretElementName()
 
 QList<ElementIndex> CodeViewEditor::GetCaretLocation()
 {
-    // We search for the first opening tag *behind* the caret.
+    // We search for the first opening tag or comment *behind* the caret.
     // This specifies the element the caret is located in.
     int pos = textCursor().position();
-    int offset = 0;
-    int len = 0;
-    QRegularExpression tag(XML_OPENING_TAG);
-    QRegularExpressionMatchIterator i = tag.globalMatch(toPlainText());
-    // There is no way to search for the last match (str.lastIndexOf) in a string and also have
-    // the matched text length. So we search forward for every match (QRegularExpression doesn't
-    // have a way to search backwards) and only use the last match's info.
-    while (i.hasNext()) {
-        QRegularExpressionMatch mo = i.next();
-        int start = mo.capturedStart();
-        if (start > pos) {
-            break;
+    MaybeRegenerateTagList();
+    int i = m_TagList.findLastTagOnOrBefore(pos);
+    TagLister::TagInfo ti = m_TagList.at(i);
+    while ((i >= 0) && ((ti.ttype == "end") || (ti.ttype == "single"))) {
+        i--;
+        ti = m_TagList.at(i);
+    }
+
+    // Each element of the hierarchy gives how many element children
+    // it has before the next element in it, the last one gives -1
+    // when the caret is in its start tag.
+    QList<ElementIndex> hierarchy;
+    if ((i >= 0) && ((ti.ttype == "begin") || (ti.ttype == "comment"))) {
+        int k = i;
+        int count = 0;
+        if (ti.ttype == "comment") {
+            count = m_TagList.countElementsBefore(i);
+            k = m_TagList.findParentTag(i);
+        }
+        while (k != -1) {
+            QString name = m_TagList.at(k).tname;
+            ElementIndex ei;
+            ei.name = name.mid(name.indexOf(':') + 1);
+            ei.index = count - 1;
+            hierarchy.prepend(ei);
+            count = m_TagList.countElementsBefore(k) + 1;
+            k = m_TagList.findParentTag(k);
         }
-        offset = start;
-        len = mo.capturedLength();
     }
-    QList<ElementIndex> hierarchy = ConvertStackToHierarchy(GetCaretLocationStack(offset + len));
 
     // determine last block element containing caret
     QString element_name;
@@ -2743,55 +2987,6 @@ void CodeViewEditor::StoreCaretLocationUpdate(const QList<ElementIndex> &hierarc
 }
 
 
-QStack<CodeViewEditor::StackElement> CodeViewEditor::GetCaretLocationStack(int offset) const
-{
-    QString source = toPlainText();
-    QXmlStreamReader reader(source);
-    QStack<StackElement> stack;
-
-    while (!reader.atEnd()) {
-        reader.readNext();
-
-        if (reader.isComment()) {
-            if (reader.characterOffset() == offset) {
-                break;
-            }
-        } else if (reader.isStartElement()) {
-            // If we detected the start of a new element, then
-            // the element currently on the top of the stack
-            // has one more child element
-            if (!stack.isEmpty()) {
-                stack.top().num_children++;
-            }
-
-            StackElement new_element;
-            new_element.name = reader.name().toString();
-            new_element.num_children = 0;
-            stack.push(new_element);
-
-            // Check if this is the element start tag
-            // we are looking for
-            if (reader.characterOffset() == offset) {
-                break;
-            }
-        }
-        // If we detect the end tag of an element,
-        // we remove it from the top of the stack
-        else if (reader.isEndElement()) {
-            stack.pop();
-        }
-    }
-
-    if (reader.hasError()) {
-        // Just return an empty location.
-        // Maybe we could return the stack we currently have?
-        return QStack<StackElement>();
-    }
-
-    return stack;
-}
-
-
 QString CodeViewEditor::ConvertHierarchyToQWebPath(const QList<ElementIndex>& hierarchy) const
 {
     QStringList pathparts;
@@ -2803,19 +2998,6 @@ QString CodeViewEditor::ConvertHierarchyToQWebPath(const QList<ElementIndex>& hi
 }
 
 
-QList<ElementIndex> CodeViewEditor::ConvertStackToHierarchy(const QStack<StackElement> stack) const
-{
-    QList<ElementIndex> hierarchy;
-    foreach(StackElement stack_element, stack) {
-        ElementIndex new_element;
-        new_element.name  = stack_element.name;
-        new_element.index = stack_element.num_children - 1;
-        hierarchy.append(new_element);
-    }
-    return hierarchy;
-}
-
-
 std::tuple<int, int> CodeViewEditor::ConvertHierarchyToCaretMove(const QList<ElementIndex> &hierarchy) const
 {
     QString source = toPlainText();
@@ -3640,8 +3822,7 @@ void CodeViewEditor::ReformatCSS(bool multiple_line_format)
     if (original_text != new_text) {
         QTextCursor cursor = textCursor();
         cursor.beginEditBlock();
-        cursor.select(QTextCursor::Document);
-        cursor.insertText(new_text);
+        ReplaceChangedText(cursor, original_text, new_text);
         cursor.endEditBlock();
     }
 }
@@ -3662,6 +3843,14 @@ void CodeViewEditor::ReformatHTML(bool all, bool to_valid)
         mainWindow->GetCurrentBook()->ReformatAllHTML(to_valid);
 
     } else {
+        if (m_LargeFile) {
+            QMessageBox::StandardButton button_pressed;
+            button_pressed = Utility::question(this, tr("Sigil"),
+                                               tr("This file is very large and reformatting it may take a long time.\n\nDo you want to continue?"));
+            if (button_pressed != QMessageBox::Yes) {
+                return;
+            }
+        }
         original_text = toPlainText();
 
         if (to_valid) {
@@ -3674,8 +3863,7 @@ void CodeViewEditor::ReformatHTML(bool all, bool to_valid)
             StoreCaretLocationUpdate(GetCaretLocation());
             QTextCursor cursor = textCursor();
             cursor.beginEditBlock();
-            cursor.select(QTextCursor::Document);
-            cursor.insertText(new_text);
+            ReplaceChangedText(cursor, original_text, new_text);
             cursor.endEditBlock();
             ExecuteCaretUpdate();
         }
@@ -4016,6 +4204,7 @@ void CodeViewEditor::ConnectSignalsToSlots()
 {
     connect(this, SIGNAL(blockCountChanged(int)), this, SLOT(UpdateLineNumberAreaMargin()));
     connect(this, SIGNAL(updateRequest(const QRect &, int)), this, SLOT(UpdateLineNumberArea(const QRect &, int)));
+    connect(this, SIGNAL(updateRequest(const QRect &, int)), this, SLOT(HighlightVisibleBlocks()));
     connect(this, SIGNAL(cursorPositionChanged()), this, SLOT(HighlightCurrentLine()));
     connect(this, SIGNAL(cursorPositionChanged()), this, SLOT(EmitFilteredCursorMoved()));
     connect(this, SIGNAL(textChanged()), this, SIGNAL(PageUpdated()));
@@ -24,10 +24,11 @@
 #ifndef CODEVIEWEDITOR_H
 #define CODEVIEWEDITOR_H
 
+#include <QtCore/QHash>
 #include <QtCore/QList>
-#include <QtCore/QStack>
 #include <QtWidgets/QPlainTextEdit>
 #include <QtGui/QStandardItem>
+#include <QtGui/QStaticText>
 #include <QtCore/QUrl>
 
 #include "Parsers/CSSInfo.h"
@@ -48,6 +49,7 @@ class QPrinter;
 class QShortcut;
 class LineNumberArea;
 class QSyntaxHighlighter;
+class RehighlightScheduler;
 class QContextMenuEvent;
 class QSignalMapper;
 
@@ -233,6 +235,17 @@ public:
     // inherited
     bool IsLoadingFinished();
 
+    /**
+     * Roughly how many bytes the tag list kept for the text uses.
+     */
+    qint64 GetTagListMemorySize() const;
+
+    /**
+     * Roughly how many bytes the highlighting formats of every
+     * line of the document use, 0 without a highlighter.
+     */
+    qint64 GetHighlightMemorySize() const;
+
     int GetCursorPosition() const;
     int GetCursorLine() const;
     int GetCursorColumn() const;
@@ -471,6 +484,10 @@ public slots:
 
     void SetAppearanceColors();
 
+    /**
+     * Highlights the document again for new settings.  The blocks on
+     * screen are done right away and the rest while the UI is idle.
+     */
     void RehighlightDocument();
 
 protected:
@@ -534,6 +551,12 @@ private slots:
      */
     void TextChangedFilter();
 
+    /**
+     * Keeps the tag list in step with each edit of the document
+     * by re-listing only the tags near the edit.
+     */
+    void UpdateTagList(int position, int chars_removed, int chars_added);
+
     void PasteClipEntryFromName(const QString &name);
 
     /**
@@ -558,6 +581,12 @@ private slots:
      */
     void UpdateLineNumberArea(const QRect &rectangle, int vertical_delta);
 
+    /**
+     * In large file mode, highlights the blocks that have
+     * just been scrolled into view.
+     */
+    void HighlightVisibleBlocks();
+
     /**
      * Highlights the line the user is editing.
      */
@@ -596,8 +625,29 @@ private slots:
 private:
     bool IsMarkedText();
 
+    /**
+     * Makes the document text new_text by editing only the span that
+     * differs from old_text, so that the undo stack holds that span
+     * instead of two copies of the whole document.
+     *
+     * @param cursor The cursor to edit with, already in an edit block.
+     * @param old_text The current text of the document.
+     * @param new_text The text the document is to have.
+     */
+    void ReplaceChangedText(QTextCursor &cursor, const QString &old_text, const QString &new_text);
+
     void MaybeRegenerateTagList();
 
+    /**
+     * Highlights the whole document before returning.
+     */
+    void RehighlightDocumentNow();
+
+    /**
+     * Passes the range of blocks to highlight on to the highlighter.
+     */
+    void SetHighlightedBlocks(int first, int last);
+
     QString RemoveFirstTag(const QString &text, const QString &tagname);
     QString RemoveLastTag(const QString &text, const QString &tagname);
 
@@ -664,49 +714,17 @@ private:
 
     bool AddSpellCheckContextMenu(QMenu *menu);
 
-    void AddViewImageContextMenu(QMenu *menu);
-
-    bool CreateMenuEntries(QMenu *parent_menu, QAction *topAction, QStandardItem *item);
-
-    bool InViewableImage();
-
     /**
-     * An element on the stack when searching for
-     * the current caret location.
+     * Puts the spelling suggestions in the menu in place of the
+     * placeholder shown while they were being found.
      */
-    struct StackElement {
-        /**
-         * The tag name.
-         */
-        QString name;
-
-        /**
-         * The number of child elements
-         * detected for the element, so far.
-         */
-        int num_children;
-    };
+    void AddSpellingSuggestions(QMenu *menu, QAction *placeholder, QAction *separator, const QStringList &suggestions);
 
-    /**
-     * Returns a stack of elements representing the
-     * current location of the caret in the document.
-     *
-     * @param offset The number of characters from document start to the end of
-     *               the start tag of the element the caret is residing in.
-     * @return The element location stack.
-     */
-    QStack<StackElement> GetCaretLocationStack(int offset) const;
+    void AddViewImageContextMenu(QMenu *menu);
 
-    /**
-     * Takes the stack provided by GetCaretLocationStack()
-     * and converts it into the element location hierarchy
-     * used by other ViewEditors.
-     *
-     * @param stack The StackElement stack.
-     * @return The converted ElementIndex hierarchy.
-     */
-    QList<ElementIndex> ConvertStackToHierarchy(const QStack<StackElement> stack) const;
+    bool CreateMenuEntries(QMenu *parent_menu, QAction *topAction, QStandardItem *item);
 
+    bool InViewableImage();
 
     // Used to convert Hierarchy to QWedPath used by BV and Gumbo
     QString ConvertHierarchyToQWebPath(const QList<ElementIndex>& hierarchy) const;
@@ -795,6 +813,17 @@ private:
      */
     int m_LastBlockCount;
 
+    /**
+     * The width the viewport margin was last set to.
+     */
+    int m_LineNumberAreaWidth;
+
+    /**
+     * The line numbers already laid out in the line number area
+     * font, by line number.
+     */
+    QHash<int, QStaticText> m_LineNumberTexts;
+
     /**
      * Keep tack of the currenlt selected line number when selected
      * by by clicking on the LineNumberArea.
@@ -898,6 +927,20 @@ private:
 
     TagLister m_TagList;
     bool m_regen_taglist;
+
+    /**
+     * Set when the document is too long to be highlighted in
+     * full or to have its tags matched on every cursor move.
+     */
+    bool m_LargeFile;
+
+    /**
+     * The blocks highlighted in large file mode.
+     */
+    int m_FirstHighlightedBlock;
+    int m_LastHighlightedBlock;
+
+    RehighlightScheduler *m_RehighlightScheduler;
 };
 
 #endif // CODEVIEWEDITOR_H
@@ -95,4 +95,32 @@ protected:
    }
 };
 
+//! Shows a few lines of text in the top right corner of its parent
+class TextOverlay : public OverlayWidget
+{
+    Q_OBJECT
+
+public:
+   TextOverlay(QWidget *parent = {}) : OverlayWidget{parent} {
+   }
+   void setText(const QString &text) {
+      m_text = text;
+      update();
+   }
+protected:
+   void paintEvent(QPaintEvent *) override {
+      if (m_text.isEmpty()) return;
+      QPainter p{this};
+      QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+      p.setFont(font);
+      QRect box = p.boundingRect(rect().adjusted(8, 8, -8, -8), Qt::AlignRight | Qt::AlignTop, m_text);
+      box.adjust(-6, -4, 6, 4);
+      p.fillRect(box, QColor(0, 0, 0, 160));
+      p.setPen(Qt::white);
+      p.drawText(box.adjusted(6, 4, -6, -4), Qt::AlignLeft | Qt::AlignTop, m_text);
+   }
+private:
+   QString m_text;
+};
+
 #endif // OVERLAY_H
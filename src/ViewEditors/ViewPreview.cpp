@@ -22,6 +22,7 @@
 
 #include <QEvent>
 #include <QEventLoop>
+#include <QShowEvent>
 #include <QDeadlineTimer>
 #include <QTimer>
 #include <QSize>
@@ -36,11 +37,15 @@
 #include <QWebEngineScript>
 #include <QApplication>
 #include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
 #include <QDebug>
 
 #include "MainUI/MainApplication.h"
+#include "Parsers/GumboInterface.h"
 #include "Misc/WebProfileMgr.h"
 #include "Misc/SettingsStore.h"
+#include "Misc/Trace.h"
 #include "Misc/Utility.h"
 #include "sigil_constants.h"
 #include "ViewEditors/WebEngPage.h"
@@ -57,6 +62,34 @@ const QString SET_CURSOR_JS2 =
     "selection.removeAllRanges();"
     "selection.addRange(range);";
 
+// Replaces %3 element children of the body starting at %2 with the
+// elements in %4, provided the body still has the %1 element
+// children it was loaded with.
+const QString LIVE_PATCH_JS =
+    "(function() {"
+    "  var body = document.body;"
+    "  if (!body || body.children.length != %1) return false;"
+    "  var fragment;"
+    "  try {"
+    "    var range = document.createRange();"
+    "    range.selectNodeContents(body);"
+    "    fragment = range.createContextualFragment(%4);"
+    "  } catch (e) {"
+    "    return false;"
+    "  }"
+    "  var next = (%2 + %3 < body.children.length) ? body.children[%2 + %3] : null;"
+    "  for (var i = 0; i < %3; i++) body.removeChild(body.children[%2]);"
+    "  body.insertBefore(fragment, next);"
+    "  return true;"
+    "})();";
+
+// MathJax lives in the page's own world
+const QString LIVE_PATCH_TYPESET_JS =
+    "if (window.MathJax) {"
+    "  if (MathJax.typesetPromise) MathJax.typesetPromise();"
+    "  else if (MathJax.Hub) MathJax.Hub.Queue([\"Typeset\", MathJax.Hub]);"
+    "}";
+
 const QString SET_PREVIEW_COLORS =
     "document.body.style.backgroundColor=\"%1\"; "
     "document.body.style.color=\"%2\";";
@@ -101,6 +134,8 @@ struct HTMLResult {
 ViewPreview::ViewPreview(QWidget *parent, bool setbackground)
     : QWebEngineView(parent),
       m_isLoadFinished(false),
+      m_ViewWebPage(NULL),
+      m_SetBackground(setbackground),
       c_jQuery(Utility::ReadUnicodeTextFile(":/javascript/jquery-3.6.4.min.js")),
       c_jQueryScrollTo(Utility::ReadUnicodeTextFile(":/javascript/jquery.scrollTo-2.1.2-min.js")),
       c_GetCaretLocation(Utility::ReadUnicodeTextFile(":/javascript/book_view_current_location.js")),
@@ -108,30 +143,51 @@ ViewPreview::ViewPreview(QWidget *parent, bool setbackground)
       m_CustomSetDocumentInProgress(false),
       m_pendingScrollToFragment(QString()),
       m_LoadOkay(false),
-      m_overlay(new LoadingOverlay(this))
+      m_overlay(new LoadingOverlay(this)),
+      m_LivePatching(false),
+      m_LastLivePatched(false),
+      m_PrefetchPage(NULL),
+      m_PrefetchReady(false)
 {
-    QWebEngineProfile* profile = WebProfileMgr::instance()->GetPreviewProfile();
-    m_ViewWebPage = new WebEngPage(profile, this, setbackground);
-    setPage(m_ViewWebPage);
-    
     setContextMenuPolicy(Qt::CustomContextMenu);
     // Set the Zoom factor but be sure no signals are set because of this.
     SettingsStore ss;
     SetCurrentZoomFactor(ss.zoomPreview());
-    
+}
+
+WebEngPage *ViewPreview::GetPage()
+{
+    if (m_ViewWebPage) {
+        return m_ViewWebPage;
+    }
+    TRACE_SPAN(span, "ViewPreview::CreatePage");
+    QWebEngineProfile* profile = WebProfileMgr::instance()->GetPreviewProfile();
+    m_ViewWebPage = new WebEngPage(profile, this, m_SetBackground);
+    setPage(m_ViewWebPage);
+
     // Update the Preview's Profile Settings with User's Preferences
+    SettingsStore ss;
     m_ViewWebPage->profile()->settings()->setAttribute(QWebEngineSettings::JavascriptEnabled,
                                                        (ss.javascriptOn() == 1));
     m_ViewWebPage->profile()->settings()->setAttribute(QWebEngineSettings::JavascriptCanOpenWindows,
                                                        (ss.javascriptOn() == 1));
     m_ViewWebPage->profile()->settings()->setAttribute(QWebEngineSettings::LocalContentCanAccessRemoteUrls,
                                                        (ss.remoteOn() == 1));
+    m_ViewWebPage->setZoomFactor(m_CurrentZoomFactor);
 
     ConnectSignalsToSlots();
+    return m_ViewWebPage;
+}
+
+void ViewPreview::showEvent(QShowEvent *event)
+{
+    GetPage();
+    QWebEngineView::showEvent(event);
 }
 
 ViewPreview::~ViewPreview()
 {
+    CancelPrefetch();
     if (m_ViewWebPage != NULL) {
         delete m_ViewWebPage;
         m_ViewWebPage = 0;
@@ -156,6 +212,7 @@ void ViewPreview::CustomSetDocument(const QString &path, const QString &html)
         return;
     }
 
+    GetPage();
     m_CustomSetDocumentInProgress = true;
 
     // If this is not the very first load of this document, store the caret location
@@ -166,27 +223,207 @@ void ViewPreview::CustomSetDocument(const QString &path, const QString &html)
  
         // keep memory footprint small clear any caches when a new page loads
         if (url().toLocalFile() != path) {
-	    page()->profile()->clearHttpCache();
+	    GetPage()->profile()->clearHttpCache();
         } 
     }
 
+    QString replaced_html = AddMissingNamespace(html);
+
+    m_LastLivePatched = false;
+    if (m_LivePatching) {
+        QString head;
+        QStringList body_children;
+        GumboInterface gi = GumboInterface(replaced_html, "any_version");
+        bool can_patch = gi.get_preview_parts(head, body_children);
+        // the very same page is only asked for again when something it
+        // uses has changed, a stylesheet or an image, so load it in full
+        bool patched = can_patch && (replaced_html != m_LiveHtml) &&
+                       LivePatchDocument(path, head, body_children);
+        m_LiveHtml = replaced_html;
+        m_LivePath = can_patch ? path : QString();
+        m_LiveHead = head;
+        m_LiveBodyChildren = body_children;
+        if (patched) {
+            m_LastLivePatched = true;
+            m_CustomSetDocumentInProgress = false;
+            if (!m_pendingScrollToFragment.isEmpty()) {
+                ScrollToFragment(m_pendingScrollToFragment);
+                m_pendingScrollToFragment.clear();
+            }
+            // after the caller is done, as a full load would be
+            QTimer::singleShot(0, this, SIGNAL(DocumentLoaded()));
+            return;
+        }
+    }
+
+    if (ShowPrefetchedDocument(path, replaced_html)) {
+        return;
+    }
+    CancelPrefetch(true);
+
     m_isLoadFinished = false;
+    LoadIntoPage(GetPage(), path, replaced_html);
+    // setContent(replaced_html.toUtf8(), "application/xhtml+xml;charset=UTF-8", QUrl::fromLocalFile(path));
+}
 
+QString ViewPreview::AddMissingNamespace(const QString &html)
+{
     // If Tidy is turned off, then Sigil will explode if there is no xmlns
     // on the <html> element. So we will silently add it if needed to ensure
     // no errors occur, to allow loading of documents created outside of
     // Sigil as well as catering for section splits etc.
     QString replaced_html = html;
     replaced_html = replaced_html.replace("<html>", "<html xmlns=\"http://www.w3.org/1999/xhtml\">");
+    return replaced_html;
+}
+
+QString ViewPreview::LoadIntoPage(WebEngPage *page, const QString &path, const QString &html)
+{
     MainApplication *mainApplication = qobject_cast<MainApplication *>(qApp);
     QString key = Utility::CreateUUID();
-    mainApplication->saveInPreviewCache(key, replaced_html);
+    mainApplication->saveInPreviewCache(key, html);
     QUrl tgturl = QUrl::fromLocalFile(path);
     tgturl.setScheme("sigil");
     tgturl.setHost("");
     tgturl.setQuery("sigilpreview=" + key); 
-    page()->load(tgturl);
-    // setContent(replaced_html.toUtf8(), "application/xhtml+xml;charset=UTF-8", QUrl::fromLocalFile(path));
+    page->load(tgturl);
+    return key;
+}
+
+void ViewPreview::PrefetchDocument(const QString &path, const QString &html, const QColor &background)
+{
+    // the view's own page has to exist for the profile settings
+    if (!m_ViewWebPage || html.isEmpty()) {
+        return;
+    }
+    QString replaced_html = AddMissingNamespace(html);
+    if (m_PrefetchPage && (path == m_PrefetchPath) && (replaced_html == m_PrefetchHtml)) {
+        return;
+    }
+    CancelPrefetch();
+    TRACE_SPAN(span, "ViewPreview::PrefetchDocument");
+    m_PrefetchPage = new WebEngPage(m_ViewWebPage->profile(), this, m_SetBackground);
+    m_PrefetchPage->setBackgroundColor(background);
+    m_PrefetchPage->setZoomFactor(m_CurrentZoomFactor);
+    m_PrefetchPath = path;
+    m_PrefetchHtml = replaced_html;
+    m_PrefetchReady = false;
+    connect(m_PrefetchPage, SIGNAL(loadFinished(bool)), this, SLOT(PrefetchFinished(bool)));
+    m_PrefetchKey = LoadIntoPage(m_PrefetchPage, path, replaced_html);
+}
+
+void ViewPreview::PrefetchFinished(bool okay)
+{
+    DBG qDebug() << "PrefetchFinished with okay " << okay << m_PrefetchPath;
+    if (!okay) {
+        CancelPrefetch();
+        return;
+    }
+    m_PrefetchReady = true;
+    m_PrefetchKey.clear();
+}
+
+void ViewPreview::CancelPrefetch(bool keep_loaded)
+{
+    if (!m_PrefetchPage || (keep_loaded && m_PrefetchReady)) {
+        return;
+    }
+    // the page may not have asked for its html yet
+    if (!m_PrefetchKey.isEmpty()) {
+        MainApplication *mainApplication = qobject_cast<MainApplication *>(qApp);
+        mainApplication->loadFromPreviewCache(m_PrefetchKey);
+        m_PrefetchKey.clear();
+    }
+    disconnect(m_PrefetchPage, 0, this, 0);
+    m_PrefetchPage->triggerAction(QWebEnginePage::Stop);
+    m_PrefetchPage->deleteLater();
+    m_PrefetchPage = NULL;
+    m_PrefetchPath.clear();
+    m_PrefetchHtml.clear();
+    m_PrefetchReady = false;
+}
+
+bool ViewPreview::ShowPrefetchedDocument(const QString &path, const QString &html)
+{
+    if (!m_PrefetchPage || !m_PrefetchReady || (path != m_PrefetchPath) || (html != m_PrefetchHtml)) {
+        return false;
+    }
+    TRACE_SPAN(span, "ViewPreview::ShowPrefetchedDocument");
+    WebEngPage *old_page = m_ViewWebPage;
+    disconnect(old_page, 0, this, 0);
+    m_isLoadFinished = false;
+    disconnect(m_PrefetchPage, 0, this, 0);
+    m_ViewWebPage = m_PrefetchPage;
+    m_PrefetchPage = NULL;
+    m_PrefetchPath.clear();
+    m_PrefetchHtml.clear();
+    m_PrefetchReady = false;
+    setPage(m_ViewWebPage);
+    m_ViewWebPage->setZoomFactor(m_CurrentZoomFactor);
+    ConnectSignalsToSlots();
+    old_page->deleteLater();
+    // after the caller is done, as a full load would be
+    QTimer::singleShot(0, this, SLOT(PrefetchShown()));
+    return true;
+}
+
+void ViewPreview::PrefetchShown()
+{
+    UpdateFinishedState(true);
+    WebPageJavascriptOnLoad();
+}
+
+void ViewPreview::SetLivePatching(bool enabled)
+{
+    m_LivePatching = enabled;
+    m_LiveHtml.clear();
+    m_LivePath.clear();
+    m_LiveHead.clear();
+    m_LiveBodyChildren.clear();
+}
+
+bool ViewPreview::LivePatchDocument(const QString &path, const QString &head, const QStringList &body_children)
+{
+    // only a page that finished loading can be patched
+    if (!m_isLoadFinished || !m_LoadOkay || (path != m_LivePath) ||
+        (url().toLocalFile() != path) || (head != m_LiveHead)) {
+        return false;
+    }
+    const QStringList &old_children = m_LiveBodyChildren;
+    int old_count = old_children.count();
+    int new_count = body_children.count();
+    int start = 0;
+    while ((start < old_count) && (start < new_count) &&
+           (old_children.at(start) == body_children.at(start))) {
+        start++;
+    }
+    int end = 0;
+    while ((end < old_count - start) && (end < new_count - start) &&
+           (old_children.at(old_count - 1 - end) == body_children.at(new_count - 1 - end))) {
+        end++;
+    }
+    if ((start == old_count) && (start == new_count)) {
+        DBG qDebug() << "LivePatchDocument body is unchanged";
+        return true;
+    }
+    QStringList removed = old_children.mid(start, old_count - start - end);
+    QStringList inserted = body_children.mid(start, new_count - start - end);
+    QString fragment = inserted.join("\n");
+    // inserted scripts would not run, so let the page load again
+    if (fragment.contains("<script") || removed.join("").contains("<script")) {
+        return false;
+    }
+    DBG qDebug() << "LivePatchDocument replacing" << removed.count() << "with" << inserted.count() << "at" << start;
+    QString fragment_literal = QString::fromUtf8(QJsonDocument(QJsonArray() << fragment).toJson(QJsonDocument::Compact));
+    fragment_literal = fragment_literal.mid(1, fragment_literal.length() - 2);
+    QString script = LIVE_PATCH_JS.arg(old_count).arg(start).arg(removed.count()).arg(fragment_literal);
+    if (!EvaluateJavascript(script).toBool()) {
+        return false;
+    }
+    if (fragment.contains("<math")) {
+        GetPage()->runJavaScript(LIVE_PATCH_TYPESET_JS, QWebEngineScript::MainWorld);
+    }
+    return true;
 }
 
 bool ViewPreview::IsLoadingFinished()
@@ -220,7 +457,7 @@ float ViewPreview::GetZoomFactor() const
 
 void ViewPreview::Zoom()
 {
-    setZoomFactor(m_CurrentZoomFactor);
+    GetPage()->setZoomFactor(m_CurrentZoomFactor);
 }
 
 void ViewPreview::UpdateDisplay()
@@ -327,8 +564,11 @@ void ViewPreview::ShowOverlay()
 
 QString ViewPreview::GetHTML() const 
  {
+     if (!m_ViewWebPage) {
+         return QString();
+     }
      HTMLResult * pres = new HTMLResult();
-     page()->toHtml(SetToHTMLResultFunctor(pres));
+     m_ViewWebPage->toHtml(SetToHTMLResultFunctor(pres));
      while(!pres->isFinished()) {
          qApp->processEvents(QEventLoop::ExcludeUserInputEvents | QEventLoop::ExcludeSocketNotifiers, 100);
      }
@@ -350,7 +590,7 @@ QVariant ViewPreview::EvaluateJavascript(const QString &javascript)
 
     DBG qDebug() << "evaluate javascript" << javascript;
 
-    page()->runJavaScript(javascript,QWebEngineScript::ApplicationWorld, SetJavascriptResultFunctor(pres));
+    GetPage()->runJavaScript(javascript,QWebEngineScript::ApplicationWorld, SetJavascriptResultFunctor(pres));
     while(!pres->isFinished() && (!deadline.hasExpired())) {
         qApp->processEvents(QEventLoop::ExcludeUserInputEvents, 100);
     }
@@ -373,7 +613,7 @@ void ViewPreview::DoJavascript(const QString &javascript)
      // do not try to evaluate javascripts with the page not loaded yet
     if (!m_isLoadFinished) return;
 
-    page()->runJavaScript(javascript,QWebEngineScript::ApplicationWorld);
+    GetPage()->runJavaScript(javascript,QWebEngineScript::ApplicationWorld);
 }
 
 
@@ -395,8 +635,8 @@ void ViewPreview::GrabFocus()
 void ViewPreview::WebPageJavascriptOnLoad()
 {
     DBG qDebug() << "WebPageJavascriptOnLoad start";
-    page()->runJavaScript(c_jQuery, QWebEngineScript::ApplicationWorld);
-    page()->runJavaScript(c_jQueryScrollTo, QWebEngineScript::ApplicationWorld);
+    GetPage()->runJavaScript(c_jQuery, QWebEngineScript::ApplicationWorld);
+    GetPage()->runJavaScript(c_jQueryScrollTo, QWebEngineScript::ApplicationWorld);
     DBG qDebug() << "WebPageJavascriptOnLoad end";
     DBG qDebug() << "WebPageJavascriptOnLoad with m_CustomSetDocumentInProgress: " << m_CustomSetDocumentInProgress;
     m_isLoadFinished = true;
@@ -543,10 +783,10 @@ bool ViewPreview::ExecuteCaretUpdate(const QString &caret_update)
 
 void ViewPreview::ConnectSignalsToSlots()
 {
-    connect(page(), SIGNAL(loadFinished(bool)), this, SLOT(UpdateFinishedState(bool)));
-    connect(page(), SIGNAL(loadFinished(bool)), this, SLOT(WebPageJavascriptOnLoad()));
-    connect(page(), SIGNAL(loadStarted()), this, SLOT(LoadingStarted()));
-    connect(page(), SIGNAL(LinkClicked(const QUrl &)), this, SIGNAL(LinkClicked(const QUrl &)));
-    connect(page(), SIGNAL(loadProgress(int)), this, SLOT(LoadingProgress(int)));
-    connect(page(), SIGNAL(linkHovered(const QString &)), this, SLOT(LinkHovered(const QString &)));
+    connect(m_ViewWebPage, SIGNAL(loadFinished(bool)), this, SLOT(UpdateFinishedState(bool)));
+    connect(m_ViewWebPage, SIGNAL(loadFinished(bool)), this, SLOT(WebPageJavascriptOnLoad()));
+    connect(m_ViewWebPage, SIGNAL(loadStarted()), this, SLOT(LoadingStarted()));
+    connect(m_ViewWebPage, SIGNAL(LinkClicked(const QUrl &)), this, SIGNAL(LinkClicked(const QUrl &)));
+    connect(m_ViewWebPage, SIGNAL(loadProgress(int)), this, SLOT(LoadingProgress(int)));
+    connect(m_ViewWebPage, SIGNAL(linkHovered(const QString &)), this, SLOT(LinkHovered(const QString &)));
 }
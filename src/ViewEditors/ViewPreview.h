@@ -24,6 +24,7 @@
 #define VIEWPREVIEW_H
 
 #include <memory>
+#include <QColor>
 #include <QEvent>
 #include <QtWebEngineWidgets>
 #include <QtWebEngineCore>
@@ -31,6 +32,7 @@
 #include "ViewEditors/WebEngPage.h"
 #include "ViewEditors/Viewer.h"
 
+class QShowEvent;
 class QSize;
 class LoadingOverlay;
 
@@ -51,12 +53,51 @@ public:
 
     void CustomSetDocument(const QString &path, const QString &html);
 
+    /**
+     * When on, a new version of the page already shown only has the
+     * elements of its body that changed replaced in the live page, which
+     * keeps the scroll position and does not fetch or lay out anything
+     * else again.  Any change to the head or the body attributes, the
+     * same page asked for again, or a body the page scripts have changed
+     * still loads the whole page.
+     */
+    void SetLivePatching(bool enabled);
+
+    /**
+     * Loads a page the user is likely to go to next into a hidden page
+     * of the same profile.  When CustomSetDocument is later asked for
+     * the very same html it shows that page instead of loading it.
+     * Asking for the page already prefetched does nothing.
+     */
+    void PrefetchDocument(const QString &path, const QString &html, const QColor &background);
+
+    /**
+     * Stops a prefetch that is still loading and frees its page.
+     * @param keep_loaded If true a prefetched page that is done
+     *                    loading is kept.
+     */
+    void CancelPrefetch(bool keep_loaded = false);
+
     bool IsLoadingFinished();
 
     QString GetHoverUrl();
 
     bool WasLoadOkay() { return m_LoadOkay; }
 
+    /**
+     * Returns the page of the view, creating it and with it the
+     * WebEngine preview profile the first time it is needed.  Use
+     * this rather than page(), which would make a page of the
+     * default profile.
+     */
+    WebEngPage *GetPage();
+
+    /**
+     * True if the last CustomSetDocument patched the live page
+     * rather than loading it again.
+     */
+    bool WasLivePatched() { return m_LastLivePatched; }
+
     void SetZoomFactor(float factor);
 
     void SetCurrentZoomFactor(float factor);
@@ -152,6 +193,12 @@ protected:
 
     bool m_isLoadFinished;
 
+    /**
+     * The page is made when the view is first shown so that starting
+     * WebEngine does not hold up showing the main window.
+     */
+    void showEvent(QShowEvent *event);
+
 protected slots:
 
     void UpdateFinishedState(bool okay);
@@ -172,6 +219,14 @@ private slots:
         ExecuteCaretUpdate();
     }
 
+    void PrefetchFinished(bool okay);
+
+    /**
+     * Runs what a load of the view's own page does once it is
+     * finished, for a prefetched page just swapped in.
+     */
+    void PrefetchShown();
+
 private:
 
     /**
@@ -179,6 +234,29 @@ private:
      */
     void ScrollToFragmentInternal(const QString &fragment);
 
+    /**
+     * Replaces the body elements that differ from the page last shown.
+     * Returns false if the page has to be loaded in full instead.
+     */
+    bool LivePatchDocument(const QString &path, const QString &head, const QStringList &body_children);
+
+    /**
+     * Swaps the prefetched page in as the page of the view if it
+     * holds this html and is done loading.
+     */
+    bool ShowPrefetchedDocument(const QString &path, const QString &html);
+
+    /**
+     * Loads html into page through the preview cache and returns
+     * the key it was stored under.
+     */
+    static QString LoadIntoPage(WebEngPage *page, const QString &path, const QString &html);
+
+    /**
+     * Returns the html with the namespace the page needs.
+     */
+    static QString AddMissingNamespace(const QString &html);
+
     /**
      * Builds the element-selecting JavaScript code, ignoring the text nodes.
      * Always just chains children() jQuery calls.
@@ -208,6 +286,8 @@ private:
 
     WebEngPage *m_ViewWebPage;
 
+    bool m_SetBackground;
+
     float m_CurrentZoomFactor;
 
     /**
@@ -243,6 +323,28 @@ private:
     QString m_hoverUrl;
 
     LoadingOverlay* m_overlay;
+
+    bool m_LivePatching;
+    bool m_LastLivePatched;
+
+    /**
+     * The page last handed to CustomSetDocument, also split up
+     * as GumboInterface::get_preview_parts does it.
+     */
+    QString m_LiveHtml;
+    QString m_LivePath;
+    QString m_LiveHead;
+    QStringList m_LiveBodyChildren;
+
+    /**
+     * The hidden page loading or holding the page likely to be
+     * shown next, NULL if there is none.
+     */
+    WebEngPage *m_PrefetchPage;
+    QString m_PrefetchPath;
+    QString m_PrefetchHtml;
+    QString m_PrefetchKey;
+    bool m_PrefetchReady;
 };
 
 #endif // VIEWPREVIEW_H
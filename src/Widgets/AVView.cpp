@@ -76,6 +76,7 @@ AVView::AVView(QWidget *parent)
 {
     QWebEngineProfile* profile = WebProfileMgr::instance()->GetOneTimeProfile();
     m_WebView->setPage(new SimplePage(profile, m_WebView));
+    WebProfileMgr::instance()->DiscardWhenHidden(m_WebView);
     m_WebView->setContextMenuPolicy(Qt::NoContextMenu);
     m_WebView->setFocusPolicy(Qt::NoFocus);
     m_WebView->setAcceptDrops(false);
@@ -33,9 +33,12 @@
 #include <QApplication>
 #include <QFont>
 #include <QRawFont>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrent>
 #include <QDebug>
 
 #include "ViewEditors/SimplePage.h"
+#include "Misc/TaskScheduler.h"
 #include "Misc/Utility.h"
 #include "Misc/WebProfileMgr.h"
 #include "Widgets/FontView.h"
@@ -71,36 +74,96 @@ static const QString FONT_HTML_BASE =
     "</body>"
     "</html>";
 
+static const QString LOADING_HTML_BASE =
+    "<html>"
+    "<head><title></title></head>"
+    "<body><p>%1</p></body>"
+    "</html>";
+
 
 FontView::FontView(QWidget *parent)
     : QWidget(parent),
       m_WebView(new QWebEngineView(this)),
-      m_layout(new QVBoxLayout(this))
+      m_layout(new QVBoxLayout(this)),
+      m_Watcher(new QFutureWatcher<FontView::FontDescription>(this))
 {
     QWebEngineProfile* profile = WebProfileMgr::instance()->GetOneTimeProfile();
     m_WebView->setPage(new SimplePage(profile, m_WebView));
+    WebProfileMgr::instance()->DiscardWhenHidden(m_WebView);
     m_WebView->setContextMenuPolicy(Qt::NoContextMenu);
     m_WebView->setFocusPolicy(Qt::NoFocus);
     m_WebView->setAcceptDrops(false);
     m_WebView->setUrl(QUrl("about:blank"));
     m_layout->addWidget(m_WebView);
+    connect(m_Watcher, SIGNAL(finished()), this, SLOT(FontRead()));
 }
 
 FontView::~FontView()
 {
+    m_Watcher->disconnect(this);
+    m_Watcher->waitForFinished();
 }
 
 void FontView::ShowFont(QString path)
 {
     m_path = path;
+    // Large fonts and collections take a while to read in, so show
+    // a placeholder and read the font in a worker thread
+    QString html = LOADING_HTML_BASE.arg(tr("Loading font..."));
+    if (Utility::IsDarkMode()) {
+        html = Utility::AddDarkCSS(html);
+    }
+    m_WebView->page()->setBackgroundColor(Utility::WebViewBackgroundColor());
+    m_WebView->setHtml(html);
+    if (m_Watcher->isRunning()) {
+        // FontRead starts the newest path once this one is read
+        return;
+    }
+    m_Watcher->setFuture(TaskScheduler::Run(TaskScheduler::InteractiveLane, ReadFontDescription, path));
+}
+
+void FontView::FontRead()
+{
+    FontDescription fd = m_Watcher->result();
+    if (fd.path != m_path) {
+        // Another font was asked for while this one was being read
+        m_Watcher->setFuture(TaskScheduler::Run(TaskScheduler::InteractiveLane, ReadFontDescription, m_path));
+        return;
+    }
+
+    QString path = fd.path;
     m_WebView->page()->profile()->clearHttpCache();
     QFileInfo fi(path);
     QString file_name = fi.fileName();
-    int file_size = fi.size();
     QString font_name = fi.baseName();
+    const QUrl furl = QUrl::fromLocalFile(path);
+    QString html = FONT_HTML_BASE.arg(furl.toEncoded().constData())
+                                 .arg(font_name)
+                                 .arg(fd.weight_name)
+                                 .arg(fd.style_name)
+                                 .arg(fd.desc.isEmpty() ? tr("No reliable font data") : fd.desc)
+                                 .arg(file_name)
+                                 .arg(QString::number(fd.file_size));
+    // allow translators to control over what the font is displaying
+    html = html.replace("LOWERCASE_LETTERS", tr("abcdefghijklmnopqrstuvwxyz"));
+    html = html.replace("UPPERCASE_LETTERS", tr("ABCDEFGHIJKLMNOPQRSTUVWXYZ"));
+    html = html.replace("DIGITS_SYMBOLS", Utility::EncodeXML(tr("0123456789.:,;(*!?'\\/\")$%^&-+@=_-~><")));
+    html = html.replace("SAMPLE_LINE", tr("The quick brown fox jumps over the lazy dog"));
+    if (Utility::IsDarkMode()) {
+        html = Utility::AddDarkCSS(html);
+    }
+    m_WebView->page()->setBackgroundColor(Utility::WebViewBackgroundColor());
+    m_WebView->setHtml(html, furl);
+}
+
+// Runs in a worker thread.
+FontView::FontDescription FontView::ReadFontDescription(const QString &path)
+{
+    FontDescription fd;
+    fd.path = path;
+    fd.file_size = QFileInfo(path).size();
     QRawFont rawfont(path, 16.0);
-    QString family_name = rawfont.familyName();
-    QString desc = family_name;
+    QString desc = rawfont.familyName();
     QString weight_name;
     QString style_name;
     if (rawfont.weight() <  QFont::ExtraLight)      weight_name = "Thin";
@@ -122,26 +185,11 @@ void FontView::ShowFont(QString path)
 
     if (!desc.isEmpty()) {
         if (!style_name.isEmpty()) desc = desc + " " + style_name;
-    } else desc = tr("No reliable font data");
-
-    const QUrl furl = QUrl::fromLocalFile(path);
-    QString html = FONT_HTML_BASE.arg(furl.toEncoded().constData())
-                                 .arg(font_name)
-                                 .arg(weight_name)
-                                 .arg(style_name)
-                                 .arg(desc)
-                                 .arg(file_name)
-                                 .arg(QString::number(file_size));
-    // allow translators to control over what the font is displaying
-    html = html.replace("LOWERCASE_LETTERS", tr("abcdefghijklmnopqrstuvwxyz"));
-    html = html.replace("UPPERCASE_LETTERS", tr("ABCDEFGHIJKLMNOPQRSTUVWXYZ"));
-    html = html.replace("DIGITS_SYMBOLS", Utility::EncodeXML(tr("0123456789.:,;(*!?'\\/\")$%^&-+@=_-~><")));
-    html = html.replace("SAMPLE_LINE", tr("The quick brown fox jumps over the lazy dog"));
-    if (Utility::IsDarkMode()) {
-        html = Utility::AddDarkCSS(html);
     }
-    m_WebView->page()->setBackgroundColor(Utility::WebViewBackgroundColor());
-    m_WebView->setHtml(html, furl);
+    fd.desc = desc;
+    fd.weight_name = weight_name;
+    fd.style_name = style_name;
+    return fd;
 }
 
 void FontView::ReloadViewer()
@@ -28,6 +28,7 @@
 
 class QVBoxLayout;
 class QWebEngineView;
+template <typename T> class QFutureWatcher;
 
 class FontView : public QWidget
 {
@@ -41,10 +42,27 @@ class FontView : public QWidget
     void ShowFont(QString path);
     void ReloadViewer();
 
+ private slots:
+    void FontRead();
+
  private:
+    /**
+     * What is shown about the font, read in a worker thread.
+     */
+    struct FontDescription {
+        QString path;
+        qint64 file_size;
+        QString desc;
+        QString weight_name;
+        QString style_name;
+    };
+
+    static FontDescription ReadFontDescription(const QString &path);
+
     QString m_path;
     QWebEngineView *m_WebView;
     QVBoxLayout* m_layout;
+    QFutureWatcher<FontDescription> *m_Watcher;
 };
 
 #endif // FONTVIEW_H
@@ -35,6 +35,7 @@
 #include <QWebEngineProfile>
 
 #include "ViewEditors/SimplePage.h"
+#include "Misc/ThumbnailCache.h"
 #include "Misc/Utility.h"
 #include "Misc/WebProfileMgr.h"
 #include "Widgets/ImageView.h"
@@ -65,6 +66,7 @@ ImageView::ImageView(QWidget *parent)
 {
     QWebEngineProfile* profile = WebProfileMgr::instance()->GetOneTimeProfile();
     m_WebView->setPage(new SimplePage(profile, m_WebView));
+    WebProfileMgr::instance()->DiscardWhenHidden(m_WebView);
     m_WebView->setContextMenuPolicy(Qt::NoContextMenu);
     m_WebView->setFocusPolicy(Qt::NoFocus);
     m_WebView->setAcceptDrops(false);
@@ -83,19 +85,19 @@ void ImageView::ShowImage(QString path)
     const QFileInfo fileInfo = QFileInfo(path);
     const double ffsize = fileInfo.size() / 1024.0;
     const QString fsize = QLocale().toString(ffsize, 'f', 2);
-    const QImage img(path);
+    const ThumbnailCache::Info img = ThumbnailCache::Get(path, 0);
     const QUrl imgUrl = QUrl::fromLocalFile(path);
-    QString colors_shades = img.isGrayscale() ? tr("shades") : tr("colors");
-    QString grayscale_color = img.isGrayscale() ? tr("Grayscale") : tr("Color");
+    QString colors_shades = img.grayscale ? tr("shades") : tr("colors");
+    QString grayscale_color = img.grayscale ? tr("Grayscale") : tr("Color");
     QString colorsInfo = "";
-    if (img.depth() == 32) {
-        colorsInfo = QString(" %1bpp").arg(img.bitPlaneCount());
-    } else if (img.depth() > 0) {
-        colorsInfo = QString(" %1bpp (%2 %3)").arg(img.bitPlaneCount()).arg(img.colorCount()).arg(colors_shades);
+    if (img.depth == 32) {
+        colorsInfo = QString(" %1bpp").arg(img.bit_planes);
+    } else if (img.depth > 0) {
+        colorsInfo = QString(" %1bpp (%2 %3)").arg(img.bit_planes).arg(img.color_count).arg(colors_shades);
     }
     QString html = IMAGE_HTML_BASE.arg(imgUrl.toString())
-                              .arg(img.width())
-                              .arg(img.height())
+                              .arg(img.width)
+                              .arg(img.height)
                               .arg(fsize)
                               .arg(grayscale_color)
                               .arg(colorsInfo);
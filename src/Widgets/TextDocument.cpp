@@ -22,12 +22,25 @@
 #include <QChar>
 #include <QTextCursor>
 
+#include "Misc/SettingsSnapshot.h"
 #include "Widgets/TextDocument.h"
 
+QList<TextDocument *> TextDocument::s_Documents;
+
 TextDocument::TextDocument(QObject *parent)
     :
-    QTextDocument(parent)
+    QTextDocument(parent),
+    m_UndoMemory(0),
+    m_PendingChange(0)
+{
+    s_Documents.append(this);
+    connect(this, SIGNAL(contentsChange(int, int, int)), this, SLOT(RecordChange(int, int, int)));
+    connect(this, SIGNAL(undoCommandAdded()), this, SLOT(RecordUndoCommand()));
+}
+
+TextDocument::~TextDocument()
 {
+    s_Documents.removeOne(this);
 }
 
 // a faster way to get just the current length of the plain text
@@ -71,3 +84,67 @@ QString TextDocument::toText()
 
     return txt;
 }
+
+
+qint64 TextDocument::UndoMemory() const
+{
+    return m_UndoMemory;
+}
+
+void TextDocument::ResetUndoMemory()
+{
+    m_UndoMemory = 0;
+    m_PendingChange = 0;
+}
+
+void TextDocument::RecordChange(int position, int chars_removed, int chars_added)
+{
+    // the undo step keeps both the removed and the added text
+    m_PendingChange += static_cast<qint64>(chars_removed + chars_added) * sizeof(QChar);
+}
+
+void TextDocument::RecordUndoCommand()
+{
+    m_UndoMemory += m_PendingChange;
+    m_PendingChange = 0;
+    EnforceUndoBudget();
+}
+
+void TextDocument::EnforceUndoBudget()
+{
+    std::shared_ptr<const SettingsSnapshot::Values> settings = SettingsSnapshot::instance()->Current();
+    if ((settings->undo_memory_per_file > 0) && (m_UndoMemory > settings->undo_memory_per_file)) {
+        ClearUndoHistory();
+    }
+    if (settings->undo_memory_total <= 0) {
+        return;
+    }
+    qint64 total = 0;
+    foreach(TextDocument *document, s_Documents) {
+        total += document->m_UndoMemory;
+    }
+    while (total > settings->undo_memory_total) {
+        // the largest history other than the one just edited goes first
+        TextDocument *largest = NULL;
+        foreach(TextDocument *document, s_Documents) {
+            if ((document != this) && (document->m_UndoMemory > 0) &&
+                (!largest || (document->m_UndoMemory > largest->m_UndoMemory))) {
+                largest = document;
+            }
+        }
+        if (!largest) {
+            largest = this;
+        }
+        total -= largest->m_UndoMemory;
+        largest->ClearUndoHistory();
+        if (largest == this) {
+            break;
+        }
+    }
+}
+
+void TextDocument::ClearUndoHistory()
+{
+    clearUndoRedoStacks();
+    ResetUndoMemory();
+}
@@ -22,6 +22,7 @@
 #ifndef TEXT_DOCUMENT
 #define TEXT_DOCUMENT
 
+#include <QList>
 #include <QString>
 #include <QTextDocument>
 
@@ -32,7 +33,7 @@ class TextDocument : public QTextDocument
     public:
 
   TextDocument(QObject *parent = 0);
-  ~TextDocument() {} ;
+  ~TextDocument();
 
   int textLength();
 
@@ -50,6 +51,34 @@ class TextDocument : public QTextDocument
 
   QString toText();
 
+  // An estimate of the memory the undo history holds, from the size
+  // of the edits made since it was last cleared.  Edits that are undone
+  // and redone are counted again so it errs on the high side.
+  qint64 UndoMemory() const;
+
+  // To be called after setPlainText, which clears the undo history
+  void ResetUndoMemory();
+
+  private slots:
+
+  void RecordChange(int position, int chars_removed, int chars_added);
+  void RecordUndoCommand();
+
+  private:
+
+  // Clears the undo history of this document when it is over the per
+  // file budget, then of the largest others while all are over the total.
+  // QTextDocument can only clear its undo history, not drop the oldest steps.
+  void EnforceUndoBudget();
+
+  void ClearUndoHistory();
+
+  qint64 m_UndoMemory;
+  qint64 m_PendingChange;
+
+  // every TextDocument, GUI thread only
+  static QList<TextDocument *> s_Documents;
+
 };
 
 #endif
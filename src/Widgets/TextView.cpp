@@ -36,6 +36,7 @@
 #include <QPointer>
 #include <QColor>
 #include <QPainter>
+#include <QStaticText>
 #include <QScrollBar>
 #include <QTextBlock>
 #include <QPlainTextEdit>
@@ -45,6 +46,7 @@
 
 #include "Misc/XHTMLHighlighter.h"
 #include "Misc/CSSHighlighter.h"
+#include "Misc/RehighlightScheduler.h"
 #include "MainUI/MainWindow.h"
 #include "Misc/SettingsStore.h"
 #include "Misc/Utility.h"
@@ -53,6 +55,8 @@
 
 static const int TAB_SPACES_WIDTH     = 4;
 static const int LINE_NUMBER_MARGIN   = 5;
+// More laid out line numbers than this are dropped and laid out again
+static const int MAX_CACHED_LINE_NUMBERS = 2000;
 
 static const QChar _PAD               = QChar(0x2007); // "use a 'figure space' 8199
 
@@ -60,10 +64,16 @@ TextView::TextView(QWidget *parent)
     :
     QPlainTextEdit(parent),
     m_LineNumberArea(new TVLineNumberArea(this)),
-    m_Highlighter(nullptr)
+    m_BlockMapWidth(0),
+    m_LineNumberAreaWidth(-1),
+    m_Highlighter(nullptr),
+    m_RehighlightScheduler(nullptr)
 {
     UpdateLineNumberAreaMargin();
     setReadOnly(true);
+    // Nothing is ever undone in a viewer, so keep no history of the
+    // text put into it
+    setUndoRedoEnabled(false);
     setTextInteractionFlags(textInteractionFlags() | Qt::TextSelectableByKeyboard);
     setLineWrapMode(QPlainTextEdit::WidgetWidth);
     QFont cf = font();
@@ -82,18 +92,29 @@ TextView::~TextView()
 void TextView::setBlockMap(const QStringList& blockmap)
 {
     m_blockmap = blockmap;
+    // The labels only change here so their longest length is
+    // found once rather than each time the margin is updated
+    m_BlockMapWidth = 0;
+    foreach(const QString& aval, m_blockmap) {
+        if (aval.length() > m_BlockMapWidth) {
+            m_BlockMapWidth = aval.length();
+        }
+    }
+    m_LineNumberTexts.clear();
     UpdateLineNumberAreaMargin();
 }
 
+void TextView::SetText(const QString& text)
+{
+    // Setting it all at once only splits the text into blocks, the
+    // blocks are laid out as they are scrolled into view.  Inserting
+    // it a line at a time updates the document layout for each one.
+    setPlainText(text);
+}
+
 int TextView::CalculateLineNumberAreaWidth()
 {
-    int max_width = 0;
-    foreach(const QString& aval, m_blockmap) {
-        if (aval.length() > max_width) {
-            max_width = aval.length();
-        }
-    }
-    if (max_width == 0) {
+    if (m_BlockMapWidth == 0) {
         return 0;
     }
     int num_digits = 1;
@@ -111,13 +132,20 @@ int TextView::CalculateLineNumberAreaWidth()
 void TextView::UpdateLineNumberAreaFont(const QFont &font)
 {
     m_LineNumberArea->setFont(font);
+    m_LineNumberTexts.clear();
     UpdateLineNumberAreaMargin();
 }
 
 void TextView::UpdateLineNumberAreaMargin()
 {
-    // The left margin width depends on width of the line number area
-    setViewportMargins(CalculateLineNumberAreaWidth(), 0, 0, 0);
+    // The left margin width depends on width of the line number area.
+    // Setting the margins lays out the viewport again, so only do
+    // it when the number of digits has actually changed.
+    int width = CalculateLineNumberAreaWidth();
+    if (width != m_LineNumberAreaWidth) {
+        m_LineNumberAreaWidth = width;
+        setViewportMargins(width, 0, 0, 0);
+    }
 }
 
 void TextView::UpdateLineNumberArea(const QRect &area_to_update, int vertically_scrolled)
@@ -140,25 +168,32 @@ void TextView::LineNumberAreaPaintEvent(QPaintEvent *event)
     // Paint the background first
     painter.fillRect(event->rect(), m_codeViewAppearance.line_number_background_color);
     // painter.fillRect(event->rect(), Qt::lightGray);
+    painter.setPen(m_codeViewAppearance.line_number_foreground_color);
     QTextBlock block = firstVisibleBlock();
     int blockNumber  = block.blockNumber();
 
     int top = blockBoundingGeometry(block).translated(contentOffset()).top();
     int bottom = top + blockBoundingRect(block).height();
-    int height = fontMetrics().height();
+    int right = m_LineNumberArea->width();
 
     // We loop through all the visible and
     // unobscured blocks and paint line numbers for each
     while (block.isValid() && (top <= event->rect().bottom())) {
-        if (block.isVisible() && (bottom >= event->rect().top())) {
-            QString numlbl = "";
-            if (blockNumber < m_blockmap.count()) {
-                numlbl = m_blockmap.at(blockNumber);
+        if (block.isVisible() && (bottom >= event->rect().top()) && (blockNumber < m_blockmap.count())) {
+            // The labels are laid out once and kept, so that
+            // scrolling back and forth only draws them again
+            QHash<int, QStaticText>::const_iterator it = m_LineNumberTexts.constFind(blockNumber);
+            if (it == m_LineNumberTexts.constEnd()) {
+                if (m_LineNumberTexts.count() >= MAX_CACHED_LINE_NUMBERS) {
+                    m_LineNumberTexts.clear();
+                }
+                QStaticText numlbl(m_blockmap.at(blockNumber));
+                numlbl.setTextFormat(Qt::PlainText);
+                numlbl.prepare(QTransform(), m_LineNumberArea->font());
+                it = m_LineNumberTexts.insert(blockNumber, numlbl);
             }
             // Draw the number in the line number area.
-            painter.setPen(m_codeViewAppearance.line_number_foreground_color);
-            // painter.setPen(Qt::black);
-            painter.drawText(0, top, m_LineNumberArea->width(), height, Qt::AlignRight, numlbl);
+            painter.drawStaticText(QPointF(right - it->size().width(), top), *it);
         }
         block = block.next();
         top = bottom;
@@ -170,8 +205,10 @@ void TextView::LineNumberAreaPaintEvent(QPaintEvent *event)
 void TextView::DoHighlightDocument(HighlighterType high_type)
 {
     if (m_Highlighter) {
+        // takes the scheduler with it
         delete m_Highlighter;
         m_Highlighter = nullptr;
+        m_RehighlightScheduler = nullptr;
     }
     if (!m_Highlighter) {
         if (high_type == TextView::Highlight_XHTML) {
@@ -181,6 +218,7 @@ void TextView::DoHighlightDocument(HighlighterType high_type)
         }
     }
     if (m_Highlighter) {
+        m_RehighlightScheduler = new RehighlightScheduler(m_Highlighter, this);
         m_Highlighter->setDocument(document());
         RehighlightDocument();
     }
@@ -414,7 +452,11 @@ void TextView::contextMenuEvent(QContextMenuEvent *event)
 // Overridden so we can emit the FocusGained() signal.
 void TextView::focusInEvent(QFocusEvent *event)
 {
-    RehighlightDocument();
+    // the text is already highlighted, so there is no need
+    // to hold up the focus change to do it all over again
+    if (isVisible() && m_RehighlightScheduler) {
+        m_RehighlightScheduler->Start();
+    }
     emit FocusGained(this);
     QPlainTextEdit::focusInEvent(event);
 }
@@ -25,8 +25,10 @@
 #ifndef TEXTVIEW_H
 #define TEXTVIEW_H
 
+#include <QHash>
 #include <QList>
 #include <QPlainTextEdit>
+#include <QStaticText>
 #include <QUrl>
 
 #include "Misc/SettingsStore.h"
@@ -39,6 +41,7 @@ class QShortcut;
 class TVLineNumberArea;
 class QContextMenuEvent;
 class QSyntaxHighlighter;
+class RehighlightScheduler;
 
 /**
  * A text viewer for source code and general text.
@@ -95,6 +98,11 @@ public:
 
     QString GetSelectedText();
 
+    /**
+     * Replaces the text shown with all of text in one go.
+     */
+    void SetText(const QString& text);
+
     void setBlockMap(const QStringList& blockmap);
 
 public slots:
@@ -142,8 +150,15 @@ private:
     SettingsStore::CodeViewAppearance m_codeViewAppearance;
     TVLineNumberArea *m_LineNumberArea;
     QStringList  m_blockmap;
+    // The length of the longest label in the block map
+    int m_BlockMapWidth;
+    // The width the viewport margin was last set to
+    int m_LineNumberAreaWidth;
+    // The labels already laid out in the line number area font
+    QHash<int, QStaticText> m_LineNumberTexts;
     QScrollBar* m_verticalScrollBar;
     QSyntaxHighlighter * m_Highlighter;
+    RehighlightScheduler * m_RehighlightScheduler;
 };
 
 #endif // TEXTVIEW_H
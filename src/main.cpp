@@ -28,6 +28,7 @@
 #include <QDir>
 #include <QLibraryInfo>
 #include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
 #include <QTranslator>
 #include <QStandardPaths>
 #include <QApplication>
@@ -48,12 +49,18 @@
 #include "MainUI/MainApplication.h"
 #include "MainUI/MainWindow.h"
 #include "Misc/AppEventFilter.h"
+#include "Misc/BatchProcessor.h"
+#include "Misc/BatchWorker.h"
+#include "Misc/Benchmarks.h"
+#include "Misc/BookGenerator.h"
 #include "Misc/SigilDarkStyle.h"
+#include "Misc/SettingsSnapshot.h"
 #include "Misc/SettingsStore.h"
+#include "Misc/TaskScheduler.h"
 #include "Misc/TempFolder.h"
+#include "Misc/Trace.h"
 #include "Misc/UpdateChecker.h"
 #include "Misc/Utility.h"
-#include "Misc/WebProfileMgr.h"
 #include "Widgets/CaretStyle.h"
 #include "sigil_constants.h"
 #include "sigil_exception.h"
@@ -64,6 +71,9 @@ static const QString WIN_CLIPBOARD_ERROR = "QClipboard::setMimeData: Failed to s
 static const int RETRY_DELAY_MS = 5;
 #endif
 
+// How long after the main window is shown embedded python is started
+static const int PYTHON_PREWARM_DELAY_MS = 2000;
+
 #ifdef Q_OS_MAC
 #include <QFileDialog>
 #include <QKeySequence>
@@ -147,6 +157,7 @@ QString accumulatedQss = "";
 // on command line arguments
 static MainWindow *GetMainWindow(const QStringList &arguments)
 {
+    TRACE_SPAN(span, "main::GetMainWindow");
     // We use the first argument as the file to load after starting
     QString filepath;
     if (arguments.size() > 1 && Utility::IsFileReadable(arguments.at(1))) {
@@ -486,9 +497,32 @@ int main(int argc, char *argv[])
         qputenv("QTWEBENGINE_CHROMIUM_FLAGS", current_flags.toUtf8());
     }
 
+    // let Preview, the Inspector and the viewers share a few renderer
+    // processes rather than each starting its own, any process model
+    // flags the user has set already are left alone
+    int renderer_limit = settings.webRendererLimit();
+    if (renderer_limit > 0) {
+        QString current_flags = Utility::GetEnvironmentVar("QTWEBENGINE_CHROMIUM_FLAGS");
+        if (!current_flags.contains("--renderer-process-limit")) {
+            current_flags += QString(" --renderer-process-limit=%1").arg(renderer_limit);
+        }
+        if (!current_flags.contains("--process-per-") && !current_flags.contains("--single-process")) {
+            current_flags += " --process-per-site";
+        }
+        qputenv("QTWEBENGINE_CHROMIUM_FLAGS", current_flags.trimmed().toUtf8());
+    }
+
     // disable thread unsafe use of broken PCRE2 JIT (version 10.43) in QRegularExpression
     qputenv("QT_ENABLE_REGEXP_JIT","0");
 
+    // batch and worker modes run on build servers that have no display
+    for (int i = 1; i < argc; i++) {
+        if (((qstrcmp(argv[i], "--batch") == 0) || (qstrcmp(argv[i], "--worker") == 0)) &&
+            !qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+    }
+
     MainApplication app(argc, argv);
 
 #ifdef Q_OS_MAC
@@ -503,10 +537,8 @@ int main(int argc, char *argv[])
     AppEventFilter *filter = new AppEventFilter(&app);
     app.installEventFilter(filter);
 
-    // Set up embedded python integration first thing
-    EmbeddedPython* epython = EmbeddedPython::instance();
-    epython->addToPythonSysPath(epython->embeddedRoot());
-    epython->addToPythonSysPath(PluginDB::launcherRoot() + "/python");
+    // before any worker can ask for it
+    SettingsSnapshot::instance();
 
     try {
 
@@ -702,16 +734,16 @@ int main(int argc, char *argv[])
         app.setDesktopFileName(QStringLiteral("sigil"));
 #endif //!defined(Q_OS_WIN32) && !defined(Q_OS_MAC)
 
-        // Create the required QWebEngineProfiles, Initialize the settings
-        // just once, installing both URLInterceptor and URLSchemeHandler as needed
-        // to bypass 2mb url limit (singleton)
-        WebProfileMgr* profile_mgr = WebProfileMgr::instance();
-        Q_UNUSED(profile_mgr);
+        // The QWebEngineProfiles are created by WebProfileMgr the first time
+        // a web view needs one, which keeps WebEngine from starting before
+        // the main window is up
         
         // Needs to be created on the heap so that
         // the reply has time to return.
         // Skip if compile-time define or runtime env var is set.
-        if ((!DONT_CHECK_FOR_UPDATES) && (!qEnvironmentVariableIsSet("SKIP_SIGIL_UPDATE_CHECK"))) {
+        if ((!DONT_CHECK_FOR_UPDATES) && (!qEnvironmentVariableIsSet("SKIP_SIGIL_UPDATE_CHECK")) &&
+            !QCoreApplication::arguments().contains("--batch") &&
+            !QCoreApplication::arguments().contains("--worker")) {
             UpdateChecker *checker = new UpdateChecker(&app);
             checker->CheckForUpdate();
         }
@@ -784,6 +816,21 @@ int main(int argc, char *argv[])
         if (arguments.contains("-t")) {
             std::cout  << TempFolder::GetPathToSigilScratchpad().toStdString() << std::endl;
             return 1;
+        } else if (arguments.contains("--benchmark")) {
+            // every argument after it is a book to time
+            int result = Benchmarks::Run(arguments.mid(arguments.indexOf("--benchmark") + 1));
+            Trace::Write();
+            return result;
+        } else if (arguments.contains("--generate-book")) {
+            return BookGenerator::Run(arguments.mid(arguments.indexOf("--generate-book") + 1));
+        } else if (arguments.contains("--batch")) {
+            int result = BatchProcessor::Run(arguments.mid(arguments.indexOf("--batch") + 1));
+            Trace::Write();
+            return result;
+        } else if (arguments.contains("--worker")) {
+            int result = BatchWorker::Run(arguments.mid(arguments.indexOf("--worker") + 1));
+            Trace::Write();
+            return result;
         } else {
             // Normal startup
 
@@ -897,11 +944,28 @@ int main(int argc, char *argv[])
             }
 #endif // Linux and Win
 
-            VerifyPlugins();
             MainWindow *widget = GetMainWindow(arguments);
-            widget->show();
-            widget->activateWindow();
-            return app.exec();
+            {
+                TRACE_SPAN(span, "main::ShowMainWindow");
+                widget->show();
+                widget->activateWindow();
+            }
+
+            // reading the plugins waits until the window is up, the
+            // Plugins menu and quick launch icons are updated once done
+            QTimer::singleShot(0, &VerifyPlugins);
+
+            // embedded python is started on first use, but get it going
+            // in the background once the window is up so it is likely
+            // ready by the time anything needs it
+            QTimer::singleShot(PYTHON_PREWARM_DELAY_MS, []() {
+                TaskScheduler::Run(TaskScheduler::BackgroundLane, &EmbeddedPython::instance);
+            } );
+            int result = app.exec();
+            // temp folders may still be being removed in the background
+            TaskScheduler::WaitForDone();
+            Trace::Write();
+            return result;
         }
     } catch (std::exception &e) {
         Utility::DisplayExceptionErrorDialog(e.what());
@@ -70,6 +70,11 @@ if ( NOT DEFINED DISABLE_UPDATE_CHECK )
     set ( DISABLE_UPDATE_CHECK 0 )
 endif()
 
+# use -DDISABLE_TRACING=1 to compile out the trace spans, see Misc/Trace.h
+if ( NOT DEFINED DISABLE_TRACING )
+    set ( DISABLE_TRACING 0 )
+endif()
+
 set( RAW_SOURCES ${MAIN_FILES} ${TAB_FILES} ${SOURCEUPDATE_FILES} ${BOOK_MANIPULATION_FILES} ${RESOURCE_OBJECT_FILES} ${DIALOG_FILES} ${WIDGET_FILES} ${EXPORTER_FILES} ${IMPORTER_FILES} ${MISC_FILES} ${MISC_EDITORS_FILES} ${QUERY_FILES} ${PARSERS_FILES} ${EMBEDPYTHON_FILES} ${SPCRE_FILES} ${VIEW_EDITOR_FILES} ${MAINUI_FILES} )
 
 #############################################################################
@@ -261,6 +266,10 @@ endif()
 add_definitions( -DQT_USE_FAST_CONCATENATION )
 add_definitions( -DQT_USE_FAST_OPERATOR_PLUS )
 
+if ( DISABLE_TRACING )
+    add_definitions( -DSIGIL_NO_TRACING )
+endif()
+
 #############################################################################
 
 # "Link time code generation" flags for MSVC